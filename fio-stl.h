@@ -3882,6 +3882,11 @@ FIO_MAP Ordering & Naming Shortcut
 ***************************************************************************** */
 
 #if defined(FIO_HTTP)
+#undef FIO_HTTP_ROUTER
+#define FIO_HTTP_ROUTER
+#endif
+
+#if defined(FIO_HTTP) || defined(FIO_HTTP_ROUTER)
 #undef FIO_HTTP_HANDLE
 #define FIO_HTTP_HANDLE
 #endif
@@ -3916,6 +3921,16 @@ FIO_MAP Ordering & Naming Shortcut
 #define FIO_JSON
 #endif
 
+#if defined(FIO_JSON_SCHEMA_NAME)
+#undef FIO_JSON_SCHEMA
+#define FIO_JSON_SCHEMA
+#endif
+
+#if defined(FIO_JSON_SCHEMA)
+#undef FIO_JSON
+#define FIO_JSON
+#endif
+
 #if defined(FIO_HTTP)
 #undef FIO_HTTP1_PARSER
 #define FIO_HTTP1_PARSER
@@ -3932,7 +3947,8 @@ FIO_MAP Ordering & Naming Shortcut
 #endif
 
 #if defined(FIO_HTTP_HANDLE) || defined(FIO_QUEUE) || defined(FIO_FIOBJ) ||    \
-    defined(FIO_LEAK_COUNTER) || defined(FIO_MEMORY_NAME) || defined(FIO_POLL)
+    defined(FIO_LEAK_COUNTER) || defined(FIO_MEMORY_NAME) ||                   \
+    defined(FIO_POLL) || defined(FIO_MUSTACHE)
 #undef FIO_STATE
 #define FIO_STATE
 #endif
@@ -3941,7 +3957,8 @@ FIO_MAP Ordering & Naming Shortcut
     defined(FIO_STR_SMALL) || defined(FIO_ARRAY_TYPE_STR) ||                   \
     defined(FIO_MAP_KEY_KSTR) || defined(FIO_MAP_KEY_BSTR) ||                  \
     (defined(FIO_MAP_NAME) && !defined(FIO_MAP_KEY)) ||                        \
-    defined(FIO_MUSTACHE) || defined(FIO_MAP2_NAME)
+    defined(FIO_MUSTACHE) || defined(FIO_MAP2_NAME) ||                        \
+    defined(FIO_JSON_SCHEMA)
 #undef FIO_STR
 #define FIO_STR
 #endif
@@ -3956,7 +3973,7 @@ FIO_MAP Ordering & Naming Shortcut
 #define FIO_QUEUE
 #endif
 
-#if defined(FIO_HTTP_HANDLE) || defined(FIO_QUEUE)
+#if defined(FIO_HTTP_HANDLE) || defined(FIO_QUEUE) || defined(FIO_MUSTACHE)
 #undef FIO_TIME
 #define FIO_TIME
 #endif
@@ -4014,7 +4031,7 @@ FIO_MAP Ordering & Naming Shortcut
 #endif
 
 #if defined(FIO_CLI) || defined(FIO_MEMORY_NAME) || defined(FIO_POLL) ||       \
-    defined(FIO_STATE) || defined(FIO_HTTP_HANDLE)
+    defined(FIO_STATE) || defined(FIO_HTTP_HANDLE) || defined(FIO_MUSTACHE)
 #undef FIO_IMAP_CORE
 #define FIO_IMAP_CORE
 #endif
@@ -4037,7 +4054,7 @@ FIO_MAP Ordering & Naming Shortcut
 #endif
 
 #if defined(FIO_MEMORY_NAME) || defined(FIO_QUEUE) ||                          \
-    (defined(DEBUG) && defined(FIO_STATE))
+    defined(FIO_HTTP_HANDLE) || (defined(DEBUG) && defined(FIO_STATE))
 #undef FIO_THREADS
 #define FIO_THREADS
 #endif
@@ -4299,6 +4316,16 @@ Pointer Tagging
 #define FIO_PTR_TAG_VALIDATE(ptr) ((ptr) != NULL)
 #endif
 
+#ifndef FIO_PTR_TAG_VALIDATE_WRITE
+/**
+ * If FIO_PTR_TAG_VALIDATE_WRITE is defined, it will be verified (in addition to
+ * FIO_PTR_TAG_VALIDATE) before executing any code that mutates the object.
+ *
+ * This allows read-only objects to share the type's functions.
+ */
+#define FIO_PTR_TAG_VALIDATE_WRITE(ptr) 1
+#endif
+
 #undef FIO_PTR_TAG_VALID_OR_RETURN
 #define FIO_PTR_TAG_VALID_OR_RETURN(tagged_ptr, value)                         \
   do {                                                                         \
@@ -4326,6 +4353,34 @@ Pointer Tagging
     }                                                                          \
   } while (0)
 
+#undef FIO_PTR_TAG_WRITABLE_OR_RETURN
+#define FIO_PTR_TAG_WRITABLE_OR_RETURN(tagged_ptr, value)                      \
+  do {                                                                         \
+    if (!(FIO_PTR_TAG_VALIDATE_WRITE((tagged_ptr)))) {                         \
+      FIO_ASSERT_DEBUG(0, "attempting to mutate a read-only object.");         \
+      FIO_LOG_ERROR("attempting to mutate a read-only object (ignored).");     \
+      return (value);                                                          \
+    }                                                                          \
+  } while (0)
+#undef FIO_PTR_TAG_WRITABLE_OR_RETURN_VOID
+#define FIO_PTR_TAG_WRITABLE_OR_RETURN_VOID(tagged_ptr)                        \
+  do {                                                                         \
+    if (!(FIO_PTR_TAG_VALIDATE_WRITE((tagged_ptr)))) {                         \
+      FIO_ASSERT_DEBUG(0, "attempting to mutate a read-only object.");         \
+      FIO_LOG_ERROR("attempting to mutate a read-only object (ignored).");     \
+      return;                                                                  \
+    }                                                                          \
+  } while (0)
+#undef FIO_PTR_TAG_WRITABLE_OR_GOTO
+#define FIO_PTR_TAG_WRITABLE_OR_GOTO(tagged_ptr, lable)                        \
+  do {                                                                         \
+    if (!(FIO_PTR_TAG_VALIDATE_WRITE((tagged_ptr)))) {                         \
+      FIO_ASSERT_DEBUG(0, "attempting to mutate a read-only object.");         \
+      FIO_LOG_ERROR("attempting to mutate a read-only object (ignored).");     \
+      goto lable;                                                              \
+    }                                                                          \
+  } while (0)
+
 #define FIO_PTR_TAG_GET_UNTAGGED(untagged_type, tagged_ptr)                    \
   ((untagged_type *)(FIO_PTR_UNTAG((tagged_ptr))))
 /* ************************************************************************* */
@@ -5149,6 +5204,7 @@ Copyright and License: see header file (000 copyright.h) or top of file
 ***************************************************************************** */
 #if defined(FIO_ATOL) && !defined(H___FIO_ATOL___H)
 #define H___FIO_ATOL___H
+#include <float.h>
 #include <inttypes.h>
 #include <math.h>
 
@@ -5186,7 +5242,8 @@ typedef struct {
  *
  * If a numerical overflow or format error occurred, the `.err` flag is set.
  *
- * Note: rounding errors may occur, as this is not an `strtod` exact match.
+ * Base 10 floats are correctly rounded (an `strtod` exact match). Note that
+ * rounding errors may occur for other bases.
  */
 FIO_SFUNC fio_aton_s fio_aton(char **pstr);
 
@@ -5205,7 +5262,12 @@ Strings to Signed Numbers - API
  */
 SFUNC int64_t fio_atol(char **pstr);
 
-/** A helper function that converts between String data to a signed double. */
+/**
+ * A helper function that converts between String data to a signed double.
+ *
+ * Base 10 numbers are correctly rounded and parsed without `strtod` (locale
+ * independent).
+ */
 SFUNC double fio_atof(char **pstr);
 
 /* *****************************************************************************
@@ -5233,6 +5295,9 @@ SFUNC size_t fio_ltoa(char *dest, int64_t num, uint8_t base);
 /**
  * A helper function that converts between a double to a string.
  *
+ * Base 10 output is the shortest representation that reads back as the exact
+ * same double (round-trip safe) and doesn't depend on the locale.
+ *
  * No overflow guard is provided, make sure there's at least 130 bytes
  * available (for base 2).
  *
@@ -5480,14 +5545,30 @@ FIO_IFUNC void fio_ltoa8u(char *dest, uint64_t i, size_t digits) {
 }
 
 FIO_IFUNC void fio_ltoa10u(char *dest, uint64_t i, size_t digits) {
+  /* writes two digits at a time, halving the number of divisions */
+  static const char pairs[201] = "00010203040506070809"
+                                 "10111213141516171819"
+                                 "20212223242526272829"
+                                 "30313233343536373839"
+                                 "40414243444546474849"
+                                 "50515253545556575859"
+                                 "60616263646566676869"
+                                 "70717273747576777879"
+                                 "80818283848586878889"
+                                 "90919293949596979899";
   dest += digits;
-  *dest-- = 0;
-  while (i > 9) {
-    uint64_t nxt = i / 10;
-    *dest-- = '0' + (i - (nxt * 10ULL));
+  *dest = 0;
+  while (i > 99) {
+    uint64_t nxt = i / 100;
+    dest -= 2;
+    fio_memcpy2(dest, pairs + ((i - (nxt * 100ULL)) << 1));
     i = nxt;
   }
-  *dest = '0' + (unsigned char)i;
+  if (i > 9) {
+    fio_memcpy2(dest - 2, pairs + (i << 1));
+    return;
+  }
+  dest[-1] = '0' + (unsigned char)i;
 }
 
 FIO_IFUNC void fio_ltoa16u(char *dest, uint64_t i, size_t digits) {
@@ -6086,6 +6167,737 @@ base_error:
   return len;
 }
 
+/* *****************************************************************************
+Base 10 Strings to Doubles (correctly rounded)
+
+Digits are read 8 at a time when possible (SWAR), and the resulting 64 bit
+mantissa and base 10 exponent are converted using either the Clinger fast
+path (exact), the Eisel-Lemire algorithm ("Number Parsing at a Gigabyte per
+Second", Daniel Lemire, 2021) or, for the rare ambiguous cases, an exact big
+number comparison of the decimal against the halfway point between doubles.
+***************************************************************************** */
+
+/* maximal number of significant digits used by the exact (slow) path */
+#define FIO___ATON10_MAX_DIGITS 768
+/* big number length (in 64 bit words) for the exact (slow) path */
+#define FIO___ATON10_BIG_WORDS  96
+
+/** Tests if reading 8 bytes from `p` stays within the same memory page. */
+#ifdef FIO___ASAN_DETECTED /* the SWAR loop may read past the number */
+#define FIO___ATON10_CAN_READ8(p) 0
+#else
+#define FIO___ATON10_CAN_READ8(p) ((((uintptr_t)(p)) & 4095) <= 4088)
+#endif
+
+/** Tests if all 8 bytes (little endian) are ASCII digits. */
+FIO_IFUNC int fio___aton10_is8digits(uint64_t v) {
+  return !(((v & 0xF0F0F0F0F0F0F0F0ULL) |
+            (((v + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) ^
+           0x3333333333333333ULL);
+}
+
+/** Converts 8 ASCII digits (little endian) to their numerical value. */
+FIO_IFUNC uint64_t fio___aton10_8digits(uint64_t v) {
+  v = ((v & 0x0F0F0F0F0F0F0F0FULL) * 2561ULL) >> 8;
+  v = ((v & 0x00FF00FF00FF00FFULL) * 6553601ULL) >> 16;
+  v = ((v & 0x0000FFFF0000FFFFULL) * 42949672960001ULL) >> 32;
+  return v;
+}
+
+/**
+ * Eisel-Lemire: returns the bits of the (positive) double closest to
+ * `w * 10^q`.
+ *
+ * Sets `*exact = 0` if the result might be off by a single unit (ULP).
+ */
+FIO_SFUNC uint64_t fio___aton10_eisel_lemire(uint64_t w,
+                                             int64_t q,
+                                             int *exact) {
+  /* 128 bit (normalized, truncated) approximations of 5^q (-342 <= q <= 308),
+   * most significant word first. */
+  // clang-format off
+  static const uint64_t pow5[651][2] = {
+      {0xEEF453D6923BD65AULL, 0x113FAA2906A13B3FULL}, {0x9558B4661B6565F8ULL, 0x4AC7CA59A424C507ULL},
+      {0xBAAEE17FA23EBF76ULL, 0x5D79BCF00D2DF649ULL}, {0xE95A99DF8ACE6F53ULL, 0xF4D82C2C107973DCULL},
+      {0x91D8A02BB6C10594ULL, 0x79071B9B8A4BE869ULL}, {0xB64EC836A47146F9ULL, 0x9748E2826CDEE284ULL},
+      {0xE3E27A444D8D98B7ULL, 0xFD1B1B2308169B25ULL}, {0x8E6D8C6AB0787F72ULL, 0xFE30F0F5E50E20F7ULL},
+      {0xB208EF855C969F4FULL, 0xBDBD2D335E51A935ULL}, {0xDE8B2B66B3BC4723ULL, 0xAD2C788035E61382ULL},
+      {0x8B16FB203055AC76ULL, 0x4C3BCB5021AFCC31ULL}, {0xADDCB9E83C6B1793ULL, 0xDF4ABE242A1BBF3DULL},
+      {0xD953E8624B85DD78ULL, 0xD71D6DAD34A2AF0DULL}, {0x87D4713D6F33AA6BULL, 0x8672648C40E5AD68ULL},
+      {0xA9C98D8CCB009506ULL, 0x680EFDAF511F18C2ULL}, {0xD43BF0EFFDC0BA48ULL, 0x0212BD1B2566DEF2ULL},
+      {0x84A57695FE98746DULL, 0x014BB630F7604B57ULL}, {0xA5CED43B7E3E9188ULL, 0x419EA3BD35385E2DULL},
+      {0xCF42894A5DCE35EAULL, 0x52064CAC828675B9ULL}, {0x818995CE7AA0E1B2ULL, 0x7343EFEBD1940993ULL},
+      {0xA1EBFB4219491A1FULL, 0x1014EBE6C5F90BF8ULL}, {0xCA66FA129F9B60A6ULL, 0xD41A26E077774EF6ULL},
+      {0xFD00B897478238D0ULL, 0x8920B098955522B4ULL}, {0x9E20735E8CB16382ULL, 0x55B46E5F5D5535B0ULL},
+      {0xC5A890362FDDBC62ULL, 0xEB2189F734AA831DULL}, {0xF712B443BBD52B7BULL, 0xA5E9EC7501D523E4ULL},
+      {0x9A6BB0AA55653B2DULL, 0x47B233C92125366EULL}, {0xC1069CD4EABE89F8ULL, 0x999EC0BB696E840AULL},
+      {0xF148440A256E2C76ULL, 0xC00670EA43CA250DULL}, {0x96CD2A865764DBCAULL, 0x380406926A5E5728ULL},
+      {0xBC807527ED3E12BCULL, 0xC605083704F5ECF2ULL}, {0xEBA09271E88D976BULL, 0xF7864A44C633682EULL},
+      {0x93445B8731587EA3ULL, 0x7AB3EE6AFBE0211DULL}, {0xB8157268FDAE9E4CULL, 0x5960EA05BAD82964ULL},
+      {0xE61ACF033D1A45DFULL, 0x6FB92487298E33BDULL}, {0x8FD0C16206306BABULL, 0xA5D3B6D479F8E056ULL},
+      {0xB3C4F1BA87BC8696ULL, 0x8F48A4899877186CULL}, {0xE0B62E2929ABA83CULL, 0x331ACDABFE94DE87ULL},
+      {0x8C71DCD9BA0B4925ULL, 0x9FF0C08B7F1D0B14ULL}, {0xAF8E5410288E1B6FULL, 0x07ECF0AE5EE44DD9ULL},
+      {0xDB71E91432B1A24AULL, 0xC9E82CD9F69D6150ULL}, {0x892731AC9FAF056EULL, 0xBE311C083A225CD2ULL},
+      {0xAB70FE17C79AC6CAULL, 0x6DBD630A48AAF406ULL}, {0xD64D3D9DB981787DULL, 0x092CBBCCDAD5B108ULL},
+      {0x85F0468293F0EB4EULL, 0x25BBF56008C58EA5ULL}, {0xA76C582338ED2621ULL, 0xAF2AF2B80AF6F24EULL},
+      {0xD1476E2C07286FAAULL, 0x1AF5AF660DB4AEE1ULL}, {0x82CCA4DB847945CAULL, 0x50D98D9FC890ED4DULL},
+      {0xA37FCE126597973CULL, 0xE50FF107BAB528A0ULL}, {0xCC5FC196FEFD7D0CULL, 0x1E53ED49A96272C8ULL},
+      {0xFF77B1FCBEBCDC4FULL, 0x25E8E89C13BB0F7AULL}, {0x9FAACF3DF73609B1ULL, 0x77B191618C54E9ACULL},
+      {0xC795830D75038C1DULL, 0xD59DF5B9EF6A2417ULL}, {0xF97AE3D0D2446F25ULL, 0x4B0573286B44AD1DULL},
+      {0x9BECCE62836AC577ULL, 0x4EE367F9430AEC32ULL}, {0xC2E801FB244576D5ULL, 0x229C41F793CDA73FULL},
+      {0xF3A20279ED56D48AULL, 0x6B43527578C1110FULL}, {0x9845418C345644D6ULL, 0x830A13896B78AAA9ULL},
+      {0xBE5691EF416BD60CULL, 0x23CC986BC656D553ULL}, {0xEDEC366B11C6CB8FULL, 0x2CBFBE86B7EC8AA8ULL},
+      {0x94B3A202EB1C3F39ULL, 0x7BF7D71432F3D6A9ULL}, {0xB9E08A83A5E34F07ULL, 0xDAF5CCD93FB0CC53ULL},
+      {0xE858AD248F5C22C9ULL, 0xD1B3400F8F9CFF68ULL}, {0x91376C36D99995BEULL, 0x23100809B9C21FA1ULL},
+      {0xB58547448FFFFB2DULL, 0xABD40A0C2832A78AULL}, {0xE2E69915B3FFF9F9ULL, 0x16C90C8F323F516CULL},
+      {0x8DD01FAD907FFC3BULL, 0xAE3DA7D97F6792E3ULL}, {0xB1442798F49FFB4AULL, 0x99CD11CFDF41779CULL},
+      {0xDD95317F31C7FA1DULL, 0x40405643D711D583ULL}, {0x8A7D3EEF7F1CFC52ULL, 0x482835EA666B2572ULL},
+      {0xAD1C8EAB5EE43B66ULL, 0xDA3243650005EECFULL}, {0xD863B256369D4A40ULL, 0x90BED43E40076A82ULL},
+      {0x873E4F75E2224E68ULL, 0x5A7744A6E804A291ULL}, {0xA90DE3535AAAE202ULL, 0x711515D0A205CB36ULL},
+      {0xD3515C2831559A83ULL, 0x0D5A5B44CA873E03ULL}, {0x8412D9991ED58091ULL, 0xE858790AFE9486C2ULL},
+      {0xA5178FFF668AE0B6ULL, 0x626E974DBE39A872ULL}, {0xCE5D73FF402D98E3ULL, 0xFB0A3D212DC8128FULL},
+      {0x80FA687F881C7F8EULL, 0x7CE66634BC9D0B99ULL}, {0xA139029F6A239F72ULL, 0x1C1FFFC1EBC44E80ULL},
+      {0xC987434744AC874EULL, 0xA327FFB266B56220ULL}, {0xFBE9141915D7A922ULL, 0x4BF1FF9F0062BAA8ULL},
+      {0x9D71AC8FADA6C9B5ULL, 0x6F773FC3603DB4A9ULL}, {0xC4CE17B399107C22ULL, 0xCB550FB4384D21D3ULL},
+      {0xF6019DA07F549B2BULL, 0x7E2A53A146606A48ULL}, {0x99C102844F94E0FBULL, 0x2EDA7444CBFC426DULL},
+      {0xC0314325637A1939ULL, 0xFA911155FEFB5308ULL}, {0xF03D93EEBC589F88ULL, 0x793555AB7EBA27CAULL},
+      {0x96267C7535B763B5ULL, 0x4BC1558B2F3458DEULL}, {0xBBB01B9283253CA2ULL, 0x9EB1AAEDFB016F16ULL},
+      {0xEA9C227723EE8BCBULL, 0x465E15A979C1CADCULL}, {0x92A1958A7675175FULL, 0x0BFACD89EC191EC9ULL},
+      {0xB749FAED14125D36ULL, 0xCEF980EC671F667BULL}, {0xE51C79A85916F484ULL, 0x82B7E12780E7401AULL},
+      {0x8F31CC0937AE58D2ULL, 0xD1B2ECB8B0908810ULL}, {0xB2FE3F0B8599EF07ULL, 0x861FA7E6DCB4AA15ULL},
+      {0xDFBDCECE67006AC9ULL, 0x67A791E093E1D49AULL}, {0x8BD6A141006042BDULL, 0xE0C8BB2C5C6D24E0ULL},
+      {0xAECC49914078536DULL, 0x58FAE9F773886E18ULL}, {0xDA7F5BF590966848ULL, 0xAF39A475506A899EULL},
+      {0x888F99797A5E012DULL, 0x6D8406C952429603ULL}, {0xAAB37FD7D8F58178ULL, 0xC8E5087BA6D33B83ULL},
+      {0xD5605FCDCF32E1D6ULL, 0xFB1E4A9A90880A64ULL}, {0x855C3BE0A17FCD26ULL, 0x5CF2EEA09A55067FULL},
+      {0xA6B34AD8C9DFC06FULL, 0xF42FAA48C0EA481EULL}, {0xD0601D8EFC57B08BULL, 0xF13B94DAF124DA26ULL},
+      {0x823C12795DB6CE57ULL, 0x76C53D08D6B70858ULL}, {0xA2CB1717B52481EDULL, 0x54768C4B0C64CA6EULL},
+      {0xCB7DDCDDA26DA268ULL, 0xA9942F5DCF7DFD09ULL}, {0xFE5D54150B090B02ULL, 0xD3F93B35435D7C4CULL},
+      {0x9EFA548D26E5A6E1ULL, 0xC47BC5014A1A6DAFULL}, {0xC6B8E9B0709F109AULL, 0x359AB6419CA1091BULL},
+      {0xF867241C8CC6D4C0ULL, 0xC30163D203C94B62ULL}, {0x9B407691D7FC44F8ULL, 0x79E0DE63425DCF1DULL},
+      {0xC21094364DFB5636ULL, 0x985915FC12F542E4ULL}, {0xF294B943E17A2BC4ULL, 0x3E6F5B7B17B2939DULL},
+      {0x979CF3CA6CEC5B5AULL, 0xA705992CEECF9C42ULL}, {0xBD8430BD08277231ULL, 0x50C6FF782A838353ULL},
+      {0xECE53CEC4A314EBDULL, 0xA4F8BF5635246428ULL}, {0x940F4613AE5ED136ULL, 0x871B7795E136BE99ULL},
+      {0xB913179899F68584ULL, 0x28E2557B59846E3FULL}, {0xE757DD7EC07426E5ULL, 0x331AEADA2FE589CFULL},
+      {0x9096EA6F3848984FULL, 0x3FF0D2C85DEF7621ULL}, {0xB4BCA50B065ABE63ULL, 0x0FED077A756B53A9ULL},
+      {0xE1EBCE4DC7F16DFBULL, 0xD3E8495912C62894ULL}, {0x8D3360F09CF6E4BDULL, 0x64712DD7ABBBD95CULL},
+      {0xB080392CC4349DECULL, 0xBD8D794D96AACFB3ULL}, {0xDCA04777F541C567ULL, 0xECF0D7A0FC5583A0ULL},
+      {0x89E42CAAF9491B60ULL, 0xF41686C49DB57244ULL}, {0xAC5D37D5B79B6239ULL, 0x311C2875C522CED5ULL},
+      {0xD77485CB25823AC7ULL, 0x7D633293366B828BULL}, {0x86A8D39EF77164BCULL, 0xAE5DFF9C02033197ULL},
+      {0xA8530886B54DBDEBULL, 0xD9F57F830283FDFCULL}, {0xD267CAA862A12D66ULL, 0xD072DF63C324FD7BULL},
+      {0x8380DEA93DA4BC60ULL, 0x4247CB9E59F71E6DULL}, {0xA46116538D0DEB78ULL, 0x52D9BE85F074E608ULL},
+      {0xCD795BE870516656ULL, 0x67902E276C921F8BULL}, {0x806BD9714632DFF6ULL, 0x00BA1CD8A3DB53B6ULL},
+      {0xA086CFCD97BF97F3ULL, 0x80E8A40ECCD228A4ULL}, {0xC8A883C0FDAF7DF0ULL, 0x6122CD128006B2CDULL},
+      {0xFAD2A4B13D1B5D6CULL, 0x796B805720085F81ULL}, {0x9CC3A6EEC6311A63ULL, 0xCBE3303674053BB0ULL},
+      {0xC3F490AA77BD60FCULL, 0xBEDBFC4411068A9CULL}, {0xF4F1B4D515ACB93BULL, 0xEE92FB5515482D44ULL},
+      {0x991711052D8BF3C5ULL, 0x751BDD152D4D1C4AULL}, {0xBF5CD54678EEF0B6ULL, 0xD262D45A78A0635DULL},
+      {0xEF340A98172AACE4ULL, 0x86FB897116C87C34ULL}, {0x9580869F0E7AAC0EULL, 0xD45D35E6AE3D4DA0ULL},
+      {0xBAE0A846D2195712ULL, 0x8974836059CCA109ULL}, {0xE998D258869FACD7ULL, 0x2BD1A438703FC94BULL},
+      {0x91FF83775423CC06ULL, 0x7B6306A34627DDCFULL}, {0xB67F6455292CBF08ULL, 0x1A3BC84C17B1D542ULL},
+      {0xE41F3D6A7377EECAULL, 0x20CABA5F1D9E4A93ULL}, {0x8E938662882AF53EULL, 0x547EB47B7282EE9CULL},
+      {0xB23867FB2A35B28DULL, 0xE99E619A4F23AA43ULL}, {0xDEC681F9F4C31F31ULL, 0x6405FA00E2EC94D4ULL},
+      {0x8B3C113C38F9F37EULL, 0xDE83BC408DD3DD04ULL}, {0xAE0B158B4738705EULL, 0x9624AB50B148D445ULL},
+      {0xD98DDAEE19068C76ULL, 0x3BADD624DD9B0957ULL}, {0x87F8A8D4CFA417C9ULL, 0xE54CA5D70A80E5D6ULL},
+      {0xA9F6D30A038D1DBCULL, 0x5E9FCF4CCD211F4CULL}, {0xD47487CC8470652BULL, 0x7647C3200069671FULL},
+      {0x84C8D4DFD2C63F3BULL, 0x29ECD9F40041E073ULL}, {0xA5FB0A17C777CF09ULL, 0xF468107100525890ULL},
+      {0xCF79CC9DB955C2CCULL, 0x7182148D4066EEB4ULL}, {0x81AC1FE293D599BFULL, 0xC6F14CD848405530ULL},
+      {0xA21727DB38CB002FULL, 0xB8ADA00E5A506A7CULL}, {0xCA9CF1D206FDC03BULL, 0xA6D90811F0E4851CULL},
+      {0xFD442E4688BD304AULL, 0x908F4A166D1DA663ULL}, {0x9E4A9CEC15763E2EULL, 0x9A598E4E043287FEULL},
+      {0xC5DD44271AD3CDBAULL, 0x40EFF1E1853F29FDULL}, {0xF7549530E188C128ULL, 0xD12BEE59E68EF47CULL},
+      {0x9A94DD3E8CF578B9ULL, 0x82BB74F8301958CEULL}, {0xC13A148E3032D6E7ULL, 0xE36A52363C1FAF01ULL},
+      {0xF18899B1BC3F8CA1ULL, 0xDC44E6C3CB279AC1ULL}, {0x96F5600F15A7B7E5ULL, 0x29AB103A5EF8C0B9ULL},
+      {0xBCB2B812DB11A5DEULL, 0x7415D448F6B6F0E7ULL}, {0xEBDF661791D60F56ULL, 0x111B495B3464AD21ULL},
+      {0x936B9FCEBB25C995ULL, 0xCAB10DD900BEEC34ULL}, {0xB84687C269EF3BFBULL, 0x3D5D514F40EEA742ULL},
+      {0xE65829B3046B0AFAULL, 0x0CB4A5A3112A5112ULL}, {0x8FF71A0FE2C2E6DCULL, 0x47F0E785EABA72ABULL},
+      {0xB3F4E093DB73A093ULL, 0x59ED216765690F56ULL}, {0xE0F218B8D25088B8ULL, 0x306869C13EC3532CULL},
+      {0x8C974F7383725573ULL, 0x1E414218C73A13FBULL}, {0xAFBD2350644EEACFULL, 0xE5D1929EF90898FAULL},
+      {0xDBAC6C247D62A583ULL, 0xDF45F746B74ABF39ULL}, {0x894BC396CE5DA772ULL, 0x6B8BBA8C328EB783ULL},
+      {0xAB9EB47C81F5114FULL, 0x066EA92F3F326564ULL}, {0xD686619BA27255A2ULL, 0xC80A537B0EFEFEBDULL},
+      {0x8613FD0145877585ULL, 0xBD06742CE95F5F36ULL}, {0xA798FC4196E952E7ULL, 0x2C48113823B73704ULL},
+      {0xD17F3B51FCA3A7A0ULL, 0xF75A15862CA504C5ULL}, {0x82EF85133DE648C4ULL, 0x9A984D73DBE722FBULL},
+      {0xA3AB66580D5FDAF5ULL, 0xC13E60D0D2E0EBBAULL}, {0xCC963FEE10B7D1B3ULL, 0x318DF905079926A8ULL},
+      {0xFFBBCFE994E5C61FULL, 0xFDF17746497F7052ULL}, {0x9FD561F1FD0F9BD3ULL, 0xFEB6EA8BEDEFA633ULL},
+      {0xC7CABA6E7C5382C8ULL, 0xFE64A52EE96B8FC0ULL}, {0xF9BD690A1B68637BULL, 0x3DFDCE7AA3C673B0ULL},
+      {0x9C1661A651213E2DULL, 0x06BEA10CA65C084EULL}, {0xC31BFA0FE5698DB8ULL, 0x486E494FCFF30A62ULL},
+      {0xF3E2F893DEC3F126ULL, 0x5A89DBA3C3EFCCFAULL}, {0x986DDB5C6B3A76B7ULL, 0xF89629465A75E01CULL},
+      {0xBE89523386091465ULL, 0xF6BBB397F1135823ULL}, {0xEE2BA6C0678B597FULL, 0x746AA07DED582E2CULL},
+      {0x94DB483840B717EFULL, 0xA8C2A44EB4571CDCULL}, {0xBA121A4650E4DDEBULL, 0x92F34D62616CE413ULL},
+      {0xE896A0D7E51E1566ULL, 0x77B020BAF9C81D17ULL}, {0x915E2486EF32CD60ULL, 0x0ACE1474DC1D122EULL},
+      {0xB5B5ADA8AAFF80B8ULL, 0x0D819992132456BAULL}, {0xE3231912D5BF60E6ULL, 0x10E1FFF697ED6C69ULL},
+      {0x8DF5EFABC5979C8FULL, 0xCA8D3FFA1EF463C1ULL}, {0xB1736B96B6FD83B3ULL, 0xBD308FF8A6B17CB2ULL},
+      {0xDDD0467C64BCE4A0ULL, 0xAC7CB3F6D05DDBDEULL}, {0x8AA22C0DBEF60EE4ULL, 0x6BCDF07A423AA96BULL},
+      {0xAD4AB7112EB3929DULL, 0x86C16C98D2C953C6ULL}, {0xD89D64D57A607744ULL, 0xE871C7BF077BA8B7ULL},
+      {0x87625F056C7C4A8BULL, 0x11471CD764AD4972ULL}, {0xA93AF6C6C79B5D2DULL, 0xD598E40D3DD89BCFULL},
+      {0xD389B47879823479ULL, 0x4AFF1D108D4EC2C3ULL}, {0x843610CB4BF160CBULL, 0xCEDF722A585139BAULL},
+      {0xA54394FE1EEDB8FEULL, 0xC2974EB4EE658828ULL}, {0xCE947A3DA6A9273EULL, 0x733D226229FEEA32ULL},
+      {0x811CCC668829B887ULL, 0x0806357D5A3F525FULL}, {0xA163FF802A3426A8ULL, 0xCA07C2DCB0CF26F7ULL},
+      {0xC9BCFF6034C13052ULL, 0xFC89B393DD02F0B5ULL}, {0xFC2C3F3841F17C67ULL, 0xBBAC2078D443ACE2ULL},
+      {0x9D9BA7832936EDC0ULL, 0xD54B944B84AA4C0DULL}, {0xC5029163F384A931ULL, 0x0A9E795E65D4DF11ULL},
+      {0xF64335BCF065D37DULL, 0x4D4617B5FF4A16D5ULL}, {0x99EA0196163FA42EULL, 0x504BCED1BF8E4E45ULL},
+      {0xC06481FB9BCF8D39ULL, 0xE45EC2862F71E1D6ULL}, {0xF07DA27A82C37088ULL, 0x5D767327BB4E5A4CULL},
+      {0x964E858C91BA2655ULL, 0x3A6A07F8D510F86FULL}, {0xBBE226EFB628AFEAULL, 0x890489F70A55368BULL},
+      {0xEADAB0ABA3B2DBE5ULL, 0x2B45AC74CCEA842EULL}, {0x92C8AE6B464FC96FULL, 0x3B0B8BC90012929DULL},
+      {0xB77ADA0617E3BBCBULL, 0x09CE6EBB40173744ULL}, {0xE55990879DDCAABDULL, 0xCC420A6A101D0515ULL},
+      {0x8F57FA54C2A9EAB6ULL, 0x9FA946824A12232DULL}, {0xB32DF8E9F3546564ULL, 0x47939822DC96ABF9ULL},
+      {0xDFF9772470297EBDULL, 0x59787E2B93BC56F7ULL}, {0x8BFBEA76C619EF36ULL, 0x57EB4EDB3C55B65AULL},
+      {0xAEFAE51477A06B03ULL, 0xEDE622920B6B23F1ULL}, {0xDAB99E59958885C4ULL, 0xE95FAB368E45ECEDULL},
+      {0x88B402F7FD75539BULL, 0x11DBCB0218EBB414ULL}, {0xAAE103B5FCD2A881ULL, 0xD652BDC29F26A119ULL},
+      {0xD59944A37C0752A2ULL, 0x4BE76D3346F0495FULL}, {0x857FCAE62D8493A5ULL, 0x6F70A4400C562DDBULL},
+      {0xA6DFBD9FB8E5B88EULL, 0xCB4CCD500F6BB952ULL}, {0xD097AD07A71F26B2ULL, 0x7E2000A41346A7A7ULL},
+      {0x825ECC24C873782FULL, 0x8ED400668C0C28C8ULL}, {0xA2F67F2DFA90563BULL, 0x728900802F0F32FAULL},
+      {0xCBB41EF979346BCAULL, 0x4F2B40A03AD2FFB9ULL}, {0xFEA126B7D78186BCULL, 0xE2F610C84987BFA8ULL},
+      {0x9F24B832E6B0F436ULL, 0x0DD9CA7D2DF4D7C9ULL}, {0xC6EDE63FA05D3143ULL, 0x91503D1C79720DBBULL},
+      {0xF8A95FCF88747D94ULL, 0x75A44C6397CE912AULL}, {0x9B69DBE1B548CE7CULL, 0xC986AFBE3EE11ABAULL},
+      {0xC24452DA229B021BULL, 0xFBE85BADCE996168ULL}, {0xF2D56790AB41C2A2ULL, 0xFAE27299423FB9C3ULL},
+      {0x97C560BA6B0919A5ULL, 0xDCCD879FC967D41AULL}, {0xBDB6B8E905CB600FULL, 0x5400E987BBC1C920ULL},
+      {0xED246723473E3813ULL, 0x290123E9AAB23B68ULL}, {0x9436C0760C86E30BULL, 0xF9A0B6720AAF6521ULL},
+      {0xB94470938FA89BCEULL, 0xF808E40E8D5B3E69ULL}, {0xE7958CB87392C2C2ULL, 0xB60B1D1230B20E04ULL},
+      {0x90BD77F3483BB9B9ULL, 0xB1C6F22B5E6F48C2ULL}, {0xB4ECD5F01A4AA828ULL, 0x1E38AEB6360B1AF3ULL},
+      {0xE2280B6C20DD5232ULL, 0x25C6DA63C38DE1B0ULL}, {0x8D590723948A535FULL, 0x579C487E5A38AD0EULL},
+      {0xB0AF48EC79ACE837ULL, 0x2D835A9DF0C6D851ULL}, {0xDCDB1B2798182244ULL, 0xF8E431456CF88E65ULL},
+      {0x8A08F0F8BF0F156BULL, 0x1B8E9ECB641B58FFULL}, {0xAC8B2D36EED2DAC5ULL, 0xE272467E3D222F3FULL},
+      {0xD7ADF884AA879177ULL, 0x5B0ED81DCC6ABB0FULL}, {0x86CCBB52EA94BAEAULL, 0x98E947129FC2B4E9ULL},
+      {0xA87FEA27A539E9A5ULL, 0x3F2398D747B36224ULL}, {0xD29FE4B18E88640EULL, 0x8EEC7F0D19A03AADULL},
+      {0x83A3EEEEF9153E89ULL, 0x1953CF68300424ACULL}, {0xA48CEAAAB75A8E2BULL, 0x5FA8C3423C052DD7ULL},
+      {0xCDB02555653131B6ULL, 0x3792F412CB06794DULL}, {0x808E17555F3EBF11ULL, 0xE2BBD88BBEE40BD0ULL},
+      {0xA0B19D2AB70E6ED6ULL, 0x5B6ACEAEAE9D0EC4ULL}, {0xC8DE047564D20A8BULL, 0xF245825A5A445275ULL},
+      {0xFB158592BE068D2EULL, 0xEED6E2F0F0D56712ULL}, {0x9CED737BB6C4183DULL, 0x55464DD69685606BULL},
+      {0xC428D05AA4751E4CULL, 0xAA97E14C3C26B886ULL}, {0xF53304714D9265DFULL, 0xD53DD99F4B3066A8ULL},
+      {0x993FE2C6D07B7FABULL, 0xE546A8038EFE4029ULL}, {0xBF8FDB78849A5F96ULL, 0xDE98520472BDD033ULL},
+      {0xEF73D256A5C0F77CULL, 0x963E66858F6D4440ULL}, {0x95A8637627989AADULL, 0xDDE7001379A44AA8ULL},
+      {0xBB127C53B17EC159ULL, 0x5560C018580D5D52ULL}, {0xE9D71B689DDE71AFULL, 0xAAB8F01E6E10B4A6ULL},
+      {0x9226712162AB070DULL, 0xCAB3961304CA70E8ULL}, {0xB6B00D69BB55C8D1ULL, 0x3D607B97C5FD0D22ULL},
+      {0xE45C10C42A2B3B05ULL, 0x8CB89A7DB77C506AULL}, {0x8EB98A7A9A5B04E3ULL, 0x77F3608E92ADB242ULL},
+      {0xB267ED1940F1C61CULL, 0x55F038B237591ED3ULL}, {0xDF01E85F912E37A3ULL, 0x6B6C46DEC52F6688ULL},
+      {0x8B61313BBABCE2C6ULL, 0x2323AC4B3B3DA015ULL}, {0xAE397D8AA96C1B77ULL, 0xABEC975E0A0D081AULL},
+      {0xD9C7DCED53C72255ULL, 0x96E7BD358C904A21ULL}, {0x881CEA14545C7575ULL, 0x7E50D64177DA2E54ULL},
+      {0xAA242499697392D2ULL, 0xDDE50BD1D5D0B9E9ULL}, {0xD4AD2DBFC3D07787ULL, 0x955E4EC64B44E864ULL},
+      {0x84EC3C97DA624AB4ULL, 0xBD5AF13BEF0B113EULL}, {0xA6274BBDD0FADD61ULL, 0xECB1AD8AEACDD58EULL},
+      {0xCFB11EAD453994BAULL, 0x67DE18EDA5814AF2ULL}, {0x81CEB32C4B43FCF4ULL, 0x80EACF948770CED7ULL},
+      {0xA2425FF75E14FC31ULL, 0xA1258379A94D028DULL}, {0xCAD2F7F5359A3B3EULL, 0x096EE45813A04330ULL},
+      {0xFD87B5F28300CA0DULL, 0x8BCA9D6E188853FCULL}, {0x9E74D1B791E07E48ULL, 0x775EA264CF55347EULL},
+      {0xC612062576589DDAULL, 0x95364AFE032A819EULL}, {0xF79687AED3EEC551ULL, 0x3A83DDBD83F52205ULL},
+      {0x9ABE14CD44753B52ULL, 0xC4926A9672793543ULL}, {0xC16D9A0095928A27ULL, 0x75B7053C0F178294ULL},
+      {0xF1C90080BAF72CB1ULL, 0x5324C68B12DD6339ULL}, {0x971DA05074DA7BEEULL, 0xD3F6FC16EBCA5E04ULL},
+      {0xBCE5086492111AEAULL, 0x88F4BB1CA6BCF585ULL}, {0xEC1E4A7DB69561A5ULL, 0x2B31E9E3D06C32E6ULL},
+      {0x9392EE8E921D5D07ULL, 0x3AFF322E62439FD0ULL}, {0xB877AA3236A4B449ULL, 0x09BEFEB9FAD487C3ULL},
+      {0xE69594BEC44DE15BULL, 0x4C2EBE687989A9B4ULL}, {0x901D7CF73AB0ACD9ULL, 0x0F9D37014BF60A11ULL},
+      {0xB424DC35095CD80FULL, 0x538484C19EF38C95ULL}, {0xE12E13424BB40E13ULL, 0x2865A5F206B06FBAULL},
+      {0x8CBCCC096F5088CBULL, 0xF93F87B7442E45D4ULL}, {0xAFEBFF0BCB24AAFEULL, 0xF78F69A51539D749ULL},
+      {0xDBE6FECEBDEDD5BEULL, 0xB573440E5A884D1CULL}, {0x89705F4136B4A597ULL, 0x31680A88F8953031ULL},
+      {0xABCC77118461CEFCULL, 0xFDC20D2B36BA7C3EULL}, {0xD6BF94D5E57A42BCULL, 0x3D32907604691B4DULL},
+      {0x8637BD05AF6C69B5ULL, 0xA63F9A49C2C1B110ULL}, {0xA7C5AC471B478423ULL, 0x0FCF80DC33721D54ULL},
+      {0xD1B71758E219652BULL, 0xD3C36113404EA4A9ULL}, {0x83126E978D4FDF3BULL, 0x645A1CAC083126EAULL},
+      {0xA3D70A3D70A3D70AULL, 0x3D70A3D70A3D70A4ULL}, {0xCCCCCCCCCCCCCCCCULL, 0xCCCCCCCCCCCCCCCDULL},
+      {0x8000000000000000ULL, 0x0000000000000000ULL}, {0xA000000000000000ULL, 0x0000000000000000ULL},
+      {0xC800000000000000ULL, 0x0000000000000000ULL}, {0xFA00000000000000ULL, 0x0000000000000000ULL},
+      {0x9C40000000000000ULL, 0x0000000000000000ULL}, {0xC350000000000000ULL, 0x0000000000000000ULL},
+      {0xF424000000000000ULL, 0x0000000000000000ULL}, {0x9896800000000000ULL, 0x0000000000000000ULL},
+      {0xBEBC200000000000ULL, 0x0000000000000000ULL}, {0xEE6B280000000000ULL, 0x0000000000000000ULL},
+      {0x9502F90000000000ULL, 0x0000000000000000ULL}, {0xBA43B74000000000ULL, 0x0000000000000000ULL},
+      {0xE8D4A51000000000ULL, 0x0000000000000000ULL}, {0x9184E72A00000000ULL, 0x0000000000000000ULL},
+      {0xB5E620F480000000ULL, 0x0000000000000000ULL}, {0xE35FA931A0000000ULL, 0x0000000000000000ULL},
+      {0x8E1BC9BF04000000ULL, 0x0000000000000000ULL}, {0xB1A2BC2EC5000000ULL, 0x0000000000000000ULL},
+      {0xDE0B6B3A76400000ULL, 0x0000000000000000ULL}, {0x8AC7230489E80000ULL, 0x0000000000000000ULL},
+      {0xAD78EBC5AC620000ULL, 0x0000000000000000ULL}, {0xD8D726B7177A8000ULL, 0x0000000000000000ULL},
+      {0x878678326EAC9000ULL, 0x0000000000000000ULL}, {0xA968163F0A57B400ULL, 0x0000000000000000ULL},
+      {0xD3C21BCECCEDA100ULL, 0x0000000000000000ULL}, {0x84595161401484A0ULL, 0x0000000000000000ULL},
+      {0xA56FA5B99019A5C8ULL, 0x0000000000000000ULL}, {0xCECB8F27F4200F3AULL, 0x0000000000000000ULL},
+      {0x813F3978F8940984ULL, 0x4000000000000000ULL}, {0xA18F07D736B90BE5ULL, 0x5000000000000000ULL},
+      {0xC9F2C9CD04674EDEULL, 0xA400000000000000ULL}, {0xFC6F7C4045812296ULL, 0x4D00000000000000ULL},
+      {0x9DC5ADA82B70B59DULL, 0xF020000000000000ULL}, {0xC5371912364CE305ULL, 0x6C28000000000000ULL},
+      {0xF684DF56C3E01BC6ULL, 0xC732000000000000ULL}, {0x9A130B963A6C115CULL, 0x3C7F400000000000ULL},
+      {0xC097CE7BC90715B3ULL, 0x4B9F100000000000ULL}, {0xF0BDC21ABB48DB20ULL, 0x1E86D40000000000ULL},
+      {0x96769950B50D88F4ULL, 0x1314448000000000ULL}, {0xBC143FA4E250EB31ULL, 0x17D955A000000000ULL},
+      {0xEB194F8E1AE525FDULL, 0x5DCFAB0800000000ULL}, {0x92EFD1B8D0CF37BEULL, 0x5AA1CAE500000000ULL},
+      {0xB7ABC627050305ADULL, 0xF14A3D9E40000000ULL}, {0xE596B7B0C643C719ULL, 0x6D9CCD05D0000000ULL},
+      {0x8F7E32CE7BEA5C6FULL, 0xE4820023A2000000ULL}, {0xB35DBF821AE4F38BULL, 0xDDA2802C8A800000ULL},
+      {0xE0352F62A19E306EULL, 0xD50B2037AD200000ULL}, {0x8C213D9DA502DE45ULL, 0x4526F422CC340000ULL},
+      {0xAF298D050E4395D6ULL, 0x9670B12B7F410000ULL}, {0xDAF3F04651D47B4CULL, 0x3C0CDD765F114000ULL},
+      {0x88D8762BF324CD0FULL, 0xA5880A69FB6AC800ULL}, {0xAB0E93B6EFEE0053ULL, 0x8EEA0D047A457A00ULL},
+      {0xD5D238A4ABE98068ULL, 0x72A4904598D6D880ULL}, {0x85A36366EB71F041ULL, 0x47A6DA2B7F864750ULL},
+      {0xA70C3C40A64E6C51ULL, 0x999090B65F67D924ULL}, {0xD0CF4B50CFE20765ULL, 0xFFF4B4E3F741CF6DULL},
+      {0x82818F1281ED449FULL, 0xBFF8F10E7A8921A4ULL}, {0xA321F2D7226895C7ULL, 0xAFF72D52192B6A0DULL},
+      {0xCBEA6F8CEB02BB39ULL, 0x9BF4F8A69F764490ULL}, {0xFEE50B7025C36A08ULL, 0x02F236D04753D5B4ULL},
+      {0x9F4F2726179A2245ULL, 0x01D762422C946590ULL}, {0xC722F0EF9D80AAD6ULL, 0x424D3AD2B7B97EF5ULL},
+      {0xF8EBAD2B84E0D58BULL, 0xD2E0898765A7DEB2ULL}, {0x9B934C3B330C8577ULL, 0x63CC55F49F88EB2FULL},
+      {0xC2781F49FFCFA6D5ULL, 0x3CBF6B71C76B25FBULL}, {0xF316271C7FC3908AULL, 0x8BEF464E3945EF7AULL},
+      {0x97EDD871CFDA3A56ULL, 0x97758BF0E3CBB5ACULL}, {0xBDE94E8E43D0C8ECULL, 0x3D52EEED1CBEA317ULL},
+      {0xED63A231D4C4FB27ULL, 0x4CA7AAA863EE4BDDULL}, {0x945E455F24FB1CF8ULL, 0x8FE8CAA93E74EF6AULL},
+      {0xB975D6B6EE39E436ULL, 0xB3E2FD538E122B44ULL}, {0xE7D34C64A9C85D44ULL, 0x60DBBCA87196B616ULL},
+      {0x90E40FBEEA1D3A4AULL, 0xBC8955E946FE31CDULL}, {0xB51D13AEA4A488DDULL, 0x6BABAB6398BDBE41ULL},
+      {0xE264589A4DCDAB14ULL, 0xC696963C7EED2DD1ULL}, {0x8D7EB76070A08AECULL, 0xFC1E1DE5CF543CA2ULL},
+      {0xB0DE65388CC8ADA8ULL, 0x3B25A55F43294BCBULL}, {0xDD15FE86AFFAD912ULL, 0x49EF0EB713F39EBEULL},
+      {0x8A2DBF142DFCC7ABULL, 0x6E3569326C784337ULL}, {0xACB92ED9397BF996ULL, 0x49C2C37F07965404ULL},
+      {0xD7E77A8F87DAF7FBULL, 0xDC33745EC97BE906ULL}, {0x86F0AC99B4E8DAFDULL, 0x69A028BB3DED71A3ULL},
+      {0xA8ACD7C0222311BCULL, 0xC40832EA0D68CE0CULL}, {0xD2D80DB02AABD62BULL, 0xF50A3FA490C30190ULL},
+      {0x83C7088E1AAB65DBULL, 0x792667C6DA79E0FAULL}, {0xA4B8CAB1A1563F52ULL, 0x577001B891185938ULL},
+      {0xCDE6FD5E09ABCF26ULL, 0xED4C0226B55E6F86ULL}, {0x80B05E5AC60B6178ULL, 0x544F8158315B05B4ULL},
+      {0xA0DC75F1778E39D6ULL, 0x696361AE3DB1C721ULL}, {0xC913936DD571C84CULL, 0x03BC3A19CD1E38E9ULL},
+      {0xFB5878494ACE3A5FULL, 0x04AB48A04065C723ULL}, {0x9D174B2DCEC0E47BULL, 0x62EB0D64283F9C76ULL},
+      {0xC45D1DF942711D9AULL, 0x3BA5D0BD324F8394ULL}, {0xF5746577930D6500ULL, 0xCA8F44EC7EE36479ULL},
+      {0x9968BF6ABBE85F20ULL, 0x7E998B13CF4E1ECBULL}, {0xBFC2EF456AE276E8ULL, 0x9E3FEDD8C321A67EULL},
+      {0xEFB3AB16C59B14A2ULL, 0xC5CFE94EF3EA101EULL}, {0x95D04AEE3B80ECE5ULL, 0xBBA1F1D158724A12ULL},
+      {0xBB445DA9CA61281FULL, 0x2A8A6E45AE8EDC97ULL}, {0xEA1575143CF97226ULL, 0xF52D09D71A3293BDULL},
+      {0x924D692CA61BE758ULL, 0x593C2626705F9C56ULL}, {0xB6E0C377CFA2E12EULL, 0x6F8B2FB00C77836CULL},
+      {0xE498F455C38B997AULL, 0x0B6DFB9C0F956447ULL}, {0x8EDF98B59A373FECULL, 0x4724BD4189BD5EACULL},
+      {0xB2977EE300C50FE7ULL, 0x58EDEC91EC2CB657ULL}, {0xDF3D5E9BC0F653E1ULL, 0x2F2967B66737E3EDULL},
+      {0x8B865B215899F46CULL, 0xBD79E0D20082EE74ULL}, {0xAE67F1E9AEC07187ULL, 0xECD8590680A3AA11ULL},
+      {0xDA01EE641A708DE9ULL, 0xE80E6F4820CC9495ULL}, {0x884134FE908658B2ULL, 0x3109058D147FDCDDULL},
+      {0xAA51823E34A7EEDEULL, 0xBD4B46F0599FD415ULL}, {0xD4E5E2CDC1D1EA96ULL, 0x6C9E18AC7007C91AULL},
+      {0x850FADC09923329EULL, 0x03E2CF6BC604DDB0ULL}, {0xA6539930BF6BFF45ULL, 0x84DB8346B786151CULL},
+      {0xCFE87F7CEF46FF16ULL, 0xE612641865679A63ULL}, {0x81F14FAE158C5F6EULL, 0x4FCB7E8F3F60C07EULL},
+      {0xA26DA3999AEF7749ULL, 0xE3BE5E330F38F09DULL}, {0xCB090C8001AB551CULL, 0x5CADF5BFD3072CC5ULL},
+      {0xFDCB4FA002162A63ULL, 0x73D9732FC7C8F7F6ULL}, {0x9E9F11C4014DDA7EULL, 0x2867E7FDDCDD9AFAULL},
+      {0xC646D63501A1511DULL, 0xB281E1FD541501B8ULL}, {0xF7D88BC24209A565ULL, 0x1F225A7CA91A4226ULL},
+      {0x9AE757596946075FULL, 0x3375788DE9B06958ULL}, {0xC1A12D2FC3978937ULL, 0x0052D6B1641C83AEULL},
+      {0xF209787BB47D6B84ULL, 0xC0678C5DBD23A49AULL}, {0x9745EB4D50CE6332ULL, 0xF840B7BA963646E0ULL},
+      {0xBD176620A501FBFFULL, 0xB650E5A93BC3D898ULL}, {0xEC5D3FA8CE427AFFULL, 0xA3E51F138AB4CEBEULL},
+      {0x93BA47C980E98CDFULL, 0xC66F336C36B10137ULL}, {0xB8A8D9BBE123F017ULL, 0xB80B0047445D4184ULL},
+      {0xE6D3102AD96CEC1DULL, 0xA60DC059157491E5ULL}, {0x9043EA1AC7E41392ULL, 0x87C89837AD68DB2FULL},
+      {0xB454E4A179DD1877ULL, 0x29BABE4598C311FBULL}, {0xE16A1DC9D8545E94ULL, 0xF4296DD6FEF3D67AULL},
+      {0x8CE2529E2734BB1DULL, 0x1899E4A65F58660CULL}, {0xB01AE745B101E9E4ULL, 0x5EC05DCFF72E7F8FULL},
+      {0xDC21A1171D42645DULL, 0x76707543F4FA1F73ULL}, {0x899504AE72497EBAULL, 0x6A06494A791C53A8ULL},
+      {0xABFA45DA0EDBDE69ULL, 0x0487DB9D17636892ULL}, {0xD6F8D7509292D603ULL, 0x45A9D2845D3C42B6ULL},
+      {0x865B86925B9BC5C2ULL, 0x0B8A2392BA45A9B2ULL}, {0xA7F26836F282B732ULL, 0x8E6CAC7768D7141EULL},
+      {0xD1EF0244AF2364FFULL, 0x3207D795430CD926ULL}, {0x8335616AED761F1FULL, 0x7F44E6BD49E807B8ULL},
+      {0xA402B9C5A8D3A6E7ULL, 0x5F16206C9C6209A6ULL}, {0xCD036837130890A1ULL, 0x36DBA887C37A8C0FULL},
+      {0x802221226BE55A64ULL, 0xC2494954DA2C9789ULL}, {0xA02AA96B06DEB0FDULL, 0xF2DB9BAA10B7BD6CULL},
+      {0xC83553C5C8965D3DULL, 0x6F92829494E5ACC7ULL}, {0xFA42A8B73ABBF48CULL, 0xCB772339BA1F17F9ULL},
+      {0x9C69A97284B578D7ULL, 0xFF2A760414536EFBULL}, {0xC38413CF25E2D70DULL, 0xFEF5138519684ABAULL},
+      {0xF46518C2EF5B8CD1ULL, 0x7EB258665FC25D69ULL}, {0x98BF2F79D5993802ULL, 0xEF2F773FFBD97A61ULL},
+      {0xBEEEFB584AFF8603ULL, 0xAAFB550FFACFD8FAULL}, {0xEEAABA2E5DBF6784ULL, 0x95BA2A53F983CF38ULL},
+      {0x952AB45CFA97A0B2ULL, 0xDD945A747BF26183ULL}, {0xBA756174393D88DFULL, 0x94F971119AEEF9E4ULL},
+      {0xE912B9D1478CEB17ULL, 0x7A37CD5601AAB85DULL}, {0x91ABB422CCB812EEULL, 0xAC62E055C10AB33AULL},
+      {0xB616A12B7FE617AAULL, 0x577B986B314D6009ULL}, {0xE39C49765FDF9D94ULL, 0xED5A7E85FDA0B80BULL},
+      {0x8E41ADE9FBEBC27DULL, 0x14588F13BE847307ULL}, {0xB1D219647AE6B31CULL, 0x596EB2D8AE258FC8ULL},
+      {0xDE469FBD99A05FE3ULL, 0x6FCA5F8ED9AEF3BBULL}, {0x8AEC23D680043BEEULL, 0x25DE7BB9480D5854ULL},
+      {0xADA72CCC20054AE9ULL, 0xAF561AA79A10AE6AULL}, {0xD910F7FF28069DA4ULL, 0x1B2BA1518094DA04ULL},
+      {0x87AA9AFF79042286ULL, 0x90FB44D2F05D0842ULL}, {0xA99541BF57452B28ULL, 0x353A1607AC744A53ULL},
+      {0xD3FA922F2D1675F2ULL, 0x42889B8997915CE8ULL}, {0x847C9B5D7C2E09B7ULL, 0x69956135FEBADA11ULL},
+      {0xA59BC234DB398C25ULL, 0x43FAB9837E699095ULL}, {0xCF02B2C21207EF2EULL, 0x94F967E45E03F4BBULL},
+      {0x8161AFB94B44F57DULL, 0x1D1BE0EEBAC278F5ULL}, {0xA1BA1BA79E1632DCULL, 0x6462D92A69731732ULL},
+      {0xCA28A291859BBF93ULL, 0x7D7B8F7503CFDCFEULL}, {0xFCB2CB35E702AF78ULL, 0x5CDA735244C3D43EULL},
+      {0x9DEFBF01B061ADABULL, 0x3A0888136AFA64A7ULL}, {0xC56BAEC21C7A1916ULL, 0x088AAA1845B8FDD0ULL},
+      {0xF6C69A72A3989F5BULL, 0x8AAD549E57273D45ULL}, {0x9A3C2087A63F6399ULL, 0x36AC54E2F678864BULL},
+      {0xC0CB28A98FCF3C7FULL, 0x84576A1BB416A7DDULL}, {0xF0FDF2D3F3C30B9FULL, 0x656D44A2A11C51D5ULL},
+      {0x969EB7C47859E743ULL, 0x9F644AE5A4B1B325ULL}, {0xBC4665B596706114ULL, 0x873D5D9F0DDE1FEEULL},
+      {0xEB57FF22FC0C7959ULL, 0xA90CB506D155A7EAULL}, {0x9316FF75DD87CBD8ULL, 0x09A7F12442D588F2ULL},
+      {0xB7DCBF5354E9BECEULL, 0x0C11ED6D538AEB2FULL}, {0xE5D3EF282A242E81ULL, 0x8F1668C8A86DA5FAULL},
+      {0x8FA475791A569D10ULL, 0xF96E017D694487BCULL}, {0xB38D92D760EC4455ULL, 0x37C981DCC395A9ACULL},
+      {0xE070F78D3927556AULL, 0x85BBE253F47B1417ULL}, {0x8C469AB843B89562ULL, 0x93956D7478CCEC8EULL},
+      {0xAF58416654A6BABBULL, 0x387AC8D1970027B2ULL}, {0xDB2E51BFE9D0696AULL, 0x06997B05FCC0319EULL},
+      {0x88FCF317F22241E2ULL, 0x441FECE3BDF81F03ULL}, {0xAB3C2FDDEEAAD25AULL, 0xD527E81CAD7626C3ULL},
+      {0xD60B3BD56A5586F1ULL, 0x8A71E223D8D3B074ULL}, {0x85C7056562757456ULL, 0xF6872D5667844E49ULL},
+      {0xA738C6BEBB12D16CULL, 0xB428F8AC016561DBULL}, {0xD106F86E69D785C7ULL, 0xE13336D701BEBA52ULL},
+      {0x82A45B450226B39CULL, 0xECC0024661173473ULL}, {0xA34D721642B06084ULL, 0x27F002D7F95D0190ULL},
+      {0xCC20CE9BD35C78A5ULL, 0x31EC038DF7B441F4ULL}, {0xFF290242C83396CEULL, 0x7E67047175A15271ULL},
+      {0x9F79A169BD203E41ULL, 0x0F0062C6E984D386ULL}, {0xC75809C42C684DD1ULL, 0x52C07B78A3E60868ULL},
+      {0xF92E0C3537826145ULL, 0xA7709A56CCDF8A82ULL}, {0x9BBCC7A142B17CCBULL, 0x88A66076400BB691ULL},
+      {0xC2ABF989935DDBFEULL, 0x6ACFF893D00EA435ULL}, {0xF356F7EBF83552FEULL, 0x0583F6B8C4124D43ULL},
+      {0x98165AF37B2153DEULL, 0xC3727A337A8B704AULL}, {0xBE1BF1B059E9A8D6ULL, 0x744F18C0592E4C5CULL},
+      {0xEDA2EE1C7064130CULL, 0x1162DEF06F79DF73ULL}, {0x9485D4D1C63E8BE7ULL, 0x8ADDCB5645AC2BA8ULL},
+      {0xB9A74A0637CE2EE1ULL, 0x6D953E2BD7173692ULL}, {0xE8111C87C5C1BA99ULL, 0xC8FA8DB6CCDD0437ULL},
+      {0x910AB1D4DB9914A0ULL, 0x1D9C9892400A22A2ULL}, {0xB54D5E4A127F59C8ULL, 0x2503BEB6D00CAB4BULL},
+      {0xE2A0B5DC971F303AULL, 0x2E44AE64840FD61DULL}, {0x8DA471A9DE737E24ULL, 0x5CEAECFED289E5D2ULL},
+      {0xB10D8E1456105DADULL, 0x7425A83E872C5F47ULL}, {0xDD50F1996B947518ULL, 0xD12F124E28F77719ULL},
+      {0x8A5296FFE33CC92FULL, 0x82BD6B70D99AAA6FULL}, {0xACE73CBFDC0BFB7BULL, 0x636CC64D1001550BULL},
+      {0xD8210BEFD30EFA5AULL, 0x3C47F7E05401AA4EULL}, {0x8714A775E3E95C78ULL, 0x65ACFAEC34810A71ULL},
+      {0xA8D9D1535CE3B396ULL, 0x7F1839A741A14D0DULL}, {0xD31045A8341CA07CULL, 0x1EDE48111209A050ULL},
+      {0x83EA2B892091E44DULL, 0x934AED0AAB460432ULL}, {0xA4E4B66B68B65D60ULL, 0xF81DA84D5617853FULL},
+      {0xCE1DE40642E3F4B9ULL, 0x36251260AB9D668EULL}, {0x80D2AE83E9CE78F3ULL, 0xC1D72B7C6B426019ULL},
+      {0xA1075A24E4421730ULL, 0xB24CF65B8612F81FULL}, {0xC94930AE1D529CFCULL, 0xDEE033F26797B627ULL},
+      {0xFB9B7CD9A4A7443CULL, 0x169840EF017DA3B1ULL}, {0x9D412E0806E88AA5ULL, 0x8E1F289560EE864EULL},
+      {0xC491798A08A2AD4EULL, 0xF1A6F2BAB92A27E2ULL}, {0xF5B5D7EC8ACB58A2ULL, 0xAE10AF696774B1DBULL},
+      {0x9991A6F3D6BF1765ULL, 0xACCA6DA1E0A8EF29ULL}, {0xBFF610B0CC6EDD3FULL, 0x17FD090A58D32AF3ULL},
+      {0xEFF394DCFF8A948EULL, 0xDDFC4B4CEF07F5B0ULL}, {0x95F83D0A1FB69CD9ULL, 0x4ABDAF101564F98EULL},
+      {0xBB764C4CA7A4440FULL, 0x9D6D1AD41ABE37F1ULL}, {0xEA53DF5FD18D5513ULL, 0x84C86189216DC5EDULL},
+      {0x92746B9BE2F8552CULL, 0x32FD3CF5B4E49BB4ULL}, {0xB7118682DBB66A77ULL, 0x3FBC8C33221DC2A1ULL},
+      {0xE4D5E82392A40515ULL, 0x0FABAF3FEAA5334AULL}, {0x8F05B1163BA6832DULL, 0x29CB4D87F2A7400EULL},
+      {0xB2C71D5BCA9023F8ULL, 0x743E20E9EF511012ULL}, {0xDF78E4B2BD342CF6ULL, 0x914DA9246B255416ULL},
+      {0x8BAB8EEFB6409C1AULL, 0x1AD089B6C2F7548EULL}, {0xAE9672ABA3D0C320ULL, 0xA184AC2473B529B1ULL},
+      {0xDA3C0F568CC4F3E8ULL, 0xC9E5D72D90A2741EULL}, {0x8865899617FB1871ULL, 0x7E2FA67C7A658892ULL},
+      {0xAA7EEBFB9DF9DE8DULL, 0xDDBB901B98FEEAB7ULL}, {0xD51EA6FA85785631ULL, 0x552A74227F3EA565ULL},
+      {0x8533285C936B35DEULL, 0xD53A88958F87275FULL}, {0xA67FF273B8460356ULL, 0x8A892ABAF368F137ULL},
+      {0xD01FEF10A657842CULL, 0x2D2B7569B0432D85ULL}, {0x8213F56A67F6B29BULL, 0x9C3B29620E29FC73ULL},
+      {0xA298F2C501F45F42ULL, 0x8349F3BA91B47B8FULL}, {0xCB3F2F7642717713ULL, 0x241C70A936219A73ULL},
+      {0xFE0EFB53D30DD4D7ULL, 0xED238CD383AA0110ULL}, {0x9EC95D1463E8A506ULL, 0xF4363804324A40AAULL},
+      {0xC67BB4597CE2CE48ULL, 0xB143C6053EDCD0D5ULL}, {0xF81AA16FDC1B81DAULL, 0xDD94B7868E94050AULL},
+      {0x9B10A4E5E9913128ULL, 0xCA7CF2B4191C8326ULL}, {0xC1D4CE1F63F57D72ULL, 0xFD1C2F611F63A3F0ULL},
+      {0xF24A01A73CF2DCCFULL, 0xBC633B39673C8CECULL}, {0x976E41088617CA01ULL, 0xD5BE0503E085D813ULL},
+      {0xBD49D14AA79DBC82ULL, 0x4B2D8644D8A74E18ULL}, {0xEC9C459D51852BA2ULL, 0xDDF8E7D60ED1219EULL},
+      {0x93E1AB8252F33B45ULL, 0xCABB90E5C942B503ULL}, {0xB8DA1662E7B00A17ULL, 0x3D6A751F3B936243ULL},
+      {0xE7109BFBA19C0C9DULL, 0x0CC512670A783AD4ULL}, {0x906A617D450187E2ULL, 0x27FB2B80668B24C5ULL},
+      {0xB484F9DC9641E9DAULL, 0xB1F9F660802DEDF6ULL}, {0xE1A63853BBD26451ULL, 0x5E7873F8A0396973ULL},
+      {0x8D07E33455637EB2ULL, 0xDB0B487B6423E1E8ULL}, {0xB049DC016ABC5E5FULL, 0x91CE1A9A3D2CDA62ULL},
+      {0xDC5C5301C56B75F7ULL, 0x7641A140CC7810FBULL}, {0x89B9B3E11B6329BAULL, 0xA9E904C87FCB0A9DULL},
+      {0xAC2820D9623BF429ULL, 0x546345FA9FBDCD44ULL}, {0xD732290FBACAF133ULL, 0xA97C177947AD4095ULL},
+      {0x867F59A9D4BED6C0ULL, 0x49ED8EABCCCC485DULL}, {0xA81F301449EE8C70ULL, 0x5C68F256BFFF5A74ULL},
+      {0xD226FC195C6A2F8CULL, 0x73832EEC6FFF3111ULL}, {0x83585D8FD9C25DB7ULL, 0xC831FD53C5FF7EABULL},
+      {0xA42E74F3D032F525ULL, 0xBA3E7CA8B77F5E55ULL}, {0xCD3A1230C43FB26FULL, 0x28CE1BD2E55F35EBULL},
+      {0x80444B5E7AA7CF85ULL, 0x7980D163CF5B81B3ULL}, {0xA0555E361951C366ULL, 0xD7E105BCC332621FULL},
+      {0xC86AB5C39FA63440ULL, 0x8DD9472BF3FEFAA7ULL}, {0xFA856334878FC150ULL, 0xB14F98F6F0FEB951ULL},
+      {0x9C935E00D4B9D8D2ULL, 0x6ED1BF9A569F33D3ULL}, {0xC3B8358109E84F07ULL, 0x0A862F80EC4700C8ULL},
+      {0xF4A642E14C6262C8ULL, 0xCD27BB612758C0FAULL}, {0x98E7E9CCCFBD7DBDULL, 0x8038D51CB897789CULL},
+      {0xBF21E44003ACDD2CULL, 0xE0470A63E6BD56C3ULL}, {0xEEEA5D5004981478ULL, 0x1858CCFCE06CAC74ULL},
+      {0x95527A5202DF0CCBULL, 0x0F37801E0C43EBC8ULL}, {0xBAA718E68396CFFDULL, 0xD30560258F54E6BAULL},
+      {0xE950DF20247C83FDULL, 0x47C6B82EF32A2069ULL}, {0x91D28B7416CDD27EULL, 0x4CDC331D57FA5441ULL},
+      {0xB6472E511C81471DULL, 0xE0133FE4ADF8E952ULL}, {0xE3D8F9E563A198E5ULL, 0x58180FDDD97723A6ULL},
+      {0x8E679C2F5E44FF8FULL, 0x570F09EAA7EA7648ULL},
+  };
+  // clang-format on
+  uint64_t hi, lo, hi2, lo2, mant;
+  int64_t power2;
+  uint32_t lz, upperbit, shift;
+  if (!w || q < -342)
+    return 0;
+  if (q > 308)
+    return FIO_MATH_DBL_EXPO_MASK; /* Infinity */
+  lz = 63 - (uint32_t)fio_msb_index_unsafe(w);
+  w <<= lz;
+  lo = fio_math_mulc64(w, pow5[q + 342][0], &hi);
+  if ((hi & 0x1FF) == 0x1FF) { /* the lower bits might carry */
+    lo2 = fio_math_mulc64(w, pow5[q + 342][1], &hi2);
+    (void)lo2; /* only the high word is used */
+    lo += hi2;
+    hi += (lo < hi2);
+  }
+  if (lo == ~(uint64_t)0 && (q < -27 || q > 55))
+    *exact = 0;
+  upperbit = (uint32_t)(hi >> 63);
+  shift = upperbit + 9;
+  mant = hi >> shift;
+  /* floor(log2(10^q)) + 63 + (bias) (arithmetic shift rounds down) */
+  power2 = ((((152170 + 65536) * q) >> 16) + 63) + upperbit - lz + 1023;
+  if (power2 <= 0) { /* subnormal */
+    if (-power2 + 1 >= 64)
+      return 0;
+    mant >>= -power2 + 1;
+    mant += (mant & 1);
+    mant >>= 1;
+    /* rounding up might produce the smallest normal number (same bits) */
+    return mant;
+  }
+  /* round ties to even when the product is exact */
+  if (lo <= 1 && q >= -4 && q <= 23 && (mant & 3) == 1 &&
+      (mant << shift) == hi)
+    mant &= ~(uint64_t)1;
+  mant += (mant & 1);
+  mant >>= 1;
+  if (mant >= ((uint64_t)2 << 52)) {
+    mant = (uint64_t)1 << 52;
+    ++power2;
+  }
+  if (power2 >= 0x7FF)
+    return FIO_MATH_DBL_EXPO_MASK; /* Infinity */
+  return ((uint64_t)power2 << 52) | (mant & FIO_MATH_DBL_MANT_MASK);
+}
+
+/** A big unsigned number for the exact (slow) path (little endian words). */
+typedef struct {
+  uint64_t w[FIO___ATON10_BIG_WORDS];
+  size_t len;
+} fio___aton10_big_s;
+
+FIO_SFUNC void fio___aton10_big_mul_add(fio___aton10_big_s *b,
+                                        uint64_t mul,
+                                        uint64_t add) {
+  for (size_t i = 0; i < b->len; ++i) {
+    uint64_t hi, lo = fio_math_mulc64(b->w[i], mul, &hi);
+    lo += add;
+    add = hi + (lo < add);
+    b->w[i] = lo;
+  }
+  if (add && b->len < FIO___ATON10_BIG_WORDS)
+    b->w[b->len++] = add;
+}
+
+FIO_SFUNC void fio___aton10_big_mul_pow5(fio___aton10_big_s *b, size_t e) {
+  static const uint64_t pow5[] = {
+      1ULL,
+      5ULL,
+      25ULL,
+      125ULL,
+      625ULL,
+      3125ULL,
+      15625ULL,
+      78125ULL,
+      390625ULL,
+      1953125ULL,
+      9765625ULL,
+      48828125ULL,
+      244140625ULL,
+      1220703125ULL,
+      6103515625ULL,
+      30517578125ULL,
+      152587890625ULL,
+      762939453125ULL,
+      3814697265625ULL,
+      19073486328125ULL,
+      95367431640625ULL,
+      476837158203125ULL,
+      2384185791015625ULL,
+      11920928955078125ULL,
+      59604644775390625ULL,
+      298023223876953125ULL,
+      1490116119384765625ULL,
+      7450580596923828125ULL,
+  };
+  for (; e > 27; e -= 27)
+    fio___aton10_big_mul_add(b, pow5[27], 0);
+  fio___aton10_big_mul_add(b, pow5[e], 0);
+}
+
+FIO_SFUNC void fio___aton10_big_shl(fio___aton10_big_s *b, size_t bits) {
+  const size_t words = bits >> 6;
+  bits &= 63;
+  if (!b->len)
+    return;
+  if (b->len + words + 1 > FIO___ATON10_BIG_WORDS)
+    return; /* never happens for numbers within the range of a double */
+  if (bits) {
+    b->w[b->len] = 0;
+    for (size_t i = b->len; i; --i)
+      b->w[i] = (b->w[i] << bits) | (b->w[i - 1] >> (64 - bits));
+    b->w[0] <<= bits;
+    b->len += (b->w[b->len] != 0);
+  }
+  if (words) {
+    for (size_t i = b->len; i--;)
+      b->w[i + words] = b->w[i];
+    FIO_MEMSET(b->w, 0, words * sizeof(b->w[0]));
+    b->len += words;
+  }
+}
+
+FIO_SFUNC int fio___aton10_big_cmp(fio___aton10_big_s *a,
+                                   fio___aton10_big_s *b) {
+  if (a->len != b->len)
+    return (a->len > b->len) ? 1 : -1;
+  for (size_t i = a->len; i--;) {
+    if (a->w[i] != b->w[i])
+      return (a->w[i] > b->w[i]) ? 1 : -1;
+  }
+  return 0;
+}
+
+/**
+ * Compares the decimal `digits * 10^e10` with the halfway point between the
+ * (positive) double `bits` and the next double up.
+ */
+FIO_SFUNC int fio___aton10_cmp_halfway(const fio___aton10_big_s *digits,
+                                       int64_t e10,
+                                       int sticky,
+                                       uint64_t bits) {
+  fio___aton10_big_s lhs = *digits, rhs;
+  const uint64_t expo = (bits & FIO_MATH_DBL_EXPO_MASK) >> 52;
+  uint64_t mant = bits & FIO_MATH_DBL_MANT_MASK;
+  int64_t e2 = (expo ? (int64_t)expo : 1) - 1075 - 1, lhs2 = 0;
+  int r;
+  mant |= (uint64_t)(expo != 0) << 52;
+  rhs.w[0] = (mant << 1) | 1;
+  rhs.len = 1;
+  if (e10 >= 0) {
+    fio___aton10_big_mul_pow5(&lhs, (size_t)e10);
+    lhs2 = e10;
+  } else { /* d / 10^k vs. h * 2^e2  <=> d vs. h * 5^k * 2^(e2 + k) */
+    fio___aton10_big_mul_pow5(&rhs, (size_t)(0 - e10));
+    e2 -= e10;
+  }
+  if (lhs2 > e2)
+    fio___aton10_big_shl(&lhs, (size_t)(lhs2 - e2));
+  else
+    fio___aton10_big_shl(&rhs, (size_t)(e2 - lhs2));
+  r = fio___aton10_big_cmp(&lhs, &rhs);
+  return r ? r : sticky;
+}
+
+/**
+ * The exact (slow) path: corrects `bits` (at most a few ULPs off) by comparing
+ * the decimal number in `[start, end)` (digits, `.` and `_`) multiplied by
+ * `10^e10` with the halfway points between neighboring doubles.
+ */
+FIO_SFUNC FIO___ASAN_AVOID uint64_t fio___aton10_exact(uint64_t bits,
+                                                       const char *start,
+                                                       const char *end,
+                                                       int64_t e10) {
+  fio___aton10_big_s d = {.len = 0};
+  uint64_t chunk = 0, chunk_mul = 1;
+  size_t taken = 0;
+  int sticky = 0, after_dot = 0;
+  for (; start < end; ++start) {
+    const uint64_t c = (uint64_t)(uint8_t)(start[0] - '0');
+    if (c > 9) {
+      after_dot |= (start[0] == '.');
+      continue;
+    }
+    if (taken == FIO___ATON10_MAX_DIGITS) {
+      sticky |= (c != 0);
+      e10 += !after_dot;
+      continue;
+    }
+    e10 -= after_dot;
+    if (!taken && !c)
+      continue; /* leading zero */
+    ++taken;
+    chunk = (chunk * 10) + c;
+    chunk_mul *= 10;
+    if (chunk_mul == 10000000000000000000ULL) {
+      fio___aton10_big_mul_add(&d, chunk_mul, chunk);
+      chunk = 0;
+      chunk_mul = 1;
+    }
+  }
+  if (chunk_mul > 1)
+    fio___aton10_big_mul_add(&d, chunk_mul, chunk);
+  if (!d.len)
+    return 0;
+  /* move up while the number is above the halfway point */
+  while (bits < FIO_MATH_DBL_EXPO_MASK) {
+    int r = fio___aton10_cmp_halfway(&d, e10, sticky, bits);
+    if (r < 0 || (!r && !(bits & 1)))
+      break;
+    ++bits;
+  }
+  /* move down while the number is below the halfway point */
+  while (bits) {
+    int r = fio___aton10_cmp_halfway(&d, e10, sticky, bits - 1);
+    if (r > 0 || (!r && !(bits & 1)))
+      break;
+    --bits;
+  }
+  return bits;
+}
+
+/**
+ * Reads an unsigned base 10 number (no sign, no prefix) into `r`, returning the
+ * first byte after the number (or `p` if no digits were found).
+ *
+ * Unless `force_float` is set, numbers without a fraction or an exponent that
+ * fit in 63 bits are returned as integers.
+ */
+FIO_SFUNC FIO___ASAN_AVOID char *fio___aton10(fio_aton_s *r,
+                                              char *p,
+                                              int force_float) {
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+  static const double pow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                 1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                 1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                 1e18, 1e19, 1e20, 1e21, 1e22};
+#endif
+  char *const start = p;
+  char *mant_end;
+  uint64_t w = 0, bits;
+  int64_t e10 = 0, expo = 0;
+  size_t count = 0;
+  int exact = 1, truncated = 0;
+  r->is_float = force_float;
+
+  /* read digits, 8 at a time when possible */
+  while (FIO___ATON10_CAN_READ8(p) &&
+         fio___aton10_is8digits(fio_buf2u64_le(p))) {
+    w = (w * 100000000ULL) + fio___aton10_8digits(fio_buf2u64_le(p));
+    p += 8;
+    count += 8;
+  }
+  for (;;) {
+    const uint64_t c = (uint64_t)(uint8_t)(p[0] - '0');
+    if (c < 10) {
+      w = (w * 10) + c;
+      ++count;
+      ++p;
+      continue;
+    }
+#if FIO_ATOL_ALLOW_UNDERSCORE_DIVIDER
+    if (p[0] == '_' && count && (uint8_t)(p[1] - '0') < 10) {
+      ++p;
+      continue;
+    }
+#endif
+    break;
+  }
+  if (p[0] == '.') {
+    char *const frac = ++p;
+    r->is_float = 1;
+    while (FIO___ATON10_CAN_READ8(p) &&
+           fio___aton10_is8digits(fio_buf2u64_le(p))) {
+      w = (w * 100000000ULL) + fio___aton10_8digits(fio_buf2u64_le(p));
+      p += 8;
+    }
+    while ((uint8_t)(p[0] - '0') < 10) {
+      w = (w * 10) + (uint64_t)(uint8_t)(p[0] - '0');
+      ++p;
+    }
+    e10 = frac - p;
+    count += (size_t)(p - frac);
+  }
+  if (!count)
+    return start;
+  mant_end = p;
+  if ((p[0] | 32) == 'e') {
+    char *e = p + 1;
+    const int neg = (e[0] == '-');
+    e += (neg | (e[0] == '+'));
+    if ((uint8_t)(e[0] - '0') < 10) {
+      r->is_float = 1;
+      while ((uint8_t)(e[0] - '0') < 10) {
+        if (expo < 0x10000000)
+          expo = (expo * 10) + (e[0] - '0');
+        ++e;
+      }
+      if (neg)
+        expo = 0 - expo;
+      p = e;
+    }
+  }
+  e10 += expo;
+
+  if (count > 19) { /* re-read the first 19 significant digits */
+    size_t taken = 0;
+    int after_dot = 0;
+    w = 0;
+    e10 = expo;
+    for (char *pos = start; pos < mant_end; ++pos) {
+      const uint64_t c = (uint64_t)(uint8_t)(pos[0] - '0');
+      if (c > 9) {
+        after_dot |= (pos[0] == '.');
+        continue;
+      }
+      if (taken == 19) {
+        truncated |= (c != 0);
+        e10 += !after_dot;
+        continue;
+      }
+      e10 -= after_dot;
+      if (!taken && !c)
+        continue; /* leading zero */
+      w = (w * 10) + c;
+      ++taken;
+    }
+  }
+
+  if (!r->is_float && !truncated && !e10 && !(w >> 63)) {
+    r->u = w;
+    return p;
+  }
+  r->is_float = 1;
+
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+  /* Clinger's fast path: both the mantissa and 10^e10 are exact doubles */
+  if (!truncated && w <= ((uint64_t)1 << 53) && e10 >= -22 && e10 <= 22) {
+    r->f = (double)w;
+    r->f = (e10 < 0) ? (r->f / pow10[0 - e10]) : (r->f * pow10[e10]);
+    return p;
+  }
+#endif
+  bits = fio___aton10_eisel_lemire(w, e10, &exact);
+  if (truncated && exact) /* the digits are between w and w + 1 */
+    exact = (bits == fio___aton10_eisel_lemire(w + 1, e10, &exact));
+  if (!exact)
+    bits = fio___aton10_exact(bits, start, mant_end, expo);
+  r->u = bits;
+  return p;
+}
+
 /* *****************************************************************************
 fio_atof
 ***************************************************************************** */
@@ -6093,8 +6905,24 @@ fio_atof
 SFUNC double fio_atof(char **pstr) {
   if (!pstr || !(*pstr))
     return 0;
-  if ((*pstr)[0] == 'b' || ((*pstr)[1] == '0' && (*pstr)[1] == 'b'))
+  if ((*pstr)[0] == 'b' || ((*pstr)[0] == '0' && (*pstr)[1] == 'b'))
     goto binary_raw;
+  {
+    char *p = *pstr;
+    const uint64_t neg = (p[0] == '-');
+    p += (neg | (p[0] == '+'));
+    /* base 10 (not hex floats, infinity or NaN, which are left to strtod) */
+    if (((uint8_t)(p[0] - '0') < 10 || p[0] == '.') &&
+        !(p[0] == '0' && (p[1] | 32) == 'x')) {
+      fio_aton_s r;
+      char *end = fio___aton10(&r, p, 1);
+      if (end != p) {
+        *pstr = end;
+        r.u |= neg << 63;
+        return r.f;
+      }
+    }
+  }
   return strtod(*pstr, pstr);
 binary_raw:
   /* binary representation is assumed to spell an exact double */
@@ -6107,6 +6935,504 @@ binary_raw:
   return punned.d;
 }
 
+/* *****************************************************************************
+fio_ftoa - shortest round-trip representation (the Ryu algorithm)
+
+Computes the shortest decimal (`mant * 10^exp`) that reads back as the exact
+same double, based on "Ryu: fast float-to-string conversion" (Ulf Adams,
+PLDI 2018). No libc `printf` machinery is used, so output is locale neutral.
+***************************************************************************** */
+
+/** The result of fio___ftoa_shortest: the double equals `mant * 10^exp`. */
+typedef struct {
+  uint64_t mant;
+  int32_t exp;
+} fio___ftoa_decimal_s;
+
+/* floor(log2(5^e)) + 1 (for 0 <= e <= 3528) */
+FIO_IFUNC int32_t fio___ftoa_pow5bits(int32_t e) {
+  return (int32_t)(((uint32_t)e * 1217359U) >> 19) + 1;
+}
+/* floor(log10(2^e)) (for 0 <= e <= 1650) */
+FIO_IFUNC uint32_t fio___ftoa_log10pow2(int32_t e) {
+  return ((uint32_t)e * 78913U) >> 18;
+}
+/* floor(log10(5^e)) (for 0 <= e <= 2620) */
+FIO_IFUNC uint32_t fio___ftoa_log10pow5(int32_t e) {
+  return ((uint32_t)e * 732923U) >> 20;
+}
+/* tests if `5^p` divides `value` */
+FIO_IFUNC int fio___ftoa_is_pow5_multiple(uint64_t value, uint32_t p) {
+  uint32_t count = 0;
+  while (value && !(value % 5)) {
+    value /= 5;
+    ++count;
+  }
+  return count >= p;
+}
+/* tests if `2^p` divides `value` (p < 64) */
+FIO_IFUNC int fio___ftoa_is_pow2_multiple(uint64_t value, uint32_t p) {
+  return !(value & ((1ULL << p) - 1));
+}
+/* returns `(m * mul) >> j`, where `mul` is a 128 bit number and j >= 64 */
+FIO_IFUNC uint64_t fio___ftoa_mul_shift(uint64_t m,
+                                        const uint64_t *mul,
+                                        int32_t j) {
+  uint64_t high0, high1, low1, sum;
+  low1 = fio_math_mulc64(m, mul[0], &high0); /* low word discarded */
+  low1 = fio_math_mulc64(m, mul[1], &high1);
+  sum = high0 + low1;
+  high1 += (sum < high0);
+  j -= 64;
+  if (!j)
+    return sum;
+  return (high1 << (64 - j)) | (sum >> j);
+}
+
+FIO_SFUNC fio___ftoa_decimal_s fio___ftoa_shortest(uint64_t ieee_mant,
+                                                   uint32_t ieee_exp) {
+  /* 5^q / 2^k and 2^k / 5^q (rounded up), normalized to 125 bits. */
+  // clang-format off
+  static const uint64_t pow5_inv[342][2] = {
+      {0x0000000000000001ULL, 0x2000000000000000ULL}, {0x999999999999999AULL, 0x1999999999999999ULL},
+      {0x47AE147AE147AE15ULL, 0x147AE147AE147AE1ULL}, {0x6C8B4395810624DEULL, 0x10624DD2F1A9FBE7ULL},
+      {0x7A786C226809D496ULL, 0x1A36E2EB1C432CA5ULL}, {0x61F9F01B866E43ABULL, 0x14F8B588E368F084ULL},
+      {0xB4C7F34938583622ULL, 0x10C6F7A0B5ED8D36ULL}, {0x87A6520EC08D236AULL, 0x1AD7F29ABCAF4857ULL},
+      {0x9FB841A566D74F88ULL, 0x15798EE2308C39DFULL}, {0xE62D01511F12A607ULL, 0x112E0BE826D694B2ULL},
+      {0xD6AE6881CB5109A4ULL, 0x1B7CDFD9D7BDBAB7ULL}, {0xDEF1ED34A2A73AEAULL, 0x15FD7FE17964955FULL},
+      {0x7F27F0F6E885C8BBULL, 0x119799812DEA1119ULL}, {0x650CB4BE40D60DF8ULL, 0x1C25C268497681C2ULL},
+      {0xEA70909833DE7193ULL, 0x16849B86A12B9B01ULL}, {0x21F3A6E0297EC143ULL, 0x1203AF9EE756159BULL},
+      {0x6985D7CD0F313537ULL, 0x1CD2B297D889BC2BULL}, {0x2137DFD73F5A90F9ULL, 0x170EF54646D49689ULL},
+      {0xE75FE645CC4873FAULL, 0x12725DD1D243ABA0ULL}, {0xA5663D3C7A0D865DULL, 0x1D83C94FB6D2AC34ULL},
+      {0x511E976394D79EB1ULL, 0x179CA10C9242235DULL}, {0xDA7EDF82DD794BC1ULL, 0x12E3B40A0E9B4F7DULL},
+      {0x2A6498D1625BAC68ULL, 0x1E392010175EE596ULL}, {0xEEB6E0A781E2F053ULL, 0x182DB34012B25144ULL},
+      {0x58924D52CE4F26A9ULL, 0x1357C299A88EA76AULL}, {0x27507BB7B07EA441ULL, 0x1EF2D0F5DA7DD8AAULL},
+      {0x52A6C95FC0655034ULL, 0x18C240C4AECB13BBULL}, {0x0EEBD44C99EAA690ULL, 0x13CE9A36F23C0FC9ULL},
+      {0xB17953ADC3110A80ULL, 0x1FB0F6BE50601941ULL}, {0xC12DDC8B02740867ULL, 0x195A5EFEA6B34767ULL},
+      {0x3424B06F3529A052ULL, 0x14484BFEEBC29F86ULL}, {0x901D59F290EE19DBULL, 0x1039D66589687F9EULL},
+      {0x4CFBC31DB4B0295FULL, 0x19F623D5A8A73297ULL}, {0x3D9635B15D59BAB2ULL, 0x14C4E977BA1F5BACULL},
+      {0x97AB5E277DE16228ULL, 0x109D8792FB4C4956ULL}, {0xF2ABC9D8C9689D0DULL, 0x1A95A5B7F87A0EF0ULL},
+      {0x5BBCA17A3ABA173EULL, 0x154484932D2E725AULL}, {0xAFCA1AC82EFB45CBULL, 0x11039D428A8B8EAEULL},
+      {0xB2DCF7A6B1920945ULL, 0x1B38FB9DAA78E44AULL}, {0xF57D92EBC141A104ULL, 0x15C72FB1552D836EULL},
+      {0xC46475896767B403ULL, 0x116C262777579C58ULL}, {0x6D6D88DBD8A5ECD2ULL, 0x1BE03D0BF225C6F4ULL},
+      {0x8ABE071646EB23DBULL, 0x164CFDA3281E38C3ULL}, {0x6EFE6C11D255B649ULL, 0x11D7314F534B609CULL},
+      {0xB197134FB6EF8A0EULL, 0x1C8B821885456760ULL}, {0x27AC0F72F8BFA1A5ULL, 0x16D601AD376AB91AULL},
+      {0xB95672C260994E1EULL, 0x1244CE242C5560E1ULL}, {0xF5571E03CDC21695ULL, 0x1D3AE36D13BBCE35ULL},
+      {0x2AAC18030B01ABABULL, 0x17624F8A762FD82BULL}, {0xBBBCE0026F348956ULL, 0x12B50C6EC4F31355ULL},
+      {0x92C7CCD0B1EDA889ULL, 0x1DEE7A4AD4B81EEFULL}, {0xDBD30A408E57BA07ULL, 0x17F1FB6F10934BF2ULL},
+      {0x7CA8D50071DFC806ULL, 0x1327FC58DA0F6FF5ULL}, {0xFAA7BB33E9660CD6ULL, 0x1EA6608E29B24CBBULL},
+      {0x9552FC298784D711ULL, 0x18851A0B548EA3C9ULL}, {0xAAA8C9BAD2D0AC0EULL, 0x139DAE6F76D88307ULL},
+      {0xDDDADC5E1E1AACE3ULL, 0x1F62B0B257C0D1A5ULL}, {0x7E48B04B4B488A4FULL, 0x191BC08EAC9A4151ULL},
+      {0xCB6D59D5D5D3A1D9ULL, 0x141633A556E1CDDAULL}, {0x3C577B1177DC817BULL, 0x1011C2EAABE7D7E2ULL},
+      {0xC6F25E825960CF2AULL, 0x19B604AAACA62636ULL}, {0x6BF518684780A5BBULL, 0x14919D5556EB51C5ULL},
+      {0x232A79ED06008496ULL, 0x10747DDDDF22A7D1ULL}, {0xD1DD8FE1A3340756ULL, 0x1A53FC9631D10C81ULL},
+      {0xA7E4731AE8F66C45ULL, 0x150FFD44F4A73D34ULL}, {0x531D28E253F8569EULL, 0x10D9976A5D52975DULL},
+      {0xEB61DB03B98D5762ULL, 0x1AF5BF109550F22EULL}, {0xBC4E48CFC7A445E8ULL, 0x159165A6DDDA5B58ULL},
+      {0x6371D3D96C836B20ULL, 0x11411E1F17E1E2ADULL}, {0x9F1C8628AD9F11CDULL, 0x1B9B6364F3030448ULL},
+      {0xE5B06B53BE18DB0BULL, 0x1615E91D8F359D06ULL}, {0xEAF3890FCB4715A2ULL, 0x11AB20E472914A6BULL},
+      {0x44B8DB4C7871BC37ULL, 0x1C45016D841BAA46ULL}, {0x03C715D6C6C1635FULL, 0x169D9ABE03495505ULL},
+      {0x3638DE456BCDE919ULL, 0x1217AEFE69077737ULL}, {0x56C163A2461641C1ULL, 0x1CF2B1970E725858ULL},
+      {0xDF011C81D1AB67CEULL, 0x17288E1271F51379ULL}, {0x7F3416CE4155ECA5ULL, 0x1286D80EC190DC61ULL},
+      {0x6520247D3556476EULL, 0x1DA48CE468E7C702ULL}, {0xEA801D30F7783925ULL, 0x17B6D71D20B96C01ULL},
+      {0xBB99B0F3F92CFA84ULL, 0x12F8AC174D612334ULL}, {0x5F5C4E532847F739ULL, 0x1E5AACF215683854ULL},
+      {0x7F7D0B75B9D32C2EULL, 0x18488A5B44536043ULL}, {0x9930D5F7C7DC2358ULL, 0x136D3B7C36A919CFULL},
+      {0x8EB4898C72F9D226ULL, 0x1F152BF9F10E8FB2ULL}, {0x722A07A38F2E41B8ULL, 0x18DDBCC7F40BA628ULL},
+      {0xC1BB394FA5BE9AFAULL, 0x13E497065CD61E86ULL}, {0x9C5EC2190930F7F6ULL, 0x1FD424D6FAF030D7ULL},
+      {0x49E56814075A5FF8ULL, 0x197683DF2F268D79ULL}, {0x6E51201005E1E660ULL, 0x145ECFE5BF520AC7ULL},
+      {0xF1DA800CD181851AULL, 0x104BD984990E6F05ULL}, {0x4FC400148268D4F5ULL, 0x1A12F5A0F4E3E4D6ULL},
+      {0xD96999AA01ED772BULL, 0x14DBF7B3F71CB711ULL}, {0xADEE1488018AC5BCULL, 0x10AFF95CC5B09274ULL},
+      {0x497CEDA668DE092CULL, 0x1AB328946F80EA54ULL}, {0x3ACA57B853E4D424ULL, 0x155C2076BF9A5510ULL},
+      {0x623B7960431D7683ULL, 0x1116805EFFAEAA73ULL}, {0x9D2BF566D1C8BD9EULL, 0x1B5733CB32B110B8ULL},
+      {0x7DBCC452416D647FULL, 0x15DF5CA28EF40D60ULL}, {0xCAFD69DB678AB6CCULL, 0x117F7D4ED8C33DE6ULL},
+      {0xAB2F0FC572778ADFULL, 0x1BFF2EE48E052FD7ULL}, {0x88F273045B92D580ULL, 0x1665BF1D3E6A8CACULL},
+      {0xD3F528D049424466ULL, 0x11EAFF4A98553D56ULL}, {0xB988414D4203A0A3ULL, 0x1CAB3210F3BB9557ULL},
+      {0x6139CDD76802E6E9ULL, 0x16EF5B40C2FC7779ULL}, {0xE761717920025254ULL, 0x125915CD68C9F92DULL},
+      {0xA568B58E999D5086ULL, 0x1D5B561574765B7CULL}, {0x5120913EE14AA6D2ULL, 0x177C44DDF6C515FDULL},
+      {0xA74D40FF1AA21F0EULL, 0x12C9D0B1923744CAULL}, {0x0BAECE64F769CB4AULL, 0x1E0FB44F50586E11ULL},
+      {0x3C8BD850C5EE3C3BULL, 0x180C903F7379F1A7ULL}, {0xCA0979DA37F1C9C9ULL, 0x133D4032C2C7F485ULL},
+      {0xA9A8C2F6BFE942DBULL, 0x1EC866B79E0CBA6FULL}, {0x2153CF2BCCBA9BE3ULL, 0x18A0522C7E709526ULL},
+      {0x1AA9728970954982ULL, 0x13B374F06526DDB8ULL}, {0xF775840F1A88759DULL, 0x1F8587E7083E2F8CULL},
+      {0x5F9136727BA05E17ULL, 0x19379FEC0698260AULL}, {0x1940F85B9619E4DFULL, 0x142C7FF0054684D5ULL},
+      {0xE100C6AFAB47EA4CULL, 0x1023998CD1053710ULL}, {0xCE67A44C453FDD47ULL, 0x19D28F47B4D524E7ULL},
+      {0xD852E9D69DCCB106ULL, 0x14A8729FC3DDB71FULL}, {0x79DBEE454B0A2738ULL, 0x1086C219697E2C19ULL},
+      {0x295FE3A211A9D859ULL, 0x1A71368F0F30468FULL}, {0xBAB31C81A7BB137AULL, 0x15275ED8D8F36BA5ULL},
+      {0x6228E39AEC95A92FULL, 0x10EC4BE0AD8F8951ULL}, {0x9D0E38F7E0EF7517ULL, 0x1B13AC9AAF4C0EE8ULL},
+      {0xB0D82D931A592A79ULL, 0x15A956E225D67253ULL}, {0x8D79BE0F4847552EULL, 0x11544581B7DEC1DCULL},
+      {0x158F967EDA0BBB7CULL, 0x1BBA08CF8C979C94ULL}, {0x77A611FF14D62F97ULL, 0x162E6D72D6DFB076ULL},
+      {0xF951A7FF43DE8C79ULL, 0x11BEBDF578B2F391ULL}, {0xC21C3FFED2FDAD8EULL, 0x1C6463225AB7EC1CULL},
+      {0x01B0333242648AD8ULL, 0x16B6B5B5155FF017ULL}, {0x0159C28E9B83A246ULL, 0x122BC490DDE659ACULL},
+      {0xCEF604175F3903A3ULL, 0x1D12D41AFCA3C2ACULL}, {0x725E69AC4C2D9C83ULL, 0x17424348CA1C9BBDULL},
+      {0xF5185489D68AE39CULL, 0x129B69070816E2FDULL}, {0xEE8D540FBDAB05C6ULL, 0x1DC574D80CF16B2FULL},
+      {0xBED77672FE226B05ULL, 0x17D12A4670C1228CULL}, {0xFF12C528CB4EBC04ULL, 0x130DBB6B8D674ED6ULL},
+      {0xCB513B74787DF9A0ULL, 0x1E7C5F127BD87E24ULL}, {0x090DC929F9FE614DULL, 0x18637F41FCAD31B7ULL},
+      {0xA0D7D42194CB810AULL, 0x1382CC34CA2427C5ULL}, {0x67BFB9CF5478CE77ULL, 0x1F37AD21436D0C6FULL},
+      {0x1FCC94A5DD2D71F9ULL, 0x18F9574DCF8A7059ULL}, {0x7FD6DD517DBDF4C7ULL, 0x13FAAC3E3FA1F37AULL},
+      {0xFFBE2EE8C92FEE0BULL, 0x1FF779FD329CB8C3ULL}, {0x6631BF20A0F324D6ULL, 0x1992C7FDC216FA36ULL},
+      {0xB827CC1A1A5C1D78ULL, 0x14756CCB01ABFB5EULL}, {0x935309AE7B7CE460ULL, 0x105DF0A267BCC918ULL},
+      {0x1EEB42B0C594A099ULL, 0x1A2FE76A3F9474F4ULL}, {0xE58902270476E6E1ULL, 0x14F31F8832DD2A5CULL},
+      {0xB7A0CE859D2BEBE7ULL, 0x10C27FA028B0EEB0ULL}, {0x59014A6F61DFDFD8ULL, 0x1AD0CC33744E4AB4ULL},
+      {0xE0CDD525E7E64CADULL, 0x1573D68F903EA229ULL}, {0x4D7177518651D6F1ULL, 0x11297872D9CBB4EEULL},
+      {0x7BE8BEE8D6E957E8ULL, 0x1B758D848FAC54B0ULL}, {0xFCBA3253DF211320ULL, 0x15F7A46A0C89DD59ULL},
+      {0x63C8284318E74280ULL, 0x1192E9EE706E4AAEULL}, {0x060D0D3827D86A66ULL, 0x1C1E43171A4A1117ULL},
+      {0x6B3DA42CECAD21EBULL, 0x167E9C127B6E7412ULL}, {0x88FE1CF0BD574E56ULL, 0x11FEE341FC585CDBULL},
+      {0x419694B462254A23ULL, 0x1CCB0536608D615FULL}, {0x67ABAA29E81DD4E9ULL, 0x1708D0F84D3DE77FULL},
+      {0xB95621BB2017DD87ULL, 0x126D73F9D764B932ULL}, {0xC223692B668C95A5ULL, 0x1D7BECC2F23AC1EAULL},
+      {0xCE82BA891ED6DE1DULL, 0x179657025B6234BBULL}, {0xA53562074BDF1818ULL, 0x12DEAC01E2B4F6FCULL},
+      {0x3B889CD87964F359ULL, 0x1E3113363787F194ULL}, {0xFC6D4A46C783F5E1ULL, 0x18274291C6065ADCULL},
+      {0x30576E9F06032B1AULL, 0x13529BA7D19EAF17ULL}, {0x1A257DCB3CD1DE90ULL, 0x1EEA92A61C311825ULL},
+      {0x481DFE3C30A7E540ULL, 0x18BBA884E35A79B7ULL}, {0xD34B31C9C0865100ULL, 0x13C9539D82AEC7C5ULL},
+      {0x5211E942CDA3B4CDULL, 0x1FA885C8D117A609ULL}, {0x74DB21023E1C90A4ULL, 0x19539E3A40DFB807ULL},
+      {0xF715B401CB4A0D50ULL, 0x1442E4FB67196005ULL}, {0xF8DE299B09080AA7ULL, 0x103583FC527AB337ULL},
+      {0x8E304291A80CDDD7ULL, 0x19EF3993B72AB859ULL}, {0x3E8D020E200A4B13ULL, 0x14BF6142F8EEF9E1ULL},
+      {0x653D9B3E80083C0FULL, 0x10991A9BFA58C7E7ULL}, {0x6EC8F864000D2CE4ULL, 0x1A8E90F9908E0CA5ULL},
+      {0x8BD3F9E999A423EAULL, 0x153EDA614071A3B7ULL}, {0x3CA994BAE1501CBBULL, 0x10FF151A99F482F9ULL},
+      {0xC775BAC49BB3612BULL, 0x1B31BB5DC320D18EULL}, {0xD2C4956A16291A89ULL, 0x15C162B168E70E0BULL},
+      {0xDBD0778811BA7BA1ULL, 0x11678227871F3E6FULL}, {0x2C80BF401C5D929BULL, 0x1BD8D03F3E9863E6ULL},
+      {0xBD33CC3349E47549ULL, 0x16470CFF6546B651ULL}, {0xCA8FD68F6E505DD4ULL, 0x11D270CC51055EA7ULL},
+      {0x4419574BE3B3C953ULL, 0x1C83E7AD4E6EFDD9ULL}, {0x0347790982F63AA9ULL, 0x16CFEC8AA52597E1ULL},
+      {0xCF6C60D468C4FBBAULL, 0x123FF06EEA847980ULL}, {0xE57A34870E07F92AULL, 0x1D331A4B10D3F59AULL},
+      {0x512E906C0B399422ULL, 0x175C1508DA432AE2ULL}, {0xDA8BA6BCD5C7A9B5ULL, 0x12B010D3E1CF5581ULL},
+      {0x90DF712E22D90F87ULL, 0x1DE6815302E5559CULL}, {0xDA4C5A8B4F140C6CULL, 0x17EB9AA8CF1DDE16ULL},
+      {0xAEA37BA2A5A9A38AULL, 0x1322E220A5B17E78ULL}, {0x7DD25F6AA2A905A9ULL, 0x1E9E369AA2B59727ULL},
+      {0x97DB7F888220D154ULL, 0x187E92154EF7AC1FULL}, {0x797C6606CE80A777ULL, 0x139874DDD8C6234CULL},
+      {0x8F2D700AE4010BF1ULL, 0x1F5A549627A36BADULL}, {0x0C2459A25000D65AULL, 0x191510781FB5EFBEULL},
+      {0x701D1481D99A4515ULL, 0x1410D9F9B2F7F2FEULL}, {0xC017439B147B6A77ULL, 0x100D7B2E28C65BFEULL},
+      {0xCCF205C4ED9243F2ULL, 0x19AF2B7D0E0A2CCAULL}, {0x0A5B37D0BE0E9CC2ULL, 0x148C22CA71A1BD6FULL},
+      {0x0848F973CB3EE3CEULL, 0x10701BD527B4978CULL}, {0xDA0E5BEC78649FB0ULL, 0x1A4CF9550C5425ACULL},
+      {0x7B3EAFF060507FC0ULL, 0x150A6110D6A9B7BDULL}, {0x95CBBFF380406633ULL, 0x10D51A73DEEE2C97ULL},
+      {0xEFAC665266CD7052ULL, 0x1AEE90B964B04758ULL}, {0x2623850EB8A459DBULL, 0x158BA6FAB6F36C47ULL},
+      {0x1E82D0D893B6AE49ULL, 0x113C85955F29236CULL}, {0xFD9E1AF41F8AB075ULL, 0x1B9408EEFEA838ACULL},
+      {0x97B1AF29B2D559F7ULL, 0x16100725988693BDULL}, {0xAC8E25BAF5777B2CULL, 0x11A66C1E139EDC97ULL},
+      {0x7A7D092B2258C513ULL, 0x1C3D79C9B8FE2DBFULL}, {0x61FDA0EF4EAD6A76ULL, 0x169794A160CB57CCULL},
+      {0xE7FE1A590BBDEEC5ULL, 0x1212DD4DE7091309ULL}, {0xA6635D5B45FCB13AULL, 0x1CEAFBAFD80E84DCULL},
+      {0x851C4AAF6B308DC8ULL, 0x172262F3133ED0B0ULL}, {0xD0E36EF2BC26D7D4ULL, 0x1281E8C275CBDA26ULL},
+      {0xB49F17EAC6A48C86ULL, 0x1D9CA79D894629D7ULL}, {0x2A18DFEF0550706BULL, 0x17B08617A104EE46ULL},
+      {0x54E0B3259DD9F389ULL, 0x12F39E794D9D8B6BULL}, {0x87CDEB6F62F65274ULL, 0x1E5297287C2F4578ULL},
+      {0xD30B22BF825EA85DULL, 0x18421286C9BF6AC6ULL}, {0x0F3C1BCC684BB9E4ULL, 0x13680ED23AFF889FULL},
+      {0x18602C7A4079296DULL, 0x1F0CE4839198DA98ULL}, {0x46B356C833942124ULL, 0x18D71D360E13E213ULL},
+      {0x388F78A029434DB6ULL, 0x13DF4A91A4DCB4DCULL}, {0x5A7F2766A86BAF8AULL, 0x1FCBAA82A1612160ULL},
+      {0x153285EBB9EFBFA2ULL, 0x196FBB9BB44DB44DULL}, {0xAA8ED189618C994EULL, 0x145962E2F6A4903DULL},
+      {0xEED8A7A11AD6E10CULL, 0x1047824F2BB6D9CAULL}, {0x7E27729B5E249B45ULL, 0x1A0C03B1DF8AF611ULL},
+      {0xFE85F549181D4904ULL, 0x14D6695B193BF80DULL}, {0xCB9E5DD4134AA0D0ULL, 0x10AB877C142FF9A4ULL},
+      {0xDF63C9535211014DULL, 0x1AAC0BF9B9E65C3AULL}, {0x191CA10F74DA6771ULL, 0x15566FFAFB1EB02FULL},
+      {0xADB080D92A4852C1ULL, 0x1111F32F2F4BC025ULL}, {0x15E7348EAA0D5134ULL, 0x1B4FEB7EB212CD09ULL},
+      {0xAB1F5D3EEE710DC4ULL, 0x15D98932280F0A6DULL}, {0xBC1917658B8DA49DULL, 0x117AD428200C0857ULL},
+      {0x2CF4F23C127C3A94ULL, 0x1BF7B9D9CCE00D59ULL}, {0xF0C3F4FCDB969543ULL, 0x165FC7E170B33DE0ULL},
+      {0x5A365D9716121103ULL, 0x11E6398126F5CB1AULL}, {0x9056FC24F01CE804ULL, 0x1CA38F350B22DE90ULL},
+      {0xD9DF301D8CE3ECD0ULL, 0x16E93F5DA2824BA6ULL}, {0xE17F59B13D8323DAULL, 0x125432B14ECEA2EBULL},
+      {0x68CBC2B52F38395CULL, 0x1D53844EE47DD179ULL}, {0x53D6355DBF602DE3ULL, 0x177603725064A794ULL},
+      {0xA9782AB165E68B1CULL, 0x12C4CF8EA6B6EC76ULL}, {0x0F26AAB56FD744FAULL, 0x1E07B27DD78B13F1ULL},
+      {0x3F52222ABFDF6A62ULL, 0x18062864AC6F4327ULL}, {0x65DB4E88997F884EULL, 0x1338205089F29C1FULL},
+      {0x6FC54A7428CC0D4AULL, 0x1EC033B40FEA9365ULL}, {0x596AA1F68709A43BULL, 0x1899C2F673220F84ULL},
+      {0xADEEE7F86C07B696ULL, 0x13AE3591F5B4D936ULL}, {0x497E3FF3E00C5756ULL, 0x1F7D228322BAF524ULL},
+      {0xD464FFF64CD6AC45ULL, 0x1930E868E89590E9ULL}, {0x4383FFF83D7889D1ULL, 0x14272053ED4473EEULL},
+      {0xCF9CCCC69793A174ULL, 0x101F4D0FF1038FF1ULL}, {0x7F6147A425B90252ULL, 0x19CBAE7FE805B31CULL},
+      {0xCC4DD2E9B7C7350FULL, 0x14A2F1FFECD15C16ULL}, {0x3D0B0F215FD290D9ULL, 0x10825B3323DAB012ULL},
+      {0x61AB4B689950E7C1ULL, 0x1A6A2B85062AB350ULL}, {0x4E22A2BA1440B967ULL, 0x1521BC6A6B555C40ULL},
+      {0x0B4EE894DD009453ULL, 0x10E7C9EEBC4449CDULL}, {0x1217DA87C800ED51ULL, 0x1B0C764AC6D3A948ULL},
+      {0xDB46486CA000BDDAULL, 0x15A391D56BDC876CULL}, {0x490506BD4CCD64AFULL, 0x114FA7DDEFE39F8AULL},
+      {0xA8080AC87AE23AB1ULL, 0x1BB2A62FE638FF43ULL}, {0x5339A239FBE82EF4ULL, 0x162884F31E93FF69ULL},
+      {0x75C7B4FB2FECF25DULL, 0x11BA03F5B20FFF87ULL}, {0x22D92191E647EA2EULL, 0x1C5CD322B67FFF3FULL},
+      {0xB57A8141850654F2ULL, 0x16B0A8E891FFFF65ULL}, {0xC4620101373843F5ULL, 0x1226ED86DB3332B7ULL},
+      {0x3A366801F1F39FEEULL, 0x1D0B15A491EB8459ULL}, {0xFB5EB99B27F6198BULL, 0x173C115074BC69E0ULL},
+      {0x2F7EFAE2865E7AD6ULL, 0x129674405D6387E7ULL}, {0xE597F7D0D6FD9156ULL, 0x1DBD86CD6238D971ULL},
+      {0x8479930D78CADAABULL, 0x17CAD23DE82D7AC1ULL}, {0xD06142712D6F1556ULL, 0x1308A831868AC89AULL},
+      {0x4D686A4EAF182222ULL, 0x1E74404F3DAADA91ULL}, {0xA453883EF279B4E8ULL, 0x185D003F6488AEDAULL},
+      {0xE9DC6CFF28615D87ULL, 0x137D99CC506D58AEULL}, {0xA960AE650D6895A4ULL, 0x1F2F5C7A1A488DE4ULL},
+      {0xBAB3BEB73DED4483ULL, 0x18F2B061AEA07183ULL}, {0x2EF6322C318A9D36ULL, 0x13F559E7BEE6C136ULL},
+      {0xE4BD1D13827761F0ULL, 0x1FEEF63F97D79B89ULL}, {0x83CA7DA9352C4E5AULL, 0x198BF832DFDFAFA1ULL},
+      {0x9CA1FE20F756A515ULL, 0x146FF9C24CB2F2E7ULL}, {0x4A1B31B3F9121DAAULL, 0x1059949B708F28B9ULL},
+      {0x435EB5ECC1B695DDULL, 0x1A28EDC580E50DF5ULL}, {0x35E55E57015EDE4AULL, 0x14ED8B04671DA4C4ULL},
+      {0xC4B77EAC0118B1D5ULL, 0x10BE08D0527E1D69ULL}, {0xA12597799B5AB622ULL, 0x1AC9A7B3B7302F0FULL},
+      {0x4DB7AC6149155E81ULL, 0x156E1FC2F8F358D9ULL}, {0xD7C6238107444B9BULL, 0x1124E63593F5E0ADULL},
+      {0x593D059B3ED3AC2BULL, 0x1B6E3D2286563449ULL}, {0xE0FD9E15CBDC89BCULL, 0x15F1CA820511C36DULL},
+      {0xB3FE18116FE3A163ULL, 0x118E3B9B37416924ULL}, {0x866359B57FD29BD1ULL, 0x1C16C5C525357507ULL},
+      {0xD1E91491330EE30EULL, 0x16789E3750F790D2ULL}, {0x74BA76DA8F3F1C0BULL, 0x11FA182C40C60D75ULL},
+      {0xEDF72490E531C678ULL, 0x1CC359E067A348BBULL}, {0x8B2C1D40B75B052DULL, 0x1702AE4D1FB5D3C9ULL},
+      {0x6F567DCD5F7C0424ULL, 0x12688B70E62B0FD4ULL}, {0x7EF0C94898C66D06ULL, 0x1D74124E3D11B2EDULL},
+      {0x98C0A106E09EBD9FULL, 0x17900EA4FDA7C257ULL}, {0x470080D24D4BCAE6ULL, 0x12D9A550CAEC9B79ULL},
+      {0xD800CE1D487944A2ULL, 0x1E29088144ADC58EULL}, {0x1333D8176D2DD082ULL, 0x1820D39A9D57D13FULL},
+      {0xA8F646792424A6CEULL, 0x134D76154AACA765ULL}, {0x74BD3D8EA03AA47DULL, 0x1EE25688777AA56FULL},
+      {0x5D64313EE6955064ULL, 0x18B51206C5FBB78CULL}, {0x4AB68DCBEBAAA6B7ULL, 0x13C40E6BD1962C70ULL},
+      {0x1124161312AAA457ULL, 0x1FA01712E8F0471AULL}, {0xDA8344DC0EEEE9DFULL, 0x194CDF4253F36C14ULL},
+      {0xE2029D7CD8BF2180ULL, 0x143D7F6843292343ULL}, {0x4E687DFD7A328133ULL, 0x103132B9CF541C36ULL},
+      {0x4A40C9959050CEB8ULL, 0x19E851294BB9C6BDULL}, {0x0833D477A6A70BC6ULL, 0x14B9DA876FC7D231ULL},
+      {0xA02976C61EEC096BULL, 0x1094AED2BFD30E8DULL}, {0x004257A364ACDBDFULL, 0x1A877E1DFFB81749ULL},
+      {0xCD01DFB5EA23E319ULL, 0x153931B1996012A0ULL}, {0x70CE4C91881CB5AEULL, 0x10FA8E27ADE6754DULL},
+      {0x1AE3ADB5A69455E2ULL, 0x1B2A7D0C4970BBAFULL}, {0x7BE957C4854377E8ULL, 0x15BB973D078D62F2ULL},
+      {0xC987796A0435F987ULL, 0x1162DF64060AB58EULL}, {0x75A58F1006BCC271ULL, 0x1BD1656CD67788E4ULL},
+      {0xF7B7A5A66BCA3527ULL, 0x16411DF0AB92D3E9ULL}, {0x5FC61E1EBCA1C41FULL, 0x11CDB18D560F0FEEULL},
+      {0xFFA363646102D365ULL, 0x1C7C4F4889B1B316ULL}, {0x32E91C504D9BDC51ULL, 0x16C9D906D48E28DFULL},
+      {0x8F20E37371497D0EULL, 0x123B140576D820B2ULL}, {0x7E9B0585820F2E7CULL, 0x1D2B533BF159CDEAULL},
+      {0xCBAF379E01A5BECAULL, 0x1755DC2FF447D7EEULL}, {0x0958F94B348498A1ULL, 0x12AB168CC36CACBFULL},
+  };
+  static const uint64_t pow5[326][2] = {
+      {0x0000000000000000ULL, 0x1000000000000000ULL}, {0x0000000000000000ULL, 0x1400000000000000ULL},
+      {0x0000000000000000ULL, 0x1900000000000000ULL}, {0x0000000000000000ULL, 0x1F40000000000000ULL},
+      {0x0000000000000000ULL, 0x1388000000000000ULL}, {0x0000000000000000ULL, 0x186A000000000000ULL},
+      {0x0000000000000000ULL, 0x1E84800000000000ULL}, {0x0000000000000000ULL, 0x1312D00000000000ULL},
+      {0x0000000000000000ULL, 0x17D7840000000000ULL}, {0x0000000000000000ULL, 0x1DCD650000000000ULL},
+      {0x0000000000000000ULL, 0x12A05F2000000000ULL}, {0x0000000000000000ULL, 0x174876E800000000ULL},
+      {0x0000000000000000ULL, 0x1D1A94A200000000ULL}, {0x0000000000000000ULL, 0x12309CE540000000ULL},
+      {0x0000000000000000ULL, 0x16BCC41E90000000ULL}, {0x0000000000000000ULL, 0x1C6BF52634000000ULL},
+      {0x0000000000000000ULL, 0x11C37937E0800000ULL}, {0x0000000000000000ULL, 0x16345785D8A00000ULL},
+      {0x0000000000000000ULL, 0x1BC16D674EC80000ULL}, {0x0000000000000000ULL, 0x1158E460913D0000ULL},
+      {0x0000000000000000ULL, 0x15AF1D78B58C4000ULL}, {0x0000000000000000ULL, 0x1B1AE4D6E2EF5000ULL},
+      {0x0000000000000000ULL, 0x10F0CF064DD59200ULL}, {0x0000000000000000ULL, 0x152D02C7E14AF680ULL},
+      {0x0000000000000000ULL, 0x1A784379D99DB420ULL}, {0x0000000000000000ULL, 0x108B2A2C28029094ULL},
+      {0x0000000000000000ULL, 0x14ADF4B7320334B9ULL}, {0x4000000000000000ULL, 0x19D971E4FE8401E7ULL},
+      {0x8800000000000000ULL, 0x1027E72F1F128130ULL}, {0xAA00000000000000ULL, 0x1431E0FAE6D7217CULL},
+      {0xD480000000000000ULL, 0x193E5939A08CE9DBULL}, {0xC9A0000000000000ULL, 0x1F8DEF8808B02452ULL},
+      {0xBE04000000000000ULL, 0x13B8B5B5056E16B3ULL}, {0xAD85000000000000ULL, 0x18A6E32246C99C60ULL},
+      {0xD8E6400000000000ULL, 0x1ED09BEAD87C0378ULL}, {0x878FE80000000000ULL, 0x13426172C74D822BULL},
+      {0x6973E20000000000ULL, 0x1812F9CF7920E2B6ULL}, {0x03D0DA8000000000ULL, 0x1E17B84357691B64ULL},
+      {0x8262889000000000ULL, 0x12CED32A16A1B11EULL}, {0x22FB2AB400000000ULL, 0x178287F49C4A1D66ULL},
+      {0xABB9F56100000000ULL, 0x1D6329F1C35CA4BFULL}, {0xCB54395CA0000000ULL, 0x125DFA371A19E6F7ULL},
+      {0xBE2947B3C8000000ULL, 0x16F578C4E0A060B5ULL}, {0x2DB399A0BA000000ULL, 0x1CB2D6F618C878E3ULL},
+      {0xFC90400474400000ULL, 0x11EFC659CF7D4B8DULL}, {0x7BB4500591500000ULL, 0x166BB7F0435C9E71ULL},
+      {0xDAA16406F5A40000ULL, 0x1C06A5EC5433C60DULL}, {0xA8A4DE8459868000ULL, 0x118427B3B4A05BC8ULL},
+      {0xD2CE16256FE82000ULL, 0x15E531A0A1C872BAULL}, {0x87819BAECBE22800ULL, 0x1B5E7E08CA3A8F69ULL},
+      {0xF4B1014D3F6D5900ULL, 0x111B0EC57E6499A1ULL}, {0x71DD41A08F48AF40ULL, 0x1561D276DDFDC00AULL},
+      {0x0E549208B31ADB10ULL, 0x1ABA4714957D300DULL}, {0x28F4DB456FF0C8EAULL, 0x10B46C6CDD6E3E08ULL},
+      {0x33321216CBECFB24ULL, 0x14E1878814C9CD8AULL}, {0xBFFE969C7EE839EDULL, 0x1A19E96A19FC40ECULL},
+      {0xF7FF1E21CF512434ULL, 0x105031E2503DA893ULL}, {0xF5FEE5AA43256D41ULL, 0x14643E5AE44D12B8ULL},
+      {0x337E9F14D3EEC892ULL, 0x197D4DF19D605767ULL}, {0x005E46DA08EA7AB6ULL, 0x1FDCA16E04B86D41ULL},
+      {0xA03AEC4845928CB2ULL, 0x13E9E4E4C2F34448ULL}, {0xC849A75A56F72FDEULL, 0x18E45E1DF3B0155AULL},
+      {0x7A5C1130ECB4FBD6ULL, 0x1F1D75A5709C1AB1ULL}, {0xEC798ABE93F11D65ULL, 0x13726987666190AEULL},
+      {0xA797ED6E38ED64BFULL, 0x184F03E93FF9F4DAULL}, {0x517DE8C9C728BDEFULL, 0x1E62C4E38FF87211ULL},
+      {0xD2EEB17E1C7976B5ULL, 0x12FDBB0E39FB474AULL}, {0x87AA5DDDA397D462ULL, 0x17BD29D1C87A191DULL},
+      {0xE994F5550C7DC97BULL, 0x1DAC74463A989F64ULL}, {0x11FD195527CE9DEDULL, 0x128BC8ABE49F639FULL},
+      {0xD67C5FAA71C24568ULL, 0x172EBAD6DDC73C86ULL}, {0x8C1B77950E32D6C2ULL, 0x1CFA698C95390BA8ULL},
+      {0x57912ABD28DFC639ULL, 0x121C81F7DD43A749ULL}, {0xAD75756C7317B7C8ULL, 0x16A3A275D494911BULL},
+      {0x98D2D2C78FDDA5BAULL, 0x1C4C8B1349B9B562ULL}, {0x9F83C3BCB9EA8794ULL, 0x11AFD6EC0E14115DULL},
+      {0x0764B4ABE8652979ULL, 0x161BCCA7119915B5ULL}, {0x493DE1D6E27E73D7ULL, 0x1BA2BFD0D5FF5B22ULL},
+      {0x6DC6AD264D8F0866ULL, 0x1145B7E285BF98F5ULL}, {0xC938586FE0F2CA80ULL, 0x159725DB272F7F32ULL},
+      {0x7B866E8BD92F7D20ULL, 0x1AFCEF51F0FB5EFFULL}, {0xAD34051767BDAE34ULL, 0x10DE1593369D1B5FULL},
+      {0x9881065D41AD19C1ULL, 0x15159AF804446237ULL}, {0x7EA147F492186032ULL, 0x1A5B01B605557AC5ULL},
+      {0x6F24CCF8DB4F3C1FULL, 0x1078E111C3556CBBULL}, {0x4AEE003712230B27ULL, 0x14971956342AC7EAULL},
+      {0xDDA98044D6ABCDF0ULL, 0x19BCDFABC13579E4ULL}, {0x0A89F02B062B60B6ULL, 0x10160BCB58C16C2FULL},
+      {0xCD2C6C35C7B638E4ULL, 0x141B8EBE2EF1C73AULL}, {0x8077874339A3C71DULL, 0x1922726DBAAE3909ULL},
+      {0xE0956914080CB8E4ULL, 0x1F6B0F092959C74BULL}, {0x6C5D61AC8507F38EULL, 0x13A2E965B9D81C8FULL},
+      {0x4774BA17A649F072ULL, 0x188BA3BF284E23B3ULL}, {0x1951E89D8FDC6C8FULL, 0x1EAE8CAEF261ACA0ULL},
+      {0x0FD3316279E9C3D9ULL, 0x132D17ED577D0BE4ULL}, {0x13C7FDBB186434CFULL, 0x17F85DE8AD5C4EDDULL},
+      {0x58B9FD29DE7D4203ULL, 0x1DF67562D8B36294ULL}, {0xB7743E3A2B0E4942ULL, 0x12BA095DC7701D9CULL},
+      {0xE5514DC8B5D1DB92ULL, 0x17688BB5394C2503ULL}, {0xDEA5A13AE3465277ULL, 0x1D42AEA2879F2E44ULL},
+      {0x0B2784C4CE0BF38AULL, 0x1249AD2594C37CEBULL}, {0xCDF165F6018EF06DULL, 0x16DC186EF9F45C25ULL},
+      {0x416DBF7381F2AC88ULL, 0x1C931E8AB871732FULL}, {0x88E497A83137ABD5ULL, 0x11DBF316B346E7FDULL},
+      {0xEB1DBD923D8596CAULL, 0x1652EFDC6018A1FCULL}, {0x25E52CF6CCE6FC7DULL, 0x1BE7ABD3781ECA7CULL},
+      {0x97AF3C1A40105DCEULL, 0x1170CB642B133E8DULL}, {0xFD9B0B20D0147542ULL, 0x15CCFE3D35D80E30ULL},
+      {0x3D01CDE904199292ULL, 0x1B403DCC834E11BDULL}, {0x462120B1A28FFB9BULL, 0x1108269FD210CB16ULL},
+      {0xD7A968DE0B33FA82ULL, 0x154A3047C694FDDBULL}, {0xCD93C3158E00F923ULL, 0x1A9CBC59B83A3D52ULL},
+      {0xC07C59ED78C09BB6ULL, 0x10A1F5B813246653ULL}, {0xB09B7068D6F0C2A3ULL, 0x14CA732617ED7FE8ULL},
+      {0xDCC24C830CACF34CULL, 0x19FD0FEF9DE8DFE2ULL}, {0xC9F96FD1E7EC180FULL, 0x103E29F5C2B18BEDULL},
+      {0x3C77CBC661E71E13ULL, 0x144DB473335DEEE9ULL}, {0x8B95BEB7FA60E598ULL, 0x1961219000356AA3ULL},
+      {0x6E7B2E65F8F91EFEULL, 0x1FB969F40042C54CULL}, {0xC50CFCFFBB9BB35FULL, 0x13D3E2388029BB4FULL},
+      {0xB6503C3FAA82A037ULL, 0x18C8DAC6A0342A23ULL}, {0xA3E44B4F95234844ULL, 0x1EFB1178484134ACULL},
+      {0xE66EAF11BD360D2BULL, 0x135CEAEB2D28C0EBULL}, {0xE00A5AD62C839075ULL, 0x183425A5F872F126ULL},
+      {0x980CF18BB7A47493ULL, 0x1E412F0F768FAD70ULL}, {0x5F0816F752C6C8DCULL, 0x12E8BD69AA19CC66ULL},
+      {0xF6CA1CB527787B13ULL, 0x17A2ECC414A03F7FULL}, {0xF47CA3E2715699D7ULL, 0x1D8BA7F519C84F5FULL},
+      {0xF8CDE66D86D62026ULL, 0x127748F9301D319BULL}, {0xF7016008E88BA830ULL, 0x17151B377C247E02ULL},
+      {0xB4C1B80B22AE923CULL, 0x1CDA62055B2D9D83ULL}, {0x50F91306F5AD1B65ULL, 0x12087D4358FC8272ULL},
+      {0xE53757C8B318623FULL, 0x168A9C942F3BA30EULL}, {0x9E852DBADFDE7ACFULL, 0x1C2D43B93B0A8BD2ULL},
+      {0xA3133C94CBEB0CC1ULL, 0x119C4A53C4E69763ULL}, {0x8BD80BB9FEE5CFF1ULL, 0x16035CE8B6203D3CULL},
+      {0xAECE0EA87E9F43EEULL, 0x1B843422E3A84C8BULL}, {0x4D40C9294F238A75ULL, 0x1132A095CE492FD7ULL},
+      {0x2090FB73A2EC6D12ULL, 0x157F48BB41DB7BCDULL}, {0x68B53A508BA78856ULL, 0x1ADF1AEA12525AC0ULL},
+      {0x417144725748B536ULL, 0x10CB70D24B7378B8ULL}, {0x51CD958EED1AE283ULL, 0x14FE4D06DE5056E6ULL},
+      {0xE640FAF2A8619B24ULL, 0x1A3DE04895E46C9FULL}, {0xEFE89CD7A93D00F7ULL, 0x1066AC2D5DAEC3E3ULL},
+      {0xEBE2C40D938C4134ULL, 0x14805738B51A74DCULL}, {0x26DB7510F86F5181ULL, 0x19A06D06E2611214ULL},
+      {0x9849292A9B4592F1ULL, 0x100444244D7CAB4CULL}, {0xBE5B73754216F7ADULL, 0x1405552D60DBD61FULL},
+      {0xADF25052929CB598ULL, 0x1906AA78B912CBA7ULL}, {0x996EE4673743E2FFULL, 0x1F485516E7577E91ULL},
+      {0xFFE54EC0828A6DDFULL, 0x138D352E5096AF1AULL}, {0xBFDEA270A32D0957ULL, 0x18708279E4BC5AE1ULL},
+      {0x2FD64B0CCBF84BADULL, 0x1E8CA3185DEB719AULL}, {0x5DE5EEE7FF7B2F4CULL, 0x1317E5EF3AB32700ULL},
+      {0x755F6AA1FF59FB1FULL, 0x17DDDF6B095FF0C0ULL}, {0x92B7454A7F3079E7ULL, 0x1DD55745CBB7ECF0ULL},
+      {0x5BB28B4E8F7E4C30ULL, 0x12A5568B9F52F416ULL}, {0xF29F2E22335DDF3CULL, 0x174EAC2E8727B11BULL},
+      {0xEF46F9AAC035570BULL, 0x1D22573A28F19D62ULL}, {0xD58C5C0AB8215667ULL, 0x123576845997025DULL},
+      {0x4AEF730D6629AC01ULL, 0x16C2D4256FFCC2F5ULL}, {0x9DAB4FD0BFB41701ULL, 0x1C73892ECBFBF3B2ULL},
+      {0xA28B11E277D08E60ULL, 0x11C835BD3F7D784FULL}, {0x8B2DD65B15C4B1F9ULL, 0x163A432C8F5CD663ULL},
+      {0x6DF94BF1DB35DE77ULL, 0x1BC8D3F7B3340BFCULL}, {0xC4BBCF772901AB0AULL, 0x115D847AD000877DULL},
+      {0x35EAC354F34215CDULL, 0x15B4E5998400A95DULL}, {0x8365742A30129B40ULL, 0x1B221EFFE500D3B4ULL},
+      {0xD21F689A5E0BA108ULL, 0x10F5535FEF208450ULL}, {0x06A742C0F58E894AULL, 0x1532A837EAE8A565ULL},
+      {0x4851137132F22B9DULL, 0x1A7F5245E5A2CEBEULL}, {0xED32AC26BFD75B42ULL, 0x108F936BAF85C136ULL},
+      {0xA87F57306FCD3212ULL, 0x14B378469B673184ULL}, {0xD29F2CFC8BC07E97ULL, 0x19E056584240FDE5ULL},
+      {0xA3A37C1DD7584F1EULL, 0x102C35F729689EAFULL}, {0x8C8C5B254D2E62E6ULL, 0x14374374F3C2C65BULL},
+      {0x6FAF71EEA079FB9FULL, 0x1945145230B377F2ULL}, {0x0B9B4E6A48987A87ULL, 0x1F965966BCE055EFULL},
+      {0x674111026D5F4C94ULL, 0x13BDF7E0360C35B5ULL}, {0xC111554308B71FBAULL, 0x18AD75D8438F4322ULL},
+      {0x7155AA93CAE4E7A8ULL, 0x1ED8D34E547313EBULL}, {0x26D58A9C5ECF10C9ULL, 0x13478410F4C7EC73ULL},
+      {0xF08AED437682D4FBULL, 0x1819651531F9E78FULL}, {0xECADA89454238A3AULL, 0x1E1FBE5A7E786173ULL},
+      {0x73EC895CB4963664ULL, 0x12D3D6F88F0B3CE8ULL}, {0x90E7ABB3E1BBC3FDULL, 0x1788CCB6B2CE0C22ULL},
+      {0x352196A0DA2AB4FDULL, 0x1D6AFFE45F818F2BULL}, {0x0134FE24885AB11EULL, 0x1262DFEEBBB0F97BULL},
+      {0xC1823DADAA715D65ULL, 0x16FB97EA6A9D37D9ULL}, {0x31E2CD19150DB4BFULL, 0x1CBA7DE5054485D0ULL},
+      {0x1F2DC02FAD2890F7ULL, 0x11F48EAF234AD3A2ULL}, {0xA6F9303B9872B535ULL, 0x1671B25AEC1D888AULL},
+      {0x50B77C4A7E8F6282ULL, 0x1C0E1EF1A724EAADULL}, {0x5272ADAE8F199D91ULL, 0x1188D357087712ACULL},
+      {0x670F591A32E004F6ULL, 0x15EB082CCA94D757ULL}, {0x40D32F60BF980633ULL, 0x1B65CA37FD3A0D2DULL},
+      {0x4883FD9C77BF03E0ULL, 0x111F9E62FE44483CULL}, {0x5AA4FD0395AEC4D8ULL, 0x156785FBBDD55A4BULL},
+      {0x314E3C447B1A760EULL, 0x1AC1677AAD4AB0DEULL}, {0xDED0E5AACCF089C9ULL, 0x10B8E0ACAC4EAE8AULL},
+      {0x96851F15802CAC3BULL, 0x14E718D7D7625A2DULL}, {0xFC2666DAE037D74AULL, 0x1A20DF0DCD3AF0B8ULL},
+      {0x9D980048CC22E68EULL, 0x10548B68A044D673ULL}, {0x84FE005AFF2BA032ULL, 0x1469AE42C8560C10ULL},
+      {0xA63D8071BEF6883EULL, 0x198419D37A6B8F14ULL}, {0xCFCCE08E2EB42A4EULL, 0x1FE52048590672D9ULL},
+      {0x21E00C58DD309A70ULL, 0x13EF342D37A407C8ULL}, {0x2A580F6F147CC10DULL, 0x18EB0138858D09BAULL},
+      {0xB4EE134AD99BF150ULL, 0x1F25C186A6F04C28ULL}, {0x7114CC0EC80176D2ULL, 0x137798F428562F99ULL},
+      {0xCD59FF127A01D486ULL, 0x18557F31326BBB7FULL}, {0xC0B07ED7188249A8ULL, 0x1E6ADEFD7F06AA5FULL},
+      {0xD86E4F466F516E09ULL, 0x1302CB5E6F642A7BULL}, {0xCE89E3180B25C98BULL, 0x17C37E360B3D351AULL},
+      {0x822C5BDE0DEF3BEEULL, 0x1DB45DC38E0C8261ULL}, {0xF15BB96AC8B58575ULL, 0x1290BA9A38C7D17CULL},
+      {0x2DB2A7C57AE2E6D2ULL, 0x1734E940C6F9C5DCULL}, {0x391F51B6D99BA086ULL, 0x1D022390F8B83753ULL},
+      {0x03B3931248014454ULL, 0x1221563A9B732294ULL}, {0x04A077D6DA019569ULL, 0x16A9ABC9424FEB39ULL},
+      {0x45C895CC9081FAC3ULL, 0x1C5416BB92E3E607ULL}, {0x8B9D5D9FDA513CBAULL, 0x11B48E353BCE6FC4ULL},
+      {0xAE84B507D0E58BE8ULL, 0x1621B1C28AC20BB5ULL}, {0x1A25E249C51EEEE3ULL, 0x1BAA1E332D728EA3ULL},
+      {0xF057AD6E1B33554DULL, 0x114A52DFFC679925ULL}, {0x6C6D98C9A2002AA1ULL, 0x159CE797FB817F6FULL},
+      {0x4788FEFC0A803549ULL, 0x1B04217DFA61DF4BULL}, {0x0CB59F5D8690214EULL, 0x10E294EEBC7D2B8FULL},
+      {0xCFE30734E83429A1ULL, 0x151B3A2A6B9C7672ULL}, {0x83DBC9022241340AULL, 0x1A6208B50683940FULL},
+      {0xB2695DA15568C086ULL, 0x107D457124123C89ULL}, {0x1F03B509AAC2F0A7ULL, 0x149C96CD6D16CBACULL},
+      {0x26C4A24C1573ACD1ULL, 0x19C3BC80C85C7E97ULL}, {0x783AE56F8D684C03ULL, 0x101A55D07D39CF1EULL},
+      {0x16499ECB70C25F03ULL, 0x1420EB449C8842E6ULL}, {0x9BDC067E4CF2F6C4ULL, 0x19292615C3AA539FULL},
+      {0x82D3081DE02FB476ULL, 0x1F736F9B3494E887ULL}, {0xB1C3E512AC1DD0C9ULL, 0x13A825C100DD1154ULL},
+      {0xDE34DE57572544FCULL, 0x18922F31411455A9ULL}, {0x55C215ED2CEE963BULL, 0x1EB6BAFD91596B14ULL},
+      {0xB5994DB43C151DE5ULL, 0x133234DE7AD7E2ECULL}, {0xE2FFA1214B1A655EULL, 0x17FEC216198DDBA7ULL},
+      {0xDBBF89699DE0FEB6ULL, 0x1DFE729B9FF15291ULL}, {0x2957B5E202AC9F31ULL, 0x12BF07A143F6D39BULL},
+      {0xF3ADA35A8357C6FEULL, 0x176EC98994F48881ULL}, {0x70990C31242DB8BDULL, 0x1D4A7BEBFA31AAA2ULL},
+      {0x865FA79EB69C9376ULL, 0x124E8D737C5F0AA5ULL}, {0xE7F791866443B854ULL, 0x16E230D05B76CD4EULL},
+      {0xA1F575E7FD54A669ULL, 0x1C9ABD04725480A2ULL}, {0xA53969B0FE54E801ULL, 0x11E0B622C774D065ULL},
+      {0x0E87C41D3DEA2202ULL, 0x1658E3AB7952047FULL}, {0xD229B5248D64AA82ULL, 0x1BEF1C9657A6859EULL},
+      {0x435A1136D85EEA91ULL, 0x117571DDF6C81383ULL}, {0x143095848E76A536ULL, 0x15D2CE55747A1864ULL},
+      {0x193CBAE5B2144E83ULL, 0x1B4781EAD1989E7DULL}, {0x2FC5F4CF8F4CB112ULL, 0x110CB132C2FF630EULL},
+      {0xBBB77203731FDD56ULL, 0x154FDD7F73BF3BD1ULL}, {0x2AA54E844FE7D4ACULL, 0x1AA3D4DF50AF0AC6ULL},
+      {0xDAA75112B1F0E4EBULL, 0x10A6650B926D66BBULL}, {0xD15125575E6D1E26ULL, 0x14CFFE4E7708C06AULL},
+      {0x85A56EAD360865B0ULL, 0x1A03FDE214CAF085ULL}, {0x7387652C41C53F8EULL, 0x10427EAD4CFED653ULL},
+      {0x50693E7752368F71ULL, 0x14531E58A03E8BE8ULL}, {0x64838E1526C4334EULL, 0x1967E5EEC84E2EE2ULL},
+      {0xFDA4719A70754022ULL, 0x1FC1DF6A7A61BA9AULL}, {0xDE86C70086494815ULL, 0x13D92BA28C7D14A0ULL},
+      {0x162878C0A7DB9A1AULL, 0x18CF768B2F9C59C9ULL}, {0x5BB296F0D1D280A1ULL, 0x1F03542DFB83703BULL},
+      {0x194F9E5683239064ULL, 0x1362149CBD322625ULL}, {0x5FA385EC23EC747EULL, 0x183A99C3EC7EAFAEULL},
+      {0xF78C67672CE7919DULL, 0x1E494034E79E5B99ULL}, {0x3AB7C0A07C10BB02ULL, 0x12EDC82110C2F940ULL},
+      {0x4965B0C89B14E9C3ULL, 0x17A93A2954F3B790ULL}, {0x5BBF1CFAC1DA2433ULL, 0x1D9388B3AA30A574ULL},
+      {0xB957721CB92856A0ULL, 0x127C35704A5E6768ULL}, {0xE7AD4EA3E7726C48ULL, 0x171B42CC5CF60142ULL},
+      {0xA198A24CE14F075AULL, 0x1CE2137F74338193ULL}, {0x44FF65700CD16498ULL, 0x120D4C2FA8A030FCULL},
+      {0x563F3ECC1005BDBEULL, 0x16909F3B92C83D3BULL}, {0x2BCF0E7F14072D2EULL, 0x1C34C70A777A4C8AULL},
+      {0x5B61690F6C847C3DULL, 0x11A0FC668AAC6FD6ULL}, {0xF239C35347A59B4CULL, 0x16093B802D578BCBULL},
+      {0xEEC83428198F021FULL, 0x1B8B8A6038AD6EBEULL}, {0x553D20990FF96153ULL, 0x1137367C236C6537ULL},
+      {0x2A8C68BF53F7B9A8ULL, 0x1585041B2C477E85ULL}, {0x752F82EF28F5A812ULL, 0x1AE64521F7595E26ULL},
+      {0x093DB1D57999890BULL, 0x10CFEB353A97DAD8ULL}, {0x0B8D1E4AD7FFEB4EULL, 0x1503E602893DD18EULL},
+      {0x8E7065DD8DFFE622ULL, 0x1A44DF832B8D45F1ULL}, {0xF9063FAA78BFEFD5ULL, 0x106B0BB1FB384BB6ULL},
+      {0xB747CF9516EFEBCAULL, 0x1485CE9E7A065EA4ULL}, {0xE519C37A5CABE6BDULL, 0x19A742461887F64DULL},
+      {0xAF301A2C79EB7036ULL, 0x1008896BCF54F9F0ULL}, {0xDAFC20B798664C43ULL, 0x140AABC6C32A386CULL},
+      {0x11BB28E57E7FDF54ULL, 0x190D56B873F4C688ULL}, {0x1629F31EDE1FD72AULL, 0x1F50AC6690F1F82AULL},
+      {0x4DDA37F34AD3E67AULL, 0x13926BC01A973B1AULL}, {0xE150C5F01D88E019ULL, 0x187706B0213D09E0ULL},
+      {0x19A4F76C24EB181FULL, 0x1E94C85C298C4C59ULL}, {0xB0071AA39712EF13ULL, 0x131CFD3999F7AFB7ULL},
+      {0x9C08E14C7CD7AAD8ULL, 0x17E43C8800759BA5ULL}, {0x030B199F9C0D958EULL, 0x1DDD4BAA0093028FULL},
+      {0x61E6F003C1887D79ULL, 0x12AA4F4A405BE199ULL}, {0xBA60AC04B1EA9CD7ULL, 0x1754E31CD072D9FFULL},
+      {0xA8F8D705DE65440DULL, 0x1D2A1BE4048F907FULL}, {0xC99B8663AAFF4A88ULL, 0x123A516E82D9BA4FULL},
+      {0xBC0267FC95BF1D2AULL, 0x16C8E5CA239028E3ULL}, {0xAB0301FBBB2EE474ULL, 0x1C7B1F3CAC74331CULL},
+      {0xEAE1E13D54FD4EC9ULL, 0x11CCF385EBC89FF1ULL}, {0x659A598CAA3CA27BULL, 0x1640306766BAC7EEULL},
+      {0xFF00EFEFD4CBCB1AULL, 0x1BD03C81406979E9ULL}, {0x3F6095F5E4FF5EF0ULL, 0x116225D0C841EC32ULL},
+      {0xCF38BB735E3F36ACULL, 0x15BAAF44FA52673EULL}, {0x8306EA5035CF0457ULL, 0x1B295B1638E7010EULL},
+      {0x11E4527221A162B6ULL, 0x10F9D8EDE39060A9ULL}, {0x565D670EAA09BB64ULL, 0x15384F295C7478D3ULL},
+      {0x2BF4C0D2548C2A3DULL, 0x1A8662F3B3919708ULL}, {0x1B78F88374D79A66ULL, 0x1093FDD8503AFE65ULL},
+      {0x625736A4520D8100ULL, 0x14B8FD4E6449BDFEULL}, {0xFAED044D6690E140ULL, 0x19E73CA1FD5C2D7DULL},
+      {0xBCD422B0601A8CC8ULL, 0x103085E53E599C6EULL}, {0x6C092B5C78212FFAULL, 0x143CA75E8DF0038AULL},
+      {0x070B763396297BF8ULL, 0x194BD136316C046DULL}, {0x48CE53C07BB3DAF6ULL, 0x1F9EC583BDC70588ULL},
+      {0x2D80F4584D5068DAULL, 0x13C33B72569C6375ULL}, {0x78E1316E60A48310ULL, 0x18B40A4EEC437C52ULL},
+  };
+  // clang-format on
+  fio___ftoa_decimal_s r;
+  int32_t e2, e10;
+  uint64_t m2, mv, vr, vp, vm, output;
+  uint32_t mm_shift, removed = 0;
+  uint8_t last_removed = 0;
+  int vm_zeros = 0, vr_zeros = 0;
+  if (ieee_exp) {
+    e2 = (int32_t)ieee_exp - 1075 - 2;
+    m2 = ieee_mant | (1ULL << 52);
+  } else {
+    e2 = 1 - 1075 - 2;
+    m2 = ieee_mant;
+  }
+  const int accept_bounds = !(m2 & 1);
+  mv = m2 << 2;
+  mm_shift = (ieee_mant || ieee_exp <= 1);
+
+  /* compute the interval bounds (vm, vp) and the value (vr) in base 10 */
+  if (e2 >= 0) {
+    const uint32_t q = fio___ftoa_log10pow2(e2) - (e2 > 3);
+    const int32_t i =
+        (int32_t)q - e2 + fio___ftoa_pow5bits((int32_t)q) - 1 + 125;
+    e10 = (int32_t)q;
+    vr = fio___ftoa_mul_shift(mv, pow5_inv[q], i);
+    vp = fio___ftoa_mul_shift(mv + 2, pow5_inv[q], i);
+    vm = fio___ftoa_mul_shift(mv - 1 - mm_shift, pow5_inv[q], i);
+    if (q <= 21) {
+      if (!(mv % 5))
+        vr_zeros = fio___ftoa_is_pow5_multiple(mv, q);
+      else if (accept_bounds)
+        vm_zeros = fio___ftoa_is_pow5_multiple(mv - 1 - mm_shift, q);
+      else
+        vp -= fio___ftoa_is_pow5_multiple(mv + 2, q);
+    }
+  } else {
+    const uint32_t q = fio___ftoa_log10pow5(-e2) - (-e2 > 1);
+    const int32_t i = -e2 - (int32_t)q;
+    const int32_t j = (int32_t)q - (fio___ftoa_pow5bits(i) - 125);
+    e10 = (int32_t)q + e2;
+    vr = fio___ftoa_mul_shift(mv, pow5[i], j);
+    vp = fio___ftoa_mul_shift(mv + 2, pow5[i], j);
+    vm = fio___ftoa_mul_shift(mv - 1 - mm_shift, pow5[i], j);
+    if (q <= 1) {
+      vr_zeros = 1;
+      if (accept_bounds)
+        vm_zeros = (mm_shift == 1);
+      else
+        --vp;
+    } else if (q < 63) {
+      vr_zeros = fio___ftoa_is_pow2_multiple(mv, q);
+    }
+  }
+
+  /* remove digits while the interval allows it */
+  if (vm_zeros || vr_zeros) { /* rare: exact boundaries and ties */
+    while (vp / 10 > vm / 10) {
+      vm_zeros &= !(vm % 10);
+      vr_zeros &= !last_removed;
+      last_removed = (uint8_t)(vr % 10);
+      vr /= 10;
+      vp /= 10;
+      vm /= 10;
+      ++removed;
+    }
+    if (vm_zeros) {
+      while (!(vm % 10)) {
+        vr_zeros &= !last_removed;
+        last_removed = (uint8_t)(vr % 10);
+        vr /= 10;
+        vp /= 10;
+        vm /= 10;
+        ++removed;
+      }
+    }
+    if (vr_zeros && last_removed == 5 && !(vr & 1))
+      last_removed = 4; /* round to even */
+    output = vr + ((vr == vm && (!accept_bounds || !vm_zeros)) ||
+                   last_removed >= 5);
+  } else { /* common case */
+    int round_up = 0;
+    if (vp / 100 > vm / 100) { /* remove two digits at a time */
+      round_up = (vr % 100) >= 50;
+      vr /= 100;
+      vp /= 100;
+      vm /= 100;
+      removed += 2;
+    }
+    while (vp / 10 > vm / 10) {
+      round_up = (vr % 10) >= 5;
+      vr /= 10;
+      vp /= 10;
+      vm /= 10;
+      ++removed;
+    }
+    output = vr + (vr == vm || round_up);
+  }
+  r.mant = output;
+  r.exp = e10 + (int32_t)removed;
+  return r;
+}
+
 /* *****************************************************************************
 fio_ftoa
 ***************************************************************************** */
@@ -6122,35 +7448,78 @@ SFUNC size_t fio_ftoa(char *dest, double num, uint8_t base) {
     p.d = num;
     return fio_ltoa(dest, p.i, base);
   }
-  size_t written = 0;
-
-  if (isinf(num))
-    goto is_inifinity;
-  if (isnan(num))
-    goto is_nan;
-
-  written = snprintf(dest, 30, "%g", num);
-  /* test if we need to add a ".0" to the end of the string */
-  for (char *start = dest;;) {
-    switch (*start) {
-    case ',':
-      *start = '.'; // locale issues?
-    /* fall through */
-    case 'e': /* fall through */
-    case '.': /* fall through */ goto finish;
-    case 0: goto add_dot_zero;
-    }
-    ++start;
+  union {
+    uint64_t u;
+    double d;
+  } p = {.d = num};
+  const uint64_t ieee_mant = p.u & FIO_MATH_DBL_MANT_MASK;
+  const uint32_t ieee_exp = (uint32_t)((p.u & FIO_MATH_DBL_EXPO_MASK) >> 52);
+  fio___ftoa_decimal_s d;
+  size_t written = 0, digits;
+  int32_t sci;
+  char buf[24];
+
+  if (ieee_exp == 2047)
+    goto is_inifinity_or_nan;
+  if ((p.u & FIO_MATH_DBL_SIGN_MASK))
+    dest[written++] = '-';
+  if (!ieee_exp && !ieee_mant) {
+    fio_memcpy4(dest + written, "0.0");
+    written += 3;
+    goto finish;
+  }
+  d = fio___ftoa_shortest(ieee_mant, ieee_exp);
+  digits = fio_digits10u(d.mant);
+  fio_ltoa10u(buf, d.mant, digits);
+  sci = d.exp + (int32_t)digits - 1; /* the scientific notation exponent */
+
+  if (sci < -4 || sci > 16)
+    goto scientific;
+  if (sci < 0) { /* 0.000ddd */
+    dest[written++] = '0';
+    dest[written++] = '.';
+    for (int32_t i = -1; i > sci; --i)
+      dest[written++] = '0';
+    FIO_MEMCPY(dest + written, buf, digits);
+    written += digits;
+  } else if ((size_t)sci + 1 >= digits) { /* ddd000.0 */
+    FIO_MEMCPY(dest + written, buf, digits);
+    written += digits;
+    for (int32_t i = 0; i < d.exp; ++i)
+      dest[written++] = '0';
+    dest[written++] = '.';
+    dest[written++] = '0';
+  } else { /* ddd.ddd */
+    FIO_MEMCPY(dest + written, buf, (size_t)sci + 1);
+    written += (size_t)sci + 1;
+    dest[written++] = '.';
+    FIO_MEMCPY(dest + written, buf + sci + 1, digits - ((size_t)sci + 1));
+    written += digits - ((size_t)sci + 1);
   }
-add_dot_zero:
-  dest[written++] = '.';
-  dest[written++] = '0';
+  goto finish;
+
+scientific: /* d.ddde+XX */
+  dest[written++] = buf[0];
+  if (digits > 1) {
+    dest[written++] = '.';
+    FIO_MEMCPY(dest + written, buf + 1, digits - 1);
+    written += digits - 1;
+  }
+  dest[written++] = 'e';
+  dest[written++] = (sci < 0 ? '-' : '+');
+  if (sci < 0)
+    sci = 0 - sci;
+  digits = fio_digits10u((uint64_t)sci);
+  fio_ltoa10u(dest + written, (uint64_t)sci, digits);
+  written += digits;
 
 finish:
   dest[written] = 0;
   return written;
 
-is_inifinity:
+is_inifinity_or_nan:
+  if (ieee_mant)
+    goto is_nan;
   if (num < 0)
     dest[written++] = '-';
   fio_memcpy8(dest + written, "Infinity");
@@ -6231,6 +7600,9 @@ FIO_SFUNC FIO___ASAN_AVOID fio_aton_s fio_aton(char **pstr) {
     goto is_infinity;
   if ((p[0] | 32) == 'n')
     goto is_nan;
+  if ((uint8_t)(p[0] - '1') < 9 || p[0] == '.' ||
+      (p[0] == '0' && p[1] == '.'))
+    goto is_decimal;
 
   base += (p[0] == '0');             /* oct */
   p += base;                         /* consume '0' */
@@ -6303,6 +7675,18 @@ FIO_SFUNC FIO___ASAN_AVOID fio_aton_s fio_aton(char **pstr) {
   r.u |= (uint64_t)neg << 63;
   return r;
 
+is_decimal:
+  start = p;
+  p = fio___aton10(&r, p, 0);
+  if (p == start)
+    return r;
+  *pstr = p;
+  if (r.is_float)
+    r.u |= (uint64_t)neg << 63;
+  else if (neg)
+    r.i = 0 - r.i;
+  return r;
+
 is_infinity:
   if ((p[1] | 32) == 'n' && (p[2] | 32) == 'f') { /* inf */
     r.is_float = 1;
@@ -10171,6 +11555,26 @@ Copyright and License: see header file (000 copyright.h) or top of file
 #define FIO_JSON_USE_FIO_ATON 0
 #endif
 
+#ifndef FIO_JSON_USE_INDEX
+/** Parses longer JSON data in two stages, using a (SIMD) structural index. */
+#define FIO_JSON_USE_INDEX 0
+#endif
+
+#ifndef FIO_JSON_INDEX_MIN
+/** JSON data shorter than this is parsed without a structural index. */
+#define FIO_JSON_INDEX_MIN 128
+#endif
+
+#ifndef FIO_JSON_INDEX_SIZE
+/** The number of structural index entries (4 bytes each) per indexing round. */
+#define FIO_JSON_INDEX_SIZE 2048
+#endif
+
+#ifndef FIO_JSON_STREAM_MAX_TOKEN
+/** The default size limit for a token (string / number) spanning chunks. */
+#define FIO_JSON_STREAM_MAX_TOKEN (1UL << 20)
+#endif
+
 /** The JSON parser settings. */
 typedef struct {
   /** NULL object was detected. Returns new object as `void *`. */
@@ -10228,11 +11632,72 @@ typedef struct {
  * Returns the number of bytes consumed before parsing stopped (due to either
  * error or end of data). Stops as close as possible to the end of the buffer or
  * once an object parsing was completed.
+ *
+ * JSON data longer than `FIO_JSON_INDEX_MIN` is parsed in two stages: a (SIMD)
+ * structural index is collected first and then walked to call the callbacks.
  */
 SFUNC fio_json_result_s fio_json_parse(fio_json_parser_callbacks_s *settings,
                                        const char *json_string,
                                        const size_t len);
 
+/* *****************************************************************************
+JSON Streaming (Push) Parser - API
+***************************************************************************** */
+
+/** A resumable JSON parser, fed using `fio_json_stream_write`. */
+typedef struct fio_json_stream_s fio_json_stream_s;
+
+/** Named arguments for `fio_json_stream_new`. */
+typedef struct {
+  /** The JSON parser callbacks (required, copied by the stream). */
+  fio_json_parser_callbacks_s *callbacks;
+  /** Called for every complete top-level JSON value (takes ownership). */
+  void (*on_json)(void *udata, void *value);
+  /** Opaque user data passed to `on_json`. */
+  void *udata;
+  /** Maximum nesting depth. Defaults to `FIO_JSON_MAX_DEPTH`. */
+  uint32_t max_depth;
+  /** Maximum bytes buffered for a single token that spans chunks. */
+  uint32_t max_token;
+  /** If set, the stream is NDJSON (one top-level value per line). */
+  uint8_t ndjson;
+} fio_json_stream_args_s;
+
+/**
+ * Creates a new resumable (push) JSON parser. Returns NULL on error.
+ *
+ * Data is fed in chunks of any size (split anywhere) using
+ * `fio_json_stream_write`, and every complete top-level value is passed to the
+ * `on_json` callback (or freed using `free_unused_object` if missing).
+ */
+SFUNC fio_json_stream_s *fio_json_stream_new(fio_json_stream_args_s args);
+/** Named arguments helper. See `fio_json_stream_args_s` for details. */
+#define fio_json_stream_new(...)                                               \
+  fio_json_stream_new((fio_json_stream_args_s){__VA_ARGS__})
+
+/**
+ * Parses the next chunk of JSON data. Returns -1 if an error occurred.
+ *
+ * On error, any partial data is passed to the `on_error` callback (that should
+ * free it). In NDJSON mode the offending line is skipped and parsing resumes
+ * on the next line, otherwise the stream ignores any data until reset by
+ * `fio_json_stream_finish`.
+ */
+SFUNC int fio_json_stream_write(fio_json_stream_s *s,
+                                const void *buf,
+                                size_t len);
+
+/**
+ * Marks the end of the input, completing a trailing top-level scalar.
+ *
+ * Returns -1 if the data was incomplete or invalid (for JSON streams, also if
+ * no value was parsed). The stream is reset and can be reused.
+ */
+SFUNC int fio_json_stream_finish(fio_json_stream_s *s);
+
+/** Frees the stream, discarding (freeing) any incomplete data. */
+SFUNC void fio_json_stream_free(fio_json_stream_s *s);
+
 /* *****************************************************************************
 JSON Parsing - Implementation - Helpers and Callbacks
 
@@ -10628,6 +12093,573 @@ void *fio___json_consume(fio___json_state_s *s) {
   }
 }
 
+/** An open collection, as tracked by the iterative parsers (internal use). */
+typedef struct {
+  /** The collection (as returned by `on_map` / `on_array`). */
+  void *ctx;
+  /** The key waiting for a value (maps only). */
+  void *key;
+  /** The collection's closing character. */
+  uintptr_t close;
+} fio___json_frame_s;
+
+/* *****************************************************************************
+JSON Parsing - Structural Index (Two Stage Parsing)
+
+Stage one classifies the JSON data in 64 byte blocks (using SIMD when
+available), marking quotes, backslashes, white space and structural characters
+in 64 bit bitmaps. Escaped quotes and string contents are masked away using bit
+arithmetic, and the positions of the structural characters, the string quotes
+and the first byte of any other value (numbers, `true`, `NaN`, etc') are
+collected in an index.
+
+Stage two walks the index (instead of the JSON bytes), calling the same
+callbacks as the recursive parser, using an explicit stack.
+
+Blocks with comments are indexed byte by byte (comments are skipped). The
+index is collected in rounds of up to `FIO_JSON_INDEX_SIZE` entries, so no
+memory is allocated.
+***************************************************************************** */
+#if FIO_JSON_USE_INDEX
+
+#if FIO_JSON_INDEX_SIZE < 64
+#error FIO_JSON_INDEX_SIZE must be at least 64 (the entries of a single block).
+#endif
+
+/** Marks the closing quote of a string that contains a backslash. */
+#define FIO___JSON_INDEX_ESCAPED ((uint32_t)1 << 31)
+/** The maximal number of entries a single block might add to the index. */
+#define FIO___JSON_INDEX_BLOCK 64
+
+/** The classification of a 64 byte block (internal use). */
+typedef struct {
+  /** Marks `'"'` bytes. */
+  uint64_t quote;
+  /** Marks `'\\'` bytes. */
+  uint64_t backslash;
+  /** Marks white space bytes (space, tab, CR and LF). */
+  uint64_t space;
+  /** Marks the `{`, `}`, `[`, `]`, `:` and `,` bytes. */
+  uint64_t op;
+  /** Marks the `/` and `#` bytes (possible comments). */
+  uint64_t comment;
+} fio___json_bitmap_s;
+
+/** The JSON structural index (internal use). */
+typedef struct {
+  /** The first byte of the JSON data (index positions are relative to it). */
+  const char *start;
+  /** The next byte to be indexed. */
+  const char *pos;
+  /** The end of the JSON data. */
+  const char *end;
+  /** All bits set if the last indexed block ended within a string. */
+  uint64_t in_string;
+  /** 1 if the first byte of the next block is escaped (by a backslash). */
+  uint64_t escaped;
+  /** 1 if the last indexed byte was part of a (non-string) value. */
+  uint64_t scalar;
+  /** `FIO___JSON_INDEX_ESCAPED` if the current string contains a backslash. */
+  uint32_t string_escaped;
+  /** The number of index entries. */
+  uint32_t count;
+  /** The number of index entries already consumed. */
+  uint32_t read;
+  /** The index entries. */
+  uint32_t at[FIO_JSON_INDEX_SIZE];
+} fio___json_index_s;
+
+/* marks (0x80) every zero byte in a 64 bit word (no false positives). */
+FIO_IFUNC uint64_t fio___json_swar_zero(uint64_t w) {
+  const uint64_t m = UINT64_C(0x7F7F7F7F7F7F7F7F);
+  return ~(((w & m) + m) | w | m);
+}
+
+#if FIO___HAS_X86_INTRIN && defined(__AVX2__)
+/* classifies 64 bytes using AVX2 (2 x 32 byte vectors). */
+FIO_IFUNC void fio___json_classify(fio___json_bitmap_s *m, const char *p) {
+  const __m256i v_quote = _mm256_set1_epi8('"');
+  const __m256i v_bs = _mm256_set1_epi8('\\');
+  const __m256i v_lower = _mm256_set1_epi8(0x20); /* '[' | 0x20 == '{' */
+  const __m256i v_open = _mm256_set1_epi8('{');
+  const __m256i v_close = _mm256_set1_epi8('}');
+  const __m256i v_colon = _mm256_set1_epi8(':');
+  const __m256i v_comma = _mm256_set1_epi8(',');
+  const __m256i v_sp = _mm256_set1_epi8(' ');
+  const __m256i v_tab = _mm256_set1_epi8('\t');
+  const __m256i v_lf = _mm256_set1_epi8('\n');
+  const __m256i v_cr = _mm256_set1_epi8('\r');
+  const __m256i v_slash = _mm256_set1_epi8('/');
+  const __m256i v_hash = _mm256_set1_epi8('#');
+  FIO_MEMSET(m, 0, sizeof(*m));
+  for (size_t i = 0; i < 64; i += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+    __m256i l = _mm256_or_si256(v, v_lower);
+    __m256i s = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, v_sp),
+                        _mm256_cmpeq_epi8(v, v_tab)),
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, v_lf),
+                        _mm256_cmpeq_epi8(v, v_cr)));
+    __m256i o = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(l, v_open),
+                        _mm256_cmpeq_epi8(l, v_close)),
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, v_colon),
+                        _mm256_cmpeq_epi8(v, v_comma)));
+    __m256i c = _mm256_or_si256(_mm256_cmpeq_epi8(v, v_slash),
+                                _mm256_cmpeq_epi8(v, v_hash));
+    m->quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(
+                    _mm256_cmpeq_epi8(v, v_quote))
+                << i;
+    m->backslash |=
+        (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, v_bs))
+        << i;
+    m->space |= (uint64_t)(uint32_t)_mm256_movemask_epi8(s) << i;
+    m->op |= (uint64_t)(uint32_t)_mm256_movemask_epi8(o) << i;
+    m->comment |= (uint64_t)(uint32_t)_mm256_movemask_epi8(c) << i;
+  }
+}
+
+#elif FIO___HAS_X86_INTRIN
+/* classifies 64 bytes using SSE2 (4 x 16 byte vectors). */
+FIO_IFUNC void fio___json_classify(fio___json_bitmap_s *m, const char *p) {
+  const __m128i v_quote = _mm_set1_epi8('"');
+  const __m128i v_bs = _mm_set1_epi8('\\');
+  const __m128i v_lower = _mm_set1_epi8(0x20); /* '[' | 0x20 == '{' */
+  const __m128i v_open = _mm_set1_epi8('{');
+  const __m128i v_close = _mm_set1_epi8('}');
+  const __m128i v_colon = _mm_set1_epi8(':');
+  const __m128i v_comma = _mm_set1_epi8(',');
+  const __m128i v_sp = _mm_set1_epi8(' ');
+  const __m128i v_tab = _mm_set1_epi8('\t');
+  const __m128i v_lf = _mm_set1_epi8('\n');
+  const __m128i v_cr = _mm_set1_epi8('\r');
+  const __m128i v_slash = _mm_set1_epi8('/');
+  const __m128i v_hash = _mm_set1_epi8('#');
+  FIO_MEMSET(m, 0, sizeof(*m));
+  for (size_t i = 0; i < 64; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+    __m128i l = _mm_or_si128(v, v_lower);
+    __m128i s = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, v_sp), _mm_cmpeq_epi8(v, v_tab)),
+        _mm_or_si128(_mm_cmpeq_epi8(v, v_lf), _mm_cmpeq_epi8(v, v_cr)));
+    __m128i o = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(l, v_open), _mm_cmpeq_epi8(l, v_close)),
+        _mm_or_si128(_mm_cmpeq_epi8(v, v_colon), _mm_cmpeq_epi8(v, v_comma)));
+    __m128i c =
+        _mm_or_si128(_mm_cmpeq_epi8(v, v_slash), _mm_cmpeq_epi8(v, v_hash));
+    m->quote |=
+        (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, v_quote)) << i;
+    m->backslash |=
+        (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, v_bs)) << i;
+    m->space |= (uint64_t)(uint16_t)_mm_movemask_epi8(s) << i;
+    m->op |= (uint64_t)(uint16_t)_mm_movemask_epi8(o) << i;
+    m->comment |= (uint64_t)(uint16_t)_mm_movemask_epi8(c) << i;
+  }
+}
+
+#elif FIO___HAS_ARM_INTRIN && defined(__aarch64__)
+/* packs four NEON comparison results (0xFF / 0x00 bytes) into a bitmap. */
+FIO_IFUNC uint64_t fio___json_neon2bitmap(uint8x16_t a,
+                                          uint8x16_t b,
+                                          uint8x16_t c,
+                                          uint8x16_t d) {
+  const uint8x16_t bits =
+      {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+  a = vpaddq_u8(vandq_u8(a, bits), vandq_u8(b, bits));
+  c = vpaddq_u8(vandq_u8(c, bits), vandq_u8(d, bits));
+  a = vpaddq_u8(a, c);
+  a = vpaddq_u8(a, a);
+  return vgetq_lane_u64(vreinterpretq_u64_u8(a), 0);
+}
+
+/* classifies 64 bytes using NEON (4 x 16 byte vectors). */
+FIO_IFUNC void fio___json_classify(fio___json_bitmap_s *m, const char *p) {
+  const uint8x16_t v_lower = vdupq_n_u8(0x20); /* '[' | 0x20 == '{' */
+  uint8x16_t q[4], b[4], s[4], o[4], c[4];
+  for (size_t i = 0; i < 4; ++i) {
+    uint8x16_t v = vld1q_u8((const uint8_t *)p + (i << 4));
+    uint8x16_t l = vorrq_u8(v, v_lower);
+    q[i] = vceqq_u8(v, vdupq_n_u8('"'));
+    b[i] = vceqq_u8(v, vdupq_n_u8('\\'));
+    s[i] = vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8(' ')),
+                             vceqq_u8(v, vdupq_n_u8('\t'))),
+                    vorrq_u8(vceqq_u8(v, vdupq_n_u8('\n')),
+                             vceqq_u8(v, vdupq_n_u8('\r'))));
+    o[i] = vorrq_u8(vorrq_u8(vceqq_u8(l, vdupq_n_u8('{')),
+                             vceqq_u8(l, vdupq_n_u8('}'))),
+                    vorrq_u8(vceqq_u8(v, vdupq_n_u8(':')),
+                             vceqq_u8(v, vdupq_n_u8(','))));
+    c[i] = vorrq_u8(vceqq_u8(v, vdupq_n_u8('/')), vceqq_u8(v, vdupq_n_u8('#')));
+  }
+  m->quote = fio___json_neon2bitmap(q[0], q[1], q[2], q[3]);
+  m->backslash = fio___json_neon2bitmap(b[0], b[1], b[2], b[3]);
+  m->space = fio___json_neon2bitmap(s[0], s[1], s[2], s[3]);
+  m->op = fio___json_neon2bitmap(o[0], o[1], o[2], o[3]);
+  m->comment = fio___json_neon2bitmap(c[0], c[1], c[2], c[3]);
+}
+
+#else
+/* packs the 0x80 bits of a little endian word into an 8 bit bitmap. */
+#define FIO___JSON_SWAR_PACK(w)                                                \
+  ((((w) >> 7) * UINT64_C(0x0102040810204080)) >> 56)
+
+/* classifies 64 bytes using SWAR (8 x 8 byte words). */
+FIO_IFUNC void fio___json_classify(fio___json_bitmap_s *m, const char *p) {
+  const uint64_t bytes = UINT64_C(0x0101010101010101);
+  FIO_MEMSET(m, 0, sizeof(*m));
+  for (size_t i = 0; i < 64; i += 8) {
+    uint64_t w = fio_buf2u64_le(p + i);
+    uint64_t l = w | (bytes * 0x20); /* '[' | 0x20 == '{' */
+    uint64_t s = fio___json_swar_zero(w ^ (bytes * ' ')) |
+                 fio___json_swar_zero(w ^ (bytes * '\t')) |
+                 fio___json_swar_zero(w ^ (bytes * '\n')) |
+                 fio___json_swar_zero(w ^ (bytes * '\r'));
+    uint64_t o = fio___json_swar_zero(l ^ (bytes * '{')) |
+                 fio___json_swar_zero(l ^ (bytes * '}')) |
+                 fio___json_swar_zero(w ^ (bytes * ':')) |
+                 fio___json_swar_zero(w ^ (bytes * ','));
+    uint64_t c = fio___json_swar_zero(w ^ (bytes * '/')) |
+                 fio___json_swar_zero(w ^ (bytes * '#'));
+    m->quote |= FIO___JSON_SWAR_PACK(fio___json_swar_zero(w ^ (bytes * '"')))
+                << i;
+    m->backslash |=
+        FIO___JSON_SWAR_PACK(fio___json_swar_zero(w ^ (bytes * '\\'))) << i;
+    m->space |= FIO___JSON_SWAR_PACK(s) << i;
+    m->op |= FIO___JSON_SWAR_PACK(o) << i;
+    m->comment |= FIO___JSON_SWAR_PACK(c) << i;
+  }
+}
+#undef FIO___JSON_SWAR_PACK
+#endif /* FIO___HAS_X86_INTRIN / FIO___HAS_ARM_INTRIN */
+
+/* sets every bit between an odd and an even set bit (string contents). */
+FIO_IFUNC uint64_t fio___json_prefix_xor(uint64_t x) {
+#if FIO___HAS_X86_INTRIN && defined(__PCLMUL__)
+  return (uint64_t)_mm_cvtsi128_si64(
+      _mm_clmulepi64_si128(_mm_set_epi64x(0, (long long)x),
+                           _mm_set1_epi8((char)0xFF),
+                           0));
+#else
+  x ^= x << 1;
+  x ^= x << 2;
+  x ^= x << 4;
+  x ^= x << 8;
+  x ^= x << 16;
+  x ^= x << 32;
+  return x;
+#endif
+}
+
+/* returns the first byte following a comment (for EOL comments, the EOL). */
+FIO_SFUNC const char *fio___json_index_comment(const char *p, const char *end) {
+  if (*p == '#' || p[1] == '/') {
+    p = (const char *)FIO_MEMCHR(p, '\n', (size_t)(end - p));
+    return (p ? p : end);
+  }
+  for (p += 2; p + 1 < end; ++p) {
+    if (p[0] == '*' && p[1] == '/')
+      return p + 2;
+  }
+  return end;
+}
+
+/* indexes the next 64 bytes (or more, for comments), one byte at a time. */
+FIO_SFUNC void fio___json_index_bytes(fio___json_index_s *ix) {
+  const char *p = ix->pos;
+  const char *stop = (ix->end - p > 64) ? p + 64 : ix->end;
+  uint64_t in_string = ix->in_string & 1;
+  uint64_t escaped = ix->escaped;
+  uint64_t scalar = ix->scalar;
+  while (p < stop) {
+    const uint32_t offset = (uint32_t)(p - ix->start);
+    if (in_string) {
+      if (escaped) {
+        escaped = 0;
+      } else if (*p == '\\') {
+        escaped = 1;
+        ix->string_escaped = FIO___JSON_INDEX_ESCAPED;
+      } else if (*p == '"') {
+        ix->at[ix->count++] = offset | ix->string_escaped;
+        ix->string_escaped = 0;
+        in_string = 0;
+      }
+      scalar = 0;
+      ++p;
+      continue;
+    }
+    switch (*p) {
+    case 0x09: /* fall through */
+    case 0x0A: /* fall through */
+    case 0x0D: /* fall through */
+    case 0x20: scalar = 0; break;
+    case '"': in_string = 1; /* fall through */
+    case '{':                /* fall through */
+    case '}':                /* fall through */
+    case '[':                /* fall through */
+    case ']':                /* fall through */
+    case ':':                /* fall through */
+    case ',':
+      ix->at[ix->count++] = offset;
+      scalar = 0;
+      break;
+    case '#':
+      p = fio___json_index_comment(p, ix->end);
+      scalar = 0;
+      continue;
+    case '/':
+      if (p + 1 < ix->end && (p[1] == '/' || p[1] == '*')) {
+        p = fio___json_index_comment(p, ix->end);
+        scalar = 0;
+        continue;
+      }
+      /* fall through */
+    default:
+      if (!scalar)
+        ix->at[ix->count++] = offset;
+      scalar = 1;
+    }
+    ++p;
+  }
+  ix->pos = p;
+  ix->in_string = (uint64_t)0 - in_string;
+  ix->escaped = escaped;
+  ix->scalar = scalar;
+}
+
+/* indexes the next 64 bytes (stage one). */
+FIO_SFUNC void fio___json_index_block(fio___json_index_s *ix) {
+  const uint64_t even = UINT64_C(0x5555555555555555);
+  char tmp[64] FIO_ALIGN(16);
+  const char *p = ix->pos;
+  const uint32_t offset = (uint32_t)(p - ix->start);
+  const size_t len = (size_t)(ix->end - p);
+  uint32_t *dest = ix->at + ix->count;
+  fio___json_bitmap_s m;
+  uint64_t bs, follows, seq, escaped, quote, in_string, scalar, bits, clean, c;
+  if (len < 64) { /* pad with white space */
+    FIO_MEMSET(tmp, ' ', 64);
+    FIO_MEMCPY(tmp, p, len);
+    p = tmp;
+  }
+  fio___json_classify(&m, p);
+  /* escaped bytes follow an odd sequence of backslashes */
+  bs = m.backslash & ~ix->escaped;
+  follows = (bs << 1) | ix->escaped;
+  seq = (bs & ~even & ~follows) + bs;
+  escaped = (even ^ (seq << 1)) & follows;
+  quote = m.quote & ~escaped;
+  in_string = fio___json_prefix_xor(quote) ^ ix->in_string;
+  if (FIO_UNLIKELY(m.comment & ~in_string)) {
+    fio___json_index_bytes(ix);
+    return;
+  }
+  ix->escaped = (seq < bs);
+  /* closing quotes reached by a carry (from the opening quote) are clean */
+  c = in_string & ~m.backslash;
+  clean = c + (quote & in_string);
+  bits = (clean < c);
+  c = clean;
+  clean += (ix->in_string & 1) & !ix->string_escaped;
+  bits |= (clean < c);
+  ix->in_string = (uint64_t)((int64_t)in_string >> 63);
+  ix->string_escaped = (uint32_t)(ix->in_string & (bits ^ 1)) << 31;
+  clean = quote & ~in_string & ~clean; /* closing quotes with a backslash */
+  /* the first byte of every value that isn't a string or a collection */
+  scalar = ~(m.op | m.space | quote);
+  bits = scalar & ~((scalar << 1) | ix->scalar);
+  ix->scalar = scalar >> 63;
+  bits = ((m.op | bits) & ~in_string) | quote;
+  ix->pos = (len < 64) ? ix->end : ix->pos + 64;
+  c = (uint64_t)fio_popcount(bits);
+  ix->count += (uint32_t)c;
+  /* writes 8 entries at a time (extra entries are ignored / overwritten) */
+  for (;;) {
+    for (size_t k = 0; k < 8; ++k) {
+      const uint32_t i =
+          (uint32_t)fio_lsb_index_unsafe(bits | ((uint64_t)1 << 63));
+      bits &= bits - 1;
+      dest[k] = (offset + i) | ((uint32_t)(clean >> i) << 31);
+    }
+    if (c <= 8)
+      return;
+    c -= 8;
+    dest += 8;
+  }
+}
+
+/* collects the next round of index entries, returns the number of entries. */
+FIO_SFUNC uint32_t fio___json_index_fill(fio___json_index_s *ix) {
+  ix->count = ix->read = 0;
+  while (ix->pos < ix->end &&
+         ix->count + FIO___JSON_INDEX_BLOCK <= FIO_JSON_INDEX_SIZE)
+    fio___json_index_block(ix);
+  return ix->count;
+}
+
+/* returns the next index entry (a position), or -1 at the end of the data. */
+FIO_IFUNC int64_t fio___json_index_next(fio___json_index_s *ix) {
+  if (FIO_UNLIKELY(ix->read == ix->count) && !fio___json_index_fill(ix))
+    return -1;
+  return (int64_t)ix->at[ix->read++];
+}
+
+/* parses a single JSON value using the structural index (stage two). */
+FIO_SFUNC void *fio___json_consume_indexed(fio___json_state_s *s) {
+  fio___json_index_s ix;
+  fio___json_frame_s stack[FIO_JSON_MAX_DEPTH];
+  fio___json_frame_s *f = NULL;
+  const char *p = s->pos;
+  const char *after;
+  void *value = NULL;
+  int64_t e;
+  ix.start = ix.pos = s->pos;
+  ix.end = s->end;
+  ix.in_string = ix.escaped = ix.scalar = 0;
+  ix.string_escaped = ix.count = ix.read = 0;
+
+  if ((e = fio___json_index_next(&ix)) < 0)
+    goto error;
+  p = ix.start + e;
+
+parse_value:
+  switch (*p) {
+  case '{': /* fall through */
+  case '[':
+    if (s->depth + 1 >= FIO_JSON_MAX_DEPTH)
+      goto error;
+    f = stack + s->depth++;
+    f->key = NULL;
+    f->close = (uintptr_t)(*p + 2); /* '{' + 2 == '}', '[' + 2 == ']' */
+    f->ctx = (*p == '{' ? s->cb.on_map : s->cb.on_array)(s, s->key);
+    s->key = NULL;
+    if ((e = fio___json_index_next(&ix)) < 0)
+      goto error;
+    p = ix.start + e;
+    if ((uintptr_t)*p == f->close)
+      goto collection_done;
+    if (f->close == '}')
+      goto parse_key;
+    goto parse_value;
+  case '"':
+    if ((e = fio___json_index_next(&ix)) < 0)
+      goto error;
+    after = ix.start + (e & ~(int64_t)FIO___JSON_INDEX_ESCAPED);
+    value = ((e & FIO___JSON_INDEX_ESCAPED) ? s->cb.on_string
+                                            : s->cb.on_string_simple)(
+        p + 1,
+        (size_t)(after - (p + 1)));
+    ++after;
+    break;
+  case '}': /* fall through */
+  case ']': /* fall through */
+  case ':': /* fall through */
+  case ',': goto error;
+  default:
+    s->pos = p;
+    value = fio___json_consume(s);
+    after = s->pos;
+  }
+
+value_done:
+  if (!s->depth) {
+    s->pos = after;
+    return value;
+  }
+  f = stack + s->depth - 1;
+  if (f->close == '}') {
+    if (value)
+      s->error |= s->cb.map_push(f->ctx, f->key, value);
+    else
+      s->cb.free_unused_object(f->key);
+    f->key = s->key = NULL;
+  } else if (value) {
+    s->error |= s->cb.array_push(f->ctx, value);
+  }
+  value = NULL;
+  if (s->error || (e = fio___json_index_next(&ix)) < 0)
+    goto error;
+  p = ix.start + e;
+  if (after < p && !(((uint8_t)*after == 0x09U) | ((uint8_t)*after == 0x0AU) |
+                     ((uint8_t)*after == 0x0DU) | ((uint8_t)*after == 0x20U)))
+    goto error; /* value followed by garbage */
+  if ((uintptr_t)*p == f->close)
+    goto collection_done;
+  if (*p != ',' || (e = fio___json_index_next(&ix)) < 0)
+    goto error;
+  p = ix.start + e;
+  if ((uintptr_t)*p == f->close) /* trailing comma */
+    goto collection_done;
+  if (f->close == ']')
+    goto parse_value;
+
+parse_key:
+  switch (*p) {
+  case '"':
+    if ((e = fio___json_index_next(&ix)) < 0)
+      goto error;
+    after = ix.start + (e & ~(int64_t)FIO___JSON_INDEX_ESCAPED);
+    f->key = ((e & FIO___JSON_INDEX_ESCAPED) ? s->cb.on_string
+                                             : s->cb.on_string_simple)(
+        p + 1,
+        (size_t)(after - (p + 1)));
+    ++after;
+    break;
+  case '{': /* fall through */
+  case '}': /* fall through */
+  case '[': /* fall through */
+  case ']': /* fall through */
+  case ':': /* fall through */
+  case ',': goto error;
+  default:
+    s->pos = p;
+    f->key = fio___json_consume(s);
+    after = s->pos;
+  }
+  if (s->error || !(s->key = f->key) || (e = fio___json_index_next(&ix)) < 0)
+    goto error;
+  p = ix.start + e;
+  if (*p != ':' ||
+      (after < p && !(((uint8_t)*after == 0x09U) | ((uint8_t)*after == 0x0AU) |
+                      ((uint8_t)*after == 0x0DU) | ((uint8_t)*after == 0x20U))))
+    goto error;
+  if ((e = fio___json_index_next(&ix)) < 0)
+    goto error;
+  p = ix.start + e;
+  goto parse_value;
+
+collection_done:
+  --s->depth;
+  s->error |= (f->close == '}' ? s->cb.map_finished : s->cb.array_finished)(
+      f->ctx);
+  value = f->ctx;
+  after = p + 1;
+  goto value_done;
+
+error:
+  /* close any open collections, adding each to its parent (as in recursion) */
+  s->error = 1;
+  s->pos = p;
+  while (s->depth) {
+    f = stack + --s->depth;
+    if (value) {
+      if (f->close == ']')
+        s->cb.array_push(f->ctx, value);
+      else if (f->key)
+        s->cb.map_push(f->ctx, f->key, value);
+      else
+        s->cb.free_unused_object(value);
+      f->key = NULL;
+    }
+    if (f->key)
+      s->cb.free_unused_object(f->key);
+    (f->close == '}' ? s->cb.map_finished : s->cb.array_finished)(f->ctx);
+    value = f->ctx;
+  }
+  return value;
+}
+#undef FIO___JSON_INDEX_BLOCK
+#endif /* FIO_JSON_USE_INDEX */
+
 static int fio___json_callback_noop(void *ctx) {
   return 0;
   (void)ctx;
@@ -10704,7 +12736,12 @@ SFUNC fio_json_result_s fio_json_parse(fio_json_parser_callbacks_s *callbacks,
     if (len == 3)
       goto finish;
   }
-  r.ctx = fio___json_consume(&state);
+#if FIO_JSON_USE_INDEX
+  if (len >= FIO_JSON_INDEX_MIN && len < ((size_t)1 << 31))
+    r.ctx = fio___json_consume_indexed(&state);
+  else
+#endif
+    r.ctx = fio___json_consume(&state);
   r.err = state.error;
   r.stop_pos = state.pos - start;
   if (state.error)
@@ -10812,6 +12849,565 @@ missing_callback:
   r.err = 1;
   return r;
 }
+
+/* *****************************************************************************
+JSON Streaming (Push) Parser - Implementation
+
+The stream is a state machine, fed byte ranges of any length. Collections are
+tracked using an explicit (heap allocated) stack, so nesting is limited only by
+`max_depth`. Strings and scalars (numbers, `true`, `null`, etc') found within a
+single chunk are parsed in place. Tokens that span chunks are copied to a
+token buffer (limited to `max_token` bytes) until they are complete.
+
+Scalars are complete once a delimiter is found, so a top-level scalar at the
+end of the data is only completed by `fio_json_stream_finish`.
+***************************************************************************** */
+
+/* stream states */
+typedef enum {
+  /* expecting a value (top-level, after `:` or after `,` in an array) */
+  FIO___JSON_STREAM_VALUE = 0,
+  /* expecting a value or `]` (after `[` or after `,` in an array) */
+  FIO___JSON_STREAM_VALUE_OR_CLOSE,
+  /* expecting a key or `}` (after `{` or after `,` in a map) */
+  FIO___JSON_STREAM_KEY_OR_CLOSE,
+  /* expecting `:` */
+  FIO___JSON_STREAM_COLON,
+  /* expecting `,` or the end of the collection */
+  FIO___JSON_STREAM_NEXT,
+  /* top-level value was parsed (JSON mode), expecting only white space */
+  FIO___JSON_STREAM_DONE,
+  /* in a string */
+  FIO___JSON_STREAM_STRING,
+  /* in a scalar (number, `true`, etc') */
+  FIO___JSON_STREAM_SCALAR,
+  /* a `/` was found, expecting `/` or `*` */
+  FIO___JSON_STREAM_COMMENT_START,
+  /* in an EOL comment */
+  FIO___JSON_STREAM_COMMENT_LINE,
+  /* in a C style comment */
+  FIO___JSON_STREAM_COMMENT_BLOCK,
+  /* skipping an invalid NDJSON line */
+  FIO___JSON_STREAM_SKIP_LINE,
+  /* parsing failed (JSON mode), waiting for `fio_json_stream_finish` */
+  FIO___JSON_STREAM_ERROR,
+} fio___json_stream_state_e;
+
+struct fio_json_stream_s {
+  /* the parser state used for scalars (and passed to `on_map` / `on_array`) */
+  fio___json_state_s parser;
+  void (*on_json)(void *udata, void *value);
+  void *udata;
+  /* open collections */
+  fio___json_frame_s *stack;
+  /* token buffer, for tokens that span chunks (NUL terminated) */
+  char *token;
+  size_t token_capa;
+  uint32_t token_len;
+  uint32_t max_token;
+  uint32_t depth;
+  uint32_t stack_capa;
+  uint32_t max_depth;
+  /* a `fio___json_stream_state_e` value */
+  uint8_t state;
+  /* the state to resume once a comment ends */
+  uint8_t resume;
+  /* the string / scalar being parsed is a map key */
+  uint8_t is_key;
+  /* the last string byte was a backslash */
+  uint8_t escaped;
+  /* the string contains escaped characters */
+  uint8_t has_escape;
+  /* the last C style comment byte was a star */
+  uint8_t star;
+  uint8_t ndjson;
+  /* the number of BOM bytes skipped (3 once a non-BOM byte was found) */
+  uint8_t bom;
+};
+
+/* appends data to the token buffer, returns -1 if the token is too long. */
+FIO_SFUNC int fio___json_stream_token_write(fio_json_stream_s *s,
+                                            const char *buf,
+                                            size_t len) {
+  size_t need = (size_t)s->token_len + len;
+  if (need > s->max_token)
+    return -1;
+  if (need >= s->token_capa) {
+    size_t capa = (need + 1 + 4095) & ~(size_t)4095;
+    char *tmp =
+        (char *)FIO_MEM_REALLOC_(s->token, s->token_capa, capa, s->token_len);
+    if (!tmp)
+      return -1;
+    s->token = tmp;
+    s->token_capa = capa;
+  }
+  FIO_MEMCPY(s->token + s->token_len, buf, len);
+  s->token_len = (uint32_t)need;
+  s->token[need] = 0;
+  return 0;
+}
+
+/* parses a complete scalar token (followed by a delimiter or NUL). */
+FIO_SFUNC int fio___json_stream_scalar(fio_json_stream_s *s,
+                                       void **value,
+                                       const char *token,
+                                       size_t len) {
+  s->parser.pos = token;
+  s->parser.end = token + len;
+  s->parser.error = 0;
+  *value = fio___json_consume(&s->parser);
+  if (!s->parser.error && s->parser.pos == s->parser.end)
+    return 0;
+  if (*value)
+    s->parser.cb.free_unused_object(*value);
+  *value = NULL;
+  return -1;
+}
+
+/* routes a complete value to its collection (or to `on_json`). */
+FIO_SFUNC int fio___json_stream_push(fio_json_stream_s *s, void *value) {
+  fio___json_frame_s *f;
+  int err = 0;
+  if (!s->depth) {
+    if (s->on_json)
+      s->on_json(s->udata, value);
+    else if (value)
+      s->parser.cb.free_unused_object(value);
+    s->state = (s->ndjson ? FIO___JSON_STREAM_VALUE : FIO___JSON_STREAM_DONE);
+    return 0;
+  }
+  f = s->stack + s->depth - 1;
+  s->state = FIO___JSON_STREAM_NEXT;
+  if (f->close == '}') {
+    if (value)
+      err = s->parser.cb.map_push(f->ctx, f->key, value);
+    else
+      s->parser.cb.free_unused_object(f->key);
+    f->key = NULL;
+    return err;
+  }
+  if (value)
+    err = s->parser.cb.array_push(f->ctx, value);
+  return err;
+}
+
+/* closes open collections (passing the result to `on_error`), and returns
+ * the position where parsing should resume. */
+FIO_SFUNC const char *fio___json_stream_fail(fio_json_stream_s *s,
+                                             void *value,
+                                             const char *pos,
+                                             const char *end) {
+  fio___json_frame_s *f;
+  while (s->depth) {
+    f = s->stack + --s->depth;
+    if (value) {
+      if (f->close == ']')
+        s->parser.cb.array_push(f->ctx, value);
+      else if (f->key)
+        s->parser.cb.map_push(f->ctx, f->key, value);
+      else
+        s->parser.cb.free_unused_object(value);
+      f->key = NULL;
+    }
+    if (f->key)
+      s->parser.cb.free_unused_object(f->key);
+    (f->close == '}' ? s->parser.cb.map_finished
+                     : s->parser.cb.array_finished)(f->ctx);
+    value = f->ctx;
+  }
+  if (value)
+    s->parser.cb.on_error(value);
+  s->token_len = 0;
+  s->is_key = 0;
+  if (!s->ndjson) {
+    s->state = FIO___JSON_STREAM_ERROR;
+    return end;
+  }
+  if (pos < end && *pos == '\n') {
+    s->state = FIO___JSON_STREAM_VALUE;
+    return pos + 1;
+  }
+  s->state = FIO___JSON_STREAM_SKIP_LINE;
+  return pos;
+}
+
+/* resets the stream, discarding any incomplete data. */
+FIO_SFUNC void fio___json_stream_reset(fio_json_stream_s *s) {
+  if (s->depth)
+    fio___json_stream_fail(s, NULL, NULL, NULL);
+  s->state = FIO___JSON_STREAM_VALUE;
+  s->token_len = 0;
+  s->is_key = s->escaped = s->has_escape = s->star = s->bom = 0;
+}
+
+/** Creates a new resumable (push) JSON parser. Returns NULL on error. */
+SFUNC fio_json_stream_s *fio_json_stream_new FIO_NOOP(
+    fio_json_stream_args_s args) {
+  fio_json_stream_s *s;
+  if (fio___json_callbacks_validate(args.callbacks))
+    goto missing_callback;
+  s = (fio_json_stream_s *)FIO_MEM_REALLOC_(NULL, 0, sizeof(*s), 0);
+  if (!s)
+    return s;
+  *s = (fio_json_stream_s){
+      .parser = {.cb = args.callbacks[0]},
+      .on_json = args.on_json,
+      .udata = args.udata,
+      .max_token = (args.max_token ? args.max_token
+                                   : (uint32_t)FIO_JSON_STREAM_MAX_TOKEN),
+      .max_depth = (args.max_depth ? args.max_depth : FIO_JSON_MAX_DEPTH),
+      .ndjson = (uint8_t)!!args.ndjson,
+  };
+  return s;
+missing_callback:
+  FIO_LOG_ERROR("JSON parser missing a critical callback!");
+  return NULL;
+}
+
+/** Frees the stream, discarding (freeing) any incomplete data. */
+SFUNC void fio_json_stream_free(fio_json_stream_s *s) {
+  if (!s)
+    return;
+  fio___json_stream_reset(s);
+  FIO_MEM_FREE_(s->stack, sizeof(*s->stack) * s->stack_capa);
+  FIO_MEM_FREE_(s->token, s->token_capa);
+  FIO_MEM_FREE_(s, sizeof(*s));
+}
+
+/** Parses the next chunk of JSON data. Returns -1 if an error occurred. */
+SFUNC int fio_json_stream_write(fio_json_stream_s *s,
+                                const void *buf,
+                                size_t len) {
+  const char *pos = (const char *)buf;
+  const char *end = pos + len;
+  const char *start = pos; /* start of a string / scalar in this chunk */
+  const char *tmp;
+  const char *quote;
+  const char *esc;
+  const char *token;
+  fio___json_frame_s *f;
+  void *value;
+  size_t token_len;
+  int r = 0;
+  if (!s || (!buf && len))
+    return -1;
+  if (s->state == FIO___JSON_STREAM_ERROR)
+    return -1;
+  if (s->bom < 3) { /* skip BOM, if exists (might be split between chunks) */
+    while (s->bom < 3 && pos < end && *pos == "\xEF\xBB\xBF"[s->bom]) {
+      ++pos;
+      ++s->bom;
+    }
+    if (pos < end)
+      s->bom = 3;
+  }
+
+  while (pos < end) {
+    value = NULL;
+    switch ((fio___json_stream_state_e)s->state) {
+    case FIO___JSON_STREAM_STRING:
+      tmp = pos;
+      quote = NULL;
+      for (;;) {
+        if (s->escaped) { /* skip the escaped byte */
+          s->escaped = 0;
+          if (++pos == end)
+            break;
+        }
+        if (!quote || quote < pos) { /* (re)search for the closing quote */
+          quote = (const char *)FIO_MEMCHR(pos, '"', (size_t)(end - pos));
+          if (!quote)
+            quote = end;
+        }
+        esc = (const char *)FIO_MEMCHR(pos, '\\', (size_t)(quote - pos));
+        if (!esc) {
+          pos = quote;
+          break;
+        }
+        s->has_escape = 1;
+        s->escaped = 1;
+        pos = esc + 1;
+        if (pos == end)
+          break;
+      }
+      if (s->ndjson && (tmp = (const char *)FIO_MEMCHR(tmp,
+                                                       '\n',
+                                                       (size_t)(pos - tmp)))) {
+        pos = tmp; /* strings can't span NDJSON lines */
+        goto error;
+      }
+      if (pos == end)
+        continue; /* the string continues in the next chunk */
+      token = start;
+      token_len = (size_t)(pos - start);
+      if (s->token_len) {
+        if (fio___json_stream_token_write(s, start, token_len))
+          goto error;
+        token = s->token;
+        token_len = s->token_len;
+      }
+      value = (s->has_escape ? s->parser.cb.on_string
+                             : s->parser.cb.on_string_simple)(token, token_len);
+      s->token_len = 0;
+      ++pos;
+      goto value_done;
+
+    case FIO___JSON_STREAM_SCALAR:
+      for (; pos < end; ++pos) {
+        switch (*pos) {
+        case 0x09: /* fall through */
+        case 0x0A: /* fall through */
+        case 0x0D: /* fall through */
+        case 0x20: /* fall through */
+        case ',':  /* fall through */
+        case ':':  /* fall through */
+        case '[':  /* fall through */
+        case ']':  /* fall through */
+        case '{':  /* fall through */
+        case '}':  /* fall through */
+        case '"':  /* fall through */
+        case '/':  /* fall through */
+        case '#': goto scalar_done;
+        }
+      }
+      continue; /* the scalar continues in the next chunk */
+    scalar_done:
+      token = start;
+      token_len = (size_t)(pos - start);
+      if (s->token_len) {
+        if (fio___json_stream_token_write(s, start, token_len))
+          goto error;
+        token = s->token;
+        token_len = s->token_len;
+      }
+      if (fio___json_stream_scalar(s, &value, token, token_len))
+        goto error;
+      s->token_len = 0;
+      goto value_done;
+
+    case FIO___JSON_STREAM_COMMENT_START:
+      if (*pos == '/')
+        s->state = FIO___JSON_STREAM_COMMENT_LINE;
+      else if (*pos == '*')
+        s->state = FIO___JSON_STREAM_COMMENT_BLOCK;
+      else
+        goto error;
+      s->star = 0;
+      ++pos;
+      continue;
+
+    case FIO___JSON_STREAM_COMMENT_LINE:
+      tmp = (const char *)FIO_MEMCHR(pos, '\n', (size_t)(end - pos));
+      if (!tmp) {
+        pos = end;
+        continue;
+      }
+      pos = tmp; /* the new line is consumed as white space */
+      s->state = s->resume;
+      continue;
+
+    case FIO___JSON_STREAM_COMMENT_BLOCK:
+      while (pos < end) {
+        const char c = *(pos++);
+        if (s->star && c == '/') {
+          s->state = s->resume;
+          break;
+        }
+        s->star = (c == '*');
+      }
+      continue;
+
+    case FIO___JSON_STREAM_SKIP_LINE:
+      tmp = (const char *)FIO_MEMCHR(pos, '\n', (size_t)(end - pos));
+      if (!tmp) {
+        pos = end;
+        continue;
+      }
+      pos = tmp + 1;
+      s->state = FIO___JSON_STREAM_VALUE;
+      continue;
+
+    case FIO___JSON_STREAM_ERROR: return -1;
+
+    case FIO___JSON_STREAM_VALUE:          /* fall through */
+    case FIO___JSON_STREAM_VALUE_OR_CLOSE: /* fall through */
+    case FIO___JSON_STREAM_KEY_OR_CLOSE:   /* fall through */
+    case FIO___JSON_STREAM_COLON:          /* fall through */
+    case FIO___JSON_STREAM_NEXT:           /* fall through */
+    case FIO___JSON_STREAM_DONE: break;
+    }
+
+    /* states expecting white space, a structural character or a value */
+    switch (*pos) {
+    case 0x0A:
+      if (s->ndjson && s->depth)
+        goto error; /* values can't span NDJSON lines */
+      /* fall through */
+    case 0x09: /* fall through */
+    case 0x0D: /* fall through */
+    case 0x20: ++pos; continue;
+    case '#':
+      s->resume = s->state;
+      s->state = FIO___JSON_STREAM_COMMENT_LINE;
+      ++pos;
+      continue;
+    case '/':
+      s->resume = s->state;
+      s->state = FIO___JSON_STREAM_COMMENT_START;
+      ++pos;
+      continue;
+    }
+    switch ((fio___json_stream_state_e)s->state) {
+    case FIO___JSON_STREAM_NEXT:
+      f = s->stack + s->depth - 1;
+      if ((uintptr_t)*pos == f->close)
+        goto collection_done;
+      if (*pos != ',')
+        goto error;
+      s->state = (f->close == '}' ? FIO___JSON_STREAM_KEY_OR_CLOSE
+                                  : FIO___JSON_STREAM_VALUE_OR_CLOSE);
+      ++pos;
+      continue;
+    case FIO___JSON_STREAM_COLON:
+      if (*pos != ':')
+        goto error;
+      s->state = FIO___JSON_STREAM_VALUE;
+      ++pos;
+      continue;
+    case FIO___JSON_STREAM_KEY_OR_CLOSE:
+      switch (*pos) {
+      case '}': goto collection_done;
+      case '{': /* fall through */
+      case '[': /* fall through */
+      case ']': /* fall through */
+      case ':': /* fall through */
+      case ',': goto error;
+      }
+      s->is_key = 1;
+      if (*pos == '"')
+        goto string_start;
+      goto scalar_start;
+    case FIO___JSON_STREAM_VALUE_OR_CLOSE:
+      if (*pos == ']')
+        goto collection_done;
+      /* fall through */
+    case FIO___JSON_STREAM_VALUE:
+      switch (*pos) {
+      case '{': /* fall through */
+      case '[': goto collection_start;
+      case '"': goto string_start;
+      case '}': /* fall through */
+      case ']': /* fall through */
+      case ':': /* fall through */
+      case ',': goto error;
+      }
+      goto scalar_start;
+    default: goto error;
+    }
+
+  string_start:
+    s->state = FIO___JSON_STREAM_STRING;
+    s->escaped = s->has_escape = 0;
+    start = ++pos;
+    continue;
+
+  scalar_start:
+    s->state = FIO___JSON_STREAM_SCALAR;
+    start = pos;
+    continue;
+
+  collection_start:
+    if (s->depth == s->max_depth)
+      goto error;
+    if (s->depth == s->stack_capa) {
+      uint32_t capa = (s->stack_capa ? (s->stack_capa << 1) : 8);
+      if (capa > s->max_depth)
+        capa = s->max_depth;
+      f = (fio___json_frame_s *)FIO_MEM_REALLOC_(
+          s->stack,
+          sizeof(*s->stack) * s->stack_capa,
+          sizeof(*s->stack) * capa,
+          sizeof(*s->stack) * s->depth);
+      if (!f)
+        goto error;
+      s->stack = f;
+      s->stack_capa = capa;
+    }
+    f = s->stack + s->depth;
+    f->key = NULL;
+    f->close = (uintptr_t)(*pos + 2); /* '{' + 2 == '}', '[' + 2 == ']' */
+    f->ctx = (*pos == '{' ? s->parser.cb.on_map : s->parser.cb.on_array)(
+        &s->parser,
+        (s->depth ? f[-1].key : NULL));
+    ++s->depth;
+    s->state = (*pos == '{' ? FIO___JSON_STREAM_KEY_OR_CLOSE
+                            : FIO___JSON_STREAM_VALUE_OR_CLOSE);
+    ++pos;
+    continue;
+
+  collection_done:
+    f = s->stack + --s->depth;
+    value = f->ctx;
+    ++pos;
+    if ((f->close == '}' ? s->parser.cb.map_finished
+                         : s->parser.cb.array_finished)(value))
+      goto error;
+
+  value_done:
+    if (s->is_key) {
+      s->is_key = 0;
+      if (!value)
+        goto error;
+      s->stack[s->depth - 1].key = value;
+      s->state = FIO___JSON_STREAM_COLON;
+      continue;
+    }
+    if (fio___json_stream_push(s, value)) {
+      value = NULL;
+      goto error;
+    }
+    continue;
+
+  error:
+    r = -1;
+    pos = fio___json_stream_fail(s, value, pos, end);
+    start = pos;
+  }
+
+  /* copy any incomplete string / scalar to the token buffer */
+  if ((s->state == FIO___JSON_STREAM_STRING ||
+       s->state == FIO___JSON_STREAM_SCALAR) &&
+      fio___json_stream_token_write(s, start, (size_t)(end - start))) {
+    r = -1;
+    fio___json_stream_fail(s, NULL, end, end);
+  }
+  return r;
+}
+
+/** Marks the end of the input, completing a trailing top-level scalar. */
+SFUNC int fio_json_stream_finish(fio_json_stream_s *s) {
+  void *value = NULL;
+  int r = 0;
+  uint8_t state;
+  if (!s)
+    return -1;
+  if (s->state == FIO___JSON_STREAM_SCALAR && !s->depth && !s->is_key) {
+    if (fio___json_stream_scalar(s, &value, s->token, s->token_len))
+      s->state = FIO___JSON_STREAM_ERROR;
+    else
+      fio___json_stream_push(s, value);
+  }
+  state = (s->state == FIO___JSON_STREAM_COMMENT_LINE ? s->resume : s->state);
+  if (s->depth || (s->ndjson ? (state != FIO___JSON_STREAM_VALUE &&
+                                state != FIO___JSON_STREAM_SKIP_LINE)
+                             : (state != FIO___JSON_STREAM_DONE))) {
+    r = -1;
+    if (s->depth)
+      fio___json_stream_fail(s, NULL, NULL, NULL);
+  }
+  fio___json_stream_reset(s);
+  return r;
+}
 #endif /* FIO_EXTERN_COMPLETE */
 #undef FIO_JSON
 #endif /* FIO_JSON */
@@ -20224,9 +22820,28 @@ SFUNC int fio_string_write_escape(fio_str_info_s *restrict dest,
        reallocate(dest,
                   fio_string_capa4len(dest->len + extra_space + len + 3)))) {
     r = -1;
-    len = dest->capa - (dest->len + 6);
-    if (dest->capa < len + 6)
+    if (dest->capa <= dest->len)
       return r;
+    /* truncate the source to the (escaped) bytes that fit */
+    extra_space = dest->capa - (dest->len + 1);
+    for (p = s; p < e;) {
+      size_t step = 1, need = 1;
+      if (!(escape_map[*p] & 64)) {
+        need = step = fio_utf8_char_len(p);
+        if (step < 2) {
+          step = 1;
+          need = 2 + ((escape_map[*p] - 1) & (3 + ((*p < 127) << 1)));
+        }
+      }
+      if (need > extra_space || step > (size_t)(e - p))
+        break;
+      extra_space -= need;
+      p += step;
+    }
+    len = (size_t)(p - s);
+    e = p;
+    if (first_stop > len)
+      first_stop = len;
   }
 
   /* copy unescaped head of string (if it's worth our time) */
@@ -21338,6 +23953,932 @@ String Core Cleanup
 /* ************************************************************************* */
 #if !defined(FIO_INCLUDE_FILE) /* Dev test - ignore line */
 #define FIO___DEV___           /* Development inclusion - ignore line */
+#define FIO_JSON_SCHEMA module /* Development inclusion - ignore line */
+#include "./include.h"         /* Development inclusion - ignore line */
+#endif                         /* Development inclusion - ignore line */
+/* *****************************************************************************
+
+
+
+
+                  JSON Schema - JSON to / from C structs
+
+
+
+
+Copyright and License: see header file (000 copyright.h) or top of file
+***************************************************************************** */
+#if defined(FIO_JSON_SCHEMA) && !defined(H___FIO_JSON_SCHEMA___H)
+#define H___FIO_JSON_SCHEMA___H
+
+/* *****************************************************************************
+Settings
+***************************************************************************** */
+
+#ifndef FIO_JSON_SCHEMA_MAX_DEPTH
+/** The maximum nesting depth of objects (structs) within a schema. */
+#define FIO_JSON_SCHEMA_MAX_DEPTH 32
+#endif
+
+/** The maximum number of fields in a schema (per struct). */
+#define FIO_JSON_SCHEMA_MAX_FIELDS 64
+
+/* *****************************************************************************
+JSON Schema - API
+***************************************************************************** */
+
+/** The C type of a schema field (use the `FIO_JSON_FIELD_*` macros). */
+typedef enum {
+  /** `bool` or any unsigned integer type (`true` / `false`). */
+  FIO_JSON_SCHEMA_BOOL = 1,
+  /** A signed integer (`int8_t` ... `int64_t`), range checked. */
+  FIO_JSON_SCHEMA_INT,
+  /** An unsigned integer (`uint8_t` ... `uint64_t`), range checked. */
+  FIO_JSON_SCHEMA_UINT,
+  /** A `float` or a `double`. */
+  FIO_JSON_SCHEMA_FLOAT,
+  /** A `char` array (the String, NUL terminated, must fit). */
+  FIO_JSON_SCHEMA_STR,
+  /** A `char *` `fio_bstr` (allocated, see `fio_bstr_free`). */
+  FIO_JSON_SCHEMA_BSTR,
+  /** A nested struct, described by its own schema. */
+  FIO_JSON_SCHEMA_OBJ,
+} fio_json_schema_type_e;
+
+typedef struct fio_json_schema_s fio_json_schema_s;
+
+/** A schema field - describes a struct member and its JSON key. */
+typedef struct {
+  /** The struct member's name (also the JSON key, unless `key` is set). */
+  const char *name;
+  /** The struct member's offset (`offsetof`). */
+  size_t offset;
+  /** The struct member's size (`sizeof`). */
+  size_t size;
+  /** The struct member's type. */
+  fio_json_schema_type_e type;
+  /** The nested struct's schema (`FIO_JSON_SCHEMA_OBJ`). */
+  fio_json_schema_s *schema;
+  /** The JSON key, if it differs from the struct member's name. */
+  const char *key;
+  /** If set, parsing fails when the field is missing (or `null`). */
+  uint8_t required;
+  /** The value set when the field is missing (or `null`). */
+  union {
+    int64_t i;
+    uint64_t u;
+    double f;
+    const char *s;
+  } def;
+} fio_json_schema_field_s;
+
+/** A schema - describes a struct (use `FIO_JSON_SCHEMA_NAME` to create). */
+struct fio_json_schema_s {
+  /** The struct's fields. */
+  const fio_json_schema_field_s *fields;
+  /** The number of fields (up to `FIO_JSON_SCHEMA_MAX_FIELDS`). */
+  uint32_t count;
+  /** If set, unknown JSON keys are errors (otherwise they are skipped). */
+  uint8_t strict;
+  /* internal: set by `fio_json_schema_prepare` */
+  volatile uint8_t ready;
+  /* internal: guards `fio_json_schema_prepare` */
+  fio_lock_i lock;
+  /* internal: perfect hash table size bits (0 == linear key search) */
+  uint8_t bits;
+  /* internal: perfect hash seed */
+  uint64_t seed;
+  /* internal: perfect hash table (field index + 1) */
+  uint8_t index[256];
+};
+
+/**
+ * Computes the schema's perfect hash table (used for key dispatch).
+ *
+ * Called automatically (before `main` for `FIO_JSON_SCHEMA_NAME` schemas, or by
+ * the first `fio_json_schema_parse`). Thread safe.
+ */
+SFUNC void fio_json_schema_prepare(fio_json_schema_s *schema);
+
+/** Sets all fields to their default values (the old values are ignored). */
+SFUNC void fio_json_schema_init(fio_json_schema_s *schema, void *obj);
+
+/** Frees any memory owned by `obj` (`fio_bstr` fields are set to NULL). */
+SFUNC void fio_json_schema_destroy(fio_json_schema_s *schema, void *obj);
+
+/**
+ * Parses a JSON object into `obj`, returning 0 on success or -1 on error.
+ *
+ * `obj` must be initialized (or zeroed), as any existing `fio_bstr` fields are
+ * reused (or freed). Missing fields are set to their default values.
+ *
+ * On error, `obj` may be partially updated (but it is always valid).
+ *
+ * If `consumed` isn't NULL, it is set to the number of bytes consumed.
+ */
+SFUNC int fio_json_schema_parse(fio_json_schema_s *schema,
+                                void *obj,
+                                fio_str_info_s json,
+                                size_t *consumed);
+
+/** Writes `obj` as a JSON object to the end of `dest` (`fio_string_write`). */
+SFUNC int fio_json_schema_write(fio_str_info_s *dest,
+                                fio_string_realloc_fn reallocate,
+                                fio_json_schema_s *schema,
+                                const void *obj);
+
+/* *****************************************************************************
+JSON Schema - Field Types (for `FIO_JSON_SCHEMA_FIELDS`)
+***************************************************************************** */
+
+/** A `bool` (or unsigned integer) field. */
+#define FIO_JSON_FIELD_BOOL .type = FIO_JSON_SCHEMA_BOOL
+/** A signed integer field (of any size). */
+#define FIO_JSON_FIELD_INT .type = FIO_JSON_SCHEMA_INT
+/** An unsigned integer field (of any size). */
+#define FIO_JSON_FIELD_UINT .type = FIO_JSON_SCHEMA_UINT
+/** A `float` or `double` field. */
+#define FIO_JSON_FIELD_FLOAT .type = FIO_JSON_SCHEMA_FLOAT
+/** A `char` array field. */
+#define FIO_JSON_FIELD_STR .type = FIO_JSON_SCHEMA_STR
+/** A `char *` (`fio_bstr`) field. */
+#define FIO_JSON_FIELD_BSTR .type = FIO_JSON_SCHEMA_BSTR
+/** A nested struct field, using the `FIO_JSON_SCHEMA_NAME` of its schema. */
+#define FIO_JSON_FIELD_OBJ(schema_name)                                        \
+  .type = FIO_JSON_SCHEMA_OBJ, .schema = &FIO_NAME(schema_name, __schema)
+
+/* *****************************************************************************
+JSON Schema - Implementation
+***************************************************************************** */
+#if defined(FIO_EXTERN_COMPLETE) || !defined(FIO_EXTERN)
+
+/* the JSON key of a field */
+#define FIO___JSON_SCHEMA_KEY(f) ((f)->key ? (f)->key : (f)->name)
+
+/* *****************************************************************************
+JSON Schema - Field Access
+***************************************************************************** */
+
+FIO_SFUNC int fio___json_schema_set_i(char *dest, size_t size, int64_t i) {
+  switch (size) {
+  case 1:
+    if (i < INT8_MIN || i > INT8_MAX)
+      return -1;
+    *(int8_t *)dest = (int8_t)i;
+    return 0;
+  case 2:
+    if (i < INT16_MIN || i > INT16_MAX)
+      return -1;
+    *(int16_t *)dest = (int16_t)i;
+    return 0;
+  case 4:
+    if (i < INT32_MIN || i > INT32_MAX)
+      return -1;
+    *(int32_t *)dest = (int32_t)i;
+    return 0;
+  case 8: *(int64_t *)dest = i; return 0;
+  }
+  return -1;
+}
+
+FIO_SFUNC int fio___json_schema_set_u(char *dest, size_t size, uint64_t u) {
+  switch (size) {
+  case 1:
+    if (u > UINT8_MAX)
+      return -1;
+    *(uint8_t *)dest = (uint8_t)u;
+    return 0;
+  case 2:
+    if (u > UINT16_MAX)
+      return -1;
+    *(uint16_t *)dest = (uint16_t)u;
+    return 0;
+  case 4:
+    if (u > UINT32_MAX)
+      return -1;
+    *(uint32_t *)dest = (uint32_t)u;
+    return 0;
+  case 8: *(uint64_t *)dest = u; return 0;
+  }
+  return -1;
+}
+
+FIO_SFUNC int fio___json_schema_set_f(char *dest, size_t size, double f) {
+  switch (size) {
+  case sizeof(float): *(float *)dest = (float)f; return 0;
+  case sizeof(double): *(double *)dest = f; return 0;
+  }
+  return -1;
+}
+
+FIO_SFUNC int64_t fio___json_schema_get_i(const char *src, size_t size) {
+  switch (size) {
+  case 1: return *(const int8_t *)src;
+  case 2: return *(const int16_t *)src;
+  case 4: return *(const int32_t *)src;
+  }
+  return *(const int64_t *)src;
+}
+
+FIO_SFUNC uint64_t fio___json_schema_get_u(const char *src, size_t size) {
+  switch (size) {
+  case 1: return *(const uint8_t *)src;
+  case 2: return *(const uint16_t *)src;
+  case 4: return *(const uint32_t *)src;
+  }
+  return *(const uint64_t *)src;
+}
+
+/* sets a field to its default value, freeing the old value if `free_old` */
+FIO_SFUNC void fio___json_schema_field_reset(char *obj,
+                                             const fio_json_schema_field_s *f,
+                                             uint8_t free_old) {
+  char *dest = obj + f->offset;
+  size_t len;
+  switch (f->type) {
+  case FIO_JSON_SCHEMA_BOOL:
+    fio___json_schema_set_u(dest, f->size, (uint64_t)(f->def.i != 0));
+    return;
+  case FIO_JSON_SCHEMA_INT:
+    fio___json_schema_set_i(dest, f->size, f->def.i);
+    return;
+  case FIO_JSON_SCHEMA_UINT:
+    fio___json_schema_set_u(dest, f->size, f->def.u);
+    return;
+  case FIO_JSON_SCHEMA_FLOAT:
+    fio___json_schema_set_f(dest, f->size, f->def.f);
+    return;
+  case FIO_JSON_SCHEMA_STR:
+    len = f->def.s ? FIO_STRLEN(f->def.s) : 0;
+    if (len >= f->size)
+      len = f->size - 1;
+    if (len)
+      FIO_MEMCPY(dest, f->def.s, len);
+    dest[len] = 0;
+    return;
+  case FIO_JSON_SCHEMA_BSTR:
+    if (free_old)
+      fio_bstr_free(*(char **)dest);
+    *(char **)dest = NULL;
+    if (f->def.s)
+      *(char **)dest = fio_bstr_write(NULL, f->def.s, FIO_STRLEN(f->def.s));
+    return;
+  case FIO_JSON_SCHEMA_OBJ:
+    for (uint32_t i = 0; i < f->schema->count; ++i)
+      fio___json_schema_field_reset(dest, f->schema->fields + i, free_old);
+    return;
+  }
+}
+
+/* *****************************************************************************
+JSON Schema - Perfect Hash Key Dispatch
+***************************************************************************** */
+
+/* the perfect hash table position of a key's hash */
+FIO_IFUNC size_t fio___json_schema_pos(uint64_t hash,
+                                       uint64_t seed,
+                                       uint8_t bits) {
+  return (size_t)(((hash ^ seed) * FIO_U64_HASH_PRIME1) >> (64 - bits));
+}
+
+/* computes the perfect hash table, called once (under the schema's lock) */
+FIO_SFUNC void fio___json_schema_prepare_task(fio_json_schema_s *s) {
+  FIO_ASSERT(s->count <= FIO_JSON_SCHEMA_MAX_FIELDS,
+             "JSON schema has too many fields (%u)",
+             (unsigned)s->count);
+  for (uint32_t i = 0; i < s->count; ++i) {
+    const fio_json_schema_field_s *f = s->fields + i;
+    FIO_ASSERT(f->type != FIO_JSON_SCHEMA_OBJ || f->schema,
+               "JSON schema field (%s) is missing its schema",
+               f->name);
+    if (f->type == FIO_JSON_SCHEMA_OBJ)
+      fio_json_schema_prepare(f->schema);
+    /* keys are written as is, so they must not require JSON escaping */
+    for (const char *k = FIO___JSON_SCHEMA_KEY(f); *k; ++k)
+      FIO_ASSERT((uint8_t)*k > 31 && *k != '"' && *k != '\\',
+                 "JSON schema key (%s) requires escaping",
+                 FIO___JSON_SCHEMA_KEY(f));
+  }
+  /* look for a seed with no collisions, using a table at least twice as big */
+  uint64_t hashes[FIO_JSON_SCHEMA_MAX_FIELDS];
+  for (uint32_t i = 0; i < s->count; ++i) {
+    const char *k = FIO___JSON_SCHEMA_KEY(s->fields + i);
+    hashes[i] = fio_risky_hash(k, FIO_STRLEN(k), 0);
+  }
+  s->bits = 0;
+  for (uint8_t bits = 1; bits <= 8 && s->count; ++bits) {
+    if (((uint64_t)1 << bits) < ((uint64_t)s->count << 1))
+      continue;
+    for (uint64_t seed = 1; seed < ((uint64_t)1 << 16); ++seed) {
+      uint32_t i = 0;
+      FIO_MEMSET(s->index, 0, sizeof(s->index));
+      for (; i < s->count; ++i) {
+        const size_t pos = fio___json_schema_pos(hashes[i], seed, bits);
+        if (s->index[pos])
+          break;
+        s->index[pos] = (uint8_t)(i + 1);
+      }
+      if (i == s->count) {
+        s->seed = seed;
+        s->bits = bits;
+        goto done;
+      }
+    }
+  }
+  FIO_MEMSET(s->index, 0, sizeof(s->index)); /* linear search fallback */
+done:
+  fio_atomic_exchange(&s->ready, 1); /* publishes the table */
+}
+
+/** Computes the schema's perfect hash table (used for key dispatch). */
+SFUNC void fio_json_schema_prepare(fio_json_schema_s *s) {
+  uint8_t ready;
+  fio_atomic_load(ready, &s->ready);
+  if (ready)
+    return;
+  fio_lock(&s->lock);
+  if (!s->ready)
+    fio___json_schema_prepare_task(s);
+  fio_unlock(&s->lock);
+}
+
+/* finds the field for a JSON key (NULL if none) */
+FIO_IFUNC const fio_json_schema_field_s *fio___json_schema_find(
+    fio_json_schema_s *s,
+    const char *key,
+    size_t len) {
+  const fio_json_schema_field_s *f;
+  const char *k;
+  if (FIO_LIKELY(s->bits)) {
+    const uint8_t i = s->index[fio___json_schema_pos(
+        fio_risky_hash(key, len, 0), s->seed, s->bits)];
+    if (!i)
+      return NULL;
+    f = s->fields + i - 1;
+    k = FIO___JSON_SCHEMA_KEY(f);
+    if (FIO_STRLEN(k) == len && !FIO_MEMCMP(k, key, len))
+      return f;
+    return NULL;
+  }
+  for (uint32_t i = 0; i < s->count; ++i) {
+    f = s->fields + i;
+    k = FIO___JSON_SCHEMA_KEY(f);
+    if (FIO_STRLEN(k) == len && !FIO_MEMCMP(k, key, len))
+      return f;
+  }
+  return NULL;
+}
+
+/* *****************************************************************************
+JSON Schema - Parsing (fio_json_parse callbacks)
+***************************************************************************** */
+
+/* a struct being parsed */
+typedef struct {
+  fio_json_schema_s *schema;
+  char *obj;
+  /** the field bound to the next value (NULL if the value is ignored) */
+  const fio_json_schema_field_s *field;
+  /** a bitmap of the fields that were set */
+  uint64_t seen;
+  uint8_t expect_key;
+} fio___json_schema_frame_s;
+
+typedef struct {
+  fio_json_schema_s *schema;
+  char *obj;
+  /** the nesting level within an ignored (or invalid) container */
+  uint32_t skip;
+  /** the number of frames */
+  uint32_t depth;
+  int error;
+  uint8_t done;
+  fio___json_schema_frame_s frames[FIO_JSON_SCHEMA_MAX_DEPTH];
+} fio___json_schema_parser_s;
+
+/* the parser has no `udata`, so the parsing state is per thread */
+static __thread fio___json_schema_parser_s *fio___json_schema_parser;
+
+/* all callbacks return this value, the data is written directly to `obj` */
+#define FIO___JSON_SCHEMA_VALUE ((void *)&fio___json_schema_parser)
+
+/* binds a Hash Map key to a field of the frame's struct */
+FIO_SFUNC void fio___json_schema_key(fio___json_schema_parser_s *p,
+                                     fio___json_schema_frame_s *f,
+                                     const char *key,
+                                     size_t len) {
+  f->expect_key = 0;
+  f->field = key ? fio___json_schema_find(f->schema, key, len) : NULL;
+  p->error |= ((!f->field) & f->schema->strict);
+}
+
+/* returns the field bound to the next value (NULL if ignored) */
+FIO_SFUNC const fio_json_schema_field_s *fio___json_schema_bind(
+    fio___json_schema_parser_s *p) {
+  fio___json_schema_frame_s *f;
+  if (p->skip)
+    return NULL;
+  if (!p->depth) { /* the JSON must be an object */
+    p->error = 1;
+    return NULL;
+  }
+  f = p->frames + p->depth - 1;
+  if (f->expect_key) { /* a non-String key */
+    fio___json_schema_key(p, f, NULL, 0);
+    return NULL;
+  }
+  f->expect_key = 1;
+  if (f->field)
+    f->seen |= (uint64_t)1 << (f->field - f->schema->fields);
+  return f->field;
+}
+
+/* returns the address of the field's value */
+FIO_IFUNC char *fio___json_schema_dest(fio___json_schema_parser_s *p,
+                                       const fio_json_schema_field_s *field) {
+  return p->frames[p->depth - 1].obj + field->offset;
+}
+
+FIO_SFUNC void *fio___json_schema_on_null(void) {
+  fio___json_schema_parser_s *p = fio___json_schema_parser;
+  const fio_json_schema_field_s *field = fio___json_schema_bind(p);
+  if (field) { /* `null` values are the same as missing values */
+    fio___json_schema_frame_s *f = p->frames + p->depth - 1;
+    f->seen &= ~((uint64_t)1 << (field - f->schema->fields));
+  }
+  return FIO___JSON_SCHEMA_VALUE;
+}
+
+FIO_SFUNC void *fio___json_schema_on_bool(uint64_t b) {
+  fio___json_schema_parser_s *p = fio___json_schema_parser;
+  const fio_json_schema_field_s *field = fio___json_schema_bind(p);
+  if (!field)
+    return FIO___JSON_SCHEMA_VALUE;
+  if (field->type != FIO_JSON_SCHEMA_BOOL ||
+      fio___json_schema_set_u(fio___json_schema_dest(p, field),
+                              field->size,
+                              b))
+    p->error = 1;
+  return FIO___JSON_SCHEMA_VALUE;
+}
+FIO_SFUNC void *fio___json_schema_on_true(void) {
+  return fio___json_schema_on_bool(1);
+}
+FIO_SFUNC void *fio___json_schema_on_false(void) {
+  return fio___json_schema_on_bool(0);
+}
+
+FIO_SFUNC void *fio___json_schema_on_number(int64_t i) {
+  fio___json_schema_parser_s *p = fio___json_schema_parser;
+  const fio_json_schema_field_s *field = fio___json_schema_bind(p);
+  char *dest;
+  if (!field)
+    return FIO___JSON_SCHEMA_VALUE;
+  dest = fio___json_schema_dest(p, field);
+  switch (field->type) {
+  case FIO_JSON_SCHEMA_INT:
+    p->error |= fio___json_schema_set_i(dest, field->size, i);
+    break;
+  case FIO_JSON_SCHEMA_UINT:
+    p->error |=
+        (i < 0) || fio___json_schema_set_u(dest, field->size, (uint64_t)i);
+    break;
+  case FIO_JSON_SCHEMA_FLOAT:
+    p->error |= fio___json_schema_set_f(dest, field->size, (double)i);
+    break;
+  default: p->error = 1;
+  }
+  return FIO___JSON_SCHEMA_VALUE;
+}
+
+FIO_SFUNC void *fio___json_schema_on_float(double f) {
+  fio___json_schema_parser_s *p = fio___json_schema_parser;
+  const fio_json_schema_field_s *field = fio___json_schema_bind(p);
+  if (!field)
+    return FIO___JSON_SCHEMA_VALUE;
+  if (field->type != FIO_JSON_SCHEMA_FLOAT ||
+      fio___json_schema_set_f(fio___json_schema_dest(p, field),
+                              field->size,
+                              f))
+    p->error = 1;
+  return FIO___JSON_SCHEMA_VALUE;
+}
+
+FIO_SFUNC void *fio___json_schema_on_string2(const void *start,
+                                             size_t len,
+                                             uint8_t escaped) {
+  fio___json_schema_parser_s *p = fio___json_schema_parser;
+  const fio_json_schema_field_s *field;
+  char *dest;
+  if (!p->skip && p->depth && p->frames[p->depth - 1].expect_key) {
+    fio___json_schema_frame_s *f = p->frames + p->depth - 1;
+    char buf[256];
+    fio_str_info_s key = FIO_STR_INFO3(buf, 0, sizeof(buf));
+    if (!escaped) {
+      fio___json_schema_key(p, f, (const char *)start, len);
+      return FIO___JSON_SCHEMA_VALUE;
+    }
+    if (fio_string_write_unescape(&key, NULL, start, len))
+      key.buf = NULL; /* longer than any reasonable key, unknown */
+    fio___json_schema_key(p, f, key.buf, key.len);
+    return FIO___JSON_SCHEMA_VALUE;
+  }
+  field = fio___json_schema_bind(p);
+  if (!field)
+    return FIO___JSON_SCHEMA_VALUE;
+  dest = fio___json_schema_dest(p, field);
+  switch (field->type) {
+  case FIO_JSON_SCHEMA_STR:
+    if (!escaped) {
+      if (len >= field->size) {
+        p->error = 1;
+        break;
+      }
+      FIO_MEMCPY(dest, start, len);
+      dest[len] = 0;
+      break;
+    } else {
+      fio_str_info_s s = FIO_STR_INFO3(dest, 0, field->size);
+      p->error |= fio_string_write_unescape(&s, NULL, start, len);
+    }
+    break;
+  case FIO_JSON_SCHEMA_BSTR: {
+    char *s = *(char **)dest;
+    if (s)
+      s = fio_bstr_len_set(s, 0);
+    *(char **)dest = escaped ? fio_bstr_write_unescape(s, start, len)
+                             : fio_bstr_write(s, start, len);
+    break;
+  }
+  default: p->error = 1;
+  }
+  return FIO___JSON_SCHEMA_VALUE;
+}
+FIO_SFUNC void *fio___json_schema_on_string(const void *start, size_t len) {
+  return fio___json_schema_on_string2(start, len, 1);
+}
+FIO_SFUNC void *fio___json_schema_on_string_simple(const void *start,
+                                                   size_t len) {
+  return fio___json_schema_on_string2(start, len, 0);
+}
+
+FIO_SFUNC void *fio___json_schema_on_map(void *ctx, void *at) {
+  fio___json_schema_parser_s *p = fio___json_schema_parser;
+  const fio_json_schema_field_s *field;
+  fio___json_schema_frame_s *f;
+  if (!p->skip && !p->depth && !p->done) { /* the root object */
+    p->frames[p->depth++] = (fio___json_schema_frame_s){
+        .schema = p->schema,
+        .obj = p->obj,
+        .expect_key = 1,
+    };
+    return FIO___JSON_SCHEMA_VALUE;
+  }
+  field = fio___json_schema_bind(p);
+  if (!field)
+    goto skip;
+  f = p->frames + p->depth - 1;
+  if (field->type != FIO_JSON_SCHEMA_OBJ ||
+      p->depth == FIO_JSON_SCHEMA_MAX_DEPTH)
+    goto error;
+  p->frames[p->depth++] = (fio___json_schema_frame_s){
+      .schema = field->schema,
+      .obj = f->obj + field->offset,
+      .expect_key = 1,
+  };
+  return FIO___JSON_SCHEMA_VALUE;
+error:
+  p->error = 1;
+skip:
+  ++p->skip;
+  return FIO___JSON_SCHEMA_VALUE;
+  (void)ctx, (void)at;
+}
+
+FIO_SFUNC void *fio___json_schema_on_array(void *ctx, void *at) {
+  fio___json_schema_parser_s *p = fio___json_schema_parser;
+  if (fio___json_schema_bind(p)) /* Arrays aren't supported by schemas */
+    p->error = 1;
+  ++p->skip;
+  return FIO___JSON_SCHEMA_VALUE;
+  (void)ctx, (void)at;
+}
+
+FIO_SFUNC int fio___json_schema_map_push(void *ctx, void *key, void *value) {
+  return fio___json_schema_parser->error;
+  (void)ctx, (void)key, (void)value;
+}
+
+FIO_SFUNC int fio___json_schema_array_push(void *ctx, void *value) {
+  return fio___json_schema_parser->error;
+  (void)ctx, (void)value;
+}
+
+FIO_SFUNC int fio___json_schema_array_finished(void *ctx) {
+  fio___json_schema_parser_s *p = fio___json_schema_parser;
+  --p->skip;
+  return p->error;
+  (void)ctx;
+}
+
+FIO_SFUNC int fio___json_schema_map_finished(void *ctx) {
+  fio___json_schema_parser_s *p = fio___json_schema_parser;
+  fio___json_schema_frame_s *f;
+  if (p->skip) {
+    --p->skip;
+    return p->error;
+  }
+  f = p->frames + --p->depth;
+  for (uint32_t i = 0; i < f->schema->count; ++i) {
+    if (((f->seen >> i) & 1))
+      continue;
+    /* missing fields are set to their default values (if not required) */
+    p->error |= f->schema->fields[i].required;
+    fio___json_schema_field_reset(f->obj, f->schema->fields + i, 1);
+  }
+  p->done = !p->depth;
+  return p->error;
+  (void)ctx;
+}
+
+FIO_SFUNC void fio___json_schema_free_unused_object(void *ctx) { (void)ctx; }
+
+/** Parses a JSON object into `obj`, returning 0 on success or -1 on error. */
+SFUNC int fio_json_schema_parse(fio_json_schema_s *schema,
+                                void *obj,
+                                fio_str_info_s json,
+                                size_t *consumed) {
+  static fio_json_parser_callbacks_s callbacks = {
+      .on_null = fio___json_schema_on_null,
+      .on_true = fio___json_schema_on_true,
+      .on_false = fio___json_schema_on_false,
+      .on_number = fio___json_schema_on_number,
+      .on_float = fio___json_schema_on_float,
+      .on_string = fio___json_schema_on_string,
+      .on_string_simple = fio___json_schema_on_string_simple,
+      .on_map = fio___json_schema_on_map,
+      .on_array = fio___json_schema_on_array,
+      .map_push = fio___json_schema_map_push,
+      .array_push = fio___json_schema_array_push,
+      .array_finished = fio___json_schema_array_finished,
+      .map_finished = fio___json_schema_map_finished,
+      .free_unused_object = fio___json_schema_free_unused_object,
+  };
+  fio___json_schema_parser_s p;
+  fio___json_schema_parser_s *old = fio___json_schema_parser;
+  fio_json_result_s r;
+  fio_json_schema_prepare(schema); /* hand declared schemas are lazy */
+  p.schema = schema;
+  p.obj = (char *)obj;
+  p.skip = p.depth = 0;
+  p.error = 0;
+  p.done = 0;
+  fio___json_schema_parser = &p;
+  r = fio_json_parse(&callbacks, json.buf, json.len);
+  fio___json_schema_parser = old;
+  if (consumed)
+    *consumed = r.stop_pos;
+  return 0 - (r.err | p.error | !p.done);
+}
+
+/* *****************************************************************************
+JSON Schema - Initialization / Cleanup
+***************************************************************************** */
+
+/** Sets all fields to their default values (the old values are ignored). */
+SFUNC void fio_json_schema_init(fio_json_schema_s *s, void *obj) {
+  for (uint32_t i = 0; i < s->count; ++i)
+    fio___json_schema_field_reset((char *)obj, s->fields + i, 0);
+}
+
+/** Frees any memory owned by `obj` (`fio_bstr` fields are set to NULL). */
+SFUNC void fio_json_schema_destroy(fio_json_schema_s *s, void *obj) {
+  for (uint32_t i = 0; i < s->count; ++i) {
+    const fio_json_schema_field_s *f = s->fields + i;
+    char *dest = (char *)obj + f->offset;
+    if (f->type == FIO_JSON_SCHEMA_BSTR) {
+      fio_bstr_free(*(char **)dest);
+      *(char **)dest = NULL;
+    } else if (f->type == FIO_JSON_SCHEMA_OBJ) {
+      fio_json_schema_destroy(f->schema, dest);
+    }
+  }
+}
+
+/* *****************************************************************************
+JSON Schema - Writing
+***************************************************************************** */
+
+/* the (maximal) JSON length of an object, ignoring String escaping */
+FIO_SFUNC size_t fio___json_schema_write_len(fio_json_schema_s *s,
+                                             const char *obj) {
+  size_t r = 1 + s->count;
+  for (uint32_t i = 0; i < s->count; ++i) {
+    const fio_json_schema_field_s *f = s->fields + i;
+    const char *src = obj + f->offset;
+    r += FIO_STRLEN(FIO___JSON_SCHEMA_KEY(f)) + 3;
+    switch (f->type) {
+    case FIO_JSON_SCHEMA_BOOL: r += 5; break;
+    case FIO_JSON_SCHEMA_INT:  /* fall through */
+    case FIO_JSON_SCHEMA_UINT: r += 20; break;
+    case FIO_JSON_SCHEMA_FLOAT: r += 24; break;
+    case FIO_JSON_SCHEMA_STR: r += f->size + 2; break;
+    case FIO_JSON_SCHEMA_BSTR:
+      r += (*(char **)src ? fio_bstr_len(*(char **)src) : 2) + 2;
+      break;
+    case FIO_JSON_SCHEMA_OBJ:
+      r += fio___json_schema_write_len(f->schema, src);
+      break;
+    }
+  }
+  return r;
+}
+
+FIO_SFUNC int fio___json_schema_write(fio_str_info_s *dest,
+                                      fio_string_realloc_fn reallocate,
+                                      fio_json_schema_s *s,
+                                      const char *obj) {
+  int r = fio_string_write(dest, reallocate, "{", 1);
+  for (uint32_t i = 0; i < s->count; ++i) {
+    const fio_json_schema_field_s *f = s->fields + i;
+    const char *src = obj + f->offset;
+    const char *key = FIO___JSON_SCHEMA_KEY(f);
+    char buf[32];
+    size_t len;
+    r |= fio_string_write(dest, reallocate, (i ? ",\"" : "\""), 1 + !!i);
+    r |= fio_string_write(dest, reallocate, key, FIO_STRLEN(key));
+    r |= fio_string_write(dest, reallocate, "\":", 2);
+    switch (f->type) {
+    case FIO_JSON_SCHEMA_BOOL:
+      if (fio___json_schema_get_u(src, f->size))
+        r |= fio_string_write(dest, reallocate, "true", 4);
+      else
+        r |= fio_string_write(dest, reallocate, "false", 5);
+      break;
+    case FIO_JSON_SCHEMA_INT:
+      r |= fio_string_write_i(dest,
+                              reallocate,
+                              fio___json_schema_get_i(src, f->size));
+      break;
+    case FIO_JSON_SCHEMA_UINT:
+      r |= fio_string_write_u(dest,
+                              reallocate,
+                              fio___json_schema_get_u(src, f->size));
+      break;
+    case FIO_JSON_SCHEMA_FLOAT:
+      len = fio_ftoa(buf,
+                     (f->size == sizeof(float) ? (double)*(const float *)src
+                                               : *(const double *)src),
+                     10);
+      r |= fio_string_write(dest, reallocate, buf, len);
+      break;
+    case FIO_JSON_SCHEMA_STR:
+      len = (size_t)((const char *)FIO_MEMCHR(src, 0, f->size) - src);
+      r |= fio_string_write(dest, reallocate, "\"", 1);
+      r |= fio_string_write_escape(dest, reallocate, src, len);
+      r |= fio_string_write(dest, reallocate, "\"", 1);
+      break;
+    case FIO_JSON_SCHEMA_BSTR:
+      if (!*(char **)src) {
+        r |= fio_string_write(dest, reallocate, "null", 4);
+        break;
+      }
+      r |= fio_string_write(dest, reallocate, "\"", 1);
+      r |= fio_string_write_escape(dest,
+                                   reallocate,
+                                   *(char **)src,
+                                   fio_bstr_len(*(char **)src));
+      r |= fio_string_write(dest, reallocate, "\"", 1);
+      break;
+    case FIO_JSON_SCHEMA_OBJ:
+      r |= fio___json_schema_write(dest, reallocate, f->schema, src);
+      break;
+    }
+  }
+  r |= fio_string_write(dest, reallocate, "}", 1);
+  return r;
+}
+
+/** Writes `obj` as a JSON object to the end of `dest` (`fio_string_write`). */
+SFUNC int fio_json_schema_write(fio_str_info_s *dest,
+                                fio_string_realloc_fn reallocate,
+                                fio_json_schema_s *schema,
+                                const void *obj) {
+  if (reallocate) { /* a single allocation, unless Strings require escaping */
+    const size_t len = fio___json_schema_write_len(schema, (const char *)obj);
+    if (dest->capa <= dest->len + len && reallocate(dest, dest->len + len))
+      return -1;
+  }
+  return fio___json_schema_write(dest, reallocate, schema, (const char *)obj);
+}
+
+/* *****************************************************************************
+JSON Schema - cleanup
+***************************************************************************** */
+#undef FIO___JSON_SCHEMA_KEY
+#undef FIO___JSON_SCHEMA_VALUE
+#endif /* FIO_EXTERN_COMPLETE */
+#endif /* FIO_JSON_SCHEMA */
+#undef FIO_JSON_SCHEMA
+
+/* *****************************************************************************
+
+
+
+
+                    JSON Schema - struct specific template
+
+
+
+
+***************************************************************************** */
+#if defined(FIO_JSON_SCHEMA_NAME)
+
+#ifndef FIO_JSON_SCHEMA_TYPE
+#error FIO_JSON_SCHEMA_TYPE (the struct type) must be defined for a schema
+#endif
+#ifndef FIO_JSON_SCHEMA_FIELDS
+#error FIO_JSON_SCHEMA_FIELDS(FIELD) must be defined for a schema
+#endif
+#ifndef FIO_JSON_SCHEMA_STRICT
+/** If true, unknown JSON keys are errors (otherwise they are skipped). */
+#define FIO_JSON_SCHEMA_STRICT 0
+#endif
+
+/* a field descriptor, used by FIO_JSON_SCHEMA_FIELDS(FIELD) */
+#define FIO___JSON_SCHEMA_FIELD(member, ...)                                   \
+  {.name = #member,                                                            \
+   .offset = offsetof(FIO_JSON_SCHEMA_TYPE, member),                           \
+   .size = sizeof(((FIO_JSON_SCHEMA_TYPE *)0)->member),                        \
+   __VA_ARGS__},
+
+static const fio_json_schema_field_s FIO_NAME(FIO_JSON_SCHEMA_NAME,
+                                              __fields)[] = {
+    FIO_JSON_SCHEMA_FIELDS(FIO___JSON_SCHEMA_FIELD)};
+
+FIO_ASSERT_STATIC(sizeof(FIO_NAME(FIO_JSON_SCHEMA_NAME, __fields)) <=
+                      sizeof(fio_json_schema_field_s) *
+                          FIO_JSON_SCHEMA_MAX_FIELDS,
+                  "too many fields in JSON schema");
+
+static fio_json_schema_s FIO_NAME(FIO_JSON_SCHEMA_NAME, __schema) = {
+    .fields = FIO_NAME(FIO_JSON_SCHEMA_NAME, __fields),
+    .count = (uint32_t)(sizeof(FIO_NAME(FIO_JSON_SCHEMA_NAME, __fields)) /
+                        sizeof(fio_json_schema_field_s)),
+    .strict = (FIO_JSON_SCHEMA_STRICT ? 1 : 0),
+};
+
+/* computes the perfect hash before `main` (and before any threads start) */
+FIO_CONSTRUCTOR(FIO_NAME(FIO_JSON_SCHEMA_NAME, __schema_prepare)) {
+  fio_json_schema_prepare(&FIO_NAME(FIO_JSON_SCHEMA_NAME, __schema));
+}
+
+/** Returns the schema (for the `fio_json_schema` functions). */
+FIO_IFUNC fio_json_schema_s *FIO_NAME(FIO_JSON_SCHEMA_NAME, schema)(void) {
+  return &FIO_NAME(FIO_JSON_SCHEMA_NAME, __schema);
+}
+
+/** Sets all fields to their default values (the old values are ignored). */
+FIO_IFUNC void FIO_NAME(FIO_JSON_SCHEMA_NAME, init)(FIO_JSON_SCHEMA_TYPE *o) {
+  fio_json_schema_init(&FIO_NAME(FIO_JSON_SCHEMA_NAME, __schema), o);
+}
+
+/** Frees any memory owned by the struct (i.e., `FIO_JSON_FIELD_BSTR`). */
+FIO_IFUNC void FIO_NAME(FIO_JSON_SCHEMA_NAME,
+                        destroy)(FIO_JSON_SCHEMA_TYPE *o) {
+  fio_json_schema_destroy(&FIO_NAME(FIO_JSON_SCHEMA_NAME, __schema), o);
+}
+
+/** Parses a JSON object into `o`, returning 0 on success or -1 on error. */
+FIO_IFUNC int FIO_NAME(FIO_JSON_SCHEMA_NAME, parse)(FIO_JSON_SCHEMA_TYPE *o,
+                                                    fio_str_info_s json,
+                                                    size_t *consumed) {
+  return fio_json_schema_parse(&FIO_NAME(FIO_JSON_SCHEMA_NAME, __schema),
+                               o,
+                               json,
+                               consumed);
+}
+
+/** Writes `o` as a JSON object to the end of `dest` (`fio_string_write`). */
+FIO_IFUNC int FIO_NAME(FIO_JSON_SCHEMA_NAME,
+                       write)(fio_str_info_s *dest,
+                              fio_string_realloc_fn reallocate,
+                              const FIO_JSON_SCHEMA_TYPE *o) {
+  return fio_json_schema_write(dest,
+                               reallocate,
+                               &FIO_NAME(FIO_JSON_SCHEMA_NAME, __schema),
+                               o);
+}
+
+#undef FIO___JSON_SCHEMA_FIELD
+#endif /* FIO_JSON_SCHEMA_NAME */
+#undef FIO_JSON_SCHEMA_NAME
+#undef FIO_JSON_SCHEMA_TYPE
+#undef FIO_JSON_SCHEMA_FIELDS
+#undef FIO_JSON_SCHEMA_STRICT
+/* ************************************************************************* */
+#if !defined(FIO_INCLUDE_FILE) /* Dev test - ignore line */
+#define FIO___DEV___           /* Development inclusion - ignore line */
 #define FIO_MUSTACHE module    /* Development inclusion - ignore line */
 #include "./include.h"         /* Development inclusion - ignore line */
 #endif                         /* Development inclusion - ignore line */
@@ -21378,6 +24919,14 @@ Settings
 /** Limits the scope of partial templates to the context of their section. */
 #define FIO_MUSTACHE_ISOLATE_PARTIALS 1
 #endif
+#ifndef FIO_MUSTACHE_CACHE_LIMIT
+/** The default memory limit for the template cache (templates and files). */
+#define FIO_MUSTACHE_CACHE_LIMIT ((size_t)1 << 25)
+#endif
+#ifndef FIO_MUSTACHE_CACHE_THROTTLE
+/** The default interval (milliseconds) between cached file change tests. */
+#define FIO_MUSTACHE_CACHE_THROTTLE 1000
+#endif
 
 /* *****************************************************************************
 Mustache Parser / Builder API
@@ -21438,6 +24987,12 @@ struct fio_mustache_bargs_s {
   void *ctx;
   /* opaque user data (settable as well as readable), the final return value. */
   void *udata;
+  /* optional: writes template text, which is valid while the template is. */
+  void *(*write_text_static)(void *udata, fio_buf_info_s txt);
+  /* optional: the hash function used by `fio_mustache_bind`. */
+  uint64_t (*var_hash)(fio_buf_info_s name);
+  /* optional: same as `get_var`, with the `var_hash` value of `name`. */
+  void *(*get_var_hashed)(void *ctx, fio_buf_info_s name, uint64_t hash);
 };
 
 /** Builds the template, returning the final value of `udata` (or NULL). */
@@ -21445,6 +25000,101 @@ SFUNC void *fio_mustache_build(fio_mustache_s *m, fio_mustache_bargs_s);
 #define fio_mustache_build(m, ...)                                             \
   fio_mustache_build((m), ((fio_mustache_bargs_s){__VA_ARGS__}))
 
+/**
+ * Pre-computes the hash value of every variable name in the template.
+ *
+ * When building a bound template, variables are looked up using
+ * `get_var_hashed` (if set and if `var_hash` is the same `hash` function),
+ * so the names are never hashed again. Dotted names (`a.b`) that are not
+ * found as a whole fall back to `get_var` for each segment.
+ *
+ * Note: this updates the template in place - bind the template before sharing
+ * it with other threads.
+ */
+SFUNC void fio_mustache_bind(fio_mustache_s *m,
+                             uint64_t (*hash)(fio_buf_info_s name));
+
+/** A rendered template, as an ordered list of buffers (see `build_iov`). */
+typedef struct {
+  /** The rendered output, in order (template text isn't copied). */
+  fio_buf_info_s *iov;
+  /** The number of buffers in `iov`. */
+  size_t count;
+  /** The total length of the rendered output. */
+  size_t len;
+  /* internal data */
+  size_t capa;
+  struct fio___mustache_iov_blk_s *blocks;
+  struct fio___mustache_iov_blk_s *block;
+  fio_mustache_s *m;
+} fio_mustache_iov_s;
+
+/**
+ * Builds the template into `dest` as a list of buffers (i.e., for `writev`),
+ * returning the number of buffers.
+ *
+ * Template text is referenced rather than copied, and `dest` holds a reference
+ * to the template, so the buffers are valid until `dest` is reused or
+ * destroyed. Variable data is copied to memory blocks owned by `dest`.
+ *
+ * `dest` must be zero initialized the first time it is used and can be reused
+ * for multiple renders (the memory is reused as well).
+ *
+ * The writer callbacks and `udata` are ignored.
+ */
+SFUNC size_t fio_mustache_build_iov(fio_mustache_s *m,
+                                    fio_mustache_iov_s *dest,
+                                    fio_mustache_bargs_s);
+#define fio_mustache_build_iov(m, dest, ...)                                   \
+  fio_mustache_build_iov((m), (dest), ((fio_mustache_bargs_s){__VA_ARGS__}))
+
+/** Frees the memory used by a `fio_mustache_iov_s` (and zeroes it out). */
+SFUNC void fio_mustache_iov_destroy(fio_mustache_iov_s *dest);
+
+/* *****************************************************************************
+Mustache Template Cache API
+***************************************************************************** */
+
+typedef struct {
+  /** The template's file name. */
+  fio_buf_info_s filename;
+  /** If set, the template is bound using `var_hash` when it is compiled. */
+  uint64_t (*var_hash)(fio_buf_info_s name);
+} fio_mustache_cache_args_s;
+
+/**
+ * Returns a compiled template from the process-wide template cache, loading
+ * (and compiling) the template if it wasn't cached.
+ *
+ * Partial template files are cached as well and shared between templates. At
+ * most once every throttle interval, the template's files are tested for
+ * changes (size and modification time) and the template is re-compiled if the
+ * content of any of its files changed.
+ *
+ * If re-compiling fails, the last valid template is returned (unless the
+ * template's file was removed).
+ *
+ * Returns a new reference (or NULL) - call `fio_mustache_free` when done.
+ * Templates are never changed once compiled, so reloading doesn't effect
+ * templates that are in use.
+ */
+SFUNC fio_mustache_s *fio_mustache_cache_get(fio_mustache_cache_args_s args);
+#define fio_mustache_cache_get(...)                                            \
+  fio_mustache_cache_get((fio_mustache_cache_args_s){__VA_ARGS__})
+
+/**
+ * Sets the template cache's memory limit (in bytes) and the minimal interval
+ * between file change tests (in milliseconds).
+ *
+ * A zero `memory_limit` or a negative `throttle` restores the default value
+ * (`FIO_MUSTACHE_CACHE_LIMIT` and `FIO_MUSTACHE_CACHE_THROTTLE`). A zero
+ * `throttle` tests for changes every time (useful during development).
+ */
+SFUNC void fio_mustache_cache_config(size_t memory_limit, int64_t throttle);
+
+/** Removes all templates from the cache (templates in use remain valid). */
+SFUNC void fio_mustache_cache_clear(void);
+
 /* *****************************************************************************
 Implementation - possibly externed functions.
 ***************************************************************************** */
@@ -21464,13 +25114,15 @@ typedef enum {
   FIO___MUSTACHE_I_STACK_PUSH,   /* 32 bit extra data (goes to position) */
   FIO___MUSTACHE_I_GOTO_PUSH,    /* 32 bit extra data (goes to position) */
   FIO___MUSTACHE_I_TXT,          /* 16 bits length + data */
-  FIO___MUSTACHE_I_VAR,          /* 16 bits length + data */
-  FIO___MUSTACHE_I_VAR_RAW,      /* 16 bits length + data */
-  FIO___MUSTACHE_I_ARY,          /* 16 bits length + 32 bit skip-pos + data */
-  FIO___MUSTACHE_I_MISSING,      /* 16 bits length + 32 bit skip-pos + data */
+  FIO___MUSTACHE_I_VAR,          /* 16 bits length + 64 bit hash + data */
+  FIO___MUSTACHE_I_VAR_RAW,      /* 16 bits length + 64 bit hash + data */
+  FIO___MUSTACHE_I_ARY,          /* 16 bit len + 32 bit skip + 64 hash + data */
+  FIO___MUSTACHE_I_MISSING,      /* 16 bit len + 32 bit skip + 64 hash + data */
   FIO___MUSTACHE_I_PADDING_PUSH, /* 16 bits length + data */
   FIO___MUSTACHE_I_PADDING_POP,  /* 0 extra data */
+  FIO___MUSTACHE_I_HASH_FN,      /* pointer sized data (the bound hash fn) */
 #if FIO_MUSTACHE_PRESERVE_PADDING
+  /* 16 bit len + 16 bit padding len + 64 bit hash + data + padding */
   FIO___MUSTACHE_I_VAR_PADDED,
   FIO___MUSTACHE_I_VAR_RAW_PADDED,
 #endif
@@ -21478,6 +25130,10 @@ typedef enum {
   FIO___MUSTACHE_I_METADATA, /* raw text data, written for lambda support */
 #endif
 } fio___mustache_inst_e;
+
+/* the bound hash function (first instruction of every template) */
+typedef uint64_t (*fio___mustache_hash_fn)(fio_buf_info_s);
+#define FIO___MUSTACHE_HASH_FN_LEN (1 + sizeof(fio___mustache_hash_fn))
 /* *****************************************************************************
 Instructions - Main processor
 ***************************************************************************** */
@@ -21503,6 +25159,7 @@ FIO_SFUNC char *fio___mustache_i_ary(char *p, fio___mustache_bldr_s *);
 FIO_SFUNC char *fio___mustache_i_missing(char *p, fio___mustache_bldr_s *);
 FIO_SFUNC char *fio___mustache_i_padding_push(char *p, fio___mustache_bldr_s *);
 FIO_SFUNC char *fio___mustache_i_padding_pop(char *p, fio___mustache_bldr_s *);
+FIO_SFUNC char *fio___mustache_i_hash_fn(char *p, fio___mustache_bldr_s *);
 #if FIO_MUSTACHE_PRESERVE_PADDING
 FIO_SFUNC char *fio___mustache_i_var_padded(char *p, fio___mustache_bldr_s *);
 FIO_SFUNC char *fio___mustache_i_var_raw_padded(char *,
@@ -21524,6 +25181,7 @@ FIO_SFUNC void *fio___mustache_build_section(char *p, fio___mustache_bldr_s a) {
     [FIO___MUSTACHE_I_MISSING] = fio___mustache_i_missing,
     [FIO___MUSTACHE_I_PADDING_PUSH] = fio___mustache_i_padding_push,
     [FIO___MUSTACHE_I_PADDING_POP] = fio___mustache_i_padding_pop,
+    [FIO___MUSTACHE_I_HASH_FN] = fio___mustache_i_hash_fn,
 #if FIO_MUSTACHE_PRESERVE_PADDING
     [FIO___MUSTACHE_I_VAR_PADDED] = fio___mustache_i_var_padded,
     [FIO___MUSTACHE_I_VAR_RAW_PADDED] = fio___mustache_i_var_raw_padded,
@@ -21547,9 +25205,13 @@ Instructions - Helpers
  */
 FIO_IFUNC void *fio___mustache_get_var_in_context(fio_mustache_bargs_s *a,
                                                   void *ctx,
-                                                  fio_buf_info_s *val_name) {
-  void *v = ctx;
-  v = a->get_var(ctx, *val_name);
+                                                  fio_buf_info_s *val_name,
+                                                  uint64_t hash) {
+  void *v;
+  if (hash && a->get_var_hashed)
+    v = a->get_var_hashed(ctx, *val_name, hash);
+  else
+    v = a->get_var(ctx, *val_name);
   if (v) {
     val_name->len = 0;
     return v;
@@ -21574,13 +25236,14 @@ FIO_IFUNC void *fio___mustache_get_var_in_context(fio_mustache_bargs_s *a,
 }
 
 FIO_IFUNC void *fio___mustache_get_var(fio___mustache_bldr_s *b,
-                                       fio_buf_info_s val_name) {
+                                       fio_buf_info_s val_name,
+                                       uint64_t hash) {
   void *v = b->ctx;
   if (val_name.len == 1 && val_name.buf[0] == '.')
     return v;
   for (;;) {
     if (b->ctx)
-      v = fio___mustache_get_var_in_context(b->args, b->ctx, &val_name);
+      v = fio___mustache_get_var_in_context(b->args, b->ctx, &val_name, hash);
     if (v)
       break;
 #if FIO_MUSTACHE_ISOLATE_PARTIALS
@@ -21592,14 +25255,14 @@ FIO_IFUNC void *fio___mustache_get_var(fio___mustache_bldr_s *b,
       return v;
   }
   while (val_name.len && v)
-    v = fio___mustache_get_var_in_context(b->args, v, &val_name);
+    v = fio___mustache_get_var_in_context(b->args, v, &val_name, 0);
   return v;
 }
 
 FIO_SFUNC void fio___mustache_write_padding(fio___mustache_bldr_s *b) {
   while (b && b->padding.len) {
     if (b->padding.buf) {
-      b->args->udata = b->args->write_text(b->args->udata, b->padding);
+      b->args->udata = b->args->write_text_static(b->args->udata, b->padding);
     }
     b = b->prev;
   }
@@ -21697,7 +25360,7 @@ FIO_SFUNC char *fio___mustache_i_goto_push(char *p, fio___mustache_bldr_s *b) {
 FIO_SFUNC char *fio___mustache_i_txt(char *p, fio___mustache_bldr_s *b) {
   fio_buf_info_s txt = FIO_BUF_INFO2(p + 3, fio_buf2u16u(p + 1));
   p = txt.buf + txt.len;
-  fio___mustache_writer_route(b, txt, b->args->write_text);
+  fio___mustache_writer_route(b, txt, b->args->write_text_static);
   return p;
 }
 
@@ -21705,9 +25368,10 @@ FIO_IFUNC char *fio___mustache_i_var_internal(
     char *p,
     fio___mustache_bldr_s *b,
     void *(*writer)(void *, fio_buf_info_s txt)) {
-  fio_buf_info_s var = FIO_BUF_INFO2(p + 3, fio_buf2u16u(p + 1));
+  fio_buf_info_s var = FIO_BUF_INFO2(p + 11, fio_buf2u16u(p + 1));
+  uint64_t hash = fio_buf2u64u(p + 3);
   p = var.buf + var.len;
-  void *v = fio___mustache_get_var(b, var);
+  void *v = fio___mustache_get_var(b, var, hash);
   if (!v)
     return p;
   var = b->args->var2str(v);
@@ -21728,8 +25392,9 @@ FIO_SFUNC char *fio___mustache_i_var_raw(char *p, fio___mustache_bldr_s *b) {
 }
 
 FIO_SFUNC char *fio___mustache_i_ary(char *p, fio___mustache_bldr_s *b) {
-  fio_buf_info_s var = FIO_BUF_INFO2(p + 7, fio_buf2u16u(p + 1));
+  fio_buf_info_s var = FIO_BUF_INFO2(p + 15, fio_buf2u16u(p + 1));
   uint32_t skip_pos = fio_buf2u32u(p + 3);
+  uint64_t hash = fio_buf2u64u(p + 7);
   p = b->root + skip_pos;
 #if FIO_MUSTACHE_LAMBDA_SUPPORT
   fio_buf_info_s section_raw_txt = FIO_BUF_INFO2(NULL, 0);
@@ -21741,7 +25406,7 @@ FIO_SFUNC char *fio___mustache_i_ary(char *p, fio___mustache_bldr_s *b) {
   const fio_buf_info_s section_raw_txt = FIO_BUF_INFO2(NULL, 0);
 #endif
 
-  void *v = fio___mustache_get_var(b, var);
+  void *v = fio___mustache_get_var(b, var, hash);
   if (!(b->args->var_is_truthful(v)))
     return p;
   size_t index = 0;
@@ -21771,11 +25436,12 @@ FIO_SFUNC char *fio___mustache_i_ary(char *p, fio___mustache_bldr_s *b) {
   }
 }
 FIO_SFUNC char *fio___mustache_i_missing(char *p, fio___mustache_bldr_s *b) {
-  fio_buf_info_s var = FIO_BUF_INFO2(p + 7, fio_buf2u16u(p + 1));
+  fio_buf_info_s var = FIO_BUF_INFO2(p + 15, fio_buf2u16u(p + 1));
   uint32_t skip_pos = fio_buf2u32u(p + 3);
+  uint64_t hash = fio_buf2u64u(p + 7);
   p = b->root + skip_pos;
 
-  void *v = fio___mustache_get_var(b, var);
+  void *v = fio___mustache_get_var(b, var, hash);
   if (b->args->var_is_truthful(v)) {
     b->args->release_var(v);
     return p;
@@ -21803,14 +25469,19 @@ FIO_SFUNC char *fio___mustache_i_padding_pop(char *p,
     b->padding.len = b->prev->padding.len;
   return p + 1;
 }
+FIO_SFUNC char *fio___mustache_i_hash_fn(char *p, fio___mustache_bldr_s *b) {
+  return p + FIO___MUSTACHE_HASH_FN_LEN;
+  (void)b;
+}
 
 #if FIO_MUSTACHE_PRESERVE_PADDING
 
 FIO_SFUNC char *fio___mustache_i_var_padded(char *p, fio___mustache_bldr_s *b) {
-  fio_buf_info_s var = FIO_BUF_INFO2(p + 5, fio_buf2u16u(p + 1));
-  fio_buf_info_s padding = FIO_BUF_INFO2(p + 5 + var.len, fio_buf2u16u(p + 3));
+  fio_buf_info_s var = FIO_BUF_INFO2(p + 13, fio_buf2u16u(p + 1));
+  fio_buf_info_s padding = FIO_BUF_INFO2(p + 13 + var.len, fio_buf2u16u(p + 3));
+  uint64_t hash = fio_buf2u64u(p + 5);
   p = padding.buf + padding.len;
-  void *v = fio___mustache_get_var(b, var);
+  void *v = fio___mustache_get_var(b, var, hash);
   if (!v)
     return p;
   var = b->args->var2str(v);
@@ -21825,10 +25496,11 @@ done:
 }
 FIO_SFUNC char *fio___mustache_i_var_raw_padded(char *p,
                                                 fio___mustache_bldr_s *b) {
-  fio_buf_info_s var = FIO_BUF_INFO2(p + 5, fio_buf2u16u(p + 1));
-  fio_buf_info_s padding = FIO_BUF_INFO2(p + 5 + var.len, fio_buf2u16u(p + 3));
+  fio_buf_info_s var = FIO_BUF_INFO2(p + 13, fio_buf2u16u(p + 1));
+  fio_buf_info_s padding = FIO_BUF_INFO2(p + 13 + var.len, fio_buf2u16u(p + 3));
+  uint64_t hash = fio_buf2u64u(p + 5);
   p = padding.buf + padding.len;
-  void *v = fio___mustache_get_var(b, var);
+  void *v = fio___mustache_get_var(b, var, hash);
   if (!v)
     return p;
   var = b->args->var2str(v);
@@ -21837,6 +25509,7 @@ FIO_SFUNC char *fio___mustache_i_var_raw_padded(char *p,
   fio___mustache_bldr_s b2 = *b;
   b2.padding = padding;
   fio___mustache_writer_route(&b2, var, b->args->write_text);
+done:
   b->args->release_var(v);
   return p;
 }
@@ -22044,7 +25717,7 @@ FIO_IFUNC int fio___mustache_parse_section_end(fio___mustache_parser_s *p,
   prev = p->root + p->starts_at;
   if (*prev != FIO___MUSTACHE_I_ARY && *prev != FIO___MUSTACHE_I_MISSING)
     goto section_not_open;
-  old_var_name = FIO_BUF_INFO2(prev + 7, (size_t)fio_buf2u16u(prev + 1));
+  old_var_name = FIO_BUF_INFO2(prev + 15, (size_t)fio_buf2u16u(prev + 1));
   if (!FIO_BUF_INFO_IS_EQ(old_var_name, var))
     goto value_name_mismatch;
 
@@ -22105,14 +25778,14 @@ FIO_IFUNC int fio___mustache_parse_section_start(fio___mustache_parser_s *p,
       .dirty = p->dirty,
   };
   union {
-    uint64_t u64[1];
-    char u8[8];
-  } buf;
+    uint64_t u64[2];
+    char u8[16];
+  } buf = {{0}};
   buf.u8[0] = FIO___MUSTACHE_I_ARY + inverted;
   fio_u2buf16u(buf.u8 + 1, var.len);
-  /* + 32 bit value to be filled by closure. */
+  /* + 32 bit value to be filled by closure, + 64 bit hash (see bind). */
   new_section.root = fio_bstr_write2(new_section.root,
-                                     FIO_STRING_WRITE_STR2(buf.u8, 7),
+                                     FIO_STRING_WRITE_STR2(buf.u8, 15),
                                      FIO_STRING_WRITE_STR2(var.buf, var.len));
 #if FIO_MUSTACHE_PRESERVE_PADDING
   if (!p->dirty && p->backwards.len) {
@@ -22230,9 +25903,9 @@ FIO_IFUNC int fio___mustache_parse_var_name(fio___mustache_parser_s *p,
                                             fio_buf_info_s var,
                                             size_t raw) {
   union {
-    uint64_t u64[1];
-    char u8[8];
-  } buf;
+    uint64_t u64[2];
+    char u8[16];
+  } buf = {{0}};
   if (p->backwards.len > ((1 << 16) - 1))
     p->backwards.len = 0;
 
@@ -22245,7 +25918,7 @@ FIO_IFUNC int fio___mustache_parse_var_name(fio___mustache_parser_s *p,
   buf.u8[0] = (char)(FIO___MUSTACHE_I_VAR + raw);
   fio_u2buf16u(buf.u8 + 1, var.len);
   p->root = fio_bstr_write2(p->root,
-                            FIO_STRING_WRITE_STR2(buf.u8, 3),
+                            FIO_STRING_WRITE_STR2(buf.u8, 11),
                             FIO_STRING_WRITE_STR2(var.buf, var.len));
   return 0;
 #if FIO_MUSTACHE_PRESERVE_PADDING
@@ -22256,7 +25929,7 @@ padded:
   fio_u2buf16u(buf.u8 + 3, p->backwards.len);
   p->root = fio_bstr_write2(
       p->root,
-      FIO_STRING_WRITE_STR2(buf.u8, 5),
+      FIO_STRING_WRITE_STR2(buf.u8, 13),
       FIO_STRING_WRITE_STR2(var.buf, var.len),
       FIO_STRING_WRITE_STR2(p->backwards.buf, p->backwards.len));
   return 0;
@@ -22499,6 +26172,108 @@ FIO_SFUNC int fio___mustache_dflt_is_lambda(
   (void)raw_template_section, (void)ctx, (void)udata;
 }
 
+/* *****************************************************************************
+Building to a list of buffers (iov) - helpers
+***************************************************************************** */
+
+typedef struct fio___mustache_iov_blk_s {
+  struct fio___mustache_iov_blk_s *next;
+  size_t len;
+  size_t capa;
+} fio___mustache_iov_blk_s;
+
+/* memory blocks never move, so the buffers pointing to them remain valid. */
+#define FIO___MUSTACHE_IOV_BLK_SIZE 4096
+
+/* returns a memory block with at least `len` bytes available */
+FIO_SFUNC fio___mustache_iov_blk_s *fio___mustache_iov_reserve(
+    fio_mustache_iov_s *o,
+    size_t len) {
+  fio___mustache_iov_blk_s *b = o->block;
+  if (b) {
+    for (;;) {
+      if (b->capa - b->len >= len)
+        return (o->block = b);
+      if (!b->next)
+        break;
+      b = b->next; /* skipped blocks are reused on the next render */
+    }
+  }
+  size_t capa = FIO___MUSTACHE_IOV_BLK_SIZE - sizeof(*b);
+  if (capa < len)
+    capa = len;
+  fio___mustache_iov_blk_s *n = (fio___mustache_iov_blk_s *)FIO_MEM_REALLOC_(
+      NULL,
+      0,
+      sizeof(*n) + capa,
+      0);
+  FIO_ASSERT_ALLOC(n);
+  n->next = NULL;
+  n->len = 0;
+  n->capa = capa;
+  if (b)
+    b->next = n;
+  else
+    o->blocks = n;
+  return (o->block = n);
+}
+
+/* adds a buffer to the list, merging contiguous buffers */
+FIO_SFUNC void fio___mustache_iov_push(fio_mustache_iov_s *o,
+                                       fio_buf_info_s buf) {
+  if (!buf.len)
+    return;
+  o->len += buf.len;
+  if (o->count &&
+      o->iov[o->count - 1].buf + o->iov[o->count - 1].len == buf.buf) {
+    o->iov[o->count - 1].len += buf.len;
+    return;
+  }
+  if (o->count == o->capa) {
+    size_t capa = o->capa ? (o->capa << 1) : 32;
+    o->iov = (fio_buf_info_s *)FIO_MEM_REALLOC_(o->iov,
+                                                o->capa * sizeof(*o->iov),
+                                                capa * sizeof(*o->iov),
+                                                o->count * sizeof(*o->iov));
+    FIO_ASSERT_ALLOC(o->iov);
+    o->capa = capa;
+  }
+  o->iov[o->count++] = buf;
+}
+
+/* template text is valid for as long as the template is (no copy). */
+FIO_SFUNC void *fio___mustache_iov_write_static(void *u, fio_buf_info_s txt) {
+  fio___mustache_iov_push((fio_mustache_iov_s *)u, txt);
+  return u;
+}
+
+FIO_SFUNC void *fio___mustache_iov_write_text(void *u, fio_buf_info_s txt) {
+  fio_mustache_iov_s *o = (fio_mustache_iov_s *)u;
+  if (!txt.len)
+    return u;
+  fio___mustache_iov_blk_s *b = fio___mustache_iov_reserve(o, txt.len);
+  char *dest = (char *)(b + 1) + b->len;
+  FIO_MEMCPY(dest, txt.buf, txt.len);
+  b->len += txt.len;
+  fio___mustache_iov_push(o, FIO_BUF_INFO2(dest, txt.len));
+  return u;
+}
+
+FIO_SFUNC void *fio___mustache_iov_write_escaped(void *u, fio_buf_info_s raw) {
+  fio_mustache_iov_s *o = (fio_mustache_iov_s *)u;
+  if (!raw.len)
+    return u;
+  /* HTML escaping reserves up to 7 bytes per escaped byte (+ NUL) */
+  fio___mustache_iov_blk_s *b =
+      fio___mustache_iov_reserve(o, (raw.len * 7) + 1);
+  fio_str_info_s d =
+      FIO_STR_INFO3((char *)(b + 1) + b->len, 0, (b->capa - b->len));
+  fio_string_write_html_escape(&d, NULL, raw.buf, raw.len);
+  b->len += d.len;
+  fio___mustache_iov_push(o, FIO_STR2BUF_INFO(d));
+  return u;
+}
+
 /* *****************************************************************************
 Public API
 ***************************************************************************** */
@@ -22536,7 +26311,10 @@ SFUNC fio_mustache_s *fio_mustache_load FIO_NOOP(fio_mustache_load_args_s a) {
     base_path = pathname.folder;
   }
   parser.args = &a;
-  parser.root = NULL;
+  { /* the first instruction holds the bound hash function (none yet) */
+    char hdr[FIO___MUSTACHE_HASH_FN_LEN] = {FIO___MUSTACHE_I_HASH_FN};
+    parser.root = fio_bstr_write(NULL, hdr, FIO___MUSTACHE_HASH_FN_LEN);
+  }
   parser.delim = fio___mustache_delimiter_init();
   parser.depth = 0;
   parser.fname = a.filename;
@@ -22597,6 +26375,15 @@ SFUNC void *fio_mustache_build FIO_NOOP(fio_mustache_s *m,
     args.release_var = fio___mustache_dflt_release_var;
   if (!args.is_lambda)
     args.is_lambda = fio___mustache_dflt_is_lambda;
+  if (!args.write_text_static)
+    args.write_text_static = args.write_text;
+  if (args.get_var_hashed) { /* was the template bound using `var_hash`? */
+    fio___mustache_hash_fn bound = NULL;
+    if (((char *)m)[0] == FIO___MUSTACHE_I_HASH_FN)
+      FIO_MEMCPY(&bound, (char *)m + 1, sizeof(bound));
+    if (!bound || bound != args.var_hash)
+      args.get_var_hashed = NULL;
+  }
 
   fio___mustache_bldr_s builder = {
       .root = (char *)m,
@@ -22606,6 +26393,449 @@ SFUNC void *fio_mustache_build FIO_NOOP(fio_mustache_s *m,
   return fio___mustache_build_section((char *)m, builder);
 }
 
+void fio_mustache_bind___(void); /* IDE marker */
+/** Pre-computes the hash value of every variable name in the template. */
+SFUNC void fio_mustache_bind(fio_mustache_s *m,
+                             uint64_t (*hash)(fio_buf_info_s name)) {
+  char *p = (char *)m;
+  if (!p || p[0] != FIO___MUSTACHE_I_HASH_FN)
+    return;
+  char *end = p + fio_bstr_len(p);
+  fio_buf_info_s name;
+  size_t hash_offset, padding;
+  FIO_MEMCPY(p + 1, &hash, sizeof(hash));
+  p += FIO___MUSTACHE_HASH_FN_LEN;
+  /* sections and partials are inlined, so instructions are walked in order */
+  while (p < end) {
+    padding = 0;
+    switch ((fio___mustache_inst_e)(uint8_t)p[0]) {
+    case FIO___MUSTACHE_I_STACK_POP: /* fall through */
+    case FIO___MUSTACHE_I_PADDING_POP: ++p; continue;
+    case FIO___MUSTACHE_I_STACK_PUSH: /* fall through */
+    case FIO___MUSTACHE_I_GOTO_PUSH: p += 5; continue;
+    case FIO___MUSTACHE_I_HASH_FN: p += FIO___MUSTACHE_HASH_FN_LEN; continue;
+    case FIO___MUSTACHE_I_VAR: /* fall through */
+    case FIO___MUSTACHE_I_VAR_RAW:
+      name = FIO_BUF_INFO2(p + 11, fio_buf2u16u(p + 1));
+      hash_offset = 3;
+      break;
+    case FIO___MUSTACHE_I_ARY: /* fall through */
+    case FIO___MUSTACHE_I_MISSING:
+      name = FIO_BUF_INFO2(p + 15, fio_buf2u16u(p + 1));
+      hash_offset = 7;
+      break;
+#if FIO_MUSTACHE_PRESERVE_PADDING
+    case FIO___MUSTACHE_I_VAR_PADDED: /* fall through */
+    case FIO___MUSTACHE_I_VAR_RAW_PADDED:
+      name = FIO_BUF_INFO2(p + 13, fio_buf2u16u(p + 1));
+      hash_offset = 5;
+      padding = fio_buf2u16u(p + 3);
+      break;
+#endif
+    default: /* text, padding and metadata: 16 bit length + data */
+      p += 3 + fio_buf2u16u(p + 1);
+      continue;
+    }
+    fio_u2buf64u(p + hash_offset, (hash ? hash(name) : 0));
+    p = name.buf + name.len + padding;
+  }
+}
+
+void fio_mustache_build_iov___(void); /* IDE marker */
+/** Builds the template into `dest` as a list of buffers. */
+SFUNC size_t fio_mustache_build_iov FIO_NOOP(fio_mustache_s *m,
+                                             fio_mustache_iov_s *dest,
+                                             fio_mustache_bargs_s args) {
+  if (!dest)
+    return 0;
+  dest->count = 0;
+  dest->len = 0;
+  for (fio___mustache_iov_blk_s *b = dest->blocks; b; b = b->next)
+    b->len = 0;
+  dest->block = dest->blocks;
+  if (dest->m != m) {
+    fio_mustache_free(dest->m);
+    dest->m = fio_mustache_dup(m);
+  }
+  if (!m)
+    return 0;
+  args.write_text = fio___mustache_iov_write_text;
+  args.write_text_escaped = fio___mustache_iov_write_escaped;
+  args.write_text_static = fio___mustache_iov_write_static;
+  args.udata = (void *)dest;
+  fio_mustache_build FIO_NOOP(m, args);
+  return dest->count;
+}
+
+/** Frees the memory used by a `fio_mustache_iov_s` (and zeroes it out). */
+SFUNC void fio_mustache_iov_destroy(fio_mustache_iov_s *o) {
+  if (!o)
+    return;
+  while (o->blocks) {
+    fio___mustache_iov_blk_s *next = o->blocks->next;
+    FIO_MEM_FREE_(o->blocks, sizeof(*o->blocks) + o->blocks->capa);
+    o->blocks = next;
+  }
+  FIO_MEM_FREE_(o->iov, o->capa * sizeof(*o->iov));
+  fio_mustache_free(o->m);
+  *o = (fio_mustache_iov_s){0};
+}
+
+/* *****************************************************************************
+Mustache Template Cache - Types
+***************************************************************************** */
+
+/* a cached file, possibly compiled as a (root) template */
+typedef struct {
+  FIO_LIST_NODE node; /* LRU order (most recently used last) */
+  uint64_t hash;      /* file name hash */
+  uint64_t content;   /* file content hash (0 == missing) */
+  int64_t mtime;      /* file modification time (when read) */
+  size_t size;        /* file size (when read) */
+  int64_t tested;     /* last time the file was tested for changes */
+  int64_t checked;    /* last time the template's files were checked */
+  char *data;         /* the file's content (fio_bstr) */
+  fio_mustache_s *m;  /* the compiled template (if loaded as a template) */
+  char *deps;         /* template files: [u64 content][u16 len][name] ... */
+  char *name;         /* the file name (NUL terminated) */
+  size_t name_len;
+} fio___mustache_cache_s;
+
+#define FIO___MUSTACHE_CACHE_HASH(o) ((*(o))->hash)
+#define FIO___MUSTACHE_CACHE_IS_EQ(a, b)                                       \
+  ((*(a))->hash == (*(b))->hash && (*(a))->name_len == (*(b))->name_len &&     \
+   !FIO_MEMCMP((*(a))->name, (*(b))->name, (*(a))->name_len))
+#define FIO___MUSTACHE_CACHE_IS_VALID(o) (*(o))
+FIO_TYPEDEF_IMAP_ARRAY(fio___mustache_cache_map,
+                       fio___mustache_cache_s *,
+                       uint32_t,
+                       FIO___MUSTACHE_CACHE_HASH,
+                       FIO___MUSTACHE_CACHE_IS_EQ,
+                       FIO___MUSTACHE_CACHE_IS_VALID)
+#undef FIO___MUSTACHE_CACHE_HASH
+#undef FIO___MUSTACHE_CACHE_IS_EQ
+#undef FIO___MUSTACHE_CACHE_IS_VALID
+
+static struct {
+  fio___mustache_cache_map_s map;
+  FIO_LIST_HEAD lru;
+  size_t memory;
+  size_t limit;
+  int64_t throttle;
+  fio_lock_i lock;
+  uint8_t at_exit;
+} fio___mustache_cache = {
+    .lru = {.next = &fio___mustache_cache.lru,
+            .prev = &fio___mustache_cache.lru},
+    .limit = FIO_MUSTACHE_CACHE_LIMIT,
+    .throttle = FIO_MUSTACHE_CACHE_THROTTLE,
+};
+
+/* *****************************************************************************
+Mustache Template Cache - Helpers (called while locked)
+***************************************************************************** */
+
+FIO_IFUNC size_t fio___mustache_cache_mem(fio___mustache_cache_s *e) {
+  return sizeof(*e) + e->name_len + 1 + (e->data ? fio_bstr_len(e->data) : 0) +
+         (e->m ? fio_bstr_len((char *)e->m) : 0) +
+         (e->deps ? fio_bstr_len(e->deps) : 0);
+}
+
+FIO_SFUNC fio___mustache_cache_s *fio___mustache_cache_find(
+    fio_buf_info_s name) {
+  fio___mustache_cache_s tmp = {.hash = fio_risky_hash(name.buf, name.len, 0),
+                                .name = name.buf,
+                                .name_len = name.len};
+  fio___mustache_cache_s **pe =
+      fio___mustache_cache_map_get(&fio___mustache_cache.map, &tmp);
+  return pe ? pe[0] : NULL;
+}
+
+FIO_SFUNC void fio___mustache_cache_destroy(fio___mustache_cache_s *e) {
+  fio___mustache_cache.memory -= fio___mustache_cache_mem(e);
+  fio___mustache_cache_map_remove(&fio___mustache_cache.map, e);
+  FIO_LIST_REMOVE(&e->node);
+  fio_mustache_free(e->m);
+  fio_bstr_free(e->data);
+  fio_bstr_free(e->deps);
+  FIO_MEM_FREE_(e, sizeof(*e) + e->name_len + 1);
+}
+
+/* evicts the least recently used entries (except `keep`) */
+FIO_SFUNC void fio___mustache_cache_evict(fio___mustache_cache_s *keep) {
+  FIO_LIST_EACH(fio___mustache_cache_s, node, &fio___mustache_cache.lru, e) {
+    if (fio___mustache_cache.memory <= fio___mustache_cache.limit)
+      return;
+    if (e != keep)
+      fio___mustache_cache_destroy(e);
+  }
+}
+
+FIO_SFUNC void fio___mustache_cache_at_exit(void *ignr_) {
+  fio_mustache_cache_clear();
+  (void)ignr_;
+}
+
+/* updates (or adds) a file's entry, returns a copy of the file's content. */
+FIO_SFUNC char *fio___mustache_cache_update(fio_buf_info_s name,
+                                            fio___mustache_cache_s *file,
+                                            uint64_t *content) {
+  fio___mustache_cache_s *e = fio___mustache_cache_find(name);
+  char *r = NULL;
+  if (!e) {
+    if (!file->data) /* don't cache missing files */
+      return r;
+    e = (fio___mustache_cache_s *)FIO_MEM_REALLOC_(NULL,
+                                                   0,
+                                                   sizeof(*e) + name.len + 1,
+                                                   0);
+    FIO_ASSERT_ALLOC(e);
+    *e = (fio___mustache_cache_s){
+        .hash = fio_risky_hash(name.buf, name.len, 0),
+        .name = (char *)(e + 1),
+        .name_len = name.len,
+    };
+    FIO_MEMCPY(e->name, name.buf, name.len);
+    e->name[name.len] = 0;
+    fio___mustache_cache.memory += fio___mustache_cache_mem(e);
+    fio___mustache_cache_map_set(&fio___mustache_cache.map, e, 1);
+    FIO_LIST_PUSH(&fio___mustache_cache.lru, &e->node);
+    if (!fio___mustache_cache.at_exit) {
+      fio___mustache_cache.at_exit = 1;
+      fio_state_callback_add(FIO_CALL_AT_EXIT,
+                             fio___mustache_cache_at_exit,
+                             NULL);
+    }
+  }
+  fio___mustache_cache.memory -= fio___mustache_cache_mem(e);
+  e->tested = file->tested;
+  e->mtime = file->mtime;
+  e->size = file->size;
+  if (!file->data || file->content != e->content) {
+    fio_bstr_free(e->data);
+    e->data = file->data;
+    e->content = file->content;
+    file->data = NULL;
+  }
+  fio___mustache_cache.memory += fio___mustache_cache_mem(e);
+  if (e->data) {
+    r = fio_bstr_copy(e->data);
+    *content = e->content;
+  }
+  return r;
+}
+
+/* *****************************************************************************
+Mustache Template Cache - Loading (file access happens without the lock)
+***************************************************************************** */
+
+/* returns a copy of the (cached) file's content, or NULL if it's missing. */
+FIO_SFUNC char *fio___mustache_cache_file(fio_buf_info_s name,
+                                          uint64_t *content) {
+  fio___mustache_cache_s file = {.tested = fio_time_milli()};
+  fio___mustache_cache_s *e;
+  struct stat st;
+  char *path;
+  char *r = NULL;
+  fio_lock(&fio___mustache_cache.lock);
+  e = fio___mustache_cache_find(name);
+  if (e && e->data) {
+    FIO_LIST_REMOVE(&e->node);
+    FIO_LIST_PUSH(&fio___mustache_cache.lru, &e->node);
+    if (file.tested - e->tested < fio___mustache_cache.throttle) {
+      r = fio_bstr_copy(e->data);
+      *content = e->content;
+    } else { /* test the file (for changes) after unlocking */
+      file.mtime = e->mtime;
+      file.size = e->size;
+      file.content = e->content;
+    }
+  }
+  fio_unlock(&fio___mustache_cache.lock);
+  if (r)
+    return r;
+  path = fio_bstr_write(NULL, name.buf, name.len);
+  if (stat(path, &st) || (size_t)st.st_size > ((size_t)1 << 30))
+    goto update;
+  if (file.content && (int64_t)st.st_mtime == file.mtime &&
+      (size_t)st.st_size == file.size) { /* unchanged, keep the cached data */
+    fio_lock(&fio___mustache_cache.lock);
+    e = fio___mustache_cache_find(name);
+    if (e && e->data && e->content == file.content) {
+      e->tested = file.tested;
+      r = fio_bstr_copy(e->data);
+      *content = e->content;
+    }
+    fio_unlock(&fio___mustache_cache.lock);
+    if (r)
+      goto finish;
+  }
+  file.data = fio_bstr_readfile(NULL, path, 0, 0);
+  if (file.data) {
+    file.mtime = (int64_t)st.st_mtime;
+    file.size = (size_t)st.st_size;
+    file.content = fio_risky_hash(file.data, fio_bstr_len(file.data), 0);
+    file.content += !file.content;
+  }
+update:
+  if (!file.data)
+    file = (fio___mustache_cache_s){.tested = file.tested};
+  fio_lock(&fio___mustache_cache.lock);
+  r = fio___mustache_cache_update(name, &file, content);
+  fio_unlock(&fio___mustache_cache.lock);
+  fio_bstr_free(file.data); /* if the content didn't change */
+finish:
+  fio_bstr_free(path);
+  return r;
+}
+
+/* returns non-zero if any of the template's files changed. */
+FIO_SFUNC int fio___mustache_cache_is_stale(char *deps) {
+  char *p = deps;
+  char *end = p + fio_bstr_len(p);
+  while (p < end) {
+    fio_buf_info_s name = FIO_BUF_INFO2(p + 10, fio_buf2u16u(p + 8));
+    uint64_t content = 0;
+    char *data = fio___mustache_cache_file(name, &content);
+    fio_bstr_free(data);
+    if (!data || content != fio_buf2u64u(p))
+      return 1;
+    p = name.buf + name.len;
+  }
+  return 0;
+}
+
+/* load_file_data callback - loads files through the cache. */
+FIO_SFUNC fio_buf_info_s fio___mustache_cache_load(fio_buf_info_s name,
+                                                   void *udata) {
+  char **deps = (char **)udata;
+  fio_buf_info_s r = {0};
+  uint64_t content = 0;
+  char *data;
+  char buf[10];
+  if (!name.len || name.len > 0xFFFF)
+    return r;
+  data = fio___mustache_cache_file(name, &content);
+  if (!data)
+    return r;
+  fio_u2buf64u(buf, content);
+  fio_u2buf16u(buf + 8, name.len);
+  *deps = fio_bstr_write2(*deps,
+                          FIO_STRING_WRITE_STR2(buf, 10),
+                          FIO_STRING_WRITE_STR2(name.buf, name.len));
+  return fio_bstr_buf(data); /* a copy, the cached data may be replaced */
+}
+
+/* free_file_data callback */
+FIO_SFUNC void fio___mustache_cache_unload(fio_buf_info_s data, void *udata) {
+  fio_bstr_free(data.buf);
+  (void)udata;
+}
+
+/* *****************************************************************************
+Mustache Template Cache - Public API
+***************************************************************************** */
+
+void fio_mustache_cache_get___(void); /* IDE marker */
+/** Returns a compiled template from the process-wide template cache. */
+SFUNC fio_mustache_s *fio_mustache_cache_get FIO_NOOP(
+    fio_mustache_cache_args_s args) {
+  fio_mustache_s *r = NULL;
+  fio_mustache_s *m;
+  fio___mustache_cache_s *e;
+  char *deps = NULL;
+  int64_t now;
+  if (!args.filename.buf)
+    return r;
+  if (!args.filename.len)
+    args.filename.len = FIO_STRLEN(args.filename.buf);
+  if (args.filename.len > 0xFFFF)
+    return r;
+  now = fio_time_milli();
+  fio_lock(&fio___mustache_cache.lock);
+  e = fio___mustache_cache_find(args.filename);
+  if (e && e->m) {
+    FIO_LIST_REMOVE(&e->node);
+    FIO_LIST_PUSH(&fio___mustache_cache.lru, &e->node);
+    r = fio_mustache_dup(e->m);
+    if (now - e->checked >= fio___mustache_cache.throttle) {
+      e->checked = now; /* other threads use the template while we test it */
+      deps = fio_bstr_copy(e->deps);
+    }
+  }
+  fio_unlock(&fio___mustache_cache.lock);
+  if (r) {
+    int stale = deps && fio___mustache_cache_is_stale(deps);
+    fio_bstr_free(deps);
+    deps = NULL;
+    if (!stale)
+      return r;
+  }
+  /* (re)compile the template (files are loaded through the cache) */
+  m = fio_mustache_load(.filename = args.filename,
+                        .load_file_data = fio___mustache_cache_load,
+                        .free_file_data = fio___mustache_cache_unload,
+                        .udata = (void *)&deps);
+  if (m && args.var_hash)
+    fio_mustache_bind(m, args.var_hash);
+  fio_lock(&fio___mustache_cache.lock);
+  e = fio___mustache_cache_find(args.filename);
+  if (!m || !e) {
+    fio_bstr_free(deps);
+    fio_mustache_free(r);
+    r = NULL;
+    if (e && e->m && e->data) { /* keep the last valid template */
+      FIO_LOG_WARNING("(mustache) template cache: couldn't reload %.*s",
+                      (int)args.filename.len,
+                      args.filename.buf);
+      r = fio_mustache_dup(e->m);
+    } else if (e && e->m) { /* the template's file was removed */
+      fio___mustache_cache.memory -= fio___mustache_cache_mem(e);
+      fio_mustache_free(e->m);
+      fio_bstr_free(e->deps);
+      e->m = NULL;
+      e->deps = NULL;
+      fio___mustache_cache.memory += fio___mustache_cache_mem(e);
+    }
+    fio_mustache_free(m);
+    goto finish;
+  }
+  fio___mustache_cache.memory -= fio___mustache_cache_mem(e);
+  fio_mustache_free(e->m); /* templates in use hold their own reference */
+  fio_bstr_free(e->deps);
+  e->m = m;
+  e->deps = deps;
+  e->checked = now;
+  fio___mustache_cache.memory += fio___mustache_cache_mem(e);
+  fio_mustache_free(r);
+  r = fio_mustache_dup(m);
+  fio___mustache_cache_evict(e);
+finish:
+  fio_unlock(&fio___mustache_cache.lock);
+  return r;
+}
+
+/** Sets the template cache's memory limit and file change test interval. */
+SFUNC void fio_mustache_cache_config(size_t memory_limit, int64_t throttle) {
+  fio_lock(&fio___mustache_cache.lock);
+  fio___mustache_cache.limit =
+      memory_limit ? memory_limit : FIO_MUSTACHE_CACHE_LIMIT;
+  fio___mustache_cache.throttle =
+      (throttle < 0) ? FIO_MUSTACHE_CACHE_THROTTLE : throttle;
+  fio___mustache_cache_evict(NULL);
+  fio_unlock(&fio___mustache_cache.lock);
+}
+
+/** Removes all templates from the cache (templates in use remain valid). */
+SFUNC void fio_mustache_cache_clear(void) {
+  fio_lock(&fio___mustache_cache.lock);
+  FIO_LIST_EACH(fio___mustache_cache_s, node, &fio___mustache_cache.lru, e) {
+    fio___mustache_cache_destroy(e);
+  }
+  fio___mustache_cache_map_destroy(&fio___mustache_cache.map);
+  fio_unlock(&fio___mustache_cache.lock);
+}
+
 /* *****************************************************************************
 Cleanup
 ***************************************************************************** */
@@ -26915,6 +31145,7 @@ SFUNC void FIO_NAME(FIO_ARRAY_NAME, destroy)(FIO_ARRAY_PTR ary_) {
 SFUNC uint32_t FIO_NAME(FIO_ARRAY_NAME, reserve)(FIO_ARRAY_PTR ary_,
                                                  int64_t capa_) {
   FIO_PTR_TAG_VALID_OR_RETURN(ary_, 0);
+  FIO_PTR_TAG_WRITABLE_OR_RETURN(ary_, 0);
   FIO_NAME(FIO_ARRAY_NAME, s) *ary =
       FIO_PTR_TAG_GET_UNTAGGED(FIO_NAME(FIO_ARRAY_NAME, s), ary_);
   if (capa_ > UINT32_MAX || capa_ < ((int64_t)0LL - UINT32_MAX))
@@ -27028,6 +31259,7 @@ SFUNC FIO_ARRAY_PTR FIO_NAME(FIO_ARRAY_NAME, concat)(FIO_ARRAY_PTR dest_,
                                                      FIO_ARRAY_PTR src_) {
   FIO_PTR_TAG_VALID_OR_RETURN(dest_, (FIO_ARRAY_PTR)NULL);
   FIO_PTR_TAG_VALID_OR_RETURN(src_, (FIO_ARRAY_PTR)NULL);
+  FIO_PTR_TAG_WRITABLE_OR_RETURN(dest_, (FIO_ARRAY_PTR)NULL);
   FIO_NAME(FIO_ARRAY_NAME, s) *dest =
       FIO_PTR_TAG_GET_UNTAGGED(FIO_NAME(FIO_ARRAY_NAME, s), dest_);
   FIO_NAME(FIO_ARRAY_NAME, s) *src =
@@ -27097,6 +31329,7 @@ SFUNC FIO_ARRAY_TYPE *FIO_NAME(FIO_ARRAY_NAME, set)(FIO_ARRAY_PTR ary_,
   uint8_t pre_existing = 1;
 
   FIO_PTR_TAG_VALID_OR_GOTO(ary_, invalid);
+  FIO_PTR_TAG_WRITABLE_OR_GOTO(ary_, invalid);
 
   ary = FIO_PTR_TAG_GET_UNTAGGED(FIO_NAME(FIO_ARRAY_NAME, s), ary_);
   count = FIO_NAME(FIO_ARRAY_NAME, count)(ary_);
@@ -27278,6 +31511,7 @@ SFUNC int FIO_NAME(FIO_ARRAY_NAME, remove)(FIO_ARRAY_PTR ary_,
   size_t count;
   if (!a)
     goto invalid;
+  FIO_PTR_TAG_WRITABLE_OR_GOTO(ary_, invalid);
   count = FIO_NAME(FIO_ARRAY_NAME, count)(ary_);
 
   if (index < 0) {
@@ -27346,6 +31580,7 @@ SFUNC uint32_t FIO_NAME(FIO_ARRAY_NAME, remove2)(FIO_ARRAY_PTR ary_,
   size_t count;
   if (!a)
     return (uint32_t)c;
+  FIO_PTR_TAG_WRITABLE_OR_RETURN(ary_, 0);
   count = FIO_NAME(FIO_ARRAY_NAME, count)(ary_);
 
   size_t i = 0;
@@ -27373,6 +31608,7 @@ SFUNC uint32_t FIO_NAME(FIO_ARRAY_NAME, remove2)(FIO_ARRAY_PTR ary_,
 /** Attempts to lower the array's memory consumption. */
 SFUNC void FIO_NAME(FIO_ARRAY_NAME, compact)(FIO_ARRAY_PTR ary_) {
   FIO_PTR_TAG_VALID_OR_RETURN_VOID(ary_);
+  FIO_PTR_TAG_WRITABLE_OR_RETURN_VOID(ary_);
   FIO_NAME(FIO_ARRAY_NAME, s) *ary =
       FIO_PTR_TAG_GET_UNTAGGED(FIO_NAME(FIO_ARRAY_NAME, s), ary_);
   size_t count = FIO_NAME(FIO_ARRAY_NAME, count)(ary_);
@@ -27423,6 +31659,7 @@ SFUNC FIO_ARRAY_TYPE *FIO_NAME(FIO_ARRAY_NAME, push)(FIO_ARRAY_PTR ary_,
                                                      FIO_ARRAY_TYPE data) {
   FIO_NAME(FIO_ARRAY_NAME, s) *ary =
       FIO_PTR_TAG_GET_UNTAGGED(FIO_NAME(FIO_ARRAY_NAME, s), ary_);
+  FIO_PTR_TAG_WRITABLE_OR_GOTO(ary_, invalid);
   switch (FIO_NAME_BL(FIO_ARRAY_NAME, embedded)(ary_)) {
   case 0:
     if (ary->end == ary->capa) {
@@ -27476,6 +31713,7 @@ SFUNC int FIO_NAME(FIO_ARRAY_NAME, pop)(FIO_ARRAY_PTR ary_,
                                         FIO_ARRAY_TYPE *old) {
   FIO_NAME(FIO_ARRAY_NAME, s) *ary =
       FIO_PTR_TAG_GET_UNTAGGED(FIO_NAME(FIO_ARRAY_NAME, s), ary_);
+  FIO_PTR_TAG_WRITABLE_OR_GOTO(ary_, invalid);
   switch (FIO_NAME_BL(FIO_ARRAY_NAME, embedded)(ary_)) {
   case 0:
     if (ary->end == ary->start)
@@ -27507,6 +31745,7 @@ SFUNC int FIO_NAME(FIO_ARRAY_NAME, pop)(FIO_ARRAY_PTR ary_,
                sizeof(*ary->ary));
     return 0;
   }
+invalid:
   if (old)
     FIO_ARRAY_TYPE_COPY(old[0], FIO_ARRAY_TYPE_INVALID);
   return -1;
@@ -27521,6 +31760,7 @@ SFUNC FIO_ARRAY_TYPE *FIO_NAME(FIO_ARRAY_NAME, unshift)(FIO_ARRAY_PTR ary_,
                                                         FIO_ARRAY_TYPE data) {
   FIO_NAME(FIO_ARRAY_NAME, s) *ary =
       FIO_PTR_TAG_GET_UNTAGGED(FIO_NAME(FIO_ARRAY_NAME, s), ary_);
+  FIO_PTR_TAG_WRITABLE_OR_GOTO(ary_, invalid);
   switch (FIO_NAME_BL(FIO_ARRAY_NAME, embedded)(ary_)) {
   case 0:
     if (!ary->start) {
@@ -27583,6 +31823,7 @@ SFUNC int FIO_NAME(FIO_ARRAY_NAME, shift)(FIO_ARRAY_PTR ary_,
 
   FIO_NAME(FIO_ARRAY_NAME, s) *ary =
       FIO_PTR_TAG_GET_UNTAGGED(FIO_NAME(FIO_ARRAY_NAME, s), ary_);
+  FIO_PTR_TAG_WRITABLE_OR_GOTO(ary_, invalid);
 
   switch (FIO_NAME_BL(FIO_ARRAY_NAME, embedded)(ary_)) {
   case 0:
@@ -27621,6 +31862,7 @@ SFUNC int FIO_NAME(FIO_ARRAY_NAME, shift)(FIO_ARRAY_PTR ary_,
                sizeof(*ary->ary));
     return 0;
   }
+invalid:
   if (old)
     FIO_ARRAY_TYPE_COPY(old[0], FIO_ARRAY_TYPE_INVALID);
   return -1;
@@ -28241,6 +32483,21 @@ FIO_SFUNC void FIO_NAME(FIO_MAP_NAME, __key_free)(void *ptr, size_t len) {
 #define FIO_MAP_ORDERED 0
 #endif
 
+/* FIO_MAP_INCREMENTAL - if true, larger maps are rehashed incrementally. */
+#ifndef FIO_MAP_INCREMENTAL
+#define FIO_MAP_INCREMENTAL 0
+#elif ((0 - FIO_MAP_INCREMENTAL - 1) == 1) /* defined as an empty macro */
+#undef FIO_MAP_INCREMENTAL
+#define FIO_MAP_INCREMENTAL 1 /* assume developer's intention */
+#endif
+#if FIO_MAP_INCREMENTAL && FIO_MAP_ORDERED
+#error "FIO_MAP_INCREMENTAL requires an unordered map (FIO_UMAP_NAME)."
+#endif
+#ifndef FIO_MAP_INCREMENTAL_SLOTS
+/* The number of old slots migrated by every map operation while rehashing. */
+#define FIO_MAP_INCREMENTAL_SLOTS 32
+#endif
+
 /* *****************************************************************************
 Pointer Tagging Support
 ***************************************************************************** */
@@ -28273,6 +32530,14 @@ typedef struct FIO_NAME(FIO_MAP_NAME, s) {
 #if FIO_MAP_ORDERED
   FIO_INDEXED_LIST32_HEAD head;
 #endif
+#if FIO_MAP_INCREMENTAL
+  struct { /* the previous table, while migrating (internal usage) */
+    uint32_t bits;
+    uint32_t count; /* entries yet to be migrated */
+    uint32_t pos;   /* the next slot to be migrated */
+    FIO_NAME(FIO_MAP_NAME, node_s) * map;
+  } old;
+#endif
 } FIO_NAME(FIO_MAP_NAME, s);
 
 /** internal object data representation */
@@ -28400,6 +32665,17 @@ FIO_IFUNC FIO_MAP_GET_T FIO_NAME(FIO_MAP_NAME, get)(FIO_MAP_PTR map,
 #endif
                                                     FIO_MAP_KEY key);
 
+#if defined(FIO_MAP_HASH_FN)
+/**
+ * Gets a value from the map using a pre-computed hash value (the value
+ * `FIO_MAP_HASH_FN(key)` returns), avoiding the hashing step for keys that are
+ * looked up often.
+ */
+SFUNC FIO_MAP_GET_T FIO_NAME(FIO_MAP_NAME, get_hashed)(FIO_MAP_PTR map,
+                                                       uint64_t hash,
+                                                       FIO_MAP_KEY key);
+#endif
+
 /** Sets a value in the map, hash maps will overwrite existing data if any. */
 FIO_IFUNC FIO_MAP_GET_T FIO_NAME(FIO_MAP_NAME, set)(FIO_MAP_PTR map,
 #if !defined(FIO_MAP_HASH_FN)
@@ -28812,6 +33088,10 @@ struct FIO_NAME(FIO_MAP_NAME, __imap_s) {
 #ifndef FIO_MAP_SEEK_LIMIT
 #define FIO_MAP_SEEK_LIMIT 13U
 #endif
+#ifndef FIO_MAP_LOAD_LIMIT
+/* maximum number of entries before larger maps grow (7/8 of capacity) */
+#define FIO_MAP_LOAD_LIMIT(capa) ((capa) - ((capa) >> 3))
+#endif
 #ifndef FIO_MAP_ARRAY_LOG_LIMIT
 #define FIO_MAP_ARRAY_LOG_LIMIT 3
 #endif
@@ -28877,6 +33157,12 @@ typedef struct FIO_NAME(FIO_MAP_NAME, __each_node_s) {
   void *udata;
 } FIO_NAME(FIO_MAP_NAME, __each_node_s);
 
+#if FIO_MAP_INCREMENTAL
+/* completes a pending incremental rehash (blocking). */
+FIO_SFUNC int FIO_NAME(FIO_MAP_NAME,
+                       __rehash_finish)(FIO_NAME(FIO_MAP_NAME, s) * o);
+#endif
+
 void fio___map___each_node___(void); /* IDE Marker */
 /* perform task for each node. */
 FIO_IFUNC int FIO_NAME(FIO_MAP_NAME,
@@ -28886,6 +33172,10 @@ FIO_IFUNC int FIO_NAME(FIO_MAP_NAME,
                                     void *udata) {
   FIO_NAME(FIO_MAP_NAME, __each_node_s)
   each = {.map = o, .fn = fn, .udata = udata};
+#if FIO_MAP_INCREMENTAL
+  if (o->old.map) /* iteration is O(n) anyway, complete the migration */
+    FIO_NAME(FIO_MAP_NAME, __rehash_finish)(o);
+#endif
   uint8_t *imap = FIO_NAME(FIO_MAP_NAME, __imap)(o);
   size_t counter = o->count;
   if (!counter)
@@ -28964,10 +33254,37 @@ static int FIO_NAME(FIO_MAP_NAME,
 }
 #endif
 
+#if FIO_MAP_INCREMENTAL
+FIO_IFUNC void FIO_NAME(FIO_MAP_NAME, __free_map)(FIO_NAME(FIO_MAP_NAME, s) * o,
+                                                  _Bool should_destroy);
+/* Returns a (temporary) map object for the previous table. */
+FIO_IFUNC FIO_NAME(FIO_MAP_NAME, s)
+    FIO_NAME(FIO_MAP_NAME, __old_view)(FIO_NAME(FIO_MAP_NAME, s) * o) {
+  FIO_NAME(FIO_MAP_NAME, s) r = {0};
+  r.bits = o->old.bits;
+  r.count = o->old.count;
+  r.map = o->old.map;
+  return r;
+}
+/* Frees the previous table (destroying any entries not yet migrated). */
+FIO_IFUNC void FIO_NAME(FIO_MAP_NAME,
+                        __old_free)(FIO_NAME(FIO_MAP_NAME, s) * o,
+                                    _Bool should_destroy) {
+  FIO_NAME(FIO_MAP_NAME, s) old = FIO_NAME(FIO_MAP_NAME, __old_view)(o);
+  o->count -= o->old.count;
+  FIO_NAME(FIO_MAP_NAME, __free_map)(&old, should_destroy);
+  FIO_MEMSET(&o->old, 0, sizeof(o->old));
+}
+#endif
+
 /* Destroys and exsiting map. */
 FIO_IFUNC void FIO_NAME(FIO_MAP_NAME,
                         __destroy_map)(FIO_NAME(FIO_MAP_NAME, s) * o,
                                        _Bool should_zero) {
+#if FIO_MAP_INCREMENTAL
+  if (o->old.map)
+    FIO_NAME(FIO_MAP_NAME, __old_free)(o, 1);
+#endif
 #if !FIO_MAP_KEY_DESTROY_SIMPLE || !FIO_MAP_VALUE_DESTROY_SIMPLE
   FIO_NAME(FIO_MAP_NAME, __each_node)
   (o, FIO_NAME(FIO_MAP_NAME, __destroy_map_task), NULL);
@@ -28984,6 +33301,10 @@ FIO_IFUNC void FIO_NAME(FIO_MAP_NAME, __free_map)(FIO_NAME(FIO_MAP_NAME, s) * o,
     return;
   if (should_destroy)
     FIO_NAME(FIO_MAP_NAME, __destroy_map)(o, 0);
+#if FIO_MAP_INCREMENTAL
+  if (o->old.map)
+    FIO_NAME(FIO_MAP_NAME, __old_free)(o, 0);
+#endif
   FIO_MEM_FREE_(o->map, ((sizeof(o->map[0]) + 1) << o->bits));
   FIO_LEAK_COUNTER_ON_FREE(FIO_NAME(FIO_MAP_NAME, destroy));
   *o = (FIO_NAME(FIO_MAP_NAME, s)){0};
@@ -28997,6 +33318,97 @@ typedef struct {
   uint32_t alt;
   uint32_t bhash;
 } fio___map_node_info_s;
+
+/* Group probing result - a bitmap with one bit per imap byte in the group. */
+typedef struct {
+  uint32_t match;   /* bytes equal to the hash tag (byte hash) */
+  uint32_t empty;   /* bytes never occupied (0) */
+  uint32_t deleted; /* tombstones (255) */
+} fio___map_group_s;
+
+/* marks (0x80) every zero byte in a 64 bit word (no false positives). */
+#define FIO___MAP_SWAR_ZERO(w)                                                 \
+  (~((((w)&UINT64_C(0x7F7F7F7F7F7F7F7F)) + UINT64_C(0x7F7F7F7F7F7F7F7F)) |     \
+     (w) | UINT64_C(0x7F7F7F7F7F7F7F7F)))
+/* packs the 0x80 bits of a little endian word into an 8 bit bitmap. */
+#define FIO___MAP_SWAR_PACK(w)                                                 \
+  ((uint32_t)((((w) >> 7) * UINT64_C(0x0102040810204080)) >> 56))
+
+/* tests 16 imap bytes using SWAR (2 x 8 byte words). */
+FIO_IFUNC fio___map_group_s fio___map_group_swar(const uint8_t *imap,
+                                                 uint8_t tag) {
+  fio___map_group_s r = {0};
+  const uint64_t mtag = UINT64_C(0x0101010101010101) * tag;
+  for (size_t i = 0; i < 16; i += 8) {
+    const uint64_t w = fio_buf2u64_le(imap + i);
+    r.match |= FIO___MAP_SWAR_PACK(FIO___MAP_SWAR_ZERO(w ^ mtag)) << i;
+    r.empty |= FIO___MAP_SWAR_PACK(FIO___MAP_SWAR_ZERO(w)) << i;
+    r.deleted |= FIO___MAP_SWAR_PACK(FIO___MAP_SWAR_ZERO(~w)) << i;
+  }
+  return r;
+}
+#undef FIO___MAP_SWAR_ZERO
+#undef FIO___MAP_SWAR_PACK
+
+#if FIO___HAS_X86_INTRIN && defined(__AVX2__)
+/* The number of imap bytes tested at once. */
+#define FIO___MAP_GROUP_SIZE 32
+/* tests 32 imap bytes using AVX2. */
+FIO_IFUNC fio___map_group_s fio___map_group(const uint8_t *imap, uint8_t tag) {
+  const __m256i v = _mm256_loadu_si256((const __m256i *)imap);
+  fio___map_group_s r = {
+      (uint32_t)_mm256_movemask_epi8(
+          _mm256_cmpeq_epi8(v, _mm256_set1_epi8((char)tag))),
+      (uint32_t)_mm256_movemask_epi8(
+          _mm256_cmpeq_epi8(v, _mm256_setzero_si256())),
+      (uint32_t)_mm256_movemask_epi8(
+          _mm256_cmpeq_epi8(v, _mm256_set1_epi8((char)0xFF))),
+  };
+  return r;
+}
+
+#elif FIO___HAS_X86_INTRIN
+#define FIO___MAP_GROUP_SIZE 16
+/* tests 16 imap bytes using SSE2. */
+FIO_IFUNC fio___map_group_s fio___map_group(const uint8_t *imap, uint8_t tag) {
+  const __m128i v = _mm_loadu_si128((const __m128i *)imap);
+  fio___map_group_s r = {
+      (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8((char)tag))),
+      (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())),
+      (uint32_t)_mm_movemask_epi8(
+          _mm_cmpeq_epi8(v, _mm_set1_epi8((char)0xFF))),
+  };
+  return r;
+}
+
+#elif FIO___HAS_ARM_INTRIN && defined(__aarch64__)
+#define FIO___MAP_GROUP_SIZE 16
+/* packs a NEON comparison result (0xFF / 0x00 bytes) into a bitmap. */
+FIO_IFUNC uint32_t fio___map_group_neon2bitmap(uint8x16_t cmp) {
+  const uint8x16_t bits =
+      {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+  cmp = vandq_u8(cmp, bits);
+  return (uint32_t)vaddv_u8(vget_low_u8(cmp)) |
+         ((uint32_t)vaddv_u8(vget_high_u8(cmp)) << 8);
+}
+/* tests 16 imap bytes using NEON. */
+FIO_IFUNC fio___map_group_s fio___map_group(const uint8_t *imap, uint8_t tag) {
+  const uint8x16_t v = vld1q_u8(imap);
+  fio___map_group_s r = {
+      fio___map_group_neon2bitmap(vceqq_u8(v, vdupq_n_u8(tag))),
+      fio___map_group_neon2bitmap(vceqq_u8(v, vdupq_n_u8(0))),
+      fio___map_group_neon2bitmap(vceqq_u8(v, vdupq_n_u8(0xFF))),
+  };
+  return r;
+}
+
+#else
+#define FIO___MAP_GROUP_SIZE 16
+/* tests 16 imap bytes (SWAR). */
+FIO_IFUNC fio___map_group_s fio___map_group(const uint8_t *imap, uint8_t tag) {
+  return fio___map_group_swar(imap, tag);
+}
+#endif /* FIO___HAS_X86_INTRIN / FIO___HAS_ARM_INTRIN */
 #endif
 
 /** internal object data representation */
@@ -29106,7 +33518,7 @@ possible_attack:
   return r;
 }
 
-/* seek a node for larger collections, where 8 byte grouping is meaningless */
+/* seek a node for larger collections, testing groups of imap bytes at once */
 FIO_SFUNC fio___map_node_info_s FIO_NAME(FIO_MAP_NAME, __node_info_full)(
     FIO_NAME(FIO_MAP_NAME, s) * o,
     FIO_NAME(FIO_MAP_NAME, __o_node_s) * node) {
@@ -29117,80 +33529,18 @@ FIO_SFUNC fio___map_node_info_s FIO_NAME(FIO_MAP_NAME, __node_info_full)(
       (uint32_t)-1,
       (uint32_t)-1,
       (uint32_t)FIO_NAME(FIO_MAP_NAME, __byte_hash)(node->hash)};
-  const uint32_t mask = (FIO_MAP_CAPA(o->bits) - 1) & (~(uint32_t)7ULL);
+  const uint32_t mask = (FIO_MAP_CAPA(o->bits) - 1) &
+                        (~(uint32_t)(FIO___MAP_GROUP_SIZE - 1));
   const uint8_t *imap = FIO_NAME(FIO_MAP_NAME, __imap)(o);
   const size_t attempt_limit = o->bits + 7;
-  const uint64_t mbyte64 = ~(UINT64_C(0x0101010101010101) * (uint64_t)r.bhash);
   uint32_t guard = FIO_MAP_ATTACK_LIMIT;
   uint32_t pos = r.home = (node->hash & mask);
-  size_t attempt = 0;
-  for (; r.alt == (uint32_t)-1 && attempt < attempt_limit; ++attempt) {
-    uint64_t group = fio_buf2u64_le(imap + pos);
-    group ^= mbyte64;
-    group &= UINT64_C(0x7F7F7F7F7F7F7F7F);
-    group += UINT64_C(0x0101010101010101);
-    group &= UINT64_C(0x8080808080808080);
-    while (group) {
-      uint32_t offset = (uint32_t)fio_lsb_index_unsafe(group);
-      group ^= (uint64_t)1ULL << offset;
-      offset >>= 3;
-      offset += pos;
-      if (imap[offset] == r.bhash &&
-          FIO_NAME(FIO_MAP_NAME, __is_eq_hash)(o->map + offset, node->hash)) {
-        if (FIO_MAP_KEY_CMP(o->map[offset].key, node->key)) {
-          r.act = offset;
-          return r;
-        }
-        if (!--guard) {
-          r.act = offset;
-          goto possible_attack;
-        }
-      }
-    }
-    group = fio_buf2u64_le(imap + pos);
-    group &= UINT64_C(0x7F7F7F7F7F7F7F7F);
-    group += UINT64_C(0x0101010101010101);
-    group &= UINT64_C(0x8080808080808080);
-    while (group) {
-      uint32_t offset = (uint32_t)fio_lsb_index_unsafe(group);
-      group ^= (uint64_t)1ULL << offset;
-      offset >>= 3;
-      offset += pos;
-      if (imap[offset] == 255U) {
-        r.alt = offset;
-        break;
-      }
-    }
-    group = ~fio_buf2u64_le(imap + pos);
-    group &= UINT64_C(0x7F7F7F7F7F7F7F7F);
-    group += UINT64_C(0x0101010101010101);
-    group &= UINT64_C(0x8080808080808080);
-    while (group) {
-      uint32_t offset = (uint32_t)fio_lsb_index_unsafe(group);
-      group ^= (uint64_t)1ULL << offset;
-      offset >>= 3;
-      offset += pos;
-      if (!imap[offset]) {
-        r.alt = offset;
-        return r;
-      }
-    }
-    pos += (attempt + 2) << 3;
-    pos &= mask;
-  }
-  for (; attempt < attempt_limit; ++attempt) {
-    uint64_t group = fio_buf2u64_le(imap + pos);
-    group ^= mbyte64;
-    group &= UINT64_C(0x7F7F7F7F7F7F7F7F);
-    group += UINT64_C(0x0101010101010101);
-    group &= UINT64_C(0x8080808080808080);
-    while (group) {
-      uint32_t offset = (uint32_t)fio_lsb_index_unsafe(group);
-      group ^= (uint64_t)1ULL << offset;
-      offset >>= 3;
-      offset += pos;
-      if (imap[offset] == r.bhash &&
-          FIO_NAME(FIO_MAP_NAME, __is_eq_hash)(o->map + offset, node->hash)) {
+  for (size_t attempt = 0; attempt < attempt_limit; ++attempt) {
+    fio___map_group_s group = fio___map_group(imap + pos, (uint8_t)r.bhash);
+    while (group.match) {
+      uint32_t offset = pos + (uint32_t)fio_lsb_index_unsafe(group.match);
+      group.match &= group.match - 1;
+      if (FIO_NAME(FIO_MAP_NAME, __is_eq_hash)(o->map + offset, node->hash)) {
         if (FIO_MAP_KEY_CMP(o->map[offset].key, node->key)) {
           r.act = offset;
           return r;
@@ -29201,20 +33551,14 @@ FIO_SFUNC fio___map_node_info_s FIO_NAME(FIO_MAP_NAME, __node_info_full)(
         }
       }
     }
-    group = ~fio_buf2u64_le(imap + pos);
-    group &= UINT64_C(0x7F7F7F7F7F7F7F7F);
-    group += UINT64_C(0x0101010101010101);
-    group &= UINT64_C(0x8080808080808080);
-    while (group) {
-      uint32_t offset = (uint32_t)fio_lsb_index_unsafe(group);
-      group ^= (uint64_t)1ULL << offset;
-      offset >>= 3;
-      offset += pos;
-      if (!imap[offset]) {
-        return r;
-      }
+    if (r.alt == (uint32_t)-1 && group.deleted) /* reuse the first tombstone */
+      r.alt = pos + (uint32_t)fio_lsb_index_unsafe(group.deleted);
+    if (group.empty) { /* the key was never pushed past this group */
+      if (r.alt == (uint32_t)-1)
+        r.alt = pos + (uint32_t)fio_lsb_index_unsafe(group.empty);
+      return r;
     }
-    pos += (attempt + 2) << 3;
+    pos += (uint32_t)((attempt + 2) * FIO___MAP_GROUP_SIZE);
     pos &= mask;
   }
   if (r.alt == (uint32_t)-1)
@@ -29298,6 +33642,124 @@ FIO_IFUNC int FIO_NAME(FIO_MAP_NAME,
       __each_node)(src, FIO_NAME(FIO_MAP_NAME, __move2map_task), dest);
 }
 
+#if FIO_MAP_INCREMENTAL
+/* Moves an entry from the previous table to an (empty) slot in the map. */
+FIO_IFUNC void FIO_NAME(FIO_MAP_NAME,
+                        __rehash_move)(FIO_NAME(FIO_MAP_NAME, s) * o,
+                                       uint32_t from,
+                                       fio___map_node_info_s to) {
+  uint8_t *old_imap = (uint8_t *)(o->old.map + FIO_MAP_CAPA(o->old.bits));
+  FIO_NAME(FIO_MAP_NAME, __imap)(o)[to.alt] = (uint8_t)to.bhash;
+  o->map[to.alt] = o->old.map[from];
+  old_imap[from] = 255U; /* old probe sequences must continue past it */
+  if (!--o->old.count)
+    FIO_NAME(FIO_MAP_NAME, __old_free)(o, 0);
+}
+
+/* Migrates up to `slots` slots from the previous table. */
+FIO_SFUNC int FIO_NAME(FIO_MAP_NAME,
+                       __rehash_step)(FIO_NAME(FIO_MAP_NAME, s) * o,
+                                      size_t slots) {
+  const uint32_t capa = (uint32_t)FIO_MAP_CAPA(o->old.bits);
+  const uint8_t *old_imap = (uint8_t *)(o->old.map + capa);
+  for (; slots && o->old.pos < capa; --slots, ++o->old.pos) {
+    const uint32_t pos = o->old.pos;
+    if (!old_imap[pos] || old_imap[pos] == 255U)
+      continue;
+    FIO_NAME(FIO_MAP_NAME, __o_node_s)
+    node = {
+      .key = FIO_MAP_KEY_FROM_INTERNAL(o->old.map[pos].key),
+#if !FIO_MAP_RECALC_HASH
+      .hash = o->old.map[pos].hash,
+#endif
+    };
+    fio___map_node_info_s i = FIO_NAME(FIO_MAP_NAME, __node_info)(o, &node);
+    if (i.home == (uint32_t)-1)
+      return -1;
+    FIO_NAME(FIO_MAP_NAME, __rehash_move)(o, pos, i);
+    if (!o->old.map)
+      return 0;
+  }
+  if (o->old.pos == capa) /* all remaining slots are tombstones */
+    FIO_NAME(FIO_MAP_NAME, __old_free)(o, 0);
+  return 0;
+}
+
+FIO_SFUNC int FIO_NAME(FIO_MAP_NAME,
+                       __rehash_finish)(FIO_NAME(FIO_MAP_NAME, s) * o) {
+  if (!o->old.map ||
+      !FIO_NAME(FIO_MAP_NAME, __rehash_step)(o, FIO_MAP_CAPA(o->old.bits)))
+    return 0;
+  /* the map rejected an entry (collisions?), move both tables to a new map */
+  FIO_NAME(FIO_MAP_NAME, s) old = FIO_NAME(FIO_MAP_NAME, __old_view)(o);
+  FIO_NAME(FIO_MAP_NAME, s) cur = {0}, tmp;
+  cur.bits = o->bits;
+  cur.count = o->count - o->old.count;
+  cur.map = o->map;
+  for (uint32_t i = 1; i < 3; ++i) {
+    if (FIO_NAME(FIO_MAP_NAME, __allocate_map)(&tmp, o->bits + i))
+      break;
+    if (!FIO_NAME(FIO_MAP_NAME, __move2map)(&tmp, &cur) &&
+        !FIO_NAME(FIO_MAP_NAME, __move2map)(&tmp, &old)) {
+      FIO_NAME(FIO_MAP_NAME, __free_map)(&cur, 0);
+      FIO_NAME(FIO_MAP_NAME, __free_map)(&old, 0);
+      *o = tmp;
+      return 0;
+    }
+    FIO_NAME(FIO_MAP_NAME, __free_map)(&tmp, 0);
+  }
+  FIO_LOG_ERROR("couldn't complete map rehashing (capa: %zu)",
+                (size_t)FIO_MAP_CAPA(o->bits));
+  return -1;
+}
+
+/* Starts an incremental rehash, returns -1 if a (blocking) rehash is needed */
+FIO_IFUNC int FIO_NAME(FIO_MAP_NAME,
+                       __rehash_start)(FIO_NAME(FIO_MAP_NAME, s) * o) {
+  FIO_NAME(FIO_MAP_NAME, s) tmp;
+  if (o->bits < 9 || o->old.map)
+    return -1; /* small maps or still migrating */
+  /* rehash at the same size if tombstones filled the map */
+  if (FIO_NAME(FIO_MAP_NAME, __allocate_map)(
+          &tmp,
+          o->bits + (o->count >= (FIO_MAP_CAPA(o->bits) >> 1))))
+    return -1;
+  tmp.count = o->count;
+  tmp.old.bits = o->bits;
+  tmp.old.count = o->count;
+  tmp.old.map = o->map;
+  *o = tmp;
+  return 0;
+}
+#endif /* FIO_MAP_INCREMENTAL */
+
+/* Seeks a node in the map, migrating it if found in the previous table. */
+FIO_IFUNC fio___map_node_info_s
+FIO_NAME(FIO_MAP_NAME, __node_seek)(FIO_NAME(FIO_MAP_NAME, s) * o,
+                                    FIO_NAME(FIO_MAP_NAME, __o_node_s) * node) {
+#if FIO_MAP_INCREMENTAL
+  if (o->old.map &&
+      FIO_NAME(FIO_MAP_NAME, __rehash_step)(o, FIO_MAP_INCREMENTAL_SLOTS))
+    FIO_NAME(FIO_MAP_NAME, __rehash_finish)(o);
+  fio___map_node_info_s r = FIO_NAME(FIO_MAP_NAME, __node_info)(o, node);
+  if (r.act != (uint32_t)-1 || !o->old.map)
+    return r;
+  FIO_NAME(FIO_MAP_NAME, s) old = FIO_NAME(FIO_MAP_NAME, __old_view)(o);
+  fio___map_node_info_s i = FIO_NAME(FIO_MAP_NAME, __node_info)(&old, node);
+  if (i.act == (uint32_t)-1)
+    return r;
+  if (r.home == (uint32_t)-1) { /* no room in the map (unlikely) */
+    FIO_NAME(FIO_MAP_NAME, __rehash_finish)(o);
+    return FIO_NAME(FIO_MAP_NAME, __node_info)(o, node);
+  }
+  FIO_NAME(FIO_MAP_NAME, __rehash_move)(o, i.act, r);
+  r.act = r.alt;
+  return r;
+#else
+  return FIO_NAME(FIO_MAP_NAME, __node_info)(o, node);
+#endif
+}
+
 /* Inserts a node to the map. */
 FIO_IFUNC uint32_t FIO_NAME(FIO_MAP_NAME,
                             __node_insert)(FIO_NAME(FIO_MAP_NAME, s) * o,
@@ -29328,11 +33790,13 @@ FIO_IFUNC uint32_t FIO_NAME(FIO_MAP_NAME,
 #endif
   };
   fio___map_node_info_s info;
-  info = FIO_NAME(FIO_MAP_NAME, __node_info)(o, &node);
+  info = FIO_NAME(FIO_MAP_NAME, __node_seek)(o, &node);
   if (info.act != r)
     goto perform_overwrite;
   if (info.home == r)
     goto reallocate_map;
+  if (o->bits > 8 && o->count >= FIO_MAP_LOAD_LIMIT(FIO_MAP_CAPA(o->bits)))
+    goto reallocate_map; /* group probing: keep miss probe sequences short */
 
 insert:
   ++o->count;
@@ -29372,8 +33836,17 @@ perform_overwrite:
   return r;
 
 reallocate_map:
-  /* reallocate map */
-  for (int i = 1; i < 3; ++i) {
+#if FIO_MAP_INCREMENTAL
+  if (!FIO_NAME(FIO_MAP_NAME, __rehash_start)(o)) {
+    info = FIO_NAME(FIO_MAP_NAME, __node_info)(o, &node);
+    if (info.home != r)
+      goto insert;
+  }
+  if (FIO_NAME(FIO_MAP_NAME, __rehash_finish)(o))
+    goto no_memory;
+#endif
+  /* reallocate map (rehash at the same size if tombstones filled the map) */
+  for (int i = (o->count < (FIO_MAP_CAPA(o->bits) >> 1)) ? 0 : 1; i < 3; ++i) {
     if (FIO_NAME(FIO_MAP_NAME, __allocate_map)(&tmp, o->bits + i))
       goto no_memory;
     if (FIO_NAME(FIO_MAP_NAME, __move2map)(&tmp, o)) {
@@ -29429,7 +33902,7 @@ FIO_IFUNC uint32_t FIO_NAME(FIO_MAP_NAME,
   };
   if (!o->map)
     return r;
-  info = FIO_NAME(FIO_MAP_NAME, __node_info)(o, &node);
+  info = FIO_NAME(FIO_MAP_NAME, __node_seek)(o, &node);
   return (r = info.act);
 }
 
@@ -29446,6 +33919,12 @@ FIO_IFUNC void FIO_NAME(FIO_MAP_NAME,
   --o->count;
   uint8_t *imap = FIO_NAME(FIO_MAP_NAME, __imap)(o);
   imap[at] = 255U; /* mark as deleted */
+  /* group probing stops at groups with empty slots. Such a group was never
+   * full, so no probe sequence continues past it and no tombstone is needed */
+  if (o->bits > 8 &&
+      fio___map_group(imap + (at & ~(uint32_t)(FIO___MAP_GROUP_SIZE - 1)), 0)
+          .empty)
+    imap[at] = 0;
   if (old) {
 #ifdef FIO_MAP_VALUE
     FIO_MAP_KEY_DESTROY(o->map[at].key);
@@ -29490,7 +33969,7 @@ FIO_IFUNC uint32_t FIO_NAME(FIO_MAP_NAME,
       .hash = hash,
 #endif
   };
-  info = FIO_NAME(FIO_MAP_NAME, __node_info)(o, &node);
+  info = FIO_NAME(FIO_MAP_NAME, __node_seek)(o, &node);
   if (info.act == r)
     return r;
   r = 0;
@@ -29526,6 +34005,7 @@ SFUNC void FIO_NAME(FIO_MAP_NAME, destroy)(FIO_MAP_PTR map) {
 /** Reserves at minimum the capacity requested. */
 SFUNC void FIO_NAME(FIO_MAP_NAME, reserve)(FIO_MAP_PTR map, size_t capa) {
   FIO_PTR_TAG_VALID_OR_RETURN_VOID(map);
+  FIO_PTR_TAG_WRITABLE_OR_RETURN_VOID(map);
   FIO_NAME(FIO_MAP_NAME, s) *m = FIO_PTR_TAG_GET_UNTAGGED(FIO_MAP_T, map);
   if (capa <= FIO_MAP_CAPA(m->bits))
     return;
@@ -29561,6 +34041,7 @@ SFUNC int FIO_NAME(FIO_MAP_NAME, remove)(FIO_MAP_PTR map,
 #endif
 ) {
   FIO_PTR_TAG_VALID_OR_RETURN(map, -1);
+  FIO_PTR_TAG_WRITABLE_OR_RETURN(map, -1);
   FIO_NAME(FIO_MAP_NAME, s) *m = FIO_PTR_TAG_GET_UNTAGGED(FIO_MAP_T, map);
   if (!m->count)
     return -1;
@@ -29586,6 +34067,7 @@ FIO_SFUNC int FIO_NAME(FIO_MAP_NAME,
 SFUNC void FIO_NAME(FIO_MAP_NAME, evict)(FIO_MAP_PTR map,
                                          size_t number_of_elements) {
   FIO_PTR_TAG_VALID_OR_RETURN_VOID(map);
+  FIO_PTR_TAG_WRITABLE_OR_RETURN_VOID(map);
   if (!number_of_elements)
     return;
   FIO_NAME(FIO_MAP_NAME, s) *m = FIO_PTR_TAG_GET_UNTAGGED(FIO_MAP_T, map);
@@ -29601,6 +34083,7 @@ SFUNC void FIO_NAME(FIO_MAP_NAME, evict)(FIO_MAP_PTR map,
  */
 SFUNC void FIO_NAME(FIO_MAP_NAME, clear)(FIO_MAP_PTR map) {
   FIO_PTR_TAG_VALID_OR_RETURN_VOID(map);
+  FIO_PTR_TAG_WRITABLE_OR_RETURN_VOID(map);
   FIO_NAME(FIO_MAP_NAME, s) *m = FIO_PTR_TAG_GET_UNTAGGED(FIO_MAP_T, map);
   if (m->map)
     FIO_NAME(FIO_MAP_NAME, __destroy_map)(m, 1);
@@ -29609,6 +34092,7 @@ SFUNC void FIO_NAME(FIO_MAP_NAME, clear)(FIO_MAP_PTR map) {
 /** Attempts to minimize memory use. */
 SFUNC void FIO_NAME(FIO_MAP_NAME, compact)(FIO_MAP_PTR map) {
   FIO_PTR_TAG_VALID_OR_RETURN_VOID(map);
+  FIO_PTR_TAG_WRITABLE_OR_RETURN_VOID(map);
   FIO_NAME(FIO_MAP_NAME, s) *o = FIO_PTR_TAG_GET_UNTAGGED(FIO_MAP_T, map);
   if (!o->map || !o->count)
     return;
@@ -29649,25 +34133,34 @@ SFUNC FIO_NAME(FIO_MAP_NAME, node_s) *
                                     FIO_MAP_KEY key
 #endif
     ) {
+  FIO_NAME(FIO_MAP_NAME, s) * m;
+  uint32_t i;
   FIO_PTR_TAG_VALID_OR_RETURN(map, NULL);
-  FIO_NAME(FIO_MAP_NAME, s) *m = FIO_PTR_TAG_GET_UNTAGGED(FIO_MAP_T, map);
-  uint32_t i = FIO_NAME(FIO_MAP_NAME, __node_insert)(m,
+  FIO_PTR_TAG_WRITABLE_OR_GOTO(map, read_only);
+  m = FIO_PTR_TAG_GET_UNTAGGED(FIO_MAP_T, map);
+  i = FIO_NAME(FIO_MAP_NAME, __node_insert)(m,
 #ifndef FIO_MAP_HASH_FN
-                                                     hash,
+                                            hash,
 #endif
-                                                     key,
+                                            key,
 #ifdef FIO_MAP_VALUE
-                                                     val,
-                                                     old,
-                                                     overwrite
+                                            val,
+                                            old,
+                                            overwrite
 #else
-                                                     NULL,
-                                                     1
+                                            NULL,
+                                            1
 #endif
   );
   if (i == (uint32_t)-1)
     return NULL;
   return m->map + i;
+read_only:
+  FIO_MAP_KEY_DISCARD(key);
+#ifdef FIO_MAP_VALUE
+  FIO_MAP_VALUE_DISCARD(val);
+#endif
+  return NULL;
 }
 
 /**
@@ -29693,6 +34186,25 @@ SFUNC FIO_NAME(FIO_MAP_NAME, node_s) *
   return m->map + i;
 }
 
+#if defined(FIO_MAP_HASH_FN)
+/** Gets a value from the map using a pre-computed hash value. */
+SFUNC FIO_MAP_GET_T FIO_NAME(FIO_MAP_NAME, get_hashed)(FIO_MAP_PTR map,
+                                                       uint64_t hash,
+                                                       FIO_MAP_KEY key) {
+  FIO_MAP_GET_T r = (FIO_MAP_GET_T){0};
+  FIO_PTR_TAG_VALID_OR_RETURN(map, r);
+  FIO_NAME(FIO_MAP_NAME, s) *m = FIO_PTR_TAG_GET_UNTAGGED(FIO_MAP_T, map);
+  FIO_NAME(FIO_MAP_NAME, __o_node_s) node = {.hash = hash, .key = key};
+  fio___map_node_info_s info;
+  if (!m->map)
+    return r;
+  info = FIO_NAME(FIO_MAP_NAME, __node_seek)(m, &node);
+  if (info.act == (uint32_t)-1)
+    return r;
+  return FIO_NAME(FIO_MAP_NAME, node2val)(m->map + info.act);
+}
+#endif
+
 /* *****************************************************************************
 
 
@@ -29710,6 +34222,10 @@ SFUNC FIO_NAME(FIO_MAP_NAME, iterator_s)
   FIO_NAME(FIO_MAP_NAME, iterator_s) r = {0};
   FIO_PTR_TAG_VALID_OR_RETURN(map, r);
   FIO_NAME(FIO_MAP_NAME, s) *m = FIO_PTR_TAG_GET_UNTAGGED(FIO_MAP_T, map);
+#if FIO_MAP_INCREMENTAL
+  if (m->old.map) /* iteration is O(n) anyway, complete the migration */
+    FIO_NAME(FIO_MAP_NAME, __rehash_finish)(m);
+#endif
   uint8_t *imap = FIO_NAME(FIO_MAP_NAME, __imap)(m);
   if (!m->count)
     return r;
@@ -29797,6 +34313,10 @@ SFUNC FIO_NAME(FIO_MAP_NAME, iterator_s)
   FIO_NAME(FIO_MAP_NAME, iterator_s) r = {0};
   FIO_PTR_TAG_VALID_OR_RETURN(map, r);
   FIO_NAME(FIO_MAP_NAME, s) *m = FIO_PTR_TAG_GET_UNTAGGED(FIO_MAP_T, map);
+#if FIO_MAP_INCREMENTAL
+  if (m->old.map) /* iteration is O(n) anyway, complete the migration */
+    FIO_NAME(FIO_MAP_NAME, __rehash_finish)(m);
+#endif
 #if FIO_MAP_ORDERED
   uint32_t ipos;
 #else
@@ -30119,6 +34639,131 @@ FIO_SFUNC void FIO_NAME_TEST(stl, FIO_MAP_NAME)(void) {
     }
     FIO_NAME(FIO_MAP_NAME, destroy)(&map);
   }
+  { /* test group probing (SIMD / SWAR) against a byte by byte test */
+    uint8_t imap[32];
+    for (size_t round = 0; round < 1024; ++round) {
+      uint64_t rnd[4] = {fio_rand64(), fio_rand64(), fio_rand64(), 0};
+      rnd[3] = rnd[0] & rnd[1]; /* skew towards edge values */
+      for (size_t i = 0; i < 32; ++i) {
+        imap[i] = (uint8_t)(rnd[i >> 3] >> ((i & 7) << 3));
+        if ((rnd[3] >> i) & 1)
+          imap[i] = (rnd[2] >> i) & 1 ? 0 : 0xFF;
+      }
+      const uint8_t tag = (round & 1) ? imap[round & 31] : (uint8_t)round;
+      fio___map_group_s expect = {0}, swar;
+      for (size_t i = 0; i < FIO___MAP_GROUP_SIZE; ++i) {
+        expect.match |= (uint32_t)(imap[i] == tag) << i;
+        expect.empty |= (uint32_t)(!imap[i]) << i;
+        expect.deleted |= (uint32_t)(imap[i] == 0xFF) << i;
+      }
+      fio___map_group_s group = fio___map_group(imap, tag);
+      FIO_ASSERT(group.match == expect.match && group.empty == expect.empty &&
+                     group.deleted == expect.deleted,
+                 "map group probing error (tag %u)",
+                 (unsigned)tag);
+      swar = fio___map_group_swar(imap, tag);
+      FIO_ASSERT(swar.match == (expect.match & 0xFFFFU) &&
+                     swar.empty == (expect.empty & 0xFFFFU) &&
+                     swar.deleted == (expect.deleted & 0xFFFFU),
+                 "map group probing (SWAR) error (tag %u)",
+                 (unsigned)tag);
+    }
+  }
+  { /* test remove / insert churn (tombstone handling) */
+    FIO_NAME(FIO_MAP_NAME, s) map = FIO_MAP_INIT;
+    const size_t len = 4096;
+    for (size_t i = 1; i <= len; ++i)
+      FIO_NAME(FIO_MAP_NAME, set)
+    (&map, FIO___M_HASH(i) i FIO___M_VAL(i) FIO___M_OLD);
+    for (size_t i = 1; i <= (len << 3); ++i) {
+      FIO_NAME(FIO_MAP_NAME, remove)(&map, FIO___M_HASH(i) i, NULL);
+      FIO_NAME(FIO_MAP_NAME, set)
+      (&map, FIO___M_HASH(i + len) (i + len) FIO___M_VAL(i + len) FIO___M_OLD);
+      FIO_ASSERT(FIO_NAME(FIO_MAP_NAME, count)(&map) == len,
+                 "map count error after churn? %zu != %zu",
+                 (size_t)FIO_NAME(FIO_MAP_NAME, count)(&map),
+                 len);
+      FIO_ASSERT(!FIO_NAME(FIO_MAP_NAME, get_ptr)(&map, FIO___M_HASH(i) i),
+                 "removed key found after churn?");
+    }
+    for (size_t i = (len << 3) + 1; i <= (len << 3) + len; ++i)
+      FIO_ASSERT(FIO_NAME(FIO_MAP_NAME, get_ptr)(&map, FIO___M_HASH(i) i),
+                 "key missing after churn? %zu",
+                 i);
+    FIO_ASSERT(FIO_NAME(FIO_MAP_NAME, capa)(&map) <= (len << 2),
+               "map grew too much during churn? %zu",
+               (size_t)FIO_NAME(FIO_MAP_NAME, capa)(&map));
+    FIO_NAME(FIO_MAP_NAME, destroy)(&map);
+  }
+#if FIO_MAP_INCREMENTAL
+  { /* test incremental rehashing */
+    FIO_NAME(FIO_MAP_NAME, s) map = FIO_MAP_INIT;
+    size_t migrating = 0, len = 0;
+    for (size_t i = 1; i < test_len_limit; ++i) {
+      FIO_NAME(FIO_MAP_NAME, set)
+      (&map, FIO___M_HASH(i) i FIO___M_VAL(i) FIO___M_OLD);
+      if (!map.old.map)
+        continue;
+      ++migrating;
+      FIO_ASSERT(FIO_NAME(FIO_MAP_NAME, count)(&map) == i,
+                 "map count error while rehashing? %zu != %zu",
+                 (size_t)FIO_NAME(FIO_MAP_NAME, count)(&map),
+                 i);
+      FIO_ASSERT(map.old.count <= i, "map rehash count error?");
+      for (size_t j = (i >> 1) + 1; j < (i >> 1) + 4; ++j)
+        FIO_ASSERT(FIO_NAME(FIO_MAP_NAME, get_ptr)(&map, FIO___M_HASH(j) j),
+                   "map key missing while rehashing? %zu / %zu",
+                   j,
+                   i);
+      FIO_ASSERT(!FIO_NAME(FIO_MAP_NAME, get_ptr)(&map, FIO___M_HASH(0) 0),
+                 "missing key found while rehashing?");
+      if (!len && map.old.map && map.old.count > 64)
+        len = i; /* a good place to test iteration / removal */
+    }
+    FIO_ASSERT(migrating, "map never rehashed incrementally?");
+    for (size_t i = 1; i < test_len_limit; ++i) /* lookups migrate as well */
+      FIO_ASSERT(FIO_NAME(FIO_MAP_NAME, get_ptr)(&map, FIO___M_HASH(i) i),
+                 "map key missing after rehashing? %zu",
+                 i);
+    FIO_ASSERT(!map.old.map, "map rehashing never completed?");
+    FIO_NAME(FIO_MAP_NAME, destroy)(&map);
+    FIO_ASSERT(len, "rehashing test point missing?");
+    /* iteration and removal while rehashing */
+    for (size_t round = 0; round < 3; ++round) {
+      for (size_t i = 1; i <= len; ++i)
+        FIO_NAME(FIO_MAP_NAME, set)
+      (&map, FIO___M_HASH(i) i FIO___M_VAL(i) FIO___M_OLD);
+      FIO_ASSERT(map.old.map, "map should be rehashing (%zu)", len);
+      if (round == 0) {
+        size_t loop_test = 0;
+        FIO_MAP_EACH(FIO_MAP_NAME, &map, pos) {
+          FIO_ASSERT(pos.key && pos.key <= len, "iteration error");
+          ++loop_test;
+        }
+        FIO_ASSERT(loop_test == len,
+                   "iteration while rehashing missed items (%zu != %zu)",
+                   loop_test,
+                   len);
+        FIO_ASSERT(!map.old.map, "iteration should complete rehashing");
+      } else if (round == 1) {
+        for (size_t i = 1; i <= len; i += 2)
+          FIO_NAME(FIO_MAP_NAME, remove)(&map, FIO___M_HASH(i) i, NULL);
+        FIO_ASSERT(FIO_NAME(FIO_MAP_NAME, count)(&map) == (len >> 1),
+                   "removal while rehashing count error (%zu != %zu)",
+                   (size_t)FIO_NAME(FIO_MAP_NAME, count)(&map),
+                   (len >> 1));
+        for (size_t i = 1; i <= len; ++i) {
+          FIO_NAME(FIO_MAP_NAME, node_s) *ptr =
+              FIO_NAME(FIO_MAP_NAME, get_ptr)(&map, FIO___M_HASH(i) i);
+          FIO_ASSERT((!ptr) == (int)(i & 1),
+                     "removal while rehashing error (%zu)",
+                     i);
+        }
+      } /* round 2: destroy while rehashing */
+      FIO_NAME(FIO_MAP_NAME, destroy)(&map);
+    }
+  }
+#endif /* FIO_MAP_INCREMENTAL */
 }
 #undef FIO___M_HASH
 #undef FIO___M_VAL
@@ -30142,6 +34787,8 @@ Map Cleanup
 #undef FIO_MAP_CUCKOO_STEPS
 #undef FIO_MAP_GET_T
 #undef FIO_MAP_HASH_FN
+#undef FIO_MAP_INCREMENTAL
+#undef FIO_MAP_INCREMENTAL_SLOTS
 #undef FIO_MAP_IS_SPARSE
 #undef FIO_MAP_KEY
 #undef FIO_MAP_KEY_BSTR
@@ -30154,6 +34801,7 @@ Map Cleanup
 #undef FIO_MAP_KEY_INTERNAL
 #undef FIO_MAP_KEY_IS_GREATER_THAN
 #undef FIO_MAP_KEY_KSTR
+#undef FIO_MAP_LOAD_LIMIT
 #undef FIO_MAP_LRU
 #undef FIO_MAP_MINIMAL_BITS
 #undef FIO_MAP_NAME
@@ -32306,6 +36954,10 @@ Pointer Tagging Cleanup
 #undef FIO_PTR_TAG_VALID_OR_RETURN
 #undef FIO_PTR_TAG_VALID_OR_RETURN_VOID
 #undef FIO_PTR_TAG_VALID_OR_GOTO
+#undef FIO_PTR_TAG_VALIDATE_WRITE
+#undef FIO_PTR_TAG_WRITABLE_OR_RETURN
+#undef FIO_PTR_TAG_WRITABLE_OR_RETURN_VOID
+#undef FIO_PTR_TAG_WRITABLE_OR_GOTO
 #endif
 /* ************************************************************************* */
 #if !defined(FIO_INCLUDE_FILE) /* Dev test - ignore line */
@@ -32404,6 +37056,16 @@ Type Naming Macros for FIOBJ types. By default, results in:
 #ifndef FIOBJ_JSON_APPEND
 #define FIOBJ_JSON_APPEND 1
 #endif
+
+#ifndef FIOBJ_ARENA_BLOCK
+/**
+ * The minimal size of an arena's memory block (see `fiobj_json_parse_arena`).
+ *
+ * The first block is sized according to the JSON data, later blocks double
+ * the arena's capacity.
+ */
+#define FIOBJ_ARENA_BLOCK 4096
+#endif
 /* *****************************************************************************
 General Requirements / Macros
 ***************************************************************************** */
@@ -32418,6 +37080,61 @@ General Requirements / Macros
 #define FIOBJ_EXTERN_OBJ     static __attribute__((unused))
 #define FIOBJ_EXTERN_OBJ_IMP static __attribute__((unused))
 #endif
+/* *****************************************************************************
+FIOBJ Memory Routing (Arena Support)
+
+While an arena backed document is being built, the FIOBJ types allocate their
+memory from the arena. Otherwise, allocations are routed to the allocator that
+was selected before the FIOBJ types were defined.
+***************************************************************************** */
+
+/** An arena backed document's memory (internal). */
+typedef struct fiobj___arena_s fiobj___arena_s;
+
+/** The arena in which the current thread is building a document (if any). */
+static __thread fiobj___arena_s *fiobj___arena_current;
+
+/** Allocates (or reallocates) memory from an arena. */
+SFUNC void *fiobj___arena_realloc(fiobj___arena_s *a,
+                                  void *ptr,
+                                  size_t new_size,
+                                  size_t copy_len);
+
+FIO_IFUNC void *fiobj___mem_sys_realloc(void *ptr,
+                                        size_t old_size,
+                                        size_t new_size,
+                                        size_t copy_len) {
+  return FIO_MEM_REALLOC_(ptr, old_size, new_size, copy_len);
+  (void)old_size, (void)copy_len; /* if unused */
+}
+FIO_IFUNC void fiobj___mem_sys_free(void *ptr, size_t size) {
+  FIO_MEM_FREE_(ptr, size);
+  (void)size; /* if unused */
+}
+FIO_IFUNC void *fiobj___mem_realloc(void *ptr,
+                                    size_t old_size,
+                                    size_t new_size,
+                                    size_t copy_len) {
+  if (FIO_UNLIKELY(fiobj___arena_current != NULL))
+    return fiobj___arena_realloc(fiobj___arena_current,
+                                 ptr,
+                                 new_size,
+                                 copy_len);
+  return fiobj___mem_sys_realloc(ptr, old_size, new_size, copy_len);
+}
+/* the `size` argument is never evaluated by the types (it might be invalid) */
+FIO_IFUNC void fiobj___mem_free(void *ptr) {
+  if (FIO_UNLIKELY(fiobj___arena_current != NULL))
+    return; /* arena memory is released with the arena */
+  fiobj___mem_sys_free(ptr, 0);
+}
+
+#undef FIO_MEM_REALLOC_
+#undef FIO_MEM_FREE_
+#define FIO_MEM_REALLOC_(ptr, old_size, new_size, copy_len)                    \
+  fiobj___mem_realloc((ptr), (old_size), (new_size), (copy_len))
+#define FIO_MEM_FREE_(ptr, size) fiobj___mem_free((ptr))
+
 /* *****************************************************************************
 Debugging / Leak Detection
 ***************************************************************************** */
@@ -32502,6 +37219,13 @@ FIO_IFUNC FIOBJ fiobj_dup(FIOBJ o);
 /** Decreases an object's reference count or frees it. */
 FIO_IFUNC void fiobj_free(FIOBJ o);
 
+/**
+ * Returns 1 if the object belongs to an arena backed (read-only) document.
+ *
+ * See `fiobj_json_parse_arena`.
+ */
+FIO_IFUNC int FIO_NAME_BL(fiobj, arena)(FIOBJ o);
+
 /* *****************************************************************************
 FIOBJ Data / Info
 ***************************************************************************** */
@@ -32808,6 +37532,9 @@ FIO_IFUNC fio_str_info_s FIO_NAME2(FIO_NAME(fiobj, FIOBJ___NAME_STRING),
 FIOBJ Arrays
 ***************************************************************************** */
 
+/* arena backed containers are read-only once built (adopted by an arena) */
+#define FIOBJ___WRITABLE(o) (!FIO_NAME_BL(fiobj, arena)((o)))
+
 #define FIO_ARRAY_NAME           FIO_NAME(fiobj, FIOBJ___NAME_ARRAY)
 #define FIO_REF_NAME             FIO_NAME(fiobj, FIOBJ___NAME_ARRAY)
 #define FIO_REF_CONSTRUCTOR_ONLY 1
@@ -32836,6 +37563,8 @@ FIOBJ Arrays
 #define FIO_PTR_UNTAG(p)        FIOBJ_PTR_UNTAG(p)
 #define FIO_PTR_TAG_VALIDATE(p) (FIOBJ_TYPE_CLASS(p) == FIOBJ_T_ARRAY)
 #define FIO_PTR_TAG_TYPE        FIOBJ
+/* mutators skip arena backed arrays */
+#define FIO_PTR_TAG_VALIDATE_WRITE(p) FIOBJ___WRITABLE(p)
 #include FIO_INCLUDE_FILE
 
 /* *****************************************************************************
@@ -32873,6 +37602,8 @@ FIOBJ Hash Maps
 #define FIO_PTR_TAG_VALIDATE(p)   (FIOBJ_TYPE_CLASS(p) == FIOBJ_T_HASH)
 #define FIO_PTR_TAG_TYPE          FIOBJ
 /* TODO! auto-hash object value */
+/* mutators skip arena backed hash maps */
+#define FIO_PTR_TAG_VALIDATE_WRITE(p) FIOBJ___WRITABLE(p)
 #include FIO_INCLUDE_FILE
 /**
  * Sets a value in a hash map, allocating the key String and automatically
@@ -32911,6 +37642,23 @@ FIOBJ JSON support
  */
 FIO_IFUNC FIOBJ FIO_NAME2(fiobj, json)(FIOBJ dest, FIOBJ o, uint8_t beautify);
 
+/**
+ * Returns the buffer length required for writing the JSON representation of
+ * the object using `fiobj_json_write` (including the NUL terminator).
+ *
+ * The length is exact, except for floating point numbers, for which the longest
+ * possible representation is assumed.
+ */
+SFUNC size_t fiobj_json_capa(FIOBJ o, uint8_t beautify);
+
+/**
+ * Writes the JSON representation of the object to `dest`, which must have room
+ * for (at least) `fiobj_json_capa(o, beautify)` bytes.
+ *
+ * Returns the number of bytes written (excluding the NUL terminator).
+ */
+SFUNC size_t fiobj_json_write(char *dest, FIOBJ o, uint8_t beautify);
+
 /**
  * Updates a Hash using JSON data.
  *
@@ -32946,6 +37694,31 @@ SFUNC FIOBJ fiobj_json_parse(fio_str_info_s str, size_t *consumed);
 #define fiobj_json_parse2(data_, len_, consumed)                               \
   fiobj_json_parse(FIO_STR_INFO2(data_, len_), consumed)
 
+/**
+ * Parses JSON data (same as `fiobj_json_parse`) into an arena backed document.
+ *
+ * All the document's objects (including Hash Map storage and String data) are
+ * carved from a single growable memory arena owned by the returned root
+ * object. Freeing the root releases the whole arena in a single operation,
+ * instead of walking and freeing every object.
+ *
+ * The document is read-only (Strings are frozen) and must be freed using
+ * `fiobj_free`. Calling `fiobj_free` on a nested object does nothing (its
+ * memory is released with the root).
+ *
+ * `fiobj_dup` increases the root's reference count. For nested objects,
+ * `fiobj_dup` returns a (deep) heap allocated copy that outlives the document
+ * and may be mutated - make sure to use the returned object.
+ *
+ * If the JSON data contains only a primitive (`true`, `null`, a small number,
+ * etc'), no arena is used.
+ */
+SFUNC FIOBJ fiobj_json_parse_arena(fio_str_info_s str, size_t *consumed);
+
+/** Helper macro, calls `fiobj_json_parse_arena` with string information */
+#define fiobj_json_parse_arena2(data_, len_, consumed)                         \
+  fiobj_json_parse_arena(FIO_STR_INFO2(data_, len_), consumed)
+
 /**
  * Uses JavaScript style notation to find data in an object structure.
  *
@@ -32970,6 +37743,74 @@ SFUNC FIOBJ fiobj_json_find(FIOBJ object, fio_str_info_s notation);
 #define fiobj_json_find2(object, str, length)                                  \
   fiobj_json_find(object, FIO_STR_INFO2(str, length))
 
+/** A compiled set of JSON paths (see `fiobj_json_path_new`). */
+typedef struct fiobj_json_path_s fiobj_json_path_s;
+
+/**
+ * Compiles `count` JavaScript style notations (see `fiobj_json_find`) into a
+ * reusable path set, with pre-hashed keys and parsed Array indexes.
+ *
+ * Paths that share a prefix (i.e., "user.name" and "user.id") share the
+ * lookups for that prefix.
+ *
+ * Notations are split at every `.` and `[`, so keys containing these
+ * characters can't be addressed using a compiled path.
+ *
+ * The path set is immutable and may be used concurrently by multiple threads.
+ *
+ * Returns NULL on error (i.e., a malformed notation).
+ */
+SFUNC fiobj_json_path_s *fiobj_json_path_new(const fio_str_info_s *notations,
+                                             size_t count);
+
+/** Helper function, compiles a single notation (see `fiobj_json_path_new`). */
+FIO_IFUNC fiobj_json_path_s *fiobj_json_path_new2(const char *notation,
+                                                  size_t len);
+
+/** Frees a compiled path set. */
+SFUNC void fiobj_json_path_free(fiobj_json_path_s *path);
+
+/** Returns the number of paths in the path set. */
+SFUNC size_t fiobj_json_path_count(fiobj_json_path_s *path);
+
+/**
+ * Finds the data addressed by the first path in the path set (same as
+ * `fiobj_json_find`).
+ *
+ * Returns a temporary reference to the object or FIOBJ_INVALID on an error.
+ */
+SFUNC FIOBJ fiobj_json_path_find(FIOBJ object, fiobj_json_path_s *path);
+
+/**
+ * Finds the data addressed by all the paths in the path set, using a single
+ * traversal of the object structure.
+ *
+ * `results` must have room for `fiobj_json_path_count(path)` objects. Each
+ * result is a temporary reference, or FIOBJ_INVALID if the data is missing.
+ *
+ * Returns the number of paths found.
+ */
+SFUNC size_t fiobj_json_path_find_all(FIOBJ object,
+                                      fiobj_json_path_s *path,
+                                      FIOBJ *results);
+
+/**
+ * Parses JSON data, building only the objects addressed by the path set
+ * (parts of the document that aren't addressed are validated and skipped).
+ *
+ * `results` must have room for `fiobj_json_path_count(path)` objects. Each
+ * result is a new reference that must be freed using `fiobj_free`, or
+ * FIOBJ_INVALID if the data is missing.
+ *
+ * If `consumed` is not NULL, it will contain the number of bytes consumed.
+ *
+ * Returns the number of paths found. On error, no results are returned.
+ */
+SFUNC size_t fiobj_json_path_parse(fiobj_json_path_s *path,
+                                   fio_str_info_s json,
+                                   FIOBJ *results,
+                                   size_t *consumed);
+
 /* *****************************************************************************
 FIOBJ Mustache support
 ***************************************************************************** */
@@ -32992,6 +37833,26 @@ FIO_IFUNC FIOBJ fiobj_mustache_build(fio_mustache_s *m, FIOBJ ctx);
  */
 FIO_IFUNC FIOBJ fiobj_mustache_build2(fio_mustache_s *m, FIOBJ dest, FIOBJ ctx);
 
+/**
+ * Pre-computes the FIOBJ Hash value of every variable name in the template,
+ * so `fiobj_mustache_build` (and `build2` / `build_iov`) never re-hash names.
+ *
+ * The template should be bound (once) before it is shared with other threads.
+ * Bound templates must be built in the same translation unit (otherwise names
+ * are hashed as if the template wasn't bound).
+ */
+FIO_IFUNC void fiobj_mustache_bind(fio_mustache_s *m);
+
+/**
+ * Builds a Mustache template using a FIOBJ context (usually a Hash), as a list
+ * of buffers (see `fio_mustache_build_iov`).
+ *
+ * Returns the number of buffers in `dest`.
+ */
+FIO_IFUNC size_t fiobj_mustache_build_iov(fio_mustache_s *m,
+                                          fio_mustache_iov_s *dest,
+                                          FIOBJ ctx);
+
 /* *****************************************************************************
 
 
@@ -33040,28 +37901,66 @@ FIO_IFUNC size_t fiobj_type(FIOBJ o) {
 FIOBJ Memory Management
 ***************************************************************************** */
 
-/** Increases an object's reference count (or copies) and returns it. */
-FIO_IFUNC FIOBJ fiobj_dup(FIOBJ o) {
+/* arena backed objects have these bits set in their reference counter */
+#define FIOBJ___ARENA_NODE ((size_t)1 << ((sizeof(size_t) << 3) - 1))
+#define FIOBJ___ARENA_ROOT ((size_t)1 << ((sizeof(size_t) << 3) - 2))
+/* nested nodes count from here, so `dup` / `free` never flip the bits above */
+#define FIOBJ___ARENA_BIAS ((size_t)1 << ((sizeof(size_t) << 3) - 3))
+
+/** Internal: returns the object wrapper's reference counter (or NULL). */
+FIO_IFUNC volatile size_t *fiobj___ref(FIOBJ o) {
+  if (!FIOBJ_PTR_UNTAG(o))
+    return NULL;
   switch (FIOBJ_TYPE_CLASS(o)) {
-  case FIOBJ_T_PRIMITIVE: /* fall through */
-  case FIOBJ_T_NUMBER:    /* fall through */
-  case FIOBJ_T_FLOAT: /* fall through */ return o;
-  case FIOBJ_T_STRING: /* fall through */
-    FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), dup)(o);
-    break;
-  case FIOBJ_T_ARRAY: /* fall through */
-    FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), dup)(o);
-    break;
-  case FIOBJ_T_HASH: /* fall through */
-    FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), dup)(o);
-    break;
-  case FIOBJ_T_OTHER: /* fall through */ fiobj_object_dup(o);
+  case FIOBJ_T_STRING:
+    return &(((FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), _wrapper_s) *)
+                  FIOBJ_PTR_UNTAG(o)) -
+             1)
+                ->ref;
+  case FIOBJ_T_ARRAY:
+    return &(((FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), _wrapper_s) *)
+                  FIOBJ_PTR_UNTAG(o)) -
+             1)
+                ->ref;
+  case FIOBJ_T_HASH:
+    return &(((FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), _wrapper_s) *)
+                  FIOBJ_PTR_UNTAG(o)) -
+             1)
+                ->ref;
+  case FIOBJ_T_OTHER:
+    return &(((FIO_NAME(fiobj_object, _wrapper_s) *)FIOBJ_PTR_UNTAG(o)) - 1)
+                ->ref;
+  default: return NULL;
   }
+}
+
+/** Internal: `fiobj_dup` for arena backed objects (`ref` was incremented). */
+SFUNC FIOBJ fiobj___arena_dup(FIOBJ o, size_t ref);
+/** Internal: `fiobj_free` for arena backed objects (`ref` was decremented). */
+SFUNC void fiobj___arena_free(FIOBJ o, size_t ref);
+
+/** Returns 1 if the object belongs to an arena backed (read-only) document. */
+FIO_IFUNC int FIO_NAME_BL(fiobj, arena)(FIOBJ o) {
+  volatile size_t *ref = fiobj___ref(o);
+  return ref && (ref[0] & FIOBJ___ARENA_NODE);
+}
+
+/** Increases an object's reference count (or copies) and returns it. */
+FIO_IFUNC FIOBJ fiobj_dup(FIOBJ o) {
+  volatile size_t *ref = fiobj___ref(o);
+  size_t r;
+  if (!ref)
+    return o;
+  r = fio_atomic_add_fetch(ref, 1);
+  if (FIO_UNLIKELY(r & FIOBJ___ARENA_NODE))
+    return fiobj___arena_dup(o, r);
   return o;
 }
 
-/** Decreases an object's reference count or frees it. */
-FIO_IFUNC void fiobj_free(FIOBJ o) {
+/* Internal: destroys an object once the last reference was released. */
+FIO_SFUNC void fiobj___free_task(FIOBJ o, volatile size_t *ref) {
+  /* the type's `free` releases the (restored) last reference and destroys */
+  ref[0] = 1;
   switch (FIOBJ_TYPE_CLASS(o)) {
   case FIOBJ_T_PRIMITIVE: /* fall through */
   case FIOBJ_T_NUMBER:    /* fall through */
@@ -33079,6 +37978,19 @@ FIO_IFUNC void fiobj_free(FIOBJ o) {
   }
 }
 
+/** Decreases an object's reference count or frees it. */
+FIO_IFUNC void fiobj_free(FIOBJ o) {
+  volatile size_t *ref = fiobj___ref(o);
+  size_t r;
+  if (!ref)
+    return;
+  r = fio_atomic_sub_fetch(ref, 1);
+  if (!r)
+    fiobj___free_task(o, ref);
+  else if (FIO_UNLIKELY(r & FIOBJ___ARENA_NODE))
+    fiobj___arena_free(o, r);
+}
+
 /* *****************************************************************************
 FIOBJ Data / Info
 ***************************************************************************** */
@@ -33094,7 +38006,8 @@ FIO_IFUNC unsigned char FIO_NAME_BL(fiobj, eq)(FIOBJ a, FIOBJ b) {
     return 1;
   if (FIOBJ_TYPE_CLASS(a) != FIOBJ_TYPE_CLASS(b))
     return 0;
-  switch (FIOBJ_TYPE_CLASS(a)) {
+  /* containers pass the lookup value (often a constant) as `b` */
+  switch (FIOBJ_TYPE_CLASS(b)) {
   case FIOBJ_T_PRIMITIVE:
   case FIOBJ_T_NUMBER: /* fall through */
   case FIOBJ_T_FLOAT: /* fall through */ return a == b;
@@ -33303,6 +38216,13 @@ FIOBJ Floats
 #define FIO_PTR_TAG_TYPE        FIOBJ
 #include FIO_INCLUDE_FILE
 
+/* the FIOBJ types are defined, restore the original allocator routing */
+#undef FIO_MEM_REALLOC_
+#undef FIO_MEM_FREE_
+#define FIO_MEM_REALLOC_(ptr, old_size, new_size, copy_len)                    \
+  fiobj___mem_sys_realloc((ptr), (old_size), (new_size), (copy_len))
+#define FIO_MEM_FREE_(ptr, size) fiobj___mem_sys_free((ptr), 0)
+
 /** Creates a new Float object. */
 FIO_IFUNC FIOBJ FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_FLOAT), new)(double i) {
   FIOBJ ui;
@@ -33532,15 +38452,8 @@ FIO_IFUNC void FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), update)(FIOBJ dest,
 FIOBJ JSON support (inline functions)
 ***************************************************************************** */
 
-typedef struct {
-  FIOBJ json;
-  size_t level;
-  uint8_t beautify;
-} fiobj___json_format_internal__s;
-
-/* internal helper function for recursive JSON formatting. */
-SFUNC void fiobj___json_format_internal__(fiobj___json_format_internal__s *,
-                                          FIOBJ);
+/* internal helper function, appends the JSON for `o` to the `dest` String. */
+SFUNC void fiobj___json_format(FIOBJ dest, FIOBJ o, uint8_t beautify);
 
 /** Helper function, calls `fiobj_hash_update_json` with string information */
 FIO_IFUNC size_t FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH),
@@ -33556,12 +38469,16 @@ FIO_IFUNC size_t FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH),
  * the existing string.
  */
 FIO_IFUNC FIOBJ FIO_NAME2(fiobj, json)(FIOBJ dest, FIOBJ o, uint8_t beautify) {
-  fiobj___json_format_internal__s args =
-      (fiobj___json_format_internal__s){.json = dest, .beautify = beautify};
   if (FIOBJ_TYPE_CLASS(dest) != FIOBJ_T_STRING)
-    args.json = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), new)();
-  fiobj___json_format_internal__(&args, o);
-  return args.json;
+    dest = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), new)();
+  fiobj___json_format(dest, o, beautify);
+  return dest;
+}
+/** Helper function, compiles a single notation (see `fiobj_json_path_new`). */
+FIO_IFUNC fiobj_json_path_s *fiobj_json_path_new2(const char *notation,
+                                                  size_t len) {
+  fio_str_info_s n = FIO_STR_INFO2((char *)notation, len);
+  return fiobj_json_path_new(&n, 1);
 }
 
 #undef FIO___RECURSIVE_INCLUDE /* from now on, type helpers are internal */
@@ -33577,6 +38494,12 @@ FIO_SFUNC void *fiobj___mustache_write_text_escaped(void *udata,
                                                     fio_buf_info_s raw);
 /* callback should return a new context pointer with the value of `name`. */
 FIO_SFUNC void *fiobj___mustache_get_var(void *ctx, fio_buf_info_s name);
+/* computes the hash of a variable name (used for pre-hashing names). */
+FIO_SFUNC uint64_t fiobj___mustache_var_hash(fio_buf_info_s name);
+/* same as `get_var`, with a pre-computed hash value. */
+FIO_SFUNC void *fiobj___mustache_get_var_hashed(void *ctx,
+                                                fio_buf_info_s name,
+                                                uint64_t hash);
 /* if context is an Array, should return its length. */
 FIO_SFUNC size_t fiobj___mustache_array_length(void *ctx);
 /* if context is an Array, should return a context pointer @ index. */
@@ -33602,6 +38525,8 @@ FIO_IFUNC FIOBJ fiobj_mustache_build(fio_mustache_s *m, FIOBJ ctx) {
       .get_var_index = fiobj___mustache_get_var_index,
       .var2str = fiobj___mustache_var2str,
       .var_is_truthful = fiobj___mustache_var_is_truthful,
+      .var_hash = fiobj___mustache_var_hash,
+      .get_var_hashed = fiobj___mustache_get_var_hashed,
       .ctx = ctx,
       .udata = NULL);
 }
@@ -33626,11 +38551,35 @@ FIO_IFUNC FIOBJ fiobj_mustache_build2(fio_mustache_s *m,
       .get_var_index = fiobj___mustache_get_var_index,
       .var2str = fiobj___mustache_var2str,
       .var_is_truthful = fiobj___mustache_var_is_truthful,
+      .var_hash = fiobj___mustache_var_hash,
+      .get_var_hashed = fiobj___mustache_get_var_hashed,
       .ctx = ctx,
       .udata = dest);
   return dest;
 }
 
+/** Pre-computes the FIOBJ Hash value of every variable name in the template. */
+FIO_IFUNC void fiobj_mustache_bind(fio_mustache_s *m) {
+  fio_mustache_bind(m, fiobj___mustache_var_hash);
+}
+
+/** Builds a Mustache template using a FIOBJ context, as a list of buffers. */
+FIO_IFUNC size_t fiobj_mustache_build_iov(fio_mustache_s *m,
+                                          fio_mustache_iov_s *dest,
+                                          FIOBJ ctx) {
+  return fio_mustache_build_iov(
+      m,
+      dest,
+      .get_var = fiobj___mustache_get_var,
+      .array_length = fiobj___mustache_array_length,
+      .get_var_index = fiobj___mustache_get_var_index,
+      .var2str = fiobj___mustache_var2str,
+      .var_is_truthful = fiobj___mustache_var_is_truthful,
+      .var_hash = fiobj___mustache_var_hash,
+      .get_var_hashed = fiobj___mustache_get_var_hashed,
+      .ctx = ctx);
+}
+
 /* callback should write `txt` to output and return updated `udata.` */
 FIO_SFUNC void *fiobj___mustache_write_text(void *udata, fio_buf_info_s txt) {
   FIOBJ d = (FIOBJ)udata;
@@ -33656,6 +38605,23 @@ FIO_SFUNC void *fiobj___mustache_get_var(void *ctx, fio_buf_info_s name) {
     return NULL;
   return fiobj_hash_get2((FIOBJ)ctx, name.buf, name.len);
 }
+/* computes the hash of a variable name (used for pre-hashing names). */
+FIO_SFUNC uint64_t fiobj___mustache_var_hash(fio_buf_info_s name) {
+  FIOBJ_STR_TEMP_VAR_STATIC(tmp, name.buf, name.len);
+  return FIO_NAME2(fiobj, hash)(tmp);
+}
+/* same as `get_var`, with a pre-computed hash value. */
+FIO_SFUNC void *fiobj___mustache_get_var_hashed(void *ctx,
+                                                fio_buf_info_s name,
+                                                uint64_t hash) {
+  if (!ctx)
+    return NULL;
+  if (!FIOBJ_TYPE_IS((FIOBJ)ctx, FIOBJ_T_HASH))
+    return NULL;
+  FIOBJ_STR_TEMP_VAR_STATIC(tmp, name.buf, name.len);
+  return FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH),
+                  get_hashed)((FIOBJ)ctx, hash, tmp);
+}
 /* if context is an Array, should return its length. */
 FIO_SFUNC size_t fiobj___mustache_array_length(void *ctx) {
   if (!FIOBJ_TYPE_IS((FIOBJ)ctx, FIOBJ_T_ARRAY))
@@ -34007,154 +38973,554 @@ FIOBJ_EXTERN_OBJ_IMP const FIOBJ_class_vtable_s FIOBJ___FLOAT_CLASS_VTBL = {
 };
 
 /* *****************************************************************************
-FIOBJ JSON support - output
+FIOBJ Arena Documents
 ***************************************************************************** */
 
-FIO_IFUNC void fiobj___json_format_internal_beauty_pad(FIOBJ json,
-                                                       size_t level) {
-  size_t pos = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), len)(json);
-  fio_str_info_s tmp = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING),
-                                resize)(json, (level << 1) + pos + 2);
-  tmp.buf[pos++] = '\r';
-  tmp.buf[pos++] = '\n';
-  for (size_t i = 0; i < level; ++i) {
-    tmp.buf[pos++] = ' ';
-    tmp.buf[pos++] = ' ';
+/* a memory block added to an arena once the first block is full */
+typedef struct fiobj___arena_block_s {
+  struct fiobj___arena_block_s *next;
+  size_t size;
+} fiobj___arena_block_s;
+
+/* the arena lives at the head of its first memory block */
+struct fiobj___arena_s {
+  /** additional memory blocks */
+  fiobj___arena_block_s *blocks;
+  /** the next available byte in the current block */
+  char *pos;
+  /** the end of the current block */
+  char *end;
+  /** the last allocation (may grow in place) */
+  char *last;
+  /** the size of the first memory block */
+  size_t size;
+  /** the total size of all memory blocks */
+  size_t total;
+};
+
+#define FIOBJ___ARENA_ALIGN(len) (((len) + 15) & (~(size_t)15))
+/* the root object is the first allocation, placed right after the arena */
+#define FIOBJ___ARENA_HEAD  FIOBJ___ARENA_ALIGN(sizeof(fiobj___arena_s))
+#define FIOBJ___ARENA_BLOCK FIOBJ___ARENA_ALIGN(sizeof(fiobj___arena_block_s))
+
+FIO_LEAK_COUNTER_DEF(fiobj___arena)
+
+/* creates an arena, sizing the first block for `hint` bytes of JSON */
+FIO_SFUNC fiobj___arena_s *fiobj___arena_new(size_t hint) {
+  size_t size = FIOBJ___ARENA_HEAD + FIOBJ_ARENA_BLOCK + (hint << 2);
+  fiobj___arena_s *a =
+      (fiobj___arena_s *)fiobj___mem_sys_realloc(NULL, 0, size, 0);
+  if (!a)
+    return a;
+  FIO_LEAK_COUNTER_ON_ALLOC(fiobj___arena);
+  FIOBJ_MARK_MEMORY_ALLOC();
+  *a = (fiobj___arena_s){
+      .pos = (char *)a + FIOBJ___ARENA_HEAD,
+      .end = (char *)a + size,
+      .size = size,
+      .total = size,
+  };
+  return a;
+}
+
+/* releases all of the arena's memory */
+FIO_SFUNC void fiobj___arena_release(fiobj___arena_s *a) {
+  fiobj___arena_block_s *b = a->blocks;
+  while (b) {
+    fiobj___arena_block_s *tmp = b;
+    b = b->next;
+    fiobj___mem_sys_free(tmp, tmp->size);
   }
+  FIOBJ_MARK_MEMORY_FREE();
+  FIO_LEAK_COUNTER_ON_FREE(fiobj___arena);
+  fiobj___mem_sys_free(a, a->size);
 }
 
-SFUNC void fiobj___json_format_internal__(fiobj___json_format_internal__s *args,
-                                          FIOBJ o) {
-  switch (FIOBJ_TYPE(o)) {
-  case FIOBJ_T_TRUE:
-    FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)
-    (args->json, "true", 4);
+/* returns true if `ptr` points to memory owned by the arena */
+FIO_SFUNC int fiobj___arena_owns(fiobj___arena_s *a, void *ptr) {
+  if ((char *)ptr > (char *)a && (char *)ptr < (char *)a + a->size)
+    return 1;
+  for (fiobj___arena_block_s *b = a->blocks; b; b = b->next)
+    if ((char *)ptr > (char *)b && (char *)ptr < (char *)b + b->size)
+      return 1;
+  return 0;
+}
+
+/** Allocates (or reallocates) memory from an arena. */
+SFUNC void *fiobj___arena_realloc(fiobj___arena_s *a,
+                                  void *ptr,
+                                  size_t new_size,
+                                  size_t copy_len) {
+  char *r;
+  new_size = FIOBJ___ARENA_ALIGN(new_size);
+  FIO_ASSERT_DEBUG(!ptr || fiobj___arena_owns(a, ptr),
+                   "FIOBJ arena reallocating foreign memory");
+  if (ptr && (char *)ptr == a->last) { /* grow (never shrink) in place */
+    if (new_size <= (size_t)(a->pos - a->last))
+      return ptr;
+    if (new_size <= (size_t)(a->end - a->last)) {
+      a->pos = a->last + new_size;
+      return ptr;
+    }
+  }
+  if (new_size > (size_t)(a->end - a->pos)) { /* add a block */
+    size_t size = a->total;
+    if (size < FIOBJ___ARENA_BLOCK + new_size)
+      size = FIOBJ___ARENA_BLOCK + new_size;
+    fiobj___arena_block_s *b =
+        (fiobj___arena_block_s *)fiobj___mem_sys_realloc(NULL, 0, size, 0);
+    if (!b)
+      return NULL;
+    *b = (fiobj___arena_block_s){.next = a->blocks, .size = size};
+    a->blocks = b;
+    a->total += size;
+    a->pos = (char *)b + FIOBJ___ARENA_BLOCK;
+    a->end = (char *)b + size;
+  }
+  r = a->pos;
+  a->pos += new_size;
+  a->last = r;
+  if (ptr && copy_len)
+    FIO_MEMCPY(r, ptr, copy_len);
+  return (void *)r;
+}
+
+/* marks an object built in the arena, settling its leak counters */
+FIO_SFUNC void fiobj___arena_adopt_task(FIOBJ o, volatile size_t *ref) {
+  ref[0] = FIOBJ___ARENA_NODE | FIOBJ___ARENA_BIAS;
+  /* arena objects are never freed on their own, so count them as freed */
+  FIOBJ_MARK_MEMORY_FREE();
+  switch (FIOBJ_TYPE_CLASS(o)) {
+  case FIOBJ_T_STRING:
+    if (FIO_NAME_BL(FIO_NAME(fiobj, FIOBJ___NAME_STRING), allocated)(o))
+      FIO_LEAK_COUNTER_ON_FREE(
+          FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), destroy));
+    FIO_LEAK_COUNTER_ON_FREE(FIO_NAME(fiobj, FIOBJ___NAME_STRING));
+    FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), freeze)(o);
     return;
-  case FIOBJ_T_FALSE:
-    FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)
-    (args->json, "false", 5);
+  case FIOBJ_T_ARRAY:
+    if (!FIO_NAME_BL(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), embedded)(o) &&
+        FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), capa)(o))
+      FIO_LEAK_COUNTER_ON_FREE(
+          FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), destroy));
+    FIO_LEAK_COUNTER_ON_FREE(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY));
     return;
-  case FIOBJ_T_NULL:
-    FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)
-    (args->json, "null", 4);
+  case FIOBJ_T_HASH:
+    if (FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), capa)(o))
+      FIO_LEAK_COUNTER_ON_FREE(
+          FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), destroy));
+    FIO_LEAK_COUNTER_ON_FREE(FIO_NAME(fiobj, FIOBJ___NAME_HASH));
     return;
-  case FIOBJ_T_NUMBER:
-    FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write_i)
-    (args->json, FIO_NAME2(FIO_NAME(fiobj, FIOBJ___NAME_NUMBER), i)(o));
+  default: /* only big numbers and floats are built by the JSON parser */
+    if ((*fiobj_object_metadata(o)) == &FIOBJ___FLOAT_CLASS_VTBL)
+      FIO_LEAK_COUNTER_ON_FREE(fiobj___bigfloat);
+    else
+      FIO_LEAK_COUNTER_ON_FREE(fiobj___bignum);
     return;
-  case FIOBJ_T_FLOAT: {
-    char tmp_buf[256];
-    size_t len = fio_ftoa(tmp_buf,
-                          FIO_NAME2(FIO_NAME(fiobj, FIOBJ___NAME_FLOAT), f)(o),
-                          10);
-    FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)
-    (args->json, tmp_buf, len);
+  }
+}
+
+/* marks an object as part of the arena (once) */
+FIO_IFUNC void fiobj___arena_adopt(FIOBJ o) {
+  volatile size_t *ref = fiobj___ref(o);
+  if (ref && !(ref[0] & FIOBJ___ARENA_NODE))
+    fiobj___arena_adopt_task(o, ref);
+}
+
+/* returns a heap allocated (deep) copy of an arena backed object */
+FIO_SFUNC FIOBJ fiobj___arena_escape(FIOBJ o) {
+  FIOBJ r;
+  if (!FIO_NAME_BL(fiobj, arena)(o))
+    return fiobj_dup(o);
+  switch (FIOBJ_TYPE_CLASS(o)) {
+  case FIOBJ_T_STRING: {
+    fio_str_info_s s = FIO_NAME2(FIO_NAME(fiobj, FIOBJ___NAME_STRING), cstr)(o);
+    return FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), new_cstr)(s.buf,
+                                                                   s.len);
+  }
+  case FIOBJ_T_ARRAY: {
+    FIOBJ *a = FIO_NAME2(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), ptr)(o);
+    uint32_t count = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), count)(o);
+    r = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), new)();
+    FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), reserve)(r, count);
+    for (uint32_t i = 0; i < count; ++i)
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), push)
+    (r, fiobj___arena_escape(a[i]));
+    return r;
+  }
+  case FIOBJ_T_HASH:
+    r = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), new)();
+    FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), reserve)
+    (r, FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), count)(o));
+    FIO_MAP_EACH(FIO_NAME(fiobj, FIOBJ___NAME_HASH), o, i) {
+      FIOBJ key = fiobj___arena_escape(i.key);
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), set)
+      (r, key, fiobj___arena_escape(i.value), NULL);
+      fiobj_free(key);
+    }
+    return r;
+  default: /* only big numbers and floats are built by the JSON parser */
+    if ((*fiobj_object_metadata(o)) == &FIOBJ___FLOAT_CLASS_VTBL)
+      return FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_FLOAT), new)(
+          FIO_NAME2(FIO_NAME(fiobj, FIOBJ___NAME_FLOAT), f)(o));
+    return FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_NUMBER), new)(
+        FIO_NAME2(FIO_NAME(fiobj, FIOBJ___NAME_NUMBER), i)(o));
+  }
+}
+
+/** Internal: `fiobj_dup` for arena backed objects (`ref` was incremented). */
+SFUNC FIOBJ fiobj___arena_dup(FIOBJ o, size_t ref) {
+  if ((ref & FIOBJ___ARENA_ROOT))
+    return o;
+  fio_atomic_sub(fiobj___ref(o), 1); /* nested objects aren't counted */
+  if (fiobj___arena_current) /* the document is being built */
+    return o;
+  return fiobj___arena_escape(o);
+}
+
+/** Internal: `fiobj_free` for arena backed objects (`ref` was decremented). */
+SFUNC void fiobj___arena_free(FIOBJ o, size_t ref) {
+  volatile size_t *r = fiobj___ref(o);
+  if (!(ref & FIOBJ___ARENA_ROOT)) {
+    fio_atomic_add(r, 1); /* nested objects are released with the root */
     return;
   }
-  case FIOBJ_T_STRING: /* fall through */
-  default: {
-    fio_str_info_s info = FIO_NAME2(fiobj, cstr)(o);
-    FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)(args->json, "\"", 1);
-    FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write_escape)
-    (args->json, info.buf, info.len);
-    FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)(args->json, "\"", 1);
+  if (ref != (FIOBJ___ARENA_NODE | FIOBJ___ARENA_ROOT))
     return;
+  fiobj___arena_release((fiobj___arena_s *)((char *)r - FIOBJ___ARENA_HEAD));
+}
+
+/* *****************************************************************************
+FIOBJ JSON support - output
+***************************************************************************** */
+
+/* the longest `fio_ftoa` output (i.e., "-1.2345678901234567e-308") */
+#define FIOBJ___JSON_FLOAT_CAPA 24
+
+/* tests 8 bytes at once, non-zero if any byte requires JSON escaping */
+FIO_IFUNC uint64_t fiobj___json_escape_test64(uint64_t w) {
+  const uint64_t ones = UINT64_C(0x0101010101010101);
+  return ((w - (ones * 0x20)) & ~w & (ones * 0x80)) | /* control characters */
+         fio_has_byte64(w, '"') | fio_has_byte64(w, '\\');
+}
+
+/* the number of bytes added by escaping `c` (as `fio_string_write_escape`) */
+FIO_IFUNC size_t fiobj___json_escape_extra(uint8_t c) {
+  if (c > 0x1F)
+    return (c == '"') | (c == '\\');
+  return 5 - ((size_t)((c > 7) & (c < 14) & (c != 11)) << 2);
+}
+
+/* writes a single (possibly escaped) byte */
+FIO_IFUNC char *fiobj___json_escape_byte(char *dest, uint8_t c) {
+  if (FIO_LIKELY(!fiobj___json_escape_extra(c))) {
+    *dest = (char)c;
+    return dest + 1;
+  }
+  *dest++ = '\\';
+  switch (c) {
+  case '\b': *dest = 'b'; return dest + 1;
+  case '\f': *dest = 'f'; return dest + 1;
+  case '\n': *dest = 'n'; return dest + 1;
+  case '\r': *dest = 'r'; return dest + 1;
+  case '\t': *dest = 't'; return dest + 1;
+  case '"':  /* fall through */
+  case '\\': *dest = (char)c; return dest + 1;
+  }
+  dest[0] = 'u';
+  dest[1] = '0';
+  dest[2] = '0';
+  dest[3] = (char)fio_i2c(c >> 4);
+  dest[4] = (char)fio_i2c(c & 15);
+  return dest + 5;
+}
+
+/* returns the length of the escaped data (excluding the quotes) */
+FIO_SFUNC size_t fiobj___json_escaped_len(fio_str_info_s s) {
+  size_t r = s.len;
+  const char *end = s.buf + s.len;
+  for (; s.buf + 8 <= end; s.buf += 8) {
+    if (FIO_LIKELY(!fiobj___json_escape_test64(fio_buf2u64u(s.buf))))
+      continue;
+    for (size_t i = 0; i < 8; ++i)
+      r += fiobj___json_escape_extra((uint8_t)s.buf[i]);
   }
+  for (; s.buf < end; ++s.buf)
+    r += fiobj___json_escape_extra((uint8_t)s.buf[0]);
+  return r;
+}
+
+/* writes the escaped data, copying 8 bytes at a time when possible */
+FIO_SFUNC char *fiobj___json_escape(char *dest, fio_str_info_s s) {
+  const char *end = s.buf + s.len;
+  while (s.buf + 8 <= end) {
+    uint64_t w = fio_buf2u64u(s.buf);
+    if (FIO_LIKELY(!fiobj___json_escape_test64(w))) {
+      fio_u2buf64u(dest, w);
+      dest += 8;
+    } else {
+      for (size_t i = 0; i < 8; ++i)
+        dest = fiobj___json_escape_byte(dest, (uint8_t)s.buf[i]);
+    }
+    s.buf += 8;
+  }
+  while (s.buf < end)
+    dest = fiobj___json_escape_byte(dest, (uint8_t)*s.buf++);
+  return dest;
+}
+
+/* the sizing pass (see `fiobj_json_capa`), excluding the NUL terminator. */
+FIO_SFUNC size_t fiobj___json_capa(FIOBJ o, size_t level, uint8_t beautify) {
+  size_t r, count;
+  switch (FIOBJ_TYPE(o)) {
+  case FIOBJ_T_TRUE: return 4;
+  case FIOBJ_T_FALSE: return 5;
+  case FIOBJ_T_NULL: return 4;
+  case FIOBJ_T_NUMBER:
+    return fio_digits10(FIO_NAME2(FIO_NAME(fiobj, FIOBJ___NAME_NUMBER), i)(o));
+  case FIOBJ_T_FLOAT: return FIOBJ___JSON_FLOAT_CAPA;
+  case FIOBJ_T_STRING: /* fall through */
+  default: return fiobj___json_escaped_len(FIO_NAME2(fiobj, cstr)(o)) + 2;
   case FIOBJ_T_ARRAY:
-    if (!FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), count)(o))
-      goto empty_array;
-    if (args->level == FIOBJ_MAX_NESTING)
-      goto err_array_nesting;
-    {
-      ++args->level;
-      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)(args->json, "[", 1);
-      const uint32_t len =
-          FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), count)(o);
-      if (args->beautify) {
-        fiobj___json_format_internal_beauty_pad(args->json, args->level);
-      }
-      fiobj___json_format_internal__(
-          args,
-          FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), get)(o, 0));
-      if (args->beautify) {
-        for (size_t i = 1; i < len; ++i) {
-          FIOBJ child =
-              FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), get)(o, i);
-          FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)
-          (args->json, ",", 1);
-          fiobj___json_format_internal_beauty_pad(args->json, args->level);
-          fiobj___json_format_internal__(args, child);
-        }
-      } else {
-        for (size_t i = 1; i < len; ++i) {
-          FIOBJ child =
-              FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), get)(o, i);
-          FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)
-          (args->json, ",", 1);
-          fiobj___json_format_internal__(args, child);
-        }
-      }
-      --args->level;
-      if (args->beautify) {
-        fiobj___json_format_internal_beauty_pad(args->json, args->level);
-      }
-      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)(args->json, "]", 1);
+    count = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), count)(o);
+    if (!count)
+      return 2;
+    if (level == FIOBJ_MAX_NESTING)
+      return 3;
+    r = 1 + count; /* brackets and commas */
+    if (beautify)
+      r += (count * (2 + ((level + 1) << 1))) + 2 + (level << 1);
+    FIO_ARRAY_EACH(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), o, pos) {
+      r += fiobj___json_capa(*pos, level + 1, beautify);
     }
-    return;
+    return r;
   case FIOBJ_T_HASH:
-    if (!FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), count)(o))
-      goto empty_hash;
-    if (args->level == FIOBJ_MAX_NESTING)
-      goto err_hash_nesting;
-    {
-      size_t i = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), count)(o);
-      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)
-      (args->json, "{", 1);
-      ++args->level;
-      FIO_MAP_EACH(FIO_NAME(fiobj, FIOBJ___NAME_HASH), o, couplet) {
-        if (args->beautify) {
-          fiobj___json_format_internal_beauty_pad(args->json, args->level);
-        }
-        fio_str_info_s info = FIO_NAME2(fiobj, cstr)(couplet.key);
-        FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)
-        (args->json, "\"", 1);
-        FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write_escape)
-        (args->json, info.buf, info.len);
-        FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)
-        (args->json, "\":", 2);
-        fiobj___json_format_internal__(args, couplet.value);
-        if (--i)
-          FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)
-        (args->json, ",", 1);
-      }
-      --args->level;
-      if (args->beautify) {
-        fiobj___json_format_internal_beauty_pad(args->json, args->level);
-      }
-      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)
-      (args->json, "}", 1);
+    count = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), count)(o);
+    if (!count)
+      return 2;
+    if (level == FIOBJ_MAX_NESTING)
+      return 3;
+    r = 1 + (count << 1); /* braces, colons and commas */
+    if (beautify)
+      r += (count * (2 + ((level + 1) << 1))) + 2 + (level << 1);
+    FIO_MAP_EACH(FIO_NAME(fiobj, FIOBJ___NAME_HASH), o, i) {
+      r += fiobj___json_escaped_len(FIO_NAME2(fiobj, cstr)(i.key)) + 2;
+      r += fiobj___json_capa(i.value, level + 1, beautify);
     }
-    return;
+    return r;
   }
-empty_hash:
-  FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)
-  (args->json, "{}", 2);
-  return;
-empty_array:
-  FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)
-  (args->json, "[]", 2);
-  return;
-err_array_nesting:
-  FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)
-  (args->json, "[ ]", 3);
-  goto log_nesting_error;
-err_hash_nesting:
-  FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)
-  (args->json, "{ }", 3);
-log_nesting_error:
+}
+
+/* a JSON output buffer, growing the `str` String (if any) when full */
+typedef struct {
+  char *buf;
+  size_t len;
+  size_t capa;
+  FIOBJ str;
+} fiobj___json_writer_s;
+
+/* writes a new line followed by the indentation for the nesting `level` */
+FIO_IFUNC void fiobj___json_write_pad(fiobj___json_writer_s *w, size_t level) {
+  w->buf[w->len++] = '\r';
+  w->buf[w->len++] = '\n';
+  FIO_MEMSET(w->buf + w->len, ' ', level << 1);
+  w->len += level << 1;
+}
+
+/* grows the output String, so more than `len` bytes are available */
+FIO_SFUNC int fiobj___json_writer_grow(fiobj___json_writer_s *w, size_t len) {
+  fio_str_info_s s;
+  if (!w->str)
+    return -1;
+  FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), resize)(w->str, w->len);
+  /* double the capacity, so large outputs are copied only a few times */
+  s = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING),
+               reserve)(w->str, (len > w->len ? len : w->len) + 1);
+  w->buf = s.buf;
+  w->capa = s.capa - 1; /* the NUL byte isn't available to the writer */
+  return 0 - (w->capa - w->len <= len);
+}
+
+/* makes sure that more than `len` bytes are available, returns -1 on error */
+#define FIOBJ___JSON_RESERVE(w, len_)                                          \
+  (FIO_LIKELY((w)->capa - (w)->len > (len_))                                   \
+       ? 0                                                                     \
+       : fiobj___json_writer_grow((w), (len_)))
+
+/* writes a JSON String (with room for the next comma or colon) */
+FIO_SFUNC int fiobj___json_write_string(fiobj___json_writer_s *w,
+                                        fio_str_info_s s) {
+  const char *end = s.buf + s.len;
+  char *dest;
+  /* assume no escaping is required, most Strings don't require escaping */
+  if (FIOBJ___JSON_RESERVE(w, s.len + 2))
+    return -1;
+  dest = w->buf + w->len;
+  *dest++ = '"';
+  for (; s.buf + 8 <= end; s.buf += 8, dest += 8) {
+    uint64_t word = fio_buf2u64u(s.buf);
+    if (FIO_UNLIKELY(fiobj___json_escape_test64(word)))
+      goto escape;
+    fio_u2buf64u(dest, word);
+  }
+  for (; s.buf < end; ++s.buf) {
+    if (FIO_UNLIKELY(fiobj___json_escape_extra((uint8_t)*s.buf)))
+      goto escape;
+    *dest++ = *s.buf;
+  }
+finish:
+  *dest++ = '"';
+  w->len = (size_t)(dest - w->buf);
+  return 0;
+
+escape:
+  w->len = (size_t)(dest - w->buf);
+  s.len = (size_t)(end - s.buf);
+  if (FIOBJ___JSON_RESERVE(w, fiobj___json_escaped_len(s) + 1))
+    return -1;
+  dest = fiobj___json_escape(w->buf + w->len, s);
+  goto finish;
+}
+
+/* the writing pass (see `fiobj_json_write`), returns -1 on error. */
+FIO_SFUNC int fiobj___json_write(fiobj___json_writer_s *w,
+                                 FIOBJ o,
+                                 size_t level,
+                                 uint8_t beautify) {
+  const size_t pad = beautify ? ((level + 1) << 1) + 2 : 0;
+  size_t count;
+  if (FIOBJ___JSON_RESERVE(w, FIOBJ___JSON_FLOAT_CAPA + pad))
+    return -1;
+  switch (FIOBJ_TYPE(o)) {
+  case FIOBJ_T_TRUE:
+    fio_memcpy4(w->buf + w->len, "true");
+    w->len += 4;
+    return 0;
+  case FIOBJ_T_FALSE:
+    fio_memcpy5(w->buf + w->len, "false");
+    w->len += 5;
+    return 0;
+  case FIOBJ_T_NULL:
+    fio_memcpy4(w->buf + w->len, "null");
+    w->len += 4;
+    return 0;
+  case FIOBJ_T_NUMBER: {
+    int64_t i = FIO_NAME2(FIO_NAME(fiobj, FIOBJ___NAME_NUMBER), i)(o);
+    count = fio_digits10(i);
+    fio_ltoa10(w->buf + w->len, i, count);
+    w->len += count;
+    return 0;
+  }
+  case FIOBJ_T_FLOAT:
+    w->len += fio_ftoa(w->buf + w->len,
+                       FIO_NAME2(FIO_NAME(fiobj, FIOBJ___NAME_FLOAT), f)(o),
+                       10);
+    return 0;
+  case FIOBJ_T_STRING: /* fall through */
+  default: return fiobj___json_write_string(w, FIO_NAME2(fiobj, cstr)(o));
+  case FIOBJ_T_ARRAY:
+    count = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), count)(o);
+    if (!count) {
+      fio_memcpy2(w->buf + w->len, "[]");
+      w->len += 2;
+      return 0;
+    }
+    if (level == FIOBJ_MAX_NESTING) {
+      fio_memcpy3(w->buf + w->len, "[ ]");
+      goto nesting_error;
+    }
+    w->buf[w->len++] = '[';
+    FIO_ARRAY_EACH(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), o, pos) {
+      if (FIOBJ___JSON_RESERVE(w, pad))
+        return -1;
+      if (beautify)
+        fiobj___json_write_pad(w, level + 1);
+      if (fiobj___json_write(w, *pos, level + 1, beautify))
+        return -1;
+      w->buf[w->len++] = ','; /* room for 1 byte is always available */
+    }
+    --w->len; /* the last comma */
+    if (FIOBJ___JSON_RESERVE(w, pad + 2)) /* the bracket and the next comma */
+      return -1;
+    if (beautify)
+      fiobj___json_write_pad(w, level);
+    w->buf[w->len++] = ']';
+    return 0;
+  case FIOBJ_T_HASH:
+    count = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), count)(o);
+    if (!count) {
+      fio_memcpy2(w->buf + w->len, "{}");
+      w->len += 2;
+      return 0;
+    }
+    if (level == FIOBJ_MAX_NESTING) {
+      fio_memcpy3(w->buf + w->len, "{ }");
+      goto nesting_error;
+    }
+    w->buf[w->len++] = '{';
+    FIO_MAP_EACH(FIO_NAME(fiobj, FIOBJ___NAME_HASH), o, i) {
+      if (FIOBJ___JSON_RESERVE(w, pad))
+        return -1;
+      if (beautify)
+        fiobj___json_write_pad(w, level + 1);
+      if (fiobj___json_write_string(w, FIO_NAME2(fiobj, cstr)(i.key)))
+        return -1;
+      w->buf[w->len++] = ':';
+      if (fiobj___json_write(w, i.value, level + 1, beautify))
+        return -1;
+      w->buf[w->len++] = ',';
+    }
+    --w->len; /* the last comma */
+    if (FIOBJ___JSON_RESERVE(w, pad + 2)) /* the bracket and the next comma */
+      return -1;
+    if (beautify)
+      fiobj___json_write_pad(w, level);
+    w->buf[w->len++] = '}';
+    return 0;
+  }
+nesting_error:
   FIO_LOG_ERROR("JSON formatting truncated - nesting level too deep.");
+  w->len += 3;
+  return 0;
+}
+
+/** Returns the buffer length required for writing the JSON representation. */
+SFUNC size_t fiobj_json_capa(FIOBJ o, uint8_t beautify) {
+  return fiobj___json_capa(o, 0, beautify) + 1;
+}
+
+/** Writes the JSON representation of the object to `dest`. */
+SFUNC size_t fiobj_json_write(char *dest, FIOBJ o, uint8_t beautify) {
+  /* the buffer was sized by the caller, so it is never reported as full */
+  fiobj___json_writer_s w = {.buf = dest, .capa = ((size_t)-1) >> 1};
+  fiobj___json_write(&w, o, 0, beautify);
+  dest[w.len] = 0;
+  return w.len;
+}
+
+/* appends the JSON for `o` to the `dest` String (see `fiobj2json`). */
+SFUNC void fiobj___json_format(FIOBJ dest, FIOBJ o, uint8_t beautify) {
+  fio_str_info_s s;
+  fiobj___json_writer_s w;
+  if (FIO_NAME_BL(FIO_NAME(fiobj, FIOBJ___NAME_STRING), frozen)(dest))
+    return;
+  /* `resize` commits the String's state before the buffer is written to */
+  s = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), resize)(
+      dest,
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), len)(dest));
+  w = (fiobj___json_writer_s){
+      .buf = s.buf,
+      .len = s.len,
+      .capa = s.capa - 1,
+      .str = dest,
+  };
+  fiobj___json_write(&w, o, 0, beautify);
+  FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), resize)(dest, w.len);
 }
 
+#undef FIOBJ___JSON_RESERVE
+#undef FIOBJ___JSON_FLOAT_CAPA
+
 /* *****************************************************************************
 FIOBJ JSON parsing
 ***************************************************************************** */
@@ -34253,6 +39619,108 @@ SFUNC FIOBJ fiobj_json_parse(fio_str_info_s str, size_t *consumed_p) {
   return (FIOBJ)result.ctx;
 }
 
+/* arena documents: objects are adopted once they are complete */
+FIO_SFUNC void *fiobj___json_arena_on_number(int64_t i) {
+  void *o = fiobj___json_on_number(i);
+  fiobj___arena_adopt((FIOBJ)o);
+  return o;
+}
+FIO_SFUNC void *fiobj___json_arena_on_float(double f) {
+  void *o = fiobj___json_on_float(f);
+  fiobj___arena_adopt((FIOBJ)o);
+  return o;
+}
+FIO_SFUNC void *fiobj___json_arena_on_string(const void *start, size_t len) {
+  void *o = fiobj___json_on_string(start, len);
+  fiobj___arena_adopt((FIOBJ)o);
+  return o;
+}
+FIO_SFUNC void *fiobj___json_arena_on_string_simple(const void *start,
+                                                    size_t len) {
+  void *o = fiobj___json_on_string_simple(start, len);
+  fiobj___arena_adopt((FIOBJ)o);
+  return o;
+}
+FIO_SFUNC void *fiobj___json_arena_on_map(void *ctx, void *at) {
+  return FIO_NAME(fiobj, FIO_NAME(FIOBJ___NAME_HASH, new))();
+  (void)ctx, (void)at;
+}
+FIO_SFUNC void *fiobj___json_arena_on_array(void *ctx, void *at) {
+  return FIO_NAME(fiobj, FIO_NAME(FIOBJ___NAME_ARRAY, new))();
+  (void)ctx, (void)at;
+}
+FIO_SFUNC int fiobj___json_arena_map_push(void *ctx, void *key, void *value) {
+  fiobj___arena_adopt((FIOBJ)key);
+  fiobj___arena_adopt((FIOBJ)value);
+  return fiobj___json_map_push(ctx, key, value);
+}
+FIO_SFUNC int fiobj___json_arena_array_push(void *ctx, void *value) {
+  fiobj___arena_adopt((FIOBJ)value);
+  return fiobj___json_array_push(ctx, value);
+}
+FIO_SFUNC int fiobj___json_arena_finished(void *ctx) {
+  fiobj___arena_adopt((FIOBJ)ctx);
+  return 0;
+}
+FIO_SFUNC void fiobj___json_arena_free_unused_object(void *ctx) {
+  fiobj___arena_adopt((FIOBJ)ctx);
+}
+FIO_SFUNC void *fiobj___json_arena_on_error(void *ctx) {
+  fiobj___arena_adopt((FIOBJ)ctx);
+  return ctx; /* the arena is released by the caller */
+}
+static fio_json_parser_callbacks_s FIOBJ_JSON_ARENA_PARSER_CALLBACKS = {
+    .on_null = fiobj___json_on_null,
+    .on_true = fiobj___json_on_true,
+    .on_false = fiobj___json_on_false,
+    .on_number = fiobj___json_arena_on_number,
+    .on_float = fiobj___json_arena_on_float,
+    .on_string = fiobj___json_arena_on_string,
+    .on_string_simple = fiobj___json_arena_on_string_simple,
+    .on_map = fiobj___json_arena_on_map,
+    .on_array = fiobj___json_arena_on_array,
+    .map_push = fiobj___json_arena_map_push,
+    .array_push = fiobj___json_arena_array_push,
+    .array_finished = fiobj___json_arena_finished,
+    .map_finished = fiobj___json_arena_finished,
+    .free_unused_object = fiobj___json_arena_free_unused_object,
+    .on_error = fiobj___json_arena_on_error,
+};
+
+/** Parses JSON into a read-only document that lives in a single arena. */
+SFUNC FIOBJ fiobj_json_parse_arena(fio_str_info_s str, size_t *consumed_p) {
+  FIOBJ r;
+  volatile size_t *ref;
+  fiobj___arena_s *old = fiobj___arena_current;
+  fiobj___arena_s *a = fiobj___arena_new(str.len);
+  if (!a) {
+    if (consumed_p)
+      *consumed_p = 0;
+    return FIOBJ_INVALID;
+  }
+  fiobj___arena_current = a;
+  fio_json_result_s result =
+      fio_json_parse(&FIOBJ_JSON_ARENA_PARSER_CALLBACKS, str.buf, str.len);
+  fiobj___arena_current = old;
+  if (consumed_p)
+    *consumed_p = result.stop_pos;
+  r = (FIOBJ)result.ctx;
+  if (result.err) {
+    fiobj___arena_release(a);
+    return FIOBJ_INVALID;
+  }
+  fiobj___arena_adopt(r);
+  ref = fiobj___ref(r);
+  if (ref && (char *)ref == (char *)a + FIOBJ___ARENA_HEAD) {
+    ref[0] = FIOBJ___ARENA_NODE | FIOBJ___ARENA_ROOT | 1;
+    return r;
+  }
+  if (ref) /* the root object must not point into the released arena */
+    r = fiobj___arena_escape(r);
+  fiobj___arena_release(a);
+  return r;
+}
+
 /**
  * Updates a Hash using JSON data.
  *
@@ -34561,6 +40029,574 @@ SFUNC FIOBJ fiobj_json_find(FIOBJ o, fio_str_info_s n) {
     }
   }
 }
+
+/* *****************************************************************************
+FIOBJ JSON compiled paths
+***************************************************************************** */
+
+/* a path set is a trie of path segments, node 0 is the root (the object) */
+typedef struct {
+  /** the Hash Map key (FIOBJ_INVALID for an Array index) */
+  FIOBJ key;
+  /** the key's hash value */
+  uint64_t hash;
+  /** the Array index */
+  uint32_t index;
+  /** the parent node */
+  uint32_t parent;
+  /** the first child node (0 if none) */
+  uint32_t child;
+  /** the next sibling node (0 if none) */
+  uint32_t next;
+  /** 1 + the index of the first path ending at this node (0 if none) */
+  uint32_t result;
+} fiobj___json_path_node_s;
+
+struct fiobj_json_path_s {
+  /** the number of paths in the set */
+  uint32_t count;
+  /** the number of trie nodes */
+  uint32_t len;
+  /** the capacity of the trie nodes array */
+  uint32_t capa;
+  /** the trie node each path ends at */
+  uint32_t *ends;
+  /** the trie nodes */
+  fiobj___json_path_node_s *nodes;
+};
+
+#define FIOBJ___JSON_PATH_NONE  ((uint32_t)-1)
+#define FIOBJ___JSON_PATH_BUILD ((uint32_t)-2)
+
+FIO_LEAK_COUNTER_DEF(fiobj_json_path)
+
+/* finds (or adds) the child node for a path segment, returns 0 on error */
+FIO_SFUNC uint32_t fiobj___json_path_child(fiobj_json_path_s *p,
+                                           uint32_t parent,
+                                           fio_str_info_s key,
+                                           uint32_t index) {
+  fiobj___json_path_node_s *n;
+  for (uint32_t i = p->nodes[parent].child; i; i = p->nodes[i].next) {
+    n = p->nodes + i;
+    if (key.buf ? (n->key && FIO_STR_INFO_IS_EQ(
+                                 FIO_NAME2(fiobj, cstr)(n->key),
+                                 key))
+                : (!n->key && n->index == index))
+      return i;
+  }
+  if (p->len == p->capa) {
+    n = (fiobj___json_path_node_s *)FIO_MEM_REALLOC_(
+        p->nodes,
+        sizeof(*n) * p->capa,
+        sizeof(*n) * (p->capa << 1),
+        sizeof(*n) * p->len);
+    if (!n)
+      return 0;
+    p->nodes = n;
+    p->capa <<= 1;
+  }
+  n = p->nodes + p->len;
+  *n = (fiobj___json_path_node_s){
+      .index = index,
+      .parent = parent,
+      .next = p->nodes[parent].child,
+  };
+  if (key.buf) {
+    n->key = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), new_cstr)(key.buf,
+                                                                     key.len);
+    n->hash = FIO_NAME2(fiobj, hash)(n->key);
+  }
+  p->nodes[parent].child = p->len;
+  return p->len++;
+}
+
+/* compiles the notation of the path at index `at`, returns -1 on error */
+FIO_SFUNC int fiobj___json_path_compile(fiobj_json_path_s *p,
+                                        uint32_t at,
+                                        fio_str_info_s n) {
+  uint32_t node = 0, depth = 0;
+  char *pos = n.buf, *end = n.buf + n.len;
+  if (n.len == 1 && pos[0] == '.')
+    ++pos;
+  while (pos < end) {
+    fio_str_info_s key = {0};
+    uint64_t index = 0;
+    if (++depth > FIOBJ_MAX_NESTING)
+      return -1;
+    if (*pos == '[') {
+      char *start = ++pos;
+      while (pos < end && fio_c2i(*pos) < 10 && index <= 0xFFFFFFFFULL)
+        index = (index * 10) + fio_c2i(*pos++);
+      if (pos == start || pos == end || *pos != ']' || index > 0xFFFFFFFFULL)
+        return -1;
+      ++pos;
+      if (pos < end && *pos != '.' && *pos != '[')
+        return -1;
+    } else {
+      key.buf = pos;
+      while (pos < end && *pos != '.' && *pos != '[')
+        ++pos;
+      key.len = pos - key.buf;
+      if (!key.len)
+        return -1;
+    }
+    pos += (pos < end && *pos == '.');
+    node = fiobj___json_path_child(p, node, key, (uint32_t)index);
+    if (!node)
+      return -1;
+  }
+  p->ends[at] = node;
+  if (!p->nodes[node].result)
+    p->nodes[node].result = at + 1;
+  return 0;
+}
+
+/** Compiles JSON path notations into a reusable path set. */
+SFUNC fiobj_json_path_s *fiobj_json_path_new(const fio_str_info_s *notations,
+                                             size_t count) {
+  fiobj_json_path_s *p;
+  if (!notations || !count || count > 0xFFFFFFF0ULL)
+    return NULL;
+  p = (fiobj_json_path_s *)
+      FIO_MEM_REALLOC_(NULL, 0, sizeof(*p) + (sizeof(uint32_t) * count), 0);
+  if (!p)
+    return p;
+  FIO_LEAK_COUNTER_ON_ALLOC(fiobj_json_path);
+  *p = (fiobj_json_path_s){
+      .count = (uint32_t)count,
+      .len = 1,
+      .capa = 8,
+      .ends = (uint32_t *)(p + 1),
+  };
+  p->nodes = (fiobj___json_path_node_s *)
+      FIO_MEM_REALLOC_(NULL, 0, sizeof(*p->nodes) * p->capa, 0);
+  if (!p->nodes)
+    goto error;
+  p->nodes[0] = (fiobj___json_path_node_s){0};
+  for (size_t i = 0; i < count; ++i)
+    if (fiobj___json_path_compile(p, (uint32_t)i, notations[i]))
+      goto error;
+  return p;
+error:
+  fiobj_json_path_free(p);
+  return NULL;
+}
+
+/** Frees a compiled path set. */
+SFUNC void fiobj_json_path_free(fiobj_json_path_s *p) {
+  if (!p)
+    return;
+  if (p->nodes) {
+    for (uint32_t i = 1; i < p->len; ++i)
+      fiobj_free(p->nodes[i].key);
+    FIO_MEM_FREE_(p->nodes, sizeof(*p->nodes) * p->capa);
+  }
+  FIO_LEAK_COUNTER_ON_FREE(fiobj_json_path);
+  FIO_MEM_FREE_(p, sizeof(*p) + (sizeof(uint32_t) * p->count));
+}
+
+/** Returns the number of paths in the path set. */
+SFUNC size_t fiobj_json_path_count(fiobj_json_path_s *p) {
+  return p ? p->count : 0;
+}
+
+/* returns the object addressed by a single trie node (segment) */
+FIO_IFUNC FIOBJ fiobj___json_path_step(FIOBJ o, fiobj___json_path_node_s *n) {
+  if (n->key)
+    return (FIOBJ_TYPE_CLASS(o) == FIOBJ_T_HASH)
+               ? FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH),
+                          get_hashed)(o, n->hash, n->key)
+               : FIOBJ_INVALID;
+  return (FIOBJ_TYPE_CLASS(o) == FIOBJ_T_ARRAY)
+             ? FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY),
+                        get)(o, (int64_t)n->index)
+             : FIOBJ_INVALID;
+}
+
+/* walks the trie from the root to `node` */
+FIO_SFUNC FIOBJ fiobj___json_path_find(FIOBJ o,
+                                       fiobj_json_path_s *p,
+                                       uint32_t node) {
+  if (!node)
+    return o;
+  o = fiobj___json_path_find(o, p, p->nodes[node].parent);
+  if (o == FIOBJ_INVALID)
+    return o;
+  return fiobj___json_path_step(o, p->nodes + node);
+}
+
+/* stores the results for `node` and its descendants (new references if own) */
+FIO_SFUNC void fiobj___json_path_visit(FIOBJ o,
+                                       fiobj_json_path_s *p,
+                                       uint32_t node,
+                                       FIOBJ *results,
+                                       int own) {
+  fiobj___json_path_node_s *n = p->nodes + node;
+  if (n->result)
+    results[n->result - 1] = own ? fiobj_dup(o) : o;
+  for (uint32_t i = n->child; i; i = p->nodes[i].next) {
+    FIOBJ v = fiobj___json_path_step(o, p->nodes + i);
+    if (v != FIOBJ_INVALID)
+      fiobj___json_path_visit(v, p, i, results, own);
+  }
+}
+
+/* fills in the results for duplicate paths, returns the number found */
+FIO_SFUNC size_t fiobj___json_path_finish(fiobj_json_path_s *p,
+                                          FIOBJ *results,
+                                          int own) {
+  size_t r = 0;
+  for (uint32_t i = 0; i < p->count; ++i) {
+    uint32_t first = p->nodes[p->ends[i]].result - 1;
+    if (first != i && results[first] != FIOBJ_INVALID)
+      results[i] = own ? fiobj_dup(results[first]) : results[first];
+    r += (results[i] != FIOBJ_INVALID);
+  }
+  return r;
+}
+
+/** Finds the data addressed by the first path in the path set. */
+SFUNC FIOBJ fiobj_json_path_find(FIOBJ o, fiobj_json_path_s *p) {
+  if (!p)
+    return FIOBJ_INVALID;
+  return fiobj___json_path_find(o, p, p->ends[0]);
+}
+
+/** Finds the data addressed by all the paths in a single traversal. */
+SFUNC size_t fiobj_json_path_find_all(FIOBJ o,
+                                      fiobj_json_path_s *p,
+                                      FIOBJ *results) {
+  if (!p || !results)
+    return 0;
+  for (uint32_t i = 0; i < p->count; ++i)
+    results[i] = FIOBJ_INVALID;
+  fiobj___json_path_visit(o, p, 0, results, 0);
+  return fiobj___json_path_finish(p, results, 0);
+}
+
+/* *****************************************************************************
+FIOBJ JSON compiled paths - selective parsing
+***************************************************************************** */
+
+/* a container along a path (a trie node with children) */
+typedef struct {
+  /** the container's trie node (NONE for the root frame) */
+  uint32_t node;
+  /** the trie node bound to the value of the last key (Hash Maps) */
+  uint32_t pending;
+  /** the number of values pushed so far */
+  uint32_t count;
+  uint8_t is_map;
+  uint8_t expect_key;
+} fiobj___json_path_frame_s;
+
+typedef struct {
+  fiobj_json_path_s *path;
+  FIOBJ *results;
+  /** the container being built, until it's complete */
+  FIOBJ root;
+  /** the trie node of the container being built */
+  uint32_t build_node;
+  /** the nesting level within the container being built */
+  uint32_t build;
+  /** the nesting level within an ignored container */
+  uint32_t skip;
+  /** the number of frames */
+  uint32_t depth;
+  fiobj___json_path_frame_s frames[FIOBJ_MAX_NESTING + 1];
+} fiobj___json_path_parser_s;
+
+/* the parser has no `udata`, so the selective parsing state is per thread */
+static __thread fiobj___json_path_parser_s *fiobj___json_path_parser;
+
+/* a placeholder for values that aren't built */
+#define FIOBJ___JSON_PATH_SKIP ((void *)&fiobj___json_path_parser)
+
+/* returns the trie node bound to the next value (NONE if ignored) */
+FIO_SFUNC uint32_t fiobj___json_path_bind(fiobj___json_path_parser_s *s) {
+  fiobj___json_path_frame_s *f = s->frames + s->depth - 1;
+  fiobj___json_path_node_s *nodes = s->path->nodes;
+  if (f->is_map)
+    return f->pending;
+  if (f->node == FIOBJ___JSON_PATH_NONE) /* the root frame */
+    return f->count ? FIOBJ___JSON_PATH_NONE : 0;
+  for (uint32_t i = nodes[f->node].child; i; i = nodes[i].next)
+    if (!nodes[i].key && nodes[i].index == f->count)
+      return i;
+  return FIOBJ___JSON_PATH_NONE;
+}
+
+/* returns 1 if the next value is a Hash Map key in a frame (consuming it) */
+FIO_IFUNC int fiobj___json_path_is_key(fiobj___json_path_parser_s *s) {
+  fiobj___json_path_frame_s *f = s->frames + s->depth - 1;
+  if (s->build | s->skip | !f->expect_key)
+    return 0;
+  f->expect_key = 0;
+  f->pending = FIOBJ___JSON_PATH_NONE;
+  return 1;
+}
+
+/* returns the trie node for a scalar value (or BUILD / NONE) */
+FIO_SFUNC uint32_t fiobj___json_path_scalar(void) {
+  fiobj___json_path_parser_s *s = fiobj___json_path_parser;
+  uint32_t n;
+  if (s->build)
+    return FIOBJ___JSON_PATH_BUILD;
+  if (s->skip || fiobj___json_path_is_key(s))
+    return FIOBJ___JSON_PATH_NONE;
+  n = fiobj___json_path_bind(s);
+  if (n == FIOBJ___JSON_PATH_NONE || !s->path->nodes[n].result)
+    return FIOBJ___JSON_PATH_NONE;
+  return n;
+}
+
+/* stores a scalar value (unless it's part of a container being built) */
+FIO_SFUNC void *fiobj___json_path_store(uint32_t n, void *o) {
+  fiobj___json_path_parser_s *s = fiobj___json_path_parser;
+  if (n == FIOBJ___JSON_PATH_BUILD)
+    return o;
+  fiobj___json_path_visit((FIOBJ)o, s->path, n, s->results, 1);
+  fiobj_free((FIOBJ)o);
+  return FIOBJ___JSON_PATH_SKIP;
+}
+
+/* releases the results of a trie node and its descendants */
+FIO_SFUNC void fiobj___json_path_clear(fiobj___json_path_parser_s *s,
+                                       uint32_t node) {
+  fiobj___json_path_node_s *n = s->path->nodes + node;
+  if (n->result) {
+    fiobj_free(s->results[n->result - 1]);
+    s->results[n->result - 1] = FIOBJ_INVALID;
+  }
+  for (uint32_t i = n->child; i; i = s->path->nodes[i].next)
+    fiobj___json_path_clear(s, i);
+}
+
+/* matches a Hash Map key to the frame's trie node children */
+FIO_SFUNC void fiobj___json_path_key(fiobj___json_path_parser_s *s,
+                                     fio_str_info_s key) {
+  fiobj___json_path_frame_s *f = s->frames + s->depth - 1;
+  fiobj___json_path_node_s *nodes = s->path->nodes;
+  for (uint32_t i = nodes[f->node].child; i; i = nodes[i].next) {
+    fio_str_info_s k;
+    if (!nodes[i].key)
+      continue;
+    k = FIO_NAME2(fiobj, cstr)(nodes[i].key);
+    if (FIO_STR_INFO_IS_EQ(k, key)) {
+      f->pending = i;
+      fiobj___json_path_clear(s, i); /* duplicate keys: the last value wins */
+      return;
+    }
+  }
+}
+
+FIO_SFUNC void *fiobj___json_path_on_null(void) {
+  uint32_t n = fiobj___json_path_scalar();
+  if (n == FIOBJ___JSON_PATH_NONE)
+    return FIOBJ___JSON_PATH_SKIP;
+  return fiobj___json_path_store(n, fiobj___json_on_null());
+}
+FIO_SFUNC void *fiobj___json_path_on_true(void) {
+  uint32_t n = fiobj___json_path_scalar();
+  if (n == FIOBJ___JSON_PATH_NONE)
+    return FIOBJ___JSON_PATH_SKIP;
+  return fiobj___json_path_store(n, fiobj___json_on_true());
+}
+FIO_SFUNC void *fiobj___json_path_on_false(void) {
+  uint32_t n = fiobj___json_path_scalar();
+  if (n == FIOBJ___JSON_PATH_NONE)
+    return FIOBJ___JSON_PATH_SKIP;
+  return fiobj___json_path_store(n, fiobj___json_on_false());
+}
+FIO_SFUNC void *fiobj___json_path_on_number(int64_t i) {
+  uint32_t n = fiobj___json_path_scalar();
+  if (n == FIOBJ___JSON_PATH_NONE)
+    return FIOBJ___JSON_PATH_SKIP;
+  return fiobj___json_path_store(n, fiobj___json_on_number(i));
+}
+FIO_SFUNC void *fiobj___json_path_on_float(double f) {
+  uint32_t n = fiobj___json_path_scalar();
+  if (n == FIOBJ___JSON_PATH_NONE)
+    return FIOBJ___JSON_PATH_SKIP;
+  return fiobj___json_path_store(n, fiobj___json_on_float(f));
+}
+FIO_SFUNC void *fiobj___json_path_on_string(const void *start, size_t len) {
+  fiobj___json_path_parser_s *s = fiobj___json_path_parser;
+  uint32_t n;
+  if (fiobj___json_path_is_key(s)) {
+    FIOBJ_STR_TEMP_VAR(key);
+    FIO_NAME(fiobj, FIO_NAME(FIOBJ___NAME_STRING, write_unescape))
+    (key, (const char *)start, len);
+    fiobj___json_path_key(s, FIO_NAME2(fiobj, cstr)(key));
+    FIOBJ_STR_TEMP_DESTROY(key);
+    return FIOBJ___JSON_PATH_SKIP;
+  }
+  n = fiobj___json_path_scalar();
+  if (n == FIOBJ___JSON_PATH_NONE)
+    return FIOBJ___JSON_PATH_SKIP;
+  return fiobj___json_path_store(n, fiobj___json_on_string(start, len));
+}
+FIO_SFUNC void *fiobj___json_path_on_string_simple(const void *start,
+                                                   size_t len) {
+  fiobj___json_path_parser_s *s = fiobj___json_path_parser;
+  uint32_t n;
+  if (fiobj___json_path_is_key(s)) {
+    fiobj___json_path_key(s, FIO_STR_INFO2((char *)start, len));
+    return FIOBJ___JSON_PATH_SKIP;
+  }
+  n = fiobj___json_path_scalar();
+  if (n == FIOBJ___JSON_PATH_NONE)
+    return FIOBJ___JSON_PATH_SKIP;
+  return fiobj___json_path_store(n, fiobj___json_on_string_simple(start, len));
+}
+FIO_SFUNC void *fiobj___json_path_on_container(uint8_t is_map) {
+  fiobj___json_path_parser_s *s = fiobj___json_path_parser;
+  fiobj___json_path_node_s *nodes = s->path->nodes;
+  uint32_t n;
+  if (s->build) {
+    ++s->build;
+    goto build;
+  }
+  if (s->skip || fiobj___json_path_is_key(s))
+    goto skip;
+  n = fiobj___json_path_bind(s);
+  if (n == FIOBJ___JSON_PATH_NONE || !(nodes[n].result | nodes[n].child))
+    goto skip;
+  if (nodes[n].result) { /* build the container (and collect its children) */
+    s->build = 1;
+    s->build_node = n;
+    s->root = (is_map ? FIO_NAME(fiobj, FIO_NAME(FIOBJ___NAME_HASH, new))()
+                      : FIO_NAME(fiobj, FIO_NAME(FIOBJ___NAME_ARRAY, new))());
+    return (void *)s->root;
+  }
+  FIO_ASSERT_DEBUG(s->depth <= FIOBJ_MAX_NESTING, "JSON path frames overflow");
+  s->frames[s->depth++] = (fiobj___json_path_frame_s){
+      .node = n,
+      .pending = FIOBJ___JSON_PATH_NONE,
+      .is_map = is_map,
+      .expect_key = is_map,
+  };
+  return FIOBJ___JSON_PATH_SKIP;
+skip:
+  ++s->skip;
+  return FIOBJ___JSON_PATH_SKIP;
+build:
+  if (is_map)
+    return (void *)FIO_NAME(fiobj, FIO_NAME(FIOBJ___NAME_HASH, new))();
+  return (void *)FIO_NAME(fiobj, FIO_NAME(FIOBJ___NAME_ARRAY, new))();
+}
+FIO_SFUNC void *fiobj___json_path_on_map(void *ctx, void *at) {
+  return fiobj___json_path_on_container(1);
+  (void)ctx, (void)at;
+}
+FIO_SFUNC void *fiobj___json_path_on_array(void *ctx, void *at) {
+  return fiobj___json_path_on_container(0);
+  (void)ctx, (void)at;
+}
+FIO_SFUNC int fiobj___json_path_map_push(void *ctx, void *key, void *value) {
+  fiobj___json_path_parser_s *s = fiobj___json_path_parser;
+  fiobj___json_path_frame_s *f = s->frames + s->depth - 1;
+  if (s->build)
+    return fiobj___json_map_push(ctx, key, value);
+  if (!s->skip) {
+    f->expect_key = 1;
+    f->pending = FIOBJ___JSON_PATH_NONE;
+    ++f->count;
+  }
+  return 0;
+}
+FIO_SFUNC int fiobj___json_path_array_push(void *ctx, void *value) {
+  fiobj___json_path_parser_s *s = fiobj___json_path_parser;
+  if (s->build)
+    return fiobj___json_array_push(ctx, value);
+  if (!s->skip)
+    ++s->frames[s->depth - 1].count;
+  return 0;
+}
+FIO_SFUNC int fiobj___json_path_finished(void *ctx) {
+  fiobj___json_path_parser_s *s = fiobj___json_path_parser;
+  if (s->build) {
+    if (--s->build)
+      return 0;
+    s->root = FIOBJ_INVALID;
+    fiobj___json_path_visit((FIOBJ)ctx, s->path, s->build_node, s->results, 1);
+    fiobj_free((FIOBJ)ctx);
+    return 0;
+  }
+  if (s->skip)
+    --s->skip;
+  else if (s->depth > 1)
+    --s->depth;
+  return 0;
+}
+FIO_SFUNC void fiobj___json_path_free_unused_object(void *ctx) {
+  if (fiobj___json_path_parser->build)
+    fiobj_free((FIOBJ)ctx);
+}
+FIO_SFUNC void *fiobj___json_path_on_error(void *ctx) {
+  return NULL; /* results are released by the caller */
+  (void)ctx;
+}
+static fio_json_parser_callbacks_s FIOBJ_JSON_PATH_PARSER_CALLBACKS = {
+    .on_null = fiobj___json_path_on_null,
+    .on_true = fiobj___json_path_on_true,
+    .on_false = fiobj___json_path_on_false,
+    .on_number = fiobj___json_path_on_number,
+    .on_float = fiobj___json_path_on_float,
+    .on_string = fiobj___json_path_on_string,
+    .on_string_simple = fiobj___json_path_on_string_simple,
+    .on_map = fiobj___json_path_on_map,
+    .on_array = fiobj___json_path_on_array,
+    .map_push = fiobj___json_path_map_push,
+    .array_push = fiobj___json_path_array_push,
+    .array_finished = fiobj___json_path_finished,
+    .map_finished = fiobj___json_path_finished,
+    .free_unused_object = fiobj___json_path_free_unused_object,
+    .on_error = fiobj___json_path_on_error,
+};
+
+/** Parses JSON data, building only the objects addressed by the path set. */
+SFUNC size_t fiobj_json_path_parse(fiobj_json_path_s *p,
+                                   fio_str_info_s json,
+                                   FIOBJ *results,
+                                   size_t *consumed) {
+  fiobj___json_path_parser_s s;
+  fiobj___json_path_parser_s *old = fiobj___json_path_parser;
+  fio_json_result_s r;
+  if (consumed)
+    *consumed = 0;
+  if (!p || !results)
+    return 0;
+  for (uint32_t i = 0; i < p->count; ++i)
+    results[i] = FIOBJ_INVALID;
+  s.path = p;
+  s.results = results;
+  s.root = FIOBJ_INVALID;
+  s.build_node = s.build = s.skip = 0;
+  s.depth = 1;
+  s.frames[0] = (fiobj___json_path_frame_s){
+      .node = FIOBJ___JSON_PATH_NONE,
+      .pending = FIOBJ___JSON_PATH_NONE,
+  };
+  fiobj___json_path_parser = &s;
+  r = fio_json_parse(&FIOBJ_JSON_PATH_PARSER_CALLBACKS, json.buf, json.len);
+  fiobj___json_path_parser = old;
+  if (consumed)
+    *consumed = r.stop_pos;
+  if (r.err) {
+    fiobj_free(s.root); /* only set if parsing stopped mid-container */
+    for (uint32_t i = 0; i < p->count; ++i) {
+      fiobj_free(results[i]);
+      results[i] = FIOBJ_INVALID;
+    }
+    return 0;
+  }
+  return fiobj___json_path_finish(p, results, 1);
+}
+#undef FIOBJ___JSON_PATH_SKIP
+#undef FIOBJ___JSON_PATH_NONE
+#undef FIOBJ___JSON_PATH_BUILD
+
 /* *****************************************************************************
 FIOBJ cleanup
 ***************************************************************************** */
@@ -37590,6 +43626,9 @@ static fio___io_listen_s *fio___io_listen_dup(fio___io_listen_s *l) {
   return l;
 }
 
+/* attaches the listener when the reactor starts (an ON_START callback) */
+FIO_SFUNC void fio___io_listen_attach_task(void *l_);
+
 static void fio___io_listen_free(void *l_) {
   fio___io_listen_s *l = (fio___io_listen_s *)l_;
   if (l->io)
@@ -37598,9 +43637,11 @@ static void fio___io_listen_free(void *l_) {
     return;
 
   fio_state_callback_remove(FIO_CALL_AT_EXIT, fio___io_listen_free, (void *)l);
-  fio_state_callback_remove(FIO_CALL_ON_START, fio___io_listen_free, (void *)l);
+  fio_state_callback_remove(FIO_CALL_ON_START,
+                            fio___io_listen_attach_task,
+                            (void *)l);
   fio_state_callback_remove(FIO_CALL_PRE_START,
-                            fio___io_listen_free,
+                            fio___io_listen_attach_task,
                             (void *)l);
   fio___io_func_free_context_caller(l->protocol->io_functions.free_context,
                                     l->tls_ctx);
@@ -37915,7 +43956,7 @@ SFUNC fio_io_s *fio_io_connect FIO_NOOP(fio_io_connect_args_s args) {
   size_t url_len = strlen(args.url);
   fio_url_s url = fio_url_parse(args.url, url_len);
   args.tls = fio_io_tls_from_url(args.tls, url);
-  fio___io_init_protocol(args.protocol, !!args.tls);
+  fio___io_init_protocol_test(args.protocol, !!args.tls);
   if (url.query.len)
     url_len = url.query.buf - (args.url + 1);
   else if (url.target.len)
@@ -38754,6 +44795,7 @@ typedef enum {
   FIO___PUBSUB_IDENTIFY = (128 | 4),  /* identify remote connection */
   FIO___PUBSUB_FORWARDER = (128 | 8), /* forward to external engine */
   FIO___PUBSUB_PING = (128 | 16),
+  FIO___PUBSUB_BATCH = (128 | 16 | 8), /* coalesced cluster (peer) messages */
 
   FIO___PUBSUB_HISTORY_START = (128 | 32),
   FIO___PUBSUB_HISTORY_END = (128 | 64),
@@ -38936,6 +44978,32 @@ SFUNC void fio_pubsub_secret_set(char *secret, size_t len);
 /** Auto-peer detection and pub/sub multi-machine clustering using `port`. */
 SFUNC void fio_pubsub_broadcast_on_port(int16_t port);
 
+#ifndef FIO_PUBSUB_CLUSTER_BATCH_SIZE
+/**
+ * Messages sent to cluster peers are coalesced into a single (encrypted) frame
+ * until the frame reaches this size (in bytes) or until the batch delay passes.
+ */
+#define FIO_PUBSUB_CLUSTER_BATCH_SIZE (1UL << 14)
+#endif
+
+#ifndef FIO_PUBSUB_CLUSTER_BATCH_DELAY
+/**
+ * The maximum delay (in milliseconds) before a partial batch is sent to a peer.
+ *
+ * If zero (0), batches are sent at the end of the current IO reactor cycle.
+ */
+#define FIO_PUBSUB_CLUSTER_BATCH_DELAY 0
+#endif
+
+#ifndef FIO_PUBSUB_CLUSTER_BACKLOG_LIMIT
+/**
+ * When a cluster peer's outgoing backlog exceeds this number of bytes, reading
+ * from worker processes (IPC publishers) is suspended until the peer catches
+ * up (the peer's backlog drops below half this value).
+ */
+#define FIO_PUBSUB_CLUSTER_BACKLOG_LIMIT (1UL << 21)
+#endif
+
 /* *****************************************************************************
 
 
@@ -39084,6 +45152,9 @@ typedef struct {
   size_t len;
   uint64_t uuid[2];
   fio___pubsub_message_s *msg;
+  char *batch;             /* outgoing (unencrypted) cluster peer batch */
+  uint8_t batch_scheduled; /* a batch flush task was scheduled */
+  uint8_t throttled;       /* peer fell behind, IPC reading is suspended */
   char buf[];
 } fio___pubsub_message_parser_s;
 
@@ -39103,6 +45174,8 @@ FIO_SFUNC void fio___pubsub_message_parser_init(
 FIO_SFUNC void fio___pubsub_message_parser_destroy(
     fio___pubsub_message_parser_s *p) {
   fio___pubsub_message_free(p->msg);
+  fio_bstr_free(p->batch);
+  p->batch = NULL;
   FIO_LEAK_COUNTER_ON_FREE(fio___pubsub_message_parser_s);
 }
 
@@ -39254,6 +45327,7 @@ FIO_SFUNC void fio___pubsub_protocol_on_attach(fio_io_s *io);
 FIO_SFUNC void fio___pubsub_protocol_on_data_master(fio_io_s *io);
 FIO_SFUNC void fio___pubsub_protocol_on_data_worker(fio_io_s *io);
 FIO_SFUNC void fio___pubsub_protocol_on_data_remote(fio_io_s *io);
+FIO_SFUNC void fio___pubsub_protocol_on_ready_remote(fio_io_s *io);
 FIO_SFUNC void fio___pubsub_protocol_on_close(void *buffer, void *udata);
 FIO_SFUNC void fio___pubsub_protocol_on_timeout(fio_io_s *io);
 
@@ -39283,6 +45357,7 @@ static struct FIO___PUBSUB_POSTOFFICE {
     fio_io_protocol_s remote;
   } protocol;
   fio_io_s *broadcaster;
+  size_t throttled; /* number of cluster peers that fell behind */
   struct {
     fio_msg_metadata_fn build;
     void (*cleanup)(void *);
@@ -39312,6 +45387,7 @@ static struct FIO___PUBSUB_POSTOFFICE {
                 {
                     .on_attach = fio___pubsub_protocol_on_attach,
                     .on_data = fio___pubsub_protocol_on_data_remote,
+                    .on_ready = fio___pubsub_protocol_on_ready_remote,
                     .on_close = fio___pubsub_protocol_on_close,
                     .on_timeout = fio___pubsub_protocol_on_timeout,
                     .buffer_size = sizeof(fio___pubsub_message_parser_s) +
@@ -39488,6 +45564,7 @@ FIO_SFUNC void fio___pubsub_protocol_on_attach(fio_io_s *io);
 FIO_SFUNC void fio___pubsub_protocol_on_data_master(fio_io_s *io);
 FIO_SFUNC void fio___pubsub_protocol_on_data_worker(fio_io_s *io);
 FIO_SFUNC void fio___pubsub_protocol_on_data_remote(fio_io_s *io);
+FIO_SFUNC void fio___pubsub_protocol_on_ready_remote(fio_io_s *io);
 FIO_SFUNC void fio___pubsub_protocol_on_close(void *buffer, void *udata);
 
 FIO_SFUNC void fio___pubsub_at_exit(void *ignr_) {
@@ -39559,6 +45636,7 @@ FIO_CONSTRUCTOR(fio_postoffice_init) {
   FIO___PUBSUB_POSTOFFICE.protocol.remote = (fio_io_protocol_s){
       .on_attach = fio___pubsub_protocol_on_attach,
       .on_data = fio___pubsub_protocol_on_data_remote,
+      .on_ready = fio___pubsub_protocol_on_ready_remote,
       .on_close = fio___pubsub_protocol_on_close,
       .on_timeout = fio_io_touch,
       .buffer_size =
@@ -40001,14 +46079,9 @@ FIO_IFUNC fio___pubsub_message_s *fio___pubsub_message_author(
   return m;
 }
 
-FIO_SFUNC void fio___pubsub_message_encrypt(fio___pubsub_message_s *m) {
-  if (m->data.udata)
-    return;
-  const void *k = fio___pubsub_secret_key(m->data.id);
-  const uint64_t nonce[2] = {fio_risky_num(m->data.id, 0), m->data.published};
-  uint8_t *pos = (uint8_t *)(m->data.message.buf + m->data.message.len + 1);
-  uint8_t *dest = pos;
-  m->data.udata = (void *)pos;
+/** Writes the message's (unencrypted) wire format header to `pos`. */
+FIO_IFUNC uint8_t *fio___pubsub_message_header_write(uint8_t *pos,
+                                                     fio___pubsub_message_s *m) {
   fio_u2buf64_le(pos, m->data.id);
   pos += 8;
   fio_u2buf64_le(pos, m->data.published);
@@ -40020,6 +46093,36 @@ FIO_SFUNC void fio___pubsub_message_encrypt(fio___pubsub_message_s *m) {
   fio_u2buf24_le(pos, (uint32_t)m->data.message.len);
   pos += 3;
   *(pos++) = m->data.is_json;
+  return pos;
+}
+
+/** Reads a wire format header from `pos`, pointing data at `m->buf`. */
+FIO_IFUNC uint8_t *fio___pubsub_message_header_read(fio___pubsub_message_s *m,
+                                                    uint8_t *pos) {
+  m->data.id = fio_buf2u64_le(pos);
+  pos += 8;
+  m->data.published = fio_buf2u64_le(pos);
+  pos += 8;
+  m->data.filter = fio_buf2u16_le(pos);
+  pos += 2;
+  m->data.channel = FIO_BUF_INFO2(m->buf, fio_buf2u16_le(pos));
+  pos += 2;
+  m->data.message =
+      FIO_BUF_INFO2(m->buf + m->data.channel.len + 1, fio_buf2u24_le(pos));
+  pos += 3;
+  m->data.is_json = *(pos++);
+  return pos;
+}
+
+FIO_SFUNC void fio___pubsub_message_encrypt(fio___pubsub_message_s *m) {
+  if (m->data.udata)
+    return;
+  const void *k = fio___pubsub_secret_key(m->data.id);
+  const uint64_t nonce[2] = {fio_risky_num(m->data.id, 0), m->data.published};
+  uint8_t *pos = (uint8_t *)(m->data.message.buf + m->data.message.len + 1);
+  uint8_t *dest = pos;
+  m->data.udata = (void *)pos;
+  pos = fio___pubsub_message_header_write(pos, m);
   const size_t enc_len = m->data.channel.len + m->data.message.len + 2;
   FIO_MEMCPY(pos, m->data.channel.buf, enc_len);
   if (enc_len == 2)
@@ -40041,18 +46144,7 @@ FIO_SFUNC int fio___pubsub_message_decrypt(fio___pubsub_message_s *m) {
     return -1;
   uint8_t *pos = (uint8_t *)(m->data.message.buf + m->data.message.len + 1);
   uint8_t *const dest = pos;
-  m->data.id = fio_buf2u64_le(pos);
-  pos += 8;
-  m->data.published = fio_buf2u64_le(pos);
-  pos += 8;
-  m->data.filter = fio_buf2u16_le(pos);
-  pos += 2;
-  m->data.channel = FIO_BUF_INFO2(m->buf, fio_buf2u16_le(pos));
-  pos += 2;
-  m->data.message =
-      FIO_BUF_INFO2(m->buf + m->data.channel.len + 1, fio_buf2u24_le(pos));
-  pos += 3;
-  m->data.is_json = *(pos++);
+  pos = fio___pubsub_message_header_read(m, pos);
   const void *k = fio___pubsub_secret_key(m->data.id);
   uint64_t nonce[2] = {fio_risky_num(m->data.id, 0), m->data.published};
   const size_t enc_len = m->data.channel.len + m->data.message.len + 2;
@@ -40107,6 +46199,140 @@ FIO_SFUNC void FIO_ON_MESSAGE_SEND_MESSAGE(fio_msg_s *msg) {
                 .dealloc = (void (*)(void *))fio___pubsub_message_free);
 }
 
+/* *****************************************************************************
+Pub/Sub Cluster Batching (coalesced peer messages, encrypted once per batch)
+
+A batch is sent as a regular message flagged as `FIO___PUBSUB_BATCH`, where the
+message payload is a sequence of unencrypted messages:
+
+| 24 bytes - message header (see wire format) |
+| X bytes - (channel name, + 1 NUL terminator) |
+| Y bytes - (message data, + 1 NUL terminator) |
+
+The batch is authenticated and encrypted as a whole, so each message within the
+batch has no MAC of its own.
+***************************************************************************** */
+
+/* flow control: suspends / resumes reading from IPC (publisher) connections */
+FIO_SFUNC void fio___pubsub_ipc_suspend_task(fio_io_s *io, void *suspend) {
+  (suspend ? fio_io_suspend : fio_io_unsuspend)(io);
+}
+
+/* flow control: marks a peer as throttled (or not) */
+FIO_SFUNC void fio___pubsub_batch_throttle(fio___pubsub_message_parser_s *p,
+                                           uint8_t throttle) {
+  if (p->throttled == throttle)
+    return;
+  p->throttled = throttle;
+  if (throttle ? FIO___PUBSUB_POSTOFFICE.throttled++
+               : --FIO___PUBSUB_POSTOFFICE.throttled)
+    return;
+  FIO_LOG_DEBUG2("(%d) pub/sub cluster peer %s, %s IPC publishers",
+                 fio_io_pid(),
+                 (throttle ? "fell behind" : "caught up"),
+                 (throttle ? "throttling" : "resuming"));
+  fio_io_protocol_each(&FIO___PUBSUB_POSTOFFICE.protocol.ipc,
+                       fio___pubsub_ipc_suspend_task,
+                       (void *)(uintptr_t)throttle);
+}
+
+/* flow control: tests the peer's backlog after writing to the peer */
+FIO_IFUNC void fio___pubsub_batch_test_backlog(fio_io_s *io,
+                                               fio___pubsub_message_parser_s *p) {
+  if (fio_io_backlog(io) > FIO_PUBSUB_CLUSTER_BACKLOG_LIMIT)
+    fio___pubsub_batch_throttle(p, 1);
+}
+
+/* sends the pending batch (if any) to the peer */
+FIO_SFUNC void fio___pubsub_batch_flush(fio_io_s *io,
+                                        fio___pubsub_message_parser_s *p) {
+  char *batch = p->batch;
+  if (!batch)
+    return;
+  p->batch = NULL;
+  fio___pubsub_message_s *m = fio___pubsub_message_author(
+      (fio_publish_args_s){.message = FIO_BUF_INFO2(batch, fio_bstr_len(batch)),
+                           .is_json = FIO___PUBSUB_BATCH});
+  fio_bstr_free(batch);
+  fio___pubsub_message_write2io(io, m);
+  fio___pubsub_message_free(m);
+  fio___pubsub_batch_test_backlog(io, p);
+}
+
+FIO_SFUNC void fio___pubsub_batch_flush_scheduled(fio_io_s *io) {
+  fio___pubsub_message_parser_s *p;
+  if (!fio_io_is_open(io) || !(p = fio___pubsub_message_parser(io)))
+    return;
+  p->batch_scheduled = 0;
+  fio___pubsub_batch_flush(io, p);
+}
+
+#if FIO_PUBSUB_CLUSTER_BATCH_DELAY
+FIO_SFUNC int fio___pubsub_batch_flush_timer(void *io_, void *ignr_) {
+  fio___pubsub_batch_flush_scheduled((fio_io_s *)io_);
+  return -1;
+  (void)ignr_;
+}
+FIO_SFUNC void fio___pubsub_batch_flush_timer_done(void *io_, void *ignr_) {
+  fio_io_free((fio_io_s *)io_);
+  (void)ignr_;
+}
+#else
+FIO_SFUNC void fio___pubsub_batch_flush_task(void *io_, void *ignr_) {
+  fio___pubsub_batch_flush_scheduled((fio_io_s *)io_);
+  fio_io_free((fio_io_s *)io_);
+  (void)ignr_;
+}
+#endif
+
+/* appends a message to a batch (a `fio_bstr`), returning the updated batch */
+FIO_SFUNC char *fio___pubsub_batch_append(char *batch,
+                                          fio___pubsub_message_s *m) {
+  const size_t len = FIO___PUBSUB_MESSAGE_HEADER + m->data.channel.len +
+                     m->data.message.len + 2;
+  const size_t offset = fio_bstr_len(batch);
+  if (!batch)
+    batch = fio_bstr_reserve(NULL, FIO_PUBSUB_CLUSTER_BATCH_SIZE + len);
+  batch = fio_bstr_len_set(batch, offset + len);
+  FIO_MEMCPY(fio___pubsub_message_header_write((uint8_t *)batch + offset, m),
+             m->data.channel.buf,
+             len - FIO___PUBSUB_MESSAGE_HEADER);
+  return batch;
+}
+
+/* adds a message to the peer's batch (`fio_io_protocol_each` callback) */
+FIO_SFUNC void fio___pubsub_message_write2batch(fio_io_s *io, void *m_) {
+  fio___pubsub_message_s *m = (fio___pubsub_message_s *)m_;
+  fio___pubsub_message_parser_s *p = fio___pubsub_message_parser(io);
+  const size_t len = FIO___PUBSUB_MESSAGE_HEADER + m->data.channel.len +
+                     m->data.message.len + 2;
+  if (io == m->data.io || !p)
+    return;
+  if (len >= FIO_PUBSUB_CLUSTER_BATCH_SIZE) { /* big messages: no batching */
+    fio___pubsub_batch_flush(io, p);          /* keeps messages in order */
+    fio___pubsub_message_write2io(io, m);
+    fio___pubsub_batch_test_backlog(io, p);
+    return;
+  }
+  p->batch = fio___pubsub_batch_append(p->batch, m);
+  if (fio_bstr_len(p->batch) >= FIO_PUBSUB_CLUSTER_BATCH_SIZE) {
+    fio___pubsub_batch_flush(io, p);
+    return;
+  }
+  if (p->batch_scheduled)
+    return;
+  p->batch_scheduled = 1;
+#if FIO_PUBSUB_CLUSTER_BATCH_DELAY
+  fio_io_run_every(.fn = fio___pubsub_batch_flush_timer,
+                   .udata1 = fio_io_dup(io),
+                   .on_finish = fio___pubsub_batch_flush_timer_done,
+                   .every = (uint32_t)FIO_PUBSUB_CLUSTER_BATCH_DELAY,
+                   .repetitions = 1);
+#else
+  fio_io_defer(fio___pubsub_batch_flush_task, fio_io_dup(io), NULL);
+#endif
+}
+
 /* *****************************************************************************
 Pub/Sub Message Routing
 ***************************************************************************** */
@@ -40128,7 +46354,7 @@ FIO_SFUNC void fio___pubsub_message_route(fio___pubsub_message_s *m) {
 
   if ((FIO___PUBSUB_POSTOFFICE.filter.remote & flags))
     fio_io_protocol_each(&FIO___PUBSUB_POSTOFFICE.protocol.remote,
-                         fio___pubsub_message_write2io,
+                         fio___pubsub_message_write2batch,
                          m);
 
   if ((FIO___PUBSUB_POSTOFFICE.filter.publish & flags))
@@ -40333,8 +46559,39 @@ FIO_SFUNC void fio___pubsub_on_message_worker(fio_io_s *io,
   fio___pubsub_message_route(msg);
   (void)io;
 }
+FIO_SFUNC void fio___pubsub_on_message_remote(fio_io_s *io,
+                                              fio___pubsub_message_s *msg);
+/* routes each of the messages in a (decrypted) cluster batch, in order */
+FIO_SFUNC void fio___pubsub_batch_unpack(fio_io_s *io,
+                                         fio___pubsub_message_s *batch) {
+  uint8_t *pos = (uint8_t *)batch->data.message.buf;
+  uint8_t *const end = pos + batch->data.message.len;
+  while (pos + FIO___PUBSUB_MESSAGE_HEADER <= end) {
+    const size_t len = fio_buf2u16_le(pos + 18) + fio_buf2u24_le(pos + 20) + 2;
+    if (pos + FIO___PUBSUB_MESSAGE_HEADER + len > end ||
+        pos[23] == FIO___PUBSUB_BATCH)
+      break;
+    fio___pubsub_message_s *m = fio___pubsub_message_alloc(pos);
+    pos = fio___pubsub_message_header_read(m, pos);
+    FIO_MEMCPY(m->buf, pos, len);
+    pos += len;
+    fio___pubsub_message_is_dirty(m); /* no encrypted copy of the message */
+    m->data.io = io;
+    fio___pubsub_on_message_remote(io, m);
+    fio___pubsub_message_free(m);
+  }
+  if (pos == end)
+    return;
+  FIO_LOG_SECURITY("(%d) pub/sub cluster batch corrupted", fio_io_pid());
+  fio_io_close_now(io);
+}
+
 FIO_SFUNC void fio___pubsub_on_message_remote(fio_io_s *io,
                                               fio___pubsub_message_s *msg) {
+  if (msg->data.is_json == FIO___PUBSUB_BATCH) {
+    fio___pubsub_batch_unpack(io, msg);
+    return;
+  }
   fio___pubsub_message_map_s *map = &FIO___PUBSUB_POSTOFFICE.remote_messages;
   map += !!(msg->data.is_json & FIO___PUBSUB_REPLAY);
   fio___pubsub_message_s *existing = fio___pubsub_message_map_set(map, msg);
@@ -40355,6 +46612,12 @@ FIO_SFUNC void fio___pubsub_protocol_on_data_worker(fio_io_s *io) {
 FIO_SFUNC void fio___pubsub_protocol_on_data_remote(fio_io_s *io) {
   fio___pubsub_message_parse(io, fio___pubsub_on_message_remote);
 }
+FIO_SFUNC void fio___pubsub_protocol_on_ready_remote(fio_io_s *io) {
+  fio___pubsub_message_parser_s *p = fio___pubsub_message_parser(io);
+  if (p && p->throttled &&
+      fio_io_backlog(io) < (FIO_PUBSUB_CLUSTER_BACKLOG_LIMIT >> 1))
+    fio___pubsub_batch_throttle(p, 0);
+}
 
 FIO_SFUNC void fio___pubsub_protocol_on_close(void *p_, void *udata) {
   fio___pubsub_message_parser_s *p = (fio___pubsub_message_parser_s *)p_;
@@ -40371,6 +46634,7 @@ FIO_SFUNC void fio___pubsub_protocol_on_close(void *p_, void *udata) {
         fio___pubsub_broadcast_connected_count(
             &FIO___PUBSUB_POSTOFFICE.remote_uuids));
   }
+  fio___pubsub_batch_throttle(p, 0);
   fio___pubsub_message_parser_destroy(p);
   if (FIO___PUBSUB_POSTOFFICE.crush_on_close) {
     if (fio_io_is_running())
@@ -41411,10 +47675,48 @@ HTTP Handle Settings
 #define FIO_HTTP_STATIC_FILE_COMPLETION 1
 #endif
 
+#ifndef FIO_HTTP_STATIC_FILE_CACHE_LIMIT
+/**
+ * Memory limit (in bytes) for the static file cache, 0 disables the cache.
+ *
+ * Small static files are kept in memory together with their pre-compressed
+ * variants and pre-computed header values.
+ *
+ * The cache is opt-in (i.e., `(1UL << 23)`), since cached files are only
+ * tested for changes once every `FIO_HTTP_STATIC_FILE_CACHE_VALIDATE` ms.
+ */
+#define FIO_HTTP_STATIC_FILE_CACHE_LIMIT 0
+#endif
+
+#ifndef FIO_HTTP_STATIC_FILE_CACHE_FILE_MAX
+/** Static files larger than this are never cached (they are streamed). */
+#define FIO_HTTP_STATIC_FILE_CACHE_FILE_MAX (1UL << 16)
+#endif
+
+#ifndef FIO_HTTP_STATIC_FILE_CACHE_VALIDATE
+/** Cached static files are tested for changes (`stat`) once every X ms. */
+#define FIO_HTTP_STATIC_FILE_CACHE_VALIDATE 1000
+#endif
+
 #ifndef FIO_HTTP_LOG_X_REQUEST_START
 #define FIO_HTTP_LOG_X_REQUEST_START 1
 #endif
 
+#ifndef FIO_HTTP_LOG_BUFFER
+/** The default (per thread) access log buffer size in bytes. */
+#define FIO_HTTP_LOG_BUFFER (1UL << 16)
+#endif
+
+#ifndef FIO_HTTP_LOG_INTERVAL
+/** The default interval (in milliseconds) for flushing the access log. */
+#define FIO_HTTP_LOG_INTERVAL 100
+#endif
+
+#ifndef FIO_HTTP_MULTIPART_HEADER_LIMIT
+/** The maximum length (in bytes) for the headers of a single multipart part. */
+#define FIO_HTTP_MULTIPART_HEADER_LIMIT 4096
+#endif
+
 #ifndef FIO_HTTP_ENFORCE_LOWERCASE_HEADERS
 /** If true, the HTTP handle will copy input header names to lower case. */
 #define FIO_HTTP_ENFORCE_LOWERCASE_HEADERS 0
@@ -41612,8 +47914,13 @@ SFUNC fio_str_info_s fio_http_body_read_until(fio_http_s *,
 /** Allocates a body (payload) of (at least) the `expected_length`. */
 SFUNC void fio_http_body_expect(fio_http_s *, size_t expected_length);
 
-/** Writes `data` to the body (payload) associated with the HTTP handle. */
-SFUNC void fio_http_body_write(fio_http_s *, const void *data, size_t len);
+/**
+ * Writes `data` to the body (payload) associated with the HTTP handle.
+ *
+ * Returns -1 if the body is streamed (see `fio_http_body_multipart`) and the
+ * parser failed. Otherwise returns 0.
+ */
+SFUNC int fio_http_body_write(fio_http_s *, const void *data, size_t len);
 
 /**
  * If the body is stored in a temporary file, returns the file's handle.
@@ -41890,9 +48197,134 @@ SFUNC int fio_http_mimetype_register(char *file_ext,
 SFUNC fio_str_info_s fio_http_mimetype(char *file_ext, size_t file_ext_len);
 
 /* *****************************************************************************
-HTTP Body Parsing Helpers (TODO!)
+HTTP Body Parsing Helpers
 ***************************************************************************** */
 
+/** The type used by the `FIO_HTTP_URLENCODED_EACH` iterator macro. */
+typedef struct {
+  /** The name of the current `name=value` pair (still URL encoded). */
+  fio_str_info_s name;
+  /** The value of the current `name=value` pair (still URL encoded). */
+  fio_str_info_s value;
+  fio_str_info_s private___;
+} fio_http_urlencoded_each_s;
+
+/** A helper function for the `FIO_HTTP_URLENCODED_EACH` macro. */
+FIO_IFUNC fio_http_urlencoded_each_s
+fio_http_urlencoded_each_next(fio_http_urlencoded_each_s);
+
+/**
+ * Iterates over the `name=value` pairs of a query string or a
+ * `application/x-www-form-urlencoded` body, skipping empty pairs.
+ *
+ * Names and values are slices of the original data (no copies are made) and
+ * are NOT decoded (see `fio_string_write_url_dec`).
+ *
+ * i.e.: `FIO_HTTP_URLENCODED_EACH(fio_http_query(h), i) { ... i.name ... }`
+ */
+#define FIO_HTTP_URLENCODED_EACH(data, i)                                      \
+  for (fio_http_urlencoded_each_s i = fio_http_urlencoded_each_next(           \
+           (fio_http_urlencoded_each_s){.private___ = (data)});                \
+       i.name.buf;                                                             \
+       i = fio_http_urlencoded_each_next(i))
+
+/** The multipart (`multipart/form-data`) streaming parser type. */
+typedef struct fio_http_multipart_s fio_http_multipart_s;
+
+/** A single part of a multipart body, as passed to the parser's callbacks. */
+typedef struct {
+  /** The form field's name (valid until the part ends). */
+  fio_str_info_s name;
+  /** The uploaded file's name, if any (valid until the part ends). */
+  fio_str_info_s filename;
+  /** The part's content type, if any (valid until the part ends). */
+  fio_str_info_s content_type;
+  /**
+   * If set by `on_part` to a valid file descriptor, the part's data is written
+   * to the file (and `on_data` isn't called). The parser never closes `fd`.
+   */
+  int fd;
+  /** The number of data bytes received for this part so far. */
+  size_t len;
+  /** Set if the part was cut short (on errors or when the parser is freed). */
+  int error;
+  /** The parser's opaque user data (see `fio_http_multipart_settings_s`). */
+  void *udata;
+} fio_http_multipart_part_s;
+
+/**
+ * Multipart parser settings. Callbacks return non-zero to stop the parser
+ * (the parser then reports an error).
+ */
+typedef struct {
+  /** Called once a part's headers were parsed, before any of its data. */
+  int (*on_part)(fio_http_multipart_part_s *part);
+  /** Called for each slice of the part's data (unless `part->fd` was set). */
+  int (*on_data)(fio_http_multipart_part_s *part, fio_buf_info_s data);
+  /**
+   * Called when a part ends (i.e., to close `part->fd`), also when the part is
+   * cut short by an error or by freeing the parser (`part->error` is set).
+   */
+  int (*on_part_end)(fio_http_multipart_part_s *part);
+  /** Opaque user data, available as `part->udata`. */
+  void *udata;
+} fio_http_multipart_settings_s;
+
+/**
+ * Creates a new multipart parser for the `content_type` header value.
+ *
+ * Returns NULL if the content type isn't `multipart/form-data` (or if the
+ * `boundary` is missing or invalid).
+ */
+SFUNC fio_http_multipart_s *fio_http_multipart_new(
+    fio_str_info_s content_type,
+    fio_http_multipart_settings_s settings);
+/** Creates a new multipart parser for the `content_type` header value. */
+#define fio_http_multipart_new(content_type, ...)                              \
+  fio_http_multipart_new((content_type),                                       \
+                         (fio_http_multipart_settings_s){__VA_ARGS__})
+
+/** Frees a multipart parser. */
+SFUNC void fio_http_multipart_free(fio_http_multipart_s *p);
+
+/**
+ * Parses the next chunk of a multipart body, calling the parser's callbacks.
+ *
+ * Chunks may be of any size (part headers and boundaries may be split between
+ * chunks). Part data is passed to the callbacks without being copied.
+ *
+ * Returns 0 on success or -1 on error (once an error occurred, all following
+ * calls fail).
+ */
+SFUNC int fio_http_multipart_parse(fio_http_multipart_s *p, fio_buf_info_s buf);
+
+/**
+ * Returns 1 once the closing boundary was parsed, -1 if an error occurred and
+ * 0 otherwise.
+ */
+SFUNC int fio_http_multipart_is_finished(fio_http_multipart_s *p);
+
+/**
+ * Streams the body (payload) through a new multipart parser, instead of
+ * storing the body, and returns the parser (owned by the HTTP handle).
+ *
+ * This should be called before the body is received (i.e., in the HTTP
+ * server's `pre_http_body` callback), so large uploads are never buffered.
+ * Data received earlier is parsed first and then released.
+ *
+ * Once the parser is attached, `fio_http_body_length` still reports the body's
+ * length, but there's nothing left to read using `fio_http_body_read`.
+ *
+ * Returns NULL if the body isn't `multipart/form-data` or a parser was already
+ * attached.
+ */
+SFUNC fio_http_multipart_s *fio_http_body_multipart(
+    fio_http_s *h,
+    fio_http_multipart_settings_s settings);
+/** Streams the body through a new multipart parser (see above). */
+#define fio_http_body_multipart(h, ...)                                        \
+  fio_http_body_multipart((h), (fio_http_multipart_settings_s){__VA_ARGS__})
+
 /* *****************************************************************************
 Header Parsing Helpers
 ***************************************************************************** */
@@ -42016,7 +48448,7 @@ SFUNC int fio_http_static_file_response(fio_http_s *h,
 /** Returns a human readable string related to the HTTP status number. */
 SFUNC fio_str_info_s fio_http_status2str(size_t status);
 
-/** Logs an HTTP (response) to STDOUT. */
+/** Logs an HTTP (response) using the access log sink (defaults to STDOUT). */
 SFUNC void fio_http_write_log(fio_http_s *h);
 
 /**
@@ -42035,6 +48467,58 @@ SFUNC fio_str_info_s fio_http_date(uint64_t now_in_seconds);
 
 /* date/time string caching for HTTP logging */
 SFUNC fio_str_info_s fio_http_log_time(uint64_t now_in_seconds);
+/* *****************************************************************************
+Access Log Sink
+***************************************************************************** */
+
+/**
+ * The access log sink settings.
+ *
+ * Log lines are collected in per-thread buffers (without locking) and written
+ * in batches by a dedicated logging thread, so the thread serving the request
+ * never waits for the log's target (unless `block` is set).
+ */
+typedef struct {
+  /** The file descriptor to write to (0 == STDOUT). */
+  int fd;
+  /** A file to append log lines to (overrides `fd`). */
+  const char *filename;
+  /** A callback for log batches, called by the logging thread (overrides). */
+  void (*on_write)(fio_str_info_s lines, void *udata);
+  /** Opaque user data for the `on_write` callback. */
+  void *udata;
+  /** Per-thread buffer size in bytes (defaults to `FIO_HTTP_LOG_BUFFER`). */
+  size_t buffer;
+  /** Flush interval in milliseconds (defaults to `FIO_HTTP_LOG_INTERVAL`). */
+  size_t interval;
+  /** A signal that reopens `filename` (log rotation), requires `FIO_SIGNAL`. */
+  int reopen_signal;
+  /** If set, wait for buffer space when full (the default drops log lines). */
+  uint8_t block;
+  /** If set, log lines are written as JSON objects (one object per line). */
+  uint8_t json;
+} fio_http_log_sink_args_s;
+
+/**
+ * Sets the access log sink, flushing any log lines buffered for the previous
+ * sink.
+ *
+ * Should be called before logging begins (i.e., before the server starts), as
+ * buffer size changes only apply to threads that haven't logged yet.
+ */
+SFUNC void fio_http_log_sink(fio_http_log_sink_args_s args);
+#define fio_http_log_sink(...)                                                 \
+  fio_http_log_sink((fio_http_log_sink_args_s){__VA_ARGS__})
+
+/** Writes all buffered log lines to the log sink (blocking). */
+SFUNC void fio_http_log_flush(void);
+
+/** Reopens the log file (log rotation). Safe to call from a signal handler. */
+SFUNC void fio_http_log_reopen(void);
+
+/** Returns the number of log lines dropped due to full buffers. */
+SFUNC size_t fio_http_log_dropped(void);
+
 /* *****************************************************************************
 The HTTP Controller
 ***************************************************************************** */
@@ -42103,6 +48587,38 @@ All memory allocations should use:
 
 */
 
+/* *****************************************************************************
+Body Parsing Helpers - inlined helpers
+***************************************************************************** */
+
+/** A helper function for the `FIO_HTTP_URLENCODED_EACH` macro. */
+FIO_IFUNC fio_http_urlencoded_each_s
+fio_http_urlencoded_each_next(fio_http_urlencoded_each_s i) {
+  char *amp, *equ;
+  do {
+    i.name = i.private___;
+    if (!i.name.buf || !i.name.len)
+      return (fio_http_urlencoded_each_s){0};
+    amp = (char *)FIO_MEMCHR(i.name.buf, '&', i.name.len);
+    if (amp) {
+      i.name.len = amp - i.name.buf;
+      i.private___.len -= i.name.len + 1;
+      i.private___.buf += i.name.len + 1;
+    } else {
+      i.private___ = FIO_STR_INFO0;
+    }
+  } while (!i.name.len); /* skip empty pairs (i.e., `"a=1&&b=2"`) */
+  equ = (char *)FIO_MEMCHR(i.name.buf, '=', i.name.len);
+  if (equ) {
+    i.value.buf = equ + 1;
+    i.value.len = (i.name.buf + i.name.len) - i.value.buf;
+    i.name.len = equ - i.name.buf;
+  } else {
+    i.value = FIO_STR_INFO2(i.name.buf + i.name.len, 0);
+  }
+  return i;
+}
+
 /* *****************************************************************************
 Header Parsing Helpers - inlined helpers
 ***************************************************************************** */
@@ -42788,6 +49304,7 @@ struct fio_http_s {
     size_t len;
     size_t pos;
     int fd;
+    fio_http_multipart_s *multipart; /* streaming body parser (if any) */
   } body;
 };
 
@@ -42818,6 +49335,7 @@ SFUNC fio_http_s *fio_http_destroy(fio_http_s *h) {
   fio_bstr_free(h->body.buf);
   if (h->body.fd != -1)
     close(h->body.fd);
+  fio_http_multipart_free(h->body.multipart);
   FIO_REF_INIT(*h);
   return h;
 }
@@ -42835,9 +49353,11 @@ SFUNC fio_http_s *fio_http_clear_response(fio_http_s *h, bool clear_body) {
   fio_bstr_free(h->body.buf);
   if (h->body.fd != -1)
     close(h->body.fd);
+  fio_http_multipart_free(h->body.multipart);
   h->body.buf = NULL;
   h->body.len = h->body.pos = 0;
   h->body.fd = -1;
+  h->body.multipart = NULL;
   return h;
 }
 
@@ -43645,16 +50165,24 @@ SFUNC fio_str_info_s fio_http_body_read_until(fio_http_s *h,
 
 /** Allocates a body (payload) of (at least) the `expected_length`. */
 SFUNC void fio_http_body_expect(fio_http_s *h, size_t expected_length) {
+  if (h->body.multipart)
+    return;
   ((h->body.fd == -1) ? fio___http_body_expect_buf
                       : fio___http_body_expect_fd)(h, expected_length);
 }
 
 /** Writes `data` to the body (payload) associated with the HTTP handle. */
-SFUNC void fio_http_body_write(fio_http_s *h, const void *data, size_t len) {
+SFUNC int fio_http_body_write(fio_http_s *h, const void *data, size_t len) {
   if (!data || !len)
-    return;
+    return 0;
+  if (h->body.multipart) { /* streamed, the body isn't stored */
+    h->body.pos = (h->body.len += len);
+    return fio_http_multipart_parse(h->body.multipart,
+                                    FIO_BUF_INFO2((char *)data, len));
+  }
   ((h->body.fd == -1) ? fio___http_body_write_buf
                       : fio___http_body_write_fd)(h, data, len);
+  return 0;
 }
 
 /* *****************************************************************************
@@ -44212,6 +50740,349 @@ SFUNC int fio_http_send_error_response(fio_http_s *h, size_t status) {
   return 0;
 }
 
+/* *****************************************************************************
+Access Log Sink - Implementation
+***************************************************************************** */
+
+FIO_LEAK_COUNTER_DEF(http___log_buffer)
+
+/* a per-thread log buffer (ring), written by one thread and read by another. */
+typedef struct fio___http_log_ring_s {
+  struct fio___http_log_ring_s *next;
+  /* advanced only by the thread that owns the ring (writing log lines) */
+  size_t head;
+  /* advanced only while flushing (under the flush lock) */
+  size_t tail;
+  size_t mask;
+  char buf[];
+} fio___http_log_ring_s;
+
+static struct {
+  fio_http_log_sink_args_s args;
+  fio___http_log_ring_s *rings;
+  char *batch;
+  size_t batch_capa;
+  size_t dropped;
+  size_t dropped_reported;
+  fio_thread_t thread;
+  fio_thread_mutex_t lock;
+  fio_thread_cond_t cond;
+  fio_lock_i rings_lock;
+  fio_lock_i flush_lock;
+  int fd;
+  volatile uint8_t running; /* 0 == stopped, 1 == running, 2 == stopping */
+  volatile uint8_t reopen;
+} FIO___HTTP_LOG = {
+    .args = {.buffer = FIO_HTTP_LOG_BUFFER, .interval = FIO_HTTP_LOG_INTERVAL},
+    .fd = -1,
+};
+
+static __thread fio___http_log_ring_s *fio___http_log_ring;
+
+/* writes a batch of log data to the sink's target (call under flush lock). */
+FIO_SFUNC void fio___http_log_output(char *buf, size_t len) {
+  if (FIO___HTTP_LOG.args.on_write) {
+    FIO___HTTP_LOG.args.on_write(FIO_STR_INFO2(buf, len),
+                                 FIO___HTTP_LOG.args.udata);
+    return;
+  }
+  if (FIO___HTTP_LOG.fd == -1) {
+    fwrite(buf, 1, len, stdout);
+    fflush(stdout);
+    return;
+  }
+  if (fio_fd_write(FIO___HTTP_LOG.fd, buf, len) != (ssize_t)len)
+    FIO_LOG_DEBUG2("(%d) HTTP access log write error", fio_getpid());
+}
+
+/* reopens the log file (log rotation), call under flush lock. */
+FIO_SFUNC void fio___http_log_reopen_file(void) {
+  int fd;
+  FIO___HTTP_LOG.reopen = 0;
+  if (!FIO___HTTP_LOG.args.filename)
+    return;
+  fd = fio_filename_open(FIO___HTTP_LOG.args.filename,
+                         O_APPEND | O_CREAT | O_WRONLY);
+  if (fd == -1) {
+    FIO_LOG_ERROR("(%d) couldn't reopen HTTP access log file: %s",
+                  fio_getpid(),
+                  FIO___HTTP_LOG.args.filename);
+    return;
+  }
+  if (FIO___HTTP_LOG.fd != -1)
+    close(FIO___HTTP_LOG.fd);
+  FIO___HTTP_LOG.fd = fd;
+}
+
+/* writes all buffered log lines to the sink's target. */
+FIO_SFUNC void fio___http_log_flush_rings(void) {
+  fio___http_log_ring_s *r;
+  size_t dropped;
+  fio_lock(&FIO___HTTP_LOG.flush_lock);
+  if (FIO___HTTP_LOG.reopen)
+    fio___http_log_reopen_file();
+  fio_lock(&FIO___HTTP_LOG.rings_lock); /* new rings are added at the head */
+  r = FIO___HTTP_LOG.rings;
+  fio_unlock(&FIO___HTTP_LOG.rings_lock);
+  for (; r; r = r->next) {
+    size_t head, start, len;
+    fio_atomic_load(head, &r->head);
+    if (head == r->tail)
+      continue;
+    start = r->tail & r->mask;
+    len = head - r->tail;
+    if (start + len <= r->mask + 1) {
+      fio___http_log_output(r->buf + start, len);
+    } else { /* wrapped around the ring, copy to a continuous batch */
+      const size_t part = r->mask + 1 - start;
+      if (FIO___HTTP_LOG.batch_capa < len) {
+        char *tmp = (char *)FIO_MEM_REALLOC_(FIO___HTTP_LOG.batch,
+                                             FIO___HTTP_LOG.batch_capa,
+                                             r->mask + 1,
+                                             0);
+        if (!tmp)
+          goto skip_ring; /* lines are lost, but the ring must be freed */
+        FIO___HTTP_LOG.batch = tmp;
+        FIO___HTTP_LOG.batch_capa = r->mask + 1;
+      }
+      FIO_MEMCPY(FIO___HTTP_LOG.batch, r->buf + start, part);
+      FIO_MEMCPY(FIO___HTTP_LOG.batch + part, r->buf, len - part);
+      fio___http_log_output(FIO___HTTP_LOG.batch, len);
+    }
+  skip_ring:
+    fio_atomic_exchange(&r->tail, head);
+  }
+  fio_atomic_load(dropped, &FIO___HTTP_LOG.dropped);
+  if (dropped != FIO___HTTP_LOG.dropped_reported) {
+    FIO_LOG_WARNING("(%d) HTTP access log buffer full, %zu log lines dropped.",
+                    fio_getpid(),
+                    dropped - FIO___HTTP_LOG.dropped_reported);
+    FIO___HTTP_LOG.dropped_reported = dropped;
+  }
+  fio_unlock(&FIO___HTTP_LOG.flush_lock);
+}
+
+/* the logging thread - flushes the log buffers every interval. */
+FIO_SFUNC void *fio___http_log_thread(void *ignr_) {
+  (void)ignr_;
+  fio_thread_mutex_lock(&FIO___HTTP_LOG.lock);
+  while (FIO___HTTP_LOG.running == 1) {
+    fio_thread_cond_timedwait(&FIO___HTTP_LOG.cond,
+                              &FIO___HTTP_LOG.lock,
+                              FIO___HTTP_LOG.args.interval);
+    fio_thread_mutex_unlock(&FIO___HTTP_LOG.lock);
+    fio___http_log_flush_rings();
+    fio_thread_mutex_lock(&FIO___HTTP_LOG.lock);
+  }
+  fio_thread_mutex_unlock(&FIO___HTTP_LOG.lock);
+  fio___http_log_flush_rings();
+  return NULL;
+}
+
+/* starts the logging thread if it isn't running, returns -1 if unavailable. */
+FIO_SFUNC int fio___http_log_start(void) {
+  int r = 0;
+  fio_thread_mutex_lock(&FIO___HTTP_LOG.lock);
+  if (!FIO___HTTP_LOG.running) {
+    FIO___HTTP_LOG.running = 1;
+    if (fio_thread_create(&FIO___HTTP_LOG.thread, fio___http_log_thread, NULL))
+      FIO___HTTP_LOG.running = 0;
+  }
+  r = 0 - (FIO___HTTP_LOG.running != 1);
+  fio_thread_mutex_unlock(&FIO___HTTP_LOG.lock);
+  return r;
+}
+
+/* stops the logging thread (flushing the log buffers). */
+FIO_SFUNC void fio___http_log_stop(void) {
+  fio_thread_mutex_lock(&FIO___HTTP_LOG.lock);
+  if (FIO___HTTP_LOG.running != 1) {
+    fio_thread_mutex_unlock(&FIO___HTTP_LOG.lock);
+    return;
+  }
+  FIO___HTTP_LOG.running = 2;
+  fio_thread_cond_signal(&FIO___HTTP_LOG.cond);
+  fio_thread_mutex_unlock(&FIO___HTTP_LOG.lock);
+  fio_thread_join(&FIO___HTTP_LOG.thread);
+  fio_thread_mutex_lock(&FIO___HTTP_LOG.lock);
+  FIO___HTTP_LOG.running = 0;
+  fio_thread_mutex_unlock(&FIO___HTTP_LOG.lock);
+}
+
+/* allocates and registers the calling thread's log buffer. */
+FIO_SFUNC fio___http_log_ring_s *fio___http_log_ring_new(void) {
+  fio___http_log_ring_s *r;
+  size_t capa = 4096;
+  while (capa < FIO___HTTP_LOG.args.buffer)
+    capa <<= 1;
+  r = (fio___http_log_ring_s *)FIO_MEM_REALLOC_(NULL, 0, sizeof(*r) + capa, 0);
+  if (!r)
+    return r;
+  FIO_LEAK_COUNTER_ON_ALLOC(http___log_buffer);
+  *r = (fio___http_log_ring_s){.mask = capa - 1};
+  fio_lock(&FIO___HTTP_LOG.rings_lock);
+  r->next = FIO___HTTP_LOG.rings;
+  FIO___HTTP_LOG.rings = r;
+  fio_unlock(&FIO___HTTP_LOG.rings_lock);
+  return (fio___http_log_ring = r);
+}
+
+/* pushes a log line to the calling thread's log buffer. */
+FIO_SFUNC void fio___http_log_write(char *buf, size_t len) {
+  fio___http_log_ring_s *r = fio___http_log_ring;
+  size_t head, tail, pos;
+  if (FIO_UNLIKELY(FIO___HTTP_LOG.running != 1) && fio___http_log_start())
+    goto write_now;
+  if (FIO_UNLIKELY(!r) && !(r = fio___http_log_ring_new()))
+    goto write_now;
+  if (FIO_UNLIKELY(len > r->mask))
+    goto write_now;
+  head = r->head;
+  for (;;) {
+    fio_atomic_load(tail, &r->tail);
+    if (head - tail + len <= r->mask + 1)
+      break;
+    if (!FIO___HTTP_LOG.args.block) {
+      fio_atomic_add(&FIO___HTTP_LOG.dropped, 1);
+      return;
+    }
+    fio_thread_cond_signal(&FIO___HTTP_LOG.cond);
+    fio_thread_yield();
+  }
+  pos = head & r->mask;
+  if (pos + len <= r->mask + 1) {
+    FIO_MEMCPY(r->buf + pos, buf, len);
+  } else {
+    const size_t part = r->mask + 1 - pos;
+    FIO_MEMCPY(r->buf + pos, buf, part);
+    FIO_MEMCPY(r->buf, buf + part, len - part);
+  }
+  fio_atomic_exchange(&r->head, head + len);
+  /* wake the logging thread early if the buffer is more than half full */
+  if (FIO_UNLIKELY(((head - tail) <= (r->mask >> 1)) &&
+                   ((head + len - tail) > (r->mask >> 1))))
+    fio_thread_cond_signal(&FIO___HTTP_LOG.cond);
+  return;
+
+write_now: /* no log buffer / logging thread, write synchronously */
+  fio_lock(&FIO___HTTP_LOG.flush_lock);
+  fio___http_log_output(buf, len);
+  fio_unlock(&FIO___HTTP_LOG.flush_lock);
+}
+
+/* called when the log rotation signal is received. */
+FIO_SFUNC void fio___http_log_on_signal(int sig, void *udata) {
+  fio_http_log_reopen();
+  (void)sig, (void)udata;
+}
+
+/* Sets the access log sink, flushing lines buffered for the previous sink. */
+SFUNC void fio_http_log_sink FIO_NOOP(fio_http_log_sink_args_s args) {
+  int fd = -1;
+  if (!args.buffer)
+    args.buffer = FIO_HTTP_LOG_BUFFER;
+  if (!args.interval)
+    args.interval = FIO_HTTP_LOG_INTERVAL;
+  if (args.on_write)
+    args.filename = NULL;
+  if (args.filename) {
+    fd = fio_filename_open(args.filename, O_APPEND | O_CREAT | O_WRONLY);
+    if (fd == -1) {
+      FIO_LOG_ERROR("(%d) couldn't open HTTP access log file: %s",
+                    fio_getpid(),
+                    args.filename);
+      args.filename = NULL;
+    } else
+      args.filename =
+          fio_bstr_write(NULL, args.filename, strlen(args.filename));
+  } else if (!args.on_write && args.fd > 0)
+    fd = args.fd;
+  fio___http_log_stop(); /* flushes to the previous target */
+  fio_lock(&FIO___HTTP_LOG.flush_lock);
+  if (FIO___HTTP_LOG.args.filename) {
+    fio_bstr_free((char *)FIO___HTTP_LOG.args.filename);
+    close(FIO___HTTP_LOG.fd);
+  }
+  FIO___HTTP_LOG.args = args;
+  FIO___HTTP_LOG.fd = fd;
+  FIO___HTTP_LOG.reopen = 0;
+  fio_unlock(&FIO___HTTP_LOG.flush_lock);
+#ifdef H___FIO_SIGNAL___H
+  if (args.reopen_signal)
+    fio_signal_monitor(.sig = args.reopen_signal,
+                       .callback = fio___http_log_on_signal,
+                       .immediate = 1);
+#else
+  if (args.reopen_signal)
+    FIO_LOG_ERROR("HTTP access log `reopen_signal` requires FIO_SIGNAL.");
+  (void)fio___http_log_on_signal;
+#endif
+}
+
+/* Writes all buffered log lines to the log sink (blocking). */
+SFUNC void fio_http_log_flush(void) { fio___http_log_flush_rings(); }
+
+/* Reopens the log file (log rotation). Safe to call from a signal handler. */
+SFUNC void fio_http_log_reopen(void) {
+  FIO___HTTP_LOG.reopen = 1; /* the file is reopened by the next flush */
+}
+
+/* Returns the number of log lines dropped due to full buffers. */
+SFUNC size_t fio_http_log_dropped(void) {
+  size_t r;
+  fio_atomic_load(r, &FIO___HTTP_LOG.dropped);
+  return r;
+}
+
+/* the logging thread isn't inherited - buffered lines are the parent's */
+FIO_SFUNC void fio___http_log_on_fork(void *ignr_) {
+  fio___http_log_ring_s *r = FIO___HTTP_LOG.rings;
+  (void)ignr_;
+  fio_thread_mutex_init(&FIO___HTTP_LOG.lock);
+  fio_thread_cond_init(&FIO___HTTP_LOG.cond);
+  FIO___HTTP_LOG.rings_lock = FIO_LOCK_INIT;
+  FIO___HTTP_LOG.flush_lock = FIO_LOCK_INIT;
+  FIO___HTTP_LOG.running = 0;
+  for (; r; r = r->next)
+    r->tail = r->head;
+}
+
+FIO_SFUNC void fio___http_log_init(void) {
+  fio_thread_mutex_init(&FIO___HTTP_LOG.lock);
+  fio_thread_cond_init(&FIO___HTTP_LOG.cond);
+  fio_state_callback_add(FIO_CALL_IN_CHILD, fio___http_log_on_fork, NULL);
+}
+
+/* stops the logging thread, flushes and frees the log buffers. */
+FIO_SFUNC void fio___http_log_destroy(void) {
+  fio___http_log_ring_s *r;
+  fio___http_log_stop();
+  fio___http_log_flush_rings();
+  fio_lock(&FIO___HTTP_LOG.rings_lock);
+  r = FIO___HTTP_LOG.rings;
+  FIO___HTTP_LOG.rings = NULL;
+  fio___http_log_ring = NULL;
+  fio_unlock(&FIO___HTTP_LOG.rings_lock);
+  while (r) {
+    fio___http_log_ring_s *tmp = r;
+    r = r->next;
+    FIO_LEAK_COUNTER_ON_FREE(http___log_buffer);
+    FIO_MEM_FREE_(tmp, sizeof(*tmp) + tmp->mask + 1);
+  }
+  FIO_MEM_FREE_(FIO___HTTP_LOG.batch, FIO___HTTP_LOG.batch_capa);
+  FIO___HTTP_LOG.batch = NULL;
+  FIO___HTTP_LOG.batch_capa = 0;
+  if (FIO___HTTP_LOG.args.filename) {
+    fio_bstr_free((char *)FIO___HTTP_LOG.args.filename);
+    FIO___HTTP_LOG.args.filename = NULL;
+    close(FIO___HTTP_LOG.fd);
+  }
+  FIO___HTTP_LOG.fd = -1;
+  FIO___HTTP_LOG.running = 2; /* any later log lines are written immediately */
+  fio_thread_cond_destroy(&FIO___HTTP_LOG.cond);
+  fio_thread_mutex_destroy(&FIO___HTTP_LOG.lock);
+}
+
 /* *****************************************************************************
 HTTP Logging
 ***************************************************************************** */
@@ -44244,13 +51115,96 @@ rewrite:
   last_pid = pid;
   goto copy;
 }
-/** Logs an HTTP (response) to STDOUT. */
+/* writes a JSON escaped string value, limiting the raw data length. */
+FIO_SFUNC void fio___http_log_json_str(fio_str_info_s *dest,
+                                       const char *name,
+                                       fio_str_info_s value,
+                                       size_t limit) {
+  if (value.len > limit)
+    value.len = limit;
+  fio_string_write(dest, NULL, name, strlen(name));
+  fio_string_write_escape(dest, NULL, value.buf, value.len);
+  fio_string_write(dest, NULL, "\"", 1);
+}
+
+/* Logs an HTTP (response) using the access log sink, formatted as JSON. */
+FIO_SFUNC void fio___http_write_log_json(fio_http_s *h, uint64_t time_end) {
+  FIO_STR_INFO_TMP_VAR(buf, 2047);
+  FIO_STR_INFO_TMP_VAR(from, 127);
+  char date[64];
+  uint64_t time_start = h->received_at, time_proxy = 0;
+  fio_http_from(&from, h);
+  if (FIO_HTTP_LOG_X_REQUEST_START) {
+    /* log request wait time using x-request-start header */
+    fio_str_info_s xstart =
+        fio_http_request_header(h,
+                                FIO_STR_INFO2((char *)"x-request-start", 15),
+                                0);
+    unsigned step =
+        (xstart.len > 1 && (xstart.buf[0] | 32) == 't' && xstart.buf[1] == '=');
+    step <<= 1;
+    xstart.buf += step;
+    xstart.len -= step;
+    time_proxy = fio_atol(&xstart.buf);
+    time_proxy *= (FIO___HTTP_TIME_DIV / 1000); /* assumes info in ms */
+    time_proxy = time_start - time_proxy;
+    if (time_proxy >= (512 * FIO___HTTP_TIME_DIV)) /* wasn't ms? */
+      time_proxy = 0;
+  }
+  fio_string_write2(
+      &buf,
+      NULL,
+      FIO_STRING_WRITE_STR2("{\"pid\":", 7),
+      FIO_STRING_WRITE_NUM(fio_thread_getpid()),
+      FIO_STRING_WRITE_STR2(",\"time\":\"", 9),
+      FIO_STRING_WRITE_STR2(
+          date,
+          fio_time2iso(date, (time_t)(time_end / FIO___HTTP_TIME_DIV))),
+      FIO_STRING_WRITE_STR2("\"", 1));
+  fio___http_log_json_str(&buf, ",\"from\":\"", from, 127);
+  fio___http_log_json_str(&buf,
+                          ",\"method\":\"",
+                          fio_keystr_info(&h->method),
+                          64);
+  fio___http_log_json_str(&buf,
+                          ",\"path\":\"",
+                          fio_keystr_info(&h->path),
+                          256);
+  fio___http_log_json_str(&buf,
+                          ",\"version\":\"",
+                          fio_keystr_info(&h->version),
+                          32);
+  fio_string_write2(
+      &buf,
+      NULL,
+      FIO_STRING_WRITE_STR2(",\"status\":", 10),
+      FIO_STRING_WRITE_NUM(h->status),
+      FIO_STRING_WRITE_STR2(",\"bytes\":", 9),
+      FIO_STRING_WRITE_NUM((h->sent > 0 ? (int64_t)h->sent : 0)),
+      FIO_STRING_WRITE_STR1(",\"duration_" FIO___HTTP_TIME_UNIT "\":"),
+      FIO_STRING_WRITE_NUM(time_end - time_start));
+  if (time_proxy)
+    fio_string_write2(
+        &buf,
+        NULL,
+        FIO_STRING_WRITE_STR1(",\"wait_" FIO___HTTP_TIME_UNIT "\":"),
+        FIO_STRING_WRITE_NUM(time_proxy));
+  fio_string_write(&buf, NULL, "}\n", 2);
+  fio___http_log_write(buf.buf, buf.len);
+  h->received_at = time_end;
+}
+
+/** Logs an HTTP (response) using the access log sink. */
 SFUNC void fio_http_write_log(fio_http_s *h) {
   FIO_STR_INFO_TMP_VAR(buf, 1023);
   intptr_t bytes_sent = h->sent;
   uint64_t time_start, time_end, time_proxy = 0;
   time_start = h->received_at;
   time_end = fio_http_get_timestump();
+  if (FIO___HTTP_LOG.args.json) {
+    fio___http_write_log_json(h, time_end);
+    return;
+  }
   fio_str_info_s date = fio_http_log_time(time_end / FIO___HTTP_TIME_DIV);
   fio_string_write_s to_write[16] = {
       FIO_STRING_WRITE_STR_INFO(fio_keystr_info(&h->method)),
@@ -44306,8 +51260,8 @@ SFUNC void fio_http_write_log(fio_http_s *h) {
   if (buf.buf[buf.len - 1] != '\n')
     buf.buf[buf.len++] = '\n'; /* log was truncated, data too long */
 
-  /* Write log line to STDOUT */
-  fwrite(buf.buf, 1, buf.len, stdout);
+  /* Write log line to the log sink */
+  fio___http_log_write(buf.buf, buf.len);
   h->received_at = time_end;
 }
 
@@ -44336,11 +51290,16 @@ SFUNC int fio_http_etag_is_match(fio_http_s *h) {
                            0);
   if (!cond.len)
     return 0;
+  /* weak comparison (compressed responses weaken the `etag`) */
+  if (etag.len > 2 && etag.buf[0] == 'W' && etag.buf[1] == '/')
+    etag.buf += 2, etag.len -= 2;
   char *end = cond.buf + cond.len;
   for (;;) {
     cond.buf += (cond.buf[0] == ',');
     while (cond.buf[0] == ' ')
       ++cond.buf;
+    if (end - cond.buf > 2 && cond.buf[0] == 'W' && cond.buf[1] == '/')
+      cond.buf += 2;
     if (cond.buf > end || (size_t)(end - cond.buf) < (size_t)etag.len)
       return 0;
     if (FIO_MEMCMP(cond.buf, etag.buf, etag.len)) {
@@ -44354,9 +51313,408 @@ SFUNC int fio_http_etag_is_match(fio_http_s *h) {
 }
 
 /* *****************************************************************************
-Param Parsing (TODO! - parse query, parse mime/multipart parse text/json)
+Body Parsing - multipart/form-data (streaming)
+
+The parser searches each chunk for the delimiter (`CRLF--boundary`), passing
+the data preceding it directly to the callbacks. Only part headers are copied.
+
+If a chunk ends with a partial delimiter, the number of matching bytes is
+carried over. The carried bytes are a prefix of the delimiter, so they are
+never copied. Since the delimiter starts with a CR (which is invalid in a
+boundary), if the next chunk doesn't complete the delimiter, all the carried
+bytes are part of the data.
+
+The body starts with a carried (virtual) CRLF, so the first boundary matches
+the delimiter even though it isn't preceded by a line break.
 ***************************************************************************** */
 
+typedef enum {
+  FIO___HTTP_MULTIPART_PREAMBLE = 0, /* before the first boundary */
+  FIO___HTTP_MULTIPART_BOUNDARY,     /* after a delimiter (padding, CR or -) */
+  FIO___HTTP_MULTIPART_BOUNDARY_LF,  /* expecting the LF after a boundary */
+  FIO___HTTP_MULTIPART_CLOSE,        /* expecting the second `-` (`--`) */
+  FIO___HTTP_MULTIPART_HEADERS,      /* collecting part headers */
+  FIO___HTTP_MULTIPART_DATA,         /* part data */
+  FIO___HTTP_MULTIPART_DONE,         /* the closing boundary was parsed */
+  FIO___HTTP_MULTIPART_ERROR,
+} fio___http_multipart_state_e;
+
+struct fio_http_multipart_s {
+  fio_http_multipart_settings_s settings;
+  fio_http_multipart_part_s part;
+  /* the current part's headers (fio_bstr), part strings point into it */
+  char *head;
+  /* the offset of the header line being collected */
+  size_t line;
+  /* the number of delimiter bytes matched at the end of the previous chunk */
+  size_t carry;
+  fio___http_multipart_state_e state;
+  size_t delim_len;
+  /* CRLF + "--" + boundary (the boundary is limited to 70 bytes) */
+  char delim[76];
+};
+
+FIO_LEAK_COUNTER_DEF(fio_http_multipart_s)
+
+/* compares a string to a lower case ASCII token, ignoring case. */
+FIO_SFUNC int fio___http_multipart_is(const char *s,
+                                      size_t len,
+                                      const char *token,
+                                      size_t token_len) {
+  if (len != token_len)
+    return 0;
+  for (size_t i = 0; i < len; ++i) {
+    if (s[i] == token[i] ||
+        ((s[i] | 32) == token[i] && token[i] >= 'a' && token[i] <= 'z'))
+      continue;
+    return 0;
+  }
+  return 1;
+}
+
+/* parses the `name` and `filename` parameters of a Content-Disposition. */
+FIO_SFUNC void fio___http_multipart_disposition(fio_http_multipart_part_s *part,
+                                                char *pos,
+                                                char *end) {
+  while (pos < end) {
+    char *key, *eq;
+    fio_str_info_s value;
+    while (pos < end && (*pos == ';' || *pos == ' ' || *pos == '\t'))
+      ++pos;
+    key = pos;
+    while (pos < end && *pos != '=' && *pos != ';')
+      ++pos;
+    if (pos == end || *pos == ';')
+      continue; /* a token without a value, i.e., `form-data` */
+    eq = pos++;
+    while (eq > key && (eq[-1] == ' ' || eq[-1] == '\t'))
+      --eq;
+    if (pos < end && *pos == '"') { /* quoted values keep their escapes */
+      value.buf = ++pos;
+      while (pos < end && *pos != '"')
+        pos += 1 + (*pos == '\\');
+      if (pos > end)
+        pos = end;
+      value.len = (size_t)(pos - value.buf);
+      pos += (pos < end);
+    } else {
+      value.buf = pos;
+      while (pos < end && *pos != ';')
+        ++pos;
+      value.len = (size_t)(pos - value.buf);
+      while (value.len &&
+             (value.buf[value.len - 1] == ' ' ||
+              value.buf[value.len - 1] == '\t'))
+        --value.len;
+    }
+    if (fio___http_multipart_is(key, (size_t)(eq - key), "name", 4))
+      part->name = value;
+    else if (fio___http_multipart_is(key, (size_t)(eq - key), "filename", 8))
+      part->filename = value;
+  }
+}
+
+/* parses the collected part headers and starts the part. */
+FIO_SFUNC int fio___http_multipart_part_start(fio_http_multipart_s *p) {
+  char *pos = p->head;
+  char *end = p->head + p->line; /* excludes the empty line */
+  p->part = (fio_http_multipart_part_s){.fd = -1,
+                                        .udata = p->settings.udata};
+  while (pos < end) {
+    char *eol = (char *)FIO_MEMCHR(pos, '\n', (size_t)(end - pos));
+    char *line_end = eol - (eol > pos && eol[-1] == '\r');
+    char *colon = (char *)FIO_MEMCHR(pos, ':', (size_t)(line_end - pos));
+    if (colon) {
+      char *value = colon + 1;
+      char *value_end = line_end;
+      while (value < value_end && (*value == ' ' || *value == '\t'))
+        ++value;
+      while (value_end > value &&
+             (value_end[-1] == ' ' || value_end[-1] == '\t'))
+        --value_end;
+      if (fio___http_multipart_is(pos,
+                                  (size_t)(colon - pos),
+                                  "content-disposition",
+                                  19))
+        fio___http_multipart_disposition(&p->part, value, value_end);
+      else if (fio___http_multipart_is(pos,
+                                       (size_t)(colon - pos),
+                                       "content-type",
+                                       12))
+        p->part.content_type =
+            FIO_STR_INFO2(value, (size_t)(value_end - value));
+    }
+    pos = eol + 1;
+  }
+  p->state = FIO___HTTP_MULTIPART_DATA;
+  return (p->settings.on_part ? p->settings.on_part(&p->part) : 0);
+}
+
+/* collects part headers, line by line, until the empty line. */
+FIO_SFUNC int fio___http_multipart_headers(fio_http_multipart_s *p,
+                                           fio_buf_info_s *buf) {
+  while (buf->len) {
+    char *nl = (char *)FIO_MEMCHR(buf->buf, '\n', buf->len);
+    size_t len = nl ? (size_t)(nl - buf->buf) + 1 : buf->len;
+    size_t line_len;
+    if (fio_bstr_len(p->head) + len > FIO_HTTP_MULTIPART_HEADER_LIMIT)
+      return -1;
+    p->head = fio_bstr_write(p->head, buf->buf, len);
+    buf->buf += len;
+    buf->len -= len;
+    if (!nl)
+      return 0;
+    line_len = fio_bstr_len(p->head) - p->line;
+    if (line_len > 2 || (line_len == 2 && p->head[p->line] != '\r')) {
+      p->line = fio_bstr_len(p->head);
+      continue;
+    }
+    return fio___http_multipart_part_start(p);
+  }
+  return 0;
+}
+
+/* passes part data to the user (or writes it to the part's file). */
+FIO_IFUNC int fio___http_multipart_write(fio_http_multipart_s *p,
+                                         const char *data,
+                                         size_t len) {
+  if (p->state != FIO___HTTP_MULTIPART_DATA || !len)
+    return 0;
+  p->part.len += len;
+  if (p->part.fd != -1)
+    return 0 - (fio_fd_write(p->part.fd, data, len) != (ssize_t)len);
+  if (p->settings.on_data)
+    return p->settings.on_data(&p->part, FIO_BUF_INFO2((char *)data, len));
+  return 0;
+}
+
+/* ends a part that was cut short, so the user can release its resources. */
+FIO_SFUNC void fio___http_multipart_abort(fio_http_multipart_s *p) {
+  if (p->state != FIO___HTTP_MULTIPART_DATA)
+    return;
+  p->state = FIO___HTTP_MULTIPART_ERROR;
+  p->part.error = 1;
+  if (p->settings.on_part_end)
+    p->settings.on_part_end(&p->part);
+}
+
+/* called when a delimiter was found (ends the current part, if any). */
+FIO_SFUNC int fio___http_multipart_delimiter(fio_http_multipart_s *p) {
+  int r = 0;
+  if (p->state == FIO___HTTP_MULTIPART_DATA && p->settings.on_part_end)
+    r = p->settings.on_part_end(&p->part);
+  p->state = FIO___HTTP_MULTIPART_BOUNDARY;
+  p->head = fio_bstr_len_set(p->head, 0);
+  p->line = 0;
+  return r;
+}
+
+/* searches for the delimiter, passing any data that precedes it. */
+FIO_SFUNC int fio___http_multipart_data(fio_http_multipart_s *p,
+                                        fio_buf_info_s *buf) {
+  const char *delim = p->delim;
+  const size_t delim_len = p->delim_len;
+  char *pos, *end;
+  if (p->carry) { /* test if the chunk completes a delimiter */
+    size_t need = delim_len - p->carry;
+    size_t len = (need < buf->len) ? need : buf->len;
+    if (!FIO_MEMCMP(buf->buf, delim + p->carry, len)) {
+      buf->buf += len;
+      buf->len -= len;
+      if (len < need) {
+        p->carry += len;
+        return 0;
+      }
+      p->carry = 0;
+      return fio___http_multipart_delimiter(p);
+    }
+    /* a false positive, the carried bytes were part of the data */
+    if (fio___http_multipart_write(p, delim, p->carry))
+      return -1;
+    p->carry = 0;
+  }
+  pos = buf->buf;
+  end = buf->buf + buf->len;
+  for (;;) {
+    char *cr = (char *)FIO_MEMCHR(pos, '\r', (size_t)(end - pos));
+    size_t left;
+    if (!cr)
+      break;
+    left = (size_t)(end - cr);
+    if (left < delim_len) { /* a possible partial delimiter at the end */
+      if (!FIO_MEMCMP(cr, delim, left)) {
+        p->carry = left;
+        end = cr;
+        break;
+      }
+    } else if (!FIO_MEMCMP(cr, delim, delim_len)) {
+      if (fio___http_multipart_write(p, buf->buf, (size_t)(cr - buf->buf)))
+        return -1;
+      buf->len -= (size_t)(cr - buf->buf) + delim_len;
+      buf->buf = cr + delim_len;
+      return fio___http_multipart_delimiter(p);
+    }
+    pos = cr + 1;
+  }
+  if (fio___http_multipart_write(p, buf->buf, (size_t)(end - buf->buf)))
+    return -1;
+  buf->buf += buf->len;
+  buf->len = 0;
+  return 0;
+}
+
+/* Creates a new multipart parser for the `content_type` header value. */
+SFUNC fio_http_multipart_s *fio_http_multipart_new FIO_NOOP(
+    fio_str_info_s content_type,
+    fio_http_multipart_settings_s settings) {
+  fio_http_multipart_s *p;
+  fio_str_info_s boundary = {0};
+  char *pos = content_type.buf, *end = content_type.buf + content_type.len;
+  if (content_type.len < 19 ||
+      !fio___http_multipart_is(pos, 19, "multipart/form-data", 19))
+    return NULL;
+  for (pos += 19; pos < end; ++pos) { /* find the `boundary` parameter */
+    if (*pos != ';')
+      continue;
+    do {
+      ++pos;
+    } while (pos < end && (*pos == ' ' || *pos == '\t'));
+    if ((size_t)(end - pos) < 10 ||
+        !fio___http_multipart_is(pos, 9, "boundary=", 9))
+      continue;
+    boundary.buf = pos + 9;
+    if (*boundary.buf == '"') {
+      char *q;
+      ++boundary.buf;
+      q = (char *)FIO_MEMCHR(boundary.buf, '"', (size_t)(end - boundary.buf));
+      boundary.len = q ? (size_t)(q - boundary.buf) : 0;
+    } else {
+      char *e = boundary.buf;
+      while (e < end && *e != ';' && *e != ' ' && *e != '\t')
+        ++e;
+      boundary.len = (size_t)(e - boundary.buf);
+    }
+    break;
+  }
+  if (!boundary.len || boundary.len > 70)
+    return NULL;
+  p = (fio_http_multipart_s *)FIO_MEM_REALLOC_(NULL, 0, sizeof(*p), 0);
+  if (!p)
+    return p;
+  FIO_LEAK_COUNTER_ON_ALLOC(fio_http_multipart_s);
+  *p = (fio_http_multipart_s){
+      .settings = settings,
+      .carry = 2, /* the body starts with a (virtual) CRLF */
+      .delim_len = boundary.len + 4,
+  };
+  FIO_MEMCPY(p->delim, "\r\n--", 4);
+  FIO_MEMCPY(p->delim + 4, boundary.buf, boundary.len);
+  return p;
+}
+
+/* Frees a multipart parser. */
+SFUNC void fio_http_multipart_free(fio_http_multipart_s *p) {
+  if (!p)
+    return;
+  fio___http_multipart_abort(p); /* i.e., a truncated body */
+  FIO_LEAK_COUNTER_ON_FREE(fio_http_multipart_s);
+  fio_bstr_free(p->head);
+  FIO_MEM_FREE_(p, sizeof(*p));
+}
+
+/* Parses the next chunk of a multipart body, calling the callbacks. */
+SFUNC int fio_http_multipart_parse(fio_http_multipart_s *p,
+                                   fio_buf_info_s buf) {
+  if (!p)
+    return -1;
+  while (buf.len) {
+    switch (p->state) {
+    case FIO___HTTP_MULTIPART_PREAMBLE: /* fall through */
+    case FIO___HTTP_MULTIPART_DATA:
+      if (fio___http_multipart_data(p, &buf))
+        goto error;
+      continue;
+    case FIO___HTTP_MULTIPART_BOUNDARY:
+      if (*buf.buf == '-')
+        p->state = FIO___HTTP_MULTIPART_CLOSE;
+      else if (*buf.buf == '\r')
+        p->state = FIO___HTTP_MULTIPART_BOUNDARY_LF;
+      else if (*buf.buf == '\n')
+        p->state = FIO___HTTP_MULTIPART_HEADERS;
+      else if (*buf.buf != ' ' && *buf.buf != '\t') /* transport padding */
+        goto error;
+      break;
+    case FIO___HTTP_MULTIPART_BOUNDARY_LF:
+      if (*buf.buf != '\n')
+        goto error;
+      p->state = FIO___HTTP_MULTIPART_HEADERS;
+      break;
+    case FIO___HTTP_MULTIPART_CLOSE:
+      if (*buf.buf != '-')
+        goto error;
+      p->state = FIO___HTTP_MULTIPART_DONE;
+      break;
+    case FIO___HTTP_MULTIPART_HEADERS:
+      if (fio___http_multipart_headers(p, &buf))
+        goto error;
+      continue;
+    case FIO___HTTP_MULTIPART_DONE: /* the epilogue is ignored */
+      return 0;
+    case FIO___HTTP_MULTIPART_ERROR: return -1;
+    }
+    ++buf.buf;
+    --buf.len;
+  }
+  return 0;
+error:
+  fio___http_multipart_abort(p);
+  p->state = FIO___HTTP_MULTIPART_ERROR;
+  return -1;
+}
+
+/* Returns 1 once the closing boundary was parsed, -1 on error, 0 otherwise. */
+SFUNC int fio_http_multipart_is_finished(fio_http_multipart_s *p) {
+  if (!p || p->state == FIO___HTTP_MULTIPART_ERROR)
+    return -1;
+  return (p->state == FIO___HTTP_MULTIPART_DONE);
+}
+
+/* Streams the body through a new multipart parser (instead of storing it). */
+SFUNC fio_http_multipart_s *fio_http_body_multipart FIO_NOOP(
+    fio_http_s *h,
+    fio_http_multipart_settings_s settings) {
+  fio_http_multipart_s *p;
+  fio_str_info_s content_type;
+  if (!h || h->body.multipart)
+    return NULL;
+  content_type = (h->status ? fio_http_response_header
+                            : fio_http_request_header)(
+      h,
+      FIO_STR_INFO2((char *)"content-type", 12),
+      0);
+  p = (fio_http_multipart_new)(content_type, settings);
+  if (!p)
+    return p;
+  if (h->body.fd != -1) { /* parse (and release) data received earlier */
+    char tmp[4096];
+    size_t pos = 0, len;
+    while (pos < h->body.len &&
+           (len = fio_fd_read(h->body.fd, tmp, sizeof(tmp), (off_t)pos))) {
+      fio_http_multipart_parse(p, FIO_BUF_INFO2(tmp, len));
+      pos += len;
+    }
+    close(h->body.fd);
+    h->body.fd = -1;
+  } else if (h->body.len) {
+    fio_http_multipart_parse(p, FIO_BUF_INFO2(h->body.buf, h->body.len));
+  }
+  fio_bstr_free(h->body.buf);
+  h->body.buf = NULL;
+  h->body.pos = h->body.len;
+  h->body.multipart = p;
+  return p;
+}
+
 /* *****************************************************************************
 
 
@@ -44365,6 +51723,269 @@ Param Parsing (TODO! - parse query, parse mime/multipart parse text/json)
 
 ***************************************************************************** */
 
+/* *****************************************************************************
+Static file cache
+***************************************************************************** */
+
+/* pre-compressed static file variants (by order of preference) */
+static const struct {
+  fio_str_info_s encoding;
+  fio_buf_info_s ext;
+} FIO___HTTP_STATIC_ENCODINGS[] = {
+    {{.buf = (char *)"br", .len = 2}, {.buf = (char *)".br", .len = 3}},
+    {{.buf = (char *)"gzip", .len = 4}, {.buf = (char *)".gz", .len = 3}},
+    {{.buf = (char *)"deflate", .len = 7}, {.buf = (char *)".zip", .len = 4}},
+};
+#define FIO___HTTP_STATIC_ENCODINGS_COUNT                                      \
+  (sizeof(FIO___HTTP_STATIC_ENCODINGS) / sizeof(FIO___HTTP_STATIC_ENCODINGS[0]))
+
+/** Returns a static file's `etag` (a `stat` hash, ignoring access time). */
+FIO_SFUNC uint64_t fio___http_stat2etag(struct stat *s) {
+  uint64_t d[6] = {(uint64_t)s->st_dev,
+                   (uint64_t)s->st_ino,
+                   (uint64_t)s->st_mode,
+                   (uint64_t)s->st_size,
+                   (uint64_t)s->st_mtime,
+                   (uint64_t)s->st_ctime};
+  uint64_t r = fio_risky_hash(d, sizeof(d), 0);
+  return r + !r;
+}
+
+/** Sets the response headers for a pre-compressed static file variant. */
+FIO_SFUNC void fio___http_static_encoding_set(fio_http_s *h, size_t i) {
+  fio_http_response_header_set(h,
+                               FIO_STR_INFO2((char *)"vary", 4),
+                               FIO_STR_INFO2((char *)"accept-encoding", 15));
+  fio_http_response_header_set(h,
+                               FIO_STR_INFO2((char *)"content-encoding", 16),
+                               FIO___HTTP_STATIC_ENCODINGS[i].encoding);
+}
+
+#if FIO_HTTP_STATIC_FILE_CACHE_LIMIT
+/* a cached file (or pre-compressed variant) */
+typedef struct {
+  char *body;     /* file data (fio_bstr, shared with pending writes) */
+  char *etag;     /* pre-computed `etag` value, NULL if not cached */
+  char *modified; /* pre-computed `last-modified` value */
+  uint64_t mark;  /* the file's `etag` hash, 0 if missing */
+} fio___http_sfc_file_s;
+
+/* a cache entry, keyed by the requested (unresolved) file name */
+typedef struct {
+  volatile uint32_t ref;
+  int64_t validated; /* last time the files were tested for changes */
+  size_t mem;        /* memory counted against the cache limit */
+  char *path;        /* resolved file name (no encoding extension) */
+  char *mime;        /* `content-type` value (copied, registry may change) */
+  fio___http_sfc_file_s file[FIO___HTTP_STATIC_ENCODINGS_COUNT + 1];
+} fio___http_sfc_s;
+
+FIO_LEAK_COUNTER_DEF(fio___http_sfc_s)
+
+FIO_SFUNC void fio___http_sfc_free(fio___http_sfc_s *e) {
+  if (!e || fio_atomic_sub_fetch(&e->ref, 1))
+    return;
+  for (size_t i = 0; i < FIO___HTTP_STATIC_ENCODINGS_COUNT + 1; ++i) {
+    fio_bstr_free(e->file[i].body);
+    fio_bstr_free(e->file[i].etag);
+    fio_bstr_free(e->file[i].modified);
+  }
+  fio_bstr_free(e->path);
+  fio_bstr_free(e->mime);
+  FIO_LEAK_COUNTER_ON_FREE(fio___http_sfc_s);
+  FIO_MEM_FREE_(e, sizeof(*e));
+}
+
+/* called (under lock) when an entry is removed from the cache */
+FIO_SFUNC void fio___http_sfc_unlink(fio___http_sfc_s *e);
+
+#define FIO___RECURSIVE_INCLUDE  1
+#define FIO_MAP_NAME             fio___http_sfc_map
+#define FIO_MAP_KEY_BSTR         /* the requested file name */
+#define FIO_MAP_VALUE            fio___http_sfc_s *
+#define FIO_MAP_VALUE_DESTROY(o) fio___http_sfc_unlink((o))
+#define FIO_MAP_ORDERED          1 /* evict oldest entries first */
+#include FIO_INCLUDE_FILE
+#undef FIO___RECURSIVE_INCLUDE
+
+static struct {
+  fio___http_sfc_map_s map;
+  size_t mem;
+  FIO___LOCK_TYPE lock;
+} FIO___HTTP_SFC = {.lock = FIO___LOCK_INIT};
+
+FIO_SFUNC void fio___http_sfc_unlink(fio___http_sfc_s *e) {
+  FIO___HTTP_SFC.mem -= e->mem;
+  fio___http_sfc_free(e);
+}
+
+FIO_IFUNC uint64_t fio___http_sfc_hash(fio_str_info_s key) {
+  return fio_risky_hash(key.buf, key.len, (uint64_t)(uintptr_t)&FIO___HTTP_SFC);
+}
+
+/** Returns a file's `etag` hash, or 0 if the file is missing. */
+FIO_SFUNC uint64_t fio___http_sfc_mark(const char *filename) {
+  struct stat stt;
+  if (stat(filename, &stt))
+    return 0;
+  return fio___http_stat2etag(&stt);
+}
+
+/* writes the resolved file name of variant `i` to `dest` (4095 bytes max). */
+FIO_SFUNC fio_str_info_s fio___http_sfc_name(char *dest,
+                                             fio___http_sfc_s *e,
+                                             size_t i) {
+  fio_str_info_s r = FIO_STR_INFO3(dest, 0, 4095);
+  fio_string_write(&r, NULL, e->path, fio_bstr_len(e->path));
+  if (i)
+    fio_string_write(&r,
+                     NULL,
+                     FIO___HTTP_STATIC_ENCODINGS[i - 1].ext.buf,
+                     FIO___HTTP_STATIC_ENCODINGS[i - 1].ext.len);
+  return r;
+}
+
+/** Returns non-zero if any of the files were modified, created or deleted. */
+FIO_SFUNC int fio___http_sfc_changed(fio___http_sfc_s *e) {
+  char buf[4096];
+  for (size_t i = 0; i < FIO___HTTP_STATIC_ENCODINGS_COUNT + 1; ++i) {
+    fio___http_sfc_name(buf, e, i);
+    if (fio___http_sfc_mark(buf) != e->file[i].mark)
+      return 1;
+  }
+  return 0;
+}
+
+/**
+ * Returns a cached entry (reference counted) for the requested file name.
+ *
+ * Entries are revalidated (using `stat`) once every
+ * FIO_HTTP_STATIC_FILE_CACHE_VALIDATE milliseconds and removed if changed.
+ */
+FIO_SFUNC fio___http_sfc_s *fio___http_sfc_get(fio_str_info_s key) {
+  fio___http_sfc_s *e;
+  const uint64_t hash = fio___http_sfc_hash(key);
+  const int64_t now = fio_http_get_timestump();
+  int validate = 0;
+  FIO___LOCK_LOCK(FIO___HTTP_SFC.lock);
+  e = fio___http_sfc_map_get(&FIO___HTTP_SFC.map, hash, key);
+  if (e) {
+    fio_atomic_add(&e->ref, 1);
+    validate = (now - e->validated) >=
+               ((int64_t)FIO_HTTP_STATIC_FILE_CACHE_VALIDATE *
+                (FIO___HTTP_TIME_DIV / 1000));
+    if (validate) /* other threads keep using the entry meanwhile */
+      e->validated = now;
+  }
+  FIO___LOCK_UNLOCK(FIO___HTTP_SFC.lock);
+  if (!validate || !fio___http_sfc_changed(e))
+    return e;
+  FIO_LOG_DDEBUG2("(%d) static file cache: %s changed", fio_io_pid(), e->path);
+  FIO___LOCK_LOCK(FIO___HTTP_SFC.lock);
+  if (fio___http_sfc_map_get(&FIO___HTTP_SFC.map, hash, key) == e)
+    fio___http_sfc_map_remove(&FIO___HTTP_SFC.map, hash, key, NULL);
+  FIO___LOCK_UNLOCK(FIO___HTTP_SFC.lock);
+  fio___http_sfc_free(e);
+  return NULL;
+}
+
+/** Reads a (small) file and pre-computes its header values. */
+FIO_SFUNC int fio___http_sfc_read(fio___http_sfc_file_s *f, const char *name) {
+  struct stat stt;
+  int fd = fio_filename_open(name, O_RDONLY);
+  if (fd == -1)
+    return -1;
+  if (fstat(fd, &stt))
+    goto error;
+  f->mark = fio___http_stat2etag(&stt);
+  if ((stt.st_mode & S_IFMT) != S_IFREG ||
+      (size_t)stt.st_size > FIO_HTTP_STATIC_FILE_CACHE_FILE_MAX)
+    goto error; /* mark is kept, so changes are still detected */
+  if (stt.st_size) {
+    f->body = fio_bstr_reserve(NULL, (size_t)stt.st_size);
+    if (fio_fd_read(fd, f->body, (size_t)stt.st_size, 0) !=
+        (size_t)stt.st_size)
+      goto error;
+    f->body = fio_bstr_len_set(f->body, (size_t)stt.st_size);
+  }
+  {
+    char tmp[64];
+    fio_str_info_s s = FIO_STR_INFO3(tmp, 0, 63);
+    fio_string_write_hex(&s, NULL, f->mark);
+    f->etag = fio_bstr_write(NULL, s.buf, s.len);
+    s.len = fio_time2rfc7231(tmp, stt.st_mtime);
+    f->modified = fio_bstr_write(NULL, s.buf, s.len);
+  }
+  close(fd);
+  return 0;
+error:
+  fio_bstr_free(f->body);
+  f->body = NULL;
+  close(fd);
+  return -1;
+}
+
+/**
+ * Loads the resolved file `path` (and any pre-compressed variants) to the
+ * cache, returning a new reference or NULL if the file can't be cached.
+ */
+FIO_SFUNC fio___http_sfc_s *fio___http_sfc_load(fio_str_info_s key,
+                                                fio_str_info_s path,
+                                                fio_str_info_s mime) {
+  char buf[4096];
+  fio___http_sfc_s *e;
+  if (path.len > 4000)
+    return NULL;
+  e = (fio___http_sfc_s *)FIO_MEM_REALLOC_(NULL, 0, sizeof(*e), 0);
+  if (!e)
+    return NULL;
+  FIO_LEAK_COUNTER_ON_ALLOC(fio___http_sfc_s);
+  *e = (fio___http_sfc_s){
+      .ref = 2, /* one for the cache and one for the caller */
+      .validated = fio_http_get_timestump(),
+      .mem = sizeof(*e) + key.len + path.len + mime.len,
+      .path = fio_bstr_write(NULL, path.buf, path.len),
+      .mime = fio_bstr_write(NULL, mime.buf, mime.len),
+  };
+  for (size_t i = 0; i < FIO___HTTP_STATIC_ENCODINGS_COUNT + 1; ++i) {
+    fio___http_sfc_name(buf, e, i);
+    if (fio___http_sfc_read(e->file + i, buf)) {
+      if (!i)
+        goto too_large;
+      continue;
+    }
+    e->mem += fio_bstr_len(e->file[i].body) + 96; /* + header values */
+  }
+  FIO___LOCK_LOCK(FIO___HTTP_SFC.lock);
+  fio___http_sfc_map_set(&FIO___HTTP_SFC.map,
+                         fio___http_sfc_hash(key),
+                         key,
+                         e,
+                         NULL);
+  FIO___HTTP_SFC.mem += e->mem;
+  while (FIO___HTTP_SFC.mem > FIO_HTTP_STATIC_FILE_CACHE_LIMIT &&
+         fio___http_sfc_map_count(&FIO___HTTP_SFC.map) > 1)
+    fio___http_sfc_map_evict(&FIO___HTTP_SFC.map, 1);
+  FIO___LOCK_UNLOCK(FIO___HTTP_SFC.lock);
+  return e;
+
+too_large:
+  e->ref = 1;
+  fio___http_sfc_free(e);
+  return NULL;
+}
+
+FIO_SFUNC void fio___http_sfc_destroy(void) {
+  FIO___LOCK_LOCK(FIO___HTTP_SFC.lock);
+  fio___http_sfc_map_destroy(&FIO___HTTP_SFC.map);
+  FIO___LOCK_UNLOCK(FIO___HTTP_SFC.lock);
+  FIO___LOCK_DESTROY(FIO___HTTP_SFC.lock);
+}
+#else
+typedef struct fio___http_sfc_s fio___http_sfc_s;
+#define fio___http_sfc_free(e) ((void)(e))
+#endif /* FIO_HTTP_STATIC_FILE_CACHE_LIMIT */
+
 /* *****************************************************************************
 Static file helper
 ***************************************************************************** */
@@ -44378,7 +51999,11 @@ SFUNC int fio_http_static_file_response(fio_http_s *h,
                                         fio_str_info_s fnm,
                                         size_t max_age) {
   int fd = -1;
+  int r = 0;
   size_t file_length = 0;
+  size_t requested_len = 0;
+  char *body = NULL; /* cached file data (if any) */
+  fio___http_sfc_s *cached = NULL;
   /* combine public folder with path to get file name */
   fio_str_info_s mime_type = {0};
   FIO_STR_INFO_TMP_VAR(etag, 31);
@@ -44396,6 +52021,12 @@ SFUNC int fio_http_static_file_response(fio_http_s *h,
   fio_string_write_url_dec(&filename, NULL, fnm.buf, fnm.len);
   if (fio_filename_is_unsafe_url(filename.buf))
     goto file_not_found;
+#if FIO_HTTP_STATIC_FILE_CACHE_LIMIT
+  /* the requested name remains a prefix of `filename` while it's resolved */
+  requested_len = filename.len;
+  if ((cached = fio___http_sfc_get(filename)))
+    goto cached_file;
+#endif
 
   { /* Test for incomplete file name */
     size_t file_type = fio_filename_type(filename.buf);
@@ -44462,6 +52093,12 @@ SFUNC int fio_http_static_file_response(fio_http_s *h,
                         ext);
     }
   }
+#if FIO_HTTP_STATIC_FILE_CACHE_LIMIT
+  if ((cached = fio___http_sfc_load(FIO_STR_INFO2(filename.buf, requested_len),
+                                    filename,
+                                    mime_type)))
+    goto cached_file;
+#endif
   {
     fio_str_info_s ac =
         fio_http_request_header(h,
@@ -44469,30 +52106,19 @@ SFUNC int fio_http_static_file_response(fio_http_s *h,
                                 0);
     if (!ac.len)
       goto accept_encoding_header_test_done;
-    struct {
-      char *value;
-      fio_buf_info_s ext;
-    } options[] = {{(char *)"br", FIO_BUF_INFO2((char *)".br", 3)},
-                   {(char *)"gzip", FIO_BUF_INFO2((char *)".gz", 3)},
-                   {(char *)"deflate", FIO_BUF_INFO2((char *)".zip", 4)},
-                   {NULL}};
-    for (size_t i = 0; options[i].value; ++i) {
-      if (!strstr(ac.buf, options[i].value))
+    for (size_t i = 0; i < FIO___HTTP_STATIC_ENCODINGS_COUNT; ++i) {
+      if (!strstr(ac.buf, FIO___HTTP_STATIC_ENCODINGS[i].encoding.buf))
         continue;
-      fio_string_write(&filename, NULL, options[i].ext.buf, options[i].ext.len);
+      fio_string_write(&filename,
+                       NULL,
+                       FIO___HTTP_STATIC_ENCODINGS[i].ext.buf,
+                       FIO___HTTP_STATIC_ENCODINGS[i].ext.len);
       if (!fio_filename_type(filename.buf)) {
-        filename.len -= options[i].ext.len;
+        filename.len -= FIO___HTTP_STATIC_ENCODINGS[i].ext.len;
         filename.buf[filename.len] = 0;
         continue;
       }
-      fio_http_response_header_set(
-          h,
-          FIO_STR_INFO2((char *)"vary", 4),
-          FIO_STR_INFO2((char *)"accept-encoding", 15));
-      fio_http_response_header_set(
-          h,
-          FIO_STR_INFO2((char *)"content-encoding", 16),
-          FIO_STR_INFO1(options[i].value));
+      fio___http_static_encoding_set(h, i);
       break;
     }
   }
@@ -44507,29 +52133,32 @@ accept_encoding_header_test_done:
     struct stat stt;
     if (fstat(fd, &stt))
       goto file_not_found;
-    uint64_t etag_hash = fio_risky_hash(&stt, sizeof(stt), 0);
-    fio_string_write_hex(&etag, NULL, etag_hash);
+    fio_string_write_hex(&etag, NULL, fio___http_stat2etag(&stt));
     fio_http_response_header_set(h, FIO_STR_INFO2((char *)"etag", 4), etag);
     filename.len = 0;
     filename.len = fio_time2rfc7231(filename.buf, stt.st_mtime);
     fio_http_response_header_set(h,
                                  FIO_STR_INFO1((char *)"last-modified"),
                                  filename);
-    if (max_age) {
-      filename.len = 0;
-      fio_string_write2(&filename,
-                        NULL,
-                        FIO_STRING_WRITE_STR2("max-age=", 8),
-                        FIO_STRING_WRITE_UNUM(max_age));
-      fio_http_response_header_set(h,
-                                   FIO_STR_INFO1((char *)"cache-control"),
-                                   filename);
-    }
     file_length = stt.st_size;
-    filename.capa = 0;
-    if (fio___http_response_etag_if_none_match(h))
-      return 0;
   }
+
+#if FIO_HTTP_STATIC_FILE_CACHE_LIMIT
+file_headers_set: /* cached files skip the file system */
+#endif
+  if (max_age) {
+    filename.len = 0;
+    fio_string_write2(&filename,
+                      NULL,
+                      FIO_STRING_WRITE_STR2("max-age=", 8),
+                      FIO_STRING_WRITE_UNUM(max_age));
+    fio_http_response_header_set(h,
+                                 FIO_STR_INFO1((char *)"cache-control"),
+                                 filename);
+  }
+  filename.capa = 0;
+  if (fio___http_response_etag_if_none_match(h))
+    goto finish;
   /* test for range requests. */
   {
     /* test / validate range requests */
@@ -44606,30 +52235,64 @@ range_request_review_finished:
     fio_http_response_header_set(h,
                                  FIO_STR_INFO2((char *)"content-type", 12),
                                  mime_type);
-  { /* send response (avoid macro for C++ compatibility) */
+  if (body) { /* send cached data (avoid macro for C++ compatibility) */
+    fio_http_write_args_s args = {
+        .buf = body,
+        .len = file_length,
+        .offset = filename.capa, /* now holds starting offset */
+        .dealloc = (void (*)(void *))fio_bstr_free,
+        .finish = 1};
+    body = NULL; /* ownership moved to the writer */
+    fio_http_write FIO_NOOP(h, args);
+  } else { /* send response (avoid macro for C++ compatibility) */
     fio_http_write_args_s args = {
         .len = file_length,
         .offset = filename.capa, /* now holds starting offset */
         .fd = fd,
         .finish = 1};
+    fd = -1; /* the file is always closed by the writer */
     fio_http_write FIO_NOOP(h, args);
   }
-  return 0;
+  goto finish;
+
+#if FIO_HTTP_STATIC_FILE_CACHE_LIMIT
+cached_file: { /* headers were pre-computed, no file system access required */
+  fio___http_sfc_file_s *f = cached->file;
+  fio_str_info_s ac =
+      fio_http_request_header(h,
+                              FIO_STR_INFO2((char *)"accept-encoding", 15),
+                              0);
+  for (size_t i = 0; ac.len && i < FIO___HTTP_STATIC_ENCODINGS_COUNT; ++i) {
+    if (!cached->file[i + 1].etag ||
+        !strstr(ac.buf, FIO___HTTP_STATIC_ENCODINGS[i].encoding.buf))
+      continue;
+    f = cached->file + i + 1;
+    fio___http_static_encoding_set(h, i);
+    break;
+  }
+  fio_string_write(&etag, NULL, f->etag, fio_bstr_len(f->etag));
+  fio_http_response_header_set(h, FIO_STR_INFO2((char *)"etag", 4), etag);
+  fio_http_response_header_set(h,
+                               FIO_STR_INFO1((char *)"last-modified"),
+                               fio_bstr_info(f->modified));
+  mime_type = fio_bstr_info(cached->mime);
+  body = fio_bstr_copy(f->body);
+  file_length = fio_bstr_len(f->body);
+  goto file_headers_set;
+}
+#endif /* FIO_HTTP_STATIC_FILE_CACHE_LIMIT */
 
 file_not_found:
-  if (fd != -1)
-    close(fd);
-  return -1;
+  r = -1;
+  goto finish;
 
 head_request:
   /* TODO! HEAD responses should close?. */
-  if (fd != -1)
-    close(fd);
   {
     fio_http_write_args_s args = {.finish = 1};
     fio_http_write FIO_NOOP(h, args);
   }
-  return 0;
+  goto finish;
 
 invalid_range:
   filename.len = 0;
@@ -44641,7 +52304,15 @@ invalid_range:
   fio_http_response_header_set(h,
                                FIO_STR_INFO2((char *)"content-range", 13),
                                filename);
-  return fio_http_send_error_response(h, 416);
+  r = fio_http_send_error_response(h, 416);
+
+finish:
+  if (fd != -1)
+    close(fd);
+  fio_bstr_free(body);
+  fio___http_sfc_free(cached);
+  return r;
+  (void)requested_len; /* if unused */
 }
 
 /* *****************************************************************************
@@ -44946,6 +52617,14 @@ Constructor / Destructor
 
 FIO_SFUNC void fio___http_cleanup(void *ignr_) {
   (void)ignr_;
+  fio___http_log_destroy();
+#if FIO_HTTP_STATIC_FILE_CACHE_LIMIT
+  FIO_LOG_DEBUG2("(%d) freeing %zu static files (%zu bytes) from cache",
+                 fio_getpid(),
+                 (size_t)fio___http_sfc_map_count(&FIO___HTTP_SFC.map),
+                 FIO___HTTP_SFC.mem);
+  fio___http_sfc_destroy();
+#endif
 #if FIO_HTTP_CACHE_LIMIT
   for (size_t i = 0; i < 2; ++i) {
     const char *names[] = {"cookie names", "header values"};
@@ -44977,6 +52656,7 @@ FIO_SFUNC void fio___http_cleanup(void *ignr_) {
 
 FIO_CONSTRUCTOR(fio___http_str_cache_static_builder) {
   fio___http_str_cached_init();
+  fio___http_log_init();
   fio_state_callback_add(FIO_CALL_AT_EXIT, fio___http_cleanup, NULL);
   fio_http_mime_register_essential();
 }
@@ -44994,6 +52674,829 @@ Cleanup
 /* ************************************************************************* */
 #if !defined(FIO_INCLUDE_FILE) /* Dev test - ignore line */
 #define FIO___DEV___           /* Development inclusion - ignore line */
+#define FIO_HTTP_ROUTER        /* Development inclusion - ignore line */
+#include "./include.h"         /* Development inclusion - ignore line */
+#endif                         /* Development inclusion - ignore line */
+/* *****************************************************************************
+
+
+
+
+                      HTTP Request Router (Radix Tree)
+
+
+
+
+Copyright and License: see header file (000 copyright.h) or top of file
+***************************************************************************** */
+#if defined(FIO_HTTP_ROUTER) && !defined(H___FIO_HTTP_ROUTER___H) &&           \
+    defined(H___FIO_HTTP_HANDLE___H) && !defined(FIO___RECURSIVE_INCLUDE)
+#define H___FIO_HTTP_ROUTER___H
+
+/* *****************************************************************************
+HTTP Router Settings
+***************************************************************************** */
+
+#ifndef FIO_HTTP_ROUTER_MAX_PARAMS
+/** The maximum number of path parameters (and wildcards) per route. */
+#define FIO_HTTP_ROUTER_MAX_PARAMS 16
+#endif
+
+/* *****************************************************************************
+HTTP Router API
+***************************************************************************** */
+
+/** The HTTP Router type. */
+typedef struct fio_http_router_s fio_http_router_s;
+
+/** A matched route, as passed to the route's handler. */
+typedef struct fio_http_route_s {
+  /** The route's handler. */
+  void (*on_http)(fio_http_s *h, struct fio_http_route_s *route);
+  /** The opaque user data set for the route. */
+  void *udata;
+  /** The number of path parameters captured. */
+  size_t count;
+  /** Path parameters - values point into the request's path (no copies). */
+  struct {
+    /** The parameter's name (as set in the route's pattern). */
+    fio_str_info_s name;
+    /** The parameter's value (a slice of the request's path). */
+    fio_str_info_s value;
+  } param[FIO_HTTP_ROUTER_MAX_PARAMS];
+} fio_http_route_s;
+
+/** HTTP Router settings (see `fio_http_router_new`). */
+typedef struct {
+  /** Called when no route matches the request (defaults to a 404 response). */
+  void (*on_not_found)(fio_http_s *h);
+  /**
+   * A public folder for static files, tested when no route matches the
+   * request (and before `on_not_found`).
+   *
+   * Note: the `public_folder` in the HTTP settings is tested before routing.
+   */
+  fio_str_info_s public_folder;
+  /** The max-age value (in seconds) for static files (`public_folder`). */
+  size_t max_age;
+} fio_http_router_settings_s;
+
+/** Creates a new HTTP Router. */
+SFUNC fio_http_router_s *fio_http_router_new(fio_http_router_settings_s);
+/** Creates a new HTTP Router. */
+#define fio_http_router_new(...)                                               \
+  fio_http_router_new((fio_http_router_settings_s){__VA_ARGS__})
+
+/** Frees an HTTP Router. */
+SFUNC void fio_http_router_free(fio_http_router_s *router);
+
+/** Named arguments for `fio_http_route`. */
+typedef struct {
+  /**
+   * The route's pattern, i.e., `"/users/:id"`.
+   *
+   * Segments starting with `:` are named parameters (matching a single, non
+   * empty, path segment). A final segment starting with `*` (i.e., `*path`)
+   * is a wildcard (matching the rest of the path, if any).
+   *
+   * Static segments are preferred over parameters, and parameters are
+   * preferred over wildcards.
+   */
+  const char *path;
+  /** The HTTP method for the route (i.e. `"GET"`). NULL == any method. */
+  const char *method;
+  /** The route's handler. */
+  void (*on_http)(fio_http_s *h, fio_http_route_s *route);
+  /** Opaque user data for the handler. */
+  void *udata;
+} fio_http_route_args_s;
+
+/**
+ * Adds a route to the router, returning -1 on error (invalid pattern).
+ *
+ * Routing a method and path that were already routed replaces the handler.
+ *
+ * Note: routes should be added before the router is used (not thread safe).
+ */
+SFUNC int fio_http_route(fio_http_router_s *router, fio_http_route_args_s args);
+/** Adds a route to the router, returning -1 on error (invalid pattern). */
+#define fio_http_route(router, ...)                                            \
+  fio_http_route((router), (fio_http_route_args_s){__VA_ARGS__})
+
+/**
+ * Finds the route for the `method` and `path`, filling in `route`.
+ *
+ * Returns 0 on success, 404 if no route matches the path and 405 if the path
+ * matched but no handler was set for the method.
+ */
+SFUNC int fio_http_router_find(fio_http_router_s *router,
+                               fio_http_route_s *route,
+                               fio_str_info_s method,
+                               fio_str_info_s path);
+
+/**
+ * Routes the HTTP request using the router, calling the route's handler.
+ *
+ * Returns 0 on success, or the same error values as `fio_http_router_find`,
+ * in which case nothing is done (no response is sent).
+ */
+SFUNC int fio_http_router_dispatch(fio_http_router_s *router, fio_http_s *h);
+
+/**
+ * An `on_http` callback that routes requests using the router set as the
+ * HTTP handle's user data (`fio_http_udata`).
+ *
+ * i.e.: `fio_http_listen(url, .on_http = fio_http_router_on_http, .udata = r)`
+ *
+ * If no route matched, tests for a static file (`public_folder`) and calls the
+ * router's `on_not_found` callback (or sends a 404 / 405 error response).
+ */
+SFUNC void fio_http_router_on_http(fio_http_s *h);
+
+/** Returns the value of the named path parameter (or an empty string). */
+FIO_IFUNC fio_str_info_s fio_http_route_param(fio_http_route_s *route,
+                                              fio_str_info_s name);
+
+/* *****************************************************************************
+HTTP Router - inlined static functions
+***************************************************************************** */
+
+/** Returns the value of the named path parameter (or an empty string). */
+FIO_IFUNC fio_str_info_s fio_http_route_param(fio_http_route_s *route,
+                                              fio_str_info_s name) {
+  fio_str_info_s r = {0};
+  for (size_t i = 0; i < route->count; ++i)
+    if (FIO_STR_INFO_IS_EQ(route->param[i].name, name))
+      return route->param[i].value;
+  return r;
+}
+
+/* *****************************************************************************
+Implementation - possibly externed functions.
+***************************************************************************** */
+#if defined(FIO_EXTERN_COMPLETE) || !defined(FIO_EXTERN)
+
+/*
+REMEMBER:
+========
+
+All memory allocations should use:
+* FIO_MEM_REALLOC_(ptr, old_size, new_size, copy_len)
+* FIO_MEM_FREE_(ptr, size)
+
+*/
+
+/* *****************************************************************************
+Router Types
+
+Routes are added to a (mutable) radix tree, which is compiled on first use to a
+compact, read only, array of nodes sharing a single string pool.
+
+In the compiled tree, the static children of a node are stored consecutively
+(sorted by their first byte) and their first bytes are stored consecutively in
+the string pool, so a child is found using a single `memchr`.
+***************************************************************************** */
+
+typedef void (*fio___http_route_fn)(fio_http_s *, fio_http_route_s *);
+
+/* a route's handler for a specific method */
+typedef struct {
+  char *method; /* NULL == any method (a fio_bstr while building) */
+  fio___http_route_fn on_http;
+  void *udata;
+} fio___http_router_handler_s;
+
+/* a node in the (mutable) radix tree */
+typedef struct fio___http_router_tnode_s {
+  struct fio___http_router_tnode_s **children;
+  struct fio___http_router_tnode_s *param;
+  struct fio___http_router_tnode_s *wildcard;
+  fio___http_router_handler_s *handlers;
+  char *prefix; /* fio_bstr (static nodes) */
+  char *name;   /* fio_bstr (parameter / wildcard nodes) */
+  uint32_t children_len;
+  uint32_t handlers_len;
+} fio___http_router_tnode_s;
+
+/* a node in the compiled radix tree (offsets are into the string pool) */
+typedef struct {
+  uint32_t prefix;
+  uint32_t prefix_len;
+  uint32_t chars; /* the first byte of each static child */
+  uint32_t children;
+  uint32_t children_len;
+  uint32_t param;    /* 0 == none (the root is never a child) */
+  uint32_t wildcard; /* 0 == none */
+  uint32_t name;
+  uint32_t name_len;
+  uint32_t handlers;
+  uint32_t handlers_len;
+} fio___http_router_node_s;
+
+/* a handler in the compiled radix tree (offsets are into the string pool) */
+typedef struct {
+  uint32_t method;
+  uint32_t method_len; /* 0 == any method */
+  fio___http_route_fn on_http;
+  void *udata;
+} fio___http_router_chandler_s;
+
+struct fio_http_router_s {
+  fio_http_router_settings_s settings;
+  fio___http_router_tnode_s root;
+  /* the compiled tree */
+  fio___http_router_node_s *nodes;
+  fio___http_router_chandler_s *handlers;
+  char *pool;
+  size_t nodes_len;
+  size_t handlers_len;
+  size_t pool_len;
+  fio_lock_i lock;
+  uint8_t compiled;
+  char public_folder[];
+};
+
+FIO_LEAK_COUNTER_DEF(fio_http_router_s)
+
+/* *****************************************************************************
+Router - Building the Tree
+***************************************************************************** */
+
+FIO_SFUNC fio___http_router_tnode_s *fio___http_router_tnode_new(void) {
+  fio___http_router_tnode_s *n = (fio___http_router_tnode_s *)FIO_MEM_REALLOC_(
+      NULL,
+      0,
+      sizeof(*n),
+      0);
+  if (n)
+    *n = (fio___http_router_tnode_s){0};
+  return n;
+}
+
+FIO_SFUNC void fio___http_router_tnode_destroy(fio___http_router_tnode_s *n) {
+  for (size_t i = 0; i < n->children_len; ++i) {
+    fio___http_router_tnode_destroy(n->children[i]);
+    FIO_MEM_FREE_(n->children[i], sizeof(*n->children[i]));
+  }
+  FIO_MEM_FREE_(n->children, sizeof(*n->children) * n->children_len);
+  if (n->param) {
+    fio___http_router_tnode_destroy(n->param);
+    FIO_MEM_FREE_(n->param, sizeof(*n->param));
+  }
+  if (n->wildcard) {
+    fio___http_router_tnode_destroy(n->wildcard);
+    FIO_MEM_FREE_(n->wildcard, sizeof(*n->wildcard));
+  }
+  for (size_t i = 0; i < n->handlers_len; ++i)
+    fio_bstr_free(n->handlers[i].method);
+  FIO_MEM_FREE_(n->handlers, sizeof(*n->handlers) * n->handlers_len);
+  fio_bstr_free(n->prefix);
+  fio_bstr_free(n->name);
+  *n = (fio___http_router_tnode_s){0};
+}
+
+/* adds a static child node with `prefix`, returns NULL on error. */
+FIO_SFUNC fio___http_router_tnode_s *fio___http_router_tnode_child(
+    fio___http_router_tnode_s *n,
+    const char *prefix,
+    size_t len) {
+  fio___http_router_tnode_s *c = fio___http_router_tnode_new();
+  fio___http_router_tnode_s **tmp;
+  if (!c)
+    return c;
+  tmp = (fio___http_router_tnode_s **)FIO_MEM_REALLOC_(
+      n->children,
+      sizeof(*tmp) * n->children_len,
+      sizeof(*tmp) * (n->children_len + 1),
+      sizeof(*tmp) * n->children_len);
+  if (!tmp) {
+    FIO_MEM_FREE_(c, sizeof(*c));
+    return NULL;
+  }
+  n->children = tmp;
+  n->children[n->children_len++] = c;
+  c->prefix = fio_bstr_write(NULL, prefix, len);
+  return c;
+}
+
+/* splits a static node's prefix at `at` (the node keeps the prefix's head). */
+FIO_SFUNC int fio___http_router_tnode_split(fio___http_router_tnode_s *n,
+                                            size_t at) {
+  fio___http_router_tnode_s *tail = fio___http_router_tnode_new();
+  fio___http_router_tnode_s **children =
+      (fio___http_router_tnode_s **)FIO_MEM_REALLOC_(NULL,
+                                                     0,
+                                                     sizeof(*children),
+                                                     0);
+  char *prefix = n->prefix;
+  if (!tail || !children) {
+    FIO_MEM_FREE_(tail, sizeof(*tail));
+    FIO_MEM_FREE_(children, sizeof(*children));
+    return -1;
+  }
+  *tail = *n; /* the tail inherits the children and handlers */
+  tail->prefix = fio_bstr_write(NULL, prefix + at, fio_bstr_len(prefix) - at);
+  *n = (fio___http_router_tnode_s){0};
+  n->prefix = fio_bstr_write(NULL, prefix, at);
+  n->children = children;
+  n->children[0] = tail;
+  n->children_len = 1;
+  fio_bstr_free(prefix);
+  return 0;
+}
+
+/* adds the static part of a route to the tree, returns the last node. */
+FIO_SFUNC fio___http_router_tnode_s *fio___http_router_tnode_add(
+    fio___http_router_tnode_s *n,
+    const char *run,
+    size_t len) {
+  while (len) {
+    fio___http_router_tnode_s *child = NULL;
+    size_t common = 0, prefix_len;
+    for (size_t i = 0; i < n->children_len; ++i) {
+      if (n->children[i]->prefix[0] != run[0])
+        continue;
+      child = n->children[i];
+      break;
+    }
+    if (!child)
+      return fio___http_router_tnode_child(n, run, len);
+    prefix_len = fio_bstr_len(child->prefix);
+    while (common < prefix_len && common < len &&
+           child->prefix[common] == run[common])
+      ++common;
+    if (common < prefix_len && fio___http_router_tnode_split(child, common))
+      return NULL;
+    n = child;
+    run += common;
+    len -= common;
+  }
+  return n;
+}
+
+/* returns a parameter / wildcard node with the `name`, creating if missing. */
+FIO_SFUNC fio___http_router_tnode_s *fio___http_router_tnode_named(
+    fio___http_router_tnode_s **pn,
+    const char *name,
+    size_t len) {
+  if (!pn[0]) {
+    if (!(pn[0] = fio___http_router_tnode_new()))
+      return NULL;
+    pn[0]->name = fio_bstr_write(NULL, name, len);
+    return pn[0];
+  }
+  if (fio_bstr_len(pn[0]->name) != len || FIO_MEMCMP(pn[0]->name, name, len))
+    return NULL; /* a parameter can't have two names */
+  return pn[0];
+}
+
+/* frees the compiled tree (it's recompiled once routing begins). */
+FIO_SFUNC void fio___http_router_compiled_free(fio_http_router_s *r) {
+  FIO_MEM_FREE_(r->nodes, sizeof(*r->nodes) * r->nodes_len);
+  FIO_MEM_FREE_(r->handlers, sizeof(*r->handlers) * r->handlers_len);
+  FIO_MEM_FREE_(r->pool, r->pool_len + 1);
+  r->nodes = NULL;
+  r->handlers = NULL;
+  r->pool = NULL;
+  r->nodes_len = r->handlers_len = r->pool_len = 0;
+  fio_atomic_exchange(&r->compiled, 0);
+}
+
+/* Adds a route to the router, returning -1 on error (invalid pattern). */
+SFUNC int fio_http_route FIO_NOOP(fio_http_router_s *r,
+                                  fio_http_route_args_s args) {
+  fio___http_router_tnode_s *n;
+  fio___http_router_handler_s *tmp;
+  const char *pos, *end;
+  size_t params = 0;
+  if (!r || !args.path || !args.on_http)
+    goto invalid;
+  n = &r->root;
+  pos = args.path;
+  end = pos + strlen(pos);
+  while (pos < end) {
+    const char *start = pos;
+    if ((pos[0] == ':' || pos[0] == '*') &&
+        (pos == args.path || pos[-1] == '/')) { /* parameter / wildcard */
+      ++start;
+      while (pos < end && *pos != '/')
+        ++pos;
+      if (++params > FIO_HTTP_ROUTER_MAX_PARAMS)
+        goto invalid;
+      if (start[-1] == '*') {
+        if (pos != end)
+          goto invalid; /* a wildcard must be the last segment */
+        n = fio___http_router_tnode_named(&n->wildcard,
+                                          start,
+                                          (size_t)(pos - start));
+      } else {
+        if (pos == start)
+          goto invalid; /* a parameter must be named */
+        n = fio___http_router_tnode_named(&n->param,
+                                          start,
+                                          (size_t)(pos - start));
+      }
+      if (!n)
+        goto invalid;
+      continue;
+    }
+    /* a static run, up to (and including) the `/` before the next parameter */
+    while (pos < end && !(pos[0] == '/' && (pos[1] == ':' || pos[1] == '*')))
+      ++pos;
+    pos += (pos < end);
+    if (!(n = fio___http_router_tnode_add(n, start, (size_t)(pos - start))))
+      goto invalid;
+  }
+  fio___http_router_compiled_free(r);
+  for (size_t i = 0; i < n->handlers_len; ++i) { /* replace existing? */
+    if (!n->handlers[i].method != !args.method ||
+        (args.method && strcmp(n->handlers[i].method, args.method)))
+      continue;
+    n->handlers[i].on_http = args.on_http;
+    n->handlers[i].udata = args.udata;
+    return 0;
+  }
+  tmp = (fio___http_router_handler_s *)FIO_MEM_REALLOC_(
+      n->handlers,
+      sizeof(*tmp) * n->handlers_len,
+      sizeof(*tmp) * (n->handlers_len + 1),
+      sizeof(*tmp) * n->handlers_len);
+  if (!tmp)
+    goto invalid;
+  n->handlers = tmp;
+  n->handlers[n->handlers_len++] = (fio___http_router_handler_s){
+      .method = (args.method
+                     ? fio_bstr_write(NULL, args.method, strlen(args.method))
+                     : NULL),
+      .on_http = args.on_http,
+      .udata = args.udata,
+  };
+  return 0;
+
+invalid:
+  FIO_LOG_ERROR("(http router) couldn't add route: %s %s",
+                (args.method ? args.method : "*"),
+                (args.path ? args.path : "(NULL)"));
+  return -1;
+}
+
+/* *****************************************************************************
+Router - Compiling the Tree
+***************************************************************************** */
+
+/* counts the nodes, handlers and string pool length required for a tree. */
+FIO_SFUNC void fio___http_router_tnode_count(fio___http_router_tnode_s *n,
+                                             size_t *nodes,
+                                             size_t *handlers,
+                                             size_t *pool) {
+  ++nodes[0];
+  handlers[0] += n->handlers_len;
+  pool[0] += fio_bstr_len(n->prefix) + fio_bstr_len(n->name) + n->children_len;
+  for (size_t i = 0; i < n->handlers_len; ++i)
+    pool[0] += fio_bstr_len(n->handlers[i].method);
+  for (size_t i = 0; i < n->children_len; ++i)
+    fio___http_router_tnode_count(n->children[i], nodes, handlers, pool);
+  if (n->param)
+    fio___http_router_tnode_count(n->param, nodes, handlers, pool);
+  if (n->wildcard)
+    fio___http_router_tnode_count(n->wildcard, nodes, handlers, pool);
+}
+
+/* copies a fio_bstr to the string pool, returning its offset. */
+FIO_IFUNC uint32_t fio___http_router_pool_write(fio_http_router_s *r,
+                                                const char *bstr) {
+  uint32_t offset = (uint32_t)r->pool_len;
+  size_t len = fio_bstr_len(bstr);
+  if (len)
+    FIO_MEMCPY(r->pool + offset, bstr, len);
+  r->pool_len += len;
+  return offset;
+}
+
+/* compiles the tree into consecutive arrays (breadth first). */
+FIO_SFUNC int fio___http_router_compile(fio_http_router_s *r) {
+  size_t nodes_len = 0, handlers_len = 0, pool_len = 0, next = 1;
+  fio___http_router_tnode_s **map;
+  fio___http_router_tnode_count(&r->root, &nodes_len, &handlers_len, &pool_len);
+  map = (fio___http_router_tnode_s **)
+      FIO_MEM_REALLOC_(NULL, 0, sizeof(*map) * nodes_len, 0);
+  r->nodes = (fio___http_router_node_s *)
+      FIO_MEM_REALLOC_(NULL, 0, sizeof(*r->nodes) * nodes_len, 0);
+  r->handlers = (fio___http_router_chandler_s *)
+      FIO_MEM_REALLOC_(NULL, 0, sizeof(*r->handlers) * (handlers_len + 1), 0);
+  r->pool = (char *)FIO_MEM_REALLOC_(NULL, 0, pool_len + 1, 0);
+  r->nodes_len = nodes_len;
+  r->handlers_len = handlers_len + 1;
+  r->pool_len = pool_len;
+  if (!map || !r->nodes || !r->handlers || !r->pool) {
+    FIO_MEM_FREE_(map, sizeof(*map) * nodes_len);
+    fio___http_router_compiled_free(r);
+    return -1;
+  }
+  r->handlers_len = r->pool_len = 0;
+  map[0] = &r->root;
+  for (size_t i = 0; i < next; ++i) {
+    fio___http_router_tnode_s *t = map[i];
+    fio___http_router_node_s *n = r->nodes + i;
+    uint32_t prefix, name;
+    /* sort static children by their first byte (insertion sort) */
+    for (size_t j = 1; j < t->children_len; ++j) {
+      fio___http_router_tnode_s *c = t->children[j];
+      const uint8_t first = (uint8_t)c->prefix[0];
+      size_t k = j;
+      for (; k && (uint8_t)t->children[k - 1]->prefix[0] > first; --k)
+        t->children[k] = t->children[k - 1];
+      t->children[k] = c;
+    }
+    /* initializer evaluation order is unspecified, so write strings first */
+    prefix = fio___http_router_pool_write(r, t->prefix);
+    name = fio___http_router_pool_write(r, t->name);
+    *n = (fio___http_router_node_s){
+        .prefix = prefix,
+        .prefix_len = (uint32_t)fio_bstr_len(t->prefix),
+        .name = name,
+        .name_len = (uint32_t)fio_bstr_len(t->name),
+        .chars = (uint32_t)r->pool_len,
+        .children = (uint32_t)next,
+        .children_len = t->children_len,
+        .handlers = (uint32_t)r->handlers_len,
+        .handlers_len = t->handlers_len,
+    };
+    for (size_t j = 0; j < t->children_len; ++j) {
+      r->pool[r->pool_len++] = t->children[j]->prefix[0];
+      map[next++] = t->children[j];
+    }
+    if (t->param) {
+      n->param = (uint32_t)next;
+      map[next++] = t->param;
+    }
+    if (t->wildcard) {
+      n->wildcard = (uint32_t)next;
+      map[next++] = t->wildcard;
+    }
+    for (size_t j = 0; j < t->handlers_len; ++j) {
+      r->handlers[r->handlers_len++] = (fio___http_router_chandler_s){
+          .method = fio___http_router_pool_write(r, t->handlers[j].method),
+          .method_len = (uint32_t)fio_bstr_len(t->handlers[j].method),
+          .on_http = t->handlers[j].on_http,
+          .udata = t->handlers[j].udata,
+      };
+    }
+  }
+  r->handlers_len = handlers_len + 1; /* the allocated length */
+  r->pool[r->pool_len] = 0;
+  FIO_MEM_FREE_(map, sizeof(*map) * nodes_len);
+  return 0;
+}
+
+/* *****************************************************************************
+Router - Matching
+***************************************************************************** */
+
+/* adds a parameter to the route, returns -1 if there's no more room. */
+FIO_IFUNC int fio___http_router_capture(fio_http_router_s *r,
+                                        fio_http_route_s *route,
+                                        const fio___http_router_node_s *n,
+                                        const char *value,
+                                        size_t len) {
+  if (route->count == FIO_HTTP_ROUTER_MAX_PARAMS)
+    return -1;
+  route->param[route->count].name =
+      FIO_STR_INFO2(r->pool + n->name, n->name_len);
+  route->param[route->count].value = FIO_STR_INFO2((char *)value, len);
+  ++route->count;
+  return 0;
+}
+
+/* the state of a single lookup. */
+typedef struct {
+  fio_http_router_s *r;
+  fio_http_route_s *route;
+  fio_str_info_s method;
+  const char *path;
+  size_t len;
+  /* set if the path matched a route that doesn't accept the method */
+  int not_allowed;
+} fio___http_router_lookup_s;
+
+/* selects the node's handler for the method (NULL if not allowed). */
+FIO_SFUNC const fio___http_router_chandler_s *fio___http_router_handler(
+    fio___http_router_lookup_s *l,
+    const fio___http_router_node_s *n) {
+  const fio___http_router_chandler_s *h = l->r->handlers + n->handlers;
+  const fio___http_router_chandler_s *end = h + n->handlers_len;
+  const fio___http_router_chandler_s *any = NULL, *get = NULL;
+  for (; h < end; ++h) {
+    if (!h->method_len) {
+      any = h;
+      continue;
+    }
+    if (h->method_len == l->method.len &&
+        !FIO_MEMCMP(l->r->pool + h->method, l->method.buf, l->method.len))
+      return h;
+    if (h->method_len == 3 && !FIO_MEMCMP(l->r->pool + h->method, "GET", 3))
+      get = h;
+  }
+  /* HEAD requests are routed to GET handlers (unless routed explicitly) */
+  if (get && l->method.len == 4 && !FIO_MEMCMP(l->method.buf, "HEAD", 4))
+    return get;
+  l->not_allowed |= !any;
+  return any;
+}
+
+/* finds the handler matching the path (static > parameter > wildcard). */
+FIO_SFUNC const fio___http_router_chandler_s *fio___http_router_match(
+    fio___http_router_lookup_s *l,
+    const fio___http_router_node_s *n,
+    size_t pos) {
+  fio_http_router_s *r = l->r;
+  for (;;) {
+    const fio___http_router_node_s *next = NULL;
+    const fio___http_router_chandler_s *found = NULL;
+    const size_t count = l->route->count;
+    if (n->prefix_len) {
+      if (l->len - pos < n->prefix_len ||
+          FIO_MEMCMP(l->path + pos, r->pool + n->prefix, n->prefix_len))
+        return NULL;
+      pos += n->prefix_len;
+    }
+    if (pos == l->len) {
+      if (n->handlers_len && (found = fio___http_router_handler(l, n)))
+        return found;
+      if (!n->wildcard)
+        return NULL;
+      n = r->nodes + n->wildcard; /* a wildcard may match an empty path */
+      if (!n->handlers_len ||
+          fio___http_router_capture(r, l->route, n, l->path + pos, 0) ||
+          !(found = fio___http_router_handler(l, n)))
+        l->route->count = count;
+      return found;
+    }
+    if (n->children_len) {
+      const char *c = (const char *)
+          FIO_MEMCHR(r->pool + n->chars, l->path[pos], n->children_len);
+      if (c)
+        next = r->nodes + n->children + (size_t)(c - (r->pool + n->chars));
+    }
+    if (!(n->param | n->wildcard)) { /* no alternatives, no need to recurse */
+      if (!next)
+        return NULL;
+      n = next;
+      continue;
+    }
+    if (next && (found = fio___http_router_match(l, next, pos)))
+      return found;
+    l->route->count = count;
+    if (n->param) {
+      const fio___http_router_node_s *p = r->nodes + n->param;
+      const char *e =
+          (const char *)FIO_MEMCHR(l->path + pos, '/', l->len - pos);
+      size_t seg_end = e ? (size_t)(e - l->path) : l->len;
+      if (seg_end > pos &&
+          !fio___http_router_capture(r,
+                                     l->route,
+                                     p,
+                                     l->path + pos,
+                                     seg_end - pos) &&
+          (found = fio___http_router_match(l, p, seg_end)))
+        return found;
+      l->route->count = count;
+    }
+    if (n->wildcard) {
+      const fio___http_router_node_s *w = r->nodes + n->wildcard;
+      if (w->handlers_len &&
+          !fio___http_router_capture(r,
+                                     l->route,
+                                     w,
+                                     l->path + pos,
+                                     l->len - pos) &&
+          (found = fio___http_router_handler(l, w)))
+        return found;
+      l->route->count = count;
+    }
+    return NULL;
+  }
+}
+
+/* Finds the route for the `method` and `path`, filling in `route`. */
+SFUNC int fio_http_router_find(fio_http_router_s *r,
+                               fio_http_route_s *route,
+                               fio_str_info_s method,
+                               fio_str_info_s path) {
+  const fio___http_router_chandler_s *h;
+  uint8_t compiled;
+  fio___http_router_lookup_s l = {
+      .r = r,
+      .route = route,
+      .method = method,
+      .path = path.buf,
+      .len = path.len,
+  };
+  route->on_http = NULL;
+  route->udata = NULL;
+  route->count = 0;
+  if (!r)
+    return 404;
+  fio_atomic_load(compiled, &r->compiled);
+  if (FIO_UNLIKELY(!compiled)) {
+    /* the tree is published (atomic store) only once fully compiled */
+    fio_lock(&r->lock);
+    if (!r->compiled && !fio___http_router_compile(r))
+      fio_atomic_exchange(&r->compiled, 1);
+    fio_unlock(&r->lock);
+    fio_atomic_load(compiled, &r->compiled);
+    if (!compiled)
+      return 404;
+  }
+  h = fio___http_router_match(&l, r->nodes, 0);
+  if (!h)
+    return (l.not_allowed ? 405 : 404);
+  route->on_http = h->on_http;
+  route->udata = h->udata;
+  return 0;
+}
+
+/* Routes the HTTP request using the router, calling the route's handler. */
+SFUNC int fio_http_router_dispatch(fio_http_router_s *r, fio_http_s *h) {
+  fio_http_route_s route;
+  int result =
+      fio_http_router_find(r, &route, fio_http_method(h), fio_http_path(h));
+  if (!result)
+    route.on_http(h, &route);
+  return result;
+}
+
+/* An `on_http` callback that routes requests using `fio_http_udata`. */
+SFUNC void fio_http_router_on_http(fio_http_s *h) {
+  fio_http_router_s *r = (fio_http_router_s *)fio_http_udata(h);
+  fio_str_info_s method;
+  int result = fio_http_router_dispatch(r, h);
+  if (!result)
+    return;
+  method = fio_http_method(h);
+  if (r && r->settings.public_folder.len &&
+      ((method.len == 3 && !FIO_MEMCMP(method.buf, "GET", 3)) ||
+       (method.len == 4 && !FIO_MEMCMP(method.buf, "HEAD", 4))) &&
+      !fio_http_static_file_response(h,
+                                     r->settings.public_folder,
+                                     fio_http_path(h),
+                                     r->settings.max_age))
+    return;
+  if (r && r->settings.on_not_found) {
+    r->settings.on_not_found(h);
+    return;
+  }
+  fio_http_send_error_response(h, (size_t)result);
+}
+
+/* *****************************************************************************
+Router - Constructor / Destructor
+***************************************************************************** */
+
+/* Creates a new HTTP Router. */
+SFUNC fio_http_router_s *fio_http_router_new FIO_NOOP(
+    fio_http_router_settings_s settings) {
+  fio_http_router_s *r;
+  if (settings.public_folder.len > 1 &&
+      settings.public_folder.buf[settings.public_folder.len - 1] == '/')
+    --settings.public_folder.len;
+  r = (fio_http_router_s *)FIO_MEM_REALLOC_(NULL,
+                                            0,
+                                            sizeof(*r) +
+                                                settings.public_folder.len + 1,
+                                            0);
+  if (!r)
+    return r;
+  FIO_LEAK_COUNTER_ON_ALLOC(fio_http_router_s);
+  *r = (fio_http_router_s){.settings = settings};
+  if (settings.public_folder.len)
+    FIO_MEMCPY(r->public_folder,
+               settings.public_folder.buf,
+               settings.public_folder.len);
+  r->public_folder[settings.public_folder.len] = 0;
+  r->settings.public_folder.buf = r->public_folder;
+  return r;
+}
+
+/* Frees an HTTP Router. */
+SFUNC void fio_http_router_free(fio_http_router_s *r) {
+  if (!r)
+    return;
+  FIO_LEAK_COUNTER_ON_FREE(fio_http_router_s);
+  fio___http_router_compiled_free(r);
+  fio___http_router_tnode_destroy(&r->root);
+  FIO_MEM_FREE_(r, sizeof(*r) + r->settings.public_folder.len + 1);
+}
+
+/* *****************************************************************************
+HTTP Router - cleanup
+***************************************************************************** */
+#endif /* FIO_EXTERN_COMPLETE */
+#undef FIO_HTTP_ROUTER
+#endif /* FIO_HTTP_ROUTER */
+/* ************************************************************************* */
+#if !defined(FIO_INCLUDE_FILE) /* Dev test - ignore line */
+#define FIO___DEV___           /* Development inclusion - ignore line */
 #define FIO_HTTP1_PARSER       /* Development inclusion - ignore line */
 #include "./include.h"         /* Development inclusion - ignore line */
 #endif                         /* Development inclusion - ignore line */
@@ -45173,6 +53676,294 @@ static int fio_http1___finish(fio_http1_parser_s *p,
   return 1;
 }
 
+/* *****************************************************************************
+Line Indexing (SIMD block scanner or memchr)
+
+With AVX2 or NEON, header data is classified 64 bytes at a time, producing a
+bitmap (one bit per byte) for control characters (anything below 0x20, as well
+as DEL) and for dividers (`' '` in the first line and `':'` in header lines).
+
+Line endings are control characters, so the first control character in a line
+is usually the CR (or LF) ending the line. The scanner keeps two consecutive
+blocks, so any line shorter than 64 bytes is indexed using a single (position
+relative) bitmap, without searching the data. Lines with other control
+characters are tested again byte by byte, since only HT is allowed.
+
+Narrower vectors (SSE2) and SWAR are slower than the C library's `memchr`, so
+other builds index lines using `memchr` and test every line for control
+characters (8 bytes at a time), so both paths accept the same requests.
+***************************************************************************** */
+
+#if (FIO___HAS_X86_INTRIN && defined(__AVX2__)) ||                             \
+    (FIO___HAS_ARM_INTRIN && defined(__aarch64__))
+#define FIO___HTTP1_SCANNER 1
+#else
+#define FIO___HTTP1_SCANNER 0
+#endif
+
+/** A line, as indexed by the block scanner / memchr (internal use). */
+typedef struct {
+  /** The first and second dividers in the line (or NULL). */
+  char *div[2];
+  /** The position of the `'\n'` ending the line. */
+  char *eol;
+  /** Non-zero if the line might contain control characters (besides CRLF). */
+  int ctl;
+} fio___http1_line_s;
+
+/* marks (0x80) every zero byte in a 64 bit word (no false positives). */
+FIO_IFUNC uint64_t fio___http1_swar_zero(uint64_t w) {
+  const uint64_t m = UINT64_C(0x7F7F7F7F7F7F7F7F);
+  return ~(((w & m) + m) | w | m);
+}
+
+#if FIO___HTTP1_SCANNER
+
+/** The bitmaps for a single 64 byte block (bit `i` maps to byte `i`). */
+typedef struct {
+  /** Marks control bytes (including CR and LF). */
+  uint64_t ctl;
+  /** Marks divider bytes. */
+  uint64_t div;
+} fio___http1_bitmap_s;
+
+/** The HTTP/1.x block scanner (internal use). */
+typedef struct {
+  /** The first byte of the current block (the next block follows). */
+  char *block;
+  /** The end of the data available for scanning. */
+  char *end;
+  /** The bitmaps for the current and the next block. */
+  fio___http1_bitmap_s map[2];
+  /** The divider byte value. */
+  uint8_t div_char;
+} fio___http1_scanner_s;
+
+#if FIO___HAS_X86_INTRIN
+/* classifies 64 bytes using AVX2 (2 x 32 byte vectors). */
+FIO_IFUNC void fio___http1_scan_block(fio___http1_bitmap_s *m,
+                                      const char *p,
+                                      uint8_t div_char) {
+  const __m256i v_div = _mm256_set1_epi8((char)div_char);
+  const __m256i v_us = _mm256_set1_epi8(0x1F);
+  const __m256i v_del = _mm256_set1_epi8(0x7F);
+  uint64_t div = 0, ctl = 0;
+  for (size_t i = 0; i < 64; i += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+    __m256i c = _mm256_or_si256(
+        _mm256_cmpeq_epi8(_mm256_min_epu8(v, v_us), v), /* v <= 0x1F */
+        _mm256_cmpeq_epi8(v, v_del));
+    div |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, v_div))
+           << i;
+    ctl |= (uint64_t)(uint32_t)_mm256_movemask_epi8(c) << i;
+  }
+  m->div = div;
+  m->ctl = ctl;
+}
+
+#else
+/* packs four NEON comparison results (0xFF / 0x00 bytes) into a bitmap. */
+FIO_IFUNC uint64_t fio___http1_neon2bitmap(uint8x16_t a,
+                                           uint8x16_t b,
+                                           uint8x16_t c,
+                                           uint8x16_t d) {
+  const uint8x16_t bits =
+      {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+  a = vpaddq_u8(vandq_u8(a, bits), vandq_u8(b, bits));
+  c = vpaddq_u8(vandq_u8(c, bits), vandq_u8(d, bits));
+  a = vpaddq_u8(a, c);
+  a = vpaddq_u8(a, a);
+  return vgetq_lane_u64(vreinterpretq_u64_u8(a), 0);
+}
+
+/* classifies 64 bytes using NEON (4 x 16 byte vectors). */
+FIO_IFUNC void fio___http1_scan_block(fio___http1_bitmap_s *m,
+                                      const char *p,
+                                      uint8_t div_char) {
+  const uint8x16_t v_div = vdupq_n_u8(div_char);
+  const uint8x16_t v_us = vdupq_n_u8(0x1F);
+  const uint8x16_t v_del = vdupq_n_u8(0x7F);
+  uint8x16_t d[4], c[4];
+  for (size_t i = 0; i < 4; ++i) {
+    uint8x16_t v = vld1q_u8((const uint8_t *)p + (i << 4));
+    d[i] = vceqq_u8(v, v_div);
+    c[i] = vorrq_u8(vcleq_u8(v, v_us), vceqq_u8(v, v_del));
+  }
+  m->div = fio___http1_neon2bitmap(d[0], d[1], d[2], d[3]);
+  m->ctl = fio___http1_neon2bitmap(c[0], c[1], c[2], c[3]);
+}
+
+#endif /* FIO___HAS_X86_INTRIN */
+
+/* classifies the (up to) 64 bytes starting at `pos`. */
+FIO_SFUNC void fio___http1_scan_load(fio___http1_scanner_s *s,
+                                     fio___http1_bitmap_s *m,
+                                     char *pos) {
+  char tmp[64] FIO_ALIGN(16);
+  if (FIO_LIKELY(s->end - pos >= 64)) {
+    fio___http1_scan_block(m, pos, s->div_char);
+    return;
+  }
+  if (pos >= s->end) {
+    *m = (fio___http1_bitmap_s){0};
+    return;
+  }
+  /* partial block: the zero padding is never part of a complete line */
+  FIO_MEMSET(tmp, 0, 64);
+  FIO_MEMCPY(tmp, pos, (size_t)(s->end - pos));
+  fio___http1_scan_block(m, tmp, s->div_char);
+}
+
+/* initializes the scanner and classifies the first two blocks of data. */
+FIO_IFUNC void fio___http1_scan_init(fio___http1_scanner_s *s,
+                                     char *start,
+                                     char *end,
+                                     uint8_t div_char) {
+  s->block = start;
+  s->end = end;
+  s->div_char = div_char;
+  fio___http1_scan_load(s, s->map, start);
+  fio___http1_scan_load(s, s->map + 1, start + 64);
+}
+
+/* moves the scanner forward until `pos` is in the current block. */
+FIO_IFUNC void fio___http1_scan_advance(fio___http1_scanner_s *s, char *pos) {
+  while (pos >= s->block + 64) {
+    s->block += 64;
+    s->map[0] = s->map[1];
+    fio___http1_scan_load(s, s->map + 1, s->block + 64);
+  }
+}
+
+/* collects the bitmaps for the 64 bytes starting at `pos` (in the window). */
+FIO_IFUNC fio___http1_bitmap_s fio___http1_scan_at(fio___http1_scanner_s *s,
+                                                   char *pos) {
+  /* note: `(x << 1) << (63 - i)` avoids an undefined shift when `i == 0` */
+  const size_t i = (size_t)(pos - s->block);
+  fio___http1_bitmap_s r = {
+      .div = (s->map[0].div >> i) | ((s->map[1].div << 1) << (63 - i)),
+      .ctl = (s->map[0].ctl >> i) | ((s->map[1].ctl << 1) << (63 - i)),
+  };
+  return r;
+}
+
+/* indexes a line that is long or contains control characters (see below). */
+FIO_SFUNC int fio___http1_scan_line_long(fio___http1_scanner_s *s,
+                                         char *pos,
+                                         fio___http1_line_s *l) {
+  size_t found = 0;
+  l->div[0] = l->div[1] = NULL;
+  l->ctl = 0;
+  for (;;) {
+    fio___http1_bitmap_s m;
+    uint64_t map = ~(uint64_t)0;
+    if (pos >= s->end)
+      return -1;
+    fio___http1_scan_advance(s, pos);
+    m = fio___http1_scan_at(s, pos);
+    for (; m.ctl; m.ctl &= m.ctl - 1) {
+      char *c = pos + fio_lsb_index_unsafe(m.ctl);
+      if (c >= s->end)
+        return -1;
+      if (*c == '\n') { /* limit the map to the bytes preceding the LF */
+        map = (m.ctl & (0 - m.ctl)) - 1;
+        l->eol = c;
+        break;
+      }
+      l->ctl |= (*c != '\r' || c + 1 == s->end || c[1] != '\n');
+    }
+    for (m.div &= map; m.div && found < 2; m.div &= m.div - 1)
+      l->div[found++] = pos + fio_lsb_index_unsafe(m.div);
+    if (m.ctl)
+      return 0;
+    pos += 64;
+  }
+}
+
+/* indexes the line starting at `pos`, returns -1 if it is incomplete. */
+FIO_IFUNC int fio___http1_scan_line(fio___http1_scanner_s *s,
+                                    char *pos,
+                                    fio___http1_line_s *l) {
+  fio___http1_bitmap_s m;
+  uint64_t div;
+  size_t i;
+  fio___http1_scan_advance(s, pos);
+  m = fio___http1_scan_at(s, pos);
+  if (FIO_UNLIKELY(!m.ctl))
+    return fio___http1_scan_line_long(s, pos, l);
+  /* fast path - the first control character is a CR or LF ending the line */
+  i = fio_lsb_index_unsafe(m.ctl);
+  if (FIO_UNLIKELY(pos + i + 1 >= s->end))
+    return fio___http1_scan_line_long(s, pos, l);
+  i += (pos[i] == '\r' && pos[i + 1] == '\n');
+  if (FIO_UNLIKELY(pos[i] != '\n'))
+    return fio___http1_scan_line_long(s, pos, l);
+  div = m.div & ((m.ctl & (0 - m.ctl)) - 1);
+  l->eol = pos + i;
+  l->div[0] = div ? pos + fio_lsb_index_unsafe(div) : NULL;
+  div &= div - 1;
+  l->div[1] = div ? pos + fio_lsb_index_unsafe(div) : NULL;
+  l->ctl = 0;
+  return 0;
+}
+
+#else /* FIO___HTTP1_SCANNER */
+
+/** The HTTP/1.x line indexer, using memchr (internal use). */
+typedef struct {
+  /** The end of the data available for scanning. */
+  char *end;
+  /** The divider byte value. */
+  uint8_t div_char;
+} fio___http1_scanner_s;
+
+FIO_IFUNC void fio___http1_scan_init(fio___http1_scanner_s *s,
+                                     char *start,
+                                     char *end,
+                                     uint8_t div_char) {
+  s->end = end;
+  s->div_char = div_char;
+  (void)start;
+}
+
+/* indexes the line starting at `pos`, returns -1 if it is incomplete. */
+FIO_IFUNC int fio___http1_scan_line(fio___http1_scanner_s *s,
+                                    char *pos,
+                                    fio___http1_line_s *l) {
+  l->eol = (char *)FIO_MEMCHR(pos, '\n', (size_t)(s->end - pos));
+  if (!l->eol)
+    return -1;
+  l->div[0] = (char *)FIO_MEMCHR(pos, s->div_char, (size_t)(l->eol - pos));
+  l->div[1] = NULL;
+  l->ctl = 1; /* untested, see fio___http1_ctl_test */
+  /* only the first line (divided by spaces) requires a second divider */
+  if (l->div[0] && s->div_char == ' ')
+    l->div[1] = (char *)FIO_MEMCHR(l->div[0] + 1,
+                                   ' ',
+                                   (size_t)(l->eol - (l->div[0] + 1)));
+  return 0;
+}
+#endif /* FIO___HTTP1_SCANNER */
+
+/* marks (0x80) every byte below 0x20 or equal to DEL (0x7F) in a word. */
+FIO_IFUNC uint64_t fio___http1_swar_ctl(uint64_t w) {
+  const uint64_t m = UINT64_C(0x7F7F7F7F7F7F7F7F);
+  return (~(((w & m) + UINT64_C(0x6060606060606060)) | w | m)) |
+         fio___http1_swar_zero(w ^ m);
+}
+
+/* tests a line for forbidden control characters (only HT is allowed). */
+FIO_SFUNC int fio___http1_ctl_test(char *start, char *eol) {
+  for (; start + 8 <= eol; start += 8) /* HT is rare, test it byte by byte */
+    if (FIO_UNLIKELY(fio___http1_swar_ctl(fio_buf2u64u(start))))
+      break;
+  for (; start < eol; ++start)
+    if (FIO_UNLIKELY(((uint8_t)start[0] < 0x20 && start[0] != '\t') ||
+                     (uint8_t)start[0] == 0x7F))
+      return -1;
+  return 0;
+}
+
 /* *****************************************************************************
 Reading the first line
 ***************************************************************************** */
@@ -45183,38 +53974,43 @@ static int fio_http1___start(fio_http1_parser_s *p,
                              void *udata) {
   /* find line start/end and test */
   fio_buf_info_s wrd[3];
+  fio___http1_scanner_s s;
+  fio___http1_line_s l;
   char *start = buf->buf;
-  char *tmp;
-  while ((start[0] == ' ' || start[0] == '\r' || start[0] == '\n') &&
-         start < buf->buf + buf->len) /* skip white space */
-    ++start;
-  if (start == buf->buf + buf->len) {
+  char *end = buf->buf + buf->len;
+  char *eol;
+  while (start < end &&
+         (start[0] == ' ' || start[0] == '\r' || start[0] == '\n'))
+    ++start; /* skip white space */
+  if (start == end) {
     buf->buf = start;
+    buf->len = 0;
     return 1;
   }
-  char *eol = (char *)FIO_MEMCHR(start, '\n', buf->len);
-  if (!eol)
+  fio___http1_scan_init(&s, start, end, ' ');
+  if (fio___http1_scan_line(&s, start, &l))
     return 1;
+  eol = l.eol;
   if (start + 13 > eol) /* test for minimal data GET HTTP/1 or ### HTTP/1 */
     return -1;
+  if (!l.div[1])
+    return -1;
 
   /* prep next stage */
   buf->len -= (eol - buf->buf) + 1;
   buf->buf = eol + 1;
   eol -= eol[-1] == '\r';
+  if (FIO_UNLIKELY(l.ctl && fio___http1_ctl_test(start, eol)))
+    return -1;
 
   /* parse first line */
   /* request: method path version ; response: version code txt */
-  if (!(tmp = (char *)FIO_MEMCHR(start, ' ', (size_t)(eol - start))))
-    return -1;
-  wrd[0] = FIO_BUF_INFO2(start, (size_t)(tmp - start));
-  start = tmp + 1;
-  if (!(tmp = (char *)FIO_MEMCHR(start, ' ', eol - start)))
-    return -1;
-  wrd[1] = FIO_BUF_INFO2(start, (size_t)(tmp - start));
-  start = tmp + 1;
-  if (start >= eol)
+  if (l.div[1] + 1 >= eol)
     return -1;
+  wrd[0] = FIO_BUF_INFO2(start, (size_t)(l.div[0] - start));
+  start = l.div[0] + 1;
+  wrd[1] = FIO_BUF_INFO2(start, (size_t)(l.div[1] - start));
+  start = l.div[1] + 1;
   wrd[2] = FIO_BUF_INFO2(start, (size_t)(eol - start));
   if (fio_c2i(wrd[1].buf[0]) < 10) /* test if path or code */
     goto parse_response_line;
@@ -45339,13 +54135,13 @@ static inline int fio_http1___on_trailer(fio_http1_parser_s *p,
 
 /* returns either a lower case (ASCI) or the original char. */
 static uint8_t fio_http1_tolower(uint8_t c) {
-  if ((c - ((uint8_t)'A' - 1U)) < ((uint8_t)'Z' - (uint8_t)'A'))
+  if ((uint8_t)(c - (uint8_t)'A') <= ((uint8_t)'Z' - (uint8_t)'A'))
     c |= 32;
   return c;
 }
 
-/* seeks to the ':' divisor while testing and converting to downcase. */
-static char *fio_http1___seek_header_div(char *p) {
+/* tests header name characters while converting the name to downcase. */
+FIO_SFUNC int fio___http1_name_prepare_slow(char *p, char *end) {
   /* this is the subset of the forbidden chars that allows UTF-8 headers */
   static const _Bool forbidden_name_chars[256] = {
       1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
@@ -45359,15 +54155,87 @@ static char *fio_http1___seek_header_div(char *p) {
       0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
       0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
       0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-  for (;;) {
+  for (; p < end; ++p) {
+    if (FIO_UNLIKELY(forbidden_name_chars[(uint8_t)(*p)]))
+      return -1;
     *p = (char)fio_http1_tolower((uint8_t)(*p));
-    ++p;
-    if (FIO_UNLIKELY(forbidden_name_chars[((uint8_t)(*p))]))
-      return p;
   }
+  return 0;
+}
+
+#if FIO___HAS_X86_INTRIN
+/*
+ * Tests and converts header names 16 bytes at a time. Names made of letters,
+ * digits and '-' are converted to lower case by setting the 0x20 bit (which is
+ * already set for digits and '-'). Other names use the (slower) table test.
+ */
+FIO_IFUNC int fio___http1_name_prepare(char *p, char *end, char *limit) {
+  static const uint8_t in_name[32] = {
+      0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+      0x20, 0x20, 0x20, 0x20, 0x20, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+  const __m128i v_a = _mm_set1_epi8('a');
+  const __m128i v_0 = _mm_set1_epi8('0');
+  const __m128i v_dash = _mm_set1_epi8('-');
+  const __m128i v_25 = _mm_set1_epi8(25);
+  const __m128i v_9 = _mm_set1_epi8(9);
+  while (p < end) {
+    __m128i v, m, a, d;
+    size_t len = (size_t)(end - p);
+    if (FIO_UNLIKELY(limit - p < 16))
+      return fio___http1_name_prepare_slow(p, end);
+    if (len > 16)
+      len = 16;
+    v = _mm_loadu_si128((const __m128i *)p);
+    m = _mm_loadu_si128((const __m128i *)(in_name + 16 - len));
+    a = _mm_sub_epi8(_mm_or_si128(v, m), v_a);
+    d = _mm_sub_epi8(v, v_0);
+    a = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(a, v_25), a),
+                     _mm_cmpeq_epi8(_mm_min_epu8(d, v_9), d));
+    a = _mm_or_si128(a, _mm_cmpeq_epi8(v, v_dash));
+    if (FIO_UNLIKELY((~_mm_movemask_epi8(a) & ((1U << len) - 1))))
+      return fio___http1_name_prepare_slow(p, end);
+    _mm_storeu_si128((__m128i *)p, _mm_or_si128(v, m));
+    p += len;
+  }
+  return 0;
+}
+
+#else
+/* marks (0x80) every byte in the range [lo, hi] (7 bit values only). */
+#define FIO___HTTP1_SWAR_RANGE(h7, lo, hi)                                     \
+  (((h7) + UINT64_C(0x0101010101010101) * (0x80 - (lo))) &                     \
+   ~((h7) + UINT64_C(0x0101010101010101) * (0x7F - (hi))))
+
+/*
+ * Tests and converts header names 8 bytes at a time. Names made of letters,
+ * digits and '-' are converted to lower case by setting the 0x20 bit (which is
+ * already set for digits and '-'). Other names use the (slower) table test.
+ */
+FIO_IFUNC int fio___http1_name_prepare(char *p, char *end, char *limit) {
+  const uint64_t bytes = UINT64_C(0x0101010101010101);
+  while (p < end) {
+    uint64_t w, x, valid;
+    uint64_t m = bytes * 0x80;
+    if (FIO_UNLIKELY(limit - p < 8))
+      return fio___http1_name_prepare_slow(p, end);
+    if (end - p < 8) /* only test (and edit) the bytes in the name */
+      m >>= (8 - (end - p)) << 3;
+    w = fio_buf2u64_le(p);
+    x = w | (bytes * 0x20);
+    valid = (FIO___HTTP1_SWAR_RANGE(x & (bytes * 0x7F), 'a', 'z') & ~x) |
+            (FIO___HTTP1_SWAR_RANGE(w & (bytes * 0x7F), '0', '9') & ~w) |
+            fio___http1_swar_zero(w ^ (bytes * '-'));
+    if (FIO_UNLIKELY((valid & m) != m))
+      return fio___http1_name_prepare_slow(p, end);
+    fio_u2buf64_le(p, w | (m >> 2));
+    p += 8;
+  }
+  return 0;
 }
+#undef FIO___HTTP1_SWAR_RANGE
+#endif /* FIO___HAS_X86_INTRIN */
 
-/* extract header name and value from a line and pass info to handler */
+/* extract header name and value from each line and pass info to handler */
 static inline int fio_http1___read_header_line(
     fio_http1_parser_s *p,
     fio_buf_info_s *buf,
@@ -45376,22 +54244,29 @@ static inline int fio_http1___read_header_line(
                    fio_buf_info_s,
                    fio_buf_info_s,
                    void *)) {
+  fio___http1_scanner_s s;
+  fio___http1_line_s l;
+  if (!buf->len)
+    return 1;
+  fio___http1_scan_init(&s, buf->buf, buf->buf + buf->len, ':');
   for (;;) {
     char *start = buf->buf;
-    char *eol = (char *)FIO_MEMCHR(start, '\n', buf->len);
+    char *eol;
     char *div;
     fio_buf_info_s name, value;
-    if (!eol)
+    if (fio___http1_scan_line(&s, start, &l))
       return 1;
-
-    buf->len -= (eol - buf->buf) + 1;
+    eol = l.eol;
+    buf->len -= (eol - start) + 1;
     buf->buf = eol + 1;
-    eol -= (eol[-1] == '\r');
+    eol -= (eol > start && eol[-1] == '\r');
     if (FIO_UNLIKELY(eol == start))
       goto headers_finished;
 
-    div = fio_http1___seek_header_div(start);
-    if (div[0] != ':')
+    div = l.div[0]; /* the first ':' is always before the (CR)LF */
+    if (FIO_UNLIKELY(!div || div == start ||
+                     (l.ctl && fio___http1_ctl_test(start, eol)) ||
+                     fio___http1_name_prepare(start, div, s.end)))
       return -1;
     name = FIO_BUF_INFO2(start, (size_t)(div - start));
     do {
@@ -45945,11 +54820,15 @@ FIO_SFUNC int fio___websocket_consume_header(fio_websocket_parser_s *p,
     p->current = info;
     if ((info & 15)) /* continuation frame == 0 ; is it missing? */
       return -1;
+    if ((info & 112)) /* RSV bits are only set on the first frame */
+      return -1;
   } else {
     p->first = p->current = info;
     p->start_at = 0;
     if (!(info & 15)) /* continuation frame == 0 ; where's the first? */
       return -1;
+    if ((info & 48) || (info & 72) == 72) /* RSV2/3 or compressed control */
+      return -1;
   }
   if (p->must_mask && !p->mask)
     return -1;
@@ -46044,11 +54923,60 @@ HTTP Setting Defaults
 #define FIO_WEBSOCKET_STATS 0
 #endif
 
+#ifndef FIO_HTTP_WEBSOCKET_DEFLATE_MIN
+/** WebSocket messages shorter than this are sent uncompressed (default). */
+#define FIO_HTTP_WEBSOCKET_DEFLATE_MIN 128
+#endif
+
+#ifndef FIO_HTTP_WEBSOCKET_DEFLATE_MEM_LEVEL
+/** The zlib `memLevel` (1-9) for WebSocket compression. Less is smaller. */
+#define FIO_HTTP_WEBSOCKET_DEFLATE_MEM_LEVEL 8
+#endif
+
+#ifndef FIO_HTTP_WEBSOCKET_DEFLATE_POOL
+/** The number of idle zlib streams kept for reuse (per window size / level). */
+#define FIO_HTTP_WEBSOCKET_DEFLATE_POOL 16
+#endif
+
+#ifndef FIO_HTTP_DEFAULT_CACHE_LIMIT
+/** The default memory limit for a listener's response cache (`cache_ttl`). */
+#define FIO_HTTP_DEFAULT_CACHE_LIMIT 8388608 /* (1UL << 23) */
+#endif
+
+#ifndef FIO_HTTP_DEFAULT_COMPRESS_MIN
+/** Responses shorter than this are sent uncompressed (see `compress`). */
+#define FIO_HTTP_DEFAULT_COMPRESS_MIN 1024
+#endif
+
+#ifndef FIO_HTTP_BROTLI_WINDOW
+/** The brotli window (in bits, 10-24) used for response compression. */
+#define FIO_HTTP_BROTLI_WINDOW 18
+#endif
+
+#ifndef FIO_HTTP2_MAX_STREAMS
+/** The maximum number of concurrent HTTP/2 streams (requests) per client. */
+#define FIO_HTTP2_MAX_STREAMS 128
+#endif
+
+#ifndef FIO_HTTP2_WINDOW
+/** The HTTP/2 flow control window (per stream and per connection). */
+#define FIO_HTTP2_WINDOW 1048576 /* (1UL << 20) */
+#endif
+
 /* *****************************************************************************
 HTTP Listen
 ***************************************************************************** */
 typedef struct fio_http_settings_s {
-  /** Called before body uploads, when a client sends an `Expect` header. */
+  /**
+   * Called once before a request's body (if any) is received, i.e., to stream
+   * the body using `fio_http_body_multipart` (server only).
+   *
+   * If a response is sent, the body is discarded (HTTP/1.1 connections are
+   * closed once the response was sent).
+   *
+   * When a client sends an `Expect` header, this is called before the `100
+   * Continue` response and a response may be sent to deny the upload.
+   */
   void (*pre_http_body)(fio_http_s *h);
   /** Callback for HTTP requests (server) or responses (client). */
   void (*on_http)(fio_http_s *h);
@@ -46128,10 +55056,70 @@ typedef struct fio_http_settings_s {
    * connections. Defaults to FIO_HTTP_DEFAULT_WS_MAX_MSG_SIZE bytes.
    */
   size_t ws_max_msg_size;
+  /**
+   * WebSocket messages shorter than this are always sent uncompressed (see
+   * `ws_deflate`).
+   *
+   * Defaults to FIO_HTTP_WEBSOCKET_DEFLATE_MIN bytes.
+   */
+  size_t ws_deflate_min;
+  /**
+   * A comma separated list of request header names that are part of the
+   * response cache key (see `cache_ttl`), i.e., `"host, accept-encoding"`.
+   *
+   * The request's path and query are always part of the key.
+   */
+  fio_str_info_s cache_vary;
+  /**
+   * The memory limit (in bytes) for the response cache (see `cache_ttl`).
+   * Least recently used responses are evicted first.
+   *
+   * Defaults to FIO_HTTP_DEFAULT_CACHE_LIMIT bytes.
+   */
+  size_t cache_limit;
+  /**
+   * Responses shorter than this are always sent uncompressed (see
+   * `compress`). Streaming responses are compressed regardless of length.
+   *
+   * Defaults to FIO_HTTP_DEFAULT_COMPRESS_MIN bytes.
+   */
+  size_t compress_min;
   /** reserved for future use. */
   intptr_t reserved1;
   /** reserved for future use. */
   intptr_t reserved2;
+  /**
+   * The maximum number of concurrent client connections per origin (only
+   * relevant in client mode).
+   *
+   * When set, `fio_http_connect` keeps HTTP/1.1 connections alive and reuses
+   * them for later requests to the same origin. Requests are queued while all
+   * of the origin's connections are busy.
+   *
+   * Defaults to 0 (a new connection per request, closed once it's done).
+   */
+  uint16_t pool_max;
+  /**
+   * The maximum number of idle client connections kept alive per origin.
+   *
+   * Defaults to `pool_max`. Idle connections are closed after `timeout`.
+   */
+  uint16_t pool_max_idle;
+  /**
+   * Caches HTTP/1.x responses to `GET` requests for up to `cache_ttl` seconds
+   * (only relevant in server mode).
+   *
+   * Cached responses are sent as is, without calling `on_http`. Concurrent
+   * requests for a response that isn't cached yet wait for the first request
+   * to be handled, so `on_http` is only called once.
+   *
+   * Only responses that can be stored by a shared cache are cached (see the
+   * `Cache-Control` and `Vary` response headers). The `max-age` / `s-maxage`
+   * directives may shorten the time a response is cached.
+   *
+   * Defaults to 0 (disabled).
+   */
+  uint16_t cache_ttl;
   /**
    * An HTTP/1.x connection timeout.
    *
@@ -46162,6 +55150,33 @@ typedef struct fio_http_settings_s {
   uint8_t sse_timeout;
   /** Timeout for client connections (only relevant in client mode). */
   uint8_t connect_timeout;
+  /**
+   * Enables WebSocket compression (the RFC 7692 permessage-deflate extension)
+   * and limits the compression window to `(1 << ws_deflate)` bytes (9-15).
+   *
+   * Defaults to 0 (disabled). Requires zlib (`HAVE_ZLIB`).
+   */
+  uint8_t ws_deflate;
+  /**
+   * If set, the compression context is reset after every WebSocket message.
+   *
+   * This compresses less, but allows zlib state to be pooled rather than kept
+   * per connection, and allows pub/sub messages to be compressed only once.
+   */
+  uint8_t ws_deflate_no_context_takeover;
+  /**
+   * Compresses textual HTTP/1.x responses (`text/...`, JSON, JavaScript, XML)
+   * using this compression level (1-9), when the client accepts the `br`
+   * (brotli) or `gzip` encoding. Works for both complete and streaming
+   * (chunked) responses.
+   *
+   * Compressible responses get a `vary: accept-encoding` header and the `etag`
+   * of a compressed response is weakened (`W/"..."`).
+   *
+   * Defaults to 0 (disabled). Requires zlib (`HAVE_ZLIB`) and / or brotli
+   * (`HAVE_BROTLI`).
+   */
+  uint8_t compress;
   /** Logging flag - set to TRUE to log HTTP requests. */
   uint8_t log;
 } fio_http_settings_s;
@@ -46186,7 +55201,13 @@ SFUNC fio_io_s *fio_http_io(fio_http_s *);
 #define fio_http_subscribe(h, ...)                                             \
   fio_subscribe(.io = fio_http_io(h), __VA_ARGS__)
 
-/** Connects to HTTP / WebSockets / SSE connections on `url`. */
+/**
+ * Connects to HTTP / WebSockets / SSE connections on `url`.
+ *
+ * If `pool_max` is set, HTTP requests reuse idle connections to the same
+ * origin. In which case, NULL is returned if the request was queued (all of
+ * the origin's connections were busy).
+ */
 SFUNC fio_io_s *fio_http_connect(const char *url,
                                  fio_http_s *h,
                                  fio_http_settings_s settings);
@@ -46254,6 +55275,13 @@ Module Implementation - possibly externed functions.
 ***************************************************************************** */
 #if defined(FIO_EXTERN_COMPLETE) || !defined(FIO_EXTERN)
 
+#if HAVE_ZLIB
+#include <zlib.h>
+#endif
+#if HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
+
 /*
 REMEMBER:
 ========
@@ -46360,6 +55388,32 @@ static void http_settings_validate(fio_http_settings_s *s, int is_client) {
     s->ws_timeout = FIO_HTTP_DEFAULT_TIMEOUT_LONG;
   if (!s->sse_timeout)
     s->sse_timeout = s->ws_timeout;
+  if (!s->ws_deflate_min)
+    s->ws_deflate_min = FIO_HTTP_WEBSOCKET_DEFLATE_MIN;
+  if (!s->pool_max_idle || s->pool_max_idle > s->pool_max)
+    s->pool_max_idle = s->pool_max;
+  if (!s->cache_limit)
+    s->cache_limit = FIO_HTTP_DEFAULT_CACHE_LIMIT;
+  if (!s->compress_min)
+    s->compress_min = FIO_HTTP_DEFAULT_COMPRESS_MIN;
+  if (s->compress > 9)
+    s->compress = 9;
+#if !HAVE_ZLIB && !HAVE_BROTLI
+  if (s->compress)
+    FIO_LOG_WARNING("HTTP compression requires zlib (HAVE_ZLIB) or brotli "
+                    "(HAVE_BROTLI).");
+  s->compress = 0;
+#endif
+#if HAVE_ZLIB
+  if (s->ws_deflate && s->ws_deflate < 9)
+    s->ws_deflate = 9; /* zlib doesn't support 256 byte raw deflate windows */
+  if (s->ws_deflate > 15)
+    s->ws_deflate = 15;
+#else
+  if (s->ws_deflate)
+    FIO_LOG_WARNING("WebSocket compression requires zlib (HAVE_ZLIB).");
+  s->ws_deflate = 0;
+#endif
 
   if (s->max_header_size < s->max_line_len)
     s->max_header_size = s->max_line_len;
@@ -46396,23 +55450,37 @@ HTTP Protocol Container (vtable + settings storage)
 ***************************************************************************** */
 #define FIO___RECURSIVE_INCLUDE 1
 
+typedef struct fio___http_cache_s fio___http_cache_s;
+typedef struct fio___http_cache_entry_s fio___http_cache_entry_s;
+
 typedef struct {
   fio_http_settings_s settings;
   void (*on_http_callback)(void *, void *);
   fio_queue_s *queue;
+  fio___http_cache_s *cache; /* response cache (server mode, if enabled) */
   struct {
     fio_io_protocol_s protocol;
     fio_http_controller_s controller;
   } state[FIO___HTTP_PROTOCOL_NONE + 1];
+  uint8_t shared_frames;
   char public_folder_buf[];
 } fio___http_protocol_s;
 #include FIO_INCLUDE_FILE
 
+/* pub/sub metadata builder for pre-framed (shared) WebSocket / SSE payloads */
+FIO_SFUNC void *fio___http_msg_metadata_build(fio_msg_s *msg);
+/* frees the response cache */
+FIO_SFUNC void fio___http_cache_free(fio___http_cache_s *cache);
+
 #define FIO_REF_NAME             fio___http_protocol
 #define FIO_REF_FLEX_TYPE        char
 #define FIO_REF_CONSTRUCTOR_ONLY 1
 #define FIO_REF_DESTROY(o)                                                     \
   do {                                                                         \
+    if (o.shared_frames)                                                       \
+      fio_message_metadata_remove(fio___http_msg_metadata_build);              \
+    if (o.cache)                                                               \
+      fio___http_cache_free(o.cache);                                          \
     if (o.settings.tls)                                                        \
       fio_io_tls_free(o.settings.tls);                                         \
     if (o.settings.on_stop)                                                    \
@@ -46429,6 +55497,7 @@ FIO_IFUNC fio___http_protocol_s *fio___http_protocol_init(
 HTTP Connection Container
 ***************************************************************************** */
 
+typedef struct fio___http_pool_s fio___http_pool_s;
 struct fio___http_connection_http_s {
   void (*on_http_callback)(void *, void *);
   void (*on_http)(fio_http_s *h);
@@ -46438,12 +55507,31 @@ struct fio___http_connection_http_s {
   uint32_t max_header;
   uint32_t max_line;
   uint32_t header_bytes;
+  fio___http_pool_s *pool; /* client connection pool (if any) */
+  FIO_LIST_NODE pool_node; /* in the pool's `idle` list while idle */
+  fio___http_cache_entry_s *cache; /* the cached response sent / recorded */
+  uint8_t cache_hit; /* set if `cache` is sent (rather than recorded) */
+  void *zip;         /* the streaming response's compressor (if any) */
+  uint8_t zip_type;  /* the response's content encoding (if compressed) */
+  uint8_t pre_body;  /* set once `pre_http_body` was called for the request */
 };
+/** WebSocket permessage-deflate state (RFC 7692), if negotiated. */
+typedef struct {
+  void *tx; /* deflate stream, kept between messages for context takeover */
+  void *rx; /* inflate stream, kept between messages for context takeover */
+  FIO___LOCK_TYPE lock; /* keeps the compressed frames in their write order */
+  uint32_t min;         /* shorter messages are sent uncompressed */
+  uint8_t tx_bits;      /* our window bits (0 == extension wasn't negotiated) */
+  uint8_t rx_bits;      /* peer window bits */
+  uint8_t tx_reset;     /* our "no_context_takeover" */
+  uint8_t rx_reset;     /* peer "no_context_takeover" */
+} fio___http_ws_deflate_s;
 struct fio___http_connection_ws_s {
   void (*on_message)(fio_http_s *h, fio_buf_info_s msg, uint8_t is_text);
   void (*on_ready)(fio_http_s *h);
   fio_websocket_parser_s parser;
   char *msg;
+  fio___http_ws_deflate_s deflate;
   uint16_t code;
 };
 struct fio___http_connection_sse_s {
@@ -46456,6 +55544,18 @@ struct fio___http_connection_sse_s {
   fio_buf_info_s event;
   char *data;
 };
+typedef struct fio___http2_s fio___http2_s;
+struct fio___http_connection_h2_s {
+  fio___http2_s *session; /* NULL once the stream was closed */
+  char *hdr; /* response header snapshot (see `fio___http2_send_headers`) */
+  fio_stream_s out;   /* response body (DATA frames) */
+  FIO_LIST_NODE node; /* in the session's `active` list */
+  int64_t window;     /* stream send window */
+  uint32_t id;        /* stream id */
+  uint32_t recv;      /* bytes received since last WINDOW_UPDATE */
+  uint16_t flags;
+  uint8_t urgency; /* RFC 9218 */
+};
 
 /** Connection objects for managing HTTP / WebSocket connection state. */
 typedef struct {
@@ -46468,12 +55568,14 @@ typedef struct {
     struct fio___http_connection_http_s http;
     struct fio___http_connection_ws_s ws;
     struct fio___http_connection_sse_s sse;
+    struct fio___http_connection_h2_s h2;
   } state;
   uint32_t len;
   uint32_t capa;
   uint8_t log;
   uint8_t suspend;
   uint8_t is_client;
+  uint8_t is_h2_stream;
   char buf[];
 } fio___http_connection_s;
 
@@ -46482,6 +55584,8 @@ typedef struct {
 #define FIO_REF_FLEX_TYPE        char
 #define FIO_REF_DESTROY(o)                                                     \
   do {                                                                         \
+    if (o.is_h2_stream)                                                        \
+      fio_io_free(o.io);                                                       \
     fio___http_protocol_free(                                                  \
         FIO_PTR_FROM_FIELD(fio___http_protocol_s, settings, o.settings));      \
   } while (0)
@@ -46504,316 +55608,1843 @@ static void fio___http_default_on_eventsource_redirect(fio_http_s *h,
 }
 
 /* *****************************************************************************
-HTTP Request handling / handling
+WebSocket Compression - permessage-deflate (RFC 7692)
 ***************************************************************************** */
 
-FIO_SFUNC void fio___http_perform_user_callback(void *cb_, void *h_) {
-  union {
-    void (*fn)(fio_http_s *);
-    void *ptr;
-  } cb = {.ptr = cb_};
-  fio_http_s *h = (fio_http_s *)h_;
-  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+/** Parsed permessage-deflate extension parameters (0 == missing). */
+typedef struct {
+  uint8_t server_bits; /* 16 == no value (valid for client_max_window_bits) */
+  uint8_t client_bits;
+  uint8_t server_reset; /* server_no_context_takeover */
+  uint8_t client_reset; /* client_no_context_takeover */
+} fio___http_ws_deflate_params_s;
+
+/** Parses an extension offer / response. Returns -1 if invalid. */
+FIO_SFUNC int fio___http_ws_deflate_params(fio___http_ws_deflate_params_s *o,
+                                           fio_str_info_s value) {
+  *o = (fio___http_ws_deflate_params_s){0};
+  FIO_HTTP_HEADER_VALUE_EACH_PROPERTY(value, p) {
+    fio_str_info_s name = p.name, val = p.value;
+    uint8_t *target;
+    uint8_t bits = 16;
+    while (name.len && (name.buf[0] == ' ' || name.buf[0] == '\t'))
+      ++name.buf, --name.len;
+    if (val.len > 1 && val.buf[0] == '"' && val.buf[val.len - 1] == '"')
+      ++val.buf, val.len -= 2;
+    if (val.len) {
+      char *pos = val.buf;
+      uint64_t i = fio_atol10u(&pos);
+      if (pos != val.buf + val.len || i < 8 || i > 15)
+        return -1;
+      bits = (uint8_t)i;
+    }
+    if (FIO_STR_INFO_IS_EQ(name,
+                           FIO_STR_INFO2((char *)"server_max_window_bits", 22)))
+      target = &o->server_bits;
+    else if (FIO_STR_INFO_IS_EQ(
+                 name,
+                 FIO_STR_INFO2((char *)"client_max_window_bits", 22)))
+      target = &o->client_bits;
+    else if (!val.len &&
+             FIO_STR_INFO_IS_EQ(
+                 name,
+                 FIO_STR_INFO2((char *)"server_no_context_takeover", 26)))
+      target = &o->server_reset;
+    else if (!val.len &&
+             FIO_STR_INFO_IS_EQ(
+                 name,
+                 FIO_STR_INFO2((char *)"client_no_context_takeover", 26)))
+      target = &o->client_reset;
+    else
+      return -1; /* unknown parameter */
+    if (*target)
+      return -1; /* parameters MUST NOT repeat */
+    *target = bits;
+  }
+  return 0 - (o->server_bits == 16);
+}
 
-  if (FIO_LIKELY(FIO_SOCK_IS_OPEN(fio_io_fd(c->io))))
-    cb.fn(h);
-  fio_http_free(h);
+#if HAVE_ZLIB
+/* *****************************************************************************
+WebSocket / HTTP Compression - zlib stream pool
+***************************************************************************** */
+
+/** A zlib stream, pooled by type and window size (or level) when idle. */
+typedef struct fio___http_zstream_s {
+  z_stream z;
+  struct fio___http_zstream_s *next;
+  uint8_t bits;       /* window bits (raw deflate / inflate), or gzip level */
+  uint8_t is_inflate; /* 0: raw deflate, 1: raw inflate, 2: gzip (deflate) */
+} fio___http_zstream_s;
+
+FIO_LEAK_COUNTER_DEF(fio___http_zstream_s)
+
+static struct {
+  fio___http_zstream_s *idle[3][16]; /* [is_inflate][window bits] */
+  uint32_t count[3][16];
+  FIO___LOCK_TYPE lock;
+  uint8_t at_exit;
+} fio___http_zpool = {.lock = FIO___LOCK_INIT};
+
+FIO_SFUNC void fio___http_zstream_destroy(fio___http_zstream_s *s) {
+  if (s->is_inflate == 1)
+    inflateEnd(&s->z);
+  else
+    deflateEnd(&s->z);
+  FIO_LEAK_COUNTER_ON_FREE(fio___http_zstream_s);
+  FIO_MEM_FREE_(s, sizeof(*s));
 }
 
-FIO_SFUNC void fio___http_perform_user_upgrade_callback_websocket(void *cb_,
-                                                                  void *h_) {
-  union {
-    int (*fn)(fio_http_s *);
-    void *ptr;
-  } cb = {.ptr = cb_};
-  fio_http_s *h = (fio_http_s *)h_;
-  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
-  struct fio___http_connection_http_s old = c->state.http;
-  if (!FIO_LIKELY(fio_io_is_open(c->io)) || cb.fn(h))
-    goto refuse_upgrade;
-  if (c->h) /* request after WebSocket Upgrade? an attack vector? */
-    goto refuse_upgrade;
-#if HAVE_ZLIB && 0           /* TODO: logs and fix extension handling logic */
-  FIO_HTTP_HEADER_EACH_VALUE(/* TODO: setup WebSocket extension */
-                             h,
-                             1,
-                             FIO_STR_INFO2((char *)"sec-websocket-extensions",
-                                           24),
-                             val) {
-    FIO_LOG_DDEBUG2("WebSocket extension requested: %.*s",
-                    (int)val.len,
-                    val.buf);
-    if (!FIO_STR_INFO_IS_EQ(val,
-                            FIO_STR_INFO2((char *)"permessage-deflate", 18)))
-      continue;
-    size_t client_bits = 0, server_bits = 0;
-    FIO_HTTP_HEADER_VALUE_EACH_PROPERTY(val, p) {
-      FIO_LOG_DDEBUG2("\t %.*s: %.*s",
-                      (int)p.name.len,
-                      p.name.buf,
-                      (int)p.value.len,
-                      p.value.buf);
-      if (FIO_STR_INFO_IS_EQ(p.name,
-                             FIO_STR_INFO2((char *)"client_max_window_bits",
-                                           22))) { /* used by chrome */
-        char *iptr = p.value.buf;
-        client_bits = iptr ? fio_atol10u(&iptr) : 0;
-        if (client_bits < 8 || client_bits > 15)
-          client_bits = (size_t)-1;
-      }
-      if (FIO_STR_INFO_IS_EQ(
-              p.name,
-              FIO_STR_INFO2((char *)"server_max_window_bits", 22))) {
-        char *iptr = p.value.buf;
-        server_bits = iptr ? fio_atol10u(&iptr) : 0;
-        if (server_bits < 8 || server_bits > 15)
-          server_bits = (size_t)-1;
-      }
+FIO_SFUNC void fio___http_zpool_destroy(void *ignr_) {
+  FIO___LOCK_LOCK(fio___http_zpool.lock);
+  for (size_t i = 0; i < 48; ++i) {
+    fio___http_zstream_s **pos = fio___http_zpool.idle[i >> 4] + (i & 15);
+    while (*pos) {
+      fio___http_zstream_s *s = *pos;
+      *pos = s->next;
+      fio___http_zstream_destroy(s);
     }
-    if (client_bits)
-      ; /* TODO */
-    if (server_bits)
-      ; /* TODO */
-    break;
-  } /* HAVE_ZLIB */
-#endif
-  fio_http_upgrade_websocket(h);
-  return;
-
-refuse_upgrade:
-  c->state.http = old;
-  if (fio_http_send_error_response(h, 403))
-    fio_io_free(c->io);
-  fio_http_free(h);
+    fio___http_zpool.count[i >> 4][i & 15] = 0;
+  }
+  FIO___LOCK_UNLOCK(fio___http_zpool.lock);
+  (void)ignr_;
 }
 
-FIO_SFUNC void fio___http_perform_user_upgrade_callback_sse(void *cb_,
-                                                            void *h_) {
-  union {
-    int (*fn)(fio_http_s *);
-    void *ptr;
-  } cb = {.ptr = cb_};
-  fio_http_s *h = (fio_http_s *)h_;
-  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
-  if (!FIO_LIKELY(fio_io_is_open(c->io)) || cb.fn(h))
-    goto refuse_upgrade;
-  if (c->h) /* request after eventsource? an attack vector? */
-    goto refuse_upgrade;
-  fio_http_upgrade_sse(h);
-  return;
+/** Takes an idle zlib stream from the pool, or initializes a new one. */
+FIO_SFUNC fio___http_zstream_s *fio___http_zstream_new(uint8_t is_inflate,
+                                                       uint8_t bits) {
+  fio___http_zstream_s *s;
+  int r;
+  FIO___LOCK_LOCK(fio___http_zpool.lock);
+  s = fio___http_zpool.idle[is_inflate][bits];
+  if (s) {
+    fio___http_zpool.idle[is_inflate][bits] = s->next;
+    --fio___http_zpool.count[is_inflate][bits];
+  }
+  FIO___LOCK_UNLOCK(fio___http_zpool.lock);
+  if (s)
+    return s;
+  s = (fio___http_zstream_s *)FIO_MEM_REALLOC_(NULL, 0, sizeof(*s), 0);
+  if (!s)
+    return s;
+  *s = (fio___http_zstream_s){.bits = bits, .is_inflate = is_inflate};
+  /* negative window bits == raw deflate (no zlib header / trailer) */
+  if (is_inflate == 2) /* 16 + 15 window bits == gzip header / trailer */
+    r = deflateInit2(&s->z,
+                     (int)bits,
+                     Z_DEFLATED,
+                     31,
+                     FIO_HTTP_WEBSOCKET_DEFLATE_MEM_LEVEL,
+                     Z_DEFAULT_STRATEGY);
+  else if (is_inflate)
+    r = inflateInit2(&s->z, 0 - (int)bits);
+  else
+    r = deflateInit2(&s->z,
+                     Z_DEFAULT_COMPRESSION,
+                     Z_DEFLATED,
+                     0 - (int)bits,
+                     FIO_HTTP_WEBSOCKET_DEFLATE_MEM_LEVEL,
+                     Z_DEFAULT_STRATEGY);
+  if (r != Z_OK) {
+    FIO_LOG_ERROR("zlib stream initialization failed (%d)", r);
+    FIO_MEM_FREE_(s, sizeof(*s));
+    return NULL;
+  }
+  FIO_LEAK_COUNTER_ON_ALLOC(fio___http_zstream_s);
+  return s;
+}
 
-refuse_upgrade:
-  if (fio_http_send_error_response(h, 403))
-    fio_io_free(c->io);
-  fio_http_free(h);
+/** Resets a zlib stream and returns it to the pool (or frees it). */
+FIO_SFUNC void fio___http_zstream_free(fio___http_zstream_s *s) {
+  if (!s)
+    return;
+  if (s->is_inflate == 1)
+    inflateReset(&s->z);
+  else
+    deflateReset(&s->z);
+  FIO___LOCK_LOCK(fio___http_zpool.lock);
+  if (fio___http_zpool.count[s->is_inflate][s->bits] <
+      FIO_HTTP_WEBSOCKET_DEFLATE_POOL) {
+    s->next = fio___http_zpool.idle[s->is_inflate][s->bits];
+    fio___http_zpool.idle[s->is_inflate][s->bits] = s;
+    ++fio___http_zpool.count[s->is_inflate][s->bits];
+    if (!fio___http_zpool.at_exit) {
+      fio___http_zpool.at_exit = 1;
+      fio_state_callback_add(FIO_CALL_AT_EXIT, fio___http_zpool_destroy, NULL);
+    }
+    s = NULL;
+  }
+  FIO___LOCK_UNLOCK(fio___http_zpool.lock);
+  if (s)
+    fio___http_zstream_destroy(s);
 }
 
-FIO_IFUNC int fio___http_on_http_test4upgrade(fio_http_s *h,
-                                              fio___http_connection_s *c) {
-  union {
-    int (*fn)(fio_http_s *);
-    void *ptr;
-  } cb;
-  if (fio_http_websocket_requested(h))
-    goto websocket_requested;
-  if (fio_http_sse_requested(h))
-    goto sse_requested;
-  return 0;
-websocket_requested:
-  cb.fn = c->settings->on_authenticate_websocket;
-  fio_queue_push(c->queue,
-                 fio___http_perform_user_upgrade_callback_websocket,
-                 cb.ptr,
-                 (void *)h);
-  return -1;
+/* *****************************************************************************
+WebSocket Compression - compressing / decompressing messages
+***************************************************************************** */
 
-sse_requested:
-  cb.fn = c->settings->on_authenticate_sse;
-  fio_queue_push(c->queue,
-                 fio___http_perform_user_upgrade_callback_sse,
-                 cb.ptr,
-                 (void *)h);
-  return -1;
+/** Compresses a message into a complete WebSocket frame (a `fio_bstr`). */
+FIO_SFUNC char *fio___http_ws_deflate_frame(z_stream *z,
+                                            const void *buf,
+                                            size_t len,
+                                            unsigned char opcode,
+                                            uint8_t is_client) {
+  const size_t head = 14; /* room for the longest frame header (masked) */
+  size_t capa, pos = head;
+  char *f;
+  char header[16];
+  int r;
+  if (len > (1ULL << 30))
+    return NULL;
+  capa = head + (size_t)deflateBound(z, (uLong)len) + 16;
+  f = fio_bstr_reserve(NULL, capa);
+  z->next_in = (Bytef *)buf;
+  z->avail_in = (uInt)len;
+  for (;;) {
+    z->next_out = (Bytef *)f + pos;
+    z->avail_out = (uInt)(capa - pos);
+    r = deflate(z, Z_SYNC_FLUSH);
+    pos = capa - z->avail_out;
+    if (r != Z_OK && r != Z_BUF_ERROR)
+      goto error;
+    if (z->avail_out) /* flushed, with room to spare */
+      break;
+    f = fio_bstr_reserve(fio_bstr_len_set(f, pos), (capa >> 1));
+    capa += (capa >> 1);
+  }
+  /* remove the 0x00 0x00 0xFF 0xFF flush marker (RFC 7692, section 7.2.1) */
+  if (pos - head < 4)
+    goto error;
+  pos -= 4;
+  if (is_client) { /* mask the payload in place */
+    uint64_t mask = (fio_rand64() | 0x01020408ULL) & 0xFFFFFFFFULL;
+    mask |= mask << 32;
+    r = (int)fio_websocket_header(header,
+                                  pos - head,
+                                  (uint32_t)mask,
+                                  opcode,
+                                  1,
+                                  1,
+                                  4);
+    fio_xmask(f + head, pos - head, mask);
+  } else {
+    r = (int)fio_websocket_header(header, pos - head, 0, opcode, 1, 1, 4);
+  }
+  FIO_MEMMOVE(f + r, f + head, pos - head);
+  FIO_MEMCPY(f, header, (size_t)r);
+  return fio_bstr_len_set(f, (pos - head) + (size_t)r);
 
-#if 0
-http2_requested:
-  // Connection: Upgrade, HTTP2-Settings
-  // Upgrade: h2c
-  // HTTP2-Settings: <base64url encoding of HTTP/2 SETTINGS payload>
-  return 0; /* allowed to ignore upgrade request */
-#endif
+error:
+  FIO_LOG_ERROR("WebSocket message compression failed (%d)", r);
+  fio_bstr_free(f);
+  return NULL;
 }
 
-FIO_SFUNC void fio___http_on_http_direct(void *h_, void *ignr) {
-  fio_http_s *h = (fio_http_s *)h_;
-  fio_http_status_set(h, 200);
-  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
-  if (fio___http_on_http_test4upgrade(h, c))
+/** Decompresses a message into a new `fio_bstr`, up to `limit` bytes. */
+FIO_SFUNC char *fio___http_ws_inflate(z_stream *z,
+                                      fio_buf_info_s msg,
+                                      size_t limit) {
+  static const char tail[4] = {0, 0, (char)0xFF, (char)0xFF};
+  size_t capa = (msg.len << 2) + 64, pos = 0;
+  char *r;
+  if (capa > limit + 1)
+    capa = limit + 1;
+  r = fio_bstr_reserve(NULL, capa);
+  /* re-append the flush marker removed by the sender (RFC 7692, 7.2.2) */
+  for (size_t i = 0; i < 2; ++i) {
+    z->next_in = (Bytef *)(i ? tail : msg.buf);
+    z->avail_in = (uInt)(i ? 4 : msg.len);
+    for (;;) {
+      int e;
+      z->next_out = (Bytef *)r + pos;
+      z->avail_out = (uInt)(capa - pos);
+      e = inflate(z, Z_SYNC_FLUSH);
+      pos = capa - z->avail_out;
+      if (e == Z_STREAM_END) { /* a final block, nothing may follow */
+        inflateReset(z);
+        goto done;
+      }
+      if (e != Z_OK && e != Z_BUF_ERROR)
+        goto error;
+      if (pos > limit)
+        goto error;
+      if (!z->avail_in && z->avail_out)
+        break;
+      if (z->avail_out) /* no progress - corrupt data */
+        goto error;
+      r = fio_bstr_reserve(fio_bstr_len_set(r, pos), capa);
+      capa <<= 1;
+      if (capa > limit + 1)
+        capa = limit + 1;
+    }
+  }
+done:
+  return fio_bstr_len_set(r, pos);
+error:
+  FIO_LOG_DDEBUG2("WebSocket message decompression failed (or too long).");
+  fio_bstr_free(r);
+  return NULL;
+}
+
+/* *****************************************************************************
+WebSocket Compression - connection state
+***************************************************************************** */
+
+/** Server side: accepts the first supported offer (a response header). */
+FIO_SFUNC void fio___http_ws_deflate_negotiate(fio_http_s *h,
+                                               fio_http_settings_s *s) {
+  FIO_HTTP_HEADER_EACH_VALUE(h,
+                             1,
+                             FIO_STR_INFO2((char *)"sec-websocket-extensions",
+                                           24),
+                             val) {
+    fio___http_ws_deflate_params_s o;
+    FIO_STR_INFO_TMP_VAR(r, 160);
+    if (!FIO_STR_INFO_IS_EQ(val,
+                            FIO_STR_INFO2((char *)"permessage-deflate", 18)) ||
+        fio___http_ws_deflate_params(&o, val))
+      continue;
+    if (o.server_bits == 8)
+      continue; /* zlib can't compress using a 256 byte window */
+    fio_string_write(&r, NULL, "permessage-deflate", 18);
+    if (o.server_reset || s->ws_deflate_no_context_takeover)
+      fio_string_write(&r, NULL, "; server_no_context_takeover", 28);
+    if (o.client_reset || s->ws_deflate_no_context_takeover)
+      fio_string_write(&r, NULL, "; client_no_context_takeover", 28);
+    /* a window smaller than requested is always valid for compression */
+    if (o.server_bits)
+      fio_string_write2(
+          &r,
+          NULL,
+          FIO_STRING_WRITE_STR2("; server_max_window_bits=", 25),
+          FIO_STRING_WRITE_UNUM(
+              (o.server_bits < s->ws_deflate ? o.server_bits : s->ws_deflate)));
+    /* limits the client's window (the memory used for decompression) */
+    if (o.client_bits)
+      fio_string_write2(
+          &r,
+          NULL,
+          FIO_STRING_WRITE_STR2("; client_max_window_bits=", 25),
+          FIO_STRING_WRITE_UNUM(
+              (o.client_bits < s->ws_deflate ? o.client_bits : s->ws_deflate)));
+    fio_http_response_header_set(
+        h,
+        FIO_STR_INFO2((char *)"sec-websocket-extensions", 24),
+        r);
     return;
-  union {
-    void (*fn)(fio_http_s *);
-    void *ptr;
-  } cb = {.fn = c->state.http.on_http};
-  fio_queue_push(c->queue, fio___http_perform_user_callback, cb.ptr, (void *)h);
-  (void)ignr;
+  }
 }
 
-FIO_SFUNC void fio___http_on_http_with_public_folder(void *h_, void *ignr) {
-  fio_http_s *h = (fio_http_s *)h_;
-  fio_http_status_set(h, 200);
-  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
-  if (fio___http_on_http_test4upgrade(h, c))
+/** Sets up the compression state according to the negotiated response. */
+FIO_SFUNC void fio___http_ws_deflate_setup(fio___http_connection_s *c) {
+  fio___http_ws_deflate_s *d = &c->state.ws.deflate;
+  *d = (fio___http_ws_deflate_s){.lock = FIO___LOCK_INIT};
+  if (!c->settings->ws_deflate || !c->h)
     return;
-  if ((fio_http_method(h).len != 4 || (fio_buf2u32u(fio_http_method(h).buf) |
-                                       0x20202020UL) != fio_buf2u32u("post")) &&
-      !fio_http_static_file_response(h,
-                                     c->settings->public_folder,
-                                     fio_http_path(h),
-                                     c->settings->max_age)) {
-    fio_http_free(h);
+  FIO_HTTP_HEADER_EACH_VALUE(c->h,
+                             0,
+                             FIO_STR_INFO2((char *)"sec-websocket-extensions",
+                                           24),
+                             val) {
+    fio___http_ws_deflate_params_s o;
+    if (!FIO_STR_INFO_IS_EQ(val,
+                            FIO_STR_INFO2((char *)"permessage-deflate", 18)) ||
+        fio___http_ws_deflate_params(&o, val) || o.client_bits == 16)
+      continue;
+    uint8_t tx = (c->is_client ? o.client_bits : o.server_bits);
+    uint8_t rx = (c->is_client ? o.server_bits : o.client_bits);
+    if (!tx || tx > c->settings->ws_deflate)
+      tx = c->settings->ws_deflate;
+    d->tx_bits = (tx > 8) ? tx : 0; /* 8 bits: decompress only */
+    d->rx_bits = rx ? rx : 15;
+    d->tx_reset = (c->is_client ? o.client_reset : o.server_reset) |
+                  c->settings->ws_deflate_no_context_takeover;
+    d->rx_reset = (c->is_client ? o.server_reset : o.client_reset);
+    d->min = (c->settings->ws_deflate_min < 0xFFFFFFFFUL)
+                 ? (uint32_t)c->settings->ws_deflate_min
+                 : 0xFFFFFFFFUL;
+    FIO_LOG_DDEBUG2("(%d) WebSocket permessage-deflate: %u/%u bits%s%s",
+                    fio_io_pid(),
+                    (unsigned)d->tx_bits,
+                    (unsigned)d->rx_bits,
+                    (d->tx_reset ? ", no tx context" : ""),
+                    (d->rx_reset ? ", no rx context" : ""));
     return;
   }
-  union {
-    void (*fn)(fio_http_s *);
-    void *ptr;
-  } cb = {.fn = c->state.http.on_http};
-  fio_queue_push(c->queue, fio___http_perform_user_callback, cb.ptr, (void *)h);
-  (void)ignr;
 }
 
-FIO_SFUNC void fio___http_perform_user_callback_client(void *cb_, void *h_) {
-  fio_http_s *h = (fio_http_s *)h_;
-  union {
-    void (*fn)(fio_http_s *);
-    void *ptr;
-  } cb = {.ptr = cb_};
-  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
-  /* unlike Server mode, handle responses from closed connections */
-  cb.fn(h);
-  fio_http_free(h);
-  fio_io_free(c->io);
+/** Frees any compression state (returning zlib streams to the pool). */
+FIO_SFUNC void fio___http_ws_deflate_destroy(fio___http_ws_deflate_s *d) {
+  fio___http_zstream_free((fio___http_zstream_s *)d->tx);
+  fio___http_zstream_free((fio___http_zstream_s *)d->rx);
+  d->tx = d->rx = NULL;
+  FIO___LOCK_DESTROY(d->lock);
 }
 
-FIO_SFUNC void fio___http_on_http_client(void *h_, void *ignr) {
-  fio_http_s *h = (fio_http_s *)h_;
-  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
-  size_t pr = FIO___HTTP_PROTOCOL_WS;
-  union {
-    void (*fn)(fio_http_s *);
-    void *ptr;
-  } cb = {.fn = c->state.http.on_http};
-
-  /* TODO! review WS and SSE responses. */
-  if (fio_http_websocket_accepted(h))
-    goto websocket_accepted;
-  if (fio_http_sse_accepted(h))
-    goto sse_accepted;
-  fio_queue_push(c->queue,
-                 fio___http_perform_user_callback_client,
-                 cb.ptr,
-                 (void *)h);
-  return;
-  (void)ignr;
-
-sse_accepted:
-  pr = FIO___HTTP_PROTOCOL_SSE;
+/** Writes a compressed message. Returns -1 if the message wasn't written. */
+FIO_SFUNC int fio___http_ws_deflate_write(fio___http_connection_s *c,
+                                          const void *buf,
+                                          size_t len,
+                                          unsigned char opcode) {
+  fio___http_ws_deflate_s *d = &c->state.ws.deflate;
+  fio___http_zstream_s *z;
+  char *frame = NULL;
+  /* compression and write order MUST match when the context is kept */
+  FIO___LOCK_LOCK(d->lock);
+  z = (fio___http_zstream_s *)d->tx;
+  if (!z)
+    z = fio___http_zstream_new(0, d->tx_bits);
+  if (z)
+    frame = fio___http_ws_deflate_frame(&z->z, buf, len, opcode, c->is_client);
+  if (d->tx_reset || !frame) { /* a reset compressor is always valid */
+    fio___http_zstream_free(z);
+    z = NULL;
+  }
+  d->tx = (void *)z;
+  if (frame)
+    fio_io_write2(c->io,
+                  .buf = frame,
+                  .len = fio_bstr_len(frame),
+                  .dealloc = (void (*)(void *))fio_bstr_free);
+  FIO___LOCK_UNLOCK(d->lock);
+  return 0 - !frame;
+}
+
+/** Decompresses a message, returning a new `fio_bstr` (or NULL on error). */
+FIO_SFUNC char *fio___http_ws_deflate_read(fio___http_connection_s *c,
+                                           fio_buf_info_s msg) {
+  fio___http_ws_deflate_s *d = &c->state.ws.deflate;
+  fio___http_zstream_s *z = (fio___http_zstream_s *)d->rx;
+  char *r = NULL;
+  if (!z)
+    z = fio___http_zstream_new(1, d->rx_bits);
+  if (z)
+    r = fio___http_ws_inflate(&z->z, msg, c->settings->ws_max_msg_size);
+  if (d->rx_reset || !r) {
+    fio___http_zstream_free(z);
+    z = NULL;
+  }
+  d->rx = (void *)z;
+  return r;
+}
 
-websocket_accepted:
-  c->h = h; /* was set to NULL in `on_http_complete` */
-  fio_http_controller_set(
-      c->h,
-      &(FIO_PTR_FROM_FIELD(fio___http_protocol_s, settings, c->settings)
-            ->state[pr]
-            .controller));
-  fio_io_protocol_set(
-      c->io,
-      &(FIO_PTR_FROM_FIELD(fio___http_protocol_s, settings, c->settings)
-            ->state[pr]
-            .protocol));
+#else /* HAVE_ZLIB */
 
-  FIO_LOG_DDEBUG2("(%d) Client %s upgrade complete for fd %d",
-                  fio_io_pid(),
-                  (fio_http_is_websocket(h) ? "WebSocket" : "SSE"),
-                  fio_io_fd(c->io));
+FIO_SFUNC void fio___http_ws_deflate_setup(fio___http_connection_s *c) {
+  c->state.ws.deflate = (fio___http_ws_deflate_s){.lock = FIO___LOCK_INIT};
+}
 
-  fio_io_free(c->io); /* fio_dup called by fio_http1_on_complete */
-  c->suspend = 0;
-  fio_io_unsuspend(c->io);
+FIO_SFUNC void fio___http_ws_deflate_destroy(fio___http_ws_deflate_s *d) {
+  FIO___LOCK_DESTROY(d->lock);
 }
+#endif /* HAVE_ZLIB */
 
 /* *****************************************************************************
-ALPN Helpers
-***************************************************************************** */
+HTTP Response Compression (HTTP/1.x server connections)
 
-FIO_SFUNC void fio___http_on_select_h1(fio_io_s *io) {
-  FIO_LOG_DDEBUG2("TLS ALPN HTTP/1.1 selected for %p", io);
-  fio___http_connection_s *c = (fio___http_connection_s *)fio_io_udata(io);
-  fio_io_protocol_set(
-      io,
-      &(FIO_PTR_FROM_FIELD(fio___http_protocol_s, settings, c->settings)
-            ->state[FIO___HTTP_PROTOCOL_HTTP1]
-            .protocol));
-}
-FIO_SFUNC void fio___http_on_select_h2(fio_io_s *io) {
-  FIO_LOG_ERROR("TLS ALPN HTTP/2 not supported for %p", io);
-  (void)io;
-}
+Complete responses are compressed in one pass once the body is written (the
+headers wait for the body, so `content-length` is correct). Streaming responses
+keep a compressor for the response, flushing it with every chunk.
 
-/* *****************************************************************************
-HTTP Listen
+gzip streams are pooled (see the zlib stream pool). brotli encoders can't be
+reset, so they're allocated per response.
 ***************************************************************************** */
 
-static void fio___http_listen_on_start(fio_io_protocol_s *protocol, void *u) {
-  (void)u;
-  fio___http_protocol_s *p = (fio___http_protocol_s *)protocol;
-  p->queue = ((p->settings.queue && p->settings.queue->q) ? p->settings.queue->q
-                                                          : fio_io_queue());
-}
+#define FIO___HTTP_ZIP_GZIP 1
+#define FIO___HTTP_ZIP_BR   2
 
-static void fio___http_listen_on_stop(fio_io_protocol_s *p, void *u) {
-  (void)u;
-  fio___http_protocol_free(
-      FIO_PTR_FROM_FIELD(fio___http_protocol_s,
-                         state[FIO___HTTP_PROTOCOL_ACCEPT].protocol,
-                         p));
+/** Returns the preferred content encoding accepted by the client (or 0). */
+FIO_SFUNC uint8_t fio___http_zip_accepted(fio_http_s *h) {
+  uint8_t r = 0;
+  FIO_HTTP_HEADER_EACH_VALUE(h,
+                             1,
+                             FIO_STR_INFO2((char *)"accept-encoding", 15),
+                             val) {
+    uint8_t e = 0;
+#if HAVE_ZLIB
+    if (FIO_STR_INFO_IS_EQ(val, FIO_STR_INFO2((char *)"gzip", 4)))
+      e = FIO___HTTP_ZIP_GZIP;
+#endif
+#if HAVE_BROTLI
+    if (FIO_STR_INFO_IS_EQ(val, FIO_STR_INFO2((char *)"br", 2)))
+      e = FIO___HTTP_ZIP_BR;
+#endif
+    if (e <= r)
+      continue;
+    FIO_HTTP_HEADER_VALUE_EACH_PROPERTY(val, prop) { /* test for `q=0` */
+      size_t i = 0;
+      if (prop.name.len != 1 || (prop.name.buf[0] | 0x20) != 'q')
+        continue;
+      while (i < prop.value.len &&
+             (prop.value.buf[i] == '0' || prop.value.buf[i] == '.'))
+        ++i;
+      if (i == prop.value.len)
+        e = 0;
+    }
+    if (e > r)
+      r = e;
+  }
+  return r;
 }
 
-void fio_http_listen___(void); /* IDE marker */
-SFUNC void *fio_http_listen FIO_NOOP(const char *url, fio_http_settings_s s) {
-  http_settings_validate(&s, 0);
-  fio___http_protocol_s *p = fio___http_protocol_new(s.public_folder.len + 1);
-  fio___http_protocol_init(p, url, s, 0);
-  void *listener =
-      fio_io_listen(.url = url,
-                    .protocol = &p->state[FIO___HTTP_PROTOCOL_ACCEPT].protocol,
-                    .tls = s.tls,
-                    .on_start = fio___http_listen_on_start,
-                    .on_stop = fio___http_listen_on_stop,
-                    .queue_for_accept = p->settings.queue);
-  return listener;
+/** Returns true if the content type is textual (worth compressing). */
+FIO_SFUNC int fio___http_zip_is_text(fio_str_info_s t) {
+  static const char *subtypes[] = {"json", "javascript", "xml", NULL};
+  char *end = t.buf + t.len;
+  if (t.len > 5 && (fio_buf2u32u(t.buf) | 0x20202020UL) ==
+                       fio_buf2u32u("text") &&
+      t.buf[4] == '/')
+    return 1;
+  for (char *pos = t.buf; pos < end && *pos != ';'; ++pos)
+    for (size_t i = 0; subtypes[i]; ++i) {
+      size_t len = strlen(subtypes[i]);
+      if ((size_t)(end - pos) >= len && !FIO_MEMCMP(pos, subtypes[i], len))
+        return 1;
+    }
+  return 0;
 }
 
-/** Returns the a pointer to the HTTP settings associated with the listener. */
-SFUNC fio_http_settings_s *fio_http_listener_settings(void *listener) {
-  fio___http_protocol_s *p =
-      FIO_PTR_FROM_FIELD(fio___http_protocol_s,
-                         state[FIO___HTTP_PROTOCOL_ACCEPT].protocol,
-                         fio_io_listener_protocol(listener));
-  return &p->settings;
+/** Creates a response compressor (pooled, for gzip). */
+FIO_SFUNC void *fio___http_zip_new(uint8_t type, uint8_t level, size_t hint) {
+#if HAVE_ZLIB
+  if (type == FIO___HTTP_ZIP_GZIP)
+    return (void *)fio___http_zstream_new(2, level);
+#endif
+#if HAVE_BROTLI
+  if (type == FIO___HTTP_ZIP_BR) {
+    BrotliEncoderState *b = BrotliEncoderCreateInstance(NULL, NULL, NULL);
+    if (!b)
+      return NULL;
+    BrotliEncoderSetParameter(b, BROTLI_PARAM_QUALITY, (uint32_t)level);
+    BrotliEncoderSetParameter(b, BROTLI_PARAM_LGWIN, FIO_HTTP_BROTLI_WINDOW);
+    if (hint && hint < (1UL << 30))
+      BrotliEncoderSetParameter(b, BROTLI_PARAM_SIZE_HINT, (uint32_t)hint);
+    return (void *)b;
+  }
+#endif
+  return NULL;
+  (void)type, (void)level, (void)hint;
 }
-/* *****************************************************************************
-HTTP Connect
-***************************************************************************** */
 
-static void fio___http_connect_on_failed(fio_io_protocol_s *p, void *udata) {
-  fio___http_connection_s *c = (fio___http_connection_s *)udata;
-  fio_http_free(c->h);
-  c->h = NULL;
-  fio___http_connection_free(c);
-  (void)p;
+/** Frees a response compressor (returning zlib streams to the pool). */
+FIO_SFUNC void fio___http_zip_free(uint8_t type, void *zip) {
+  if (!zip)
+    return;
+#if HAVE_ZLIB
+  if (type == FIO___HTTP_ZIP_GZIP)
+    fio___http_zstream_free((fio___http_zstream_s *)zip);
+#endif
+#if HAVE_BROTLI
+  if (type == FIO___HTTP_ZIP_BR)
+    BrotliEncoderDestroyInstance((BrotliEncoderState *)zip);
+#endif
+  (void)type;
 }
 
-void fio_http_connect___(void); /* IDE Marker */
+/** Compresses and flushes (or finishes) data, returns a `fio_bstr` or NULL. */
+FIO_SFUNC char *fio___http_zip(uint8_t type,
+                               void *zip,
+                               const void *buf,
+                               size_t len,
+                               int finish) {
+  size_t capa = len + (len >> 3) + 64, pos = 0;
+  char *r;
+  if (len > (1ULL << 30))
+    return NULL;
+  r = fio_bstr_reserve(NULL, capa);
+#if HAVE_ZLIB
+  if (type == FIO___HTTP_ZIP_GZIP) {
+    z_stream *z = &((fio___http_zstream_s *)zip)->z;
+    z->next_in = (Bytef *)buf;
+    z->avail_in = (uInt)len;
+    for (;;) {
+      int e;
+      z->next_out = (Bytef *)r + pos;
+      z->avail_out = (uInt)(capa - pos);
+      e = deflate(z, (finish ? Z_FINISH : Z_SYNC_FLUSH));
+      pos = capa - z->avail_out;
+      if (e == Z_STREAM_END)
+        break;
+      if (e != Z_OK && e != Z_BUF_ERROR)
+        goto error;
+      if (z->avail_out && !finish) /* flushed, with room to spare */
+        break;
+      r = fio_bstr_reserve(fio_bstr_len_set(r, pos), (capa >> 1));
+      capa += (capa >> 1);
+    }
+    return fio_bstr_len_set(r, pos);
+  }
+#endif
+#if HAVE_BROTLI
+  if (type == FIO___HTTP_ZIP_BR) {
+    BrotliEncoderState *b = (BrotliEncoderState *)zip;
+    const uint8_t *next_in = (const uint8_t *)buf;
+    size_t avail_in = len;
+    for (;;) {
+      uint8_t *next_out = (uint8_t *)r + pos;
+      size_t avail_out = capa - pos;
+      if (!BrotliEncoderCompressStream(
+              b,
+              (finish ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_FLUSH),
+              &avail_in,
+              &next_in,
+              &avail_out,
+              &next_out,
+              NULL))
+        goto error;
+      pos = capa - avail_out;
+      if (!avail_in && !BrotliEncoderHasMoreOutput(b) &&
+          (!finish || BrotliEncoderIsFinished(b)))
+        break;
+      if (avail_out)
+        continue;
+      r = fio_bstr_reserve(fio_bstr_len_set(r, pos), (capa >> 1));
+      capa += (capa >> 1);
+    }
+    return fio_bstr_len_set(r, pos);
+  }
+#endif
+#if HAVE_ZLIB || HAVE_BROTLI
+error:
+  FIO_LOG_ERROR("HTTP response compression failed");
+#endif
+  fio_bstr_free(r);
+  return NULL;
+  (void)type, (void)zip, (void)buf, (void)finish, (void)pos;
+}
+
+/** Weakens a strong `etag`, as the compressed body isn't byte-identical. */
+FIO_SFUNC void fio___http_zip_etag(fio_http_s *h) {
+  fio_str_info_s etag =
+      fio_http_response_header(h, FIO_STR_INFO2((char *)"etag", 4), 0);
+  char *tmp;
+  if (!etag.len || etag.buf[0] != '"')
+    return; /* no `etag`, or already weak (`W/"..."`) */
+  tmp = fio_bstr_write2(NULL,
+                        FIO_STRING_WRITE_STR2("W/", 2),
+                        FIO_STRING_WRITE_STR_INFO(etag));
+  fio_http_response_header_set(h,
+                               FIO_STR_INFO2((char *)"etag", 4),
+                               fio_bstr_info(tmp));
+  fio_bstr_free(tmp);
+}
+
+/**
+ * Selects the response's content encoding (called before sending headers).
+ *
+ * Returns true if the headers should be sent with the (compressed) body.
+ */
+FIO_SFUNC int fio___http_zip_start(fio___http_connection_s *c, fio_http_s *h) {
+  size_t status = fio_http_status(h);
+  fio_str_info_s v;
+  uint8_t type;
+  c->state.http.zip_type = 0;
+  if (status < 200 || status == 204 || status == 206 || status == 304)
+    return 0;
+  v = fio_http_method(h);
+  if (v.len == 4 &&
+      (fio_buf2u32u(v.buf) | 0x20202020UL) == fio_buf2u32u("head"))
+    return 0;
+  if (fio_http_response_header(h,
+                               FIO_STR_INFO2((char *)"content-encoding", 16),
+                               0)
+          .len ||
+      !fio___http_zip_is_text(
+          fio_http_response_header(h,
+                                   FIO_STR_INFO2((char *)"content-type", 12),
+                                   0)))
+    return 0;
+  if (!fio_http_is_streaming(h)) {
+    v = fio_http_response_header(h,
+                                 FIO_STR_INFO2((char *)"content-length", 14),
+                                 0);
+    if (!v.len || fio_atol10u(&v.buf) < c->settings->compress_min)
+      return 0;
+  }
+  /* the response depends on `accept-encoding`, even if sent uncompressed */
+  fio_http_response_header_add(h,
+                               FIO_STR_INFO2((char *)"vary", 4),
+                               FIO_STR_INFO2((char *)"accept-encoding", 15));
+  if (!(type = fio___http_zip_accepted(h)))
+    return 0;
+  if (!fio_http_is_streaming(h)) {
+    c->state.http.zip_type = type;
+    return 1;
+  }
+  c->state.http.zip = fio___http_zip_new(type, c->settings->compress, 0);
+  if (!c->state.http.zip)
+    return 0;
+  c->state.http.zip_type = type;
+  fio___http_zip_etag(h);
+  fio_http_response_header_set(
+      h,
+      FIO_STR_INFO2((char *)"content-encoding", 16),
+      (type == FIO___HTTP_ZIP_GZIP ? FIO_STR_INFO2((char *)"gzip", 4)
+                                   : FIO_STR_INFO2((char *)"br", 2)));
+  return 0;
+}
+
+/** Compresses a streaming response chunk, returns true if nothing is left. */
+FIO_SFUNC int fio___http_zip_chunk(fio___http_connection_s *c,
+                                   fio_http_write_args_s *args) {
+  char *tmp = NULL, *out;
+  const char *buf = (const char *)args->buf + args->offset;
+  size_t len = args->len;
+  if (!args->buf) {
+    if ((uint32_t)(args->fd + 1) <= 1U)
+      return 0; /* no data */
+    tmp = fio_bstr_readfd(NULL,
+                          args->fd,
+                          (intptr_t)args->offset,
+                          (intptr_t)args->len);
+    if (!args->copy)
+      close(args->fd);
+    buf = tmp;
+    len = fio_bstr_len(tmp);
+  }
+  out = (len ? fio___http_zip(c->state.http.zip_type,
+                              c->state.http.zip,
+                              buf,
+                              len,
+                              0)
+             : NULL);
+  fio_bstr_free(tmp);
+  if (args->buf && args->dealloc)
+    args->dealloc((void *)args->buf);
+  if (!fio_bstr_len(out)) {
+    fio_bstr_free(out);
+    return 1;
+  }
+  *args = (fio_http_write_args_s){
+      .buf = out,
+      .len = fio_bstr_len(out),
+      .dealloc = (void (*)(void *))fio_bstr_free,
+      .finish = args->finish,
+  };
+  return 0;
+}
+
+/** Finishes a streaming response's compression, writing the last chunk. */
+FIO_SFUNC void fio___http_zip_finish(fio___http_connection_s *c) {
+  char *out = NULL;
+  if (c->state.http.zip)
+    out = fio___http_zip(c->state.http.zip_type,
+                         c->state.http.zip,
+                         NULL,
+                         0,
+                         1);
+  fio___http_zip_free(c->state.http.zip_type, c->state.http.zip);
+  c->state.http.zip = NULL;
+  c->state.http.zip_type = 0;
+  if (fio_bstr_len(out))
+    fio_string_write2(&c->state.http.buf,
+                      FIO_STRING_REALLOC,
+                      FIO_STRING_WRITE_HEX(fio_bstr_len(out)),
+                      FIO_STRING_WRITE_STR2("\r\n", 2),
+                      FIO_STRING_WRITE_STR2(out, fio_bstr_len(out)),
+                      FIO_STRING_WRITE_STR2("\r\n", 2));
+  fio_bstr_free(out);
+}
+
+/* *****************************************************************************
+HTTP Response Cache (HTTP/1.x server connections)
+
+Responses to `GET` requests are recorded (serialized) while sent and later
+requests with the same key (path, query and `cache_vary` request headers) are
+answered using a zero-copy write of the (reference counted) recorded response.
+
+While a response is recorded, its entry is "pending" and requests for the same
+key wait in the entry's `waiting` list (request coalescing). Responses that
+can't be cached leave a "pass" entry, so requests bypass the cache (and the
+waiting list) until the entry expires.
+***************************************************************************** */
+
+/* a cache entry - pending (no `data`), a cached response or a "pass" entry */
+struct fio___http_cache_entry_s {
+  volatile uint32_t ref;
+  FIO_LIST_NODE node;    /* LRU list (if cached or "pass", not if pending) */
+  FIO_LIST_HEAD waiting; /* requests waiting for a pending entry */
+  fio___http_cache_s *cache;
+  char *key;       /* the cache key (fio_bstr) */
+  char *data;      /* the serialized response (fio_bstr) */
+  int64_t expires; /* expiration time (in milliseconds, `fio_io_last_tick`) */
+  uint64_t hash;
+  size_t mem;      /* memory counted against the cache limit */
+  size_t status;   /* the response status */
+  uint8_t pass;    /* the response couldn't be cached, bypass the cache */
+};
+
+/* a request waiting for a pending entry (request coalescing). */
+typedef struct {
+  FIO_LIST_NODE node;
+  fio_http_s *h;
+} fio___http_cache_waiting_s;
+
+FIO_LEAK_COUNTER_DEF(fio___http_cache_entry_s)
+FIO_LEAK_COUNTER_DEF(fio___http_cache_waiting_s)
+FIO_LEAK_COUNTER_DEF(fio___http_cache_s)
+
+FIO_SFUNC void fio___http_cache_entry_free(fio___http_cache_entry_s *e) {
+  if (fio_atomic_sub_fetch(&e->ref, 1))
+    return;
+  fio_bstr_free(e->key);
+  fio_bstr_free(e->data);
+  FIO_LEAK_COUNTER_ON_FREE(fio___http_cache_entry_s);
+  FIO_MEM_FREE_(e, sizeof(*e));
+}
+
+/* called (under lock) when an entry is removed from the cache's map */
+FIO_SFUNC void fio___http_cache_unlink(fio___http_cache_entry_s *e);
+
+#define FIO___RECURSIVE_INCLUDE  1
+#define FIO_MAP_NAME             fio___http_cache_map
+#define FIO_MAP_KEY_BSTR         /* the cache key */
+#define FIO_MAP_VALUE            fio___http_cache_entry_s *
+#define FIO_MAP_VALUE_DESTROY(o) fio___http_cache_unlink((o))
+#include FIO_INCLUDE_FILE
+#undef FIO___RECURSIVE_INCLUDE
+
+struct fio___http_cache_s {
+  fio___http_cache_map_s map;
+  FIO_LIST_HEAD lru; /* cached and "pass" entries, least recently used first */
+  size_t mem;
+  size_t limit;
+  int64_t ttl;   /* in milliseconds */
+  char *vary;    /* the (lower case) `cache_vary` list (fio_bstr) */
+  uint16_t ttl_sec;
+  FIO___LOCK_TYPE lock;
+};
+
+FIO_SFUNC void fio___http_cache_unlink(fio___http_cache_entry_s *e) {
+  if (!FIO_LIST_IS_EMPTY(&e->node)) { /* counted while in the LRU list */
+    e->cache->mem -= e->mem;
+    FIO_LIST_REMOVE_RESET(&e->node);
+  }
+  fio___http_cache_entry_free(e);
+}
+
+FIO_SFUNC fio___http_cache_s *fio___http_cache_new(fio_http_settings_s *s) {
+  fio___http_cache_s *cache =
+      (fio___http_cache_s *)FIO_MEM_REALLOC_(NULL, 0, sizeof(*cache), 0);
+  FIO_ASSERT_ALLOC(cache);
+  FIO_LEAK_COUNTER_ON_ALLOC(fio___http_cache_s);
+  *cache = (fio___http_cache_s){
+      .lru = FIO_LIST_INIT(cache->lru),
+      .limit = s->cache_limit,
+      .ttl = (int64_t)s->cache_ttl * 1000,
+      .ttl_sec = s->cache_ttl,
+      .lock = FIO___LOCK_INIT,
+  };
+  cache->vary = fio_bstr_write(NULL, s->cache_vary.buf, s->cache_vary.len);
+  for (size_t i = 0; i < fio_bstr_len(cache->vary); ++i)
+    if (cache->vary[i] >= 'A' && cache->vary[i] <= 'Z')
+      cache->vary[i] |= 0x20;
+  s->cache_vary = fio_bstr_info(cache->vary); /* settings may be freed */
+  return cache;
+}
+
+FIO_SFUNC void fio___http_cache_free(fio___http_cache_s *cache) {
+  fio___http_cache_map_destroy(&cache->map);
+  FIO___LOCK_DESTROY(cache->lock);
+  fio_bstr_free(cache->vary);
+  FIO_LEAK_COUNTER_ON_FREE(fio___http_cache_s);
+  FIO_MEM_FREE_(cache, sizeof(*cache));
+}
+
+FIO_IFUNC fio___http_cache_s *fio___http_cache(fio___http_connection_s *c) {
+  return FIO_PTR_FROM_FIELD(fio___http_protocol_s, settings, c->settings)
+      ->cache;
+}
+
+/* consumes the next token in a comma separated list, returns 0 when done. */
+FIO_SFUNC int fio___http_cache_token(fio_str_info_s *list, fio_str_info_s *t) {
+  char *pos = list->buf;
+  char *end = list->buf + list->len;
+  while (pos < end && (*pos == ',' || *pos == ' ' || *pos == '\t'))
+    ++pos;
+  if (pos >= end)
+    return 0;
+  t->buf = pos;
+  while (pos < end && *pos != ',')
+    ++pos;
+  t->len = (size_t)(pos - t->buf);
+  while (t->buf[t->len - 1] == ' ' || t->buf[t->len - 1] == '\t')
+    --t->len;
+  *list = FIO_STR_INFO2(pos, (size_t)(end - pos));
+  return 1;
+}
+
+/* returns true if `t` starts with the lower case `s` (case insensitive). */
+FIO_IFUNC int fio___http_cache_token_is(fio_str_info_s t,
+                                        const char *s,
+                                        size_t len) {
+  if (t.len < len)
+    return 0;
+  for (size_t i = 0; i < len; ++i)
+    if ((t.buf[i] | 0x20) != s[i])
+      return 0;
+  return 1;
+}
+
+/* returns true if the header `name` is part of the cache key. */
+FIO_SFUNC int fio___http_cache_is_vary(fio___http_cache_s *cache,
+                                       fio_str_info_s name) {
+  fio_str_info_s list = fio_bstr_info(cache->vary), t;
+  while (fio___http_cache_token(&list, &t))
+    if (t.len == name.len && fio___http_cache_token_is(name, t.buf, t.len))
+      return 1;
+  return 0;
+}
+
+/* writes the request's cache key, returns -1 if the request bypasses cache. */
+FIO_SFUNC int fio___http_cache_key(fio___http_cache_s *cache,
+                                   fio_http_s *h,
+                                   fio_str_info_s *key) {
+  fio_str_info_s v = fio_http_method(h), t, list;
+  int r;
+  if (v.len != 3 || (v.buf[0] | 0x20) != 'g' || (v.buf[1] | 0x20) != 'e' ||
+      (v.buf[2] | 0x20) != 't')
+    return -1;
+  v = fio_http_version(h); /* the recorded status line includes the version */
+  if (v.len != 8 || fio_buf2u64u(v.buf) != fio_buf2u64u("HTTP/1.1"))
+    return -1;
+  v = fio_http_request_header(h,
+                              FIO_STR_INFO2((char *)"cache-control", 13),
+                              0);
+  while (fio___http_cache_token(&v, &t))
+    if (fio___http_cache_token_is(t, "no-cache", 8) ||
+        fio___http_cache_token_is(t, "no-store", 8))
+      return -1;
+  if (fio_http_request_header(h,
+                              FIO_STR_INFO2((char *)"authorization", 13),
+                              0)
+          .len &&
+      !fio___http_cache_is_vary(cache,
+                                FIO_STR_INFO2((char *)"authorization", 13)))
+    return -1;
+  /* NUL separators - header values can't contain NUL bytes */
+  v = fio_http_path(h);
+  r = fio_string_write(key, NULL, v.buf, v.len);
+  v = fio_http_query(h);
+  r |= fio_string_write(key, NULL, "\0", 1);
+  if (v.len)
+    r |= fio_string_write(key, NULL, v.buf, v.len);
+  list = fio_bstr_info(cache->vary);
+  while (fio___http_cache_token(&list, &t)) {
+    v = fio_http_request_header(h, t, 0);
+    r |= fio_string_write(key, NULL, "\0", 1);
+    if (v.len)
+      r |= fio_string_write(key, NULL, v.buf, v.len);
+  }
+  return r ? -1 : 0;
+}
+
+FIO_SFUNC int fio___http_cache_any_cookie(fio_http_s *h,
+                                          fio_str_info_s name,
+                                          fio_str_info_s value,
+                                          void *udata) {
+  return 1;
+  (void)h, (void)name, (void)value, (void)udata;
+}
+
+/* returns the time (in seconds) a response may be cached, 0 if it can't. */
+FIO_SFUNC size_t fio___http_cache_response_ttl(fio___http_cache_s *cache,
+                                               fio_http_s *h) {
+  size_t ttl = cache->ttl_sec, age = (size_t)-1, s_age = (size_t)-1;
+  fio_str_info_s v, t;
+  switch (fio_http_status(h)) { /* cacheable by default (RFC 9110) */
+  case 200: /* fall through */
+  case 203: /* fall through */
+  case 204: /* fall through */
+  case 300: /* fall through */
+  case 301: /* fall through */
+  case 308: break;
+  default: return 0;
+  }
+  if (fio_http_is_streaming(h) ||
+      fio_http_set_cookie_each(h, fio___http_cache_any_cookie, NULL))
+    return 0;
+  v = fio_http_response_header(h, FIO_STR_INFO2((char *)"vary", 4), 0);
+  while (fio___http_cache_token(&v, &t))
+    if (!fio___http_cache_is_vary(cache, t)) /* also tests for `*` */
+      return 0;
+  v = fio_http_response_header(h,
+                               FIO_STR_INFO2((char *)"cache-control", 13),
+                               0);
+  while (fio___http_cache_token(&v, &t)) {
+    char *pos;
+    if (fio___http_cache_token_is(t, "no-store", 8) ||
+        fio___http_cache_token_is(t, "no-cache", 8) ||
+        fio___http_cache_token_is(t, "private", 7))
+      return 0;
+    if (fio___http_cache_token_is(t, "s-maxage=", 9)) {
+      pos = t.buf + 9;
+      s_age = (size_t)fio_atol10u(&pos);
+    } else if (fio___http_cache_token_is(t, "max-age=", 8)) {
+      pos = t.buf + 8;
+      age = (size_t)fio_atol10u(&pos);
+    }
+  }
+  if (s_age != (size_t)-1)
+    age = s_age;
+  if (age < ttl)
+    ttl = age;
+  return ttl;
+}
+
+/* adds an entry to the LRU list and evicts entries over the limit (locked) */
+FIO_SFUNC void fio___http_cache_store(fio___http_cache_s *cache,
+                                      fio___http_cache_entry_s *e) {
+  FIO_LIST_PUSH(&cache->lru, &e->node);
+  cache->mem += e->mem;
+  while (cache->mem > cache->limit && cache->lru.next != &e->node) {
+    fio___http_cache_entry_s *old =
+        FIO_PTR_FROM_FIELD(fio___http_cache_entry_s, node, cache->lru.next);
+    if (fio___http_cache_map_remove(&cache->map,
+                                    old->hash,
+                                    fio_bstr_info(old->key),
+                                    NULL))
+      break;
+  }
+}
+
+FIO_SFUNC void fio___http_perform_user_callback(void *cb_, void *h_);
+
+/* sends a cached response to `h` (consumes a reference to `e` and `h`). */
+FIO_SFUNC void fio___http_cache_send(void *h_, void *e_) {
+  fio_http_s *h = (fio_http_s *)h_;
+  fio___http_cache_entry_s *e = (fio___http_cache_entry_s *)e_;
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  c->state.http.cache = e;
+  c->state.http.cache_hit = 1;
+  fio_http_status_set(h, e->status);
+  fio_http_finish(h); /* the controller writes `e->data` */
+  fio_http_free(h);
+}
+
+/* releases requests waiting for `e` - sending `e` if it was cached. */
+FIO_SFUNC void fio___http_cache_release(fio___http_cache_entry_s *e) {
+  union {
+    void (*fn)(fio_http_s *);
+    void *ptr;
+  } cb;
+  while (!FIO_LIST_IS_EMPTY(&e->waiting)) {
+    fio___http_cache_waiting_s *w;
+    fio___http_connection_s *c;
+    fio_http_s *h;
+    FIO_LIST_POP(fio___http_cache_waiting_s, node, w, &e->waiting);
+    h = w->h;
+    FIO_LEAK_COUNTER_ON_FREE(fio___http_cache_waiting_s);
+    FIO_MEM_FREE_(w, sizeof(*w));
+    if (e->data) {
+      fio_atomic_add(&e->ref, 1);
+      fio_io_defer(fio___http_cache_send, (void *)h, (void *)e);
+      continue;
+    }
+    c = (fio___http_connection_s *)fio_http_cdata(h);
+    cb.fn = c->state.http.on_http;
+    fio_queue_push(c->queue, fio___http_perform_user_callback, cb.ptr, h);
+  }
+}
+
+/**
+ * Serves a request from the cache (or queues it while the response is
+ * recorded), returns 0 if `on_http` should be called for the request.
+ */
+FIO_SFUNC int fio___http_cache_request(fio___http_connection_s *c,
+                                       fio_http_s *h) {
+  fio___http_cache_s *cache = fio___http_cache(c);
+  fio___http_cache_entry_s *e;
+  fio___http_cache_waiting_s *w;
+  char buf[4096];
+  fio_str_info_s key = FIO_STR_INFO3(buf, 0, 4096);
+  uint64_t hash;
+  int64_t now;
+  int conditional;
+  if (fio___http_cache_key(cache, h, &key))
+    return 0;
+  /* a conditional request might get a (non-cacheable) 304 response */
+  conditional =
+      fio_http_request_header(h,
+                              FIO_STR_INFO2((char *)"if-none-match", 13),
+                              0)
+          .len ||
+      fio_http_request_header(h,
+                              FIO_STR_INFO2((char *)"if-modified-since", 17),
+                              0)
+          .len;
+  hash = fio_risky_hash(key.buf, key.len, (uint64_t)(uintptr_t)cache);
+  now = (int64_t)fio_io_last_tick();
+  FIO___LOCK_LOCK(cache->lock);
+  e = fio___http_cache_map_get(&cache->map, hash, key);
+  if (e && (e->data || e->pass) && e->expires <= now) {
+    fio___http_cache_map_remove(&cache->map, hash, key, NULL);
+    e = NULL;
+  }
+  if (!e)
+    goto record;
+  if (e->pass)
+    goto bypass;
+  if (!e->data)
+    goto wait;
+  /* cache hit - move to the end of the LRU list */
+  FIO_LIST_REMOVE(&e->node);
+  FIO_LIST_PUSH(&cache->lru, &e->node);
+  fio_atomic_add(&e->ref, 1);
+  FIO___LOCK_UNLOCK(cache->lock);
+  fio___http_cache_send((void *)h, (void *)e);
+  return 1;
+
+wait:
+  if (conditional)
+    goto bypass;
+  w = (fio___http_cache_waiting_s *)FIO_MEM_REALLOC_(NULL, 0, sizeof(*w), 0);
+  if (!w)
+    goto bypass;
+  FIO_LEAK_COUNTER_ON_ALLOC(fio___http_cache_waiting_s);
+  w->h = h;
+  FIO_LIST_PUSH(&e->waiting, &w->node);
+  FIO___LOCK_UNLOCK(cache->lock);
+  return 1;
+
+record:
+  if (conditional)
+    goto bypass;
+  e = (fio___http_cache_entry_s *)FIO_MEM_REALLOC_(NULL, 0, sizeof(*e), 0);
+  if (!e)
+    goto bypass;
+  FIO_LEAK_COUNTER_ON_ALLOC(fio___http_cache_entry_s);
+  *e = (fio___http_cache_entry_s){
+      .ref = 2, /* the map and the recording connection */
+      .node = FIO_LIST_INIT(e->node),
+      .waiting = FIO_LIST_INIT(e->waiting),
+      .cache = cache,
+      .key = fio_bstr_write(NULL, key.buf, key.len),
+      .hash = hash,
+      .mem = sizeof(*e) + (key.len << 1),
+  };
+  fio___http_cache_map_set(&cache->map, hash, key, e, NULL);
+  FIO___LOCK_UNLOCK(cache->lock);
+  c->state.http.cache = e;
+  c->state.http.cache_hit = 0;
+  return 0;
+
+bypass:
+  FIO___LOCK_UNLOCK(cache->lock);
+  return 0;
+}
+
+/* stops recording (or sending) a response, `pass` marks it as non-cacheable */
+FIO_SFUNC void fio___http_cache_abandon(fio___http_connection_s *c, int pass) {
+  fio___http_cache_entry_s *e = c->state.http.cache;
+  fio___http_cache_s *cache = e->cache;
+  c->state.http.cache = NULL;
+  if (c->state.http.cache_hit)
+    goto finish;
+  FIO___LOCK_LOCK(cache->lock);
+  if (fio___http_cache_map_get(&cache->map, e->hash, fio_bstr_info(e->key)) ==
+      e) {
+    if (pass) {
+      e->pass = 1;
+      e->expires = (int64_t)fio_io_last_tick() + cache->ttl;
+      fio___http_cache_store(cache, e);
+    } else
+      fio___http_cache_map_remove(&cache->map,
+                                  e->hash,
+                                  fio_bstr_info(e->key),
+                                  NULL);
+  }
+  FIO___LOCK_UNLOCK(cache->lock);
+  fio___http_cache_release(e); /* the waiting list is no longer shared */
+finish:
+  fio___http_cache_entry_free(e);
+}
+
+/* tests the recorded response headers, returns true when sending from cache */
+FIO_SFUNC int fio___http_cache_on_headers(fio___http_connection_s *c,
+                                          fio_http_s *h) {
+  fio___http_cache_entry_s *e = c->state.http.cache;
+  size_t ttl;
+  if (c->state.http.cache_hit)
+    return 1;
+  if (!c->io || !fio_io_is_open(c->io)) {
+    fio___http_cache_abandon(c, 0);
+    return 0;
+  }
+  if (!(ttl = fio___http_cache_response_ttl(e->cache, h))) {
+    fio___http_cache_abandon(c, 1);
+    return 0;
+  }
+  e->status = fio_http_status(h);
+  e->expires = (int64_t)fio_io_last_tick() + ((int64_t)ttl * 1000);
+  return 0;
+}
+
+/* records body data, returns true if the data was consumed */
+FIO_SFUNC int fio___http_cache_on_body(fio___http_connection_s *c,
+                                       fio_http_write_args_s *args) {
+  if (c->state.http.cache_hit)
+    return 1;
+  if (!args->buf) {
+    if ((uint32_t)(args->fd + 1) <= 1U)
+      return 1; /* no data */
+    fio___http_cache_abandon(c, 1); /* files aren't cached */
+    return 0;
+  }
+  if (c->state.http.buf.len + args->len >
+      (c->state.http.cache->cache->limit >> 3)) {
+    fio___http_cache_abandon(c, 1);
+    return 0;
+  }
+  fio_string_write(&c->state.http.buf,
+                   FIO_STRING_REALLOC,
+                   (char *)args->buf + args->offset,
+                   args->len);
+  if (args->dealloc)
+    args->dealloc((void *)args->buf);
+  return 1;
+}
+
+/* sends the cached response, or caches the recorded one and sends it */
+FIO_SFUNC void fio___http_cache_on_finish(fio___http_connection_s *c) {
+  fio___http_cache_entry_s *e = c->state.http.cache;
+  fio___http_cache_s *cache = e->cache;
+  char *data;
+  if (c->state.http.cache_hit) {
+    fio_io_write2(c->io,
+                  .buf = fio_bstr_copy(e->data),
+                  .len = fio_bstr_len(e->data),
+                  .dealloc = (void (*)(void *))fio_bstr_free);
+    c->state.http.cache = NULL;
+    fio___http_cache_entry_free(e);
+    return;
+  }
+  if (!c->state.http.buf.len || !fio_io_is_open(c->io)) {
+    fio___http_cache_abandon(c, 0);
+    return;
+  }
+  data = fio_bstr_write(NULL, c->state.http.buf.buf, c->state.http.buf.len);
+  FIO_STRING_FREE2(c->state.http.buf);
+  c->state.http.buf = FIO_STR_INFO0;
+  c->state.http.cache = NULL;
+  fio_io_write2(c->io,
+                .buf = fio_bstr_copy(data),
+                .len = fio_bstr_len(data),
+                .dealloc = (void (*)(void *))fio_bstr_free);
+  FIO___LOCK_LOCK(cache->lock);
+  e->data = data;
+  e->mem += fio_bstr_len(data);
+  if (fio___http_cache_map_get(&cache->map, e->hash, fio_bstr_info(e->key)) ==
+      e)
+    fio___http_cache_store(cache, e);
+  FIO___LOCK_UNLOCK(cache->lock);
+  fio___http_cache_release(e); /* the waiting list is no longer shared */
+  fio___http_cache_entry_free(e);
+}
+
+/* *****************************************************************************
+HTTP Request handling / handling
+***************************************************************************** */
+
+FIO_SFUNC void fio___http_perform_user_callback(void *cb_, void *h_) {
+  union {
+    void (*fn)(fio_http_s *);
+    void *ptr;
+  } cb = {.ptr = cb_};
+  fio_http_s *h = (fio_http_s *)h_;
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+
+  if (FIO_LIKELY(FIO_SOCK_IS_OPEN(fio_io_fd(c->io))))
+    cb.fn(h);
+  fio_http_free(h);
+}
+
+FIO_SFUNC void fio___http_perform_user_upgrade_callback_websocket(void *cb_,
+                                                                  void *h_) {
+  union {
+    int (*fn)(fio_http_s *);
+    void *ptr;
+  } cb = {.ptr = cb_};
+  fio_http_s *h = (fio_http_s *)h_;
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  struct fio___http_connection_http_s old = c->state.http;
+  if (!FIO_LIKELY(fio_io_is_open(c->io)) || cb.fn(h))
+    goto refuse_upgrade;
+  if (c->h) /* request after WebSocket Upgrade? an attack vector? */
+    goto refuse_upgrade;
+#if HAVE_ZLIB
+  if (c->settings->ws_deflate)
+    fio___http_ws_deflate_negotiate(h, c->settings);
+#endif
+  fio_http_upgrade_websocket(h);
+  return;
+
+refuse_upgrade:
+  c->state.http = old;
+  if (fio_http_send_error_response(h, 403))
+    fio_io_free(c->io);
+  fio_http_free(h);
+}
+
+FIO_SFUNC void fio___http_perform_user_upgrade_callback_sse(void *cb_,
+                                                            void *h_) {
+  union {
+    int (*fn)(fio_http_s *);
+    void *ptr;
+  } cb = {.ptr = cb_};
+  fio_http_s *h = (fio_http_s *)h_;
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  if (!FIO_LIKELY(fio_io_is_open(c->io)) || cb.fn(h))
+    goto refuse_upgrade;
+  if (c->h) /* request after eventsource? an attack vector? */
+    goto refuse_upgrade;
+  fio_http_upgrade_sse(h);
+  return;
+
+refuse_upgrade:
+  if (fio_http_send_error_response(h, 403))
+    fio_io_free(c->io);
+  fio_http_free(h);
+}
+
+FIO_IFUNC int fio___http_on_http_test4upgrade(fio_http_s *h,
+                                              fio___http_connection_s *c) {
+  union {
+    int (*fn)(fio_http_s *);
+    void *ptr;
+  } cb;
+  if (fio_http_websocket_requested(h))
+    goto websocket_requested;
+  if (fio_http_sse_requested(h))
+    goto sse_requested;
+  return 0;
+websocket_requested:
+  cb.fn = c->settings->on_authenticate_websocket;
+  fio_queue_push(c->queue,
+                 fio___http_perform_user_upgrade_callback_websocket,
+                 cb.ptr,
+                 (void *)h);
+  return -1;
+
+sse_requested:
+  cb.fn = c->settings->on_authenticate_sse;
+  fio_queue_push(c->queue,
+                 fio___http_perform_user_upgrade_callback_sse,
+                 cb.ptr,
+                 (void *)h);
+  return -1;
+
+#if 0
+http2_requested:
+  // Connection: Upgrade, HTTP2-Settings
+  // Upgrade: h2c
+  // HTTP2-Settings: <base64url encoding of HTTP/2 SETTINGS payload>
+  return 0; /* allowed to ignore upgrade request */
+#endif
+}
+
+FIO_SFUNC void fio___http_on_http_direct(void *h_, void *ignr) {
+  fio_http_s *h = (fio_http_s *)h_;
+  fio_http_status_set(h, 200);
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  if (fio___http_on_http_test4upgrade(h, c))
+    return;
+  if (fio___http_cache(c) && fio___http_cache_request(c, h))
+    return;
+  union {
+    void (*fn)(fio_http_s *);
+    void *ptr;
+  } cb = {.fn = c->state.http.on_http};
+  fio_queue_push(c->queue, fio___http_perform_user_callback, cb.ptr, (void *)h);
+  (void)ignr;
+}
+
+FIO_SFUNC void fio___http_on_http_with_public_folder(void *h_, void *ignr) {
+  fio_http_s *h = (fio_http_s *)h_;
+  fio_http_status_set(h, 200);
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  if (fio___http_on_http_test4upgrade(h, c))
+    return;
+  if ((fio_http_method(h).len != 4 || (fio_buf2u32u(fio_http_method(h).buf) |
+                                       0x20202020UL) != fio_buf2u32u("post")) &&
+      !fio_http_static_file_response(h,
+                                     c->settings->public_folder,
+                                     fio_http_path(h),
+                                     c->settings->max_age)) {
+    fio_http_free(h);
+    return;
+  }
+  if (fio___http_cache(c) && fio___http_cache_request(c, h))
+    return;
+  union {
+    void (*fn)(fio_http_s *);
+    void *ptr;
+  } cb = {.fn = c->state.http.on_http};
+  fio_queue_push(c->queue, fio___http_perform_user_callback, cb.ptr, (void *)h);
+  (void)ignr;
+}
+
+FIO_SFUNC void fio___http_perform_user_callback_client(void *cb_, void *h_) {
+  fio_http_s *h = (fio_http_s *)h_;
+  union {
+    void (*fn)(fio_http_s *);
+    void *ptr;
+  } cb = {.ptr = cb_};
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  /* unlike Server mode, handle responses from closed connections */
+  cb.fn(h);
+  fio_http_free(h);
+  fio_io_free(c->io);
+}
+
+FIO_SFUNC void fio___http_on_http_client(void *h_, void *ignr) {
+  fio_http_s *h = (fio_http_s *)h_;
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  size_t pr = FIO___HTTP_PROTOCOL_WS;
+  union {
+    void (*fn)(fio_http_s *);
+    void *ptr;
+  } cb = {.fn = c->state.http.on_http};
+
+  /* TODO! review WS and SSE responses. */
+  if (fio_http_websocket_accepted(h))
+    goto websocket_accepted;
+  if (fio_http_sse_accepted(h))
+    goto sse_accepted;
+  fio_queue_push(c->queue,
+                 fio___http_perform_user_callback_client,
+                 cb.ptr,
+                 (void *)h);
+  return;
+  (void)ignr;
+
+sse_accepted:
+  pr = FIO___HTTP_PROTOCOL_SSE;
+
+websocket_accepted:
+  c->h = h; /* was set to NULL in `on_http_complete` */
+  fio_http_controller_set(
+      c->h,
+      &(FIO_PTR_FROM_FIELD(fio___http_protocol_s, settings, c->settings)
+            ->state[pr]
+            .controller));
+  fio_io_protocol_set(
+      c->io,
+      &(FIO_PTR_FROM_FIELD(fio___http_protocol_s, settings, c->settings)
+            ->state[pr]
+            .protocol));
+
+  FIO_LOG_DDEBUG2("(%d) Client %s upgrade complete for fd %d",
+                  fio_io_pid(),
+                  (fio_http_is_websocket(h) ? "WebSocket" : "SSE"),
+                  fio_io_fd(c->io));
+
+  fio_io_free(c->io); /* fio_dup called by fio_http1_on_complete */
+  c->suspend = 0;
+  fio_io_unsuspend(c->io);
+}
+
+/* *****************************************************************************
+ALPN Helpers
+***************************************************************************** */
+
+FIO_SFUNC void fio___http_on_select_h1(fio_io_s *io) {
+  FIO_LOG_DDEBUG2("TLS ALPN HTTP/1.1 selected for %p", io);
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_io_udata(io);
+  fio_io_protocol_set(
+      io,
+      &(FIO_PTR_FROM_FIELD(fio___http_protocol_s, settings, c->settings)
+            ->state[FIO___HTTP_PROTOCOL_HTTP1]
+            .protocol));
+}
+FIO_SFUNC void fio___http_on_select_h2(fio_io_s *io) {
+  /* the HTTP/2 client preface is detected by `fio___http1_accept_on_data` */
+  FIO_LOG_DDEBUG2("TLS ALPN HTTP/2 selected for %p", io);
+  (void)io;
+}
+
+/* *****************************************************************************
+HTTP Listen
+***************************************************************************** */
+
+static void fio___http_listen_on_start(fio_io_protocol_s *protocol, void *u) {
+  (void)u;
+  fio___http_protocol_s *p =
+      FIO_PTR_FROM_FIELD(fio___http_protocol_s,
+                         state[FIO___HTTP_PROTOCOL_ACCEPT].protocol,
+                         protocol);
+  p->queue = ((p->settings.queue && p->settings.queue->q) ? p->settings.queue->q
+                                                          : fio_io_queue());
+}
+
+static void fio___http_listen_on_stop(fio_io_protocol_s *p, void *u) {
+  (void)u;
+  fio___http_protocol_free(
+      FIO_PTR_FROM_FIELD(fio___http_protocol_s,
+                         state[FIO___HTTP_PROTOCOL_ACCEPT].protocol,
+                         p));
+}
+
+void fio_http_listen___(void); /* IDE marker */
+SFUNC void *fio_http_listen FIO_NOOP(const char *url, fio_http_settings_s s) {
+  http_settings_validate(&s, 0);
+  fio___http_protocol_s *p = fio___http_protocol_new(s.public_folder.len + 1);
+  fio___http_protocol_init(p, url, s, 0);
+  void *listener =
+      fio_io_listen(.url = url,
+                    .protocol = &p->state[FIO___HTTP_PROTOCOL_ACCEPT].protocol,
+                    .tls = p->settings.tls, /* includes ALPN protocols */
+                    .on_start = fio___http_listen_on_start,
+                    .on_stop = fio___http_listen_on_stop,
+                    .queue_for_accept = p->settings.queue);
+  return listener;
+}
+
+/** Returns the a pointer to the HTTP settings associated with the listener. */
+SFUNC fio_http_settings_s *fio_http_listener_settings(void *listener) {
+  fio___http_protocol_s *p =
+      FIO_PTR_FROM_FIELD(fio___http_protocol_s,
+                         state[FIO___HTTP_PROTOCOL_ACCEPT].protocol,
+                         fio_io_listener_protocol(listener));
+  return &p->settings;
+}
+/* *****************************************************************************
+HTTP Client Connection Pool
+
+Pooled client connections are kept (per origin) after a response was handled
+and reused for later requests, saving the TCP / TLS handshake. Requests are
+queued while all of an origin's connections are busy and sent (in order) as
+connections are released.
+
+Idle connections are monitored by the reactor, so connections closed by the
+server (or by the `timeout`) are removed from the pool.
+***************************************************************************** */
+
+/* a request waiting to be sent over a pooled connection. */
+typedef struct {
+  FIO_LIST_NODE node;
+  fio___http_pool_s *pool;
+  fio_http_s *h;
+  void (*on_http)(fio_http_s *h);
+  void (*on_finish)(fio_http_s *h);
+} fio___http_pool_req_s;
+
+/* an origin's connection pool (kept until the program exits). */
+struct fio___http_pool_s {
+  FIO_LIST_HEAD idle;       /* idle connections, most recently used first */
+  FIO_LIST_HEAD queue;      /* requests waiting for a connection */
+  fio___http_protocol_s *p; /* settings used by all of the pool's connections */
+  char *url;                /* the URL used for new connections (fio_bstr) */
+  uint32_t open;            /* open (or connecting) connections */
+  uint32_t idle_count;      /* connections in the `idle` list */
+};
+
+FIO_LEAK_COUNTER_DEF(fio___http_pool_req_s)
+FIO_LEAK_COUNTER_DEF(fio___http_pool_s)
+
+FIO_SFUNC void fio___http_pool_destroy(fio___http_pool_s *pool);
+
+#define FIO___RECURSIVE_INCLUDE  1
+#define FIO_MAP_NAME             fio___http_pool_map
+#define FIO_MAP_KEY_BSTR         /* scheme, host, port and TLS settings */
+#define FIO_MAP_VALUE            fio___http_pool_s *
+#define FIO_MAP_VALUE_DESTROY(o) fio___http_pool_destroy((o))
+#include FIO_INCLUDE_FILE
+#undef FIO___RECURSIVE_INCLUDE
+
+static struct {
+  fio___http_pool_map_s map;
+  FIO___LOCK_TYPE lock;
+  uint8_t at_exit;
+} FIO___HTTP_POOL = {.lock = FIO___LOCK_INIT};
+
+FIO_SFUNC void fio___http1_send_request(fio_http_s *h);
+static void fio___http_connect_on_failed(fio_io_protocol_s *p, void *udata);
+
+FIO_SFUNC fio___http_pool_req_s *fio___http_pool_req_new(
+    fio___http_pool_s *pool,
+    fio_http_s *h,
+    fio_http_settings_s *s) {
+  fio___http_pool_req_s *r =
+      (fio___http_pool_req_s *)FIO_MEM_REALLOC_(NULL, 0, sizeof(*r), 0);
+  FIO_ASSERT_ALLOC(r);
+  FIO_LEAK_COUNTER_ON_ALLOC(fio___http_pool_req_s);
+  *r = (fio___http_pool_req_s){
+      .pool = pool,
+      .h = h,
+      .on_http = s->on_http,
+      .on_finish = s->on_finish,
+  };
+  return r;
+}
+
+FIO_SFUNC void fio___http_pool_req_free(fio___http_pool_req_s *r) {
+  FIO_LEAK_COUNTER_ON_FREE(fio___http_pool_req_s);
+  FIO_MEM_FREE_(r, sizeof(*r));
+}
+
+FIO_SFUNC void fio___http_pool_destroy(fio___http_pool_s *pool) {
+  while (!FIO_LIST_IS_EMPTY(&pool->queue)) {
+    fio___http_pool_req_s *r;
+    FIO_LIST_POP(fio___http_pool_req_s, node, r, &pool->queue);
+    fio_http_free(r->h);
+    fio___http_pool_req_free(r);
+  }
+  fio___http_protocol_free(pool->p);
+  fio_bstr_free(pool->url);
+  FIO_LEAK_COUNTER_ON_FREE(fio___http_pool_s);
+  FIO_MEM_FREE_(pool, sizeof(*pool));
+}
+
+FIO_SFUNC void fio___http_pool_cleanup(void *ignr_) {
+  FIO___LOCK_LOCK(FIO___HTTP_POOL.lock);
+  fio___http_pool_map_destroy(&FIO___HTTP_POOL.map);
+  FIO___LOCK_UNLOCK(FIO___HTTP_POOL.lock);
+  (void)ignr_;
+}
+
+/* returns the connection pool for the origin (created using `s` if new). */
+FIO_SFUNC fio___http_pool_s *fio___http_pool_get(const char *url,
+                                                 fio_url_s u,
+                                                 fio_http_settings_s *s) {
+  FIO_STR_INFO_TMP_VAR(key, 1024);
+  fio___http_pool_s *pool;
+  uint64_t hash;
+  fio_string_write2(&key,
+                    NULL,
+                    FIO_STRING_WRITE_STR2("s", (size_t)fio_url_is_tls(u).tls),
+                    FIO_STRING_WRITE_STR_INFO(u.host),
+                    FIO_STRING_WRITE_STR2(":", 1),
+                    FIO_STRING_WRITE_STR_INFO(u.port),
+                    FIO_STRING_WRITE_STR2("@", 1),
+                    FIO_STRING_WRITE_HEX((uintptr_t)s->tls));
+  hash = fio_risky_hash(key.buf,
+                        key.len,
+                        (uint64_t)(uintptr_t)&FIO___HTTP_POOL);
+  FIO___LOCK_LOCK(FIO___HTTP_POOL.lock);
+  pool = fio___http_pool_map_get(&FIO___HTTP_POOL.map, hash, key);
+  if (pool)
+    goto done;
+  pool = (fio___http_pool_s *)FIO_MEM_REALLOC_(NULL, 0, sizeof(*pool), 0);
+  FIO_ASSERT_ALLOC(pool);
+  FIO_LEAK_COUNTER_ON_ALLOC(fio___http_pool_s);
+  *pool = (fio___http_pool_s){
+      .p = fio___http_protocol_new(u.host.len),
+      .url = fio_bstr_write(NULL, url, strlen(url)),
+  };
+  pool->idle = FIO_LIST_INIT(pool->idle);
+  pool->queue = FIO_LIST_INIT(pool->queue);
+  fio___http_protocol_init(pool->p, url, *s, 1);
+  fio___http_pool_map_set(&FIO___HTTP_POOL.map, hash, key, pool, NULL);
+  if (!FIO___HTTP_POOL.at_exit) {
+    FIO___HTTP_POOL.at_exit = 1;
+    fio_state_callback_add(FIO_CALL_AT_EXIT, fio___http_pool_cleanup, NULL);
+  }
+done:
+  FIO___LOCK_UNLOCK(FIO___HTTP_POOL.lock);
+  return pool;
+}
+
+/* attaches an HTTP client handle to the connection (the handle's request). */
+FIO_SFUNC void fio___http_client_attach(fio___http_connection_s *c,
+                                        fio_http_s *h) {
+  fio_http_controller_set(
+      h,
+      &(FIO_PTR_FROM_FIELD(fio___http_protocol_s, settings, c->settings)
+            ->state[FIO___HTTP_PROTOCOL_HTTP1]
+            .controller));
+  if (!fio_http_udata(h)) /* avoid overwriting existing `udata` if set */
+    fio_http_udata_set(h, c->udata);
+  fio_http_cdata_set(h, fio___http_connection_dup(c));
+}
+
+/* opens a new client connection for `h`, consuming a reference to `p`. */
+FIO_SFUNC fio_io_s *fio___http_client_new(const char *url,
+                                          fio___http_protocol_s *p,
+                                          fio___http_pool_s *pool,
+                                          fio_http_s *h,
+                                          void (*on_http)(fio_http_s *),
+                                          void (*on_finish)(fio_http_s *)) {
+  fio___http_connection_s *c =
+      fio___http_connection_new(p->settings.max_line_len);
+  FIO_ASSERT_ALLOC(c);
+  *c = (fio___http_connection_s){
+      .io = NULL,
+      .h = h,
+      .settings = &(p->settings),
+      .queue = p->queue,
+      .udata = p->settings.udata,
+      .state.http =
+          {
+              .on_http_callback = p->on_http_callback,
+              .on_http = on_http,
+              .on_finish = on_finish,
+              .max_header = p->settings.max_header_size,
+              .max_line = p->settings.max_line_len,
+              .pool = pool,
+          },
+      .capa = p->settings.max_line_len,
+      .log = p->settings.log,
+      .is_client = 1,
+  };
+  c->state.http.pool_node = FIO_LIST_INIT(c->state.http.pool_node);
+  fio___http_client_attach(c, h);
+  return fio_io_connect(url,
+                        .protocol =
+                            &p->state[FIO___HTTP_PROTOCOL_HTTP1].protocol,
+                        .on_failed = fio___http_connect_on_failed,
+                        .udata = c,
+                        .tls = p->settings.tls,
+                        .timeout = p->settings.connect_timeout);
+}
+
+/* opens a new pooled connection for the request (a slot was reserved). */
+FIO_SFUNC fio_io_s *fio___http_pool_connect(fio___http_pool_req_s *r) {
+  fio___http_pool_s *pool = r->pool;
+  fio_http_s *h = r->h;
+  void (*on_http)(fio_http_s *) = r->on_http;
+  void (*on_finish)(fio_http_s *) = r->on_finish;
+  fio___http_pool_req_free(r);
+  return fio___http_client_new(pool->url,
+                               fio___http_protocol_dup(pool->p),
+                               pool,
+                               h,
+                               on_http,
+                               on_finish);
+}
+
+FIO_SFUNC fio_io_s *fio___http_pool_request(fio___http_pool_req_s *r);
+
+/* sends a request over an idle pooled connection (performed by the IO loop) */
+FIO_SFUNC void fio___http_pool_send_task(void *c_, void *r_) {
+  fio___http_connection_s *c = (fio___http_connection_s *)c_;
+  fio___http_pool_req_s *r = (fio___http_pool_req_s *)r_;
+  if (!c->io || !fio_io_is_open(c->io)) { /* closed while idle - retry */
+    fio___http_connection_free(c);
+    fio___http_pool_request(r);
+    return;
+  }
+  c->h = r->h;
+  c->state.http.on_http = r->on_http;
+  c->state.http.on_finish = r->on_finish;
+  fio___http_pool_req_free(r);
+  fio___http_client_attach(c, c->h);
+  fio___http1_send_request(c->h);
+  fio___http_connection_free(c);
+}
+
+/* sends the request using an idle connection, a new connection or queues it */
+FIO_SFUNC fio_io_s *fio___http_pool_request(fio___http_pool_req_s *r) {
+  fio___http_pool_s *pool = r->pool;
+  fio___http_connection_s *c = NULL;
+  fio_io_s *io = NULL;
+  FIO___LOCK_LOCK(FIO___HTTP_POOL.lock);
+  if (!FIO_LIST_IS_EMPTY(&pool->idle)) {
+    c = FIO_PTR_FROM_FIELD(fio___http_connection_s,
+                           state.http.pool_node,
+                           pool->idle.next);
+    FIO_LIST_REMOVE_RESET(&c->state.http.pool_node);
+    --pool->idle_count;
+    c = fio___http_connection_dup(c); /* the IO might close meanwhile */
+    io = c->io;
+  } else if (pool->open < pool->p->settings.pool_max) {
+    ++pool->open;
+  } else {
+    FIO_LIST_PUSH(&pool->queue, &r->node);
+    r = NULL;
+  }
+  FIO___LOCK_UNLOCK(FIO___HTTP_POOL.lock);
+  if (c) {
+    fio_io_defer(fio___http_pool_send_task, (void *)c, (void *)r);
+    return io;
+  }
+  if (r)
+    return fio___http_pool_connect(r);
+  return io;
+}
+
+/* tests if a connection can be reused once its response was handled. */
+FIO_SFUNC int fio___http_pool_is_reusable(fio___http_connection_s *c,
+                                          fio_http_s *h) {
+  fio_str_info_s v;
+  if (!c->state.http.pool || !fio_http_status(h) || c->len ||
+      !fio_http1_parser_is_empty(&c->state.http.parser) ||
+      !fio_io_is_open(c->io))
+    return 0;
+  v = fio_http_version(h);
+  if (v.len != 8 || fio_buf2u64u(v.buf) != fio_buf2u64u("HTTP/1.1"))
+    return 0;
+  v = fio_http_response_header(h, FIO_STR_INFO2((char *)"connection", 10), 0);
+  if (v.len == 5 && (fio_buf2u32u(v.buf) | 0x20202020UL) ==
+                        fio_buf2u32u("clos") &&
+      (v.buf[4] | 0x20) == 'e')
+    return 0;
+  return 1;
+}
+
+/* returns a connection to its pool, or uses it for the next queued request */
+FIO_SFUNC void fio___http_pool_release(fio___http_connection_s *c) {
+  fio___http_pool_s *pool = c->state.http.pool;
+  fio___http_pool_req_s *r = NULL;
+  int keep = 0;
+  FIO___LOCK_LOCK(FIO___HTTP_POOL.lock);
+  if (!FIO_LIST_IS_EMPTY(&pool->queue)) {
+    FIO_LIST_POP(fio___http_pool_req_s, node, r, &pool->queue);
+  } else if (pool->idle_count < pool->p->settings.pool_max_idle) {
+    FIO_LIST_NODE *first = pool->idle.next; /* most recently used first */
+    FIO_LIST_PUSH(first, &c->state.http.pool_node);
+    ++pool->idle_count;
+    keep = 1;
+  }
+  FIO___LOCK_UNLOCK(FIO___HTTP_POOL.lock);
+  if (r) {
+    fio_io_defer(fio___http_pool_send_task,
+                 (void *)fio___http_connection_dup(c),
+                 (void *)r);
+    return;
+  }
+  if (!keep) {
+    fio_io_close(c->io);
+    return;
+  }
+  c->suspend = 0; /* monitor idle connections (i.e., if closed by server) */
+  fio_io_unsuspend(c->io);
+}
+
+/* called when a pooled connection was closed (or failed to connect). */
+FIO_SFUNC void fio___http_pool_on_close(fio___http_connection_s *c) {
+  fio___http_pool_s *pool = c->state.http.pool;
+  fio___http_pool_req_s *r = NULL;
+  if (!pool)
+    return;
+  FIO___LOCK_LOCK(FIO___HTTP_POOL.lock);
+  if (!FIO_LIST_IS_EMPTY(&c->state.http.pool_node)) {
+    FIO_LIST_REMOVE_RESET(&c->state.http.pool_node);
+    --pool->idle_count;
+  }
+  if (FIO_LIST_IS_EMPTY(&pool->queue))
+    --pool->open;
+  else /* the connection's slot is passed on to the next queued request */
+    FIO_LIST_POP(fio___http_pool_req_s, node, r, &pool->queue);
+  FIO___LOCK_UNLOCK(FIO___HTTP_POOL.lock);
+  if (r)
+    fio___http_pool_connect(r);
+}
+
+/* *****************************************************************************
+HTTP Connect
+***************************************************************************** */
+
+static void fio___http_connect_on_failed(fio_io_protocol_s *p, void *udata) {
+  fio___http_connection_s *c = (fio___http_connection_s *)udata;
+  fio_http_free(c->h);
+  c->h = NULL;
+  fio___http_pool_on_close(c);
+  fio___http_connection_free(c);
+  (void)p;
+}
+
+void fio_http_connect___(void); /* IDE Marker */
 /** Connects to HTTP / WebSockets / SSE connections on `url`. */
 SFUNC fio_io_s *fio_http_connect FIO_NOOP(const char *url,
                                           fio_http_s *h,
@@ -46823,6 +57454,7 @@ SFUNC fio_io_s *fio_http_connect FIO_NOOP(const char *url,
   fio_url_s u = (fio_url_s){0};
   if (url)
     u = fio_url_parse(url, strlen(url));
+  int pooled = (s.pool_max && u.host.len); /* upgraded connections aren't */
 
   if (!h)
     h = fio_http_new();
@@ -46857,6 +57489,20 @@ SFUNC fio_io_s *fio_http_connect FIO_NOOP(const char *url,
                                            FIO_STR_INFO2((char *)"origin", 6),
                                            origin);
     fio_http_websocket_set_request(h);
+    pooled = 0;
+#if HAVE_ZLIB
+    if (s.ws_deflate)
+      fio_http_request_header_set_if_missing(
+          h,
+          FIO_STR_INFO2((char *)"sec-websocket-extensions", 24),
+          (s.ws_deflate_no_context_takeover
+               ? FIO_STR_INFO1((char *)"permessage-deflate; "
+                                       "client_max_window_bits; "
+                                       "client_no_context_takeover; "
+                                       "server_no_context_takeover")
+               : FIO_STR_INFO1(
+                     (char *)"permessage-deflate; client_max_window_bits")));
+#endif
   }
   /* test for sse:// or sses:// - Server Sent Events scheme */
   else if ((u.scheme.len == 3 ||
@@ -46867,45 +57513,24 @@ SFUNC fio_io_s *fio_http_connect FIO_NOOP(const char *url,
                                            FIO_STR_INFO2((char *)"origin", 6),
                                            origin);
     fio_http_sse_set_request(h);
+    pooled = 0;
   }
 
-  /* TODO: test for and attempt to re-use connection */
-  // if (fio_http_cdata(h)) { }
+  if (pooled) {
+    if (!fio_http_udata(h)) /* the pool's connections share `udata` */
+      fio_http_udata_set(h, s.udata);
+    return fio___http_pool_request(
+        fio___http_pool_req_new(fio___http_pool_get(url, u, &s), h, &s));
+  }
 
   fio___http_protocol_s *p = fio___http_protocol_new(u.host.len);
   fio___http_protocol_init(p, url, s, 1);
-  fio___http_connection_s *c =
-      fio___http_connection_new(p->settings.max_line_len);
-  FIO_ASSERT_ALLOC(c);
-  *c = (fio___http_connection_s){
-      .io = NULL,
-      .h = h,
-      .settings = &(p->settings),
-      .queue = p->queue,
-      .udata = p->settings.udata,
-      .state.http =
-          {
-              .on_http_callback = p->on_http_callback,
-              .on_http = p->settings.on_http,
-              .on_finish = p->settings.on_finish,
-              .max_header = p->settings.max_header_size,
-              .max_line = p->settings.max_line_len,
-          },
-      .capa = p->settings.max_line_len,
-      .log = p->settings.log,
-      .is_client = 1,
-  };
-  fio_http_controller_set(h, &p->state[FIO___HTTP_PROTOCOL_HTTP1].controller);
-  if (!fio_http_udata(h)) /* avoid overwriting existing `udata` if set */
-    fio_http_udata_set(h, c->udata);
-  fio_http_cdata_set(h, fio___http_connection_dup(c));
-  return fio_io_connect(url,
-                        .protocol =
-                            &p->state[FIO___HTTP_PROTOCOL_HTTP1].protocol,
-                        .on_failed = fio___http_connect_on_failed,
-                        .udata = c,
-                        .tls = s.tls,
-                        .timeout = s.connect_timeout);
+  return fio___http_client_new(url,
+                               p,
+                               NULL,
+                               h,
+                               p->settings.on_http,
+                               p->settings.on_finish);
 }
 
 /* *****************************************************************************
@@ -46920,6 +57545,7 @@ static void fio_http1_on_complete(void *udata) {
   fio_http_s *h = c->h;
   c->h = NULL;
   c->state.http.header_bytes = 0;
+  c->state.http.pre_body = 0;
   c->suspend = 1;
   // fio_io_defer(c->state.http.on_http_callback, h, NULL);
   fio_queue_push(fio_io_queue(), c->state.http.on_http_callback, h);
@@ -46929,13 +57555,15 @@ static void fio_http1_on_complete(void *udata) {
 HTTP/1.1 Parser callbacks
 ***************************************************************************** */
 
-FIO_IFUNC void fio___http_request_too_big(fio___http_connection_s *c) {
+/* answers with an error and stops reading (i.e., 413 for a payload too big) */
+FIO_IFUNC void fio___http_request_refuse(fio___http_connection_s *c,
+                                         size_t status) {
   fio_http_s *h = c->h;
   fio_io_dup(c->io); /* sending the response will result in fio_undup */
   fio_io_suspend(c->io);
   c->h = NULL;
   c->suspend = 1;
-  if (fio_http_send_error_response(h, 413))
+  if (fio_http_send_error_response(h, status))
     fio_io_free(c->io); /* response not sent, we need to fio_undup */
   fio_http_free(h);
 }
@@ -46967,6 +57595,8 @@ static int fio_http1_on_status(size_t istatus,
                                fio_buf_info_s status,
                                void *udata) {
   fio___http_connection_s *c = (fio___http_connection_s *)udata;
+  if (!c->h)
+    return -1; /* unexpected response (i.e., on an idle connection) */
   fio_http_clear_response(c->h, istatus != 301 && istatus != 302);
   fio_http_status_set(c->h, istatus);
   return 0;
@@ -47040,10 +57670,27 @@ static int fio_http1_on_header_content_length(fio_buf_info_s name,
 #endif
   return 0;
 too_big:
-  fio___http_request_too_big(c);
+  fio___http_request_refuse(c, 413);
   return 0; /* should we disconnect (return -1), or not? */
   (void)name, (void)value;
 }
+
+/* calls `pre_http_body`, returns -1 if it responded (the body isn't wanted). */
+FIO_SFUNC int fio___http1_pre_body(fio___http_connection_s *c) {
+  c->state.http.pre_body = 1;
+  fio_io_dup(c->io); /* sending a response will result in fio_undup */
+  c->settings->pre_http_body(c->h);
+  if (!fio_http_status(c->h)) {
+    fio_io_free(c->io);
+    return 0;
+  }
+  fio_io_suspend(c->io);
+  c->suspend = 1;
+  fio_http_free(c->h);
+  c->h = NULL;
+  return -1;
+}
+
 /** called when `Expect` arrives and may require a 100 continue response. */
 static int fio_http1_on_expect(void *udata) {
   fio___http_connection_s *c = (fio___http_connection_s *)udata;
@@ -47057,19 +57704,15 @@ static int fio_http1_on_expect(void *udata) {
   if (FIO_HTTP1_EXPECTED_CHUNKED != fio_http1_expected(&c->state.http.parser) &&
       c->settings->max_body_size > fio_http1_expected(&c->state.http.parser))
     goto payload_too_big;
-  c->settings->pre_http_body(h);
-  if (fio_http_status(h))
-    goto response_sent;
   c->h = h;
+  if (fio___http1_pre_body(c))
+    return 1; /* a response was sent */
   fio_io_write2(c->io, .buf = response.buf, .len = response.len, .copy = 0);
   return 0; /* TODO?: improve support for `expect` headers? */
 payload_too_big:
   fio_io_dup(c->io);
   if (fio_http_send_error_response(h, 413))
     fio_io_free(c->io); /* response not sent, we need to fio_undup */
-                        /* fall through */
-response_sent:
-  // c->h = NULL;
   fio_http_free(h);
   return 1;
 }
@@ -47084,11 +57727,17 @@ static int fio_http1_on_body_chunk(fio_buf_info_s chunk, void *udata) {
     return 0; /* don't overwrite client payload on redirect */
   if (chunk.len + fio_http_body_length(c->h) > c->settings->max_body_size)
     goto too_big;
-  fio_http_body_write(c->h, chunk.buf, chunk.len);
-  return 0;
-too_big:
-  fio___http_request_too_big(c);
+  if (!c->state.http.pre_body && !c->is_client && fio___http1_pre_body(c))
+    return -1; /* a response was sent, the body isn't wanted */
+  if (fio_http_body_write(c->h, chunk.buf, chunk.len))
+    goto bad_body; /* i.e., a malformed multipart body */
   return 0;
+too_big: /* stop parsing, so the request is never completed */
+  fio___http_request_refuse(c, 413);
+  return -1;
+bad_body:
+  fio___http_request_refuse(c, 400);
+  return -1;
 }
 
 /* *****************************************************************************
@@ -47150,7 +57799,7 @@ FIO_SFUNC void fio___http1_accept_on_data(fio_io_s *io) {
   size_t r = fio_io_read(io, c->buf + c->len, c->capa - c->len);
   if (!r) /* nothing happened */
     return;
-  c->len = (uint32_t)r;
+  c->len += (uint32_t)r;
   if (prior_knowledge.buf[0] != c->buf[0] ||
       FIO_MEMCMP(
           prior_knowledge.buf,
@@ -47186,6 +57835,8 @@ FIO_SFUNC void fio___http_on_close(void *buf, void *udata) {
   fio___http_connection_s *c = (fio___http_connection_s *)udata;
   c->io = NULL;
   fio_http_free(c->h);
+  if (c->is_client)
+    fio___http_pool_on_close(c);
   fio___http_connection_free(c);
   (void)buf;
 }
@@ -47405,10 +58056,27 @@ FIO_SFUNC int fio___http_controller_get_fd(fio_http_s *h) {
   return fio_io_fd(fio_http_io(h));
 }
 
-/** Informs the controller that request / response headers must be sent. */
-FIO_SFUNC void fio___http_controller_http1_send_headers(fio_http_s *h) {
-  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
-  if (!c->io || !fio_io_is_open(c->io))
+/** writes all headers except `content-length` (replaced by the caller). */
+FIO_SFUNC int fio_http1___write_header_zip_callback(fio_http_s *h,
+                                                    fio_str_info_s name,
+                                                    fio_str_info_s value,
+                                                    void *out_) {
+  if (name.len == 14 && !FIO_MEMCMP(name.buf, "content-length", 14))
+    return 0;
+  return fio_http1___write_header_callback(h, name, value, out_);
+}
+
+/**
+ * Serializes the response headers to `c->state.http.buf`.
+ *
+ * If `zip` is set, the `content-encoding` and `content-length` (`zip_len`)
+ * headers of the compressed body are written instead of `content-length`.
+ */
+FIO_SFUNC void fio___http1_write_headers(fio___http_connection_s *c,
+                                         fio_http_s *h,
+                                         uint8_t zip,
+                                         size_t zip_len) {
+  if (c->state.http.cache && fio___http_cache_on_headers(c, h))
     return;
   fio_str_info_s buf = FIO_STR_INFO2(NULL, 0);
   { /* write status string */
@@ -47429,7 +58097,19 @@ FIO_SFUNC void fio___http_controller_http1_send_headers(fio_http_s *h) {
   }
 
   /* write headers */
-  fio_http_response_header_each(h, fio_http1___write_header_callback, &buf);
+  if (zip)
+    fio_string_write2(&buf,
+                      FIO_STRING_REALLOC,
+                      FIO_STRING_WRITE_STR2("content-encoding:", 17),
+                      FIO_STRING_WRITE_STR1(
+                          (zip == FIO___HTTP_ZIP_GZIP ? "gzip" : "br")),
+                      FIO_STRING_WRITE_STR2("\r\ncontent-length:", 17),
+                      FIO_STRING_WRITE_UNUM(zip_len),
+                      FIO_STRING_WRITE_STR2("\r\n", 2));
+  fio_http_response_header_each(h,
+                                (zip ? fio_http1___write_header_zip_callback
+                                     : fio_http1___write_header_callback),
+                                &buf);
   /* write cookies */
   fio_http_set_cookie_each(h, fio_http1___write_header_callback, &buf);
   /* add streaming headers? */
@@ -47448,6 +58128,59 @@ FIO_SFUNC void fio___http_controller_http1_send_headers(fio_http_s *h) {
   //               .dealloc = FIO_STRING_FREE,
   //               .copy = 0);
 }
+
+/** Informs the controller that request / response headers must be sent. */
+FIO_SFUNC void fio___http_controller_http1_send_headers(fio_http_s *h) {
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  if (c->state.http.cache && c->state.http.cache_hit)
+    return;
+  if (!c->io || !fio_io_is_open(c->io))
+    return;
+  if (c->settings->compress && fio___http_zip_start(c, h))
+    return; /* sent with the compressed body (see `write_body`) */
+  fio___http1_write_headers(c, h, 0, 0);
+}
+
+/** Compresses a complete response body, sending the postponed headers. */
+FIO_SFUNC void fio___http_zip_body(fio___http_connection_s *c,
+                                   fio_http_s *h,
+                                   fio_http_write_args_s *args) {
+  uint8_t type = c->state.http.zip_type;
+  char *out = NULL;
+  void *zip;
+  fio_str_info_s len =
+      fio_http_response_header(h,
+                               FIO_STR_INFO2((char *)"content-length", 14),
+                               0);
+  c->state.http.zip_type = 0;
+  /* compress only if the whole body is written at once (not a file) */
+  if (args->buf && args->len && fio_atol10u(&len.buf) == args->len &&
+      (zip = fio___http_zip_new(type, c->settings->compress, args->len))) {
+    out = fio___http_zip(type,
+                         zip,
+                         (char *)args->buf + args->offset,
+                         args->len,
+                         1);
+    fio___http_zip_free(type, zip);
+    if (fio_bstr_len(out) >= args->len) { /* no gain */
+      fio_bstr_free(out);
+      out = NULL;
+    }
+  }
+  if (out)
+    fio___http_zip_etag(h);
+  fio___http1_write_headers(c, h, (out ? type : 0), fio_bstr_len(out));
+  if (!out)
+    return;
+  if (args->dealloc)
+    args->dealloc((void *)args->buf);
+  *args = (fio_http_write_args_s){
+      .buf = out,
+      .len = fio_bstr_len(out),
+      .dealloc = (void (*)(void *))fio_bstr_free,
+      .finish = args->finish,
+  };
+}
 /** called by the HTTP handle for each body chunk (or to finish a response. */
 FIO_SFUNC void fio___http_controller_http1_write_body(
     fio_http_s *h,
@@ -47457,6 +58190,10 @@ FIO_SFUNC void fio___http_controller_http1_write_body(
     goto no_write_err;
   if (fio_http_is_streaming(h))
     goto stream_chunk;
+  if (c->state.http.zip_type)
+    fio___http_zip_body(c, h, &args);
+  if (c->state.http.cache && fio___http_cache_on_body(c, &args))
+    return;
   if (c->state.http.buf.len) {
     if (args.buf && args.len) {
       fio_string_write(&c->state.http.buf,
@@ -47485,6 +58222,8 @@ FIO_SFUNC void fio___http_controller_http1_write_body(
   return;
 
 stream_chunk:
+  if (c->state.http.zip && fio___http_zip_chunk(c, &args))
+    return;
   if (args.len && args.buf) { /* String */
     if (args.copy || args.len < (1 << 16)) {
       fio_string_write2(
@@ -47643,6 +58382,10 @@ no_io:
 /** called once a request / response had finished */
 FIO_SFUNC void fio___http_controller_http1_on_finish(fio_http_s *h) {
   fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  if (c->state.http.zip_type)
+    fio___http_zip_finish(c);
+  if (c->state.http.cache)
+    fio___http_cache_on_finish(c);
   if (c->state.http.buf.len) {
     if (fio_http_is_streaming(h))
       fio_string_write(&c->state.http.buf, FIO_STRING_REALLOC, "0\r\n\r\n", 5);
@@ -47672,33 +58415,1956 @@ upgraded:
 }
 
 /* *****************************************************************************
-HTTP/2 Protocol (disconnect, as HTTP/2 is unsupported)
+HTTP/2 - Constants (RFC 9113)
+***************************************************************************** */
+
+#define FIO___HTTP2_FRAME_DATA            0x0
+#define FIO___HTTP2_FRAME_HEADERS         0x1
+#define FIO___HTTP2_FRAME_PRIORITY        0x2
+#define FIO___HTTP2_FRAME_RST_STREAM      0x3
+#define FIO___HTTP2_FRAME_SETTINGS        0x4
+#define FIO___HTTP2_FRAME_PUSH_PROMISE    0x5
+#define FIO___HTTP2_FRAME_PING            0x6
+#define FIO___HTTP2_FRAME_GOAWAY          0x7
+#define FIO___HTTP2_FRAME_WINDOW_UPDATE   0x8
+#define FIO___HTTP2_FRAME_CONTINUATION    0x9
+#define FIO___HTTP2_FRAME_PRIORITY_UPDATE 0x10 /* RFC 9218 */
+
+#define FIO___HTTP2_FLAG_END_STREAM  0x1
+#define FIO___HTTP2_FLAG_ACK         0x1
+#define FIO___HTTP2_FLAG_END_HEADERS 0x4
+#define FIO___HTTP2_FLAG_PADDED      0x8
+#define FIO___HTTP2_FLAG_PRIORITY    0x20
+
+#define FIO___HTTP2_NO_ERROR            0x0
+#define FIO___HTTP2_PROTOCOL_ERROR      0x1
+#define FIO___HTTP2_INTERNAL_ERROR      0x2
+#define FIO___HTTP2_FLOW_CONTROL_ERROR  0x3
+#define FIO___HTTP2_STREAM_CLOSED       0x5
+#define FIO___HTTP2_FRAME_SIZE_ERROR    0x6
+#define FIO___HTTP2_REFUSED_STREAM      0x7
+#define FIO___HTTP2_CANCEL              0x8
+#define FIO___HTTP2_COMPRESSION_ERROR   0x9
+#define FIO___HTTP2_ENHANCE_YOUR_CALM   0xb
+#define FIO___HTTP2_HTTP_1_1_REQUIRED   0xd
+
+/* stream state flags */
+#define FIO___HTTP2_S_REMOTE_CLOSED 1  /* END_STREAM received */
+#define FIO___HTTP2_S_LOCAL_CLOSED  2  /* END_STREAM sent */
+#define FIO___HTTP2_S_HEADERS_SENT  4  /* response HEADERS were sent */
+#define FIO___HTTP2_S_FINISHED      8  /* response body is complete */
+#define FIO___HTTP2_S_ACTIVE        16 /* listed as having pending output */
+#define FIO___HTTP2_S_DISCARD       32 /* request body is ignored */
+#define FIO___HTTP2_S_PRE_BODY      64 /* `pre_http_body` was called */
+
+/* our SETTINGS_MAX_FRAME_SIZE (the protocol's default) */
+#define FIO___HTTP2_FRAME_MAX 16384
+/* default (and maximum) HPACK dynamic table size */
+#define FIO___HTTP2_HPACK_MAX 4096
+/* DATA bytes written per flush cycle, allowing other connections to run */
+#define FIO___HTTP2_FLUSH_LIMIT 262144
+/* stop writing DATA frames while the IO's outgoing buffer is this large */
+#define FIO___HTTP2_BACKLOG_LIMIT 1048576
+
+/* *****************************************************************************
+HTTP/2 - HPACK Huffman Code (RFC 7541, Appendix B)
+
+The code is canonical, so decoding uses the first code / count / symbol offset
+of each code length (5-30 bits) rather than a decoding tree.
+***************************************************************************** */
+
+static const uint32_t fio___hpack_huff_code[257] = {
+    0x1FF8, 0x7FFFD8, 0xFFFFFE2, 0xFFFFFE3, 0xFFFFFE4, 0xFFFFFE5,
+    0xFFFFFE6, 0xFFFFFE7, 0xFFFFFE8, 0xFFFFEA, 0x3FFFFFFC, 0xFFFFFE9,
+    0xFFFFFEA, 0x3FFFFFFD, 0xFFFFFEB, 0xFFFFFEC, 0xFFFFFED, 0xFFFFFEE,
+    0xFFFFFEF, 0xFFFFFF0, 0xFFFFFF1, 0xFFFFFF2, 0x3FFFFFFE, 0xFFFFFF3,
+    0xFFFFFF4, 0xFFFFFF5, 0xFFFFFF6, 0xFFFFFF7, 0xFFFFFF8, 0xFFFFFF9,
+    0xFFFFFFA, 0xFFFFFFB, 0x14, 0x3F8, 0x3F9, 0xFFA,
+    0x1FF9, 0x15, 0xF8, 0x7FA, 0x3FA, 0x3FB,
+    0xF9, 0x7FB, 0xFA, 0x16, 0x17, 0x18,
+    0x0, 0x1, 0x2, 0x19, 0x1A, 0x1B,
+    0x1C, 0x1D, 0x1E, 0x1F, 0x5C, 0xFB,
+    0x7FFC, 0x20, 0xFFB, 0x3FC, 0x1FFA, 0x21,
+    0x5D, 0x5E, 0x5F, 0x60, 0x61, 0x62,
+    0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6A, 0x6B, 0x6C, 0x6D, 0x6E,
+    0x6F, 0x70, 0x71, 0x72, 0xFC, 0x73,
+    0xFD, 0x1FFB, 0x7FFF0, 0x1FFC, 0x3FFC, 0x22,
+    0x7FFD, 0x3, 0x23, 0x4, 0x24, 0x5,
+    0x25, 0x26, 0x27, 0x6, 0x74, 0x75,
+    0x28, 0x29, 0x2A, 0x7, 0x2B, 0x76,
+    0x2C, 0x8, 0x9, 0x2D, 0x77, 0x78,
+    0x79, 0x7A, 0x7B, 0x7FFE, 0x7FC, 0x3FFD,
+    0x1FFD, 0xFFFFFFC, 0xFFFE6, 0x3FFFD2, 0xFFFE7, 0xFFFE8,
+    0x3FFFD3, 0x3FFFD4, 0x3FFFD5, 0x7FFFD9, 0x3FFFD6, 0x7FFFDA,
+    0x7FFFDB, 0x7FFFDC, 0x7FFFDD, 0x7FFFDE, 0xFFFFEB, 0x7FFFDF,
+    0xFFFFEC, 0xFFFFED, 0x3FFFD7, 0x7FFFE0, 0xFFFFEE, 0x7FFFE1,
+    0x7FFFE2, 0x7FFFE3, 0x7FFFE4, 0x1FFFDC, 0x3FFFD8, 0x7FFFE5,
+    0x3FFFD9, 0x7FFFE6, 0x7FFFE7, 0xFFFFEF, 0x3FFFDA, 0x1FFFDD,
+    0xFFFE9, 0x3FFFDB, 0x3FFFDC, 0x7FFFE8, 0x7FFFE9, 0x1FFFDE,
+    0x7FFFEA, 0x3FFFDD, 0x3FFFDE, 0xFFFFF0, 0x1FFFDF, 0x3FFFDF,
+    0x7FFFEB, 0x7FFFEC, 0x1FFFE0, 0x1FFFE1, 0x3FFFE0, 0x1FFFE2,
+    0x7FFFED, 0x3FFFE1, 0x7FFFEE, 0x7FFFEF, 0xFFFEA, 0x3FFFE2,
+    0x3FFFE3, 0x3FFFE4, 0x7FFFF0, 0x3FFFE5, 0x3FFFE6, 0x7FFFF1,
+    0x3FFFFE0, 0x3FFFFE1, 0xFFFEB, 0x7FFF1, 0x3FFFE7, 0x7FFFF2,
+    0x3FFFE8, 0x1FFFFEC, 0x3FFFFE2, 0x3FFFFE3, 0x3FFFFE4, 0x7FFFFDE,
+    0x7FFFFDF, 0x3FFFFE5, 0xFFFFF1, 0x1FFFFED, 0x7FFF2, 0x1FFFE3,
+    0x3FFFFE6, 0x7FFFFE0, 0x7FFFFE1, 0x3FFFFE7, 0x7FFFFE2, 0xFFFFF2,
+    0x1FFFE4, 0x1FFFE5, 0x3FFFFE8, 0x3FFFFE9, 0xFFFFFFD, 0x7FFFFE3,
+    0x7FFFFE4, 0x7FFFFE5, 0xFFFEC, 0xFFFFF3, 0xFFFED, 0x1FFFE6,
+    0x3FFFE9, 0x1FFFE7, 0x1FFFE8, 0x7FFFF3, 0x3FFFEA, 0x3FFFEB,
+    0x1FFFFEE, 0x1FFFFEF, 0xFFFFF4, 0xFFFFF5, 0x3FFFFEA, 0x7FFFF4,
+    0x3FFFFEB, 0x7FFFFE6, 0x3FFFFEC, 0x3FFFFED, 0x7FFFFE7, 0x7FFFFE8,
+    0x7FFFFE9, 0x7FFFFEA, 0x7FFFFEB, 0xFFFFFFE, 0x7FFFFEC, 0x7FFFFED,
+    0x7FFFFEE, 0x7FFFFEF, 0x7FFFFF0, 0x3FFFFEE, 0x3FFFFFFF,
+};
+
+static const uint8_t fio___hpack_huff_bits[257] = {
+    13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+    28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+    6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+    5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+    13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+    15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+    6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+    20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+    24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+    22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+    21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+    26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+    19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+    20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+    26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+    30,
+};
+
+static const uint32_t fio___hpack_huff_first[26] = {
+    0x0, 0x14, 0x5C, 0xF8, 0x0, 0x3F8,
+    0x7FA, 0xFFA, 0x1FF8, 0x3FFC, 0x7FFC, 0x0,
+    0x0, 0x0, 0x7FFF0, 0xFFFE6, 0x1FFFDC, 0x3FFFD2,
+    0x7FFFD8, 0xFFFFEA, 0x1FFFFEC, 0x3FFFFE0, 0x7FFFFDE, 0xFFFFFE2,
+    0x0, 0x3FFFFFFC,
+};
+
+static const uint16_t fio___hpack_huff_count[26] = {
+    10, 26, 32, 6, 0, 5, 3, 2, 6, 2, 3, 0, 0,
+    0, 3, 8, 13, 26, 29, 12, 4, 15, 19, 29, 0, 4,
+};
+
+static const uint16_t fio___hpack_huff_offset[26] = {
+    0, 10, 36, 68, 0, 74, 79, 82, 84, 90, 92, 0, 0,
+    0, 95, 98, 106, 119, 145, 174, 186, 190, 205, 224, 0, 253,
+};
+
+static const uint16_t fio___hpack_huff_sym[257] = {
+    48, 49, 50, 97, 99, 101, 105, 111, 115, 116, 32, 37,
+    45, 46, 47, 51, 52, 53, 54, 55, 56, 57, 61, 65,
+    95, 98, 100, 102, 103, 104, 108, 109, 110, 112, 114, 117,
+    58, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76,
+    77, 78, 79, 80, 81, 82, 83, 84, 85, 86, 87, 89,
+    106, 107, 113, 118, 119, 120, 121, 122, 38, 42, 44, 59,
+    88, 90, 33, 34, 40, 41, 63, 39, 43, 124, 35, 62,
+    0, 36, 64, 91, 93, 126, 94, 125, 60, 96, 123, 92,
+    195, 208, 128, 130, 131, 162, 184, 194, 224, 226, 153, 161,
+    167, 172, 176, 177, 179, 209, 216, 217, 227, 229, 230, 129,
+    132, 133, 134, 136, 146, 154, 156, 160, 163, 164, 169, 170,
+    173, 178, 181, 185, 186, 187, 189, 190, 196, 198, 228, 232,
+    233, 1, 135, 137, 138, 139, 140, 141, 143, 147, 149, 150,
+    151, 152, 155, 157, 158, 165, 166, 168, 174, 175, 180, 182,
+    183, 188, 191, 197, 231, 239, 9, 142, 144, 145, 148, 159,
+    171, 206, 215, 225, 236, 237, 199, 207, 234, 235, 192, 193,
+    200, 201, 202, 205, 210, 213, 218, 219, 238, 240, 242, 243,
+    255, 203, 204, 211, 212, 214, 221, 222, 223, 241, 244, 245,
+    246, 247, 248, 250, 251, 252, 253, 254, 2, 3, 4, 5,
+    6, 7, 8, 11, 12, 14, 15, 16, 17, 18, 19, 20,
+    21, 23, 24, 25, 26, 27, 28, 29, 30, 31, 127, 220,
+    249, 10, 13, 22, 256,
+};
+
+
+/** Returns the length of `len` bytes, once Huffman encoded. */
+FIO_IFUNC size_t fio___hpack_huff_length(const uint8_t *s, size_t len) {
+  size_t bits = 0;
+  for (size_t i = 0; i < len; ++i)
+    bits += fio___hpack_huff_bits[s[i]];
+  return (bits + 7) >> 3;
+}
+
+/** Huffman encodes `len` bytes to `dest`, returning the number of bytes. */
+FIO_SFUNC size_t fio___hpack_huff_encode(uint8_t *dest,
+                                         const uint8_t *s,
+                                         size_t len) {
+  uint64_t acc = 0;
+  size_t bits = 0, r = 0;
+  for (size_t i = 0; i < len; ++i) {
+    acc = (acc << fio___hpack_huff_bits[s[i]]) | fio___hpack_huff_code[s[i]];
+    bits += fio___hpack_huff_bits[s[i]];
+    while (bits >= 8) {
+      bits -= 8;
+      dest[r++] = (uint8_t)(acc >> bits);
+    }
+  }
+  if (bits) /* pad using the most significant bits of EOS (all ones) */
+    dest[r++] = (uint8_t)((acc << (8 - bits)) | (0xFFU >> bits));
+  return r;
+}
+
+/** Huffman decodes `len` bytes to `dest`. Returns -1 on error. */
+FIO_SFUNC int fio___hpack_huff_decode(char *dest,
+                                      size_t *dest_len,
+                                      const uint8_t *s,
+                                      size_t len) {
+  uint64_t acc = 0;
+  size_t bits = 0, r = 0;
+  for (;;) {
+    uint32_t peek, sym = 256;
+    size_t l;
+    while (bits <= 56 && len) {
+      acc = (acc << 8) | *(s++);
+      --len;
+      bits += 8;
+    }
+    if (!bits)
+      break;
+    /* peek at the next 30 bits, padding with ones (the EOS prefix) */
+    if (bits >= 30)
+      peek = (uint32_t)(acc >> (bits - 30)) & 0x3FFFFFFFUL;
+    else
+      peek = (uint32_t)((acc << (30 - bits)) | ((1ULL << (30 - bits)) - 1)) &
+             0x3FFFFFFFUL;
+    for (l = 5; l <= 30; ++l) {
+      uint32_t i = (peek >> (30 - l)) - fio___hpack_huff_first[l - 5];
+      if (i < fio___hpack_huff_count[l - 5]) {
+        sym = fio___hpack_huff_sym[fio___hpack_huff_offset[l - 5] + i];
+        break;
+      }
+    }
+    if (l > bits) { /* padding: at most 7 bits, all set */
+      if (bits > 7 || (acc & ((1ULL << bits) - 1)) != ((1ULL << bits) - 1))
+        return -1;
+      break;
+    }
+    if (sym == 256) /* EOS is a decoding error */
+      return -1;
+    dest[r++] = (char)sym;
+    bits -= l;
+  }
+  *dest_len = r;
+  return 0;
+}
+
+/* *****************************************************************************
+HTTP/2 - HPACK Integers & String Literals (RFC 7541, section 5)
 ***************************************************************************** */
 
-// /** Called when an IO is attached to a protocol. */
-// void (*on_attach)(fio_io_s *io);
-// /** Called when a data is available. */
-// void (*on_data)(fio_io_s *io);
-// /** called once all pending `fio_io_write` calls are finished. */
-// void (*on_ready)(fio_io_s *io);
-// /** Called after the connection was closed, and pending tasks
-// completed.
-// */ void (*on_close)(void *udata);
+/** Reads an integer with an N-bit prefix. Returns -1 on error. */
+FIO_IFUNC int fio___hpack_int_read(uint64_t *dest,
+                                   const uint8_t **pos,
+                                   const uint8_t *end,
+                                   uint8_t prefix) {
+  const uint8_t *p = *pos;
+  const uint64_t mask = (1U << prefix) - 1;
+  uint64_t r;
+  if (p >= end)
+    return -1;
+  r = *(p++) & mask;
+  if (r == mask) {
+    for (size_t shift = 0;; shift += 7) {
+      if (p >= end || shift > 28)
+        return -1;
+      r += (uint64_t)(*p & 0x7F) << shift;
+      if (!(*(p++) & 0x80))
+        break;
+    }
+  }
+  *dest = r;
+  *pos = p;
+  return 0;
+}
+
+/** Writes an integer with an N-bit prefix, returning the bytes written. */
+FIO_IFUNC size_t fio___hpack_int_write(uint8_t *dest,
+                                       uint64_t i,
+                                       uint8_t prefix,
+                                       uint8_t first) {
+  const uint64_t mask = (1U << prefix) - 1;
+  size_t r = 1;
+  if (i < mask) {
+    dest[0] = first | (uint8_t)i;
+    return 1;
+  }
+  dest[0] = first | (uint8_t)mask;
+  i -= mask;
+  while (i >= 0x80) {
+    dest[r++] = (uint8_t)(i | 0x80);
+    i >>= 7;
+  }
+  dest[r++] = (uint8_t)i;
+  return r;
+}
+
+/** Reads a string literal, Huffman decoding it to `scratch` if required. */
+FIO_SFUNC int fio___hpack_str_read(fio_str_info_s *dest,
+                                   const uint8_t **pos,
+                                   const uint8_t *end,
+                                   char **scratch) {
+  uint64_t len;
+  const uint8_t huffman = (*pos < end) && (**pos & 0x80);
+  if (fio___hpack_int_read(&len, pos, end, 7) ||
+      len > (uint64_t)(end - *pos))
+    return -1;
+  if (!huffman) {
+    *dest = FIO_STR_INFO2((char *)*pos, (size_t)len);
+    *pos += len;
+    return 0;
+  }
+  dest->buf = *scratch;
+  if (fio___hpack_huff_decode(dest->buf, &dest->len, *pos, (size_t)len))
+    return -1;
+  *scratch += dest->len;
+  *pos += len;
+  return 0;
+}
+
+/** Writes a string literal, Huffman encoded when shorter. */
+FIO_IFUNC size_t fio___hpack_str_write(uint8_t *dest, fio_str_info_s s) {
+  size_t r;
+  const size_t hlen = fio___hpack_huff_length((uint8_t *)s.buf, s.len);
+  if (hlen < s.len) {
+    r = fio___hpack_int_write(dest, hlen, 7, 0x80);
+    return r + fio___hpack_huff_encode(dest + r, (uint8_t *)s.buf, s.len);
+  }
+  r = fio___hpack_int_write(dest, s.len, 7, 0);
+  if (s.len)
+    FIO_MEMCPY(dest + r, s.buf, s.len);
+  return r + s.len;
+}
+
+/* *****************************************************************************
+HTTP/2 - HPACK Static & Dynamic Tables (RFC 7541, section 2.3)
+***************************************************************************** */
+
+#define FIO___HPACK_STATIC(n, v) {n, v, sizeof(n) - 1, sizeof(v) - 1}
+static const struct {
+  const char *name;
+  const char *value;
+  uint8_t nlen;
+  uint8_t vlen;
+} fio___hpack_static[61] = {
+    FIO___HPACK_STATIC(":authority", ""),
+    FIO___HPACK_STATIC(":method", "GET"),
+    FIO___HPACK_STATIC(":method", "POST"),
+    FIO___HPACK_STATIC(":path", "/"),
+    FIO___HPACK_STATIC(":path", "/index.html"),
+    FIO___HPACK_STATIC(":scheme", "http"),
+    FIO___HPACK_STATIC(":scheme", "https"),
+    FIO___HPACK_STATIC(":status", "200"),
+    FIO___HPACK_STATIC(":status", "204"),
+    FIO___HPACK_STATIC(":status", "206"),
+    FIO___HPACK_STATIC(":status", "304"),
+    FIO___HPACK_STATIC(":status", "400"),
+    FIO___HPACK_STATIC(":status", "404"),
+    FIO___HPACK_STATIC(":status", "500"),
+    FIO___HPACK_STATIC("accept-charset", ""),
+    FIO___HPACK_STATIC("accept-encoding", "gzip, deflate"),
+    FIO___HPACK_STATIC("accept-language", ""),
+    FIO___HPACK_STATIC("accept-ranges", ""),
+    FIO___HPACK_STATIC("accept", ""),
+    FIO___HPACK_STATIC("access-control-allow-origin", ""),
+    FIO___HPACK_STATIC("age", ""),
+    FIO___HPACK_STATIC("allow", ""),
+    FIO___HPACK_STATIC("authorization", ""),
+    FIO___HPACK_STATIC("cache-control", ""),
+    FIO___HPACK_STATIC("content-disposition", ""),
+    FIO___HPACK_STATIC("content-encoding", ""),
+    FIO___HPACK_STATIC("content-language", ""),
+    FIO___HPACK_STATIC("content-length", ""),
+    FIO___HPACK_STATIC("content-location", ""),
+    FIO___HPACK_STATIC("content-range", ""),
+    FIO___HPACK_STATIC("content-type", ""),
+    FIO___HPACK_STATIC("cookie", ""),
+    FIO___HPACK_STATIC("date", ""),
+    FIO___HPACK_STATIC("etag", ""),
+    FIO___HPACK_STATIC("expect", ""),
+    FIO___HPACK_STATIC("expires", ""),
+    FIO___HPACK_STATIC("from", ""),
+    FIO___HPACK_STATIC("host", ""),
+    FIO___HPACK_STATIC("if-match", ""),
+    FIO___HPACK_STATIC("if-modified-since", ""),
+    FIO___HPACK_STATIC("if-none-match", ""),
+    FIO___HPACK_STATIC("if-range", ""),
+    FIO___HPACK_STATIC("if-unmodified-since", ""),
+    FIO___HPACK_STATIC("last-modified", ""),
+    FIO___HPACK_STATIC("link", ""),
+    FIO___HPACK_STATIC("location", ""),
+    FIO___HPACK_STATIC("max-forwards", ""),
+    FIO___HPACK_STATIC("proxy-authenticate", ""),
+    FIO___HPACK_STATIC("proxy-authorization", ""),
+    FIO___HPACK_STATIC("range", ""),
+    FIO___HPACK_STATIC("referer", ""),
+    FIO___HPACK_STATIC("refresh", ""),
+    FIO___HPACK_STATIC("retry-after", ""),
+    FIO___HPACK_STATIC("server", ""),
+    FIO___HPACK_STATIC("set-cookie", ""),
+    FIO___HPACK_STATIC("strict-transport-security", ""),
+    FIO___HPACK_STATIC("transfer-encoding", ""),
+    FIO___HPACK_STATIC("user-agent", ""),
+    FIO___HPACK_STATIC("vary", ""),
+    FIO___HPACK_STATIC("via", ""),
+    FIO___HPACK_STATIC("www-authenticate", ""),
+};
+#undef FIO___HPACK_STATIC
+
+/** A dynamic table entry (name and value share a single allocation). */
+typedef struct {
+  char *buf;
+  uint32_t nlen;
+  uint32_t vlen;
+} fio___hpack_entry_s;
+
+/** A dynamic table - a ring buffer where index 0 is the newest entry. */
+typedef struct {
+  fio___hpack_entry_s *ary;
+  uint32_t capa;  /* ring capacity (a power of 2) */
+  uint32_t head;  /* ring position of the next insertion */
+  uint32_t count; /* number of entries */
+  uint32_t size;  /* table size, as defined by RFC 7541, section 4.1 */
+  uint32_t max;   /* maximum table size */
+  uint8_t update; /* (encoder) a size update must be sent */
+} fio___hpack_table_s;
+
+FIO_IFUNC fio___hpack_entry_s *fio___hpack_table_get(fio___hpack_table_s *t,
+                                                     size_t i) {
+  return t->ary + ((t->head - 1 - (uint32_t)i) & (t->capa - 1));
+}
+
+/** Evicts the oldest entries until the table size fits in `max`. */
+FIO_SFUNC void fio___hpack_table_evict(fio___hpack_table_s *t, size_t max) {
+  while (t->size > max && t->count) {
+    fio___hpack_entry_s *e = fio___hpack_table_get(t, t->count - 1);
+    t->size -= e->nlen + e->vlen + 32;
+    FIO_MEM_FREE_(e->buf, e->nlen + e->vlen + 1);
+    e->buf = NULL;
+    --t->count;
+  }
+}
+
+FIO_SFUNC void fio___hpack_table_destroy(fio___hpack_table_s *t) {
+  fio___hpack_table_evict(t, 0);
+  FIO_MEM_FREE_(t->ary, sizeof(*t->ary) * t->capa);
+  *t = (fio___hpack_table_s){0};
+}
+
+/** Adds an entry, evicting older entries as required. */
+FIO_SFUNC void fio___hpack_table_add(fio___hpack_table_s *t,
+                                     fio_str_info_s name,
+                                     fio_str_info_s value) {
+  const size_t size = name.len + value.len + 32;
+  char *buf;
+  if (size > t->max) { /* not an error, the table is emptied */
+    fio___hpack_table_evict(t, 0);
+    return;
+  }
+  /* copy before eviction, as `name` may point to an evicted entry */
+  buf = (char *)FIO_MEM_REALLOC_(NULL, 0, name.len + value.len + 1, 0);
+  FIO_ASSERT_ALLOC(buf);
+  if (name.len)
+    FIO_MEMCPY(buf, name.buf, name.len);
+  if (value.len)
+    FIO_MEMCPY(buf + name.len, value.buf, value.len);
+  fio___hpack_table_evict(t, t->max - size);
+  if (t->count == t->capa) {
+    const uint32_t capa = t->capa ? (t->capa << 1) : 16;
+    fio___hpack_entry_s *tmp = (fio___hpack_entry_s *)
+        FIO_MEM_REALLOC_(NULL, 0, sizeof(*tmp) * capa, 0);
+    FIO_ASSERT_ALLOC(tmp);
+    for (size_t i = 0; i < t->count; ++i)
+      tmp[t->count - 1 - i] = *fio___hpack_table_get(t, i);
+    FIO_MEM_FREE_(t->ary, sizeof(*t->ary) * t->capa);
+    t->ary = tmp;
+    t->capa = capa;
+    t->head = t->count;
+  }
+  t->ary[t->head & (t->capa - 1)] = (fio___hpack_entry_s){
+      .buf = buf,
+      .nlen = (uint32_t)name.len,
+      .vlen = (uint32_t)value.len,
+  };
+  ++t->head;
+  ++t->count;
+  t->size += (uint32_t)size;
+}
+
+/** Gets the header field at `index` (static or dynamic). */
+FIO_SFUNC int fio___hpack_table_index(fio___hpack_table_s *t,
+                                      uint64_t index,
+                                      fio_str_info_s *name,
+                                      fio_str_info_s *value) {
+  fio___hpack_entry_s *e;
+  if (!index)
+    return -1;
+  if (index <= 61) {
+    --index;
+    *name = FIO_STR_INFO2((char *)fio___hpack_static[index].name,
+                          fio___hpack_static[index].nlen);
+    *value = FIO_STR_INFO2((char *)fio___hpack_static[index].value,
+                           fio___hpack_static[index].vlen);
+    return 0;
+  }
+  index -= 62;
+  if (index >= t->count)
+    return -1;
+  e = fio___hpack_table_get(t, (size_t)index);
+  *name = FIO_STR_INFO2(e->buf, e->nlen);
+  *value = FIO_STR_INFO2(e->buf + e->nlen, e->vlen);
+  return 0;
+}
+
+/** Finds a header field, returns its index (0 if missing). */
+FIO_SFUNC size_t fio___hpack_table_find(fio___hpack_table_s *t,
+                                        fio_str_info_s name,
+                                        fio_str_info_s value,
+                                        int *exact) {
+  size_t found = 0;
+  *exact = 0;
+  for (size_t i = 0; i < 61; ++i) {
+    if (fio___hpack_static[i].nlen != name.len ||
+        FIO_MEMCMP(fio___hpack_static[i].name, name.buf, name.len))
+      continue;
+    if (!found)
+      found = i + 1;
+    if (fio___hpack_static[i].vlen == value.len &&
+        (!value.len ||
+         !FIO_MEMCMP(fio___hpack_static[i].value, value.buf, value.len))) {
+      *exact = 1;
+      return i + 1;
+    }
+  }
+  for (size_t i = 0; i < t->count; ++i) {
+    fio___hpack_entry_s *e = fio___hpack_table_get(t, i);
+    if (e->nlen != name.len || FIO_MEMCMP(e->buf, name.buf, name.len))
+      continue;
+    if (!found)
+      found = i + 62;
+    if (e->vlen == value.len &&
+        (!value.len || !FIO_MEMCMP(e->buf + e->nlen, value.buf, value.len))) {
+      *exact = 1;
+      return i + 62;
+    }
+  }
+  return found;
+}
+
+/* *****************************************************************************
+HTTP/2 - HPACK Decoding / Encoding (RFC 7541, section 6)
+***************************************************************************** */
+
+/**
+ * Decodes a header block, calling `on_header` for each header field.
+ *
+ * Once `on_header` returns non-zero it is no longer called, but decoding
+ * continues so the dynamic table remains synchronized.
+ *
+ * Returns -1 on a decoding (compression) error, 1 if `on_header` failed.
+ */
+FIO_SFUNC int fio___hpack_decode(fio___hpack_table_s *t,
+                                 fio_buf_info_s block,
+                                 int (*on_header)(void *,
+                                                  fio_str_info_s name,
+                                                  fio_str_info_s value),
+                                 void *udata) {
+  char tmp[2048];
+  char *scratch_start = tmp;
+  const uint8_t *pos = (const uint8_t *)block.buf;
+  const uint8_t *end = pos + block.len;
+  const size_t scratch_len = ((block.len * 8) / 5) + 16;
+  int r = 0, any = 0;
+  if (scratch_len > sizeof(tmp)) {
+    scratch_start = (char *)FIO_MEM_REALLOC_(NULL, 0, scratch_len, 0);
+    FIO_ASSERT_ALLOC(scratch_start);
+  }
+  while (pos < end) {
+    char *scratch = scratch_start;
+    fio_str_info_s name, value;
+    uint64_t i;
+    uint8_t add = 0;
+    if ((*pos & 0x80)) { /* indexed header field */
+      if (fio___hpack_int_read(&i, &pos, end, 7) ||
+          fio___hpack_table_index(t, i, &name, &value))
+        goto decoding_error;
+    } else if ((*pos & 0xE0) == 0x20) { /* dynamic table size update */
+      if (any || fio___hpack_int_read(&i, &pos, end, 5) ||
+          i > FIO___HTTP2_HPACK_MAX)
+        goto decoding_error;
+      t->max = (uint32_t)i;
+      fio___hpack_table_evict(t, t->max);
+      continue;
+    } else { /* literal, with incremental indexing / without / never */
+      add = ((*pos & 0xC0) == 0x40);
+      if (fio___hpack_int_read(&i, &pos, end, (add ? 6 : 4)))
+        goto decoding_error;
+      if (i) {
+        if (fio___hpack_table_index(t, i, &name, &value))
+          goto decoding_error;
+      } else if (fio___hpack_str_read(&name, &pos, end, &scratch))
+        goto decoding_error;
+      if (fio___hpack_str_read(&value, &pos, end, &scratch))
+        goto decoding_error;
+    }
+    any = 1;
+    if (!r && on_header(udata, name, value))
+      r = 1;
+    if (add)
+      fio___hpack_table_add(t, name, value);
+  }
+  if (scratch_start != tmp)
+    FIO_MEM_FREE_(scratch_start, scratch_len);
+  return r;
+
+decoding_error:
+  if (scratch_start != tmp)
+    FIO_MEM_FREE_(scratch_start, scratch_len);
+  return -1;
+}
+
+/** Encoding modes: with incremental indexing, without indexing, never. */
+typedef enum {
+  FIO___HPACK_INDEX = 0,
+  FIO___HPACK_NO_INDEX = 1,
+  FIO___HPACK_NEVER_INDEX = 2,
+} fio___hpack_mode_e;
+
+/** Encodes a header field, appending it to the `dest` fio_bstr. */
+FIO_SFUNC char *fio___hpack_encode(fio___hpack_table_s *t,
+                                   char *dest,
+                                   fio_str_info_s name,
+                                   fio_str_info_s value,
+                                   fio___hpack_mode_e mode) {
+  int exact;
+  size_t i = fio___hpack_table_find(t, name, value, &exact);
+  size_t len = fio_bstr_len(dest);
+  uint8_t *p;
+  dest = fio_bstr_reserve(dest, name.len + value.len + 24);
+  p = (uint8_t *)dest + len;
+  if (exact && mode != FIO___HPACK_NEVER_INDEX) {
+    len += fio___hpack_int_write(p, i, 7, 0x80);
+    return fio_bstr_len_set(dest, len);
+  }
+  if (mode == FIO___HPACK_INDEX)
+    len += fio___hpack_int_write(p, i, 6, 0x40);
+  else
+    len += fio___hpack_int_write(p,
+                                 i,
+                                 4,
+                                 (mode == FIO___HPACK_NEVER_INDEX ? 0x10 : 0));
+  if (!i)
+    len += fio___hpack_str_write((uint8_t *)dest + len, name);
+  len += fio___hpack_str_write((uint8_t *)dest + len, value);
+  if (mode == FIO___HPACK_INDEX)
+    fio___hpack_table_add(t, name, value);
+  return fio_bstr_len_set(dest, len);
+}
+
+/* *****************************************************************************
+HTTP/2 - Session (Connection) State
+***************************************************************************** */
+#define FIO___RECURSIVE_INCLUDE 1
+
+#define FIO_MAP_NAME       fio___http2_smap
+#define FIO_MAP_KEY        uint32_t
+#define FIO_MAP_VALUE      fio___http_connection_s *
+#define FIO_MAP_HASH_FN(k) fio_risky_num((uint64_t)(k), 0)
+#include FIO_INCLUDE_FILE
+
+/** HTTP/2 connection state, attached to the connection's `state.h2`. */
+struct fio___http2_s {
+  fio_io_s *io;                /* NULL once the connection was closed */
+  fio___http_connection_s *c;  /* the connection object (IO `udata`) */
+  fio___http2_smap_s streams;  /* open streams by id */
+  FIO_LIST_HEAD active;        /* streams with pending output */
+  fio___hpack_table_s dec;     /* request header decoding */
+  fio___hpack_table_s enc;     /* response header encoding */
+  char *wbuf;                  /* pending frames, written once per cycle */
+  char *hblock;                /* incomplete header block (+ CONTINUATION) */
+  char *eblock;                /* header block encoding buffer */
+  int64_t window;              /* connection send window */
+  uint32_t recv;               /* bytes received since last WINDOW_UPDATE */
+  uint32_t peer_window;        /* peer's SETTINGS_INITIAL_WINDOW_SIZE */
+  uint32_t peer_frame;         /* peer's SETTINGS_MAX_FRAME_SIZE */
+  uint32_t last_id;            /* highest stream id received */
+  uint32_t hblock_id;          /* stream id for `hblock` */
+  uint32_t len;                /* bytes in `buf` */
+  uint32_t capa;               /* capacity of `buf` */
+  uint8_t hblock_flags;        /* HEADERS flags for `hblock` */
+  uint8_t flush;               /* flush task scheduled */
+  uint8_t goaway;              /* GOAWAY sent / received, no new streams */
+  uint8_t error;               /* connection error, stop processing */
+  char buf[];
+};
+
+#define FIO_REF_NAME             fio___http2
+#define FIO_REF_FLEX_TYPE        char
+#define FIO_REF_CONSTRUCTOR_ONLY 1
+#define FIO_REF_DESTROY(o)                                                     \
+  do {                                                                         \
+    fio___http2_smap_destroy(&o.streams);                                      \
+    fio___hpack_table_destroy(&o.dec);                                         \
+    fio___hpack_table_destroy(&o.enc);                                         \
+    fio_bstr_free(o.wbuf);                                                     \
+    fio_bstr_free(o.hblock);                                                   \
+    fio_bstr_free(o.eblock);                                                   \
+  } while (0)
+#include FIO_INCLUDE_FILE
+
+#undef FIO___RECURSIVE_INCLUDE
+
+FIO_SFUNC void fio___http2_flush(fio___http2_s *s);
+
+/* *****************************************************************************
+HTTP/2 - Frame Writing
+***************************************************************************** */
+
+FIO_IFUNC void fio___http2_frame_header(char *dest,
+                                        size_t len,
+                                        uint8_t type,
+                                        uint8_t flags,
+                                        uint32_t id) {
+  fio_u2buf24_be(dest, (uint32_t)len);
+  dest[3] = (char)type;
+  dest[4] = (char)flags;
+  fio_u2buf32_be(dest + 5, id & 0x7FFFFFFFUL);
+}
+
+/** Appends a frame to the session's write buffer. */
+FIO_SFUNC void fio___http2_frame(fio___http2_s *s,
+                                 uint8_t type,
+                                 uint8_t flags,
+                                 uint32_t id,
+                                 const void *payload,
+                                 size_t len) {
+  size_t pos = fio_bstr_len(s->wbuf);
+  s->wbuf = fio_bstr_reserve(s->wbuf, len + 9);
+  fio___http2_frame_header(s->wbuf + pos, len, type, flags, id);
+  if (len)
+    FIO_MEMCPY(s->wbuf + pos + 9, payload, len);
+  s->wbuf = fio_bstr_len_set(s->wbuf, pos + len + 9);
+}
+
+/** Appends a frame with a single 32 bit payload value. */
+FIO_IFUNC void fio___http2_frame32(fio___http2_s *s,
+                                   uint8_t type,
+                                   uint32_t id,
+                                   uint32_t value) {
+  char buf[4];
+  fio_u2buf32_be(buf, value);
+  fio___http2_frame(s, type, 0, id, buf, 4);
+}
+
+/** Hands the pending frames to the IO. */
+FIO_IFUNC void fio___http2_write(fio___http2_s *s) {
+  if (!s->wbuf || !s->io)
+    return;
+  fio_io_write2(s->io,
+                .buf = s->wbuf,
+                .len = fio_bstr_len(s->wbuf),
+                .dealloc = (void (*)(void *))fio_bstr_free);
+  s->wbuf = NULL;
+}
+
+/** Sends a GOAWAY frame, no new streams will be accepted. */
+FIO_SFUNC void fio___http2_goaway(fio___http2_s *s, uint32_t code) {
+  char buf[8];
+  fio_u2buf32_be(buf, s->last_id);
+  fio_u2buf32_be(buf + 4, code);
+  fio___http2_frame(s, FIO___HTTP2_FRAME_GOAWAY, 0, 0, buf, 8);
+  s->goaway = 1;
+}
+
+/** Connection errors: sends a GOAWAY frame and closes the connection. */
+FIO_SFUNC void fio___http2_error(fio___http2_s *s, uint32_t code) {
+  FIO_LOG_DDEBUG2("(%d) HTTP/2 connection error (%u) for %p",
+                  fio_io_pid(),
+                  (unsigned)code,
+                  (void *)s->io);
+  if (s->error)
+    return;
+  s->error = 1;
+  fio___http2_goaway(s, code);
+  fio___http2_write(s);
+  fio_io_close(s->io);
+}
+
+FIO_SFUNC void fio___http2_flush_task(void *s_, void *ignr_) {
+  fio___http2_s *s = (fio___http2_s *)s_;
+  s->flush = 0;
+  if (s->io && !s->error)
+    fio___http2_flush(s);
+  fio___http2_free(s);
+  (void)ignr_;
+}
+
+/** Schedules a flush (once per cycle), coalescing frames from all streams. */
+FIO_IFUNC void fio___http2_schedule(fio___http2_s *s) {
+  if (s->flush)
+    return;
+  s->flush = 1;
+  fio_io_defer(fio___http2_flush_task, (void *)fio___http2_dup(s), NULL);
+}
+
+/* *****************************************************************************
+HTTP/2 - Streams (each stream has its own connection object as `cdata`)
+***************************************************************************** */
+
+/** Creates a new stream with a new request handle. */
+FIO_SFUNC fio___http_connection_s *fio___http2_stream_new(fio___http2_s *s,
+                                                          uint32_t id) {
+  fio___http_protocol_s *p =
+      FIO_PTR_FROM_FIELD(fio___http_protocol_s, settings, s->c->settings);
+  fio___http_connection_s *st = fio___http_connection_new(0);
+  FIO_ASSERT_ALLOC(st);
+  fio___http_protocol_dup(p);
+  *st = (fio___http_connection_s){
+      .io = fio_io_dup(s->io),
+      .h = fio_http_new(),
+      .settings = s->c->settings,
+      .queue = s->c->queue,
+      .udata = s->c->udata,
+      .state.h2 =
+          {
+              .session = s,
+              .window = s->peer_window,
+              .id = id,
+              .urgency = 3, /* RFC 9218 default urgency */
+          },
+      .log = s->c->log,
+      .is_h2_stream = 1,
+  };
+  FIO_ASSERT_ALLOC(st->h);
+  st->state.h2.out = (fio_stream_s)FIO_STREAM_INIT(st->state.h2.out);
+  st->state.h2.node = FIO_LIST_INIT(st->state.h2.node);
+  fio_http_controller_set(st->h,
+                          &p->state[FIO___HTTP_PROTOCOL_HTTP2].controller);
+  fio_http_udata_set(st->h, st->udata);
+  fio_http_cdata_set(st->h, fio___http_connection_dup(st));
+  fio_http_version_set(st->h, FIO_STR_INFO2((char *)"HTTP/2", 6));
+  fio___http2_smap_set(&s->streams, id, st, NULL);
+  return st;
+}
+
+/** Marks a stream as having pending output and schedules a flush. */
+FIO_IFUNC void fio___http2_stream_activate(fio___http2_s *s,
+                                           fio___http_connection_s *st) {
+  if (!(st->state.h2.flags & FIO___HTTP2_S_ACTIVE)) {
+    st->state.h2.flags |= FIO___HTTP2_S_ACTIVE;
+    FIO_LIST_PUSH(&s->active, &st->state.h2.node);
+  }
+  fio___http2_schedule(s);
+}
+
+/** Removes a stream from the session, discarding any pending output. */
+FIO_SFUNC void fio___http2_stream_remove(fio___http2_s *s,
+                                         fio___http_connection_s *st) {
+  fio_http_s *h = st->h;
+  if (!st->state.h2.session)
+    return;
+  st->state.h2.session = NULL;
+  st->h = NULL;
+  if ((st->state.h2.flags & FIO___HTTP2_S_ACTIVE))
+    FIO_LIST_REMOVE_RESET(&st->state.h2.node);
+  st->state.h2.flags |= FIO___HTTP2_S_LOCAL_CLOSED |
+                        FIO___HTTP2_S_REMOTE_CLOSED;
+  fio_stream_destroy(&st->state.h2.out);
+  fio_bstr_free(st->state.h2.hdr);
+  st->state.h2.hdr = NULL;
+  fio___http2_smap_remove(&s->streams, st->state.h2.id, NULL);
+  if (h) { /* an incomplete request that was never handled, don't log */
+    st->log = 0;
+    fio_http_free(h);
+  }
+  fio___http_connection_free(st);
+  if (s->goaway && s->io && !fio___http2_smap_count(&s->streams))
+    fio_io_close(s->io);
+}
+
+/** Stream errors: sends RST_STREAM and removes the stream. */
+FIO_IFUNC void fio___http2_stream_reset(fio___http2_s *s,
+                                        fio___http_connection_s *st,
+                                        uint32_t code) {
+  fio___http2_frame32(s,
+                      FIO___HTTP2_FRAME_RST_STREAM,
+                      st->state.h2.id,
+                      code);
+  fio___http2_stream_remove(s, st);
+}
+
+/** Answers a request with an error before it reached the user's callback. */
+FIO_SFUNC void fio___http2_stream_refuse(fio___http_connection_s *st,
+                                         size_t status) {
+  fio_http_s *h = st->h;
+  st->h = NULL;
+  st->state.h2.flags |= FIO___HTTP2_S_DISCARD;
+  fio_http_send_error_response(h, status);
+  fio_http_free(h);
+}
+
+/** Parses the RFC 9218 urgency (`u=N`) from a `priority` field value. */
+FIO_IFUNC uint8_t fio___http2_urgency(fio_str_info_s v, uint8_t dflt) {
+  for (size_t i = 0; i + 2 < v.len; ++i) {
+    if (v.buf[i] != 'u' || v.buf[i + 1] != '=' ||
+        (i && v.buf[i - 1] != ' ' && v.buf[i - 1] != ','))
+      continue;
+    if (v.buf[i + 2] >= '0' && v.buf[i + 2] <= '7')
+      return (uint8_t)(v.buf[i + 2] - '0');
+    return dflt;
+  }
+  return dflt;
+}
+
+/** Tests for connection specific headers (RFC 9113, section 8.2.2). */
+FIO_IFUNC int fio___http2_is_connection_header(fio_str_info_s n) {
+  switch (n.len) {
+  case 7: return !FIO_MEMCMP(n.buf, "upgrade", 7);
+  case 10:
+    return !FIO_MEMCMP(n.buf, "connection", 10) ||
+           !FIO_MEMCMP(n.buf, "keep-alive", 10);
+  case 16: return !FIO_MEMCMP(n.buf, "proxy-connection", 16);
+  case 17: return !FIO_MEMCMP(n.buf, "transfer-encoding", 17);
+  }
+  return 0;
+}
+
+/* *****************************************************************************
+HTTP/2 - Requests (HEADERS, CONTINUATION, DATA)
+***************************************************************************** */
+
+typedef struct {
+  fio___http_connection_s *st;
+  size_t bytes;
+  uint8_t regular; /* a regular header was received (no more pseudo headers) */
+  uint8_t trailer;
+  uint8_t err; /* 1: malformed, otherwise an HTTP status code */
+  uint16_t status;
+} fio___http2_headers_s;
+
+/** HPACK callback, adding a decoded header field to the request. */
+FIO_SFUNC int fio___http2_on_header(void *ctx_,
+                                    fio_str_info_s name,
+                                    fio_str_info_s value) {
+  fio___http2_headers_s *ctx = (fio___http2_headers_s *)ctx_;
+  fio_http_s *h = ctx->st ? ctx->st->h : NULL;
+  if (!h)
+    return -1; /* refused / discarded stream, keep HPACK state only */
+  ctx->bytes += name.len + value.len + 32;
+  if (ctx->bytes > ctx->st->settings->max_header_size) {
+    ctx->status = 431;
+    return -1;
+  }
+  if (!name.len)
+    goto malformed;
+  if (name.buf[0] == ':') { /* pseudo-header fields */
+    if (ctx->regular || ctx->trailer)
+      goto malformed;
+    if (name.len == 7 && !FIO_MEMCMP(name.buf, ":method", 7)) {
+      if (fio_http_method(h).len)
+        goto malformed;
+      fio_http_method_set(h, value);
+    } else if (name.len == 5 && !FIO_MEMCMP(name.buf, ":path", 5)) {
+      char *q = value.len ? (char *)FIO_MEMCHR(value.buf, '?', value.len)
+                          : NULL;
+      if (fio_http_path(h).len || !value.len)
+        goto malformed;
+      if (q) {
+        fio_http_query_set(
+            h,
+            FIO_STR_INFO2(q + 1, (size_t)((value.buf + value.len) - (q + 1))));
+        value.len = (size_t)(q - value.buf);
+      }
+      fio_http_path_set(h, value);
+    } else if (name.len == 10 && !FIO_MEMCMP(name.buf, ":authority", 10)) {
+      fio_http_request_header_set(h, FIO_STR_INFO2((char *)"host", 4), value);
+    } else if (!(name.len == 7 && !FIO_MEMCMP(name.buf, ":scheme", 7)))
+      goto malformed;
+    return 0;
+  }
+  ctx->regular = 1;
+  for (size_t i = 0; i < name.len; ++i)
+    if ((unsigned char)(name.buf[i] - 'A') < 26)
+      goto malformed; /* field names must be lower case */
+  if (fio___http2_is_connection_header(name))
+    goto malformed;
+  if (name.len == 2 && name.buf[0] == 't' && name.buf[1] == 'e' &&
+      !(value.len == 8 && !FIO_MEMCMP(value.buf, "trailers", 8)))
+    goto malformed;
+  if (name.len == 14 && !FIO_MEMCMP(name.buf, "content-length", 14)) {
+    size_t len = 0; /* values aren't NUL terminated, avoid fio_atol */
+    if (!value.len || value.len > 15)
+      goto malformed;
+    for (size_t i = 0; i < value.len; ++i) {
+      if ((uint8_t)(value.buf[i] - '0') > 9)
+        goto malformed;
+      len = (len * 10) + (size_t)(value.buf[i] - '0');
+    }
+    if (len > ctx->st->settings->max_body_size) {
+      ctx->status = 413;
+      return -1;
+    }
+    if (len && !ctx->trailer)
+      fio_http_body_expect(h, len);
+    if (!FIO_HTTP_SHOW_CONTENT_LENGTH_HEADER)
+      return 0;
+  }
+  if (name.len == 8 && !FIO_MEMCMP(name.buf, "priority", 8))
+    ctx->st->state.h2.urgency = fio___http2_urgency(value, 3);
+  if (name.len == 4 && !FIO_MEMCMP(name.buf, "host", 4)) {
+    fio_http_request_header_set(h, name, value); /* may follow :authority */
+    return 0;
+  }
+  fio_http_request_header_add(h, name, value);
+  return 0;
+
+malformed:
+  ctx->err = 1;
+  return -1;
+}
+
+/** Serves requests routed to an HTTP/2 stream (no Upgrade mechanism). */
+FIO_SFUNC void fio___http2_on_http(void *h_, void *ignr) {
+  fio_http_s *h = (fio_http_s *)h_;
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  union {
+    void (*fn)(fio_http_s *);
+    void *ptr;
+  } cb = {.fn = c->settings->on_http};
+  fio_http_status_set(h, 200);
+  if (c->settings->public_folder.len &&
+      (fio_http_method(h).len != 4 || (fio_buf2u32u(fio_http_method(h).buf) |
+                                       0x20202020UL) != fio_buf2u32u("post")) &&
+      !fio_http_static_file_response(h,
+                                     c->settings->public_folder,
+                                     fio_http_path(h),
+                                     c->settings->max_age)) {
+    fio_http_free(h);
+    return;
+  }
+  fio_queue_push(c->queue, fio___http_perform_user_callback, cb.ptr, (void *)h);
+  (void)ignr;
+}
+
+/** Routes a complete request to the user's `on_http` callback. */
+FIO_SFUNC void fio___http2_stream_dispatch(fio___http2_s *s,
+                                           fio___http_connection_s *st) {
+  if (!st->h)
+    return;
+  if (fio_http_sse_requested(st->h)) {
+    /* EventSource streams require HTTP/1.1, browsers will retry */
+    fio___http2_stream_reset(s, st, FIO___HTTP2_HTTP_1_1_REQUIRED);
+    return;
+  }
+  fio_queue_push(fio_io_queue(), fio___http2_on_http, (void *)st->h);
+  st->h = NULL;
+}
+
+/** Handles a complete header block (HEADERS + CONTINUATION frames). */
+FIO_SFUNC void fio___http2_on_header_block(fio___http2_s *s,
+                                           uint32_t id,
+                                           fio_buf_info_s block,
+                                           uint8_t end_stream) {
+  fio___http2_headers_s ctx = {0};
+  int r;
+  ctx.st = fio___http2_smap_get(&s->streams, id);
+  if (!ctx.st) {
+    if (!(id & 1)) {
+      fio___http2_error(s, FIO___HTTP2_PROTOCOL_ERROR);
+      return;
+    }
+    if (id <= s->last_id) {
+      /* closed / reset stream: keep the HPACK state in sync (RFC 9113) */
+      if (fio___hpack_decode(&s->dec, block, fio___http2_on_header, &ctx) < 0)
+        goto compression_error;
+      fio___http2_frame32(s,
+                          FIO___HTTP2_FRAME_RST_STREAM,
+                          id,
+                          FIO___HTTP2_STREAM_CLOSED);
+      return;
+    }
+    s->last_id = id;
+    if (s->goaway ||
+        fio___http2_smap_count(&s->streams) >= FIO_HTTP2_MAX_STREAMS) {
+      if (fio___hpack_decode(&s->dec, block, fio___http2_on_header, &ctx) < 0)
+        goto compression_error;
+      fio___http2_frame32(s,
+                          FIO___HTTP2_FRAME_RST_STREAM,
+                          id,
+                          FIO___HTTP2_REFUSED_STREAM);
+      return;
+    }
+    ctx.st = fio___http2_stream_new(s, id);
+  } else {
+    ctx.trailer = 1;
+  }
+  r = fio___hpack_decode(&s->dec, block, fio___http2_on_header, &ctx);
+  if (r < 0)
+    goto compression_error;
+  if (ctx.trailer) {
+    if ((ctx.st->state.h2.flags & FIO___HTTP2_S_REMOTE_CLOSED)) {
+      fio___http2_stream_reset(s, ctx.st, FIO___HTTP2_STREAM_CLOSED);
+      return;
+    }
+    if (!end_stream)
+      ctx.err = 1;
+  } else if (!ctx.err && !ctx.status &&
+             (!fio_http_method(ctx.st->h).len || !fio_http_path(ctx.st->h).len))
+    ctx.err = 1;
+  if (ctx.err) {
+    fio___http2_stream_reset(s, ctx.st, FIO___HTTP2_PROTOCOL_ERROR);
+    return;
+  }
+  if (ctx.status && ctx.st->h)
+    fio___http2_stream_refuse(ctx.st, ctx.status);
+  if (!end_stream)
+    return;
+  ctx.st->state.h2.flags |= FIO___HTTP2_S_REMOTE_CLOSED;
+  fio___http2_stream_dispatch(s, ctx.st);
+  return;
+
+compression_error:
+  fio___http2_error(s, FIO___HTTP2_COMPRESSION_ERROR);
+}
+
+FIO_SFUNC void fio___http2_on_frame_headers(fio___http2_s *s,
+                                            uint32_t id,
+                                            uint8_t flags,
+                                            char *payload,
+                                            size_t len) {
+  size_t pad = 0;
+  if (!id)
+    goto protocol_error;
+  if ((flags & FIO___HTTP2_FLAG_PADDED)) {
+    if (!len)
+      goto protocol_error;
+    pad = (uint8_t)payload[0];
+    ++payload;
+    --len;
+  }
+  if ((flags & FIO___HTTP2_FLAG_PRIORITY)) { /* deprecated (RFC 9113) */
+    if (len < 5)
+      goto protocol_error;
+    payload += 5;
+    len -= 5;
+  }
+  if (pad > len)
+    goto protocol_error;
+  len -= pad;
+  if ((flags & FIO___HTTP2_FLAG_END_HEADERS)) {
+    fio___http2_on_header_block(s,
+                                id,
+                                FIO_BUF_INFO2(payload, len),
+                                (flags & FIO___HTTP2_FLAG_END_STREAM));
+    return;
+  }
+  s->hblock = fio_bstr_write(s->hblock, payload, len);
+  s->hblock_id = id;
+  s->hblock_flags = flags;
+  return;
+protocol_error:
+  fio___http2_error(s, FIO___HTTP2_PROTOCOL_ERROR);
+}
+
+FIO_SFUNC void fio___http2_on_frame_continuation(fio___http2_s *s,
+                                                 uint32_t id,
+                                                 uint8_t flags,
+                                                 char *payload,
+                                                 size_t len) {
+  if (!s->hblock_id || id != s->hblock_id) {
+    fio___http2_error(s, FIO___HTTP2_PROTOCOL_ERROR);
+    return;
+  }
+  s->hblock = fio_bstr_write(s->hblock, payload, len);
+  if (fio_bstr_len(s->hblock) > (s->c->settings->max_header_size << 1)) {
+    fio___http2_error(s, FIO___HTTP2_ENHANCE_YOUR_CALM);
+    return;
+  }
+  if (!(flags & FIO___HTTP2_FLAG_END_HEADERS))
+    return;
+  s->hblock_id = 0;
+  fio___http2_on_header_block(s,
+                              id,
+                              fio_bstr_buf(s->hblock),
+                              (s->hblock_flags & FIO___HTTP2_FLAG_END_STREAM));
+  s->hblock = fio_bstr_len_set(s->hblock, 0);
+}
+
+FIO_SFUNC void fio___http2_on_frame_data(fio___http2_s *s,
+                                         uint32_t id,
+                                         uint8_t flags,
+                                         char *payload,
+                                         size_t len) {
+  fio___http_connection_s *st;
+  const size_t flow = len; /* flow control includes padding */
+  size_t pad = 0;
+  if (!id)
+    goto protocol_error;
+  if ((flags & FIO___HTTP2_FLAG_PADDED)) {
+    if (!len)
+      goto protocol_error;
+    pad = (uint8_t)payload[0];
+    ++payload;
+    --len;
+    if (pad > len)
+      goto protocol_error;
+    len -= pad;
+  }
+  s->recv += (uint32_t)flow;
+  if (s->recv > FIO_HTTP2_WINDOW) {
+    fio___http2_error(s, FIO___HTTP2_FLOW_CONTROL_ERROR);
+    return;
+  }
+  if (s->recv >= (FIO_HTTP2_WINDOW >> 1)) {
+    fio___http2_frame32(s, FIO___HTTP2_FRAME_WINDOW_UPDATE, 0, s->recv);
+    s->recv = 0;
+  }
+  st = fio___http2_smap_get(&s->streams, id);
+  if (!st) {
+    if (id > s->last_id)
+      goto protocol_error;
+    return; /* a recently closed (reset) stream */
+  }
+  if ((st->state.h2.flags & FIO___HTTP2_S_REMOTE_CLOSED)) {
+    fio___http2_stream_reset(s, st, FIO___HTTP2_STREAM_CLOSED);
+    return;
+  }
+  st->state.h2.recv += (uint32_t)flow;
+  if (st->state.h2.recv > FIO_HTTP2_WINDOW) {
+    fio___http2_stream_reset(s, st, FIO___HTTP2_FLOW_CONTROL_ERROR);
+    return;
+  }
+  if (!(flags & FIO___HTTP2_FLAG_END_STREAM) &&
+      st->state.h2.recv >= (FIO_HTTP2_WINDOW >> 1)) {
+    fio___http2_frame32(s,
+                        FIO___HTTP2_FRAME_WINDOW_UPDATE,
+                        id,
+                        st->state.h2.recv);
+    st->state.h2.recv = 0;
+  }
+  if (st->h && len && !(st->state.h2.flags & FIO___HTTP2_S_DISCARD)) {
+    if (len + fio_http_body_length(st->h) > st->settings->max_body_size) {
+      fio___http2_stream_refuse(st, 413);
+    } else {
+      if (!(st->state.h2.flags & FIO___HTTP2_S_PRE_BODY)) {
+        st->state.h2.flags |= FIO___HTTP2_S_PRE_BODY;
+        st->settings->pre_http_body(st->h);
+      }
+      if (fio_http_status(st->h)) { /* responded, the body isn't wanted */
+        fio_http_free(st->h);
+        st->h = NULL;
+        st->state.h2.flags |= FIO___HTTP2_S_DISCARD;
+      } else if (fio_http_body_write(st->h, payload, len)) {
+        fio___http2_stream_refuse(st, 400); /* i.e., a malformed multipart */
+      }
+    }
+  }
+  if (!(flags & FIO___HTTP2_FLAG_END_STREAM))
+    return;
+  st->state.h2.flags |= FIO___HTTP2_S_REMOTE_CLOSED;
+  fio___http2_stream_dispatch(s, st);
+  return;
+protocol_error:
+  fio___http2_error(s, FIO___HTTP2_PROTOCOL_ERROR);
+}
+
+/* *****************************************************************************
+HTTP/2 - Control Frames
+***************************************************************************** */
+
+FIO_SFUNC void fio___http2_on_frame_settings(fio___http2_s *s,
+                                             uint32_t id,
+                                             uint8_t flags,
+                                             char *payload,
+                                             size_t len) {
+  if (id) {
+    fio___http2_error(s, FIO___HTTP2_PROTOCOL_ERROR);
+    return;
+  }
+  if ((flags & FIO___HTTP2_FLAG_ACK)) {
+    if (len)
+      fio___http2_error(s, FIO___HTTP2_FRAME_SIZE_ERROR);
+    return;
+  }
+  if ((len % 6)) {
+    fio___http2_error(s, FIO___HTTP2_FRAME_SIZE_ERROR);
+    return;
+  }
+  for (size_t i = 0; i < len; i += 6) {
+    const uint32_t v = fio_buf2u32_be(payload + i + 2);
+    switch (fio_buf2u16_be(payload + i)) {
+    case 0x1: /* SETTINGS_HEADER_TABLE_SIZE */
+      if ((v > FIO___HTTP2_HPACK_MAX ? FIO___HTTP2_HPACK_MAX : v) ==
+          s->enc.max)
+        break;
+      s->enc.max = (v > FIO___HTTP2_HPACK_MAX ? FIO___HTTP2_HPACK_MAX : v);
+      fio___hpack_table_evict(&s->enc, s->enc.max);
+      s->enc.update = 1;
+      break;
+    case 0x2: /* SETTINGS_ENABLE_PUSH (we never push) */
+      if (v > 1)
+        goto protocol_error;
+      break;
+    case 0x4: /* SETTINGS_INITIAL_WINDOW_SIZE */
+      if (v > 0x7FFFFFFFUL) {
+        fio___http2_error(s, FIO___HTTP2_FLOW_CONTROL_ERROR);
+        return;
+      }
+      FIO_MAP_EACH(fio___http2_smap, &s->streams, pos) {
+        pos.value->state.h2.window += (int64_t)v - (int64_t)s->peer_window;
+        if (pos.value->state.h2.window > 0x7FFFFFFFLL) {
+          fio___http2_error(s, FIO___HTTP2_FLOW_CONTROL_ERROR);
+          return;
+        }
+      }
+      s->peer_window = v;
+      break;
+    case 0x5: /* SETTINGS_MAX_FRAME_SIZE */
+      if (v < 16384 || v > 16777215)
+        goto protocol_error;
+      s->peer_frame = v;
+      break;
+    }
+  }
+  fio___http2_frame(s, FIO___HTTP2_FRAME_SETTINGS, FIO___HTTP2_FLAG_ACK, 0, 0, 0);
+  if (!FIO_LIST_IS_EMPTY(&s->active))
+    fio___http2_schedule(s);
+  return;
+protocol_error:
+  fio___http2_error(s, FIO___HTTP2_PROTOCOL_ERROR);
+}
+
+FIO_SFUNC void fio___http2_on_frame_window_update(fio___http2_s *s,
+                                                  uint32_t id,
+                                                  char *payload,
+                                                  size_t len) {
+  fio___http_connection_s *st;
+  uint32_t inc;
+  if (len != 4) {
+    fio___http2_error(s, FIO___HTTP2_FRAME_SIZE_ERROR);
+    return;
+  }
+  inc = fio_buf2u32_be(payload) & 0x7FFFFFFFUL;
+  if (!id) {
+    if (!inc) {
+      fio___http2_error(s, FIO___HTTP2_PROTOCOL_ERROR);
+      return;
+    }
+    s->window += inc;
+    if (s->window > 0x7FFFFFFFLL)
+      fio___http2_error(s, FIO___HTTP2_FLOW_CONTROL_ERROR);
+    else if (!FIO_LIST_IS_EMPTY(&s->active))
+      fio___http2_schedule(s);
+    return;
+  }
+  st = fio___http2_smap_get(&s->streams, id);
+  if (!st)
+    return;
+  if (!inc) {
+    fio___http2_stream_reset(s, st, FIO___HTTP2_PROTOCOL_ERROR);
+    return;
+  }
+  st->state.h2.window += inc;
+  if (st->state.h2.window > 0x7FFFFFFFLL)
+    fio___http2_stream_reset(s, st, FIO___HTTP2_FLOW_CONTROL_ERROR);
+  else if ((st->state.h2.flags & FIO___HTTP2_S_ACTIVE))
+    fio___http2_schedule(s);
+}
+
+/** Processes all complete frames in the session's read buffer. */
+FIO_SFUNC void fio___http2_process(fio___http2_s *s) {
+  char *pos = s->buf;
+  char *end = s->buf + s->len;
+  while (!s->error && (end - pos) >= 9) {
+    const size_t len = fio_buf2u24_be(pos);
+    const uint8_t type = (uint8_t)pos[3];
+    const uint8_t flags = (uint8_t)pos[4];
+    const uint32_t id = fio_buf2u32_be(pos + 5) & 0x7FFFFFFFUL;
+    char *payload = pos + 9;
+    fio___http_connection_s *st;
+    if (len > FIO___HTTP2_FRAME_MAX) {
+      fio___http2_error(s, FIO___HTTP2_FRAME_SIZE_ERROR);
+      return;
+    }
+    if ((size_t)(end - pos) < len + 9)
+      break;
+    pos += len + 9;
+    if (s->hblock_id && type != FIO___HTTP2_FRAME_CONTINUATION) {
+      fio___http2_error(s, FIO___HTTP2_PROTOCOL_ERROR);
+      return;
+    }
+    switch (type) {
+    case FIO___HTTP2_FRAME_DATA:
+      fio___http2_on_frame_data(s, id, flags, payload, len);
+      break;
+    case FIO___HTTP2_FRAME_HEADERS:
+      fio___http2_on_frame_headers(s, id, flags, payload, len);
+      break;
+    case FIO___HTTP2_FRAME_CONTINUATION:
+      fio___http2_on_frame_continuation(s, id, flags, payload, len);
+      break;
+    case FIO___HTTP2_FRAME_PRIORITY: /* deprecated (RFC 9113), ignored */
+      if (!id)
+        fio___http2_error(s, FIO___HTTP2_PROTOCOL_ERROR);
+      else if (len != 5)
+        fio___http2_frame32(s,
+                            FIO___HTTP2_FRAME_RST_STREAM,
+                            id,
+                            FIO___HTTP2_FRAME_SIZE_ERROR);
+      break;
+    case FIO___HTTP2_FRAME_RST_STREAM:
+      if (!id)
+        fio___http2_error(s, FIO___HTTP2_PROTOCOL_ERROR);
+      else if (len != 4)
+        fio___http2_error(s, FIO___HTTP2_FRAME_SIZE_ERROR);
+      else if ((st = fio___http2_smap_get(&s->streams, id)))
+        fio___http2_stream_remove(s, st);
+      else if (id > s->last_id)
+        fio___http2_error(s, FIO___HTTP2_PROTOCOL_ERROR);
+      break;
+    case FIO___HTTP2_FRAME_SETTINGS:
+      fio___http2_on_frame_settings(s, id, flags, payload, len);
+      break;
+    case FIO___HTTP2_FRAME_PUSH_PROMISE: /* clients can't push */
+      fio___http2_error(s, FIO___HTTP2_PROTOCOL_ERROR);
+      break;
+    case FIO___HTTP2_FRAME_PING:
+      if (id)
+        fio___http2_error(s, FIO___HTTP2_PROTOCOL_ERROR);
+      else if (len != 8)
+        fio___http2_error(s, FIO___HTTP2_FRAME_SIZE_ERROR);
+      else if (!(flags & FIO___HTTP2_FLAG_ACK))
+        fio___http2_frame(s,
+                          FIO___HTTP2_FRAME_PING,
+                          FIO___HTTP2_FLAG_ACK,
+                          0,
+                          payload,
+                          8);
+      break;
+    case FIO___HTTP2_FRAME_GOAWAY:
+      if (id) {
+        fio___http2_error(s, FIO___HTTP2_PROTOCOL_ERROR);
+        break;
+      }
+      s->goaway = 1;
+      if (!fio___http2_smap_count(&s->streams))
+        fio_io_close(s->io);
+      break;
+    case FIO___HTTP2_FRAME_WINDOW_UPDATE:
+      fio___http2_on_frame_window_update(s, id, payload, len);
+      break;
+    case FIO___HTTP2_FRAME_PRIORITY_UPDATE: /* RFC 9218 */
+      if (id)
+        fio___http2_error(s, FIO___HTTP2_PROTOCOL_ERROR);
+      else if (len < 4)
+        fio___http2_error(s, FIO___HTTP2_FRAME_SIZE_ERROR);
+      else if ((st = fio___http2_smap_get(
+                    &s->streams,
+                    fio_buf2u32_be(payload) & 0x7FFFFFFFUL)))
+        st->state.h2.urgency =
+            fio___http2_urgency(FIO_STR_INFO2(payload + 4, len - 4),
+                                st->state.h2.urgency);
+      break;
+    default: break; /* unknown frame types are ignored */
+    }
+  }
+  if (s->error)
+    return;
+  s->len = (uint32_t)(end - pos);
+  if (s->len && pos != s->buf)
+    FIO_MEMMOVE(s->buf, pos, s->len);
+}
+
+/* *****************************************************************************
+HTTP/2 - Responses (HEADERS & DATA frames)
+***************************************************************************** */
+
+/** Chooses the HPACK indexing mode for response header fields. */
+FIO_IFUNC fio___hpack_mode_e fio___http2_index_mode(fio_str_info_s n,
+                                                    fio_str_info_s v) {
+  if (v.len > 256)
+    return FIO___HPACK_NO_INDEX;
+  switch (n.len) {
+  case 4:
+    if (!FIO_MEMCMP(n.buf, "etag", 4))
+      return FIO___HPACK_NO_INDEX;
+    break;
+  case 10:
+    if (!FIO_MEMCMP(n.buf, "set-cookie", 10))
+      return FIO___HPACK_NEVER_INDEX;
+    break;
+  case 13:
+    if (!FIO_MEMCMP(n.buf, "last-modified", 13) ||
+        !FIO_MEMCMP(n.buf, "content-range", 13))
+      return FIO___HPACK_NO_INDEX;
+    break;
+  case 14:
+    if (!FIO_MEMCMP(n.buf, "content-length", 14))
+      return FIO___HPACK_NO_INDEX;
+    break;
+  }
+  return FIO___HPACK_INDEX;
+}
+
+/** Encodes a stream's response headers, writing HEADERS + CONTINUATION. */
+FIO_SFUNC void fio___http2_write_headers(fio___http2_s *s,
+                                         fio___http_connection_s *st) {
+  fio_buf_info_s list = fio_bstr_buf(st->state.h2.hdr);
+  size_t offset = 0;
+  uint8_t type = FIO___HTTP2_FRAME_HEADERS;
+  uint8_t flags = 0;
+  s->eblock = fio_bstr_len_set(s->eblock, 0);
+  if (s->enc.update) {
+    uint8_t tmp[8];
+    s->eblock = fio_bstr_write(s->eblock,
+                               tmp,
+                               fio___hpack_int_write(tmp, s->enc.max, 5, 0x20));
+    s->enc.update = 0;
+  }
+  /* the header list: a sequence of [name len][value len][name][value] */
+  while (offset + 8 <= list.len) {
+    fio_str_info_s n, v;
+    n.len = fio_buf2u32u(list.buf + offset);
+    v.len = fio_buf2u32u(list.buf + offset + 4);
+    n.buf = list.buf + offset + 8;
+    v.buf = n.buf + n.len;
+    offset += 8 + n.len + v.len;
+    s->eblock = fio___hpack_encode(&s->enc,
+                                   s->eblock,
+                                   n,
+                                   v,
+                                   fio___http2_index_mode(n, v));
+  }
+  fio_bstr_free(st->state.h2.hdr);
+  st->state.h2.hdr = NULL;
+  st->state.h2.flags |= FIO___HTTP2_S_HEADERS_SENT;
+  if ((st->state.h2.flags & FIO___HTTP2_S_FINISHED) &&
+      !fio_stream_any(&st->state.h2.out)) {
+    flags = FIO___HTTP2_FLAG_END_STREAM;
+    st->state.h2.flags |= FIO___HTTP2_S_LOCAL_CLOSED;
+  }
+  list = fio_bstr_buf(s->eblock);
+  offset = 0;
+  do {
+    size_t len = list.len - offset;
+    if (len > s->peer_frame)
+      len = s->peer_frame;
+    if (offset + len == list.len)
+      flags |= FIO___HTTP2_FLAG_END_HEADERS;
+    fio___http2_frame(s, type, flags, st->state.h2.id, list.buf + offset, len);
+    offset += len;
+    type = FIO___HTTP2_FRAME_CONTINUATION;
+    flags = 0;
+  } while (offset < list.len);
+}
+
+/** Writes a single DATA frame, returning the number of bytes written. */
+FIO_SFUNC size_t fio___http2_write_data(fio___http2_s *s,
+                                        fio___http_connection_s *st,
+                                        size_t len) {
+  const size_t pos = fio_bstr_len(s->wbuf);
+  const size_t limit = len;
+  uint8_t flags = 0;
+  char *buf;
+  s->wbuf = fio_bstr_reserve(s->wbuf, len + 9);
+  buf = s->wbuf + pos + 9;
+  fio_stream_read(&st->state.h2.out, &buf, &len);
+  if (!buf || !len)
+    return 0;
+  if (len > limit) /* may point to a larger (embedded / external) buffer */
+    len = limit;
+  if (buf != s->wbuf + pos + 9)
+    FIO_MEMCPY(s->wbuf + pos + 9, buf, len);
+  fio_stream_advance(&st->state.h2.out, len);
+  if ((st->state.h2.flags & FIO___HTTP2_S_FINISHED) &&
+      !fio_stream_any(&st->state.h2.out)) {
+    flags = FIO___HTTP2_FLAG_END_STREAM;
+    st->state.h2.flags |= FIO___HTTP2_S_LOCAL_CLOSED;
+  }
+  fio___http2_frame_header(s->wbuf + pos,
+                           len,
+                           FIO___HTTP2_FRAME_DATA,
+                           flags,
+                           st->state.h2.id);
+  s->wbuf = fio_bstr_len_set(s->wbuf, pos + len + 9);
+  return len;
+}
+
+/**
+ * Writes pending HEADERS and DATA frames, as well as any control frames.
+ *
+ * HEADERS are written first, as HPACK requires header blocks to be encoded in
+ * the order they are sent. DATA frames are scheduled by RFC 9218 urgency
+ * (lower values first), round-robin among streams of the same urgency, and
+ * limited by the connection and stream flow control windows.
+ */
+FIO_SFUNC void fio___http2_flush(fio___http2_s *s) {
+  fio___http_connection_s *ary[FIO_HTTP2_MAX_STREAMS];
+  size_t count = 0;
+  size_t budget = FIO___HTTP2_FLUSH_LIMIT;
+  if (fio_io_backlog(s->io) > FIO___HTTP2_BACKLOG_LIMIT)
+    budget = 0; /* `on_ready` will resume */
+  FIO_LIST_EACH(fio___http_connection_s, state.h2.node, &s->active, st) {
+    if (st->state.h2.hdr)
+      fio___http2_write_headers(s, st);
+    if (count < FIO_HTTP2_MAX_STREAMS)
+      ary[count++] = st;
+  }
+  /* stable insertion sort by urgency, preserving round-robin ordering */
+  for (size_t i = 1; i < count; ++i) {
+    fio___http_connection_s *tmp = ary[i];
+    size_t j = i;
+    for (; j && ary[j - 1]->state.h2.urgency > tmp->state.h2.urgency; --j)
+      ary[j] = ary[j - 1];
+    ary[j] = tmp;
+  }
+  for (size_t start = 0, end; start < count; start = end) {
+    uint8_t progress = 1;
+    for (end = start; end < count && ary[end]->state.h2.urgency ==
+                                         ary[start]->state.h2.urgency;
+         ++end)
+      ;
+    while (progress) {
+      progress = 0;
+      for (size_t i = start; i < end; ++i) {
+        fio___http_connection_s *st = ary[i];
+        size_t len;
+        if (!st)
+          continue;
+        len = fio_stream_length(&st->state.h2.out);
+        if ((st->state.h2.flags &
+             (FIO___HTTP2_S_LOCAL_CLOSED | FIO___HTTP2_S_HEADERS_SENT)) !=
+            FIO___HTTP2_S_HEADERS_SENT)
+          continue;
+        if (!len) {
+          if ((st->state.h2.flags & FIO___HTTP2_S_FINISHED)) {
+            fio___http2_frame(s,
+                              FIO___HTTP2_FRAME_DATA,
+                              FIO___HTTP2_FLAG_END_STREAM,
+                              st->state.h2.id,
+                              NULL,
+                              0);
+            st->state.h2.flags |= FIO___HTTP2_S_LOCAL_CLOSED;
+          }
+          continue;
+        }
+        if (len > budget)
+          len = budget;
+        if ((int64_t)len > s->window)
+          len = (s->window > 0) ? (size_t)s->window : 0;
+        if ((int64_t)len > st->state.h2.window)
+          len = (st->state.h2.window > 0) ? (size_t)st->state.h2.window : 0;
+        if (len > s->peer_frame)
+          len = s->peer_frame;
+        if (!len)
+          continue;
+        if (!(len = fio___http2_write_data(s, st, len))) {
+          fio___http2_stream_reset(s, st, FIO___HTTP2_INTERNAL_ERROR);
+          ary[i] = NULL;
+          continue;
+        }
+        s->window -= (int64_t)len;
+        st->state.h2.window -= (int64_t)len;
+        budget -= len;
+        progress = 1;
+      }
+    }
+  }
+  /* cleanup: close finished streams, deactivate idle ones */
+  for (size_t i = 0; i < count; ++i) {
+    fio___http_connection_s *st = ary[i];
+    if (!st)
+      continue;
+    if ((st->state.h2.flags & FIO___HTTP2_S_LOCAL_CLOSED)) {
+      if (!(st->state.h2.flags & FIO___HTTP2_S_REMOTE_CLOSED))
+        fio___http2_frame32(s, /* response complete, request body unneeded */
+                            FIO___HTTP2_FRAME_RST_STREAM,
+                            st->state.h2.id,
+                            FIO___HTTP2_NO_ERROR);
+      fio___http2_stream_remove(s, st);
+      continue;
+    }
+    if (!fio_stream_any(&st->state.h2.out) && !st->state.h2.hdr &&
+        !(st->state.h2.flags & FIO___HTTP2_S_FINISHED)) {
+      st->state.h2.flags &= ~FIO___HTTP2_S_ACTIVE;
+      FIO_LIST_REMOVE_RESET(&st->state.h2.node);
+    }
+  }
+  fio___http2_write(s);
+  if (!budget && s->window > 0 && !FIO_LIST_IS_EMPTY(&s->active) &&
+      fio_io_backlog(s->io) <= FIO___HTTP2_BACKLOG_LIMIT)
+    fio___http2_schedule(s);
+}
+
+/* *****************************************************************************
+HTTP/2 Protocol
+***************************************************************************** */
+
+/** Called when an IO is attached to the HTTP/2 protocol (after the preface). */
+FIO_SFUNC void fio___http2_on_attach(fio_io_s *io) {
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_io_udata(io);
+  const uint32_t capa =
+      (c->len > FIO___HTTP2_FRAME_MAX + 9) ? c->len : FIO___HTTP2_FRAME_MAX + 9;
+  fio___http2_s *s = fio___http2_new(capa);
+  char settings[18];
+  FIO_ASSERT_ALLOC(s);
+  *s = (fio___http2_s){
+      .io = io,
+      .c = c,
+      .dec = {.max = FIO___HTTP2_HPACK_MAX},
+      .enc = {.max = FIO___HTTP2_HPACK_MAX},
+      .window = 65535,
+      .peer_window = 65535,
+      .peer_frame = 16384,
+      .len = c->len,
+      .capa = capa,
+  };
+  s->active = FIO_LIST_INIT(s->active);
+  if (c->len)
+    FIO_MEMCPY(s->buf, c->buf, c->len);
+  c->len = 0;
+  c->state.h2 = (struct fio___http_connection_h2_s){.session = s};
+  FIO_LOG_DDEBUG2("(%d) HTTP/2 connection attached for %p",
+                  fio_io_pid(),
+                  (void *)io);
+  /* server connection preface: SETTINGS + connection window */
+  fio_u2buf16_be(settings, 0x3); /* SETTINGS_MAX_CONCURRENT_STREAMS */
+  fio_u2buf32_be(settings + 2, FIO_HTTP2_MAX_STREAMS);
+  fio_u2buf16_be(settings + 6, 0x4); /* SETTINGS_INITIAL_WINDOW_SIZE */
+  fio_u2buf32_be(settings + 8, FIO_HTTP2_WINDOW);
+  fio_u2buf16_be(settings + 12, 0x6); /* SETTINGS_MAX_HEADER_LIST_SIZE */
+  fio_u2buf32_be(settings + 14, c->settings->max_header_size);
+  fio___http2_frame(s, FIO___HTTP2_FRAME_SETTINGS, 0, 0, settings, 18);
+  if (FIO_HTTP2_WINDOW > 65535)
+    fio___http2_frame32(s,
+                        FIO___HTTP2_FRAME_WINDOW_UPDATE,
+                        0,
+                        FIO_HTTP2_WINDOW - 65535);
+  if (s->len)
+    fio___http2_process(s);
+  fio___http2_write(s);
+}
+
+/** Called when data is available. */
+FIO_SFUNC void fio___http2_on_data(fio_io_s *io) {
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_io_udata(io);
+  fio___http2_s *s = c->state.h2.session;
+  size_t r;
+  while (!s->error &&
+         (r = fio_io_read(io, s->buf + s->len, s->capa - s->len))) {
+    s->len += (uint32_t)r;
+    fio___http2_process(s);
+  }
+  fio___http2_write(s);
+}
+
+/** Called once all pending `fio_io_write` calls are finished. */
+FIO_SFUNC void fio___http2_on_ready(fio_io_s *io) {
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_io_udata(io);
+  fio___http2_s *s = c->state.h2.session;
+  if (!s->error && !FIO_LIST_IS_EMPTY(&s->active))
+    fio___http2_flush(s);
+}
+
+/** Called when the server is shutting down (sends GOAWAY). */
+FIO_SFUNC void fio___http2_on_shutdown(fio_io_s *io) {
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_io_udata(io);
+  fio___http2_s *s = c->state.h2.session;
+  if (s->error)
+    return;
+  fio___http2_goaway(s, FIO___HTTP2_NO_ERROR);
+  fio___http2_write(s);
+}
+
+/** Called after the connection was closed, discarding any open streams. */
+FIO_SFUNC void fio___http2_on_close(void *buf, void *udata) {
+  fio___http_connection_s *c = (fio___http_connection_s *)udata;
+  fio___http2_s *s = c->state.h2.session;
+  if (s) {
+    fio___http_connection_s *ary[FIO_HTTP2_MAX_STREAMS];
+    size_t count = 0;
+    s->io = NULL;
+    FIO_MAP_EACH(fio___http2_smap, &s->streams, pos) {
+      if (count < FIO_HTTP2_MAX_STREAMS)
+        ary[count++] = pos.value;
+    }
+    for (size_t i = 0; i < count; ++i)
+      fio___http2_stream_remove(s, ary[i]);
+    fio___http2_free(s);
+    c->state.h2.session = NULL;
+  }
+  fio___http_on_close(buf, udata);
+}
 
 /* *****************************************************************************
-HTTP/2 Controller (TODO!)
+HTTP/2 Controller (stream state is only updated by the IO thread)
 ***************************************************************************** */
 
-// /** Called when an HTTP handle is freed. */
-// void (*on_destroyed)(fio_http_s *h, void *cdata);
-// /** Informs the controller that request / response headers must be
-// sent.
-// */ void (*send_headers)(fio_http_s *h);
-// /** called by the HTTP handle for each body chunk (or to finish a
-// response.
-// */ void (*write_body)(fio_http_s *h, fio_http_write_args_s args);
-// /** called once a request / response had finished */
-// void (*on_finish)(fio_http_s *h);
+/** Appends a header to the snapshot: [u32 name len][u32 value len]name value */
+FIO_SFUNC int fio___http2_header_snapshot(fio_http_s *h,
+                                          fio_str_info_s name,
+                                          fio_str_info_s value,
+                                          void *udata) {
+  char **dest = (char **)udata;
+  const size_t pos = fio_bstr_len(*dest);
+  char *n;
+  if (!name.len)
+    return 0;
+  *dest = fio_bstr_reserve(*dest, name.len + value.len + 8);
+  n = *dest + pos + 8;
+  for (size_t i = 0; i < name.len; ++i) /* HTTP/2 requires lower case */
+    n[i] = (char)((uint8_t)name.buf[i] |
+                  ((uint8_t)((uint8_t)(name.buf[i] - 'A') < 26) << 5));
+  if (fio___http2_is_connection_header(FIO_STR_INFO2(n, name.len)))
+    return 0;
+  fio_u2buf32u(*dest + pos, (uint32_t)name.len);
+  fio_u2buf32u(*dest + pos + 4, (uint32_t)value.len);
+  if (value.len)
+    FIO_MEMCPY(n + name.len, value.buf, value.len);
+  *dest = fio_bstr_len_set(*dest, pos + name.len + value.len + 8);
+  (void)h;
+  return 0;
+}
+
+FIO_SFUNC void fio___http2_send_headers_task(void *c_, void *hdr_) {
+  fio___http_connection_s *c = (fio___http_connection_s *)c_;
+  fio___http2_s *s = c->state.h2.session;
+  if (!s || !s->io || c->state.h2.hdr ||
+      (c->state.h2.flags &
+       (FIO___HTTP2_S_LOCAL_CLOSED | FIO___HTTP2_S_HEADERS_SENT))) {
+    fio_bstr_free((char *)hdr_);
+    goto done;
+  }
+  c->state.h2.hdr = (char *)hdr_;
+  fio___http2_stream_activate(s, c);
+done:
+  fio___http_connection_free(c);
+}
+
+/** Informs the controller that response headers must be sent. */
+FIO_SFUNC void fio___http2_send_headers(fio_http_s *h) {
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  size_t status = fio_http_status(h);
+  char *hdr = NULL;
+  char buf[3];
+  if (status < 100 || status > 999)
+    status = 500;
+  buf[0] = (char)('0' + (status / 100));
+  buf[1] = (char)('0' + ((status / 10) % 10));
+  buf[2] = (char)('0' + (status % 10));
+  /* headers are snapshot here, `h` may be freed before the IO thread runs */
+  fio___http2_header_snapshot(h,
+                              FIO_STR_INFO2((char *)":status", 7),
+                              FIO_STR_INFO2(buf, 3),
+                              &hdr);
+  fio_http_response_header_each(h, fio___http2_header_snapshot, &hdr);
+  fio_http_set_cookie_each(h, fio___http2_header_snapshot, &hdr);
+  fio_io_defer(fio___http2_send_headers_task,
+               (void *)fio___http_connection_dup(c),
+               (void *)hdr);
+}
+
+FIO_SFUNC void fio___http2_write_body_task(void *c_, void *packet_) {
+  fio___http_connection_s *c = (fio___http_connection_s *)c_;
+  fio___http2_s *s = c->state.h2.session;
+  fio_stream_packet_s *packet = (fio_stream_packet_s *)packet_;
+  if (!s || !s->io ||
+      (c->state.h2.flags &
+       (FIO___HTTP2_S_LOCAL_CLOSED | FIO___HTTP2_S_FINISHED))) {
+    fio_stream_pack_free(packet);
+    goto done;
+  }
+  fio_stream_add(&c->state.h2.out, packet);
+  fio___http2_stream_activate(s, c);
+done:
+  fio___http_connection_free(c);
+}
+
+/** Called by the HTTP handle for each body chunk (DATA frames). */
+FIO_SFUNC void fio___http2_write_body(fio_http_s *h,
+                                      fio_http_write_args_s args) {
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  fio_stream_packet_s *packet = NULL;
+  if (args.buf)
+    packet = fio_stream_pack_data((void *)args.buf,
+                                  args.len,
+                                  args.offset,
+                                  (uint8_t)args.copy,
+                                  args.dealloc);
+  else if ((uint32_t)(args.fd + 1) > 1U)
+    packet =
+        fio_stream_pack_fd(args.fd, args.len, args.offset, (uint8_t)args.copy);
+  if (!packet)
+    return;
+  fio_io_defer(fio___http2_write_body_task,
+               (void *)fio___http_connection_dup(c),
+               (void *)packet);
+}
+
+FIO_SFUNC void fio___http2_on_finish_task(void *c_, void *ignr_) {
+  fio___http_connection_s *c = (fio___http_connection_s *)c_;
+  fio___http2_s *s = c->state.h2.session;
+  if (s && s->io && !(c->state.h2.flags & FIO___HTTP2_S_LOCAL_CLOSED)) {
+    c->state.h2.flags |= FIO___HTTP2_S_FINISHED;
+    fio___http2_stream_activate(s, c);
+  }
+  fio___http_connection_free(c);
+  (void)ignr_;
+}
+
+/** Called once a response had finished (END_STREAM). */
+FIO_SFUNC void fio___http2_on_finish(fio_http_s *h) {
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  if (c->log)
+    fio_http_write_log(h);
+  /* once the function returns, `h` may be freed (auto-finish on free). */
+  c->settings->on_finish(h);
+  fio_io_defer(fio___http2_on_finish_task,
+               (void *)fio___http_connection_dup(c),
+               NULL);
+}
+
+FIO_SFUNC void fio___http2_on_destroyed_task(void *c_, void *ignr_) {
+  fio___http_connection_free((fio___http_connection_s *)c_);
+  (void)ignr_;
+}
+
+/** Called when an HTTP handle is freed (auto-finishes the response). */
+FIO_SFUNC void fio___http2_on_destroyed(fio_http_s *h) {
+  if (!(fio_http_is_upgraded(h) | fio_http_is_finished(h))) {
+    if (!fio_http_status(h))
+      fio_http_status_set(h, 500); /* ignored if headers already sent */
+    fio_http_write_args_s args = {.finish = 1};
+    fio_http_write FIO_NOOP(h, args);
+  }
+  fio_queue_push(fio_io_queue(),
+                 fio___http2_on_destroyed_task,
+                 fio_http_cdata(h));
+}
+
+FIO_SFUNC void fio___http2_close_io_task(void *c_, void *ignr_) {
+  fio___http_connection_s *c = (fio___http_connection_s *)c_;
+  fio___http2_s *s = c->state.h2.session;
+  if (s && s->io && !(c->state.h2.flags & FIO___HTTP2_S_FINISHED)) {
+    fio___http2_stream_reset(s, c, FIO___HTTP2_CANCEL);
+    fio___http2_schedule(s);
+  }
+  fio___http_connection_free(c);
+  (void)ignr_;
+}
+
+/** Closes (cancels) the stream, the connection remains open. */
+FIO_SFUNC void fio___http2_close_io(fio_http_s *h) {
+  fio_io_defer(fio___http2_close_io_task,
+               (void *)fio___http_connection_dup(
+                   (fio___http_connection_s *)fio_http_cdata(h)),
+               NULL);
+}
 
 /* *****************************************************************************
 Authentication Helper
@@ -47786,9 +60452,19 @@ FIO_SFUNC fio_buf_info_s fio_websocket_write_partial(void *udata,
 FIO_SFUNC fio_buf_info_s fio_websocket_decompress(void *udata,
                                                   fio_buf_info_s msg) {
   fio___http_connection_s *c = (fio___http_connection_s *)udata;
-  FIO_LOG_ERROR("WebSocket permessage-deflate not yet implemented!");
-  (void)c;
-  return msg;
+#if HAVE_ZLIB
+  char *r;
+  if (c->state.ws.deflate.rx_bits && (r = fio___http_ws_deflate_read(c, msg))) {
+    fio_bstr_free(c->state.ws.msg);
+    c->state.ws.msg = r;
+    return fio_bstr_buf(r);
+  }
+#endif
+  FIO_LOG_DDEBUG2("(%d) WebSocket message decompression failed for %p",
+                  fio_io_pid(),
+                  c->io);
+  (void)c, (void)msg;
+  return (fio_buf_info_s){0};
 }
 
 /** Called when a `ping` message was received. */
@@ -47932,6 +60608,7 @@ FIO_SFUNC void fio___websocket_on_attach(fio_io_s *io) {
       .on_ready = c->settings->on_ready,
       .parser = {.must_mask = !c->is_client},
   };
+  fio___http_ws_deflate_setup(c);
   c->settings->on_open(h);
   fio___websocket_process_data(io, c);
 }
@@ -47944,6 +60621,7 @@ FIO_SFUNC void fio___websocket_on_close(void *buf, void *udata) {
   fio___http_connection_s *c = (fio___http_connection_s *)udata;
   c->io = NULL;
   fio_bstr_free(c->state.ws.msg);
+  fio___http_ws_deflate_destroy(&c->state.ws.deflate);
   if (c->h) {
     fio_http_status_set(c->h, (size_t)(c->state.ws.code));
     c->settings->on_close(c->h);
@@ -47975,48 +60653,11 @@ SFUNC int fio_http_on_message_set(fio_http_s *h,
 }
 
 /* *****************************************************************************
-WebSocket Writing / Subscription Helpers
+Pub/Sub Shared Frames (encoded once per message, written by every subscriber)
 ***************************************************************************** */
 
-FIO_IFUNC void fio___http_websocket_subscribe_imp(fio_msg_s *msg,
-                                                  uint8_t is_text) {
-  fio___http_connection_s *c = (fio___http_connection_s *)fio_io_udata(msg->io);
-  if (!c)
-    return;
-  fio_http_websocket_write(c->h, msg->message.buf, msg->message.len, is_text);
-}
-
-/** Optional WebSocket subscription callback - all messages are UTF-8 valid. */
-SFUNC void FIO_HTTP_WEBSOCKET_SUBSCRIBE_DIRECT_TEXT(fio_msg_s *msg) {
-  fio___http_websocket_subscribe_imp(msg, 1);
-}
-/** Optional WebSocket subscription callback - messages may be non-UTF-8. */
-SFUNC void FIO_HTTP_WEBSOCKET_SUBSCRIBE_DIRECT_BINARY(fio_msg_s *msg) {
-  fio___http_websocket_subscribe_imp(msg, 0);
-}
-
-/** Optional WebSocket subscription callback. */
-SFUNC void FIO_HTTP_WEBSOCKET_SUBSCRIBE_DIRECT(fio_msg_s *msg) {
-  ((msg->message.len < FIO_HTTP_WEBSOCKET_WRITE_VALIDITY_TEST_LIMIT) &&
-           (fio_string_utf8_valid(
-               FIO_STR_INFO2((char *)msg->message.buf, msg->message.len)))
-       ? FIO_HTTP_WEBSOCKET_SUBSCRIBE_DIRECT_TEXT
-       : FIO_HTTP_WEBSOCKET_SUBSCRIBE_DIRECT_BINARY)(msg);
-}
-
-/* *****************************************************************************
-EventSource (SSE) Helpers - HTTP Upgraded Connections
-***************************************************************************** */
-
-void fio_http_sse_write___(void); /* IDE Marker */
-/** Writes an SSE message (UTF-8). Fails if connection wasn't upgraded yet. */
-SFUNC int fio_http_sse_write FIO_NOOP(fio_http_s *h,
-                                      fio_http_sse_write_args_s args) {
-  if (!args.data.len || !h || !fio_http_is_sse(h))
-    return -1;
-  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
-  if (!c || !c->io)
-    return -1;
+/** Formats an SSE event as a `fio_bstr` (without writing it anywhere). */
+FIO_SFUNC char *fio___http_sse_payload(fio_http_sse_write_args_s args) {
   char *payload =
       fio_bstr_reserve(NULL, args.id.len + args.event.len + args.data.len + 22);
   if (args.id.len)
@@ -48054,6 +60695,185 @@ SFUNC int fio_http_sse_write FIO_NOOP(fio_http_s *h,
                         FIO_STRING_WRITE_STR2("\r\n", 2));
   /* event ends on empty line */
   payload = fio_bstr_write(payload, "\r\n", 2);
+  return payload;
+}
+
+typedef enum {
+  FIO___HTTP_MSG_FRAME_WS_TEXT = 0,
+  FIO___HTTP_MSG_FRAME_WS_BINARY,
+  FIO___HTTP_MSG_FRAME_WS_TEXT_DEFLATE, /* (no context takeover) */
+  FIO___HTTP_MSG_FRAME_WS_BINARY_DEFLATE,
+  FIO___HTTP_MSG_FRAME_SSE,
+  FIO___HTTP_MSG_FRAME_COUNT,
+} fio___http_msg_frame_e;
+
+/**
+ * Message metadata: server side frames, built lazily (on first use) and shared
+ * (using the `fio_bstr` reference count) by all the subscribed connections.
+ *
+ * Client connections mask their frames and can't share them. Compressed frames
+ * are shared only by connections that reset the compression context for every
+ * message and allow (at least) the window size used to compress them.
+ */
+typedef struct {
+  char *frame[FIO___HTTP_MSG_FRAME_COUNT];
+  FIO___LOCK_TYPE lock;
+  uint8_t utf8; /* 0 == untested; 1 == valid UTF-8; 2 == binary (or long) */
+  uint8_t deflate_bits[2]; /* window bits used for the compressed frames */
+} fio___http_msg_metadata_s;
+
+FIO_LEAK_COUNTER_DEF(fio___http_msg_metadata_s)
+
+FIO_SFUNC void *fio___http_msg_metadata_build(fio_msg_s *msg) {
+  (void)msg; /* frames are built lazily, only if a connection requires them */
+  fio___http_msg_metadata_s *m =
+      (fio___http_msg_metadata_s *)FIO_MEM_REALLOC_(NULL, 0, sizeof(*m), 0);
+  if (!m)
+    return m;
+  FIO_LEAK_COUNTER_ON_ALLOC(fio___http_msg_metadata_s);
+  *m = (fio___http_msg_metadata_s){.lock = FIO___LOCK_INIT};
+  return (void *)m;
+}
+
+FIO_SFUNC void fio___http_msg_metadata_free(void *m_) {
+  fio___http_msg_metadata_s *m = (fio___http_msg_metadata_s *)m_;
+  if (!m)
+    return;
+  for (size_t i = 0; i < FIO___HTTP_MSG_FRAME_COUNT; ++i)
+    fio_bstr_free(m->frame[i]);
+  FIO___LOCK_DESTROY(m->lock);
+  FIO_LEAK_COUNTER_ON_FREE(fio___http_msg_metadata_s);
+  FIO_MEM_FREE_(m, sizeof(*m));
+}
+
+/* Tests (once per message) if the message should be sent as a text frame. */
+FIO_SFUNC uint8_t fio___http_msg_is_utf8(fio_msg_s *msg) {
+  fio___http_msg_metadata_s *m = (fio___http_msg_metadata_s *)
+      fio_message_metadata(msg, fio___http_msg_metadata_build);
+  uint8_t r = (m ? m->utf8 : 0);
+  if (r)
+    return (r == 1);
+  r = (msg->message.len < FIO_HTTP_WEBSOCKET_WRITE_VALIDITY_TEST_LIMIT) &&
+      fio_string_utf8_valid(
+          FIO_STR_INFO2((char *)msg->message.buf, msg->message.len));
+  if (m)
+    m->utf8 = 2 - r; /* idempotent, a race would write the same value */
+  return r;
+}
+
+/* Returns a shared (copy on write) frame for the message, or NULL. */
+FIO_SFUNC char *fio___http_msg_frame(fio_msg_s *msg,
+                                     fio___http_msg_frame_e t,
+                                     uint8_t deflate_bits) {
+  char *r = NULL;
+  fio___http_msg_metadata_s *m = (fio___http_msg_metadata_s *)
+      fio_message_metadata(msg, fio___http_msg_metadata_build);
+  if (!m)
+    return NULL;
+  FIO___LOCK_LOCK(m->lock);
+  if (!m->frame[t]) {
+    if (t == FIO___HTTP_MSG_FRAME_SSE) {
+      FIO_STR_INFO_TMP_VAR(id_str, 64);
+      fio_string_write_hex(&id_str, NULL, msg->id);
+      m->frame[t] = fio___http_sse_payload(
+          (fio_http_sse_write_args_s){.id = FIO_STR2BUF_INFO(id_str),
+                                      .event = FIO_STR2BUF_INFO(msg->channel),
+                                      .data = FIO_STR2BUF_INFO(msg->message)});
+#if HAVE_ZLIB
+    } else if ((t & FIO___HTTP_MSG_FRAME_WS_TEXT_DEFLATE)) {
+      fio___http_zstream_s *z = fio___http_zstream_new(0, deflate_bits);
+      if (z)
+        m->frame[t] = fio___http_ws_deflate_frame(&z->z,
+                                                  msg->message.buf,
+                                                  msg->message.len,
+                                                  (unsigned char)(1 + (t & 1)),
+                                                  0);
+      fio___http_zstream_free(z);
+      m->deflate_bits[t & 1] = deflate_bits;
+#endif
+    } else {
+      /* opcode: 1 == text, 2 == binary */
+      const unsigned char opcode = 1 + (t == FIO___HTTP_MSG_FRAME_WS_BINARY);
+      char *f =
+          fio_bstr_reserve(NULL, fio_websocket_wrapped_len(msg->message.len));
+      m->frame[t] = fio_bstr_len_set(f,
+                                     fio_websocket_server_wrap(f,
+                                                               msg->message.buf,
+                                                               msg->message.len,
+                                                               opcode,
+                                                               1,
+                                                               1,
+                                                               0));
+    }
+  }
+  if (!(t & FIO___HTTP_MSG_FRAME_WS_TEXT_DEFLATE) ||
+      m->deflate_bits[t & 1] <= deflate_bits) /* a smaller window is valid */
+    r = fio_bstr_copy(m->frame[t]);
+  FIO___LOCK_UNLOCK(m->lock);
+  return r;
+}
+
+/* *****************************************************************************
+WebSocket Writing / Subscription Helpers
+***************************************************************************** */
+
+FIO_IFUNC void fio___http_websocket_subscribe_imp(fio_msg_s *msg,
+                                                  uint8_t is_text) {
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_io_udata(msg->io);
+  fio___http_msg_frame_e t =
+      (is_text ? FIO___HTTP_MSG_FRAME_WS_TEXT : FIO___HTTP_MSG_FRAME_WS_BINARY);
+  uint8_t bits = 0;
+  char *frame;
+  if (!c || !c->h || !fio_http_is_websocket(c->h))
+    return;
+  uint8_t shared = !c->is_client;
+#if HAVE_ZLIB
+  if (c->state.ws.deflate.tx_bits &&
+      msg->message.len >= c->state.ws.deflate.min) {
+    /* with context takeover, every connection compresses its own messages */
+    shared &= c->state.ws.deflate.tx_reset;
+    bits = c->state.ws.deflate.tx_bits;
+    t = (fio___http_msg_frame_e)(t | FIO___HTTP_MSG_FRAME_WS_TEXT_DEFLATE);
+  }
+#endif
+  if (shared && (frame = fio___http_msg_frame(msg, t, bits))) {
+    fio_io_write2(c->io,
+                  .buf = frame,
+                  .len = fio_bstr_len(frame),
+                  .dealloc = (void (*)(void *))fio_bstr_free);
+    return;
+  }
+  fio_http_websocket_write(c->h, msg->message.buf, msg->message.len, is_text);
+}
+
+/** Optional WebSocket subscription callback - all messages are UTF-8 valid. */
+SFUNC void FIO_HTTP_WEBSOCKET_SUBSCRIBE_DIRECT_TEXT(fio_msg_s *msg) {
+  fio___http_websocket_subscribe_imp(msg, 1);
+}
+/** Optional WebSocket subscription callback - messages may be non-UTF-8. */
+SFUNC void FIO_HTTP_WEBSOCKET_SUBSCRIBE_DIRECT_BINARY(fio_msg_s *msg) {
+  fio___http_websocket_subscribe_imp(msg, 0);
+}
+
+/** Optional WebSocket subscription callback. */
+SFUNC void FIO_HTTP_WEBSOCKET_SUBSCRIBE_DIRECT(fio_msg_s *msg) {
+  fio___http_websocket_subscribe_imp(msg, fio___http_msg_is_utf8(msg));
+}
+
+/* *****************************************************************************
+EventSource (SSE) Helpers - HTTP Upgraded Connections
+***************************************************************************** */
+
+void fio_http_sse_write___(void); /* IDE Marker */
+/** Writes an SSE message (UTF-8). Fails if connection wasn't upgraded yet. */
+SFUNC int fio_http_sse_write FIO_NOOP(fio_http_s *h,
+                                      fio_http_sse_write_args_s args) {
+  if (!args.data.len || !h || !fio_http_is_sse(h))
+    return -1;
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  if (!c || !c->io)
+    return -1;
+  char *payload = fio___http_sse_payload(args);
   fio_io_write2(c->io,
                 .buf = payload,
                 .len = fio_bstr_len(payload),
@@ -48064,8 +60884,16 @@ SFUNC int fio_http_sse_write FIO_NOOP(fio_http_s *h,
 /** Optional EventSource subscription callback - messages MUST be UTF-8. */
 SFUNC void FIO_HTTP_SSE_SUBSCRIBE_DIRECT(fio_msg_s *msg) {
   fio___http_connection_s *c = (fio___http_connection_s *)fio_io_udata(msg->io);
-  if (!c)
+  char *frame;
+  if (!c || !c->io || !c->h || !fio_http_is_sse(c->h) || !msg->message.len)
+    return;
+  if ((frame = fio___http_msg_frame(msg, FIO___HTTP_MSG_FRAME_SSE, 0))) {
+    fio_io_write2(c->io,
+                  .buf = frame,
+                  .len = fio_bstr_len(frame),
+                  .dealloc = (void (*)(void *))fio_bstr_free);
     return;
+  }
   FIO_STR_INFO_TMP_VAR(id_str, 64);
   fio_string_write_hex(&id_str, NULL, msg->id);
   fio_http_sse_write(c->h,
@@ -48089,6 +60917,11 @@ SFUNC int fio_http_websocket_write(fio_http_s *h,
     return -1;
   is_text = (!!is_text);
   is_text |= (!is_text) << 1;
+#if HAVE_ZLIB
+  if (c->state.ws.deflate.tx_bits && len >= c->state.ws.deflate.min &&
+      !fio___http_ws_deflate_write(c, buf, len, is_text))
+    return 0 - !fio_io_is_open(c->io);
+#endif
   uint8_t rsv = 0;
   if (len < 512) { /* fast-path: no allocation, no compression */
     char tmp[520];
@@ -48099,9 +60932,6 @@ SFUNC int fio_http_websocket_write(fio_http_s *h,
     fio_io_write2(c->io, .buf = tmp, .len = wlen, .copy = 1);
     return 0;
   }
-#if HAVE_ZLIB /* TODO: compress? */
-  // if(c->state.ws.deflate) ;
-#endif
   char *payload =
       fio_bstr_reserve(NULL,
                        fio_websocket_wrapped_len(len) + (c->is_client << 2));
@@ -48357,6 +61187,10 @@ FIO_SFUNC void fio__http_controller_on_destroyed(fio_http_s *h) {
     fio_http_write FIO_NOOP(h, args);
   }
   fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  if (c->state.http.cache)
+    fio___http_cache_abandon(c, 0);
+  if (c->state.http.zip_type)
+    fio___http_zip_finish(c);
   if (c->state.http.buf.buf)
     FIO_STRING_FREE2(c->state.http.buf);
   c->state.http.buf = FIO_STR_INFO0;
@@ -48374,14 +61208,16 @@ FIO_SFUNC void fio__http_controller_on_destroyed2(fio_http_s *h) {
 
 /** Called when an HTTP handle is freed. */
 FIO_SFUNC void fio__http_controller_on_destroyed_client(fio_http_s *h) {
-  fio_queue_push(fio_io_queue(),
-                 fio___http_controller_on_destroyed_task,
-                 fio_http_cdata(h));
   fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
   c->state.http.on_finish(h);
   c->h = NULL;
-  if (c->io)
-    fio_io_close(c->io);
+  if (c->io) {
+    if (fio___http_pool_is_reusable(c, h))
+      fio___http_pool_release(c);
+    else
+      fio_io_close(c->io);
+  }
+  /* the IO object holds its own reference to the connection */
   fio_queue_push(fio_io_queue(), fio___http_controller_on_destroyed_task, c);
 }
 
@@ -48412,7 +61248,13 @@ fio___http_protocol_get(fio___http_protocol_selector_e s, int is_client) {
     }
     return r;
   case FIO___HTTP_PROTOCOL_HTTP2:
-    r = (fio_io_protocol_s){.on_close = fio___http_on_close};
+    r = (fio_io_protocol_s){
+        .on_attach = fio___http2_on_attach,
+        .on_data = fio___http2_on_data,
+        .on_ready = fio___http2_on_ready,
+        .on_close = fio___http2_on_close,
+        .on_shutdown = fio___http2_on_shutdown,
+    };
     return r;
   case FIO___HTTP_PROTOCOL_WS:
     r = (fio_io_protocol_s){
@@ -48483,8 +61325,11 @@ fio___http_controller_get(fio___http_protocol_selector_e s, int is_client) {
     return r;
   case FIO___HTTP_PROTOCOL_HTTP2:
     r = (fio_http_controller_s){
-        .on_destroyed = fio__http_controller_on_destroyed,
-        .close_io = fio___http_default_close,
+        .on_destroyed = fio___http2_on_destroyed,
+        .send_headers = fio___http2_send_headers,
+        .write_body = fio___http2_write_body,
+        .on_finish = fio___http2_on_finish,
+        .close_io = fio___http2_close_io,
         .get_fd = fio___http_controller_get_fd,
     };
     return r;
@@ -48539,6 +61384,8 @@ FIO_IFUNC fio___http_protocol_s *fio___http_protocol_init(
       (unsigned)s.timeout * 1000U;
   p->state[FIO___HTTP_PROTOCOL_HTTP1].protocol.timeout =
       (unsigned)s.timeout * 1000U;
+  p->state[FIO___HTTP_PROTOCOL_HTTP2].protocol.timeout =
+      (unsigned)s.timeout * 1000U;
   p->state[FIO___HTTP_PROTOCOL_NONE].protocol.timeout =
       (unsigned)s.timeout * 1000U;
   if (url) {
@@ -48546,9 +61393,10 @@ FIO_IFUNC fio___http_protocol_s *fio___http_protocol_init(
     s.tls = fio_io_tls_from_url(s.tls, u);
     if (s.tls) {
       s.tls = fio_io_tls_dup(s.tls);
-      /* fio_io_tls_alpn_add(s.tls, "h2", fio___http_on_select_h2); // not yet
-       */
-      // fio_io_tls_alpn_add(s.tls, "http/1.1", fio___http_on_select_h1);
+      if (!is_client) {
+        fio_io_tls_alpn_add(s.tls, "h2", fio___http_on_select_h2);
+        fio_io_tls_alpn_add(s.tls, "http/1.1", fio___http_on_select_h1);
+      }
       fio_io_functions_s tmp_fn = fio_io_tls_default_functions(NULL);
       if (!s.tls_io_func)
         s.tls_io_func = &tmp_fn;
@@ -48565,6 +61413,13 @@ FIO_IFUNC fio___http_protocol_s *fio___http_protocol_init(
                             : fio___http_on_http_direct;
   p->settings.public_folder.buf = p->public_folder_buf;
   p->queue = fio_io_queue();
+  p->cache = (!is_client && s.cache_ttl) ? fio___http_cache_new(&p->settings)
+                                         : NULL;
+  p->shared_frames = !fio_message_metadata_add(fio___http_msg_metadata_build,
+                                               fio___http_msg_metadata_free);
+  if (!p->shared_frames)
+    FIO_LOG_DEBUG2("(HTTP) pub/sub metadata store full, "
+                   "WebSocket / SSE broadcasts will not share frames");
 
   if (s.public_folder.len)
     FIO_MEMCPY(p->public_folder_buf, s.public_folder.buf, s.public_folder.len);
@@ -48944,6 +61799,13 @@ static int ary____test_was_destroyed = 0;
 #define FIO_MAP_VALUE   size_t
 #define FIO_MAP_TEST
 #include FIO_INCLUDE_FILE
+#define FIO_UMAP_NAME       umap___test_size_inc
+#define FIO_MEMORY_NAME     umap___test_size_inc_mem
+#define FIO_MAP_KEY         size_t
+#define FIO_MAP_VALUE       size_t
+#define FIO_MAP_INCREMENTAL 1
+#define FIO_MAP_TEST
+#include FIO_INCLUDE_FILE
 #define FIO_OMAP_NAME   omap___test_size_t
 #define FIO_MEMORY_NAME omap___test_size_t_mem
 #define FIO_MAP_KEY     size_t
@@ -49074,6 +61936,7 @@ FIO_SFUNC void FIO_NAME_TEST(stl, aton_speed)(void) {
     double (*fn)(char **);
   } to_test[] = {
       {.n = "fio_aton", .fn = fio___aton_float_wrapper},
+      {.n = "fio_atof", .fn = fio_atof},
       {.n = "strtod  ", .fn = fio___strtod_wrapper},
   };
   const char *floats[] = {
@@ -49561,6 +62424,159 @@ FIO_SFUNC void FIO_NAME_TEST(stl, atol)(void) {
   TEST_LTOA_DIGITS_BIN(0xFF00000000000000ULL, 64);
 #undef TEST_LTOA_DIGITS_BIN
 
+  fprintf(stderr, "* Testing fio_ftoa (shortest round-trip).\n");
+  {
+    struct {
+      double d;
+      const char *s;
+    } ftoa_examples[] = {
+        {0.0, "0.0"},
+        {-0.0, "-0.0"},
+        {1.0, "1.0"},
+        {-2.5, "-2.5"},
+        {0.1, "0.1"},
+        {0.3, "0.3"},
+        {1.0 / 3, "0.3333333333333333"},
+        {100.0, "100.0"},
+        {123456789.0, "123456789.0"},
+        {9007199254740993.0, "9007199254740992.0"},
+        {1e16, "10000000000000000.0"},
+        {1e17, "1e+17"},
+        {1e22, "1e+22"},
+        {1e23, "1e+23"},
+        {0.0001, "0.0001"},
+        {1.5e-5, "1.5e-5"},
+        {5e-324, "5e-324"},
+        {2.2250738585072014e-308, "2.2250738585072014e-308"},
+        {1.7976931348623157e308, "1.7976931348623157e+308"},
+    };
+    char buf[128];
+    for (size_t i = 0; i < sizeof(ftoa_examples) / sizeof(ftoa_examples[0]);
+         ++i) {
+      size_t len = fio_ftoa(buf, ftoa_examples[i].d, 10);
+      FIO_ASSERT(len == strlen(ftoa_examples[i].s) &&
+                     !memcmp(buf, ftoa_examples[i].s, len + 1),
+                 "fio_ftoa(%.17g) error: %s != %s",
+                 ftoa_examples[i].d,
+                 buf,
+                 ftoa_examples[i].s);
+    }
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    for (size_t i = 0; i < (FIO_ATOL_TEST_MAX >> 2); ++i) {
+      union {
+        uint64_t u;
+        double d;
+      } u1, u2;
+      seed = (seed * 6364136223846793005ULL) + 1442695040888963407ULL;
+      u1.u = seed ^ (seed >> 29);
+      if ((i & 1))
+        u1.d = (double)(u1.u >> 40) / 1000.0; /* short decimals */
+      if ((u1.u & FIO_MATH_DBL_EXPO_MASK) == FIO_MATH_DBL_EXPO_MASK)
+        continue; /* NaN / Infinity */
+      size_t len = fio_ftoa(buf, u1.d, 10);
+      char *end = buf;
+      u2.d = strtod(buf, &end);
+      FIO_ASSERT(u1.u == u2.u && end == buf + len,
+                 "fio_ftoa round-trip error: %.17g => %s",
+                 u1.d,
+                 buf);
+    }
+  }
+
+  fprintf(stderr, "* Testing fio_atof (correctly rounded base 10).\n");
+  {
+    const char *examples[] = {
+        "0.1",
+        "1e23",
+        "9007199254740993",
+        "9007199254740992.5",
+        "18446744073709551616",
+        "123456789012345678901234567890",
+        "0.000000000000000000000000000001",
+        "1.7976931348623157e308",
+        "1.7976931348623159e308",
+        "2.2250738585072011e-308",
+        "2.2250738585072012e-308",
+        "2.4703282292062327e-324",
+        "2.4703282292062328e-324",
+        "1.00000000000000011102230246251565404236316680908203124",
+        "1.00000000000000011102230246251565404236316680908203125",
+        "1.00000000000000011102230246251565404236316680908203126",
+        "5708990770823839207320493820740630171355185152001e-3",
+        "1e-400",
+        "1e400",
+        "3.e2",
+        ".5e1",
+    };
+    union {
+      uint64_t u;
+      double d;
+    } u1, u2;
+    char buf[1200];
+    for (size_t i = 0; i < sizeof(examples) / sizeof(examples[0]); ++i) {
+      char *p1 = (char *)examples[i], *p2 = (char *)examples[i];
+      u1.d = fio_atof(&p1);
+      u2.d = strtod(p2, &p2);
+      FIO_ASSERT(u1.u == u2.u && p1 == p2,
+                 "fio_atof(%s) error: %.17g != %.17g",
+                 examples[i],
+                 u1.d,
+                 u2.d);
+    }
+    /* the exact halfway point between zero and the smallest subnormal */
+    {
+      uint8_t digits[760] = {1};
+      size_t len = 1, pos = 0;
+      for (size_t i = 0; i < 1075; ++i) { /* 5^1075 */
+        unsigned carry = 0;
+        for (size_t j = 0; j < len; ++j) {
+          carry += digits[j] * 5U;
+          digits[j] = (uint8_t)(carry % 10);
+          carry /= 10;
+        }
+        if (carry)
+          digits[len++] = (uint8_t)carry;
+      }
+      buf[pos++] = '0';
+      buf[pos++] = '.';
+      for (size_t i = len; i < 1075; ++i)
+        buf[pos++] = '0';
+      while (len)
+        buf[pos++] = (char)('0' + digits[--len]);
+      buf[pos] = 0;
+      char *p1 = buf;
+      u1.d = fio_atof(&p1);
+      FIO_ASSERT(!u1.u && p1 == buf + pos,
+                 "fio_atof halfway tie should round to even (zero)");
+      FIO_MEMSET(buf + pos, '0', 40); /* beyond the significant digit limit */
+      buf[pos + 40] = '1';
+      buf[pos + 41] = 0;
+      p1 = buf;
+      u1.d = fio_atof(&p1);
+      FIO_ASSERT(u1.u == 1 && p1 == buf + pos + 41,
+                 "fio_atof above halfway should round up (smallest subnormal)");
+    }
+    uint64_t seed = 0x2545F4914F6CDD1DULL;
+    for (size_t i = 0; i < (FIO_ATOL_TEST_MAX >> 2); ++i) {
+      seed = (seed * 6364136223846793005ULL) + 1442695040888963407ULL;
+      u1.u = (seed ^ (seed >> 29)) & (~FIO_MATH_DBL_SIGN_MASK);
+      if ((u1.u & FIO_MATH_DBL_EXPO_MASK) == FIO_MATH_DBL_EXPO_MASK)
+        continue; /* NaN / Infinity */
+      if ((i & 1))
+        snprintf(buf, 64, "%.17g", u1.d);
+      else
+        snprintf(buf, 64, "%.*e", (int)(i & 15), u1.d);
+      char *p1 = buf, *p2 = buf;
+      u1.d = fio_atof(&p1);
+      u2.d = strtod(p2, &p2);
+      FIO_ASSERT(u1.u == u2.u && p1 == p2,
+                 "fio_atof(%s) error: %.17g != %.17g",
+                 buf,
+                 u1.d,
+                 u2.d);
+    }
+  }
+
   FIO_NAME_TEST(stl, atol_speed)("fio_atol/fio_ltoa", fio_atol, fio_ltoa);
   FIO_NAME_TEST(stl, atol_speed)
   ("fio_aton/fio_ltoa", fio_aton_wrapper, fio_ltoa);
@@ -50783,6 +63799,181 @@ FIO_SFUNC int FIO_NAME_TEST(stl, fiobj_task)(fiobj_each_s *e) {
   return 0;
 }
 
+/* writes random white space and (sometimes) a comment */
+FIO_SFUNC char *FIO_NAME_TEST(stl, fiobj_json_space)(char *d, int comments) {
+  static const char *cmt[] = {"/* comment \"*/", "// comment \"\n", "#\n"};
+  uint64_t r = fio_rand64();
+  for (size_t i = r & 3; i; --i)
+    d = fio_bstr_write(d, " \t\r\n" + ((r >> (i << 1)) & 3), 1);
+  if (comments && !((r >> 8) & 31)) {
+    const char *c = cmt[((r >> 16) & 0xFF) % 3];
+    d = fio_bstr_write(d, c, FIO_STRLEN(c));
+  }
+  return d;
+}
+
+/* writes a random string, with escapes, that might cross block boundaries */
+FIO_SFUNC char *FIO_NAME_TEST(stl, fiobj_json_string)(char *d) {
+  static const char *parts[] = {"a", "\\\"", "\\\\", "\\n", "\\u00e9", "{[,:]}",
+                                "\\\\\\\"", "//", "#", "/*", " ", "0123456789"};
+  uint64_t r = fio_rand64();
+  size_t len = (r & 7) ? (r & 15) : ((r >> 4) & 127);
+  d = fio_bstr_write(d, "\"", 1);
+  for (size_t i = 0; i < len; ++i) {
+    const char *p = parts[(fio_rand64() & 0xFF) % 12];
+    d = fio_bstr_write(d, p, FIO_STRLEN(p));
+  }
+  return fio_bstr_write(d, "\"", 1);
+}
+
+/* writes a random JSON value (collections have a limited nesting depth) */
+FIO_SFUNC char *FIO_NAME_TEST(stl, fiobj_json_value)(char *d, size_t depth) {
+  static const char *words[] = {"true",
+                                "false",
+                                "null",
+                                "Infinity",
+                                "-Infinity",
+                                "0x1F",
+                                "1e400",
+                                "-0.0",
+                                "12345678901234567890"};
+  char buf[32];
+  uint64_t r = fio_rand64();
+  d = FIO_NAME_TEST(stl, fiobj_json_space)(d, 1);
+  switch ((r & 0xFF) % (depth < 5 ? 9 : 5)) {
+  case 0:
+    return fio_bstr_write(d, buf, fio_ltoa(buf, (int64_t)(r >> 8) >> 20, 10));
+  case 1:
+    return fio_bstr_write(d, buf, fio_ftoa(buf, (double)(r >> 11) / 1e9, 10));
+  case 2: return FIO_NAME_TEST(stl, fiobj_json_string)(d);
+  case 3: {
+    const char *w = words[((r >> 8) & 0xFF) % 9];
+    return fio_bstr_write(d, w, FIO_STRLEN(w));
+  }
+  case 4: return FIO_NAME_TEST(stl, fiobj_json_string)(d);
+  case 5: /* fall through */
+  case 6: {
+    size_t count = (r >> 8) & 7;
+    d = fio_bstr_write(d, "[", 1);
+    for (size_t i = 0; i < count; ++i) {
+      if (i)
+        d = fio_bstr_write(FIO_NAME_TEST(stl, fiobj_json_space)(d, 0), ",", 1);
+      d = FIO_NAME_TEST(stl, fiobj_json_value)(d, depth + 1);
+    }
+    if (count && ((r >> 12) & 1))
+      d = fio_bstr_write(d, ",", 1); /* trailing comma */
+    return fio_bstr_write(FIO_NAME_TEST(stl, fiobj_json_space)(d, 0), "]", 1);
+  }
+  default: {
+    size_t count = (r >> 8) & 7;
+    d = fio_bstr_write(d, "{", 1);
+    for (size_t i = 0; i < count; ++i) {
+      if (i)
+        d = fio_bstr_write(FIO_NAME_TEST(stl, fiobj_json_space)(d, 0), ",", 1);
+      d = FIO_NAME_TEST(stl, fiobj_json_space)(d, 1);
+      d = fio_bstr_write(FIO_NAME_TEST(stl, fiobj_json_string)(d), ":", 1);
+      d = FIO_NAME_TEST(stl, fiobj_json_value)(d, depth + 1);
+    }
+    return fio_bstr_write(FIO_NAME_TEST(stl, fiobj_json_space)(d, 0), "}", 1);
+  }
+  }
+}
+
+/* collects the top-level values of a JSON stream in an Array (`udata`) */
+FIO_SFUNC void FIO_NAME_TEST(stl, fiobj_json_stream_on_json)(void *udata,
+                                                             void *value) {
+  FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), push)
+  ((FIOBJ)udata, (FIOBJ)value);
+}
+
+/* writes JSON to a stream in random sized chunks, returns -1 on error */
+FIO_SFUNC int FIO_NAME_TEST(stl, fiobj_json_stream_write)(fio_json_stream_s *s,
+                                                          const char *json,
+                                                          size_t len) {
+  int r = 0;
+  while (len) {
+    uint64_t rnd = fio_rand64();
+    size_t chunk = (rnd & 1) ? 1 : (size_t)((rnd >> 8) % 96) + 1;
+    if (chunk > len)
+      chunk = len;
+    r |= fio_json_stream_write(s, json, chunk);
+    json += chunk;
+    len -= chunk;
+  }
+  return r;
+}
+
+/* collects a single Hash Map element (`udata`) for a JSON path test */
+FIO_SFUNC int FIO_NAME_TEST(stl, fiobj_json_path_pick)(fiobj_each_s *e) {
+  ((FIOBJ *)e->udata)[0] = e->key;
+  ((FIOBJ *)e->udata)[1] = e->value;
+  return -1;
+}
+
+/* writes a random JSON path notation (mostly) addressing data in `o` */
+FIO_SFUNC char *FIO_NAME_TEST(stl, fiobj_json_path_notation)(char *d,
+                                                             FIOBJ o) {
+  for (size_t depth = 0; depth < 8; ++depth) {
+    uint64_t r = fio_rand64();
+    if (!(r & 7))
+      return d;
+    if (FIOBJ_TYPE_CLASS(o) == FIOBJ_T_ARRAY) {
+      char buf[32];
+      /* some of the indexes are out of range */
+      size_t i = (size_t)((r >> 8) %
+                          (FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY),
+                                    count)(o) +
+                           2));
+      d = fio_bstr_write(d, "[", 1);
+      d = fio_bstr_write(d, buf, fio_ltoa(buf, (int64_t)i, 10));
+      d = fio_bstr_write(d, "]", 1);
+      o = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), get)(o, (int64_t)i);
+    } else if (FIOBJ_TYPE_CLASS(o) == FIOBJ_T_HASH &&
+               FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), count)(o)) {
+      FIOBJ kv[2] = {FIOBJ_INVALID, FIOBJ_INVALID};
+      fiobj_each1(o,
+                  FIO_NAME_TEST(stl, fiobj_json_path_pick),
+                  kv,
+                  (int32_t)((r >> 8) %
+                            FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH),
+                                     count)(o)));
+      fio_str_info_s k = FIO_NAME2(fiobj, cstr)(kv[0]);
+      if (!k.len || memchr(k.buf, '.', k.len) || memchr(k.buf, '[', k.len))
+        return d; /* keys that can't be addressed using a compiled path */
+      if (fio_bstr_len(d))
+        d = fio_bstr_write(d, ".", 1);
+      d = fio_bstr_write(d, k.buf, k.len);
+      o = kv[1];
+    } else {
+      if ((r >> 8) & 1) { /* a missing key */
+        if (fio_bstr_len(d))
+          d = fio_bstr_write(d, ".", 1);
+        d = fio_bstr_write(d, "missing", 7);
+      }
+      return d;
+    }
+  }
+  return d;
+}
+
+#if FIO_JSON_USE_INDEX
+/* parses JSON using either the recursive or the structural index parser */
+FIO_SFUNC FIOBJ FIO_NAME_TEST(stl, fiobj_json_parse)(const char *json,
+                                                     size_t len,
+                                                     int indexed,
+                                                     size_t *stop_pos) {
+  fio___json_state_s s = {.cb = FIOBJ_JSON_PARSER_CALLBACKS,
+                          .pos = json,
+                          .end = json + len};
+  FIO_ASSERT(!fio___json_callbacks_validate(&s.cb), "JSON callbacks error");
+  void *r = indexed ? fio___json_consume_indexed(&s) : fio___json_consume(&s);
+  *stop_pos = (size_t)(s.pos - json);
+  if (s.error)
+    return (FIOBJ)s.cb.on_error(r);
+  return (FIOBJ)r;
+}
+#endif /* FIO_JSON_USE_INDEX */
+
 FIO_SFUNC void FIO_NAME_TEST(stl, fiobj)(void) {
   FIOBJ o = FIOBJ_INVALID;
   if (!FIOBJ_MARK_MEMORY_ENABLED) {
@@ -50944,6 +64135,538 @@ FIO_SFUNC void FIO_NAME_TEST(stl, fiobj)(void) {
     fiobj_free(j);
     o = FIOBJ_INVALID;
   }
+#if FIO_JSON_USE_INDEX
+  {
+    fprintf(stderr, "* Testing FIOBJ JSON structural index (two stages).\n");
+    for (size_t round = 0; round < 2048; ++round) {
+      char *json = FIO_NAME_TEST(stl, fiobj_json_value)(NULL, 0);
+      size_t len = fio_bstr_len(json);
+      size_t stop[2];
+      FIOBJ r[2];
+      json = fio_bstr_write(json, " ", 1);
+      r[0] = FIO_NAME_TEST(stl, fiobj_json_parse)(json, len + 1, 0, stop);
+      r[1] = FIO_NAME_TEST(stl, fiobj_json_parse)(json, len + 1, 1, stop + 1);
+      FIO_ASSERT(r[0] != FIOBJ_INVALID && r[1] != FIOBJ_INVALID,
+                 "JSON parsing failed (%d, %d) for:\n%s",
+                 (int)(r[0] != FIOBJ_INVALID),
+                 (int)(r[1] != FIOBJ_INVALID),
+                 json);
+      FIO_ASSERT(FIO_NAME_BL(fiobj, eq)(r[0], r[1]),
+                 "JSON structural index parsing error for:\n%s",
+                 json);
+      FIO_ASSERT(stop[0] == stop[1] && stop[1] == len,
+                 "JSON structural index stop position error %zu != %zu (%zu)",
+                 stop[1],
+                 stop[0],
+                 len);
+      fiobj_free(r[0]);
+      fiobj_free(r[1]);
+      /* truncated JSON - both parsers should fail (or succeed) */
+      len = (size_t)(fio_rand64() % len);
+      json = fio_bstr_len_set(json, len);
+      r[0] = FIO_NAME_TEST(stl, fiobj_json_parse)(json, len, 0, stop);
+      r[1] = FIO_NAME_TEST(stl, fiobj_json_parse)(json, len, 1, stop + 1);
+      FIO_ASSERT((r[0] == FIOBJ_INVALID) == (r[1] == FIOBJ_INVALID),
+                 "JSON structural index error handling for:\n%s",
+                 json);
+      FIO_ASSERT(FIO_NAME_BL(fiobj, eq)(r[0], r[1]),
+                 "JSON structural index parsing error for:\n%s",
+                 json);
+      fiobj_free(r[0]);
+      fiobj_free(r[1]);
+      fio_bstr_free(json);
+    }
+    /* long strings, escapes across block boundaries, errors */
+    for (size_t i = 0; i < 192; ++i) {
+      char *json = fio_bstr_write(NULL, "[\"", 2);
+      size_t stop;
+      for (size_t j = 0; j < i; ++j)
+        json = fio_bstr_write(json, "\\", 1);
+      json = fio_bstr_write(json, "\", 1, {\"a\":[]}]", 15);
+      o = FIO_NAME_TEST(stl, fiobj_json_parse)(json,
+                                               fio_bstr_len(json),
+                                               1,
+                                               &stop);
+      if ((i & 1)) { /* odd backslashes escape the quote, next string */
+        FIO_ASSERT(o == FIOBJ_INVALID,
+                   "JSON structural index should fail for:\n%s",
+                   json);
+      } else {
+        FIO_ASSERT(FIOBJ_TYPE(o) == FIOBJ_T_ARRAY &&
+                       FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY),
+                                count)(o) == 3 &&
+                       FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), len)(
+                           FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY),
+                                    get)(o, 0)) == (i >> 1) &&
+                       stop == fio_bstr_len(json),
+                   "JSON structural index backslash error (%zu) for:\n%s",
+                   i,
+                   json);
+      }
+      fiobj_free(o);
+      fio_bstr_free(json);
+    }
+    {
+      static const char *bad[] = {
+          "[1 2]",
+          "[1,,2]",
+          "{\"a\" 1}",
+          "{\"a\":1 \"b\":2}",
+          "{\"a\":}",
+          "[\"a]",
+          "[1x]",
+          "{[]:1}",
+          "[/* open",
+          "]",
+          "[tru]",
+          "[1,2",
+          "[\"\\\"]",
+      };
+      for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+        size_t stop;
+        o = FIO_NAME_TEST(stl, fiobj_json_parse)(bad[i],
+                                                 FIO_STRLEN(bad[i]),
+                                                 1,
+                                                 &stop);
+        FIO_ASSERT(o == FIOBJ_INVALID,
+                   "JSON structural index should fail for: %s",
+                   bad[i]);
+        fiobj_free(o);
+      }
+    }
+    o = FIOBJ_INVALID;
+  }
+#endif /* FIO_JSON_USE_INDEX */
+  {
+    fprintf(stderr, "* Testing FIOBJ JSON streaming (push) parser.\n");
+    FIOBJ results = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), new)();
+    fio_json_stream_s *s = fio_json_stream_new(
+        .callbacks = &FIOBJ_JSON_PARSER_CALLBACKS,
+        .on_json = FIO_NAME_TEST(stl, fiobj_json_stream_on_json),
+        .udata = (void *)results);
+    FIO_ASSERT(s, "fio_json_stream_new failed");
+    for (size_t round = 0; round < 1024; ++round) {
+      char *json = FIO_NAME_TEST(stl, fiobj_json_value)(NULL, 0);
+      size_t len = fio_bstr_len(json);
+      size_t stop;
+      int r = FIO_NAME_TEST(stl, fiobj_json_stream_write)(s, json, len);
+      r |= fio_json_stream_finish(s);
+      o = fiobj_json_parse2(json, len, NULL);
+      FIO_ASSERT(!r && o != FIOBJ_INVALID &&
+                     FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY),
+                              count)(results) == 1,
+                 "JSON stream parsing failed for:\n%s",
+                 json);
+      FIO_ASSERT(FIO_NAME_BL(fiobj, eq)(
+                     o,
+                     FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY),
+                              get)(results, 0)),
+                 "JSON stream parsing error for:\n%s",
+                 json);
+      fiobj_free(o);
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), destroy)(results);
+      /* truncated JSON - stream should fail (or succeed) as the parser does */
+      len = (size_t)(fio_rand64() % len);
+      json = fio_bstr_len_set(json, len);
+      r = FIO_NAME_TEST(stl, fiobj_json_stream_write)(s, json, len);
+      r |= fio_json_stream_finish(s);
+      o = fiobj_json_parse2(json, len, &stop);
+      /* the stream rejects trailing data the parser stops before (`-Inf|in`) */
+      FIO_ASSERT(r ? (o == FIOBJ_INVALID || stop < len)
+                   : FIO_NAME_BL(fiobj, eq)(
+                         o,
+                         FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY),
+                                  get)(results, 0)),
+                 "JSON stream error handling (%d) for:\n%.*s",
+                 r,
+                 (int)len,
+                 json);
+      fiobj_free(o);
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), destroy)(results);
+      fio_bstr_free(json);
+    }
+    fio_json_stream_free(s);
+    {
+      static const char *bad[] = {
+          "[1 2]",
+          "[1,,2]",
+          "{\"a\" 1}",
+          "{\"a\":1 \"b\":2}",
+          "{\"a\":}",
+          "[\"a]",
+          "[1x]",
+          "{[]:1}",
+          "[/* open",
+          "]",
+          "[tru]",
+          "[1,2",
+          "[\"\\\"]",
+          "[1]]",
+          "",
+          "[[[[[[[[1]]]]]]]]",
+          "[\"a token longer than 32 bytes, buffered\"]",
+      };
+      s = fio_json_stream_new(.callbacks = &FIOBJ_JSON_PARSER_CALLBACKS,
+                              .max_depth = 7,
+                              .max_token = 32);
+      for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+        int r = 0;
+        for (size_t j = 0; bad[i][j]; ++j) /* one byte at a time */
+          r |= fio_json_stream_write(s, bad[i] + j, 1);
+        r |= fio_json_stream_finish(s);
+        FIO_ASSERT(r == -1, "JSON stream should fail for: %s", bad[i]);
+      }
+      FIO_ASSERT(!fio_json_stream_write(s, "[[[[[[[1]]]]]]] ", 16) &&
+                     !fio_json_stream_finish(s),
+                 "JSON stream nesting limit error");
+      fio_json_stream_free(s);
+    }
+    /* NDJSON - one value per line, invalid lines are skipped */
+    s = fio_json_stream_new(.callbacks = &FIOBJ_JSON_PARSER_CALLBACKS,
+                            .on_json =
+                                FIO_NAME_TEST(stl, fiobj_json_stream_on_json),
+                            .udata = (void *)results,
+                            .ndjson = 1);
+    for (size_t round = 0; round < 64; ++round) {
+      FIOBJ expected = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), new)();
+      char *ndjson = NULL;
+      int r = 0;
+      for (size_t i = 0; i < 32; ++i) {
+        char *json = FIO_NAME_TEST(stl, fiobj_json_value)(NULL, 0);
+        if (FIO_MEMCHR(json, '\n', fio_bstr_len(json))) {
+          fio_bstr_free(json); /* values must fit on a single line */
+          continue;
+        }
+        if (!(fio_rand64() & 7)) { /* an invalid line (unterminated array) */
+          ndjson = fio_bstr_write(ndjson, "[1,", 3);
+          r = -1;
+        } else {
+          FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), push)
+          (expected, fiobj_json_parse2(json, fio_bstr_len(json), NULL));
+        }
+        ndjson = fio_bstr_write(ndjson, json, fio_bstr_len(json));
+        ndjson = fio_bstr_write(ndjson, "\r\n" + (i & 1), 2 - (i & 1));
+        fio_bstr_free(json);
+      }
+      FIO_ASSERT(FIO_NAME_TEST(stl, fiobj_json_stream_write)(
+                     s,
+                     ndjson,
+                     fio_bstr_len(ndjson)) == r &&
+                     !fio_json_stream_finish(s),
+                 "NDJSON stream error reporting for:\n%s",
+                 ndjson);
+      FIO_ASSERT(FIO_NAME_BL(fiobj, eq)(expected, results),
+                 "NDJSON stream parsing error for:\n%s",
+                 ndjson);
+      fiobj_free(expected);
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), destroy)(results);
+      fio_bstr_free(ndjson);
+    }
+    fio_json_stream_free(s);
+    fiobj_free(results);
+    o = FIOBJ_INVALID;
+  }
+  {
+    fprintf(stderr, "* Testing FIOBJ JSON arena documents.\n");
+    for (size_t round = 0; round < 1024; ++round) {
+      char *json = FIO_NAME_TEST(stl, fiobj_json_value)(NULL, 0);
+      size_t len = fio_bstr_len(json);
+      size_t stop[2];
+      FIOBJ r[2], tmp, expected;
+      r[0] = fiobj_json_parse(FIO_STR_INFO2(json, len), stop);
+      r[1] = fiobj_json_parse_arena(FIO_STR_INFO2(json, len), stop + 1);
+      FIO_ASSERT(r[0] != FIOBJ_INVALID && r[1] != FIOBJ_INVALID,
+                 "JSON arena parsing failed (%d, %d) for:\n%s",
+                 (int)(r[0] != FIOBJ_INVALID),
+                 (int)(r[1] != FIOBJ_INVALID),
+                 json);
+      FIO_ASSERT(FIO_NAME_BL(fiobj, eq)(r[0], r[1]) && stop[0] == stop[1],
+                 "JSON arena parsing error for:\n%s",
+                 json);
+      FIO_ASSERT(!FIO_NAME_BL(fiobj, arena)(r[0]),
+                 "fiobj_json_parse result shouldn't be arena backed");
+      /* a nested object escapes the arena when duplicated */
+      tmp = r[1];
+      expected = r[0];
+      while (FIOBJ_TYPE_CLASS(tmp) == FIOBJ_T_ARRAY &&
+             FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), count)(tmp)) {
+        tmp = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), get)(tmp, 0);
+        expected =
+            FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), get)(expected, 0);
+      }
+      if (tmp != r[1] && FIO_NAME_BL(fiobj, arena)(tmp)) {
+        FIOBJ cpy = fiobj_dup(tmp);
+        FIO_ASSERT(cpy != tmp && !FIO_NAME_BL(fiobj, arena)(cpy),
+                   "fiobj_dup should copy nested arena objects");
+        fiobj_free(tmp); /* no-op for nested arena objects */
+        fiobj_free(r[1]);
+        FIO_ASSERT(FIO_NAME_BL(fiobj, eq)(cpy, expected),
+                   "nested arena object copy error for:\n%s",
+                   json);
+        fiobj_free(cpy);
+      } else {
+        /* the root is reference counted */
+        FIO_ASSERT(fiobj_dup(r[1]) == r[1], "fiobj_dup(arena root) error");
+        fiobj_free(r[1]);
+        FIO_ASSERT(FIO_NAME_BL(fiobj, eq)(r[0], r[1]),
+                   "arena root released early");
+        fiobj_free(r[1]);
+      }
+      fiobj_free(r[0]);
+      /* truncated JSON - both parsers should fail (or succeed) */
+      len = (size_t)(fio_rand64() % len);
+      r[0] = fiobj_json_parse(FIO_STR_INFO2(json, len), stop);
+      r[1] = fiobj_json_parse_arena(FIO_STR_INFO2(json, len), stop + 1);
+      FIO_ASSERT((r[0] == FIOBJ_INVALID) == (r[1] == FIOBJ_INVALID) &&
+                     FIO_NAME_BL(fiobj, eq)(r[0], r[1]),
+                 "JSON arena error handling for:\n%.*s",
+                 (int)len,
+                 json);
+      fiobj_free(r[0]);
+      fiobj_free(r[1]);
+      fio_bstr_free(json);
+    }
+#if !defined(DEBUG) /* DEBUG builds assert (abort) on read-only mutations */
+    {
+      /* arena backed containers are read-only, mutators are no-ops */
+      char json[] = "{\"a\":[1,2,3],\"b\":{\"c\":[4],\"d\":5}}";
+      FIOBJ root = fiobj_json_parse_arena(FIO_STR_INFO2(json, sizeof(json) - 1),
+                                          NULL);
+      FIOBJ expected = fiobj_json_parse(FIO_STR_INFO2(json, sizeof(json) - 1),
+                                        NULL);
+      FIOBJ a =
+          FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), get2)(root, "a", 1);
+      FIOBJ b =
+          FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), get2)(root, "b", 1);
+      FIOBJ old = FIOBJ_INVALID;
+      int log_level = FIO_LOG_LEVEL_GET();
+      FIO_ASSERT(FIO_NAME_BL(fiobj, arena)(a) && FIO_NAME_BL(fiobj, arena)(b),
+                 "arena document nodes should be arena backed");
+      FIO_LOG_LEVEL_SET(FIO_LOG_LEVEL_NONE);
+      FIO_ASSERT(!FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), push)(
+                     a,
+                     FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING),
+                              new_cstr)("push", 4)),
+                 "fiobj_array_push should fail for arena nodes");
+      FIO_ASSERT(!FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), unshift)(
+                     a,
+                     FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING),
+                              new_cstr)("unshift", 7)),
+                 "fiobj_array_unshift should fail for arena nodes");
+      FIO_ASSERT(!FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), set)(
+                     a,
+                     0,
+                     FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING),
+                              new_cstr)("set", 3),
+                     &old) &&
+                     old == FIOBJ_INVALID,
+                 "fiobj_array_set should fail for arena nodes");
+      FIO_ASSERT(FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), pop)(a, &old) &&
+                     FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY),
+                              shift)(a, &old) &&
+                     FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY),
+                              remove)(a, 0, &old) &&
+                     !FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), remove2)(
+                         a,
+                         FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_NUMBER),
+                                  new)(1)) &&
+                     old == FIOBJ_INVALID,
+                 "Array removal should fail for arena nodes");
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), compact)(a);
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), reserve)(a, 64);
+      FIO_ASSERT(!FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), concat)(a, a),
+                 "fiobj_array_concat should fail for arena nodes");
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), set2)
+      (b,
+       "e",
+       1,
+       FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), new_cstr)("set2", 4));
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), set2)
+      (root, "a", 1, FIOBJ_INVALID);
+      FIO_ASSERT(FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH),
+                          remove2)(root, "b", 1, &old) &&
+                     old == FIOBJ_INVALID,
+                 "fiobj_hash_remove2 should fail for arena nodes");
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), evict)(b, 1);
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), clear)(b);
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), compact)(b);
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), reserve)(root, 1024);
+      FIO_LOG_LEVEL_SET(log_level);
+      FIO_ASSERT(FIO_NAME_BL(fiobj, eq)(root, expected),
+                 "arena document shouldn't be mutated");
+      FIO_ASSERT(FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), capa)(root) <
+                     1024,
+                 "arena document shouldn't be reallocated");
+      fiobj_free(expected);
+      fiobj_free(root);
+    }
+#endif
+  }
+  {
+    fprintf(stderr, "* Testing FIOBJ JSON compiled paths.\n");
+    static const char *bad[] = {"a..b", "[x]", "[1", "[1]x", "[]", "a[2]b"};
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i)
+      FIO_ASSERT(!fiobj_json_path_new2(bad[i], FIO_STRLEN(bad[i])),
+                 "fiobj_json_path_new should fail for %s",
+                 bad[i]);
+    for (size_t round = 0; round < 512; ++round) {
+      char *json = FIO_NAME_TEST(stl, fiobj_json_value)(NULL, 0);
+      size_t len = fio_bstr_len(json);
+      size_t stop[2], count = 1 + (fio_rand64() & 3), found = 0;
+      char *notations[4] = {NULL};
+      fio_str_info_s n[4];
+      FIOBJ expected[4], r[4];
+      o = fiobj_json_parse(FIO_STR_INFO2(json, len), stop);
+      FIO_ASSERT(o != FIOBJ_INVALID, "JSON parsing failed for:\n%s", json);
+      for (size_t i = 0; i < count; ++i) {
+        notations[i] = FIO_NAME_TEST(stl, fiobj_json_path_notation)(NULL, o);
+        n[i] = FIO_STR_INFO2(notations[i], fio_bstr_len(notations[i]));
+        expected[i] = fiobj_json_find(o, n[i]);
+        found += (expected[i] != FIOBJ_INVALID);
+      }
+      fiobj_json_path_s *path = fiobj_json_path_new(n, count);
+      FIO_ASSERT(path && fiobj_json_path_count(path) == count,
+                 "fiobj_json_path_new failed for %s",
+                 notations[0]);
+      FIO_ASSERT(fiobj_json_path_find(o, path) == expected[0],
+                 "fiobj_json_path_find error for %s in:\n%s",
+                 notations[0],
+                 json);
+      FIO_ASSERT(fiobj_json_path_find_all(o, path, r) == found,
+                 "fiobj_json_path_find_all count error for:\n%s",
+                 json);
+      for (size_t i = 0; i < count; ++i)
+        FIO_ASSERT(r[i] == expected[i],
+                   "fiobj_json_path_find_all error for %s in:\n%s",
+                   notations[i],
+                   json);
+      /* selective parsing */
+      FIO_ASSERT(fiobj_json_path_parse(path,
+                                       FIO_STR_INFO2(json, len),
+                                       r,
+                                       stop + 1) == found &&
+                     stop[0] == stop[1],
+                 "fiobj_json_path_parse count error for:\n%s",
+                 json);
+      for (size_t i = 0; i < count; ++i) {
+        FIO_ASSERT(FIO_NAME_BL(fiobj, eq)(r[i], expected[i]),
+                   "fiobj_json_path_parse error for %s in:\n%s",
+                   notations[i],
+                   json);
+        fiobj_free(r[i]);
+      }
+      fiobj_free(o);
+      /* truncated JSON - should fail (or succeed) like fiobj_json_parse */
+      len = (size_t)(fio_rand64() % len);
+      o = fiobj_json_parse(FIO_STR_INFO2(json, len), stop);
+      found = fiobj_json_path_parse(path, FIO_STR_INFO2(json, len), r, NULL);
+      FIO_ASSERT(o != FIOBJ_INVALID || !found,
+                 "fiobj_json_path_parse error handling for:\n%.*s",
+                 (int)len,
+                 json);
+      for (size_t i = 0; i < count; ++i) {
+        FIO_ASSERT(FIO_NAME_BL(fiobj, eq)(r[i], fiobj_json_find(o, n[i])),
+                   "fiobj_json_path_parse error for %s in:\n%.*s",
+                   notations[i],
+                   (int)len,
+                   json);
+        fiobj_free(r[i]);
+      }
+      fiobj_free(o);
+      fiobj_json_path_free(path);
+      for (size_t i = 0; i < count; ++i)
+        fio_bstr_free(notations[i]);
+      fio_bstr_free(json);
+    }
+    { /* duplicate keys - the last value wins */
+      char json[] = "{\"a\":{\"b\":1},\"a\":{\"c\":2}}";
+      fio_str_info_s n[2] = {FIO_STR_INFO1((char *)"a.b"),
+                             FIO_STR_INFO1((char *)"a.c")};
+      fiobj_json_path_s *path = fiobj_json_path_new(n, 2);
+      FIOBJ r[2];
+      FIO_ASSERT(fiobj_json_path_parse(path,
+                                       FIO_STR_INFO2(json, sizeof(json) - 1),
+                                       r,
+                                       NULL) == 1 &&
+                     r[0] == FIOBJ_INVALID && fiobj2i(r[1]) == 2,
+                 "fiobj_json_path_parse duplicate key error");
+      fiobj_free(r[1]);
+      fiobj_json_path_free(path);
+    }
+    o = FIOBJ_INVALID;
+  }
+  {
+    fprintf(stderr, "* Testing FIOBJ JSON output (fiobj_json_write).\n");
+    for (size_t round = 0; round < 4096; ++round) {
+      /* escaping must match fio_string_write_escape for any byte */
+      char raw[80];
+      size_t len = (size_t)(fio_rand64() % 80);
+      uint64_t r = fio_rand64();
+      for (size_t i = 0; i < len; ++i) {
+        if (!(i & 7))
+          r = fio_rand64();
+        raw[i] = (char)((r & 1) ? (r >> 8) : ((r >> 8) & 0x7F) | 0x20);
+        r >>= 8;
+      }
+      o = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), new_cstr)(raw, len);
+      FIOBJ json = fiobj2json(FIOBJ_INVALID, o, 0);
+      FIOBJ expected = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), new)();
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)(expected, "\"", 1);
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write_escape)
+      (expected, raw, len);
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)(expected, "\"", 1);
+      FIO_ASSERT(FIO_NAME_BL(fiobj, eq)(json, expected),
+                 "JSON String escaping error:\n%s\n%s",
+                 FIO_NAME2(fiobj, cstr)(json).buf,
+                 FIO_NAME2(fiobj, cstr)(expected).buf);
+      FIO_ASSERT(fiobj_json_capa(o, 0) ==
+                     FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), len)(json) +
+                         1,
+                 "fiobj_json_capa String length error");
+      fiobj_free(expected);
+      fiobj_free(json);
+      fiobj_free(o);
+    }
+    for (size_t round = 0; round < 1024; ++round) {
+      char *src = FIO_NAME_TEST(stl, fiobj_json_value)(NULL, 0);
+      o = fiobj_json_parse(FIO_STR_INFO2(src, fio_bstr_len(src)), NULL);
+      for (uint8_t beautify = 0; beautify < 2; ++beautify) {
+        FIOBJ json = fiobj2json(FIOBJ_INVALID, o, beautify);
+        fio_str_info_s j = FIO_NAME2(fiobj, cstr)(json);
+        size_t capa = fiobj_json_capa(o, beautify);
+        char *buf = (char *)FIO_MEM_REALLOC(NULL, 0, capa, 0);
+        FIO_ASSERT_ALLOC(buf);
+        FIO_ASSERT(capa > j.len, "fiobj_json_capa too short");
+        FIO_ASSERT(fiobj_json_write(buf, o, beautify) == j.len &&
+                       !buf[j.len] && !FIO_MEMCMP(buf, j.buf, j.len),
+                   "fiobj_json_write error for:\n%s",
+                   j.buf);
+        FIO_MEM_FREE(buf, capa);
+        /* appending to an existing String */
+        FIOBJ tmp = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), new_cstr)(
+            "JSON: ",
+            6);
+        FIO_ASSERT(fiobj2json(tmp, o, beautify) == tmp &&
+                       FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING),
+                                len)(tmp) == j.len + 6 &&
+                       !FIO_MEMCMP(FIO_NAME2(fiobj, cstr)(tmp).buf + 6,
+                                   j.buf,
+                                   j.len),
+                   "fiobj2json append error for:\n%s",
+                   j.buf);
+        fiobj_free(tmp);
+        tmp = fiobj_json_parse(j, NULL);
+        FIO_ASSERT(FIO_NAME_BL(fiobj, eq)(o, tmp),
+                   "fiobj2json round-trip error for:\n%s",
+                   j.buf);
+        fiobj_free(tmp);
+        fiobj_free(json);
+      }
+      fiobj_free(o);
+      fio_bstr_free(src);
+    }
+    o = FIOBJ_INVALID;
+  }
   {
     fprintf(stderr, "* Testing FIOBJ array equality test (fiobj_is_eq).\n");
     FIOBJ a1 = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), new)();
@@ -51299,6 +65022,13 @@ Copyright and License: see header file (000 copyright.h) or top of file
 // #undef FIO___TEST_REINCLUDE
 // #endif
 
+/* collects access log batches into a fio_bstr */
+FIO_SFUNC void fio___test_http_log_on_write(fio_str_info_s lines,
+                                            void *udata) {
+  char **log = (char **)udata;
+  *log = fio_bstr_write(*log, lines.buf, lines.len);
+}
+
 FIO_SFUNC void FIO_NAME_TEST(stl, http_s)(void) {
   fprintf(stderr, "* Testing HTTP handle (fio_http_s).\n");
   fio_http_s *h = fio_http_new();
@@ -51448,6 +65178,164 @@ FIO_SFUNC void FIO_NAME_TEST(stl, http_s)(void) {
                "fio_http_body_read_until token error");
   }
 
+#if defined(P_tmpdir)
+  { /* test static file responses (and the static file cache) */
+    char name[64];
+    fio_str_info_s folder = FIO_STR_INFO1((char *)P_tmpdir);
+    FIO_STR_INFO_TMP_VAR(path, 1023);
+    uint64_t rnd = fio_rand64();
+    snprintf(name,
+             sizeof(name),
+             "/fio_test_static_%llx",
+             (unsigned long long)rnd);
+    fio_string_write2(&path,
+                      NULL,
+                      FIO_STRING_WRITE_STR2(folder.buf, folder.len),
+                      FIO_STRING_WRITE_STR1(name),
+                      FIO_STRING_WRITE_STR2(".txt", 4));
+    FIO_ASSERT(fio_filename_overwrite(path.buf, "static file body", 16) == 0,
+               "couldn't create test file %s",
+               path.buf);
+    fio_string_write(&path, NULL, ".gz", 3);
+    FIO_ASSERT(fio_filename_overwrite(path.buf, "compressed", 10) == 0,
+               "couldn't create test file %s",
+               path.buf);
+    path.len -= 3;
+    path.buf[path.len] = 0;
+    fio_str_info_s etag[2] = {{0}};
+    char etag_buf[2][32];
+    for (size_t round = 0; round < 4; ++round) {
+      /* round 0/2: identity, round 1/3: gzip (2+ may be served from cache) */
+      fio_http_s *s = fio_http_new();
+      fio_http_status_set(s, 200);
+      fio_http_method_set(s, FIO_STR_INFO1((char *)"GET"));
+      if ((round & 1))
+        fio_http_request_header_set(
+            s,
+            FIO_STR_INFO1((char *)"accept-encoding"),
+            FIO_STR_INFO1((char *)"gzip, deflate"));
+      FIO_ASSERT(!fio_http_static_file_response(
+                     s,
+                     folder,
+                     FIO_STR_INFO2(name, strlen(name)), /* auto-completed */
+                     3600),
+                 "fio_http_static_file_response failed (%zu)",
+                 round);
+      fio_str_info_s tmp =
+          fio_http_response_header(s, FIO_STR_INFO1((char *)"etag"), 0);
+      FIO_ASSERT(fio_http_status(s) == 200 && tmp.len,
+                 "static file response status / etag error (%zu)",
+                 round);
+      if (round < 2) {
+        FIO_ASSERT(tmp.len < 32, "etag too long");
+        FIO_MEMCPY(etag_buf[round], tmp.buf, tmp.len);
+        etag[round] = FIO_STR_INFO2(etag_buf[round], tmp.len);
+      }
+      FIO_ASSERT(FIO_STR_INFO_IS_EQ(tmp, etag[round & 1]),
+                 "static file etag should be stable (%zu)",
+                 round);
+      FIO_ASSERT(!(round & 1) || !FIO_STR_INFO_IS_EQ(etag[0], etag[1]),
+                 "static file variants should have different etags");
+      tmp = fio_http_response_header(s,
+                                     FIO_STR_INFO1((char *)"content-encoding"),
+                                     0);
+      FIO_ASSERT((round & 1) ? FIO_STR_INFO_IS_EQ(tmp,
+                                                  FIO_STR_INFO1((char *)"gzip"))
+                             : !tmp.len,
+                 "static file content-encoding error (%zu)",
+                 round);
+      tmp = fio_http_response_header(s,
+                                     FIO_STR_INFO1((char *)"content-length"),
+                                     0);
+      FIO_ASSERT(FIO_STR_INFO_IS_EQ(
+                     tmp,
+                     FIO_STR_INFO1((char *)((round & 1) ? "10" : "16"))),
+                 "static file content-length error (%zu)",
+                 round);
+      fio_http_free(s);
+    }
+    { /* test if-none-match */
+      fio_http_s *s = fio_http_new();
+      fio_http_status_set(s, 200);
+      fio_http_method_set(s, FIO_STR_INFO1((char *)"GET"));
+      fio_http_request_header_set(s,
+                                  FIO_STR_INFO1((char *)"if-none-match"),
+                                  etag[0]);
+      FIO_ASSERT(!fio_http_static_file_response(
+                     s,
+                     folder,
+                     FIO_STR_INFO2(path.buf + folder.len,
+                                   path.len - folder.len),
+                     0) &&
+                     fio_http_status(s) == 304,
+                 "static file if-none-match should return 304");
+      fio_http_free(s);
+    }
+#if FIO_HTTP_STATIC_FILE_CACHE_LIMIT
+    FIO_ASSERT(fio___http_sfc_map_count(&FIO___HTTP_SFC.map),
+               "static file cache should hold an entry");
+#endif
+    unlink(path.buf);
+    fio_string_write(&path, NULL, ".gz", 3);
+    unlink(path.buf);
+  }
+#endif /* P_tmpdir */
+
+  { /* test the access log sink */
+    char *log = NULL;
+    size_t lines = 0, dropped = fio_http_log_dropped();
+    fio_http_s *s = fio_http_new();
+    fio_http_status_set(s, 200);
+    fio_http_method_set(s, FIO_STR_INFO1((char *)"GET"));
+    fio_http_path_set(s, FIO_STR_INFO1((char *)"/log\"test"));
+    fio_http_version_set(s, FIO_STR_INFO1((char *)"HTTP/1.1"));
+    fio_http_log_sink(.on_write = fio___test_http_log_on_write, .udata = &log);
+    fio_http_write_log(s);
+    fio_http_log_flush();
+    FIO_ASSERT(log && fio_bstr_len(log) &&
+                   log[fio_bstr_len(log) - 1] == '\n' &&
+                   strstr(log, "\"GET /log\"test HTTP/1.1\" 200 "),
+               "access log line error:\n%s",
+               log);
+    fio_bstr_free(log);
+    log = NULL;
+    fio_http_log_sink(.on_write = fio___test_http_log_on_write,
+                      .udata = &log,
+                      .json = 1);
+    fio_http_write_log(s);
+    fio_http_log_flush();
+    FIO_ASSERT(log && !FIO_MEMCMP(log, "{\"pid\":", 7) &&
+                   strstr(log, ",\"path\":\"/log\\\"test\",") &&
+                   strstr(log, ",\"status\":200,") &&
+                   !FIO_MEMCMP(log + fio_bstr_len(log) - 2, "}\n", 2),
+               "JSON access log line error:\n%s",
+               log);
+    fio_bstr_free(log);
+    log = NULL;
+    for (size_t block = 0; block < 2; ++block) {
+      fio_http_log_sink(.on_write = fio___test_http_log_on_write,
+                        .udata = &log,
+                        .block = (uint8_t)block);
+      for (size_t i = 0; i < 4096; ++i)
+        fio_http_write_log(s);
+      fio_http_log_flush();
+      lines = 0;
+      for (char *pos = log; (pos = strchr(pos, '\n')); ++pos)
+        ++lines;
+      FIO_ASSERT(lines + (fio_http_log_dropped() - dropped) == 4096,
+                 "access log lines lost (%zu written, %zu dropped)",
+                 lines,
+                 (fio_http_log_dropped() - dropped));
+      FIO_ASSERT(!block || fio_http_log_dropped() == dropped,
+                 "blocking access log shouldn't drop lines");
+      dropped = fio_http_log_dropped();
+      fio_bstr_free(log);
+      log = NULL;
+    }
+    fio_http_log_sink(.fd = 0); /* restore default (STDOUT) */
+    fio_http_free(s);
+  }
+
   /* almost done, just make sure reference counting doesn't destroy object */
   fio_http_free(fio_http_dup(h));
   FIO_ASSERT(
@@ -51458,6 +65346,1410 @@ FIO_SFUNC void FIO_NAME_TEST(stl, http_s)(void) {
   fio_http_free(h);
 }
 
+
+/* collects multipart parser events into a fio_bstr (`part->udata`) */
+FIO_SFUNC int fio___test_http_multipart_on_part(
+    fio_http_multipart_part_s *part) {
+  char **out = (char **)part->udata;
+  *out = fio_bstr_write(*out, "[", 1);
+  *out = fio_bstr_write(*out, part->name.buf, part->name.len);
+  *out = fio_bstr_write(*out, "|", 1);
+  *out = fio_bstr_write(*out, part->filename.buf, part->filename.len);
+  *out = fio_bstr_write(*out, "|", 1);
+  *out = fio_bstr_write(*out, part->content_type.buf, part->content_type.len);
+  *out = fio_bstr_write(*out, "]", 1);
+  if (part->filename.len && fio_bstr_len(*out) < 4096 &&
+      !FIO_MEMCMP(part->filename.buf, "fd", 2))
+    part->fd = fio_filename_tmp(); /* stream to a file */
+  return 0;
+}
+FIO_SFUNC int fio___test_http_multipart_on_data(fio_http_multipart_part_s *part,
+                                                fio_buf_info_s data) {
+  char **out = (char **)part->udata;
+  *out = fio_bstr_write(*out, data.buf, data.len);
+  return 0 - (data.buf[0] == '!'); /* tests callback errors */
+}
+FIO_SFUNC int fio___test_http_multipart_on_part_end(
+    fio_http_multipart_part_s *part) {
+  char **out = (char **)part->udata;
+  if (part->fd != -1) { /* read back the file's content */
+    char tmp[256];
+    size_t len = fio_fd_read(part->fd, tmp, sizeof(tmp), 0);
+    FIO_ASSERT(len == part->len, "multipart part file length error");
+    *out = fio_bstr_write(*out, "(fd)", 4);
+    *out = fio_bstr_write(*out, tmp, len);
+    close(part->fd);
+  }
+  if (part->error)
+    *out = fio_bstr_write(*out, "<error>", 7);
+  else
+    *out = fio_bstr_write(*out, "<end>", 5);
+  return 0;
+}
+
+FIO_SFUNC void FIO_NAME_TEST(stl, http_body_parsing)(void) {
+  fprintf(stderr, "* Testing HTTP body parsing helpers.\n");
+  { /* urlencoded / query parsing */
+    const char *expected[] = {"a", "1", "b", "", "c", "", "", "d", "e", "%20x"};
+    size_t count = 0;
+    FIO_HTTP_URLENCODED_EACH(FIO_STR_INFO1((char *)"a=1&&b=&c&=d&e=%20x&"),
+                             i) {
+      FIO_ASSERT(count < 10 &&
+                     FIO_STR_INFO_IS_EQ(
+                         i.name,
+                         FIO_STR_INFO1((char *)expected[count])) &&
+                     FIO_STR_INFO_IS_EQ(
+                         i.value,
+                         FIO_STR_INFO1((char *)expected[count + 1])),
+                 "FIO_HTTP_URLENCODED_EACH error at %zu (%.*s=%.*s)",
+                 count >> 1,
+                 (int)i.name.len,
+                 i.name.buf,
+                 (int)i.value.len,
+                 i.value.buf);
+      count += 2;
+    }
+    FIO_ASSERT(count == 10, "FIO_HTTP_URLENCODED_EACH count error");
+    FIO_HTTP_URLENCODED_EACH(FIO_STR_INFO0, i) {
+      FIO_ASSERT(0, "FIO_HTTP_URLENCODED_EACH shouldn't iterate empty data");
+    }
+  }
+  { /* multipart parsing, using every chunk size */
+    fio_str_info_s content_type = FIO_STR_INFO1(
+        (char *)"Multipart/Form-Data; charset=utf-8; boundary=\"xyz123\"");
+    const char *body =
+        "preamble\r\n--xyz123\r\n"
+        "Content-Disposition: form-data; name=\"field\"\r\n"
+        "\r\n"
+        "value\r\n"
+        "--xyz123  \r\n"
+        "content-disposition: form-data; name=\"up\"; filename=\"a.bin\"\r\n"
+        "Content-Type: application/octet-stream\r\n"
+        "\r\n"
+        "l1\r\nl2\r\n--xyz12\r\r\n--xy\r\n\r\n--xyz123\r\n"
+        "Content-Disposition: form-data; name=file; filename=\"fd.txt\"\r\n"
+        "\r\n"
+        "streamed\r\n--xyz123\r\n"
+        "\r\n"
+        "\r\n--xyz123--\r\nepilogue\r\n--xyz123\r\n";
+    const char *expected = "[field||]value<end>"
+                           "[up|a.bin|application/octet-stream]"
+                           "l1\r\nl2\r\n--xyz12\r\r\n--xy\r\n<end>"
+                           "[file|fd.txt|](fd)streamed<end>"
+                           "[||]<end>";
+    const size_t body_len = strlen(body);
+    const size_t body_end = (size_t)(strstr(body, "--xyz123--") + 10 - body);
+    FIO_ASSERT(!fio_http_multipart_new(FIO_STR_INFO1((char *)"text/plain"),
+                                       .udata = NULL),
+               "multipart parser should require multipart/form-data");
+    FIO_ASSERT(!fio_http_multipart_new(
+                   FIO_STR_INFO1((char *)"multipart/form-data; charset=x"),
+                   .udata = NULL),
+               "multipart parser should require a boundary");
+    for (size_t chunk = 1; chunk <= body_len; ++chunk) {
+      char *out = NULL;
+      fio_http_multipart_s *p =
+          fio_http_multipart_new(content_type,
+                                 .on_part = fio___test_http_multipart_on_part,
+                                 .on_data = fio___test_http_multipart_on_data,
+                                 .on_part_end =
+                                     fio___test_http_multipart_on_part_end,
+                                 .udata = &out);
+      FIO_ASSERT(p, "fio_http_multipart_new failed");
+      for (size_t pos = 0; pos < body_len; pos += chunk) {
+        size_t len = (body_len - pos < chunk) ? body_len - pos : chunk;
+        FIO_ASSERT(!fio_http_multipart_is_finished(p) || pos >= body_end,
+                   "multipart parser finished too soon");
+        FIO_ASSERT(!fio_http_multipart_parse(
+                       p,
+                       FIO_BUF_INFO2((char *)body + pos, len)),
+                   "multipart parser error (chunk size %zu)",
+                   chunk);
+      }
+      FIO_ASSERT(fio_http_multipart_is_finished(p) == 1,
+                 "multipart parser should be finished (chunk size %zu)",
+                 chunk);
+      FIO_ASSERT(out && !strcmp(out, expected),
+                 "multipart parser output error (chunk size %zu):\n%s",
+                 chunk,
+                 out);
+      fio_bstr_free(out);
+      fio_http_multipart_free(p);
+    }
+    { /* errors */
+      fio_http_multipart_s *p =
+          fio_http_multipart_new(content_type, .udata = NULL);
+      FIO_ASSERT(fio_http_multipart_parse(
+                     p,
+                     FIO_BUF_INFO1((char *)"--xyz123x\r\n\r\n")) == -1,
+                 "multipart parser should fail on invalid boundary lines");
+      FIO_ASSERT(fio_http_multipart_is_finished(p) == -1 &&
+                     fio_http_multipart_parse(p,
+                                              FIO_BUF_INFO1((char *)"\r\n")) ==
+                         -1,
+                 "multipart parser errors should persist");
+      fio_http_multipart_free(p);
+    }
+    { /* parts cut short still reach `on_part_end` (i.e., to close files) */
+      static const char *tests[][2] = {
+          {"--xyz123\r\nContent-Disposition: form-data; name=f; "
+           "filename=fd.txt\r\n\r\ntrunca",
+           "[f|fd.txt|](fd)trunca<error>"},
+          {"--xyz123\r\nContent-Disposition: form-data; name=f\r\n\r\n"
+           "!fail\r\n--xyz123--",
+           "[f||]!fail<error>"},
+          {"--xyz123\r\nContent-Disposition: form-data; name=f\r\n\r\n"
+           "ok\r\n--xyz123\r\nContent-Disposition: form-data; name=g\r\n"
+           "\r\n!",
+           "[f||]ok<end>[g||]!<error>"},
+          {NULL},
+      };
+      for (size_t i = 0; tests[i][0]; ++i) {
+        char *out = NULL;
+        fio_http_multipart_s *p =
+            fio_http_multipart_new(content_type,
+                                   .on_part = fio___test_http_multipart_on_part,
+                                   .on_data = fio___test_http_multipart_on_data,
+                                   .on_part_end =
+                                       fio___test_http_multipart_on_part_end,
+                                   .udata = &out);
+        fio_http_multipart_parse(p, FIO_BUF_INFO1((char *)tests[i][0]));
+        fio_http_multipart_free(p);
+        FIO_ASSERT(out && !strcmp(out, tests[i][1]),
+                   "multipart parts cut short should end with an error (%zu):"
+                   "\n%s",
+                   i,
+                   out);
+        fio_bstr_free(out);
+      }
+    }
+    { /* streaming the body of an HTTP handle (part of it received earlier) */
+      char *out = NULL;
+      fio_http_s *h = fio_http_new();
+      fio_http_request_header_set(h,
+                                  FIO_STR_INFO1((char *)"content-type"),
+                                  content_type);
+      fio_http_body_write(h, body, 30);
+      FIO_ASSERT(fio_http_body_multipart(
+                     h,
+                     .on_part = fio___test_http_multipart_on_part,
+                     .on_data = fio___test_http_multipart_on_data,
+                     .on_part_end = fio___test_http_multipart_on_part_end,
+                     .udata = &out),
+                 "fio_http_body_multipart failed");
+      FIO_ASSERT(!fio_http_body_multipart(h, .udata = NULL),
+                 "fio_http_body_multipart should only attach a single parser");
+      FIO_ASSERT(!fio_http_body_write(h, body + 30, body_len - 30),
+                 "fio_http_body_write should report a valid multipart body");
+      FIO_ASSERT(fio_http_body_length(h) == body_len &&
+                     !fio_http_body_read(h, 16).len,
+                 "streamed body shouldn't be stored");
+      FIO_ASSERT(out && !strcmp(out, expected),
+                 "fio_http_body_multipart output error:\n%s",
+                 out);
+      fio_bstr_free(out);
+      fio_http_free(h);
+      h = fio_http_new();
+      fio_http_request_header_set(h,
+                                  FIO_STR_INFO1((char *)"content-type"),
+                                  content_type);
+      FIO_ASSERT(fio_http_body_multipart(h, .udata = NULL),
+                 "fio_http_body_multipart failed");
+      FIO_ASSERT(fio_http_body_write(h, "--xyz123x", 9) == -1,
+                 "fio_http_body_write should report multipart errors");
+      fio_http_free(h);
+    }
+  }
+}
+
+/* *****************************************************************************
+Cleanup
+***************************************************************************** */
+#endif /* FIO_TEST_ALL */
+/* ************************************************************************* */
+#if !defined(FIO_INCLUDE_FILE) /* Dev test - ignore line */
+#define FIO___DEV___           /* Development inclusion - ignore line */
+#define FIO_TEST_ALL           /* Development inclusion - ignore line */
+#include "./include.h"         /* Development inclusion - ignore line */
+#endif                         /* Development inclusion - ignore line */
+/* *****************************************************************************
+
+
+
+
+                        HTTP Router Test Helper
+
+
+
+
+Copyright and License: see header file (000 copyright.h) or top of file
+***************************************************************************** */
+#if defined(FIO_TEST_ALL) && !defined(FIO___TEST_REINCLUDE) &&                 \
+    !defined(H___FIO_HTTP_ROUTER_TEST___H) && defined(H___FIO_HTTP_ROUTER___H)
+#define H___FIO_HTTP_ROUTER_TEST___H
+
+/* route handlers are told apart using their `udata` */
+FIO_SFUNC void fio___test_http_router_task(fio_http_s *h,
+                                           fio_http_route_s *route) {
+  fio_http_udata_set(h, route->udata);
+}
+
+FIO_SFUNC void FIO_NAME_TEST(stl, http_router)(void) {
+  fprintf(stderr, "* Testing HTTP router (fio_http_router_s).\n");
+  struct {
+    const char *method;
+    const char *path;
+    uintptr_t id;
+  } routes[] = {
+      {NULL, "/", 1},
+      {"GET", "/users", 2},
+      {"GET", "/users/:id", 3},
+      {"PUT", "/users/:id", 4},
+      {"GET", "/users/me", 5},
+      {"GET", "/users/:id/posts/:post", 6},
+      {NULL, "/files/*path", 7},
+      {"GET", "/files/index.html", 8},
+      {"GET", "/user", 9},
+      {"POST", "/users", 10},
+      {"GET", "/a:b/:c", 11},
+      {"GET", "/*all", 12},
+      {NULL, NULL, 0},
+  };
+  struct {
+    const char *method;
+    const char *path;
+    int result;
+    uintptr_t id;
+    const char *param[4]; /* name, value pairs */
+  } tests[] = {
+      {"GET", "/", 0, 1, {NULL}},
+      {"DELETE", "/", 0, 1, {NULL}},
+      {"GET", "/users", 0, 2, {NULL}},
+      {"HEAD", "/users", 0, 2, {NULL}},
+      {"POST", "/users", 0, 10, {NULL}},
+      {"DELETE", "/users", 405, 0, {NULL}},
+      {"GET", "/user", 0, 9, {NULL}},
+      {"GET", "/users/me", 0, 5, {NULL}},
+      {"PUT", "/users/me", 0, 4, {"id", "me"}},
+      {"GET", "/users/42", 0, 3, {"id", "42"}},
+      {"PUT", "/users/42", 0, 4, {"id", "42"}},
+      {"DELETE", "/users/42", 405, 0, {NULL}},
+      {"GET", "/users/42/posts/7", 0, 6, {"id", "42", "post", "7"}},
+      {"GET", "/users/me/posts/7", 0, 6, {"id", "me", "post", "7"}},
+      {"GET", "/files/", 0, 7, {"path", ""}},
+      {"GET", "/files/a/b.txt", 0, 7, {"path", "a/b.txt"}},
+      {"GET", "/files/index.html", 0, 8, {NULL}},
+      {"POST", "/files/index.html", 0, 7, {"path", "index.html"}},
+      {"POST", "/nothing", 405, 0, {NULL}},
+      {"GET", "/a:b/c", 0, 11, {"c", "c"}},
+      {"GET", "/users/", 0, 12, {"all", "users/"}},
+      {"GET", "/usersx", 0, 12, {"all", "usersx"}},
+      {"GET", "/nothing/here", 0, 12, {"all", "nothing/here"}},
+      {NULL, NULL, 0, 0, {NULL}},
+  };
+  fio_http_router_s *r = fio_http_router_new(.on_not_found = NULL);
+  fio_http_route_s route;
+  FIO_ASSERT(r, "fio_http_router_new failed");
+  FIO_ASSERT(fio_http_router_find(r,
+                                  &route,
+                                  FIO_STR_INFO1((char *)"GET"),
+                                  FIO_STR_INFO1((char *)"/")) == 404,
+             "empty router should return 404");
+  for (size_t i = 0; routes[i].path; ++i) {
+    FIO_ASSERT(!fio_http_route(r,
+                               .method = routes[i].method,
+                               .path = routes[i].path,
+                               .on_http = fio___test_http_router_task,
+                               .udata = (void *)routes[i].id),
+               "fio_http_route failed for %s",
+               routes[i].path);
+  }
+  /* the router logs errors for invalid routes */
+  int log_level = FIO_LOG_LEVEL_GET();
+  FIO_LOG_LEVEL_SET(FIO_LOG_LEVEL_NONE);
+  FIO_ASSERT(fio_http_route(r,
+                            .path = "/users/:name/x",
+                            .on_http = fio___test_http_router_task) == -1,
+             "parameter name conflicts should fail");
+  FIO_ASSERT(fio_http_route(r,
+                            .path = "/x/*rest/more",
+                            .on_http = fio___test_http_router_task) == -1,
+             "wildcards must be the last segment");
+  FIO_ASSERT(fio_http_route(r,
+                            .path = "/x/:/y",
+                            .on_http = fio___test_http_router_task) == -1,
+             "parameters must be named");
+  FIO_LOG_LEVEL_SET(log_level);
+
+  for (size_t i = 0; tests[i].path; ++i) {
+    int result = fio_http_router_find(r,
+                                      &route,
+                                      FIO_STR_INFO1((char *)tests[i].method),
+                                      FIO_STR_INFO1((char *)tests[i].path));
+    size_t count = 0;
+    FIO_ASSERT(result == tests[i].result,
+               "router result error for %s %s (%d != %d)",
+               tests[i].method,
+               tests[i].path,
+               result,
+               tests[i].result);
+    if (result)
+      continue;
+    FIO_ASSERT(route.udata == (void *)tests[i].id,
+               "router matched the wrong route for %s %s (%zu != %zu)",
+               tests[i].method,
+               tests[i].path,
+               (size_t)(uintptr_t)route.udata,
+               (size_t)tests[i].id);
+    for (; count < 2 && tests[i].param[count << 1]; ++count) {
+      fio_str_info_s v = fio_http_route_param(
+          &route,
+          FIO_STR_INFO1((char *)tests[i].param[count << 1]));
+      fio_str_info_s expected =
+          FIO_STR_INFO1((char *)tests[i].param[(count << 1) + 1]);
+      FIO_ASSERT(v.buf && FIO_STR_INFO_IS_EQ(v, expected),
+                 "router parameter error for %s (%s = %.*s)",
+                 tests[i].path,
+                 tests[i].param[count << 1],
+                 (int)v.len,
+                 v.buf);
+    }
+    FIO_ASSERT(route.count == count,
+               "router parameter count error for %s (%zu != %zu)",
+               tests[i].path,
+               route.count,
+               count);
+  }
+  FIO_ASSERT(!fio_http_route_param(&route, FIO_STR_INFO1((char *)"missing"))
+                  .buf,
+             "missing route parameters should be NULL");
+
+  { /* routes added after compilation, dispatching */
+    fio_http_s *h = fio_http_new();
+    FIO_ASSERT(!fio_http_route(r,
+                               .method = "GET",
+                               .path = "/late/:x",
+                               .on_http = fio___test_http_router_task,
+                               .udata = (void *)(uintptr_t)13),
+               "fio_http_route failed after compilation");
+    fio_http_method_set(h, FIO_STR_INFO1((char *)"GET"));
+    fio_http_path_set(h, FIO_STR_INFO1((char *)"/late/1"));
+    FIO_ASSERT(!fio_http_router_dispatch(r, h) &&
+                   fio_http_udata(h) == (void *)(uintptr_t)13,
+               "fio_http_router_dispatch failed");
+    fio_http_free(h);
+  }
+  fio_http_router_free(r);
+}
+
+/* *****************************************************************************
+Cleanup
+***************************************************************************** */
+#endif /* FIO_TEST_ALL */
+/* ************************************************************************* */
+#if !defined(FIO_INCLUDE_FILE) /* Dev test - ignore line */
+#define FIO___DEV___           /* Development inclusion - ignore line */
+#define FIO_TEST_ALL           /* Development inclusion - ignore line */
+#include "./include.h"         /* Development inclusion - ignore line */
+#endif                         /* Development inclusion - ignore line */
+/* *****************************************************************************
+
+
+
+
+      HTTP/2 (HPACK), WebSocket, HTTP Compression and Client Pool Tests
+
+
+
+
+Copyright and License: see header file (000 copyright.h) or top of file
+***************************************************************************** */
+#if defined(FIO_TEST_ALL) && !defined(FIO___TEST_REINCLUDE) &&                 \
+    !defined(H___FIO_HTTP2_TEST___H)
+#define H___FIO_HTTP2_TEST___H
+
+typedef struct {
+  char buf[512];
+  size_t len;
+} fio___test_hpack_s;
+
+/* collects decoded headers as "name: value\n" */
+FIO_SFUNC int fio___test_hpack_on_header(void *udata,
+                                         fio_str_info_s name,
+                                         fio_str_info_s value) {
+  fio___test_hpack_s *t = (fio___test_hpack_s *)udata;
+  FIO_ASSERT(t->len + name.len + value.len + 3 < sizeof(t->buf),
+             "HPACK test buffer overflow");
+  FIO_MEMCPY(t->buf + t->len, name.buf, name.len);
+  t->len += name.len;
+  t->buf[t->len++] = ':';
+  t->buf[t->len++] = ' ';
+  if (value.len)
+    FIO_MEMCPY(t->buf + t->len, value.buf, value.len);
+  t->len += value.len;
+  t->buf[t->len++] = '\n';
+  t->buf[t->len] = 0;
+  return 0;
+}
+
+FIO_SFUNC void FIO_NAME_TEST(stl, hpack)(void) {
+  fprintf(stderr, "* Testing HTTP/2 HPACK header compression (RFC 7541).\n");
+  { /* Huffman round-trip, all byte values */
+    uint8_t src[256], enc[1024];
+    char dec[512];
+    size_t dlen = 0;
+    for (size_t i = 0; i < 256; ++i)
+      src[i] = (uint8_t)i;
+    size_t elen = fio___hpack_huff_encode(enc, src, 256);
+    FIO_ASSERT(elen == fio___hpack_huff_length(src, 256),
+               "HPACK Huffman length error");
+    FIO_ASSERT(!fio___hpack_huff_decode(dec, &dlen, enc, elen) &&
+                   dlen == 256 && !FIO_MEMCMP(dec, src, 256),
+               "HPACK Huffman round-trip error");
+    /* padding longer than 7 bits (a full byte of ones) must fail */
+    enc[elen] = 0xFF;
+    FIO_ASSERT(fio___hpack_huff_decode(dec, &dlen, enc, elen + 1),
+               "HPACK Huffman padding > 7 bits should fail");
+  }
+  { /* integer encoding (RFC 7541, Appendix C.1) */
+    uint8_t buf[8];
+    const uint8_t *pos = buf;
+    uint64_t i = 0;
+    FIO_ASSERT(fio___hpack_int_write(buf, 10, 5, 0) == 1 && buf[0] == 10,
+               "HPACK integer (C.1.1) error");
+    FIO_ASSERT(fio___hpack_int_write(buf, 1337, 5, 0) == 3 && buf[0] == 31 &&
+                   buf[1] == 154 && buf[2] == 10,
+               "HPACK integer (C.1.2) error");
+    FIO_ASSERT(!fio___hpack_int_read(&i, &pos, buf + 3, 5) && i == 1337 &&
+                   pos == buf + 3,
+               "HPACK integer (C.1.2) decoding error");
+    pos = buf;
+    FIO_ASSERT(fio___hpack_int_read(&i, &pos, buf + 2, 5),
+               "HPACK truncated integer should fail");
+  }
+  { /* request examples with Huffman coding (RFC 7541, Appendix C.4) */
+    static const char *blocks[] = {
+        "\x82\x86\x84\x41\x8c\xf1\xe3\xc2\xe5\xf2\x3a\x6b\xa0\xab\x90\xf4\xff",
+        "\x82\x86\x84\xbe\x58\x86\xa8\xeb\x10\x64\x9c\xbf",
+        "\x82\x87\x85\xbf\x40\x88\x25\xa8\x49\xe9\x5b\xa9\x7d\x7f\x89\x25\xa8"
+        "\x49\xe9\x5b\xb8\xe8\xb4\xbf",
+    };
+    static const size_t lengths[] = {17, 12, 24};
+    static const char *expected[] = {
+        ":method: GET\n:scheme: http\n:path: /\n"
+        ":authority: www.example.com\n",
+        ":method: GET\n:scheme: http\n:path: /\n"
+        ":authority: www.example.com\ncache-control: no-cache\n",
+        ":method: GET\n:scheme: https\n:path: /index.html\n"
+        ":authority: www.example.com\ncustom-key: custom-value\n",
+    };
+    fio___hpack_table_s t = {.max = 4096};
+    for (size_t i = 0; i < 3; ++i) {
+      fio___test_hpack_s r = {{0}};
+      FIO_ASSERT(!fio___hpack_decode(&t,
+                                     FIO_BUF_INFO2((char *)blocks[i],
+                                                   lengths[i]),
+                                     fio___test_hpack_on_header,
+                                     &r),
+                 "HPACK decoding failed (C.4.%zu)",
+                 i + 1);
+      FIO_ASSERT(!strcmp(r.buf, expected[i]),
+                 "HPACK decoding error (C.4.%zu):\n%s",
+                 i + 1,
+                 r.buf);
+    }
+    FIO_ASSERT(t.count == 3 && t.size == 164,
+               "HPACK dynamic table state error (C.4.3)");
+    /* an index beyond the dynamic table is a compression error */
+    FIO_ASSERT(fio___hpack_decode(&t,
+                                  FIO_BUF_INFO2((char *)"\xc1", 1),
+                                  fio___test_hpack_on_header,
+                                  NULL) == -1,
+               "HPACK invalid index should fail");
+    /* a size update after the first field is a compression error */
+    FIO_ASSERT(fio___hpack_decode(&t,
+                                  FIO_BUF_INFO2((char *)"\x82\x20", 2),
+                                  fio___test_hpack_on_header,
+                                  &(fio___test_hpack_s){{0}}) == -1,
+               "HPACK late table size update should fail");
+    fio___hpack_table_destroy(&t);
+  }
+  { /* encoder / decoder round-trip with eviction (small table) */
+    fio___hpack_table_s enc = {.max = 128}, dec = {.max = 128};
+    char *block = NULL;
+    for (size_t round = 0; round < 64; ++round) {
+      char value[32];
+      fio___test_hpack_s r = {{0}};
+      char expected[128];
+      size_t vlen = (size_t)snprintf(value, sizeof(value), "value-%zu", round);
+      if (block)
+        block = fio_bstr_len_set(block, 0);
+      block = fio___hpack_encode(&enc,
+                                 block,
+                                 FIO_STR_INFO2((char *)":status", 7),
+                                 FIO_STR_INFO2((char *)"200", 3),
+                                 FIO___HPACK_INDEX);
+      block = fio___hpack_encode(&enc,
+                                 block,
+                                 FIO_STR_INFO2((char *)"x-round", 7),
+                                 FIO_STR_INFO2(value, vlen),
+                                 FIO___HPACK_INDEX);
+      block = fio___hpack_encode(&enc,
+                                 block,
+                                 FIO_STR_INFO2((char *)"x-same", 6),
+                                 FIO_STR_INFO2((char *)"same", 4),
+                                 FIO___HPACK_INDEX);
+      block = fio___hpack_encode(&enc,
+                                 block,
+                                 FIO_STR_INFO2((char *)"set-cookie", 10),
+                                 FIO_STR_INFO2((char *)"id=1", 4),
+                                 FIO___HPACK_NEVER_INDEX);
+      FIO_ASSERT(!fio___hpack_decode(&dec,
+                                     fio_bstr_buf(block),
+                                     fio___test_hpack_on_header,
+                                     &r),
+                 "HPACK round-trip decoding failed (round %zu)",
+                 round);
+      snprintf(expected,
+               sizeof(expected),
+               ":status: 200\nx-round: %s\nx-same: same\nset-cookie: id=1\n",
+               value);
+      FIO_ASSERT(!strcmp(r.buf, expected),
+                 "HPACK round-trip error (round %zu):\n%s",
+                 round,
+                 r.buf);
+      FIO_ASSERT(enc.size == dec.size && enc.count == dec.count &&
+                     enc.size <= 128,
+                 "HPACK encoder / decoder tables out of sync");
+    }
+    fio_bstr_free(block);
+    fio___hpack_table_destroy(&enc);
+    fio___hpack_table_destroy(&dec);
+  }
+  { /* header blocks for closed streams must still update the HPACK table */
+    fio___hpack_table_s enc = {.max = FIO___HTTP2_HPACK_MAX};
+    fio___http2_s *s = fio___http2_new(0);
+    char *block = NULL;
+    FIO_ASSERT_ALLOC(s);
+    *s = (fio___http2_s){.dec = {.max = FIO___HTTP2_HPACK_MAX}, .last_id = 5};
+    s->active = FIO_LIST_INIT(s->active);
+    block = fio___hpack_encode(&enc,
+                               block,
+                               FIO_STR_INFO2((char *)"x-closed", 8),
+                               FIO_STR_INFO2((char *)"stream", 6),
+                               FIO___HPACK_INDEX);
+    fio___http2_on_header_block(s, 3, fio_bstr_buf(block), 1);
+    FIO_ASSERT(!s->error && s->dec.count == enc.count &&
+                   s->dec.size == enc.size,
+               "HTTP/2 HEADERS on a closed stream should update HPACK state");
+    FIO_ASSERT(fio_bstr_len(s->wbuf) == 13 &&
+                   s->wbuf[3] == FIO___HTTP2_FRAME_RST_STREAM &&
+                   fio_buf2u32_be(s->wbuf + 5) == 3 &&
+                   fio_buf2u32_be(s->wbuf + 9) == FIO___HTTP2_STREAM_CLOSED,
+               "HTTP/2 HEADERS on a closed stream should reset the stream");
+    fio_bstr_free(block);
+    fio___hpack_table_destroy(&enc);
+    fio___http2_free(s);
+  }
+}
+
+FIO_SFUNC void FIO_NAME_TEST(stl, websocket_deflate)(void) {
+  fprintf(stderr, "* Testing WebSocket permessage-deflate (RFC 7692).\n");
+#if HAVE_ZLIB
+  { /* extension negotiation */
+    static const struct {
+      const char *offer;
+      const char *response;
+    } examples[] = {
+        {"permessage-deflate", "permessage-deflate"},
+        {"permessage-deflate; client_max_window_bits",
+         "permessage-deflate; client_max_window_bits=12"},
+        {"x-webkit-deflate-frame, permessage-deflate; "
+         "server_max_window_bits=10; client_max_window_bits=\"9\"",
+         "permessage-deflate; server_max_window_bits=10; "
+         "client_max_window_bits=9"},
+        {"permessage-deflate; server_no_context_takeover",
+         "permessage-deflate; server_no_context_takeover"},
+        {"permessage-deflate; server_max_window_bits=8, permessage-deflate",
+         "permessage-deflate"},
+        {"permessage-deflate; server_max_window_bits", NULL},
+        {"permessage-deflate; client_max_window_bits=16", NULL},
+        {"permessage-deflate; unknown_parameter", NULL},
+        {"permessage-deflate; server_no_context_takeover; "
+         "server_no_context_takeover",
+         NULL},
+        {NULL, NULL},
+    };
+    fio_http_settings_s s = {.ws_deflate = 12};
+    for (size_t i = 0; examples[i].offer; ++i) {
+      fio_http_s *h = fio_http_new();
+      fio_http_request_header_add(
+          h,
+          FIO_STR_INFO2((char *)"sec-websocket-extensions", 24),
+          FIO_STR_INFO1((char *)examples[i].offer));
+      fio___http_ws_deflate_negotiate(h, &s);
+      fio_str_info_s r = fio_http_response_header(
+          h,
+          FIO_STR_INFO2((char *)"sec-websocket-extensions", 24),
+          0);
+      FIO_ASSERT((!r.len && !examples[i].response) ||
+                     (examples[i].response &&
+                      FIO_STR_INFO_IS_EQ(
+                          r,
+                          FIO_STR_INFO1((char *)examples[i].response))),
+                 "permessage-deflate negotiation error for:\n\t%s\n\t%s",
+                 examples[i].offer,
+                 (r.len ? r.buf : "(declined)"));
+      fio_http_free(h);
+    }
+  }
+  { /* compression round-trip, with and without context takeover */
+    char msg[1000];
+    for (size_t i = 0; i < sizeof(msg); ++i)
+      msg[i] = "{\"symbol\":\"AAPL\",\"bid\":189.25,\"ask\":189.27}"[i % 43];
+    for (size_t reset = 0; reset < 2; ++reset) {
+      fio___http_zstream_s *tx = fio___http_zstream_new(0, 15);
+      fio___http_zstream_s *rx = fio___http_zstream_new(1, 15);
+      size_t first = 0;
+      FIO_ASSERT(tx && rx, "zlib stream allocation failed");
+      for (size_t round = 0; round < 4; ++round) {
+        char *frame = fio___http_ws_deflate_frame(&tx->z, msg, 1000, 1, 0);
+        FIO_ASSERT(frame && (uint8_t)frame[0] == 0xC1 && frame[1] < 126,
+                   "compressed frame header error (FIN | RSV1 | text)");
+        fio_buf_info_s payload = FIO_BUF_INFO2(frame + 2, (size_t)frame[1]);
+        char *out = fio___http_ws_inflate(&rx->z, payload, 1000);
+        FIO_ASSERT(out && fio_bstr_len(out) == 1000 &&
+                       !FIO_MEMCMP(out, msg, 1000),
+                   "permessage-deflate round-trip error (%zu)",
+                   round);
+        if (!round)
+          first = payload.len;
+        FIO_ASSERT((reset ? payload.len == first : payload.len < first) ||
+                       !round,
+                   "permessage-deflate context takeover error");
+        fio_bstr_free(out);
+        fio_bstr_free(frame);
+        if (reset) {
+          deflateReset(&tx->z);
+          inflateReset(&rx->z);
+        }
+      }
+      fio___http_zstream_free(tx);
+      fio___http_zstream_free(rx);
+    }
+    { /* decompression limits (ws_max_msg_size) */
+      fio___http_zstream_s *tx = fio___http_zstream_new(0, 9);
+      fio___http_zstream_s *rx = fio___http_zstream_new(1, 9);
+      char *frame = fio___http_ws_deflate_frame(&tx->z, msg, 1000, 2, 0);
+      FIO_ASSERT(frame && !fio___http_ws_inflate(
+                              &rx->z,
+                              FIO_BUF_INFO2(frame + 2, (size_t)frame[1]),
+                              999),
+                 "permessage-deflate decompression limit ignored");
+      fio_bstr_free(frame);
+      fio___http_zstream_free(tx);
+      fio___http_zstream_free(rx);
+    }
+  }
+#else
+  fprintf(stderr, "\t- skipped (requires zlib / HAVE_ZLIB).\n");
+#endif /* HAVE_ZLIB */
+}
+
+FIO_SFUNC void FIO_NAME_TEST(stl, http_compress)(void) {
+  fprintf(stderr, "* Testing HTTP response compression (gzip / brotli).\n");
+#if HAVE_ZLIB || HAVE_BROTLI
+  { /* content encoding negotiation */
+    static const struct {
+      const char *accept;
+      uint8_t gzip;
+      uint8_t br;
+    } examples[] = {
+        {"gzip, deflate", FIO___HTTP_ZIP_GZIP, FIO___HTTP_ZIP_GZIP},
+        {"gzip, deflate, br", FIO___HTTP_ZIP_GZIP, FIO___HTTP_ZIP_BR},
+        {"br;q=0, gzip;q=0.5", FIO___HTTP_ZIP_GZIP, FIO___HTTP_ZIP_GZIP},
+        {"gzip;q=0.0, br;q=0.1", 0, FIO___HTTP_ZIP_BR},
+        {"identity", 0, 0},
+        {"br", 0, FIO___HTTP_ZIP_BR},
+        {NULL, 0, 0},
+    };
+    for (size_t i = 0; examples[i].accept; ++i) {
+      fio_http_s *h = fio_http_new();
+#if HAVE_BROTLI
+      uint8_t expected = examples[i].br;
+#else
+      uint8_t expected = examples[i].gzip;
+#endif
+#if !HAVE_ZLIB
+      if (expected == FIO___HTTP_ZIP_GZIP)
+        expected = 0;
+#endif
+      fio_http_request_header_add(h,
+                                  FIO_STR_INFO2((char *)"accept-encoding", 15),
+                                  FIO_STR_INFO1((char *)examples[i].accept));
+      FIO_ASSERT(fio___http_zip_accepted(h) == expected,
+                 "accept-encoding negotiation error for: %s",
+                 examples[i].accept);
+      fio_http_free(h);
+    }
+    FIO_ASSERT(fio___http_zip_is_text(FIO_STR_INFO1((char *)"text/html")) &&
+                   fio___http_zip_is_text(FIO_STR_INFO1(
+                       (char *)"application/json; charset=utf-8")) &&
+                   fio___http_zip_is_text(
+                       FIO_STR_INFO1((char *)"image/svg+xml")) &&
+                   !fio___http_zip_is_text(
+                       FIO_STR_INFO1((char *)"image/png")) &&
+                   !fio___http_zip_is_text(FIO_STR_INFO0),
+               "compressible content type detection error");
+  }
+  { /* `vary` and `etag` headers of compressible responses */
+    fio_http_settings_s settings = {.compress = 6, .compress_min = 100};
+    fio___http_connection_s c = {.settings = &settings};
+    fio_http_s *h = fio_http_new();
+    fio_http_status_set(h, 200);
+    fio_http_response_header_set(h,
+                                 FIO_STR_INFO2((char *)"content-type", 12),
+                                 FIO_STR_INFO2((char *)"text/html", 9));
+    fio_http_response_header_set(h,
+                                 FIO_STR_INFO2((char *)"content-length", 14),
+                                 FIO_STR_INFO2((char *)"1000", 4));
+    fio_http_response_header_set(h,
+                                 FIO_STR_INFO2((char *)"etag", 4),
+                                 FIO_STR_INFO2((char *)"\"abc\"", 5));
+    FIO_ASSERT(!fio___http_zip_start(&c, h) && !c.state.http.zip_type,
+               "response compressed without accept-encoding");
+    FIO_ASSERT(FIO_STR_INFO_IS_EQ(
+                   fio_http_response_header(h,
+                                            FIO_STR_INFO2((char *)"vary", 4),
+                                            0),
+                   FIO_STR_INFO2((char *)"accept-encoding", 15)),
+               "compressible response missing `vary: accept-encoding`");
+    fio___http_zip_etag(h);
+    fio___http_zip_etag(h);
+    FIO_ASSERT(FIO_STR_INFO_IS_EQ(
+                   fio_http_response_header(h,
+                                            FIO_STR_INFO2((char *)"etag", 4),
+                                            0),
+                   FIO_STR_INFO2((char *)"W/\"abc\"", 7)),
+               "compressed response `etag` should be weak");
+    fio_http_method_set(h, FIO_STR_INFO2((char *)"GET", 3));
+    fio_http_request_header_set(h,
+                                FIO_STR_INFO2((char *)"if-none-match", 13),
+                                FIO_STR_INFO2((char *)"W/\"abc\"", 7));
+    FIO_ASSERT(fio_http_etag_is_match(h),
+               "weak `if-none-match` should match a weakened `etag`");
+    fio_http_free(h);
+  }
+  { /* compression - a complete body and a streamed body */
+    char msg[4000];
+    for (size_t i = 0; i < sizeof(msg); ++i)
+      msg[i] = "{\"symbol\":\"AAPL\",\"bid\":189.25,\"ask\":189.27}"[i % 43];
+    for (uint8_t type = 1; type < 3; ++type) {
+      char *out[5] = {NULL};
+      size_t total = 0;
+      void *zip = fio___http_zip_new(type, 6, sizeof(msg));
+      if (!zip)
+        continue; /* not supported by this build */
+      out[0] = fio___http_zip(type, zip, msg, sizeof(msg), 1);
+      fio___http_zip_free(type, zip);
+      FIO_ASSERT(fio_bstr_len(out[0]) && fio_bstr_len(out[0]) < 400,
+                 "HTTP compression error (%s)",
+                 (type == FIO___HTTP_ZIP_GZIP ? "gzip" : "br"));
+      zip = fio___http_zip_new(type, 6, 0);
+      for (size_t i = 1; i < 4; ++i) {
+        out[i] = fio___http_zip(type, zip, msg + ((i - 1) * 1000), 1000, 0);
+        FIO_ASSERT(fio_bstr_len(out[i]), "streaming compression - no flush");
+      }
+      out[4] = fio___http_zip(type, zip, NULL, 0, 1);
+      fio___http_zip_free(type, zip);
+#if HAVE_ZLIB
+      if (type == FIO___HTTP_ZIP_GZIP) { /* decompress both */
+        char dec[8192];
+        for (size_t round = 0; round < 2; ++round) {
+          z_stream z;
+          FIO_MEMSET(&z, 0, sizeof(z));
+          FIO_ASSERT(inflateInit2(&z, 31) == Z_OK, "inflateInit2 failed");
+          z.next_out = (Bytef *)dec;
+          z.avail_out = sizeof(dec);
+          for (size_t i = (round ? 1 : 0); i < (round ? 5U : 1U); ++i) {
+            z.next_in = (Bytef *)out[i];
+            z.avail_in = (uInt)fio_bstr_len(out[i]);
+            inflate(&z, Z_SYNC_FLUSH);
+          }
+          total = sizeof(dec) - z.avail_out;
+          inflateEnd(&z);
+          FIO_ASSERT(total == (round ? 3000U : sizeof(msg)) &&
+                         !FIO_MEMCMP(dec, msg, total),
+                     "gzip round-trip error (%s)",
+                     (round ? "streaming" : "complete"));
+        }
+      }
+#endif
+      for (size_t i = 0; i < 5; ++i)
+        fio_bstr_free(out[i]);
+      (void)total;
+    }
+  }
+#else
+  fprintf(stderr, "\t- skipped (requires zlib or brotli).\n");
+#endif /* HAVE_ZLIB || HAVE_BROTLI */
+}
+
+/* *****************************************************************************
+HTTP Client Connection Pool Tests (a local server and client, in one reactor)
+***************************************************************************** */
+
+#define FIO___TEST_HTTP_POOL_URL "http://127.0.0.1:9761/"
+
+static struct {
+  fio___http_pool_s *pool;
+  fio_io_s *server[8]; /* server side connections (NULL once released) */
+  size_t server_count; /* connections accepted by the server */
+  size_t sent;
+  size_t finished;
+  int64_t deadline;
+  uint8_t stage;
+} FIO___TEST_HTTP_POOL;
+
+/* server side: records the connection and responds. */
+FIO_SFUNC void fio___test_http_pool_on_request(fio_http_s *h) {
+  fio_io_s *io = fio_http_io(h);
+  size_t i = 0;
+  while (i < FIO___TEST_HTTP_POOL.server_count &&
+         FIO___TEST_HTTP_POOL.server[i] != io)
+    ++i;
+  if (i == FIO___TEST_HTTP_POOL.server_count) {
+    FIO_ASSERT(i < 8, "HTTP pool test: too many server connections");
+    FIO___TEST_HTTP_POOL.server[i] = fio_io_dup(io);
+    ++FIO___TEST_HTTP_POOL.server_count;
+  }
+  fio_http_write(h, .buf = (char *)"pool", .len = 4, .finish = 1);
+}
+
+/* client side: validates the response and the pool's connection limit. */
+FIO_SFUNC void fio___test_http_pool_on_response(fio_http_s *h) {
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  FIO___TEST_HTTP_POOL.pool = c->state.http.pool;
+  FIO_ASSERT(fio_http_status(h) == 200 && fio_http_body_length(h) == 4,
+             "HTTP pool test: bad response");
+  FIO_ASSERT(c->state.http.pool && c->state.http.pool->open <= 2,
+             "HTTP pool test: pool_max exceeded (%u connections)",
+             (unsigned)(c->state.http.pool ? c->state.http.pool->open : 0));
+}
+
+FIO_SFUNC void fio___test_http_pool_on_finish(fio_http_s *h) {
+  FIO_ASSERT(fio_http_status(h), "HTTP pool test: request failed");
+  ++FIO___TEST_HTTP_POOL.finished;
+}
+
+FIO_SFUNC void fio___test_http_pool_send(size_t count) {
+  while (count--) {
+    ++FIO___TEST_HTTP_POOL.sent;
+    fio_http_connect(FIO___TEST_HTTP_POOL_URL,
+                     NULL,
+                     .on_http = fio___test_http_pool_on_response,
+                     .on_finish = fio___test_http_pool_on_finish,
+                     .pool_max = 2,
+                     .pool_max_idle = 1);
+  }
+}
+
+/* releases the server side connections (held connections delay shutdown) */
+FIO_SFUNC void fio___test_http_pool_server_release(int close) {
+  for (size_t i = 0; i < FIO___TEST_HTTP_POOL.server_count; ++i) {
+    if (!FIO___TEST_HTTP_POOL.server[i])
+      continue;
+    if (close)
+      fio_io_close(FIO___TEST_HTTP_POOL.server[i]);
+    fio_io_free(FIO___TEST_HTTP_POOL.server[i]);
+    FIO___TEST_HTTP_POOL.server[i] = NULL;
+  }
+}
+
+/* advances the test once the previous stage settled (a timer task). */
+FIO_SFUNC int fio___test_http_pool_step(void *ignr_1, void *ignr_2) {
+  fio___http_pool_s *pool = FIO___TEST_HTTP_POOL.pool;
+  (void)ignr_1, (void)ignr_2;
+  FIO_ASSERT(fio_time_milli() < FIO___TEST_HTTP_POOL.deadline,
+             "HTTP pool test timed out (stage %d)",
+             (int)FIO___TEST_HTTP_POOL.stage);
+  if (FIO___TEST_HTTP_POOL.finished < FIO___TEST_HTTP_POOL.sent)
+    return 0;
+  switch (FIO___TEST_HTTP_POOL.stage) {
+  case 0: /* reuse: sequential requests share a single connection */
+    if (FIO___TEST_HTTP_POOL.sent) {
+      if (pool->idle_count != 1)
+        return 0;
+      FIO_ASSERT(pool->open == 1 && FIO___TEST_HTTP_POOL.server_count == 1,
+                 "HTTP pool test: idle connection not reused");
+    }
+    if (FIO___TEST_HTTP_POOL.sent < 4) {
+      fio___test_http_pool_send(1);
+      return 0;
+    }
+    ++FIO___TEST_HTTP_POOL.stage;
+    /* limits: at most `pool_max` connections, the rest are queued */
+    fio___test_http_pool_send(6);
+    {
+      size_t queued = 0;
+      FIO_LIST_EACH(fio___http_pool_req_s, node, &pool->queue, r) {
+        ++queued;
+        (void)r;
+      }
+      FIO_ASSERT(pool->open == 2 && queued == 4 && !pool->idle_count,
+                 "HTTP pool test: pool_max should queue requests (%u, %zu)",
+                 (unsigned)pool->open,
+                 queued);
+    }
+    return 0;
+  case 1: /* `pool_max_idle` closes the connections it can't keep */
+    if (pool->open != 1)
+      return 0;
+    FIO_ASSERT(pool->idle_count == 1 &&
+                   FIO___TEST_HTTP_POOL.server_count == 2,
+               "HTTP pool test: pool_max_idle error");
+    ++FIO___TEST_HTTP_POOL.stage;
+    /* idle eviction: the server closes the idle connection */
+    fio___test_http_pool_server_release(1);
+    return 0;
+  case 2:
+    if (pool->open || pool->idle_count)
+      return 0;
+    ++FIO___TEST_HTTP_POOL.stage;
+    fio___test_http_pool_send(1); /* a new connection replaces the evicted */
+    return 0;
+  case 3:
+    if (pool->idle_count != 1)
+      return 0;
+    FIO_ASSERT(pool->open == 1 && FIO___TEST_HTTP_POOL.server_count == 3,
+               "HTTP pool test: evicted connection reused");
+    ++FIO___TEST_HTTP_POOL.stage;
+    fio___test_http_pool_server_release(0);
+    fio_io_stop();
+    return -1;
+  }
+  return -1;
+}
+
+FIO_SFUNC void fio___test_http_pool_on_start(void *ignr_) {
+  fio_io_run_every(.fn = fio___test_http_pool_step,
+                   .every = 5,
+                   .repetitions = -1);
+  (void)ignr_;
+}
+
+FIO_SFUNC void FIO_NAME_TEST(stl, http_client_pool)(void) {
+  fprintf(stderr, "* Testing HTTP client connection pool.\n");
+  int log_level = FIO_LOG_LEVEL;
+  void *listener;
+  FIO_LOG_LEVEL = FIO_LOG_LEVEL_WARNING;
+  listener = fio_http_listen(FIO___TEST_HTTP_POOL_URL,
+                             .on_http = fio___test_http_pool_on_request);
+  FIO_ASSERT(listener, "HTTP pool test: couldn't listen for connections");
+  FIO___TEST_HTTP_POOL.deadline = fio_time_milli() + 10000;
+  fio_state_callback_add(FIO_CALL_ON_START,
+                         fio___test_http_pool_on_start,
+                         NULL);
+  fio_io_start(0);
+  fio_state_callback_remove(FIO_CALL_ON_START,
+                            fio___test_http_pool_on_start,
+                            NULL);
+  FIO_ASSERT(FIO___TEST_HTTP_POOL.stage == 4,
+             "HTTP pool test: reactor stopped early (stage %d)",
+             (int)FIO___TEST_HTTP_POOL.stage);
+  fio_io_listen_stop(listener);
+  /* pools (and their pub/sub metadata callbacks) otherwise live until exit */
+  fio___http_pool_cleanup(NULL);
+  FIO_LOG_LEVEL = log_level;
+}
+
+/* *****************************************************************************
+HTTP Response Cache Tests (a local server and client, in one reactor)
+***************************************************************************** */
+
+#define FIO___TEST_HTTP_CACHE_URL "http://127.0.0.1:9762/"
+/* a listener without `cache_vary`, so compressed responses can't be cached */
+#define FIO___TEST_HTTP_CACHE_URL_NO_VARY "http://127.0.0.1:9763/"
+#define FIO___TEST_HTTP_CACHE_LIMIT       4096
+/* paths `/0` - `/15` test LRU eviction (they don't all fit in the cache) */
+#define FIO___TEST_HTTP_CACHE_LRU 16
+#if HAVE_ZLIB || HAVE_BROTLI
+#define FIO___TEST_HTTP_CACHE_COMPRESS 1
+#else
+#define FIO___TEST_HTTP_CACHE_COMPRESS 0
+#endif
+
+/* the request path is `/<slot>`, the server responds according to the slot */
+typedef enum {
+  FIO___TEST_HTTP_CACHE_TTL = FIO___TEST_HTTP_CACHE_LRU,
+  FIO___TEST_HTTP_CACHE_COOKIE,
+  FIO___TEST_HTTP_CACHE_NO_STORE,
+  FIO___TEST_HTTP_CACHE_VARY,
+  FIO___TEST_HTTP_CACHE_SLOW, /* answered once more requests wait for it */
+  FIO___TEST_HTTP_CACHE_ZIP,
+  FIO___TEST_HTTP_CACHE_SLOTS,
+} fio___test_http_cache_slot_e;
+
+static struct {
+  fio___http_cache_s *cache; /* the first listener's response cache */
+  fio_http_s *held;          /* the `SLOW` request, until answered */
+  size_t calls[FIO___TEST_HTTP_CACHE_SLOTS]; /* server side `on_http` calls */
+  size_t gen[FIO___TEST_HTTP_CACHE_SLOTS];   /* last `x-gen` the client got */
+  size_t zipped; /* compressed responses received by the client */
+  size_t sent;
+  size_t finished;
+  size_t lru; /* LRU requests sent */
+  int64_t expires;
+  int64_t deadline;
+  uint8_t stage;
+} FIO___TEST_HTTP_CACHE;
+
+FIO_SFUNC size_t fio___test_http_cache_slot(fio_http_s *h) {
+  fio_str_info_s path = fio_http_path(h);
+  char *pos = path.buf + 1;
+  size_t slot = 0;
+  if (path.len > 1)
+    slot = (size_t)fio_atol10u(&pos);
+  FIO_ASSERT(path.len > 1 && slot < FIO___TEST_HTTP_CACHE_SLOTS,
+             "HTTP cache test: unknown path");
+  return slot;
+}
+
+/* responds, `x-gen` counts the times `on_http` was called for the path. */
+FIO_SFUNC void fio___test_http_cache_respond(fio_http_s *h, size_t slot) {
+  char body[256];
+  size_t len = 128; /* shorter than `compress_min` */
+  FIO_STR_INFO_TMP_VAR(gen, 32);
+  fio_string_write_u(&gen, NULL, FIO___TEST_HTTP_CACHE.calls[slot]);
+  fio_http_response_header_set(h, FIO_STR_INFO2((char *)"x-gen", 5), gen);
+  if (slot == FIO___TEST_HTTP_CACHE_ZIP) {
+    len = 256;
+    fio_http_response_header_set(h,
+                                 FIO_STR_INFO2((char *)"content-type", 12),
+                                 FIO_STR_INFO2((char *)"text/plain", 10));
+  }
+  FIO_MEMSET(body, 'a' + (char)(slot & 15), len);
+  fio_http_write(h, .buf = body, .len = len, .copy = 1, .finish = 1);
+}
+
+/* server side: counts `on_http` calls (cached responses skip it). */
+FIO_SFUNC void fio___test_http_cache_on_request(fio_http_s *h) {
+  size_t slot = fio___test_http_cache_slot(h);
+  ++FIO___TEST_HTTP_CACHE.calls[slot];
+  switch ((fio___test_http_cache_slot_e)slot) {
+  case FIO___TEST_HTTP_CACHE_COOKIE:
+    fio_http_cookie_set(h,
+                        .name = FIO_STR_INFO2((char *)"id", 2),
+                        .value = FIO_STR_INFO2((char *)"1", 1));
+    break;
+  case FIO___TEST_HTTP_CACHE_NO_STORE:
+    fio_http_response_header_set(h,
+                                 FIO_STR_INFO2((char *)"cache-control", 13),
+                                 FIO_STR_INFO2((char *)"no-store", 8));
+    break;
+  case FIO___TEST_HTTP_CACHE_VARY:
+    fio_http_response_header_set(h,
+                                 FIO_STR_INFO2((char *)"vary", 4),
+                                 FIO_STR_INFO2((char *)"user-agent", 10));
+    break;
+  case FIO___TEST_HTTP_CACHE_SLOW:
+    FIO_ASSERT(!FIO___TEST_HTTP_CACHE.held,
+               "HTTP cache test: concurrent requests weren't coalesced");
+    FIO___TEST_HTTP_CACHE.held = fio_http_dup(h);
+    return;
+  default: break;
+  }
+  fio___test_http_cache_respond(h, slot);
+}
+
+FIO_SFUNC void fio___test_http_cache_on_request_main(fio_http_s *h) {
+  FIO___TEST_HTTP_CACHE.cache =
+      fio___http_cache((fio___http_connection_s *)fio_http_cdata(h));
+  fio___test_http_cache_on_request(h);
+}
+
+/* client side: records the response's generation and content encoding. */
+FIO_SFUNC void fio___test_http_cache_on_response(fio_http_s *h) {
+  size_t slot = fio___test_http_cache_slot(h);
+  fio_str_info_s gen =
+      fio_http_response_header(h, FIO_STR_INFO2((char *)"x-gen", 5), 0);
+  FIO_ASSERT(fio_http_status(h) == 200 && gen.len,
+             "HTTP cache test: bad response");
+  FIO___TEST_HTTP_CACHE.gen[slot] = (size_t)fio_atol10u(&gen.buf);
+  FIO___TEST_HTTP_CACHE.zipped +=
+      !!fio_http_response_header(h,
+                                 FIO_STR_INFO2((char *)"content-encoding", 16),
+                                 0)
+            .len;
+}
+
+FIO_SFUNC void fio___test_http_cache_on_finish(fio_http_s *h) {
+  FIO_ASSERT(fio_http_status(h), "HTTP cache test: request failed");
+  ++FIO___TEST_HTTP_CACHE.finished;
+}
+
+FIO_SFUNC void fio___test_http_cache_send(const char *url,
+                                          size_t slot,
+                                          int zip) {
+  fio_http_s *h = fio_http_new();
+  FIO_STR_INFO_TMP_VAR(path, 32);
+  fio_string_write2(&path,
+                    NULL,
+                    FIO_STRING_WRITE_STR2("/", 1),
+                    FIO_STRING_WRITE_UNUM(slot));
+  fio_http_path_set(h, path);
+  if (zip)
+    fio_http_request_header_set(h,
+                                FIO_STR_INFO2((char *)"accept-encoding", 15),
+                                FIO_STR_INFO2((char *)"gzip, br", 8));
+  ++FIO___TEST_HTTP_CACHE.sent;
+  fio_http_connect(url,
+                   h,
+                   .on_http = fio___test_http_cache_on_response,
+                   .on_finish = fio___test_http_cache_on_finish);
+}
+
+/* tests the server's `on_http` calls and the last response's generation. */
+FIO_SFUNC void fio___test_http_cache_expect(size_t slot,
+                                            size_t calls,
+                                            const char *msg) {
+  FIO_ASSERT(FIO___TEST_HTTP_CACHE.calls[slot] == calls &&
+                 FIO___TEST_HTTP_CACHE.gen[slot] == calls,
+             "HTTP cache test: %s (path /%zu: %zu calls, generation %zu)",
+             msg,
+             slot,
+             FIO___TEST_HTTP_CACHE.calls[slot],
+             FIO___TEST_HTTP_CACHE.gen[slot]);
+}
+
+/* answers the held `SLOW` request once two more requests wait for it. */
+FIO_SFUNC int fio___test_http_cache_release_held(void) {
+  fio_http_s *h = FIO___TEST_HTTP_CACHE.held;
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  fio___http_cache_entry_s *e = c->state.http.cache;
+  size_t waiting = 0;
+  FIO_ASSERT(e && !c->state.http.cache_hit,
+             "HTTP cache test: the response isn't recorded");
+  FIO_LIST_EACH(fio___http_cache_waiting_s, node, &e->waiting, w) {
+    ++waiting;
+    (void)w;
+  }
+  if (waiting < 2)
+    return -1;
+  FIO___TEST_HTTP_CACHE.held = NULL;
+  fio___test_http_cache_respond(h, FIO___TEST_HTTP_CACHE_SLOW);
+  fio_http_free(h);
+  return 0;
+}
+
+/* advances the test once the previous stage settled (a timer task). */
+FIO_SFUNC int fio___test_http_cache_step(void *ignr_1, void *ignr_2) {
+  fio___http_cache_s *cache = FIO___TEST_HTTP_CACHE.cache;
+  (void)ignr_1, (void)ignr_2;
+  FIO_ASSERT(fio_time_milli() < FIO___TEST_HTTP_CACHE.deadline,
+             "HTTP cache test timed out (stage %d)",
+             (int)FIO___TEST_HTTP_CACHE.stage);
+  if (FIO___TEST_HTTP_CACHE.held && fio___test_http_cache_release_held())
+    return 0;
+  if (FIO___TEST_HTTP_CACHE.finished < FIO___TEST_HTTP_CACHE.sent)
+    return 0;
+  switch (FIO___TEST_HTTP_CACHE.stage++) {
+  case 0: /* TTL: cached until `cache_ttl` expires */
+    fio___test_http_cache_send(FIO___TEST_HTTP_CACHE_URL,
+                               FIO___TEST_HTTP_CACHE_TTL,
+                               0);
+    return 0;
+  case 1:
+    fio___test_http_cache_expect(FIO___TEST_HTTP_CACHE_TTL, 1, "TTL error");
+    FIO___TEST_HTTP_CACHE.expires = fio_time_milli() + 1000;
+    fio___test_http_cache_send(FIO___TEST_HTTP_CACHE_URL,
+                               FIO___TEST_HTTP_CACHE_TTL,
+                               0);
+    return 0;
+  case 2:
+    fio___test_http_cache_expect(FIO___TEST_HTTP_CACHE_TTL,
+                                 1,
+                                 "response not cached");
+    return 0;
+  case 3:
+    if (fio_time_milli() <= FIO___TEST_HTTP_CACHE.expires) {
+      --FIO___TEST_HTTP_CACHE.stage;
+      return 0;
+    }
+    fio___test_http_cache_send(FIO___TEST_HTTP_CACHE_URL,
+                               FIO___TEST_HTTP_CACHE_TTL,
+                               0);
+    return 0;
+  case 4:
+    fio___test_http_cache_expect(FIO___TEST_HTTP_CACHE_TTL,
+                                 2,
+                                 "expired response sent");
+    /* "pass" entries: responses a shared cache can't store */
+    for (size_t i = FIO___TEST_HTTP_CACHE_COOKIE;
+         i <= FIO___TEST_HTTP_CACHE_VARY;
+         ++i)
+      fio___test_http_cache_send(FIO___TEST_HTTP_CACHE_URL, i, 0);
+    return 0;
+  case 5:
+    for (size_t i = FIO___TEST_HTTP_CACHE_COOKIE;
+         i <= FIO___TEST_HTTP_CACHE_VARY;
+         ++i) {
+      fio___test_http_cache_expect(i, 1, "pass entry error");
+      fio___test_http_cache_send(FIO___TEST_HTTP_CACHE_URL, i, 0);
+    }
+    return 0;
+  case 6: {
+    size_t pass = 0;
+    for (size_t i = FIO___TEST_HTTP_CACHE_COOKIE;
+         i <= FIO___TEST_HTTP_CACHE_VARY;
+         ++i)
+      fio___test_http_cache_expect(i, 2, "non-cacheable response cached");
+    FIO_MAP_EACH(fio___http_cache_map, &cache->map, i) {
+      pass += i.value->pass;
+    }
+    FIO_ASSERT(pass == 3,
+               "HTTP cache test: expected 3 pass entries, found %zu",
+               pass);
+  }
+    /* coalescing: concurrent requests wait for the first response */
+    for (size_t i = 0; i < 3; ++i)
+      fio___test_http_cache_send(FIO___TEST_HTTP_CACHE_URL,
+                                 FIO___TEST_HTTP_CACHE_SLOW,
+                                 0);
+    return 0;
+  case 7:
+    fio___test_http_cache_expect(FIO___TEST_HTTP_CACHE_SLOW,
+                                 1,
+                                 "requests weren't coalesced");
+    if (!FIO___TEST_HTTP_CACHE_COMPRESS) {
+      FIO___TEST_HTTP_CACHE.stage = 14;
+      return 0;
+    }
+    /* compression: `accept-encoding` is part of the key (`cache_vary`) */
+    fio___test_http_cache_send(FIO___TEST_HTTP_CACHE_URL,
+                               FIO___TEST_HTTP_CACHE_ZIP,
+                               1);
+    return 0;
+  case 8:
+    fio___test_http_cache_expect(FIO___TEST_HTTP_CACHE_ZIP, 1, "zip error");
+    fio___test_http_cache_send(FIO___TEST_HTTP_CACHE_URL,
+                               FIO___TEST_HTTP_CACHE_ZIP,
+                               1);
+    return 0;
+  case 9:
+    fio___test_http_cache_expect(FIO___TEST_HTTP_CACHE_ZIP,
+                                 1,
+                                 "compressed response not cached");
+    FIO_ASSERT(FIO___TEST_HTTP_CACHE.zipped == 2,
+               "HTTP cache test: cached response should be compressed");
+    fio___test_http_cache_send(FIO___TEST_HTTP_CACHE_URL,
+                               FIO___TEST_HTTP_CACHE_ZIP,
+                               0);
+    return 0;
+  case 10:
+    fio___test_http_cache_expect(FIO___TEST_HTTP_CACHE_ZIP,
+                                 2,
+                                 "compressed response sent as identity");
+    fio___test_http_cache_send(FIO___TEST_HTTP_CACHE_URL,
+                               FIO___TEST_HTTP_CACHE_ZIP,
+                               0);
+    return 0;
+  case 11:
+    fio___test_http_cache_expect(FIO___TEST_HTTP_CACHE_ZIP,
+                                 2,
+                                 "identity response not cached");
+    FIO_ASSERT(FIO___TEST_HTTP_CACHE.zipped == 2,
+               "HTTP cache test: identity response compressed");
+    /* without `cache_vary`, `vary: accept-encoding` leaves a "pass" entry */
+    fio___test_http_cache_send(FIO___TEST_HTTP_CACHE_URL_NO_VARY,
+                               FIO___TEST_HTTP_CACHE_ZIP,
+                               1);
+    return 0;
+  case 12:
+    fio___test_http_cache_expect(FIO___TEST_HTTP_CACHE_ZIP, 3, "zip error");
+    fio___test_http_cache_send(FIO___TEST_HTTP_CACHE_URL_NO_VARY,
+                               FIO___TEST_HTTP_CACHE_ZIP,
+                               1);
+    return 0;
+  case 13:
+    fio___test_http_cache_expect(FIO___TEST_HTTP_CACHE_ZIP,
+                                 4,
+                                 "`vary` ignored for compressed response");
+    FIO_ASSERT(FIO___TEST_HTTP_CACHE.zipped == 4,
+               "HTTP cache test: response should be compressed");
+    return 0;
+  case 14: /* LRU: the cache evicts the least recently used responses */
+    if (FIO___TEST_HTTP_CACHE.lru < FIO___TEST_HTTP_CACHE_LRU) {
+      --FIO___TEST_HTTP_CACHE.stage;
+      fio___test_http_cache_send(FIO___TEST_HTTP_CACHE_URL,
+                                 FIO___TEST_HTTP_CACHE.lru++,
+                                 0);
+      return 0;
+    }
+    FIO_ASSERT(cache->mem <= cache->limit,
+               "HTTP cache test: cache_limit exceeded (%zu bytes)",
+               cache->mem);
+    fio___test_http_cache_send(FIO___TEST_HTTP_CACHE_URL,
+                               FIO___TEST_HTTP_CACHE_LRU - 1,
+                               0);
+    return 0;
+  case 15:
+    fio___test_http_cache_expect(FIO___TEST_HTTP_CACHE_LRU - 1,
+                                 1,
+                                 "recently used response evicted");
+    fio___test_http_cache_send(FIO___TEST_HTTP_CACHE_URL, 0, 0);
+    return 0;
+  case 16:
+    fio___test_http_cache_expect(0, 2, "cache_limit ignored");
+    fio_io_stop();
+    return -1;
+  }
+  return -1;
+}
+
+FIO_SFUNC void fio___test_http_cache_on_start(void *ignr_) {
+  fio_io_run_every(.fn = fio___test_http_cache_step,
+                   .every = 5,
+                   .repetitions = -1);
+  (void)ignr_;
+}
+
+FIO_SFUNC void FIO_NAME_TEST(stl, http_cache)(void) {
+  fprintf(stderr, "* Testing HTTP response cache.\n");
+  int log_level = FIO_LOG_LEVEL;
+  void *listeners[2];
+  FIO_LOG_LEVEL = FIO_LOG_LEVEL_WARNING;
+  listeners[0] =
+      fio_http_listen(FIO___TEST_HTTP_CACHE_URL,
+                      .on_http = fio___test_http_cache_on_request_main,
+                      .cache_vary = FIO_STR_INFO1((char *)"accept-encoding"),
+                      .cache_limit = FIO___TEST_HTTP_CACHE_LIMIT,
+                      .compress_min = 200,
+                      .cache_ttl = 1,
+                      .compress = FIO___TEST_HTTP_CACHE_COMPRESS);
+  listeners[1] = fio_http_listen(FIO___TEST_HTTP_CACHE_URL_NO_VARY,
+                                 .on_http = fio___test_http_cache_on_request,
+                                 .compress_min = 200,
+                                 .cache_ttl = 1,
+                                 .compress = FIO___TEST_HTTP_CACHE_COMPRESS);
+  FIO_ASSERT(listeners[0] && listeners[1],
+             "HTTP cache test: couldn't listen for connections");
+  FIO___TEST_HTTP_CACHE.deadline = fio_time_milli() + 10000;
+  fio_state_callback_add(FIO_CALL_ON_START,
+                         fio___test_http_cache_on_start,
+                         NULL);
+  fio_io_start(0);
+  fio_state_callback_remove(FIO_CALL_ON_START,
+                            fio___test_http_cache_on_start,
+                            NULL);
+  FIO_ASSERT(FIO___TEST_HTTP_CACHE.stage == 17,
+             "HTTP cache test: reactor stopped early (stage %d)",
+             (int)FIO___TEST_HTTP_CACHE.stage);
+  fio_io_listen_stop(listeners[0]);
+  fio_io_listen_stop(listeners[1]);
+  FIO_LOG_LEVEL = log_level;
+}
+
 /* *****************************************************************************
 Cleanup
 ***************************************************************************** */
@@ -51876,6 +67168,295 @@ Cleanup
 
 
 
+                        FIO_JSON_SCHEMA Test Helper
+
+
+
+
+Copyright and License: see header file (000 copyright.h) or top of file
+***************************************************************************** */
+#if defined(FIO_TEST_ALL) && !defined(FIO___TEST_REINCLUDE) &&                 \
+    !defined(H___FIO_JSON_SCHEMA_TEST___H)
+#define H___FIO_JSON_SCHEMA_TEST___H
+
+typedef struct {
+  double x;
+  double y;
+} fio___test_json_point_s;
+
+typedef struct {
+  int64_t id;
+  int32_t small;
+  uint16_t port;
+  uint8_t active;
+  float ratio;
+  double price;
+  char name[16];
+  char *note;
+  fio___test_json_point_s origin;
+  int64_t answer;
+  char *greeting;
+} fio___test_json_msg_s;
+
+#define FIO___TEST_REINCLUDE
+#define FIO_JSON_SCHEMA_NAME   fio___test_json_point
+#define FIO_JSON_SCHEMA_TYPE   fio___test_json_point_s
+#define FIO_JSON_SCHEMA_STRICT 1
+#define FIO_JSON_SCHEMA_FIELDS(FIELD)                                          \
+  FIELD(x, FIO_JSON_FIELD_FLOAT, .required = 1)                                \
+  FIELD(y, FIO_JSON_FIELD_FLOAT, .def.f = -1.5)
+#include FIO_INCLUDE_FILE
+
+#define FIO_JSON_SCHEMA_NAME fio___test_json_msg
+#define FIO_JSON_SCHEMA_TYPE fio___test_json_msg_s
+#define FIO_JSON_SCHEMA_FIELDS(FIELD)                                          \
+  FIELD(id, FIO_JSON_FIELD_INT, .required = 1)                                 \
+  FIELD(small, FIO_JSON_FIELD_INT)                                             \
+  FIELD(port, FIO_JSON_FIELD_UINT)                                             \
+  FIELD(active, FIO_JSON_FIELD_BOOL)                                           \
+  FIELD(ratio, FIO_JSON_FIELD_FLOAT)                                           \
+  FIELD(price, FIO_JSON_FIELD_FLOAT)                                           \
+  FIELD(name, FIO_JSON_FIELD_STR)                                              \
+  FIELD(note, FIO_JSON_FIELD_BSTR)                                             \
+  FIELD(origin, FIO_JSON_FIELD_OBJ(fio___test_json_point))                     \
+  FIELD(answer, FIO_JSON_FIELD_INT, .key = "the-answer", .def.i = 42)          \
+  FIELD(greeting, FIO_JSON_FIELD_BSTR, .def.s = "hello")
+#include FIO_INCLUDE_FILE
+#undef FIO___TEST_REINCLUDE
+
+/* parses a JSON object using a (lazily prepared) runtime schema */
+typedef struct {
+  fio_json_schema_s *schema;
+  fio_str_info_s json;
+  int64_t values[FIO_JSON_SCHEMA_MAX_FIELDS];
+  int result;
+} fio___test_json_schema_task_s;
+
+FIO_SFUNC void *fio___test_json_schema_task(void *task_) {
+  fio___test_json_schema_task_s *task = (fio___test_json_schema_task_s *)task_;
+  task->result =
+      fio_json_schema_parse(task->schema, task->values, task->json, NULL);
+  return NULL;
+}
+
+FIO_SFUNC void FIO_NAME_TEST(stl, json_schema)(void) {
+  fprintf(stderr, "* Testing JSON schemas (JSON to / from C structs).\n");
+  fio___test_json_msg_s m, m2;
+  char buf[1024];
+  fio_str_info_s out = FIO_STR_INFO3(buf, 0, sizeof(buf));
+  size_t consumed = 0;
+  fio___test_json_msg_init(&m);
+  fio___test_json_msg_init(&m2);
+  FIO_ASSERT(!m.id && !m.note && m.answer == 42 && m.origin.y == -1.5 &&
+                 m.greeting && !strcmp(m.greeting, "hello") && !m.name[0],
+             "JSON schema init error");
+  { /* a full message (long enough for the structural index parser) */
+    const char *json = "{\"id\": 9007199254740993, \"small\": -2147483648, "
+                       "\"port\": 65535, \"active\": true, \"ratio\": 0.5, "
+                       "\"unknown\": [1, {\"id\": 2}, [\"x\"]], "
+                       "\"price\": 12, \"na\\u006De\": \"\\u00e9t\\u00e9\", "
+                       "\"note\": \"line\\nbreak\", \"skip\": {\"x\": {}}, "
+                       "\"origin\": {\"x\": 1.25, \"y\": -3}, "
+                       "\"greeting\": null}  ";
+    FIO_ASSERT(FIO_STRLEN(json) >= 128, "test JSON should be indexed");
+    FIO_ASSERT(!fio___test_json_msg_parse(&m, FIO_STR_INFO1((char *)json), 0),
+               "JSON schema parsing failed");
+    FIO_ASSERT(m.id == 9007199254740993LL && m.small == INT32_MIN &&
+                   m.port == 65535 && m.active == 1 && m.ratio == 0.5 &&
+                   m.price == 12.0 && m.origin.x == 1.25 &&
+                   m.origin.y == -3.0 && m.answer == 42 &&
+                   !strcmp(m.greeting, "hello"),
+               "JSON schema parsing value error");
+    FIO_ASSERT(!strcmp(m.name, "\xC3\xA9t\xC3\xA9"),
+               "JSON schema escaped String / key error: %s",
+               m.name);
+    FIO_ASSERT(m.note && !strcmp(m.note, "line\nbreak") &&
+                   fio_bstr_len(m.note) == 10,
+               "JSON schema fio_bstr field error");
+  }
+  { /* writing and round-trip */
+    FIO_ASSERT(!fio___test_json_msg_write(&out, NULL, &m),
+               "JSON schema writing failed (buffer too short?)");
+    FIO_ASSERT(!strcmp(out.buf,
+                       "{\"id\":9007199254740993,\"small\":-2147483648,"
+                       "\"port\":65535,\"active\":true,\"ratio\":0.5,"
+                       "\"price\":12.0,\"name\":\"\xC3\xA9t\xC3\xA9\","
+                       "\"note\":\"line\\nbreak\","
+                       "\"origin\":{\"x\":1.25,\"y\":-3.0},"
+                       "\"the-answer\":42,\"greeting\":\"hello\"}"),
+               "JSON schema output error:\n%s",
+               out.buf);
+    FIO_ASSERT(!fio___test_json_msg_parse(&m2, out, &consumed) &&
+                   consumed == out.len,
+               "JSON schema round-trip parsing failed");
+    FIO_ASSERT(m2.id == m.id && m2.small == m.small && m2.port == m.port &&
+                   m2.active == m.active && m2.ratio == m.ratio &&
+                   m2.price == m.price && !strcmp(m2.name, m.name) &&
+                   !strcmp(m2.note, m.note) &&
+                   m2.origin.x == m.origin.x && m2.origin.y == m.origin.y &&
+                   m2.answer == m.answer && !strcmp(m2.greeting, "hello"),
+               "JSON schema round-trip error");
+    /* writing using a reallocation callback */
+    char *bstr = NULL;
+    fio_str_info_s i = fio_bstr_info(bstr);
+    FIO_ASSERT(!fio___test_json_msg_write(&i, fio_bstr_reallocate, &m),
+               "JSON schema writing (with reallocation) failed");
+    bstr = fio_bstr_len_set(i.buf, i.len);
+    FIO_ASSERT(FIO_BUF_INFO_IS_EQ(fio_bstr_buf(bstr), FIO_STR2BUF_INFO(out)),
+               "JSON schema writing (with reallocation) error");
+    fio_bstr_free(bstr);
+    /* NULL `fio_bstr` fields are written as `null` */
+    fio_bstr_free(m2.greeting);
+    m2.greeting = NULL;
+    out = FIO_STR_INFO3(buf, 0, sizeof(buf));
+    FIO_ASSERT(!fio___test_json_msg_write(&out, NULL, &m2) &&
+                   !FIO_MEMCMP(out.buf + out.len - 16,
+                               "\"greeting\":null}",
+                               16),
+               "JSON schema NULL String output error:\n%s",
+               out.buf);
+    /* a short buffer truncates the output */
+    out = FIO_STR_INFO3(buf, 0, 16);
+    FIO_ASSERT(fio___test_json_msg_write(&out, NULL, &m) && out.len == 15,
+               "JSON schema writing should fail for short buffers");
+  }
+  { /* missing fields, duplicate keys, `null` values and bstr reuse */
+    const char *json = "{\"id\":1,\"the-answer\":7,\"origin\":{\"x\":1},"
+                       "\"origin\":{\"x\":2},\"the-answer\":null,"
+                       "\"note\":\"a\"}";
+    FIO_ASSERT(!fio___test_json_msg_parse(&m, FIO_STR_INFO1((char *)json), 0),
+               "JSON schema parsing failed (defaults)");
+    FIO_ASSERT(m.id == 1 && !m.small && !m.port && !m.active && !m.ratio &&
+                   !m.price && !m.name[0] && m.origin.x == 2.0 &&
+                   m.origin.y == -1.5 && m.answer == 42 &&
+                   !strcmp(m.greeting, "hello") && !strcmp(m.note, "a"),
+               "JSON schema default values error");
+  }
+  { /* errors */
+    const char *errors[] = {
+        "{\"small\":1}",                   /* missing required field */
+        "{\"id\":1,\"origin\":{\"y\":1}}", /* missing required (nested) */
+        "{\"id\":\"1\"}",                  /* type mismatch */
+        "{\"id\":1.5}",                    /* type mismatch */
+        "{\"id\":1,\"active\":1}",         /* type mismatch */
+        "{\"id\":1,\"name\":1}",           /* type mismatch */
+        "{\"id\":1,\"origin\":[1,2]}",     /* type mismatch */
+        "{\"id\":1,\"price\":{}}",         /* type mismatch */
+        "{\"id\":1,\"small\":2147483648}", /* out of range */
+        "{\"id\":1,\"port\":65536}",       /* out of range */
+        "{\"id\":1,\"port\":-1}",          /* out of range */
+        "{\"id\":1,\"name\":\"0123456789abcdef\"}", /* String too long */
+        "{\"id\":1,\"origin\":{\"x\":1,\"z\":1}}",  /* strict schema */
+        "{\"id\":1",                                /* incomplete */
+        "[{\"id\":1}]",                             /* not an object */
+        "1",                                        /* not an object */
+        "",                                         /* no data */
+        NULL,
+    };
+    for (size_t i = 0; errors[i]; ++i) {
+      FIO_ASSERT(fio___test_json_msg_parse(&m,
+                                           FIO_STR_INFO1((char *)errors[i]),
+                                           NULL),
+                 "JSON schema parsing should have failed for: %s",
+                 errors[i]);
+    }
+    FIO_ASSERT(!fio___test_json_msg_parse(
+                   &m,
+                   FIO_STR_INFO1((char *)"{\"id\":1,\"name\":"
+                                         "\"0123456789abcde\"}"),
+                   NULL) &&
+                   !strcmp(m.name, "0123456789abcde"),
+               "JSON schema parsing failed for a String that fits");
+  }
+  { /* perfect hash key dispatch, using a 64 field schema */
+    fio_json_schema_field_s fields[FIO_JSON_SCHEMA_MAX_FIELDS];
+    char names[FIO_JSON_SCHEMA_MAX_FIELDS][8];
+    int64_t values[FIO_JSON_SCHEMA_MAX_FIELDS];
+    char *json = NULL;
+    for (size_t i = 0; i < FIO_JSON_SCHEMA_MAX_FIELDS; ++i) {
+      snprintf(names[i], sizeof(names[i]), "f%zu", i);
+      fields[i] = (fio_json_schema_field_s){
+          .name = names[i],
+          .offset = sizeof(values[0]) * i,
+          .size = sizeof(values[0]),
+          .type = FIO_JSON_SCHEMA_INT,
+          .required = 1,
+      };
+    }
+    fio_json_schema_s schema = {
+        .fields = fields,
+        .count = FIO_JSON_SCHEMA_MAX_FIELDS,
+        .strict = 1,
+    };
+    fio_json_schema_prepare(&schema);
+    FIO_ASSERT(schema.bits, "JSON schema perfect hash not found");
+    json = fio_bstr_write(json, "{", 1);
+    for (size_t i = FIO_JSON_SCHEMA_MAX_FIELDS; i--;)
+      json = fio_bstr_write2(json,
+                             FIO_STRING_WRITE_STR1("\""),
+                             FIO_STRING_WRITE_STR1(names[i]),
+                             FIO_STRING_WRITE_STR1("\":"),
+                             FIO_STRING_WRITE_NUM(i * 3),
+                             FIO_STRING_WRITE_STR1((i ? "," : "}")));
+    FIO_ASSERT(!fio_json_schema_parse(&schema, values, fio_bstr_info(json), 0),
+               "JSON schema (64 fields) parsing failed");
+    for (size_t i = 0; i < FIO_JSON_SCHEMA_MAX_FIELDS; ++i)
+      FIO_ASSERT(values[i] == (int64_t)(i * 3),
+                 "JSON schema (64 fields) value error at %zu",
+                 i);
+    { /* threads racing to prepare a hand declared schema */
+      fio_json_schema_s lazy = {
+          .fields = fields,
+          .count = FIO_JSON_SCHEMA_MAX_FIELDS,
+          .strict = 1,
+      };
+      fio_thread_t threads[4];
+      fio___test_json_schema_task_s tasks[4];
+      for (size_t i = 0; i < 4; ++i) {
+        tasks[i] = (fio___test_json_schema_task_s){
+            .schema = &lazy,
+            .json = fio_bstr_info(json),
+            .result = -1,
+        };
+        FIO_ASSERT(!fio_thread_create(threads + i,
+                                      fio___test_json_schema_task,
+                                      tasks + i),
+                   "couldn't start a JSON schema test thread");
+      }
+      for (size_t i = 0; i < 4; ++i) {
+        fio_thread_join(threads + i);
+        FIO_ASSERT(!tasks[i].result &&
+                       tasks[i].values[FIO_JSON_SCHEMA_MAX_FIELDS - 1] ==
+                           (int64_t)((FIO_JSON_SCHEMA_MAX_FIELDS - 1) * 3),
+                   "JSON schema lazy preparation failed (thread %zu)",
+                   i);
+      }
+      FIO_ASSERT(lazy.ready && lazy.bits == schema.bits &&
+                     lazy.seed == schema.seed,
+                 "JSON schema lazy preparation error");
+    }
+    fio_bstr_free(json);
+  }
+  fio___test_json_msg_destroy(&m);
+  fio___test_json_msg_destroy(&m2);
+  FIO_ASSERT(!m.note && !m.greeting, "JSON schema destroy error");
+}
+
+/* *****************************************************************************
+Cleanup
+***************************************************************************** */
+#endif /* FIO_TEST_ALL */
+/* ************************************************************************* */
+#if !defined(FIO_INCLUDE_FILE) /* Dev test - ignore line */
+#define FIO___DEV___           /* Development inclusion - ignore line */
+#define FIO_TEST_ALL           /* Development inclusion - ignore line */
+#include "./include.h"         /* Development inclusion - ignore line */
+#endif                         /* Development inclusion - ignore line */
+/* *****************************************************************************
+
+
+
+
                         Math Test Helper
 
 
@@ -52649,6 +68230,49 @@ Copyright and License: see header file (000 copyright.h) or top of file
 // #undef FIO___TEST_REINCLUDE
 // #endif
 
+/* a minimal context: entry 0 is the root context, the rest are values. */
+typedef struct {
+  const char *name;
+  const char *value;
+} fio___test_mustache_var_s;
+static fio___test_mustache_var_s fio___test_mustache_vars[] = {
+    {"", ""},
+    {"tag", "<b>"},
+    {"this_one", "1 & 2"},
+    {"flag", "yes"},
+    {NULL, NULL}};
+static size_t fio___test_mustache_hashed_calls;
+
+FIO_SFUNC uint64_t fio___test_mustache_hash(fio_buf_info_s name) {
+  return fio_risky_hash(name.buf, name.len, 0);
+}
+FIO_SFUNC uint64_t fio___test_mustache_hash2(fio_buf_info_s name) {
+  return fio_risky_hash(name.buf, name.len, 1);
+}
+FIO_SFUNC void *fio___test_mustache_get_var(void *ctx, fio_buf_info_s name) {
+  if (ctx != (void *)fio___test_mustache_vars)
+    return NULL;
+  for (size_t i = 1; fio___test_mustache_vars[i].name; ++i)
+    if (FIO_BUF_INFO_IS_EQ(
+            name,
+            FIO_BUF_INFO1((char *)fio___test_mustache_vars[i].name)))
+      return (void *)(fio___test_mustache_vars + i);
+  return NULL;
+}
+FIO_SFUNC void *fio___test_mustache_get_var_hashed(void *ctx,
+                                                   fio_buf_info_s name,
+                                                   uint64_t hash) {
+  ++fio___test_mustache_hashed_calls;
+  FIO_ASSERT(hash == fio___test_mustache_hash(name),
+             "bound hash value error for %.*s",
+             (int)name.len,
+             name.buf);
+  return fio___test_mustache_get_var(ctx, name);
+}
+FIO_SFUNC fio_buf_info_s fio___test_mustache_var2str(void *var) {
+  return FIO_BUF_INFO1((char *)((fio___test_mustache_var_s *)var)->value);
+}
+
 FIO_SFUNC void FIO_NAME_TEST(stl, mustache)(void) {
   fprintf(stderr, "* Testing mustache template parser.\n");
   char *example1 = (char *)"This is a {{tag}}, and so is {{ this_one }}.";
@@ -52668,6 +68292,174 @@ FIO_SFUNC void FIO_NAME_TEST(stl, mustache)(void) {
   m = fio_mustache_load(.data = FIO_BUF_INFO1(example2));
   FIO_ASSERT(!m, "invalid example load returned an object.");
   fio_mustache_free(m);
+
+  fprintf(stderr, "* Testing mustache template binding and iov output.\n");
+  {
+    char *example3 =
+        (char *)"{{#flag}}[{{tag}}]{{/flag}}{{^missing}} {{{this_one}}} "
+                "{{this_one}}{{/missing}}{{a.b}}.";
+    fio_buf_info_s expected =
+        FIO_BUF_INFO1((char *)"[&lt;b&gt;] 1 & 2 1 &amp; 2.");
+    fio_mustache_bargs_s args = {
+        .get_var = fio___test_mustache_get_var,
+        .var2str = fio___test_mustache_var2str,
+        .var_hash = fio___test_mustache_hash,
+        .get_var_hashed = fio___test_mustache_get_var_hashed,
+        .ctx = (void *)fio___test_mustache_vars,
+    };
+    m = fio_mustache_load(.data = FIO_BUF_INFO1(example3));
+    FIO_ASSERT(m, "valid example load failed!");
+    fio___test_mustache_hashed_calls = 0;
+    result = (char *)fio_mustache_build FIO_NOOP(m, args);
+    FIO_ASSERT(FIO_BUF_INFO_IS_EQ(fio_bstr_buf(result), expected),
+               "unbound template result error: %s",
+               result);
+    FIO_ASSERT(!fio___test_mustache_hashed_calls,
+               "get_var_hashed called for an unbound template");
+    fio_bstr_free(result);
+
+    fio_mustache_bind(m, fio___test_mustache_hash);
+    result = (char *)fio_mustache_build FIO_NOOP(m, args);
+    FIO_ASSERT(FIO_BUF_INFO_IS_EQ(fio_bstr_buf(result), expected),
+               "bound template result error: %s",
+               result);
+    FIO_ASSERT(fio___test_mustache_hashed_calls,
+               "get_var_hashed wasn't called for a bound template");
+    fio_bstr_free(result);
+
+    fio___test_mustache_hashed_calls = 0;
+    args.var_hash = fio___test_mustache_hash2;
+    result = (char *)fio_mustache_build FIO_NOOP(m, args);
+    FIO_ASSERT(FIO_BUF_INFO_IS_EQ(fio_bstr_buf(result), expected),
+               "template result error (hash function mismatch): %s",
+               result);
+    FIO_ASSERT(!fio___test_mustache_hashed_calls,
+               "get_var_hashed called with a mismatched hash function");
+    fio_bstr_free(result);
+    args.var_hash = fio___test_mustache_hash;
+
+    fio_mustache_iov_s iov = {0};
+    for (size_t round = 0; round < 2; ++round) {
+      size_t count = fio_mustache_build_iov FIO_NOOP(m, &iov, args);
+      FIO_ASSERT(count && count == iov.count && iov.len == expected.len,
+                 "fio_mustache_build_iov count / length error (%zu / %zu)",
+                 count,
+                 iov.len);
+      result = NULL;
+      size_t referenced = 0;
+      for (size_t i = 0; i < iov.count; ++i) {
+        result = fio_bstr_write(result, iov.iov[i].buf, iov.iov[i].len);
+        referenced += (iov.iov[i].buf >= (char *)m &&
+                       iov.iov[i].buf < (char *)m + fio_bstr_len((char *)m));
+      }
+      FIO_ASSERT(FIO_BUF_INFO_IS_EQ(fio_bstr_buf(result), expected),
+                 "fio_mustache_build_iov result error: %s",
+                 result);
+      FIO_ASSERT(referenced, "template text should be referenced, not copied");
+      fio_bstr_free(result);
+    }
+    fio_mustache_free(m); /* the iov holds a reference to the template */
+    FIO_ASSERT(iov.iov[0].buf[0] == '[', "iov template reference error");
+    fio_mustache_iov_destroy(&iov);
+    FIO_ASSERT(!iov.iov && !iov.count && !iov.blocks,
+               "fio_mustache_iov_destroy should zero out the object");
+  }
+
+  fprintf(stderr, "* Testing mustache template cache.\n");
+  {
+    const char *main_fn = "fio___test_mustache_cache_main.mustache";
+    const char *part_fn = "fio___test_mustache_cache_part.mustache";
+    const char *second_fn = "fio___test_mustache_cache_second.mustache";
+    fio_mustache_bargs_s args = {
+        .get_var = fio___test_mustache_get_var,
+        .var2str = fio___test_mustache_var2str,
+        .ctx = (void *)fio___test_mustache_vars,
+    };
+    struct {
+      fio_mustache_s *m;
+      const char *expected;
+    } t[6] = {{0}};
+    fio_mustache_cache_config(0, 0); /* test files for changes every time */
+    FIO_ASSERT(!fio_mustache_cache_get(.filename = FIO_BUF_INFO1(
+                                           (char *)main_fn)),
+               "fio_mustache_cache_get should fail for missing files");
+    FIO_ASSERT(!fio_filename_overwrite(main_fn,
+                                       "[{{> fio___test_mustache_cache_part}}]",
+                                       38) &&
+                   !fio_filename_overwrite(part_fn, "{{tag}}", 7) &&
+                   !fio_filename_overwrite(
+                       second_fn,
+                       "({{> fio___test_mustache_cache_part}})",
+                       38),
+               "couldn't write template cache test files");
+
+    t[0].m = fio_mustache_cache_get(.filename = FIO_BUF_INFO1((char *)main_fn));
+    t[0].expected = "[&lt;b&gt;]";
+    t[1].m = fio_mustache_cache_get(.filename = FIO_BUF_INFO1((char *)main_fn));
+    t[1].expected = t[0].expected;
+    FIO_ASSERT(t[0].m && t[0].m == t[1].m,
+               "fio_mustache_cache_get should return the cached template");
+    t[2].m = fio_mustache_cache_get(.filename =
+                                        FIO_BUF_INFO1((char *)second_fn),
+                                    .var_hash = fio___test_mustache_hash);
+    t[2].expected = "(&lt;b&gt;)";
+    FIO_ASSERT(t[2].m && t[2].m != t[0].m, "cached template error");
+
+    /* a partial change re-compiles both templates, in use templates remain */
+    fio_filename_overwrite(part_fn, "{{{tag}}}!", 10);
+    t[3].m = fio_mustache_cache_get(.filename = FIO_BUF_INFO1((char *)main_fn));
+    t[3].expected = "[<b>!]";
+    FIO_ASSERT(t[3].m && t[3].m != t[0].m,
+               "fio_mustache_cache_get should reload changed partials");
+    t[4].m = fio_mustache_cache_get(.filename =
+                                        FIO_BUF_INFO1((char *)second_fn));
+    t[4].expected = "(<b>!)";
+    FIO_ASSERT(t[4].m && t[4].m != t[2].m,
+               "fio_mustache_cache_get should reload shared partials");
+
+    /* a broken template keeps the last valid version */
+    fprintf(stderr, "\terrors should print on the next lines.\n");
+    fio_filename_overwrite(main_fn, "{{tag}} and {{ incomplete}", 26);
+    t[5].m = fio_mustache_cache_get(.filename = FIO_BUF_INFO1((char *)main_fn));
+    t[5].expected = t[3].expected;
+    FIO_ASSERT(t[5].m == t[3].m,
+               "fio_mustache_cache_get should keep the last valid template");
+
+    for (size_t i = 0; i < 6; ++i) {
+      result = (char *)fio_mustache_build FIO_NOOP(t[i].m, args);
+      FIO_ASSERT(FIO_BUF_INFO_IS_EQ(fio_bstr_buf(result),
+                                    FIO_BUF_INFO1((char *)t[i].expected)),
+                 "cached template (%zu) result error: %s != %s",
+                 i,
+                 result,
+                 t[i].expected);
+      fio_bstr_free(result);
+      fio_mustache_free(t[i].m);
+    }
+
+    /* a tiny memory limit evicts everything but the latest template */
+    fio_mustache_cache_config(1, 0);
+    for (size_t i = 0; i < 2; ++i) {
+      fio_mustache_s *cached =
+          fio_mustache_cache_get(.filename = FIO_BUF_INFO1((char *)second_fn));
+      result = (char *)fio_mustache_build FIO_NOOP(cached, args);
+      FIO_ASSERT(FIO_BUF_INFO_IS_EQ(fio_bstr_buf(result),
+                                    FIO_BUF_INFO1((char *)"(<b>!)")),
+                 "memory limited template cache result error: %s",
+                 result);
+      fio_bstr_free(result);
+      fio_mustache_free(cached);
+    }
+
+    unlink(main_fn);
+    unlink(part_fn);
+    unlink(second_fn);
+    FIO_ASSERT(!fio_mustache_cache_get(.filename = FIO_BUF_INFO1(
+                                           (char *)second_fn)),
+               "fio_mustache_cache_get should drop removed templates");
+    fio_mustache_cache_clear();
+    fio_mustache_cache_config(0, -1);
+  }
 }
 
 /* *****************************************************************************
@@ -52814,6 +68606,62 @@ FIO_SFUNC void FIO_NAME_TEST(stl, pubsub_encryption)(void) {
   fio___pubsub_message_free(dec);
 }
 
+/* *****************************************************************************
+Cluster Batch Testing
+***************************************************************************** */
+
+FIO_SFUNC void FIO_NAME_TEST(stl, pubsub_batch_on_message)(fio_msg_s *msg) {
+  size_t *state = (size_t *)msg->udata;
+  FIO_ASSERT(msg->message.len == 1 &&
+                 (size_t)msg->message.buf[0] == 'a' + state[0],
+             "(pubsub) batched message out of order (%zu)",
+             state[0]);
+  ++state[0];
+}
+
+FIO_SFUNC void FIO_NAME_TEST(stl, pubsub_batch)(void) {
+  fprintf(stderr, "* Testing pub/sub cluster batches.\n");
+  size_t state = 0;
+  char *batch = NULL;
+  char tmp[2] = {0};
+  fio_buf_info_s test_channel = FIO_BUF_INFO1((char *)"pubsub_batch_channel");
+  fio_subscribe(.channel = test_channel,
+                .on_message = FIO_NAME_TEST(stl, pubsub_batch_on_message),
+                .udata = &state,
+                .filter = -126);
+  for (size_t i = 0; i < 8; ++i) {
+    tmp[0] = (char)('a' + i);
+    fio___pubsub_message_s *m = fio___pubsub_message_author(
+        (fio_publish_args_s){.channel = test_channel,
+                             .message = FIO_BUF_INFO2(tmp, 1),
+                             .filter = -126,
+                             .is_json = FIO___PUBSUB_PROCESS});
+    batch = fio___pubsub_batch_append(batch, m);
+    fio___pubsub_message_free(m);
+  }
+  fio___pubsub_message_s *enc = fio___pubsub_message_author(
+      (fio_publish_args_s){.message = FIO_BUF_INFO2(batch, fio_bstr_len(batch)),
+                           .is_json = FIO___PUBSUB_BATCH});
+  fio_bstr_free(batch);
+  fio___pubsub_message_encrypt(enc);
+  const size_t len = enc->data.channel.len + enc->data.message.len +
+                     FIO___PUBSUB_MESSAGE_OVERHEAD;
+  fio___pubsub_message_s *dec = fio___pubsub_message_alloc(enc->data.udata);
+  FIO_MEMCPY(dec->data.udata, enc->data.udata, len);
+  FIO_ASSERT(!fio___pubsub_message_decrypt(dec), "batch decryption failed");
+  FIO_ASSERT(dec->data.is_json == FIO___PUBSUB_BATCH, "batch flag error");
+  fio___pubsub_on_message_remote(NULL, dec);
+  fio_queue_perform_all(fio_io_queue());
+  FIO_ASSERT(state == 8, "(pubsub) batch unpacking error (%zu/8)", state);
+  fio___pubsub_message_free(enc);
+  fio___pubsub_message_free(dec);
+  fio_unsubscribe(.channel = test_channel,
+                  .on_message = FIO_NAME_TEST(stl, pubsub_batch_on_message),
+                  .udata = &state,
+                  .filter = -126);
+  fio_queue_perform_all(fio_io_queue());
+}
+
 /* *****************************************************************************
 Round Trip Testing
 ***************************************************************************** */
@@ -52894,6 +68742,7 @@ FIO_SFUNC void FIO_NAME_TEST(stl, pubsub_roundtrip)(void) {
 
 FIO_SFUNC void FIO_NAME_TEST(stl, pubsub)(void) {
   FIO_NAME_TEST(stl, pubsub_encryption)();
+  FIO_NAME_TEST(stl, pubsub_batch)();
   FIO_NAME_TEST(stl, pubsub_roundtrip)();
   fio___io_cleanup_at_exit(NULL);
 }
@@ -54751,6 +70600,22 @@ FIO_SFUNC void FIO_NAME_TEST(stl, string_core_helpers)(void) {
     FIO_ASSERT(!memcmp(unescaped.buf, decoded.buf, unescaped.len),
                "C escaping round-trip failed:\n %s",
                decoded.buf);
+    /* escaping into a (non-reallocatable) buffer that's too short */
+    decoded = FIO_STR_INFO3(mem + 512, 0, 512);
+    fio_string_write_escape(&decoded, NULL, "a\"b\nc\001d", 7);
+    for (size_t capa = 1; capa <= decoded.len; ++capa) {
+      memset(mem, 'X', 32);
+      encoded = FIO_STR_INFO3(mem, 0, capa);
+      FIO_ASSERT(fio_string_write_escape(&encoded, NULL, "a\"b\nc\001d", 7),
+                 "C escaping should fail when the buffer is too short");
+      FIO_ASSERT(encoded.len < capa && !mem[encoded.len] && mem[capa] == 'X',
+                 "C escaping overflowed a short buffer (capa %zu, len %zu)",
+                 capa,
+                 encoded.len);
+      FIO_ASSERT(!memcmp(encoded.buf, decoded.buf, encoded.len) &&
+                     (!encoded.len || encoded.buf[encoded.len - 1] != '\\'),
+                 "C escaping truncated in the middle of an escape sequence");
+    }
   }
   { /* testing Base64 Support */
     fprintf(stderr, "* Testing Base64 encoding / decoding.\n");
@@ -56830,6 +72695,7 @@ FIO_SFUNC void fio_test_dynamic_types(void) {
   fprintf(stderr, "===============\n");
   FIO_NAME_TEST(stl, uset___test_size_t)();
   FIO_NAME_TEST(stl, umap___test_size)();
+  FIO_NAME_TEST(stl, umap___test_size_inc)();
   FIO_NAME_TEST(stl, omap___test_size_t)();
   FIO_NAME_TEST(stl, omap___test_size_lru)();
   fprintf(stderr, "===============\n");
@@ -56838,6 +72704,8 @@ FIO_SFUNC void fio_test_dynamic_types(void) {
   fprintf(stderr, "===============\n");
   FIO_NAME_TEST(stl, mustache)();
   fprintf(stderr, "===============\n");
+  FIO_NAME_TEST(stl, json_schema)();
+  fprintf(stderr, "===============\n");
   FIO_NAME_TEST(stl, time)();
   fprintf(stderr, "===============\n");
   FIO_NAME_TEST(stl, queue)();
@@ -56863,9 +72731,19 @@ FIO_SFUNC void fio_test_dynamic_types(void) {
   FIO_NAME_TEST(stl, fiobj)();
   fprintf(stderr, "===============\n");
   FIO_NAME_TEST(stl, io)();
+  /* runs the IO reactor (the pub/sub tests clean up the reactor's state) */
+  FIO_NAME_TEST(stl, http_client_pool)();
+  FIO_NAME_TEST(stl, http_cache)();
   FIO_NAME_TEST(stl, pubsub)();
   fprintf(stderr, "===============\n");
   FIO_NAME_TEST(stl, http_s)();
+  FIO_NAME_TEST(stl, http_body_parsing)();
+  FIO_NAME_TEST(stl, http_router)();
+  fprintf(stderr, "===============\n");
+  FIO_NAME_TEST(stl, hpack)();
+  fprintf(stderr, "===============\n");
+  FIO_NAME_TEST(stl, websocket_deflate)();
+  FIO_NAME_TEST(stl, http_compress)();
   fprintf(stderr, "===============\n");
   FIO_NAME_TEST(stl, risky)();
   fprintf(stderr, "===============\n");
@@ -57010,6 +72888,9 @@ Finish testing segment
 #include "102 queue.h"
 #endif
 
+#if defined(FIO_JSON_SCHEMA) || defined(FIO_JSON_SCHEMA_NAME)
+#include "104 json schema.h"
+#endif
 #ifdef FIO_MUSTACHE
 #include "104 mustache.h"
 #endif
@@ -57076,6 +72957,10 @@ Finish testing segment
 #include "431 http handle.h"
 #endif
 
+#if defined(FIO_HTTP_ROUTER) && !defined(FIO___RECURSIVE_INCLUDE)
+#include "431 http router.h"
+#endif
+
 #if defined(FIO_HTTP) && !defined(FIO___RECURSIVE_INCLUDE)
 #include "439 http.h"
 #endif
@@ -57094,8 +72979,11 @@ Finish testing segment
 #include "902 fiobj.h"
 #include "902 glob matching.h"
 #include "902 http handle.h"
+#include "902 http router.h"
+#include "902 http.h"
 #include "902 imap.h"
 #include "902 io.h"
+#include "902 json schema.h"
 #include "902 math.h"
 #include "902 memalt.h"
 #include "902 mustache.h"
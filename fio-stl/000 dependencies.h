@@ -264,6 +264,11 @@ FIO_MAP Ordering & Naming Shortcut
 ***************************************************************************** */
 
 #if defined(FIO_HTTP)
+#undef FIO_HTTP_ROUTER
+#define FIO_HTTP_ROUTER
+#endif
+
+#if defined(FIO_HTTP) || defined(FIO_HTTP_ROUTER)
 #undef FIO_HTTP_HANDLE
 #define FIO_HTTP_HANDLE
 #endif
@@ -298,6 +303,16 @@ FIO_MAP Ordering & Naming Shortcut
 #define FIO_JSON
 #endif
 
+#if defined(FIO_JSON_SCHEMA_NAME)
+#undef FIO_JSON_SCHEMA
+#define FIO_JSON_SCHEMA
+#endif
+
+#if defined(FIO_JSON_SCHEMA)
+#undef FIO_JSON
+#define FIO_JSON
+#endif
+
 #if defined(FIO_HTTP)
 #undef FIO_HTTP1_PARSER
 #define FIO_HTTP1_PARSER
@@ -314,7 +329,8 @@ FIO_MAP Ordering & Naming Shortcut
 #endif
 
 #if defined(FIO_HTTP_HANDLE) || defined(FIO_QUEUE) || defined(FIO_FIOBJ) ||    \
-    defined(FIO_LEAK_COUNTER) || defined(FIO_MEMORY_NAME) || defined(FIO_POLL)
+    defined(FIO_LEAK_COUNTER) || defined(FIO_MEMORY_NAME) ||                   \
+    defined(FIO_POLL) || defined(FIO_MUSTACHE)
 #undef FIO_STATE
 #define FIO_STATE
 #endif
@@ -323,7 +339,8 @@ FIO_MAP Ordering & Naming Shortcut
     defined(FIO_STR_SMALL) || defined(FIO_ARRAY_TYPE_STR) ||                   \
     defined(FIO_MAP_KEY_KSTR) || defined(FIO_MAP_KEY_BSTR) ||                  \
     (defined(FIO_MAP_NAME) && !defined(FIO_MAP_KEY)) ||                        \
-    defined(FIO_MUSTACHE) || defined(FIO_MAP2_NAME)
+    defined(FIO_MUSTACHE) || defined(FIO_MAP2_NAME) ||                        \
+    defined(FIO_JSON_SCHEMA)
 #undef FIO_STR
 #define FIO_STR
 #endif
@@ -338,7 +355,7 @@ FIO_MAP Ordering & Naming Shortcut
 #define FIO_QUEUE
 #endif
 
-#if defined(FIO_HTTP_HANDLE) || defined(FIO_QUEUE)
+#if defined(FIO_HTTP_HANDLE) || defined(FIO_QUEUE) || defined(FIO_MUSTACHE)
 #undef FIO_TIME
 #define FIO_TIME
 #endif
@@ -396,7 +413,7 @@ FIO_MAP Ordering & Naming Shortcut
 #endif
 
 #if defined(FIO_CLI) || defined(FIO_MEMORY_NAME) || defined(FIO_POLL) ||       \
-    defined(FIO_STATE) || defined(FIO_HTTP_HANDLE)
+    defined(FIO_STATE) || defined(FIO_HTTP_HANDLE) || defined(FIO_MUSTACHE)
 #undef FIO_IMAP_CORE
 #define FIO_IMAP_CORE
 #endif
@@ -419,7 +436,7 @@ FIO_MAP Ordering & Naming Shortcut
 #endif
 
 #if defined(FIO_MEMORY_NAME) || defined(FIO_QUEUE) ||                          \
-    (defined(DEBUG) && defined(FIO_STATE))
+    defined(FIO_HTTP_HANDLE) || (defined(DEBUG) && defined(FIO_STATE))
 #undef FIO_THREADS
 #define FIO_THREADS
 #endif
@@ -251,6 +251,16 @@ Pointer Tagging
 #define FIO_PTR_TAG_VALIDATE(ptr) ((ptr) != NULL)
 #endif
 
+#ifndef FIO_PTR_TAG_VALIDATE_WRITE
+/**
+ * If FIO_PTR_TAG_VALIDATE_WRITE is defined, it will be verified (in addition to
+ * FIO_PTR_TAG_VALIDATE) before executing any code that mutates the object.
+ *
+ * This allows read-only objects to share the type's functions.
+ */
+#define FIO_PTR_TAG_VALIDATE_WRITE(ptr) 1
+#endif
+
 #undef FIO_PTR_TAG_VALID_OR_RETURN
 #define FIO_PTR_TAG_VALID_OR_RETURN(tagged_ptr, value)                         \
   do {                                                                         \
@@ -278,5 +288,33 @@ Pointer Tagging
     }                                                                          \
   } while (0)
 
+#undef FIO_PTR_TAG_WRITABLE_OR_RETURN
+#define FIO_PTR_TAG_WRITABLE_OR_RETURN(tagged_ptr, value)                      \
+  do {                                                                         \
+    if (!(FIO_PTR_TAG_VALIDATE_WRITE((tagged_ptr)))) {                         \
+      FIO_ASSERT_DEBUG(0, "attempting to mutate a read-only object.");         \
+      FIO_LOG_ERROR("attempting to mutate a read-only object (ignored).");     \
+      return (value);                                                          \
+    }                                                                          \
+  } while (0)
+#undef FIO_PTR_TAG_WRITABLE_OR_RETURN_VOID
+#define FIO_PTR_TAG_WRITABLE_OR_RETURN_VOID(tagged_ptr)                        \
+  do {                                                                         \
+    if (!(FIO_PTR_TAG_VALIDATE_WRITE((tagged_ptr)))) {                         \
+      FIO_ASSERT_DEBUG(0, "attempting to mutate a read-only object.");         \
+      FIO_LOG_ERROR("attempting to mutate a read-only object (ignored).");     \
+      return;                                                                  \
+    }                                                                          \
+  } while (0)
+#undef FIO_PTR_TAG_WRITABLE_OR_GOTO
+#define FIO_PTR_TAG_WRITABLE_OR_GOTO(tagged_ptr, lable)                        \
+  do {                                                                         \
+    if (!(FIO_PTR_TAG_VALIDATE_WRITE((tagged_ptr)))) {                         \
+      FIO_ASSERT_DEBUG(0, "attempting to mutate a read-only object.");         \
+      FIO_LOG_ERROR("attempting to mutate a read-only object (ignored).");     \
+      goto lable;                                                              \
+    }                                                                          \
+  } while (0)
+
 #define FIO_PTR_TAG_GET_UNTAGGED(untagged_type, tagged_ptr)                    \
   ((untagged_type *)(FIO_PTR_UNTAG((tagged_ptr))))
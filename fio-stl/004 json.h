@@ -27,6 +27,26 @@ Copyright and License: see header file (000 copyright.h) or top of file
 #define FIO_JSON_USE_FIO_ATON 0
 #endif
 
+#ifndef FIO_JSON_USE_INDEX
+/** Parses longer JSON data in two stages, using a (SIMD) structural index. */
+#define FIO_JSON_USE_INDEX 0
+#endif
+
+#ifndef FIO_JSON_INDEX_MIN
+/** JSON data shorter than this is parsed without a structural index. */
+#define FIO_JSON_INDEX_MIN 128
+#endif
+
+#ifndef FIO_JSON_INDEX_SIZE
+/** The number of structural index entries (4 bytes each) per indexing round. */
+#define FIO_JSON_INDEX_SIZE 2048
+#endif
+
+#ifndef FIO_JSON_STREAM_MAX_TOKEN
+/** The default size limit for a token (string / number) spanning chunks. */
+#define FIO_JSON_STREAM_MAX_TOKEN (1UL << 20)
+#endif
+
 /** The JSON parser settings. */
 typedef struct {
   /** NULL object was detected. Returns new object as `void *`. */
@@ -84,11 +104,72 @@ typedef struct {
  * Returns the number of bytes consumed before parsing stopped (due to either
  * error or end of data). Stops as close as possible to the end of the buffer or
  * once an object parsing was completed.
+ *
+ * JSON data longer than `FIO_JSON_INDEX_MIN` is parsed in two stages: a (SIMD)
+ * structural index is collected first and then walked to call the callbacks.
  */
 SFUNC fio_json_result_s fio_json_parse(fio_json_parser_callbacks_s *settings,
                                        const char *json_string,
                                        const size_t len);
 
+/* *****************************************************************************
+JSON Streaming (Push) Parser - API
+***************************************************************************** */
+
+/** A resumable JSON parser, fed using `fio_json_stream_write`. */
+typedef struct fio_json_stream_s fio_json_stream_s;
+
+/** Named arguments for `fio_json_stream_new`. */
+typedef struct {
+  /** The JSON parser callbacks (required, copied by the stream). */
+  fio_json_parser_callbacks_s *callbacks;
+  /** Called for every complete top-level JSON value (takes ownership). */
+  void (*on_json)(void *udata, void *value);
+  /** Opaque user data passed to `on_json`. */
+  void *udata;
+  /** Maximum nesting depth. Defaults to `FIO_JSON_MAX_DEPTH`. */
+  uint32_t max_depth;
+  /** Maximum bytes buffered for a single token that spans chunks. */
+  uint32_t max_token;
+  /** If set, the stream is NDJSON (one top-level value per line). */
+  uint8_t ndjson;
+} fio_json_stream_args_s;
+
+/**
+ * Creates a new resumable (push) JSON parser. Returns NULL on error.
+ *
+ * Data is fed in chunks of any size (split anywhere) using
+ * `fio_json_stream_write`, and every complete top-level value is passed to the
+ * `on_json` callback (or freed using `free_unused_object` if missing).
+ */
+SFUNC fio_json_stream_s *fio_json_stream_new(fio_json_stream_args_s args);
+/** Named arguments helper. See `fio_json_stream_args_s` for details. */
+#define fio_json_stream_new(...)                                               \
+  fio_json_stream_new((fio_json_stream_args_s){__VA_ARGS__})
+
+/**
+ * Parses the next chunk of JSON data. Returns -1 if an error occurred.
+ *
+ * On error, any partial data is passed to the `on_error` callback (that should
+ * free it). In NDJSON mode the offending line is skipped and parsing resumes
+ * on the next line, otherwise the stream ignores any data until reset by
+ * `fio_json_stream_finish`.
+ */
+SFUNC int fio_json_stream_write(fio_json_stream_s *s,
+                                const void *buf,
+                                size_t len);
+
+/**
+ * Marks the end of the input, completing a trailing top-level scalar.
+ *
+ * Returns -1 if the data was incomplete or invalid (for JSON streams, also if
+ * no value was parsed). The stream is reset and can be reused.
+ */
+SFUNC int fio_json_stream_finish(fio_json_stream_s *s);
+
+/** Frees the stream, discarding (freeing) any incomplete data. */
+SFUNC void fio_json_stream_free(fio_json_stream_s *s);
+
 /* *****************************************************************************
 JSON Parsing - Implementation - Helpers and Callbacks
 
@@ -484,6 +565,573 @@ void *fio___json_consume(fio___json_state_s *s) {
   }
 }
 
+/** An open collection, as tracked by the iterative parsers (internal use). */
+typedef struct {
+  /** The collection (as returned by `on_map` / `on_array`). */
+  void *ctx;
+  /** The key waiting for a value (maps only). */
+  void *key;
+  /** The collection's closing character. */
+  uintptr_t close;
+} fio___json_frame_s;
+
+/* *****************************************************************************
+JSON Parsing - Structural Index (Two Stage Parsing)
+
+Stage one classifies the JSON data in 64 byte blocks (using SIMD when
+available), marking quotes, backslashes, white space and structural characters
+in 64 bit bitmaps. Escaped quotes and string contents are masked away using bit
+arithmetic, and the positions of the structural characters, the string quotes
+and the first byte of any other value (numbers, `true`, `NaN`, etc') are
+collected in an index.
+
+Stage two walks the index (instead of the JSON bytes), calling the same
+callbacks as the recursive parser, using an explicit stack.
+
+Blocks with comments are indexed byte by byte (comments are skipped). The
+index is collected in rounds of up to `FIO_JSON_INDEX_SIZE` entries, so no
+memory is allocated.
+***************************************************************************** */
+#if FIO_JSON_USE_INDEX
+
+#if FIO_JSON_INDEX_SIZE < 64
+#error FIO_JSON_INDEX_SIZE must be at least 64 (the entries of a single block).
+#endif
+
+/** Marks the closing quote of a string that contains a backslash. */
+#define FIO___JSON_INDEX_ESCAPED ((uint32_t)1 << 31)
+/** The maximal number of entries a single block might add to the index. */
+#define FIO___JSON_INDEX_BLOCK 64
+
+/** The classification of a 64 byte block (internal use). */
+typedef struct {
+  /** Marks `'"'` bytes. */
+  uint64_t quote;
+  /** Marks `'\\'` bytes. */
+  uint64_t backslash;
+  /** Marks white space bytes (space, tab, CR and LF). */
+  uint64_t space;
+  /** Marks the `{`, `}`, `[`, `]`, `:` and `,` bytes. */
+  uint64_t op;
+  /** Marks the `/` and `#` bytes (possible comments). */
+  uint64_t comment;
+} fio___json_bitmap_s;
+
+/** The JSON structural index (internal use). */
+typedef struct {
+  /** The first byte of the JSON data (index positions are relative to it). */
+  const char *start;
+  /** The next byte to be indexed. */
+  const char *pos;
+  /** The end of the JSON data. */
+  const char *end;
+  /** All bits set if the last indexed block ended within a string. */
+  uint64_t in_string;
+  /** 1 if the first byte of the next block is escaped (by a backslash). */
+  uint64_t escaped;
+  /** 1 if the last indexed byte was part of a (non-string) value. */
+  uint64_t scalar;
+  /** `FIO___JSON_INDEX_ESCAPED` if the current string contains a backslash. */
+  uint32_t string_escaped;
+  /** The number of index entries. */
+  uint32_t count;
+  /** The number of index entries already consumed. */
+  uint32_t read;
+  /** The index entries. */
+  uint32_t at[FIO_JSON_INDEX_SIZE];
+} fio___json_index_s;
+
+/* marks (0x80) every zero byte in a 64 bit word (no false positives). */
+FIO_IFUNC uint64_t fio___json_swar_zero(uint64_t w) {
+  const uint64_t m = UINT64_C(0x7F7F7F7F7F7F7F7F);
+  return ~(((w & m) + m) | w | m);
+}
+
+#if FIO___HAS_X86_INTRIN && defined(__AVX2__)
+/* classifies 64 bytes using AVX2 (2 x 32 byte vectors). */
+FIO_IFUNC void fio___json_classify(fio___json_bitmap_s *m, const char *p) {
+  const __m256i v_quote = _mm256_set1_epi8('"');
+  const __m256i v_bs = _mm256_set1_epi8('\\');
+  const __m256i v_lower = _mm256_set1_epi8(0x20); /* '[' | 0x20 == '{' */
+  const __m256i v_open = _mm256_set1_epi8('{');
+  const __m256i v_close = _mm256_set1_epi8('}');
+  const __m256i v_colon = _mm256_set1_epi8(':');
+  const __m256i v_comma = _mm256_set1_epi8(',');
+  const __m256i v_sp = _mm256_set1_epi8(' ');
+  const __m256i v_tab = _mm256_set1_epi8('\t');
+  const __m256i v_lf = _mm256_set1_epi8('\n');
+  const __m256i v_cr = _mm256_set1_epi8('\r');
+  const __m256i v_slash = _mm256_set1_epi8('/');
+  const __m256i v_hash = _mm256_set1_epi8('#');
+  FIO_MEMSET(m, 0, sizeof(*m));
+  for (size_t i = 0; i < 64; i += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+    __m256i l = _mm256_or_si256(v, v_lower);
+    __m256i s = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, v_sp),
+                        _mm256_cmpeq_epi8(v, v_tab)),
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, v_lf),
+                        _mm256_cmpeq_epi8(v, v_cr)));
+    __m256i o = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(l, v_open),
+                        _mm256_cmpeq_epi8(l, v_close)),
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, v_colon),
+                        _mm256_cmpeq_epi8(v, v_comma)));
+    __m256i c = _mm256_or_si256(_mm256_cmpeq_epi8(v, v_slash),
+                                _mm256_cmpeq_epi8(v, v_hash));
+    m->quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(
+                    _mm256_cmpeq_epi8(v, v_quote))
+                << i;
+    m->backslash |=
+        (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, v_bs))
+        << i;
+    m->space |= (uint64_t)(uint32_t)_mm256_movemask_epi8(s) << i;
+    m->op |= (uint64_t)(uint32_t)_mm256_movemask_epi8(o) << i;
+    m->comment |= (uint64_t)(uint32_t)_mm256_movemask_epi8(c) << i;
+  }
+}
+
+#elif FIO___HAS_X86_INTRIN
+/* classifies 64 bytes using SSE2 (4 x 16 byte vectors). */
+FIO_IFUNC void fio___json_classify(fio___json_bitmap_s *m, const char *p) {
+  const __m128i v_quote = _mm_set1_epi8('"');
+  const __m128i v_bs = _mm_set1_epi8('\\');
+  const __m128i v_lower = _mm_set1_epi8(0x20); /* '[' | 0x20 == '{' */
+  const __m128i v_open = _mm_set1_epi8('{');
+  const __m128i v_close = _mm_set1_epi8('}');
+  const __m128i v_colon = _mm_set1_epi8(':');
+  const __m128i v_comma = _mm_set1_epi8(',');
+  const __m128i v_sp = _mm_set1_epi8(' ');
+  const __m128i v_tab = _mm_set1_epi8('\t');
+  const __m128i v_lf = _mm_set1_epi8('\n');
+  const __m128i v_cr = _mm_set1_epi8('\r');
+  const __m128i v_slash = _mm_set1_epi8('/');
+  const __m128i v_hash = _mm_set1_epi8('#');
+  FIO_MEMSET(m, 0, sizeof(*m));
+  for (size_t i = 0; i < 64; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+    __m128i l = _mm_or_si128(v, v_lower);
+    __m128i s = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, v_sp), _mm_cmpeq_epi8(v, v_tab)),
+        _mm_or_si128(_mm_cmpeq_epi8(v, v_lf), _mm_cmpeq_epi8(v, v_cr)));
+    __m128i o = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(l, v_open), _mm_cmpeq_epi8(l, v_close)),
+        _mm_or_si128(_mm_cmpeq_epi8(v, v_colon), _mm_cmpeq_epi8(v, v_comma)));
+    __m128i c =
+        _mm_or_si128(_mm_cmpeq_epi8(v, v_slash), _mm_cmpeq_epi8(v, v_hash));
+    m->quote |=
+        (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, v_quote)) << i;
+    m->backslash |=
+        (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, v_bs)) << i;
+    m->space |= (uint64_t)(uint16_t)_mm_movemask_epi8(s) << i;
+    m->op |= (uint64_t)(uint16_t)_mm_movemask_epi8(o) << i;
+    m->comment |= (uint64_t)(uint16_t)_mm_movemask_epi8(c) << i;
+  }
+}
+
+#elif FIO___HAS_ARM_INTRIN && defined(__aarch64__)
+/* packs four NEON comparison results (0xFF / 0x00 bytes) into a bitmap. */
+FIO_IFUNC uint64_t fio___json_neon2bitmap(uint8x16_t a,
+                                          uint8x16_t b,
+                                          uint8x16_t c,
+                                          uint8x16_t d) {
+  const uint8x16_t bits =
+      {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+  a = vpaddq_u8(vandq_u8(a, bits), vandq_u8(b, bits));
+  c = vpaddq_u8(vandq_u8(c, bits), vandq_u8(d, bits));
+  a = vpaddq_u8(a, c);
+  a = vpaddq_u8(a, a);
+  return vgetq_lane_u64(vreinterpretq_u64_u8(a), 0);
+}
+
+/* classifies 64 bytes using NEON (4 x 16 byte vectors). */
+FIO_IFUNC void fio___json_classify(fio___json_bitmap_s *m, const char *p) {
+  const uint8x16_t v_lower = vdupq_n_u8(0x20); /* '[' | 0x20 == '{' */
+  uint8x16_t q[4], b[4], s[4], o[4], c[4];
+  for (size_t i = 0; i < 4; ++i) {
+    uint8x16_t v = vld1q_u8((const uint8_t *)p + (i << 4));
+    uint8x16_t l = vorrq_u8(v, v_lower);
+    q[i] = vceqq_u8(v, vdupq_n_u8('"'));
+    b[i] = vceqq_u8(v, vdupq_n_u8('\\'));
+    s[i] = vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8(' ')),
+                             vceqq_u8(v, vdupq_n_u8('\t'))),
+                    vorrq_u8(vceqq_u8(v, vdupq_n_u8('\n')),
+                             vceqq_u8(v, vdupq_n_u8('\r'))));
+    o[i] = vorrq_u8(vorrq_u8(vceqq_u8(l, vdupq_n_u8('{')),
+                             vceqq_u8(l, vdupq_n_u8('}'))),
+                    vorrq_u8(vceqq_u8(v, vdupq_n_u8(':')),
+                             vceqq_u8(v, vdupq_n_u8(','))));
+    c[i] = vorrq_u8(vceqq_u8(v, vdupq_n_u8('/')), vceqq_u8(v, vdupq_n_u8('#')));
+  }
+  m->quote = fio___json_neon2bitmap(q[0], q[1], q[2], q[3]);
+  m->backslash = fio___json_neon2bitmap(b[0], b[1], b[2], b[3]);
+  m->space = fio___json_neon2bitmap(s[0], s[1], s[2], s[3]);
+  m->op = fio___json_neon2bitmap(o[0], o[1], o[2], o[3]);
+  m->comment = fio___json_neon2bitmap(c[0], c[1], c[2], c[3]);
+}
+
+#else
+/* packs the 0x80 bits of a little endian word into an 8 bit bitmap. */
+#define FIO___JSON_SWAR_PACK(w)                                                \
+  ((((w) >> 7) * UINT64_C(0x0102040810204080)) >> 56)
+
+/* classifies 64 bytes using SWAR (8 x 8 byte words). */
+FIO_IFUNC void fio___json_classify(fio___json_bitmap_s *m, const char *p) {
+  const uint64_t bytes = UINT64_C(0x0101010101010101);
+  FIO_MEMSET(m, 0, sizeof(*m));
+  for (size_t i = 0; i < 64; i += 8) {
+    uint64_t w = fio_buf2u64_le(p + i);
+    uint64_t l = w | (bytes * 0x20); /* '[' | 0x20 == '{' */
+    uint64_t s = fio___json_swar_zero(w ^ (bytes * ' ')) |
+                 fio___json_swar_zero(w ^ (bytes * '\t')) |
+                 fio___json_swar_zero(w ^ (bytes * '\n')) |
+                 fio___json_swar_zero(w ^ (bytes * '\r'));
+    uint64_t o = fio___json_swar_zero(l ^ (bytes * '{')) |
+                 fio___json_swar_zero(l ^ (bytes * '}')) |
+                 fio___json_swar_zero(w ^ (bytes * ':')) |
+                 fio___json_swar_zero(w ^ (bytes * ','));
+    uint64_t c = fio___json_swar_zero(w ^ (bytes * '/')) |
+                 fio___json_swar_zero(w ^ (bytes * '#'));
+    m->quote |= FIO___JSON_SWAR_PACK(fio___json_swar_zero(w ^ (bytes * '"')))
+                << i;
+    m->backslash |=
+        FIO___JSON_SWAR_PACK(fio___json_swar_zero(w ^ (bytes * '\\'))) << i;
+    m->space |= FIO___JSON_SWAR_PACK(s) << i;
+    m->op |= FIO___JSON_SWAR_PACK(o) << i;
+    m->comment |= FIO___JSON_SWAR_PACK(c) << i;
+  }
+}
+#undef FIO___JSON_SWAR_PACK
+#endif /* FIO___HAS_X86_INTRIN / FIO___HAS_ARM_INTRIN */
+
+/* sets every bit between an odd and an even set bit (string contents). */
+FIO_IFUNC uint64_t fio___json_prefix_xor(uint64_t x) {
+#if FIO___HAS_X86_INTRIN && defined(__PCLMUL__)
+  return (uint64_t)_mm_cvtsi128_si64(
+      _mm_clmulepi64_si128(_mm_set_epi64x(0, (long long)x),
+                           _mm_set1_epi8((char)0xFF),
+                           0));
+#else
+  x ^= x << 1;
+  x ^= x << 2;
+  x ^= x << 4;
+  x ^= x << 8;
+  x ^= x << 16;
+  x ^= x << 32;
+  return x;
+#endif
+}
+
+/* returns the first byte following a comment (for EOL comments, the EOL). */
+FIO_SFUNC const char *fio___json_index_comment(const char *p, const char *end) {
+  if (*p == '#' || p[1] == '/') {
+    p = (const char *)FIO_MEMCHR(p, '\n', (size_t)(end - p));
+    return (p ? p : end);
+  }
+  for (p += 2; p + 1 < end; ++p) {
+    if (p[0] == '*' && p[1] == '/')
+      return p + 2;
+  }
+  return end;
+}
+
+/* indexes the next 64 bytes (or more, for comments), one byte at a time. */
+FIO_SFUNC void fio___json_index_bytes(fio___json_index_s *ix) {
+  const char *p = ix->pos;
+  const char *stop = (ix->end - p > 64) ? p + 64 : ix->end;
+  uint64_t in_string = ix->in_string & 1;
+  uint64_t escaped = ix->escaped;
+  uint64_t scalar = ix->scalar;
+  while (p < stop) {
+    const uint32_t offset = (uint32_t)(p - ix->start);
+    if (in_string) {
+      if (escaped) {
+        escaped = 0;
+      } else if (*p == '\\') {
+        escaped = 1;
+        ix->string_escaped = FIO___JSON_INDEX_ESCAPED;
+      } else if (*p == '"') {
+        ix->at[ix->count++] = offset | ix->string_escaped;
+        ix->string_escaped = 0;
+        in_string = 0;
+      }
+      scalar = 0;
+      ++p;
+      continue;
+    }
+    switch (*p) {
+    case 0x09: /* fall through */
+    case 0x0A: /* fall through */
+    case 0x0D: /* fall through */
+    case 0x20: scalar = 0; break;
+    case '"': in_string = 1; /* fall through */
+    case '{':                /* fall through */
+    case '}':                /* fall through */
+    case '[':                /* fall through */
+    case ']':                /* fall through */
+    case ':':                /* fall through */
+    case ',':
+      ix->at[ix->count++] = offset;
+      scalar = 0;
+      break;
+    case '#':
+      p = fio___json_index_comment(p, ix->end);
+      scalar = 0;
+      continue;
+    case '/':
+      if (p + 1 < ix->end && (p[1] == '/' || p[1] == '*')) {
+        p = fio___json_index_comment(p, ix->end);
+        scalar = 0;
+        continue;
+      }
+      /* fall through */
+    default:
+      if (!scalar)
+        ix->at[ix->count++] = offset;
+      scalar = 1;
+    }
+    ++p;
+  }
+  ix->pos = p;
+  ix->in_string = (uint64_t)0 - in_string;
+  ix->escaped = escaped;
+  ix->scalar = scalar;
+}
+
+/* indexes the next 64 bytes (stage one). */
+FIO_SFUNC void fio___json_index_block(fio___json_index_s *ix) {
+  const uint64_t even = UINT64_C(0x5555555555555555);
+  char tmp[64] FIO_ALIGN(16);
+  const char *p = ix->pos;
+  const uint32_t offset = (uint32_t)(p - ix->start);
+  const size_t len = (size_t)(ix->end - p);
+  uint32_t *dest = ix->at + ix->count;
+  fio___json_bitmap_s m;
+  uint64_t bs, follows, seq, escaped, quote, in_string, scalar, bits, clean, c;
+  if (len < 64) { /* pad with white space */
+    FIO_MEMSET(tmp, ' ', 64);
+    FIO_MEMCPY(tmp, p, len);
+    p = tmp;
+  }
+  fio___json_classify(&m, p);
+  /* escaped bytes follow an odd sequence of backslashes */
+  bs = m.backslash & ~ix->escaped;
+  follows = (bs << 1) | ix->escaped;
+  seq = (bs & ~even & ~follows) + bs;
+  escaped = (even ^ (seq << 1)) & follows;
+  quote = m.quote & ~escaped;
+  in_string = fio___json_prefix_xor(quote) ^ ix->in_string;
+  if (FIO_UNLIKELY(m.comment & ~in_string)) {
+    fio___json_index_bytes(ix);
+    return;
+  }
+  ix->escaped = (seq < bs);
+  /* closing quotes reached by a carry (from the opening quote) are clean */
+  c = in_string & ~m.backslash;
+  clean = c + (quote & in_string);
+  bits = (clean < c);
+  c = clean;
+  clean += (ix->in_string & 1) & !ix->string_escaped;
+  bits |= (clean < c);
+  ix->in_string = (uint64_t)((int64_t)in_string >> 63);
+  ix->string_escaped = (uint32_t)(ix->in_string & (bits ^ 1)) << 31;
+  clean = quote & ~in_string & ~clean; /* closing quotes with a backslash */
+  /* the first byte of every value that isn't a string or a collection */
+  scalar = ~(m.op | m.space | quote);
+  bits = scalar & ~((scalar << 1) | ix->scalar);
+  ix->scalar = scalar >> 63;
+  bits = ((m.op | bits) & ~in_string) | quote;
+  ix->pos = (len < 64) ? ix->end : ix->pos + 64;
+  c = (uint64_t)fio_popcount(bits);
+  ix->count += (uint32_t)c;
+  /* writes 8 entries at a time (extra entries are ignored / overwritten) */
+  for (;;) {
+    for (size_t k = 0; k < 8; ++k) {
+      const uint32_t i =
+          (uint32_t)fio_lsb_index_unsafe(bits | ((uint64_t)1 << 63));
+      bits &= bits - 1;
+      dest[k] = (offset + i) | ((uint32_t)(clean >> i) << 31);
+    }
+    if (c <= 8)
+      return;
+    c -= 8;
+    dest += 8;
+  }
+}
+
+/* collects the next round of index entries, returns the number of entries. */
+FIO_SFUNC uint32_t fio___json_index_fill(fio___json_index_s *ix) {
+  ix->count = ix->read = 0;
+  while (ix->pos < ix->end &&
+         ix->count + FIO___JSON_INDEX_BLOCK <= FIO_JSON_INDEX_SIZE)
+    fio___json_index_block(ix);
+  return ix->count;
+}
+
+/* returns the next index entry (a position), or -1 at the end of the data. */
+FIO_IFUNC int64_t fio___json_index_next(fio___json_index_s *ix) {
+  if (FIO_UNLIKELY(ix->read == ix->count) && !fio___json_index_fill(ix))
+    return -1;
+  return (int64_t)ix->at[ix->read++];
+}
+
+/* parses a single JSON value using the structural index (stage two). */
+FIO_SFUNC void *fio___json_consume_indexed(fio___json_state_s *s) {
+  fio___json_index_s ix;
+  fio___json_frame_s stack[FIO_JSON_MAX_DEPTH];
+  fio___json_frame_s *f = NULL;
+  const char *p = s->pos;
+  const char *after;
+  void *value = NULL;
+  int64_t e;
+  ix.start = ix.pos = s->pos;
+  ix.end = s->end;
+  ix.in_string = ix.escaped = ix.scalar = 0;
+  ix.string_escaped = ix.count = ix.read = 0;
+
+  if ((e = fio___json_index_next(&ix)) < 0)
+    goto error;
+  p = ix.start + e;
+
+parse_value:
+  switch (*p) {
+  case '{': /* fall through */
+  case '[':
+    if (s->depth + 1 >= FIO_JSON_MAX_DEPTH)
+      goto error;
+    f = stack + s->depth++;
+    f->key = NULL;
+    f->close = (uintptr_t)(*p + 2); /* '{' + 2 == '}', '[' + 2 == ']' */
+    f->ctx = (*p == '{' ? s->cb.on_map : s->cb.on_array)(s, s->key);
+    s->key = NULL;
+    if ((e = fio___json_index_next(&ix)) < 0)
+      goto error;
+    p = ix.start + e;
+    if ((uintptr_t)*p == f->close)
+      goto collection_done;
+    if (f->close == '}')
+      goto parse_key;
+    goto parse_value;
+  case '"':
+    if ((e = fio___json_index_next(&ix)) < 0)
+      goto error;
+    after = ix.start + (e & ~(int64_t)FIO___JSON_INDEX_ESCAPED);
+    value = ((e & FIO___JSON_INDEX_ESCAPED) ? s->cb.on_string
+                                            : s->cb.on_string_simple)(
+        p + 1,
+        (size_t)(after - (p + 1)));
+    ++after;
+    break;
+  case '}': /* fall through */
+  case ']': /* fall through */
+  case ':': /* fall through */
+  case ',': goto error;
+  default:
+    s->pos = p;
+    value = fio___json_consume(s);
+    after = s->pos;
+  }
+
+value_done:
+  if (!s->depth) {
+    s->pos = after;
+    return value;
+  }
+  f = stack + s->depth - 1;
+  if (f->close == '}') {
+    if (value)
+      s->error |= s->cb.map_push(f->ctx, f->key, value);
+    else
+      s->cb.free_unused_object(f->key);
+    f->key = s->key = NULL;
+  } else if (value) {
+    s->error |= s->cb.array_push(f->ctx, value);
+  }
+  value = NULL;
+  if (s->error || (e = fio___json_index_next(&ix)) < 0)
+    goto error;
+  p = ix.start + e;
+  if (after < p && !(((uint8_t)*after == 0x09U) | ((uint8_t)*after == 0x0AU) |
+                     ((uint8_t)*after == 0x0DU) | ((uint8_t)*after == 0x20U)))
+    goto error; /* value followed by garbage */
+  if ((uintptr_t)*p == f->close)
+    goto collection_done;
+  if (*p != ',' || (e = fio___json_index_next(&ix)) < 0)
+    goto error;
+  p = ix.start + e;
+  if ((uintptr_t)*p == f->close) /* trailing comma */
+    goto collection_done;
+  if (f->close == ']')
+    goto parse_value;
+
+parse_key:
+  switch (*p) {
+  case '"':
+    if ((e = fio___json_index_next(&ix)) < 0)
+      goto error;
+    after = ix.start + (e & ~(int64_t)FIO___JSON_INDEX_ESCAPED);
+    f->key = ((e & FIO___JSON_INDEX_ESCAPED) ? s->cb.on_string
+                                             : s->cb.on_string_simple)(
+        p + 1,
+        (size_t)(after - (p + 1)));
+    ++after;
+    break;
+  case '{': /* fall through */
+  case '}': /* fall through */
+  case '[': /* fall through */
+  case ']': /* fall through */
+  case ':': /* fall through */
+  case ',': goto error;
+  default:
+    s->pos = p;
+    f->key = fio___json_consume(s);
+    after = s->pos;
+  }
+  if (s->error || !(s->key = f->key) || (e = fio___json_index_next(&ix)) < 0)
+    goto error;
+  p = ix.start + e;
+  if (*p != ':' ||
+      (after < p && !(((uint8_t)*after == 0x09U) | ((uint8_t)*after == 0x0AU) |
+                      ((uint8_t)*after == 0x0DU) | ((uint8_t)*after == 0x20U))))
+    goto error;
+  if ((e = fio___json_index_next(&ix)) < 0)
+    goto error;
+  p = ix.start + e;
+  goto parse_value;
+
+collection_done:
+  --s->depth;
+  s->error |= (f->close == '}' ? s->cb.map_finished : s->cb.array_finished)(
+      f->ctx);
+  value = f->ctx;
+  after = p + 1;
+  goto value_done;
+
+error:
+  /* close any open collections, adding each to its parent (as in recursion) */
+  s->error = 1;
+  s->pos = p;
+  while (s->depth) {
+    f = stack + --s->depth;
+    if (value) {
+      if (f->close == ']')
+        s->cb.array_push(f->ctx, value);
+      else if (f->key)
+        s->cb.map_push(f->ctx, f->key, value);
+      else
+        s->cb.free_unused_object(value);
+      f->key = NULL;
+    }
+    if (f->key)
+      s->cb.free_unused_object(f->key);
+    (f->close == '}' ? s->cb.map_finished : s->cb.array_finished)(f->ctx);
+    value = f->ctx;
+  }
+  return value;
+}
+#undef FIO___JSON_INDEX_BLOCK
+#endif /* FIO_JSON_USE_INDEX */
+
 static int fio___json_callback_noop(void *ctx) {
   return 0;
   (void)ctx;
@@ -560,7 +1208,12 @@ SFUNC fio_json_result_s fio_json_parse(fio_json_parser_callbacks_s *callbacks,
     if (len == 3)
       goto finish;
   }
-  r.ctx = fio___json_consume(&state);
+#if FIO_JSON_USE_INDEX
+  if (len >= FIO_JSON_INDEX_MIN && len < ((size_t)1 << 31))
+    r.ctx = fio___json_consume_indexed(&state);
+  else
+#endif
+    r.ctx = fio___json_consume(&state);
   r.err = state.error;
   r.stop_pos = state.pos - start;
   if (state.error)
@@ -668,6 +1321,565 @@ missing_callback:
   r.err = 1;
   return r;
 }
+
+/* *****************************************************************************
+JSON Streaming (Push) Parser - Implementation
+
+The stream is a state machine, fed byte ranges of any length. Collections are
+tracked using an explicit (heap allocated) stack, so nesting is limited only by
+`max_depth`. Strings and scalars (numbers, `true`, `null`, etc') found within a
+single chunk are parsed in place. Tokens that span chunks are copied to a
+token buffer (limited to `max_token` bytes) until they are complete.
+
+Scalars are complete once a delimiter is found, so a top-level scalar at the
+end of the data is only completed by `fio_json_stream_finish`.
+***************************************************************************** */
+
+/* stream states */
+typedef enum {
+  /* expecting a value (top-level, after `:` or after `,` in an array) */
+  FIO___JSON_STREAM_VALUE = 0,
+  /* expecting a value or `]` (after `[` or after `,` in an array) */
+  FIO___JSON_STREAM_VALUE_OR_CLOSE,
+  /* expecting a key or `}` (after `{` or after `,` in a map) */
+  FIO___JSON_STREAM_KEY_OR_CLOSE,
+  /* expecting `:` */
+  FIO___JSON_STREAM_COLON,
+  /* expecting `,` or the end of the collection */
+  FIO___JSON_STREAM_NEXT,
+  /* top-level value was parsed (JSON mode), expecting only white space */
+  FIO___JSON_STREAM_DONE,
+  /* in a string */
+  FIO___JSON_STREAM_STRING,
+  /* in a scalar (number, `true`, etc') */
+  FIO___JSON_STREAM_SCALAR,
+  /* a `/` was found, expecting `/` or `*` */
+  FIO___JSON_STREAM_COMMENT_START,
+  /* in an EOL comment */
+  FIO___JSON_STREAM_COMMENT_LINE,
+  /* in a C style comment */
+  FIO___JSON_STREAM_COMMENT_BLOCK,
+  /* skipping an invalid NDJSON line */
+  FIO___JSON_STREAM_SKIP_LINE,
+  /* parsing failed (JSON mode), waiting for `fio_json_stream_finish` */
+  FIO___JSON_STREAM_ERROR,
+} fio___json_stream_state_e;
+
+struct fio_json_stream_s {
+  /* the parser state used for scalars (and passed to `on_map` / `on_array`) */
+  fio___json_state_s parser;
+  void (*on_json)(void *udata, void *value);
+  void *udata;
+  /* open collections */
+  fio___json_frame_s *stack;
+  /* token buffer, for tokens that span chunks (NUL terminated) */
+  char *token;
+  size_t token_capa;
+  uint32_t token_len;
+  uint32_t max_token;
+  uint32_t depth;
+  uint32_t stack_capa;
+  uint32_t max_depth;
+  /* a `fio___json_stream_state_e` value */
+  uint8_t state;
+  /* the state to resume once a comment ends */
+  uint8_t resume;
+  /* the string / scalar being parsed is a map key */
+  uint8_t is_key;
+  /* the last string byte was a backslash */
+  uint8_t escaped;
+  /* the string contains escaped characters */
+  uint8_t has_escape;
+  /* the last C style comment byte was a star */
+  uint8_t star;
+  uint8_t ndjson;
+  /* the number of BOM bytes skipped (3 once a non-BOM byte was found) */
+  uint8_t bom;
+};
+
+/* appends data to the token buffer, returns -1 if the token is too long. */
+FIO_SFUNC int fio___json_stream_token_write(fio_json_stream_s *s,
+                                            const char *buf,
+                                            size_t len) {
+  size_t need = (size_t)s->token_len + len;
+  if (need > s->max_token)
+    return -1;
+  if (need >= s->token_capa) {
+    size_t capa = (need + 1 + 4095) & ~(size_t)4095;
+    char *tmp =
+        (char *)FIO_MEM_REALLOC_(s->token, s->token_capa, capa, s->token_len);
+    if (!tmp)
+      return -1;
+    s->token = tmp;
+    s->token_capa = capa;
+  }
+  FIO_MEMCPY(s->token + s->token_len, buf, len);
+  s->token_len = (uint32_t)need;
+  s->token[need] = 0;
+  return 0;
+}
+
+/* parses a complete scalar token (followed by a delimiter or NUL). */
+FIO_SFUNC int fio___json_stream_scalar(fio_json_stream_s *s,
+                                       void **value,
+                                       const char *token,
+                                       size_t len) {
+  s->parser.pos = token;
+  s->parser.end = token + len;
+  s->parser.error = 0;
+  *value = fio___json_consume(&s->parser);
+  if (!s->parser.error && s->parser.pos == s->parser.end)
+    return 0;
+  if (*value)
+    s->parser.cb.free_unused_object(*value);
+  *value = NULL;
+  return -1;
+}
+
+/* routes a complete value to its collection (or to `on_json`). */
+FIO_SFUNC int fio___json_stream_push(fio_json_stream_s *s, void *value) {
+  fio___json_frame_s *f;
+  int err = 0;
+  if (!s->depth) {
+    if (s->on_json)
+      s->on_json(s->udata, value);
+    else if (value)
+      s->parser.cb.free_unused_object(value);
+    s->state = (s->ndjson ? FIO___JSON_STREAM_VALUE : FIO___JSON_STREAM_DONE);
+    return 0;
+  }
+  f = s->stack + s->depth - 1;
+  s->state = FIO___JSON_STREAM_NEXT;
+  if (f->close == '}') {
+    if (value)
+      err = s->parser.cb.map_push(f->ctx, f->key, value);
+    else
+      s->parser.cb.free_unused_object(f->key);
+    f->key = NULL;
+    return err;
+  }
+  if (value)
+    err = s->parser.cb.array_push(f->ctx, value);
+  return err;
+}
+
+/* closes open collections (passing the result to `on_error`), and returns
+ * the position where parsing should resume. */
+FIO_SFUNC const char *fio___json_stream_fail(fio_json_stream_s *s,
+                                             void *value,
+                                             const char *pos,
+                                             const char *end) {
+  fio___json_frame_s *f;
+  while (s->depth) {
+    f = s->stack + --s->depth;
+    if (value) {
+      if (f->close == ']')
+        s->parser.cb.array_push(f->ctx, value);
+      else if (f->key)
+        s->parser.cb.map_push(f->ctx, f->key, value);
+      else
+        s->parser.cb.free_unused_object(value);
+      f->key = NULL;
+    }
+    if (f->key)
+      s->parser.cb.free_unused_object(f->key);
+    (f->close == '}' ? s->parser.cb.map_finished
+                     : s->parser.cb.array_finished)(f->ctx);
+    value = f->ctx;
+  }
+  if (value)
+    s->parser.cb.on_error(value);
+  s->token_len = 0;
+  s->is_key = 0;
+  if (!s->ndjson) {
+    s->state = FIO___JSON_STREAM_ERROR;
+    return end;
+  }
+  if (pos < end && *pos == '\n') {
+    s->state = FIO___JSON_STREAM_VALUE;
+    return pos + 1;
+  }
+  s->state = FIO___JSON_STREAM_SKIP_LINE;
+  return pos;
+}
+
+/* resets the stream, discarding any incomplete data. */
+FIO_SFUNC void fio___json_stream_reset(fio_json_stream_s *s) {
+  if (s->depth)
+    fio___json_stream_fail(s, NULL, NULL, NULL);
+  s->state = FIO___JSON_STREAM_VALUE;
+  s->token_len = 0;
+  s->is_key = s->escaped = s->has_escape = s->star = s->bom = 0;
+}
+
+/** Creates a new resumable (push) JSON parser. Returns NULL on error. */
+SFUNC fio_json_stream_s *fio_json_stream_new FIO_NOOP(
+    fio_json_stream_args_s args) {
+  fio_json_stream_s *s;
+  if (fio___json_callbacks_validate(args.callbacks))
+    goto missing_callback;
+  s = (fio_json_stream_s *)FIO_MEM_REALLOC_(NULL, 0, sizeof(*s), 0);
+  if (!s)
+    return s;
+  *s = (fio_json_stream_s){
+      .parser = {.cb = args.callbacks[0]},
+      .on_json = args.on_json,
+      .udata = args.udata,
+      .max_token = (args.max_token ? args.max_token
+                                   : (uint32_t)FIO_JSON_STREAM_MAX_TOKEN),
+      .max_depth = (args.max_depth ? args.max_depth : FIO_JSON_MAX_DEPTH),
+      .ndjson = (uint8_t)!!args.ndjson,
+  };
+  return s;
+missing_callback:
+  FIO_LOG_ERROR("JSON parser missing a critical callback!");
+  return NULL;
+}
+
+/** Frees the stream, discarding (freeing) any incomplete data. */
+SFUNC void fio_json_stream_free(fio_json_stream_s *s) {
+  if (!s)
+    return;
+  fio___json_stream_reset(s);
+  FIO_MEM_FREE_(s->stack, sizeof(*s->stack) * s->stack_capa);
+  FIO_MEM_FREE_(s->token, s->token_capa);
+  FIO_MEM_FREE_(s, sizeof(*s));
+}
+
+/** Parses the next chunk of JSON data. Returns -1 if an error occurred. */
+SFUNC int fio_json_stream_write(fio_json_stream_s *s,
+                                const void *buf,
+                                size_t len) {
+  const char *pos = (const char *)buf;
+  const char *end = pos + len;
+  const char *start = pos; /* start of a string / scalar in this chunk */
+  const char *tmp;
+  const char *quote;
+  const char *esc;
+  const char *token;
+  fio___json_frame_s *f;
+  void *value;
+  size_t token_len;
+  int r = 0;
+  if (!s || (!buf && len))
+    return -1;
+  if (s->state == FIO___JSON_STREAM_ERROR)
+    return -1;
+  if (s->bom < 3) { /* skip BOM, if exists (might be split between chunks) */
+    while (s->bom < 3 && pos < end && *pos == "\xEF\xBB\xBF"[s->bom]) {
+      ++pos;
+      ++s->bom;
+    }
+    if (pos < end)
+      s->bom = 3;
+  }
+
+  while (pos < end) {
+    value = NULL;
+    switch ((fio___json_stream_state_e)s->state) {
+    case FIO___JSON_STREAM_STRING:
+      tmp = pos;
+      quote = NULL;
+      for (;;) {
+        if (s->escaped) { /* skip the escaped byte */
+          s->escaped = 0;
+          if (++pos == end)
+            break;
+        }
+        if (!quote || quote < pos) { /* (re)search for the closing quote */
+          quote = (const char *)FIO_MEMCHR(pos, '"', (size_t)(end - pos));
+          if (!quote)
+            quote = end;
+        }
+        esc = (const char *)FIO_MEMCHR(pos, '\\', (size_t)(quote - pos));
+        if (!esc) {
+          pos = quote;
+          break;
+        }
+        s->has_escape = 1;
+        s->escaped = 1;
+        pos = esc + 1;
+        if (pos == end)
+          break;
+      }
+      if (s->ndjson && (tmp = (const char *)FIO_MEMCHR(tmp,
+                                                       '\n',
+                                                       (size_t)(pos - tmp)))) {
+        pos = tmp; /* strings can't span NDJSON lines */
+        goto error;
+      }
+      if (pos == end)
+        continue; /* the string continues in the next chunk */
+      token = start;
+      token_len = (size_t)(pos - start);
+      if (s->token_len) {
+        if (fio___json_stream_token_write(s, start, token_len))
+          goto error;
+        token = s->token;
+        token_len = s->token_len;
+      }
+      value = (s->has_escape ? s->parser.cb.on_string
+                             : s->parser.cb.on_string_simple)(token, token_len);
+      s->token_len = 0;
+      ++pos;
+      goto value_done;
+
+    case FIO___JSON_STREAM_SCALAR:
+      for (; pos < end; ++pos) {
+        switch (*pos) {
+        case 0x09: /* fall through */
+        case 0x0A: /* fall through */
+        case 0x0D: /* fall through */
+        case 0x20: /* fall through */
+        case ',':  /* fall through */
+        case ':':  /* fall through */
+        case '[':  /* fall through */
+        case ']':  /* fall through */
+        case '{':  /* fall through */
+        case '}':  /* fall through */
+        case '"':  /* fall through */
+        case '/':  /* fall through */
+        case '#': goto scalar_done;
+        }
+      }
+      continue; /* the scalar continues in the next chunk */
+    scalar_done:
+      token = start;
+      token_len = (size_t)(pos - start);
+      if (s->token_len) {
+        if (fio___json_stream_token_write(s, start, token_len))
+          goto error;
+        token = s->token;
+        token_len = s->token_len;
+      }
+      if (fio___json_stream_scalar(s, &value, token, token_len))
+        goto error;
+      s->token_len = 0;
+      goto value_done;
+
+    case FIO___JSON_STREAM_COMMENT_START:
+      if (*pos == '/')
+        s->state = FIO___JSON_STREAM_COMMENT_LINE;
+      else if (*pos == '*')
+        s->state = FIO___JSON_STREAM_COMMENT_BLOCK;
+      else
+        goto error;
+      s->star = 0;
+      ++pos;
+      continue;
+
+    case FIO___JSON_STREAM_COMMENT_LINE:
+      tmp = (const char *)FIO_MEMCHR(pos, '\n', (size_t)(end - pos));
+      if (!tmp) {
+        pos = end;
+        continue;
+      }
+      pos = tmp; /* the new line is consumed as white space */
+      s->state = s->resume;
+      continue;
+
+    case FIO___JSON_STREAM_COMMENT_BLOCK:
+      while (pos < end) {
+        const char c = *(pos++);
+        if (s->star && c == '/') {
+          s->state = s->resume;
+          break;
+        }
+        s->star = (c == '*');
+      }
+      continue;
+
+    case FIO___JSON_STREAM_SKIP_LINE:
+      tmp = (const char *)FIO_MEMCHR(pos, '\n', (size_t)(end - pos));
+      if (!tmp) {
+        pos = end;
+        continue;
+      }
+      pos = tmp + 1;
+      s->state = FIO___JSON_STREAM_VALUE;
+      continue;
+
+    case FIO___JSON_STREAM_ERROR: return -1;
+
+    case FIO___JSON_STREAM_VALUE:          /* fall through */
+    case FIO___JSON_STREAM_VALUE_OR_CLOSE: /* fall through */
+    case FIO___JSON_STREAM_KEY_OR_CLOSE:   /* fall through */
+    case FIO___JSON_STREAM_COLON:          /* fall through */
+    case FIO___JSON_STREAM_NEXT:           /* fall through */
+    case FIO___JSON_STREAM_DONE: break;
+    }
+
+    /* states expecting white space, a structural character or a value */
+    switch (*pos) {
+    case 0x0A:
+      if (s->ndjson && s->depth)
+        goto error; /* values can't span NDJSON lines */
+      /* fall through */
+    case 0x09: /* fall through */
+    case 0x0D: /* fall through */
+    case 0x20: ++pos; continue;
+    case '#':
+      s->resume = s->state;
+      s->state = FIO___JSON_STREAM_COMMENT_LINE;
+      ++pos;
+      continue;
+    case '/':
+      s->resume = s->state;
+      s->state = FIO___JSON_STREAM_COMMENT_START;
+      ++pos;
+      continue;
+    }
+    switch ((fio___json_stream_state_e)s->state) {
+    case FIO___JSON_STREAM_NEXT:
+      f = s->stack + s->depth - 1;
+      if ((uintptr_t)*pos == f->close)
+        goto collection_done;
+      if (*pos != ',')
+        goto error;
+      s->state = (f->close == '}' ? FIO___JSON_STREAM_KEY_OR_CLOSE
+                                  : FIO___JSON_STREAM_VALUE_OR_CLOSE);
+      ++pos;
+      continue;
+    case FIO___JSON_STREAM_COLON:
+      if (*pos != ':')
+        goto error;
+      s->state = FIO___JSON_STREAM_VALUE;
+      ++pos;
+      continue;
+    case FIO___JSON_STREAM_KEY_OR_CLOSE:
+      switch (*pos) {
+      case '}': goto collection_done;
+      case '{': /* fall through */
+      case '[': /* fall through */
+      case ']': /* fall through */
+      case ':': /* fall through */
+      case ',': goto error;
+      }
+      s->is_key = 1;
+      if (*pos == '"')
+        goto string_start;
+      goto scalar_start;
+    case FIO___JSON_STREAM_VALUE_OR_CLOSE:
+      if (*pos == ']')
+        goto collection_done;
+      /* fall through */
+    case FIO___JSON_STREAM_VALUE:
+      switch (*pos) {
+      case '{': /* fall through */
+      case '[': goto collection_start;
+      case '"': goto string_start;
+      case '}': /* fall through */
+      case ']': /* fall through */
+      case ':': /* fall through */
+      case ',': goto error;
+      }
+      goto scalar_start;
+    default: goto error;
+    }
+
+  string_start:
+    s->state = FIO___JSON_STREAM_STRING;
+    s->escaped = s->has_escape = 0;
+    start = ++pos;
+    continue;
+
+  scalar_start:
+    s->state = FIO___JSON_STREAM_SCALAR;
+    start = pos;
+    continue;
+
+  collection_start:
+    if (s->depth == s->max_depth)
+      goto error;
+    if (s->depth == s->stack_capa) {
+      uint32_t capa = (s->stack_capa ? (s->stack_capa << 1) : 8);
+      if (capa > s->max_depth)
+        capa = s->max_depth;
+      f = (fio___json_frame_s *)FIO_MEM_REALLOC_(
+          s->stack,
+          sizeof(*s->stack) * s->stack_capa,
+          sizeof(*s->stack) * capa,
+          sizeof(*s->stack) * s->depth);
+      if (!f)
+        goto error;
+      s->stack = f;
+      s->stack_capa = capa;
+    }
+    f = s->stack + s->depth;
+    f->key = NULL;
+    f->close = (uintptr_t)(*pos + 2); /* '{' + 2 == '}', '[' + 2 == ']' */
+    f->ctx = (*pos == '{' ? s->parser.cb.on_map : s->parser.cb.on_array)(
+        &s->parser,
+        (s->depth ? f[-1].key : NULL));
+    ++s->depth;
+    s->state = (*pos == '{' ? FIO___JSON_STREAM_KEY_OR_CLOSE
+                            : FIO___JSON_STREAM_VALUE_OR_CLOSE);
+    ++pos;
+    continue;
+
+  collection_done:
+    f = s->stack + --s->depth;
+    value = f->ctx;
+    ++pos;
+    if ((f->close == '}' ? s->parser.cb.map_finished
+                         : s->parser.cb.array_finished)(value))
+      goto error;
+
+  value_done:
+    if (s->is_key) {
+      s->is_key = 0;
+      if (!value)
+        goto error;
+      s->stack[s->depth - 1].key = value;
+      s->state = FIO___JSON_STREAM_COLON;
+      continue;
+    }
+    if (fio___json_stream_push(s, value)) {
+      value = NULL;
+      goto error;
+    }
+    continue;
+
+  error:
+    r = -1;
+    pos = fio___json_stream_fail(s, value, pos, end);
+    start = pos;
+  }
+
+  /* copy any incomplete string / scalar to the token buffer */
+  if ((s->state == FIO___JSON_STREAM_STRING ||
+       s->state == FIO___JSON_STREAM_SCALAR) &&
+      fio___json_stream_token_write(s, start, (size_t)(end - start))) {
+    r = -1;
+    fio___json_stream_fail(s, NULL, end, end);
+  }
+  return r;
+}
+
+/** Marks the end of the input, completing a trailing top-level scalar. */
+SFUNC int fio_json_stream_finish(fio_json_stream_s *s) {
+  void *value = NULL;
+  int r = 0;
+  uint8_t state;
+  if (!s)
+    return -1;
+  if (s->state == FIO___JSON_STREAM_SCALAR && !s->depth && !s->is_key) {
+    if (fio___json_stream_scalar(s, &value, s->token, s->token_len))
+      s->state = FIO___JSON_STREAM_ERROR;
+    else
+      fio___json_stream_push(s, value);
+  }
+  state = (s->state == FIO___JSON_STREAM_COMMENT_LINE ? s->resume : s->state);
+  if (s->depth || (s->ndjson ? (state != FIO___JSON_STREAM_VALUE &&
+                                state != FIO___JSON_STREAM_SKIP_LINE)
+                             : (state != FIO___JSON_STREAM_DONE))) {
+    r = -1;
+    if (s->depth)
+      fio___json_stream_fail(s, NULL, NULL, NULL);
+  }
+  fio___json_stream_reset(s);
+  return r;
+}
 #endif /* FIO_EXTERN_COMPLETE */
 #undef FIO_JSON
 #endif /* FIO_JSON */
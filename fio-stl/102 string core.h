@@ -1804,9 +1804,28 @@ SFUNC int fio_string_write_escape(fio_str_info_s *restrict dest,
        reallocate(dest,
                   fio_string_capa4len(dest->len + extra_space + len + 3)))) {
     r = -1;
-    len = dest->capa - (dest->len + 6);
-    if (dest->capa < len + 6)
+    if (dest->capa <= dest->len)
       return r;
+    /* truncate the source to the (escaped) bytes that fit */
+    extra_space = dest->capa - (dest->len + 1);
+    for (p = s; p < e;) {
+      size_t step = 1, need = 1;
+      if (!(escape_map[*p] & 64)) {
+        need = step = fio_utf8_char_len(p);
+        if (step < 2) {
+          step = 1;
+          need = 2 + ((escape_map[*p] - 1) & (3 + ((*p < 127) << 1)));
+        }
+      }
+      if (need > extra_space || step > (size_t)(e - p))
+        break;
+      extra_space -= need;
+      p += step;
+    }
+    len = (size_t)(p - s);
+    e = p;
+    if (first_stop > len)
+      first_stop = len;
   }
 
   /* copy unescaped head of string (if it's worth our time) */
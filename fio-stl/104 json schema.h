@@ -0,0 +1,926 @@
+/* ************************************************************************* */
+#if !defined(FIO_INCLUDE_FILE) /* Dev test - ignore line */
+#define FIO___DEV___           /* Development inclusion - ignore line */
+#define FIO_JSON_SCHEMA module /* Development inclusion - ignore line */
+#include "./include.h"         /* Development inclusion - ignore line */
+#endif                         /* Development inclusion - ignore line */
+/* *****************************************************************************
+
+
+
+
+                  JSON Schema - JSON to / from C structs
+
+
+
+
+Copyright and License: see header file (000 copyright.h) or top of file
+***************************************************************************** */
+#if defined(FIO_JSON_SCHEMA) && !defined(H___FIO_JSON_SCHEMA___H)
+#define H___FIO_JSON_SCHEMA___H
+
+/* *****************************************************************************
+Settings
+***************************************************************************** */
+
+#ifndef FIO_JSON_SCHEMA_MAX_DEPTH
+/** The maximum nesting depth of objects (structs) within a schema. */
+#define FIO_JSON_SCHEMA_MAX_DEPTH 32
+#endif
+
+/** The maximum number of fields in a schema (per struct). */
+#define FIO_JSON_SCHEMA_MAX_FIELDS 64
+
+/* *****************************************************************************
+JSON Schema - API
+***************************************************************************** */
+
+/** The C type of a schema field (use the `FIO_JSON_FIELD_*` macros). */
+typedef enum {
+  /** `bool` or any unsigned integer type (`true` / `false`). */
+  FIO_JSON_SCHEMA_BOOL = 1,
+  /** A signed integer (`int8_t` ... `int64_t`), range checked. */
+  FIO_JSON_SCHEMA_INT,
+  /** An unsigned integer (`uint8_t` ... `uint64_t`), range checked. */
+  FIO_JSON_SCHEMA_UINT,
+  /** A `float` or a `double`. */
+  FIO_JSON_SCHEMA_FLOAT,
+  /** A `char` array (the String, NUL terminated, must fit). */
+  FIO_JSON_SCHEMA_STR,
+  /** A `char *` `fio_bstr` (allocated, see `fio_bstr_free`). */
+  FIO_JSON_SCHEMA_BSTR,
+  /** A nested struct, described by its own schema. */
+  FIO_JSON_SCHEMA_OBJ,
+} fio_json_schema_type_e;
+
+typedef struct fio_json_schema_s fio_json_schema_s;
+
+/** A schema field - describes a struct member and its JSON key. */
+typedef struct {
+  /** The struct member's name (also the JSON key, unless `key` is set). */
+  const char *name;
+  /** The struct member's offset (`offsetof`). */
+  size_t offset;
+  /** The struct member's size (`sizeof`). */
+  size_t size;
+  /** The struct member's type. */
+  fio_json_schema_type_e type;
+  /** The nested struct's schema (`FIO_JSON_SCHEMA_OBJ`). */
+  fio_json_schema_s *schema;
+  /** The JSON key, if it differs from the struct member's name. */
+  const char *key;
+  /** If set, parsing fails when the field is missing (or `null`). */
+  uint8_t required;
+  /** The value set when the field is missing (or `null`). */
+  union {
+    int64_t i;
+    uint64_t u;
+    double f;
+    const char *s;
+  } def;
+} fio_json_schema_field_s;
+
+/** A schema - describes a struct (use `FIO_JSON_SCHEMA_NAME` to create). */
+struct fio_json_schema_s {
+  /** The struct's fields. */
+  const fio_json_schema_field_s *fields;
+  /** The number of fields (up to `FIO_JSON_SCHEMA_MAX_FIELDS`). */
+  uint32_t count;
+  /** If set, unknown JSON keys are errors (otherwise they are skipped). */
+  uint8_t strict;
+  /* internal: set by `fio_json_schema_prepare` */
+  volatile uint8_t ready;
+  /* internal: guards `fio_json_schema_prepare` */
+  fio_lock_i lock;
+  /* internal: perfect hash table size bits (0 == linear key search) */
+  uint8_t bits;
+  /* internal: perfect hash seed */
+  uint64_t seed;
+  /* internal: perfect hash table (field index + 1) */
+  uint8_t index[256];
+};
+
+/**
+ * Computes the schema's perfect hash table (used for key dispatch).
+ *
+ * Called automatically (before `main` for `FIO_JSON_SCHEMA_NAME` schemas, or by
+ * the first `fio_json_schema_parse`). Thread safe.
+ */
+SFUNC void fio_json_schema_prepare(fio_json_schema_s *schema);
+
+/** Sets all fields to their default values (the old values are ignored). */
+SFUNC void fio_json_schema_init(fio_json_schema_s *schema, void *obj);
+
+/** Frees any memory owned by `obj` (`fio_bstr` fields are set to NULL). */
+SFUNC void fio_json_schema_destroy(fio_json_schema_s *schema, void *obj);
+
+/**
+ * Parses a JSON object into `obj`, returning 0 on success or -1 on error.
+ *
+ * `obj` must be initialized (or zeroed), as any existing `fio_bstr` fields are
+ * reused (or freed). Missing fields are set to their default values.
+ *
+ * On error, `obj` may be partially updated (but it is always valid).
+ *
+ * If `consumed` isn't NULL, it is set to the number of bytes consumed.
+ */
+SFUNC int fio_json_schema_parse(fio_json_schema_s *schema,
+                                void *obj,
+                                fio_str_info_s json,
+                                size_t *consumed);
+
+/** Writes `obj` as a JSON object to the end of `dest` (`fio_string_write`). */
+SFUNC int fio_json_schema_write(fio_str_info_s *dest,
+                                fio_string_realloc_fn reallocate,
+                                fio_json_schema_s *schema,
+                                const void *obj);
+
+/* *****************************************************************************
+JSON Schema - Field Types (for `FIO_JSON_SCHEMA_FIELDS`)
+***************************************************************************** */
+
+/** A `bool` (or unsigned integer) field. */
+#define FIO_JSON_FIELD_BOOL .type = FIO_JSON_SCHEMA_BOOL
+/** A signed integer field (of any size). */
+#define FIO_JSON_FIELD_INT .type = FIO_JSON_SCHEMA_INT
+/** An unsigned integer field (of any size). */
+#define FIO_JSON_FIELD_UINT .type = FIO_JSON_SCHEMA_UINT
+/** A `float` or `double` field. */
+#define FIO_JSON_FIELD_FLOAT .type = FIO_JSON_SCHEMA_FLOAT
+/** A `char` array field. */
+#define FIO_JSON_FIELD_STR .type = FIO_JSON_SCHEMA_STR
+/** A `char *` (`fio_bstr`) field. */
+#define FIO_JSON_FIELD_BSTR .type = FIO_JSON_SCHEMA_BSTR
+/** A nested struct field, using the `FIO_JSON_SCHEMA_NAME` of its schema. */
+#define FIO_JSON_FIELD_OBJ(schema_name)                                        \
+  .type = FIO_JSON_SCHEMA_OBJ, .schema = &FIO_NAME(schema_name, __schema)
+
+/* *****************************************************************************
+JSON Schema - Implementation
+***************************************************************************** */
+#if defined(FIO_EXTERN_COMPLETE) || !defined(FIO_EXTERN)
+
+/* the JSON key of a field */
+#define FIO___JSON_SCHEMA_KEY(f) ((f)->key ? (f)->key : (f)->name)
+
+/* *****************************************************************************
+JSON Schema - Field Access
+***************************************************************************** */
+
+FIO_SFUNC int fio___json_schema_set_i(char *dest, size_t size, int64_t i) {
+  switch (size) {
+  case 1:
+    if (i < INT8_MIN || i > INT8_MAX)
+      return -1;
+    *(int8_t *)dest = (int8_t)i;
+    return 0;
+  case 2:
+    if (i < INT16_MIN || i > INT16_MAX)
+      return -1;
+    *(int16_t *)dest = (int16_t)i;
+    return 0;
+  case 4:
+    if (i < INT32_MIN || i > INT32_MAX)
+      return -1;
+    *(int32_t *)dest = (int32_t)i;
+    return 0;
+  case 8: *(int64_t *)dest = i; return 0;
+  }
+  return -1;
+}
+
+FIO_SFUNC int fio___json_schema_set_u(char *dest, size_t size, uint64_t u) {
+  switch (size) {
+  case 1:
+    if (u > UINT8_MAX)
+      return -1;
+    *(uint8_t *)dest = (uint8_t)u;
+    return 0;
+  case 2:
+    if (u > UINT16_MAX)
+      return -1;
+    *(uint16_t *)dest = (uint16_t)u;
+    return 0;
+  case 4:
+    if (u > UINT32_MAX)
+      return -1;
+    *(uint32_t *)dest = (uint32_t)u;
+    return 0;
+  case 8: *(uint64_t *)dest = u; return 0;
+  }
+  return -1;
+}
+
+FIO_SFUNC int fio___json_schema_set_f(char *dest, size_t size, double f) {
+  switch (size) {
+  case sizeof(float): *(float *)dest = (float)f; return 0;
+  case sizeof(double): *(double *)dest = f; return 0;
+  }
+  return -1;
+}
+
+FIO_SFUNC int64_t fio___json_schema_get_i(const char *src, size_t size) {
+  switch (size) {
+  case 1: return *(const int8_t *)src;
+  case 2: return *(const int16_t *)src;
+  case 4: return *(const int32_t *)src;
+  }
+  return *(const int64_t *)src;
+}
+
+FIO_SFUNC uint64_t fio___json_schema_get_u(const char *src, size_t size) {
+  switch (size) {
+  case 1: return *(const uint8_t *)src;
+  case 2: return *(const uint16_t *)src;
+  case 4: return *(const uint32_t *)src;
+  }
+  return *(const uint64_t *)src;
+}
+
+/* sets a field to its default value, freeing the old value if `free_old` */
+FIO_SFUNC void fio___json_schema_field_reset(char *obj,
+                                             const fio_json_schema_field_s *f,
+                                             uint8_t free_old) {
+  char *dest = obj + f->offset;
+  size_t len;
+  switch (f->type) {
+  case FIO_JSON_SCHEMA_BOOL:
+    fio___json_schema_set_u(dest, f->size, (uint64_t)(f->def.i != 0));
+    return;
+  case FIO_JSON_SCHEMA_INT:
+    fio___json_schema_set_i(dest, f->size, f->def.i);
+    return;
+  case FIO_JSON_SCHEMA_UINT:
+    fio___json_schema_set_u(dest, f->size, f->def.u);
+    return;
+  case FIO_JSON_SCHEMA_FLOAT:
+    fio___json_schema_set_f(dest, f->size, f->def.f);
+    return;
+  case FIO_JSON_SCHEMA_STR:
+    len = f->def.s ? FIO_STRLEN(f->def.s) : 0;
+    if (len >= f->size)
+      len = f->size - 1;
+    if (len)
+      FIO_MEMCPY(dest, f->def.s, len);
+    dest[len] = 0;
+    return;
+  case FIO_JSON_SCHEMA_BSTR:
+    if (free_old)
+      fio_bstr_free(*(char **)dest);
+    *(char **)dest = NULL;
+    if (f->def.s)
+      *(char **)dest = fio_bstr_write(NULL, f->def.s, FIO_STRLEN(f->def.s));
+    return;
+  case FIO_JSON_SCHEMA_OBJ:
+    for (uint32_t i = 0; i < f->schema->count; ++i)
+      fio___json_schema_field_reset(dest, f->schema->fields + i, free_old);
+    return;
+  }
+}
+
+/* *****************************************************************************
+JSON Schema - Perfect Hash Key Dispatch
+***************************************************************************** */
+
+/* the perfect hash table position of a key's hash */
+FIO_IFUNC size_t fio___json_schema_pos(uint64_t hash,
+                                       uint64_t seed,
+                                       uint8_t bits) {
+  return (size_t)(((hash ^ seed) * FIO_U64_HASH_PRIME1) >> (64 - bits));
+}
+
+/* computes the perfect hash table, called once (under the schema's lock) */
+FIO_SFUNC void fio___json_schema_prepare_task(fio_json_schema_s *s) {
+  FIO_ASSERT(s->count <= FIO_JSON_SCHEMA_MAX_FIELDS,
+             "JSON schema has too many fields (%u)",
+             (unsigned)s->count);
+  for (uint32_t i = 0; i < s->count; ++i) {
+    const fio_json_schema_field_s *f = s->fields + i;
+    FIO_ASSERT(f->type != FIO_JSON_SCHEMA_OBJ || f->schema,
+               "JSON schema field (%s) is missing its schema",
+               f->name);
+    if (f->type == FIO_JSON_SCHEMA_OBJ)
+      fio_json_schema_prepare(f->schema);
+    /* keys are written as is, so they must not require JSON escaping */
+    for (const char *k = FIO___JSON_SCHEMA_KEY(f); *k; ++k)
+      FIO_ASSERT((uint8_t)*k > 31 && *k != '"' && *k != '\\',
+                 "JSON schema key (%s) requires escaping",
+                 FIO___JSON_SCHEMA_KEY(f));
+  }
+  /* look for a seed with no collisions, using a table at least twice as big */
+  uint64_t hashes[FIO_JSON_SCHEMA_MAX_FIELDS];
+  for (uint32_t i = 0; i < s->count; ++i) {
+    const char *k = FIO___JSON_SCHEMA_KEY(s->fields + i);
+    hashes[i] = fio_risky_hash(k, FIO_STRLEN(k), 0);
+  }
+  s->bits = 0;
+  for (uint8_t bits = 1; bits <= 8 && s->count; ++bits) {
+    if (((uint64_t)1 << bits) < ((uint64_t)s->count << 1))
+      continue;
+    for (uint64_t seed = 1; seed < ((uint64_t)1 << 16); ++seed) {
+      uint32_t i = 0;
+      FIO_MEMSET(s->index, 0, sizeof(s->index));
+      for (; i < s->count; ++i) {
+        const size_t pos = fio___json_schema_pos(hashes[i], seed, bits);
+        if (s->index[pos])
+          break;
+        s->index[pos] = (uint8_t)(i + 1);
+      }
+      if (i == s->count) {
+        s->seed = seed;
+        s->bits = bits;
+        goto done;
+      }
+    }
+  }
+  FIO_MEMSET(s->index, 0, sizeof(s->index)); /* linear search fallback */
+done:
+  fio_atomic_exchange(&s->ready, 1); /* publishes the table */
+}
+
+/** Computes the schema's perfect hash table (used for key dispatch). */
+SFUNC void fio_json_schema_prepare(fio_json_schema_s *s) {
+  uint8_t ready;
+  fio_atomic_load(ready, &s->ready);
+  if (ready)
+    return;
+  fio_lock(&s->lock);
+  if (!s->ready)
+    fio___json_schema_prepare_task(s);
+  fio_unlock(&s->lock);
+}
+
+/* finds the field for a JSON key (NULL if none) */
+FIO_IFUNC const fio_json_schema_field_s *fio___json_schema_find(
+    fio_json_schema_s *s,
+    const char *key,
+    size_t len) {
+  const fio_json_schema_field_s *f;
+  const char *k;
+  if (FIO_LIKELY(s->bits)) {
+    const uint8_t i = s->index[fio___json_schema_pos(
+        fio_risky_hash(key, len, 0), s->seed, s->bits)];
+    if (!i)
+      return NULL;
+    f = s->fields + i - 1;
+    k = FIO___JSON_SCHEMA_KEY(f);
+    if (FIO_STRLEN(k) == len && !FIO_MEMCMP(k, key, len))
+      return f;
+    return NULL;
+  }
+  for (uint32_t i = 0; i < s->count; ++i) {
+    f = s->fields + i;
+    k = FIO___JSON_SCHEMA_KEY(f);
+    if (FIO_STRLEN(k) == len && !FIO_MEMCMP(k, key, len))
+      return f;
+  }
+  return NULL;
+}
+
+/* *****************************************************************************
+JSON Schema - Parsing (fio_json_parse callbacks)
+***************************************************************************** */
+
+/* a struct being parsed */
+typedef struct {
+  fio_json_schema_s *schema;
+  char *obj;
+  /** the field bound to the next value (NULL if the value is ignored) */
+  const fio_json_schema_field_s *field;
+  /** a bitmap of the fields that were set */
+  uint64_t seen;
+  uint8_t expect_key;
+} fio___json_schema_frame_s;
+
+typedef struct {
+  fio_json_schema_s *schema;
+  char *obj;
+  /** the nesting level within an ignored (or invalid) container */
+  uint32_t skip;
+  /** the number of frames */
+  uint32_t depth;
+  int error;
+  uint8_t done;
+  fio___json_schema_frame_s frames[FIO_JSON_SCHEMA_MAX_DEPTH];
+} fio___json_schema_parser_s;
+
+/* the parser has no `udata`, so the parsing state is per thread */
+static __thread fio___json_schema_parser_s *fio___json_schema_parser;
+
+/* all callbacks return this value, the data is written directly to `obj` */
+#define FIO___JSON_SCHEMA_VALUE ((void *)&fio___json_schema_parser)
+
+/* binds a Hash Map key to a field of the frame's struct */
+FIO_SFUNC void fio___json_schema_key(fio___json_schema_parser_s *p,
+                                     fio___json_schema_frame_s *f,
+                                     const char *key,
+                                     size_t len) {
+  f->expect_key = 0;
+  f->field = key ? fio___json_schema_find(f->schema, key, len) : NULL;
+  p->error |= ((!f->field) & f->schema->strict);
+}
+
+/* returns the field bound to the next value (NULL if ignored) */
+FIO_SFUNC const fio_json_schema_field_s *fio___json_schema_bind(
+    fio___json_schema_parser_s *p) {
+  fio___json_schema_frame_s *f;
+  if (p->skip)
+    return NULL;
+  if (!p->depth) { /* the JSON must be an object */
+    p->error = 1;
+    return NULL;
+  }
+  f = p->frames + p->depth - 1;
+  if (f->expect_key) { /* a non-String key */
+    fio___json_schema_key(p, f, NULL, 0);
+    return NULL;
+  }
+  f->expect_key = 1;
+  if (f->field)
+    f->seen |= (uint64_t)1 << (f->field - f->schema->fields);
+  return f->field;
+}
+
+/* returns the address of the field's value */
+FIO_IFUNC char *fio___json_schema_dest(fio___json_schema_parser_s *p,
+                                       const fio_json_schema_field_s *field) {
+  return p->frames[p->depth - 1].obj + field->offset;
+}
+
+FIO_SFUNC void *fio___json_schema_on_null(void) {
+  fio___json_schema_parser_s *p = fio___json_schema_parser;
+  const fio_json_schema_field_s *field = fio___json_schema_bind(p);
+  if (field) { /* `null` values are the same as missing values */
+    fio___json_schema_frame_s *f = p->frames + p->depth - 1;
+    f->seen &= ~((uint64_t)1 << (field - f->schema->fields));
+  }
+  return FIO___JSON_SCHEMA_VALUE;
+}
+
+FIO_SFUNC void *fio___json_schema_on_bool(uint64_t b) {
+  fio___json_schema_parser_s *p = fio___json_schema_parser;
+  const fio_json_schema_field_s *field = fio___json_schema_bind(p);
+  if (!field)
+    return FIO___JSON_SCHEMA_VALUE;
+  if (field->type != FIO_JSON_SCHEMA_BOOL ||
+      fio___json_schema_set_u(fio___json_schema_dest(p, field),
+                              field->size,
+                              b))
+    p->error = 1;
+  return FIO___JSON_SCHEMA_VALUE;
+}
+FIO_SFUNC void *fio___json_schema_on_true(void) {
+  return fio___json_schema_on_bool(1);
+}
+FIO_SFUNC void *fio___json_schema_on_false(void) {
+  return fio___json_schema_on_bool(0);
+}
+
+FIO_SFUNC void *fio___json_schema_on_number(int64_t i) {
+  fio___json_schema_parser_s *p = fio___json_schema_parser;
+  const fio_json_schema_field_s *field = fio___json_schema_bind(p);
+  char *dest;
+  if (!field)
+    return FIO___JSON_SCHEMA_VALUE;
+  dest = fio___json_schema_dest(p, field);
+  switch (field->type) {
+  case FIO_JSON_SCHEMA_INT:
+    p->error |= fio___json_schema_set_i(dest, field->size, i);
+    break;
+  case FIO_JSON_SCHEMA_UINT:
+    p->error |=
+        (i < 0) || fio___json_schema_set_u(dest, field->size, (uint64_t)i);
+    break;
+  case FIO_JSON_SCHEMA_FLOAT:
+    p->error |= fio___json_schema_set_f(dest, field->size, (double)i);
+    break;
+  default: p->error = 1;
+  }
+  return FIO___JSON_SCHEMA_VALUE;
+}
+
+FIO_SFUNC void *fio___json_schema_on_float(double f) {
+  fio___json_schema_parser_s *p = fio___json_schema_parser;
+  const fio_json_schema_field_s *field = fio___json_schema_bind(p);
+  if (!field)
+    return FIO___JSON_SCHEMA_VALUE;
+  if (field->type != FIO_JSON_SCHEMA_FLOAT ||
+      fio___json_schema_set_f(fio___json_schema_dest(p, field),
+                              field->size,
+                              f))
+    p->error = 1;
+  return FIO___JSON_SCHEMA_VALUE;
+}
+
+FIO_SFUNC void *fio___json_schema_on_string2(const void *start,
+                                             size_t len,
+                                             uint8_t escaped) {
+  fio___json_schema_parser_s *p = fio___json_schema_parser;
+  const fio_json_schema_field_s *field;
+  char *dest;
+  if (!p->skip && p->depth && p->frames[p->depth - 1].expect_key) {
+    fio___json_schema_frame_s *f = p->frames + p->depth - 1;
+    char buf[256];
+    fio_str_info_s key = FIO_STR_INFO3(buf, 0, sizeof(buf));
+    if (!escaped) {
+      fio___json_schema_key(p, f, (const char *)start, len);
+      return FIO___JSON_SCHEMA_VALUE;
+    }
+    if (fio_string_write_unescape(&key, NULL, start, len))
+      key.buf = NULL; /* longer than any reasonable key, unknown */
+    fio___json_schema_key(p, f, key.buf, key.len);
+    return FIO___JSON_SCHEMA_VALUE;
+  }
+  field = fio___json_schema_bind(p);
+  if (!field)
+    return FIO___JSON_SCHEMA_VALUE;
+  dest = fio___json_schema_dest(p, field);
+  switch (field->type) {
+  case FIO_JSON_SCHEMA_STR:
+    if (!escaped) {
+      if (len >= field->size) {
+        p->error = 1;
+        break;
+      }
+      FIO_MEMCPY(dest, start, len);
+      dest[len] = 0;
+      break;
+    } else {
+      fio_str_info_s s = FIO_STR_INFO3(dest, 0, field->size);
+      p->error |= fio_string_write_unescape(&s, NULL, start, len);
+    }
+    break;
+  case FIO_JSON_SCHEMA_BSTR: {
+    char *s = *(char **)dest;
+    if (s)
+      s = fio_bstr_len_set(s, 0);
+    *(char **)dest = escaped ? fio_bstr_write_unescape(s, start, len)
+                             : fio_bstr_write(s, start, len);
+    break;
+  }
+  default: p->error = 1;
+  }
+  return FIO___JSON_SCHEMA_VALUE;
+}
+FIO_SFUNC void *fio___json_schema_on_string(const void *start, size_t len) {
+  return fio___json_schema_on_string2(start, len, 1);
+}
+FIO_SFUNC void *fio___json_schema_on_string_simple(const void *start,
+                                                   size_t len) {
+  return fio___json_schema_on_string2(start, len, 0);
+}
+
+FIO_SFUNC void *fio___json_schema_on_map(void *ctx, void *at) {
+  fio___json_schema_parser_s *p = fio___json_schema_parser;
+  const fio_json_schema_field_s *field;
+  fio___json_schema_frame_s *f;
+  if (!p->skip && !p->depth && !p->done) { /* the root object */
+    p->frames[p->depth++] = (fio___json_schema_frame_s){
+        .schema = p->schema,
+        .obj = p->obj,
+        .expect_key = 1,
+    };
+    return FIO___JSON_SCHEMA_VALUE;
+  }
+  field = fio___json_schema_bind(p);
+  if (!field)
+    goto skip;
+  f = p->frames + p->depth - 1;
+  if (field->type != FIO_JSON_SCHEMA_OBJ ||
+      p->depth == FIO_JSON_SCHEMA_MAX_DEPTH)
+    goto error;
+  p->frames[p->depth++] = (fio___json_schema_frame_s){
+      .schema = field->schema,
+      .obj = f->obj + field->offset,
+      .expect_key = 1,
+  };
+  return FIO___JSON_SCHEMA_VALUE;
+error:
+  p->error = 1;
+skip:
+  ++p->skip;
+  return FIO___JSON_SCHEMA_VALUE;
+  (void)ctx, (void)at;
+}
+
+FIO_SFUNC void *fio___json_schema_on_array(void *ctx, void *at) {
+  fio___json_schema_parser_s *p = fio___json_schema_parser;
+  if (fio___json_schema_bind(p)) /* Arrays aren't supported by schemas */
+    p->error = 1;
+  ++p->skip;
+  return FIO___JSON_SCHEMA_VALUE;
+  (void)ctx, (void)at;
+}
+
+FIO_SFUNC int fio___json_schema_map_push(void *ctx, void *key, void *value) {
+  return fio___json_schema_parser->error;
+  (void)ctx, (void)key, (void)value;
+}
+
+FIO_SFUNC int fio___json_schema_array_push(void *ctx, void *value) {
+  return fio___json_schema_parser->error;
+  (void)ctx, (void)value;
+}
+
+FIO_SFUNC int fio___json_schema_array_finished(void *ctx) {
+  fio___json_schema_parser_s *p = fio___json_schema_parser;
+  --p->skip;
+  return p->error;
+  (void)ctx;
+}
+
+FIO_SFUNC int fio___json_schema_map_finished(void *ctx) {
+  fio___json_schema_parser_s *p = fio___json_schema_parser;
+  fio___json_schema_frame_s *f;
+  if (p->skip) {
+    --p->skip;
+    return p->error;
+  }
+  f = p->frames + --p->depth;
+  for (uint32_t i = 0; i < f->schema->count; ++i) {
+    if (((f->seen >> i) & 1))
+      continue;
+    /* missing fields are set to their default values (if not required) */
+    p->error |= f->schema->fields[i].required;
+    fio___json_schema_field_reset(f->obj, f->schema->fields + i, 1);
+  }
+  p->done = !p->depth;
+  return p->error;
+  (void)ctx;
+}
+
+FIO_SFUNC void fio___json_schema_free_unused_object(void *ctx) { (void)ctx; }
+
+/** Parses a JSON object into `obj`, returning 0 on success or -1 on error. */
+SFUNC int fio_json_schema_parse(fio_json_schema_s *schema,
+                                void *obj,
+                                fio_str_info_s json,
+                                size_t *consumed) {
+  static fio_json_parser_callbacks_s callbacks = {
+      .on_null = fio___json_schema_on_null,
+      .on_true = fio___json_schema_on_true,
+      .on_false = fio___json_schema_on_false,
+      .on_number = fio___json_schema_on_number,
+      .on_float = fio___json_schema_on_float,
+      .on_string = fio___json_schema_on_string,
+      .on_string_simple = fio___json_schema_on_string_simple,
+      .on_map = fio___json_schema_on_map,
+      .on_array = fio___json_schema_on_array,
+      .map_push = fio___json_schema_map_push,
+      .array_push = fio___json_schema_array_push,
+      .array_finished = fio___json_schema_array_finished,
+      .map_finished = fio___json_schema_map_finished,
+      .free_unused_object = fio___json_schema_free_unused_object,
+  };
+  fio___json_schema_parser_s p;
+  fio___json_schema_parser_s *old = fio___json_schema_parser;
+  fio_json_result_s r;
+  fio_json_schema_prepare(schema); /* hand declared schemas are lazy */
+  p.schema = schema;
+  p.obj = (char *)obj;
+  p.skip = p.depth = 0;
+  p.error = 0;
+  p.done = 0;
+  fio___json_schema_parser = &p;
+  r = fio_json_parse(&callbacks, json.buf, json.len);
+  fio___json_schema_parser = old;
+  if (consumed)
+    *consumed = r.stop_pos;
+  return 0 - (r.err | p.error | !p.done);
+}
+
+/* *****************************************************************************
+JSON Schema - Initialization / Cleanup
+***************************************************************************** */
+
+/** Sets all fields to their default values (the old values are ignored). */
+SFUNC void fio_json_schema_init(fio_json_schema_s *s, void *obj) {
+  for (uint32_t i = 0; i < s->count; ++i)
+    fio___json_schema_field_reset((char *)obj, s->fields + i, 0);
+}
+
+/** Frees any memory owned by `obj` (`fio_bstr` fields are set to NULL). */
+SFUNC void fio_json_schema_destroy(fio_json_schema_s *s, void *obj) {
+  for (uint32_t i = 0; i < s->count; ++i) {
+    const fio_json_schema_field_s *f = s->fields + i;
+    char *dest = (char *)obj + f->offset;
+    if (f->type == FIO_JSON_SCHEMA_BSTR) {
+      fio_bstr_free(*(char **)dest);
+      *(char **)dest = NULL;
+    } else if (f->type == FIO_JSON_SCHEMA_OBJ) {
+      fio_json_schema_destroy(f->schema, dest);
+    }
+  }
+}
+
+/* *****************************************************************************
+JSON Schema - Writing
+***************************************************************************** */
+
+/* the (maximal) JSON length of an object, ignoring String escaping */
+FIO_SFUNC size_t fio___json_schema_write_len(fio_json_schema_s *s,
+                                             const char *obj) {
+  size_t r = 1 + s->count;
+  for (uint32_t i = 0; i < s->count; ++i) {
+    const fio_json_schema_field_s *f = s->fields + i;
+    const char *src = obj + f->offset;
+    r += FIO_STRLEN(FIO___JSON_SCHEMA_KEY(f)) + 3;
+    switch (f->type) {
+    case FIO_JSON_SCHEMA_BOOL: r += 5; break;
+    case FIO_JSON_SCHEMA_INT:  /* fall through */
+    case FIO_JSON_SCHEMA_UINT: r += 20; break;
+    case FIO_JSON_SCHEMA_FLOAT: r += 24; break;
+    case FIO_JSON_SCHEMA_STR: r += f->size + 2; break;
+    case FIO_JSON_SCHEMA_BSTR:
+      r += (*(char **)src ? fio_bstr_len(*(char **)src) : 2) + 2;
+      break;
+    case FIO_JSON_SCHEMA_OBJ:
+      r += fio___json_schema_write_len(f->schema, src);
+      break;
+    }
+  }
+  return r;
+}
+
+FIO_SFUNC int fio___json_schema_write(fio_str_info_s *dest,
+                                      fio_string_realloc_fn reallocate,
+                                      fio_json_schema_s *s,
+                                      const char *obj) {
+  int r = fio_string_write(dest, reallocate, "{", 1);
+  for (uint32_t i = 0; i < s->count; ++i) {
+    const fio_json_schema_field_s *f = s->fields + i;
+    const char *src = obj + f->offset;
+    const char *key = FIO___JSON_SCHEMA_KEY(f);
+    char buf[32];
+    size_t len;
+    r |= fio_string_write(dest, reallocate, (i ? ",\"" : "\""), 1 + !!i);
+    r |= fio_string_write(dest, reallocate, key, FIO_STRLEN(key));
+    r |= fio_string_write(dest, reallocate, "\":", 2);
+    switch (f->type) {
+    case FIO_JSON_SCHEMA_BOOL:
+      if (fio___json_schema_get_u(src, f->size))
+        r |= fio_string_write(dest, reallocate, "true", 4);
+      else
+        r |= fio_string_write(dest, reallocate, "false", 5);
+      break;
+    case FIO_JSON_SCHEMA_INT:
+      r |= fio_string_write_i(dest,
+                              reallocate,
+                              fio___json_schema_get_i(src, f->size));
+      break;
+    case FIO_JSON_SCHEMA_UINT:
+      r |= fio_string_write_u(dest,
+                              reallocate,
+                              fio___json_schema_get_u(src, f->size));
+      break;
+    case FIO_JSON_SCHEMA_FLOAT:
+      len = fio_ftoa(buf,
+                     (f->size == sizeof(float) ? (double)*(const float *)src
+                                               : *(const double *)src),
+                     10);
+      r |= fio_string_write(dest, reallocate, buf, len);
+      break;
+    case FIO_JSON_SCHEMA_STR:
+      len = (size_t)((const char *)FIO_MEMCHR(src, 0, f->size) - src);
+      r |= fio_string_write(dest, reallocate, "\"", 1);
+      r |= fio_string_write_escape(dest, reallocate, src, len);
+      r |= fio_string_write(dest, reallocate, "\"", 1);
+      break;
+    case FIO_JSON_SCHEMA_BSTR:
+      if (!*(char **)src) {
+        r |= fio_string_write(dest, reallocate, "null", 4);
+        break;
+      }
+      r |= fio_string_write(dest, reallocate, "\"", 1);
+      r |= fio_string_write_escape(dest,
+                                   reallocate,
+                                   *(char **)src,
+                                   fio_bstr_len(*(char **)src));
+      r |= fio_string_write(dest, reallocate, "\"", 1);
+      break;
+    case FIO_JSON_SCHEMA_OBJ:
+      r |= fio___json_schema_write(dest, reallocate, f->schema, src);
+      break;
+    }
+  }
+  r |= fio_string_write(dest, reallocate, "}", 1);
+  return r;
+}
+
+/** Writes `obj` as a JSON object to the end of `dest` (`fio_string_write`). */
+SFUNC int fio_json_schema_write(fio_str_info_s *dest,
+                                fio_string_realloc_fn reallocate,
+                                fio_json_schema_s *schema,
+                                const void *obj) {
+  if (reallocate) { /* a single allocation, unless Strings require escaping */
+    const size_t len = fio___json_schema_write_len(schema, (const char *)obj);
+    if (dest->capa <= dest->len + len && reallocate(dest, dest->len + len))
+      return -1;
+  }
+  return fio___json_schema_write(dest, reallocate, schema, (const char *)obj);
+}
+
+/* *****************************************************************************
+JSON Schema - cleanup
+***************************************************************************** */
+#undef FIO___JSON_SCHEMA_KEY
+#undef FIO___JSON_SCHEMA_VALUE
+#endif /* FIO_EXTERN_COMPLETE */
+#endif /* FIO_JSON_SCHEMA */
+#undef FIO_JSON_SCHEMA
+
+/* *****************************************************************************
+
+
+
+
+                    JSON Schema - struct specific template
+
+
+
+
+***************************************************************************** */
+#if defined(FIO_JSON_SCHEMA_NAME)
+
+#ifndef FIO_JSON_SCHEMA_TYPE
+#error FIO_JSON_SCHEMA_TYPE (the struct type) must be defined for a schema
+#endif
+#ifndef FIO_JSON_SCHEMA_FIELDS
+#error FIO_JSON_SCHEMA_FIELDS(FIELD) must be defined for a schema
+#endif
+#ifndef FIO_JSON_SCHEMA_STRICT
+/** If true, unknown JSON keys are errors (otherwise they are skipped). */
+#define FIO_JSON_SCHEMA_STRICT 0
+#endif
+
+/* a field descriptor, used by FIO_JSON_SCHEMA_FIELDS(FIELD) */
+#define FIO___JSON_SCHEMA_FIELD(member, ...)                                   \
+  {.name = #member,                                                            \
+   .offset = offsetof(FIO_JSON_SCHEMA_TYPE, member),                           \
+   .size = sizeof(((FIO_JSON_SCHEMA_TYPE *)0)->member),                        \
+   __VA_ARGS__},
+
+static const fio_json_schema_field_s FIO_NAME(FIO_JSON_SCHEMA_NAME,
+                                              __fields)[] = {
+    FIO_JSON_SCHEMA_FIELDS(FIO___JSON_SCHEMA_FIELD)};
+
+FIO_ASSERT_STATIC(sizeof(FIO_NAME(FIO_JSON_SCHEMA_NAME, __fields)) <=
+                      sizeof(fio_json_schema_field_s) *
+                          FIO_JSON_SCHEMA_MAX_FIELDS,
+                  "too many fields in JSON schema");
+
+static fio_json_schema_s FIO_NAME(FIO_JSON_SCHEMA_NAME, __schema) = {
+    .fields = FIO_NAME(FIO_JSON_SCHEMA_NAME, __fields),
+    .count = (uint32_t)(sizeof(FIO_NAME(FIO_JSON_SCHEMA_NAME, __fields)) /
+                        sizeof(fio_json_schema_field_s)),
+    .strict = (FIO_JSON_SCHEMA_STRICT ? 1 : 0),
+};
+
+/* computes the perfect hash before `main` (and before any threads start) */
+FIO_CONSTRUCTOR(FIO_NAME(FIO_JSON_SCHEMA_NAME, __schema_prepare)) {
+  fio_json_schema_prepare(&FIO_NAME(FIO_JSON_SCHEMA_NAME, __schema));
+}
+
+/** Returns the schema (for the `fio_json_schema` functions). */
+FIO_IFUNC fio_json_schema_s *FIO_NAME(FIO_JSON_SCHEMA_NAME, schema)(void) {
+  return &FIO_NAME(FIO_JSON_SCHEMA_NAME, __schema);
+}
+
+/** Sets all fields to their default values (the old values are ignored). */
+FIO_IFUNC void FIO_NAME(FIO_JSON_SCHEMA_NAME, init)(FIO_JSON_SCHEMA_TYPE *o) {
+  fio_json_schema_init(&FIO_NAME(FIO_JSON_SCHEMA_NAME, __schema), o);
+}
+
+/** Frees any memory owned by the struct (i.e., `FIO_JSON_FIELD_BSTR`). */
+FIO_IFUNC void FIO_NAME(FIO_JSON_SCHEMA_NAME,
+                        destroy)(FIO_JSON_SCHEMA_TYPE *o) {
+  fio_json_schema_destroy(&FIO_NAME(FIO_JSON_SCHEMA_NAME, __schema), o);
+}
+
+/** Parses a JSON object into `o`, returning 0 on success or -1 on error. */
+FIO_IFUNC int FIO_NAME(FIO_JSON_SCHEMA_NAME, parse)(FIO_JSON_SCHEMA_TYPE *o,
+                                                    fio_str_info_s json,
+                                                    size_t *consumed) {
+  return fio_json_schema_parse(&FIO_NAME(FIO_JSON_SCHEMA_NAME, __schema),
+                               o,
+                               json,
+                               consumed);
+}
+
+/** Writes `o` as a JSON object to the end of `dest` (`fio_string_write`). */
+FIO_IFUNC int FIO_NAME(FIO_JSON_SCHEMA_NAME,
+                       write)(fio_str_info_s *dest,
+                              fio_string_realloc_fn reallocate,
+                              const FIO_JSON_SCHEMA_TYPE *o) {
+  return fio_json_schema_write(dest,
+                               reallocate,
+                               &FIO_NAME(FIO_JSON_SCHEMA_NAME, __schema),
+                               o);
+}
+
+#undef FIO___JSON_SCHEMA_FIELD
+#endif /* FIO_JSON_SCHEMA_NAME */
+#undef FIO_JSON_SCHEMA_NAME
+#undef FIO_JSON_SCHEMA_TYPE
+#undef FIO_JSON_SCHEMA_FIELDS
+#undef FIO_JSON_SCHEMA_STRICT
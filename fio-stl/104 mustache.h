@@ -41,6 +41,14 @@ Settings
 /** Limits the scope of partial templates to the context of their section. */
 #define FIO_MUSTACHE_ISOLATE_PARTIALS 1
 #endif
+#ifndef FIO_MUSTACHE_CACHE_LIMIT
+/** The default memory limit for the template cache (templates and files). */
+#define FIO_MUSTACHE_CACHE_LIMIT ((size_t)1 << 25)
+#endif
+#ifndef FIO_MUSTACHE_CACHE_THROTTLE
+/** The default interval (milliseconds) between cached file change tests. */
+#define FIO_MUSTACHE_CACHE_THROTTLE 1000
+#endif
 
 /* *****************************************************************************
 Mustache Parser / Builder API
@@ -101,6 +109,12 @@ struct fio_mustache_bargs_s {
   void *ctx;
   /* opaque user data (settable as well as readable), the final return value. */
   void *udata;
+  /* optional: writes template text, which is valid while the template is. */
+  void *(*write_text_static)(void *udata, fio_buf_info_s txt);
+  /* optional: the hash function used by `fio_mustache_bind`. */
+  uint64_t (*var_hash)(fio_buf_info_s name);
+  /* optional: same as `get_var`, with the `var_hash` value of `name`. */
+  void *(*get_var_hashed)(void *ctx, fio_buf_info_s name, uint64_t hash);
 };
 
 /** Builds the template, returning the final value of `udata` (or NULL). */
@@ -108,6 +122,101 @@ SFUNC void *fio_mustache_build(fio_mustache_s *m, fio_mustache_bargs_s);
 #define fio_mustache_build(m, ...)                                             \
   fio_mustache_build((m), ((fio_mustache_bargs_s){__VA_ARGS__}))
 
+/**
+ * Pre-computes the hash value of every variable name in the template.
+ *
+ * When building a bound template, variables are looked up using
+ * `get_var_hashed` (if set and if `var_hash` is the same `hash` function),
+ * so the names are never hashed again. Dotted names (`a.b`) that are not
+ * found as a whole fall back to `get_var` for each segment.
+ *
+ * Note: this updates the template in place - bind the template before sharing
+ * it with other threads.
+ */
+SFUNC void fio_mustache_bind(fio_mustache_s *m,
+                             uint64_t (*hash)(fio_buf_info_s name));
+
+/** A rendered template, as an ordered list of buffers (see `build_iov`). */
+typedef struct {
+  /** The rendered output, in order (template text isn't copied). */
+  fio_buf_info_s *iov;
+  /** The number of buffers in `iov`. */
+  size_t count;
+  /** The total length of the rendered output. */
+  size_t len;
+  /* internal data */
+  size_t capa;
+  struct fio___mustache_iov_blk_s *blocks;
+  struct fio___mustache_iov_blk_s *block;
+  fio_mustache_s *m;
+} fio_mustache_iov_s;
+
+/**
+ * Builds the template into `dest` as a list of buffers (i.e., for `writev`),
+ * returning the number of buffers.
+ *
+ * Template text is referenced rather than copied, and `dest` holds a reference
+ * to the template, so the buffers are valid until `dest` is reused or
+ * destroyed. Variable data is copied to memory blocks owned by `dest`.
+ *
+ * `dest` must be zero initialized the first time it is used and can be reused
+ * for multiple renders (the memory is reused as well).
+ *
+ * The writer callbacks and `udata` are ignored.
+ */
+SFUNC size_t fio_mustache_build_iov(fio_mustache_s *m,
+                                    fio_mustache_iov_s *dest,
+                                    fio_mustache_bargs_s);
+#define fio_mustache_build_iov(m, dest, ...)                                   \
+  fio_mustache_build_iov((m), (dest), ((fio_mustache_bargs_s){__VA_ARGS__}))
+
+/** Frees the memory used by a `fio_mustache_iov_s` (and zeroes it out). */
+SFUNC void fio_mustache_iov_destroy(fio_mustache_iov_s *dest);
+
+/* *****************************************************************************
+Mustache Template Cache API
+***************************************************************************** */
+
+typedef struct {
+  /** The template's file name. */
+  fio_buf_info_s filename;
+  /** If set, the template is bound using `var_hash` when it is compiled. */
+  uint64_t (*var_hash)(fio_buf_info_s name);
+} fio_mustache_cache_args_s;
+
+/**
+ * Returns a compiled template from the process-wide template cache, loading
+ * (and compiling) the template if it wasn't cached.
+ *
+ * Partial template files are cached as well and shared between templates. At
+ * most once every throttle interval, the template's files are tested for
+ * changes (size and modification time) and the template is re-compiled if the
+ * content of any of its files changed.
+ *
+ * If re-compiling fails, the last valid template is returned (unless the
+ * template's file was removed).
+ *
+ * Returns a new reference (or NULL) - call `fio_mustache_free` when done.
+ * Templates are never changed once compiled, so reloading doesn't effect
+ * templates that are in use.
+ */
+SFUNC fio_mustache_s *fio_mustache_cache_get(fio_mustache_cache_args_s args);
+#define fio_mustache_cache_get(...)                                            \
+  fio_mustache_cache_get((fio_mustache_cache_args_s){__VA_ARGS__})
+
+/**
+ * Sets the template cache's memory limit (in bytes) and the minimal interval
+ * between file change tests (in milliseconds).
+ *
+ * A zero `memory_limit` or a negative `throttle` restores the default value
+ * (`FIO_MUSTACHE_CACHE_LIMIT` and `FIO_MUSTACHE_CACHE_THROTTLE`). A zero
+ * `throttle` tests for changes every time (useful during development).
+ */
+SFUNC void fio_mustache_cache_config(size_t memory_limit, int64_t throttle);
+
+/** Removes all templates from the cache (templates in use remain valid). */
+SFUNC void fio_mustache_cache_clear(void);
+
 /* *****************************************************************************
 Implementation - possibly externed functions.
 ***************************************************************************** */
@@ -127,13 +236,15 @@ typedef enum {
   FIO___MUSTACHE_I_STACK_PUSH,   /* 32 bit extra data (goes to position) */
   FIO___MUSTACHE_I_GOTO_PUSH,    /* 32 bit extra data (goes to position) */
   FIO___MUSTACHE_I_TXT,          /* 16 bits length + data */
-  FIO___MUSTACHE_I_VAR,          /* 16 bits length + data */
-  FIO___MUSTACHE_I_VAR_RAW,      /* 16 bits length + data */
-  FIO___MUSTACHE_I_ARY,          /* 16 bits length + 32 bit skip-pos + data */
-  FIO___MUSTACHE_I_MISSING,      /* 16 bits length + 32 bit skip-pos + data */
+  FIO___MUSTACHE_I_VAR,          /* 16 bits length + 64 bit hash + data */
+  FIO___MUSTACHE_I_VAR_RAW,      /* 16 bits length + 64 bit hash + data */
+  FIO___MUSTACHE_I_ARY,          /* 16 bit len + 32 bit skip + 64 hash + data */
+  FIO___MUSTACHE_I_MISSING,      /* 16 bit len + 32 bit skip + 64 hash + data */
   FIO___MUSTACHE_I_PADDING_PUSH, /* 16 bits length + data */
   FIO___MUSTACHE_I_PADDING_POP,  /* 0 extra data */
+  FIO___MUSTACHE_I_HASH_FN,      /* pointer sized data (the bound hash fn) */
 #if FIO_MUSTACHE_PRESERVE_PADDING
+  /* 16 bit len + 16 bit padding len + 64 bit hash + data + padding */
   FIO___MUSTACHE_I_VAR_PADDED,
   FIO___MUSTACHE_I_VAR_RAW_PADDED,
 #endif
@@ -141,6 +252,10 @@ typedef enum {
   FIO___MUSTACHE_I_METADATA, /* raw text data, written for lambda support */
 #endif
 } fio___mustache_inst_e;
+
+/* the bound hash function (first instruction of every template) */
+typedef uint64_t (*fio___mustache_hash_fn)(fio_buf_info_s);
+#define FIO___MUSTACHE_HASH_FN_LEN (1 + sizeof(fio___mustache_hash_fn))
 /* *****************************************************************************
 Instructions - Main processor
 ***************************************************************************** */
@@ -166,6 +281,7 @@ FIO_SFUNC char *fio___mustache_i_ary(char *p, fio___mustache_bldr_s *);
 FIO_SFUNC char *fio___mustache_i_missing(char *p, fio___mustache_bldr_s *);
 FIO_SFUNC char *fio___mustache_i_padding_push(char *p, fio___mustache_bldr_s *);
 FIO_SFUNC char *fio___mustache_i_padding_pop(char *p, fio___mustache_bldr_s *);
+FIO_SFUNC char *fio___mustache_i_hash_fn(char *p, fio___mustache_bldr_s *);
 #if FIO_MUSTACHE_PRESERVE_PADDING
 FIO_SFUNC char *fio___mustache_i_var_padded(char *p, fio___mustache_bldr_s *);
 FIO_SFUNC char *fio___mustache_i_var_raw_padded(char *,
@@ -187,6 +303,7 @@ FIO_SFUNC void *fio___mustache_build_section(char *p, fio___mustache_bldr_s a) {
     [FIO___MUSTACHE_I_MISSING] = fio___mustache_i_missing,
     [FIO___MUSTACHE_I_PADDING_PUSH] = fio___mustache_i_padding_push,
     [FIO___MUSTACHE_I_PADDING_POP] = fio___mustache_i_padding_pop,
+    [FIO___MUSTACHE_I_HASH_FN] = fio___mustache_i_hash_fn,
 #if FIO_MUSTACHE_PRESERVE_PADDING
     [FIO___MUSTACHE_I_VAR_PADDED] = fio___mustache_i_var_padded,
     [FIO___MUSTACHE_I_VAR_RAW_PADDED] = fio___mustache_i_var_raw_padded,
@@ -210,9 +327,13 @@ Instructions - Helpers
  */
 FIO_IFUNC void *fio___mustache_get_var_in_context(fio_mustache_bargs_s *a,
                                                   void *ctx,
-                                                  fio_buf_info_s *val_name) {
-  void *v = ctx;
-  v = a->get_var(ctx, *val_name);
+                                                  fio_buf_info_s *val_name,
+                                                  uint64_t hash) {
+  void *v;
+  if (hash && a->get_var_hashed)
+    v = a->get_var_hashed(ctx, *val_name, hash);
+  else
+    v = a->get_var(ctx, *val_name);
   if (v) {
     val_name->len = 0;
     return v;
@@ -237,13 +358,14 @@ FIO_IFUNC void *fio___mustache_get_var_in_context(fio_mustache_bargs_s *a,
 }
 
 FIO_IFUNC void *fio___mustache_get_var(fio___mustache_bldr_s *b,
-                                       fio_buf_info_s val_name) {
+                                       fio_buf_info_s val_name,
+                                       uint64_t hash) {
   void *v = b->ctx;
   if (val_name.len == 1 && val_name.buf[0] == '.')
     return v;
   for (;;) {
     if (b->ctx)
-      v = fio___mustache_get_var_in_context(b->args, b->ctx, &val_name);
+      v = fio___mustache_get_var_in_context(b->args, b->ctx, &val_name, hash);
     if (v)
       break;
 #if FIO_MUSTACHE_ISOLATE_PARTIALS
@@ -255,14 +377,14 @@ FIO_IFUNC void *fio___mustache_get_var(fio___mustache_bldr_s *b,
       return v;
   }
   while (val_name.len && v)
-    v = fio___mustache_get_var_in_context(b->args, v, &val_name);
+    v = fio___mustache_get_var_in_context(b->args, v, &val_name, 0);
   return v;
 }
 
 FIO_SFUNC void fio___mustache_write_padding(fio___mustache_bldr_s *b) {
   while (b && b->padding.len) {
     if (b->padding.buf) {
-      b->args->udata = b->args->write_text(b->args->udata, b->padding);
+      b->args->udata = b->args->write_text_static(b->args->udata, b->padding);
     }
     b = b->prev;
   }
@@ -360,7 +482,7 @@ FIO_SFUNC char *fio___mustache_i_goto_push(char *p, fio___mustache_bldr_s *b) {
 FIO_SFUNC char *fio___mustache_i_txt(char *p, fio___mustache_bldr_s *b) {
   fio_buf_info_s txt = FIO_BUF_INFO2(p + 3, fio_buf2u16u(p + 1));
   p = txt.buf + txt.len;
-  fio___mustache_writer_route(b, txt, b->args->write_text);
+  fio___mustache_writer_route(b, txt, b->args->write_text_static);
   return p;
 }
 
@@ -368,9 +490,10 @@ FIO_IFUNC char *fio___mustache_i_var_internal(
     char *p,
     fio___mustache_bldr_s *b,
     void *(*writer)(void *, fio_buf_info_s txt)) {
-  fio_buf_info_s var = FIO_BUF_INFO2(p + 3, fio_buf2u16u(p + 1));
+  fio_buf_info_s var = FIO_BUF_INFO2(p + 11, fio_buf2u16u(p + 1));
+  uint64_t hash = fio_buf2u64u(p + 3);
   p = var.buf + var.len;
-  void *v = fio___mustache_get_var(b, var);
+  void *v = fio___mustache_get_var(b, var, hash);
   if (!v)
     return p;
   var = b->args->var2str(v);
@@ -391,8 +514,9 @@ FIO_SFUNC char *fio___mustache_i_var_raw(char *p, fio___mustache_bldr_s *b) {
 }
 
 FIO_SFUNC char *fio___mustache_i_ary(char *p, fio___mustache_bldr_s *b) {
-  fio_buf_info_s var = FIO_BUF_INFO2(p + 7, fio_buf2u16u(p + 1));
+  fio_buf_info_s var = FIO_BUF_INFO2(p + 15, fio_buf2u16u(p + 1));
   uint32_t skip_pos = fio_buf2u32u(p + 3);
+  uint64_t hash = fio_buf2u64u(p + 7);
   p = b->root + skip_pos;
 #if FIO_MUSTACHE_LAMBDA_SUPPORT
   fio_buf_info_s section_raw_txt = FIO_BUF_INFO2(NULL, 0);
@@ -404,7 +528,7 @@ FIO_SFUNC char *fio___mustache_i_ary(char *p, fio___mustache_bldr_s *b) {
   const fio_buf_info_s section_raw_txt = FIO_BUF_INFO2(NULL, 0);
 #endif
 
-  void *v = fio___mustache_get_var(b, var);
+  void *v = fio___mustache_get_var(b, var, hash);
   if (!(b->args->var_is_truthful(v)))
     return p;
   size_t index = 0;
@@ -434,11 +558,12 @@ FIO_SFUNC char *fio___mustache_i_ary(char *p, fio___mustache_bldr_s *b) {
   }
 }
 FIO_SFUNC char *fio___mustache_i_missing(char *p, fio___mustache_bldr_s *b) {
-  fio_buf_info_s var = FIO_BUF_INFO2(p + 7, fio_buf2u16u(p + 1));
+  fio_buf_info_s var = FIO_BUF_INFO2(p + 15, fio_buf2u16u(p + 1));
   uint32_t skip_pos = fio_buf2u32u(p + 3);
+  uint64_t hash = fio_buf2u64u(p + 7);
   p = b->root + skip_pos;
 
-  void *v = fio___mustache_get_var(b, var);
+  void *v = fio___mustache_get_var(b, var, hash);
   if (b->args->var_is_truthful(v)) {
     b->args->release_var(v);
     return p;
@@ -466,14 +591,19 @@ FIO_SFUNC char *fio___mustache_i_padding_pop(char *p,
     b->padding.len = b->prev->padding.len;
   return p + 1;
 }
+FIO_SFUNC char *fio___mustache_i_hash_fn(char *p, fio___mustache_bldr_s *b) {
+  return p + FIO___MUSTACHE_HASH_FN_LEN;
+  (void)b;
+}
 
 #if FIO_MUSTACHE_PRESERVE_PADDING
 
 FIO_SFUNC char *fio___mustache_i_var_padded(char *p, fio___mustache_bldr_s *b) {
-  fio_buf_info_s var = FIO_BUF_INFO2(p + 5, fio_buf2u16u(p + 1));
-  fio_buf_info_s padding = FIO_BUF_INFO2(p + 5 + var.len, fio_buf2u16u(p + 3));
+  fio_buf_info_s var = FIO_BUF_INFO2(p + 13, fio_buf2u16u(p + 1));
+  fio_buf_info_s padding = FIO_BUF_INFO2(p + 13 + var.len, fio_buf2u16u(p + 3));
+  uint64_t hash = fio_buf2u64u(p + 5);
   p = padding.buf + padding.len;
-  void *v = fio___mustache_get_var(b, var);
+  void *v = fio___mustache_get_var(b, var, hash);
   if (!v)
     return p;
   var = b->args->var2str(v);
@@ -488,10 +618,11 @@ done:
 }
 FIO_SFUNC char *fio___mustache_i_var_raw_padded(char *p,
                                                 fio___mustache_bldr_s *b) {
-  fio_buf_info_s var = FIO_BUF_INFO2(p + 5, fio_buf2u16u(p + 1));
-  fio_buf_info_s padding = FIO_BUF_INFO2(p + 5 + var.len, fio_buf2u16u(p + 3));
+  fio_buf_info_s var = FIO_BUF_INFO2(p + 13, fio_buf2u16u(p + 1));
+  fio_buf_info_s padding = FIO_BUF_INFO2(p + 13 + var.len, fio_buf2u16u(p + 3));
+  uint64_t hash = fio_buf2u64u(p + 5);
   p = padding.buf + padding.len;
-  void *v = fio___mustache_get_var(b, var);
+  void *v = fio___mustache_get_var(b, var, hash);
   if (!v)
     return p;
   var = b->args->var2str(v);
@@ -500,6 +631,7 @@ FIO_SFUNC char *fio___mustache_i_var_raw_padded(char *p,
   fio___mustache_bldr_s b2 = *b;
   b2.padding = padding;
   fio___mustache_writer_route(&b2, var, b->args->write_text);
+done:
   b->args->release_var(v);
   return p;
 }
@@ -707,7 +839,7 @@ FIO_IFUNC int fio___mustache_parse_section_end(fio___mustache_parser_s *p,
   prev = p->root + p->starts_at;
   if (*prev != FIO___MUSTACHE_I_ARY && *prev != FIO___MUSTACHE_I_MISSING)
     goto section_not_open;
-  old_var_name = FIO_BUF_INFO2(prev + 7, (size_t)fio_buf2u16u(prev + 1));
+  old_var_name = FIO_BUF_INFO2(prev + 15, (size_t)fio_buf2u16u(prev + 1));
   if (!FIO_BUF_INFO_IS_EQ(old_var_name, var))
     goto value_name_mismatch;
 
@@ -768,14 +900,14 @@ FIO_IFUNC int fio___mustache_parse_section_start(fio___mustache_parser_s *p,
       .dirty = p->dirty,
   };
   union {
-    uint64_t u64[1];
-    char u8[8];
-  } buf;
+    uint64_t u64[2];
+    char u8[16];
+  } buf = {{0}};
   buf.u8[0] = FIO___MUSTACHE_I_ARY + inverted;
   fio_u2buf16u(buf.u8 + 1, var.len);
-  /* + 32 bit value to be filled by closure. */
+  /* + 32 bit value to be filled by closure, + 64 bit hash (see bind). */
   new_section.root = fio_bstr_write2(new_section.root,
-                                     FIO_STRING_WRITE_STR2(buf.u8, 7),
+                                     FIO_STRING_WRITE_STR2(buf.u8, 15),
                                      FIO_STRING_WRITE_STR2(var.buf, var.len));
 #if FIO_MUSTACHE_PRESERVE_PADDING
   if (!p->dirty && p->backwards.len) {
@@ -893,9 +1025,9 @@ FIO_IFUNC int fio___mustache_parse_var_name(fio___mustache_parser_s *p,
                                             fio_buf_info_s var,
                                             size_t raw) {
   union {
-    uint64_t u64[1];
-    char u8[8];
-  } buf;
+    uint64_t u64[2];
+    char u8[16];
+  } buf = {{0}};
   if (p->backwards.len > ((1 << 16) - 1))
     p->backwards.len = 0;
 
@@ -908,7 +1040,7 @@ FIO_IFUNC int fio___mustache_parse_var_name(fio___mustache_parser_s *p,
   buf.u8[0] = (char)(FIO___MUSTACHE_I_VAR + raw);
   fio_u2buf16u(buf.u8 + 1, var.len);
   p->root = fio_bstr_write2(p->root,
-                            FIO_STRING_WRITE_STR2(buf.u8, 3),
+                            FIO_STRING_WRITE_STR2(buf.u8, 11),
                             FIO_STRING_WRITE_STR2(var.buf, var.len));
   return 0;
 #if FIO_MUSTACHE_PRESERVE_PADDING
@@ -919,7 +1051,7 @@ padded:
   fio_u2buf16u(buf.u8 + 3, p->backwards.len);
   p->root = fio_bstr_write2(
       p->root,
-      FIO_STRING_WRITE_STR2(buf.u8, 5),
+      FIO_STRING_WRITE_STR2(buf.u8, 13),
       FIO_STRING_WRITE_STR2(var.buf, var.len),
       FIO_STRING_WRITE_STR2(p->backwards.buf, p->backwards.len));
   return 0;
@@ -1162,6 +1294,108 @@ FIO_SFUNC int fio___mustache_dflt_is_lambda(
   (void)raw_template_section, (void)ctx, (void)udata;
 }
 
+/* *****************************************************************************
+Building to a list of buffers (iov) - helpers
+***************************************************************************** */
+
+typedef struct fio___mustache_iov_blk_s {
+  struct fio___mustache_iov_blk_s *next;
+  size_t len;
+  size_t capa;
+} fio___mustache_iov_blk_s;
+
+/* memory blocks never move, so the buffers pointing to them remain valid. */
+#define FIO___MUSTACHE_IOV_BLK_SIZE 4096
+
+/* returns a memory block with at least `len` bytes available */
+FIO_SFUNC fio___mustache_iov_blk_s *fio___mustache_iov_reserve(
+    fio_mustache_iov_s *o,
+    size_t len) {
+  fio___mustache_iov_blk_s *b = o->block;
+  if (b) {
+    for (;;) {
+      if (b->capa - b->len >= len)
+        return (o->block = b);
+      if (!b->next)
+        break;
+      b = b->next; /* skipped blocks are reused on the next render */
+    }
+  }
+  size_t capa = FIO___MUSTACHE_IOV_BLK_SIZE - sizeof(*b);
+  if (capa < len)
+    capa = len;
+  fio___mustache_iov_blk_s *n = (fio___mustache_iov_blk_s *)FIO_MEM_REALLOC_(
+      NULL,
+      0,
+      sizeof(*n) + capa,
+      0);
+  FIO_ASSERT_ALLOC(n);
+  n->next = NULL;
+  n->len = 0;
+  n->capa = capa;
+  if (b)
+    b->next = n;
+  else
+    o->blocks = n;
+  return (o->block = n);
+}
+
+/* adds a buffer to the list, merging contiguous buffers */
+FIO_SFUNC void fio___mustache_iov_push(fio_mustache_iov_s *o,
+                                       fio_buf_info_s buf) {
+  if (!buf.len)
+    return;
+  o->len += buf.len;
+  if (o->count &&
+      o->iov[o->count - 1].buf + o->iov[o->count - 1].len == buf.buf) {
+    o->iov[o->count - 1].len += buf.len;
+    return;
+  }
+  if (o->count == o->capa) {
+    size_t capa = o->capa ? (o->capa << 1) : 32;
+    o->iov = (fio_buf_info_s *)FIO_MEM_REALLOC_(o->iov,
+                                                o->capa * sizeof(*o->iov),
+                                                capa * sizeof(*o->iov),
+                                                o->count * sizeof(*o->iov));
+    FIO_ASSERT_ALLOC(o->iov);
+    o->capa = capa;
+  }
+  o->iov[o->count++] = buf;
+}
+
+/* template text is valid for as long as the template is (no copy). */
+FIO_SFUNC void *fio___mustache_iov_write_static(void *u, fio_buf_info_s txt) {
+  fio___mustache_iov_push((fio_mustache_iov_s *)u, txt);
+  return u;
+}
+
+FIO_SFUNC void *fio___mustache_iov_write_text(void *u, fio_buf_info_s txt) {
+  fio_mustache_iov_s *o = (fio_mustache_iov_s *)u;
+  if (!txt.len)
+    return u;
+  fio___mustache_iov_blk_s *b = fio___mustache_iov_reserve(o, txt.len);
+  char *dest = (char *)(b + 1) + b->len;
+  FIO_MEMCPY(dest, txt.buf, txt.len);
+  b->len += txt.len;
+  fio___mustache_iov_push(o, FIO_BUF_INFO2(dest, txt.len));
+  return u;
+}
+
+FIO_SFUNC void *fio___mustache_iov_write_escaped(void *u, fio_buf_info_s raw) {
+  fio_mustache_iov_s *o = (fio_mustache_iov_s *)u;
+  if (!raw.len)
+    return u;
+  /* HTML escaping reserves up to 7 bytes per escaped byte (+ NUL) */
+  fio___mustache_iov_blk_s *b =
+      fio___mustache_iov_reserve(o, (raw.len * 7) + 1);
+  fio_str_info_s d =
+      FIO_STR_INFO3((char *)(b + 1) + b->len, 0, (b->capa - b->len));
+  fio_string_write_html_escape(&d, NULL, raw.buf, raw.len);
+  b->len += d.len;
+  fio___mustache_iov_push(o, FIO_STR2BUF_INFO(d));
+  return u;
+}
+
 /* *****************************************************************************
 Public API
 ***************************************************************************** */
@@ -1199,7 +1433,10 @@ SFUNC fio_mustache_s *fio_mustache_load FIO_NOOP(fio_mustache_load_args_s a) {
     base_path = pathname.folder;
   }
   parser.args = &a;
-  parser.root = NULL;
+  { /* the first instruction holds the bound hash function (none yet) */
+    char hdr[FIO___MUSTACHE_HASH_FN_LEN] = {FIO___MUSTACHE_I_HASH_FN};
+    parser.root = fio_bstr_write(NULL, hdr, FIO___MUSTACHE_HASH_FN_LEN);
+  }
   parser.delim = fio___mustache_delimiter_init();
   parser.depth = 0;
   parser.fname = a.filename;
@@ -1260,6 +1497,15 @@ SFUNC void *fio_mustache_build FIO_NOOP(fio_mustache_s *m,
     args.release_var = fio___mustache_dflt_release_var;
   if (!args.is_lambda)
     args.is_lambda = fio___mustache_dflt_is_lambda;
+  if (!args.write_text_static)
+    args.write_text_static = args.write_text;
+  if (args.get_var_hashed) { /* was the template bound using `var_hash`? */
+    fio___mustache_hash_fn bound = NULL;
+    if (((char *)m)[0] == FIO___MUSTACHE_I_HASH_FN)
+      FIO_MEMCPY(&bound, (char *)m + 1, sizeof(bound));
+    if (!bound || bound != args.var_hash)
+      args.get_var_hashed = NULL;
+  }
 
   fio___mustache_bldr_s builder = {
       .root = (char *)m,
@@ -1269,6 +1515,449 @@ SFUNC void *fio_mustache_build FIO_NOOP(fio_mustache_s *m,
   return fio___mustache_build_section((char *)m, builder);
 }
 
+void fio_mustache_bind___(void); /* IDE marker */
+/** Pre-computes the hash value of every variable name in the template. */
+SFUNC void fio_mustache_bind(fio_mustache_s *m,
+                             uint64_t (*hash)(fio_buf_info_s name)) {
+  char *p = (char *)m;
+  if (!p || p[0] != FIO___MUSTACHE_I_HASH_FN)
+    return;
+  char *end = p + fio_bstr_len(p);
+  fio_buf_info_s name;
+  size_t hash_offset, padding;
+  FIO_MEMCPY(p + 1, &hash, sizeof(hash));
+  p += FIO___MUSTACHE_HASH_FN_LEN;
+  /* sections and partials are inlined, so instructions are walked in order */
+  while (p < end) {
+    padding = 0;
+    switch ((fio___mustache_inst_e)(uint8_t)p[0]) {
+    case FIO___MUSTACHE_I_STACK_POP: /* fall through */
+    case FIO___MUSTACHE_I_PADDING_POP: ++p; continue;
+    case FIO___MUSTACHE_I_STACK_PUSH: /* fall through */
+    case FIO___MUSTACHE_I_GOTO_PUSH: p += 5; continue;
+    case FIO___MUSTACHE_I_HASH_FN: p += FIO___MUSTACHE_HASH_FN_LEN; continue;
+    case FIO___MUSTACHE_I_VAR: /* fall through */
+    case FIO___MUSTACHE_I_VAR_RAW:
+      name = FIO_BUF_INFO2(p + 11, fio_buf2u16u(p + 1));
+      hash_offset = 3;
+      break;
+    case FIO___MUSTACHE_I_ARY: /* fall through */
+    case FIO___MUSTACHE_I_MISSING:
+      name = FIO_BUF_INFO2(p + 15, fio_buf2u16u(p + 1));
+      hash_offset = 7;
+      break;
+#if FIO_MUSTACHE_PRESERVE_PADDING
+    case FIO___MUSTACHE_I_VAR_PADDED: /* fall through */
+    case FIO___MUSTACHE_I_VAR_RAW_PADDED:
+      name = FIO_BUF_INFO2(p + 13, fio_buf2u16u(p + 1));
+      hash_offset = 5;
+      padding = fio_buf2u16u(p + 3);
+      break;
+#endif
+    default: /* text, padding and metadata: 16 bit length + data */
+      p += 3 + fio_buf2u16u(p + 1);
+      continue;
+    }
+    fio_u2buf64u(p + hash_offset, (hash ? hash(name) : 0));
+    p = name.buf + name.len + padding;
+  }
+}
+
+void fio_mustache_build_iov___(void); /* IDE marker */
+/** Builds the template into `dest` as a list of buffers. */
+SFUNC size_t fio_mustache_build_iov FIO_NOOP(fio_mustache_s *m,
+                                             fio_mustache_iov_s *dest,
+                                             fio_mustache_bargs_s args) {
+  if (!dest)
+    return 0;
+  dest->count = 0;
+  dest->len = 0;
+  for (fio___mustache_iov_blk_s *b = dest->blocks; b; b = b->next)
+    b->len = 0;
+  dest->block = dest->blocks;
+  if (dest->m != m) {
+    fio_mustache_free(dest->m);
+    dest->m = fio_mustache_dup(m);
+  }
+  if (!m)
+    return 0;
+  args.write_text = fio___mustache_iov_write_text;
+  args.write_text_escaped = fio___mustache_iov_write_escaped;
+  args.write_text_static = fio___mustache_iov_write_static;
+  args.udata = (void *)dest;
+  fio_mustache_build FIO_NOOP(m, args);
+  return dest->count;
+}
+
+/** Frees the memory used by a `fio_mustache_iov_s` (and zeroes it out). */
+SFUNC void fio_mustache_iov_destroy(fio_mustache_iov_s *o) {
+  if (!o)
+    return;
+  while (o->blocks) {
+    fio___mustache_iov_blk_s *next = o->blocks->next;
+    FIO_MEM_FREE_(o->blocks, sizeof(*o->blocks) + o->blocks->capa);
+    o->blocks = next;
+  }
+  FIO_MEM_FREE_(o->iov, o->capa * sizeof(*o->iov));
+  fio_mustache_free(o->m);
+  *o = (fio_mustache_iov_s){0};
+}
+
+/* *****************************************************************************
+Mustache Template Cache - Types
+***************************************************************************** */
+
+/* a cached file, possibly compiled as a (root) template */
+typedef struct {
+  FIO_LIST_NODE node; /* LRU order (most recently used last) */
+  uint64_t hash;      /* file name hash */
+  uint64_t content;   /* file content hash (0 == missing) */
+  int64_t mtime;      /* file modification time (when read) */
+  size_t size;        /* file size (when read) */
+  int64_t tested;     /* last time the file was tested for changes */
+  int64_t checked;    /* last time the template's files were checked */
+  char *data;         /* the file's content (fio_bstr) */
+  fio_mustache_s *m;  /* the compiled template (if loaded as a template) */
+  char *deps;         /* template files: [u64 content][u16 len][name] ... */
+  char *name;         /* the file name (NUL terminated) */
+  size_t name_len;
+} fio___mustache_cache_s;
+
+#define FIO___MUSTACHE_CACHE_HASH(o) ((*(o))->hash)
+#define FIO___MUSTACHE_CACHE_IS_EQ(a, b)                                       \
+  ((*(a))->hash == (*(b))->hash && (*(a))->name_len == (*(b))->name_len &&     \
+   !FIO_MEMCMP((*(a))->name, (*(b))->name, (*(a))->name_len))
+#define FIO___MUSTACHE_CACHE_IS_VALID(o) (*(o))
+FIO_TYPEDEF_IMAP_ARRAY(fio___mustache_cache_map,
+                       fio___mustache_cache_s *,
+                       uint32_t,
+                       FIO___MUSTACHE_CACHE_HASH,
+                       FIO___MUSTACHE_CACHE_IS_EQ,
+                       FIO___MUSTACHE_CACHE_IS_VALID)
+#undef FIO___MUSTACHE_CACHE_HASH
+#undef FIO___MUSTACHE_CACHE_IS_EQ
+#undef FIO___MUSTACHE_CACHE_IS_VALID
+
+static struct {
+  fio___mustache_cache_map_s map;
+  FIO_LIST_HEAD lru;
+  size_t memory;
+  size_t limit;
+  int64_t throttle;
+  fio_lock_i lock;
+  uint8_t at_exit;
+} fio___mustache_cache = {
+    .lru = {.next = &fio___mustache_cache.lru,
+            .prev = &fio___mustache_cache.lru},
+    .limit = FIO_MUSTACHE_CACHE_LIMIT,
+    .throttle = FIO_MUSTACHE_CACHE_THROTTLE,
+};
+
+/* *****************************************************************************
+Mustache Template Cache - Helpers (called while locked)
+***************************************************************************** */
+
+FIO_IFUNC size_t fio___mustache_cache_mem(fio___mustache_cache_s *e) {
+  return sizeof(*e) + e->name_len + 1 + (e->data ? fio_bstr_len(e->data) : 0) +
+         (e->m ? fio_bstr_len((char *)e->m) : 0) +
+         (e->deps ? fio_bstr_len(e->deps) : 0);
+}
+
+FIO_SFUNC fio___mustache_cache_s *fio___mustache_cache_find(
+    fio_buf_info_s name) {
+  fio___mustache_cache_s tmp = {.hash = fio_risky_hash(name.buf, name.len, 0),
+                                .name = name.buf,
+                                .name_len = name.len};
+  fio___mustache_cache_s **pe =
+      fio___mustache_cache_map_get(&fio___mustache_cache.map, &tmp);
+  return pe ? pe[0] : NULL;
+}
+
+FIO_SFUNC void fio___mustache_cache_destroy(fio___mustache_cache_s *e) {
+  fio___mustache_cache.memory -= fio___mustache_cache_mem(e);
+  fio___mustache_cache_map_remove(&fio___mustache_cache.map, e);
+  FIO_LIST_REMOVE(&e->node);
+  fio_mustache_free(e->m);
+  fio_bstr_free(e->data);
+  fio_bstr_free(e->deps);
+  FIO_MEM_FREE_(e, sizeof(*e) + e->name_len + 1);
+}
+
+/* evicts the least recently used entries (except `keep`) */
+FIO_SFUNC void fio___mustache_cache_evict(fio___mustache_cache_s *keep) {
+  FIO_LIST_EACH(fio___mustache_cache_s, node, &fio___mustache_cache.lru, e) {
+    if (fio___mustache_cache.memory <= fio___mustache_cache.limit)
+      return;
+    if (e != keep)
+      fio___mustache_cache_destroy(e);
+  }
+}
+
+FIO_SFUNC void fio___mustache_cache_at_exit(void *ignr_) {
+  fio_mustache_cache_clear();
+  (void)ignr_;
+}
+
+/* updates (or adds) a file's entry, returns a copy of the file's content. */
+FIO_SFUNC char *fio___mustache_cache_update(fio_buf_info_s name,
+                                            fio___mustache_cache_s *file,
+                                            uint64_t *content) {
+  fio___mustache_cache_s *e = fio___mustache_cache_find(name);
+  char *r = NULL;
+  if (!e) {
+    if (!file->data) /* don't cache missing files */
+      return r;
+    e = (fio___mustache_cache_s *)FIO_MEM_REALLOC_(NULL,
+                                                   0,
+                                                   sizeof(*e) + name.len + 1,
+                                                   0);
+    FIO_ASSERT_ALLOC(e);
+    *e = (fio___mustache_cache_s){
+        .hash = fio_risky_hash(name.buf, name.len, 0),
+        .name = (char *)(e + 1),
+        .name_len = name.len,
+    };
+    FIO_MEMCPY(e->name, name.buf, name.len);
+    e->name[name.len] = 0;
+    fio___mustache_cache.memory += fio___mustache_cache_mem(e);
+    fio___mustache_cache_map_set(&fio___mustache_cache.map, e, 1);
+    FIO_LIST_PUSH(&fio___mustache_cache.lru, &e->node);
+    if (!fio___mustache_cache.at_exit) {
+      fio___mustache_cache.at_exit = 1;
+      fio_state_callback_add(FIO_CALL_AT_EXIT,
+                             fio___mustache_cache_at_exit,
+                             NULL);
+    }
+  }
+  fio___mustache_cache.memory -= fio___mustache_cache_mem(e);
+  e->tested = file->tested;
+  e->mtime = file->mtime;
+  e->size = file->size;
+  if (!file->data || file->content != e->content) {
+    fio_bstr_free(e->data);
+    e->data = file->data;
+    e->content = file->content;
+    file->data = NULL;
+  }
+  fio___mustache_cache.memory += fio___mustache_cache_mem(e);
+  if (e->data) {
+    r = fio_bstr_copy(e->data);
+    *content = e->content;
+  }
+  return r;
+}
+
+/* *****************************************************************************
+Mustache Template Cache - Loading (file access happens without the lock)
+***************************************************************************** */
+
+/* returns a copy of the (cached) file's content, or NULL if it's missing. */
+FIO_SFUNC char *fio___mustache_cache_file(fio_buf_info_s name,
+                                          uint64_t *content) {
+  fio___mustache_cache_s file = {.tested = fio_time_milli()};
+  fio___mustache_cache_s *e;
+  struct stat st;
+  char *path;
+  char *r = NULL;
+  fio_lock(&fio___mustache_cache.lock);
+  e = fio___mustache_cache_find(name);
+  if (e && e->data) {
+    FIO_LIST_REMOVE(&e->node);
+    FIO_LIST_PUSH(&fio___mustache_cache.lru, &e->node);
+    if (file.tested - e->tested < fio___mustache_cache.throttle) {
+      r = fio_bstr_copy(e->data);
+      *content = e->content;
+    } else { /* test the file (for changes) after unlocking */
+      file.mtime = e->mtime;
+      file.size = e->size;
+      file.content = e->content;
+    }
+  }
+  fio_unlock(&fio___mustache_cache.lock);
+  if (r)
+    return r;
+  path = fio_bstr_write(NULL, name.buf, name.len);
+  if (stat(path, &st) || (size_t)st.st_size > ((size_t)1 << 30))
+    goto update;
+  if (file.content && (int64_t)st.st_mtime == file.mtime &&
+      (size_t)st.st_size == file.size) { /* unchanged, keep the cached data */
+    fio_lock(&fio___mustache_cache.lock);
+    e = fio___mustache_cache_find(name);
+    if (e && e->data && e->content == file.content) {
+      e->tested = file.tested;
+      r = fio_bstr_copy(e->data);
+      *content = e->content;
+    }
+    fio_unlock(&fio___mustache_cache.lock);
+    if (r)
+      goto finish;
+  }
+  file.data = fio_bstr_readfile(NULL, path, 0, 0);
+  if (file.data) {
+    file.mtime = (int64_t)st.st_mtime;
+    file.size = (size_t)st.st_size;
+    file.content = fio_risky_hash(file.data, fio_bstr_len(file.data), 0);
+    file.content += !file.content;
+  }
+update:
+  if (!file.data)
+    file = (fio___mustache_cache_s){.tested = file.tested};
+  fio_lock(&fio___mustache_cache.lock);
+  r = fio___mustache_cache_update(name, &file, content);
+  fio_unlock(&fio___mustache_cache.lock);
+  fio_bstr_free(file.data); /* if the content didn't change */
+finish:
+  fio_bstr_free(path);
+  return r;
+}
+
+/* returns non-zero if any of the template's files changed. */
+FIO_SFUNC int fio___mustache_cache_is_stale(char *deps) {
+  char *p = deps;
+  char *end = p + fio_bstr_len(p);
+  while (p < end) {
+    fio_buf_info_s name = FIO_BUF_INFO2(p + 10, fio_buf2u16u(p + 8));
+    uint64_t content = 0;
+    char *data = fio___mustache_cache_file(name, &content);
+    fio_bstr_free(data);
+    if (!data || content != fio_buf2u64u(p))
+      return 1;
+    p = name.buf + name.len;
+  }
+  return 0;
+}
+
+/* load_file_data callback - loads files through the cache. */
+FIO_SFUNC fio_buf_info_s fio___mustache_cache_load(fio_buf_info_s name,
+                                                   void *udata) {
+  char **deps = (char **)udata;
+  fio_buf_info_s r = {0};
+  uint64_t content = 0;
+  char *data;
+  char buf[10];
+  if (!name.len || name.len > 0xFFFF)
+    return r;
+  data = fio___mustache_cache_file(name, &content);
+  if (!data)
+    return r;
+  fio_u2buf64u(buf, content);
+  fio_u2buf16u(buf + 8, name.len);
+  *deps = fio_bstr_write2(*deps,
+                          FIO_STRING_WRITE_STR2(buf, 10),
+                          FIO_STRING_WRITE_STR2(name.buf, name.len));
+  return fio_bstr_buf(data); /* a copy, the cached data may be replaced */
+}
+
+/* free_file_data callback */
+FIO_SFUNC void fio___mustache_cache_unload(fio_buf_info_s data, void *udata) {
+  fio_bstr_free(data.buf);
+  (void)udata;
+}
+
+/* *****************************************************************************
+Mustache Template Cache - Public API
+***************************************************************************** */
+
+void fio_mustache_cache_get___(void); /* IDE marker */
+/** Returns a compiled template from the process-wide template cache. */
+SFUNC fio_mustache_s *fio_mustache_cache_get FIO_NOOP(
+    fio_mustache_cache_args_s args) {
+  fio_mustache_s *r = NULL;
+  fio_mustache_s *m;
+  fio___mustache_cache_s *e;
+  char *deps = NULL;
+  int64_t now;
+  if (!args.filename.buf)
+    return r;
+  if (!args.filename.len)
+    args.filename.len = FIO_STRLEN(args.filename.buf);
+  if (args.filename.len > 0xFFFF)
+    return r;
+  now = fio_time_milli();
+  fio_lock(&fio___mustache_cache.lock);
+  e = fio___mustache_cache_find(args.filename);
+  if (e && e->m) {
+    FIO_LIST_REMOVE(&e->node);
+    FIO_LIST_PUSH(&fio___mustache_cache.lru, &e->node);
+    r = fio_mustache_dup(e->m);
+    if (now - e->checked >= fio___mustache_cache.throttle) {
+      e->checked = now; /* other threads use the template while we test it */
+      deps = fio_bstr_copy(e->deps);
+    }
+  }
+  fio_unlock(&fio___mustache_cache.lock);
+  if (r) {
+    int stale = deps && fio___mustache_cache_is_stale(deps);
+    fio_bstr_free(deps);
+    deps = NULL;
+    if (!stale)
+      return r;
+  }
+  /* (re)compile the template (files are loaded through the cache) */
+  m = fio_mustache_load(.filename = args.filename,
+                        .load_file_data = fio___mustache_cache_load,
+                        .free_file_data = fio___mustache_cache_unload,
+                        .udata = (void *)&deps);
+  if (m && args.var_hash)
+    fio_mustache_bind(m, args.var_hash);
+  fio_lock(&fio___mustache_cache.lock);
+  e = fio___mustache_cache_find(args.filename);
+  if (!m || !e) {
+    fio_bstr_free(deps);
+    fio_mustache_free(r);
+    r = NULL;
+    if (e && e->m && e->data) { /* keep the last valid template */
+      FIO_LOG_WARNING("(mustache) template cache: couldn't reload %.*s",
+                      (int)args.filename.len,
+                      args.filename.buf);
+      r = fio_mustache_dup(e->m);
+    } else if (e && e->m) { /* the template's file was removed */
+      fio___mustache_cache.memory -= fio___mustache_cache_mem(e);
+      fio_mustache_free(e->m);
+      fio_bstr_free(e->deps);
+      e->m = NULL;
+      e->deps = NULL;
+      fio___mustache_cache.memory += fio___mustache_cache_mem(e);
+    }
+    fio_mustache_free(m);
+    goto finish;
+  }
+  fio___mustache_cache.memory -= fio___mustache_cache_mem(e);
+  fio_mustache_free(e->m); /* templates in use hold their own reference */
+  fio_bstr_free(e->deps);
+  e->m = m;
+  e->deps = deps;
+  e->checked = now;
+  fio___mustache_cache.memory += fio___mustache_cache_mem(e);
+  fio_mustache_free(r);
+  r = fio_mustache_dup(m);
+  fio___mustache_cache_evict(e);
+finish:
+  fio_unlock(&fio___mustache_cache.lock);
+  return r;
+}
+
+/** Sets the template cache's memory limit and file change test interval. */
+SFUNC void fio_mustache_cache_config(size_t memory_limit, int64_t throttle) {
+  fio_lock(&fio___mustache_cache.lock);
+  fio___mustache_cache.limit =
+      memory_limit ? memory_limit : FIO_MUSTACHE_CACHE_LIMIT;
+  fio___mustache_cache.throttle =
+      (throttle < 0) ? FIO_MUSTACHE_CACHE_THROTTLE : throttle;
+  fio___mustache_cache_evict(NULL);
+  fio_unlock(&fio___mustache_cache.lock);
+}
+
+/** Removes all templates from the cache (templates in use remain valid). */
+SFUNC void fio_mustache_cache_clear(void) {
+  fio_lock(&fio___mustache_cache.lock);
+  FIO_LIST_EACH(fio___mustache_cache_s, node, &fio___mustache_cache.lru, e) {
+    fio___mustache_cache_destroy(e);
+  }
+  fio___mustache_cache_map_destroy(&fio___mustache_cache.map);
+  fio_unlock(&fio___mustache_cache.lock);
+}
+
 /* *****************************************************************************
 Cleanup
 ***************************************************************************** */
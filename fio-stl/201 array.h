@@ -662,6 +662,7 @@ SFUNC void FIO_NAME(FIO_ARRAY_NAME, destroy)(FIO_ARRAY_PTR ary_) {
 SFUNC uint32_t FIO_NAME(FIO_ARRAY_NAME, reserve)(FIO_ARRAY_PTR ary_,
                                                  int64_t capa_) {
   FIO_PTR_TAG_VALID_OR_RETURN(ary_, 0);
+  FIO_PTR_TAG_WRITABLE_OR_RETURN(ary_, 0);
   FIO_NAME(FIO_ARRAY_NAME, s) *ary =
       FIO_PTR_TAG_GET_UNTAGGED(FIO_NAME(FIO_ARRAY_NAME, s), ary_);
   if (capa_ > UINT32_MAX || capa_ < ((int64_t)0LL - UINT32_MAX))
@@ -775,6 +776,7 @@ SFUNC FIO_ARRAY_PTR FIO_NAME(FIO_ARRAY_NAME, concat)(FIO_ARRAY_PTR dest_,
                                                      FIO_ARRAY_PTR src_) {
   FIO_PTR_TAG_VALID_OR_RETURN(dest_, (FIO_ARRAY_PTR)NULL);
   FIO_PTR_TAG_VALID_OR_RETURN(src_, (FIO_ARRAY_PTR)NULL);
+  FIO_PTR_TAG_WRITABLE_OR_RETURN(dest_, (FIO_ARRAY_PTR)NULL);
   FIO_NAME(FIO_ARRAY_NAME, s) *dest =
       FIO_PTR_TAG_GET_UNTAGGED(FIO_NAME(FIO_ARRAY_NAME, s), dest_);
   FIO_NAME(FIO_ARRAY_NAME, s) *src =
@@ -844,6 +846,7 @@ SFUNC FIO_ARRAY_TYPE *FIO_NAME(FIO_ARRAY_NAME, set)(FIO_ARRAY_PTR ary_,
   uint8_t pre_existing = 1;
 
   FIO_PTR_TAG_VALID_OR_GOTO(ary_, invalid);
+  FIO_PTR_TAG_WRITABLE_OR_GOTO(ary_, invalid);
 
   ary = FIO_PTR_TAG_GET_UNTAGGED(FIO_NAME(FIO_ARRAY_NAME, s), ary_);
   count = FIO_NAME(FIO_ARRAY_NAME, count)(ary_);
@@ -1025,6 +1028,7 @@ SFUNC int FIO_NAME(FIO_ARRAY_NAME, remove)(FIO_ARRAY_PTR ary_,
   size_t count;
   if (!a)
     goto invalid;
+  FIO_PTR_TAG_WRITABLE_OR_GOTO(ary_, invalid);
   count = FIO_NAME(FIO_ARRAY_NAME, count)(ary_);
 
   if (index < 0) {
@@ -1093,6 +1097,7 @@ SFUNC uint32_t FIO_NAME(FIO_ARRAY_NAME, remove2)(FIO_ARRAY_PTR ary_,
   size_t count;
   if (!a)
     return (uint32_t)c;
+  FIO_PTR_TAG_WRITABLE_OR_RETURN(ary_, 0);
   count = FIO_NAME(FIO_ARRAY_NAME, count)(ary_);
 
   size_t i = 0;
@@ -1120,6 +1125,7 @@ SFUNC uint32_t FIO_NAME(FIO_ARRAY_NAME, remove2)(FIO_ARRAY_PTR ary_,
 /** Attempts to lower the array's memory consumption. */
 SFUNC void FIO_NAME(FIO_ARRAY_NAME, compact)(FIO_ARRAY_PTR ary_) {
   FIO_PTR_TAG_VALID_OR_RETURN_VOID(ary_);
+  FIO_PTR_TAG_WRITABLE_OR_RETURN_VOID(ary_);
   FIO_NAME(FIO_ARRAY_NAME, s) *ary =
       FIO_PTR_TAG_GET_UNTAGGED(FIO_NAME(FIO_ARRAY_NAME, s), ary_);
   size_t count = FIO_NAME(FIO_ARRAY_NAME, count)(ary_);
@@ -1170,6 +1176,7 @@ SFUNC FIO_ARRAY_TYPE *FIO_NAME(FIO_ARRAY_NAME, push)(FIO_ARRAY_PTR ary_,
                                                      FIO_ARRAY_TYPE data) {
   FIO_NAME(FIO_ARRAY_NAME, s) *ary =
       FIO_PTR_TAG_GET_UNTAGGED(FIO_NAME(FIO_ARRAY_NAME, s), ary_);
+  FIO_PTR_TAG_WRITABLE_OR_GOTO(ary_, invalid);
   switch (FIO_NAME_BL(FIO_ARRAY_NAME, embedded)(ary_)) {
   case 0:
     if (ary->end == ary->capa) {
@@ -1223,6 +1230,7 @@ SFUNC int FIO_NAME(FIO_ARRAY_NAME, pop)(FIO_ARRAY_PTR ary_,
                                         FIO_ARRAY_TYPE *old) {
   FIO_NAME(FIO_ARRAY_NAME, s) *ary =
       FIO_PTR_TAG_GET_UNTAGGED(FIO_NAME(FIO_ARRAY_NAME, s), ary_);
+  FIO_PTR_TAG_WRITABLE_OR_GOTO(ary_, invalid);
   switch (FIO_NAME_BL(FIO_ARRAY_NAME, embedded)(ary_)) {
   case 0:
     if (ary->end == ary->start)
@@ -1254,6 +1262,7 @@ SFUNC int FIO_NAME(FIO_ARRAY_NAME, pop)(FIO_ARRAY_PTR ary_,
                sizeof(*ary->ary));
     return 0;
   }
+invalid:
   if (old)
     FIO_ARRAY_TYPE_COPY(old[0], FIO_ARRAY_TYPE_INVALID);
   return -1;
@@ -1268,6 +1277,7 @@ SFUNC FIO_ARRAY_TYPE *FIO_NAME(FIO_ARRAY_NAME, unshift)(FIO_ARRAY_PTR ary_,
                                                         FIO_ARRAY_TYPE data) {
   FIO_NAME(FIO_ARRAY_NAME, s) *ary =
       FIO_PTR_TAG_GET_UNTAGGED(FIO_NAME(FIO_ARRAY_NAME, s), ary_);
+  FIO_PTR_TAG_WRITABLE_OR_GOTO(ary_, invalid);
   switch (FIO_NAME_BL(FIO_ARRAY_NAME, embedded)(ary_)) {
   case 0:
     if (!ary->start) {
@@ -1330,6 +1340,7 @@ SFUNC int FIO_NAME(FIO_ARRAY_NAME, shift)(FIO_ARRAY_PTR ary_,
 
   FIO_NAME(FIO_ARRAY_NAME, s) *ary =
       FIO_PTR_TAG_GET_UNTAGGED(FIO_NAME(FIO_ARRAY_NAME, s), ary_);
+  FIO_PTR_TAG_WRITABLE_OR_GOTO(ary_, invalid);
 
   switch (FIO_NAME_BL(FIO_ARRAY_NAME, embedded)(ary_)) {
   case 0:
@@ -1368,6 +1379,7 @@ SFUNC int FIO_NAME(FIO_ARRAY_NAME, shift)(FIO_ARRAY_PTR ary_,
                sizeof(*ary->ary));
     return 0;
   }
+invalid:
   if (old)
     FIO_ARRAY_TYPE_COPY(old[0], FIO_ARRAY_TYPE_INVALID);
   return -1;
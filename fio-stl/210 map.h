@@ -152,6 +152,21 @@ FIO_SFUNC void FIO_NAME(FIO_MAP_NAME, __key_free)(void *ptr, size_t len) {
 #define FIO_MAP_ORDERED 0
 #endif
 
+/* FIO_MAP_INCREMENTAL - if true, larger maps are rehashed incrementally. */
+#ifndef FIO_MAP_INCREMENTAL
+#define FIO_MAP_INCREMENTAL 0
+#elif ((0 - FIO_MAP_INCREMENTAL - 1) == 1) /* defined as an empty macro */
+#undef FIO_MAP_INCREMENTAL
+#define FIO_MAP_INCREMENTAL 1 /* assume developer's intention */
+#endif
+#if FIO_MAP_INCREMENTAL && FIO_MAP_ORDERED
+#error "FIO_MAP_INCREMENTAL requires an unordered map (FIO_UMAP_NAME)."
+#endif
+#ifndef FIO_MAP_INCREMENTAL_SLOTS
+/* The number of old slots migrated by every map operation while rehashing. */
+#define FIO_MAP_INCREMENTAL_SLOTS 32
+#endif
+
 /* *****************************************************************************
 Pointer Tagging Support
 ***************************************************************************** */
@@ -184,6 +199,14 @@ typedef struct FIO_NAME(FIO_MAP_NAME, s) {
 #if FIO_MAP_ORDERED
   FIO_INDEXED_LIST32_HEAD head;
 #endif
+#if FIO_MAP_INCREMENTAL
+  struct { /* the previous table, while migrating (internal usage) */
+    uint32_t bits;
+    uint32_t count; /* entries yet to be migrated */
+    uint32_t pos;   /* the next slot to be migrated */
+    FIO_NAME(FIO_MAP_NAME, node_s) * map;
+  } old;
+#endif
 } FIO_NAME(FIO_MAP_NAME, s);
 
 /** internal object data representation */
@@ -311,6 +334,17 @@ FIO_IFUNC FIO_MAP_GET_T FIO_NAME(FIO_MAP_NAME, get)(FIO_MAP_PTR map,
 #endif
                                                     FIO_MAP_KEY key);
 
+#if defined(FIO_MAP_HASH_FN)
+/**
+ * Gets a value from the map using a pre-computed hash value (the value
+ * `FIO_MAP_HASH_FN(key)` returns), avoiding the hashing step for keys that are
+ * looked up often.
+ */
+SFUNC FIO_MAP_GET_T FIO_NAME(FIO_MAP_NAME, get_hashed)(FIO_MAP_PTR map,
+                                                       uint64_t hash,
+                                                       FIO_MAP_KEY key);
+#endif
+
 /** Sets a value in the map, hash maps will overwrite existing data if any. */
 FIO_IFUNC FIO_MAP_GET_T FIO_NAME(FIO_MAP_NAME, set)(FIO_MAP_PTR map,
 #if !defined(FIO_MAP_HASH_FN)
@@ -723,6 +757,10 @@ struct FIO_NAME(FIO_MAP_NAME, __imap_s) {
 #ifndef FIO_MAP_SEEK_LIMIT
 #define FIO_MAP_SEEK_LIMIT 13U
 #endif
+#ifndef FIO_MAP_LOAD_LIMIT
+/* maximum number of entries before larger maps grow (7/8 of capacity) */
+#define FIO_MAP_LOAD_LIMIT(capa) ((capa) - ((capa) >> 3))
+#endif
 #ifndef FIO_MAP_ARRAY_LOG_LIMIT
 #define FIO_MAP_ARRAY_LOG_LIMIT 3
 #endif
@@ -788,6 +826,12 @@ typedef struct FIO_NAME(FIO_MAP_NAME, __each_node_s) {
   void *udata;
 } FIO_NAME(FIO_MAP_NAME, __each_node_s);
 
+#if FIO_MAP_INCREMENTAL
+/* completes a pending incremental rehash (blocking). */
+FIO_SFUNC int FIO_NAME(FIO_MAP_NAME,
+                       __rehash_finish)(FIO_NAME(FIO_MAP_NAME, s) * o);
+#endif
+
 void fio___map___each_node___(void); /* IDE Marker */
 /* perform task for each node. */
 FIO_IFUNC int FIO_NAME(FIO_MAP_NAME,
@@ -797,6 +841,10 @@ FIO_IFUNC int FIO_NAME(FIO_MAP_NAME,
                                     void *udata) {
   FIO_NAME(FIO_MAP_NAME, __each_node_s)
   each = {.map = o, .fn = fn, .udata = udata};
+#if FIO_MAP_INCREMENTAL
+  if (o->old.map) /* iteration is O(n) anyway, complete the migration */
+    FIO_NAME(FIO_MAP_NAME, __rehash_finish)(o);
+#endif
   uint8_t *imap = FIO_NAME(FIO_MAP_NAME, __imap)(o);
   size_t counter = o->count;
   if (!counter)
@@ -875,10 +923,37 @@ static int FIO_NAME(FIO_MAP_NAME,
 }
 #endif
 
+#if FIO_MAP_INCREMENTAL
+FIO_IFUNC void FIO_NAME(FIO_MAP_NAME, __free_map)(FIO_NAME(FIO_MAP_NAME, s) * o,
+                                                  _Bool should_destroy);
+/* Returns a (temporary) map object for the previous table. */
+FIO_IFUNC FIO_NAME(FIO_MAP_NAME, s)
+    FIO_NAME(FIO_MAP_NAME, __old_view)(FIO_NAME(FIO_MAP_NAME, s) * o) {
+  FIO_NAME(FIO_MAP_NAME, s) r = {0};
+  r.bits = o->old.bits;
+  r.count = o->old.count;
+  r.map = o->old.map;
+  return r;
+}
+/* Frees the previous table (destroying any entries not yet migrated). */
+FIO_IFUNC void FIO_NAME(FIO_MAP_NAME,
+                        __old_free)(FIO_NAME(FIO_MAP_NAME, s) * o,
+                                    _Bool should_destroy) {
+  FIO_NAME(FIO_MAP_NAME, s) old = FIO_NAME(FIO_MAP_NAME, __old_view)(o);
+  o->count -= o->old.count;
+  FIO_NAME(FIO_MAP_NAME, __free_map)(&old, should_destroy);
+  FIO_MEMSET(&o->old, 0, sizeof(o->old));
+}
+#endif
+
 /* Destroys and exsiting map. */
 FIO_IFUNC void FIO_NAME(FIO_MAP_NAME,
                         __destroy_map)(FIO_NAME(FIO_MAP_NAME, s) * o,
                                        _Bool should_zero) {
+#if FIO_MAP_INCREMENTAL
+  if (o->old.map)
+    FIO_NAME(FIO_MAP_NAME, __old_free)(o, 1);
+#endif
 #if !FIO_MAP_KEY_DESTROY_SIMPLE || !FIO_MAP_VALUE_DESTROY_SIMPLE
   FIO_NAME(FIO_MAP_NAME, __each_node)
   (o, FIO_NAME(FIO_MAP_NAME, __destroy_map_task), NULL);
@@ -895,6 +970,10 @@ FIO_IFUNC void FIO_NAME(FIO_MAP_NAME, __free_map)(FIO_NAME(FIO_MAP_NAME, s) * o,
     return;
   if (should_destroy)
     FIO_NAME(FIO_MAP_NAME, __destroy_map)(o, 0);
+#if FIO_MAP_INCREMENTAL
+  if (o->old.map)
+    FIO_NAME(FIO_MAP_NAME, __old_free)(o, 0);
+#endif
   FIO_MEM_FREE_(o->map, ((sizeof(o->map[0]) + 1) << o->bits));
   FIO_LEAK_COUNTER_ON_FREE(FIO_NAME(FIO_MAP_NAME, destroy));
   *o = (FIO_NAME(FIO_MAP_NAME, s)){0};
@@ -908,6 +987,97 @@ typedef struct {
   uint32_t alt;
   uint32_t bhash;
 } fio___map_node_info_s;
+
+/* Group probing result - a bitmap with one bit per imap byte in the group. */
+typedef struct {
+  uint32_t match;   /* bytes equal to the hash tag (byte hash) */
+  uint32_t empty;   /* bytes never occupied (0) */
+  uint32_t deleted; /* tombstones (255) */
+} fio___map_group_s;
+
+/* marks (0x80) every zero byte in a 64 bit word (no false positives). */
+#define FIO___MAP_SWAR_ZERO(w)                                                 \
+  (~((((w)&UINT64_C(0x7F7F7F7F7F7F7F7F)) + UINT64_C(0x7F7F7F7F7F7F7F7F)) |     \
+     (w) | UINT64_C(0x7F7F7F7F7F7F7F7F)))
+/* packs the 0x80 bits of a little endian word into an 8 bit bitmap. */
+#define FIO___MAP_SWAR_PACK(w)                                                 \
+  ((uint32_t)((((w) >> 7) * UINT64_C(0x0102040810204080)) >> 56))
+
+/* tests 16 imap bytes using SWAR (2 x 8 byte words). */
+FIO_IFUNC fio___map_group_s fio___map_group_swar(const uint8_t *imap,
+                                                 uint8_t tag) {
+  fio___map_group_s r = {0};
+  const uint64_t mtag = UINT64_C(0x0101010101010101) * tag;
+  for (size_t i = 0; i < 16; i += 8) {
+    const uint64_t w = fio_buf2u64_le(imap + i);
+    r.match |= FIO___MAP_SWAR_PACK(FIO___MAP_SWAR_ZERO(w ^ mtag)) << i;
+    r.empty |= FIO___MAP_SWAR_PACK(FIO___MAP_SWAR_ZERO(w)) << i;
+    r.deleted |= FIO___MAP_SWAR_PACK(FIO___MAP_SWAR_ZERO(~w)) << i;
+  }
+  return r;
+}
+#undef FIO___MAP_SWAR_ZERO
+#undef FIO___MAP_SWAR_PACK
+
+#if FIO___HAS_X86_INTRIN && defined(__AVX2__)
+/* The number of imap bytes tested at once. */
+#define FIO___MAP_GROUP_SIZE 32
+/* tests 32 imap bytes using AVX2. */
+FIO_IFUNC fio___map_group_s fio___map_group(const uint8_t *imap, uint8_t tag) {
+  const __m256i v = _mm256_loadu_si256((const __m256i *)imap);
+  fio___map_group_s r = {
+      (uint32_t)_mm256_movemask_epi8(
+          _mm256_cmpeq_epi8(v, _mm256_set1_epi8((char)tag))),
+      (uint32_t)_mm256_movemask_epi8(
+          _mm256_cmpeq_epi8(v, _mm256_setzero_si256())),
+      (uint32_t)_mm256_movemask_epi8(
+          _mm256_cmpeq_epi8(v, _mm256_set1_epi8((char)0xFF))),
+  };
+  return r;
+}
+
+#elif FIO___HAS_X86_INTRIN
+#define FIO___MAP_GROUP_SIZE 16
+/* tests 16 imap bytes using SSE2. */
+FIO_IFUNC fio___map_group_s fio___map_group(const uint8_t *imap, uint8_t tag) {
+  const __m128i v = _mm_loadu_si128((const __m128i *)imap);
+  fio___map_group_s r = {
+      (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8((char)tag))),
+      (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())),
+      (uint32_t)_mm_movemask_epi8(
+          _mm_cmpeq_epi8(v, _mm_set1_epi8((char)0xFF))),
+  };
+  return r;
+}
+
+#elif FIO___HAS_ARM_INTRIN && defined(__aarch64__)
+#define FIO___MAP_GROUP_SIZE 16
+/* packs a NEON comparison result (0xFF / 0x00 bytes) into a bitmap. */
+FIO_IFUNC uint32_t fio___map_group_neon2bitmap(uint8x16_t cmp) {
+  const uint8x16_t bits =
+      {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+  cmp = vandq_u8(cmp, bits);
+  return (uint32_t)vaddv_u8(vget_low_u8(cmp)) |
+         ((uint32_t)vaddv_u8(vget_high_u8(cmp)) << 8);
+}
+/* tests 16 imap bytes using NEON. */
+FIO_IFUNC fio___map_group_s fio___map_group(const uint8_t *imap, uint8_t tag) {
+  const uint8x16_t v = vld1q_u8(imap);
+  fio___map_group_s r = {
+      fio___map_group_neon2bitmap(vceqq_u8(v, vdupq_n_u8(tag))),
+      fio___map_group_neon2bitmap(vceqq_u8(v, vdupq_n_u8(0))),
+      fio___map_group_neon2bitmap(vceqq_u8(v, vdupq_n_u8(0xFF))),
+  };
+  return r;
+}
+
+#else
+#define FIO___MAP_GROUP_SIZE 16
+/* tests 16 imap bytes (SWAR). */
+FIO_IFUNC fio___map_group_s fio___map_group(const uint8_t *imap, uint8_t tag) {
+  return fio___map_group_swar(imap, tag);
+}
+#endif /* FIO___HAS_X86_INTRIN / FIO___HAS_ARM_INTRIN */
 #endif
 
 /** internal object data representation */
@@ -1017,7 +1187,7 @@ possible_attack:
   return r;
 }
 
-/* seek a node for larger collections, where 8 byte grouping is meaningless */
+/* seek a node for larger collections, testing groups of imap bytes at once */
 FIO_SFUNC fio___map_node_info_s FIO_NAME(FIO_MAP_NAME, __node_info_full)(
     FIO_NAME(FIO_MAP_NAME, s) * o,
     FIO_NAME(FIO_MAP_NAME, __o_node_s) * node) {
@@ -1028,80 +1198,18 @@ FIO_SFUNC fio___map_node_info_s FIO_NAME(FIO_MAP_NAME, __node_info_full)(
       (uint32_t)-1,
       (uint32_t)-1,
       (uint32_t)FIO_NAME(FIO_MAP_NAME, __byte_hash)(node->hash)};
-  const uint32_t mask = (FIO_MAP_CAPA(o->bits) - 1) & (~(uint32_t)7ULL);
+  const uint32_t mask = (FIO_MAP_CAPA(o->bits) - 1) &
+                        (~(uint32_t)(FIO___MAP_GROUP_SIZE - 1));
   const uint8_t *imap = FIO_NAME(FIO_MAP_NAME, __imap)(o);
   const size_t attempt_limit = o->bits + 7;
-  const uint64_t mbyte64 = ~(UINT64_C(0x0101010101010101) * (uint64_t)r.bhash);
   uint32_t guard = FIO_MAP_ATTACK_LIMIT;
   uint32_t pos = r.home = (node->hash & mask);
-  size_t attempt = 0;
-  for (; r.alt == (uint32_t)-1 && attempt < attempt_limit; ++attempt) {
-    uint64_t group = fio_buf2u64_le(imap + pos);
-    group ^= mbyte64;
-    group &= UINT64_C(0x7F7F7F7F7F7F7F7F);
-    group += UINT64_C(0x0101010101010101);
-    group &= UINT64_C(0x8080808080808080);
-    while (group) {
-      uint32_t offset = (uint32_t)fio_lsb_index_unsafe(group);
-      group ^= (uint64_t)1ULL << offset;
-      offset >>= 3;
-      offset += pos;
-      if (imap[offset] == r.bhash &&
-          FIO_NAME(FIO_MAP_NAME, __is_eq_hash)(o->map + offset, node->hash)) {
-        if (FIO_MAP_KEY_CMP(o->map[offset].key, node->key)) {
-          r.act = offset;
-          return r;
-        }
-        if (!--guard) {
-          r.act = offset;
-          goto possible_attack;
-        }
-      }
-    }
-    group = fio_buf2u64_le(imap + pos);
-    group &= UINT64_C(0x7F7F7F7F7F7F7F7F);
-    group += UINT64_C(0x0101010101010101);
-    group &= UINT64_C(0x8080808080808080);
-    while (group) {
-      uint32_t offset = (uint32_t)fio_lsb_index_unsafe(group);
-      group ^= (uint64_t)1ULL << offset;
-      offset >>= 3;
-      offset += pos;
-      if (imap[offset] == 255U) {
-        r.alt = offset;
-        break;
-      }
-    }
-    group = ~fio_buf2u64_le(imap + pos);
-    group &= UINT64_C(0x7F7F7F7F7F7F7F7F);
-    group += UINT64_C(0x0101010101010101);
-    group &= UINT64_C(0x8080808080808080);
-    while (group) {
-      uint32_t offset = (uint32_t)fio_lsb_index_unsafe(group);
-      group ^= (uint64_t)1ULL << offset;
-      offset >>= 3;
-      offset += pos;
-      if (!imap[offset]) {
-        r.alt = offset;
-        return r;
-      }
-    }
-    pos += (attempt + 2) << 3;
-    pos &= mask;
-  }
-  for (; attempt < attempt_limit; ++attempt) {
-    uint64_t group = fio_buf2u64_le(imap + pos);
-    group ^= mbyte64;
-    group &= UINT64_C(0x7F7F7F7F7F7F7F7F);
-    group += UINT64_C(0x0101010101010101);
-    group &= UINT64_C(0x8080808080808080);
-    while (group) {
-      uint32_t offset = (uint32_t)fio_lsb_index_unsafe(group);
-      group ^= (uint64_t)1ULL << offset;
-      offset >>= 3;
-      offset += pos;
-      if (imap[offset] == r.bhash &&
-          FIO_NAME(FIO_MAP_NAME, __is_eq_hash)(o->map + offset, node->hash)) {
+  for (size_t attempt = 0; attempt < attempt_limit; ++attempt) {
+    fio___map_group_s group = fio___map_group(imap + pos, (uint8_t)r.bhash);
+    while (group.match) {
+      uint32_t offset = pos + (uint32_t)fio_lsb_index_unsafe(group.match);
+      group.match &= group.match - 1;
+      if (FIO_NAME(FIO_MAP_NAME, __is_eq_hash)(o->map + offset, node->hash)) {
         if (FIO_MAP_KEY_CMP(o->map[offset].key, node->key)) {
           r.act = offset;
           return r;
@@ -1112,20 +1220,14 @@ FIO_SFUNC fio___map_node_info_s FIO_NAME(FIO_MAP_NAME, __node_info_full)(
         }
       }
     }
-    group = ~fio_buf2u64_le(imap + pos);
-    group &= UINT64_C(0x7F7F7F7F7F7F7F7F);
-    group += UINT64_C(0x0101010101010101);
-    group &= UINT64_C(0x8080808080808080);
-    while (group) {
-      uint32_t offset = (uint32_t)fio_lsb_index_unsafe(group);
-      group ^= (uint64_t)1ULL << offset;
-      offset >>= 3;
-      offset += pos;
-      if (!imap[offset]) {
-        return r;
-      }
+    if (r.alt == (uint32_t)-1 && group.deleted) /* reuse the first tombstone */
+      r.alt = pos + (uint32_t)fio_lsb_index_unsafe(group.deleted);
+    if (group.empty) { /* the key was never pushed past this group */
+      if (r.alt == (uint32_t)-1)
+        r.alt = pos + (uint32_t)fio_lsb_index_unsafe(group.empty);
+      return r;
     }
-    pos += (attempt + 2) << 3;
+    pos += (uint32_t)((attempt + 2) * FIO___MAP_GROUP_SIZE);
     pos &= mask;
   }
   if (r.alt == (uint32_t)-1)
@@ -1209,6 +1311,124 @@ FIO_IFUNC int FIO_NAME(FIO_MAP_NAME,
       __each_node)(src, FIO_NAME(FIO_MAP_NAME, __move2map_task), dest);
 }
 
+#if FIO_MAP_INCREMENTAL
+/* Moves an entry from the previous table to an (empty) slot in the map. */
+FIO_IFUNC void FIO_NAME(FIO_MAP_NAME,
+                        __rehash_move)(FIO_NAME(FIO_MAP_NAME, s) * o,
+                                       uint32_t from,
+                                       fio___map_node_info_s to) {
+  uint8_t *old_imap = (uint8_t *)(o->old.map + FIO_MAP_CAPA(o->old.bits));
+  FIO_NAME(FIO_MAP_NAME, __imap)(o)[to.alt] = (uint8_t)to.bhash;
+  o->map[to.alt] = o->old.map[from];
+  old_imap[from] = 255U; /* old probe sequences must continue past it */
+  if (!--o->old.count)
+    FIO_NAME(FIO_MAP_NAME, __old_free)(o, 0);
+}
+
+/* Migrates up to `slots` slots from the previous table. */
+FIO_SFUNC int FIO_NAME(FIO_MAP_NAME,
+                       __rehash_step)(FIO_NAME(FIO_MAP_NAME, s) * o,
+                                      size_t slots) {
+  const uint32_t capa = (uint32_t)FIO_MAP_CAPA(o->old.bits);
+  const uint8_t *old_imap = (uint8_t *)(o->old.map + capa);
+  for (; slots && o->old.pos < capa; --slots, ++o->old.pos) {
+    const uint32_t pos = o->old.pos;
+    if (!old_imap[pos] || old_imap[pos] == 255U)
+      continue;
+    FIO_NAME(FIO_MAP_NAME, __o_node_s)
+    node = {
+      .key = FIO_MAP_KEY_FROM_INTERNAL(o->old.map[pos].key),
+#if !FIO_MAP_RECALC_HASH
+      .hash = o->old.map[pos].hash,
+#endif
+    };
+    fio___map_node_info_s i = FIO_NAME(FIO_MAP_NAME, __node_info)(o, &node);
+    if (i.home == (uint32_t)-1)
+      return -1;
+    FIO_NAME(FIO_MAP_NAME, __rehash_move)(o, pos, i);
+    if (!o->old.map)
+      return 0;
+  }
+  if (o->old.pos == capa) /* all remaining slots are tombstones */
+    FIO_NAME(FIO_MAP_NAME, __old_free)(o, 0);
+  return 0;
+}
+
+FIO_SFUNC int FIO_NAME(FIO_MAP_NAME,
+                       __rehash_finish)(FIO_NAME(FIO_MAP_NAME, s) * o) {
+  if (!o->old.map ||
+      !FIO_NAME(FIO_MAP_NAME, __rehash_step)(o, FIO_MAP_CAPA(o->old.bits)))
+    return 0;
+  /* the map rejected an entry (collisions?), move both tables to a new map */
+  FIO_NAME(FIO_MAP_NAME, s) old = FIO_NAME(FIO_MAP_NAME, __old_view)(o);
+  FIO_NAME(FIO_MAP_NAME, s) cur = {0}, tmp;
+  cur.bits = o->bits;
+  cur.count = o->count - o->old.count;
+  cur.map = o->map;
+  for (uint32_t i = 1; i < 3; ++i) {
+    if (FIO_NAME(FIO_MAP_NAME, __allocate_map)(&tmp, o->bits + i))
+      break;
+    if (!FIO_NAME(FIO_MAP_NAME, __move2map)(&tmp, &cur) &&
+        !FIO_NAME(FIO_MAP_NAME, __move2map)(&tmp, &old)) {
+      FIO_NAME(FIO_MAP_NAME, __free_map)(&cur, 0);
+      FIO_NAME(FIO_MAP_NAME, __free_map)(&old, 0);
+      *o = tmp;
+      return 0;
+    }
+    FIO_NAME(FIO_MAP_NAME, __free_map)(&tmp, 0);
+  }
+  FIO_LOG_ERROR("couldn't complete map rehashing (capa: %zu)",
+                (size_t)FIO_MAP_CAPA(o->bits));
+  return -1;
+}
+
+/* Starts an incremental rehash, returns -1 if a (blocking) rehash is needed */
+FIO_IFUNC int FIO_NAME(FIO_MAP_NAME,
+                       __rehash_start)(FIO_NAME(FIO_MAP_NAME, s) * o) {
+  FIO_NAME(FIO_MAP_NAME, s) tmp;
+  if (o->bits < 9 || o->old.map)
+    return -1; /* small maps or still migrating */
+  /* rehash at the same size if tombstones filled the map */
+  if (FIO_NAME(FIO_MAP_NAME, __allocate_map)(
+          &tmp,
+          o->bits + (o->count >= (FIO_MAP_CAPA(o->bits) >> 1))))
+    return -1;
+  tmp.count = o->count;
+  tmp.old.bits = o->bits;
+  tmp.old.count = o->count;
+  tmp.old.map = o->map;
+  *o = tmp;
+  return 0;
+}
+#endif /* FIO_MAP_INCREMENTAL */
+
+/* Seeks a node in the map, migrating it if found in the previous table. */
+FIO_IFUNC fio___map_node_info_s
+FIO_NAME(FIO_MAP_NAME, __node_seek)(FIO_NAME(FIO_MAP_NAME, s) * o,
+                                    FIO_NAME(FIO_MAP_NAME, __o_node_s) * node) {
+#if FIO_MAP_INCREMENTAL
+  if (o->old.map &&
+      FIO_NAME(FIO_MAP_NAME, __rehash_step)(o, FIO_MAP_INCREMENTAL_SLOTS))
+    FIO_NAME(FIO_MAP_NAME, __rehash_finish)(o);
+  fio___map_node_info_s r = FIO_NAME(FIO_MAP_NAME, __node_info)(o, node);
+  if (r.act != (uint32_t)-1 || !o->old.map)
+    return r;
+  FIO_NAME(FIO_MAP_NAME, s) old = FIO_NAME(FIO_MAP_NAME, __old_view)(o);
+  fio___map_node_info_s i = FIO_NAME(FIO_MAP_NAME, __node_info)(&old, node);
+  if (i.act == (uint32_t)-1)
+    return r;
+  if (r.home == (uint32_t)-1) { /* no room in the map (unlikely) */
+    FIO_NAME(FIO_MAP_NAME, __rehash_finish)(o);
+    return FIO_NAME(FIO_MAP_NAME, __node_info)(o, node);
+  }
+  FIO_NAME(FIO_MAP_NAME, __rehash_move)(o, i.act, r);
+  r.act = r.alt;
+  return r;
+#else
+  return FIO_NAME(FIO_MAP_NAME, __node_info)(o, node);
+#endif
+}
+
 /* Inserts a node to the map. */
 FIO_IFUNC uint32_t FIO_NAME(FIO_MAP_NAME,
                             __node_insert)(FIO_NAME(FIO_MAP_NAME, s) * o,
@@ -1239,11 +1459,13 @@ FIO_IFUNC uint32_t FIO_NAME(FIO_MAP_NAME,
 #endif
   };
   fio___map_node_info_s info;
-  info = FIO_NAME(FIO_MAP_NAME, __node_info)(o, &node);
+  info = FIO_NAME(FIO_MAP_NAME, __node_seek)(o, &node);
   if (info.act != r)
     goto perform_overwrite;
   if (info.home == r)
     goto reallocate_map;
+  if (o->bits > 8 && o->count >= FIO_MAP_LOAD_LIMIT(FIO_MAP_CAPA(o->bits)))
+    goto reallocate_map; /* group probing: keep miss probe sequences short */
 
 insert:
   ++o->count;
@@ -1283,8 +1505,17 @@ perform_overwrite:
   return r;
 
 reallocate_map:
-  /* reallocate map */
-  for (int i = 1; i < 3; ++i) {
+#if FIO_MAP_INCREMENTAL
+  if (!FIO_NAME(FIO_MAP_NAME, __rehash_start)(o)) {
+    info = FIO_NAME(FIO_MAP_NAME, __node_info)(o, &node);
+    if (info.home != r)
+      goto insert;
+  }
+  if (FIO_NAME(FIO_MAP_NAME, __rehash_finish)(o))
+    goto no_memory;
+#endif
+  /* reallocate map (rehash at the same size if tombstones filled the map) */
+  for (int i = (o->count < (FIO_MAP_CAPA(o->bits) >> 1)) ? 0 : 1; i < 3; ++i) {
     if (FIO_NAME(FIO_MAP_NAME, __allocate_map)(&tmp, o->bits + i))
       goto no_memory;
     if (FIO_NAME(FIO_MAP_NAME, __move2map)(&tmp, o)) {
@@ -1340,7 +1571,7 @@ FIO_IFUNC uint32_t FIO_NAME(FIO_MAP_NAME,
   };
   if (!o->map)
     return r;
-  info = FIO_NAME(FIO_MAP_NAME, __node_info)(o, &node);
+  info = FIO_NAME(FIO_MAP_NAME, __node_seek)(o, &node);
   return (r = info.act);
 }
 
@@ -1357,6 +1588,12 @@ FIO_IFUNC void FIO_NAME(FIO_MAP_NAME,
   --o->count;
   uint8_t *imap = FIO_NAME(FIO_MAP_NAME, __imap)(o);
   imap[at] = 255U; /* mark as deleted */
+  /* group probing stops at groups with empty slots. Such a group was never
+   * full, so no probe sequence continues past it and no tombstone is needed */
+  if (o->bits > 8 &&
+      fio___map_group(imap + (at & ~(uint32_t)(FIO___MAP_GROUP_SIZE - 1)), 0)
+          .empty)
+    imap[at] = 0;
   if (old) {
 #ifdef FIO_MAP_VALUE
     FIO_MAP_KEY_DESTROY(o->map[at].key);
@@ -1401,7 +1638,7 @@ FIO_IFUNC uint32_t FIO_NAME(FIO_MAP_NAME,
       .hash = hash,
 #endif
   };
-  info = FIO_NAME(FIO_MAP_NAME, __node_info)(o, &node);
+  info = FIO_NAME(FIO_MAP_NAME, __node_seek)(o, &node);
   if (info.act == r)
     return r;
   r = 0;
@@ -1437,6 +1674,7 @@ SFUNC void FIO_NAME(FIO_MAP_NAME, destroy)(FIO_MAP_PTR map) {
 /** Reserves at minimum the capacity requested. */
 SFUNC void FIO_NAME(FIO_MAP_NAME, reserve)(FIO_MAP_PTR map, size_t capa) {
   FIO_PTR_TAG_VALID_OR_RETURN_VOID(map);
+  FIO_PTR_TAG_WRITABLE_OR_RETURN_VOID(map);
   FIO_NAME(FIO_MAP_NAME, s) *m = FIO_PTR_TAG_GET_UNTAGGED(FIO_MAP_T, map);
   if (capa <= FIO_MAP_CAPA(m->bits))
     return;
@@ -1472,6 +1710,7 @@ SFUNC int FIO_NAME(FIO_MAP_NAME, remove)(FIO_MAP_PTR map,
 #endif
 ) {
   FIO_PTR_TAG_VALID_OR_RETURN(map, -1);
+  FIO_PTR_TAG_WRITABLE_OR_RETURN(map, -1);
   FIO_NAME(FIO_MAP_NAME, s) *m = FIO_PTR_TAG_GET_UNTAGGED(FIO_MAP_T, map);
   if (!m->count)
     return -1;
@@ -1497,6 +1736,7 @@ FIO_SFUNC int FIO_NAME(FIO_MAP_NAME,
 SFUNC void FIO_NAME(FIO_MAP_NAME, evict)(FIO_MAP_PTR map,
                                          size_t number_of_elements) {
   FIO_PTR_TAG_VALID_OR_RETURN_VOID(map);
+  FIO_PTR_TAG_WRITABLE_OR_RETURN_VOID(map);
   if (!number_of_elements)
     return;
   FIO_NAME(FIO_MAP_NAME, s) *m = FIO_PTR_TAG_GET_UNTAGGED(FIO_MAP_T, map);
@@ -1512,6 +1752,7 @@ SFUNC void FIO_NAME(FIO_MAP_NAME, evict)(FIO_MAP_PTR map,
  */
 SFUNC void FIO_NAME(FIO_MAP_NAME, clear)(FIO_MAP_PTR map) {
   FIO_PTR_TAG_VALID_OR_RETURN_VOID(map);
+  FIO_PTR_TAG_WRITABLE_OR_RETURN_VOID(map);
   FIO_NAME(FIO_MAP_NAME, s) *m = FIO_PTR_TAG_GET_UNTAGGED(FIO_MAP_T, map);
   if (m->map)
     FIO_NAME(FIO_MAP_NAME, __destroy_map)(m, 1);
@@ -1520,6 +1761,7 @@ SFUNC void FIO_NAME(FIO_MAP_NAME, clear)(FIO_MAP_PTR map) {
 /** Attempts to minimize memory use. */
 SFUNC void FIO_NAME(FIO_MAP_NAME, compact)(FIO_MAP_PTR map) {
   FIO_PTR_TAG_VALID_OR_RETURN_VOID(map);
+  FIO_PTR_TAG_WRITABLE_OR_RETURN_VOID(map);
   FIO_NAME(FIO_MAP_NAME, s) *o = FIO_PTR_TAG_GET_UNTAGGED(FIO_MAP_T, map);
   if (!o->map || !o->count)
     return;
@@ -1560,25 +1802,34 @@ SFUNC FIO_NAME(FIO_MAP_NAME, node_s) *
                                     FIO_MAP_KEY key
 #endif
     ) {
+  FIO_NAME(FIO_MAP_NAME, s) * m;
+  uint32_t i;
   FIO_PTR_TAG_VALID_OR_RETURN(map, NULL);
-  FIO_NAME(FIO_MAP_NAME, s) *m = FIO_PTR_TAG_GET_UNTAGGED(FIO_MAP_T, map);
-  uint32_t i = FIO_NAME(FIO_MAP_NAME, __node_insert)(m,
+  FIO_PTR_TAG_WRITABLE_OR_GOTO(map, read_only);
+  m = FIO_PTR_TAG_GET_UNTAGGED(FIO_MAP_T, map);
+  i = FIO_NAME(FIO_MAP_NAME, __node_insert)(m,
 #ifndef FIO_MAP_HASH_FN
-                                                     hash,
+                                            hash,
 #endif
-                                                     key,
+                                            key,
 #ifdef FIO_MAP_VALUE
-                                                     val,
-                                                     old,
-                                                     overwrite
+                                            val,
+                                            old,
+                                            overwrite
 #else
-                                                     NULL,
-                                                     1
+                                            NULL,
+                                            1
 #endif
   );
   if (i == (uint32_t)-1)
     return NULL;
   return m->map + i;
+read_only:
+  FIO_MAP_KEY_DISCARD(key);
+#ifdef FIO_MAP_VALUE
+  FIO_MAP_VALUE_DISCARD(val);
+#endif
+  return NULL;
 }
 
 /**
@@ -1604,6 +1855,25 @@ SFUNC FIO_NAME(FIO_MAP_NAME, node_s) *
   return m->map + i;
 }
 
+#if defined(FIO_MAP_HASH_FN)
+/** Gets a value from the map using a pre-computed hash value. */
+SFUNC FIO_MAP_GET_T FIO_NAME(FIO_MAP_NAME, get_hashed)(FIO_MAP_PTR map,
+                                                       uint64_t hash,
+                                                       FIO_MAP_KEY key) {
+  FIO_MAP_GET_T r = (FIO_MAP_GET_T){0};
+  FIO_PTR_TAG_VALID_OR_RETURN(map, r);
+  FIO_NAME(FIO_MAP_NAME, s) *m = FIO_PTR_TAG_GET_UNTAGGED(FIO_MAP_T, map);
+  FIO_NAME(FIO_MAP_NAME, __o_node_s) node = {.hash = hash, .key = key};
+  fio___map_node_info_s info;
+  if (!m->map)
+    return r;
+  info = FIO_NAME(FIO_MAP_NAME, __node_seek)(m, &node);
+  if (info.act == (uint32_t)-1)
+    return r;
+  return FIO_NAME(FIO_MAP_NAME, node2val)(m->map + info.act);
+}
+#endif
+
 /* *****************************************************************************
 
 
@@ -1621,6 +1891,10 @@ SFUNC FIO_NAME(FIO_MAP_NAME, iterator_s)
   FIO_NAME(FIO_MAP_NAME, iterator_s) r = {0};
   FIO_PTR_TAG_VALID_OR_RETURN(map, r);
   FIO_NAME(FIO_MAP_NAME, s) *m = FIO_PTR_TAG_GET_UNTAGGED(FIO_MAP_T, map);
+#if FIO_MAP_INCREMENTAL
+  if (m->old.map) /* iteration is O(n) anyway, complete the migration */
+    FIO_NAME(FIO_MAP_NAME, __rehash_finish)(m);
+#endif
   uint8_t *imap = FIO_NAME(FIO_MAP_NAME, __imap)(m);
   if (!m->count)
     return r;
@@ -1708,6 +1982,10 @@ SFUNC FIO_NAME(FIO_MAP_NAME, iterator_s)
   FIO_NAME(FIO_MAP_NAME, iterator_s) r = {0};
   FIO_PTR_TAG_VALID_OR_RETURN(map, r);
   FIO_NAME(FIO_MAP_NAME, s) *m = FIO_PTR_TAG_GET_UNTAGGED(FIO_MAP_T, map);
+#if FIO_MAP_INCREMENTAL
+  if (m->old.map) /* iteration is O(n) anyway, complete the migration */
+    FIO_NAME(FIO_MAP_NAME, __rehash_finish)(m);
+#endif
 #if FIO_MAP_ORDERED
   uint32_t ipos;
 #else
@@ -2030,6 +2308,131 @@ FIO_SFUNC void FIO_NAME_TEST(stl, FIO_MAP_NAME)(void) {
     }
     FIO_NAME(FIO_MAP_NAME, destroy)(&map);
   }
+  { /* test group probing (SIMD / SWAR) against a byte by byte test */
+    uint8_t imap[32];
+    for (size_t round = 0; round < 1024; ++round) {
+      uint64_t rnd[4] = {fio_rand64(), fio_rand64(), fio_rand64(), 0};
+      rnd[3] = rnd[0] & rnd[1]; /* skew towards edge values */
+      for (size_t i = 0; i < 32; ++i) {
+        imap[i] = (uint8_t)(rnd[i >> 3] >> ((i & 7) << 3));
+        if ((rnd[3] >> i) & 1)
+          imap[i] = (rnd[2] >> i) & 1 ? 0 : 0xFF;
+      }
+      const uint8_t tag = (round & 1) ? imap[round & 31] : (uint8_t)round;
+      fio___map_group_s expect = {0}, swar;
+      for (size_t i = 0; i < FIO___MAP_GROUP_SIZE; ++i) {
+        expect.match |= (uint32_t)(imap[i] == tag) << i;
+        expect.empty |= (uint32_t)(!imap[i]) << i;
+        expect.deleted |= (uint32_t)(imap[i] == 0xFF) << i;
+      }
+      fio___map_group_s group = fio___map_group(imap, tag);
+      FIO_ASSERT(group.match == expect.match && group.empty == expect.empty &&
+                     group.deleted == expect.deleted,
+                 "map group probing error (tag %u)",
+                 (unsigned)tag);
+      swar = fio___map_group_swar(imap, tag);
+      FIO_ASSERT(swar.match == (expect.match & 0xFFFFU) &&
+                     swar.empty == (expect.empty & 0xFFFFU) &&
+                     swar.deleted == (expect.deleted & 0xFFFFU),
+                 "map group probing (SWAR) error (tag %u)",
+                 (unsigned)tag);
+    }
+  }
+  { /* test remove / insert churn (tombstone handling) */
+    FIO_NAME(FIO_MAP_NAME, s) map = FIO_MAP_INIT;
+    const size_t len = 4096;
+    for (size_t i = 1; i <= len; ++i)
+      FIO_NAME(FIO_MAP_NAME, set)
+    (&map, FIO___M_HASH(i) i FIO___M_VAL(i) FIO___M_OLD);
+    for (size_t i = 1; i <= (len << 3); ++i) {
+      FIO_NAME(FIO_MAP_NAME, remove)(&map, FIO___M_HASH(i) i, NULL);
+      FIO_NAME(FIO_MAP_NAME, set)
+      (&map, FIO___M_HASH(i + len) (i + len) FIO___M_VAL(i + len) FIO___M_OLD);
+      FIO_ASSERT(FIO_NAME(FIO_MAP_NAME, count)(&map) == len,
+                 "map count error after churn? %zu != %zu",
+                 (size_t)FIO_NAME(FIO_MAP_NAME, count)(&map),
+                 len);
+      FIO_ASSERT(!FIO_NAME(FIO_MAP_NAME, get_ptr)(&map, FIO___M_HASH(i) i),
+                 "removed key found after churn?");
+    }
+    for (size_t i = (len << 3) + 1; i <= (len << 3) + len; ++i)
+      FIO_ASSERT(FIO_NAME(FIO_MAP_NAME, get_ptr)(&map, FIO___M_HASH(i) i),
+                 "key missing after churn? %zu",
+                 i);
+    FIO_ASSERT(FIO_NAME(FIO_MAP_NAME, capa)(&map) <= (len << 2),
+               "map grew too much during churn? %zu",
+               (size_t)FIO_NAME(FIO_MAP_NAME, capa)(&map));
+    FIO_NAME(FIO_MAP_NAME, destroy)(&map);
+  }
+#if FIO_MAP_INCREMENTAL
+  { /* test incremental rehashing */
+    FIO_NAME(FIO_MAP_NAME, s) map = FIO_MAP_INIT;
+    size_t migrating = 0, len = 0;
+    for (size_t i = 1; i < test_len_limit; ++i) {
+      FIO_NAME(FIO_MAP_NAME, set)
+      (&map, FIO___M_HASH(i) i FIO___M_VAL(i) FIO___M_OLD);
+      if (!map.old.map)
+        continue;
+      ++migrating;
+      FIO_ASSERT(FIO_NAME(FIO_MAP_NAME, count)(&map) == i,
+                 "map count error while rehashing? %zu != %zu",
+                 (size_t)FIO_NAME(FIO_MAP_NAME, count)(&map),
+                 i);
+      FIO_ASSERT(map.old.count <= i, "map rehash count error?");
+      for (size_t j = (i >> 1) + 1; j < (i >> 1) + 4; ++j)
+        FIO_ASSERT(FIO_NAME(FIO_MAP_NAME, get_ptr)(&map, FIO___M_HASH(j) j),
+                   "map key missing while rehashing? %zu / %zu",
+                   j,
+                   i);
+      FIO_ASSERT(!FIO_NAME(FIO_MAP_NAME, get_ptr)(&map, FIO___M_HASH(0) 0),
+                 "missing key found while rehashing?");
+      if (!len && map.old.map && map.old.count > 64)
+        len = i; /* a good place to test iteration / removal */
+    }
+    FIO_ASSERT(migrating, "map never rehashed incrementally?");
+    for (size_t i = 1; i < test_len_limit; ++i) /* lookups migrate as well */
+      FIO_ASSERT(FIO_NAME(FIO_MAP_NAME, get_ptr)(&map, FIO___M_HASH(i) i),
+                 "map key missing after rehashing? %zu",
+                 i);
+    FIO_ASSERT(!map.old.map, "map rehashing never completed?");
+    FIO_NAME(FIO_MAP_NAME, destroy)(&map);
+    FIO_ASSERT(len, "rehashing test point missing?");
+    /* iteration and removal while rehashing */
+    for (size_t round = 0; round < 3; ++round) {
+      for (size_t i = 1; i <= len; ++i)
+        FIO_NAME(FIO_MAP_NAME, set)
+      (&map, FIO___M_HASH(i) i FIO___M_VAL(i) FIO___M_OLD);
+      FIO_ASSERT(map.old.map, "map should be rehashing (%zu)", len);
+      if (round == 0) {
+        size_t loop_test = 0;
+        FIO_MAP_EACH(FIO_MAP_NAME, &map, pos) {
+          FIO_ASSERT(pos.key && pos.key <= len, "iteration error");
+          ++loop_test;
+        }
+        FIO_ASSERT(loop_test == len,
+                   "iteration while rehashing missed items (%zu != %zu)",
+                   loop_test,
+                   len);
+        FIO_ASSERT(!map.old.map, "iteration should complete rehashing");
+      } else if (round == 1) {
+        for (size_t i = 1; i <= len; i += 2)
+          FIO_NAME(FIO_MAP_NAME, remove)(&map, FIO___M_HASH(i) i, NULL);
+        FIO_ASSERT(FIO_NAME(FIO_MAP_NAME, count)(&map) == (len >> 1),
+                   "removal while rehashing count error (%zu != %zu)",
+                   (size_t)FIO_NAME(FIO_MAP_NAME, count)(&map),
+                   (len >> 1));
+        for (size_t i = 1; i <= len; ++i) {
+          FIO_NAME(FIO_MAP_NAME, node_s) *ptr =
+              FIO_NAME(FIO_MAP_NAME, get_ptr)(&map, FIO___M_HASH(i) i);
+          FIO_ASSERT((!ptr) == (int)(i & 1),
+                     "removal while rehashing error (%zu)",
+                     i);
+        }
+      } /* round 2: destroy while rehashing */
+      FIO_NAME(FIO_MAP_NAME, destroy)(&map);
+    }
+  }
+#endif /* FIO_MAP_INCREMENTAL */
 }
 #undef FIO___M_HASH
 #undef FIO___M_VAL
@@ -2053,6 +2456,8 @@ Map Cleanup
 #undef FIO_MAP_CUCKOO_STEPS
 #undef FIO_MAP_GET_T
 #undef FIO_MAP_HASH_FN
+#undef FIO_MAP_INCREMENTAL
+#undef FIO_MAP_INCREMENTAL_SLOTS
 #undef FIO_MAP_IS_SPARSE
 #undef FIO_MAP_KEY
 #undef FIO_MAP_KEY_BSTR
@@ -2065,6 +2470,7 @@ Map Cleanup
 #undef FIO_MAP_KEY_INTERNAL
 #undef FIO_MAP_KEY_IS_GREATER_THAN
 #undef FIO_MAP_KEY_KSTR
+#undef FIO_MAP_LOAD_LIMIT
 #undef FIO_MAP_LRU
 #undef FIO_MAP_MINIMAL_BITS
 #undef FIO_MAP_NAME
@@ -251,4 +251,8 @@ Pointer Tagging Cleanup
 #undef FIO_PTR_TAG_VALID_OR_RETURN
 #undef FIO_PTR_TAG_VALID_OR_RETURN_VOID
 #undef FIO_PTR_TAG_VALID_OR_GOTO
+#undef FIO_PTR_TAG_VALIDATE_WRITE
+#undef FIO_PTR_TAG_WRITABLE_OR_RETURN
+#undef FIO_PTR_TAG_WRITABLE_OR_RETURN_VOID
+#undef FIO_PTR_TAG_WRITABLE_OR_GOTO
 #endif
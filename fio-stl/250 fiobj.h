@@ -95,6 +95,16 @@ Type Naming Macros for FIOBJ types. By default, results in:
 #ifndef FIOBJ_JSON_APPEND
 #define FIOBJ_JSON_APPEND 1
 #endif
+
+#ifndef FIOBJ_ARENA_BLOCK
+/**
+ * The minimal size of an arena's memory block (see `fiobj_json_parse_arena`).
+ *
+ * The first block is sized according to the JSON data, later blocks double
+ * the arena's capacity.
+ */
+#define FIOBJ_ARENA_BLOCK 4096
+#endif
 /* *****************************************************************************
 General Requirements / Macros
 ***************************************************************************** */
@@ -109,6 +119,61 @@ General Requirements / Macros
 #define FIOBJ_EXTERN_OBJ     static __attribute__((unused))
 #define FIOBJ_EXTERN_OBJ_IMP static __attribute__((unused))
 #endif
+/* *****************************************************************************
+FIOBJ Memory Routing (Arena Support)
+
+While an arena backed document is being built, the FIOBJ types allocate their
+memory from the arena. Otherwise, allocations are routed to the allocator that
+was selected before the FIOBJ types were defined.
+***************************************************************************** */
+
+/** An arena backed document's memory (internal). */
+typedef struct fiobj___arena_s fiobj___arena_s;
+
+/** The arena in which the current thread is building a document (if any). */
+static __thread fiobj___arena_s *fiobj___arena_current;
+
+/** Allocates (or reallocates) memory from an arena. */
+SFUNC void *fiobj___arena_realloc(fiobj___arena_s *a,
+                                  void *ptr,
+                                  size_t new_size,
+                                  size_t copy_len);
+
+FIO_IFUNC void *fiobj___mem_sys_realloc(void *ptr,
+                                        size_t old_size,
+                                        size_t new_size,
+                                        size_t copy_len) {
+  return FIO_MEM_REALLOC_(ptr, old_size, new_size, copy_len);
+  (void)old_size, (void)copy_len; /* if unused */
+}
+FIO_IFUNC void fiobj___mem_sys_free(void *ptr, size_t size) {
+  FIO_MEM_FREE_(ptr, size);
+  (void)size; /* if unused */
+}
+FIO_IFUNC void *fiobj___mem_realloc(void *ptr,
+                                    size_t old_size,
+                                    size_t new_size,
+                                    size_t copy_len) {
+  if (FIO_UNLIKELY(fiobj___arena_current != NULL))
+    return fiobj___arena_realloc(fiobj___arena_current,
+                                 ptr,
+                                 new_size,
+                                 copy_len);
+  return fiobj___mem_sys_realloc(ptr, old_size, new_size, copy_len);
+}
+/* the `size` argument is never evaluated by the types (it might be invalid) */
+FIO_IFUNC void fiobj___mem_free(void *ptr) {
+  if (FIO_UNLIKELY(fiobj___arena_current != NULL))
+    return; /* arena memory is released with the arena */
+  fiobj___mem_sys_free(ptr, 0);
+}
+
+#undef FIO_MEM_REALLOC_
+#undef FIO_MEM_FREE_
+#define FIO_MEM_REALLOC_(ptr, old_size, new_size, copy_len)                    \
+  fiobj___mem_realloc((ptr), (old_size), (new_size), (copy_len))
+#define FIO_MEM_FREE_(ptr, size) fiobj___mem_free((ptr))
+
 /* *****************************************************************************
 Debugging / Leak Detection
 ***************************************************************************** */
@@ -193,6 +258,13 @@ FIO_IFUNC FIOBJ fiobj_dup(FIOBJ o);
 /** Decreases an object's reference count or frees it. */
 FIO_IFUNC void fiobj_free(FIOBJ o);
 
+/**
+ * Returns 1 if the object belongs to an arena backed (read-only) document.
+ *
+ * See `fiobj_json_parse_arena`.
+ */
+FIO_IFUNC int FIO_NAME_BL(fiobj, arena)(FIOBJ o);
+
 /* *****************************************************************************
 FIOBJ Data / Info
 ***************************************************************************** */
@@ -499,6 +571,9 @@ FIO_IFUNC fio_str_info_s FIO_NAME2(FIO_NAME(fiobj, FIOBJ___NAME_STRING),
 FIOBJ Arrays
 ***************************************************************************** */
 
+/* arena backed containers are read-only once built (adopted by an arena) */
+#define FIOBJ___WRITABLE(o) (!FIO_NAME_BL(fiobj, arena)((o)))
+
 #define FIO_ARRAY_NAME           FIO_NAME(fiobj, FIOBJ___NAME_ARRAY)
 #define FIO_REF_NAME             FIO_NAME(fiobj, FIOBJ___NAME_ARRAY)
 #define FIO_REF_CONSTRUCTOR_ONLY 1
@@ -527,6 +602,8 @@ FIOBJ Arrays
 #define FIO_PTR_UNTAG(p)        FIOBJ_PTR_UNTAG(p)
 #define FIO_PTR_TAG_VALIDATE(p) (FIOBJ_TYPE_CLASS(p) == FIOBJ_T_ARRAY)
 #define FIO_PTR_TAG_TYPE        FIOBJ
+/* mutators skip arena backed arrays */
+#define FIO_PTR_TAG_VALIDATE_WRITE(p) FIOBJ___WRITABLE(p)
 #include FIO_INCLUDE_FILE
 
 /* *****************************************************************************
@@ -564,6 +641,8 @@ FIOBJ Hash Maps
 #define FIO_PTR_TAG_VALIDATE(p)   (FIOBJ_TYPE_CLASS(p) == FIOBJ_T_HASH)
 #define FIO_PTR_TAG_TYPE          FIOBJ
 /* TODO! auto-hash object value */
+/* mutators skip arena backed hash maps */
+#define FIO_PTR_TAG_VALIDATE_WRITE(p) FIOBJ___WRITABLE(p)
 #include FIO_INCLUDE_FILE
 /**
  * Sets a value in a hash map, allocating the key String and automatically
@@ -602,6 +681,23 @@ FIOBJ JSON support
  */
 FIO_IFUNC FIOBJ FIO_NAME2(fiobj, json)(FIOBJ dest, FIOBJ o, uint8_t beautify);
 
+/**
+ * Returns the buffer length required for writing the JSON representation of
+ * the object using `fiobj_json_write` (including the NUL terminator).
+ *
+ * The length is exact, except for floating point numbers, for which the longest
+ * possible representation is assumed.
+ */
+SFUNC size_t fiobj_json_capa(FIOBJ o, uint8_t beautify);
+
+/**
+ * Writes the JSON representation of the object to `dest`, which must have room
+ * for (at least) `fiobj_json_capa(o, beautify)` bytes.
+ *
+ * Returns the number of bytes written (excluding the NUL terminator).
+ */
+SFUNC size_t fiobj_json_write(char *dest, FIOBJ o, uint8_t beautify);
+
 /**
  * Updates a Hash using JSON data.
  *
@@ -637,6 +733,31 @@ SFUNC FIOBJ fiobj_json_parse(fio_str_info_s str, size_t *consumed);
 #define fiobj_json_parse2(data_, len_, consumed)                               \
   fiobj_json_parse(FIO_STR_INFO2(data_, len_), consumed)
 
+/**
+ * Parses JSON data (same as `fiobj_json_parse`) into an arena backed document.
+ *
+ * All the document's objects (including Hash Map storage and String data) are
+ * carved from a single growable memory arena owned by the returned root
+ * object. Freeing the root releases the whole arena in a single operation,
+ * instead of walking and freeing every object.
+ *
+ * The document is read-only (Strings are frozen) and must be freed using
+ * `fiobj_free`. Calling `fiobj_free` on a nested object does nothing (its
+ * memory is released with the root).
+ *
+ * `fiobj_dup` increases the root's reference count. For nested objects,
+ * `fiobj_dup` returns a (deep) heap allocated copy that outlives the document
+ * and may be mutated - make sure to use the returned object.
+ *
+ * If the JSON data contains only a primitive (`true`, `null`, a small number,
+ * etc'), no arena is used.
+ */
+SFUNC FIOBJ fiobj_json_parse_arena(fio_str_info_s str, size_t *consumed);
+
+/** Helper macro, calls `fiobj_json_parse_arena` with string information */
+#define fiobj_json_parse_arena2(data_, len_, consumed)                         \
+  fiobj_json_parse_arena(FIO_STR_INFO2(data_, len_), consumed)
+
 /**
  * Uses JavaScript style notation to find data in an object structure.
  *
@@ -661,6 +782,74 @@ SFUNC FIOBJ fiobj_json_find(FIOBJ object, fio_str_info_s notation);
 #define fiobj_json_find2(object, str, length)                                  \
   fiobj_json_find(object, FIO_STR_INFO2(str, length))
 
+/** A compiled set of JSON paths (see `fiobj_json_path_new`). */
+typedef struct fiobj_json_path_s fiobj_json_path_s;
+
+/**
+ * Compiles `count` JavaScript style notations (see `fiobj_json_find`) into a
+ * reusable path set, with pre-hashed keys and parsed Array indexes.
+ *
+ * Paths that share a prefix (i.e., "user.name" and "user.id") share the
+ * lookups for that prefix.
+ *
+ * Notations are split at every `.` and `[`, so keys containing these
+ * characters can't be addressed using a compiled path.
+ *
+ * The path set is immutable and may be used concurrently by multiple threads.
+ *
+ * Returns NULL on error (i.e., a malformed notation).
+ */
+SFUNC fiobj_json_path_s *fiobj_json_path_new(const fio_str_info_s *notations,
+                                             size_t count);
+
+/** Helper function, compiles a single notation (see `fiobj_json_path_new`). */
+FIO_IFUNC fiobj_json_path_s *fiobj_json_path_new2(const char *notation,
+                                                  size_t len);
+
+/** Frees a compiled path set. */
+SFUNC void fiobj_json_path_free(fiobj_json_path_s *path);
+
+/** Returns the number of paths in the path set. */
+SFUNC size_t fiobj_json_path_count(fiobj_json_path_s *path);
+
+/**
+ * Finds the data addressed by the first path in the path set (same as
+ * `fiobj_json_find`).
+ *
+ * Returns a temporary reference to the object or FIOBJ_INVALID on an error.
+ */
+SFUNC FIOBJ fiobj_json_path_find(FIOBJ object, fiobj_json_path_s *path);
+
+/**
+ * Finds the data addressed by all the paths in the path set, using a single
+ * traversal of the object structure.
+ *
+ * `results` must have room for `fiobj_json_path_count(path)` objects. Each
+ * result is a temporary reference, or FIOBJ_INVALID if the data is missing.
+ *
+ * Returns the number of paths found.
+ */
+SFUNC size_t fiobj_json_path_find_all(FIOBJ object,
+                                      fiobj_json_path_s *path,
+                                      FIOBJ *results);
+
+/**
+ * Parses JSON data, building only the objects addressed by the path set
+ * (parts of the document that aren't addressed are validated and skipped).
+ *
+ * `results` must have room for `fiobj_json_path_count(path)` objects. Each
+ * result is a new reference that must be freed using `fiobj_free`, or
+ * FIOBJ_INVALID if the data is missing.
+ *
+ * If `consumed` is not NULL, it will contain the number of bytes consumed.
+ *
+ * Returns the number of paths found. On error, no results are returned.
+ */
+SFUNC size_t fiobj_json_path_parse(fiobj_json_path_s *path,
+                                   fio_str_info_s json,
+                                   FIOBJ *results,
+                                   size_t *consumed);
+
 /* *****************************************************************************
 FIOBJ Mustache support
 ***************************************************************************** */
@@ -683,6 +872,26 @@ FIO_IFUNC FIOBJ fiobj_mustache_build(fio_mustache_s *m, FIOBJ ctx);
  */
 FIO_IFUNC FIOBJ fiobj_mustache_build2(fio_mustache_s *m, FIOBJ dest, FIOBJ ctx);
 
+/**
+ * Pre-computes the FIOBJ Hash value of every variable name in the template,
+ * so `fiobj_mustache_build` (and `build2` / `build_iov`) never re-hash names.
+ *
+ * The template should be bound (once) before it is shared with other threads.
+ * Bound templates must be built in the same translation unit (otherwise names
+ * are hashed as if the template wasn't bound).
+ */
+FIO_IFUNC void fiobj_mustache_bind(fio_mustache_s *m);
+
+/**
+ * Builds a Mustache template using a FIOBJ context (usually a Hash), as a list
+ * of buffers (see `fio_mustache_build_iov`).
+ *
+ * Returns the number of buffers in `dest`.
+ */
+FIO_IFUNC size_t fiobj_mustache_build_iov(fio_mustache_s *m,
+                                          fio_mustache_iov_s *dest,
+                                          FIOBJ ctx);
+
 /* *****************************************************************************
 
 
@@ -731,28 +940,66 @@ FIO_IFUNC size_t fiobj_type(FIOBJ o) {
 FIOBJ Memory Management
 ***************************************************************************** */
 
-/** Increases an object's reference count (or copies) and returns it. */
-FIO_IFUNC FIOBJ fiobj_dup(FIOBJ o) {
+/* arena backed objects have these bits set in their reference counter */
+#define FIOBJ___ARENA_NODE ((size_t)1 << ((sizeof(size_t) << 3) - 1))
+#define FIOBJ___ARENA_ROOT ((size_t)1 << ((sizeof(size_t) << 3) - 2))
+/* nested nodes count from here, so `dup` / `free` never flip the bits above */
+#define FIOBJ___ARENA_BIAS ((size_t)1 << ((sizeof(size_t) << 3) - 3))
+
+/** Internal: returns the object wrapper's reference counter (or NULL). */
+FIO_IFUNC volatile size_t *fiobj___ref(FIOBJ o) {
+  if (!FIOBJ_PTR_UNTAG(o))
+    return NULL;
   switch (FIOBJ_TYPE_CLASS(o)) {
-  case FIOBJ_T_PRIMITIVE: /* fall through */
-  case FIOBJ_T_NUMBER:    /* fall through */
-  case FIOBJ_T_FLOAT: /* fall through */ return o;
-  case FIOBJ_T_STRING: /* fall through */
-    FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), dup)(o);
-    break;
-  case FIOBJ_T_ARRAY: /* fall through */
-    FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), dup)(o);
-    break;
-  case FIOBJ_T_HASH: /* fall through */
-    FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), dup)(o);
-    break;
-  case FIOBJ_T_OTHER: /* fall through */ fiobj_object_dup(o);
+  case FIOBJ_T_STRING:
+    return &(((FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), _wrapper_s) *)
+                  FIOBJ_PTR_UNTAG(o)) -
+             1)
+                ->ref;
+  case FIOBJ_T_ARRAY:
+    return &(((FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), _wrapper_s) *)
+                  FIOBJ_PTR_UNTAG(o)) -
+             1)
+                ->ref;
+  case FIOBJ_T_HASH:
+    return &(((FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), _wrapper_s) *)
+                  FIOBJ_PTR_UNTAG(o)) -
+             1)
+                ->ref;
+  case FIOBJ_T_OTHER:
+    return &(((FIO_NAME(fiobj_object, _wrapper_s) *)FIOBJ_PTR_UNTAG(o)) - 1)
+                ->ref;
+  default: return NULL;
   }
+}
+
+/** Internal: `fiobj_dup` for arena backed objects (`ref` was incremented). */
+SFUNC FIOBJ fiobj___arena_dup(FIOBJ o, size_t ref);
+/** Internal: `fiobj_free` for arena backed objects (`ref` was decremented). */
+SFUNC void fiobj___arena_free(FIOBJ o, size_t ref);
+
+/** Returns 1 if the object belongs to an arena backed (read-only) document. */
+FIO_IFUNC int FIO_NAME_BL(fiobj, arena)(FIOBJ o) {
+  volatile size_t *ref = fiobj___ref(o);
+  return ref && (ref[0] & FIOBJ___ARENA_NODE);
+}
+
+/** Increases an object's reference count (or copies) and returns it. */
+FIO_IFUNC FIOBJ fiobj_dup(FIOBJ o) {
+  volatile size_t *ref = fiobj___ref(o);
+  size_t r;
+  if (!ref)
+    return o;
+  r = fio_atomic_add_fetch(ref, 1);
+  if (FIO_UNLIKELY(r & FIOBJ___ARENA_NODE))
+    return fiobj___arena_dup(o, r);
   return o;
 }
 
-/** Decreases an object's reference count or frees it. */
-FIO_IFUNC void fiobj_free(FIOBJ o) {
+/* Internal: destroys an object once the last reference was released. */
+FIO_SFUNC void fiobj___free_task(FIOBJ o, volatile size_t *ref) {
+  /* the type's `free` releases the (restored) last reference and destroys */
+  ref[0] = 1;
   switch (FIOBJ_TYPE_CLASS(o)) {
   case FIOBJ_T_PRIMITIVE: /* fall through */
   case FIOBJ_T_NUMBER:    /* fall through */
@@ -770,6 +1017,19 @@ FIO_IFUNC void fiobj_free(FIOBJ o) {
   }
 }
 
+/** Decreases an object's reference count or frees it. */
+FIO_IFUNC void fiobj_free(FIOBJ o) {
+  volatile size_t *ref = fiobj___ref(o);
+  size_t r;
+  if (!ref)
+    return;
+  r = fio_atomic_sub_fetch(ref, 1);
+  if (!r)
+    fiobj___free_task(o, ref);
+  else if (FIO_UNLIKELY(r & FIOBJ___ARENA_NODE))
+    fiobj___arena_free(o, r);
+}
+
 /* *****************************************************************************
 FIOBJ Data / Info
 ***************************************************************************** */
@@ -785,7 +1045,8 @@ FIO_IFUNC unsigned char FIO_NAME_BL(fiobj, eq)(FIOBJ a, FIOBJ b) {
     return 1;
   if (FIOBJ_TYPE_CLASS(a) != FIOBJ_TYPE_CLASS(b))
     return 0;
-  switch (FIOBJ_TYPE_CLASS(a)) {
+  /* containers pass the lookup value (often a constant) as `b` */
+  switch (FIOBJ_TYPE_CLASS(b)) {
   case FIOBJ_T_PRIMITIVE:
   case FIOBJ_T_NUMBER: /* fall through */
   case FIOBJ_T_FLOAT: /* fall through */ return a == b;
@@ -994,6 +1255,13 @@ FIOBJ Floats
 #define FIO_PTR_TAG_TYPE        FIOBJ
 #include FIO_INCLUDE_FILE
 
+/* the FIOBJ types are defined, restore the original allocator routing */
+#undef FIO_MEM_REALLOC_
+#undef FIO_MEM_FREE_
+#define FIO_MEM_REALLOC_(ptr, old_size, new_size, copy_len)                    \
+  fiobj___mem_sys_realloc((ptr), (old_size), (new_size), (copy_len))
+#define FIO_MEM_FREE_(ptr, size) fiobj___mem_sys_free((ptr), 0)
+
 /** Creates a new Float object. */
 FIO_IFUNC FIOBJ FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_FLOAT), new)(double i) {
   FIOBJ ui;
@@ -1223,15 +1491,8 @@ FIO_IFUNC void FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), update)(FIOBJ dest,
 FIOBJ JSON support (inline functions)
 ***************************************************************************** */
 
-typedef struct {
-  FIOBJ json;
-  size_t level;
-  uint8_t beautify;
-} fiobj___json_format_internal__s;
-
-/* internal helper function for recursive JSON formatting. */
-SFUNC void fiobj___json_format_internal__(fiobj___json_format_internal__s *,
-                                          FIOBJ);
+/* internal helper function, appends the JSON for `o` to the `dest` String. */
+SFUNC void fiobj___json_format(FIOBJ dest, FIOBJ o, uint8_t beautify);
 
 /** Helper function, calls `fiobj_hash_update_json` with string information */
 FIO_IFUNC size_t FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH),
@@ -1247,12 +1508,16 @@ FIO_IFUNC size_t FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH),
  * the existing string.
  */
 FIO_IFUNC FIOBJ FIO_NAME2(fiobj, json)(FIOBJ dest, FIOBJ o, uint8_t beautify) {
-  fiobj___json_format_internal__s args =
-      (fiobj___json_format_internal__s){.json = dest, .beautify = beautify};
   if (FIOBJ_TYPE_CLASS(dest) != FIOBJ_T_STRING)
-    args.json = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), new)();
-  fiobj___json_format_internal__(&args, o);
-  return args.json;
+    dest = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), new)();
+  fiobj___json_format(dest, o, beautify);
+  return dest;
+}
+/** Helper function, compiles a single notation (see `fiobj_json_path_new`). */
+FIO_IFUNC fiobj_json_path_s *fiobj_json_path_new2(const char *notation,
+                                                  size_t len) {
+  fio_str_info_s n = FIO_STR_INFO2((char *)notation, len);
+  return fiobj_json_path_new(&n, 1);
 }
 
 #undef FIO___RECURSIVE_INCLUDE /* from now on, type helpers are internal */
@@ -1268,6 +1533,12 @@ FIO_SFUNC void *fiobj___mustache_write_text_escaped(void *udata,
                                                     fio_buf_info_s raw);
 /* callback should return a new context pointer with the value of `name`. */
 FIO_SFUNC void *fiobj___mustache_get_var(void *ctx, fio_buf_info_s name);
+/* computes the hash of a variable name (used for pre-hashing names). */
+FIO_SFUNC uint64_t fiobj___mustache_var_hash(fio_buf_info_s name);
+/* same as `get_var`, with a pre-computed hash value. */
+FIO_SFUNC void *fiobj___mustache_get_var_hashed(void *ctx,
+                                                fio_buf_info_s name,
+                                                uint64_t hash);
 /* if context is an Array, should return its length. */
 FIO_SFUNC size_t fiobj___mustache_array_length(void *ctx);
 /* if context is an Array, should return a context pointer @ index. */
@@ -1293,6 +1564,8 @@ FIO_IFUNC FIOBJ fiobj_mustache_build(fio_mustache_s *m, FIOBJ ctx) {
       .get_var_index = fiobj___mustache_get_var_index,
       .var2str = fiobj___mustache_var2str,
       .var_is_truthful = fiobj___mustache_var_is_truthful,
+      .var_hash = fiobj___mustache_var_hash,
+      .get_var_hashed = fiobj___mustache_get_var_hashed,
       .ctx = ctx,
       .udata = NULL);
 }
@@ -1317,11 +1590,35 @@ FIO_IFUNC FIOBJ fiobj_mustache_build2(fio_mustache_s *m,
       .get_var_index = fiobj___mustache_get_var_index,
       .var2str = fiobj___mustache_var2str,
       .var_is_truthful = fiobj___mustache_var_is_truthful,
+      .var_hash = fiobj___mustache_var_hash,
+      .get_var_hashed = fiobj___mustache_get_var_hashed,
       .ctx = ctx,
       .udata = dest);
   return dest;
 }
 
+/** Pre-computes the FIOBJ Hash value of every variable name in the template. */
+FIO_IFUNC void fiobj_mustache_bind(fio_mustache_s *m) {
+  fio_mustache_bind(m, fiobj___mustache_var_hash);
+}
+
+/** Builds a Mustache template using a FIOBJ context, as a list of buffers. */
+FIO_IFUNC size_t fiobj_mustache_build_iov(fio_mustache_s *m,
+                                          fio_mustache_iov_s *dest,
+                                          FIOBJ ctx) {
+  return fio_mustache_build_iov(
+      m,
+      dest,
+      .get_var = fiobj___mustache_get_var,
+      .array_length = fiobj___mustache_array_length,
+      .get_var_index = fiobj___mustache_get_var_index,
+      .var2str = fiobj___mustache_var2str,
+      .var_is_truthful = fiobj___mustache_var_is_truthful,
+      .var_hash = fiobj___mustache_var_hash,
+      .get_var_hashed = fiobj___mustache_get_var_hashed,
+      .ctx = ctx);
+}
+
 /* callback should write `txt` to output and return updated `udata.` */
 FIO_SFUNC void *fiobj___mustache_write_text(void *udata, fio_buf_info_s txt) {
   FIOBJ d = (FIOBJ)udata;
@@ -1347,6 +1644,23 @@ FIO_SFUNC void *fiobj___mustache_get_var(void *ctx, fio_buf_info_s name) {
     return NULL;
   return fiobj_hash_get2((FIOBJ)ctx, name.buf, name.len);
 }
+/* computes the hash of a variable name (used for pre-hashing names). */
+FIO_SFUNC uint64_t fiobj___mustache_var_hash(fio_buf_info_s name) {
+  FIOBJ_STR_TEMP_VAR_STATIC(tmp, name.buf, name.len);
+  return FIO_NAME2(fiobj, hash)(tmp);
+}
+/* same as `get_var`, with a pre-computed hash value. */
+FIO_SFUNC void *fiobj___mustache_get_var_hashed(void *ctx,
+                                                fio_buf_info_s name,
+                                                uint64_t hash) {
+  if (!ctx)
+    return NULL;
+  if (!FIOBJ_TYPE_IS((FIOBJ)ctx, FIOBJ_T_HASH))
+    return NULL;
+  FIOBJ_STR_TEMP_VAR_STATIC(tmp, name.buf, name.len);
+  return FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH),
+                  get_hashed)((FIOBJ)ctx, hash, tmp);
+}
 /* if context is an Array, should return its length. */
 FIO_SFUNC size_t fiobj___mustache_array_length(void *ctx) {
   if (!FIOBJ_TYPE_IS((FIOBJ)ctx, FIOBJ_T_ARRAY))
@@ -1698,154 +2012,554 @@ FIOBJ_EXTERN_OBJ_IMP const FIOBJ_class_vtable_s FIOBJ___FLOAT_CLASS_VTBL = {
 };
 
 /* *****************************************************************************
-FIOBJ JSON support - output
+FIOBJ Arena Documents
 ***************************************************************************** */
 
-FIO_IFUNC void fiobj___json_format_internal_beauty_pad(FIOBJ json,
-                                                       size_t level) {
-  size_t pos = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), len)(json);
-  fio_str_info_s tmp = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING),
-                                resize)(json, (level << 1) + pos + 2);
-  tmp.buf[pos++] = '\r';
-  tmp.buf[pos++] = '\n';
-  for (size_t i = 0; i < level; ++i) {
-    tmp.buf[pos++] = ' ';
-    tmp.buf[pos++] = ' ';
+/* a memory block added to an arena once the first block is full */
+typedef struct fiobj___arena_block_s {
+  struct fiobj___arena_block_s *next;
+  size_t size;
+} fiobj___arena_block_s;
+
+/* the arena lives at the head of its first memory block */
+struct fiobj___arena_s {
+  /** additional memory blocks */
+  fiobj___arena_block_s *blocks;
+  /** the next available byte in the current block */
+  char *pos;
+  /** the end of the current block */
+  char *end;
+  /** the last allocation (may grow in place) */
+  char *last;
+  /** the size of the first memory block */
+  size_t size;
+  /** the total size of all memory blocks */
+  size_t total;
+};
+
+#define FIOBJ___ARENA_ALIGN(len) (((len) + 15) & (~(size_t)15))
+/* the root object is the first allocation, placed right after the arena */
+#define FIOBJ___ARENA_HEAD  FIOBJ___ARENA_ALIGN(sizeof(fiobj___arena_s))
+#define FIOBJ___ARENA_BLOCK FIOBJ___ARENA_ALIGN(sizeof(fiobj___arena_block_s))
+
+FIO_LEAK_COUNTER_DEF(fiobj___arena)
+
+/* creates an arena, sizing the first block for `hint` bytes of JSON */
+FIO_SFUNC fiobj___arena_s *fiobj___arena_new(size_t hint) {
+  size_t size = FIOBJ___ARENA_HEAD + FIOBJ_ARENA_BLOCK + (hint << 2);
+  fiobj___arena_s *a =
+      (fiobj___arena_s *)fiobj___mem_sys_realloc(NULL, 0, size, 0);
+  if (!a)
+    return a;
+  FIO_LEAK_COUNTER_ON_ALLOC(fiobj___arena);
+  FIOBJ_MARK_MEMORY_ALLOC();
+  *a = (fiobj___arena_s){
+      .pos = (char *)a + FIOBJ___ARENA_HEAD,
+      .end = (char *)a + size,
+      .size = size,
+      .total = size,
+  };
+  return a;
+}
+
+/* releases all of the arena's memory */
+FIO_SFUNC void fiobj___arena_release(fiobj___arena_s *a) {
+  fiobj___arena_block_s *b = a->blocks;
+  while (b) {
+    fiobj___arena_block_s *tmp = b;
+    b = b->next;
+    fiobj___mem_sys_free(tmp, tmp->size);
   }
+  FIOBJ_MARK_MEMORY_FREE();
+  FIO_LEAK_COUNTER_ON_FREE(fiobj___arena);
+  fiobj___mem_sys_free(a, a->size);
 }
 
-SFUNC void fiobj___json_format_internal__(fiobj___json_format_internal__s *args,
-                                          FIOBJ o) {
-  switch (FIOBJ_TYPE(o)) {
-  case FIOBJ_T_TRUE:
-    FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)
-    (args->json, "true", 4);
+/* returns true if `ptr` points to memory owned by the arena */
+FIO_SFUNC int fiobj___arena_owns(fiobj___arena_s *a, void *ptr) {
+  if ((char *)ptr > (char *)a && (char *)ptr < (char *)a + a->size)
+    return 1;
+  for (fiobj___arena_block_s *b = a->blocks; b; b = b->next)
+    if ((char *)ptr > (char *)b && (char *)ptr < (char *)b + b->size)
+      return 1;
+  return 0;
+}
+
+/** Allocates (or reallocates) memory from an arena. */
+SFUNC void *fiobj___arena_realloc(fiobj___arena_s *a,
+                                  void *ptr,
+                                  size_t new_size,
+                                  size_t copy_len) {
+  char *r;
+  new_size = FIOBJ___ARENA_ALIGN(new_size);
+  FIO_ASSERT_DEBUG(!ptr || fiobj___arena_owns(a, ptr),
+                   "FIOBJ arena reallocating foreign memory");
+  if (ptr && (char *)ptr == a->last) { /* grow (never shrink) in place */
+    if (new_size <= (size_t)(a->pos - a->last))
+      return ptr;
+    if (new_size <= (size_t)(a->end - a->last)) {
+      a->pos = a->last + new_size;
+      return ptr;
+    }
+  }
+  if (new_size > (size_t)(a->end - a->pos)) { /* add a block */
+    size_t size = a->total;
+    if (size < FIOBJ___ARENA_BLOCK + new_size)
+      size = FIOBJ___ARENA_BLOCK + new_size;
+    fiobj___arena_block_s *b =
+        (fiobj___arena_block_s *)fiobj___mem_sys_realloc(NULL, 0, size, 0);
+    if (!b)
+      return NULL;
+    *b = (fiobj___arena_block_s){.next = a->blocks, .size = size};
+    a->blocks = b;
+    a->total += size;
+    a->pos = (char *)b + FIOBJ___ARENA_BLOCK;
+    a->end = (char *)b + size;
+  }
+  r = a->pos;
+  a->pos += new_size;
+  a->last = r;
+  if (ptr && copy_len)
+    FIO_MEMCPY(r, ptr, copy_len);
+  return (void *)r;
+}
+
+/* marks an object built in the arena, settling its leak counters */
+FIO_SFUNC void fiobj___arena_adopt_task(FIOBJ o, volatile size_t *ref) {
+  ref[0] = FIOBJ___ARENA_NODE | FIOBJ___ARENA_BIAS;
+  /* arena objects are never freed on their own, so count them as freed */
+  FIOBJ_MARK_MEMORY_FREE();
+  switch (FIOBJ_TYPE_CLASS(o)) {
+  case FIOBJ_T_STRING:
+    if (FIO_NAME_BL(FIO_NAME(fiobj, FIOBJ___NAME_STRING), allocated)(o))
+      FIO_LEAK_COUNTER_ON_FREE(
+          FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), destroy));
+    FIO_LEAK_COUNTER_ON_FREE(FIO_NAME(fiobj, FIOBJ___NAME_STRING));
+    FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), freeze)(o);
     return;
-  case FIOBJ_T_FALSE:
-    FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)
-    (args->json, "false", 5);
+  case FIOBJ_T_ARRAY:
+    if (!FIO_NAME_BL(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), embedded)(o) &&
+        FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), capa)(o))
+      FIO_LEAK_COUNTER_ON_FREE(
+          FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), destroy));
+    FIO_LEAK_COUNTER_ON_FREE(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY));
     return;
-  case FIOBJ_T_NULL:
-    FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)
-    (args->json, "null", 4);
+  case FIOBJ_T_HASH:
+    if (FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), capa)(o))
+      FIO_LEAK_COUNTER_ON_FREE(
+          FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), destroy));
+    FIO_LEAK_COUNTER_ON_FREE(FIO_NAME(fiobj, FIOBJ___NAME_HASH));
     return;
-  case FIOBJ_T_NUMBER:
-    FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write_i)
-    (args->json, FIO_NAME2(FIO_NAME(fiobj, FIOBJ___NAME_NUMBER), i)(o));
+  default: /* only big numbers and floats are built by the JSON parser */
+    if ((*fiobj_object_metadata(o)) == &FIOBJ___FLOAT_CLASS_VTBL)
+      FIO_LEAK_COUNTER_ON_FREE(fiobj___bigfloat);
+    else
+      FIO_LEAK_COUNTER_ON_FREE(fiobj___bignum);
     return;
-  case FIOBJ_T_FLOAT: {
-    char tmp_buf[256];
-    size_t len = fio_ftoa(tmp_buf,
-                          FIO_NAME2(FIO_NAME(fiobj, FIOBJ___NAME_FLOAT), f)(o),
-                          10);
-    FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)
-    (args->json, tmp_buf, len);
+  }
+}
+
+/* marks an object as part of the arena (once) */
+FIO_IFUNC void fiobj___arena_adopt(FIOBJ o) {
+  volatile size_t *ref = fiobj___ref(o);
+  if (ref && !(ref[0] & FIOBJ___ARENA_NODE))
+    fiobj___arena_adopt_task(o, ref);
+}
+
+/* returns a heap allocated (deep) copy of an arena backed object */
+FIO_SFUNC FIOBJ fiobj___arena_escape(FIOBJ o) {
+  FIOBJ r;
+  if (!FIO_NAME_BL(fiobj, arena)(o))
+    return fiobj_dup(o);
+  switch (FIOBJ_TYPE_CLASS(o)) {
+  case FIOBJ_T_STRING: {
+    fio_str_info_s s = FIO_NAME2(FIO_NAME(fiobj, FIOBJ___NAME_STRING), cstr)(o);
+    return FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), new_cstr)(s.buf,
+                                                                   s.len);
+  }
+  case FIOBJ_T_ARRAY: {
+    FIOBJ *a = FIO_NAME2(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), ptr)(o);
+    uint32_t count = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), count)(o);
+    r = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), new)();
+    FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), reserve)(r, count);
+    for (uint32_t i = 0; i < count; ++i)
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), push)
+    (r, fiobj___arena_escape(a[i]));
+    return r;
+  }
+  case FIOBJ_T_HASH:
+    r = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), new)();
+    FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), reserve)
+    (r, FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), count)(o));
+    FIO_MAP_EACH(FIO_NAME(fiobj, FIOBJ___NAME_HASH), o, i) {
+      FIOBJ key = fiobj___arena_escape(i.key);
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), set)
+      (r, key, fiobj___arena_escape(i.value), NULL);
+      fiobj_free(key);
+    }
+    return r;
+  default: /* only big numbers and floats are built by the JSON parser */
+    if ((*fiobj_object_metadata(o)) == &FIOBJ___FLOAT_CLASS_VTBL)
+      return FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_FLOAT), new)(
+          FIO_NAME2(FIO_NAME(fiobj, FIOBJ___NAME_FLOAT), f)(o));
+    return FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_NUMBER), new)(
+        FIO_NAME2(FIO_NAME(fiobj, FIOBJ___NAME_NUMBER), i)(o));
+  }
+}
+
+/** Internal: `fiobj_dup` for arena backed objects (`ref` was incremented). */
+SFUNC FIOBJ fiobj___arena_dup(FIOBJ o, size_t ref) {
+  if ((ref & FIOBJ___ARENA_ROOT))
+    return o;
+  fio_atomic_sub(fiobj___ref(o), 1); /* nested objects aren't counted */
+  if (fiobj___arena_current) /* the document is being built */
+    return o;
+  return fiobj___arena_escape(o);
+}
+
+/** Internal: `fiobj_free` for arena backed objects (`ref` was decremented). */
+SFUNC void fiobj___arena_free(FIOBJ o, size_t ref) {
+  volatile size_t *r = fiobj___ref(o);
+  if (!(ref & FIOBJ___ARENA_ROOT)) {
+    fio_atomic_add(r, 1); /* nested objects are released with the root */
     return;
   }
-  case FIOBJ_T_STRING: /* fall through */
-  default: {
-    fio_str_info_s info = FIO_NAME2(fiobj, cstr)(o);
-    FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)(args->json, "\"", 1);
-    FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write_escape)
-    (args->json, info.buf, info.len);
-    FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)(args->json, "\"", 1);
+  if (ref != (FIOBJ___ARENA_NODE | FIOBJ___ARENA_ROOT))
     return;
+  fiobj___arena_release((fiobj___arena_s *)((char *)r - FIOBJ___ARENA_HEAD));
+}
+
+/* *****************************************************************************
+FIOBJ JSON support - output
+***************************************************************************** */
+
+/* the longest `fio_ftoa` output (i.e., "-1.2345678901234567e-308") */
+#define FIOBJ___JSON_FLOAT_CAPA 24
+
+/* tests 8 bytes at once, non-zero if any byte requires JSON escaping */
+FIO_IFUNC uint64_t fiobj___json_escape_test64(uint64_t w) {
+  const uint64_t ones = UINT64_C(0x0101010101010101);
+  return ((w - (ones * 0x20)) & ~w & (ones * 0x80)) | /* control characters */
+         fio_has_byte64(w, '"') | fio_has_byte64(w, '\\');
+}
+
+/* the number of bytes added by escaping `c` (as `fio_string_write_escape`) */
+FIO_IFUNC size_t fiobj___json_escape_extra(uint8_t c) {
+  if (c > 0x1F)
+    return (c == '"') | (c == '\\');
+  return 5 - ((size_t)((c > 7) & (c < 14) & (c != 11)) << 2);
+}
+
+/* writes a single (possibly escaped) byte */
+FIO_IFUNC char *fiobj___json_escape_byte(char *dest, uint8_t c) {
+  if (FIO_LIKELY(!fiobj___json_escape_extra(c))) {
+    *dest = (char)c;
+    return dest + 1;
+  }
+  *dest++ = '\\';
+  switch (c) {
+  case '\b': *dest = 'b'; return dest + 1;
+  case '\f': *dest = 'f'; return dest + 1;
+  case '\n': *dest = 'n'; return dest + 1;
+  case '\r': *dest = 'r'; return dest + 1;
+  case '\t': *dest = 't'; return dest + 1;
+  case '"':  /* fall through */
+  case '\\': *dest = (char)c; return dest + 1;
+  }
+  dest[0] = 'u';
+  dest[1] = '0';
+  dest[2] = '0';
+  dest[3] = (char)fio_i2c(c >> 4);
+  dest[4] = (char)fio_i2c(c & 15);
+  return dest + 5;
+}
+
+/* returns the length of the escaped data (excluding the quotes) */
+FIO_SFUNC size_t fiobj___json_escaped_len(fio_str_info_s s) {
+  size_t r = s.len;
+  const char *end = s.buf + s.len;
+  for (; s.buf + 8 <= end; s.buf += 8) {
+    if (FIO_LIKELY(!fiobj___json_escape_test64(fio_buf2u64u(s.buf))))
+      continue;
+    for (size_t i = 0; i < 8; ++i)
+      r += fiobj___json_escape_extra((uint8_t)s.buf[i]);
   }
+  for (; s.buf < end; ++s.buf)
+    r += fiobj___json_escape_extra((uint8_t)s.buf[0]);
+  return r;
+}
+
+/* writes the escaped data, copying 8 bytes at a time when possible */
+FIO_SFUNC char *fiobj___json_escape(char *dest, fio_str_info_s s) {
+  const char *end = s.buf + s.len;
+  while (s.buf + 8 <= end) {
+    uint64_t w = fio_buf2u64u(s.buf);
+    if (FIO_LIKELY(!fiobj___json_escape_test64(w))) {
+      fio_u2buf64u(dest, w);
+      dest += 8;
+    } else {
+      for (size_t i = 0; i < 8; ++i)
+        dest = fiobj___json_escape_byte(dest, (uint8_t)s.buf[i]);
+    }
+    s.buf += 8;
+  }
+  while (s.buf < end)
+    dest = fiobj___json_escape_byte(dest, (uint8_t)*s.buf++);
+  return dest;
+}
+
+/* the sizing pass (see `fiobj_json_capa`), excluding the NUL terminator. */
+FIO_SFUNC size_t fiobj___json_capa(FIOBJ o, size_t level, uint8_t beautify) {
+  size_t r, count;
+  switch (FIOBJ_TYPE(o)) {
+  case FIOBJ_T_TRUE: return 4;
+  case FIOBJ_T_FALSE: return 5;
+  case FIOBJ_T_NULL: return 4;
+  case FIOBJ_T_NUMBER:
+    return fio_digits10(FIO_NAME2(FIO_NAME(fiobj, FIOBJ___NAME_NUMBER), i)(o));
+  case FIOBJ_T_FLOAT: return FIOBJ___JSON_FLOAT_CAPA;
+  case FIOBJ_T_STRING: /* fall through */
+  default: return fiobj___json_escaped_len(FIO_NAME2(fiobj, cstr)(o)) + 2;
   case FIOBJ_T_ARRAY:
-    if (!FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), count)(o))
-      goto empty_array;
-    if (args->level == FIOBJ_MAX_NESTING)
-      goto err_array_nesting;
-    {
-      ++args->level;
-      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)(args->json, "[", 1);
-      const uint32_t len =
-          FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), count)(o);
-      if (args->beautify) {
-        fiobj___json_format_internal_beauty_pad(args->json, args->level);
-      }
-      fiobj___json_format_internal__(
-          args,
-          FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), get)(o, 0));
-      if (args->beautify) {
-        for (size_t i = 1; i < len; ++i) {
-          FIOBJ child =
-              FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), get)(o, i);
-          FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)
-          (args->json, ",", 1);
-          fiobj___json_format_internal_beauty_pad(args->json, args->level);
-          fiobj___json_format_internal__(args, child);
-        }
-      } else {
-        for (size_t i = 1; i < len; ++i) {
-          FIOBJ child =
-              FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), get)(o, i);
-          FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)
-          (args->json, ",", 1);
-          fiobj___json_format_internal__(args, child);
-        }
-      }
-      --args->level;
-      if (args->beautify) {
-        fiobj___json_format_internal_beauty_pad(args->json, args->level);
-      }
-      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)(args->json, "]", 1);
+    count = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), count)(o);
+    if (!count)
+      return 2;
+    if (level == FIOBJ_MAX_NESTING)
+      return 3;
+    r = 1 + count; /* brackets and commas */
+    if (beautify)
+      r += (count * (2 + ((level + 1) << 1))) + 2 + (level << 1);
+    FIO_ARRAY_EACH(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), o, pos) {
+      r += fiobj___json_capa(*pos, level + 1, beautify);
     }
-    return;
+    return r;
   case FIOBJ_T_HASH:
-    if (!FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), count)(o))
-      goto empty_hash;
-    if (args->level == FIOBJ_MAX_NESTING)
-      goto err_hash_nesting;
-    {
-      size_t i = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), count)(o);
-      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)
-      (args->json, "{", 1);
-      ++args->level;
-      FIO_MAP_EACH(FIO_NAME(fiobj, FIOBJ___NAME_HASH), o, couplet) {
-        if (args->beautify) {
-          fiobj___json_format_internal_beauty_pad(args->json, args->level);
-        }
-        fio_str_info_s info = FIO_NAME2(fiobj, cstr)(couplet.key);
-        FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)
-        (args->json, "\"", 1);
-        FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write_escape)
-        (args->json, info.buf, info.len);
-        FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)
-        (args->json, "\":", 2);
-        fiobj___json_format_internal__(args, couplet.value);
-        if (--i)
-          FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)
-        (args->json, ",", 1);
-      }
-      --args->level;
-      if (args->beautify) {
-        fiobj___json_format_internal_beauty_pad(args->json, args->level);
-      }
-      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)
-      (args->json, "}", 1);
+    count = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), count)(o);
+    if (!count)
+      return 2;
+    if (level == FIOBJ_MAX_NESTING)
+      return 3;
+    r = 1 + (count << 1); /* braces, colons and commas */
+    if (beautify)
+      r += (count * (2 + ((level + 1) << 1))) + 2 + (level << 1);
+    FIO_MAP_EACH(FIO_NAME(fiobj, FIOBJ___NAME_HASH), o, i) {
+      r += fiobj___json_escaped_len(FIO_NAME2(fiobj, cstr)(i.key)) + 2;
+      r += fiobj___json_capa(i.value, level + 1, beautify);
     }
-    return;
+    return r;
   }
-empty_hash:
-  FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)
-  (args->json, "{}", 2);
-  return;
-empty_array:
-  FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)
-  (args->json, "[]", 2);
-  return;
-err_array_nesting:
-  FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)
-  (args->json, "[ ]", 3);
-  goto log_nesting_error;
-err_hash_nesting:
-  FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)
-  (args->json, "{ }", 3);
-log_nesting_error:
+}
+
+/* a JSON output buffer, growing the `str` String (if any) when full */
+typedef struct {
+  char *buf;
+  size_t len;
+  size_t capa;
+  FIOBJ str;
+} fiobj___json_writer_s;
+
+/* writes a new line followed by the indentation for the nesting `level` */
+FIO_IFUNC void fiobj___json_write_pad(fiobj___json_writer_s *w, size_t level) {
+  w->buf[w->len++] = '\r';
+  w->buf[w->len++] = '\n';
+  FIO_MEMSET(w->buf + w->len, ' ', level << 1);
+  w->len += level << 1;
+}
+
+/* grows the output String, so more than `len` bytes are available */
+FIO_SFUNC int fiobj___json_writer_grow(fiobj___json_writer_s *w, size_t len) {
+  fio_str_info_s s;
+  if (!w->str)
+    return -1;
+  FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), resize)(w->str, w->len);
+  /* double the capacity, so large outputs are copied only a few times */
+  s = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING),
+               reserve)(w->str, (len > w->len ? len : w->len) + 1);
+  w->buf = s.buf;
+  w->capa = s.capa - 1; /* the NUL byte isn't available to the writer */
+  return 0 - (w->capa - w->len <= len);
+}
+
+/* makes sure that more than `len` bytes are available, returns -1 on error */
+#define FIOBJ___JSON_RESERVE(w, len_)                                          \
+  (FIO_LIKELY((w)->capa - (w)->len > (len_))                                   \
+       ? 0                                                                     \
+       : fiobj___json_writer_grow((w), (len_)))
+
+/* writes a JSON String (with room for the next comma or colon) */
+FIO_SFUNC int fiobj___json_write_string(fiobj___json_writer_s *w,
+                                        fio_str_info_s s) {
+  const char *end = s.buf + s.len;
+  char *dest;
+  /* assume no escaping is required, most Strings don't require escaping */
+  if (FIOBJ___JSON_RESERVE(w, s.len + 2))
+    return -1;
+  dest = w->buf + w->len;
+  *dest++ = '"';
+  for (; s.buf + 8 <= end; s.buf += 8, dest += 8) {
+    uint64_t word = fio_buf2u64u(s.buf);
+    if (FIO_UNLIKELY(fiobj___json_escape_test64(word)))
+      goto escape;
+    fio_u2buf64u(dest, word);
+  }
+  for (; s.buf < end; ++s.buf) {
+    if (FIO_UNLIKELY(fiobj___json_escape_extra((uint8_t)*s.buf)))
+      goto escape;
+    *dest++ = *s.buf;
+  }
+finish:
+  *dest++ = '"';
+  w->len = (size_t)(dest - w->buf);
+  return 0;
+
+escape:
+  w->len = (size_t)(dest - w->buf);
+  s.len = (size_t)(end - s.buf);
+  if (FIOBJ___JSON_RESERVE(w, fiobj___json_escaped_len(s) + 1))
+    return -1;
+  dest = fiobj___json_escape(w->buf + w->len, s);
+  goto finish;
+}
+
+/* the writing pass (see `fiobj_json_write`), returns -1 on error. */
+FIO_SFUNC int fiobj___json_write(fiobj___json_writer_s *w,
+                                 FIOBJ o,
+                                 size_t level,
+                                 uint8_t beautify) {
+  const size_t pad = beautify ? ((level + 1) << 1) + 2 : 0;
+  size_t count;
+  if (FIOBJ___JSON_RESERVE(w, FIOBJ___JSON_FLOAT_CAPA + pad))
+    return -1;
+  switch (FIOBJ_TYPE(o)) {
+  case FIOBJ_T_TRUE:
+    fio_memcpy4(w->buf + w->len, "true");
+    w->len += 4;
+    return 0;
+  case FIOBJ_T_FALSE:
+    fio_memcpy5(w->buf + w->len, "false");
+    w->len += 5;
+    return 0;
+  case FIOBJ_T_NULL:
+    fio_memcpy4(w->buf + w->len, "null");
+    w->len += 4;
+    return 0;
+  case FIOBJ_T_NUMBER: {
+    int64_t i = FIO_NAME2(FIO_NAME(fiobj, FIOBJ___NAME_NUMBER), i)(o);
+    count = fio_digits10(i);
+    fio_ltoa10(w->buf + w->len, i, count);
+    w->len += count;
+    return 0;
+  }
+  case FIOBJ_T_FLOAT:
+    w->len += fio_ftoa(w->buf + w->len,
+                       FIO_NAME2(FIO_NAME(fiobj, FIOBJ___NAME_FLOAT), f)(o),
+                       10);
+    return 0;
+  case FIOBJ_T_STRING: /* fall through */
+  default: return fiobj___json_write_string(w, FIO_NAME2(fiobj, cstr)(o));
+  case FIOBJ_T_ARRAY:
+    count = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), count)(o);
+    if (!count) {
+      fio_memcpy2(w->buf + w->len, "[]");
+      w->len += 2;
+      return 0;
+    }
+    if (level == FIOBJ_MAX_NESTING) {
+      fio_memcpy3(w->buf + w->len, "[ ]");
+      goto nesting_error;
+    }
+    w->buf[w->len++] = '[';
+    FIO_ARRAY_EACH(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), o, pos) {
+      if (FIOBJ___JSON_RESERVE(w, pad))
+        return -1;
+      if (beautify)
+        fiobj___json_write_pad(w, level + 1);
+      if (fiobj___json_write(w, *pos, level + 1, beautify))
+        return -1;
+      w->buf[w->len++] = ','; /* room for 1 byte is always available */
+    }
+    --w->len; /* the last comma */
+    if (FIOBJ___JSON_RESERVE(w, pad + 2)) /* the bracket and the next comma */
+      return -1;
+    if (beautify)
+      fiobj___json_write_pad(w, level);
+    w->buf[w->len++] = ']';
+    return 0;
+  case FIOBJ_T_HASH:
+    count = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), count)(o);
+    if (!count) {
+      fio_memcpy2(w->buf + w->len, "{}");
+      w->len += 2;
+      return 0;
+    }
+    if (level == FIOBJ_MAX_NESTING) {
+      fio_memcpy3(w->buf + w->len, "{ }");
+      goto nesting_error;
+    }
+    w->buf[w->len++] = '{';
+    FIO_MAP_EACH(FIO_NAME(fiobj, FIOBJ___NAME_HASH), o, i) {
+      if (FIOBJ___JSON_RESERVE(w, pad))
+        return -1;
+      if (beautify)
+        fiobj___json_write_pad(w, level + 1);
+      if (fiobj___json_write_string(w, FIO_NAME2(fiobj, cstr)(i.key)))
+        return -1;
+      w->buf[w->len++] = ':';
+      if (fiobj___json_write(w, i.value, level + 1, beautify))
+        return -1;
+      w->buf[w->len++] = ',';
+    }
+    --w->len; /* the last comma */
+    if (FIOBJ___JSON_RESERVE(w, pad + 2)) /* the bracket and the next comma */
+      return -1;
+    if (beautify)
+      fiobj___json_write_pad(w, level);
+    w->buf[w->len++] = '}';
+    return 0;
+  }
+nesting_error:
   FIO_LOG_ERROR("JSON formatting truncated - nesting level too deep.");
+  w->len += 3;
+  return 0;
+}
+
+/** Returns the buffer length required for writing the JSON representation. */
+SFUNC size_t fiobj_json_capa(FIOBJ o, uint8_t beautify) {
+  return fiobj___json_capa(o, 0, beautify) + 1;
+}
+
+/** Writes the JSON representation of the object to `dest`. */
+SFUNC size_t fiobj_json_write(char *dest, FIOBJ o, uint8_t beautify) {
+  /* the buffer was sized by the caller, so it is never reported as full */
+  fiobj___json_writer_s w = {.buf = dest, .capa = ((size_t)-1) >> 1};
+  fiobj___json_write(&w, o, 0, beautify);
+  dest[w.len] = 0;
+  return w.len;
 }
 
+/* appends the JSON for `o` to the `dest` String (see `fiobj2json`). */
+SFUNC void fiobj___json_format(FIOBJ dest, FIOBJ o, uint8_t beautify) {
+  fio_str_info_s s;
+  fiobj___json_writer_s w;
+  if (FIO_NAME_BL(FIO_NAME(fiobj, FIOBJ___NAME_STRING), frozen)(dest))
+    return;
+  /* `resize` commits the String's state before the buffer is written to */
+  s = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), resize)(
+      dest,
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), len)(dest));
+  w = (fiobj___json_writer_s){
+      .buf = s.buf,
+      .len = s.len,
+      .capa = s.capa - 1,
+      .str = dest,
+  };
+  fiobj___json_write(&w, o, 0, beautify);
+  FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), resize)(dest, w.len);
+}
+
+#undef FIOBJ___JSON_RESERVE
+#undef FIOBJ___JSON_FLOAT_CAPA
+
 /* *****************************************************************************
 FIOBJ JSON parsing
 ***************************************************************************** */
@@ -1944,6 +2658,108 @@ SFUNC FIOBJ fiobj_json_parse(fio_str_info_s str, size_t *consumed_p) {
   return (FIOBJ)result.ctx;
 }
 
+/* arena documents: objects are adopted once they are complete */
+FIO_SFUNC void *fiobj___json_arena_on_number(int64_t i) {
+  void *o = fiobj___json_on_number(i);
+  fiobj___arena_adopt((FIOBJ)o);
+  return o;
+}
+FIO_SFUNC void *fiobj___json_arena_on_float(double f) {
+  void *o = fiobj___json_on_float(f);
+  fiobj___arena_adopt((FIOBJ)o);
+  return o;
+}
+FIO_SFUNC void *fiobj___json_arena_on_string(const void *start, size_t len) {
+  void *o = fiobj___json_on_string(start, len);
+  fiobj___arena_adopt((FIOBJ)o);
+  return o;
+}
+FIO_SFUNC void *fiobj___json_arena_on_string_simple(const void *start,
+                                                    size_t len) {
+  void *o = fiobj___json_on_string_simple(start, len);
+  fiobj___arena_adopt((FIOBJ)o);
+  return o;
+}
+FIO_SFUNC void *fiobj___json_arena_on_map(void *ctx, void *at) {
+  return FIO_NAME(fiobj, FIO_NAME(FIOBJ___NAME_HASH, new))();
+  (void)ctx, (void)at;
+}
+FIO_SFUNC void *fiobj___json_arena_on_array(void *ctx, void *at) {
+  return FIO_NAME(fiobj, FIO_NAME(FIOBJ___NAME_ARRAY, new))();
+  (void)ctx, (void)at;
+}
+FIO_SFUNC int fiobj___json_arena_map_push(void *ctx, void *key, void *value) {
+  fiobj___arena_adopt((FIOBJ)key);
+  fiobj___arena_adopt((FIOBJ)value);
+  return fiobj___json_map_push(ctx, key, value);
+}
+FIO_SFUNC int fiobj___json_arena_array_push(void *ctx, void *value) {
+  fiobj___arena_adopt((FIOBJ)value);
+  return fiobj___json_array_push(ctx, value);
+}
+FIO_SFUNC int fiobj___json_arena_finished(void *ctx) {
+  fiobj___arena_adopt((FIOBJ)ctx);
+  return 0;
+}
+FIO_SFUNC void fiobj___json_arena_free_unused_object(void *ctx) {
+  fiobj___arena_adopt((FIOBJ)ctx);
+}
+FIO_SFUNC void *fiobj___json_arena_on_error(void *ctx) {
+  fiobj___arena_adopt((FIOBJ)ctx);
+  return ctx; /* the arena is released by the caller */
+}
+static fio_json_parser_callbacks_s FIOBJ_JSON_ARENA_PARSER_CALLBACKS = {
+    .on_null = fiobj___json_on_null,
+    .on_true = fiobj___json_on_true,
+    .on_false = fiobj___json_on_false,
+    .on_number = fiobj___json_arena_on_number,
+    .on_float = fiobj___json_arena_on_float,
+    .on_string = fiobj___json_arena_on_string,
+    .on_string_simple = fiobj___json_arena_on_string_simple,
+    .on_map = fiobj___json_arena_on_map,
+    .on_array = fiobj___json_arena_on_array,
+    .map_push = fiobj___json_arena_map_push,
+    .array_push = fiobj___json_arena_array_push,
+    .array_finished = fiobj___json_arena_finished,
+    .map_finished = fiobj___json_arena_finished,
+    .free_unused_object = fiobj___json_arena_free_unused_object,
+    .on_error = fiobj___json_arena_on_error,
+};
+
+/** Parses JSON into a read-only document that lives in a single arena. */
+SFUNC FIOBJ fiobj_json_parse_arena(fio_str_info_s str, size_t *consumed_p) {
+  FIOBJ r;
+  volatile size_t *ref;
+  fiobj___arena_s *old = fiobj___arena_current;
+  fiobj___arena_s *a = fiobj___arena_new(str.len);
+  if (!a) {
+    if (consumed_p)
+      *consumed_p = 0;
+    return FIOBJ_INVALID;
+  }
+  fiobj___arena_current = a;
+  fio_json_result_s result =
+      fio_json_parse(&FIOBJ_JSON_ARENA_PARSER_CALLBACKS, str.buf, str.len);
+  fiobj___arena_current = old;
+  if (consumed_p)
+    *consumed_p = result.stop_pos;
+  r = (FIOBJ)result.ctx;
+  if (result.err) {
+    fiobj___arena_release(a);
+    return FIOBJ_INVALID;
+  }
+  fiobj___arena_adopt(r);
+  ref = fiobj___ref(r);
+  if (ref && (char *)ref == (char *)a + FIOBJ___ARENA_HEAD) {
+    ref[0] = FIOBJ___ARENA_NODE | FIOBJ___ARENA_ROOT | 1;
+    return r;
+  }
+  if (ref) /* the root object must not point into the released arena */
+    r = fiobj___arena_escape(r);
+  fiobj___arena_release(a);
+  return r;
+}
+
 /**
  * Updates a Hash using JSON data.
  *
@@ -2252,6 +3068,574 @@ SFUNC FIOBJ fiobj_json_find(FIOBJ o, fio_str_info_s n) {
     }
   }
 }
+
+/* *****************************************************************************
+FIOBJ JSON compiled paths
+***************************************************************************** */
+
+/* a path set is a trie of path segments, node 0 is the root (the object) */
+typedef struct {
+  /** the Hash Map key (FIOBJ_INVALID for an Array index) */
+  FIOBJ key;
+  /** the key's hash value */
+  uint64_t hash;
+  /** the Array index */
+  uint32_t index;
+  /** the parent node */
+  uint32_t parent;
+  /** the first child node (0 if none) */
+  uint32_t child;
+  /** the next sibling node (0 if none) */
+  uint32_t next;
+  /** 1 + the index of the first path ending at this node (0 if none) */
+  uint32_t result;
+} fiobj___json_path_node_s;
+
+struct fiobj_json_path_s {
+  /** the number of paths in the set */
+  uint32_t count;
+  /** the number of trie nodes */
+  uint32_t len;
+  /** the capacity of the trie nodes array */
+  uint32_t capa;
+  /** the trie node each path ends at */
+  uint32_t *ends;
+  /** the trie nodes */
+  fiobj___json_path_node_s *nodes;
+};
+
+#define FIOBJ___JSON_PATH_NONE  ((uint32_t)-1)
+#define FIOBJ___JSON_PATH_BUILD ((uint32_t)-2)
+
+FIO_LEAK_COUNTER_DEF(fiobj_json_path)
+
+/* finds (or adds) the child node for a path segment, returns 0 on error */
+FIO_SFUNC uint32_t fiobj___json_path_child(fiobj_json_path_s *p,
+                                           uint32_t parent,
+                                           fio_str_info_s key,
+                                           uint32_t index) {
+  fiobj___json_path_node_s *n;
+  for (uint32_t i = p->nodes[parent].child; i; i = p->nodes[i].next) {
+    n = p->nodes + i;
+    if (key.buf ? (n->key && FIO_STR_INFO_IS_EQ(
+                                 FIO_NAME2(fiobj, cstr)(n->key),
+                                 key))
+                : (!n->key && n->index == index))
+      return i;
+  }
+  if (p->len == p->capa) {
+    n = (fiobj___json_path_node_s *)FIO_MEM_REALLOC_(
+        p->nodes,
+        sizeof(*n) * p->capa,
+        sizeof(*n) * (p->capa << 1),
+        sizeof(*n) * p->len);
+    if (!n)
+      return 0;
+    p->nodes = n;
+    p->capa <<= 1;
+  }
+  n = p->nodes + p->len;
+  *n = (fiobj___json_path_node_s){
+      .index = index,
+      .parent = parent,
+      .next = p->nodes[parent].child,
+  };
+  if (key.buf) {
+    n->key = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), new_cstr)(key.buf,
+                                                                     key.len);
+    n->hash = FIO_NAME2(fiobj, hash)(n->key);
+  }
+  p->nodes[parent].child = p->len;
+  return p->len++;
+}
+
+/* compiles the notation of the path at index `at`, returns -1 on error */
+FIO_SFUNC int fiobj___json_path_compile(fiobj_json_path_s *p,
+                                        uint32_t at,
+                                        fio_str_info_s n) {
+  uint32_t node = 0, depth = 0;
+  char *pos = n.buf, *end = n.buf + n.len;
+  if (n.len == 1 && pos[0] == '.')
+    ++pos;
+  while (pos < end) {
+    fio_str_info_s key = {0};
+    uint64_t index = 0;
+    if (++depth > FIOBJ_MAX_NESTING)
+      return -1;
+    if (*pos == '[') {
+      char *start = ++pos;
+      while (pos < end && fio_c2i(*pos) < 10 && index <= 0xFFFFFFFFULL)
+        index = (index * 10) + fio_c2i(*pos++);
+      if (pos == start || pos == end || *pos != ']' || index > 0xFFFFFFFFULL)
+        return -1;
+      ++pos;
+      if (pos < end && *pos != '.' && *pos != '[')
+        return -1;
+    } else {
+      key.buf = pos;
+      while (pos < end && *pos != '.' && *pos != '[')
+        ++pos;
+      key.len = pos - key.buf;
+      if (!key.len)
+        return -1;
+    }
+    pos += (pos < end && *pos == '.');
+    node = fiobj___json_path_child(p, node, key, (uint32_t)index);
+    if (!node)
+      return -1;
+  }
+  p->ends[at] = node;
+  if (!p->nodes[node].result)
+    p->nodes[node].result = at + 1;
+  return 0;
+}
+
+/** Compiles JSON path notations into a reusable path set. */
+SFUNC fiobj_json_path_s *fiobj_json_path_new(const fio_str_info_s *notations,
+                                             size_t count) {
+  fiobj_json_path_s *p;
+  if (!notations || !count || count > 0xFFFFFFF0ULL)
+    return NULL;
+  p = (fiobj_json_path_s *)
+      FIO_MEM_REALLOC_(NULL, 0, sizeof(*p) + (sizeof(uint32_t) * count), 0);
+  if (!p)
+    return p;
+  FIO_LEAK_COUNTER_ON_ALLOC(fiobj_json_path);
+  *p = (fiobj_json_path_s){
+      .count = (uint32_t)count,
+      .len = 1,
+      .capa = 8,
+      .ends = (uint32_t *)(p + 1),
+  };
+  p->nodes = (fiobj___json_path_node_s *)
+      FIO_MEM_REALLOC_(NULL, 0, sizeof(*p->nodes) * p->capa, 0);
+  if (!p->nodes)
+    goto error;
+  p->nodes[0] = (fiobj___json_path_node_s){0};
+  for (size_t i = 0; i < count; ++i)
+    if (fiobj___json_path_compile(p, (uint32_t)i, notations[i]))
+      goto error;
+  return p;
+error:
+  fiobj_json_path_free(p);
+  return NULL;
+}
+
+/** Frees a compiled path set. */
+SFUNC void fiobj_json_path_free(fiobj_json_path_s *p) {
+  if (!p)
+    return;
+  if (p->nodes) {
+    for (uint32_t i = 1; i < p->len; ++i)
+      fiobj_free(p->nodes[i].key);
+    FIO_MEM_FREE_(p->nodes, sizeof(*p->nodes) * p->capa);
+  }
+  FIO_LEAK_COUNTER_ON_FREE(fiobj_json_path);
+  FIO_MEM_FREE_(p, sizeof(*p) + (sizeof(uint32_t) * p->count));
+}
+
+/** Returns the number of paths in the path set. */
+SFUNC size_t fiobj_json_path_count(fiobj_json_path_s *p) {
+  return p ? p->count : 0;
+}
+
+/* returns the object addressed by a single trie node (segment) */
+FIO_IFUNC FIOBJ fiobj___json_path_step(FIOBJ o, fiobj___json_path_node_s *n) {
+  if (n->key)
+    return (FIOBJ_TYPE_CLASS(o) == FIOBJ_T_HASH)
+               ? FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH),
+                          get_hashed)(o, n->hash, n->key)
+               : FIOBJ_INVALID;
+  return (FIOBJ_TYPE_CLASS(o) == FIOBJ_T_ARRAY)
+             ? FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY),
+                        get)(o, (int64_t)n->index)
+             : FIOBJ_INVALID;
+}
+
+/* walks the trie from the root to `node` */
+FIO_SFUNC FIOBJ fiobj___json_path_find(FIOBJ o,
+                                       fiobj_json_path_s *p,
+                                       uint32_t node) {
+  if (!node)
+    return o;
+  o = fiobj___json_path_find(o, p, p->nodes[node].parent);
+  if (o == FIOBJ_INVALID)
+    return o;
+  return fiobj___json_path_step(o, p->nodes + node);
+}
+
+/* stores the results for `node` and its descendants (new references if own) */
+FIO_SFUNC void fiobj___json_path_visit(FIOBJ o,
+                                       fiobj_json_path_s *p,
+                                       uint32_t node,
+                                       FIOBJ *results,
+                                       int own) {
+  fiobj___json_path_node_s *n = p->nodes + node;
+  if (n->result)
+    results[n->result - 1] = own ? fiobj_dup(o) : o;
+  for (uint32_t i = n->child; i; i = p->nodes[i].next) {
+    FIOBJ v = fiobj___json_path_step(o, p->nodes + i);
+    if (v != FIOBJ_INVALID)
+      fiobj___json_path_visit(v, p, i, results, own);
+  }
+}
+
+/* fills in the results for duplicate paths, returns the number found */
+FIO_SFUNC size_t fiobj___json_path_finish(fiobj_json_path_s *p,
+                                          FIOBJ *results,
+                                          int own) {
+  size_t r = 0;
+  for (uint32_t i = 0; i < p->count; ++i) {
+    uint32_t first = p->nodes[p->ends[i]].result - 1;
+    if (first != i && results[first] != FIOBJ_INVALID)
+      results[i] = own ? fiobj_dup(results[first]) : results[first];
+    r += (results[i] != FIOBJ_INVALID);
+  }
+  return r;
+}
+
+/** Finds the data addressed by the first path in the path set. */
+SFUNC FIOBJ fiobj_json_path_find(FIOBJ o, fiobj_json_path_s *p) {
+  if (!p)
+    return FIOBJ_INVALID;
+  return fiobj___json_path_find(o, p, p->ends[0]);
+}
+
+/** Finds the data addressed by all the paths in a single traversal. */
+SFUNC size_t fiobj_json_path_find_all(FIOBJ o,
+                                      fiobj_json_path_s *p,
+                                      FIOBJ *results) {
+  if (!p || !results)
+    return 0;
+  for (uint32_t i = 0; i < p->count; ++i)
+    results[i] = FIOBJ_INVALID;
+  fiobj___json_path_visit(o, p, 0, results, 0);
+  return fiobj___json_path_finish(p, results, 0);
+}
+
+/* *****************************************************************************
+FIOBJ JSON compiled paths - selective parsing
+***************************************************************************** */
+
+/* a container along a path (a trie node with children) */
+typedef struct {
+  /** the container's trie node (NONE for the root frame) */
+  uint32_t node;
+  /** the trie node bound to the value of the last key (Hash Maps) */
+  uint32_t pending;
+  /** the number of values pushed so far */
+  uint32_t count;
+  uint8_t is_map;
+  uint8_t expect_key;
+} fiobj___json_path_frame_s;
+
+typedef struct {
+  fiobj_json_path_s *path;
+  FIOBJ *results;
+  /** the container being built, until it's complete */
+  FIOBJ root;
+  /** the trie node of the container being built */
+  uint32_t build_node;
+  /** the nesting level within the container being built */
+  uint32_t build;
+  /** the nesting level within an ignored container */
+  uint32_t skip;
+  /** the number of frames */
+  uint32_t depth;
+  fiobj___json_path_frame_s frames[FIOBJ_MAX_NESTING + 1];
+} fiobj___json_path_parser_s;
+
+/* the parser has no `udata`, so the selective parsing state is per thread */
+static __thread fiobj___json_path_parser_s *fiobj___json_path_parser;
+
+/* a placeholder for values that aren't built */
+#define FIOBJ___JSON_PATH_SKIP ((void *)&fiobj___json_path_parser)
+
+/* returns the trie node bound to the next value (NONE if ignored) */
+FIO_SFUNC uint32_t fiobj___json_path_bind(fiobj___json_path_parser_s *s) {
+  fiobj___json_path_frame_s *f = s->frames + s->depth - 1;
+  fiobj___json_path_node_s *nodes = s->path->nodes;
+  if (f->is_map)
+    return f->pending;
+  if (f->node == FIOBJ___JSON_PATH_NONE) /* the root frame */
+    return f->count ? FIOBJ___JSON_PATH_NONE : 0;
+  for (uint32_t i = nodes[f->node].child; i; i = nodes[i].next)
+    if (!nodes[i].key && nodes[i].index == f->count)
+      return i;
+  return FIOBJ___JSON_PATH_NONE;
+}
+
+/* returns 1 if the next value is a Hash Map key in a frame (consuming it) */
+FIO_IFUNC int fiobj___json_path_is_key(fiobj___json_path_parser_s *s) {
+  fiobj___json_path_frame_s *f = s->frames + s->depth - 1;
+  if (s->build | s->skip | !f->expect_key)
+    return 0;
+  f->expect_key = 0;
+  f->pending = FIOBJ___JSON_PATH_NONE;
+  return 1;
+}
+
+/* returns the trie node for a scalar value (or BUILD / NONE) */
+FIO_SFUNC uint32_t fiobj___json_path_scalar(void) {
+  fiobj___json_path_parser_s *s = fiobj___json_path_parser;
+  uint32_t n;
+  if (s->build)
+    return FIOBJ___JSON_PATH_BUILD;
+  if (s->skip || fiobj___json_path_is_key(s))
+    return FIOBJ___JSON_PATH_NONE;
+  n = fiobj___json_path_bind(s);
+  if (n == FIOBJ___JSON_PATH_NONE || !s->path->nodes[n].result)
+    return FIOBJ___JSON_PATH_NONE;
+  return n;
+}
+
+/* stores a scalar value (unless it's part of a container being built) */
+FIO_SFUNC void *fiobj___json_path_store(uint32_t n, void *o) {
+  fiobj___json_path_parser_s *s = fiobj___json_path_parser;
+  if (n == FIOBJ___JSON_PATH_BUILD)
+    return o;
+  fiobj___json_path_visit((FIOBJ)o, s->path, n, s->results, 1);
+  fiobj_free((FIOBJ)o);
+  return FIOBJ___JSON_PATH_SKIP;
+}
+
+/* releases the results of a trie node and its descendants */
+FIO_SFUNC void fiobj___json_path_clear(fiobj___json_path_parser_s *s,
+                                       uint32_t node) {
+  fiobj___json_path_node_s *n = s->path->nodes + node;
+  if (n->result) {
+    fiobj_free(s->results[n->result - 1]);
+    s->results[n->result - 1] = FIOBJ_INVALID;
+  }
+  for (uint32_t i = n->child; i; i = s->path->nodes[i].next)
+    fiobj___json_path_clear(s, i);
+}
+
+/* matches a Hash Map key to the frame's trie node children */
+FIO_SFUNC void fiobj___json_path_key(fiobj___json_path_parser_s *s,
+                                     fio_str_info_s key) {
+  fiobj___json_path_frame_s *f = s->frames + s->depth - 1;
+  fiobj___json_path_node_s *nodes = s->path->nodes;
+  for (uint32_t i = nodes[f->node].child; i; i = nodes[i].next) {
+    fio_str_info_s k;
+    if (!nodes[i].key)
+      continue;
+    k = FIO_NAME2(fiobj, cstr)(nodes[i].key);
+    if (FIO_STR_INFO_IS_EQ(k, key)) {
+      f->pending = i;
+      fiobj___json_path_clear(s, i); /* duplicate keys: the last value wins */
+      return;
+    }
+  }
+}
+
+FIO_SFUNC void *fiobj___json_path_on_null(void) {
+  uint32_t n = fiobj___json_path_scalar();
+  if (n == FIOBJ___JSON_PATH_NONE)
+    return FIOBJ___JSON_PATH_SKIP;
+  return fiobj___json_path_store(n, fiobj___json_on_null());
+}
+FIO_SFUNC void *fiobj___json_path_on_true(void) {
+  uint32_t n = fiobj___json_path_scalar();
+  if (n == FIOBJ___JSON_PATH_NONE)
+    return FIOBJ___JSON_PATH_SKIP;
+  return fiobj___json_path_store(n, fiobj___json_on_true());
+}
+FIO_SFUNC void *fiobj___json_path_on_false(void) {
+  uint32_t n = fiobj___json_path_scalar();
+  if (n == FIOBJ___JSON_PATH_NONE)
+    return FIOBJ___JSON_PATH_SKIP;
+  return fiobj___json_path_store(n, fiobj___json_on_false());
+}
+FIO_SFUNC void *fiobj___json_path_on_number(int64_t i) {
+  uint32_t n = fiobj___json_path_scalar();
+  if (n == FIOBJ___JSON_PATH_NONE)
+    return FIOBJ___JSON_PATH_SKIP;
+  return fiobj___json_path_store(n, fiobj___json_on_number(i));
+}
+FIO_SFUNC void *fiobj___json_path_on_float(double f) {
+  uint32_t n = fiobj___json_path_scalar();
+  if (n == FIOBJ___JSON_PATH_NONE)
+    return FIOBJ___JSON_PATH_SKIP;
+  return fiobj___json_path_store(n, fiobj___json_on_float(f));
+}
+FIO_SFUNC void *fiobj___json_path_on_string(const void *start, size_t len) {
+  fiobj___json_path_parser_s *s = fiobj___json_path_parser;
+  uint32_t n;
+  if (fiobj___json_path_is_key(s)) {
+    FIOBJ_STR_TEMP_VAR(key);
+    FIO_NAME(fiobj, FIO_NAME(FIOBJ___NAME_STRING, write_unescape))
+    (key, (const char *)start, len);
+    fiobj___json_path_key(s, FIO_NAME2(fiobj, cstr)(key));
+    FIOBJ_STR_TEMP_DESTROY(key);
+    return FIOBJ___JSON_PATH_SKIP;
+  }
+  n = fiobj___json_path_scalar();
+  if (n == FIOBJ___JSON_PATH_NONE)
+    return FIOBJ___JSON_PATH_SKIP;
+  return fiobj___json_path_store(n, fiobj___json_on_string(start, len));
+}
+FIO_SFUNC void *fiobj___json_path_on_string_simple(const void *start,
+                                                   size_t len) {
+  fiobj___json_path_parser_s *s = fiobj___json_path_parser;
+  uint32_t n;
+  if (fiobj___json_path_is_key(s)) {
+    fiobj___json_path_key(s, FIO_STR_INFO2((char *)start, len));
+    return FIOBJ___JSON_PATH_SKIP;
+  }
+  n = fiobj___json_path_scalar();
+  if (n == FIOBJ___JSON_PATH_NONE)
+    return FIOBJ___JSON_PATH_SKIP;
+  return fiobj___json_path_store(n, fiobj___json_on_string_simple(start, len));
+}
+FIO_SFUNC void *fiobj___json_path_on_container(uint8_t is_map) {
+  fiobj___json_path_parser_s *s = fiobj___json_path_parser;
+  fiobj___json_path_node_s *nodes = s->path->nodes;
+  uint32_t n;
+  if (s->build) {
+    ++s->build;
+    goto build;
+  }
+  if (s->skip || fiobj___json_path_is_key(s))
+    goto skip;
+  n = fiobj___json_path_bind(s);
+  if (n == FIOBJ___JSON_PATH_NONE || !(nodes[n].result | nodes[n].child))
+    goto skip;
+  if (nodes[n].result) { /* build the container (and collect its children) */
+    s->build = 1;
+    s->build_node = n;
+    s->root = (is_map ? FIO_NAME(fiobj, FIO_NAME(FIOBJ___NAME_HASH, new))()
+                      : FIO_NAME(fiobj, FIO_NAME(FIOBJ___NAME_ARRAY, new))());
+    return (void *)s->root;
+  }
+  FIO_ASSERT_DEBUG(s->depth <= FIOBJ_MAX_NESTING, "JSON path frames overflow");
+  s->frames[s->depth++] = (fiobj___json_path_frame_s){
+      .node = n,
+      .pending = FIOBJ___JSON_PATH_NONE,
+      .is_map = is_map,
+      .expect_key = is_map,
+  };
+  return FIOBJ___JSON_PATH_SKIP;
+skip:
+  ++s->skip;
+  return FIOBJ___JSON_PATH_SKIP;
+build:
+  if (is_map)
+    return (void *)FIO_NAME(fiobj, FIO_NAME(FIOBJ___NAME_HASH, new))();
+  return (void *)FIO_NAME(fiobj, FIO_NAME(FIOBJ___NAME_ARRAY, new))();
+}
+FIO_SFUNC void *fiobj___json_path_on_map(void *ctx, void *at) {
+  return fiobj___json_path_on_container(1);
+  (void)ctx, (void)at;
+}
+FIO_SFUNC void *fiobj___json_path_on_array(void *ctx, void *at) {
+  return fiobj___json_path_on_container(0);
+  (void)ctx, (void)at;
+}
+FIO_SFUNC int fiobj___json_path_map_push(void *ctx, void *key, void *value) {
+  fiobj___json_path_parser_s *s = fiobj___json_path_parser;
+  fiobj___json_path_frame_s *f = s->frames + s->depth - 1;
+  if (s->build)
+    return fiobj___json_map_push(ctx, key, value);
+  if (!s->skip) {
+    f->expect_key = 1;
+    f->pending = FIOBJ___JSON_PATH_NONE;
+    ++f->count;
+  }
+  return 0;
+}
+FIO_SFUNC int fiobj___json_path_array_push(void *ctx, void *value) {
+  fiobj___json_path_parser_s *s = fiobj___json_path_parser;
+  if (s->build)
+    return fiobj___json_array_push(ctx, value);
+  if (!s->skip)
+    ++s->frames[s->depth - 1].count;
+  return 0;
+}
+FIO_SFUNC int fiobj___json_path_finished(void *ctx) {
+  fiobj___json_path_parser_s *s = fiobj___json_path_parser;
+  if (s->build) {
+    if (--s->build)
+      return 0;
+    s->root = FIOBJ_INVALID;
+    fiobj___json_path_visit((FIOBJ)ctx, s->path, s->build_node, s->results, 1);
+    fiobj_free((FIOBJ)ctx);
+    return 0;
+  }
+  if (s->skip)
+    --s->skip;
+  else if (s->depth > 1)
+    --s->depth;
+  return 0;
+}
+FIO_SFUNC void fiobj___json_path_free_unused_object(void *ctx) {
+  if (fiobj___json_path_parser->build)
+    fiobj_free((FIOBJ)ctx);
+}
+FIO_SFUNC void *fiobj___json_path_on_error(void *ctx) {
+  return NULL; /* results are released by the caller */
+  (void)ctx;
+}
+static fio_json_parser_callbacks_s FIOBJ_JSON_PATH_PARSER_CALLBACKS = {
+    .on_null = fiobj___json_path_on_null,
+    .on_true = fiobj___json_path_on_true,
+    .on_false = fiobj___json_path_on_false,
+    .on_number = fiobj___json_path_on_number,
+    .on_float = fiobj___json_path_on_float,
+    .on_string = fiobj___json_path_on_string,
+    .on_string_simple = fiobj___json_path_on_string_simple,
+    .on_map = fiobj___json_path_on_map,
+    .on_array = fiobj___json_path_on_array,
+    .map_push = fiobj___json_path_map_push,
+    .array_push = fiobj___json_path_array_push,
+    .array_finished = fiobj___json_path_finished,
+    .map_finished = fiobj___json_path_finished,
+    .free_unused_object = fiobj___json_path_free_unused_object,
+    .on_error = fiobj___json_path_on_error,
+};
+
+/** Parses JSON data, building only the objects addressed by the path set. */
+SFUNC size_t fiobj_json_path_parse(fiobj_json_path_s *p,
+                                   fio_str_info_s json,
+                                   FIOBJ *results,
+                                   size_t *consumed) {
+  fiobj___json_path_parser_s s;
+  fiobj___json_path_parser_s *old = fiobj___json_path_parser;
+  fio_json_result_s r;
+  if (consumed)
+    *consumed = 0;
+  if (!p || !results)
+    return 0;
+  for (uint32_t i = 0; i < p->count; ++i)
+    results[i] = FIOBJ_INVALID;
+  s.path = p;
+  s.results = results;
+  s.root = FIOBJ_INVALID;
+  s.build_node = s.build = s.skip = 0;
+  s.depth = 1;
+  s.frames[0] = (fiobj___json_path_frame_s){
+      .node = FIOBJ___JSON_PATH_NONE,
+      .pending = FIOBJ___JSON_PATH_NONE,
+  };
+  fiobj___json_path_parser = &s;
+  r = fio_json_parse(&FIOBJ_JSON_PATH_PARSER_CALLBACKS, json.buf, json.len);
+  fiobj___json_path_parser = old;
+  if (consumed)
+    *consumed = r.stop_pos;
+  if (r.err) {
+    fiobj_free(s.root); /* only set if parsing stopped mid-container */
+    for (uint32_t i = 0; i < p->count; ++i) {
+      fiobj_free(results[i]);
+      results[i] = FIOBJ_INVALID;
+    }
+    return 0;
+  }
+  return fiobj___json_path_finish(p, results, 1);
+}
+#undef FIOBJ___JSON_PATH_SKIP
+#undef FIOBJ___JSON_PATH_NONE
+#undef FIOBJ___JSON_PATH_BUILD
+
 /* *****************************************************************************
 FIOBJ cleanup
 ***************************************************************************** */
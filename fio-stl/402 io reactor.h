@@ -505,6 +505,9 @@ static fio___io_listen_s *fio___io_listen_dup(fio___io_listen_s *l) {
   return l;
 }
 
+/* attaches the listener when the reactor starts (an ON_START callback) */
+FIO_SFUNC void fio___io_listen_attach_task(void *l_);
+
 static void fio___io_listen_free(void *l_) {
   fio___io_listen_s *l = (fio___io_listen_s *)l_;
   if (l->io)
@@ -513,9 +516,11 @@ static void fio___io_listen_free(void *l_) {
     return;
 
   fio_state_callback_remove(FIO_CALL_AT_EXIT, fio___io_listen_free, (void *)l);
-  fio_state_callback_remove(FIO_CALL_ON_START, fio___io_listen_free, (void *)l);
+  fio_state_callback_remove(FIO_CALL_ON_START,
+                            fio___io_listen_attach_task,
+                            (void *)l);
   fio_state_callback_remove(FIO_CALL_PRE_START,
-                            fio___io_listen_free,
+                            fio___io_listen_attach_task,
                             (void *)l);
   fio___io_func_free_context_caller(l->protocol->io_functions.free_context,
                                     l->tls_ctx);
@@ -830,7 +835,7 @@ SFUNC fio_io_s *fio_io_connect FIO_NOOP(fio_io_connect_args_s args) {
   size_t url_len = strlen(args.url);
   fio_url_s url = fio_url_parse(args.url, url_len);
   args.tls = fio_io_tls_from_url(args.tls, url);
-  fio___io_init_protocol(args.protocol, !!args.tls);
+  fio___io_init_protocol_test(args.protocol, !!args.tls);
   if (url.query.len)
     url_len = url.query.buf - (args.url + 1);
   else if (url.target.len)
@@ -260,6 +260,7 @@ typedef enum {
   FIO___PUBSUB_IDENTIFY = (128 | 4),  /* identify remote connection */
   FIO___PUBSUB_FORWARDER = (128 | 8), /* forward to external engine */
   FIO___PUBSUB_PING = (128 | 16),
+  FIO___PUBSUB_BATCH = (128 | 16 | 8), /* coalesced cluster (peer) messages */
 
   FIO___PUBSUB_HISTORY_START = (128 | 32),
   FIO___PUBSUB_HISTORY_END = (128 | 64),
@@ -442,6 +443,32 @@ SFUNC void fio_pubsub_secret_set(char *secret, size_t len);
 /** Auto-peer detection and pub/sub multi-machine clustering using `port`. */
 SFUNC void fio_pubsub_broadcast_on_port(int16_t port);
 
+#ifndef FIO_PUBSUB_CLUSTER_BATCH_SIZE
+/**
+ * Messages sent to cluster peers are coalesced into a single (encrypted) frame
+ * until the frame reaches this size (in bytes) or until the batch delay passes.
+ */
+#define FIO_PUBSUB_CLUSTER_BATCH_SIZE (1UL << 14)
+#endif
+
+#ifndef FIO_PUBSUB_CLUSTER_BATCH_DELAY
+/**
+ * The maximum delay (in milliseconds) before a partial batch is sent to a peer.
+ *
+ * If zero (0), batches are sent at the end of the current IO reactor cycle.
+ */
+#define FIO_PUBSUB_CLUSTER_BATCH_DELAY 0
+#endif
+
+#ifndef FIO_PUBSUB_CLUSTER_BACKLOG_LIMIT
+/**
+ * When a cluster peer's outgoing backlog exceeds this number of bytes, reading
+ * from worker processes (IPC publishers) is suspended until the peer catches
+ * up (the peer's backlog drops below half this value).
+ */
+#define FIO_PUBSUB_CLUSTER_BACKLOG_LIMIT (1UL << 21)
+#endif
+
 /* *****************************************************************************
 
 
@@ -590,6 +617,9 @@ typedef struct {
   size_t len;
   uint64_t uuid[2];
   fio___pubsub_message_s *msg;
+  char *batch;             /* outgoing (unencrypted) cluster peer batch */
+  uint8_t batch_scheduled; /* a batch flush task was scheduled */
+  uint8_t throttled;       /* peer fell behind, IPC reading is suspended */
   char buf[];
 } fio___pubsub_message_parser_s;
 
@@ -609,6 +639,8 @@ FIO_SFUNC void fio___pubsub_message_parser_init(
 FIO_SFUNC void fio___pubsub_message_parser_destroy(
     fio___pubsub_message_parser_s *p) {
   fio___pubsub_message_free(p->msg);
+  fio_bstr_free(p->batch);
+  p->batch = NULL;
   FIO_LEAK_COUNTER_ON_FREE(fio___pubsub_message_parser_s);
 }
 
@@ -760,6 +792,7 @@ FIO_SFUNC void fio___pubsub_protocol_on_attach(fio_io_s *io);
 FIO_SFUNC void fio___pubsub_protocol_on_data_master(fio_io_s *io);
 FIO_SFUNC void fio___pubsub_protocol_on_data_worker(fio_io_s *io);
 FIO_SFUNC void fio___pubsub_protocol_on_data_remote(fio_io_s *io);
+FIO_SFUNC void fio___pubsub_protocol_on_ready_remote(fio_io_s *io);
 FIO_SFUNC void fio___pubsub_protocol_on_close(void *buffer, void *udata);
 FIO_SFUNC void fio___pubsub_protocol_on_timeout(fio_io_s *io);
 
@@ -789,6 +822,7 @@ static struct FIO___PUBSUB_POSTOFFICE {
     fio_io_protocol_s remote;
   } protocol;
   fio_io_s *broadcaster;
+  size_t throttled; /* number of cluster peers that fell behind */
   struct {
     fio_msg_metadata_fn build;
     void (*cleanup)(void *);
@@ -818,6 +852,7 @@ static struct FIO___PUBSUB_POSTOFFICE {
                 {
                     .on_attach = fio___pubsub_protocol_on_attach,
                     .on_data = fio___pubsub_protocol_on_data_remote,
+                    .on_ready = fio___pubsub_protocol_on_ready_remote,
                     .on_close = fio___pubsub_protocol_on_close,
                     .on_timeout = fio___pubsub_protocol_on_timeout,
                     .buffer_size = sizeof(fio___pubsub_message_parser_s) +
@@ -994,6 +1029,7 @@ FIO_SFUNC void fio___pubsub_protocol_on_attach(fio_io_s *io);
 FIO_SFUNC void fio___pubsub_protocol_on_data_master(fio_io_s *io);
 FIO_SFUNC void fio___pubsub_protocol_on_data_worker(fio_io_s *io);
 FIO_SFUNC void fio___pubsub_protocol_on_data_remote(fio_io_s *io);
+FIO_SFUNC void fio___pubsub_protocol_on_ready_remote(fio_io_s *io);
 FIO_SFUNC void fio___pubsub_protocol_on_close(void *buffer, void *udata);
 
 FIO_SFUNC void fio___pubsub_at_exit(void *ignr_) {
@@ -1065,6 +1101,7 @@ FIO_CONSTRUCTOR(fio_postoffice_init) {
   FIO___PUBSUB_POSTOFFICE.protocol.remote = (fio_io_protocol_s){
       .on_attach = fio___pubsub_protocol_on_attach,
       .on_data = fio___pubsub_protocol_on_data_remote,
+      .on_ready = fio___pubsub_protocol_on_ready_remote,
       .on_close = fio___pubsub_protocol_on_close,
       .on_timeout = fio_io_touch,
       .buffer_size =
@@ -1507,14 +1544,9 @@ FIO_IFUNC fio___pubsub_message_s *fio___pubsub_message_author(
   return m;
 }
 
-FIO_SFUNC void fio___pubsub_message_encrypt(fio___pubsub_message_s *m) {
-  if (m->data.udata)
-    return;
-  const void *k = fio___pubsub_secret_key(m->data.id);
-  const uint64_t nonce[2] = {fio_risky_num(m->data.id, 0), m->data.published};
-  uint8_t *pos = (uint8_t *)(m->data.message.buf + m->data.message.len + 1);
-  uint8_t *dest = pos;
-  m->data.udata = (void *)pos;
+/** Writes the message's (unencrypted) wire format header to `pos`. */
+FIO_IFUNC uint8_t *fio___pubsub_message_header_write(uint8_t *pos,
+                                                     fio___pubsub_message_s *m) {
   fio_u2buf64_le(pos, m->data.id);
   pos += 8;
   fio_u2buf64_le(pos, m->data.published);
@@ -1526,6 +1558,36 @@ FIO_SFUNC void fio___pubsub_message_encrypt(fio___pubsub_message_s *m) {
   fio_u2buf24_le(pos, (uint32_t)m->data.message.len);
   pos += 3;
   *(pos++) = m->data.is_json;
+  return pos;
+}
+
+/** Reads a wire format header from `pos`, pointing data at `m->buf`. */
+FIO_IFUNC uint8_t *fio___pubsub_message_header_read(fio___pubsub_message_s *m,
+                                                    uint8_t *pos) {
+  m->data.id = fio_buf2u64_le(pos);
+  pos += 8;
+  m->data.published = fio_buf2u64_le(pos);
+  pos += 8;
+  m->data.filter = fio_buf2u16_le(pos);
+  pos += 2;
+  m->data.channel = FIO_BUF_INFO2(m->buf, fio_buf2u16_le(pos));
+  pos += 2;
+  m->data.message =
+      FIO_BUF_INFO2(m->buf + m->data.channel.len + 1, fio_buf2u24_le(pos));
+  pos += 3;
+  m->data.is_json = *(pos++);
+  return pos;
+}
+
+FIO_SFUNC void fio___pubsub_message_encrypt(fio___pubsub_message_s *m) {
+  if (m->data.udata)
+    return;
+  const void *k = fio___pubsub_secret_key(m->data.id);
+  const uint64_t nonce[2] = {fio_risky_num(m->data.id, 0), m->data.published};
+  uint8_t *pos = (uint8_t *)(m->data.message.buf + m->data.message.len + 1);
+  uint8_t *dest = pos;
+  m->data.udata = (void *)pos;
+  pos = fio___pubsub_message_header_write(pos, m);
   const size_t enc_len = m->data.channel.len + m->data.message.len + 2;
   FIO_MEMCPY(pos, m->data.channel.buf, enc_len);
   if (enc_len == 2)
@@ -1547,18 +1609,7 @@ FIO_SFUNC int fio___pubsub_message_decrypt(fio___pubsub_message_s *m) {
     return -1;
   uint8_t *pos = (uint8_t *)(m->data.message.buf + m->data.message.len + 1);
   uint8_t *const dest = pos;
-  m->data.id = fio_buf2u64_le(pos);
-  pos += 8;
-  m->data.published = fio_buf2u64_le(pos);
-  pos += 8;
-  m->data.filter = fio_buf2u16_le(pos);
-  pos += 2;
-  m->data.channel = FIO_BUF_INFO2(m->buf, fio_buf2u16_le(pos));
-  pos += 2;
-  m->data.message =
-      FIO_BUF_INFO2(m->buf + m->data.channel.len + 1, fio_buf2u24_le(pos));
-  pos += 3;
-  m->data.is_json = *(pos++);
+  pos = fio___pubsub_message_header_read(m, pos);
   const void *k = fio___pubsub_secret_key(m->data.id);
   uint64_t nonce[2] = {fio_risky_num(m->data.id, 0), m->data.published};
   const size_t enc_len = m->data.channel.len + m->data.message.len + 2;
@@ -1613,6 +1664,140 @@ FIO_SFUNC void FIO_ON_MESSAGE_SEND_MESSAGE(fio_msg_s *msg) {
                 .dealloc = (void (*)(void *))fio___pubsub_message_free);
 }
 
+/* *****************************************************************************
+Pub/Sub Cluster Batching (coalesced peer messages, encrypted once per batch)
+
+A batch is sent as a regular message flagged as `FIO___PUBSUB_BATCH`, where the
+message payload is a sequence of unencrypted messages:
+
+| 24 bytes - message header (see wire format) |
+| X bytes - (channel name, + 1 NUL terminator) |
+| Y bytes - (message data, + 1 NUL terminator) |
+
+The batch is authenticated and encrypted as a whole, so each message within the
+batch has no MAC of its own.
+***************************************************************************** */
+
+/* flow control: suspends / resumes reading from IPC (publisher) connections */
+FIO_SFUNC void fio___pubsub_ipc_suspend_task(fio_io_s *io, void *suspend) {
+  (suspend ? fio_io_suspend : fio_io_unsuspend)(io);
+}
+
+/* flow control: marks a peer as throttled (or not) */
+FIO_SFUNC void fio___pubsub_batch_throttle(fio___pubsub_message_parser_s *p,
+                                           uint8_t throttle) {
+  if (p->throttled == throttle)
+    return;
+  p->throttled = throttle;
+  if (throttle ? FIO___PUBSUB_POSTOFFICE.throttled++
+               : --FIO___PUBSUB_POSTOFFICE.throttled)
+    return;
+  FIO_LOG_DEBUG2("(%d) pub/sub cluster peer %s, %s IPC publishers",
+                 fio_io_pid(),
+                 (throttle ? "fell behind" : "caught up"),
+                 (throttle ? "throttling" : "resuming"));
+  fio_io_protocol_each(&FIO___PUBSUB_POSTOFFICE.protocol.ipc,
+                       fio___pubsub_ipc_suspend_task,
+                       (void *)(uintptr_t)throttle);
+}
+
+/* flow control: tests the peer's backlog after writing to the peer */
+FIO_IFUNC void fio___pubsub_batch_test_backlog(fio_io_s *io,
+                                               fio___pubsub_message_parser_s *p) {
+  if (fio_io_backlog(io) > FIO_PUBSUB_CLUSTER_BACKLOG_LIMIT)
+    fio___pubsub_batch_throttle(p, 1);
+}
+
+/* sends the pending batch (if any) to the peer */
+FIO_SFUNC void fio___pubsub_batch_flush(fio_io_s *io,
+                                        fio___pubsub_message_parser_s *p) {
+  char *batch = p->batch;
+  if (!batch)
+    return;
+  p->batch = NULL;
+  fio___pubsub_message_s *m = fio___pubsub_message_author(
+      (fio_publish_args_s){.message = FIO_BUF_INFO2(batch, fio_bstr_len(batch)),
+                           .is_json = FIO___PUBSUB_BATCH});
+  fio_bstr_free(batch);
+  fio___pubsub_message_write2io(io, m);
+  fio___pubsub_message_free(m);
+  fio___pubsub_batch_test_backlog(io, p);
+}
+
+FIO_SFUNC void fio___pubsub_batch_flush_scheduled(fio_io_s *io) {
+  fio___pubsub_message_parser_s *p;
+  if (!fio_io_is_open(io) || !(p = fio___pubsub_message_parser(io)))
+    return;
+  p->batch_scheduled = 0;
+  fio___pubsub_batch_flush(io, p);
+}
+
+#if FIO_PUBSUB_CLUSTER_BATCH_DELAY
+FIO_SFUNC int fio___pubsub_batch_flush_timer(void *io_, void *ignr_) {
+  fio___pubsub_batch_flush_scheduled((fio_io_s *)io_);
+  return -1;
+  (void)ignr_;
+}
+FIO_SFUNC void fio___pubsub_batch_flush_timer_done(void *io_, void *ignr_) {
+  fio_io_free((fio_io_s *)io_);
+  (void)ignr_;
+}
+#else
+FIO_SFUNC void fio___pubsub_batch_flush_task(void *io_, void *ignr_) {
+  fio___pubsub_batch_flush_scheduled((fio_io_s *)io_);
+  fio_io_free((fio_io_s *)io_);
+  (void)ignr_;
+}
+#endif
+
+/* appends a message to a batch (a `fio_bstr`), returning the updated batch */
+FIO_SFUNC char *fio___pubsub_batch_append(char *batch,
+                                          fio___pubsub_message_s *m) {
+  const size_t len = FIO___PUBSUB_MESSAGE_HEADER + m->data.channel.len +
+                     m->data.message.len + 2;
+  const size_t offset = fio_bstr_len(batch);
+  if (!batch)
+    batch = fio_bstr_reserve(NULL, FIO_PUBSUB_CLUSTER_BATCH_SIZE + len);
+  batch = fio_bstr_len_set(batch, offset + len);
+  FIO_MEMCPY(fio___pubsub_message_header_write((uint8_t *)batch + offset, m),
+             m->data.channel.buf,
+             len - FIO___PUBSUB_MESSAGE_HEADER);
+  return batch;
+}
+
+/* adds a message to the peer's batch (`fio_io_protocol_each` callback) */
+FIO_SFUNC void fio___pubsub_message_write2batch(fio_io_s *io, void *m_) {
+  fio___pubsub_message_s *m = (fio___pubsub_message_s *)m_;
+  fio___pubsub_message_parser_s *p = fio___pubsub_message_parser(io);
+  const size_t len = FIO___PUBSUB_MESSAGE_HEADER + m->data.channel.len +
+                     m->data.message.len + 2;
+  if (io == m->data.io || !p)
+    return;
+  if (len >= FIO_PUBSUB_CLUSTER_BATCH_SIZE) { /* big messages: no batching */
+    fio___pubsub_batch_flush(io, p);          /* keeps messages in order */
+    fio___pubsub_message_write2io(io, m);
+    fio___pubsub_batch_test_backlog(io, p);
+    return;
+  }
+  p->batch = fio___pubsub_batch_append(p->batch, m);
+  if (fio_bstr_len(p->batch) >= FIO_PUBSUB_CLUSTER_BATCH_SIZE) {
+    fio___pubsub_batch_flush(io, p);
+    return;
+  }
+  if (p->batch_scheduled)
+    return;
+  p->batch_scheduled = 1;
+#if FIO_PUBSUB_CLUSTER_BATCH_DELAY
+  fio_io_run_every(.fn = fio___pubsub_batch_flush_timer,
+                   .udata1 = fio_io_dup(io),
+                   .on_finish = fio___pubsub_batch_flush_timer_done,
+                   .every = (uint32_t)FIO_PUBSUB_CLUSTER_BATCH_DELAY,
+                   .repetitions = 1);
+#else
+  fio_io_defer(fio___pubsub_batch_flush_task, fio_io_dup(io), NULL);
+#endif
+}
+
 /* *****************************************************************************
 Pub/Sub Message Routing
 ***************************************************************************** */
@@ -1634,7 +1819,7 @@ FIO_SFUNC void fio___pubsub_message_route(fio___pubsub_message_s *m) {
 
   if ((FIO___PUBSUB_POSTOFFICE.filter.remote & flags))
     fio_io_protocol_each(&FIO___PUBSUB_POSTOFFICE.protocol.remote,
-                         fio___pubsub_message_write2io,
+                         fio___pubsub_message_write2batch,
                          m);
 
   if ((FIO___PUBSUB_POSTOFFICE.filter.publish & flags))
@@ -1839,8 +2024,39 @@ FIO_SFUNC void fio___pubsub_on_message_worker(fio_io_s *io,
   fio___pubsub_message_route(msg);
   (void)io;
 }
+FIO_SFUNC void fio___pubsub_on_message_remote(fio_io_s *io,
+                                              fio___pubsub_message_s *msg);
+/* routes each of the messages in a (decrypted) cluster batch, in order */
+FIO_SFUNC void fio___pubsub_batch_unpack(fio_io_s *io,
+                                         fio___pubsub_message_s *batch) {
+  uint8_t *pos = (uint8_t *)batch->data.message.buf;
+  uint8_t *const end = pos + batch->data.message.len;
+  while (pos + FIO___PUBSUB_MESSAGE_HEADER <= end) {
+    const size_t len = fio_buf2u16_le(pos + 18) + fio_buf2u24_le(pos + 20) + 2;
+    if (pos + FIO___PUBSUB_MESSAGE_HEADER + len > end ||
+        pos[23] == FIO___PUBSUB_BATCH)
+      break;
+    fio___pubsub_message_s *m = fio___pubsub_message_alloc(pos);
+    pos = fio___pubsub_message_header_read(m, pos);
+    FIO_MEMCPY(m->buf, pos, len);
+    pos += len;
+    fio___pubsub_message_is_dirty(m); /* no encrypted copy of the message */
+    m->data.io = io;
+    fio___pubsub_on_message_remote(io, m);
+    fio___pubsub_message_free(m);
+  }
+  if (pos == end)
+    return;
+  FIO_LOG_SECURITY("(%d) pub/sub cluster batch corrupted", fio_io_pid());
+  fio_io_close_now(io);
+}
+
 FIO_SFUNC void fio___pubsub_on_message_remote(fio_io_s *io,
                                               fio___pubsub_message_s *msg) {
+  if (msg->data.is_json == FIO___PUBSUB_BATCH) {
+    fio___pubsub_batch_unpack(io, msg);
+    return;
+  }
   fio___pubsub_message_map_s *map = &FIO___PUBSUB_POSTOFFICE.remote_messages;
   map += !!(msg->data.is_json & FIO___PUBSUB_REPLAY);
   fio___pubsub_message_s *existing = fio___pubsub_message_map_set(map, msg);
@@ -1861,6 +2077,12 @@ FIO_SFUNC void fio___pubsub_protocol_on_data_worker(fio_io_s *io) {
 FIO_SFUNC void fio___pubsub_protocol_on_data_remote(fio_io_s *io) {
   fio___pubsub_message_parse(io, fio___pubsub_on_message_remote);
 }
+FIO_SFUNC void fio___pubsub_protocol_on_ready_remote(fio_io_s *io) {
+  fio___pubsub_message_parser_s *p = fio___pubsub_message_parser(io);
+  if (p && p->throttled &&
+      fio_io_backlog(io) < (FIO_PUBSUB_CLUSTER_BACKLOG_LIMIT >> 1))
+    fio___pubsub_batch_throttle(p, 0);
+}
 
 FIO_SFUNC void fio___pubsub_protocol_on_close(void *p_, void *udata) {
   fio___pubsub_message_parser_s *p = (fio___pubsub_message_parser_s *)p_;
@@ -1877,6 +2099,7 @@ FIO_SFUNC void fio___pubsub_protocol_on_close(void *p_, void *udata) {
         fio___pubsub_broadcast_connected_count(
             &FIO___PUBSUB_POSTOFFICE.remote_uuids));
   }
+  fio___pubsub_batch_throttle(p, 0);
   fio___pubsub_message_parser_destroy(p);
   if (FIO___PUBSUB_POSTOFFICE.crush_on_close) {
     if (fio_io_is_running())
@@ -0,0 +1,541 @@
+/* ************************************************************************* */
+#if !defined(FIO_INCLUDE_FILE) /* Dev test - ignore line */
+#define FIO___DEV___           /* Development inclusion - ignore line */
+#define FIO_RESP3              /* Development inclusion - ignore line */
+#define FIO_ATOL               /* Development inclusion - ignore line */
+#include "./include.h"         /* Development inclusion - ignore line */
+#endif                         /* Development inclusion - ignore line */
+/* *****************************************************************************
+
+
+
+
+                                RESP 3 Parser Module
+
+
+
+
+Copyright and License: see header file (000 copyright.h) or top of file
+***************************************************************************** */
+#if defined(FIO_RESP3) && !defined(FIO___RECURSIVE_INCLUDE) &&                 \
+    !defined(H___FIO_RESP3___H)
+#define H___FIO_RESP3___H
+
+/* *****************************************************************************
+RESP Parser Settings
+***************************************************************************** */
+
+/** The maximum number of nested layers in object responses (2...32,768)*/
+#define FIO_RESP3_MAX_NESTING 32
+
+/** RESP's parser settings – callbacks and object creation. */
+typedef struct {
+  /** The value for NULL */
+  void *set_null;
+  /** The value for TRUE */
+  void *set_true;
+  /** The value for FALSE */
+  void *set_false;
+  /** Should return an object representing the number `i` */
+  void *(*get_number)(int64_t i);
+  /** Should return an object representing the float `f` */
+  void *(*get_float)(double f);
+  /** Should return an object representing the BIG number `i` */
+  void *(*get_bignum)(char *str, size_t len);
+  /** Should return an object representing the String */
+  void *(*get_string)(char *str, size_t len);
+  /** Should return an object representing a dynamic String */
+  void *(*string_start)(size_t soft_expected);
+  /** Should write data to the a dynamic String, perhaps reallocating it */
+  void *(*string_write)(void *dest, char *str, size_t len);
+  /** Should return an object representing a dynamic Array */
+  void *(*array_start)(size_t soft_expected);
+  /** Should push an object to the dynamic Array, perhaps reallocating it */
+  void *(*array_push)(void *array, void *value);
+  /** Should return an object representing a dynamic Map */
+  void *(*map_start)(size_t soft_expected);
+  /** Should push an object to the dynamic Map, perhaps reallocating it */
+  void *(*map_push)(void *map, void *key, void *value);
+  /** Called on object received. returns non-zero on error. */
+  int (*done)(void *udata, void *response);
+  /** Called on error response, NOT on protocol error. */
+  int (*error)(void *udata, void *response);
+  /** Called on out-of-bounds object received. returns non-zero on error. */
+  int (*push)(void *udata, void *response);
+  /** Called after either response callbacks or protocol error. */
+  void (*free_response)(void *obj);
+} fio_resp3_settings_s;
+
+/* *****************************************************************************
+RESP Parser API
+***************************************************************************** */
+
+struct fio___resp3_frame_s {
+  /** Object in Frame */
+  void *obj;
+  /** Object Size */
+  uint32_t size;
+  /** Object Type */
+  uint8_t otype;
+  /** Streaming Object */
+  uint8_t streaming;
+  /** Object is finalized */
+  uint8_t finished;
+};
+
+/* RESP's parser type - do not access directly. */
+typedef struct fio_resp3_s {
+  /** callback settings. */
+  fio_resp3_settings_s settings;
+  void *udata;
+  uint32_t depth;
+  uint8_t perror; /* protocol error flag */
+  struct fio___resp3_frame_s stack[FIO_RESP3_MAX_NESTING];
+} fio_resp3_s;
+
+#define FIO_RESP3_INIT(...)                                                    \
+  (fio_resp3_s) {                                                              \
+    .settings = {__VA_ARGS__}, .private_data = {0}, .udata = NULL              \
+  }
+
+/** Returns an initialized parser. */
+FIO_IFUNC fio_resp3_s fio_resp3_init(fio_resp3_settings_s *settings,
+                                     void *udata);
+/** Initializes the parser. */
+FIO_IFUNC void fio_resp3_init2(fio_resp3_s *dest,
+                               fio_resp3_settings_s *settings,
+                               void *udata);
+
+/** Parse `data`, returning the abount of bytes consumed. */
+FIO_IFUNC size_t fio_resp3_parse(fio_resp3_s *parser);
+
+/* *****************************************************************************
+RESP Implementation - possibly externed functions.
+***************************************************************************** */
+#if defined(FIO_EXTERN_COMPLETE) || !defined(FIO_EXTERN)
+
+/* Single Line Types */
+
+/** The general form is `+<string>\r\n` */
+#define FIO___RESP3_U8_SIMPLE ((unsigned char)'+')
+/** The general form is `-<string>\r\n` */
+#define FIO___RESP3_U8_ERROR ((unsigned char)'-')
+/** Big number `(<big number>\r\n` */
+#define FIO___RESP3_U8_BIGNUM ((unsigned char)'(')
+/** The general form is `:<number>\r\n` */
+#define FIO___RESP3_U8_NUMBER ((unsigned char)':')
+/** Null: `_\r\n` */
+#define FIO___RESP3_U8_NULL ((unsigned char)'_')
+/** Double: ,<floating-point-number>\r\n (inf, inf, nan, -nan) */
+#define FIO___RESP3_U8_FLOAT ((unsigned char)',')
+/** Boolean: `#t\r\n` and `#f\r\n` */
+#define FIO___RESP3_U8_BOOL ((unsigned char)'#')
+
+/* Blob Types */
+
+/** The general form is `$<length>\r\n<bytes>\r\n` */
+#define FIO___RESP3_U8_BLOB ((unsigned char)'$')
+/** Blob error: `!<length>\r\n<bytes>\r\n`.*/
+#define FIO___RESP3_U8_ERROR_BLOB ((unsigned char)'!')
+/** Verbatim string: first 3 bytes are the type `XXX:`,i.e., `txt:`  */
+#define FIO___RESP3_U8_VBLOB ((unsigned char)'=')
+
+/* <aggregate-type-char><numelements><CR><LF> */
+#define FIO___RESP3_U8_ARRAY ((unsigned char)'*')
+#define FIO___RESP3_U8_PUSH  ((unsigned char)'>')
+#define FIO___RESP3_U8_MAP   ((unsigned char)'%')
+#define FIO___RESP3_U8_ATTR  ((unsigned char)'|')
+#define FIO___RESP3_U8_SET   ((unsigned char)'~')
+
+/* Streamed Strings / Arrays / Maps */
+
+#define FIO___RESP3_U8_STR_STREAM_LEN    ((unsigned char)'?')
+#define FIO___RESP3_U8_STR_STREAM_PART   ((unsigned char)';')
+#define FIO___RESP3_U8_ARRAY_STREAM_STOP ((unsigned char)'.')
+
+// Basically the transfer starts with `$?`. We use the same prefix as normal
+// strings, that is `$`, but later instead of the count we use a question mark
+// in order to communicate the client that this is a chunked encoding transfer,
+// and we don't know the final size ye t.
+
+/** RESP3 Hello */
+#define FIO___RESP3_HELLO_STR_BUF "HELLO 3\r\n"
+#define FIO___RESP3_HELLO_STR_LEN (sizeof(FIO___RESP3_HELLO_STR_BUF) - 1)
+
+/* *****************************************************************************
+Validating RESP3 Settings.
+***************************************************************************** */
+
+/* clang-format off */
+static void *fio___resp3_get_number(int64_t i) { (void)i; }
+static void *fio___resp3_get_float(double f) { (void)f; }
+static void *fio___resp3_get_bignum(char *str, size_t len) { (void)str, (void)len; }
+static void *fio___resp3_get_string(char *str, size_t len) { (void)str, (void)len; }
+static void *fio___resp3_str_start(size_t soft_expected) { (void)soft_expected; }
+static void *fio___resp3_str(void *d, char *s, size_t l) { (void)d, (void)s, (void)l; }
+static void *fio___resp3_arr_start(size_t soft_expected) { (void)soft_expected; }
+static void *fio___resp3_arr_push(void *a, void *v) { (void)a, (void)v; }
+static void *fio___resp3_map_start(size_t soft_expected) { (void)soft_expected; }
+static void *fio___resp3_map(void *m, void *k, void *v) { (void)m, (void)k, (void)v; }
+static int fio___resp3_done(void *u, void *r) { (void)u, (void)r; }
+static void fio___resp3_free(void *r) { (void)r; }
+/* clang-format on */
+
+static void fio___resp3_validate_settings(fio_resp3_settings_s *settings) {
+  static const fio_resp3_settings_s defaults = {
+      .set_null = NULL,
+      .set_true = NULL,
+      .set_false = NULL,
+      .get_number = fio___resp3_get_number,
+      .get_float = fio___resp3_get_float,
+      .get_bignum = fio___resp3_get_bignum,
+      .get_string = fio___resp3_get_string,
+      .string_start = fio___resp3_str_start,
+      .string_write = fio___resp3_str,
+      .array_start = fio___resp3_arr_start,
+      .array_push = fio___resp3_arr_push,
+      .map_start = fio___resp3_map_start,
+      .map_push = fio___resp3_map,
+      .done = fio___resp3_done,
+      .error = fio___resp3_done,
+      .push = fio___resp3_done,
+      .free_response = fio___resp3_free,
+  };
+  union {
+    uintptr_t *ptr;
+    fio_resp3_settings_s *s;
+  } src, dest;
+  src.s = (fio_resp3_settings_s *)&defaults;
+  dest.s = settings;
+  for (int i = 0; i < sizeof(fio_resp3_settings_s) / sizeof(uintptr_t); ++i)
+    if (!dest.ptr[i])
+      dest.ptr[i] = src.ptr[i];
+}
+
+/* *****************************************************************************
+RESP3 Initialization
+***************************************************************************** */
+
+/** Returns an initialized parser. */
+FIO_IFUNC fio_resp3_s fio_resp3_init(fio_resp3_settings_s *settings,
+                                     void *udata) {
+  fio_resp3_s r;
+  fio___resp3_validate_settings(settings);
+  r.settings = *settings;
+  r.udata = udata;
+  r.depth = 0;
+  r.stack[0] = (struct fio___resp3_frame_s){0};
+  return r; /* return by value */
+}
+
+/** Initializes the parser. */
+FIO_IFUNC void fio_resp3_init2(fio_resp3_s *dest,
+                               fio_resp3_settings_s *settings,
+                               void *udata) {
+  fio___resp3_validate_settings(settings);
+  dest->settings = *settings;
+  dest->udata = udata;
+  dest->depth = 0;
+  dest->stack[0] = (struct fio___resp3_frame_s){0};
+}
+
+/* *****************************************************************************
+RESP3 Stack Push/Pop
+***************************************************************************** */
+
+static void fio___resp3_stack_destroy(fio_resp3_s *p) {
+  while (p->depth) {
+    size_t i = p->depth--;
+    if (p->stack[i].obj)
+      p->settings.free_response(p->stack[i].obj);
+  }
+  if (p->stack[0].obj)
+    p->settings.free_response(p->stack[0].obj);
+  p->stack[0] = (struct fio___resp3_frame_s){0};
+}
+
+static int fio___resp3_stack_push(fio_resp3_s *p) {
+  size_t i = ++p->depth;
+  if (i == FIO_RESP3_MAX_NESTING)
+    goto error;
+  p->stack[i] = (struct fio___resp3_frame_s){0};
+  return 0;
+error:
+  --p->depth;
+  fio___resp3_stack_destroy(p);
+  return -1;
+}
+
+static int fio___resp3_stack_pop_or_push(fio_resp3_s *p) {
+  size_t v = p->depth;
+  size_t k = p->depth - 1;
+  size_t c = c;
+  /* ignore attributes */
+  if (p->stack[v].otype == FIO___RESP3_U8_ATTR) {
+    p->depth = c;
+    return 0;
+  }
+  /* if the container type is a map, we need another object */
+  switch (p->stack[c].otype) {
+  case FIO___RESP3_U8_MAP:
+    if (p->stack[c].size)
+      return fio___resp3_stack_push(p);
+    /* fall through / ignore? */
+  case FIO___RESP3_U8_ATTR: p->depth = c; return 0;
+  case FIO___RESP3_U8_SET: /* push key=true and  */
+    p->settings.map_push(p->stack[c].obj,
+                         p->stack[v].obj,
+                         p->settings.set_true);
+    p->depth = c;
+    if (--p->stack[c].size)
+      return fio___resp3_stack_push(p) - 1;
+    continue;
+
+  case FIO___RESP3_U8_ARRAY: /* fall through */
+  case FIO___RESP3_U8_PUSH:
+    p->settings.array_push(p->stack[c].obj, p->stack[v].obj);
+    p->depth = c;
+    if (--p->stack[c].size)
+      return fio___resp3_stack_push(p);
+    continue;
+
+  default:
+    /* if `c` (container) isn't a container, it may be a key in a map */
+    c -= !!c;
+    switch (p->stack[c].otype) {
+    case FIO___RESP3_U8_ATTR: /* TODO: FIXME: ignore attributes? */
+      if (p->stack[v].obj)
+        p->settings.free_response(p->stack[v].obj);
+      if (p->stack[k].obj)
+        p->settings.free_response(p->stack[k].obj);
+      break;
+      p->depth = c;
+      if (--p->stack[c].size)
+        return fio___resp3_stack_push(p);
+      continue;
+
+    case FIO___RESP3_U8_MAP:
+      /* push both key and value to map */
+      p->settings.map_push(p->stack[c].obj, p->stack[k].obj, p->stack[v].obj);
+      p->depth = c;
+      if (--p->stack[c].size)
+        return fio___resp3_stack_push(p);
+      continue;
+      break;
+    default: goto error;
+    }
+  }
+error:
+  fio___resp3_stack_destroy(p);
+  return -1;
+}
+
+static int fio___resp3_stack_consume(fio_resp3_s *p) {
+  for (;;) {
+    int pnp = fio___resp3_stack_pop_or_push(p);
+    if (!pnp)
+      continue;
+    return pnp - (pnp == 1);
+  }
+  if (p->depth)
+    return 0;
+
+  /* ignore attributes, as they are not replies */
+  if (p->stack[0].otype == FIO___RESP3_U8_ATTR) {
+    p->stack[0] = (struct fio___resp3_frame_s){0};
+    return 0;
+  }
+  /* call the correct callback by offset (done == 0, err == 1, push == 2) */
+  (&(p->settings.done))[(
+      (uintptr_t)(p->stack[0].otype == FIO___RESP3_U8_ERROR) |
+      (uintptr_t)(p->stack[0].otype == FIO___RESP3_U8_ERROR_BLOB) |
+      ((uintptr_t)(p->stack[0].otype == FIO___RESP3_U8_PUSH) << 1))](
+      p->udata,
+      p->stack[0].obj);
+  /* free memory */
+  p->settings.free_response(p->stack[0].obj);
+  p->stack[0] = (struct fio___resp3_frame_s){0};
+  return 0;
+}
+
+static int fio___resp3_stack_pop(fio_resp3_s *p) {
+  p->depth -= !!p->depth;
+  return fio___resp3_stack_consume(p);
+}
+/* *****************************************************************************
+RESP Implementation - inline functions.
+***************************************************************************** */
+
+FIO_SFUNC size_t fio___resp3_parse_line(fio_resp3_s *p,
+                                        uint8_t *buf,
+                                        size_t len) {
+  uint8_t *const start = buf;
+  uint8_t *eol = (uint8_t *)FIO_MEMCHR(buf, '\n', len);
+  if (!eol)
+    return 0;
+  uint8_t *end = eol - (eol[0 - (eol > buf)] == '\r');
+  ++eol;
+  if (end == buf)
+    goto finished;
+  p->stack[p->depth].otype = buf[0];
+  switch (*buf) {
+  /** The general form is `+<string>\r\n` */
+  case FIO___RESP3_U8_SIMPLE: /* ((unsigned char)'+') */
+  /** The general form is `-<string>\r\n` */
+  case FIO___RESP3_U8_ERROR: /* ((unsigned char)'-') */
+  /** Big number `(<big number>\r\n` */
+  case FIO___RESP3_U8_BIGNUM: /* ((unsigned char)'(') */
+    ++buf;
+    p->stack[p->depth].obj = p->settings.get_string((char *)buf, end - buf);
+    goto finished;
+  /** The general form is `:<number>\r\n` */
+  case FIO___RESP3_U8_NUMBER: /* ((unsigned char)':') */
+    ++buf;
+    p->stack[p->depth].obj = p->settings.get_number(fio_atol((char **)&buf));
+    if (buf[buf[0] == '\r'] != '\n')
+      goto error;
+    goto finished;
+  /** Null: `_\r\n` */
+  case FIO___RESP3_U8_NULL: /* ((unsigned char)'_') */
+    p->stack[p->depth].obj = p->settings.set_null;
+    if (buf[buf[0] == '\r'] != '\n')
+      goto error;
+    goto finished;
+
+  /** Double: ,<floating-point-number>\r\n (inf, inf, nan, -nan) */
+  case FIO___RESP3_U8_FLOAT: /* ((unsigned char)',') */
+    ++buf;
+    p->stack[p->depth].obj = p->settings.get_float(fio_atof((char **)&buf));
+    if (buf[buf[0] == '\r'] != '\n')
+      goto error;
+    goto finished;
+  /** Boolean: `#t\r\n` and `#f\r\n` */
+  case FIO___RESP3_U8_BOOL: /* ((unsigned char)'#') */
+    ++buf;
+    switch ((buf[0] | 32)) {
+    case 't': p->stack[p->depth].obj = p->settings.set_true; break;
+    case 'f': p->stack[p->depth].obj = p->settings.set_false; break;
+    default: goto error;
+    }
+    if (buf[buf[0] == '\r'] != '\n')
+      goto error;
+    goto finished;
+
+  /* Blob Types */
+
+  /** The general form is `$<length>\r\n<bytes>\r\n` */
+  case FIO___RESP3_U8_BLOB: /* ((unsigned char)'$') */ /* fall through */
+  /** Blob error: `!<length>\r\n<bytes>\r\n`.*/
+  case FIO___RESP3_U8_ERROR_BLOB: /* ((unsigned char)'!') */ /* fall through */
+  /** Verbatim string: first 3 bytes are the type `XXX:`,i.e., `txt:`  */
+  case FIO___RESP3_U8_VBLOB: /* ((unsigned char)'=') */
+    p->stack[p->depth].obj = p->settings.string_start;
+
+  case FIO___RESP3_U8_ARRAY: /* ((unsigned char)'*') */ break;
+  case FIO___RESP3_U8_PUSH: /*  ((unsigned char)'>') */ break;
+  case FIO___RESP3_U8_MAP: /*   ((unsigned char)'%') */ break;
+  case FIO___RESP3_U8_ATTR: /*  ((unsigned char)'|') */ break;
+  case FIO___RESP3_U8_SET: /*   ((unsigned char)'~') */ break;
+  }
+
+get_length:
+  if (buf[1] == FIO___RESP3_U8_STR_STREAM_LEN) {
+    p->stack[p->depth].streaming = 1;
+  } else {
+    ++buf;
+    uint64_t l = (uint64_t)fio_atol((char **)buf);
+    if ((l >> 32))
+      goto error;
+    p->stack[p->depth].size = (uint32_t)l;
+    if (buf[buf[0] == '\r'] != '\n')
+      goto error;
+  }
+
+finished:
+  if (fio___resp3_stack_consume(p))
+    goto error;
+  return eol - start;
+push_finished:
+  return eol - start;
+error:
+  return eol - start;
+}
+
+FIO_SFUNC size_t fio___resp3_parse_router(fio_resp3_s *p,
+                                          uint8_t *buf,
+                                          size_t len) {
+  switch (p->stack[p->depth].otype) {
+  case 0: return fio___resp3_parse_line(p, buf, len);
+  }
+}
+
+/** Parse `data`, returning the abount of bytes consumed. */
+FIO_IFUNC size_t fio_resp3_parse(fio_resp3_s *parser,
+                                 uint8_t *buf,
+                                 size_t len) {
+  size_t r = 0, tmp = 0;
+  if (!buf)
+    return r;
+
+  return r;
+}
+
+/* *****************************************************************************
+RESP Single Line Types
+***************************************************************************** */
+
+/* *****************************************************************************
+RESP Parsing @ Root
+***************************************************************************** */
+static size_t fio___resp3_parse_start(fio_resp3_s *parser,
+                                      uint8_t *buf,
+                                      size_t len);
+
+/* *****************************************************************************
+Queue Thoughts
+***************************************************************************** */
+
+typedef union {
+  uint64_t cache_line_size[8];
+  struct {
+    fio_list_node_s node;
+    union {
+      void (*fn1)(void *);
+      void (*fn2)(void *, void *);
+      void (*fn3)(void *, void *, void *);
+      void (*fn4)(void *, void *, void *, void *);
+    };
+    void *argv[4];
+    size_t argc;
+    size_t flags;
+  };
+  struct {
+    fio_list_node_s queue;
+    fio_list_node_s free;
+    struct fio___queue_block_s *next;
+  } head;
+} fio___queue_cache_line_s;
+
+#define FIO_QQUEUE_LINES 64
+typedef struct fio___queue_block_s {
+  fio___queue_cache_line_s line[FIO_QQUEUE_LINES];
+} fio___queue_block_s;
+
+typedef struct {
+  fio___queue_cache_line_s lines[FIO_QQUEUE_LINES];
+} fio_qqueue_s;
+
+FIO_IFUNC void fio_qqueue_init(fio_qqueue_s *q) {
+  q->lines[0].head.free = FIO_LIST_INIT(q->lines[0].head.free);
+  q->lines[0].head.queue = FIO_LIST_INIT(q->lines[0].head.queue);
+  for (int i = 1; i < FIO_QQUEUE_LINES; ++i) {
+    FIO_LIST_PUSH(&q->lines[0].head.free, &q->lines[i].node);
+  }
+}
+
+/* *****************************************************************************
+RESP Cleanup
+***************************************************************************** */
+#endif /* FIO_EXTERN_COMPLETE */
+#undef FIO_RESP3
+#endif /* FIO_RESP */
@@ -86,10 +86,48 @@ HTTP Handle Settings
 #define FIO_HTTP_STATIC_FILE_COMPLETION 1
 #endif
 
+#ifndef FIO_HTTP_STATIC_FILE_CACHE_LIMIT
+/**
+ * Memory limit (in bytes) for the static file cache, 0 disables the cache.
+ *
+ * Small static files are kept in memory together with their pre-compressed
+ * variants and pre-computed header values.
+ *
+ * The cache is opt-in (i.e., `(1UL << 23)`), since cached files are only
+ * tested for changes once every `FIO_HTTP_STATIC_FILE_CACHE_VALIDATE` ms.
+ */
+#define FIO_HTTP_STATIC_FILE_CACHE_LIMIT 0
+#endif
+
+#ifndef FIO_HTTP_STATIC_FILE_CACHE_FILE_MAX
+/** Static files larger than this are never cached (they are streamed). */
+#define FIO_HTTP_STATIC_FILE_CACHE_FILE_MAX (1UL << 16)
+#endif
+
+#ifndef FIO_HTTP_STATIC_FILE_CACHE_VALIDATE
+/** Cached static files are tested for changes (`stat`) once every X ms. */
+#define FIO_HTTP_STATIC_FILE_CACHE_VALIDATE 1000
+#endif
+
 #ifndef FIO_HTTP_LOG_X_REQUEST_START
 #define FIO_HTTP_LOG_X_REQUEST_START 1
 #endif
 
+#ifndef FIO_HTTP_LOG_BUFFER
+/** The default (per thread) access log buffer size in bytes. */
+#define FIO_HTTP_LOG_BUFFER (1UL << 16)
+#endif
+
+#ifndef FIO_HTTP_LOG_INTERVAL
+/** The default interval (in milliseconds) for flushing the access log. */
+#define FIO_HTTP_LOG_INTERVAL 100
+#endif
+
+#ifndef FIO_HTTP_MULTIPART_HEADER_LIMIT
+/** The maximum length (in bytes) for the headers of a single multipart part. */
+#define FIO_HTTP_MULTIPART_HEADER_LIMIT 4096
+#endif
+
 #ifndef FIO_HTTP_ENFORCE_LOWERCASE_HEADERS
 /** If true, the HTTP handle will copy input header names to lower case. */
 #define FIO_HTTP_ENFORCE_LOWERCASE_HEADERS 0
@@ -287,8 +325,13 @@ SFUNC fio_str_info_s fio_http_body_read_until(fio_http_s *,
 /** Allocates a body (payload) of (at least) the `expected_length`. */
 SFUNC void fio_http_body_expect(fio_http_s *, size_t expected_length);
 
-/** Writes `data` to the body (payload) associated with the HTTP handle. */
-SFUNC void fio_http_body_write(fio_http_s *, const void *data, size_t len);
+/**
+ * Writes `data` to the body (payload) associated with the HTTP handle.
+ *
+ * Returns -1 if the body is streamed (see `fio_http_body_multipart`) and the
+ * parser failed. Otherwise returns 0.
+ */
+SFUNC int fio_http_body_write(fio_http_s *, const void *data, size_t len);
 
 /**
  * If the body is stored in a temporary file, returns the file's handle.
@@ -565,9 +608,134 @@ SFUNC int fio_http_mimetype_register(char *file_ext,
 SFUNC fio_str_info_s fio_http_mimetype(char *file_ext, size_t file_ext_len);
 
 /* *****************************************************************************
-HTTP Body Parsing Helpers (TODO!)
+HTTP Body Parsing Helpers
 ***************************************************************************** */
 
+/** The type used by the `FIO_HTTP_URLENCODED_EACH` iterator macro. */
+typedef struct {
+  /** The name of the current `name=value` pair (still URL encoded). */
+  fio_str_info_s name;
+  /** The value of the current `name=value` pair (still URL encoded). */
+  fio_str_info_s value;
+  fio_str_info_s private___;
+} fio_http_urlencoded_each_s;
+
+/** A helper function for the `FIO_HTTP_URLENCODED_EACH` macro. */
+FIO_IFUNC fio_http_urlencoded_each_s
+fio_http_urlencoded_each_next(fio_http_urlencoded_each_s);
+
+/**
+ * Iterates over the `name=value` pairs of a query string or a
+ * `application/x-www-form-urlencoded` body, skipping empty pairs.
+ *
+ * Names and values are slices of the original data (no copies are made) and
+ * are NOT decoded (see `fio_string_write_url_dec`).
+ *
+ * i.e.: `FIO_HTTP_URLENCODED_EACH(fio_http_query(h), i) { ... i.name ... }`
+ */
+#define FIO_HTTP_URLENCODED_EACH(data, i)                                      \
+  for (fio_http_urlencoded_each_s i = fio_http_urlencoded_each_next(           \
+           (fio_http_urlencoded_each_s){.private___ = (data)});                \
+       i.name.buf;                                                             \
+       i = fio_http_urlencoded_each_next(i))
+
+/** The multipart (`multipart/form-data`) streaming parser type. */
+typedef struct fio_http_multipart_s fio_http_multipart_s;
+
+/** A single part of a multipart body, as passed to the parser's callbacks. */
+typedef struct {
+  /** The form field's name (valid until the part ends). */
+  fio_str_info_s name;
+  /** The uploaded file's name, if any (valid until the part ends). */
+  fio_str_info_s filename;
+  /** The part's content type, if any (valid until the part ends). */
+  fio_str_info_s content_type;
+  /**
+   * If set by `on_part` to a valid file descriptor, the part's data is written
+   * to the file (and `on_data` isn't called). The parser never closes `fd`.
+   */
+  int fd;
+  /** The number of data bytes received for this part so far. */
+  size_t len;
+  /** Set if the part was cut short (on errors or when the parser is freed). */
+  int error;
+  /** The parser's opaque user data (see `fio_http_multipart_settings_s`). */
+  void *udata;
+} fio_http_multipart_part_s;
+
+/**
+ * Multipart parser settings. Callbacks return non-zero to stop the parser
+ * (the parser then reports an error).
+ */
+typedef struct {
+  /** Called once a part's headers were parsed, before any of its data. */
+  int (*on_part)(fio_http_multipart_part_s *part);
+  /** Called for each slice of the part's data (unless `part->fd` was set). */
+  int (*on_data)(fio_http_multipart_part_s *part, fio_buf_info_s data);
+  /**
+   * Called when a part ends (i.e., to close `part->fd`), also when the part is
+   * cut short by an error or by freeing the parser (`part->error` is set).
+   */
+  int (*on_part_end)(fio_http_multipart_part_s *part);
+  /** Opaque user data, available as `part->udata`. */
+  void *udata;
+} fio_http_multipart_settings_s;
+
+/**
+ * Creates a new multipart parser for the `content_type` header value.
+ *
+ * Returns NULL if the content type isn't `multipart/form-data` (or if the
+ * `boundary` is missing or invalid).
+ */
+SFUNC fio_http_multipart_s *fio_http_multipart_new(
+    fio_str_info_s content_type,
+    fio_http_multipart_settings_s settings);
+/** Creates a new multipart parser for the `content_type` header value. */
+#define fio_http_multipart_new(content_type, ...)                              \
+  fio_http_multipart_new((content_type),                                       \
+                         (fio_http_multipart_settings_s){__VA_ARGS__})
+
+/** Frees a multipart parser. */
+SFUNC void fio_http_multipart_free(fio_http_multipart_s *p);
+
+/**
+ * Parses the next chunk of a multipart body, calling the parser's callbacks.
+ *
+ * Chunks may be of any size (part headers and boundaries may be split between
+ * chunks). Part data is passed to the callbacks without being copied.
+ *
+ * Returns 0 on success or -1 on error (once an error occurred, all following
+ * calls fail).
+ */
+SFUNC int fio_http_multipart_parse(fio_http_multipart_s *p, fio_buf_info_s buf);
+
+/**
+ * Returns 1 once the closing boundary was parsed, -1 if an error occurred and
+ * 0 otherwise.
+ */
+SFUNC int fio_http_multipart_is_finished(fio_http_multipart_s *p);
+
+/**
+ * Streams the body (payload) through a new multipart parser, instead of
+ * storing the body, and returns the parser (owned by the HTTP handle).
+ *
+ * This should be called before the body is received (i.e., in the HTTP
+ * server's `pre_http_body` callback), so large uploads are never buffered.
+ * Data received earlier is parsed first and then released.
+ *
+ * Once the parser is attached, `fio_http_body_length` still reports the body's
+ * length, but there's nothing left to read using `fio_http_body_read`.
+ *
+ * Returns NULL if the body isn't `multipart/form-data` or a parser was already
+ * attached.
+ */
+SFUNC fio_http_multipart_s *fio_http_body_multipart(
+    fio_http_s *h,
+    fio_http_multipart_settings_s settings);
+/** Streams the body through a new multipart parser (see above). */
+#define fio_http_body_multipart(h, ...)                                        \
+  fio_http_body_multipart((h), (fio_http_multipart_settings_s){__VA_ARGS__})
+
 /* *****************************************************************************
 Header Parsing Helpers
 ***************************************************************************** */
@@ -691,7 +859,7 @@ SFUNC int fio_http_static_file_response(fio_http_s *h,
 /** Returns a human readable string related to the HTTP status number. */
 SFUNC fio_str_info_s fio_http_status2str(size_t status);
 
-/** Logs an HTTP (response) to STDOUT. */
+/** Logs an HTTP (response) using the access log sink (defaults to STDOUT). */
 SFUNC void fio_http_write_log(fio_http_s *h);
 
 /**
@@ -710,6 +878,58 @@ SFUNC fio_str_info_s fio_http_date(uint64_t now_in_seconds);
 
 /* date/time string caching for HTTP logging */
 SFUNC fio_str_info_s fio_http_log_time(uint64_t now_in_seconds);
+/* *****************************************************************************
+Access Log Sink
+***************************************************************************** */
+
+/**
+ * The access log sink settings.
+ *
+ * Log lines are collected in per-thread buffers (without locking) and written
+ * in batches by a dedicated logging thread, so the thread serving the request
+ * never waits for the log's target (unless `block` is set).
+ */
+typedef struct {
+  /** The file descriptor to write to (0 == STDOUT). */
+  int fd;
+  /** A file to append log lines to (overrides `fd`). */
+  const char *filename;
+  /** A callback for log batches, called by the logging thread (overrides). */
+  void (*on_write)(fio_str_info_s lines, void *udata);
+  /** Opaque user data for the `on_write` callback. */
+  void *udata;
+  /** Per-thread buffer size in bytes (defaults to `FIO_HTTP_LOG_BUFFER`). */
+  size_t buffer;
+  /** Flush interval in milliseconds (defaults to `FIO_HTTP_LOG_INTERVAL`). */
+  size_t interval;
+  /** A signal that reopens `filename` (log rotation), requires `FIO_SIGNAL`. */
+  int reopen_signal;
+  /** If set, wait for buffer space when full (the default drops log lines). */
+  uint8_t block;
+  /** If set, log lines are written as JSON objects (one object per line). */
+  uint8_t json;
+} fio_http_log_sink_args_s;
+
+/**
+ * Sets the access log sink, flushing any log lines buffered for the previous
+ * sink.
+ *
+ * Should be called before logging begins (i.e., before the server starts), as
+ * buffer size changes only apply to threads that haven't logged yet.
+ */
+SFUNC void fio_http_log_sink(fio_http_log_sink_args_s args);
+#define fio_http_log_sink(...)                                                 \
+  fio_http_log_sink((fio_http_log_sink_args_s){__VA_ARGS__})
+
+/** Writes all buffered log lines to the log sink (blocking). */
+SFUNC void fio_http_log_flush(void);
+
+/** Reopens the log file (log rotation). Safe to call from a signal handler. */
+SFUNC void fio_http_log_reopen(void);
+
+/** Returns the number of log lines dropped due to full buffers. */
+SFUNC size_t fio_http_log_dropped(void);
+
 /* *****************************************************************************
 The HTTP Controller
 ***************************************************************************** */
@@ -778,6 +998,38 @@ All memory allocations should use:
 
 */
 
+/* *****************************************************************************
+Body Parsing Helpers - inlined helpers
+***************************************************************************** */
+
+/** A helper function for the `FIO_HTTP_URLENCODED_EACH` macro. */
+FIO_IFUNC fio_http_urlencoded_each_s
+fio_http_urlencoded_each_next(fio_http_urlencoded_each_s i) {
+  char *amp, *equ;
+  do {
+    i.name = i.private___;
+    if (!i.name.buf || !i.name.len)
+      return (fio_http_urlencoded_each_s){0};
+    amp = (char *)FIO_MEMCHR(i.name.buf, '&', i.name.len);
+    if (amp) {
+      i.name.len = amp - i.name.buf;
+      i.private___.len -= i.name.len + 1;
+      i.private___.buf += i.name.len + 1;
+    } else {
+      i.private___ = FIO_STR_INFO0;
+    }
+  } while (!i.name.len); /* skip empty pairs (i.e., `"a=1&&b=2"`) */
+  equ = (char *)FIO_MEMCHR(i.name.buf, '=', i.name.len);
+  if (equ) {
+    i.value.buf = equ + 1;
+    i.value.len = (i.name.buf + i.name.len) - i.value.buf;
+    i.name.len = equ - i.name.buf;
+  } else {
+    i.value = FIO_STR_INFO2(i.name.buf + i.name.len, 0);
+  }
+  return i;
+}
+
 /* *****************************************************************************
 Header Parsing Helpers - inlined helpers
 ***************************************************************************** */
@@ -1463,6 +1715,7 @@ struct fio_http_s {
     size_t len;
     size_t pos;
     int fd;
+    fio_http_multipart_s *multipart; /* streaming body parser (if any) */
   } body;
 };
 
@@ -1493,6 +1746,7 @@ SFUNC fio_http_s *fio_http_destroy(fio_http_s *h) {
   fio_bstr_free(h->body.buf);
   if (h->body.fd != -1)
     close(h->body.fd);
+  fio_http_multipart_free(h->body.multipart);
   FIO_REF_INIT(*h);
   return h;
 }
@@ -1510,9 +1764,11 @@ SFUNC fio_http_s *fio_http_clear_response(fio_http_s *h, bool clear_body) {
   fio_bstr_free(h->body.buf);
   if (h->body.fd != -1)
     close(h->body.fd);
+  fio_http_multipart_free(h->body.multipart);
   h->body.buf = NULL;
   h->body.len = h->body.pos = 0;
   h->body.fd = -1;
+  h->body.multipart = NULL;
   return h;
 }
 
@@ -2320,16 +2576,24 @@ SFUNC fio_str_info_s fio_http_body_read_until(fio_http_s *h,
 
 /** Allocates a body (payload) of (at least) the `expected_length`. */
 SFUNC void fio_http_body_expect(fio_http_s *h, size_t expected_length) {
+  if (h->body.multipart)
+    return;
   ((h->body.fd == -1) ? fio___http_body_expect_buf
                       : fio___http_body_expect_fd)(h, expected_length);
 }
 
 /** Writes `data` to the body (payload) associated with the HTTP handle. */
-SFUNC void fio_http_body_write(fio_http_s *h, const void *data, size_t len) {
+SFUNC int fio_http_body_write(fio_http_s *h, const void *data, size_t len) {
   if (!data || !len)
-    return;
+    return 0;
+  if (h->body.multipart) { /* streamed, the body isn't stored */
+    h->body.pos = (h->body.len += len);
+    return fio_http_multipart_parse(h->body.multipart,
+                                    FIO_BUF_INFO2((char *)data, len));
+  }
   ((h->body.fd == -1) ? fio___http_body_write_buf
                       : fio___http_body_write_fd)(h, data, len);
+  return 0;
 }
 
 /* *****************************************************************************
@@ -2887,6 +3151,349 @@ SFUNC int fio_http_send_error_response(fio_http_s *h, size_t status) {
   return 0;
 }
 
+/* *****************************************************************************
+Access Log Sink - Implementation
+***************************************************************************** */
+
+FIO_LEAK_COUNTER_DEF(http___log_buffer)
+
+/* a per-thread log buffer (ring), written by one thread and read by another. */
+typedef struct fio___http_log_ring_s {
+  struct fio___http_log_ring_s *next;
+  /* advanced only by the thread that owns the ring (writing log lines) */
+  size_t head;
+  /* advanced only while flushing (under the flush lock) */
+  size_t tail;
+  size_t mask;
+  char buf[];
+} fio___http_log_ring_s;
+
+static struct {
+  fio_http_log_sink_args_s args;
+  fio___http_log_ring_s *rings;
+  char *batch;
+  size_t batch_capa;
+  size_t dropped;
+  size_t dropped_reported;
+  fio_thread_t thread;
+  fio_thread_mutex_t lock;
+  fio_thread_cond_t cond;
+  fio_lock_i rings_lock;
+  fio_lock_i flush_lock;
+  int fd;
+  volatile uint8_t running; /* 0 == stopped, 1 == running, 2 == stopping */
+  volatile uint8_t reopen;
+} FIO___HTTP_LOG = {
+    .args = {.buffer = FIO_HTTP_LOG_BUFFER, .interval = FIO_HTTP_LOG_INTERVAL},
+    .fd = -1,
+};
+
+static __thread fio___http_log_ring_s *fio___http_log_ring;
+
+/* writes a batch of log data to the sink's target (call under flush lock). */
+FIO_SFUNC void fio___http_log_output(char *buf, size_t len) {
+  if (FIO___HTTP_LOG.args.on_write) {
+    FIO___HTTP_LOG.args.on_write(FIO_STR_INFO2(buf, len),
+                                 FIO___HTTP_LOG.args.udata);
+    return;
+  }
+  if (FIO___HTTP_LOG.fd == -1) {
+    fwrite(buf, 1, len, stdout);
+    fflush(stdout);
+    return;
+  }
+  if (fio_fd_write(FIO___HTTP_LOG.fd, buf, len) != (ssize_t)len)
+    FIO_LOG_DEBUG2("(%d) HTTP access log write error", fio_getpid());
+}
+
+/* reopens the log file (log rotation), call under flush lock. */
+FIO_SFUNC void fio___http_log_reopen_file(void) {
+  int fd;
+  FIO___HTTP_LOG.reopen = 0;
+  if (!FIO___HTTP_LOG.args.filename)
+    return;
+  fd = fio_filename_open(FIO___HTTP_LOG.args.filename,
+                         O_APPEND | O_CREAT | O_WRONLY);
+  if (fd == -1) {
+    FIO_LOG_ERROR("(%d) couldn't reopen HTTP access log file: %s",
+                  fio_getpid(),
+                  FIO___HTTP_LOG.args.filename);
+    return;
+  }
+  if (FIO___HTTP_LOG.fd != -1)
+    close(FIO___HTTP_LOG.fd);
+  FIO___HTTP_LOG.fd = fd;
+}
+
+/* writes all buffered log lines to the sink's target. */
+FIO_SFUNC void fio___http_log_flush_rings(void) {
+  fio___http_log_ring_s *r;
+  size_t dropped;
+  fio_lock(&FIO___HTTP_LOG.flush_lock);
+  if (FIO___HTTP_LOG.reopen)
+    fio___http_log_reopen_file();
+  fio_lock(&FIO___HTTP_LOG.rings_lock); /* new rings are added at the head */
+  r = FIO___HTTP_LOG.rings;
+  fio_unlock(&FIO___HTTP_LOG.rings_lock);
+  for (; r; r = r->next) {
+    size_t head, start, len;
+    fio_atomic_load(head, &r->head);
+    if (head == r->tail)
+      continue;
+    start = r->tail & r->mask;
+    len = head - r->tail;
+    if (start + len <= r->mask + 1) {
+      fio___http_log_output(r->buf + start, len);
+    } else { /* wrapped around the ring, copy to a continuous batch */
+      const size_t part = r->mask + 1 - start;
+      if (FIO___HTTP_LOG.batch_capa < len) {
+        char *tmp = (char *)FIO_MEM_REALLOC_(FIO___HTTP_LOG.batch,
+                                             FIO___HTTP_LOG.batch_capa,
+                                             r->mask + 1,
+                                             0);
+        if (!tmp)
+          goto skip_ring; /* lines are lost, but the ring must be freed */
+        FIO___HTTP_LOG.batch = tmp;
+        FIO___HTTP_LOG.batch_capa = r->mask + 1;
+      }
+      FIO_MEMCPY(FIO___HTTP_LOG.batch, r->buf + start, part);
+      FIO_MEMCPY(FIO___HTTP_LOG.batch + part, r->buf, len - part);
+      fio___http_log_output(FIO___HTTP_LOG.batch, len);
+    }
+  skip_ring:
+    fio_atomic_exchange(&r->tail, head);
+  }
+  fio_atomic_load(dropped, &FIO___HTTP_LOG.dropped);
+  if (dropped != FIO___HTTP_LOG.dropped_reported) {
+    FIO_LOG_WARNING("(%d) HTTP access log buffer full, %zu log lines dropped.",
+                    fio_getpid(),
+                    dropped - FIO___HTTP_LOG.dropped_reported);
+    FIO___HTTP_LOG.dropped_reported = dropped;
+  }
+  fio_unlock(&FIO___HTTP_LOG.flush_lock);
+}
+
+/* the logging thread - flushes the log buffers every interval. */
+FIO_SFUNC void *fio___http_log_thread(void *ignr_) {
+  (void)ignr_;
+  fio_thread_mutex_lock(&FIO___HTTP_LOG.lock);
+  while (FIO___HTTP_LOG.running == 1) {
+    fio_thread_cond_timedwait(&FIO___HTTP_LOG.cond,
+                              &FIO___HTTP_LOG.lock,
+                              FIO___HTTP_LOG.args.interval);
+    fio_thread_mutex_unlock(&FIO___HTTP_LOG.lock);
+    fio___http_log_flush_rings();
+    fio_thread_mutex_lock(&FIO___HTTP_LOG.lock);
+  }
+  fio_thread_mutex_unlock(&FIO___HTTP_LOG.lock);
+  fio___http_log_flush_rings();
+  return NULL;
+}
+
+/* starts the logging thread if it isn't running, returns -1 if unavailable. */
+FIO_SFUNC int fio___http_log_start(void) {
+  int r = 0;
+  fio_thread_mutex_lock(&FIO___HTTP_LOG.lock);
+  if (!FIO___HTTP_LOG.running) {
+    FIO___HTTP_LOG.running = 1;
+    if (fio_thread_create(&FIO___HTTP_LOG.thread, fio___http_log_thread, NULL))
+      FIO___HTTP_LOG.running = 0;
+  }
+  r = 0 - (FIO___HTTP_LOG.running != 1);
+  fio_thread_mutex_unlock(&FIO___HTTP_LOG.lock);
+  return r;
+}
+
+/* stops the logging thread (flushing the log buffers). */
+FIO_SFUNC void fio___http_log_stop(void) {
+  fio_thread_mutex_lock(&FIO___HTTP_LOG.lock);
+  if (FIO___HTTP_LOG.running != 1) {
+    fio_thread_mutex_unlock(&FIO___HTTP_LOG.lock);
+    return;
+  }
+  FIO___HTTP_LOG.running = 2;
+  fio_thread_cond_signal(&FIO___HTTP_LOG.cond);
+  fio_thread_mutex_unlock(&FIO___HTTP_LOG.lock);
+  fio_thread_join(&FIO___HTTP_LOG.thread);
+  fio_thread_mutex_lock(&FIO___HTTP_LOG.lock);
+  FIO___HTTP_LOG.running = 0;
+  fio_thread_mutex_unlock(&FIO___HTTP_LOG.lock);
+}
+
+/* allocates and registers the calling thread's log buffer. */
+FIO_SFUNC fio___http_log_ring_s *fio___http_log_ring_new(void) {
+  fio___http_log_ring_s *r;
+  size_t capa = 4096;
+  while (capa < FIO___HTTP_LOG.args.buffer)
+    capa <<= 1;
+  r = (fio___http_log_ring_s *)FIO_MEM_REALLOC_(NULL, 0, sizeof(*r) + capa, 0);
+  if (!r)
+    return r;
+  FIO_LEAK_COUNTER_ON_ALLOC(http___log_buffer);
+  *r = (fio___http_log_ring_s){.mask = capa - 1};
+  fio_lock(&FIO___HTTP_LOG.rings_lock);
+  r->next = FIO___HTTP_LOG.rings;
+  FIO___HTTP_LOG.rings = r;
+  fio_unlock(&FIO___HTTP_LOG.rings_lock);
+  return (fio___http_log_ring = r);
+}
+
+/* pushes a log line to the calling thread's log buffer. */
+FIO_SFUNC void fio___http_log_write(char *buf, size_t len) {
+  fio___http_log_ring_s *r = fio___http_log_ring;
+  size_t head, tail, pos;
+  if (FIO_UNLIKELY(FIO___HTTP_LOG.running != 1) && fio___http_log_start())
+    goto write_now;
+  if (FIO_UNLIKELY(!r) && !(r = fio___http_log_ring_new()))
+    goto write_now;
+  if (FIO_UNLIKELY(len > r->mask))
+    goto write_now;
+  head = r->head;
+  for (;;) {
+    fio_atomic_load(tail, &r->tail);
+    if (head - tail + len <= r->mask + 1)
+      break;
+    if (!FIO___HTTP_LOG.args.block) {
+      fio_atomic_add(&FIO___HTTP_LOG.dropped, 1);
+      return;
+    }
+    fio_thread_cond_signal(&FIO___HTTP_LOG.cond);
+    fio_thread_yield();
+  }
+  pos = head & r->mask;
+  if (pos + len <= r->mask + 1) {
+    FIO_MEMCPY(r->buf + pos, buf, len);
+  } else {
+    const size_t part = r->mask + 1 - pos;
+    FIO_MEMCPY(r->buf + pos, buf, part);
+    FIO_MEMCPY(r->buf, buf + part, len - part);
+  }
+  fio_atomic_exchange(&r->head, head + len);
+  /* wake the logging thread early if the buffer is more than half full */
+  if (FIO_UNLIKELY(((head - tail) <= (r->mask >> 1)) &&
+                   ((head + len - tail) > (r->mask >> 1))))
+    fio_thread_cond_signal(&FIO___HTTP_LOG.cond);
+  return;
+
+write_now: /* no log buffer / logging thread, write synchronously */
+  fio_lock(&FIO___HTTP_LOG.flush_lock);
+  fio___http_log_output(buf, len);
+  fio_unlock(&FIO___HTTP_LOG.flush_lock);
+}
+
+/* called when the log rotation signal is received. */
+FIO_SFUNC void fio___http_log_on_signal(int sig, void *udata) {
+  fio_http_log_reopen();
+  (void)sig, (void)udata;
+}
+
+/* Sets the access log sink, flushing lines buffered for the previous sink. */
+SFUNC void fio_http_log_sink FIO_NOOP(fio_http_log_sink_args_s args) {
+  int fd = -1;
+  if (!args.buffer)
+    args.buffer = FIO_HTTP_LOG_BUFFER;
+  if (!args.interval)
+    args.interval = FIO_HTTP_LOG_INTERVAL;
+  if (args.on_write)
+    args.filename = NULL;
+  if (args.filename) {
+    fd = fio_filename_open(args.filename, O_APPEND | O_CREAT | O_WRONLY);
+    if (fd == -1) {
+      FIO_LOG_ERROR("(%d) couldn't open HTTP access log file: %s",
+                    fio_getpid(),
+                    args.filename);
+      args.filename = NULL;
+    } else
+      args.filename =
+          fio_bstr_write(NULL, args.filename, strlen(args.filename));
+  } else if (!args.on_write && args.fd > 0)
+    fd = args.fd;
+  fio___http_log_stop(); /* flushes to the previous target */
+  fio_lock(&FIO___HTTP_LOG.flush_lock);
+  if (FIO___HTTP_LOG.args.filename) {
+    fio_bstr_free((char *)FIO___HTTP_LOG.args.filename);
+    close(FIO___HTTP_LOG.fd);
+  }
+  FIO___HTTP_LOG.args = args;
+  FIO___HTTP_LOG.fd = fd;
+  FIO___HTTP_LOG.reopen = 0;
+  fio_unlock(&FIO___HTTP_LOG.flush_lock);
+#ifdef H___FIO_SIGNAL___H
+  if (args.reopen_signal)
+    fio_signal_monitor(.sig = args.reopen_signal,
+                       .callback = fio___http_log_on_signal,
+                       .immediate = 1);
+#else
+  if (args.reopen_signal)
+    FIO_LOG_ERROR("HTTP access log `reopen_signal` requires FIO_SIGNAL.");
+  (void)fio___http_log_on_signal;
+#endif
+}
+
+/* Writes all buffered log lines to the log sink (blocking). */
+SFUNC void fio_http_log_flush(void) { fio___http_log_flush_rings(); }
+
+/* Reopens the log file (log rotation). Safe to call from a signal handler. */
+SFUNC void fio_http_log_reopen(void) {
+  FIO___HTTP_LOG.reopen = 1; /* the file is reopened by the next flush */
+}
+
+/* Returns the number of log lines dropped due to full buffers. */
+SFUNC size_t fio_http_log_dropped(void) {
+  size_t r;
+  fio_atomic_load(r, &FIO___HTTP_LOG.dropped);
+  return r;
+}
+
+/* the logging thread isn't inherited - buffered lines are the parent's */
+FIO_SFUNC void fio___http_log_on_fork(void *ignr_) {
+  fio___http_log_ring_s *r = FIO___HTTP_LOG.rings;
+  (void)ignr_;
+  fio_thread_mutex_init(&FIO___HTTP_LOG.lock);
+  fio_thread_cond_init(&FIO___HTTP_LOG.cond);
+  FIO___HTTP_LOG.rings_lock = FIO_LOCK_INIT;
+  FIO___HTTP_LOG.flush_lock = FIO_LOCK_INIT;
+  FIO___HTTP_LOG.running = 0;
+  for (; r; r = r->next)
+    r->tail = r->head;
+}
+
+FIO_SFUNC void fio___http_log_init(void) {
+  fio_thread_mutex_init(&FIO___HTTP_LOG.lock);
+  fio_thread_cond_init(&FIO___HTTP_LOG.cond);
+  fio_state_callback_add(FIO_CALL_IN_CHILD, fio___http_log_on_fork, NULL);
+}
+
+/* stops the logging thread, flushes and frees the log buffers. */
+FIO_SFUNC void fio___http_log_destroy(void) {
+  fio___http_log_ring_s *r;
+  fio___http_log_stop();
+  fio___http_log_flush_rings();
+  fio_lock(&FIO___HTTP_LOG.rings_lock);
+  r = FIO___HTTP_LOG.rings;
+  FIO___HTTP_LOG.rings = NULL;
+  fio___http_log_ring = NULL;
+  fio_unlock(&FIO___HTTP_LOG.rings_lock);
+  while (r) {
+    fio___http_log_ring_s *tmp = r;
+    r = r->next;
+    FIO_LEAK_COUNTER_ON_FREE(http___log_buffer);
+    FIO_MEM_FREE_(tmp, sizeof(*tmp) + tmp->mask + 1);
+  }
+  FIO_MEM_FREE_(FIO___HTTP_LOG.batch, FIO___HTTP_LOG.batch_capa);
+  FIO___HTTP_LOG.batch = NULL;
+  FIO___HTTP_LOG.batch_capa = 0;
+  if (FIO___HTTP_LOG.args.filename) {
+    fio_bstr_free((char *)FIO___HTTP_LOG.args.filename);
+    FIO___HTTP_LOG.args.filename = NULL;
+    close(FIO___HTTP_LOG.fd);
+  }
+  FIO___HTTP_LOG.fd = -1;
+  FIO___HTTP_LOG.running = 2; /* any later log lines are written immediately */
+  fio_thread_cond_destroy(&FIO___HTTP_LOG.cond);
+  fio_thread_mutex_destroy(&FIO___HTTP_LOG.lock);
+}
+
 /* *****************************************************************************
 HTTP Logging
 ***************************************************************************** */
@@ -2919,13 +3526,96 @@ rewrite:
   last_pid = pid;
   goto copy;
 }
-/** Logs an HTTP (response) to STDOUT. */
+/* writes a JSON escaped string value, limiting the raw data length. */
+FIO_SFUNC void fio___http_log_json_str(fio_str_info_s *dest,
+                                       const char *name,
+                                       fio_str_info_s value,
+                                       size_t limit) {
+  if (value.len > limit)
+    value.len = limit;
+  fio_string_write(dest, NULL, name, strlen(name));
+  fio_string_write_escape(dest, NULL, value.buf, value.len);
+  fio_string_write(dest, NULL, "\"", 1);
+}
+
+/* Logs an HTTP (response) using the access log sink, formatted as JSON. */
+FIO_SFUNC void fio___http_write_log_json(fio_http_s *h, uint64_t time_end) {
+  FIO_STR_INFO_TMP_VAR(buf, 2047);
+  FIO_STR_INFO_TMP_VAR(from, 127);
+  char date[64];
+  uint64_t time_start = h->received_at, time_proxy = 0;
+  fio_http_from(&from, h);
+  if (FIO_HTTP_LOG_X_REQUEST_START) {
+    /* log request wait time using x-request-start header */
+    fio_str_info_s xstart =
+        fio_http_request_header(h,
+                                FIO_STR_INFO2((char *)"x-request-start", 15),
+                                0);
+    unsigned step =
+        (xstart.len > 1 && (xstart.buf[0] | 32) == 't' && xstart.buf[1] == '=');
+    step <<= 1;
+    xstart.buf += step;
+    xstart.len -= step;
+    time_proxy = fio_atol(&xstart.buf);
+    time_proxy *= (FIO___HTTP_TIME_DIV / 1000); /* assumes info in ms */
+    time_proxy = time_start - time_proxy;
+    if (time_proxy >= (512 * FIO___HTTP_TIME_DIV)) /* wasn't ms? */
+      time_proxy = 0;
+  }
+  fio_string_write2(
+      &buf,
+      NULL,
+      FIO_STRING_WRITE_STR2("{\"pid\":", 7),
+      FIO_STRING_WRITE_NUM(fio_thread_getpid()),
+      FIO_STRING_WRITE_STR2(",\"time\":\"", 9),
+      FIO_STRING_WRITE_STR2(
+          date,
+          fio_time2iso(date, (time_t)(time_end / FIO___HTTP_TIME_DIV))),
+      FIO_STRING_WRITE_STR2("\"", 1));
+  fio___http_log_json_str(&buf, ",\"from\":\"", from, 127);
+  fio___http_log_json_str(&buf,
+                          ",\"method\":\"",
+                          fio_keystr_info(&h->method),
+                          64);
+  fio___http_log_json_str(&buf,
+                          ",\"path\":\"",
+                          fio_keystr_info(&h->path),
+                          256);
+  fio___http_log_json_str(&buf,
+                          ",\"version\":\"",
+                          fio_keystr_info(&h->version),
+                          32);
+  fio_string_write2(
+      &buf,
+      NULL,
+      FIO_STRING_WRITE_STR2(",\"status\":", 10),
+      FIO_STRING_WRITE_NUM(h->status),
+      FIO_STRING_WRITE_STR2(",\"bytes\":", 9),
+      FIO_STRING_WRITE_NUM((h->sent > 0 ? (int64_t)h->sent : 0)),
+      FIO_STRING_WRITE_STR1(",\"duration_" FIO___HTTP_TIME_UNIT "\":"),
+      FIO_STRING_WRITE_NUM(time_end - time_start));
+  if (time_proxy)
+    fio_string_write2(
+        &buf,
+        NULL,
+        FIO_STRING_WRITE_STR1(",\"wait_" FIO___HTTP_TIME_UNIT "\":"),
+        FIO_STRING_WRITE_NUM(time_proxy));
+  fio_string_write(&buf, NULL, "}\n", 2);
+  fio___http_log_write(buf.buf, buf.len);
+  h->received_at = time_end;
+}
+
+/** Logs an HTTP (response) using the access log sink. */
 SFUNC void fio_http_write_log(fio_http_s *h) {
   FIO_STR_INFO_TMP_VAR(buf, 1023);
   intptr_t bytes_sent = h->sent;
   uint64_t time_start, time_end, time_proxy = 0;
   time_start = h->received_at;
   time_end = fio_http_get_timestump();
+  if (FIO___HTTP_LOG.args.json) {
+    fio___http_write_log_json(h, time_end);
+    return;
+  }
   fio_str_info_s date = fio_http_log_time(time_end / FIO___HTTP_TIME_DIV);
   fio_string_write_s to_write[16] = {
       FIO_STRING_WRITE_STR_INFO(fio_keystr_info(&h->method)),
@@ -2981,8 +3671,8 @@ SFUNC void fio_http_write_log(fio_http_s *h) {
   if (buf.buf[buf.len - 1] != '\n')
     buf.buf[buf.len++] = '\n'; /* log was truncated, data too long */
 
-  /* Write log line to STDOUT */
-  fwrite(buf.buf, 1, buf.len, stdout);
+  /* Write log line to the log sink */
+  fio___http_log_write(buf.buf, buf.len);
   h->received_at = time_end;
 }
 
@@ -3011,11 +3701,16 @@ SFUNC int fio_http_etag_is_match(fio_http_s *h) {
                            0);
   if (!cond.len)
     return 0;
+  /* weak comparison (compressed responses weaken the `etag`) */
+  if (etag.len > 2 && etag.buf[0] == 'W' && etag.buf[1] == '/')
+    etag.buf += 2, etag.len -= 2;
   char *end = cond.buf + cond.len;
   for (;;) {
     cond.buf += (cond.buf[0] == ',');
     while (cond.buf[0] == ' ')
       ++cond.buf;
+    if (end - cond.buf > 2 && cond.buf[0] == 'W' && cond.buf[1] == '/')
+      cond.buf += 2;
     if (cond.buf > end || (size_t)(end - cond.buf) < (size_t)etag.len)
       return 0;
     if (FIO_MEMCMP(cond.buf, etag.buf, etag.len)) {
@@ -3029,9 +3724,408 @@ SFUNC int fio_http_etag_is_match(fio_http_s *h) {
 }
 
 /* *****************************************************************************
-Param Parsing (TODO! - parse query, parse mime/multipart parse text/json)
+Body Parsing - multipart/form-data (streaming)
+
+The parser searches each chunk for the delimiter (`CRLF--boundary`), passing
+the data preceding it directly to the callbacks. Only part headers are copied.
+
+If a chunk ends with a partial delimiter, the number of matching bytes is
+carried over. The carried bytes are a prefix of the delimiter, so they are
+never copied. Since the delimiter starts with a CR (which is invalid in a
+boundary), if the next chunk doesn't complete the delimiter, all the carried
+bytes are part of the data.
+
+The body starts with a carried (virtual) CRLF, so the first boundary matches
+the delimiter even though it isn't preceded by a line break.
 ***************************************************************************** */
 
+typedef enum {
+  FIO___HTTP_MULTIPART_PREAMBLE = 0, /* before the first boundary */
+  FIO___HTTP_MULTIPART_BOUNDARY,     /* after a delimiter (padding, CR or -) */
+  FIO___HTTP_MULTIPART_BOUNDARY_LF,  /* expecting the LF after a boundary */
+  FIO___HTTP_MULTIPART_CLOSE,        /* expecting the second `-` (`--`) */
+  FIO___HTTP_MULTIPART_HEADERS,      /* collecting part headers */
+  FIO___HTTP_MULTIPART_DATA,         /* part data */
+  FIO___HTTP_MULTIPART_DONE,         /* the closing boundary was parsed */
+  FIO___HTTP_MULTIPART_ERROR,
+} fio___http_multipart_state_e;
+
+struct fio_http_multipart_s {
+  fio_http_multipart_settings_s settings;
+  fio_http_multipart_part_s part;
+  /* the current part's headers (fio_bstr), part strings point into it */
+  char *head;
+  /* the offset of the header line being collected */
+  size_t line;
+  /* the number of delimiter bytes matched at the end of the previous chunk */
+  size_t carry;
+  fio___http_multipart_state_e state;
+  size_t delim_len;
+  /* CRLF + "--" + boundary (the boundary is limited to 70 bytes) */
+  char delim[76];
+};
+
+FIO_LEAK_COUNTER_DEF(fio_http_multipart_s)
+
+/* compares a string to a lower case ASCII token, ignoring case. */
+FIO_SFUNC int fio___http_multipart_is(const char *s,
+                                      size_t len,
+                                      const char *token,
+                                      size_t token_len) {
+  if (len != token_len)
+    return 0;
+  for (size_t i = 0; i < len; ++i) {
+    if (s[i] == token[i] ||
+        ((s[i] | 32) == token[i] && token[i] >= 'a' && token[i] <= 'z'))
+      continue;
+    return 0;
+  }
+  return 1;
+}
+
+/* parses the `name` and `filename` parameters of a Content-Disposition. */
+FIO_SFUNC void fio___http_multipart_disposition(fio_http_multipart_part_s *part,
+                                                char *pos,
+                                                char *end) {
+  while (pos < end) {
+    char *key, *eq;
+    fio_str_info_s value;
+    while (pos < end && (*pos == ';' || *pos == ' ' || *pos == '\t'))
+      ++pos;
+    key = pos;
+    while (pos < end && *pos != '=' && *pos != ';')
+      ++pos;
+    if (pos == end || *pos == ';')
+      continue; /* a token without a value, i.e., `form-data` */
+    eq = pos++;
+    while (eq > key && (eq[-1] == ' ' || eq[-1] == '\t'))
+      --eq;
+    if (pos < end && *pos == '"') { /* quoted values keep their escapes */
+      value.buf = ++pos;
+      while (pos < end && *pos != '"')
+        pos += 1 + (*pos == '\\');
+      if (pos > end)
+        pos = end;
+      value.len = (size_t)(pos - value.buf);
+      pos += (pos < end);
+    } else {
+      value.buf = pos;
+      while (pos < end && *pos != ';')
+        ++pos;
+      value.len = (size_t)(pos - value.buf);
+      while (value.len &&
+             (value.buf[value.len - 1] == ' ' ||
+              value.buf[value.len - 1] == '\t'))
+        --value.len;
+    }
+    if (fio___http_multipart_is(key, (size_t)(eq - key), "name", 4))
+      part->name = value;
+    else if (fio___http_multipart_is(key, (size_t)(eq - key), "filename", 8))
+      part->filename = value;
+  }
+}
+
+/* parses the collected part headers and starts the part. */
+FIO_SFUNC int fio___http_multipart_part_start(fio_http_multipart_s *p) {
+  char *pos = p->head;
+  char *end = p->head + p->line; /* excludes the empty line */
+  p->part = (fio_http_multipart_part_s){.fd = -1,
+                                        .udata = p->settings.udata};
+  while (pos < end) {
+    char *eol = (char *)FIO_MEMCHR(pos, '\n', (size_t)(end - pos));
+    char *line_end = eol - (eol > pos && eol[-1] == '\r');
+    char *colon = (char *)FIO_MEMCHR(pos, ':', (size_t)(line_end - pos));
+    if (colon) {
+      char *value = colon + 1;
+      char *value_end = line_end;
+      while (value < value_end && (*value == ' ' || *value == '\t'))
+        ++value;
+      while (value_end > value &&
+             (value_end[-1] == ' ' || value_end[-1] == '\t'))
+        --value_end;
+      if (fio___http_multipart_is(pos,
+                                  (size_t)(colon - pos),
+                                  "content-disposition",
+                                  19))
+        fio___http_multipart_disposition(&p->part, value, value_end);
+      else if (fio___http_multipart_is(pos,
+                                       (size_t)(colon - pos),
+                                       "content-type",
+                                       12))
+        p->part.content_type =
+            FIO_STR_INFO2(value, (size_t)(value_end - value));
+    }
+    pos = eol + 1;
+  }
+  p->state = FIO___HTTP_MULTIPART_DATA;
+  return (p->settings.on_part ? p->settings.on_part(&p->part) : 0);
+}
+
+/* collects part headers, line by line, until the empty line. */
+FIO_SFUNC int fio___http_multipart_headers(fio_http_multipart_s *p,
+                                           fio_buf_info_s *buf) {
+  while (buf->len) {
+    char *nl = (char *)FIO_MEMCHR(buf->buf, '\n', buf->len);
+    size_t len = nl ? (size_t)(nl - buf->buf) + 1 : buf->len;
+    size_t line_len;
+    if (fio_bstr_len(p->head) + len > FIO_HTTP_MULTIPART_HEADER_LIMIT)
+      return -1;
+    p->head = fio_bstr_write(p->head, buf->buf, len);
+    buf->buf += len;
+    buf->len -= len;
+    if (!nl)
+      return 0;
+    line_len = fio_bstr_len(p->head) - p->line;
+    if (line_len > 2 || (line_len == 2 && p->head[p->line] != '\r')) {
+      p->line = fio_bstr_len(p->head);
+      continue;
+    }
+    return fio___http_multipart_part_start(p);
+  }
+  return 0;
+}
+
+/* passes part data to the user (or writes it to the part's file). */
+FIO_IFUNC int fio___http_multipart_write(fio_http_multipart_s *p,
+                                         const char *data,
+                                         size_t len) {
+  if (p->state != FIO___HTTP_MULTIPART_DATA || !len)
+    return 0;
+  p->part.len += len;
+  if (p->part.fd != -1)
+    return 0 - (fio_fd_write(p->part.fd, data, len) != (ssize_t)len);
+  if (p->settings.on_data)
+    return p->settings.on_data(&p->part, FIO_BUF_INFO2((char *)data, len));
+  return 0;
+}
+
+/* ends a part that was cut short, so the user can release its resources. */
+FIO_SFUNC void fio___http_multipart_abort(fio_http_multipart_s *p) {
+  if (p->state != FIO___HTTP_MULTIPART_DATA)
+    return;
+  p->state = FIO___HTTP_MULTIPART_ERROR;
+  p->part.error = 1;
+  if (p->settings.on_part_end)
+    p->settings.on_part_end(&p->part);
+}
+
+/* called when a delimiter was found (ends the current part, if any). */
+FIO_SFUNC int fio___http_multipart_delimiter(fio_http_multipart_s *p) {
+  int r = 0;
+  if (p->state == FIO___HTTP_MULTIPART_DATA && p->settings.on_part_end)
+    r = p->settings.on_part_end(&p->part);
+  p->state = FIO___HTTP_MULTIPART_BOUNDARY;
+  p->head = fio_bstr_len_set(p->head, 0);
+  p->line = 0;
+  return r;
+}
+
+/* searches for the delimiter, passing any data that precedes it. */
+FIO_SFUNC int fio___http_multipart_data(fio_http_multipart_s *p,
+                                        fio_buf_info_s *buf) {
+  const char *delim = p->delim;
+  const size_t delim_len = p->delim_len;
+  char *pos, *end;
+  if (p->carry) { /* test if the chunk completes a delimiter */
+    size_t need = delim_len - p->carry;
+    size_t len = (need < buf->len) ? need : buf->len;
+    if (!FIO_MEMCMP(buf->buf, delim + p->carry, len)) {
+      buf->buf += len;
+      buf->len -= len;
+      if (len < need) {
+        p->carry += len;
+        return 0;
+      }
+      p->carry = 0;
+      return fio___http_multipart_delimiter(p);
+    }
+    /* a false positive, the carried bytes were part of the data */
+    if (fio___http_multipart_write(p, delim, p->carry))
+      return -1;
+    p->carry = 0;
+  }
+  pos = buf->buf;
+  end = buf->buf + buf->len;
+  for (;;) {
+    char *cr = (char *)FIO_MEMCHR(pos, '\r', (size_t)(end - pos));
+    size_t left;
+    if (!cr)
+      break;
+    left = (size_t)(end - cr);
+    if (left < delim_len) { /* a possible partial delimiter at the end */
+      if (!FIO_MEMCMP(cr, delim, left)) {
+        p->carry = left;
+        end = cr;
+        break;
+      }
+    } else if (!FIO_MEMCMP(cr, delim, delim_len)) {
+      if (fio___http_multipart_write(p, buf->buf, (size_t)(cr - buf->buf)))
+        return -1;
+      buf->len -= (size_t)(cr - buf->buf) + delim_len;
+      buf->buf = cr + delim_len;
+      return fio___http_multipart_delimiter(p);
+    }
+    pos = cr + 1;
+  }
+  if (fio___http_multipart_write(p, buf->buf, (size_t)(end - buf->buf)))
+    return -1;
+  buf->buf += buf->len;
+  buf->len = 0;
+  return 0;
+}
+
+/* Creates a new multipart parser for the `content_type` header value. */
+SFUNC fio_http_multipart_s *fio_http_multipart_new FIO_NOOP(
+    fio_str_info_s content_type,
+    fio_http_multipart_settings_s settings) {
+  fio_http_multipart_s *p;
+  fio_str_info_s boundary = {0};
+  char *pos = content_type.buf, *end = content_type.buf + content_type.len;
+  if (content_type.len < 19 ||
+      !fio___http_multipart_is(pos, 19, "multipart/form-data", 19))
+    return NULL;
+  for (pos += 19; pos < end; ++pos) { /* find the `boundary` parameter */
+    if (*pos != ';')
+      continue;
+    do {
+      ++pos;
+    } while (pos < end && (*pos == ' ' || *pos == '\t'));
+    if ((size_t)(end - pos) < 10 ||
+        !fio___http_multipart_is(pos, 9, "boundary=", 9))
+      continue;
+    boundary.buf = pos + 9;
+    if (*boundary.buf == '"') {
+      char *q;
+      ++boundary.buf;
+      q = (char *)FIO_MEMCHR(boundary.buf, '"', (size_t)(end - boundary.buf));
+      boundary.len = q ? (size_t)(q - boundary.buf) : 0;
+    } else {
+      char *e = boundary.buf;
+      while (e < end && *e != ';' && *e != ' ' && *e != '\t')
+        ++e;
+      boundary.len = (size_t)(e - boundary.buf);
+    }
+    break;
+  }
+  if (!boundary.len || boundary.len > 70)
+    return NULL;
+  p = (fio_http_multipart_s *)FIO_MEM_REALLOC_(NULL, 0, sizeof(*p), 0);
+  if (!p)
+    return p;
+  FIO_LEAK_COUNTER_ON_ALLOC(fio_http_multipart_s);
+  *p = (fio_http_multipart_s){
+      .settings = settings,
+      .carry = 2, /* the body starts with a (virtual) CRLF */
+      .delim_len = boundary.len + 4,
+  };
+  FIO_MEMCPY(p->delim, "\r\n--", 4);
+  FIO_MEMCPY(p->delim + 4, boundary.buf, boundary.len);
+  return p;
+}
+
+/* Frees a multipart parser. */
+SFUNC void fio_http_multipart_free(fio_http_multipart_s *p) {
+  if (!p)
+    return;
+  fio___http_multipart_abort(p); /* i.e., a truncated body */
+  FIO_LEAK_COUNTER_ON_FREE(fio_http_multipart_s);
+  fio_bstr_free(p->head);
+  FIO_MEM_FREE_(p, sizeof(*p));
+}
+
+/* Parses the next chunk of a multipart body, calling the callbacks. */
+SFUNC int fio_http_multipart_parse(fio_http_multipart_s *p,
+                                   fio_buf_info_s buf) {
+  if (!p)
+    return -1;
+  while (buf.len) {
+    switch (p->state) {
+    case FIO___HTTP_MULTIPART_PREAMBLE: /* fall through */
+    case FIO___HTTP_MULTIPART_DATA:
+      if (fio___http_multipart_data(p, &buf))
+        goto error;
+      continue;
+    case FIO___HTTP_MULTIPART_BOUNDARY:
+      if (*buf.buf == '-')
+        p->state = FIO___HTTP_MULTIPART_CLOSE;
+      else if (*buf.buf == '\r')
+        p->state = FIO___HTTP_MULTIPART_BOUNDARY_LF;
+      else if (*buf.buf == '\n')
+        p->state = FIO___HTTP_MULTIPART_HEADERS;
+      else if (*buf.buf != ' ' && *buf.buf != '\t') /* transport padding */
+        goto error;
+      break;
+    case FIO___HTTP_MULTIPART_BOUNDARY_LF:
+      if (*buf.buf != '\n')
+        goto error;
+      p->state = FIO___HTTP_MULTIPART_HEADERS;
+      break;
+    case FIO___HTTP_MULTIPART_CLOSE:
+      if (*buf.buf != '-')
+        goto error;
+      p->state = FIO___HTTP_MULTIPART_DONE;
+      break;
+    case FIO___HTTP_MULTIPART_HEADERS:
+      if (fio___http_multipart_headers(p, &buf))
+        goto error;
+      continue;
+    case FIO___HTTP_MULTIPART_DONE: /* the epilogue is ignored */
+      return 0;
+    case FIO___HTTP_MULTIPART_ERROR: return -1;
+    }
+    ++buf.buf;
+    --buf.len;
+  }
+  return 0;
+error:
+  fio___http_multipart_abort(p);
+  p->state = FIO___HTTP_MULTIPART_ERROR;
+  return -1;
+}
+
+/* Returns 1 once the closing boundary was parsed, -1 on error, 0 otherwise. */
+SFUNC int fio_http_multipart_is_finished(fio_http_multipart_s *p) {
+  if (!p || p->state == FIO___HTTP_MULTIPART_ERROR)
+    return -1;
+  return (p->state == FIO___HTTP_MULTIPART_DONE);
+}
+
+/* Streams the body through a new multipart parser (instead of storing it). */
+SFUNC fio_http_multipart_s *fio_http_body_multipart FIO_NOOP(
+    fio_http_s *h,
+    fio_http_multipart_settings_s settings) {
+  fio_http_multipart_s *p;
+  fio_str_info_s content_type;
+  if (!h || h->body.multipart)
+    return NULL;
+  content_type = (h->status ? fio_http_response_header
+                            : fio_http_request_header)(
+      h,
+      FIO_STR_INFO2((char *)"content-type", 12),
+      0);
+  p = (fio_http_multipart_new)(content_type, settings);
+  if (!p)
+    return p;
+  if (h->body.fd != -1) { /* parse (and release) data received earlier */
+    char tmp[4096];
+    size_t pos = 0, len;
+    while (pos < h->body.len &&
+           (len = fio_fd_read(h->body.fd, tmp, sizeof(tmp), (off_t)pos))) {
+      fio_http_multipart_parse(p, FIO_BUF_INFO2(tmp, len));
+      pos += len;
+    }
+    close(h->body.fd);
+    h->body.fd = -1;
+  } else if (h->body.len) {
+    fio_http_multipart_parse(p, FIO_BUF_INFO2(h->body.buf, h->body.len));
+  }
+  fio_bstr_free(h->body.buf);
+  h->body.buf = NULL;
+  h->body.pos = h->body.len;
+  h->body.multipart = p;
+  return p;
+}
+
 /* *****************************************************************************
 
 
@@ -3040,6 +4134,269 @@ Param Parsing (TODO! - parse query, parse mime/multipart parse text/json)
 
 ***************************************************************************** */
 
+/* *****************************************************************************
+Static file cache
+***************************************************************************** */
+
+/* pre-compressed static file variants (by order of preference) */
+static const struct {
+  fio_str_info_s encoding;
+  fio_buf_info_s ext;
+} FIO___HTTP_STATIC_ENCODINGS[] = {
+    {{.buf = (char *)"br", .len = 2}, {.buf = (char *)".br", .len = 3}},
+    {{.buf = (char *)"gzip", .len = 4}, {.buf = (char *)".gz", .len = 3}},
+    {{.buf = (char *)"deflate", .len = 7}, {.buf = (char *)".zip", .len = 4}},
+};
+#define FIO___HTTP_STATIC_ENCODINGS_COUNT                                      \
+  (sizeof(FIO___HTTP_STATIC_ENCODINGS) / sizeof(FIO___HTTP_STATIC_ENCODINGS[0]))
+
+/** Returns a static file's `etag` (a `stat` hash, ignoring access time). */
+FIO_SFUNC uint64_t fio___http_stat2etag(struct stat *s) {
+  uint64_t d[6] = {(uint64_t)s->st_dev,
+                   (uint64_t)s->st_ino,
+                   (uint64_t)s->st_mode,
+                   (uint64_t)s->st_size,
+                   (uint64_t)s->st_mtime,
+                   (uint64_t)s->st_ctime};
+  uint64_t r = fio_risky_hash(d, sizeof(d), 0);
+  return r + !r;
+}
+
+/** Sets the response headers for a pre-compressed static file variant. */
+FIO_SFUNC void fio___http_static_encoding_set(fio_http_s *h, size_t i) {
+  fio_http_response_header_set(h,
+                               FIO_STR_INFO2((char *)"vary", 4),
+                               FIO_STR_INFO2((char *)"accept-encoding", 15));
+  fio_http_response_header_set(h,
+                               FIO_STR_INFO2((char *)"content-encoding", 16),
+                               FIO___HTTP_STATIC_ENCODINGS[i].encoding);
+}
+
+#if FIO_HTTP_STATIC_FILE_CACHE_LIMIT
+/* a cached file (or pre-compressed variant) */
+typedef struct {
+  char *body;     /* file data (fio_bstr, shared with pending writes) */
+  char *etag;     /* pre-computed `etag` value, NULL if not cached */
+  char *modified; /* pre-computed `last-modified` value */
+  uint64_t mark;  /* the file's `etag` hash, 0 if missing */
+} fio___http_sfc_file_s;
+
+/* a cache entry, keyed by the requested (unresolved) file name */
+typedef struct {
+  volatile uint32_t ref;
+  int64_t validated; /* last time the files were tested for changes */
+  size_t mem;        /* memory counted against the cache limit */
+  char *path;        /* resolved file name (no encoding extension) */
+  char *mime;        /* `content-type` value (copied, registry may change) */
+  fio___http_sfc_file_s file[FIO___HTTP_STATIC_ENCODINGS_COUNT + 1];
+} fio___http_sfc_s;
+
+FIO_LEAK_COUNTER_DEF(fio___http_sfc_s)
+
+FIO_SFUNC void fio___http_sfc_free(fio___http_sfc_s *e) {
+  if (!e || fio_atomic_sub_fetch(&e->ref, 1))
+    return;
+  for (size_t i = 0; i < FIO___HTTP_STATIC_ENCODINGS_COUNT + 1; ++i) {
+    fio_bstr_free(e->file[i].body);
+    fio_bstr_free(e->file[i].etag);
+    fio_bstr_free(e->file[i].modified);
+  }
+  fio_bstr_free(e->path);
+  fio_bstr_free(e->mime);
+  FIO_LEAK_COUNTER_ON_FREE(fio___http_sfc_s);
+  FIO_MEM_FREE_(e, sizeof(*e));
+}
+
+/* called (under lock) when an entry is removed from the cache */
+FIO_SFUNC void fio___http_sfc_unlink(fio___http_sfc_s *e);
+
+#define FIO___RECURSIVE_INCLUDE  1
+#define FIO_MAP_NAME             fio___http_sfc_map
+#define FIO_MAP_KEY_BSTR         /* the requested file name */
+#define FIO_MAP_VALUE            fio___http_sfc_s *
+#define FIO_MAP_VALUE_DESTROY(o) fio___http_sfc_unlink((o))
+#define FIO_MAP_ORDERED          1 /* evict oldest entries first */
+#include FIO_INCLUDE_FILE
+#undef FIO___RECURSIVE_INCLUDE
+
+static struct {
+  fio___http_sfc_map_s map;
+  size_t mem;
+  FIO___LOCK_TYPE lock;
+} FIO___HTTP_SFC = {.lock = FIO___LOCK_INIT};
+
+FIO_SFUNC void fio___http_sfc_unlink(fio___http_sfc_s *e) {
+  FIO___HTTP_SFC.mem -= e->mem;
+  fio___http_sfc_free(e);
+}
+
+FIO_IFUNC uint64_t fio___http_sfc_hash(fio_str_info_s key) {
+  return fio_risky_hash(key.buf, key.len, (uint64_t)(uintptr_t)&FIO___HTTP_SFC);
+}
+
+/** Returns a file's `etag` hash, or 0 if the file is missing. */
+FIO_SFUNC uint64_t fio___http_sfc_mark(const char *filename) {
+  struct stat stt;
+  if (stat(filename, &stt))
+    return 0;
+  return fio___http_stat2etag(&stt);
+}
+
+/* writes the resolved file name of variant `i` to `dest` (4095 bytes max). */
+FIO_SFUNC fio_str_info_s fio___http_sfc_name(char *dest,
+                                             fio___http_sfc_s *e,
+                                             size_t i) {
+  fio_str_info_s r = FIO_STR_INFO3(dest, 0, 4095);
+  fio_string_write(&r, NULL, e->path, fio_bstr_len(e->path));
+  if (i)
+    fio_string_write(&r,
+                     NULL,
+                     FIO___HTTP_STATIC_ENCODINGS[i - 1].ext.buf,
+                     FIO___HTTP_STATIC_ENCODINGS[i - 1].ext.len);
+  return r;
+}
+
+/** Returns non-zero if any of the files were modified, created or deleted. */
+FIO_SFUNC int fio___http_sfc_changed(fio___http_sfc_s *e) {
+  char buf[4096];
+  for (size_t i = 0; i < FIO___HTTP_STATIC_ENCODINGS_COUNT + 1; ++i) {
+    fio___http_sfc_name(buf, e, i);
+    if (fio___http_sfc_mark(buf) != e->file[i].mark)
+      return 1;
+  }
+  return 0;
+}
+
+/**
+ * Returns a cached entry (reference counted) for the requested file name.
+ *
+ * Entries are revalidated (using `stat`) once every
+ * FIO_HTTP_STATIC_FILE_CACHE_VALIDATE milliseconds and removed if changed.
+ */
+FIO_SFUNC fio___http_sfc_s *fio___http_sfc_get(fio_str_info_s key) {
+  fio___http_sfc_s *e;
+  const uint64_t hash = fio___http_sfc_hash(key);
+  const int64_t now = fio_http_get_timestump();
+  int validate = 0;
+  FIO___LOCK_LOCK(FIO___HTTP_SFC.lock);
+  e = fio___http_sfc_map_get(&FIO___HTTP_SFC.map, hash, key);
+  if (e) {
+    fio_atomic_add(&e->ref, 1);
+    validate = (now - e->validated) >=
+               ((int64_t)FIO_HTTP_STATIC_FILE_CACHE_VALIDATE *
+                (FIO___HTTP_TIME_DIV / 1000));
+    if (validate) /* other threads keep using the entry meanwhile */
+      e->validated = now;
+  }
+  FIO___LOCK_UNLOCK(FIO___HTTP_SFC.lock);
+  if (!validate || !fio___http_sfc_changed(e))
+    return e;
+  FIO_LOG_DDEBUG2("(%d) static file cache: %s changed", fio_io_pid(), e->path);
+  FIO___LOCK_LOCK(FIO___HTTP_SFC.lock);
+  if (fio___http_sfc_map_get(&FIO___HTTP_SFC.map, hash, key) == e)
+    fio___http_sfc_map_remove(&FIO___HTTP_SFC.map, hash, key, NULL);
+  FIO___LOCK_UNLOCK(FIO___HTTP_SFC.lock);
+  fio___http_sfc_free(e);
+  return NULL;
+}
+
+/** Reads a (small) file and pre-computes its header values. */
+FIO_SFUNC int fio___http_sfc_read(fio___http_sfc_file_s *f, const char *name) {
+  struct stat stt;
+  int fd = fio_filename_open(name, O_RDONLY);
+  if (fd == -1)
+    return -1;
+  if (fstat(fd, &stt))
+    goto error;
+  f->mark = fio___http_stat2etag(&stt);
+  if ((stt.st_mode & S_IFMT) != S_IFREG ||
+      (size_t)stt.st_size > FIO_HTTP_STATIC_FILE_CACHE_FILE_MAX)
+    goto error; /* mark is kept, so changes are still detected */
+  if (stt.st_size) {
+    f->body = fio_bstr_reserve(NULL, (size_t)stt.st_size);
+    if (fio_fd_read(fd, f->body, (size_t)stt.st_size, 0) !=
+        (size_t)stt.st_size)
+      goto error;
+    f->body = fio_bstr_len_set(f->body, (size_t)stt.st_size);
+  }
+  {
+    char tmp[64];
+    fio_str_info_s s = FIO_STR_INFO3(tmp, 0, 63);
+    fio_string_write_hex(&s, NULL, f->mark);
+    f->etag = fio_bstr_write(NULL, s.buf, s.len);
+    s.len = fio_time2rfc7231(tmp, stt.st_mtime);
+    f->modified = fio_bstr_write(NULL, s.buf, s.len);
+  }
+  close(fd);
+  return 0;
+error:
+  fio_bstr_free(f->body);
+  f->body = NULL;
+  close(fd);
+  return -1;
+}
+
+/**
+ * Loads the resolved file `path` (and any pre-compressed variants) to the
+ * cache, returning a new reference or NULL if the file can't be cached.
+ */
+FIO_SFUNC fio___http_sfc_s *fio___http_sfc_load(fio_str_info_s key,
+                                                fio_str_info_s path,
+                                                fio_str_info_s mime) {
+  char buf[4096];
+  fio___http_sfc_s *e;
+  if (path.len > 4000)
+    return NULL;
+  e = (fio___http_sfc_s *)FIO_MEM_REALLOC_(NULL, 0, sizeof(*e), 0);
+  if (!e)
+    return NULL;
+  FIO_LEAK_COUNTER_ON_ALLOC(fio___http_sfc_s);
+  *e = (fio___http_sfc_s){
+      .ref = 2, /* one for the cache and one for the caller */
+      .validated = fio_http_get_timestump(),
+      .mem = sizeof(*e) + key.len + path.len + mime.len,
+      .path = fio_bstr_write(NULL, path.buf, path.len),
+      .mime = fio_bstr_write(NULL, mime.buf, mime.len),
+  };
+  for (size_t i = 0; i < FIO___HTTP_STATIC_ENCODINGS_COUNT + 1; ++i) {
+    fio___http_sfc_name(buf, e, i);
+    if (fio___http_sfc_read(e->file + i, buf)) {
+      if (!i)
+        goto too_large;
+      continue;
+    }
+    e->mem += fio_bstr_len(e->file[i].body) + 96; /* + header values */
+  }
+  FIO___LOCK_LOCK(FIO___HTTP_SFC.lock);
+  fio___http_sfc_map_set(&FIO___HTTP_SFC.map,
+                         fio___http_sfc_hash(key),
+                         key,
+                         e,
+                         NULL);
+  FIO___HTTP_SFC.mem += e->mem;
+  while (FIO___HTTP_SFC.mem > FIO_HTTP_STATIC_FILE_CACHE_LIMIT &&
+         fio___http_sfc_map_count(&FIO___HTTP_SFC.map) > 1)
+    fio___http_sfc_map_evict(&FIO___HTTP_SFC.map, 1);
+  FIO___LOCK_UNLOCK(FIO___HTTP_SFC.lock);
+  return e;
+
+too_large:
+  e->ref = 1;
+  fio___http_sfc_free(e);
+  return NULL;
+}
+
+FIO_SFUNC void fio___http_sfc_destroy(void) {
+  FIO___LOCK_LOCK(FIO___HTTP_SFC.lock);
+  fio___http_sfc_map_destroy(&FIO___HTTP_SFC.map);
+  FIO___LOCK_UNLOCK(FIO___HTTP_SFC.lock);
+  FIO___LOCK_DESTROY(FIO___HTTP_SFC.lock);
+}
+#else
+typedef struct fio___http_sfc_s fio___http_sfc_s;
+#define fio___http_sfc_free(e) ((void)(e))
+#endif /* FIO_HTTP_STATIC_FILE_CACHE_LIMIT */
+
 /* *****************************************************************************
 Static file helper
 ***************************************************************************** */
@@ -3053,7 +4410,11 @@ SFUNC int fio_http_static_file_response(fio_http_s *h,
                                         fio_str_info_s fnm,
                                         size_t max_age) {
   int fd = -1;
+  int r = 0;
   size_t file_length = 0;
+  size_t requested_len = 0;
+  char *body = NULL; /* cached file data (if any) */
+  fio___http_sfc_s *cached = NULL;
   /* combine public folder with path to get file name */
   fio_str_info_s mime_type = {0};
   FIO_STR_INFO_TMP_VAR(etag, 31);
@@ -3071,6 +4432,12 @@ SFUNC int fio_http_static_file_response(fio_http_s *h,
   fio_string_write_url_dec(&filename, NULL, fnm.buf, fnm.len);
   if (fio_filename_is_unsafe_url(filename.buf))
     goto file_not_found;
+#if FIO_HTTP_STATIC_FILE_CACHE_LIMIT
+  /* the requested name remains a prefix of `filename` while it's resolved */
+  requested_len = filename.len;
+  if ((cached = fio___http_sfc_get(filename)))
+    goto cached_file;
+#endif
 
   { /* Test for incomplete file name */
     size_t file_type = fio_filename_type(filename.buf);
@@ -3137,6 +4504,12 @@ SFUNC int fio_http_static_file_response(fio_http_s *h,
                         ext);
     }
   }
+#if FIO_HTTP_STATIC_FILE_CACHE_LIMIT
+  if ((cached = fio___http_sfc_load(FIO_STR_INFO2(filename.buf, requested_len),
+                                    filename,
+                                    mime_type)))
+    goto cached_file;
+#endif
   {
     fio_str_info_s ac =
         fio_http_request_header(h,
@@ -3144,30 +4517,19 @@ SFUNC int fio_http_static_file_response(fio_http_s *h,
                                 0);
     if (!ac.len)
       goto accept_encoding_header_test_done;
-    struct {
-      char *value;
-      fio_buf_info_s ext;
-    } options[] = {{(char *)"br", FIO_BUF_INFO2((char *)".br", 3)},
-                   {(char *)"gzip", FIO_BUF_INFO2((char *)".gz", 3)},
-                   {(char *)"deflate", FIO_BUF_INFO2((char *)".zip", 4)},
-                   {NULL}};
-    for (size_t i = 0; options[i].value; ++i) {
-      if (!strstr(ac.buf, options[i].value))
+    for (size_t i = 0; i < FIO___HTTP_STATIC_ENCODINGS_COUNT; ++i) {
+      if (!strstr(ac.buf, FIO___HTTP_STATIC_ENCODINGS[i].encoding.buf))
         continue;
-      fio_string_write(&filename, NULL, options[i].ext.buf, options[i].ext.len);
+      fio_string_write(&filename,
+                       NULL,
+                       FIO___HTTP_STATIC_ENCODINGS[i].ext.buf,
+                       FIO___HTTP_STATIC_ENCODINGS[i].ext.len);
       if (!fio_filename_type(filename.buf)) {
-        filename.len -= options[i].ext.len;
+        filename.len -= FIO___HTTP_STATIC_ENCODINGS[i].ext.len;
         filename.buf[filename.len] = 0;
         continue;
       }
-      fio_http_response_header_set(
-          h,
-          FIO_STR_INFO2((char *)"vary", 4),
-          FIO_STR_INFO2((char *)"accept-encoding", 15));
-      fio_http_response_header_set(
-          h,
-          FIO_STR_INFO2((char *)"content-encoding", 16),
-          FIO_STR_INFO1(options[i].value));
+      fio___http_static_encoding_set(h, i);
       break;
     }
   }
@@ -3182,29 +4544,32 @@ accept_encoding_header_test_done:
     struct stat stt;
     if (fstat(fd, &stt))
       goto file_not_found;
-    uint64_t etag_hash = fio_risky_hash(&stt, sizeof(stt), 0);
-    fio_string_write_hex(&etag, NULL, etag_hash);
+    fio_string_write_hex(&etag, NULL, fio___http_stat2etag(&stt));
     fio_http_response_header_set(h, FIO_STR_INFO2((char *)"etag", 4), etag);
     filename.len = 0;
     filename.len = fio_time2rfc7231(filename.buf, stt.st_mtime);
     fio_http_response_header_set(h,
                                  FIO_STR_INFO1((char *)"last-modified"),
                                  filename);
-    if (max_age) {
-      filename.len = 0;
-      fio_string_write2(&filename,
-                        NULL,
-                        FIO_STRING_WRITE_STR2("max-age=", 8),
-                        FIO_STRING_WRITE_UNUM(max_age));
-      fio_http_response_header_set(h,
-                                   FIO_STR_INFO1((char *)"cache-control"),
-                                   filename);
-    }
     file_length = stt.st_size;
-    filename.capa = 0;
-    if (fio___http_response_etag_if_none_match(h))
-      return 0;
   }
+
+#if FIO_HTTP_STATIC_FILE_CACHE_LIMIT
+file_headers_set: /* cached files skip the file system */
+#endif
+  if (max_age) {
+    filename.len = 0;
+    fio_string_write2(&filename,
+                      NULL,
+                      FIO_STRING_WRITE_STR2("max-age=", 8),
+                      FIO_STRING_WRITE_UNUM(max_age));
+    fio_http_response_header_set(h,
+                                 FIO_STR_INFO1((char *)"cache-control"),
+                                 filename);
+  }
+  filename.capa = 0;
+  if (fio___http_response_etag_if_none_match(h))
+    goto finish;
   /* test for range requests. */
   {
     /* test / validate range requests */
@@ -3281,30 +4646,64 @@ range_request_review_finished:
     fio_http_response_header_set(h,
                                  FIO_STR_INFO2((char *)"content-type", 12),
                                  mime_type);
-  { /* send response (avoid macro for C++ compatibility) */
+  if (body) { /* send cached data (avoid macro for C++ compatibility) */
+    fio_http_write_args_s args = {
+        .buf = body,
+        .len = file_length,
+        .offset = filename.capa, /* now holds starting offset */
+        .dealloc = (void (*)(void *))fio_bstr_free,
+        .finish = 1};
+    body = NULL; /* ownership moved to the writer */
+    fio_http_write FIO_NOOP(h, args);
+  } else { /* send response (avoid macro for C++ compatibility) */
     fio_http_write_args_s args = {
         .len = file_length,
         .offset = filename.capa, /* now holds starting offset */
         .fd = fd,
         .finish = 1};
+    fd = -1; /* the file is always closed by the writer */
     fio_http_write FIO_NOOP(h, args);
   }
-  return 0;
+  goto finish;
+
+#if FIO_HTTP_STATIC_FILE_CACHE_LIMIT
+cached_file: { /* headers were pre-computed, no file system access required */
+  fio___http_sfc_file_s *f = cached->file;
+  fio_str_info_s ac =
+      fio_http_request_header(h,
+                              FIO_STR_INFO2((char *)"accept-encoding", 15),
+                              0);
+  for (size_t i = 0; ac.len && i < FIO___HTTP_STATIC_ENCODINGS_COUNT; ++i) {
+    if (!cached->file[i + 1].etag ||
+        !strstr(ac.buf, FIO___HTTP_STATIC_ENCODINGS[i].encoding.buf))
+      continue;
+    f = cached->file + i + 1;
+    fio___http_static_encoding_set(h, i);
+    break;
+  }
+  fio_string_write(&etag, NULL, f->etag, fio_bstr_len(f->etag));
+  fio_http_response_header_set(h, FIO_STR_INFO2((char *)"etag", 4), etag);
+  fio_http_response_header_set(h,
+                               FIO_STR_INFO1((char *)"last-modified"),
+                               fio_bstr_info(f->modified));
+  mime_type = fio_bstr_info(cached->mime);
+  body = fio_bstr_copy(f->body);
+  file_length = fio_bstr_len(f->body);
+  goto file_headers_set;
+}
+#endif /* FIO_HTTP_STATIC_FILE_CACHE_LIMIT */
 
 file_not_found:
-  if (fd != -1)
-    close(fd);
-  return -1;
+  r = -1;
+  goto finish;
 
 head_request:
   /* TODO! HEAD responses should close?. */
-  if (fd != -1)
-    close(fd);
   {
     fio_http_write_args_s args = {.finish = 1};
     fio_http_write FIO_NOOP(h, args);
   }
-  return 0;
+  goto finish;
 
 invalid_range:
   filename.len = 0;
@@ -3316,7 +4715,15 @@ invalid_range:
   fio_http_response_header_set(h,
                                FIO_STR_INFO2((char *)"content-range", 13),
                                filename);
-  return fio_http_send_error_response(h, 416);
+  r = fio_http_send_error_response(h, 416);
+
+finish:
+  if (fd != -1)
+    close(fd);
+  fio_bstr_free(body);
+  fio___http_sfc_free(cached);
+  return r;
+  (void)requested_len; /* if unused */
 }
 
 /* *****************************************************************************
@@ -3621,6 +5028,14 @@ Constructor / Destructor
 
 FIO_SFUNC void fio___http_cleanup(void *ignr_) {
   (void)ignr_;
+  fio___http_log_destroy();
+#if FIO_HTTP_STATIC_FILE_CACHE_LIMIT
+  FIO_LOG_DEBUG2("(%d) freeing %zu static files (%zu bytes) from cache",
+                 fio_getpid(),
+                 (size_t)fio___http_sfc_map_count(&FIO___HTTP_SFC.map),
+                 FIO___HTTP_SFC.mem);
+  fio___http_sfc_destroy();
+#endif
 #if FIO_HTTP_CACHE_LIMIT
   for (size_t i = 0; i < 2; ++i) {
     const char *names[] = {"cookie names", "header values"};
@@ -3652,6 +5067,7 @@ FIO_SFUNC void fio___http_cleanup(void *ignr_) {
 
 FIO_CONSTRUCTOR(fio___http_str_cache_static_builder) {
   fio___http_str_cached_init();
+  fio___http_log_init();
   fio_state_callback_add(FIO_CALL_AT_EXIT, fio___http_cleanup, NULL);
   fio_http_mime_register_essential();
 }
@@ -0,0 +1,823 @@
+/* ************************************************************************* */
+#if !defined(FIO_INCLUDE_FILE) /* Dev test - ignore line */
+#define FIO___DEV___           /* Development inclusion - ignore line */
+#define FIO_HTTP_ROUTER        /* Development inclusion - ignore line */
+#include "./include.h"         /* Development inclusion - ignore line */
+#endif                         /* Development inclusion - ignore line */
+/* *****************************************************************************
+
+
+
+
+                      HTTP Request Router (Radix Tree)
+
+
+
+
+Copyright and License: see header file (000 copyright.h) or top of file
+***************************************************************************** */
+#if defined(FIO_HTTP_ROUTER) && !defined(H___FIO_HTTP_ROUTER___H) &&           \
+    defined(H___FIO_HTTP_HANDLE___H) && !defined(FIO___RECURSIVE_INCLUDE)
+#define H___FIO_HTTP_ROUTER___H
+
+/* *****************************************************************************
+HTTP Router Settings
+***************************************************************************** */
+
+#ifndef FIO_HTTP_ROUTER_MAX_PARAMS
+/** The maximum number of path parameters (and wildcards) per route. */
+#define FIO_HTTP_ROUTER_MAX_PARAMS 16
+#endif
+
+/* *****************************************************************************
+HTTP Router API
+***************************************************************************** */
+
+/** The HTTP Router type. */
+typedef struct fio_http_router_s fio_http_router_s;
+
+/** A matched route, as passed to the route's handler. */
+typedef struct fio_http_route_s {
+  /** The route's handler. */
+  void (*on_http)(fio_http_s *h, struct fio_http_route_s *route);
+  /** The opaque user data set for the route. */
+  void *udata;
+  /** The number of path parameters captured. */
+  size_t count;
+  /** Path parameters - values point into the request's path (no copies). */
+  struct {
+    /** The parameter's name (as set in the route's pattern). */
+    fio_str_info_s name;
+    /** The parameter's value (a slice of the request's path). */
+    fio_str_info_s value;
+  } param[FIO_HTTP_ROUTER_MAX_PARAMS];
+} fio_http_route_s;
+
+/** HTTP Router settings (see `fio_http_router_new`). */
+typedef struct {
+  /** Called when no route matches the request (defaults to a 404 response). */
+  void (*on_not_found)(fio_http_s *h);
+  /**
+   * A public folder for static files, tested when no route matches the
+   * request (and before `on_not_found`).
+   *
+   * Note: the `public_folder` in the HTTP settings is tested before routing.
+   */
+  fio_str_info_s public_folder;
+  /** The max-age value (in seconds) for static files (`public_folder`). */
+  size_t max_age;
+} fio_http_router_settings_s;
+
+/** Creates a new HTTP Router. */
+SFUNC fio_http_router_s *fio_http_router_new(fio_http_router_settings_s);
+/** Creates a new HTTP Router. */
+#define fio_http_router_new(...)                                               \
+  fio_http_router_new((fio_http_router_settings_s){__VA_ARGS__})
+
+/** Frees an HTTP Router. */
+SFUNC void fio_http_router_free(fio_http_router_s *router);
+
+/** Named arguments for `fio_http_route`. */
+typedef struct {
+  /**
+   * The route's pattern, i.e., `"/users/:id"`.
+   *
+   * Segments starting with `:` are named parameters (matching a single, non
+   * empty, path segment). A final segment starting with `*` (i.e., `*path`)
+   * is a wildcard (matching the rest of the path, if any).
+   *
+   * Static segments are preferred over parameters, and parameters are
+   * preferred over wildcards.
+   */
+  const char *path;
+  /** The HTTP method for the route (i.e. `"GET"`). NULL == any method. */
+  const char *method;
+  /** The route's handler. */
+  void (*on_http)(fio_http_s *h, fio_http_route_s *route);
+  /** Opaque user data for the handler. */
+  void *udata;
+} fio_http_route_args_s;
+
+/**
+ * Adds a route to the router, returning -1 on error (invalid pattern).
+ *
+ * Routing a method and path that were already routed replaces the handler.
+ *
+ * Note: routes should be added before the router is used (not thread safe).
+ */
+SFUNC int fio_http_route(fio_http_router_s *router, fio_http_route_args_s args);
+/** Adds a route to the router, returning -1 on error (invalid pattern). */
+#define fio_http_route(router, ...)                                            \
+  fio_http_route((router), (fio_http_route_args_s){__VA_ARGS__})
+
+/**
+ * Finds the route for the `method` and `path`, filling in `route`.
+ *
+ * Returns 0 on success, 404 if no route matches the path and 405 if the path
+ * matched but no handler was set for the method.
+ */
+SFUNC int fio_http_router_find(fio_http_router_s *router,
+                               fio_http_route_s *route,
+                               fio_str_info_s method,
+                               fio_str_info_s path);
+
+/**
+ * Routes the HTTP request using the router, calling the route's handler.
+ *
+ * Returns 0 on success, or the same error values as `fio_http_router_find`,
+ * in which case nothing is done (no response is sent).
+ */
+SFUNC int fio_http_router_dispatch(fio_http_router_s *router, fio_http_s *h);
+
+/**
+ * An `on_http` callback that routes requests using the router set as the
+ * HTTP handle's user data (`fio_http_udata`).
+ *
+ * i.e.: `fio_http_listen(url, .on_http = fio_http_router_on_http, .udata = r)`
+ *
+ * If no route matched, tests for a static file (`public_folder`) and calls the
+ * router's `on_not_found` callback (or sends a 404 / 405 error response).
+ */
+SFUNC void fio_http_router_on_http(fio_http_s *h);
+
+/** Returns the value of the named path parameter (or an empty string). */
+FIO_IFUNC fio_str_info_s fio_http_route_param(fio_http_route_s *route,
+                                              fio_str_info_s name);
+
+/* *****************************************************************************
+HTTP Router - inlined static functions
+***************************************************************************** */
+
+/** Returns the value of the named path parameter (or an empty string). */
+FIO_IFUNC fio_str_info_s fio_http_route_param(fio_http_route_s *route,
+                                              fio_str_info_s name) {
+  fio_str_info_s r = {0};
+  for (size_t i = 0; i < route->count; ++i)
+    if (FIO_STR_INFO_IS_EQ(route->param[i].name, name))
+      return route->param[i].value;
+  return r;
+}
+
+/* *****************************************************************************
+Implementation - possibly externed functions.
+***************************************************************************** */
+#if defined(FIO_EXTERN_COMPLETE) || !defined(FIO_EXTERN)
+
+/*
+REMEMBER:
+========
+
+All memory allocations should use:
+* FIO_MEM_REALLOC_(ptr, old_size, new_size, copy_len)
+* FIO_MEM_FREE_(ptr, size)
+
+*/
+
+/* *****************************************************************************
+Router Types
+
+Routes are added to a (mutable) radix tree, which is compiled on first use to a
+compact, read only, array of nodes sharing a single string pool.
+
+In the compiled tree, the static children of a node are stored consecutively
+(sorted by their first byte) and their first bytes are stored consecutively in
+the string pool, so a child is found using a single `memchr`.
+***************************************************************************** */
+
+typedef void (*fio___http_route_fn)(fio_http_s *, fio_http_route_s *);
+
+/* a route's handler for a specific method */
+typedef struct {
+  char *method; /* NULL == any method (a fio_bstr while building) */
+  fio___http_route_fn on_http;
+  void *udata;
+} fio___http_router_handler_s;
+
+/* a node in the (mutable) radix tree */
+typedef struct fio___http_router_tnode_s {
+  struct fio___http_router_tnode_s **children;
+  struct fio___http_router_tnode_s *param;
+  struct fio___http_router_tnode_s *wildcard;
+  fio___http_router_handler_s *handlers;
+  char *prefix; /* fio_bstr (static nodes) */
+  char *name;   /* fio_bstr (parameter / wildcard nodes) */
+  uint32_t children_len;
+  uint32_t handlers_len;
+} fio___http_router_tnode_s;
+
+/* a node in the compiled radix tree (offsets are into the string pool) */
+typedef struct {
+  uint32_t prefix;
+  uint32_t prefix_len;
+  uint32_t chars; /* the first byte of each static child */
+  uint32_t children;
+  uint32_t children_len;
+  uint32_t param;    /* 0 == none (the root is never a child) */
+  uint32_t wildcard; /* 0 == none */
+  uint32_t name;
+  uint32_t name_len;
+  uint32_t handlers;
+  uint32_t handlers_len;
+} fio___http_router_node_s;
+
+/* a handler in the compiled radix tree (offsets are into the string pool) */
+typedef struct {
+  uint32_t method;
+  uint32_t method_len; /* 0 == any method */
+  fio___http_route_fn on_http;
+  void *udata;
+} fio___http_router_chandler_s;
+
+struct fio_http_router_s {
+  fio_http_router_settings_s settings;
+  fio___http_router_tnode_s root;
+  /* the compiled tree */
+  fio___http_router_node_s *nodes;
+  fio___http_router_chandler_s *handlers;
+  char *pool;
+  size_t nodes_len;
+  size_t handlers_len;
+  size_t pool_len;
+  fio_lock_i lock;
+  uint8_t compiled;
+  char public_folder[];
+};
+
+FIO_LEAK_COUNTER_DEF(fio_http_router_s)
+
+/* *****************************************************************************
+Router - Building the Tree
+***************************************************************************** */
+
+FIO_SFUNC fio___http_router_tnode_s *fio___http_router_tnode_new(void) {
+  fio___http_router_tnode_s *n = (fio___http_router_tnode_s *)FIO_MEM_REALLOC_(
+      NULL,
+      0,
+      sizeof(*n),
+      0);
+  if (n)
+    *n = (fio___http_router_tnode_s){0};
+  return n;
+}
+
+FIO_SFUNC void fio___http_router_tnode_destroy(fio___http_router_tnode_s *n) {
+  for (size_t i = 0; i < n->children_len; ++i) {
+    fio___http_router_tnode_destroy(n->children[i]);
+    FIO_MEM_FREE_(n->children[i], sizeof(*n->children[i]));
+  }
+  FIO_MEM_FREE_(n->children, sizeof(*n->children) * n->children_len);
+  if (n->param) {
+    fio___http_router_tnode_destroy(n->param);
+    FIO_MEM_FREE_(n->param, sizeof(*n->param));
+  }
+  if (n->wildcard) {
+    fio___http_router_tnode_destroy(n->wildcard);
+    FIO_MEM_FREE_(n->wildcard, sizeof(*n->wildcard));
+  }
+  for (size_t i = 0; i < n->handlers_len; ++i)
+    fio_bstr_free(n->handlers[i].method);
+  FIO_MEM_FREE_(n->handlers, sizeof(*n->handlers) * n->handlers_len);
+  fio_bstr_free(n->prefix);
+  fio_bstr_free(n->name);
+  *n = (fio___http_router_tnode_s){0};
+}
+
+/* adds a static child node with `prefix`, returns NULL on error. */
+FIO_SFUNC fio___http_router_tnode_s *fio___http_router_tnode_child(
+    fio___http_router_tnode_s *n,
+    const char *prefix,
+    size_t len) {
+  fio___http_router_tnode_s *c = fio___http_router_tnode_new();
+  fio___http_router_tnode_s **tmp;
+  if (!c)
+    return c;
+  tmp = (fio___http_router_tnode_s **)FIO_MEM_REALLOC_(
+      n->children,
+      sizeof(*tmp) * n->children_len,
+      sizeof(*tmp) * (n->children_len + 1),
+      sizeof(*tmp) * n->children_len);
+  if (!tmp) {
+    FIO_MEM_FREE_(c, sizeof(*c));
+    return NULL;
+  }
+  n->children = tmp;
+  n->children[n->children_len++] = c;
+  c->prefix = fio_bstr_write(NULL, prefix, len);
+  return c;
+}
+
+/* splits a static node's prefix at `at` (the node keeps the prefix's head). */
+FIO_SFUNC int fio___http_router_tnode_split(fio___http_router_tnode_s *n,
+                                            size_t at) {
+  fio___http_router_tnode_s *tail = fio___http_router_tnode_new();
+  fio___http_router_tnode_s **children =
+      (fio___http_router_tnode_s **)FIO_MEM_REALLOC_(NULL,
+                                                     0,
+                                                     sizeof(*children),
+                                                     0);
+  char *prefix = n->prefix;
+  if (!tail || !children) {
+    FIO_MEM_FREE_(tail, sizeof(*tail));
+    FIO_MEM_FREE_(children, sizeof(*children));
+    return -1;
+  }
+  *tail = *n; /* the tail inherits the children and handlers */
+  tail->prefix = fio_bstr_write(NULL, prefix + at, fio_bstr_len(prefix) - at);
+  *n = (fio___http_router_tnode_s){0};
+  n->prefix = fio_bstr_write(NULL, prefix, at);
+  n->children = children;
+  n->children[0] = tail;
+  n->children_len = 1;
+  fio_bstr_free(prefix);
+  return 0;
+}
+
+/* adds the static part of a route to the tree, returns the last node. */
+FIO_SFUNC fio___http_router_tnode_s *fio___http_router_tnode_add(
+    fio___http_router_tnode_s *n,
+    const char *run,
+    size_t len) {
+  while (len) {
+    fio___http_router_tnode_s *child = NULL;
+    size_t common = 0, prefix_len;
+    for (size_t i = 0; i < n->children_len; ++i) {
+      if (n->children[i]->prefix[0] != run[0])
+        continue;
+      child = n->children[i];
+      break;
+    }
+    if (!child)
+      return fio___http_router_tnode_child(n, run, len);
+    prefix_len = fio_bstr_len(child->prefix);
+    while (common < prefix_len && common < len &&
+           child->prefix[common] == run[common])
+      ++common;
+    if (common < prefix_len && fio___http_router_tnode_split(child, common))
+      return NULL;
+    n = child;
+    run += common;
+    len -= common;
+  }
+  return n;
+}
+
+/* returns a parameter / wildcard node with the `name`, creating if missing. */
+FIO_SFUNC fio___http_router_tnode_s *fio___http_router_tnode_named(
+    fio___http_router_tnode_s **pn,
+    const char *name,
+    size_t len) {
+  if (!pn[0]) {
+    if (!(pn[0] = fio___http_router_tnode_new()))
+      return NULL;
+    pn[0]->name = fio_bstr_write(NULL, name, len);
+    return pn[0];
+  }
+  if (fio_bstr_len(pn[0]->name) != len || FIO_MEMCMP(pn[0]->name, name, len))
+    return NULL; /* a parameter can't have two names */
+  return pn[0];
+}
+
+/* frees the compiled tree (it's recompiled once routing begins). */
+FIO_SFUNC void fio___http_router_compiled_free(fio_http_router_s *r) {
+  FIO_MEM_FREE_(r->nodes, sizeof(*r->nodes) * r->nodes_len);
+  FIO_MEM_FREE_(r->handlers, sizeof(*r->handlers) * r->handlers_len);
+  FIO_MEM_FREE_(r->pool, r->pool_len + 1);
+  r->nodes = NULL;
+  r->handlers = NULL;
+  r->pool = NULL;
+  r->nodes_len = r->handlers_len = r->pool_len = 0;
+  fio_atomic_exchange(&r->compiled, 0);
+}
+
+/* Adds a route to the router, returning -1 on error (invalid pattern). */
+SFUNC int fio_http_route FIO_NOOP(fio_http_router_s *r,
+                                  fio_http_route_args_s args) {
+  fio___http_router_tnode_s *n;
+  fio___http_router_handler_s *tmp;
+  const char *pos, *end;
+  size_t params = 0;
+  if (!r || !args.path || !args.on_http)
+    goto invalid;
+  n = &r->root;
+  pos = args.path;
+  end = pos + strlen(pos);
+  while (pos < end) {
+    const char *start = pos;
+    if ((pos[0] == ':' || pos[0] == '*') &&
+        (pos == args.path || pos[-1] == '/')) { /* parameter / wildcard */
+      ++start;
+      while (pos < end && *pos != '/')
+        ++pos;
+      if (++params > FIO_HTTP_ROUTER_MAX_PARAMS)
+        goto invalid;
+      if (start[-1] == '*') {
+        if (pos != end)
+          goto invalid; /* a wildcard must be the last segment */
+        n = fio___http_router_tnode_named(&n->wildcard,
+                                          start,
+                                          (size_t)(pos - start));
+      } else {
+        if (pos == start)
+          goto invalid; /* a parameter must be named */
+        n = fio___http_router_tnode_named(&n->param,
+                                          start,
+                                          (size_t)(pos - start));
+      }
+      if (!n)
+        goto invalid;
+      continue;
+    }
+    /* a static run, up to (and including) the `/` before the next parameter */
+    while (pos < end && !(pos[0] == '/' && (pos[1] == ':' || pos[1] == '*')))
+      ++pos;
+    pos += (pos < end);
+    if (!(n = fio___http_router_tnode_add(n, start, (size_t)(pos - start))))
+      goto invalid;
+  }
+  fio___http_router_compiled_free(r);
+  for (size_t i = 0; i < n->handlers_len; ++i) { /* replace existing? */
+    if (!n->handlers[i].method != !args.method ||
+        (args.method && strcmp(n->handlers[i].method, args.method)))
+      continue;
+    n->handlers[i].on_http = args.on_http;
+    n->handlers[i].udata = args.udata;
+    return 0;
+  }
+  tmp = (fio___http_router_handler_s *)FIO_MEM_REALLOC_(
+      n->handlers,
+      sizeof(*tmp) * n->handlers_len,
+      sizeof(*tmp) * (n->handlers_len + 1),
+      sizeof(*tmp) * n->handlers_len);
+  if (!tmp)
+    goto invalid;
+  n->handlers = tmp;
+  n->handlers[n->handlers_len++] = (fio___http_router_handler_s){
+      .method = (args.method
+                     ? fio_bstr_write(NULL, args.method, strlen(args.method))
+                     : NULL),
+      .on_http = args.on_http,
+      .udata = args.udata,
+  };
+  return 0;
+
+invalid:
+  FIO_LOG_ERROR("(http router) couldn't add route: %s %s",
+                (args.method ? args.method : "*"),
+                (args.path ? args.path : "(NULL)"));
+  return -1;
+}
+
+/* *****************************************************************************
+Router - Compiling the Tree
+***************************************************************************** */
+
+/* counts the nodes, handlers and string pool length required for a tree. */
+FIO_SFUNC void fio___http_router_tnode_count(fio___http_router_tnode_s *n,
+                                             size_t *nodes,
+                                             size_t *handlers,
+                                             size_t *pool) {
+  ++nodes[0];
+  handlers[0] += n->handlers_len;
+  pool[0] += fio_bstr_len(n->prefix) + fio_bstr_len(n->name) + n->children_len;
+  for (size_t i = 0; i < n->handlers_len; ++i)
+    pool[0] += fio_bstr_len(n->handlers[i].method);
+  for (size_t i = 0; i < n->children_len; ++i)
+    fio___http_router_tnode_count(n->children[i], nodes, handlers, pool);
+  if (n->param)
+    fio___http_router_tnode_count(n->param, nodes, handlers, pool);
+  if (n->wildcard)
+    fio___http_router_tnode_count(n->wildcard, nodes, handlers, pool);
+}
+
+/* copies a fio_bstr to the string pool, returning its offset. */
+FIO_IFUNC uint32_t fio___http_router_pool_write(fio_http_router_s *r,
+                                                const char *bstr) {
+  uint32_t offset = (uint32_t)r->pool_len;
+  size_t len = fio_bstr_len(bstr);
+  if (len)
+    FIO_MEMCPY(r->pool + offset, bstr, len);
+  r->pool_len += len;
+  return offset;
+}
+
+/* compiles the tree into consecutive arrays (breadth first). */
+FIO_SFUNC int fio___http_router_compile(fio_http_router_s *r) {
+  size_t nodes_len = 0, handlers_len = 0, pool_len = 0, next = 1;
+  fio___http_router_tnode_s **map;
+  fio___http_router_tnode_count(&r->root, &nodes_len, &handlers_len, &pool_len);
+  map = (fio___http_router_tnode_s **)
+      FIO_MEM_REALLOC_(NULL, 0, sizeof(*map) * nodes_len, 0);
+  r->nodes = (fio___http_router_node_s *)
+      FIO_MEM_REALLOC_(NULL, 0, sizeof(*r->nodes) * nodes_len, 0);
+  r->handlers = (fio___http_router_chandler_s *)
+      FIO_MEM_REALLOC_(NULL, 0, sizeof(*r->handlers) * (handlers_len + 1), 0);
+  r->pool = (char *)FIO_MEM_REALLOC_(NULL, 0, pool_len + 1, 0);
+  r->nodes_len = nodes_len;
+  r->handlers_len = handlers_len + 1;
+  r->pool_len = pool_len;
+  if (!map || !r->nodes || !r->handlers || !r->pool) {
+    FIO_MEM_FREE_(map, sizeof(*map) * nodes_len);
+    fio___http_router_compiled_free(r);
+    return -1;
+  }
+  r->handlers_len = r->pool_len = 0;
+  map[0] = &r->root;
+  for (size_t i = 0; i < next; ++i) {
+    fio___http_router_tnode_s *t = map[i];
+    fio___http_router_node_s *n = r->nodes + i;
+    uint32_t prefix, name;
+    /* sort static children by their first byte (insertion sort) */
+    for (size_t j = 1; j < t->children_len; ++j) {
+      fio___http_router_tnode_s *c = t->children[j];
+      const uint8_t first = (uint8_t)c->prefix[0];
+      size_t k = j;
+      for (; k && (uint8_t)t->children[k - 1]->prefix[0] > first; --k)
+        t->children[k] = t->children[k - 1];
+      t->children[k] = c;
+    }
+    /* initializer evaluation order is unspecified, so write strings first */
+    prefix = fio___http_router_pool_write(r, t->prefix);
+    name = fio___http_router_pool_write(r, t->name);
+    *n = (fio___http_router_node_s){
+        .prefix = prefix,
+        .prefix_len = (uint32_t)fio_bstr_len(t->prefix),
+        .name = name,
+        .name_len = (uint32_t)fio_bstr_len(t->name),
+        .chars = (uint32_t)r->pool_len,
+        .children = (uint32_t)next,
+        .children_len = t->children_len,
+        .handlers = (uint32_t)r->handlers_len,
+        .handlers_len = t->handlers_len,
+    };
+    for (size_t j = 0; j < t->children_len; ++j) {
+      r->pool[r->pool_len++] = t->children[j]->prefix[0];
+      map[next++] = t->children[j];
+    }
+    if (t->param) {
+      n->param = (uint32_t)next;
+      map[next++] = t->param;
+    }
+    if (t->wildcard) {
+      n->wildcard = (uint32_t)next;
+      map[next++] = t->wildcard;
+    }
+    for (size_t j = 0; j < t->handlers_len; ++j) {
+      r->handlers[r->handlers_len++] = (fio___http_router_chandler_s){
+          .method = fio___http_router_pool_write(r, t->handlers[j].method),
+          .method_len = (uint32_t)fio_bstr_len(t->handlers[j].method),
+          .on_http = t->handlers[j].on_http,
+          .udata = t->handlers[j].udata,
+      };
+    }
+  }
+  r->handlers_len = handlers_len + 1; /* the allocated length */
+  r->pool[r->pool_len] = 0;
+  FIO_MEM_FREE_(map, sizeof(*map) * nodes_len);
+  return 0;
+}
+
+/* *****************************************************************************
+Router - Matching
+***************************************************************************** */
+
+/* adds a parameter to the route, returns -1 if there's no more room. */
+FIO_IFUNC int fio___http_router_capture(fio_http_router_s *r,
+                                        fio_http_route_s *route,
+                                        const fio___http_router_node_s *n,
+                                        const char *value,
+                                        size_t len) {
+  if (route->count == FIO_HTTP_ROUTER_MAX_PARAMS)
+    return -1;
+  route->param[route->count].name =
+      FIO_STR_INFO2(r->pool + n->name, n->name_len);
+  route->param[route->count].value = FIO_STR_INFO2((char *)value, len);
+  ++route->count;
+  return 0;
+}
+
+/* the state of a single lookup. */
+typedef struct {
+  fio_http_router_s *r;
+  fio_http_route_s *route;
+  fio_str_info_s method;
+  const char *path;
+  size_t len;
+  /* set if the path matched a route that doesn't accept the method */
+  int not_allowed;
+} fio___http_router_lookup_s;
+
+/* selects the node's handler for the method (NULL if not allowed). */
+FIO_SFUNC const fio___http_router_chandler_s *fio___http_router_handler(
+    fio___http_router_lookup_s *l,
+    const fio___http_router_node_s *n) {
+  const fio___http_router_chandler_s *h = l->r->handlers + n->handlers;
+  const fio___http_router_chandler_s *end = h + n->handlers_len;
+  const fio___http_router_chandler_s *any = NULL, *get = NULL;
+  for (; h < end; ++h) {
+    if (!h->method_len) {
+      any = h;
+      continue;
+    }
+    if (h->method_len == l->method.len &&
+        !FIO_MEMCMP(l->r->pool + h->method, l->method.buf, l->method.len))
+      return h;
+    if (h->method_len == 3 && !FIO_MEMCMP(l->r->pool + h->method, "GET", 3))
+      get = h;
+  }
+  /* HEAD requests are routed to GET handlers (unless routed explicitly) */
+  if (get && l->method.len == 4 && !FIO_MEMCMP(l->method.buf, "HEAD", 4))
+    return get;
+  l->not_allowed |= !any;
+  return any;
+}
+
+/* finds the handler matching the path (static > parameter > wildcard). */
+FIO_SFUNC const fio___http_router_chandler_s *fio___http_router_match(
+    fio___http_router_lookup_s *l,
+    const fio___http_router_node_s *n,
+    size_t pos) {
+  fio_http_router_s *r = l->r;
+  for (;;) {
+    const fio___http_router_node_s *next = NULL;
+    const fio___http_router_chandler_s *found = NULL;
+    const size_t count = l->route->count;
+    if (n->prefix_len) {
+      if (l->len - pos < n->prefix_len ||
+          FIO_MEMCMP(l->path + pos, r->pool + n->prefix, n->prefix_len))
+        return NULL;
+      pos += n->prefix_len;
+    }
+    if (pos == l->len) {
+      if (n->handlers_len && (found = fio___http_router_handler(l, n)))
+        return found;
+      if (!n->wildcard)
+        return NULL;
+      n = r->nodes + n->wildcard; /* a wildcard may match an empty path */
+      if (!n->handlers_len ||
+          fio___http_router_capture(r, l->route, n, l->path + pos, 0) ||
+          !(found = fio___http_router_handler(l, n)))
+        l->route->count = count;
+      return found;
+    }
+    if (n->children_len) {
+      const char *c = (const char *)
+          FIO_MEMCHR(r->pool + n->chars, l->path[pos], n->children_len);
+      if (c)
+        next = r->nodes + n->children + (size_t)(c - (r->pool + n->chars));
+    }
+    if (!(n->param | n->wildcard)) { /* no alternatives, no need to recurse */
+      if (!next)
+        return NULL;
+      n = next;
+      continue;
+    }
+    if (next && (found = fio___http_router_match(l, next, pos)))
+      return found;
+    l->route->count = count;
+    if (n->param) {
+      const fio___http_router_node_s *p = r->nodes + n->param;
+      const char *e =
+          (const char *)FIO_MEMCHR(l->path + pos, '/', l->len - pos);
+      size_t seg_end = e ? (size_t)(e - l->path) : l->len;
+      if (seg_end > pos &&
+          !fio___http_router_capture(r,
+                                     l->route,
+                                     p,
+                                     l->path + pos,
+                                     seg_end - pos) &&
+          (found = fio___http_router_match(l, p, seg_end)))
+        return found;
+      l->route->count = count;
+    }
+    if (n->wildcard) {
+      const fio___http_router_node_s *w = r->nodes + n->wildcard;
+      if (w->handlers_len &&
+          !fio___http_router_capture(r,
+                                     l->route,
+                                     w,
+                                     l->path + pos,
+                                     l->len - pos) &&
+          (found = fio___http_router_handler(l, w)))
+        return found;
+      l->route->count = count;
+    }
+    return NULL;
+  }
+}
+
+/* Finds the route for the `method` and `path`, filling in `route`. */
+SFUNC int fio_http_router_find(fio_http_router_s *r,
+                               fio_http_route_s *route,
+                               fio_str_info_s method,
+                               fio_str_info_s path) {
+  const fio___http_router_chandler_s *h;
+  uint8_t compiled;
+  fio___http_router_lookup_s l = {
+      .r = r,
+      .route = route,
+      .method = method,
+      .path = path.buf,
+      .len = path.len,
+  };
+  route->on_http = NULL;
+  route->udata = NULL;
+  route->count = 0;
+  if (!r)
+    return 404;
+  fio_atomic_load(compiled, &r->compiled);
+  if (FIO_UNLIKELY(!compiled)) {
+    /* the tree is published (atomic store) only once fully compiled */
+    fio_lock(&r->lock);
+    if (!r->compiled && !fio___http_router_compile(r))
+      fio_atomic_exchange(&r->compiled, 1);
+    fio_unlock(&r->lock);
+    fio_atomic_load(compiled, &r->compiled);
+    if (!compiled)
+      return 404;
+  }
+  h = fio___http_router_match(&l, r->nodes, 0);
+  if (!h)
+    return (l.not_allowed ? 405 : 404);
+  route->on_http = h->on_http;
+  route->udata = h->udata;
+  return 0;
+}
+
+/* Routes the HTTP request using the router, calling the route's handler. */
+SFUNC int fio_http_router_dispatch(fio_http_router_s *r, fio_http_s *h) {
+  fio_http_route_s route;
+  int result =
+      fio_http_router_find(r, &route, fio_http_method(h), fio_http_path(h));
+  if (!result)
+    route.on_http(h, &route);
+  return result;
+}
+
+/* An `on_http` callback that routes requests using `fio_http_udata`. */
+SFUNC void fio_http_router_on_http(fio_http_s *h) {
+  fio_http_router_s *r = (fio_http_router_s *)fio_http_udata(h);
+  fio_str_info_s method;
+  int result = fio_http_router_dispatch(r, h);
+  if (!result)
+    return;
+  method = fio_http_method(h);
+  if (r && r->settings.public_folder.len &&
+      ((method.len == 3 && !FIO_MEMCMP(method.buf, "GET", 3)) ||
+       (method.len == 4 && !FIO_MEMCMP(method.buf, "HEAD", 4))) &&
+      !fio_http_static_file_response(h,
+                                     r->settings.public_folder,
+                                     fio_http_path(h),
+                                     r->settings.max_age))
+    return;
+  if (r && r->settings.on_not_found) {
+    r->settings.on_not_found(h);
+    return;
+  }
+  fio_http_send_error_response(h, (size_t)result);
+}
+
+/* *****************************************************************************
+Router - Constructor / Destructor
+***************************************************************************** */
+
+/* Creates a new HTTP Router. */
+SFUNC fio_http_router_s *fio_http_router_new FIO_NOOP(
+    fio_http_router_settings_s settings) {
+  fio_http_router_s *r;
+  if (settings.public_folder.len > 1 &&
+      settings.public_folder.buf[settings.public_folder.len - 1] == '/')
+    --settings.public_folder.len;
+  r = (fio_http_router_s *)FIO_MEM_REALLOC_(NULL,
+                                            0,
+                                            sizeof(*r) +
+                                                settings.public_folder.len + 1,
+                                            0);
+  if (!r)
+    return r;
+  FIO_LEAK_COUNTER_ON_ALLOC(fio_http_router_s);
+  *r = (fio_http_router_s){.settings = settings};
+  if (settings.public_folder.len)
+    FIO_MEMCPY(r->public_folder,
+               settings.public_folder.buf,
+               settings.public_folder.len);
+  r->public_folder[settings.public_folder.len] = 0;
+  r->settings.public_folder.buf = r->public_folder;
+  return r;
+}
+
+/* Frees an HTTP Router. */
+SFUNC void fio_http_router_free(fio_http_router_s *r) {
+  if (!r)
+    return;
+  FIO_LEAK_COUNTER_ON_FREE(fio_http_router_s);
+  fio___http_router_compiled_free(r);
+  fio___http_router_tnode_destroy(&r->root);
+  FIO_MEM_FREE_(r, sizeof(*r) + r->settings.public_folder.len + 1);
+}
+
+/* *****************************************************************************
+HTTP Router - cleanup
+***************************************************************************** */
+#endif /* FIO_EXTERN_COMPLETE */
+#undef FIO_HTTP_ROUTER
+#endif /* FIO_HTTP_ROUTER */
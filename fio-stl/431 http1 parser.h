@@ -180,6 +180,294 @@ static int fio_http1___finish(fio_http1_parser_s *p,
   return 1;
 }
 
+/* *****************************************************************************
+Line Indexing (SIMD block scanner or memchr)
+
+With AVX2 or NEON, header data is classified 64 bytes at a time, producing a
+bitmap (one bit per byte) for control characters (anything below 0x20, as well
+as DEL) and for dividers (`' '` in the first line and `':'` in header lines).
+
+Line endings are control characters, so the first control character in a line
+is usually the CR (or LF) ending the line. The scanner keeps two consecutive
+blocks, so any line shorter than 64 bytes is indexed using a single (position
+relative) bitmap, without searching the data. Lines with other control
+characters are tested again byte by byte, since only HT is allowed.
+
+Narrower vectors (SSE2) and SWAR are slower than the C library's `memchr`, so
+other builds index lines using `memchr` and test every line for control
+characters (8 bytes at a time), so both paths accept the same requests.
+***************************************************************************** */
+
+#if (FIO___HAS_X86_INTRIN && defined(__AVX2__)) ||                             \
+    (FIO___HAS_ARM_INTRIN && defined(__aarch64__))
+#define FIO___HTTP1_SCANNER 1
+#else
+#define FIO___HTTP1_SCANNER 0
+#endif
+
+/** A line, as indexed by the block scanner / memchr (internal use). */
+typedef struct {
+  /** The first and second dividers in the line (or NULL). */
+  char *div[2];
+  /** The position of the `'\n'` ending the line. */
+  char *eol;
+  /** Non-zero if the line might contain control characters (besides CRLF). */
+  int ctl;
+} fio___http1_line_s;
+
+/* marks (0x80) every zero byte in a 64 bit word (no false positives). */
+FIO_IFUNC uint64_t fio___http1_swar_zero(uint64_t w) {
+  const uint64_t m = UINT64_C(0x7F7F7F7F7F7F7F7F);
+  return ~(((w & m) + m) | w | m);
+}
+
+#if FIO___HTTP1_SCANNER
+
+/** The bitmaps for a single 64 byte block (bit `i` maps to byte `i`). */
+typedef struct {
+  /** Marks control bytes (including CR and LF). */
+  uint64_t ctl;
+  /** Marks divider bytes. */
+  uint64_t div;
+} fio___http1_bitmap_s;
+
+/** The HTTP/1.x block scanner (internal use). */
+typedef struct {
+  /** The first byte of the current block (the next block follows). */
+  char *block;
+  /** The end of the data available for scanning. */
+  char *end;
+  /** The bitmaps for the current and the next block. */
+  fio___http1_bitmap_s map[2];
+  /** The divider byte value. */
+  uint8_t div_char;
+} fio___http1_scanner_s;
+
+#if FIO___HAS_X86_INTRIN
+/* classifies 64 bytes using AVX2 (2 x 32 byte vectors). */
+FIO_IFUNC void fio___http1_scan_block(fio___http1_bitmap_s *m,
+                                      const char *p,
+                                      uint8_t div_char) {
+  const __m256i v_div = _mm256_set1_epi8((char)div_char);
+  const __m256i v_us = _mm256_set1_epi8(0x1F);
+  const __m256i v_del = _mm256_set1_epi8(0x7F);
+  uint64_t div = 0, ctl = 0;
+  for (size_t i = 0; i < 64; i += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+    __m256i c = _mm256_or_si256(
+        _mm256_cmpeq_epi8(_mm256_min_epu8(v, v_us), v), /* v <= 0x1F */
+        _mm256_cmpeq_epi8(v, v_del));
+    div |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, v_div))
+           << i;
+    ctl |= (uint64_t)(uint32_t)_mm256_movemask_epi8(c) << i;
+  }
+  m->div = div;
+  m->ctl = ctl;
+}
+
+#else
+/* packs four NEON comparison results (0xFF / 0x00 bytes) into a bitmap. */
+FIO_IFUNC uint64_t fio___http1_neon2bitmap(uint8x16_t a,
+                                           uint8x16_t b,
+                                           uint8x16_t c,
+                                           uint8x16_t d) {
+  const uint8x16_t bits =
+      {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+  a = vpaddq_u8(vandq_u8(a, bits), vandq_u8(b, bits));
+  c = vpaddq_u8(vandq_u8(c, bits), vandq_u8(d, bits));
+  a = vpaddq_u8(a, c);
+  a = vpaddq_u8(a, a);
+  return vgetq_lane_u64(vreinterpretq_u64_u8(a), 0);
+}
+
+/* classifies 64 bytes using NEON (4 x 16 byte vectors). */
+FIO_IFUNC void fio___http1_scan_block(fio___http1_bitmap_s *m,
+                                      const char *p,
+                                      uint8_t div_char) {
+  const uint8x16_t v_div = vdupq_n_u8(div_char);
+  const uint8x16_t v_us = vdupq_n_u8(0x1F);
+  const uint8x16_t v_del = vdupq_n_u8(0x7F);
+  uint8x16_t d[4], c[4];
+  for (size_t i = 0; i < 4; ++i) {
+    uint8x16_t v = vld1q_u8((const uint8_t *)p + (i << 4));
+    d[i] = vceqq_u8(v, v_div);
+    c[i] = vorrq_u8(vcleq_u8(v, v_us), vceqq_u8(v, v_del));
+  }
+  m->div = fio___http1_neon2bitmap(d[0], d[1], d[2], d[3]);
+  m->ctl = fio___http1_neon2bitmap(c[0], c[1], c[2], c[3]);
+}
+
+#endif /* FIO___HAS_X86_INTRIN */
+
+/* classifies the (up to) 64 bytes starting at `pos`. */
+FIO_SFUNC void fio___http1_scan_load(fio___http1_scanner_s *s,
+                                     fio___http1_bitmap_s *m,
+                                     char *pos) {
+  char tmp[64] FIO_ALIGN(16);
+  if (FIO_LIKELY(s->end - pos >= 64)) {
+    fio___http1_scan_block(m, pos, s->div_char);
+    return;
+  }
+  if (pos >= s->end) {
+    *m = (fio___http1_bitmap_s){0};
+    return;
+  }
+  /* partial block: the zero padding is never part of a complete line */
+  FIO_MEMSET(tmp, 0, 64);
+  FIO_MEMCPY(tmp, pos, (size_t)(s->end - pos));
+  fio___http1_scan_block(m, tmp, s->div_char);
+}
+
+/* initializes the scanner and classifies the first two blocks of data. */
+FIO_IFUNC void fio___http1_scan_init(fio___http1_scanner_s *s,
+                                     char *start,
+                                     char *end,
+                                     uint8_t div_char) {
+  s->block = start;
+  s->end = end;
+  s->div_char = div_char;
+  fio___http1_scan_load(s, s->map, start);
+  fio___http1_scan_load(s, s->map + 1, start + 64);
+}
+
+/* moves the scanner forward until `pos` is in the current block. */
+FIO_IFUNC void fio___http1_scan_advance(fio___http1_scanner_s *s, char *pos) {
+  while (pos >= s->block + 64) {
+    s->block += 64;
+    s->map[0] = s->map[1];
+    fio___http1_scan_load(s, s->map + 1, s->block + 64);
+  }
+}
+
+/* collects the bitmaps for the 64 bytes starting at `pos` (in the window). */
+FIO_IFUNC fio___http1_bitmap_s fio___http1_scan_at(fio___http1_scanner_s *s,
+                                                   char *pos) {
+  /* note: `(x << 1) << (63 - i)` avoids an undefined shift when `i == 0` */
+  const size_t i = (size_t)(pos - s->block);
+  fio___http1_bitmap_s r = {
+      .div = (s->map[0].div >> i) | ((s->map[1].div << 1) << (63 - i)),
+      .ctl = (s->map[0].ctl >> i) | ((s->map[1].ctl << 1) << (63 - i)),
+  };
+  return r;
+}
+
+/* indexes a line that is long or contains control characters (see below). */
+FIO_SFUNC int fio___http1_scan_line_long(fio___http1_scanner_s *s,
+                                         char *pos,
+                                         fio___http1_line_s *l) {
+  size_t found = 0;
+  l->div[0] = l->div[1] = NULL;
+  l->ctl = 0;
+  for (;;) {
+    fio___http1_bitmap_s m;
+    uint64_t map = ~(uint64_t)0;
+    if (pos >= s->end)
+      return -1;
+    fio___http1_scan_advance(s, pos);
+    m = fio___http1_scan_at(s, pos);
+    for (; m.ctl; m.ctl &= m.ctl - 1) {
+      char *c = pos + fio_lsb_index_unsafe(m.ctl);
+      if (c >= s->end)
+        return -1;
+      if (*c == '\n') { /* limit the map to the bytes preceding the LF */
+        map = (m.ctl & (0 - m.ctl)) - 1;
+        l->eol = c;
+        break;
+      }
+      l->ctl |= (*c != '\r' || c + 1 == s->end || c[1] != '\n');
+    }
+    for (m.div &= map; m.div && found < 2; m.div &= m.div - 1)
+      l->div[found++] = pos + fio_lsb_index_unsafe(m.div);
+    if (m.ctl)
+      return 0;
+    pos += 64;
+  }
+}
+
+/* indexes the line starting at `pos`, returns -1 if it is incomplete. */
+FIO_IFUNC int fio___http1_scan_line(fio___http1_scanner_s *s,
+                                    char *pos,
+                                    fio___http1_line_s *l) {
+  fio___http1_bitmap_s m;
+  uint64_t div;
+  size_t i;
+  fio___http1_scan_advance(s, pos);
+  m = fio___http1_scan_at(s, pos);
+  if (FIO_UNLIKELY(!m.ctl))
+    return fio___http1_scan_line_long(s, pos, l);
+  /* fast path - the first control character is a CR or LF ending the line */
+  i = fio_lsb_index_unsafe(m.ctl);
+  if (FIO_UNLIKELY(pos + i + 1 >= s->end))
+    return fio___http1_scan_line_long(s, pos, l);
+  i += (pos[i] == '\r' && pos[i + 1] == '\n');
+  if (FIO_UNLIKELY(pos[i] != '\n'))
+    return fio___http1_scan_line_long(s, pos, l);
+  div = m.div & ((m.ctl & (0 - m.ctl)) - 1);
+  l->eol = pos + i;
+  l->div[0] = div ? pos + fio_lsb_index_unsafe(div) : NULL;
+  div &= div - 1;
+  l->div[1] = div ? pos + fio_lsb_index_unsafe(div) : NULL;
+  l->ctl = 0;
+  return 0;
+}
+
+#else /* FIO___HTTP1_SCANNER */
+
+/** The HTTP/1.x line indexer, using memchr (internal use). */
+typedef struct {
+  /** The end of the data available for scanning. */
+  char *end;
+  /** The divider byte value. */
+  uint8_t div_char;
+} fio___http1_scanner_s;
+
+FIO_IFUNC void fio___http1_scan_init(fio___http1_scanner_s *s,
+                                     char *start,
+                                     char *end,
+                                     uint8_t div_char) {
+  s->end = end;
+  s->div_char = div_char;
+  (void)start;
+}
+
+/* indexes the line starting at `pos`, returns -1 if it is incomplete. */
+FIO_IFUNC int fio___http1_scan_line(fio___http1_scanner_s *s,
+                                    char *pos,
+                                    fio___http1_line_s *l) {
+  l->eol = (char *)FIO_MEMCHR(pos, '\n', (size_t)(s->end - pos));
+  if (!l->eol)
+    return -1;
+  l->div[0] = (char *)FIO_MEMCHR(pos, s->div_char, (size_t)(l->eol - pos));
+  l->div[1] = NULL;
+  l->ctl = 1; /* untested, see fio___http1_ctl_test */
+  /* only the first line (divided by spaces) requires a second divider */
+  if (l->div[0] && s->div_char == ' ')
+    l->div[1] = (char *)FIO_MEMCHR(l->div[0] + 1,
+                                   ' ',
+                                   (size_t)(l->eol - (l->div[0] + 1)));
+  return 0;
+}
+#endif /* FIO___HTTP1_SCANNER */
+
+/* marks (0x80) every byte below 0x20 or equal to DEL (0x7F) in a word. */
+FIO_IFUNC uint64_t fio___http1_swar_ctl(uint64_t w) {
+  const uint64_t m = UINT64_C(0x7F7F7F7F7F7F7F7F);
+  return (~(((w & m) + UINT64_C(0x6060606060606060)) | w | m)) |
+         fio___http1_swar_zero(w ^ m);
+}
+
+/* tests a line for forbidden control characters (only HT is allowed). */
+FIO_SFUNC int fio___http1_ctl_test(char *start, char *eol) {
+  for (; start + 8 <= eol; start += 8) /* HT is rare, test it byte by byte */
+    if (FIO_UNLIKELY(fio___http1_swar_ctl(fio_buf2u64u(start))))
+      break;
+  for (; start < eol; ++start)
+    if (FIO_UNLIKELY(((uint8_t)start[0] < 0x20 && start[0] != '\t') ||
+                     (uint8_t)start[0] == 0x7F))
+      return -1;
+  return 0;
+}
+
 /* *****************************************************************************
 Reading the first line
 ***************************************************************************** */
@@ -190,38 +478,43 @@ static int fio_http1___start(fio_http1_parser_s *p,
                              void *udata) {
   /* find line start/end and test */
   fio_buf_info_s wrd[3];
+  fio___http1_scanner_s s;
+  fio___http1_line_s l;
   char *start = buf->buf;
-  char *tmp;
-  while ((start[0] == ' ' || start[0] == '\r' || start[0] == '\n') &&
-         start < buf->buf + buf->len) /* skip white space */
-    ++start;
-  if (start == buf->buf + buf->len) {
+  char *end = buf->buf + buf->len;
+  char *eol;
+  while (start < end &&
+         (start[0] == ' ' || start[0] == '\r' || start[0] == '\n'))
+    ++start; /* skip white space */
+  if (start == end) {
     buf->buf = start;
+    buf->len = 0;
     return 1;
   }
-  char *eol = (char *)FIO_MEMCHR(start, '\n', buf->len);
-  if (!eol)
+  fio___http1_scan_init(&s, start, end, ' ');
+  if (fio___http1_scan_line(&s, start, &l))
     return 1;
+  eol = l.eol;
   if (start + 13 > eol) /* test for minimal data GET HTTP/1 or ### HTTP/1 */
     return -1;
+  if (!l.div[1])
+    return -1;
 
   /* prep next stage */
   buf->len -= (eol - buf->buf) + 1;
   buf->buf = eol + 1;
   eol -= eol[-1] == '\r';
+  if (FIO_UNLIKELY(l.ctl && fio___http1_ctl_test(start, eol)))
+    return -1;
 
   /* parse first line */
   /* request: method path version ; response: version code txt */
-  if (!(tmp = (char *)FIO_MEMCHR(start, ' ', (size_t)(eol - start))))
-    return -1;
-  wrd[0] = FIO_BUF_INFO2(start, (size_t)(tmp - start));
-  start = tmp + 1;
-  if (!(tmp = (char *)FIO_MEMCHR(start, ' ', eol - start)))
-    return -1;
-  wrd[1] = FIO_BUF_INFO2(start, (size_t)(tmp - start));
-  start = tmp + 1;
-  if (start >= eol)
+  if (l.div[1] + 1 >= eol)
     return -1;
+  wrd[0] = FIO_BUF_INFO2(start, (size_t)(l.div[0] - start));
+  start = l.div[0] + 1;
+  wrd[1] = FIO_BUF_INFO2(start, (size_t)(l.div[1] - start));
+  start = l.div[1] + 1;
   wrd[2] = FIO_BUF_INFO2(start, (size_t)(eol - start));
   if (fio_c2i(wrd[1].buf[0]) < 10) /* test if path or code */
     goto parse_response_line;
@@ -346,13 +639,13 @@ static inline int fio_http1___on_trailer(fio_http1_parser_s *p,
 
 /* returns either a lower case (ASCI) or the original char. */
 static uint8_t fio_http1_tolower(uint8_t c) {
-  if ((c - ((uint8_t)'A' - 1U)) < ((uint8_t)'Z' - (uint8_t)'A'))
+  if ((uint8_t)(c - (uint8_t)'A') <= ((uint8_t)'Z' - (uint8_t)'A'))
     c |= 32;
   return c;
 }
 
-/* seeks to the ':' divisor while testing and converting to downcase. */
-static char *fio_http1___seek_header_div(char *p) {
+/* tests header name characters while converting the name to downcase. */
+FIO_SFUNC int fio___http1_name_prepare_slow(char *p, char *end) {
   /* this is the subset of the forbidden chars that allows UTF-8 headers */
   static const _Bool forbidden_name_chars[256] = {
       1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
@@ -366,15 +659,87 @@ static char *fio_http1___seek_header_div(char *p) {
       0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
       0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
       0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-  for (;;) {
+  for (; p < end; ++p) {
+    if (FIO_UNLIKELY(forbidden_name_chars[(uint8_t)(*p)]))
+      return -1;
     *p = (char)fio_http1_tolower((uint8_t)(*p));
-    ++p;
-    if (FIO_UNLIKELY(forbidden_name_chars[((uint8_t)(*p))]))
-      return p;
   }
+  return 0;
+}
+
+#if FIO___HAS_X86_INTRIN
+/*
+ * Tests and converts header names 16 bytes at a time. Names made of letters,
+ * digits and '-' are converted to lower case by setting the 0x20 bit (which is
+ * already set for digits and '-'). Other names use the (slower) table test.
+ */
+FIO_IFUNC int fio___http1_name_prepare(char *p, char *end, char *limit) {
+  static const uint8_t in_name[32] = {
+      0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+      0x20, 0x20, 0x20, 0x20, 0x20, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+  const __m128i v_a = _mm_set1_epi8('a');
+  const __m128i v_0 = _mm_set1_epi8('0');
+  const __m128i v_dash = _mm_set1_epi8('-');
+  const __m128i v_25 = _mm_set1_epi8(25);
+  const __m128i v_9 = _mm_set1_epi8(9);
+  while (p < end) {
+    __m128i v, m, a, d;
+    size_t len = (size_t)(end - p);
+    if (FIO_UNLIKELY(limit - p < 16))
+      return fio___http1_name_prepare_slow(p, end);
+    if (len > 16)
+      len = 16;
+    v = _mm_loadu_si128((const __m128i *)p);
+    m = _mm_loadu_si128((const __m128i *)(in_name + 16 - len));
+    a = _mm_sub_epi8(_mm_or_si128(v, m), v_a);
+    d = _mm_sub_epi8(v, v_0);
+    a = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(a, v_25), a),
+                     _mm_cmpeq_epi8(_mm_min_epu8(d, v_9), d));
+    a = _mm_or_si128(a, _mm_cmpeq_epi8(v, v_dash));
+    if (FIO_UNLIKELY((~_mm_movemask_epi8(a) & ((1U << len) - 1))))
+      return fio___http1_name_prepare_slow(p, end);
+    _mm_storeu_si128((__m128i *)p, _mm_or_si128(v, m));
+    p += len;
+  }
+  return 0;
 }
 
-/* extract header name and value from a line and pass info to handler */
+#else
+/* marks (0x80) every byte in the range [lo, hi] (7 bit values only). */
+#define FIO___HTTP1_SWAR_RANGE(h7, lo, hi)                                     \
+  (((h7) + UINT64_C(0x0101010101010101) * (0x80 - (lo))) &                     \
+   ~((h7) + UINT64_C(0x0101010101010101) * (0x7F - (hi))))
+
+/*
+ * Tests and converts header names 8 bytes at a time. Names made of letters,
+ * digits and '-' are converted to lower case by setting the 0x20 bit (which is
+ * already set for digits and '-'). Other names use the (slower) table test.
+ */
+FIO_IFUNC int fio___http1_name_prepare(char *p, char *end, char *limit) {
+  const uint64_t bytes = UINT64_C(0x0101010101010101);
+  while (p < end) {
+    uint64_t w, x, valid;
+    uint64_t m = bytes * 0x80;
+    if (FIO_UNLIKELY(limit - p < 8))
+      return fio___http1_name_prepare_slow(p, end);
+    if (end - p < 8) /* only test (and edit) the bytes in the name */
+      m >>= (8 - (end - p)) << 3;
+    w = fio_buf2u64_le(p);
+    x = w | (bytes * 0x20);
+    valid = (FIO___HTTP1_SWAR_RANGE(x & (bytes * 0x7F), 'a', 'z') & ~x) |
+            (FIO___HTTP1_SWAR_RANGE(w & (bytes * 0x7F), '0', '9') & ~w) |
+            fio___http1_swar_zero(w ^ (bytes * '-'));
+    if (FIO_UNLIKELY((valid & m) != m))
+      return fio___http1_name_prepare_slow(p, end);
+    fio_u2buf64_le(p, w | (m >> 2));
+    p += 8;
+  }
+  return 0;
+}
+#undef FIO___HTTP1_SWAR_RANGE
+#endif /* FIO___HAS_X86_INTRIN */
+
+/* extract header name and value from each line and pass info to handler */
 static inline int fio_http1___read_header_line(
     fio_http1_parser_s *p,
     fio_buf_info_s *buf,
@@ -383,22 +748,29 @@ static inline int fio_http1___read_header_line(
                    fio_buf_info_s,
                    fio_buf_info_s,
                    void *)) {
+  fio___http1_scanner_s s;
+  fio___http1_line_s l;
+  if (!buf->len)
+    return 1;
+  fio___http1_scan_init(&s, buf->buf, buf->buf + buf->len, ':');
   for (;;) {
     char *start = buf->buf;
-    char *eol = (char *)FIO_MEMCHR(start, '\n', buf->len);
+    char *eol;
     char *div;
     fio_buf_info_s name, value;
-    if (!eol)
+    if (fio___http1_scan_line(&s, start, &l))
       return 1;
-
-    buf->len -= (eol - buf->buf) + 1;
+    eol = l.eol;
+    buf->len -= (eol - start) + 1;
     buf->buf = eol + 1;
-    eol -= (eol[-1] == '\r');
+    eol -= (eol > start && eol[-1] == '\r');
     if (FIO_UNLIKELY(eol == start))
       goto headers_finished;
 
-    div = fio_http1___seek_header_div(start);
-    if (div[0] != ':')
+    div = l.div[0]; /* the first ':' is always before the (CR)LF */
+    if (FIO_UNLIKELY(!div || div == start ||
+                     (l.ctl && fio___http1_ctl_test(start, eol)) ||
+                     fio___http1_name_prepare(start, div, s.end)))
       return -1;
     name = FIO_BUF_INFO2(start, (size_t)(div - start));
     do {
@@ -398,11 +398,15 @@ FIO_SFUNC int fio___websocket_consume_header(fio_websocket_parser_s *p,
     p->current = info;
     if ((info & 15)) /* continuation frame == 0 ; is it missing? */
       return -1;
+    if ((info & 112)) /* RSV bits are only set on the first frame */
+      return -1;
   } else {
     p->first = p->current = info;
     p->start_at = 0;
     if (!(info & 15)) /* continuation frame == 0 ; where's the first? */
       return -1;
+    if ((info & 48) || (info & 72) == 72) /* RSV2/3 or compressed control */
+      return -1;
   }
   if (p->must_mask && !p->mask)
     return -1;
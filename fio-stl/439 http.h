@@ -57,11 +57,60 @@ HTTP Setting Defaults
 #define FIO_WEBSOCKET_STATS 0
 #endif
 
+#ifndef FIO_HTTP_WEBSOCKET_DEFLATE_MIN
+/** WebSocket messages shorter than this are sent uncompressed (default). */
+#define FIO_HTTP_WEBSOCKET_DEFLATE_MIN 128
+#endif
+
+#ifndef FIO_HTTP_WEBSOCKET_DEFLATE_MEM_LEVEL
+/** The zlib `memLevel` (1-9) for WebSocket compression. Less is smaller. */
+#define FIO_HTTP_WEBSOCKET_DEFLATE_MEM_LEVEL 8
+#endif
+
+#ifndef FIO_HTTP_WEBSOCKET_DEFLATE_POOL
+/** The number of idle zlib streams kept for reuse (per window size / level). */
+#define FIO_HTTP_WEBSOCKET_DEFLATE_POOL 16
+#endif
+
+#ifndef FIO_HTTP_DEFAULT_CACHE_LIMIT
+/** The default memory limit for a listener's response cache (`cache_ttl`). */
+#define FIO_HTTP_DEFAULT_CACHE_LIMIT 8388608 /* (1UL << 23) */
+#endif
+
+#ifndef FIO_HTTP_DEFAULT_COMPRESS_MIN
+/** Responses shorter than this are sent uncompressed (see `compress`). */
+#define FIO_HTTP_DEFAULT_COMPRESS_MIN 1024
+#endif
+
+#ifndef FIO_HTTP_BROTLI_WINDOW
+/** The brotli window (in bits, 10-24) used for response compression. */
+#define FIO_HTTP_BROTLI_WINDOW 18
+#endif
+
+#ifndef FIO_HTTP2_MAX_STREAMS
+/** The maximum number of concurrent HTTP/2 streams (requests) per client. */
+#define FIO_HTTP2_MAX_STREAMS 128
+#endif
+
+#ifndef FIO_HTTP2_WINDOW
+/** The HTTP/2 flow control window (per stream and per connection). */
+#define FIO_HTTP2_WINDOW 1048576 /* (1UL << 20) */
+#endif
+
 /* *****************************************************************************
 HTTP Listen
 ***************************************************************************** */
 typedef struct fio_http_settings_s {
-  /** Called before body uploads, when a client sends an `Expect` header. */
+  /**
+   * Called once before a request's body (if any) is received, i.e., to stream
+   * the body using `fio_http_body_multipart` (server only).
+   *
+   * If a response is sent, the body is discarded (HTTP/1.1 connections are
+   * closed once the response was sent).
+   *
+   * When a client sends an `Expect` header, this is called before the `100
+   * Continue` response and a response may be sent to deny the upload.
+   */
   void (*pre_http_body)(fio_http_s *h);
   /** Callback for HTTP requests (server) or responses (client). */
   void (*on_http)(fio_http_s *h);
@@ -141,10 +190,70 @@ typedef struct fio_http_settings_s {
    * connections. Defaults to FIO_HTTP_DEFAULT_WS_MAX_MSG_SIZE bytes.
    */
   size_t ws_max_msg_size;
+  /**
+   * WebSocket messages shorter than this are always sent uncompressed (see
+   * `ws_deflate`).
+   *
+   * Defaults to FIO_HTTP_WEBSOCKET_DEFLATE_MIN bytes.
+   */
+  size_t ws_deflate_min;
+  /**
+   * A comma separated list of request header names that are part of the
+   * response cache key (see `cache_ttl`), i.e., `"host, accept-encoding"`.
+   *
+   * The request's path and query are always part of the key.
+   */
+  fio_str_info_s cache_vary;
+  /**
+   * The memory limit (in bytes) for the response cache (see `cache_ttl`).
+   * Least recently used responses are evicted first.
+   *
+   * Defaults to FIO_HTTP_DEFAULT_CACHE_LIMIT bytes.
+   */
+  size_t cache_limit;
+  /**
+   * Responses shorter than this are always sent uncompressed (see
+   * `compress`). Streaming responses are compressed regardless of length.
+   *
+   * Defaults to FIO_HTTP_DEFAULT_COMPRESS_MIN bytes.
+   */
+  size_t compress_min;
   /** reserved for future use. */
   intptr_t reserved1;
   /** reserved for future use. */
   intptr_t reserved2;
+  /**
+   * The maximum number of concurrent client connections per origin (only
+   * relevant in client mode).
+   *
+   * When set, `fio_http_connect` keeps HTTP/1.1 connections alive and reuses
+   * them for later requests to the same origin. Requests are queued while all
+   * of the origin's connections are busy.
+   *
+   * Defaults to 0 (a new connection per request, closed once it's done).
+   */
+  uint16_t pool_max;
+  /**
+   * The maximum number of idle client connections kept alive per origin.
+   *
+   * Defaults to `pool_max`. Idle connections are closed after `timeout`.
+   */
+  uint16_t pool_max_idle;
+  /**
+   * Caches HTTP/1.x responses to `GET` requests for up to `cache_ttl` seconds
+   * (only relevant in server mode).
+   *
+   * Cached responses are sent as is, without calling `on_http`. Concurrent
+   * requests for a response that isn't cached yet wait for the first request
+   * to be handled, so `on_http` is only called once.
+   *
+   * Only responses that can be stored by a shared cache are cached (see the
+   * `Cache-Control` and `Vary` response headers). The `max-age` / `s-maxage`
+   * directives may shorten the time a response is cached.
+   *
+   * Defaults to 0 (disabled).
+   */
+  uint16_t cache_ttl;
   /**
    * An HTTP/1.x connection timeout.
    *
@@ -175,6 +284,33 @@ typedef struct fio_http_settings_s {
   uint8_t sse_timeout;
   /** Timeout for client connections (only relevant in client mode). */
   uint8_t connect_timeout;
+  /**
+   * Enables WebSocket compression (the RFC 7692 permessage-deflate extension)
+   * and limits the compression window to `(1 << ws_deflate)` bytes (9-15).
+   *
+   * Defaults to 0 (disabled). Requires zlib (`HAVE_ZLIB`).
+   */
+  uint8_t ws_deflate;
+  /**
+   * If set, the compression context is reset after every WebSocket message.
+   *
+   * This compresses less, but allows zlib state to be pooled rather than kept
+   * per connection, and allows pub/sub messages to be compressed only once.
+   */
+  uint8_t ws_deflate_no_context_takeover;
+  /**
+   * Compresses textual HTTP/1.x responses (`text/...`, JSON, JavaScript, XML)
+   * using this compression level (1-9), when the client accepts the `br`
+   * (brotli) or `gzip` encoding. Works for both complete and streaming
+   * (chunked) responses.
+   *
+   * Compressible responses get a `vary: accept-encoding` header and the `etag`
+   * of a compressed response is weakened (`W/"..."`).
+   *
+   * Defaults to 0 (disabled). Requires zlib (`HAVE_ZLIB`) and / or brotli
+   * (`HAVE_BROTLI`).
+   */
+  uint8_t compress;
   /** Logging flag - set to TRUE to log HTTP requests. */
   uint8_t log;
 } fio_http_settings_s;
@@ -199,7 +335,13 @@ SFUNC fio_io_s *fio_http_io(fio_http_s *);
 #define fio_http_subscribe(h, ...)                                             \
   fio_subscribe(.io = fio_http_io(h), __VA_ARGS__)
 
-/** Connects to HTTP / WebSockets / SSE connections on `url`. */
+/**
+ * Connects to HTTP / WebSockets / SSE connections on `url`.
+ *
+ * If `pool_max` is set, HTTP requests reuse idle connections to the same
+ * origin. In which case, NULL is returned if the request was queued (all of
+ * the origin's connections were busy).
+ */
 SFUNC fio_io_s *fio_http_connect(const char *url,
                                  fio_http_s *h,
                                  fio_http_settings_s settings);
@@ -267,6 +409,13 @@ Module Implementation - possibly externed functions.
 ***************************************************************************** */
 #if defined(FIO_EXTERN_COMPLETE) || !defined(FIO_EXTERN)
 
+#if HAVE_ZLIB
+#include <zlib.h>
+#endif
+#if HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
+
 /*
 REMEMBER:
 ========
@@ -373,6 +522,32 @@ static void http_settings_validate(fio_http_settings_s *s, int is_client) {
     s->ws_timeout = FIO_HTTP_DEFAULT_TIMEOUT_LONG;
   if (!s->sse_timeout)
     s->sse_timeout = s->ws_timeout;
+  if (!s->ws_deflate_min)
+    s->ws_deflate_min = FIO_HTTP_WEBSOCKET_DEFLATE_MIN;
+  if (!s->pool_max_idle || s->pool_max_idle > s->pool_max)
+    s->pool_max_idle = s->pool_max;
+  if (!s->cache_limit)
+    s->cache_limit = FIO_HTTP_DEFAULT_CACHE_LIMIT;
+  if (!s->compress_min)
+    s->compress_min = FIO_HTTP_DEFAULT_COMPRESS_MIN;
+  if (s->compress > 9)
+    s->compress = 9;
+#if !HAVE_ZLIB && !HAVE_BROTLI
+  if (s->compress)
+    FIO_LOG_WARNING("HTTP compression requires zlib (HAVE_ZLIB) or brotli "
+                    "(HAVE_BROTLI).");
+  s->compress = 0;
+#endif
+#if HAVE_ZLIB
+  if (s->ws_deflate && s->ws_deflate < 9)
+    s->ws_deflate = 9; /* zlib doesn't support 256 byte raw deflate windows */
+  if (s->ws_deflate > 15)
+    s->ws_deflate = 15;
+#else
+  if (s->ws_deflate)
+    FIO_LOG_WARNING("WebSocket compression requires zlib (HAVE_ZLIB).");
+  s->ws_deflate = 0;
+#endif
 
   if (s->max_header_size < s->max_line_len)
     s->max_header_size = s->max_line_len;
@@ -409,23 +584,37 @@ HTTP Protocol Container (vtable + settings storage)
 ***************************************************************************** */
 #define FIO___RECURSIVE_INCLUDE 1
 
+typedef struct fio___http_cache_s fio___http_cache_s;
+typedef struct fio___http_cache_entry_s fio___http_cache_entry_s;
+
 typedef struct {
   fio_http_settings_s settings;
   void (*on_http_callback)(void *, void *);
   fio_queue_s *queue;
+  fio___http_cache_s *cache; /* response cache (server mode, if enabled) */
   struct {
     fio_io_protocol_s protocol;
     fio_http_controller_s controller;
   } state[FIO___HTTP_PROTOCOL_NONE + 1];
+  uint8_t shared_frames;
   char public_folder_buf[];
 } fio___http_protocol_s;
 #include FIO_INCLUDE_FILE
 
+/* pub/sub metadata builder for pre-framed (shared) WebSocket / SSE payloads */
+FIO_SFUNC void *fio___http_msg_metadata_build(fio_msg_s *msg);
+/* frees the response cache */
+FIO_SFUNC void fio___http_cache_free(fio___http_cache_s *cache);
+
 #define FIO_REF_NAME             fio___http_protocol
 #define FIO_REF_FLEX_TYPE        char
 #define FIO_REF_CONSTRUCTOR_ONLY 1
 #define FIO_REF_DESTROY(o)                                                     \
   do {                                                                         \
+    if (o.shared_frames)                                                       \
+      fio_message_metadata_remove(fio___http_msg_metadata_build);              \
+    if (o.cache)                                                               \
+      fio___http_cache_free(o.cache);                                          \
     if (o.settings.tls)                                                        \
       fio_io_tls_free(o.settings.tls);                                         \
     if (o.settings.on_stop)                                                    \
@@ -442,6 +631,7 @@ FIO_IFUNC fio___http_protocol_s *fio___http_protocol_init(
 HTTP Connection Container
 ***************************************************************************** */
 
+typedef struct fio___http_pool_s fio___http_pool_s;
 struct fio___http_connection_http_s {
   void (*on_http_callback)(void *, void *);
   void (*on_http)(fio_http_s *h);
@@ -451,12 +641,31 @@ struct fio___http_connection_http_s {
   uint32_t max_header;
   uint32_t max_line;
   uint32_t header_bytes;
+  fio___http_pool_s *pool; /* client connection pool (if any) */
+  FIO_LIST_NODE pool_node; /* in the pool's `idle` list while idle */
+  fio___http_cache_entry_s *cache; /* the cached response sent / recorded */
+  uint8_t cache_hit; /* set if `cache` is sent (rather than recorded) */
+  void *zip;         /* the streaming response's compressor (if any) */
+  uint8_t zip_type;  /* the response's content encoding (if compressed) */
+  uint8_t pre_body;  /* set once `pre_http_body` was called for the request */
 };
+/** WebSocket permessage-deflate state (RFC 7692), if negotiated. */
+typedef struct {
+  void *tx; /* deflate stream, kept between messages for context takeover */
+  void *rx; /* inflate stream, kept between messages for context takeover */
+  FIO___LOCK_TYPE lock; /* keeps the compressed frames in their write order */
+  uint32_t min;         /* shorter messages are sent uncompressed */
+  uint8_t tx_bits;      /* our window bits (0 == extension wasn't negotiated) */
+  uint8_t rx_bits;      /* peer window bits */
+  uint8_t tx_reset;     /* our "no_context_takeover" */
+  uint8_t rx_reset;     /* peer "no_context_takeover" */
+} fio___http_ws_deflate_s;
 struct fio___http_connection_ws_s {
   void (*on_message)(fio_http_s *h, fio_buf_info_s msg, uint8_t is_text);
   void (*on_ready)(fio_http_s *h);
   fio_websocket_parser_s parser;
   char *msg;
+  fio___http_ws_deflate_s deflate;
   uint16_t code;
 };
 struct fio___http_connection_sse_s {
@@ -469,6 +678,18 @@ struct fio___http_connection_sse_s {
   fio_buf_info_s event;
   char *data;
 };
+typedef struct fio___http2_s fio___http2_s;
+struct fio___http_connection_h2_s {
+  fio___http2_s *session; /* NULL once the stream was closed */
+  char *hdr; /* response header snapshot (see `fio___http2_send_headers`) */
+  fio_stream_s out;   /* response body (DATA frames) */
+  FIO_LIST_NODE node; /* in the session's `active` list */
+  int64_t window;     /* stream send window */
+  uint32_t id;        /* stream id */
+  uint32_t recv;      /* bytes received since last WINDOW_UPDATE */
+  uint16_t flags;
+  uint8_t urgency; /* RFC 9218 */
+};
 
 /** Connection objects for managing HTTP / WebSocket connection state. */
 typedef struct {
@@ -481,12 +702,14 @@ typedef struct {
     struct fio___http_connection_http_s http;
     struct fio___http_connection_ws_s ws;
     struct fio___http_connection_sse_s sse;
+    struct fio___http_connection_h2_s h2;
   } state;
   uint32_t len;
   uint32_t capa;
   uint8_t log;
   uint8_t suspend;
   uint8_t is_client;
+  uint8_t is_h2_stream;
   char buf[];
 } fio___http_connection_s;
 
@@ -495,6 +718,8 @@ typedef struct {
 #define FIO_REF_FLEX_TYPE        char
 #define FIO_REF_DESTROY(o)                                                     \
   do {                                                                         \
+    if (o.is_h2_stream)                                                        \
+      fio_io_free(o.io);                                                       \
     fio___http_protocol_free(                                                  \
         FIO_PTR_FROM_FIELD(fio___http_protocol_s, settings, o.settings));      \
   } while (0)
@@ -517,1201 +742,4763 @@ static void fio___http_default_on_eventsource_redirect(fio_http_s *h,
 }
 
 /* *****************************************************************************
-HTTP Request handling / handling
+WebSocket Compression - permessage-deflate (RFC 7692)
 ***************************************************************************** */
 
-FIO_SFUNC void fio___http_perform_user_callback(void *cb_, void *h_) {
-  union {
-    void (*fn)(fio_http_s *);
-    void *ptr;
-  } cb = {.ptr = cb_};
-  fio_http_s *h = (fio_http_s *)h_;
-  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+/** Parsed permessage-deflate extension parameters (0 == missing). */
+typedef struct {
+  uint8_t server_bits; /* 16 == no value (valid for client_max_window_bits) */
+  uint8_t client_bits;
+  uint8_t server_reset; /* server_no_context_takeover */
+  uint8_t client_reset; /* client_no_context_takeover */
+} fio___http_ws_deflate_params_s;
+
+/** Parses an extension offer / response. Returns -1 if invalid. */
+FIO_SFUNC int fio___http_ws_deflate_params(fio___http_ws_deflate_params_s *o,
+                                           fio_str_info_s value) {
+  *o = (fio___http_ws_deflate_params_s){0};
+  FIO_HTTP_HEADER_VALUE_EACH_PROPERTY(value, p) {
+    fio_str_info_s name = p.name, val = p.value;
+    uint8_t *target;
+    uint8_t bits = 16;
+    while (name.len && (name.buf[0] == ' ' || name.buf[0] == '\t'))
+      ++name.buf, --name.len;
+    if (val.len > 1 && val.buf[0] == '"' && val.buf[val.len - 1] == '"')
+      ++val.buf, val.len -= 2;
+    if (val.len) {
+      char *pos = val.buf;
+      uint64_t i = fio_atol10u(&pos);
+      if (pos != val.buf + val.len || i < 8 || i > 15)
+        return -1;
+      bits = (uint8_t)i;
+    }
+    if (FIO_STR_INFO_IS_EQ(name,
+                           FIO_STR_INFO2((char *)"server_max_window_bits", 22)))
+      target = &o->server_bits;
+    else if (FIO_STR_INFO_IS_EQ(
+                 name,
+                 FIO_STR_INFO2((char *)"client_max_window_bits", 22)))
+      target = &o->client_bits;
+    else if (!val.len &&
+             FIO_STR_INFO_IS_EQ(
+                 name,
+                 FIO_STR_INFO2((char *)"server_no_context_takeover", 26)))
+      target = &o->server_reset;
+    else if (!val.len &&
+             FIO_STR_INFO_IS_EQ(
+                 name,
+                 FIO_STR_INFO2((char *)"client_no_context_takeover", 26)))
+      target = &o->client_reset;
+    else
+      return -1; /* unknown parameter */
+    if (*target)
+      return -1; /* parameters MUST NOT repeat */
+    *target = bits;
+  }
+  return 0 - (o->server_bits == 16);
+}
 
-  if (FIO_LIKELY(FIO_SOCK_IS_OPEN(fio_io_fd(c->io))))
-    cb.fn(h);
-  fio_http_free(h);
+#if HAVE_ZLIB
+/* *****************************************************************************
+WebSocket / HTTP Compression - zlib stream pool
+***************************************************************************** */
+
+/** A zlib stream, pooled by type and window size (or level) when idle. */
+typedef struct fio___http_zstream_s {
+  z_stream z;
+  struct fio___http_zstream_s *next;
+  uint8_t bits;       /* window bits (raw deflate / inflate), or gzip level */
+  uint8_t is_inflate; /* 0: raw deflate, 1: raw inflate, 2: gzip (deflate) */
+} fio___http_zstream_s;
+
+FIO_LEAK_COUNTER_DEF(fio___http_zstream_s)
+
+static struct {
+  fio___http_zstream_s *idle[3][16]; /* [is_inflate][window bits] */
+  uint32_t count[3][16];
+  FIO___LOCK_TYPE lock;
+  uint8_t at_exit;
+} fio___http_zpool = {.lock = FIO___LOCK_INIT};
+
+FIO_SFUNC void fio___http_zstream_destroy(fio___http_zstream_s *s) {
+  if (s->is_inflate == 1)
+    inflateEnd(&s->z);
+  else
+    deflateEnd(&s->z);
+  FIO_LEAK_COUNTER_ON_FREE(fio___http_zstream_s);
+  FIO_MEM_FREE_(s, sizeof(*s));
 }
 
-FIO_SFUNC void fio___http_perform_user_upgrade_callback_websocket(void *cb_,
-                                                                  void *h_) {
-  union {
-    int (*fn)(fio_http_s *);
-    void *ptr;
-  } cb = {.ptr = cb_};
-  fio_http_s *h = (fio_http_s *)h_;
-  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
-  struct fio___http_connection_http_s old = c->state.http;
-  if (!FIO_LIKELY(fio_io_is_open(c->io)) || cb.fn(h))
-    goto refuse_upgrade;
-  if (c->h) /* request after WebSocket Upgrade? an attack vector? */
-    goto refuse_upgrade;
-#if HAVE_ZLIB && 0           /* TODO: logs and fix extension handling logic */
-  FIO_HTTP_HEADER_EACH_VALUE(/* TODO: setup WebSocket extension */
-                             h,
-                             1,
-                             FIO_STR_INFO2((char *)"sec-websocket-extensions",
-                                           24),
-                             val) {
-    FIO_LOG_DDEBUG2("WebSocket extension requested: %.*s",
-                    (int)val.len,
-                    val.buf);
-    if (!FIO_STR_INFO_IS_EQ(val,
-                            FIO_STR_INFO2((char *)"permessage-deflate", 18)))
-      continue;
-    size_t client_bits = 0, server_bits = 0;
-    FIO_HTTP_HEADER_VALUE_EACH_PROPERTY(val, p) {
-      FIO_LOG_DDEBUG2("\t %.*s: %.*s",
-                      (int)p.name.len,
-                      p.name.buf,
-                      (int)p.value.len,
-                      p.value.buf);
-      if (FIO_STR_INFO_IS_EQ(p.name,
-                             FIO_STR_INFO2((char *)"client_max_window_bits",
-                                           22))) { /* used by chrome */
-        char *iptr = p.value.buf;
-        client_bits = iptr ? fio_atol10u(&iptr) : 0;
-        if (client_bits < 8 || client_bits > 15)
-          client_bits = (size_t)-1;
-      }
-      if (FIO_STR_INFO_IS_EQ(
-              p.name,
-              FIO_STR_INFO2((char *)"server_max_window_bits", 22))) {
-        char *iptr = p.value.buf;
-        server_bits = iptr ? fio_atol10u(&iptr) : 0;
-        if (server_bits < 8 || server_bits > 15)
-          server_bits = (size_t)-1;
-      }
+FIO_SFUNC void fio___http_zpool_destroy(void *ignr_) {
+  FIO___LOCK_LOCK(fio___http_zpool.lock);
+  for (size_t i = 0; i < 48; ++i) {
+    fio___http_zstream_s **pos = fio___http_zpool.idle[i >> 4] + (i & 15);
+    while (*pos) {
+      fio___http_zstream_s *s = *pos;
+      *pos = s->next;
+      fio___http_zstream_destroy(s);
     }
-    if (client_bits)
-      ; /* TODO */
-    if (server_bits)
-      ; /* TODO */
-    break;
-  } /* HAVE_ZLIB */
-#endif
-  fio_http_upgrade_websocket(h);
-  return;
-
-refuse_upgrade:
-  c->state.http = old;
-  if (fio_http_send_error_response(h, 403))
-    fio_io_free(c->io);
-  fio_http_free(h);
+    fio___http_zpool.count[i >> 4][i & 15] = 0;
+  }
+  FIO___LOCK_UNLOCK(fio___http_zpool.lock);
+  (void)ignr_;
 }
 
-FIO_SFUNC void fio___http_perform_user_upgrade_callback_sse(void *cb_,
-                                                            void *h_) {
-  union {
-    int (*fn)(fio_http_s *);
-    void *ptr;
-  } cb = {.ptr = cb_};
-  fio_http_s *h = (fio_http_s *)h_;
-  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
-  if (!FIO_LIKELY(fio_io_is_open(c->io)) || cb.fn(h))
-    goto refuse_upgrade;
-  if (c->h) /* request after eventsource? an attack vector? */
-    goto refuse_upgrade;
-  fio_http_upgrade_sse(h);
-  return;
+/** Takes an idle zlib stream from the pool, or initializes a new one. */
+FIO_SFUNC fio___http_zstream_s *fio___http_zstream_new(uint8_t is_inflate,
+                                                       uint8_t bits) {
+  fio___http_zstream_s *s;
+  int r;
+  FIO___LOCK_LOCK(fio___http_zpool.lock);
+  s = fio___http_zpool.idle[is_inflate][bits];
+  if (s) {
+    fio___http_zpool.idle[is_inflate][bits] = s->next;
+    --fio___http_zpool.count[is_inflate][bits];
+  }
+  FIO___LOCK_UNLOCK(fio___http_zpool.lock);
+  if (s)
+    return s;
+  s = (fio___http_zstream_s *)FIO_MEM_REALLOC_(NULL, 0, sizeof(*s), 0);
+  if (!s)
+    return s;
+  *s = (fio___http_zstream_s){.bits = bits, .is_inflate = is_inflate};
+  /* negative window bits == raw deflate (no zlib header / trailer) */
+  if (is_inflate == 2) /* 16 + 15 window bits == gzip header / trailer */
+    r = deflateInit2(&s->z,
+                     (int)bits,
+                     Z_DEFLATED,
+                     31,
+                     FIO_HTTP_WEBSOCKET_DEFLATE_MEM_LEVEL,
+                     Z_DEFAULT_STRATEGY);
+  else if (is_inflate)
+    r = inflateInit2(&s->z, 0 - (int)bits);
+  else
+    r = deflateInit2(&s->z,
+                     Z_DEFAULT_COMPRESSION,
+                     Z_DEFLATED,
+                     0 - (int)bits,
+                     FIO_HTTP_WEBSOCKET_DEFLATE_MEM_LEVEL,
+                     Z_DEFAULT_STRATEGY);
+  if (r != Z_OK) {
+    FIO_LOG_ERROR("zlib stream initialization failed (%d)", r);
+    FIO_MEM_FREE_(s, sizeof(*s));
+    return NULL;
+  }
+  FIO_LEAK_COUNTER_ON_ALLOC(fio___http_zstream_s);
+  return s;
+}
 
-refuse_upgrade:
-  if (fio_http_send_error_response(h, 403))
-    fio_io_free(c->io);
-  fio_http_free(h);
+/** Resets a zlib stream and returns it to the pool (or frees it). */
+FIO_SFUNC void fio___http_zstream_free(fio___http_zstream_s *s) {
+  if (!s)
+    return;
+  if (s->is_inflate == 1)
+    inflateReset(&s->z);
+  else
+    deflateReset(&s->z);
+  FIO___LOCK_LOCK(fio___http_zpool.lock);
+  if (fio___http_zpool.count[s->is_inflate][s->bits] <
+      FIO_HTTP_WEBSOCKET_DEFLATE_POOL) {
+    s->next = fio___http_zpool.idle[s->is_inflate][s->bits];
+    fio___http_zpool.idle[s->is_inflate][s->bits] = s;
+    ++fio___http_zpool.count[s->is_inflate][s->bits];
+    if (!fio___http_zpool.at_exit) {
+      fio___http_zpool.at_exit = 1;
+      fio_state_callback_add(FIO_CALL_AT_EXIT, fio___http_zpool_destroy, NULL);
+    }
+    s = NULL;
+  }
+  FIO___LOCK_UNLOCK(fio___http_zpool.lock);
+  if (s)
+    fio___http_zstream_destroy(s);
 }
 
-FIO_IFUNC int fio___http_on_http_test4upgrade(fio_http_s *h,
-                                              fio___http_connection_s *c) {
-  union {
-    int (*fn)(fio_http_s *);
-    void *ptr;
-  } cb;
-  if (fio_http_websocket_requested(h))
-    goto websocket_requested;
-  if (fio_http_sse_requested(h))
-    goto sse_requested;
-  return 0;
-websocket_requested:
-  cb.fn = c->settings->on_authenticate_websocket;
-  fio_queue_push(c->queue,
-                 fio___http_perform_user_upgrade_callback_websocket,
-                 cb.ptr,
-                 (void *)h);
-  return -1;
+/* *****************************************************************************
+WebSocket Compression - compressing / decompressing messages
+***************************************************************************** */
 
-sse_requested:
-  cb.fn = c->settings->on_authenticate_sse;
-  fio_queue_push(c->queue,
-                 fio___http_perform_user_upgrade_callback_sse,
-                 cb.ptr,
-                 (void *)h);
-  return -1;
+/** Compresses a message into a complete WebSocket frame (a `fio_bstr`). */
+FIO_SFUNC char *fio___http_ws_deflate_frame(z_stream *z,
+                                            const void *buf,
+                                            size_t len,
+                                            unsigned char opcode,
+                                            uint8_t is_client) {
+  const size_t head = 14; /* room for the longest frame header (masked) */
+  size_t capa, pos = head;
+  char *f;
+  char header[16];
+  int r;
+  if (len > (1ULL << 30))
+    return NULL;
+  capa = head + (size_t)deflateBound(z, (uLong)len) + 16;
+  f = fio_bstr_reserve(NULL, capa);
+  z->next_in = (Bytef *)buf;
+  z->avail_in = (uInt)len;
+  for (;;) {
+    z->next_out = (Bytef *)f + pos;
+    z->avail_out = (uInt)(capa - pos);
+    r = deflate(z, Z_SYNC_FLUSH);
+    pos = capa - z->avail_out;
+    if (r != Z_OK && r != Z_BUF_ERROR)
+      goto error;
+    if (z->avail_out) /* flushed, with room to spare */
+      break;
+    f = fio_bstr_reserve(fio_bstr_len_set(f, pos), (capa >> 1));
+    capa += (capa >> 1);
+  }
+  /* remove the 0x00 0x00 0xFF 0xFF flush marker (RFC 7692, section 7.2.1) */
+  if (pos - head < 4)
+    goto error;
+  pos -= 4;
+  if (is_client) { /* mask the payload in place */
+    uint64_t mask = (fio_rand64() | 0x01020408ULL) & 0xFFFFFFFFULL;
+    mask |= mask << 32;
+    r = (int)fio_websocket_header(header,
+                                  pos - head,
+                                  (uint32_t)mask,
+                                  opcode,
+                                  1,
+                                  1,
+                                  4);
+    fio_xmask(f + head, pos - head, mask);
+  } else {
+    r = (int)fio_websocket_header(header, pos - head, 0, opcode, 1, 1, 4);
+  }
+  FIO_MEMMOVE(f + r, f + head, pos - head);
+  FIO_MEMCPY(f, header, (size_t)r);
+  return fio_bstr_len_set(f, (pos - head) + (size_t)r);
 
-#if 0
-http2_requested:
-  // Connection: Upgrade, HTTP2-Settings
-  // Upgrade: h2c
-  // HTTP2-Settings: <base64url encoding of HTTP/2 SETTINGS payload>
-  return 0; /* allowed to ignore upgrade request */
-#endif
+error:
+  FIO_LOG_ERROR("WebSocket message compression failed (%d)", r);
+  fio_bstr_free(f);
+  return NULL;
 }
 
-FIO_SFUNC void fio___http_on_http_direct(void *h_, void *ignr) {
-  fio_http_s *h = (fio_http_s *)h_;
-  fio_http_status_set(h, 200);
-  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
-  if (fio___http_on_http_test4upgrade(h, c))
+/** Decompresses a message into a new `fio_bstr`, up to `limit` bytes. */
+FIO_SFUNC char *fio___http_ws_inflate(z_stream *z,
+                                      fio_buf_info_s msg,
+                                      size_t limit) {
+  static const char tail[4] = {0, 0, (char)0xFF, (char)0xFF};
+  size_t capa = (msg.len << 2) + 64, pos = 0;
+  char *r;
+  if (capa > limit + 1)
+    capa = limit + 1;
+  r = fio_bstr_reserve(NULL, capa);
+  /* re-append the flush marker removed by the sender (RFC 7692, 7.2.2) */
+  for (size_t i = 0; i < 2; ++i) {
+    z->next_in = (Bytef *)(i ? tail : msg.buf);
+    z->avail_in = (uInt)(i ? 4 : msg.len);
+    for (;;) {
+      int e;
+      z->next_out = (Bytef *)r + pos;
+      z->avail_out = (uInt)(capa - pos);
+      e = inflate(z, Z_SYNC_FLUSH);
+      pos = capa - z->avail_out;
+      if (e == Z_STREAM_END) { /* a final block, nothing may follow */
+        inflateReset(z);
+        goto done;
+      }
+      if (e != Z_OK && e != Z_BUF_ERROR)
+        goto error;
+      if (pos > limit)
+        goto error;
+      if (!z->avail_in && z->avail_out)
+        break;
+      if (z->avail_out) /* no progress - corrupt data */
+        goto error;
+      r = fio_bstr_reserve(fio_bstr_len_set(r, pos), capa);
+      capa <<= 1;
+      if (capa > limit + 1)
+        capa = limit + 1;
+    }
+  }
+done:
+  return fio_bstr_len_set(r, pos);
+error:
+  FIO_LOG_DDEBUG2("WebSocket message decompression failed (or too long).");
+  fio_bstr_free(r);
+  return NULL;
+}
+
+/* *****************************************************************************
+WebSocket Compression - connection state
+***************************************************************************** */
+
+/** Server side: accepts the first supported offer (a response header). */
+FIO_SFUNC void fio___http_ws_deflate_negotiate(fio_http_s *h,
+                                               fio_http_settings_s *s) {
+  FIO_HTTP_HEADER_EACH_VALUE(h,
+                             1,
+                             FIO_STR_INFO2((char *)"sec-websocket-extensions",
+                                           24),
+                             val) {
+    fio___http_ws_deflate_params_s o;
+    FIO_STR_INFO_TMP_VAR(r, 160);
+    if (!FIO_STR_INFO_IS_EQ(val,
+                            FIO_STR_INFO2((char *)"permessage-deflate", 18)) ||
+        fio___http_ws_deflate_params(&o, val))
+      continue;
+    if (o.server_bits == 8)
+      continue; /* zlib can't compress using a 256 byte window */
+    fio_string_write(&r, NULL, "permessage-deflate", 18);
+    if (o.server_reset || s->ws_deflate_no_context_takeover)
+      fio_string_write(&r, NULL, "; server_no_context_takeover", 28);
+    if (o.client_reset || s->ws_deflate_no_context_takeover)
+      fio_string_write(&r, NULL, "; client_no_context_takeover", 28);
+    /* a window smaller than requested is always valid for compression */
+    if (o.server_bits)
+      fio_string_write2(
+          &r,
+          NULL,
+          FIO_STRING_WRITE_STR2("; server_max_window_bits=", 25),
+          FIO_STRING_WRITE_UNUM(
+              (o.server_bits < s->ws_deflate ? o.server_bits : s->ws_deflate)));
+    /* limits the client's window (the memory used for decompression) */
+    if (o.client_bits)
+      fio_string_write2(
+          &r,
+          NULL,
+          FIO_STRING_WRITE_STR2("; client_max_window_bits=", 25),
+          FIO_STRING_WRITE_UNUM(
+              (o.client_bits < s->ws_deflate ? o.client_bits : s->ws_deflate)));
+    fio_http_response_header_set(
+        h,
+        FIO_STR_INFO2((char *)"sec-websocket-extensions", 24),
+        r);
     return;
-  union {
-    void (*fn)(fio_http_s *);
-    void *ptr;
-  } cb = {.fn = c->state.http.on_http};
-  fio_queue_push(c->queue, fio___http_perform_user_callback, cb.ptr, (void *)h);
-  (void)ignr;
+  }
 }
 
-FIO_SFUNC void fio___http_on_http_with_public_folder(void *h_, void *ignr) {
-  fio_http_s *h = (fio_http_s *)h_;
-  fio_http_status_set(h, 200);
-  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
-  if (fio___http_on_http_test4upgrade(h, c))
+/** Sets up the compression state according to the negotiated response. */
+FIO_SFUNC void fio___http_ws_deflate_setup(fio___http_connection_s *c) {
+  fio___http_ws_deflate_s *d = &c->state.ws.deflate;
+  *d = (fio___http_ws_deflate_s){.lock = FIO___LOCK_INIT};
+  if (!c->settings->ws_deflate || !c->h)
     return;
-  if ((fio_http_method(h).len != 4 || (fio_buf2u32u(fio_http_method(h).buf) |
-                                       0x20202020UL) != fio_buf2u32u("post")) &&
-      !fio_http_static_file_response(h,
-                                     c->settings->public_folder,
-                                     fio_http_path(h),
-                                     c->settings->max_age)) {
-    fio_http_free(h);
+  FIO_HTTP_HEADER_EACH_VALUE(c->h,
+                             0,
+                             FIO_STR_INFO2((char *)"sec-websocket-extensions",
+                                           24),
+                             val) {
+    fio___http_ws_deflate_params_s o;
+    if (!FIO_STR_INFO_IS_EQ(val,
+                            FIO_STR_INFO2((char *)"permessage-deflate", 18)) ||
+        fio___http_ws_deflate_params(&o, val) || o.client_bits == 16)
+      continue;
+    uint8_t tx = (c->is_client ? o.client_bits : o.server_bits);
+    uint8_t rx = (c->is_client ? o.server_bits : o.client_bits);
+    if (!tx || tx > c->settings->ws_deflate)
+      tx = c->settings->ws_deflate;
+    d->tx_bits = (tx > 8) ? tx : 0; /* 8 bits: decompress only */
+    d->rx_bits = rx ? rx : 15;
+    d->tx_reset = (c->is_client ? o.client_reset : o.server_reset) |
+                  c->settings->ws_deflate_no_context_takeover;
+    d->rx_reset = (c->is_client ? o.server_reset : o.client_reset);
+    d->min = (c->settings->ws_deflate_min < 0xFFFFFFFFUL)
+                 ? (uint32_t)c->settings->ws_deflate_min
+                 : 0xFFFFFFFFUL;
+    FIO_LOG_DDEBUG2("(%d) WebSocket permessage-deflate: %u/%u bits%s%s",
+                    fio_io_pid(),
+                    (unsigned)d->tx_bits,
+                    (unsigned)d->rx_bits,
+                    (d->tx_reset ? ", no tx context" : ""),
+                    (d->rx_reset ? ", no rx context" : ""));
     return;
   }
-  union {
-    void (*fn)(fio_http_s *);
-    void *ptr;
-  } cb = {.fn = c->state.http.on_http};
-  fio_queue_push(c->queue, fio___http_perform_user_callback, cb.ptr, (void *)h);
-  (void)ignr;
 }
 
-FIO_SFUNC void fio___http_perform_user_callback_client(void *cb_, void *h_) {
-  fio_http_s *h = (fio_http_s *)h_;
-  union {
-    void (*fn)(fio_http_s *);
-    void *ptr;
-  } cb = {.ptr = cb_};
-  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
-  /* unlike Server mode, handle responses from closed connections */
-  cb.fn(h);
-  fio_http_free(h);
-  fio_io_free(c->io);
+/** Frees any compression state (returning zlib streams to the pool). */
+FIO_SFUNC void fio___http_ws_deflate_destroy(fio___http_ws_deflate_s *d) {
+  fio___http_zstream_free((fio___http_zstream_s *)d->tx);
+  fio___http_zstream_free((fio___http_zstream_s *)d->rx);
+  d->tx = d->rx = NULL;
+  FIO___LOCK_DESTROY(d->lock);
 }
 
-FIO_SFUNC void fio___http_on_http_client(void *h_, void *ignr) {
-  fio_http_s *h = (fio_http_s *)h_;
-  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
-  size_t pr = FIO___HTTP_PROTOCOL_WS;
-  union {
-    void (*fn)(fio_http_s *);
-    void *ptr;
-  } cb = {.fn = c->state.http.on_http};
-
-  /* TODO! review WS and SSE responses. */
-  if (fio_http_websocket_accepted(h))
-    goto websocket_accepted;
-  if (fio_http_sse_accepted(h))
-    goto sse_accepted;
-  fio_queue_push(c->queue,
-                 fio___http_perform_user_callback_client,
-                 cb.ptr,
-                 (void *)h);
-  return;
-  (void)ignr;
+/** Writes a compressed message. Returns -1 if the message wasn't written. */
+FIO_SFUNC int fio___http_ws_deflate_write(fio___http_connection_s *c,
+                                          const void *buf,
+                                          size_t len,
+                                          unsigned char opcode) {
+  fio___http_ws_deflate_s *d = &c->state.ws.deflate;
+  fio___http_zstream_s *z;
+  char *frame = NULL;
+  /* compression and write order MUST match when the context is kept */
+  FIO___LOCK_LOCK(d->lock);
+  z = (fio___http_zstream_s *)d->tx;
+  if (!z)
+    z = fio___http_zstream_new(0, d->tx_bits);
+  if (z)
+    frame = fio___http_ws_deflate_frame(&z->z, buf, len, opcode, c->is_client);
+  if (d->tx_reset || !frame) { /* a reset compressor is always valid */
+    fio___http_zstream_free(z);
+    z = NULL;
+  }
+  d->tx = (void *)z;
+  if (frame)
+    fio_io_write2(c->io,
+                  .buf = frame,
+                  .len = fio_bstr_len(frame),
+                  .dealloc = (void (*)(void *))fio_bstr_free);
+  FIO___LOCK_UNLOCK(d->lock);
+  return 0 - !frame;
+}
 
-sse_accepted:
-  pr = FIO___HTTP_PROTOCOL_SSE;
+/** Decompresses a message, returning a new `fio_bstr` (or NULL on error). */
+FIO_SFUNC char *fio___http_ws_deflate_read(fio___http_connection_s *c,
+                                           fio_buf_info_s msg) {
+  fio___http_ws_deflate_s *d = &c->state.ws.deflate;
+  fio___http_zstream_s *z = (fio___http_zstream_s *)d->rx;
+  char *r = NULL;
+  if (!z)
+    z = fio___http_zstream_new(1, d->rx_bits);
+  if (z)
+    r = fio___http_ws_inflate(&z->z, msg, c->settings->ws_max_msg_size);
+  if (d->rx_reset || !r) {
+    fio___http_zstream_free(z);
+    z = NULL;
+  }
+  d->rx = (void *)z;
+  return r;
+}
 
-websocket_accepted:
-  c->h = h; /* was set to NULL in `on_http_complete` */
-  fio_http_controller_set(
-      c->h,
-      &(FIO_PTR_FROM_FIELD(fio___http_protocol_s, settings, c->settings)
-            ->state[pr]
-            .controller));
-  fio_io_protocol_set(
-      c->io,
-      &(FIO_PTR_FROM_FIELD(fio___http_protocol_s, settings, c->settings)
-            ->state[pr]
-            .protocol));
+#else /* HAVE_ZLIB */
 
-  FIO_LOG_DDEBUG2("(%d) Client %s upgrade complete for fd %d",
-                  fio_io_pid(),
-                  (fio_http_is_websocket(h) ? "WebSocket" : "SSE"),
-                  fio_io_fd(c->io));
+FIO_SFUNC void fio___http_ws_deflate_setup(fio___http_connection_s *c) {
+  c->state.ws.deflate = (fio___http_ws_deflate_s){.lock = FIO___LOCK_INIT};
+}
 
-  fio_io_free(c->io); /* fio_dup called by fio_http1_on_complete */
-  c->suspend = 0;
-  fio_io_unsuspend(c->io);
+FIO_SFUNC void fio___http_ws_deflate_destroy(fio___http_ws_deflate_s *d) {
+  FIO___LOCK_DESTROY(d->lock);
 }
+#endif /* HAVE_ZLIB */
 
 /* *****************************************************************************
-ALPN Helpers
-***************************************************************************** */
+HTTP Response Compression (HTTP/1.x server connections)
 
-FIO_SFUNC void fio___http_on_select_h1(fio_io_s *io) {
-  FIO_LOG_DDEBUG2("TLS ALPN HTTP/1.1 selected for %p", io);
-  fio___http_connection_s *c = (fio___http_connection_s *)fio_io_udata(io);
-  fio_io_protocol_set(
-      io,
-      &(FIO_PTR_FROM_FIELD(fio___http_protocol_s, settings, c->settings)
-            ->state[FIO___HTTP_PROTOCOL_HTTP1]
-            .protocol));
-}
-FIO_SFUNC void fio___http_on_select_h2(fio_io_s *io) {
-  FIO_LOG_ERROR("TLS ALPN HTTP/2 not supported for %p", io);
-  (void)io;
-}
+Complete responses are compressed in one pass once the body is written (the
+headers wait for the body, so `content-length` is correct). Streaming responses
+keep a compressor for the response, flushing it with every chunk.
 
-/* *****************************************************************************
-HTTP Listen
+gzip streams are pooled (see the zlib stream pool). brotli encoders can't be
+reset, so they're allocated per response.
 ***************************************************************************** */
 
-static void fio___http_listen_on_start(fio_io_protocol_s *protocol, void *u) {
-  (void)u;
-  fio___http_protocol_s *p = (fio___http_protocol_s *)protocol;
-  p->queue = ((p->settings.queue && p->settings.queue->q) ? p->settings.queue->q
-                                                          : fio_io_queue());
+#define FIO___HTTP_ZIP_GZIP 1
+#define FIO___HTTP_ZIP_BR   2
+
+/** Returns the preferred content encoding accepted by the client (or 0). */
+FIO_SFUNC uint8_t fio___http_zip_accepted(fio_http_s *h) {
+  uint8_t r = 0;
+  FIO_HTTP_HEADER_EACH_VALUE(h,
+                             1,
+                             FIO_STR_INFO2((char *)"accept-encoding", 15),
+                             val) {
+    uint8_t e = 0;
+#if HAVE_ZLIB
+    if (FIO_STR_INFO_IS_EQ(val, FIO_STR_INFO2((char *)"gzip", 4)))
+      e = FIO___HTTP_ZIP_GZIP;
+#endif
+#if HAVE_BROTLI
+    if (FIO_STR_INFO_IS_EQ(val, FIO_STR_INFO2((char *)"br", 2)))
+      e = FIO___HTTP_ZIP_BR;
+#endif
+    if (e <= r)
+      continue;
+    FIO_HTTP_HEADER_VALUE_EACH_PROPERTY(val, prop) { /* test for `q=0` */
+      size_t i = 0;
+      if (prop.name.len != 1 || (prop.name.buf[0] | 0x20) != 'q')
+        continue;
+      while (i < prop.value.len &&
+             (prop.value.buf[i] == '0' || prop.value.buf[i] == '.'))
+        ++i;
+      if (i == prop.value.len)
+        e = 0;
+    }
+    if (e > r)
+      r = e;
+  }
+  return r;
 }
 
-static void fio___http_listen_on_stop(fio_io_protocol_s *p, void *u) {
-  (void)u;
-  fio___http_protocol_free(
-      FIO_PTR_FROM_FIELD(fio___http_protocol_s,
-                         state[FIO___HTTP_PROTOCOL_ACCEPT].protocol,
-                         p));
+/** Returns true if the content type is textual (worth compressing). */
+FIO_SFUNC int fio___http_zip_is_text(fio_str_info_s t) {
+  static const char *subtypes[] = {"json", "javascript", "xml", NULL};
+  char *end = t.buf + t.len;
+  if (t.len > 5 && (fio_buf2u32u(t.buf) | 0x20202020UL) ==
+                       fio_buf2u32u("text") &&
+      t.buf[4] == '/')
+    return 1;
+  for (char *pos = t.buf; pos < end && *pos != ';'; ++pos)
+    for (size_t i = 0; subtypes[i]; ++i) {
+      size_t len = strlen(subtypes[i]);
+      if ((size_t)(end - pos) >= len && !FIO_MEMCMP(pos, subtypes[i], len))
+        return 1;
+    }
+  return 0;
 }
 
-void fio_http_listen___(void); /* IDE marker */
-SFUNC void *fio_http_listen FIO_NOOP(const char *url, fio_http_settings_s s) {
-  http_settings_validate(&s, 0);
-  fio___http_protocol_s *p = fio___http_protocol_new(s.public_folder.len + 1);
-  fio___http_protocol_init(p, url, s, 0);
-  void *listener =
-      fio_io_listen(.url = url,
-                    .protocol = &p->state[FIO___HTTP_PROTOCOL_ACCEPT].protocol,
-                    .tls = s.tls,
-                    .on_start = fio___http_listen_on_start,
-                    .on_stop = fio___http_listen_on_stop,
-                    .queue_for_accept = p->settings.queue);
-  return listener;
+/** Creates a response compressor (pooled, for gzip). */
+FIO_SFUNC void *fio___http_zip_new(uint8_t type, uint8_t level, size_t hint) {
+#if HAVE_ZLIB
+  if (type == FIO___HTTP_ZIP_GZIP)
+    return (void *)fio___http_zstream_new(2, level);
+#endif
+#if HAVE_BROTLI
+  if (type == FIO___HTTP_ZIP_BR) {
+    BrotliEncoderState *b = BrotliEncoderCreateInstance(NULL, NULL, NULL);
+    if (!b)
+      return NULL;
+    BrotliEncoderSetParameter(b, BROTLI_PARAM_QUALITY, (uint32_t)level);
+    BrotliEncoderSetParameter(b, BROTLI_PARAM_LGWIN, FIO_HTTP_BROTLI_WINDOW);
+    if (hint && hint < (1UL << 30))
+      BrotliEncoderSetParameter(b, BROTLI_PARAM_SIZE_HINT, (uint32_t)hint);
+    return (void *)b;
+  }
+#endif
+  return NULL;
+  (void)type, (void)level, (void)hint;
 }
 
-/** Returns the a pointer to the HTTP settings associated with the listener. */
-SFUNC fio_http_settings_s *fio_http_listener_settings(void *listener) {
-  fio___http_protocol_s *p =
-      FIO_PTR_FROM_FIELD(fio___http_protocol_s,
-                         state[FIO___HTTP_PROTOCOL_ACCEPT].protocol,
-                         fio_io_listener_protocol(listener));
-  return &p->settings;
+/** Frees a response compressor (returning zlib streams to the pool). */
+FIO_SFUNC void fio___http_zip_free(uint8_t type, void *zip) {
+  if (!zip)
+    return;
+#if HAVE_ZLIB
+  if (type == FIO___HTTP_ZIP_GZIP)
+    fio___http_zstream_free((fio___http_zstream_s *)zip);
+#endif
+#if HAVE_BROTLI
+  if (type == FIO___HTTP_ZIP_BR)
+    BrotliEncoderDestroyInstance((BrotliEncoderState *)zip);
+#endif
+  (void)type;
 }
-/* *****************************************************************************
-HTTP Connect
-***************************************************************************** */
 
-static void fio___http_connect_on_failed(fio_io_protocol_s *p, void *udata) {
-  fio___http_connection_s *c = (fio___http_connection_s *)udata;
-  fio_http_free(c->h);
-  c->h = NULL;
-  fio___http_connection_free(c);
-  (void)p;
+/** Compresses and flushes (or finishes) data, returns a `fio_bstr` or NULL. */
+FIO_SFUNC char *fio___http_zip(uint8_t type,
+                               void *zip,
+                               const void *buf,
+                               size_t len,
+                               int finish) {
+  size_t capa = len + (len >> 3) + 64, pos = 0;
+  char *r;
+  if (len > (1ULL << 30))
+    return NULL;
+  r = fio_bstr_reserve(NULL, capa);
+#if HAVE_ZLIB
+  if (type == FIO___HTTP_ZIP_GZIP) {
+    z_stream *z = &((fio___http_zstream_s *)zip)->z;
+    z->next_in = (Bytef *)buf;
+    z->avail_in = (uInt)len;
+    for (;;) {
+      int e;
+      z->next_out = (Bytef *)r + pos;
+      z->avail_out = (uInt)(capa - pos);
+      e = deflate(z, (finish ? Z_FINISH : Z_SYNC_FLUSH));
+      pos = capa - z->avail_out;
+      if (e == Z_STREAM_END)
+        break;
+      if (e != Z_OK && e != Z_BUF_ERROR)
+        goto error;
+      if (z->avail_out && !finish) /* flushed, with room to spare */
+        break;
+      r = fio_bstr_reserve(fio_bstr_len_set(r, pos), (capa >> 1));
+      capa += (capa >> 1);
+    }
+    return fio_bstr_len_set(r, pos);
+  }
+#endif
+#if HAVE_BROTLI
+  if (type == FIO___HTTP_ZIP_BR) {
+    BrotliEncoderState *b = (BrotliEncoderState *)zip;
+    const uint8_t *next_in = (const uint8_t *)buf;
+    size_t avail_in = len;
+    for (;;) {
+      uint8_t *next_out = (uint8_t *)r + pos;
+      size_t avail_out = capa - pos;
+      if (!BrotliEncoderCompressStream(
+              b,
+              (finish ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_FLUSH),
+              &avail_in,
+              &next_in,
+              &avail_out,
+              &next_out,
+              NULL))
+        goto error;
+      pos = capa - avail_out;
+      if (!avail_in && !BrotliEncoderHasMoreOutput(b) &&
+          (!finish || BrotliEncoderIsFinished(b)))
+        break;
+      if (avail_out)
+        continue;
+      r = fio_bstr_reserve(fio_bstr_len_set(r, pos), (capa >> 1));
+      capa += (capa >> 1);
+    }
+    return fio_bstr_len_set(r, pos);
+  }
+#endif
+#if HAVE_ZLIB || HAVE_BROTLI
+error:
+  FIO_LOG_ERROR("HTTP response compression failed");
+#endif
+  fio_bstr_free(r);
+  return NULL;
+  (void)type, (void)zip, (void)buf, (void)finish, (void)pos;
 }
 
-void fio_http_connect___(void); /* IDE Marker */
-/** Connects to HTTP / WebSockets / SSE connections on `url`. */
-SFUNC fio_io_s *fio_http_connect FIO_NOOP(const char *url,
-                                          fio_http_s *h,
-                                          fio_http_settings_s s) {
-  FIO_STR_INFO_TMP_VAR(origin, 4096);
-  http_settings_validate(&s, 1);
-  fio_url_s u = (fio_url_s){0};
-  if (url)
-    u = fio_url_parse(url, strlen(url));
+/** Weakens a strong `etag`, as the compressed body isn't byte-identical. */
+FIO_SFUNC void fio___http_zip_etag(fio_http_s *h) {
+  fio_str_info_s etag =
+      fio_http_response_header(h, FIO_STR_INFO2((char *)"etag", 4), 0);
+  char *tmp;
+  if (!etag.len || etag.buf[0] != '"')
+    return; /* no `etag`, or already weak (`W/"..."`) */
+  tmp = fio_bstr_write2(NULL,
+                        FIO_STRING_WRITE_STR2("W/", 2),
+                        FIO_STRING_WRITE_STR_INFO(etag));
+  fio_http_response_header_set(h,
+                               FIO_STR_INFO2((char *)"etag", 4),
+                               fio_bstr_info(tmp));
+  fio_bstr_free(tmp);
+}
 
-  if (!h)
-    h = fio_http_new();
-  if (!fio_http_path(h).len)
-    fio_http_path_set(h,
-                      u.path.len ? FIO_BUF2STR_INFO(u.path)
-                                 : FIO_STR_INFO2((char *)"/", 1));
-  if (!fio_http_query(h).len && u.query.len)
-    fio_http_query_set(h, FIO_BUF2STR_INFO(u.query));
-  if (!fio_http_method(h).len)
-    fio_http_method_set(h, FIO_STR_INFO2((char *)"GET", 3));
-  if (u.host.len) {
-    fio_http_request_header_set_if_missing(h,
-                                           FIO_STR_INFO2((char *)"host", 4),
-                                           FIO_BUF2STR_INFO(u.host));
-    /* Origin header */
-    fio_string_write2(
-        &origin,
-        NULL,
-        FIO_STRING_WRITE_STR2("https", (size_t)(4 + fio_url_is_tls(u).tls)),
-        FIO_STRING_WRITE_STR2("://", 3U),
-        FIO_STRING_WRITE_STR_INFO(u.host),
-        FIO_STRING_WRITE_STR2(":", (size_t)(!!u.port.len)),
-        FIO_STRING_WRITE_STR_INFO(u.port));
+/**
+ * Selects the response's content encoding (called before sending headers).
+ *
+ * Returns true if the headers should be sent with the (compressed) body.
+ */
+FIO_SFUNC int fio___http_zip_start(fio___http_connection_s *c, fio_http_s *h) {
+  size_t status = fio_http_status(h);
+  fio_str_info_s v;
+  uint8_t type;
+  c->state.http.zip_type = 0;
+  if (status < 200 || status == 204 || status == 206 || status == 304)
+    return 0;
+  v = fio_http_method(h);
+  if (v.len == 4 &&
+      (fio_buf2u32u(v.buf) | 0x20202020UL) == fio_buf2u32u("head"))
+    return 0;
+  if (fio_http_response_header(h,
+                               FIO_STR_INFO2((char *)"content-encoding", 16),
+                               0)
+          .len ||
+      !fio___http_zip_is_text(
+          fio_http_response_header(h,
+                                   FIO_STR_INFO2((char *)"content-type", 12),
+                                   0)))
+    return 0;
+  if (!fio_http_is_streaming(h)) {
+    v = fio_http_response_header(h,
+                                 FIO_STR_INFO2((char *)"content-length", 14),
+                                 0);
+    if (!v.len || fio_atol10u(&v.buf) < c->settings->compress_min)
+      return 0;
+  }
+  /* the response depends on `accept-encoding`, even if sent uncompressed */
+  fio_http_response_header_add(h,
+                               FIO_STR_INFO2((char *)"vary", 4),
+                               FIO_STR_INFO2((char *)"accept-encoding", 15));
+  if (!(type = fio___http_zip_accepted(h)))
+    return 0;
+  if (!fio_http_is_streaming(h)) {
+    c->state.http.zip_type = type;
+    return 1;
   }
+  c->state.http.zip = fio___http_zip_new(type, c->settings->compress, 0);
+  if (!c->state.http.zip)
+    return 0;
+  c->state.http.zip_type = type;
+  fio___http_zip_etag(h);
+  fio_http_response_header_set(
+      h,
+      FIO_STR_INFO2((char *)"content-encoding", 16),
+      (type == FIO___HTTP_ZIP_GZIP ? FIO_STR_INFO2((char *)"gzip", 4)
+                                   : FIO_STR_INFO2((char *)"br", 2)));
+  return 0;
+}
 
-  /* test for ws:// or wss:// - WebSocket scheme */
-  if ((u.scheme.len == 2 ||
-       (u.scheme.len == 3 && ((u.scheme.buf[2] | 0x20) == 's'))) &&
-      (fio_buf2u16u(u.scheme.buf) | 0x2020) == fio_buf2u16u("ws")) {
-    fio_http_request_header_set_if_missing(h,
-                                           FIO_STR_INFO2((char *)"origin", 6),
-                                           origin);
-    fio_http_websocket_set_request(h);
+/** Compresses a streaming response chunk, returns true if nothing is left. */
+FIO_SFUNC int fio___http_zip_chunk(fio___http_connection_s *c,
+                                   fio_http_write_args_s *args) {
+  char *tmp = NULL, *out;
+  const char *buf = (const char *)args->buf + args->offset;
+  size_t len = args->len;
+  if (!args->buf) {
+    if ((uint32_t)(args->fd + 1) <= 1U)
+      return 0; /* no data */
+    tmp = fio_bstr_readfd(NULL,
+                          args->fd,
+                          (intptr_t)args->offset,
+                          (intptr_t)args->len);
+    if (!args->copy)
+      close(args->fd);
+    buf = tmp;
+    len = fio_bstr_len(tmp);
   }
-  /* test for sse:// or sses:// - Server Sent Events scheme */
-  else if ((u.scheme.len == 3 ||
-            (u.scheme.len == 4 && ((u.scheme.buf[3] | 0x20) == 's'))) &&
-           (fio_buf2u32u(u.scheme.buf) | fio_buf2u32u("\x20\x20\x20\xFF")) ==
-               fio_buf2u32u("sse\xFF")) {
-    fio_http_request_header_set_if_missing(h,
-                                           FIO_STR_INFO2((char *)"origin", 6),
-                                           origin);
-    fio_http_sse_set_request(h);
+  out = (len ? fio___http_zip(c->state.http.zip_type,
+                              c->state.http.zip,
+                              buf,
+                              len,
+                              0)
+             : NULL);
+  fio_bstr_free(tmp);
+  if (args->buf && args->dealloc)
+    args->dealloc((void *)args->buf);
+  if (!fio_bstr_len(out)) {
+    fio_bstr_free(out);
+    return 1;
   }
-
-  /* TODO: test for and attempt to re-use connection */
-  // if (fio_http_cdata(h)) { }
-
-  fio___http_protocol_s *p = fio___http_protocol_new(u.host.len);
-  fio___http_protocol_init(p, url, s, 1);
-  fio___http_connection_s *c =
-      fio___http_connection_new(p->settings.max_line_len);
-  FIO_ASSERT_ALLOC(c);
-  *c = (fio___http_connection_s){
-      .io = NULL,
-      .h = h,
-      .settings = &(p->settings),
-      .queue = p->queue,
-      .udata = p->settings.udata,
-      .state.http =
-          {
-              .on_http_callback = p->on_http_callback,
-              .on_http = p->settings.on_http,
-              .on_finish = p->settings.on_finish,
-              .max_header = p->settings.max_header_size,
-              .max_line = p->settings.max_line_len,
-          },
-      .capa = p->settings.max_line_len,
-      .log = p->settings.log,
-      .is_client = 1,
+  *args = (fio_http_write_args_s){
+      .buf = out,
+      .len = fio_bstr_len(out),
+      .dealloc = (void (*)(void *))fio_bstr_free,
+      .finish = args->finish,
   };
-  fio_http_controller_set(h, &p->state[FIO___HTTP_PROTOCOL_HTTP1].controller);
-  if (!fio_http_udata(h)) /* avoid overwriting existing `udata` if set */
-    fio_http_udata_set(h, c->udata);
-  fio_http_cdata_set(h, fio___http_connection_dup(c));
-  return fio_io_connect(url,
-                        .protocol =
-                            &p->state[FIO___HTTP_PROTOCOL_HTTP1].protocol,
-                        .on_failed = fio___http_connect_on_failed,
-                        .udata = c,
-                        .tls = s.tls,
-                        .timeout = s.connect_timeout);
+  return 0;
 }
 
-/* *****************************************************************************
-HTTP/1.1 Request / Response Completed
-***************************************************************************** */
-
-/** called when either a request or a response was received. */
-static void fio_http1_on_complete(void *udata) {
-  fio___http_connection_s *c = (fio___http_connection_s *)udata;
-  fio_io_dup(c->io); /* make sure the IO and its data are valid in callback */
-  fio_io_suspend(c->io);
-  fio_http_s *h = c->h;
-  c->h = NULL;
-  c->state.http.header_bytes = 0;
-  c->suspend = 1;
-  // fio_io_defer(c->state.http.on_http_callback, h, NULL);
-  fio_queue_push(fio_io_queue(), c->state.http.on_http_callback, h);
+/** Finishes a streaming response's compression, writing the last chunk. */
+FIO_SFUNC void fio___http_zip_finish(fio___http_connection_s *c) {
+  char *out = NULL;
+  if (c->state.http.zip)
+    out = fio___http_zip(c->state.http.zip_type,
+                         c->state.http.zip,
+                         NULL,
+                         0,
+                         1);
+  fio___http_zip_free(c->state.http.zip_type, c->state.http.zip);
+  c->state.http.zip = NULL;
+  c->state.http.zip_type = 0;
+  if (fio_bstr_len(out))
+    fio_string_write2(&c->state.http.buf,
+                      FIO_STRING_REALLOC,
+                      FIO_STRING_WRITE_HEX(fio_bstr_len(out)),
+                      FIO_STRING_WRITE_STR2("\r\n", 2),
+                      FIO_STRING_WRITE_STR2(out, fio_bstr_len(out)),
+                      FIO_STRING_WRITE_STR2("\r\n", 2));
+  fio_bstr_free(out);
 }
 
 /* *****************************************************************************
-HTTP/1.1 Parser callbacks
+HTTP Response Cache (HTTP/1.x server connections)
+
+Responses to `GET` requests are recorded (serialized) while sent and later
+requests with the same key (path, query and `cache_vary` request headers) are
+answered using a zero-copy write of the (reference counted) recorded response.
+
+While a response is recorded, its entry is "pending" and requests for the same
+key wait in the entry's `waiting` list (request coalescing). Responses that
+can't be cached leave a "pass" entry, so requests bypass the cache (and the
+waiting list) until the entry expires.
 ***************************************************************************** */
 
-FIO_IFUNC void fio___http_request_too_big(fio___http_connection_s *c) {
-  fio_http_s *h = c->h;
-  fio_io_dup(c->io); /* sending the response will result in fio_undup */
-  fio_io_suspend(c->io);
-  c->h = NULL;
-  c->suspend = 1;
-  if (fio_http_send_error_response(h, 413))
-    fio_io_free(c->io); /* response not sent, we need to fio_undup */
-  fio_http_free(h);
-}
+/* a cache entry - pending (no `data`), a cached response or a "pass" entry */
+struct fio___http_cache_entry_s {
+  volatile uint32_t ref;
+  FIO_LIST_NODE node;    /* LRU list (if cached or "pass", not if pending) */
+  FIO_LIST_HEAD waiting; /* requests waiting for a pending entry */
+  fio___http_cache_s *cache;
+  char *key;       /* the cache key (fio_bstr) */
+  char *data;      /* the serialized response (fio_bstr) */
+  int64_t expires; /* expiration time (in milliseconds, `fio_io_last_tick`) */
+  uint64_t hash;
+  size_t mem;      /* memory counted against the cache limit */
+  size_t status;   /* the response status */
+  uint8_t pass;    /* the response couldn't be cached, bypass the cache */
+};
 
-FIO_IFUNC void fio_http1_attach_handle(fio___http_connection_s *c) {
-  c->h = fio_http_new();
-  FIO_ASSERT_ALLOC(c->h);
-  fio_http_controller_set(
-      c->h,
-      &(FIO_PTR_FROM_FIELD(fio___http_protocol_s, settings, c->settings))
-           ->state[FIO___HTTP_PROTOCOL_HTTP1]
-           .controller);
-  fio_http_udata_set(c->h, c->udata);
-  fio_http_cdata_set(c->h, fio___http_connection_dup(c));
+/* a request waiting for a pending entry (request coalescing). */
+typedef struct {
+  FIO_LIST_NODE node;
+  fio_http_s *h;
+} fio___http_cache_waiting_s;
+
+FIO_LEAK_COUNTER_DEF(fio___http_cache_entry_s)
+FIO_LEAK_COUNTER_DEF(fio___http_cache_waiting_s)
+FIO_LEAK_COUNTER_DEF(fio___http_cache_s)
+
+FIO_SFUNC void fio___http_cache_entry_free(fio___http_cache_entry_s *e) {
+  if (fio_atomic_sub_fetch(&e->ref, 1))
+    return;
+  fio_bstr_free(e->key);
+  fio_bstr_free(e->data);
+  FIO_LEAK_COUNTER_ON_FREE(fio___http_cache_entry_s);
+  FIO_MEM_FREE_(e, sizeof(*e));
 }
 
-/** called when a request method is parsed. */
-static int fio_http1_on_method(fio_buf_info_s method, void *udata) {
-  fio___http_connection_s *c = (fio___http_connection_s *)udata;
-  if (c->h)
-    return -1;
-  fio_http1_attach_handle(c);
-  fio_http_method_set(c->h, FIO_BUF2STR_INFO(method));
-  return 0;
+/* called (under lock) when an entry is removed from the cache's map */
+FIO_SFUNC void fio___http_cache_unlink(fio___http_cache_entry_s *e);
+
+#define FIO___RECURSIVE_INCLUDE  1
+#define FIO_MAP_NAME             fio___http_cache_map
+#define FIO_MAP_KEY_BSTR         /* the cache key */
+#define FIO_MAP_VALUE            fio___http_cache_entry_s *
+#define FIO_MAP_VALUE_DESTROY(o) fio___http_cache_unlink((o))
+#include FIO_INCLUDE_FILE
+#undef FIO___RECURSIVE_INCLUDE
+
+struct fio___http_cache_s {
+  fio___http_cache_map_s map;
+  FIO_LIST_HEAD lru; /* cached and "pass" entries, least recently used first */
+  size_t mem;
+  size_t limit;
+  int64_t ttl;   /* in milliseconds */
+  char *vary;    /* the (lower case) `cache_vary` list (fio_bstr) */
+  uint16_t ttl_sec;
+  FIO___LOCK_TYPE lock;
+};
+
+FIO_SFUNC void fio___http_cache_unlink(fio___http_cache_entry_s *e) {
+  if (!FIO_LIST_IS_EMPTY(&e->node)) { /* counted while in the LRU list */
+    e->cache->mem -= e->mem;
+    FIO_LIST_REMOVE_RESET(&e->node);
+  }
+  fio___http_cache_entry_free(e);
 }
-/** called when a response status is parsed. the status_str is the string
- * without the prefixed numerical status indicator.*/
-static int fio_http1_on_status(size_t istatus,
-                               fio_buf_info_s status,
-                               void *udata) {
-  fio___http_connection_s *c = (fio___http_connection_s *)udata;
-  fio_http_clear_response(c->h, istatus != 301 && istatus != 302);
-  fio_http_status_set(c->h, istatus);
-  return 0;
-  (void)status;
+
+FIO_SFUNC fio___http_cache_s *fio___http_cache_new(fio_http_settings_s *s) {
+  fio___http_cache_s *cache =
+      (fio___http_cache_s *)FIO_MEM_REALLOC_(NULL, 0, sizeof(*cache), 0);
+  FIO_ASSERT_ALLOC(cache);
+  FIO_LEAK_COUNTER_ON_ALLOC(fio___http_cache_s);
+  *cache = (fio___http_cache_s){
+      .lru = FIO_LIST_INIT(cache->lru),
+      .limit = s->cache_limit,
+      .ttl = (int64_t)s->cache_ttl * 1000,
+      .ttl_sec = s->cache_ttl,
+      .lock = FIO___LOCK_INIT,
+  };
+  cache->vary = fio_bstr_write(NULL, s->cache_vary.buf, s->cache_vary.len);
+  for (size_t i = 0; i < fio_bstr_len(cache->vary); ++i)
+    if (cache->vary[i] >= 'A' && cache->vary[i] <= 'Z')
+      cache->vary[i] |= 0x20;
+  s->cache_vary = fio_bstr_info(cache->vary); /* settings may be freed */
+  return cache;
 }
-/** called when a request URL is parsed. */
-static int fio_http1_on_url(fio_buf_info_s url, void *udata) {
-  fio___http_connection_s *c = (fio___http_connection_s *)udata;
-  fio_url_s u = fio_url_parse(url.buf, url.len);
-  if (!u.path.len || u.path.buf[0] != '/')
-    return -1;
-  fio_http_path_set(c->h, FIO_BUF2STR_INFO(u.path));
-  if (u.query.len)
-    fio_http_query_set(c->h, FIO_BUF2STR_INFO(u.query));
-  if (u.host.len)
-    (!(c->h) ? fio_http_request_header_set
-             : fio_http_response_header_set)(c->h,
-                                             FIO_STR_INFO1((char *)"host"),
-                                             FIO_BUF2STR_INFO(u.host));
+
+FIO_SFUNC void fio___http_cache_free(fio___http_cache_s *cache) {
+  fio___http_cache_map_destroy(&cache->map);
+  FIO___LOCK_DESTROY(cache->lock);
+  fio_bstr_free(cache->vary);
+  FIO_LEAK_COUNTER_ON_FREE(fio___http_cache_s);
+  FIO_MEM_FREE_(cache, sizeof(*cache));
+}
+
+FIO_IFUNC fio___http_cache_s *fio___http_cache(fio___http_connection_s *c) {
+  return FIO_PTR_FROM_FIELD(fio___http_protocol_s, settings, c->settings)
+      ->cache;
+}
+
+/* consumes the next token in a comma separated list, returns 0 when done. */
+FIO_SFUNC int fio___http_cache_token(fio_str_info_s *list, fio_str_info_s *t) {
+  char *pos = list->buf;
+  char *end = list->buf + list->len;
+  while (pos < end && (*pos == ',' || *pos == ' ' || *pos == '\t'))
+    ++pos;
+  if (pos >= end)
+    return 0;
+  t->buf = pos;
+  while (pos < end && *pos != ',')
+    ++pos;
+  t->len = (size_t)(pos - t->buf);
+  while (t->buf[t->len - 1] == ' ' || t->buf[t->len - 1] == '\t')
+    --t->len;
+  *list = FIO_STR_INFO2(pos, (size_t)(end - pos));
+  return 1;
+}
+
+/* returns true if `t` starts with the lower case `s` (case insensitive). */
+FIO_IFUNC int fio___http_cache_token_is(fio_str_info_s t,
+                                        const char *s,
+                                        size_t len) {
+  if (t.len < len)
+    return 0;
+  for (size_t i = 0; i < len; ++i)
+    if ((t.buf[i] | 0x20) != s[i])
+      return 0;
+  return 1;
+}
+
+/* returns true if the header `name` is part of the cache key. */
+FIO_SFUNC int fio___http_cache_is_vary(fio___http_cache_s *cache,
+                                       fio_str_info_s name) {
+  fio_str_info_s list = fio_bstr_info(cache->vary), t;
+  while (fio___http_cache_token(&list, &t))
+    if (t.len == name.len && fio___http_cache_token_is(name, t.buf, t.len))
+      return 1;
   return 0;
 }
-/** called when a the HTTP/1.x version is parsed. */
-static int fio_http1_on_version(fio_buf_info_s version, void *udata) {
-  fio___http_connection_s *c = (fio___http_connection_s *)udata;
-  FIO_ASSERT_DEBUG(c->h, "on_version called without a pre-existing handle!");
-  if (!c->h)
+
+/* writes the request's cache key, returns -1 if the request bypasses cache. */
+FIO_SFUNC int fio___http_cache_key(fio___http_cache_s *cache,
+                                   fio_http_s *h,
+                                   fio_str_info_s *key) {
+  fio_str_info_s v = fio_http_method(h), t, list;
+  int r;
+  if (v.len != 3 || (v.buf[0] | 0x20) != 'g' || (v.buf[1] | 0x20) != 'e' ||
+      (v.buf[2] | 0x20) != 't')
     return -1;
-  fio_http_version_set(c->h, FIO_BUF2STR_INFO(version));
-  return 0;
+  v = fio_http_version(h); /* the recorded status line includes the version */
+  if (v.len != 8 || fio_buf2u64u(v.buf) != fio_buf2u64u("HTTP/1.1"))
+    return -1;
+  v = fio_http_request_header(h,
+                              FIO_STR_INFO2((char *)"cache-control", 13),
+                              0);
+  while (fio___http_cache_token(&v, &t))
+    if (fio___http_cache_token_is(t, "no-cache", 8) ||
+        fio___http_cache_token_is(t, "no-store", 8))
+      return -1;
+  if (fio_http_request_header(h,
+                              FIO_STR_INFO2((char *)"authorization", 13),
+                              0)
+          .len &&
+      !fio___http_cache_is_vary(cache,
+                                FIO_STR_INFO2((char *)"authorization", 13)))
+    return -1;
+  /* NUL separators - header values can't contain NUL bytes */
+  v = fio_http_path(h);
+  r = fio_string_write(key, NULL, v.buf, v.len);
+  v = fio_http_query(h);
+  r |= fio_string_write(key, NULL, "\0", 1);
+  if (v.len)
+    r |= fio_string_write(key, NULL, v.buf, v.len);
+  list = fio_bstr_info(cache->vary);
+  while (fio___http_cache_token(&list, &t)) {
+    v = fio_http_request_header(h, t, 0);
+    r |= fio_string_write(key, NULL, "\0", 1);
+    if (v.len)
+      r |= fio_string_write(key, NULL, v.buf, v.len);
+  }
+  return r ? -1 : 0;
 }
-/** called when a header is parsed. */
-static int fio_http1_on_header(fio_buf_info_s name,
-                               fio_buf_info_s value,
-                               void *udata) {
-  fio___http_connection_s *c = (fio___http_connection_s *)udata;
-  if (!c->h)
-    return 0; /* ignore possible post-error response headers */
-  const size_t line_len = value.len + name.len;
-  c->state.http.header_bytes += line_len;
-  if ((unsigned)(c->state.http.header_bytes > c->state.http.max_header) |
-      (line_len > c->state.http.max_line))
-    goto headers_too_big;
-  (!fio_http_status(c->h)
-       ? fio_http_request_header_add
-       : fio_http_response_header_add)(c->h,
-                                       FIO_BUF2STR_INFO(name),
-                                       FIO_BUF2STR_INFO(value));
+
+FIO_SFUNC int fio___http_cache_any_cookie(fio_http_s *h,
+                                          fio_str_info_s name,
+                                          fio_str_info_s value,
+                                          void *udata) {
+  return 1;
+  (void)h, (void)name, (void)value, (void)udata;
+}
+
+/* returns the time (in seconds) a response may be cached, 0 if it can't. */
+FIO_SFUNC size_t fio___http_cache_response_ttl(fio___http_cache_s *cache,
+                                               fio_http_s *h) {
+  size_t ttl = cache->ttl_sec, age = (size_t)-1, s_age = (size_t)-1;
+  fio_str_info_s v, t;
+  switch (fio_http_status(h)) { /* cacheable by default (RFC 9110) */
+  case 200: /* fall through */
+  case 203: /* fall through */
+  case 204: /* fall through */
+  case 300: /* fall through */
+  case 301: /* fall through */
+  case 308: break;
+  default: return 0;
+  }
+  if (fio_http_is_streaming(h) ||
+      fio_http_set_cookie_each(h, fio___http_cache_any_cookie, NULL))
+    return 0;
+  v = fio_http_response_header(h, FIO_STR_INFO2((char *)"vary", 4), 0);
+  while (fio___http_cache_token(&v, &t))
+    if (!fio___http_cache_is_vary(cache, t)) /* also tests for `*` */
+      return 0;
+  v = fio_http_response_header(h,
+                               FIO_STR_INFO2((char *)"cache-control", 13),
+                               0);
+  while (fio___http_cache_token(&v, &t)) {
+    char *pos;
+    if (fio___http_cache_token_is(t, "no-store", 8) ||
+        fio___http_cache_token_is(t, "no-cache", 8) ||
+        fio___http_cache_token_is(t, "private", 7))
+      return 0;
+    if (fio___http_cache_token_is(t, "s-maxage=", 9)) {
+      pos = t.buf + 9;
+      s_age = (size_t)fio_atol10u(&pos);
+    } else if (fio___http_cache_token_is(t, "max-age=", 8)) {
+      pos = t.buf + 8;
+      age = (size_t)fio_atol10u(&pos);
+    }
+  }
+  if (s_age != (size_t)-1)
+    age = s_age;
+  if (age < ttl)
+    ttl = age;
+  return ttl;
+}
+
+/* adds an entry to the LRU list and evicts entries over the limit (locked) */
+FIO_SFUNC void fio___http_cache_store(fio___http_cache_s *cache,
+                                      fio___http_cache_entry_s *e) {
+  FIO_LIST_PUSH(&cache->lru, &e->node);
+  cache->mem += e->mem;
+  while (cache->mem > cache->limit && cache->lru.next != &e->node) {
+    fio___http_cache_entry_s *old =
+        FIO_PTR_FROM_FIELD(fio___http_cache_entry_s, node, cache->lru.next);
+    if (fio___http_cache_map_remove(&cache->map,
+                                    old->hash,
+                                    fio_bstr_info(old->key),
+                                    NULL))
+      break;
+  }
+}
+
+FIO_SFUNC void fio___http_perform_user_callback(void *cb_, void *h_);
+
+/* sends a cached response to `h` (consumes a reference to `e` and `h`). */
+FIO_SFUNC void fio___http_cache_send(void *h_, void *e_) {
+  fio_http_s *h = (fio_http_s *)h_;
+  fio___http_cache_entry_s *e = (fio___http_cache_entry_s *)e_;
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  c->state.http.cache = e;
+  c->state.http.cache_hit = 1;
+  fio_http_status_set(h, e->status);
+  fio_http_finish(h); /* the controller writes `e->data` */
+  fio_http_free(h);
+}
+
+/* releases requests waiting for `e` - sending `e` if it was cached. */
+FIO_SFUNC void fio___http_cache_release(fio___http_cache_entry_s *e) {
+  union {
+    void (*fn)(fio_http_s *);
+    void *ptr;
+  } cb;
+  while (!FIO_LIST_IS_EMPTY(&e->waiting)) {
+    fio___http_cache_waiting_s *w;
+    fio___http_connection_s *c;
+    fio_http_s *h;
+    FIO_LIST_POP(fio___http_cache_waiting_s, node, w, &e->waiting);
+    h = w->h;
+    FIO_LEAK_COUNTER_ON_FREE(fio___http_cache_waiting_s);
+    FIO_MEM_FREE_(w, sizeof(*w));
+    if (e->data) {
+      fio_atomic_add(&e->ref, 1);
+      fio_io_defer(fio___http_cache_send, (void *)h, (void *)e);
+      continue;
+    }
+    c = (fio___http_connection_s *)fio_http_cdata(h);
+    cb.fn = c->state.http.on_http;
+    fio_queue_push(c->queue, fio___http_perform_user_callback, cb.ptr, h);
+  }
+}
+
+/**
+ * Serves a request from the cache (or queues it while the response is
+ * recorded), returns 0 if `on_http` should be called for the request.
+ */
+FIO_SFUNC int fio___http_cache_request(fio___http_connection_s *c,
+                                       fio_http_s *h) {
+  fio___http_cache_s *cache = fio___http_cache(c);
+  fio___http_cache_entry_s *e;
+  fio___http_cache_waiting_s *w;
+  char buf[4096];
+  fio_str_info_s key = FIO_STR_INFO3(buf, 0, 4096);
+  uint64_t hash;
+  int64_t now;
+  int conditional;
+  if (fio___http_cache_key(cache, h, &key))
+    return 0;
+  /* a conditional request might get a (non-cacheable) 304 response */
+  conditional =
+      fio_http_request_header(h,
+                              FIO_STR_INFO2((char *)"if-none-match", 13),
+                              0)
+          .len ||
+      fio_http_request_header(h,
+                              FIO_STR_INFO2((char *)"if-modified-since", 17),
+                              0)
+          .len;
+  hash = fio_risky_hash(key.buf, key.len, (uint64_t)(uintptr_t)cache);
+  now = (int64_t)fio_io_last_tick();
+  FIO___LOCK_LOCK(cache->lock);
+  e = fio___http_cache_map_get(&cache->map, hash, key);
+  if (e && (e->data || e->pass) && e->expires <= now) {
+    fio___http_cache_map_remove(&cache->map, hash, key, NULL);
+    e = NULL;
+  }
+  if (!e)
+    goto record;
+  if (e->pass)
+    goto bypass;
+  if (!e->data)
+    goto wait;
+  /* cache hit - move to the end of the LRU list */
+  FIO_LIST_REMOVE(&e->node);
+  FIO_LIST_PUSH(&cache->lru, &e->node);
+  fio_atomic_add(&e->ref, 1);
+  FIO___LOCK_UNLOCK(cache->lock);
+  fio___http_cache_send((void *)h, (void *)e);
+  return 1;
+
+wait:
+  if (conditional)
+    goto bypass;
+  w = (fio___http_cache_waiting_s *)FIO_MEM_REALLOC_(NULL, 0, sizeof(*w), 0);
+  if (!w)
+    goto bypass;
+  FIO_LEAK_COUNTER_ON_ALLOC(fio___http_cache_waiting_s);
+  w->h = h;
+  FIO_LIST_PUSH(&e->waiting, &w->node);
+  FIO___LOCK_UNLOCK(cache->lock);
+  return 1;
+
+record:
+  if (conditional)
+    goto bypass;
+  e = (fio___http_cache_entry_s *)FIO_MEM_REALLOC_(NULL, 0, sizeof(*e), 0);
+  if (!e)
+    goto bypass;
+  FIO_LEAK_COUNTER_ON_ALLOC(fio___http_cache_entry_s);
+  *e = (fio___http_cache_entry_s){
+      .ref = 2, /* the map and the recording connection */
+      .node = FIO_LIST_INIT(e->node),
+      .waiting = FIO_LIST_INIT(e->waiting),
+      .cache = cache,
+      .key = fio_bstr_write(NULL, key.buf, key.len),
+      .hash = hash,
+      .mem = sizeof(*e) + (key.len << 1),
+  };
+  fio___http_cache_map_set(&cache->map, hash, key, e, NULL);
+  FIO___LOCK_UNLOCK(cache->lock);
+  c->state.http.cache = e;
+  c->state.http.cache_hit = 0;
+  return 0;
+
+bypass:
+  FIO___LOCK_UNLOCK(cache->lock);
   return 0;
-headers_too_big:
-  fio_http_send_error_response(c->h, 431);
-  return -1;
 }
-/** called when the special content-length header is parsed. */
-static int fio_http1_on_header_content_length(fio_buf_info_s name,
-                                              fio_buf_info_s value,
-                                              size_t content_length,
-                                              void *udata) {
-  fio___http_connection_s *c = (fio___http_connection_s *)udata;
-  fio_http_s *h = c->h;
-  if (!h)
+
+/* stops recording (or sending) a response, `pass` marks it as non-cacheable */
+FIO_SFUNC void fio___http_cache_abandon(fio___http_connection_s *c, int pass) {
+  fio___http_cache_entry_s *e = c->state.http.cache;
+  fio___http_cache_s *cache = e->cache;
+  c->state.http.cache = NULL;
+  if (c->state.http.cache_hit)
+    goto finish;
+  FIO___LOCK_LOCK(cache->lock);
+  if (fio___http_cache_map_get(&cache->map, e->hash, fio_bstr_info(e->key)) ==
+      e) {
+    if (pass) {
+      e->pass = 1;
+      e->expires = (int64_t)fio_io_last_tick() + cache->ttl;
+      fio___http_cache_store(cache, e);
+    } else
+      fio___http_cache_map_remove(&cache->map,
+                                  e->hash,
+                                  fio_bstr_info(e->key),
+                                  NULL);
+  }
+  FIO___LOCK_UNLOCK(cache->lock);
+  fio___http_cache_release(e); /* the waiting list is no longer shared */
+finish:
+  fio___http_cache_entry_free(e);
+}
+
+/* tests the recorded response headers, returns true when sending from cache */
+FIO_SFUNC int fio___http_cache_on_headers(fio___http_connection_s *c,
+                                          fio_http_s *h) {
+  fio___http_cache_entry_s *e = c->state.http.cache;
+  size_t ttl;
+  if (c->state.http.cache_hit)
+    return 1;
+  if (!c->io || !fio_io_is_open(c->io)) {
+    fio___http_cache_abandon(c, 0);
     return 0;
-  if (content_length > c->settings->max_body_size)
-    goto too_big;
-  if (content_length)
-    fio_http_body_expect(c->h, content_length);
-#if FIO_HTTP_SHOW_CONTENT_LENGTH_HEADER
-  (!(h->status) ? fio_http_request_header_add
-                : fio_http_response_header_add)(h,
-                                                FIO_BUF2STR_INFO(name),
-                                                FIO_BUF2STR_INFO(value));
-#endif
+  }
+  if (!(ttl = fio___http_cache_response_ttl(e->cache, h))) {
+    fio___http_cache_abandon(c, 1);
+    return 0;
+  }
+  e->status = fio_http_status(h);
+  e->expires = (int64_t)fio_io_last_tick() + ((int64_t)ttl * 1000);
   return 0;
-too_big:
-  fio___http_request_too_big(c);
-  return 0; /* should we disconnect (return -1), or not? */
-  (void)name, (void)value;
 }
-/** called when `Expect` arrives and may require a 100 continue response. */
-static int fio_http1_on_expect(void *udata) {
-  fio___http_connection_s *c = (fio___http_connection_s *)udata;
-  const fio_buf_info_s response =
-      FIO_BUF_INFO1((char *)"HTTP/1.1 100 Continue\r\n\r\n");
-  fio_http_s *h = c->h;
-  if (!h)
+
+/* records body data, returns true if the data was consumed */
+FIO_SFUNC int fio___http_cache_on_body(fio___http_connection_s *c,
+                                       fio_http_write_args_s *args) {
+  if (c->state.http.cache_hit)
     return 1;
-  c->h = NULL;
-  /* TODO: test for body size violation and deny request if payload too big. */
-  if (FIO_HTTP1_EXPECTED_CHUNKED != fio_http1_expected(&c->state.http.parser) &&
-      c->settings->max_body_size > fio_http1_expected(&c->state.http.parser))
-    goto payload_too_big;
-  c->settings->pre_http_body(h);
-  if (fio_http_status(h))
-    goto response_sent;
-  c->h = h;
-  fio_io_write2(c->io, .buf = response.buf, .len = response.len, .copy = 0);
-  return 0; /* TODO?: improve support for `expect` headers? */
-payload_too_big:
-  fio_io_dup(c->io);
-  if (fio_http_send_error_response(h, 413))
-    fio_io_free(c->io); /* response not sent, we need to fio_undup */
-                        /* fall through */
-response_sent:
-  // c->h = NULL;
-  fio_http_free(h);
+  if (!args->buf) {
+    if ((uint32_t)(args->fd + 1) <= 1U)
+      return 1; /* no data */
+    fio___http_cache_abandon(c, 1); /* files aren't cached */
+    return 0;
+  }
+  if (c->state.http.buf.len + args->len >
+      (c->state.http.cache->cache->limit >> 3)) {
+    fio___http_cache_abandon(c, 1);
+    return 0;
+  }
+  fio_string_write(&c->state.http.buf,
+                   FIO_STRING_REALLOC,
+                   (char *)args->buf + args->offset,
+                   args->len);
+  if (args->dealloc)
+    args->dealloc((void *)args->buf);
   return 1;
 }
 
-/** called when a body chunk is parsed. */
-static int fio_http1_on_body_chunk(fio_buf_info_s chunk, void *udata) {
-  fio___http_connection_s *c = (fio___http_connection_s *)udata;
-  if (!c->h)
-    return -1; /* close connection if a large payload is unstoppable */
-  if (c->is_client &&
-      (fio_http_status(c->h) == 301 || fio_http_status(c->h) == 302))
-    return 0; /* don't overwrite client payload on redirect */
-  if (chunk.len + fio_http_body_length(c->h) > c->settings->max_body_size)
-    goto too_big;
-  fio_http_body_write(c->h, chunk.buf, chunk.len);
-  return 0;
-too_big:
-  fio___http_request_too_big(c);
-  return 0;
+/* sends the cached response, or caches the recorded one and sends it */
+FIO_SFUNC void fio___http_cache_on_finish(fio___http_connection_s *c) {
+  fio___http_cache_entry_s *e = c->state.http.cache;
+  fio___http_cache_s *cache = e->cache;
+  char *data;
+  if (c->state.http.cache_hit) {
+    fio_io_write2(c->io,
+                  .buf = fio_bstr_copy(e->data),
+                  .len = fio_bstr_len(e->data),
+                  .dealloc = (void (*)(void *))fio_bstr_free);
+    c->state.http.cache = NULL;
+    fio___http_cache_entry_free(e);
+    return;
+  }
+  if (!c->state.http.buf.len || !fio_io_is_open(c->io)) {
+    fio___http_cache_abandon(c, 0);
+    return;
+  }
+  data = fio_bstr_write(NULL, c->state.http.buf.buf, c->state.http.buf.len);
+  FIO_STRING_FREE2(c->state.http.buf);
+  c->state.http.buf = FIO_STR_INFO0;
+  c->state.http.cache = NULL;
+  fio_io_write2(c->io,
+                .buf = fio_bstr_copy(data),
+                .len = fio_bstr_len(data),
+                .dealloc = (void (*)(void *))fio_bstr_free);
+  FIO___LOCK_LOCK(cache->lock);
+  e->data = data;
+  e->mem += fio_bstr_len(data);
+  if (fio___http_cache_map_get(&cache->map, e->hash, fio_bstr_info(e->key)) ==
+      e)
+    fio___http_cache_store(cache, e);
+  FIO___LOCK_UNLOCK(cache->lock);
+  fio___http_cache_release(e); /* the waiting list is no longer shared */
+  fio___http_cache_entry_free(e);
 }
 
 /* *****************************************************************************
-HTTP/1.1 Accepting new connections (tests for special HTTP/2 pre-knowledge)
+HTTP Request handling / handling
 ***************************************************************************** */
 
-/** Called when an IO is attached to a protocol. */
-FIO_SFUNC void fio___http_on_attach_accept(fio_io_s *io) {
+FIO_SFUNC void fio___http_perform_user_callback(void *cb_, void *h_) {
+  union {
+    void (*fn)(fio_http_s *);
+    void *ptr;
+  } cb = {.ptr = cb_};
+  fio_http_s *h = (fio_http_s *)h_;
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
 
-  fio___http_protocol_s *p =
-      FIO_PTR_FROM_FIELD(fio___http_protocol_s,
-                         state[FIO___HTTP_PROTOCOL_ACCEPT].protocol,
-                         fio_io_protocol(io));
-  fio___http_protocol_dup(p);
-  // p->queue = fio_io_queue();
+  if (FIO_LIKELY(FIO_SOCK_IS_OPEN(fio_io_fd(c->io))))
+    cb.fn(h);
+  fio_http_free(h);
+}
 
-  const uint32_t capa = p->settings.max_line_len;
-  fio___http_connection_s *c = fio___http_connection_new(capa);
-  FIO_ASSERT_ALLOC(c);
-  *c = (fio___http_connection_s){
-      .io = io,
-      .settings = &(p->settings),
-      .queue =
-          ((p->settings.queue && p->settings.queue->q) ? p->settings.queue->q
-                                                       : fio_io_queue()),
-      .udata = p->settings.udata,
-      .state.http =
-          {
-              .on_http_callback = p->on_http_callback,
-              .on_http = p->settings.on_http,
-              .on_finish = p->settings.on_finish,
-              .max_header = p->settings.max_header_size,
-              .max_line = p->settings.max_line_len,
-          },
-      .capa = capa,
-      .log = p->settings.log,
-  };
-  fio_io_udata_set(io, (void *)c);
-  FIO_LOG_DDEBUG2("(%d) HTTP accepted a new connection (%p)",
-                  (int)fio_thread_getpid(),
-                  c->io);
-#if 0 /* skip pre-knowledge test? */
+FIO_SFUNC void fio___http_perform_user_upgrade_callback_websocket(void *cb_,
+                                                                  void *h_) {
+  union {
+    int (*fn)(fio_http_s *);
+    void *ptr;
+  } cb = {.ptr = cb_};
+  fio_http_s *h = (fio_http_s *)h_;
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  struct fio___http_connection_http_s old = c->state.http;
+  if (!FIO_LIKELY(fio_io_is_open(c->io)) || cb.fn(h))
+    goto refuse_upgrade;
+  if (c->h) /* request after WebSocket Upgrade? an attack vector? */
+    goto refuse_upgrade;
+#if HAVE_ZLIB
+  if (c->settings->ws_deflate)
+    fio___http_ws_deflate_negotiate(h, c->settings);
+#endif
+  fio_http_upgrade_websocket(h);
+  return;
+
+refuse_upgrade:
+  c->state.http = old;
+  if (fio_http_send_error_response(h, 403))
+    fio_io_free(c->io);
+  fio_http_free(h);
+}
+
+FIO_SFUNC void fio___http_perform_user_upgrade_callback_sse(void *cb_,
+                                                            void *h_) {
+  union {
+    int (*fn)(fio_http_s *);
+    void *ptr;
+  } cb = {.ptr = cb_};
+  fio_http_s *h = (fio_http_s *)h_;
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  if (!FIO_LIKELY(fio_io_is_open(c->io)) || cb.fn(h))
+    goto refuse_upgrade;
+  if (c->h) /* request after eventsource? an attack vector? */
+    goto refuse_upgrade;
+  fio_http_upgrade_sse(h);
+  return;
+
+refuse_upgrade:
+  if (fio_http_send_error_response(h, 403))
+    fio_io_free(c->io);
+  fio_http_free(h);
+}
+
+FIO_IFUNC int fio___http_on_http_test4upgrade(fio_http_s *h,
+                                              fio___http_connection_s *c) {
+  union {
+    int (*fn)(fio_http_s *);
+    void *ptr;
+  } cb;
+  if (fio_http_websocket_requested(h))
+    goto websocket_requested;
+  if (fio_http_sse_requested(h))
+    goto sse_requested;
+  return 0;
+websocket_requested:
+  cb.fn = c->settings->on_authenticate_websocket;
+  fio_queue_push(c->queue,
+                 fio___http_perform_user_upgrade_callback_websocket,
+                 cb.ptr,
+                 (void *)h);
+  return -1;
+
+sse_requested:
+  cb.fn = c->settings->on_authenticate_sse;
+  fio_queue_push(c->queue,
+                 fio___http_perform_user_upgrade_callback_sse,
+                 cb.ptr,
+                 (void *)h);
+  return -1;
+
+#if 0
+http2_requested:
+  // Connection: Upgrade, HTTP2-Settings
+  // Upgrade: h2c
+  // HTTP2-Settings: <base64url encoding of HTTP/2 SETTINGS payload>
+  return 0; /* allowed to ignore upgrade request */
+#endif
+}
+
+FIO_SFUNC void fio___http_on_http_direct(void *h_, void *ignr) {
+  fio_http_s *h = (fio_http_s *)h_;
+  fio_http_status_set(h, 200);
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  if (fio___http_on_http_test4upgrade(h, c))
+    return;
+  if (fio___http_cache(c) && fio___http_cache_request(c, h))
+    return;
+  union {
+    void (*fn)(fio_http_s *);
+    void *ptr;
+  } cb = {.fn = c->state.http.on_http};
+  fio_queue_push(c->queue, fio___http_perform_user_callback, cb.ptr, (void *)h);
+  (void)ignr;
+}
+
+FIO_SFUNC void fio___http_on_http_with_public_folder(void *h_, void *ignr) {
+  fio_http_s *h = (fio_http_s *)h_;
+  fio_http_status_set(h, 200);
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  if (fio___http_on_http_test4upgrade(h, c))
+    return;
+  if ((fio_http_method(h).len != 4 || (fio_buf2u32u(fio_http_method(h).buf) |
+                                       0x20202020UL) != fio_buf2u32u("post")) &&
+      !fio_http_static_file_response(h,
+                                     c->settings->public_folder,
+                                     fio_http_path(h),
+                                     c->settings->max_age)) {
+    fio_http_free(h);
+    return;
+  }
+  if (fio___http_cache(c) && fio___http_cache_request(c, h))
+    return;
+  union {
+    void (*fn)(fio_http_s *);
+    void *ptr;
+  } cb = {.fn = c->state.http.on_http};
+  fio_queue_push(c->queue, fio___http_perform_user_callback, cb.ptr, (void *)h);
+  (void)ignr;
+}
+
+FIO_SFUNC void fio___http_perform_user_callback_client(void *cb_, void *h_) {
+  fio_http_s *h = (fio_http_s *)h_;
+  union {
+    void (*fn)(fio_http_s *);
+    void *ptr;
+  } cb = {.ptr = cb_};
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  /* unlike Server mode, handle responses from closed connections */
+  cb.fn(h);
+  fio_http_free(h);
+  fio_io_free(c->io);
+}
+
+FIO_SFUNC void fio___http_on_http_client(void *h_, void *ignr) {
+  fio_http_s *h = (fio_http_s *)h_;
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  size_t pr = FIO___HTTP_PROTOCOL_WS;
+  union {
+    void (*fn)(fio_http_s *);
+    void *ptr;
+  } cb = {.fn = c->state.http.on_http};
+
+  /* TODO! review WS and SSE responses. */
+  if (fio_http_websocket_accepted(h))
+    goto websocket_accepted;
+  if (fio_http_sse_accepted(h))
+    goto sse_accepted;
+  fio_queue_push(c->queue,
+                 fio___http_perform_user_callback_client,
+                 cb.ptr,
+                 (void *)h);
+  return;
+  (void)ignr;
+
+sse_accepted:
+  pr = FIO___HTTP_PROTOCOL_SSE;
+
+websocket_accepted:
+  c->h = h; /* was set to NULL in `on_http_complete` */
+  fio_http_controller_set(
+      c->h,
+      &(FIO_PTR_FROM_FIELD(fio___http_protocol_s, settings, c->settings)
+            ->state[pr]
+            .controller));
+  fio_io_protocol_set(
+      c->io,
+      &(FIO_PTR_FROM_FIELD(fio___http_protocol_s, settings, c->settings)
+            ->state[pr]
+            .protocol));
+
+  FIO_LOG_DDEBUG2("(%d) Client %s upgrade complete for fd %d",
+                  fio_io_pid(),
+                  (fio_http_is_websocket(h) ? "WebSocket" : "SSE"),
+                  fio_io_fd(c->io));
+
+  fio_io_free(c->io); /* fio_dup called by fio_http1_on_complete */
+  c->suspend = 0;
+  fio_io_unsuspend(c->io);
+}
+
+/* *****************************************************************************
+ALPN Helpers
+***************************************************************************** */
+
+FIO_SFUNC void fio___http_on_select_h1(fio_io_s *io) {
+  FIO_LOG_DDEBUG2("TLS ALPN HTTP/1.1 selected for %p", io);
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_io_udata(io);
   fio_io_protocol_set(
       io,
       &(FIO_PTR_FROM_FIELD(fio___http_protocol_s, settings, c->settings)
             ->state[FIO___HTTP_PROTOCOL_HTTP1]
             .protocol));
-#endif
+}
+FIO_SFUNC void fio___http_on_select_h2(fio_io_s *io) {
+  /* the HTTP/2 client preface is detected by `fio___http1_accept_on_data` */
+  FIO_LOG_DDEBUG2("TLS ALPN HTTP/2 selected for %p", io);
+  (void)io;
 }
 
-/** Called when a data is available. */
-FIO_SFUNC void fio___http1_accept_on_data(fio_io_s *io) {
-  const fio_buf_info_s prior_knowledge = FIO_BUF_INFO2(
-      (char *)"\x50\x52\x49\x20\x2a\x20\x48\x54\x54\x50\x2f\x32\x2e\x30"
-              "\x0d\x0a\x0d\x0a\x53\x4d\x0d\x0a\x0d\x0a",
-      24);
-  fio___http_connection_s *c = (fio___http_connection_s *)fio_io_udata(io);
-  fio_io_protocol_s *phttp_new;
-  size_t r = fio_io_read(io, c->buf + c->len, c->capa - c->len);
-  if (!r) /* nothing happened */
-    return;
-  c->len = (uint32_t)r;
-  if (prior_knowledge.buf[0] != c->buf[0] ||
-      FIO_MEMCMP(
-          prior_knowledge.buf,
-          c->buf,
-          (c->len > prior_knowledge.len ? prior_knowledge.len : c->len))) {
-    /* no prior knowledge, switch to HTTP/1.1 */
-    phttp_new =
-        &(FIO_PTR_FROM_FIELD(fio___http_protocol_s, settings, c->settings)
-              ->state[FIO___HTTP_PROTOCOL_HTTP1]
-              .protocol);
-    fio_io_protocol_set(io, phttp_new);
-    return;
-  }
-  if (c->len < prior_knowledge.len) /* wait for more data */
+/* *****************************************************************************
+HTTP Listen
+***************************************************************************** */
+
+static void fio___http_listen_on_start(fio_io_protocol_s *protocol, void *u) {
+  (void)u;
+  fio___http_protocol_s *p =
+      FIO_PTR_FROM_FIELD(fio___http_protocol_s,
+                         state[FIO___HTTP_PROTOCOL_ACCEPT].protocol,
+                         protocol);
+  p->queue = ((p->settings.queue && p->settings.queue->q) ? p->settings.queue->q
+                                                          : fio_io_queue());
+}
+
+static void fio___http_listen_on_stop(fio_io_protocol_s *p, void *u) {
+  (void)u;
+  fio___http_protocol_free(
+      FIO_PTR_FROM_FIELD(fio___http_protocol_s,
+                         state[FIO___HTTP_PROTOCOL_ACCEPT].protocol,
+                         p));
+}
+
+void fio_http_listen___(void); /* IDE marker */
+SFUNC void *fio_http_listen FIO_NOOP(const char *url, fio_http_settings_s s) {
+  http_settings_validate(&s, 0);
+  fio___http_protocol_s *p = fio___http_protocol_new(s.public_folder.len + 1);
+  fio___http_protocol_init(p, url, s, 0);
+  void *listener =
+      fio_io_listen(.url = url,
+                    .protocol = &p->state[FIO___HTTP_PROTOCOL_ACCEPT].protocol,
+                    .tls = p->settings.tls, /* includes ALPN protocols */
+                    .on_start = fio___http_listen_on_start,
+                    .on_stop = fio___http_listen_on_stop,
+                    .queue_for_accept = p->settings.queue);
+  return listener;
+}
+
+/** Returns the a pointer to the HTTP settings associated with the listener. */
+SFUNC fio_http_settings_s *fio_http_listener_settings(void *listener) {
+  fio___http_protocol_s *p =
+      FIO_PTR_FROM_FIELD(fio___http_protocol_s,
+                         state[FIO___HTTP_PROTOCOL_ACCEPT].protocol,
+                         fio_io_listener_protocol(listener));
+  return &p->settings;
+}
+/* *****************************************************************************
+HTTP Client Connection Pool
+
+Pooled client connections are kept (per origin) after a response was handled
+and reused for later requests, saving the TCP / TLS handshake. Requests are
+queued while all of an origin's connections are busy and sent (in order) as
+connections are released.
+
+Idle connections are monitored by the reactor, so connections closed by the
+server (or by the `timeout`) are removed from the pool.
+***************************************************************************** */
+
+/* a request waiting to be sent over a pooled connection. */
+typedef struct {
+  FIO_LIST_NODE node;
+  fio___http_pool_s *pool;
+  fio_http_s *h;
+  void (*on_http)(fio_http_s *h);
+  void (*on_finish)(fio_http_s *h);
+} fio___http_pool_req_s;
+
+/* an origin's connection pool (kept until the program exits). */
+struct fio___http_pool_s {
+  FIO_LIST_HEAD idle;       /* idle connections, most recently used first */
+  FIO_LIST_HEAD queue;      /* requests waiting for a connection */
+  fio___http_protocol_s *p; /* settings used by all of the pool's connections */
+  char *url;                /* the URL used for new connections (fio_bstr) */
+  uint32_t open;            /* open (or connecting) connections */
+  uint32_t idle_count;      /* connections in the `idle` list */
+};
+
+FIO_LEAK_COUNTER_DEF(fio___http_pool_req_s)
+FIO_LEAK_COUNTER_DEF(fio___http_pool_s)
+
+FIO_SFUNC void fio___http_pool_destroy(fio___http_pool_s *pool);
+
+#define FIO___RECURSIVE_INCLUDE  1
+#define FIO_MAP_NAME             fio___http_pool_map
+#define FIO_MAP_KEY_BSTR         /* scheme, host, port and TLS settings */
+#define FIO_MAP_VALUE            fio___http_pool_s *
+#define FIO_MAP_VALUE_DESTROY(o) fio___http_pool_destroy((o))
+#include FIO_INCLUDE_FILE
+#undef FIO___RECURSIVE_INCLUDE
+
+static struct {
+  fio___http_pool_map_s map;
+  FIO___LOCK_TYPE lock;
+  uint8_t at_exit;
+} FIO___HTTP_POOL = {.lock = FIO___LOCK_INIT};
+
+FIO_SFUNC void fio___http1_send_request(fio_http_s *h);
+static void fio___http_connect_on_failed(fio_io_protocol_s *p, void *udata);
+
+FIO_SFUNC fio___http_pool_req_s *fio___http_pool_req_new(
+    fio___http_pool_s *pool,
+    fio_http_s *h,
+    fio_http_settings_s *s) {
+  fio___http_pool_req_s *r =
+      (fio___http_pool_req_s *)FIO_MEM_REALLOC_(NULL, 0, sizeof(*r), 0);
+  FIO_ASSERT_ALLOC(r);
+  FIO_LEAK_COUNTER_ON_ALLOC(fio___http_pool_req_s);
+  *r = (fio___http_pool_req_s){
+      .pool = pool,
+      .h = h,
+      .on_http = s->on_http,
+      .on_finish = s->on_finish,
+  };
+  return r;
+}
+
+FIO_SFUNC void fio___http_pool_req_free(fio___http_pool_req_s *r) {
+  FIO_LEAK_COUNTER_ON_FREE(fio___http_pool_req_s);
+  FIO_MEM_FREE_(r, sizeof(*r));
+}
+
+FIO_SFUNC void fio___http_pool_destroy(fio___http_pool_s *pool) {
+  while (!FIO_LIST_IS_EMPTY(&pool->queue)) {
+    fio___http_pool_req_s *r;
+    FIO_LIST_POP(fio___http_pool_req_s, node, r, &pool->queue);
+    fio_http_free(r->h);
+    fio___http_pool_req_free(r);
+  }
+  fio___http_protocol_free(pool->p);
+  fio_bstr_free(pool->url);
+  FIO_LEAK_COUNTER_ON_FREE(fio___http_pool_s);
+  FIO_MEM_FREE_(pool, sizeof(*pool));
+}
+
+FIO_SFUNC void fio___http_pool_cleanup(void *ignr_) {
+  FIO___LOCK_LOCK(FIO___HTTP_POOL.lock);
+  fio___http_pool_map_destroy(&FIO___HTTP_POOL.map);
+  FIO___LOCK_UNLOCK(FIO___HTTP_POOL.lock);
+  (void)ignr_;
+}
+
+/* returns the connection pool for the origin (created using `s` if new). */
+FIO_SFUNC fio___http_pool_s *fio___http_pool_get(const char *url,
+                                                 fio_url_s u,
+                                                 fio_http_settings_s *s) {
+  FIO_STR_INFO_TMP_VAR(key, 1024);
+  fio___http_pool_s *pool;
+  uint64_t hash;
+  fio_string_write2(&key,
+                    NULL,
+                    FIO_STRING_WRITE_STR2("s", (size_t)fio_url_is_tls(u).tls),
+                    FIO_STRING_WRITE_STR_INFO(u.host),
+                    FIO_STRING_WRITE_STR2(":", 1),
+                    FIO_STRING_WRITE_STR_INFO(u.port),
+                    FIO_STRING_WRITE_STR2("@", 1),
+                    FIO_STRING_WRITE_HEX((uintptr_t)s->tls));
+  hash = fio_risky_hash(key.buf,
+                        key.len,
+                        (uint64_t)(uintptr_t)&FIO___HTTP_POOL);
+  FIO___LOCK_LOCK(FIO___HTTP_POOL.lock);
+  pool = fio___http_pool_map_get(&FIO___HTTP_POOL.map, hash, key);
+  if (pool)
+    goto done;
+  pool = (fio___http_pool_s *)FIO_MEM_REALLOC_(NULL, 0, sizeof(*pool), 0);
+  FIO_ASSERT_ALLOC(pool);
+  FIO_LEAK_COUNTER_ON_ALLOC(fio___http_pool_s);
+  *pool = (fio___http_pool_s){
+      .p = fio___http_protocol_new(u.host.len),
+      .url = fio_bstr_write(NULL, url, strlen(url)),
+  };
+  pool->idle = FIO_LIST_INIT(pool->idle);
+  pool->queue = FIO_LIST_INIT(pool->queue);
+  fio___http_protocol_init(pool->p, url, *s, 1);
+  fio___http_pool_map_set(&FIO___HTTP_POOL.map, hash, key, pool, NULL);
+  if (!FIO___HTTP_POOL.at_exit) {
+    FIO___HTTP_POOL.at_exit = 1;
+    fio_state_callback_add(FIO_CALL_AT_EXIT, fio___http_pool_cleanup, NULL);
+  }
+done:
+  FIO___LOCK_UNLOCK(FIO___HTTP_POOL.lock);
+  return pool;
+}
+
+/* attaches an HTTP client handle to the connection (the handle's request). */
+FIO_SFUNC void fio___http_client_attach(fio___http_connection_s *c,
+                                        fio_http_s *h) {
+  fio_http_controller_set(
+      h,
+      &(FIO_PTR_FROM_FIELD(fio___http_protocol_s, settings, c->settings)
+            ->state[FIO___HTTP_PROTOCOL_HTTP1]
+            .controller));
+  if (!fio_http_udata(h)) /* avoid overwriting existing `udata` if set */
+    fio_http_udata_set(h, c->udata);
+  fio_http_cdata_set(h, fio___http_connection_dup(c));
+}
+
+/* opens a new client connection for `h`, consuming a reference to `p`. */
+FIO_SFUNC fio_io_s *fio___http_client_new(const char *url,
+                                          fio___http_protocol_s *p,
+                                          fio___http_pool_s *pool,
+                                          fio_http_s *h,
+                                          void (*on_http)(fio_http_s *),
+                                          void (*on_finish)(fio_http_s *)) {
+  fio___http_connection_s *c =
+      fio___http_connection_new(p->settings.max_line_len);
+  FIO_ASSERT_ALLOC(c);
+  *c = (fio___http_connection_s){
+      .io = NULL,
+      .h = h,
+      .settings = &(p->settings),
+      .queue = p->queue,
+      .udata = p->settings.udata,
+      .state.http =
+          {
+              .on_http_callback = p->on_http_callback,
+              .on_http = on_http,
+              .on_finish = on_finish,
+              .max_header = p->settings.max_header_size,
+              .max_line = p->settings.max_line_len,
+              .pool = pool,
+          },
+      .capa = p->settings.max_line_len,
+      .log = p->settings.log,
+      .is_client = 1,
+  };
+  c->state.http.pool_node = FIO_LIST_INIT(c->state.http.pool_node);
+  fio___http_client_attach(c, h);
+  return fio_io_connect(url,
+                        .protocol =
+                            &p->state[FIO___HTTP_PROTOCOL_HTTP1].protocol,
+                        .on_failed = fio___http_connect_on_failed,
+                        .udata = c,
+                        .tls = p->settings.tls,
+                        .timeout = p->settings.connect_timeout);
+}
+
+/* opens a new pooled connection for the request (a slot was reserved). */
+FIO_SFUNC fio_io_s *fio___http_pool_connect(fio___http_pool_req_s *r) {
+  fio___http_pool_s *pool = r->pool;
+  fio_http_s *h = r->h;
+  void (*on_http)(fio_http_s *) = r->on_http;
+  void (*on_finish)(fio_http_s *) = r->on_finish;
+  fio___http_pool_req_free(r);
+  return fio___http_client_new(pool->url,
+                               fio___http_protocol_dup(pool->p),
+                               pool,
+                               h,
+                               on_http,
+                               on_finish);
+}
+
+FIO_SFUNC fio_io_s *fio___http_pool_request(fio___http_pool_req_s *r);
+
+/* sends a request over an idle pooled connection (performed by the IO loop) */
+FIO_SFUNC void fio___http_pool_send_task(void *c_, void *r_) {
+  fio___http_connection_s *c = (fio___http_connection_s *)c_;
+  fio___http_pool_req_s *r = (fio___http_pool_req_s *)r_;
+  if (!c->io || !fio_io_is_open(c->io)) { /* closed while idle - retry */
+    fio___http_connection_free(c);
+    fio___http_pool_request(r);
+    return;
+  }
+  c->h = r->h;
+  c->state.http.on_http = r->on_http;
+  c->state.http.on_finish = r->on_finish;
+  fio___http_pool_req_free(r);
+  fio___http_client_attach(c, c->h);
+  fio___http1_send_request(c->h);
+  fio___http_connection_free(c);
+}
+
+/* sends the request using an idle connection, a new connection or queues it */
+FIO_SFUNC fio_io_s *fio___http_pool_request(fio___http_pool_req_s *r) {
+  fio___http_pool_s *pool = r->pool;
+  fio___http_connection_s *c = NULL;
+  fio_io_s *io = NULL;
+  FIO___LOCK_LOCK(FIO___HTTP_POOL.lock);
+  if (!FIO_LIST_IS_EMPTY(&pool->idle)) {
+    c = FIO_PTR_FROM_FIELD(fio___http_connection_s,
+                           state.http.pool_node,
+                           pool->idle.next);
+    FIO_LIST_REMOVE_RESET(&c->state.http.pool_node);
+    --pool->idle_count;
+    c = fio___http_connection_dup(c); /* the IO might close meanwhile */
+    io = c->io;
+  } else if (pool->open < pool->p->settings.pool_max) {
+    ++pool->open;
+  } else {
+    FIO_LIST_PUSH(&pool->queue, &r->node);
+    r = NULL;
+  }
+  FIO___LOCK_UNLOCK(FIO___HTTP_POOL.lock);
+  if (c) {
+    fio_io_defer(fio___http_pool_send_task, (void *)c, (void *)r);
+    return io;
+  }
+  if (r)
+    return fio___http_pool_connect(r);
+  return io;
+}
+
+/* tests if a connection can be reused once its response was handled. */
+FIO_SFUNC int fio___http_pool_is_reusable(fio___http_connection_s *c,
+                                          fio_http_s *h) {
+  fio_str_info_s v;
+  if (!c->state.http.pool || !fio_http_status(h) || c->len ||
+      !fio_http1_parser_is_empty(&c->state.http.parser) ||
+      !fio_io_is_open(c->io))
+    return 0;
+  v = fio_http_version(h);
+  if (v.len != 8 || fio_buf2u64u(v.buf) != fio_buf2u64u("HTTP/1.1"))
+    return 0;
+  v = fio_http_response_header(h, FIO_STR_INFO2((char *)"connection", 10), 0);
+  if (v.len == 5 && (fio_buf2u32u(v.buf) | 0x20202020UL) ==
+                        fio_buf2u32u("clos") &&
+      (v.buf[4] | 0x20) == 'e')
+    return 0;
+  return 1;
+}
+
+/* returns a connection to its pool, or uses it for the next queued request */
+FIO_SFUNC void fio___http_pool_release(fio___http_connection_s *c) {
+  fio___http_pool_s *pool = c->state.http.pool;
+  fio___http_pool_req_s *r = NULL;
+  int keep = 0;
+  FIO___LOCK_LOCK(FIO___HTTP_POOL.lock);
+  if (!FIO_LIST_IS_EMPTY(&pool->queue)) {
+    FIO_LIST_POP(fio___http_pool_req_s, node, r, &pool->queue);
+  } else if (pool->idle_count < pool->p->settings.pool_max_idle) {
+    FIO_LIST_NODE *first = pool->idle.next; /* most recently used first */
+    FIO_LIST_PUSH(first, &c->state.http.pool_node);
+    ++pool->idle_count;
+    keep = 1;
+  }
+  FIO___LOCK_UNLOCK(FIO___HTTP_POOL.lock);
+  if (r) {
+    fio_io_defer(fio___http_pool_send_task,
+                 (void *)fio___http_connection_dup(c),
+                 (void *)r);
+    return;
+  }
+  if (!keep) {
+    fio_io_close(c->io);
+    return;
+  }
+  c->suspend = 0; /* monitor idle connections (i.e., if closed by server) */
+  fio_io_unsuspend(c->io);
+}
+
+/* called when a pooled connection was closed (or failed to connect). */
+FIO_SFUNC void fio___http_pool_on_close(fio___http_connection_s *c) {
+  fio___http_pool_s *pool = c->state.http.pool;
+  fio___http_pool_req_s *r = NULL;
+  if (!pool)
+    return;
+  FIO___LOCK_LOCK(FIO___HTTP_POOL.lock);
+  if (!FIO_LIST_IS_EMPTY(&c->state.http.pool_node)) {
+    FIO_LIST_REMOVE_RESET(&c->state.http.pool_node);
+    --pool->idle_count;
+  }
+  if (FIO_LIST_IS_EMPTY(&pool->queue))
+    --pool->open;
+  else /* the connection's slot is passed on to the next queued request */
+    FIO_LIST_POP(fio___http_pool_req_s, node, r, &pool->queue);
+  FIO___LOCK_UNLOCK(FIO___HTTP_POOL.lock);
+  if (r)
+    fio___http_pool_connect(r);
+}
+
+/* *****************************************************************************
+HTTP Connect
+***************************************************************************** */
+
+static void fio___http_connect_on_failed(fio_io_protocol_s *p, void *udata) {
+  fio___http_connection_s *c = (fio___http_connection_s *)udata;
+  fio_http_free(c->h);
+  c->h = NULL;
+  fio___http_pool_on_close(c);
+  fio___http_connection_free(c);
+  (void)p;
+}
+
+void fio_http_connect___(void); /* IDE Marker */
+/** Connects to HTTP / WebSockets / SSE connections on `url`. */
+SFUNC fio_io_s *fio_http_connect FIO_NOOP(const char *url,
+                                          fio_http_s *h,
+                                          fio_http_settings_s s) {
+  FIO_STR_INFO_TMP_VAR(origin, 4096);
+  http_settings_validate(&s, 1);
+  fio_url_s u = (fio_url_s){0};
+  if (url)
+    u = fio_url_parse(url, strlen(url));
+  int pooled = (s.pool_max && u.host.len); /* upgraded connections aren't */
+
+  if (!h)
+    h = fio_http_new();
+  if (!fio_http_path(h).len)
+    fio_http_path_set(h,
+                      u.path.len ? FIO_BUF2STR_INFO(u.path)
+                                 : FIO_STR_INFO2((char *)"/", 1));
+  if (!fio_http_query(h).len && u.query.len)
+    fio_http_query_set(h, FIO_BUF2STR_INFO(u.query));
+  if (!fio_http_method(h).len)
+    fio_http_method_set(h, FIO_STR_INFO2((char *)"GET", 3));
+  if (u.host.len) {
+    fio_http_request_header_set_if_missing(h,
+                                           FIO_STR_INFO2((char *)"host", 4),
+                                           FIO_BUF2STR_INFO(u.host));
+    /* Origin header */
+    fio_string_write2(
+        &origin,
+        NULL,
+        FIO_STRING_WRITE_STR2("https", (size_t)(4 + fio_url_is_tls(u).tls)),
+        FIO_STRING_WRITE_STR2("://", 3U),
+        FIO_STRING_WRITE_STR_INFO(u.host),
+        FIO_STRING_WRITE_STR2(":", (size_t)(!!u.port.len)),
+        FIO_STRING_WRITE_STR_INFO(u.port));
+  }
+
+  /* test for ws:// or wss:// - WebSocket scheme */
+  if ((u.scheme.len == 2 ||
+       (u.scheme.len == 3 && ((u.scheme.buf[2] | 0x20) == 's'))) &&
+      (fio_buf2u16u(u.scheme.buf) | 0x2020) == fio_buf2u16u("ws")) {
+    fio_http_request_header_set_if_missing(h,
+                                           FIO_STR_INFO2((char *)"origin", 6),
+                                           origin);
+    fio_http_websocket_set_request(h);
+    pooled = 0;
+#if HAVE_ZLIB
+    if (s.ws_deflate)
+      fio_http_request_header_set_if_missing(
+          h,
+          FIO_STR_INFO2((char *)"sec-websocket-extensions", 24),
+          (s.ws_deflate_no_context_takeover
+               ? FIO_STR_INFO1((char *)"permessage-deflate; "
+                                       "client_max_window_bits; "
+                                       "client_no_context_takeover; "
+                                       "server_no_context_takeover")
+               : FIO_STR_INFO1(
+                     (char *)"permessage-deflate; client_max_window_bits")));
+#endif
+  }
+  /* test for sse:// or sses:// - Server Sent Events scheme */
+  else if ((u.scheme.len == 3 ||
+            (u.scheme.len == 4 && ((u.scheme.buf[3] | 0x20) == 's'))) &&
+           (fio_buf2u32u(u.scheme.buf) | fio_buf2u32u("\x20\x20\x20\xFF")) ==
+               fio_buf2u32u("sse\xFF")) {
+    fio_http_request_header_set_if_missing(h,
+                                           FIO_STR_INFO2((char *)"origin", 6),
+                                           origin);
+    fio_http_sse_set_request(h);
+    pooled = 0;
+  }
+
+  if (pooled) {
+    if (!fio_http_udata(h)) /* the pool's connections share `udata` */
+      fio_http_udata_set(h, s.udata);
+    return fio___http_pool_request(
+        fio___http_pool_req_new(fio___http_pool_get(url, u, &s), h, &s));
+  }
+
+  fio___http_protocol_s *p = fio___http_protocol_new(u.host.len);
+  fio___http_protocol_init(p, url, s, 1);
+  return fio___http_client_new(url,
+                               p,
+                               NULL,
+                               h,
+                               p->settings.on_http,
+                               p->settings.on_finish);
+}
+
+/* *****************************************************************************
+HTTP/1.1 Request / Response Completed
+***************************************************************************** */
+
+/** called when either a request or a response was received. */
+static void fio_http1_on_complete(void *udata) {
+  fio___http_connection_s *c = (fio___http_connection_s *)udata;
+  fio_io_dup(c->io); /* make sure the IO and its data are valid in callback */
+  fio_io_suspend(c->io);
+  fio_http_s *h = c->h;
+  c->h = NULL;
+  c->state.http.header_bytes = 0;
+  c->state.http.pre_body = 0;
+  c->suspend = 1;
+  // fio_io_defer(c->state.http.on_http_callback, h, NULL);
+  fio_queue_push(fio_io_queue(), c->state.http.on_http_callback, h);
+}
+
+/* *****************************************************************************
+HTTP/1.1 Parser callbacks
+***************************************************************************** */
+
+/* answers with an error and stops reading (i.e., 413 for a payload too big) */
+FIO_IFUNC void fio___http_request_refuse(fio___http_connection_s *c,
+                                         size_t status) {
+  fio_http_s *h = c->h;
+  fio_io_dup(c->io); /* sending the response will result in fio_undup */
+  fio_io_suspend(c->io);
+  c->h = NULL;
+  c->suspend = 1;
+  if (fio_http_send_error_response(h, status))
+    fio_io_free(c->io); /* response not sent, we need to fio_undup */
+  fio_http_free(h);
+}
+
+FIO_IFUNC void fio_http1_attach_handle(fio___http_connection_s *c) {
+  c->h = fio_http_new();
+  FIO_ASSERT_ALLOC(c->h);
+  fio_http_controller_set(
+      c->h,
+      &(FIO_PTR_FROM_FIELD(fio___http_protocol_s, settings, c->settings))
+           ->state[FIO___HTTP_PROTOCOL_HTTP1]
+           .controller);
+  fio_http_udata_set(c->h, c->udata);
+  fio_http_cdata_set(c->h, fio___http_connection_dup(c));
+}
+
+/** called when a request method is parsed. */
+static int fio_http1_on_method(fio_buf_info_s method, void *udata) {
+  fio___http_connection_s *c = (fio___http_connection_s *)udata;
+  if (c->h)
+    return -1;
+  fio_http1_attach_handle(c);
+  fio_http_method_set(c->h, FIO_BUF2STR_INFO(method));
+  return 0;
+}
+/** called when a response status is parsed. the status_str is the string
+ * without the prefixed numerical status indicator.*/
+static int fio_http1_on_status(size_t istatus,
+                               fio_buf_info_s status,
+                               void *udata) {
+  fio___http_connection_s *c = (fio___http_connection_s *)udata;
+  if (!c->h)
+    return -1; /* unexpected response (i.e., on an idle connection) */
+  fio_http_clear_response(c->h, istatus != 301 && istatus != 302);
+  fio_http_status_set(c->h, istatus);
+  return 0;
+  (void)status;
+}
+/** called when a request URL is parsed. */
+static int fio_http1_on_url(fio_buf_info_s url, void *udata) {
+  fio___http_connection_s *c = (fio___http_connection_s *)udata;
+  fio_url_s u = fio_url_parse(url.buf, url.len);
+  if (!u.path.len || u.path.buf[0] != '/')
+    return -1;
+  fio_http_path_set(c->h, FIO_BUF2STR_INFO(u.path));
+  if (u.query.len)
+    fio_http_query_set(c->h, FIO_BUF2STR_INFO(u.query));
+  if (u.host.len)
+    (!(c->h) ? fio_http_request_header_set
+             : fio_http_response_header_set)(c->h,
+                                             FIO_STR_INFO1((char *)"host"),
+                                             FIO_BUF2STR_INFO(u.host));
+  return 0;
+}
+/** called when a the HTTP/1.x version is parsed. */
+static int fio_http1_on_version(fio_buf_info_s version, void *udata) {
+  fio___http_connection_s *c = (fio___http_connection_s *)udata;
+  FIO_ASSERT_DEBUG(c->h, "on_version called without a pre-existing handle!");
+  if (!c->h)
+    return -1;
+  fio_http_version_set(c->h, FIO_BUF2STR_INFO(version));
+  return 0;
+}
+/** called when a header is parsed. */
+static int fio_http1_on_header(fio_buf_info_s name,
+                               fio_buf_info_s value,
+                               void *udata) {
+  fio___http_connection_s *c = (fio___http_connection_s *)udata;
+  if (!c->h)
+    return 0; /* ignore possible post-error response headers */
+  const size_t line_len = value.len + name.len;
+  c->state.http.header_bytes += line_len;
+  if ((unsigned)(c->state.http.header_bytes > c->state.http.max_header) |
+      (line_len > c->state.http.max_line))
+    goto headers_too_big;
+  (!fio_http_status(c->h)
+       ? fio_http_request_header_add
+       : fio_http_response_header_add)(c->h,
+                                       FIO_BUF2STR_INFO(name),
+                                       FIO_BUF2STR_INFO(value));
+  return 0;
+headers_too_big:
+  fio_http_send_error_response(c->h, 431);
+  return -1;
+}
+/** called when the special content-length header is parsed. */
+static int fio_http1_on_header_content_length(fio_buf_info_s name,
+                                              fio_buf_info_s value,
+                                              size_t content_length,
+                                              void *udata) {
+  fio___http_connection_s *c = (fio___http_connection_s *)udata;
+  fio_http_s *h = c->h;
+  if (!h)
+    return 0;
+  if (content_length > c->settings->max_body_size)
+    goto too_big;
+  if (content_length)
+    fio_http_body_expect(c->h, content_length);
+#if FIO_HTTP_SHOW_CONTENT_LENGTH_HEADER
+  (!(h->status) ? fio_http_request_header_add
+                : fio_http_response_header_add)(h,
+                                                FIO_BUF2STR_INFO(name),
+                                                FIO_BUF2STR_INFO(value));
+#endif
+  return 0;
+too_big:
+  fio___http_request_refuse(c, 413);
+  return 0; /* should we disconnect (return -1), or not? */
+  (void)name, (void)value;
+}
+
+/* calls `pre_http_body`, returns -1 if it responded (the body isn't wanted). */
+FIO_SFUNC int fio___http1_pre_body(fio___http_connection_s *c) {
+  c->state.http.pre_body = 1;
+  fio_io_dup(c->io); /* sending a response will result in fio_undup */
+  c->settings->pre_http_body(c->h);
+  if (!fio_http_status(c->h)) {
+    fio_io_free(c->io);
+    return 0;
+  }
+  fio_io_suspend(c->io);
+  c->suspend = 1;
+  fio_http_free(c->h);
+  c->h = NULL;
+  return -1;
+}
+
+/** called when `Expect` arrives and may require a 100 continue response. */
+static int fio_http1_on_expect(void *udata) {
+  fio___http_connection_s *c = (fio___http_connection_s *)udata;
+  const fio_buf_info_s response =
+      FIO_BUF_INFO1((char *)"HTTP/1.1 100 Continue\r\n\r\n");
+  fio_http_s *h = c->h;
+  if (!h)
+    return 1;
+  c->h = NULL;
+  /* TODO: test for body size violation and deny request if payload too big. */
+  if (FIO_HTTP1_EXPECTED_CHUNKED != fio_http1_expected(&c->state.http.parser) &&
+      c->settings->max_body_size > fio_http1_expected(&c->state.http.parser))
+    goto payload_too_big;
+  c->h = h;
+  if (fio___http1_pre_body(c))
+    return 1; /* a response was sent */
+  fio_io_write2(c->io, .buf = response.buf, .len = response.len, .copy = 0);
+  return 0; /* TODO?: improve support for `expect` headers? */
+payload_too_big:
+  fio_io_dup(c->io);
+  if (fio_http_send_error_response(h, 413))
+    fio_io_free(c->io); /* response not sent, we need to fio_undup */
+  fio_http_free(h);
+  return 1;
+}
+
+/** called when a body chunk is parsed. */
+static int fio_http1_on_body_chunk(fio_buf_info_s chunk, void *udata) {
+  fio___http_connection_s *c = (fio___http_connection_s *)udata;
+  if (!c->h)
+    return -1; /* close connection if a large payload is unstoppable */
+  if (c->is_client &&
+      (fio_http_status(c->h) == 301 || fio_http_status(c->h) == 302))
+    return 0; /* don't overwrite client payload on redirect */
+  if (chunk.len + fio_http_body_length(c->h) > c->settings->max_body_size)
+    goto too_big;
+  if (!c->state.http.pre_body && !c->is_client && fio___http1_pre_body(c))
+    return -1; /* a response was sent, the body isn't wanted */
+  if (fio_http_body_write(c->h, chunk.buf, chunk.len))
+    goto bad_body; /* i.e., a malformed multipart body */
+  return 0;
+too_big: /* stop parsing, so the request is never completed */
+  fio___http_request_refuse(c, 413);
+  return -1;
+bad_body:
+  fio___http_request_refuse(c, 400);
+  return -1;
+}
+
+/* *****************************************************************************
+HTTP/1.1 Accepting new connections (tests for special HTTP/2 pre-knowledge)
+***************************************************************************** */
+
+/** Called when an IO is attached to a protocol. */
+FIO_SFUNC void fio___http_on_attach_accept(fio_io_s *io) {
+
+  fio___http_protocol_s *p =
+      FIO_PTR_FROM_FIELD(fio___http_protocol_s,
+                         state[FIO___HTTP_PROTOCOL_ACCEPT].protocol,
+                         fio_io_protocol(io));
+  fio___http_protocol_dup(p);
+  // p->queue = fio_io_queue();
+
+  const uint32_t capa = p->settings.max_line_len;
+  fio___http_connection_s *c = fio___http_connection_new(capa);
+  FIO_ASSERT_ALLOC(c);
+  *c = (fio___http_connection_s){
+      .io = io,
+      .settings = &(p->settings),
+      .queue =
+          ((p->settings.queue && p->settings.queue->q) ? p->settings.queue->q
+                                                       : fio_io_queue()),
+      .udata = p->settings.udata,
+      .state.http =
+          {
+              .on_http_callback = p->on_http_callback,
+              .on_http = p->settings.on_http,
+              .on_finish = p->settings.on_finish,
+              .max_header = p->settings.max_header_size,
+              .max_line = p->settings.max_line_len,
+          },
+      .capa = capa,
+      .log = p->settings.log,
+  };
+  fio_io_udata_set(io, (void *)c);
+  FIO_LOG_DDEBUG2("(%d) HTTP accepted a new connection (%p)",
+                  (int)fio_thread_getpid(),
+                  c->io);
+#if 0 /* skip pre-knowledge test? */
+  fio_io_protocol_set(
+      io,
+      &(FIO_PTR_FROM_FIELD(fio___http_protocol_s, settings, c->settings)
+            ->state[FIO___HTTP_PROTOCOL_HTTP1]
+            .protocol));
+#endif
+}
+
+/** Called when a data is available. */
+FIO_SFUNC void fio___http1_accept_on_data(fio_io_s *io) {
+  const fio_buf_info_s prior_knowledge = FIO_BUF_INFO2(
+      (char *)"\x50\x52\x49\x20\x2a\x20\x48\x54\x54\x50\x2f\x32\x2e\x30"
+              "\x0d\x0a\x0d\x0a\x53\x4d\x0d\x0a\x0d\x0a",
+      24);
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_io_udata(io);
+  fio_io_protocol_s *phttp_new;
+  size_t r = fio_io_read(io, c->buf + c->len, c->capa - c->len);
+  if (!r) /* nothing happened */
+    return;
+  c->len += (uint32_t)r;
+  if (prior_knowledge.buf[0] != c->buf[0] ||
+      FIO_MEMCMP(
+          prior_knowledge.buf,
+          c->buf,
+          (c->len > prior_knowledge.len ? prior_knowledge.len : c->len))) {
+    /* no prior knowledge, switch to HTTP/1.1 */
+    phttp_new =
+        &(FIO_PTR_FROM_FIELD(fio___http_protocol_s, settings, c->settings)
+              ->state[FIO___HTTP_PROTOCOL_HTTP1]
+              .protocol);
+    fio_io_protocol_set(io, phttp_new);
+    return;
+  }
+  if (c->len < prior_knowledge.len) /* wait for more data */
+    return;
+
+  if (c->len > prior_knowledge.len)
+    FIO_MEMMOVE(c->buf,
+                c->buf + prior_knowledge.len,
+                c->len - prior_knowledge.len);
+  c->len -= prior_knowledge.len;
+  phttp_new = &(FIO_PTR_FROM_FIELD(fio___http_protocol_s, settings, c->settings)
+                    ->state[FIO___HTTP_PROTOCOL_HTTP2]
+                    .protocol);
+
+  fio_io_protocol_set(io, phttp_new);
+}
+
+FIO_SFUNC void fio___http_on_close(void *buf, void *udata) {
+  FIO_LOG_DDEBUG2("(%d) HTTP connection closed for %p",
+                  (int)fio_thread_getpid(),
+                  udata);
+  fio___http_connection_s *c = (fio___http_connection_s *)udata;
+  c->io = NULL;
+  fio_http_free(c->h);
+  if (c->is_client)
+    fio___http_pool_on_close(c);
+  fio___http_connection_free(c);
+  (void)buf;
+}
+
+/* *****************************************************************************
+HTTP/1.1 Protocol
+***************************************************************************** */
+
+FIO_SFUNC int fio___http1_process_data(fio_io_s *io,
+                                       fio___http_connection_s *c) {
+  (void)io;
+  for (;;) {
+    size_t consumed = fio_http1_parse(&c->state.http.parser,
+                                      FIO_BUF_INFO2(c->buf, c->len),
+                                      (void *)c);
+    if (!consumed)
+      goto nothing_consumed;
+    if (consumed == FIO_HTTP1_PARSER_ERROR)
+      goto http1_error;
+    c->len -= consumed;
+    if (c->len)
+      FIO_MEMMOVE(c->buf, c->buf + consumed, c->len);
+    if (c->suspend)
+      return -1;
+  }
+  return 0;
+
+nothing_consumed:
+  if (c->len == c->capa)
+    goto http1_abuse;
+  else
+    return -1;
+
+http1_error:
+  FIO_LOG_DDEBUG2("(%d) HTTP/1.1 parser error! disconnecting client at %d",
+                  fio_io_pid(),
+                  fio_io_fd(io));
+  if (c->h) {
+    fio_http_s *h = c->h;
+    c->h = NULL;
+    if (!c->is_client) {
+      fio_io_dup(c->io);
+      if (fio_http_send_error_response(h, 400))
+        fio_io_free(c->io);
+    }
+    fio_http_free(h);
+  }
+  fio_io_close(io);
+  return -1;
+
+http1_abuse:
+  FIO_LOG_DDEBUG2(
+      "(%d) HTTP/1.1 hit security limit, disconnecting client at %d",
+      fio_io_pid(),
+      fio_io_fd(io));
+  if (c->h) {
+    fio_http_s *h = c->h;
+    c->h = NULL;
+    if (!c->is_client) {
+      fio_io_dup(c->io);
+      if (fio_http_send_error_response(h, 431))
+        fio_io_free(c->io);
+    }
+    fio_http_free(h);
+  }
+  fio_io_close(io);
+  return -1;
+}
+
+// /** Called when a data is available. */
+FIO_SFUNC void fio___http1_on_data(fio_io_s *io) {
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_io_udata(io);
+  size_t r;
+  for (;;) {
+    if (c->capa == c->len)
+      return;
+    if (!(r = fio_io_read(io, c->buf + c->len, c->capa - c->len)))
+      return;
+    c->len += r;
+    if (fio___http1_process_data(io, c))
+      return;
+  }
+}
+
+// /** Called when an IO is attached to a protocol. */
+FIO_SFUNC void fio___http1_on_attach(fio_io_s *io) {
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_io_udata(io);
+  if (c->len)
+    fio___http1_process_data(io, c);
+  return;
+}
+
+/* *****************************************************************************
+HTTP/1.1 Client Protocol
+***************************************************************************** */
+
+/** Iterates through all cookies. A non-zero return will stop iteration. */
+FIO_SFUNC int fio_http1___write_client_cookie_callback(fio_http_s *h,
+                                                       fio_str_info_s name,
+                                                       fio_str_info_s value,
+                                                       void *udata) {
+  fio_str_info_s *buf = (fio_str_info_s *)udata;
+  fio_string_write2(buf,
+                    FIO_STRING_REALLOC,
+                    FIO_STRING_WRITE_STR2("cookie:", 7),
+                    FIO_STRING_WRITE_STR_INFO(name),
+                    FIO_STRING_WRITE_STR2("=", 1),
+                    FIO_STRING_WRITE_STR_INFO(value),
+                    FIO_STRING_WRITE_STR2("\r\n", 2));
+  return 0;
+  (void)h;
+}
+
+/** called by the HTTP handle for each header. */
+FIO_SFUNC int fio_http1___write_header_callback(fio_http_s *h,
+                                                fio_str_info_s name,
+                                                fio_str_info_s value,
+                                                void *out_) {
+  (void)h;
+  /* manually copy, as this is an "all or nothing" copy (no truncation) */
+  fio_str_info_s *out = (fio_str_info_s *)out_;
+  return fio_string_write2(out,
+                           FIO_STRING_REALLOC,
+                           FIO_STRING_WRITE_STR2(name.buf, name.len),
+                           FIO_STRING_WRITE_STR2(":", 1),
+                           FIO_STRING_WRITE_STR2(value.buf, value.len),
+                           FIO_STRING_WRITE_STR2("\r\n", 2));
+}
+
+FIO_SFUNC void fio___http1_send_request(fio_http_s *h) {
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  if (!c->io || !fio_io_is_open(c->io))
+    return;
+  fio_str_info_s buf = FIO_STR_INFO2(NULL, 0);
+  /* set Content-Length (client is never streaming) */
+  if (fio_http_body_length(h)) {
+    char ibuf[32];
+    fio_str_info_s k = FIO_STR_INFO2((char *)"content-length", 14);
+    fio_str_info_s v = FIO_STR_INFO3(ibuf, 0, 32);
+    v.len = fio_digits10u(fio_http_body_length(h));
+    fio_ltoa10u(v.buf, fio_http_body_length(h), v.len);
+    fio_http_request_header_set(h, k, v);
+  }
+  { /* set sensible defaults for common headers (Accept, User-Agent) */
+    fio_http_request_header_set_if_missing(h,
+                                           FIO_STR_INFO1((char *)"accept"),
+                                           FIO_STR_INFO1((char *)"*/*"));
+    fio_http_request_header_set_if_missing(
+        h,
+        FIO_STR_INFO1((char *)"user-agent"),
+        FIO_STR_INFO1((char *)"facil.io/" FIO_VERSION_STRING));
+  }
+  { /* write status string */
+    fio_str_info_s method = fio_http_method(h);
+    fio_str_info_s path = fio_http_path(h);
+    fio_str_info_s version = fio_http_version(h);
+    if (!path.len)
+      path = FIO_STR_INFO1((char *)"/");
+    if ((version.len - 1) > 15)
+      version = FIO_STR_INFO1((char *)"HTTP/1.1");
+    fio_string_write2(&buf,
+                      FIO_STRING_REALLOC,
+                      FIO_STRING_WRITE_STR_INFO(method),
+                      FIO_STRING_WRITE_STR2(" ", 1),
+                      FIO_STRING_WRITE_STR_INFO(path),
+                      FIO_STRING_WRITE_STR2(" ", 1),
+                      FIO_STRING_WRITE_STR_INFO(version),
+                      FIO_STRING_WRITE_STR2("\r\n", 2));
+  }
+  /* write headers */
+  fio_http_request_header_each(h, fio_http1___write_header_callback, &buf);
+  /* write cookies */
+  fio_http_cookie_each(h, fio_http1___write_client_cookie_callback, &buf);
+  fio_string_write(&buf, FIO_STRING_REALLOC, "\r\n", 2);
+  /* send data (moves memory ownership) */
+  fio_io_write2(c->io,
+                .buf = buf.buf,
+                .len = buf.len,
+                .dealloc = FIO_STRING_FREE,
+                .copy = 0);
+  /* make sure we listen to incoming data */
+  c->suspend = 0;
+  fio_io_unsuspend(c->io);
+  /* Write Body */
+  if (!fio_http_body_length(h))
+    return;
+  fio_http_body_seek(h, 0);
+  if (fio_http_body_fd(h) == -1) {
+    buf = fio_http_body_read(h, (size_t)-1);
+    fio_io_write2(c->io,
+                  .buf = (char *)fio_http_dup(h),
+                  .len = buf.len,
+                  .offset = (size_t)((char *)h - buf.buf),
+                  .dealloc = (void (*)(void *))fio_http_free);
+  } else {
+    fio_io_write2(c->io,
+                  .fd = fio_http_body_fd(h),
+                  .len = fio_http_body_length(h),
+                  .copy = 1);
+  }
+}
+
+FIO_SFUNC void fio___http1_on_attach_client(fio_io_s *io) {
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_io_udata(io);
+  // c->io = fio_io_dup(io);
+  c->io = io;
+  fio___http1_send_request(c->h);
+  if (c->len)
+    fio___http1_process_data(io, c);
+  return;
+}
+
+/* *****************************************************************************
+HTTP/1 Controller
+***************************************************************************** */
+FIO_SFUNC int fio___http_controller_get_fd(fio_http_s *h) {
+  return fio_io_fd(fio_http_io(h));
+}
+
+/** writes all headers except `content-length` (replaced by the caller). */
+FIO_SFUNC int fio_http1___write_header_zip_callback(fio_http_s *h,
+                                                    fio_str_info_s name,
+                                                    fio_str_info_s value,
+                                                    void *out_) {
+  if (name.len == 14 && !FIO_MEMCMP(name.buf, "content-length", 14))
+    return 0;
+  return fio_http1___write_header_callback(h, name, value, out_);
+}
+
+/**
+ * Serializes the response headers to `c->state.http.buf`.
+ *
+ * If `zip` is set, the `content-encoding` and `content-length` (`zip_len`)
+ * headers of the compressed body are written instead of `content-length`.
+ */
+FIO_SFUNC void fio___http1_write_headers(fio___http_connection_s *c,
+                                         fio_http_s *h,
+                                         uint8_t zip,
+                                         size_t zip_len) {
+  if (c->state.http.cache && fio___http_cache_on_headers(c, h))
+    return;
+  fio_str_info_s buf = FIO_STR_INFO2(NULL, 0);
+  { /* write status string */
+    fio_str_info_s ver = fio_http_version(h);
+    fio_str_info_s status = fio_http_status2str(fio_http_status(h));
+    if (ver.len > 15) {
+      FIO_LOG_ERROR("HTTP/1.1 client version string too long!");
+      ver = FIO_STR_INFO1((char *)"HTTP/1.1");
+    }
+    fio_string_write2(&buf,
+                      FIO_STRING_REALLOC,
+                      FIO_STRING_WRITE_STR2(ver.buf, ver.len),
+                      FIO_STRING_WRITE_STR2(" ", 1),
+                      FIO_STRING_WRITE_NUM(fio_http_status(h)),
+                      FIO_STRING_WRITE_STR2(" ", 1),
+                      FIO_STRING_WRITE_STR2(status.buf, status.len),
+                      FIO_STRING_WRITE_STR2("\r\n", 2));
+  }
+
+  /* write headers */
+  if (zip)
+    fio_string_write2(&buf,
+                      FIO_STRING_REALLOC,
+                      FIO_STRING_WRITE_STR2("content-encoding:", 17),
+                      FIO_STRING_WRITE_STR1(
+                          (zip == FIO___HTTP_ZIP_GZIP ? "gzip" : "br")),
+                      FIO_STRING_WRITE_STR2("\r\ncontent-length:", 17),
+                      FIO_STRING_WRITE_UNUM(zip_len),
+                      FIO_STRING_WRITE_STR2("\r\n", 2));
+  fio_http_response_header_each(h,
+                                (zip ? fio_http1___write_header_zip_callback
+                                     : fio_http1___write_header_callback),
+                                &buf);
+  /* write cookies */
+  fio_http_set_cookie_each(h, fio_http1___write_header_callback, &buf);
+  /* add streaming headers? */
+  if (fio_http_is_streaming(h))
+    fio_string_write(&buf,
+                     FIO_STRING_REALLOC,
+                     "transfer-encoding: chunked\r\n",
+                     28);
+  fio_string_write(&buf, FIO_STRING_REALLOC, "\r\n", 2);
+  /* send data (move memory ownership)? */
+  c->state.http.buf = buf;
+  return;
+  // fio_io_write2(c->io,
+  //               .buf = buf.buf,
+  //               .len = buf.len,
+  //               .dealloc = FIO_STRING_FREE,
+  //               .copy = 0);
+}
+
+/** Informs the controller that request / response headers must be sent. */
+FIO_SFUNC void fio___http_controller_http1_send_headers(fio_http_s *h) {
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  if (c->state.http.cache && c->state.http.cache_hit)
+    return;
+  if (!c->io || !fio_io_is_open(c->io))
+    return;
+  if (c->settings->compress && fio___http_zip_start(c, h))
+    return; /* sent with the compressed body (see `write_body`) */
+  fio___http1_write_headers(c, h, 0, 0);
+}
+
+/** Compresses a complete response body, sending the postponed headers. */
+FIO_SFUNC void fio___http_zip_body(fio___http_connection_s *c,
+                                   fio_http_s *h,
+                                   fio_http_write_args_s *args) {
+  uint8_t type = c->state.http.zip_type;
+  char *out = NULL;
+  void *zip;
+  fio_str_info_s len =
+      fio_http_response_header(h,
+                               FIO_STR_INFO2((char *)"content-length", 14),
+                               0);
+  c->state.http.zip_type = 0;
+  /* compress only if the whole body is written at once (not a file) */
+  if (args->buf && args->len && fio_atol10u(&len.buf) == args->len &&
+      (zip = fio___http_zip_new(type, c->settings->compress, args->len))) {
+    out = fio___http_zip(type,
+                         zip,
+                         (char *)args->buf + args->offset,
+                         args->len,
+                         1);
+    fio___http_zip_free(type, zip);
+    if (fio_bstr_len(out) >= args->len) { /* no gain */
+      fio_bstr_free(out);
+      out = NULL;
+    }
+  }
+  if (out)
+    fio___http_zip_etag(h);
+  fio___http1_write_headers(c, h, (out ? type : 0), fio_bstr_len(out));
+  if (!out)
+    return;
+  if (args->dealloc)
+    args->dealloc((void *)args->buf);
+  *args = (fio_http_write_args_s){
+      .buf = out,
+      .len = fio_bstr_len(out),
+      .dealloc = (void (*)(void *))fio_bstr_free,
+      .finish = args->finish,
+  };
+}
+/** called by the HTTP handle for each body chunk (or to finish a response. */
+FIO_SFUNC void fio___http_controller_http1_write_body(
+    fio_http_s *h,
+    fio_http_write_args_s args) {
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  if (!c->io || !fio_io_is_open(c->io))
+    goto no_write_err;
+  if (fio_http_is_streaming(h))
+    goto stream_chunk;
+  if (c->state.http.zip_type)
+    fio___http_zip_body(c, h, &args);
+  if (c->state.http.cache && fio___http_cache_on_body(c, &args))
+    return;
+  if (c->state.http.buf.len) {
+    if (args.buf && args.len) {
+      fio_string_write(&c->state.http.buf,
+                       FIO_STRING_REALLOC,
+                       (char *)args.buf + args.offset,
+                       args.len);
+      if (args.dealloc)
+        args.dealloc((void *)args.buf);
+    }
+    fio_io_write2(c->io,
+                  .buf = (void *)c->state.http.buf.buf,
+                  .len = c->state.http.buf.len,
+                  .dealloc = FIO_STRING_FREE);
+    c->state.http.buf = FIO_STR_INFO0;
+    if (args.buf && args.len)
+      return;
+  }
+
+  fio_io_write2(c->io,
+                .buf = (void *)args.buf,
+                .fd = args.fd,
+                .len = args.len,
+                .offset = args.offset,
+                .dealloc = args.dealloc,
+                .copy = (uint8_t)args.copy);
+  return;
+
+stream_chunk:
+  if (c->state.http.zip && fio___http_zip_chunk(c, &args))
+    return;
+  if (args.len && args.buf) { /* String */
+    if (args.copy || args.len < (1 << 16)) {
+      fio_string_write2(
+          &c->state.http.buf,
+          FIO_STRING_REALLOC,
+          FIO_STRING_WRITE_HEX(args.len),   /* chunk header - length */
+          FIO_STRING_WRITE_STR2("\r\n", 2), /* chunk header - EOL */
+          FIO_STRING_WRITE_STR2((char *)args.buf, args.buf ? args.len : 0),
+          FIO_STRING_WRITE_STR2("\r\n", 2)); /* chunk trailer - EOL */
+      fio_io_write2(c->io,
+                    .buf = (void *)c->state.http.buf.buf,
+                    .len = c->state.http.buf.len,
+                    .dealloc = FIO_STRING_FREE);
+      c->state.http.buf = FIO_STR_INFO0;
+      if (args.dealloc)
+        args.dealloc((void *)args.buf);
+      return;
+    } else { /* avoid copying the incoming data if possible */
+      FIO_STR_INFO_TMP_VAR(buf, 32);
+      if (c->state.http.buf.buf)
+        buf = c->state.http.buf;
+      c->state.http.buf = FIO_STR_INFO0;
+      fio_string_write2(
+          &buf,
+          NULL,
+          FIO_STRING_WRITE_HEX(args.len),    /* chunk header - length */
+          FIO_STRING_WRITE_STR2("\r\n", 2)); /* chunk header - EOL */
+      fio_io_write2(c->io,
+                    .buf = buf.buf,
+                    .len = buf.len,
+                    .copy = !FIO_STR_INFO_TMP_IS_REALLOCATED(buf),
+                    .dealloc = FIO_STR_INFO_TMP_IS_REALLOCATED(buf)
+                                   ? FIO_STRING_FREE
+                                   : NULL);
+      fio_io_write2(c->io,
+                    .buf = (void *)args.buf,
+                    .len = args.len,
+                    .dealloc = args.dealloc);
+      /* chunk trailer - EOL */
+      fio_io_write2(c->io, .buf = (void *)"\r\n", .len = 2);
+      return;
+    }
+  } else if ((uint32_t)(args.fd + 1) > 1U) { /* File? */
+    if (!args.len) {
+      if (fio_fd_type(args.fd) != S_IFREG)
+        goto no_length_err;
+      /* collect remaining file length */
+      off_t len = fio_fd_size(args.fd);
+      off_t offset = lseek(args.fd, 0, SEEK_CUR);
+      if (len > 0 && offset > 0)
+        len -= offset;
+      if (len <= 0)
+        goto no_length_err;
+      args.len = (size_t)len;
+    }
+    FIO_STR_INFO_TMP_VAR(buf, 32);
+    if (c->state.http.buf.buf)
+      buf = c->state.http.buf;
+    c->state.http.buf = FIO_STR_INFO0;
+    fio_string_write2(
+        &buf,
+        NULL,
+        FIO_STRING_WRITE_HEX(args.len),    /* chunk header - length */
+        FIO_STRING_WRITE_STR2("\r\n", 2)); /* chunk header - EOL */
+    fio_io_write2(
+        c->io,
+        .buf = buf.buf,
+        .len = buf.len,
+        .copy = !FIO_STR_INFO_TMP_IS_REALLOCATED(buf),
+        .dealloc =
+            (FIO_STR_INFO_TMP_IS_REALLOCATED(buf) ? FIO_STRING_FREE : NULL));
+    fio_io_write2(c->io,
+                  .fd = args.fd,
+                  .len = args.len,
+                  .copy = (bool)args.copy,
+                  .dealloc = args.dealloc);
+    /* chunk trailer - EOL */
+    fio_io_write2(c->io, .buf = (void *)"\r\n", .len = 2);
+  } else
+    goto no_write_err;
+  return;
+no_length_err:
+  FIO_LOG_ERROR("HTTP1 streaming requires a correctly pre-determined "
+                "length per chunk.");
+no_write_err:
+  if (args.buf) {
+    if (args.dealloc)
+      args.dealloc((void *)args.buf);
+  } else if ((uint32_t)(args.fd + 1) > 1U) {
+    close(args.fd);
+  }
+}
+
+FIO_SFUNC void fio___http_controller_http1_on_finish_task(void *c_,
+                                                          void *upgraded) {
+  fio___http_connection_s *c = (fio___http_connection_s *)c_;
+  c->suspend = 0;
+
+  if (upgraded)
+    goto upgraded;
+
+  if (!c->io)
+    goto no_io;
+
+  if (fio_io_is_open(c->io)) {
+    /* TODO: test for connection:close header and h->status values */
+    fio___http1_process_data(c->io, c);
+  }
+  if (!c->suspend)
+    fio_io_unsuspend(c->io);
+  fio_io_free(c->io);
+  return;
+
+upgraded:
+  if (c->h || !fio_io_is_open(c->io))
+    goto something_is_wrong;
+  c->h = (fio_http_s *)upgraded;
+  { /* TODO! test if safe to move to user thread for callback execution? */
+    const size_t pr_i = fio_http_is_websocket(c->h) ? FIO___HTTP_PROTOCOL_WS
+                                                    : FIO___HTTP_PROTOCOL_SSE;
+    fio_http_controller_set(
+        c->h,
+        &(FIO_PTR_FROM_FIELD(fio___http_protocol_s, settings, c->settings)
+              ->state[pr_i]
+              .controller));
+    fio_io_protocol_set(
+        c->io,
+        &(FIO_PTR_FROM_FIELD(fio___http_protocol_s, settings, c->settings)
+              ->state[pr_i]
+              .protocol));
+    if (pr_i == FIO___HTTP_PROTOCOL_SSE) {
+      fio_str_info_s last_id =
+          fio_http_request_header(c->h,
+                                  FIO_STR_INFO2((char *)"last-event-id", 13),
+                                  0);
+      if (last_id.buf)
+        c->settings->on_eventsource_reconnect(c->h, FIO_STR2BUF_INFO(last_id));
+    }
+  }
+  fio_io_unsuspend(c->io);
+  fio_io_free(c->io);
+  return;
+
+something_is_wrong:
+  if (fio_io_is_open(c->io))
+    FIO_LOG_DEBUG2("(%d) Connection upgrade went wrong for fd %d - closing",
+                   fio_io_pid(),
+                   fio_io_fd(c->io));
+  fio_io_protocol_set(c->io, NULL); /* make zombie, timeout will clear it. */
+  fio_io_free(c->io);
+/* fall through */
+no_io:
+  fio___http_connection_free(c); /* free HTTP connection element */
+}
+
+/** called once a request / response had finished */
+FIO_SFUNC void fio___http_controller_http1_on_finish(fio_http_s *h) {
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  if (c->state.http.zip_type)
+    fio___http_zip_finish(c);
+  if (c->state.http.cache)
+    fio___http_cache_on_finish(c);
+  if (c->state.http.buf.len) {
+    if (fio_http_is_streaming(h))
+      fio_string_write(&c->state.http.buf, FIO_STRING_REALLOC, "0\r\n\r\n", 5);
+    fio_io_write2(c->io,
+                  .buf = (void *)c->state.http.buf.buf,
+                  .len = c->state.http.buf.len,
+                  .dealloc = FIO_STRING_FREE);
+    c->state.http.buf = FIO_STR_INFO0;
+  } else {
+    if (fio_http_is_streaming(h))
+      fio_io_write2(c->io, .buf = (char *)"0\r\n\r\n", .len = 5, .copy = 1);
+  }
+  if (c->log)
+    fio_http_write_log(h);
+  if (fio_http_is_upgraded(h))
+    goto upgraded;
+  /* once the function returns, `h` may be freed (auto-finish on free).
+   * so we must call this callback here (sync), no matter the thread */
+  c->state.http.on_finish(h);
+  fio_io_defer(fio___http_controller_http1_on_finish_task, (void *)(c), NULL);
+  return;
+
+upgraded:
+  fio_io_defer(fio___http_controller_http1_on_finish_task,
+               (void *)(c),
+               (void *)h);
+}
+
+/* *****************************************************************************
+HTTP/2 - Constants (RFC 9113)
+***************************************************************************** */
+
+#define FIO___HTTP2_FRAME_DATA            0x0
+#define FIO___HTTP2_FRAME_HEADERS         0x1
+#define FIO___HTTP2_FRAME_PRIORITY        0x2
+#define FIO___HTTP2_FRAME_RST_STREAM      0x3
+#define FIO___HTTP2_FRAME_SETTINGS        0x4
+#define FIO___HTTP2_FRAME_PUSH_PROMISE    0x5
+#define FIO___HTTP2_FRAME_PING            0x6
+#define FIO___HTTP2_FRAME_GOAWAY          0x7
+#define FIO___HTTP2_FRAME_WINDOW_UPDATE   0x8
+#define FIO___HTTP2_FRAME_CONTINUATION    0x9
+#define FIO___HTTP2_FRAME_PRIORITY_UPDATE 0x10 /* RFC 9218 */
+
+#define FIO___HTTP2_FLAG_END_STREAM  0x1
+#define FIO___HTTP2_FLAG_ACK         0x1
+#define FIO___HTTP2_FLAG_END_HEADERS 0x4
+#define FIO___HTTP2_FLAG_PADDED      0x8
+#define FIO___HTTP2_FLAG_PRIORITY    0x20
+
+#define FIO___HTTP2_NO_ERROR            0x0
+#define FIO___HTTP2_PROTOCOL_ERROR      0x1
+#define FIO___HTTP2_INTERNAL_ERROR      0x2
+#define FIO___HTTP2_FLOW_CONTROL_ERROR  0x3
+#define FIO___HTTP2_STREAM_CLOSED       0x5
+#define FIO___HTTP2_FRAME_SIZE_ERROR    0x6
+#define FIO___HTTP2_REFUSED_STREAM      0x7
+#define FIO___HTTP2_CANCEL              0x8
+#define FIO___HTTP2_COMPRESSION_ERROR   0x9
+#define FIO___HTTP2_ENHANCE_YOUR_CALM   0xb
+#define FIO___HTTP2_HTTP_1_1_REQUIRED   0xd
+
+/* stream state flags */
+#define FIO___HTTP2_S_REMOTE_CLOSED 1  /* END_STREAM received */
+#define FIO___HTTP2_S_LOCAL_CLOSED  2  /* END_STREAM sent */
+#define FIO___HTTP2_S_HEADERS_SENT  4  /* response HEADERS were sent */
+#define FIO___HTTP2_S_FINISHED      8  /* response body is complete */
+#define FIO___HTTP2_S_ACTIVE        16 /* listed as having pending output */
+#define FIO___HTTP2_S_DISCARD       32 /* request body is ignored */
+#define FIO___HTTP2_S_PRE_BODY      64 /* `pre_http_body` was called */
+
+/* our SETTINGS_MAX_FRAME_SIZE (the protocol's default) */
+#define FIO___HTTP2_FRAME_MAX 16384
+/* default (and maximum) HPACK dynamic table size */
+#define FIO___HTTP2_HPACK_MAX 4096
+/* DATA bytes written per flush cycle, allowing other connections to run */
+#define FIO___HTTP2_FLUSH_LIMIT 262144
+/* stop writing DATA frames while the IO's outgoing buffer is this large */
+#define FIO___HTTP2_BACKLOG_LIMIT 1048576
+
+/* *****************************************************************************
+HTTP/2 - HPACK Huffman Code (RFC 7541, Appendix B)
+
+The code is canonical, so decoding uses the first code / count / symbol offset
+of each code length (5-30 bits) rather than a decoding tree.
+***************************************************************************** */
+
+static const uint32_t fio___hpack_huff_code[257] = {
+    0x1FF8, 0x7FFFD8, 0xFFFFFE2, 0xFFFFFE3, 0xFFFFFE4, 0xFFFFFE5,
+    0xFFFFFE6, 0xFFFFFE7, 0xFFFFFE8, 0xFFFFEA, 0x3FFFFFFC, 0xFFFFFE9,
+    0xFFFFFEA, 0x3FFFFFFD, 0xFFFFFEB, 0xFFFFFEC, 0xFFFFFED, 0xFFFFFEE,
+    0xFFFFFEF, 0xFFFFFF0, 0xFFFFFF1, 0xFFFFFF2, 0x3FFFFFFE, 0xFFFFFF3,
+    0xFFFFFF4, 0xFFFFFF5, 0xFFFFFF6, 0xFFFFFF7, 0xFFFFFF8, 0xFFFFFF9,
+    0xFFFFFFA, 0xFFFFFFB, 0x14, 0x3F8, 0x3F9, 0xFFA,
+    0x1FF9, 0x15, 0xF8, 0x7FA, 0x3FA, 0x3FB,
+    0xF9, 0x7FB, 0xFA, 0x16, 0x17, 0x18,
+    0x0, 0x1, 0x2, 0x19, 0x1A, 0x1B,
+    0x1C, 0x1D, 0x1E, 0x1F, 0x5C, 0xFB,
+    0x7FFC, 0x20, 0xFFB, 0x3FC, 0x1FFA, 0x21,
+    0x5D, 0x5E, 0x5F, 0x60, 0x61, 0x62,
+    0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6A, 0x6B, 0x6C, 0x6D, 0x6E,
+    0x6F, 0x70, 0x71, 0x72, 0xFC, 0x73,
+    0xFD, 0x1FFB, 0x7FFF0, 0x1FFC, 0x3FFC, 0x22,
+    0x7FFD, 0x3, 0x23, 0x4, 0x24, 0x5,
+    0x25, 0x26, 0x27, 0x6, 0x74, 0x75,
+    0x28, 0x29, 0x2A, 0x7, 0x2B, 0x76,
+    0x2C, 0x8, 0x9, 0x2D, 0x77, 0x78,
+    0x79, 0x7A, 0x7B, 0x7FFE, 0x7FC, 0x3FFD,
+    0x1FFD, 0xFFFFFFC, 0xFFFE6, 0x3FFFD2, 0xFFFE7, 0xFFFE8,
+    0x3FFFD3, 0x3FFFD4, 0x3FFFD5, 0x7FFFD9, 0x3FFFD6, 0x7FFFDA,
+    0x7FFFDB, 0x7FFFDC, 0x7FFFDD, 0x7FFFDE, 0xFFFFEB, 0x7FFFDF,
+    0xFFFFEC, 0xFFFFED, 0x3FFFD7, 0x7FFFE0, 0xFFFFEE, 0x7FFFE1,
+    0x7FFFE2, 0x7FFFE3, 0x7FFFE4, 0x1FFFDC, 0x3FFFD8, 0x7FFFE5,
+    0x3FFFD9, 0x7FFFE6, 0x7FFFE7, 0xFFFFEF, 0x3FFFDA, 0x1FFFDD,
+    0xFFFE9, 0x3FFFDB, 0x3FFFDC, 0x7FFFE8, 0x7FFFE9, 0x1FFFDE,
+    0x7FFFEA, 0x3FFFDD, 0x3FFFDE, 0xFFFFF0, 0x1FFFDF, 0x3FFFDF,
+    0x7FFFEB, 0x7FFFEC, 0x1FFFE0, 0x1FFFE1, 0x3FFFE0, 0x1FFFE2,
+    0x7FFFED, 0x3FFFE1, 0x7FFFEE, 0x7FFFEF, 0xFFFEA, 0x3FFFE2,
+    0x3FFFE3, 0x3FFFE4, 0x7FFFF0, 0x3FFFE5, 0x3FFFE6, 0x7FFFF1,
+    0x3FFFFE0, 0x3FFFFE1, 0xFFFEB, 0x7FFF1, 0x3FFFE7, 0x7FFFF2,
+    0x3FFFE8, 0x1FFFFEC, 0x3FFFFE2, 0x3FFFFE3, 0x3FFFFE4, 0x7FFFFDE,
+    0x7FFFFDF, 0x3FFFFE5, 0xFFFFF1, 0x1FFFFED, 0x7FFF2, 0x1FFFE3,
+    0x3FFFFE6, 0x7FFFFE0, 0x7FFFFE1, 0x3FFFFE7, 0x7FFFFE2, 0xFFFFF2,
+    0x1FFFE4, 0x1FFFE5, 0x3FFFFE8, 0x3FFFFE9, 0xFFFFFFD, 0x7FFFFE3,
+    0x7FFFFE4, 0x7FFFFE5, 0xFFFEC, 0xFFFFF3, 0xFFFED, 0x1FFFE6,
+    0x3FFFE9, 0x1FFFE7, 0x1FFFE8, 0x7FFFF3, 0x3FFFEA, 0x3FFFEB,
+    0x1FFFFEE, 0x1FFFFEF, 0xFFFFF4, 0xFFFFF5, 0x3FFFFEA, 0x7FFFF4,
+    0x3FFFFEB, 0x7FFFFE6, 0x3FFFFEC, 0x3FFFFED, 0x7FFFFE7, 0x7FFFFE8,
+    0x7FFFFE9, 0x7FFFFEA, 0x7FFFFEB, 0xFFFFFFE, 0x7FFFFEC, 0x7FFFFED,
+    0x7FFFFEE, 0x7FFFFEF, 0x7FFFFF0, 0x3FFFFEE, 0x3FFFFFFF,
+};
+
+static const uint8_t fio___hpack_huff_bits[257] = {
+    13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+    28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+    6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+    5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+    13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+    15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+    6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+    20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+    24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+    22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+    21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+    26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+    19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+    20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+    26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+    30,
+};
+
+static const uint32_t fio___hpack_huff_first[26] = {
+    0x0, 0x14, 0x5C, 0xF8, 0x0, 0x3F8,
+    0x7FA, 0xFFA, 0x1FF8, 0x3FFC, 0x7FFC, 0x0,
+    0x0, 0x0, 0x7FFF0, 0xFFFE6, 0x1FFFDC, 0x3FFFD2,
+    0x7FFFD8, 0xFFFFEA, 0x1FFFFEC, 0x3FFFFE0, 0x7FFFFDE, 0xFFFFFE2,
+    0x0, 0x3FFFFFFC,
+};
+
+static const uint16_t fio___hpack_huff_count[26] = {
+    10, 26, 32, 6, 0, 5, 3, 2, 6, 2, 3, 0, 0,
+    0, 3, 8, 13, 26, 29, 12, 4, 15, 19, 29, 0, 4,
+};
+
+static const uint16_t fio___hpack_huff_offset[26] = {
+    0, 10, 36, 68, 0, 74, 79, 82, 84, 90, 92, 0, 0,
+    0, 95, 98, 106, 119, 145, 174, 186, 190, 205, 224, 0, 253,
+};
+
+static const uint16_t fio___hpack_huff_sym[257] = {
+    48, 49, 50, 97, 99, 101, 105, 111, 115, 116, 32, 37,
+    45, 46, 47, 51, 52, 53, 54, 55, 56, 57, 61, 65,
+    95, 98, 100, 102, 103, 104, 108, 109, 110, 112, 114, 117,
+    58, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76,
+    77, 78, 79, 80, 81, 82, 83, 84, 85, 86, 87, 89,
+    106, 107, 113, 118, 119, 120, 121, 122, 38, 42, 44, 59,
+    88, 90, 33, 34, 40, 41, 63, 39, 43, 124, 35, 62,
+    0, 36, 64, 91, 93, 126, 94, 125, 60, 96, 123, 92,
+    195, 208, 128, 130, 131, 162, 184, 194, 224, 226, 153, 161,
+    167, 172, 176, 177, 179, 209, 216, 217, 227, 229, 230, 129,
+    132, 133, 134, 136, 146, 154, 156, 160, 163, 164, 169, 170,
+    173, 178, 181, 185, 186, 187, 189, 190, 196, 198, 228, 232,
+    233, 1, 135, 137, 138, 139, 140, 141, 143, 147, 149, 150,
+    151, 152, 155, 157, 158, 165, 166, 168, 174, 175, 180, 182,
+    183, 188, 191, 197, 231, 239, 9, 142, 144, 145, 148, 159,
+    171, 206, 215, 225, 236, 237, 199, 207, 234, 235, 192, 193,
+    200, 201, 202, 205, 210, 213, 218, 219, 238, 240, 242, 243,
+    255, 203, 204, 211, 212, 214, 221, 222, 223, 241, 244, 245,
+    246, 247, 248, 250, 251, 252, 253, 254, 2, 3, 4, 5,
+    6, 7, 8, 11, 12, 14, 15, 16, 17, 18, 19, 20,
+    21, 23, 24, 25, 26, 27, 28, 29, 30, 31, 127, 220,
+    249, 10, 13, 22, 256,
+};
+
+
+/** Returns the length of `len` bytes, once Huffman encoded. */
+FIO_IFUNC size_t fio___hpack_huff_length(const uint8_t *s, size_t len) {
+  size_t bits = 0;
+  for (size_t i = 0; i < len; ++i)
+    bits += fio___hpack_huff_bits[s[i]];
+  return (bits + 7) >> 3;
+}
+
+/** Huffman encodes `len` bytes to `dest`, returning the number of bytes. */
+FIO_SFUNC size_t fio___hpack_huff_encode(uint8_t *dest,
+                                         const uint8_t *s,
+                                         size_t len) {
+  uint64_t acc = 0;
+  size_t bits = 0, r = 0;
+  for (size_t i = 0; i < len; ++i) {
+    acc = (acc << fio___hpack_huff_bits[s[i]]) | fio___hpack_huff_code[s[i]];
+    bits += fio___hpack_huff_bits[s[i]];
+    while (bits >= 8) {
+      bits -= 8;
+      dest[r++] = (uint8_t)(acc >> bits);
+    }
+  }
+  if (bits) /* pad using the most significant bits of EOS (all ones) */
+    dest[r++] = (uint8_t)((acc << (8 - bits)) | (0xFFU >> bits));
+  return r;
+}
+
+/** Huffman decodes `len` bytes to `dest`. Returns -1 on error. */
+FIO_SFUNC int fio___hpack_huff_decode(char *dest,
+                                      size_t *dest_len,
+                                      const uint8_t *s,
+                                      size_t len) {
+  uint64_t acc = 0;
+  size_t bits = 0, r = 0;
+  for (;;) {
+    uint32_t peek, sym = 256;
+    size_t l;
+    while (bits <= 56 && len) {
+      acc = (acc << 8) | *(s++);
+      --len;
+      bits += 8;
+    }
+    if (!bits)
+      break;
+    /* peek at the next 30 bits, padding with ones (the EOS prefix) */
+    if (bits >= 30)
+      peek = (uint32_t)(acc >> (bits - 30)) & 0x3FFFFFFFUL;
+    else
+      peek = (uint32_t)((acc << (30 - bits)) | ((1ULL << (30 - bits)) - 1)) &
+             0x3FFFFFFFUL;
+    for (l = 5; l <= 30; ++l) {
+      uint32_t i = (peek >> (30 - l)) - fio___hpack_huff_first[l - 5];
+      if (i < fio___hpack_huff_count[l - 5]) {
+        sym = fio___hpack_huff_sym[fio___hpack_huff_offset[l - 5] + i];
+        break;
+      }
+    }
+    if (l > bits) { /* padding: at most 7 bits, all set */
+      if (bits > 7 || (acc & ((1ULL << bits) - 1)) != ((1ULL << bits) - 1))
+        return -1;
+      break;
+    }
+    if (sym == 256) /* EOS is a decoding error */
+      return -1;
+    dest[r++] = (char)sym;
+    bits -= l;
+  }
+  *dest_len = r;
+  return 0;
+}
+
+/* *****************************************************************************
+HTTP/2 - HPACK Integers & String Literals (RFC 7541, section 5)
+***************************************************************************** */
+
+/** Reads an integer with an N-bit prefix. Returns -1 on error. */
+FIO_IFUNC int fio___hpack_int_read(uint64_t *dest,
+                                   const uint8_t **pos,
+                                   const uint8_t *end,
+                                   uint8_t prefix) {
+  const uint8_t *p = *pos;
+  const uint64_t mask = (1U << prefix) - 1;
+  uint64_t r;
+  if (p >= end)
+    return -1;
+  r = *(p++) & mask;
+  if (r == mask) {
+    for (size_t shift = 0;; shift += 7) {
+      if (p >= end || shift > 28)
+        return -1;
+      r += (uint64_t)(*p & 0x7F) << shift;
+      if (!(*(p++) & 0x80))
+        break;
+    }
+  }
+  *dest = r;
+  *pos = p;
+  return 0;
+}
+
+/** Writes an integer with an N-bit prefix, returning the bytes written. */
+FIO_IFUNC size_t fio___hpack_int_write(uint8_t *dest,
+                                       uint64_t i,
+                                       uint8_t prefix,
+                                       uint8_t first) {
+  const uint64_t mask = (1U << prefix) - 1;
+  size_t r = 1;
+  if (i < mask) {
+    dest[0] = first | (uint8_t)i;
+    return 1;
+  }
+  dest[0] = first | (uint8_t)mask;
+  i -= mask;
+  while (i >= 0x80) {
+    dest[r++] = (uint8_t)(i | 0x80);
+    i >>= 7;
+  }
+  dest[r++] = (uint8_t)i;
+  return r;
+}
+
+/** Reads a string literal, Huffman decoding it to `scratch` if required. */
+FIO_SFUNC int fio___hpack_str_read(fio_str_info_s *dest,
+                                   const uint8_t **pos,
+                                   const uint8_t *end,
+                                   char **scratch) {
+  uint64_t len;
+  const uint8_t huffman = (*pos < end) && (**pos & 0x80);
+  if (fio___hpack_int_read(&len, pos, end, 7) ||
+      len > (uint64_t)(end - *pos))
+    return -1;
+  if (!huffman) {
+    *dest = FIO_STR_INFO2((char *)*pos, (size_t)len);
+    *pos += len;
+    return 0;
+  }
+  dest->buf = *scratch;
+  if (fio___hpack_huff_decode(dest->buf, &dest->len, *pos, (size_t)len))
+    return -1;
+  *scratch += dest->len;
+  *pos += len;
+  return 0;
+}
+
+/** Writes a string literal, Huffman encoded when shorter. */
+FIO_IFUNC size_t fio___hpack_str_write(uint8_t *dest, fio_str_info_s s) {
+  size_t r;
+  const size_t hlen = fio___hpack_huff_length((uint8_t *)s.buf, s.len);
+  if (hlen < s.len) {
+    r = fio___hpack_int_write(dest, hlen, 7, 0x80);
+    return r + fio___hpack_huff_encode(dest + r, (uint8_t *)s.buf, s.len);
+  }
+  r = fio___hpack_int_write(dest, s.len, 7, 0);
+  if (s.len)
+    FIO_MEMCPY(dest + r, s.buf, s.len);
+  return r + s.len;
+}
+
+/* *****************************************************************************
+HTTP/2 - HPACK Static & Dynamic Tables (RFC 7541, section 2.3)
+***************************************************************************** */
+
+#define FIO___HPACK_STATIC(n, v) {n, v, sizeof(n) - 1, sizeof(v) - 1}
+static const struct {
+  const char *name;
+  const char *value;
+  uint8_t nlen;
+  uint8_t vlen;
+} fio___hpack_static[61] = {
+    FIO___HPACK_STATIC(":authority", ""),
+    FIO___HPACK_STATIC(":method", "GET"),
+    FIO___HPACK_STATIC(":method", "POST"),
+    FIO___HPACK_STATIC(":path", "/"),
+    FIO___HPACK_STATIC(":path", "/index.html"),
+    FIO___HPACK_STATIC(":scheme", "http"),
+    FIO___HPACK_STATIC(":scheme", "https"),
+    FIO___HPACK_STATIC(":status", "200"),
+    FIO___HPACK_STATIC(":status", "204"),
+    FIO___HPACK_STATIC(":status", "206"),
+    FIO___HPACK_STATIC(":status", "304"),
+    FIO___HPACK_STATIC(":status", "400"),
+    FIO___HPACK_STATIC(":status", "404"),
+    FIO___HPACK_STATIC(":status", "500"),
+    FIO___HPACK_STATIC("accept-charset", ""),
+    FIO___HPACK_STATIC("accept-encoding", "gzip, deflate"),
+    FIO___HPACK_STATIC("accept-language", ""),
+    FIO___HPACK_STATIC("accept-ranges", ""),
+    FIO___HPACK_STATIC("accept", ""),
+    FIO___HPACK_STATIC("access-control-allow-origin", ""),
+    FIO___HPACK_STATIC("age", ""),
+    FIO___HPACK_STATIC("allow", ""),
+    FIO___HPACK_STATIC("authorization", ""),
+    FIO___HPACK_STATIC("cache-control", ""),
+    FIO___HPACK_STATIC("content-disposition", ""),
+    FIO___HPACK_STATIC("content-encoding", ""),
+    FIO___HPACK_STATIC("content-language", ""),
+    FIO___HPACK_STATIC("content-length", ""),
+    FIO___HPACK_STATIC("content-location", ""),
+    FIO___HPACK_STATIC("content-range", ""),
+    FIO___HPACK_STATIC("content-type", ""),
+    FIO___HPACK_STATIC("cookie", ""),
+    FIO___HPACK_STATIC("date", ""),
+    FIO___HPACK_STATIC("etag", ""),
+    FIO___HPACK_STATIC("expect", ""),
+    FIO___HPACK_STATIC("expires", ""),
+    FIO___HPACK_STATIC("from", ""),
+    FIO___HPACK_STATIC("host", ""),
+    FIO___HPACK_STATIC("if-match", ""),
+    FIO___HPACK_STATIC("if-modified-since", ""),
+    FIO___HPACK_STATIC("if-none-match", ""),
+    FIO___HPACK_STATIC("if-range", ""),
+    FIO___HPACK_STATIC("if-unmodified-since", ""),
+    FIO___HPACK_STATIC("last-modified", ""),
+    FIO___HPACK_STATIC("link", ""),
+    FIO___HPACK_STATIC("location", ""),
+    FIO___HPACK_STATIC("max-forwards", ""),
+    FIO___HPACK_STATIC("proxy-authenticate", ""),
+    FIO___HPACK_STATIC("proxy-authorization", ""),
+    FIO___HPACK_STATIC("range", ""),
+    FIO___HPACK_STATIC("referer", ""),
+    FIO___HPACK_STATIC("refresh", ""),
+    FIO___HPACK_STATIC("retry-after", ""),
+    FIO___HPACK_STATIC("server", ""),
+    FIO___HPACK_STATIC("set-cookie", ""),
+    FIO___HPACK_STATIC("strict-transport-security", ""),
+    FIO___HPACK_STATIC("transfer-encoding", ""),
+    FIO___HPACK_STATIC("user-agent", ""),
+    FIO___HPACK_STATIC("vary", ""),
+    FIO___HPACK_STATIC("via", ""),
+    FIO___HPACK_STATIC("www-authenticate", ""),
+};
+#undef FIO___HPACK_STATIC
+
+/** A dynamic table entry (name and value share a single allocation). */
+typedef struct {
+  char *buf;
+  uint32_t nlen;
+  uint32_t vlen;
+} fio___hpack_entry_s;
+
+/** A dynamic table - a ring buffer where index 0 is the newest entry. */
+typedef struct {
+  fio___hpack_entry_s *ary;
+  uint32_t capa;  /* ring capacity (a power of 2) */
+  uint32_t head;  /* ring position of the next insertion */
+  uint32_t count; /* number of entries */
+  uint32_t size;  /* table size, as defined by RFC 7541, section 4.1 */
+  uint32_t max;   /* maximum table size */
+  uint8_t update; /* (encoder) a size update must be sent */
+} fio___hpack_table_s;
+
+FIO_IFUNC fio___hpack_entry_s *fio___hpack_table_get(fio___hpack_table_s *t,
+                                                     size_t i) {
+  return t->ary + ((t->head - 1 - (uint32_t)i) & (t->capa - 1));
+}
+
+/** Evicts the oldest entries until the table size fits in `max`. */
+FIO_SFUNC void fio___hpack_table_evict(fio___hpack_table_s *t, size_t max) {
+  while (t->size > max && t->count) {
+    fio___hpack_entry_s *e = fio___hpack_table_get(t, t->count - 1);
+    t->size -= e->nlen + e->vlen + 32;
+    FIO_MEM_FREE_(e->buf, e->nlen + e->vlen + 1);
+    e->buf = NULL;
+    --t->count;
+  }
+}
+
+FIO_SFUNC void fio___hpack_table_destroy(fio___hpack_table_s *t) {
+  fio___hpack_table_evict(t, 0);
+  FIO_MEM_FREE_(t->ary, sizeof(*t->ary) * t->capa);
+  *t = (fio___hpack_table_s){0};
+}
+
+/** Adds an entry, evicting older entries as required. */
+FIO_SFUNC void fio___hpack_table_add(fio___hpack_table_s *t,
+                                     fio_str_info_s name,
+                                     fio_str_info_s value) {
+  const size_t size = name.len + value.len + 32;
+  char *buf;
+  if (size > t->max) { /* not an error, the table is emptied */
+    fio___hpack_table_evict(t, 0);
+    return;
+  }
+  /* copy before eviction, as `name` may point to an evicted entry */
+  buf = (char *)FIO_MEM_REALLOC_(NULL, 0, name.len + value.len + 1, 0);
+  FIO_ASSERT_ALLOC(buf);
+  if (name.len)
+    FIO_MEMCPY(buf, name.buf, name.len);
+  if (value.len)
+    FIO_MEMCPY(buf + name.len, value.buf, value.len);
+  fio___hpack_table_evict(t, t->max - size);
+  if (t->count == t->capa) {
+    const uint32_t capa = t->capa ? (t->capa << 1) : 16;
+    fio___hpack_entry_s *tmp = (fio___hpack_entry_s *)
+        FIO_MEM_REALLOC_(NULL, 0, sizeof(*tmp) * capa, 0);
+    FIO_ASSERT_ALLOC(tmp);
+    for (size_t i = 0; i < t->count; ++i)
+      tmp[t->count - 1 - i] = *fio___hpack_table_get(t, i);
+    FIO_MEM_FREE_(t->ary, sizeof(*t->ary) * t->capa);
+    t->ary = tmp;
+    t->capa = capa;
+    t->head = t->count;
+  }
+  t->ary[t->head & (t->capa - 1)] = (fio___hpack_entry_s){
+      .buf = buf,
+      .nlen = (uint32_t)name.len,
+      .vlen = (uint32_t)value.len,
+  };
+  ++t->head;
+  ++t->count;
+  t->size += (uint32_t)size;
+}
+
+/** Gets the header field at `index` (static or dynamic). */
+FIO_SFUNC int fio___hpack_table_index(fio___hpack_table_s *t,
+                                      uint64_t index,
+                                      fio_str_info_s *name,
+                                      fio_str_info_s *value) {
+  fio___hpack_entry_s *e;
+  if (!index)
+    return -1;
+  if (index <= 61) {
+    --index;
+    *name = FIO_STR_INFO2((char *)fio___hpack_static[index].name,
+                          fio___hpack_static[index].nlen);
+    *value = FIO_STR_INFO2((char *)fio___hpack_static[index].value,
+                           fio___hpack_static[index].vlen);
+    return 0;
+  }
+  index -= 62;
+  if (index >= t->count)
+    return -1;
+  e = fio___hpack_table_get(t, (size_t)index);
+  *name = FIO_STR_INFO2(e->buf, e->nlen);
+  *value = FIO_STR_INFO2(e->buf + e->nlen, e->vlen);
+  return 0;
+}
+
+/** Finds a header field, returns its index (0 if missing). */
+FIO_SFUNC size_t fio___hpack_table_find(fio___hpack_table_s *t,
+                                        fio_str_info_s name,
+                                        fio_str_info_s value,
+                                        int *exact) {
+  size_t found = 0;
+  *exact = 0;
+  for (size_t i = 0; i < 61; ++i) {
+    if (fio___hpack_static[i].nlen != name.len ||
+        FIO_MEMCMP(fio___hpack_static[i].name, name.buf, name.len))
+      continue;
+    if (!found)
+      found = i + 1;
+    if (fio___hpack_static[i].vlen == value.len &&
+        (!value.len ||
+         !FIO_MEMCMP(fio___hpack_static[i].value, value.buf, value.len))) {
+      *exact = 1;
+      return i + 1;
+    }
+  }
+  for (size_t i = 0; i < t->count; ++i) {
+    fio___hpack_entry_s *e = fio___hpack_table_get(t, i);
+    if (e->nlen != name.len || FIO_MEMCMP(e->buf, name.buf, name.len))
+      continue;
+    if (!found)
+      found = i + 62;
+    if (e->vlen == value.len &&
+        (!value.len || !FIO_MEMCMP(e->buf + e->nlen, value.buf, value.len))) {
+      *exact = 1;
+      return i + 62;
+    }
+  }
+  return found;
+}
+
+/* *****************************************************************************
+HTTP/2 - HPACK Decoding / Encoding (RFC 7541, section 6)
+***************************************************************************** */
+
+/**
+ * Decodes a header block, calling `on_header` for each header field.
+ *
+ * Once `on_header` returns non-zero it is no longer called, but decoding
+ * continues so the dynamic table remains synchronized.
+ *
+ * Returns -1 on a decoding (compression) error, 1 if `on_header` failed.
+ */
+FIO_SFUNC int fio___hpack_decode(fio___hpack_table_s *t,
+                                 fio_buf_info_s block,
+                                 int (*on_header)(void *,
+                                                  fio_str_info_s name,
+                                                  fio_str_info_s value),
+                                 void *udata) {
+  char tmp[2048];
+  char *scratch_start = tmp;
+  const uint8_t *pos = (const uint8_t *)block.buf;
+  const uint8_t *end = pos + block.len;
+  const size_t scratch_len = ((block.len * 8) / 5) + 16;
+  int r = 0, any = 0;
+  if (scratch_len > sizeof(tmp)) {
+    scratch_start = (char *)FIO_MEM_REALLOC_(NULL, 0, scratch_len, 0);
+    FIO_ASSERT_ALLOC(scratch_start);
+  }
+  while (pos < end) {
+    char *scratch = scratch_start;
+    fio_str_info_s name, value;
+    uint64_t i;
+    uint8_t add = 0;
+    if ((*pos & 0x80)) { /* indexed header field */
+      if (fio___hpack_int_read(&i, &pos, end, 7) ||
+          fio___hpack_table_index(t, i, &name, &value))
+        goto decoding_error;
+    } else if ((*pos & 0xE0) == 0x20) { /* dynamic table size update */
+      if (any || fio___hpack_int_read(&i, &pos, end, 5) ||
+          i > FIO___HTTP2_HPACK_MAX)
+        goto decoding_error;
+      t->max = (uint32_t)i;
+      fio___hpack_table_evict(t, t->max);
+      continue;
+    } else { /* literal, with incremental indexing / without / never */
+      add = ((*pos & 0xC0) == 0x40);
+      if (fio___hpack_int_read(&i, &pos, end, (add ? 6 : 4)))
+        goto decoding_error;
+      if (i) {
+        if (fio___hpack_table_index(t, i, &name, &value))
+          goto decoding_error;
+      } else if (fio___hpack_str_read(&name, &pos, end, &scratch))
+        goto decoding_error;
+      if (fio___hpack_str_read(&value, &pos, end, &scratch))
+        goto decoding_error;
+    }
+    any = 1;
+    if (!r && on_header(udata, name, value))
+      r = 1;
+    if (add)
+      fio___hpack_table_add(t, name, value);
+  }
+  if (scratch_start != tmp)
+    FIO_MEM_FREE_(scratch_start, scratch_len);
+  return r;
+
+decoding_error:
+  if (scratch_start != tmp)
+    FIO_MEM_FREE_(scratch_start, scratch_len);
+  return -1;
+}
+
+/** Encoding modes: with incremental indexing, without indexing, never. */
+typedef enum {
+  FIO___HPACK_INDEX = 0,
+  FIO___HPACK_NO_INDEX = 1,
+  FIO___HPACK_NEVER_INDEX = 2,
+} fio___hpack_mode_e;
+
+/** Encodes a header field, appending it to the `dest` fio_bstr. */
+FIO_SFUNC char *fio___hpack_encode(fio___hpack_table_s *t,
+                                   char *dest,
+                                   fio_str_info_s name,
+                                   fio_str_info_s value,
+                                   fio___hpack_mode_e mode) {
+  int exact;
+  size_t i = fio___hpack_table_find(t, name, value, &exact);
+  size_t len = fio_bstr_len(dest);
+  uint8_t *p;
+  dest = fio_bstr_reserve(dest, name.len + value.len + 24);
+  p = (uint8_t *)dest + len;
+  if (exact && mode != FIO___HPACK_NEVER_INDEX) {
+    len += fio___hpack_int_write(p, i, 7, 0x80);
+    return fio_bstr_len_set(dest, len);
+  }
+  if (mode == FIO___HPACK_INDEX)
+    len += fio___hpack_int_write(p, i, 6, 0x40);
+  else
+    len += fio___hpack_int_write(p,
+                                 i,
+                                 4,
+                                 (mode == FIO___HPACK_NEVER_INDEX ? 0x10 : 0));
+  if (!i)
+    len += fio___hpack_str_write((uint8_t *)dest + len, name);
+  len += fio___hpack_str_write((uint8_t *)dest + len, value);
+  if (mode == FIO___HPACK_INDEX)
+    fio___hpack_table_add(t, name, value);
+  return fio_bstr_len_set(dest, len);
+}
+
+/* *****************************************************************************
+HTTP/2 - Session (Connection) State
+***************************************************************************** */
+#define FIO___RECURSIVE_INCLUDE 1
+
+#define FIO_MAP_NAME       fio___http2_smap
+#define FIO_MAP_KEY        uint32_t
+#define FIO_MAP_VALUE      fio___http_connection_s *
+#define FIO_MAP_HASH_FN(k) fio_risky_num((uint64_t)(k), 0)
+#include FIO_INCLUDE_FILE
+
+/** HTTP/2 connection state, attached to the connection's `state.h2`. */
+struct fio___http2_s {
+  fio_io_s *io;                /* NULL once the connection was closed */
+  fio___http_connection_s *c;  /* the connection object (IO `udata`) */
+  fio___http2_smap_s streams;  /* open streams by id */
+  FIO_LIST_HEAD active;        /* streams with pending output */
+  fio___hpack_table_s dec;     /* request header decoding */
+  fio___hpack_table_s enc;     /* response header encoding */
+  char *wbuf;                  /* pending frames, written once per cycle */
+  char *hblock;                /* incomplete header block (+ CONTINUATION) */
+  char *eblock;                /* header block encoding buffer */
+  int64_t window;              /* connection send window */
+  uint32_t recv;               /* bytes received since last WINDOW_UPDATE */
+  uint32_t peer_window;        /* peer's SETTINGS_INITIAL_WINDOW_SIZE */
+  uint32_t peer_frame;         /* peer's SETTINGS_MAX_FRAME_SIZE */
+  uint32_t last_id;            /* highest stream id received */
+  uint32_t hblock_id;          /* stream id for `hblock` */
+  uint32_t len;                /* bytes in `buf` */
+  uint32_t capa;               /* capacity of `buf` */
+  uint8_t hblock_flags;        /* HEADERS flags for `hblock` */
+  uint8_t flush;               /* flush task scheduled */
+  uint8_t goaway;              /* GOAWAY sent / received, no new streams */
+  uint8_t error;               /* connection error, stop processing */
+  char buf[];
+};
+
+#define FIO_REF_NAME             fio___http2
+#define FIO_REF_FLEX_TYPE        char
+#define FIO_REF_CONSTRUCTOR_ONLY 1
+#define FIO_REF_DESTROY(o)                                                     \
+  do {                                                                         \
+    fio___http2_smap_destroy(&o.streams);                                      \
+    fio___hpack_table_destroy(&o.dec);                                         \
+    fio___hpack_table_destroy(&o.enc);                                         \
+    fio_bstr_free(o.wbuf);                                                     \
+    fio_bstr_free(o.hblock);                                                   \
+    fio_bstr_free(o.eblock);                                                   \
+  } while (0)
+#include FIO_INCLUDE_FILE
+
+#undef FIO___RECURSIVE_INCLUDE
+
+FIO_SFUNC void fio___http2_flush(fio___http2_s *s);
+
+/* *****************************************************************************
+HTTP/2 - Frame Writing
+***************************************************************************** */
+
+FIO_IFUNC void fio___http2_frame_header(char *dest,
+                                        size_t len,
+                                        uint8_t type,
+                                        uint8_t flags,
+                                        uint32_t id) {
+  fio_u2buf24_be(dest, (uint32_t)len);
+  dest[3] = (char)type;
+  dest[4] = (char)flags;
+  fio_u2buf32_be(dest + 5, id & 0x7FFFFFFFUL);
+}
+
+/** Appends a frame to the session's write buffer. */
+FIO_SFUNC void fio___http2_frame(fio___http2_s *s,
+                                 uint8_t type,
+                                 uint8_t flags,
+                                 uint32_t id,
+                                 const void *payload,
+                                 size_t len) {
+  size_t pos = fio_bstr_len(s->wbuf);
+  s->wbuf = fio_bstr_reserve(s->wbuf, len + 9);
+  fio___http2_frame_header(s->wbuf + pos, len, type, flags, id);
+  if (len)
+    FIO_MEMCPY(s->wbuf + pos + 9, payload, len);
+  s->wbuf = fio_bstr_len_set(s->wbuf, pos + len + 9);
+}
+
+/** Appends a frame with a single 32 bit payload value. */
+FIO_IFUNC void fio___http2_frame32(fio___http2_s *s,
+                                   uint8_t type,
+                                   uint32_t id,
+                                   uint32_t value) {
+  char buf[4];
+  fio_u2buf32_be(buf, value);
+  fio___http2_frame(s, type, 0, id, buf, 4);
+}
+
+/** Hands the pending frames to the IO. */
+FIO_IFUNC void fio___http2_write(fio___http2_s *s) {
+  if (!s->wbuf || !s->io)
+    return;
+  fio_io_write2(s->io,
+                .buf = s->wbuf,
+                .len = fio_bstr_len(s->wbuf),
+                .dealloc = (void (*)(void *))fio_bstr_free);
+  s->wbuf = NULL;
+}
+
+/** Sends a GOAWAY frame, no new streams will be accepted. */
+FIO_SFUNC void fio___http2_goaway(fio___http2_s *s, uint32_t code) {
+  char buf[8];
+  fio_u2buf32_be(buf, s->last_id);
+  fio_u2buf32_be(buf + 4, code);
+  fio___http2_frame(s, FIO___HTTP2_FRAME_GOAWAY, 0, 0, buf, 8);
+  s->goaway = 1;
+}
+
+/** Connection errors: sends a GOAWAY frame and closes the connection. */
+FIO_SFUNC void fio___http2_error(fio___http2_s *s, uint32_t code) {
+  FIO_LOG_DDEBUG2("(%d) HTTP/2 connection error (%u) for %p",
+                  fio_io_pid(),
+                  (unsigned)code,
+                  (void *)s->io);
+  if (s->error)
+    return;
+  s->error = 1;
+  fio___http2_goaway(s, code);
+  fio___http2_write(s);
+  fio_io_close(s->io);
+}
+
+FIO_SFUNC void fio___http2_flush_task(void *s_, void *ignr_) {
+  fio___http2_s *s = (fio___http2_s *)s_;
+  s->flush = 0;
+  if (s->io && !s->error)
+    fio___http2_flush(s);
+  fio___http2_free(s);
+  (void)ignr_;
+}
+
+/** Schedules a flush (once per cycle), coalescing frames from all streams. */
+FIO_IFUNC void fio___http2_schedule(fio___http2_s *s) {
+  if (s->flush)
+    return;
+  s->flush = 1;
+  fio_io_defer(fio___http2_flush_task, (void *)fio___http2_dup(s), NULL);
+}
+
+/* *****************************************************************************
+HTTP/2 - Streams (each stream has its own connection object as `cdata`)
+***************************************************************************** */
+
+/** Creates a new stream with a new request handle. */
+FIO_SFUNC fio___http_connection_s *fio___http2_stream_new(fio___http2_s *s,
+                                                          uint32_t id) {
+  fio___http_protocol_s *p =
+      FIO_PTR_FROM_FIELD(fio___http_protocol_s, settings, s->c->settings);
+  fio___http_connection_s *st = fio___http_connection_new(0);
+  FIO_ASSERT_ALLOC(st);
+  fio___http_protocol_dup(p);
+  *st = (fio___http_connection_s){
+      .io = fio_io_dup(s->io),
+      .h = fio_http_new(),
+      .settings = s->c->settings,
+      .queue = s->c->queue,
+      .udata = s->c->udata,
+      .state.h2 =
+          {
+              .session = s,
+              .window = s->peer_window,
+              .id = id,
+              .urgency = 3, /* RFC 9218 default urgency */
+          },
+      .log = s->c->log,
+      .is_h2_stream = 1,
+  };
+  FIO_ASSERT_ALLOC(st->h);
+  st->state.h2.out = (fio_stream_s)FIO_STREAM_INIT(st->state.h2.out);
+  st->state.h2.node = FIO_LIST_INIT(st->state.h2.node);
+  fio_http_controller_set(st->h,
+                          &p->state[FIO___HTTP_PROTOCOL_HTTP2].controller);
+  fio_http_udata_set(st->h, st->udata);
+  fio_http_cdata_set(st->h, fio___http_connection_dup(st));
+  fio_http_version_set(st->h, FIO_STR_INFO2((char *)"HTTP/2", 6));
+  fio___http2_smap_set(&s->streams, id, st, NULL);
+  return st;
+}
+
+/** Marks a stream as having pending output and schedules a flush. */
+FIO_IFUNC void fio___http2_stream_activate(fio___http2_s *s,
+                                           fio___http_connection_s *st) {
+  if (!(st->state.h2.flags & FIO___HTTP2_S_ACTIVE)) {
+    st->state.h2.flags |= FIO___HTTP2_S_ACTIVE;
+    FIO_LIST_PUSH(&s->active, &st->state.h2.node);
+  }
+  fio___http2_schedule(s);
+}
+
+/** Removes a stream from the session, discarding any pending output. */
+FIO_SFUNC void fio___http2_stream_remove(fio___http2_s *s,
+                                         fio___http_connection_s *st) {
+  fio_http_s *h = st->h;
+  if (!st->state.h2.session)
     return;
+  st->state.h2.session = NULL;
+  st->h = NULL;
+  if ((st->state.h2.flags & FIO___HTTP2_S_ACTIVE))
+    FIO_LIST_REMOVE_RESET(&st->state.h2.node);
+  st->state.h2.flags |= FIO___HTTP2_S_LOCAL_CLOSED |
+                        FIO___HTTP2_S_REMOTE_CLOSED;
+  fio_stream_destroy(&st->state.h2.out);
+  fio_bstr_free(st->state.h2.hdr);
+  st->state.h2.hdr = NULL;
+  fio___http2_smap_remove(&s->streams, st->state.h2.id, NULL);
+  if (h) { /* an incomplete request that was never handled, don't log */
+    st->log = 0;
+    fio_http_free(h);
+  }
+  fio___http_connection_free(st);
+  if (s->goaway && s->io && !fio___http2_smap_count(&s->streams))
+    fio_io_close(s->io);
+}
 
-  if (c->len > prior_knowledge.len)
-    FIO_MEMMOVE(c->buf,
-                c->buf + prior_knowledge.len,
-                c->len - prior_knowledge.len);
-  c->len -= prior_knowledge.len;
-  phttp_new = &(FIO_PTR_FROM_FIELD(fio___http_protocol_s, settings, c->settings)
-                    ->state[FIO___HTTP_PROTOCOL_HTTP2]
-                    .protocol);
+/** Stream errors: sends RST_STREAM and removes the stream. */
+FIO_IFUNC void fio___http2_stream_reset(fio___http2_s *s,
+                                        fio___http_connection_s *st,
+                                        uint32_t code) {
+  fio___http2_frame32(s,
+                      FIO___HTTP2_FRAME_RST_STREAM,
+                      st->state.h2.id,
+                      code);
+  fio___http2_stream_remove(s, st);
+}
 
-  fio_io_protocol_set(io, phttp_new);
+/** Answers a request with an error before it reached the user's callback. */
+FIO_SFUNC void fio___http2_stream_refuse(fio___http_connection_s *st,
+                                         size_t status) {
+  fio_http_s *h = st->h;
+  st->h = NULL;
+  st->state.h2.flags |= FIO___HTTP2_S_DISCARD;
+  fio_http_send_error_response(h, status);
+  fio_http_free(h);
 }
 
-FIO_SFUNC void fio___http_on_close(void *buf, void *udata) {
-  FIO_LOG_DDEBUG2("(%d) HTTP connection closed for %p",
-                  (int)fio_thread_getpid(),
-                  udata);
-  fio___http_connection_s *c = (fio___http_connection_s *)udata;
-  c->io = NULL;
-  fio_http_free(c->h);
-  fio___http_connection_free(c);
-  (void)buf;
+/** Parses the RFC 9218 urgency (`u=N`) from a `priority` field value. */
+FIO_IFUNC uint8_t fio___http2_urgency(fio_str_info_s v, uint8_t dflt) {
+  for (size_t i = 0; i + 2 < v.len; ++i) {
+    if (v.buf[i] != 'u' || v.buf[i + 1] != '=' ||
+        (i && v.buf[i - 1] != ' ' && v.buf[i - 1] != ','))
+      continue;
+    if (v.buf[i + 2] >= '0' && v.buf[i + 2] <= '7')
+      return (uint8_t)(v.buf[i + 2] - '0');
+    return dflt;
+  }
+  return dflt;
+}
+
+/** Tests for connection specific headers (RFC 9113, section 8.2.2). */
+FIO_IFUNC int fio___http2_is_connection_header(fio_str_info_s n) {
+  switch (n.len) {
+  case 7: return !FIO_MEMCMP(n.buf, "upgrade", 7);
+  case 10:
+    return !FIO_MEMCMP(n.buf, "connection", 10) ||
+           !FIO_MEMCMP(n.buf, "keep-alive", 10);
+  case 16: return !FIO_MEMCMP(n.buf, "proxy-connection", 16);
+  case 17: return !FIO_MEMCMP(n.buf, "transfer-encoding", 17);
+  }
+  return 0;
 }
 
 /* *****************************************************************************
-HTTP/1.1 Protocol
+HTTP/2 - Requests (HEADERS, CONTINUATION, DATA)
 ***************************************************************************** */
 
-FIO_SFUNC int fio___http1_process_data(fio_io_s *io,
-                                       fio___http_connection_s *c) {
-  (void)io;
-  for (;;) {
-    size_t consumed = fio_http1_parse(&c->state.http.parser,
-                                      FIO_BUF_INFO2(c->buf, c->len),
-                                      (void *)c);
-    if (!consumed)
-      goto nothing_consumed;
-    if (consumed == FIO_HTTP1_PARSER_ERROR)
-      goto http1_error;
-    c->len -= consumed;
-    if (c->len)
-      FIO_MEMMOVE(c->buf, c->buf + consumed, c->len);
-    if (c->suspend)
+typedef struct {
+  fio___http_connection_s *st;
+  size_t bytes;
+  uint8_t regular; /* a regular header was received (no more pseudo headers) */
+  uint8_t trailer;
+  uint8_t err; /* 1: malformed, otherwise an HTTP status code */
+  uint16_t status;
+} fio___http2_headers_s;
+
+/** HPACK callback, adding a decoded header field to the request. */
+FIO_SFUNC int fio___http2_on_header(void *ctx_,
+                                    fio_str_info_s name,
+                                    fio_str_info_s value) {
+  fio___http2_headers_s *ctx = (fio___http2_headers_s *)ctx_;
+  fio_http_s *h = ctx->st ? ctx->st->h : NULL;
+  if (!h)
+    return -1; /* refused / discarded stream, keep HPACK state only */
+  ctx->bytes += name.len + value.len + 32;
+  if (ctx->bytes > ctx->st->settings->max_header_size) {
+    ctx->status = 431;
+    return -1;
+  }
+  if (!name.len)
+    goto malformed;
+  if (name.buf[0] == ':') { /* pseudo-header fields */
+    if (ctx->regular || ctx->trailer)
+      goto malformed;
+    if (name.len == 7 && !FIO_MEMCMP(name.buf, ":method", 7)) {
+      if (fio_http_method(h).len)
+        goto malformed;
+      fio_http_method_set(h, value);
+    } else if (name.len == 5 && !FIO_MEMCMP(name.buf, ":path", 5)) {
+      char *q = value.len ? (char *)FIO_MEMCHR(value.buf, '?', value.len)
+                          : NULL;
+      if (fio_http_path(h).len || !value.len)
+        goto malformed;
+      if (q) {
+        fio_http_query_set(
+            h,
+            FIO_STR_INFO2(q + 1, (size_t)((value.buf + value.len) - (q + 1))));
+        value.len = (size_t)(q - value.buf);
+      }
+      fio_http_path_set(h, value);
+    } else if (name.len == 10 && !FIO_MEMCMP(name.buf, ":authority", 10)) {
+      fio_http_request_header_set(h, FIO_STR_INFO2((char *)"host", 4), value);
+    } else if (!(name.len == 7 && !FIO_MEMCMP(name.buf, ":scheme", 7)))
+      goto malformed;
+    return 0;
+  }
+  ctx->regular = 1;
+  for (size_t i = 0; i < name.len; ++i)
+    if ((unsigned char)(name.buf[i] - 'A') < 26)
+      goto malformed; /* field names must be lower case */
+  if (fio___http2_is_connection_header(name))
+    goto malformed;
+  if (name.len == 2 && name.buf[0] == 't' && name.buf[1] == 'e' &&
+      !(value.len == 8 && !FIO_MEMCMP(value.buf, "trailers", 8)))
+    goto malformed;
+  if (name.len == 14 && !FIO_MEMCMP(name.buf, "content-length", 14)) {
+    size_t len = 0; /* values aren't NUL terminated, avoid fio_atol */
+    if (!value.len || value.len > 15)
+      goto malformed;
+    for (size_t i = 0; i < value.len; ++i) {
+      if ((uint8_t)(value.buf[i] - '0') > 9)
+        goto malformed;
+      len = (len * 10) + (size_t)(value.buf[i] - '0');
+    }
+    if (len > ctx->st->settings->max_body_size) {
+      ctx->status = 413;
       return -1;
+    }
+    if (len && !ctx->trailer)
+      fio_http_body_expect(h, len);
+    if (!FIO_HTTP_SHOW_CONTENT_LENGTH_HEADER)
+      return 0;
+  }
+  if (name.len == 8 && !FIO_MEMCMP(name.buf, "priority", 8))
+    ctx->st->state.h2.urgency = fio___http2_urgency(value, 3);
+  if (name.len == 4 && !FIO_MEMCMP(name.buf, "host", 4)) {
+    fio_http_request_header_set(h, name, value); /* may follow :authority */
+    return 0;
   }
+  fio_http_request_header_add(h, name, value);
   return 0;
 
-nothing_consumed:
-  if (c->len == c->capa)
-    goto http1_abuse;
-  else
-    return -1;
+malformed:
+  ctx->err = 1;
+  return -1;
+}
 
-http1_error:
-  FIO_LOG_DDEBUG2("(%d) HTTP/1.1 parser error! disconnecting client at %d",
-                  fio_io_pid(),
-                  fio_io_fd(io));
-  if (c->h) {
-    fio_http_s *h = c->h;
-    c->h = NULL;
-    if (!c->is_client) {
-      fio_io_dup(c->io);
-      if (fio_http_send_error_response(h, 400))
-        fio_io_free(c->io);
-    }
+/** Serves requests routed to an HTTP/2 stream (no Upgrade mechanism). */
+FIO_SFUNC void fio___http2_on_http(void *h_, void *ignr) {
+  fio_http_s *h = (fio_http_s *)h_;
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  union {
+    void (*fn)(fio_http_s *);
+    void *ptr;
+  } cb = {.fn = c->settings->on_http};
+  fio_http_status_set(h, 200);
+  if (c->settings->public_folder.len &&
+      (fio_http_method(h).len != 4 || (fio_buf2u32u(fio_http_method(h).buf) |
+                                       0x20202020UL) != fio_buf2u32u("post")) &&
+      !fio_http_static_file_response(h,
+                                     c->settings->public_folder,
+                                     fio_http_path(h),
+                                     c->settings->max_age)) {
     fio_http_free(h);
+    return;
   }
-  fio_io_close(io);
-  return -1;
+  fio_queue_push(c->queue, fio___http_perform_user_callback, cb.ptr, (void *)h);
+  (void)ignr;
+}
 
-http1_abuse:
-  FIO_LOG_DDEBUG2(
-      "(%d) HTTP/1.1 hit security limit, disconnecting client at %d",
-      fio_io_pid(),
-      fio_io_fd(io));
-  if (c->h) {
-    fio_http_s *h = c->h;
-    c->h = NULL;
-    if (!c->is_client) {
-      fio_io_dup(c->io);
-      if (fio_http_send_error_response(h, 431))
-        fio_io_free(c->io);
-    }
-    fio_http_free(h);
+/** Routes a complete request to the user's `on_http` callback. */
+FIO_SFUNC void fio___http2_stream_dispatch(fio___http2_s *s,
+                                           fio___http_connection_s *st) {
+  if (!st->h)
+    return;
+  if (fio_http_sse_requested(st->h)) {
+    /* EventSource streams require HTTP/1.1, browsers will retry */
+    fio___http2_stream_reset(s, st, FIO___HTTP2_HTTP_1_1_REQUIRED);
+    return;
   }
-  fio_io_close(io);
-  return -1;
+  fio_queue_push(fio_io_queue(), fio___http2_on_http, (void *)st->h);
+  st->h = NULL;
 }
 
-// /** Called when a data is available. */
-FIO_SFUNC void fio___http1_on_data(fio_io_s *io) {
-  fio___http_connection_s *c = (fio___http_connection_s *)fio_io_udata(io);
-  size_t r;
-  for (;;) {
-    if (c->capa == c->len)
+/** Handles a complete header block (HEADERS + CONTINUATION frames). */
+FIO_SFUNC void fio___http2_on_header_block(fio___http2_s *s,
+                                           uint32_t id,
+                                           fio_buf_info_s block,
+                                           uint8_t end_stream) {
+  fio___http2_headers_s ctx = {0};
+  int r;
+  ctx.st = fio___http2_smap_get(&s->streams, id);
+  if (!ctx.st) {
+    if (!(id & 1)) {
+      fio___http2_error(s, FIO___HTTP2_PROTOCOL_ERROR);
       return;
-    if (!(r = fio_io_read(io, c->buf + c->len, c->capa - c->len)))
+    }
+    if (id <= s->last_id) {
+      /* closed / reset stream: keep the HPACK state in sync (RFC 9113) */
+      if (fio___hpack_decode(&s->dec, block, fio___http2_on_header, &ctx) < 0)
+        goto compression_error;
+      fio___http2_frame32(s,
+                          FIO___HTTP2_FRAME_RST_STREAM,
+                          id,
+                          FIO___HTTP2_STREAM_CLOSED);
       return;
-    c->len += r;
-    if (fio___http1_process_data(io, c))
+    }
+    s->last_id = id;
+    if (s->goaway ||
+        fio___http2_smap_count(&s->streams) >= FIO_HTTP2_MAX_STREAMS) {
+      if (fio___hpack_decode(&s->dec, block, fio___http2_on_header, &ctx) < 0)
+        goto compression_error;
+      fio___http2_frame32(s,
+                          FIO___HTTP2_FRAME_RST_STREAM,
+                          id,
+                          FIO___HTTP2_REFUSED_STREAM);
       return;
+    }
+    ctx.st = fio___http2_stream_new(s, id);
+  } else {
+    ctx.trailer = 1;
   }
-}
-
-// /** Called when an IO is attached to a protocol. */
-FIO_SFUNC void fio___http1_on_attach(fio_io_s *io) {
-  fio___http_connection_s *c = (fio___http_connection_s *)fio_io_udata(io);
-  if (c->len)
-    fio___http1_process_data(io, c);
+  r = fio___hpack_decode(&s->dec, block, fio___http2_on_header, &ctx);
+  if (r < 0)
+    goto compression_error;
+  if (ctx.trailer) {
+    if ((ctx.st->state.h2.flags & FIO___HTTP2_S_REMOTE_CLOSED)) {
+      fio___http2_stream_reset(s, ctx.st, FIO___HTTP2_STREAM_CLOSED);
+      return;
+    }
+    if (!end_stream)
+      ctx.err = 1;
+  } else if (!ctx.err && !ctx.status &&
+             (!fio_http_method(ctx.st->h).len || !fio_http_path(ctx.st->h).len))
+    ctx.err = 1;
+  if (ctx.err) {
+    fio___http2_stream_reset(s, ctx.st, FIO___HTTP2_PROTOCOL_ERROR);
+    return;
+  }
+  if (ctx.status && ctx.st->h)
+    fio___http2_stream_refuse(ctx.st, ctx.status);
+  if (!end_stream)
+    return;
+  ctx.st->state.h2.flags |= FIO___HTTP2_S_REMOTE_CLOSED;
+  fio___http2_stream_dispatch(s, ctx.st);
   return;
-}
 
-/* *****************************************************************************
-HTTP/1.1 Client Protocol
-***************************************************************************** */
+compression_error:
+  fio___http2_error(s, FIO___HTTP2_COMPRESSION_ERROR);
+}
 
-/** Iterates through all cookies. A non-zero return will stop iteration. */
-FIO_SFUNC int fio_http1___write_client_cookie_callback(fio_http_s *h,
-                                                       fio_str_info_s name,
-                                                       fio_str_info_s value,
-                                                       void *udata) {
-  fio_str_info_s *buf = (fio_str_info_s *)udata;
-  fio_string_write2(buf,
-                    FIO_STRING_REALLOC,
-                    FIO_STRING_WRITE_STR2("cookie:", 7),
-                    FIO_STRING_WRITE_STR_INFO(name),
-                    FIO_STRING_WRITE_STR2("=", 1),
-                    FIO_STRING_WRITE_STR_INFO(value),
-                    FIO_STRING_WRITE_STR2("\r\n", 2));
-  return 0;
-  (void)h;
+FIO_SFUNC void fio___http2_on_frame_headers(fio___http2_s *s,
+                                            uint32_t id,
+                                            uint8_t flags,
+                                            char *payload,
+                                            size_t len) {
+  size_t pad = 0;
+  if (!id)
+    goto protocol_error;
+  if ((flags & FIO___HTTP2_FLAG_PADDED)) {
+    if (!len)
+      goto protocol_error;
+    pad = (uint8_t)payload[0];
+    ++payload;
+    --len;
+  }
+  if ((flags & FIO___HTTP2_FLAG_PRIORITY)) { /* deprecated (RFC 9113) */
+    if (len < 5)
+      goto protocol_error;
+    payload += 5;
+    len -= 5;
+  }
+  if (pad > len)
+    goto protocol_error;
+  len -= pad;
+  if ((flags & FIO___HTTP2_FLAG_END_HEADERS)) {
+    fio___http2_on_header_block(s,
+                                id,
+                                FIO_BUF_INFO2(payload, len),
+                                (flags & FIO___HTTP2_FLAG_END_STREAM));
+    return;
+  }
+  s->hblock = fio_bstr_write(s->hblock, payload, len);
+  s->hblock_id = id;
+  s->hblock_flags = flags;
+  return;
+protocol_error:
+  fio___http2_error(s, FIO___HTTP2_PROTOCOL_ERROR);
 }
 
-/** called by the HTTP handle for each header. */
-FIO_SFUNC int fio_http1___write_header_callback(fio_http_s *h,
-                                                fio_str_info_s name,
-                                                fio_str_info_s value,
-                                                void *out_) {
-  (void)h;
-  /* manually copy, as this is an "all or nothing" copy (no truncation) */
-  fio_str_info_s *out = (fio_str_info_s *)out_;
-  return fio_string_write2(out,
-                           FIO_STRING_REALLOC,
-                           FIO_STRING_WRITE_STR2(name.buf, name.len),
-                           FIO_STRING_WRITE_STR2(":", 1),
-                           FIO_STRING_WRITE_STR2(value.buf, value.len),
-                           FIO_STRING_WRITE_STR2("\r\n", 2));
+FIO_SFUNC void fio___http2_on_frame_continuation(fio___http2_s *s,
+                                                 uint32_t id,
+                                                 uint8_t flags,
+                                                 char *payload,
+                                                 size_t len) {
+  if (!s->hblock_id || id != s->hblock_id) {
+    fio___http2_error(s, FIO___HTTP2_PROTOCOL_ERROR);
+    return;
+  }
+  s->hblock = fio_bstr_write(s->hblock, payload, len);
+  if (fio_bstr_len(s->hblock) > (s->c->settings->max_header_size << 1)) {
+    fio___http2_error(s, FIO___HTTP2_ENHANCE_YOUR_CALM);
+    return;
+  }
+  if (!(flags & FIO___HTTP2_FLAG_END_HEADERS))
+    return;
+  s->hblock_id = 0;
+  fio___http2_on_header_block(s,
+                              id,
+                              fio_bstr_buf(s->hblock),
+                              (s->hblock_flags & FIO___HTTP2_FLAG_END_STREAM));
+  s->hblock = fio_bstr_len_set(s->hblock, 0);
 }
 
-FIO_SFUNC void fio___http1_send_request(fio_http_s *h) {
-  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
-  if (!c->io || !fio_io_is_open(c->io))
+FIO_SFUNC void fio___http2_on_frame_data(fio___http2_s *s,
+                                         uint32_t id,
+                                         uint8_t flags,
+                                         char *payload,
+                                         size_t len) {
+  fio___http_connection_s *st;
+  const size_t flow = len; /* flow control includes padding */
+  size_t pad = 0;
+  if (!id)
+    goto protocol_error;
+  if ((flags & FIO___HTTP2_FLAG_PADDED)) {
+    if (!len)
+      goto protocol_error;
+    pad = (uint8_t)payload[0];
+    ++payload;
+    --len;
+    if (pad > len)
+      goto protocol_error;
+    len -= pad;
+  }
+  s->recv += (uint32_t)flow;
+  if (s->recv > FIO_HTTP2_WINDOW) {
+    fio___http2_error(s, FIO___HTTP2_FLOW_CONTROL_ERROR);
     return;
-  fio_str_info_s buf = FIO_STR_INFO2(NULL, 0);
-  /* set Content-Length (client is never streaming) */
-  if (fio_http_body_length(h)) {
-    char ibuf[32];
-    fio_str_info_s k = FIO_STR_INFO2((char *)"content-length", 14);
-    fio_str_info_s v = FIO_STR_INFO3(ibuf, 0, 32);
-    v.len = fio_digits10u(fio_http_body_length(h));
-    fio_ltoa10u(v.buf, fio_http_body_length(h), v.len);
-    fio_http_request_header_set(h, k, v);
   }
-  { /* set sensible defaults for common headers (Accept, User-Agent) */
-    fio_http_request_header_set_if_missing(h,
-                                           FIO_STR_INFO1((char *)"accept"),
-                                           FIO_STR_INFO1((char *)"*/*"));
-    fio_http_request_header_set_if_missing(
-        h,
-        FIO_STR_INFO1((char *)"user-agent"),
-        FIO_STR_INFO1((char *)"facil.io/" FIO_VERSION_STRING));
+  if (s->recv >= (FIO_HTTP2_WINDOW >> 1)) {
+    fio___http2_frame32(s, FIO___HTTP2_FRAME_WINDOW_UPDATE, 0, s->recv);
+    s->recv = 0;
   }
-  { /* write status string */
-    fio_str_info_s method = fio_http_method(h);
-    fio_str_info_s path = fio_http_path(h);
-    fio_str_info_s version = fio_http_version(h);
-    if (!path.len)
-      path = FIO_STR_INFO1((char *)"/");
-    if ((version.len - 1) > 15)
-      version = FIO_STR_INFO1((char *)"HTTP/1.1");
-    fio_string_write2(&buf,
-                      FIO_STRING_REALLOC,
-                      FIO_STRING_WRITE_STR_INFO(method),
-                      FIO_STRING_WRITE_STR2(" ", 1),
-                      FIO_STRING_WRITE_STR_INFO(path),
-                      FIO_STRING_WRITE_STR2(" ", 1),
-                      FIO_STRING_WRITE_STR_INFO(version),
-                      FIO_STRING_WRITE_STR2("\r\n", 2));
+  st = fio___http2_smap_get(&s->streams, id);
+  if (!st) {
+    if (id > s->last_id)
+      goto protocol_error;
+    return; /* a recently closed (reset) stream */
   }
-  /* write headers */
-  fio_http_request_header_each(h, fio_http1___write_header_callback, &buf);
-  /* write cookies */
-  fio_http_cookie_each(h, fio_http1___write_client_cookie_callback, &buf);
-  fio_string_write(&buf, FIO_STRING_REALLOC, "\r\n", 2);
-  /* send data (moves memory ownership) */
-  fio_io_write2(c->io,
-                .buf = buf.buf,
-                .len = buf.len,
-                .dealloc = FIO_STRING_FREE,
-                .copy = 0);
-  /* make sure we listen to incoming data */
-  c->suspend = 0;
-  fio_io_unsuspend(c->io);
-  /* Write Body */
-  if (!fio_http_body_length(h))
+  if ((st->state.h2.flags & FIO___HTTP2_S_REMOTE_CLOSED)) {
+    fio___http2_stream_reset(s, st, FIO___HTTP2_STREAM_CLOSED);
     return;
-  fio_http_body_seek(h, 0);
-  if (fio_http_body_fd(h) == -1) {
-    buf = fio_http_body_read(h, (size_t)-1);
-    fio_io_write2(c->io,
-                  .buf = (char *)fio_http_dup(h),
-                  .len = buf.len,
-                  .offset = (size_t)((char *)h - buf.buf),
-                  .dealloc = (void (*)(void *))fio_http_free);
-  } else {
-    fio_io_write2(c->io,
-                  .fd = fio_http_body_fd(h),
-                  .len = fio_http_body_length(h),
-                  .copy = 1);
   }
-}
-
-FIO_SFUNC void fio___http1_on_attach_client(fio_io_s *io) {
-  fio___http_connection_s *c = (fio___http_connection_s *)fio_io_udata(io);
-  // c->io = fio_io_dup(io);
-  c->io = io;
-  fio___http1_send_request(c->h);
-  if (c->len)
-    fio___http1_process_data(io, c);
+  st->state.h2.recv += (uint32_t)flow;
+  if (st->state.h2.recv > FIO_HTTP2_WINDOW) {
+    fio___http2_stream_reset(s, st, FIO___HTTP2_FLOW_CONTROL_ERROR);
+    return;
+  }
+  if (!(flags & FIO___HTTP2_FLAG_END_STREAM) &&
+      st->state.h2.recv >= (FIO_HTTP2_WINDOW >> 1)) {
+    fio___http2_frame32(s,
+                        FIO___HTTP2_FRAME_WINDOW_UPDATE,
+                        id,
+                        st->state.h2.recv);
+    st->state.h2.recv = 0;
+  }
+  if (st->h && len && !(st->state.h2.flags & FIO___HTTP2_S_DISCARD)) {
+    if (len + fio_http_body_length(st->h) > st->settings->max_body_size) {
+      fio___http2_stream_refuse(st, 413);
+    } else {
+      if (!(st->state.h2.flags & FIO___HTTP2_S_PRE_BODY)) {
+        st->state.h2.flags |= FIO___HTTP2_S_PRE_BODY;
+        st->settings->pre_http_body(st->h);
+      }
+      if (fio_http_status(st->h)) { /* responded, the body isn't wanted */
+        fio_http_free(st->h);
+        st->h = NULL;
+        st->state.h2.flags |= FIO___HTTP2_S_DISCARD;
+      } else if (fio_http_body_write(st->h, payload, len)) {
+        fio___http2_stream_refuse(st, 400); /* i.e., a malformed multipart */
+      }
+    }
+  }
+  if (!(flags & FIO___HTTP2_FLAG_END_STREAM))
+    return;
+  st->state.h2.flags |= FIO___HTTP2_S_REMOTE_CLOSED;
+  fio___http2_stream_dispatch(s, st);
   return;
+protocol_error:
+  fio___http2_error(s, FIO___HTTP2_PROTOCOL_ERROR);
 }
 
 /* *****************************************************************************
-HTTP/1 Controller
+HTTP/2 - Control Frames
 ***************************************************************************** */
-FIO_SFUNC int fio___http_controller_get_fd(fio_http_s *h) {
-  return fio_io_fd(fio_http_io(h));
-}
 
-/** Informs the controller that request / response headers must be sent. */
-FIO_SFUNC void fio___http_controller_http1_send_headers(fio_http_s *h) {
-  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
-  if (!c->io || !fio_io_is_open(c->io))
+FIO_SFUNC void fio___http2_on_frame_settings(fio___http2_s *s,
+                                             uint32_t id,
+                                             uint8_t flags,
+                                             char *payload,
+                                             size_t len) {
+  if (id) {
+    fio___http2_error(s, FIO___HTTP2_PROTOCOL_ERROR);
     return;
-  fio_str_info_s buf = FIO_STR_INFO2(NULL, 0);
-  { /* write status string */
-    fio_str_info_s ver = fio_http_version(h);
-    fio_str_info_s status = fio_http_status2str(fio_http_status(h));
-    if (ver.len > 15) {
-      FIO_LOG_ERROR("HTTP/1.1 client version string too long!");
-      ver = FIO_STR_INFO1((char *)"HTTP/1.1");
+  }
+  if ((flags & FIO___HTTP2_FLAG_ACK)) {
+    if (len)
+      fio___http2_error(s, FIO___HTTP2_FRAME_SIZE_ERROR);
+    return;
+  }
+  if ((len % 6)) {
+    fio___http2_error(s, FIO___HTTP2_FRAME_SIZE_ERROR);
+    return;
+  }
+  for (size_t i = 0; i < len; i += 6) {
+    const uint32_t v = fio_buf2u32_be(payload + i + 2);
+    switch (fio_buf2u16_be(payload + i)) {
+    case 0x1: /* SETTINGS_HEADER_TABLE_SIZE */
+      if ((v > FIO___HTTP2_HPACK_MAX ? FIO___HTTP2_HPACK_MAX : v) ==
+          s->enc.max)
+        break;
+      s->enc.max = (v > FIO___HTTP2_HPACK_MAX ? FIO___HTTP2_HPACK_MAX : v);
+      fio___hpack_table_evict(&s->enc, s->enc.max);
+      s->enc.update = 1;
+      break;
+    case 0x2: /* SETTINGS_ENABLE_PUSH (we never push) */
+      if (v > 1)
+        goto protocol_error;
+      break;
+    case 0x4: /* SETTINGS_INITIAL_WINDOW_SIZE */
+      if (v > 0x7FFFFFFFUL) {
+        fio___http2_error(s, FIO___HTTP2_FLOW_CONTROL_ERROR);
+        return;
+      }
+      FIO_MAP_EACH(fio___http2_smap, &s->streams, pos) {
+        pos.value->state.h2.window += (int64_t)v - (int64_t)s->peer_window;
+        if (pos.value->state.h2.window > 0x7FFFFFFFLL) {
+          fio___http2_error(s, FIO___HTTP2_FLOW_CONTROL_ERROR);
+          return;
+        }
+      }
+      s->peer_window = v;
+      break;
+    case 0x5: /* SETTINGS_MAX_FRAME_SIZE */
+      if (v < 16384 || v > 16777215)
+        goto protocol_error;
+      s->peer_frame = v;
+      break;
     }
-    fio_string_write2(&buf,
-                      FIO_STRING_REALLOC,
-                      FIO_STRING_WRITE_STR2(ver.buf, ver.len),
-                      FIO_STRING_WRITE_STR2(" ", 1),
-                      FIO_STRING_WRITE_NUM(fio_http_status(h)),
-                      FIO_STRING_WRITE_STR2(" ", 1),
-                      FIO_STRING_WRITE_STR2(status.buf, status.len),
-                      FIO_STRING_WRITE_STR2("\r\n", 2));
   }
-
-  /* write headers */
-  fio_http_response_header_each(h, fio_http1___write_header_callback, &buf);
-  /* write cookies */
-  fio_http_set_cookie_each(h, fio_http1___write_header_callback, &buf);
-  /* add streaming headers? */
-  if (fio_http_is_streaming(h))
-    fio_string_write(&buf,
-                     FIO_STRING_REALLOC,
-                     "transfer-encoding: chunked\r\n",
-                     28);
-  fio_string_write(&buf, FIO_STRING_REALLOC, "\r\n", 2);
-  /* send data (move memory ownership)? */
-  c->state.http.buf = buf;
+  fio___http2_frame(s, FIO___HTTP2_FRAME_SETTINGS, FIO___HTTP2_FLAG_ACK, 0, 0, 0);
+  if (!FIO_LIST_IS_EMPTY(&s->active))
+    fio___http2_schedule(s);
   return;
-  // fio_io_write2(c->io,
-  //               .buf = buf.buf,
-  //               .len = buf.len,
-  //               .dealloc = FIO_STRING_FREE,
-  //               .copy = 0);
+protocol_error:
+  fio___http2_error(s, FIO___HTTP2_PROTOCOL_ERROR);
 }
-/** called by the HTTP handle for each body chunk (or to finish a response. */
-FIO_SFUNC void fio___http_controller_http1_write_body(
-    fio_http_s *h,
-    fio_http_write_args_s args) {
-  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
-  if (!c->io || !fio_io_is_open(c->io))
-    goto no_write_err;
-  if (fio_http_is_streaming(h))
-    goto stream_chunk;
-  if (c->state.http.buf.len) {
-    if (args.buf && args.len) {
-      fio_string_write(&c->state.http.buf,
-                       FIO_STRING_REALLOC,
-                       (char *)args.buf + args.offset,
-                       args.len);
-      if (args.dealloc)
-        args.dealloc((void *)args.buf);
-    }
-    fio_io_write2(c->io,
-                  .buf = (void *)c->state.http.buf.buf,
-                  .len = c->state.http.buf.len,
-                  .dealloc = FIO_STRING_FREE);
-    c->state.http.buf = FIO_STR_INFO0;
-    if (args.buf && args.len)
+
+FIO_SFUNC void fio___http2_on_frame_window_update(fio___http2_s *s,
+                                                  uint32_t id,
+                                                  char *payload,
+                                                  size_t len) {
+  fio___http_connection_s *st;
+  uint32_t inc;
+  if (len != 4) {
+    fio___http2_error(s, FIO___HTTP2_FRAME_SIZE_ERROR);
+    return;
+  }
+  inc = fio_buf2u32_be(payload) & 0x7FFFFFFFUL;
+  if (!id) {
+    if (!inc) {
+      fio___http2_error(s, FIO___HTTP2_PROTOCOL_ERROR);
       return;
+    }
+    s->window += inc;
+    if (s->window > 0x7FFFFFFFLL)
+      fio___http2_error(s, FIO___HTTP2_FLOW_CONTROL_ERROR);
+    else if (!FIO_LIST_IS_EMPTY(&s->active))
+      fio___http2_schedule(s);
+    return;
   }
+  st = fio___http2_smap_get(&s->streams, id);
+  if (!st)
+    return;
+  if (!inc) {
+    fio___http2_stream_reset(s, st, FIO___HTTP2_PROTOCOL_ERROR);
+    return;
+  }
+  st->state.h2.window += inc;
+  if (st->state.h2.window > 0x7FFFFFFFLL)
+    fio___http2_stream_reset(s, st, FIO___HTTP2_FLOW_CONTROL_ERROR);
+  else if ((st->state.h2.flags & FIO___HTTP2_S_ACTIVE))
+    fio___http2_schedule(s);
+}
 
-  fio_io_write2(c->io,
-                .buf = (void *)args.buf,
-                .fd = args.fd,
-                .len = args.len,
-                .offset = args.offset,
-                .dealloc = args.dealloc,
-                .copy = (uint8_t)args.copy);
-  return;
-
-stream_chunk:
-  if (args.len && args.buf) { /* String */
-    if (args.copy || args.len < (1 << 16)) {
-      fio_string_write2(
-          &c->state.http.buf,
-          FIO_STRING_REALLOC,
-          FIO_STRING_WRITE_HEX(args.len),   /* chunk header - length */
-          FIO_STRING_WRITE_STR2("\r\n", 2), /* chunk header - EOL */
-          FIO_STRING_WRITE_STR2((char *)args.buf, args.buf ? args.len : 0),
-          FIO_STRING_WRITE_STR2("\r\n", 2)); /* chunk trailer - EOL */
-      fio_io_write2(c->io,
-                    .buf = (void *)c->state.http.buf.buf,
-                    .len = c->state.http.buf.len,
-                    .dealloc = FIO_STRING_FREE);
-      c->state.http.buf = FIO_STR_INFO0;
-      if (args.dealloc)
-        args.dealloc((void *)args.buf);
+/** Processes all complete frames in the session's read buffer. */
+FIO_SFUNC void fio___http2_process(fio___http2_s *s) {
+  char *pos = s->buf;
+  char *end = s->buf + s->len;
+  while (!s->error && (end - pos) >= 9) {
+    const size_t len = fio_buf2u24_be(pos);
+    const uint8_t type = (uint8_t)pos[3];
+    const uint8_t flags = (uint8_t)pos[4];
+    const uint32_t id = fio_buf2u32_be(pos + 5) & 0x7FFFFFFFUL;
+    char *payload = pos + 9;
+    fio___http_connection_s *st;
+    if (len > FIO___HTTP2_FRAME_MAX) {
+      fio___http2_error(s, FIO___HTTP2_FRAME_SIZE_ERROR);
       return;
-    } else { /* avoid copying the incoming data if possible */
-      FIO_STR_INFO_TMP_VAR(buf, 32);
-      if (c->state.http.buf.buf)
-        buf = c->state.http.buf;
-      c->state.http.buf = FIO_STR_INFO0;
-      fio_string_write2(
-          &buf,
-          NULL,
-          FIO_STRING_WRITE_HEX(args.len),    /* chunk header - length */
-          FIO_STRING_WRITE_STR2("\r\n", 2)); /* chunk header - EOL */
-      fio_io_write2(c->io,
-                    .buf = buf.buf,
-                    .len = buf.len,
-                    .copy = !FIO_STR_INFO_TMP_IS_REALLOCATED(buf),
-                    .dealloc = FIO_STR_INFO_TMP_IS_REALLOCATED(buf)
-                                   ? FIO_STRING_FREE
-                                   : NULL);
-      fio_io_write2(c->io,
-                    .buf = (void *)args.buf,
-                    .len = args.len,
-                    .dealloc = args.dealloc);
-      /* chunk trailer - EOL */
-      fio_io_write2(c->io, .buf = (void *)"\r\n", .len = 2);
+    }
+    if ((size_t)(end - pos) < len + 9)
+      break;
+    pos += len + 9;
+    if (s->hblock_id && type != FIO___HTTP2_FRAME_CONTINUATION) {
+      fio___http2_error(s, FIO___HTTP2_PROTOCOL_ERROR);
       return;
     }
-  } else if ((uint32_t)(args.fd + 1) > 1U) { /* File? */
-    if (!args.len) {
-      if (fio_fd_type(args.fd) != S_IFREG)
-        goto no_length_err;
-      /* collect remaining file length */
-      off_t len = fio_fd_size(args.fd);
-      off_t offset = lseek(args.fd, 0, SEEK_CUR);
-      if (len > 0 && offset > 0)
-        len -= offset;
-      if (len <= 0)
-        goto no_length_err;
-      args.len = (size_t)len;
+    switch (type) {
+    case FIO___HTTP2_FRAME_DATA:
+      fio___http2_on_frame_data(s, id, flags, payload, len);
+      break;
+    case FIO___HTTP2_FRAME_HEADERS:
+      fio___http2_on_frame_headers(s, id, flags, payload, len);
+      break;
+    case FIO___HTTP2_FRAME_CONTINUATION:
+      fio___http2_on_frame_continuation(s, id, flags, payload, len);
+      break;
+    case FIO___HTTP2_FRAME_PRIORITY: /* deprecated (RFC 9113), ignored */
+      if (!id)
+        fio___http2_error(s, FIO___HTTP2_PROTOCOL_ERROR);
+      else if (len != 5)
+        fio___http2_frame32(s,
+                            FIO___HTTP2_FRAME_RST_STREAM,
+                            id,
+                            FIO___HTTP2_FRAME_SIZE_ERROR);
+      break;
+    case FIO___HTTP2_FRAME_RST_STREAM:
+      if (!id)
+        fio___http2_error(s, FIO___HTTP2_PROTOCOL_ERROR);
+      else if (len != 4)
+        fio___http2_error(s, FIO___HTTP2_FRAME_SIZE_ERROR);
+      else if ((st = fio___http2_smap_get(&s->streams, id)))
+        fio___http2_stream_remove(s, st);
+      else if (id > s->last_id)
+        fio___http2_error(s, FIO___HTTP2_PROTOCOL_ERROR);
+      break;
+    case FIO___HTTP2_FRAME_SETTINGS:
+      fio___http2_on_frame_settings(s, id, flags, payload, len);
+      break;
+    case FIO___HTTP2_FRAME_PUSH_PROMISE: /* clients can't push */
+      fio___http2_error(s, FIO___HTTP2_PROTOCOL_ERROR);
+      break;
+    case FIO___HTTP2_FRAME_PING:
+      if (id)
+        fio___http2_error(s, FIO___HTTP2_PROTOCOL_ERROR);
+      else if (len != 8)
+        fio___http2_error(s, FIO___HTTP2_FRAME_SIZE_ERROR);
+      else if (!(flags & FIO___HTTP2_FLAG_ACK))
+        fio___http2_frame(s,
+                          FIO___HTTP2_FRAME_PING,
+                          FIO___HTTP2_FLAG_ACK,
+                          0,
+                          payload,
+                          8);
+      break;
+    case FIO___HTTP2_FRAME_GOAWAY:
+      if (id) {
+        fio___http2_error(s, FIO___HTTP2_PROTOCOL_ERROR);
+        break;
+      }
+      s->goaway = 1;
+      if (!fio___http2_smap_count(&s->streams))
+        fio_io_close(s->io);
+      break;
+    case FIO___HTTP2_FRAME_WINDOW_UPDATE:
+      fio___http2_on_frame_window_update(s, id, payload, len);
+      break;
+    case FIO___HTTP2_FRAME_PRIORITY_UPDATE: /* RFC 9218 */
+      if (id)
+        fio___http2_error(s, FIO___HTTP2_PROTOCOL_ERROR);
+      else if (len < 4)
+        fio___http2_error(s, FIO___HTTP2_FRAME_SIZE_ERROR);
+      else if ((st = fio___http2_smap_get(
+                    &s->streams,
+                    fio_buf2u32_be(payload) & 0x7FFFFFFFUL)))
+        st->state.h2.urgency =
+            fio___http2_urgency(FIO_STR_INFO2(payload + 4, len - 4),
+                                st->state.h2.urgency);
+      break;
+    default: break; /* unknown frame types are ignored */
     }
-    FIO_STR_INFO_TMP_VAR(buf, 32);
-    if (c->state.http.buf.buf)
-      buf = c->state.http.buf;
-    c->state.http.buf = FIO_STR_INFO0;
-    fio_string_write2(
-        &buf,
-        NULL,
-        FIO_STRING_WRITE_HEX(args.len),    /* chunk header - length */
-        FIO_STRING_WRITE_STR2("\r\n", 2)); /* chunk header - EOL */
-    fio_io_write2(
-        c->io,
-        .buf = buf.buf,
-        .len = buf.len,
-        .copy = !FIO_STR_INFO_TMP_IS_REALLOCATED(buf),
-        .dealloc =
-            (FIO_STR_INFO_TMP_IS_REALLOCATED(buf) ? FIO_STRING_FREE : NULL));
-    fio_io_write2(c->io,
-                  .fd = args.fd,
-                  .len = args.len,
-                  .copy = (bool)args.copy,
-                  .dealloc = args.dealloc);
-    /* chunk trailer - EOL */
-    fio_io_write2(c->io, .buf = (void *)"\r\n", .len = 2);
-  } else
-    goto no_write_err;
-  return;
-no_length_err:
-  FIO_LOG_ERROR("HTTP1 streaming requires a correctly pre-determined "
-                "length per chunk.");
-no_write_err:
-  if (args.buf) {
-    if (args.dealloc)
-      args.dealloc((void *)args.buf);
-  } else if ((uint32_t)(args.fd + 1) > 1U) {
-    close(args.fd);
   }
+  if (s->error)
+    return;
+  s->len = (uint32_t)(end - pos);
+  if (s->len && pos != s->buf)
+    FIO_MEMMOVE(s->buf, pos, s->len);
+}
+
+/* *****************************************************************************
+HTTP/2 - Responses (HEADERS & DATA frames)
+***************************************************************************** */
+
+/** Chooses the HPACK indexing mode for response header fields. */
+FIO_IFUNC fio___hpack_mode_e fio___http2_index_mode(fio_str_info_s n,
+                                                    fio_str_info_s v) {
+  if (v.len > 256)
+    return FIO___HPACK_NO_INDEX;
+  switch (n.len) {
+  case 4:
+    if (!FIO_MEMCMP(n.buf, "etag", 4))
+      return FIO___HPACK_NO_INDEX;
+    break;
+  case 10:
+    if (!FIO_MEMCMP(n.buf, "set-cookie", 10))
+      return FIO___HPACK_NEVER_INDEX;
+    break;
+  case 13:
+    if (!FIO_MEMCMP(n.buf, "last-modified", 13) ||
+        !FIO_MEMCMP(n.buf, "content-range", 13))
+      return FIO___HPACK_NO_INDEX;
+    break;
+  case 14:
+    if (!FIO_MEMCMP(n.buf, "content-length", 14))
+      return FIO___HPACK_NO_INDEX;
+    break;
+  }
+  return FIO___HPACK_INDEX;
+}
+
+/** Encodes a stream's response headers, writing HEADERS + CONTINUATION. */
+FIO_SFUNC void fio___http2_write_headers(fio___http2_s *s,
+                                         fio___http_connection_s *st) {
+  fio_buf_info_s list = fio_bstr_buf(st->state.h2.hdr);
+  size_t offset = 0;
+  uint8_t type = FIO___HTTP2_FRAME_HEADERS;
+  uint8_t flags = 0;
+  s->eblock = fio_bstr_len_set(s->eblock, 0);
+  if (s->enc.update) {
+    uint8_t tmp[8];
+    s->eblock = fio_bstr_write(s->eblock,
+                               tmp,
+                               fio___hpack_int_write(tmp, s->enc.max, 5, 0x20));
+    s->enc.update = 0;
+  }
+  /* the header list: a sequence of [name len][value len][name][value] */
+  while (offset + 8 <= list.len) {
+    fio_str_info_s n, v;
+    n.len = fio_buf2u32u(list.buf + offset);
+    v.len = fio_buf2u32u(list.buf + offset + 4);
+    n.buf = list.buf + offset + 8;
+    v.buf = n.buf + n.len;
+    offset += 8 + n.len + v.len;
+    s->eblock = fio___hpack_encode(&s->enc,
+                                   s->eblock,
+                                   n,
+                                   v,
+                                   fio___http2_index_mode(n, v));
+  }
+  fio_bstr_free(st->state.h2.hdr);
+  st->state.h2.hdr = NULL;
+  st->state.h2.flags |= FIO___HTTP2_S_HEADERS_SENT;
+  if ((st->state.h2.flags & FIO___HTTP2_S_FINISHED) &&
+      !fio_stream_any(&st->state.h2.out)) {
+    flags = FIO___HTTP2_FLAG_END_STREAM;
+    st->state.h2.flags |= FIO___HTTP2_S_LOCAL_CLOSED;
+  }
+  list = fio_bstr_buf(s->eblock);
+  offset = 0;
+  do {
+    size_t len = list.len - offset;
+    if (len > s->peer_frame)
+      len = s->peer_frame;
+    if (offset + len == list.len)
+      flags |= FIO___HTTP2_FLAG_END_HEADERS;
+    fio___http2_frame(s, type, flags, st->state.h2.id, list.buf + offset, len);
+    offset += len;
+    type = FIO___HTTP2_FRAME_CONTINUATION;
+    flags = 0;
+  } while (offset < list.len);
+}
+
+/** Writes a single DATA frame, returning the number of bytes written. */
+FIO_SFUNC size_t fio___http2_write_data(fio___http2_s *s,
+                                        fio___http_connection_s *st,
+                                        size_t len) {
+  const size_t pos = fio_bstr_len(s->wbuf);
+  const size_t limit = len;
+  uint8_t flags = 0;
+  char *buf;
+  s->wbuf = fio_bstr_reserve(s->wbuf, len + 9);
+  buf = s->wbuf + pos + 9;
+  fio_stream_read(&st->state.h2.out, &buf, &len);
+  if (!buf || !len)
+    return 0;
+  if (len > limit) /* may point to a larger (embedded / external) buffer */
+    len = limit;
+  if (buf != s->wbuf + pos + 9)
+    FIO_MEMCPY(s->wbuf + pos + 9, buf, len);
+  fio_stream_advance(&st->state.h2.out, len);
+  if ((st->state.h2.flags & FIO___HTTP2_S_FINISHED) &&
+      !fio_stream_any(&st->state.h2.out)) {
+    flags = FIO___HTTP2_FLAG_END_STREAM;
+    st->state.h2.flags |= FIO___HTTP2_S_LOCAL_CLOSED;
+  }
+  fio___http2_frame_header(s->wbuf + pos,
+                           len,
+                           FIO___HTTP2_FRAME_DATA,
+                           flags,
+                           st->state.h2.id);
+  s->wbuf = fio_bstr_len_set(s->wbuf, pos + len + 9);
+  return len;
+}
+
+/**
+ * Writes pending HEADERS and DATA frames, as well as any control frames.
+ *
+ * HEADERS are written first, as HPACK requires header blocks to be encoded in
+ * the order they are sent. DATA frames are scheduled by RFC 9218 urgency
+ * (lower values first), round-robin among streams of the same urgency, and
+ * limited by the connection and stream flow control windows.
+ */
+FIO_SFUNC void fio___http2_flush(fio___http2_s *s) {
+  fio___http_connection_s *ary[FIO_HTTP2_MAX_STREAMS];
+  size_t count = 0;
+  size_t budget = FIO___HTTP2_FLUSH_LIMIT;
+  if (fio_io_backlog(s->io) > FIO___HTTP2_BACKLOG_LIMIT)
+    budget = 0; /* `on_ready` will resume */
+  FIO_LIST_EACH(fio___http_connection_s, state.h2.node, &s->active, st) {
+    if (st->state.h2.hdr)
+      fio___http2_write_headers(s, st);
+    if (count < FIO_HTTP2_MAX_STREAMS)
+      ary[count++] = st;
+  }
+  /* stable insertion sort by urgency, preserving round-robin ordering */
+  for (size_t i = 1; i < count; ++i) {
+    fio___http_connection_s *tmp = ary[i];
+    size_t j = i;
+    for (; j && ary[j - 1]->state.h2.urgency > tmp->state.h2.urgency; --j)
+      ary[j] = ary[j - 1];
+    ary[j] = tmp;
+  }
+  for (size_t start = 0, end; start < count; start = end) {
+    uint8_t progress = 1;
+    for (end = start; end < count && ary[end]->state.h2.urgency ==
+                                         ary[start]->state.h2.urgency;
+         ++end)
+      ;
+    while (progress) {
+      progress = 0;
+      for (size_t i = start; i < end; ++i) {
+        fio___http_connection_s *st = ary[i];
+        size_t len;
+        if (!st)
+          continue;
+        len = fio_stream_length(&st->state.h2.out);
+        if ((st->state.h2.flags &
+             (FIO___HTTP2_S_LOCAL_CLOSED | FIO___HTTP2_S_HEADERS_SENT)) !=
+            FIO___HTTP2_S_HEADERS_SENT)
+          continue;
+        if (!len) {
+          if ((st->state.h2.flags & FIO___HTTP2_S_FINISHED)) {
+            fio___http2_frame(s,
+                              FIO___HTTP2_FRAME_DATA,
+                              FIO___HTTP2_FLAG_END_STREAM,
+                              st->state.h2.id,
+                              NULL,
+                              0);
+            st->state.h2.flags |= FIO___HTTP2_S_LOCAL_CLOSED;
+          }
+          continue;
+        }
+        if (len > budget)
+          len = budget;
+        if ((int64_t)len > s->window)
+          len = (s->window > 0) ? (size_t)s->window : 0;
+        if ((int64_t)len > st->state.h2.window)
+          len = (st->state.h2.window > 0) ? (size_t)st->state.h2.window : 0;
+        if (len > s->peer_frame)
+          len = s->peer_frame;
+        if (!len)
+          continue;
+        if (!(len = fio___http2_write_data(s, st, len))) {
+          fio___http2_stream_reset(s, st, FIO___HTTP2_INTERNAL_ERROR);
+          ary[i] = NULL;
+          continue;
+        }
+        s->window -= (int64_t)len;
+        st->state.h2.window -= (int64_t)len;
+        budget -= len;
+        progress = 1;
+      }
+    }
+  }
+  /* cleanup: close finished streams, deactivate idle ones */
+  for (size_t i = 0; i < count; ++i) {
+    fio___http_connection_s *st = ary[i];
+    if (!st)
+      continue;
+    if ((st->state.h2.flags & FIO___HTTP2_S_LOCAL_CLOSED)) {
+      if (!(st->state.h2.flags & FIO___HTTP2_S_REMOTE_CLOSED))
+        fio___http2_frame32(s, /* response complete, request body unneeded */
+                            FIO___HTTP2_FRAME_RST_STREAM,
+                            st->state.h2.id,
+                            FIO___HTTP2_NO_ERROR);
+      fio___http2_stream_remove(s, st);
+      continue;
+    }
+    if (!fio_stream_any(&st->state.h2.out) && !st->state.h2.hdr &&
+        !(st->state.h2.flags & FIO___HTTP2_S_FINISHED)) {
+      st->state.h2.flags &= ~FIO___HTTP2_S_ACTIVE;
+      FIO_LIST_REMOVE_RESET(&st->state.h2.node);
+    }
+  }
+  fio___http2_write(s);
+  if (!budget && s->window > 0 && !FIO_LIST_IS_EMPTY(&s->active) &&
+      fio_io_backlog(s->io) <= FIO___HTTP2_BACKLOG_LIMIT)
+    fio___http2_schedule(s);
+}
+
+/* *****************************************************************************
+HTTP/2 Protocol
+***************************************************************************** */
+
+/** Called when an IO is attached to the HTTP/2 protocol (after the preface). */
+FIO_SFUNC void fio___http2_on_attach(fio_io_s *io) {
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_io_udata(io);
+  const uint32_t capa =
+      (c->len > FIO___HTTP2_FRAME_MAX + 9) ? c->len : FIO___HTTP2_FRAME_MAX + 9;
+  fio___http2_s *s = fio___http2_new(capa);
+  char settings[18];
+  FIO_ASSERT_ALLOC(s);
+  *s = (fio___http2_s){
+      .io = io,
+      .c = c,
+      .dec = {.max = FIO___HTTP2_HPACK_MAX},
+      .enc = {.max = FIO___HTTP2_HPACK_MAX},
+      .window = 65535,
+      .peer_window = 65535,
+      .peer_frame = 16384,
+      .len = c->len,
+      .capa = capa,
+  };
+  s->active = FIO_LIST_INIT(s->active);
+  if (c->len)
+    FIO_MEMCPY(s->buf, c->buf, c->len);
+  c->len = 0;
+  c->state.h2 = (struct fio___http_connection_h2_s){.session = s};
+  FIO_LOG_DDEBUG2("(%d) HTTP/2 connection attached for %p",
+                  fio_io_pid(),
+                  (void *)io);
+  /* server connection preface: SETTINGS + connection window */
+  fio_u2buf16_be(settings, 0x3); /* SETTINGS_MAX_CONCURRENT_STREAMS */
+  fio_u2buf32_be(settings + 2, FIO_HTTP2_MAX_STREAMS);
+  fio_u2buf16_be(settings + 6, 0x4); /* SETTINGS_INITIAL_WINDOW_SIZE */
+  fio_u2buf32_be(settings + 8, FIO_HTTP2_WINDOW);
+  fio_u2buf16_be(settings + 12, 0x6); /* SETTINGS_MAX_HEADER_LIST_SIZE */
+  fio_u2buf32_be(settings + 14, c->settings->max_header_size);
+  fio___http2_frame(s, FIO___HTTP2_FRAME_SETTINGS, 0, 0, settings, 18);
+  if (FIO_HTTP2_WINDOW > 65535)
+    fio___http2_frame32(s,
+                        FIO___HTTP2_FRAME_WINDOW_UPDATE,
+                        0,
+                        FIO_HTTP2_WINDOW - 65535);
+  if (s->len)
+    fio___http2_process(s);
+  fio___http2_write(s);
+}
+
+/** Called when data is available. */
+FIO_SFUNC void fio___http2_on_data(fio_io_s *io) {
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_io_udata(io);
+  fio___http2_s *s = c->state.h2.session;
+  size_t r;
+  while (!s->error &&
+         (r = fio_io_read(io, s->buf + s->len, s->capa - s->len))) {
+    s->len += (uint32_t)r;
+    fio___http2_process(s);
+  }
+  fio___http2_write(s);
+}
+
+/** Called once all pending `fio_io_write` calls are finished. */
+FIO_SFUNC void fio___http2_on_ready(fio_io_s *io) {
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_io_udata(io);
+  fio___http2_s *s = c->state.h2.session;
+  if (!s->error && !FIO_LIST_IS_EMPTY(&s->active))
+    fio___http2_flush(s);
 }
 
-FIO_SFUNC void fio___http_controller_http1_on_finish_task(void *c_,
-                                                          void *upgraded) {
-  fio___http_connection_s *c = (fio___http_connection_s *)c_;
-  c->suspend = 0;
+/** Called when the server is shutting down (sends GOAWAY). */
+FIO_SFUNC void fio___http2_on_shutdown(fio_io_s *io) {
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_io_udata(io);
+  fio___http2_s *s = c->state.h2.session;
+  if (s->error)
+    return;
+  fio___http2_goaway(s, FIO___HTTP2_NO_ERROR);
+  fio___http2_write(s);
+}
 
-  if (upgraded)
-    goto upgraded;
+/** Called after the connection was closed, discarding any open streams. */
+FIO_SFUNC void fio___http2_on_close(void *buf, void *udata) {
+  fio___http_connection_s *c = (fio___http_connection_s *)udata;
+  fio___http2_s *s = c->state.h2.session;
+  if (s) {
+    fio___http_connection_s *ary[FIO_HTTP2_MAX_STREAMS];
+    size_t count = 0;
+    s->io = NULL;
+    FIO_MAP_EACH(fio___http2_smap, &s->streams, pos) {
+      if (count < FIO_HTTP2_MAX_STREAMS)
+        ary[count++] = pos.value;
+    }
+    for (size_t i = 0; i < count; ++i)
+      fio___http2_stream_remove(s, ary[i]);
+    fio___http2_free(s);
+    c->state.h2.session = NULL;
+  }
+  fio___http_on_close(buf, udata);
+}
 
-  if (!c->io)
-    goto no_io;
+/* *****************************************************************************
+HTTP/2 Controller (stream state is only updated by the IO thread)
+***************************************************************************** */
 
-  if (fio_io_is_open(c->io)) {
-    /* TODO: test for connection:close header and h->status values */
-    fio___http1_process_data(c->io, c);
-  }
-  if (!c->suspend)
-    fio_io_unsuspend(c->io);
-  fio_io_free(c->io);
-  return;
+/** Appends a header to the snapshot: [u32 name len][u32 value len]name value */
+FIO_SFUNC int fio___http2_header_snapshot(fio_http_s *h,
+                                          fio_str_info_s name,
+                                          fio_str_info_s value,
+                                          void *udata) {
+  char **dest = (char **)udata;
+  const size_t pos = fio_bstr_len(*dest);
+  char *n;
+  if (!name.len)
+    return 0;
+  *dest = fio_bstr_reserve(*dest, name.len + value.len + 8);
+  n = *dest + pos + 8;
+  for (size_t i = 0; i < name.len; ++i) /* HTTP/2 requires lower case */
+    n[i] = (char)((uint8_t)name.buf[i] |
+                  ((uint8_t)((uint8_t)(name.buf[i] - 'A') < 26) << 5));
+  if (fio___http2_is_connection_header(FIO_STR_INFO2(n, name.len)))
+    return 0;
+  fio_u2buf32u(*dest + pos, (uint32_t)name.len);
+  fio_u2buf32u(*dest + pos + 4, (uint32_t)value.len);
+  if (value.len)
+    FIO_MEMCPY(n + name.len, value.buf, value.len);
+  *dest = fio_bstr_len_set(*dest, pos + name.len + value.len + 8);
+  (void)h;
+  return 0;
+}
 
-upgraded:
-  if (c->h || !fio_io_is_open(c->io))
-    goto something_is_wrong;
-  c->h = (fio_http_s *)upgraded;
-  { /* TODO! test if safe to move to user thread for callback execution? */
-    const size_t pr_i = fio_http_is_websocket(c->h) ? FIO___HTTP_PROTOCOL_WS
-                                                    : FIO___HTTP_PROTOCOL_SSE;
-    fio_http_controller_set(
-        c->h,
-        &(FIO_PTR_FROM_FIELD(fio___http_protocol_s, settings, c->settings)
-              ->state[pr_i]
-              .controller));
-    fio_io_protocol_set(
-        c->io,
-        &(FIO_PTR_FROM_FIELD(fio___http_protocol_s, settings, c->settings)
-              ->state[pr_i]
-              .protocol));
-    if (pr_i == FIO___HTTP_PROTOCOL_SSE) {
-      fio_str_info_s last_id =
-          fio_http_request_header(c->h,
-                                  FIO_STR_INFO2((char *)"last-event-id", 13),
-                                  0);
-      if (last_id.buf)
-        c->settings->on_eventsource_reconnect(c->h, FIO_STR2BUF_INFO(last_id));
-    }
+FIO_SFUNC void fio___http2_send_headers_task(void *c_, void *hdr_) {
+  fio___http_connection_s *c = (fio___http_connection_s *)c_;
+  fio___http2_s *s = c->state.h2.session;
+  if (!s || !s->io || c->state.h2.hdr ||
+      (c->state.h2.flags &
+       (FIO___HTTP2_S_LOCAL_CLOSED | FIO___HTTP2_S_HEADERS_SENT))) {
+    fio_bstr_free((char *)hdr_);
+    goto done;
   }
-  fio_io_unsuspend(c->io);
-  fio_io_free(c->io);
-  return;
+  c->state.h2.hdr = (char *)hdr_;
+  fio___http2_stream_activate(s, c);
+done:
+  fio___http_connection_free(c);
+}
 
-something_is_wrong:
-  if (fio_io_is_open(c->io))
-    FIO_LOG_DEBUG2("(%d) Connection upgrade went wrong for fd %d - closing",
-                   fio_io_pid(),
-                   fio_io_fd(c->io));
-  fio_io_protocol_set(c->io, NULL); /* make zombie, timeout will clear it. */
-  fio_io_free(c->io);
-/* fall through */
-no_io:
-  fio___http_connection_free(c); /* free HTTP connection element */
+/** Informs the controller that response headers must be sent. */
+FIO_SFUNC void fio___http2_send_headers(fio_http_s *h) {
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  size_t status = fio_http_status(h);
+  char *hdr = NULL;
+  char buf[3];
+  if (status < 100 || status > 999)
+    status = 500;
+  buf[0] = (char)('0' + (status / 100));
+  buf[1] = (char)('0' + ((status / 10) % 10));
+  buf[2] = (char)('0' + (status % 10));
+  /* headers are snapshot here, `h` may be freed before the IO thread runs */
+  fio___http2_header_snapshot(h,
+                              FIO_STR_INFO2((char *)":status", 7),
+                              FIO_STR_INFO2(buf, 3),
+                              &hdr);
+  fio_http_response_header_each(h, fio___http2_header_snapshot, &hdr);
+  fio_http_set_cookie_each(h, fio___http2_header_snapshot, &hdr);
+  fio_io_defer(fio___http2_send_headers_task,
+               (void *)fio___http_connection_dup(c),
+               (void *)hdr);
 }
 
-/** called once a request / response had finished */
-FIO_SFUNC void fio___http_controller_http1_on_finish(fio_http_s *h) {
+FIO_SFUNC void fio___http2_write_body_task(void *c_, void *packet_) {
+  fio___http_connection_s *c = (fio___http_connection_s *)c_;
+  fio___http2_s *s = c->state.h2.session;
+  fio_stream_packet_s *packet = (fio_stream_packet_s *)packet_;
+  if (!s || !s->io ||
+      (c->state.h2.flags &
+       (FIO___HTTP2_S_LOCAL_CLOSED | FIO___HTTP2_S_FINISHED))) {
+    fio_stream_pack_free(packet);
+    goto done;
+  }
+  fio_stream_add(&c->state.h2.out, packet);
+  fio___http2_stream_activate(s, c);
+done:
+  fio___http_connection_free(c);
+}
+
+/** Called by the HTTP handle for each body chunk (DATA frames). */
+FIO_SFUNC void fio___http2_write_body(fio_http_s *h,
+                                      fio_http_write_args_s args) {
   fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
-  if (c->state.http.buf.len) {
-    if (fio_http_is_streaming(h))
-      fio_string_write(&c->state.http.buf, FIO_STRING_REALLOC, "0\r\n\r\n", 5);
-    fio_io_write2(c->io,
-                  .buf = (void *)c->state.http.buf.buf,
-                  .len = c->state.http.buf.len,
-                  .dealloc = FIO_STRING_FREE);
-    c->state.http.buf = FIO_STR_INFO0;
-  } else {
-    if (fio_http_is_streaming(h))
-      fio_io_write2(c->io, .buf = (char *)"0\r\n\r\n", .len = 5, .copy = 1);
+  fio_stream_packet_s *packet = NULL;
+  if (args.buf)
+    packet = fio_stream_pack_data((void *)args.buf,
+                                  args.len,
+                                  args.offset,
+                                  (uint8_t)args.copy,
+                                  args.dealloc);
+  else if ((uint32_t)(args.fd + 1) > 1U)
+    packet =
+        fio_stream_pack_fd(args.fd, args.len, args.offset, (uint8_t)args.copy);
+  if (!packet)
+    return;
+  fio_io_defer(fio___http2_write_body_task,
+               (void *)fio___http_connection_dup(c),
+               (void *)packet);
+}
+
+FIO_SFUNC void fio___http2_on_finish_task(void *c_, void *ignr_) {
+  fio___http_connection_s *c = (fio___http_connection_s *)c_;
+  fio___http2_s *s = c->state.h2.session;
+  if (s && s->io && !(c->state.h2.flags & FIO___HTTP2_S_LOCAL_CLOSED)) {
+    c->state.h2.flags |= FIO___HTTP2_S_FINISHED;
+    fio___http2_stream_activate(s, c);
   }
+  fio___http_connection_free(c);
+  (void)ignr_;
+}
+
+/** Called once a response had finished (END_STREAM). */
+FIO_SFUNC void fio___http2_on_finish(fio_http_s *h) {
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
   if (c->log)
     fio_http_write_log(h);
-  if (fio_http_is_upgraded(h))
-    goto upgraded;
-  /* once the function returns, `h` may be freed (auto-finish on free).
-   * so we must call this callback here (sync), no matter the thread */
-  c->state.http.on_finish(h);
-  fio_io_defer(fio___http_controller_http1_on_finish_task, (void *)(c), NULL);
-  return;
-
-upgraded:
-  fio_io_defer(fio___http_controller_http1_on_finish_task,
-               (void *)(c),
-               (void *)h);
+  /* once the function returns, `h` may be freed (auto-finish on free). */
+  c->settings->on_finish(h);
+  fio_io_defer(fio___http2_on_finish_task,
+               (void *)fio___http_connection_dup(c),
+               NULL);
 }
 
-/* *****************************************************************************
-HTTP/2 Protocol (disconnect, as HTTP/2 is unsupported)
-***************************************************************************** */
+FIO_SFUNC void fio___http2_on_destroyed_task(void *c_, void *ignr_) {
+  fio___http_connection_free((fio___http_connection_s *)c_);
+  (void)ignr_;
+}
 
-// /** Called when an IO is attached to a protocol. */
-// void (*on_attach)(fio_io_s *io);
-// /** Called when a data is available. */
-// void (*on_data)(fio_io_s *io);
-// /** called once all pending `fio_io_write` calls are finished. */
-// void (*on_ready)(fio_io_s *io);
-// /** Called after the connection was closed, and pending tasks
-// completed.
-// */ void (*on_close)(void *udata);
+/** Called when an HTTP handle is freed (auto-finishes the response). */
+FIO_SFUNC void fio___http2_on_destroyed(fio_http_s *h) {
+  if (!(fio_http_is_upgraded(h) | fio_http_is_finished(h))) {
+    if (!fio_http_status(h))
+      fio_http_status_set(h, 500); /* ignored if headers already sent */
+    fio_http_write_args_s args = {.finish = 1};
+    fio_http_write FIO_NOOP(h, args);
+  }
+  fio_queue_push(fio_io_queue(),
+                 fio___http2_on_destroyed_task,
+                 fio_http_cdata(h));
+}
 
-/* *****************************************************************************
-HTTP/2 Controller (TODO!)
-***************************************************************************** */
+FIO_SFUNC void fio___http2_close_io_task(void *c_, void *ignr_) {
+  fio___http_connection_s *c = (fio___http_connection_s *)c_;
+  fio___http2_s *s = c->state.h2.session;
+  if (s && s->io && !(c->state.h2.flags & FIO___HTTP2_S_FINISHED)) {
+    fio___http2_stream_reset(s, c, FIO___HTTP2_CANCEL);
+    fio___http2_schedule(s);
+  }
+  fio___http_connection_free(c);
+  (void)ignr_;
+}
 
-// /** Called when an HTTP handle is freed. */
-// void (*on_destroyed)(fio_http_s *h, void *cdata);
-// /** Informs the controller that request / response headers must be
-// sent.
-// */ void (*send_headers)(fio_http_s *h);
-// /** called by the HTTP handle for each body chunk (or to finish a
-// response.
-// */ void (*write_body)(fio_http_s *h, fio_http_write_args_s args);
-// /** called once a request / response had finished */
-// void (*on_finish)(fio_http_s *h);
+/** Closes (cancels) the stream, the connection remains open. */
+FIO_SFUNC void fio___http2_close_io(fio_http_s *h) {
+  fio_io_defer(fio___http2_close_io_task,
+               (void *)fio___http_connection_dup(
+                   (fio___http_connection_s *)fio_http_cdata(h)),
+               NULL);
+}
 
 /* *****************************************************************************
 Authentication Helper
@@ -1799,9 +5586,19 @@ FIO_SFUNC fio_buf_info_s fio_websocket_write_partial(void *udata,
 FIO_SFUNC fio_buf_info_s fio_websocket_decompress(void *udata,
                                                   fio_buf_info_s msg) {
   fio___http_connection_s *c = (fio___http_connection_s *)udata;
-  FIO_LOG_ERROR("WebSocket permessage-deflate not yet implemented!");
-  (void)c;
-  return msg;
+#if HAVE_ZLIB
+  char *r;
+  if (c->state.ws.deflate.rx_bits && (r = fio___http_ws_deflate_read(c, msg))) {
+    fio_bstr_free(c->state.ws.msg);
+    c->state.ws.msg = r;
+    return fio_bstr_buf(r);
+  }
+#endif
+  FIO_LOG_DDEBUG2("(%d) WebSocket message decompression failed for %p",
+                  fio_io_pid(),
+                  c->io);
+  (void)c, (void)msg;
+  return (fio_buf_info_s){0};
 }
 
 /** Called when a `ping` message was received. */
@@ -1945,6 +5742,7 @@ FIO_SFUNC void fio___websocket_on_attach(fio_io_s *io) {
       .on_ready = c->settings->on_ready,
       .parser = {.must_mask = !c->is_client},
   };
+  fio___http_ws_deflate_setup(c);
   c->settings->on_open(h);
   fio___websocket_process_data(io, c);
 }
@@ -1957,6 +5755,7 @@ FIO_SFUNC void fio___websocket_on_close(void *buf, void *udata) {
   fio___http_connection_s *c = (fio___http_connection_s *)udata;
   c->io = NULL;
   fio_bstr_free(c->state.ws.msg);
+  fio___http_ws_deflate_destroy(&c->state.ws.deflate);
   if (c->h) {
     fio_http_status_set(c->h, (size_t)(c->state.ws.code));
     c->settings->on_close(c->h);
@@ -1988,48 +5787,11 @@ SFUNC int fio_http_on_message_set(fio_http_s *h,
 }
 
 /* *****************************************************************************
-WebSocket Writing / Subscription Helpers
-***************************************************************************** */
-
-FIO_IFUNC void fio___http_websocket_subscribe_imp(fio_msg_s *msg,
-                                                  uint8_t is_text) {
-  fio___http_connection_s *c = (fio___http_connection_s *)fio_io_udata(msg->io);
-  if (!c)
-    return;
-  fio_http_websocket_write(c->h, msg->message.buf, msg->message.len, is_text);
-}
-
-/** Optional WebSocket subscription callback - all messages are UTF-8 valid. */
-SFUNC void FIO_HTTP_WEBSOCKET_SUBSCRIBE_DIRECT_TEXT(fio_msg_s *msg) {
-  fio___http_websocket_subscribe_imp(msg, 1);
-}
-/** Optional WebSocket subscription callback - messages may be non-UTF-8. */
-SFUNC void FIO_HTTP_WEBSOCKET_SUBSCRIBE_DIRECT_BINARY(fio_msg_s *msg) {
-  fio___http_websocket_subscribe_imp(msg, 0);
-}
-
-/** Optional WebSocket subscription callback. */
-SFUNC void FIO_HTTP_WEBSOCKET_SUBSCRIBE_DIRECT(fio_msg_s *msg) {
-  ((msg->message.len < FIO_HTTP_WEBSOCKET_WRITE_VALIDITY_TEST_LIMIT) &&
-           (fio_string_utf8_valid(
-               FIO_STR_INFO2((char *)msg->message.buf, msg->message.len)))
-       ? FIO_HTTP_WEBSOCKET_SUBSCRIBE_DIRECT_TEXT
-       : FIO_HTTP_WEBSOCKET_SUBSCRIBE_DIRECT_BINARY)(msg);
-}
-
-/* *****************************************************************************
-EventSource (SSE) Helpers - HTTP Upgraded Connections
+Pub/Sub Shared Frames (encoded once per message, written by every subscriber)
 ***************************************************************************** */
 
-void fio_http_sse_write___(void); /* IDE Marker */
-/** Writes an SSE message (UTF-8). Fails if connection wasn't upgraded yet. */
-SFUNC int fio_http_sse_write FIO_NOOP(fio_http_s *h,
-                                      fio_http_sse_write_args_s args) {
-  if (!args.data.len || !h || !fio_http_is_sse(h))
-    return -1;
-  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
-  if (!c || !c->io)
-    return -1;
+/** Formats an SSE event as a `fio_bstr` (without writing it anywhere). */
+FIO_SFUNC char *fio___http_sse_payload(fio_http_sse_write_args_s args) {
   char *payload =
       fio_bstr_reserve(NULL, args.id.len + args.event.len + args.data.len + 22);
   if (args.id.len)
@@ -2067,6 +5829,185 @@ SFUNC int fio_http_sse_write FIO_NOOP(fio_http_s *h,
                         FIO_STRING_WRITE_STR2("\r\n", 2));
   /* event ends on empty line */
   payload = fio_bstr_write(payload, "\r\n", 2);
+  return payload;
+}
+
+typedef enum {
+  FIO___HTTP_MSG_FRAME_WS_TEXT = 0,
+  FIO___HTTP_MSG_FRAME_WS_BINARY,
+  FIO___HTTP_MSG_FRAME_WS_TEXT_DEFLATE, /* (no context takeover) */
+  FIO___HTTP_MSG_FRAME_WS_BINARY_DEFLATE,
+  FIO___HTTP_MSG_FRAME_SSE,
+  FIO___HTTP_MSG_FRAME_COUNT,
+} fio___http_msg_frame_e;
+
+/**
+ * Message metadata: server side frames, built lazily (on first use) and shared
+ * (using the `fio_bstr` reference count) by all the subscribed connections.
+ *
+ * Client connections mask their frames and can't share them. Compressed frames
+ * are shared only by connections that reset the compression context for every
+ * message and allow (at least) the window size used to compress them.
+ */
+typedef struct {
+  char *frame[FIO___HTTP_MSG_FRAME_COUNT];
+  FIO___LOCK_TYPE lock;
+  uint8_t utf8; /* 0 == untested; 1 == valid UTF-8; 2 == binary (or long) */
+  uint8_t deflate_bits[2]; /* window bits used for the compressed frames */
+} fio___http_msg_metadata_s;
+
+FIO_LEAK_COUNTER_DEF(fio___http_msg_metadata_s)
+
+FIO_SFUNC void *fio___http_msg_metadata_build(fio_msg_s *msg) {
+  (void)msg; /* frames are built lazily, only if a connection requires them */
+  fio___http_msg_metadata_s *m =
+      (fio___http_msg_metadata_s *)FIO_MEM_REALLOC_(NULL, 0, sizeof(*m), 0);
+  if (!m)
+    return m;
+  FIO_LEAK_COUNTER_ON_ALLOC(fio___http_msg_metadata_s);
+  *m = (fio___http_msg_metadata_s){.lock = FIO___LOCK_INIT};
+  return (void *)m;
+}
+
+FIO_SFUNC void fio___http_msg_metadata_free(void *m_) {
+  fio___http_msg_metadata_s *m = (fio___http_msg_metadata_s *)m_;
+  if (!m)
+    return;
+  for (size_t i = 0; i < FIO___HTTP_MSG_FRAME_COUNT; ++i)
+    fio_bstr_free(m->frame[i]);
+  FIO___LOCK_DESTROY(m->lock);
+  FIO_LEAK_COUNTER_ON_FREE(fio___http_msg_metadata_s);
+  FIO_MEM_FREE_(m, sizeof(*m));
+}
+
+/* Tests (once per message) if the message should be sent as a text frame. */
+FIO_SFUNC uint8_t fio___http_msg_is_utf8(fio_msg_s *msg) {
+  fio___http_msg_metadata_s *m = (fio___http_msg_metadata_s *)
+      fio_message_metadata(msg, fio___http_msg_metadata_build);
+  uint8_t r = (m ? m->utf8 : 0);
+  if (r)
+    return (r == 1);
+  r = (msg->message.len < FIO_HTTP_WEBSOCKET_WRITE_VALIDITY_TEST_LIMIT) &&
+      fio_string_utf8_valid(
+          FIO_STR_INFO2((char *)msg->message.buf, msg->message.len));
+  if (m)
+    m->utf8 = 2 - r; /* idempotent, a race would write the same value */
+  return r;
+}
+
+/* Returns a shared (copy on write) frame for the message, or NULL. */
+FIO_SFUNC char *fio___http_msg_frame(fio_msg_s *msg,
+                                     fio___http_msg_frame_e t,
+                                     uint8_t deflate_bits) {
+  char *r = NULL;
+  fio___http_msg_metadata_s *m = (fio___http_msg_metadata_s *)
+      fio_message_metadata(msg, fio___http_msg_metadata_build);
+  if (!m)
+    return NULL;
+  FIO___LOCK_LOCK(m->lock);
+  if (!m->frame[t]) {
+    if (t == FIO___HTTP_MSG_FRAME_SSE) {
+      FIO_STR_INFO_TMP_VAR(id_str, 64);
+      fio_string_write_hex(&id_str, NULL, msg->id);
+      m->frame[t] = fio___http_sse_payload(
+          (fio_http_sse_write_args_s){.id = FIO_STR2BUF_INFO(id_str),
+                                      .event = FIO_STR2BUF_INFO(msg->channel),
+                                      .data = FIO_STR2BUF_INFO(msg->message)});
+#if HAVE_ZLIB
+    } else if ((t & FIO___HTTP_MSG_FRAME_WS_TEXT_DEFLATE)) {
+      fio___http_zstream_s *z = fio___http_zstream_new(0, deflate_bits);
+      if (z)
+        m->frame[t] = fio___http_ws_deflate_frame(&z->z,
+                                                  msg->message.buf,
+                                                  msg->message.len,
+                                                  (unsigned char)(1 + (t & 1)),
+                                                  0);
+      fio___http_zstream_free(z);
+      m->deflate_bits[t & 1] = deflate_bits;
+#endif
+    } else {
+      /* opcode: 1 == text, 2 == binary */
+      const unsigned char opcode = 1 + (t == FIO___HTTP_MSG_FRAME_WS_BINARY);
+      char *f =
+          fio_bstr_reserve(NULL, fio_websocket_wrapped_len(msg->message.len));
+      m->frame[t] = fio_bstr_len_set(f,
+                                     fio_websocket_server_wrap(f,
+                                                               msg->message.buf,
+                                                               msg->message.len,
+                                                               opcode,
+                                                               1,
+                                                               1,
+                                                               0));
+    }
+  }
+  if (!(t & FIO___HTTP_MSG_FRAME_WS_TEXT_DEFLATE) ||
+      m->deflate_bits[t & 1] <= deflate_bits) /* a smaller window is valid */
+    r = fio_bstr_copy(m->frame[t]);
+  FIO___LOCK_UNLOCK(m->lock);
+  return r;
+}
+
+/* *****************************************************************************
+WebSocket Writing / Subscription Helpers
+***************************************************************************** */
+
+FIO_IFUNC void fio___http_websocket_subscribe_imp(fio_msg_s *msg,
+                                                  uint8_t is_text) {
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_io_udata(msg->io);
+  fio___http_msg_frame_e t =
+      (is_text ? FIO___HTTP_MSG_FRAME_WS_TEXT : FIO___HTTP_MSG_FRAME_WS_BINARY);
+  uint8_t bits = 0;
+  char *frame;
+  if (!c || !c->h || !fio_http_is_websocket(c->h))
+    return;
+  uint8_t shared = !c->is_client;
+#if HAVE_ZLIB
+  if (c->state.ws.deflate.tx_bits &&
+      msg->message.len >= c->state.ws.deflate.min) {
+    /* with context takeover, every connection compresses its own messages */
+    shared &= c->state.ws.deflate.tx_reset;
+    bits = c->state.ws.deflate.tx_bits;
+    t = (fio___http_msg_frame_e)(t | FIO___HTTP_MSG_FRAME_WS_TEXT_DEFLATE);
+  }
+#endif
+  if (shared && (frame = fio___http_msg_frame(msg, t, bits))) {
+    fio_io_write2(c->io,
+                  .buf = frame,
+                  .len = fio_bstr_len(frame),
+                  .dealloc = (void (*)(void *))fio_bstr_free);
+    return;
+  }
+  fio_http_websocket_write(c->h, msg->message.buf, msg->message.len, is_text);
+}
+
+/** Optional WebSocket subscription callback - all messages are UTF-8 valid. */
+SFUNC void FIO_HTTP_WEBSOCKET_SUBSCRIBE_DIRECT_TEXT(fio_msg_s *msg) {
+  fio___http_websocket_subscribe_imp(msg, 1);
+}
+/** Optional WebSocket subscription callback - messages may be non-UTF-8. */
+SFUNC void FIO_HTTP_WEBSOCKET_SUBSCRIBE_DIRECT_BINARY(fio_msg_s *msg) {
+  fio___http_websocket_subscribe_imp(msg, 0);
+}
+
+/** Optional WebSocket subscription callback. */
+SFUNC void FIO_HTTP_WEBSOCKET_SUBSCRIBE_DIRECT(fio_msg_s *msg) {
+  fio___http_websocket_subscribe_imp(msg, fio___http_msg_is_utf8(msg));
+}
+
+/* *****************************************************************************
+EventSource (SSE) Helpers - HTTP Upgraded Connections
+***************************************************************************** */
+
+void fio_http_sse_write___(void); /* IDE Marker */
+/** Writes an SSE message (UTF-8). Fails if connection wasn't upgraded yet. */
+SFUNC int fio_http_sse_write FIO_NOOP(fio_http_s *h,
+                                      fio_http_sse_write_args_s args) {
+  if (!args.data.len || !h || !fio_http_is_sse(h))
+    return -1;
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  if (!c || !c->io)
+    return -1;
+  char *payload = fio___http_sse_payload(args);
   fio_io_write2(c->io,
                 .buf = payload,
                 .len = fio_bstr_len(payload),
@@ -2077,8 +6018,16 @@ SFUNC int fio_http_sse_write FIO_NOOP(fio_http_s *h,
 /** Optional EventSource subscription callback - messages MUST be UTF-8. */
 SFUNC void FIO_HTTP_SSE_SUBSCRIBE_DIRECT(fio_msg_s *msg) {
   fio___http_connection_s *c = (fio___http_connection_s *)fio_io_udata(msg->io);
-  if (!c)
+  char *frame;
+  if (!c || !c->io || !c->h || !fio_http_is_sse(c->h) || !msg->message.len)
+    return;
+  if ((frame = fio___http_msg_frame(msg, FIO___HTTP_MSG_FRAME_SSE, 0))) {
+    fio_io_write2(c->io,
+                  .buf = frame,
+                  .len = fio_bstr_len(frame),
+                  .dealloc = (void (*)(void *))fio_bstr_free);
     return;
+  }
   FIO_STR_INFO_TMP_VAR(id_str, 64);
   fio_string_write_hex(&id_str, NULL, msg->id);
   fio_http_sse_write(c->h,
@@ -2102,6 +6051,11 @@ SFUNC int fio_http_websocket_write(fio_http_s *h,
     return -1;
   is_text = (!!is_text);
   is_text |= (!is_text) << 1;
+#if HAVE_ZLIB
+  if (c->state.ws.deflate.tx_bits && len >= c->state.ws.deflate.min &&
+      !fio___http_ws_deflate_write(c, buf, len, is_text))
+    return 0 - !fio_io_is_open(c->io);
+#endif
   uint8_t rsv = 0;
   if (len < 512) { /* fast-path: no allocation, no compression */
     char tmp[520];
@@ -2112,9 +6066,6 @@ SFUNC int fio_http_websocket_write(fio_http_s *h,
     fio_io_write2(c->io, .buf = tmp, .len = wlen, .copy = 1);
     return 0;
   }
-#if HAVE_ZLIB /* TODO: compress? */
-  // if(c->state.ws.deflate) ;
-#endif
   char *payload =
       fio_bstr_reserve(NULL,
                        fio_websocket_wrapped_len(len) + (c->is_client << 2));
@@ -2370,6 +6321,10 @@ FIO_SFUNC void fio__http_controller_on_destroyed(fio_http_s *h) {
     fio_http_write FIO_NOOP(h, args);
   }
   fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  if (c->state.http.cache)
+    fio___http_cache_abandon(c, 0);
+  if (c->state.http.zip_type)
+    fio___http_zip_finish(c);
   if (c->state.http.buf.buf)
     FIO_STRING_FREE2(c->state.http.buf);
   c->state.http.buf = FIO_STR_INFO0;
@@ -2387,14 +6342,16 @@ FIO_SFUNC void fio__http_controller_on_destroyed2(fio_http_s *h) {
 
 /** Called when an HTTP handle is freed. */
 FIO_SFUNC void fio__http_controller_on_destroyed_client(fio_http_s *h) {
-  fio_queue_push(fio_io_queue(),
-                 fio___http_controller_on_destroyed_task,
-                 fio_http_cdata(h));
   fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
   c->state.http.on_finish(h);
   c->h = NULL;
-  if (c->io)
-    fio_io_close(c->io);
+  if (c->io) {
+    if (fio___http_pool_is_reusable(c, h))
+      fio___http_pool_release(c);
+    else
+      fio_io_close(c->io);
+  }
+  /* the IO object holds its own reference to the connection */
   fio_queue_push(fio_io_queue(), fio___http_controller_on_destroyed_task, c);
 }
 
@@ -2425,7 +6382,13 @@ fio___http_protocol_get(fio___http_protocol_selector_e s, int is_client) {
     }
     return r;
   case FIO___HTTP_PROTOCOL_HTTP2:
-    r = (fio_io_protocol_s){.on_close = fio___http_on_close};
+    r = (fio_io_protocol_s){
+        .on_attach = fio___http2_on_attach,
+        .on_data = fio___http2_on_data,
+        .on_ready = fio___http2_on_ready,
+        .on_close = fio___http2_on_close,
+        .on_shutdown = fio___http2_on_shutdown,
+    };
     return r;
   case FIO___HTTP_PROTOCOL_WS:
     r = (fio_io_protocol_s){
@@ -2496,8 +6459,11 @@ fio___http_controller_get(fio___http_protocol_selector_e s, int is_client) {
     return r;
   case FIO___HTTP_PROTOCOL_HTTP2:
     r = (fio_http_controller_s){
-        .on_destroyed = fio__http_controller_on_destroyed,
-        .close_io = fio___http_default_close,
+        .on_destroyed = fio___http2_on_destroyed,
+        .send_headers = fio___http2_send_headers,
+        .write_body = fio___http2_write_body,
+        .on_finish = fio___http2_on_finish,
+        .close_io = fio___http2_close_io,
         .get_fd = fio___http_controller_get_fd,
     };
     return r;
@@ -2552,6 +6518,8 @@ FIO_IFUNC fio___http_protocol_s *fio___http_protocol_init(
       (unsigned)s.timeout * 1000U;
   p->state[FIO___HTTP_PROTOCOL_HTTP1].protocol.timeout =
       (unsigned)s.timeout * 1000U;
+  p->state[FIO___HTTP_PROTOCOL_HTTP2].protocol.timeout =
+      (unsigned)s.timeout * 1000U;
   p->state[FIO___HTTP_PROTOCOL_NONE].protocol.timeout =
       (unsigned)s.timeout * 1000U;
   if (url) {
@@ -2559,9 +6527,10 @@ FIO_IFUNC fio___http_protocol_s *fio___http_protocol_init(
     s.tls = fio_io_tls_from_url(s.tls, u);
     if (s.tls) {
       s.tls = fio_io_tls_dup(s.tls);
-      /* fio_io_tls_alpn_add(s.tls, "h2", fio___http_on_select_h2); // not yet
-       */
-      // fio_io_tls_alpn_add(s.tls, "http/1.1", fio___http_on_select_h1);
+      if (!is_client) {
+        fio_io_tls_alpn_add(s.tls, "h2", fio___http_on_select_h2);
+        fio_io_tls_alpn_add(s.tls, "http/1.1", fio___http_on_select_h1);
+      }
       fio_io_functions_s tmp_fn = fio_io_tls_default_functions(NULL);
       if (!s.tls_io_func)
         s.tls_io_func = &tmp_fn;
@@ -2578,6 +6547,13 @@ FIO_IFUNC fio___http_protocol_s *fio___http_protocol_init(
                             : fio___http_on_http_direct;
   p->settings.public_folder.buf = p->public_folder_buf;
   p->queue = fio_io_queue();
+  p->cache = (!is_client && s.cache_ttl) ? fio___http_cache_new(&p->settings)
+                                         : NULL;
+  p->shared_frames = !fio_message_metadata_add(fio___http_msg_metadata_build,
+                                               fio___http_msg_metadata_free);
+  if (!p->shared_frames)
+    FIO_LOG_DEBUG2("(HTTP) pub/sub metadata store full, "
+                   "WebSocket / SSE broadcasts will not share frames");
 
   if (s.public_folder.len)
     FIO_MEMCPY(p->public_folder_buf, s.public_folder.buf, s.public_folder.len);
@@ -103,6 +103,13 @@ static int ary____test_was_destroyed = 0;
 #define FIO_MAP_VALUE   size_t
 #define FIO_MAP_TEST
 #include FIO_INCLUDE_FILE
+#define FIO_UMAP_NAME       umap___test_size_inc
+#define FIO_MEMORY_NAME     umap___test_size_inc_mem
+#define FIO_MAP_KEY         size_t
+#define FIO_MAP_VALUE       size_t
+#define FIO_MAP_INCREMENTAL 1
+#define FIO_MAP_TEST
+#include FIO_INCLUDE_FILE
 #define FIO_OMAP_NAME   omap___test_size_t
 #define FIO_MEMORY_NAME omap___test_size_t_mem
 #define FIO_MAP_KEY     size_t
@@ -51,6 +51,7 @@ FIO_SFUNC void FIO_NAME_TEST(stl, aton_speed)(void) {
     double (*fn)(char **);
   } to_test[] = {
       {.n = "fio_aton", .fn = fio___aton_float_wrapper},
+      {.n = "fio_atof", .fn = fio_atof},
       {.n = "strtod  ", .fn = fio___strtod_wrapper},
   };
   const char *floats[] = {
@@ -538,6 +539,159 @@ FIO_SFUNC void FIO_NAME_TEST(stl, atol)(void) {
   TEST_LTOA_DIGITS_BIN(0xFF00000000000000ULL, 64);
 #undef TEST_LTOA_DIGITS_BIN
 
+  fprintf(stderr, "* Testing fio_ftoa (shortest round-trip).\n");
+  {
+    struct {
+      double d;
+      const char *s;
+    } ftoa_examples[] = {
+        {0.0, "0.0"},
+        {-0.0, "-0.0"},
+        {1.0, "1.0"},
+        {-2.5, "-2.5"},
+        {0.1, "0.1"},
+        {0.3, "0.3"},
+        {1.0 / 3, "0.3333333333333333"},
+        {100.0, "100.0"},
+        {123456789.0, "123456789.0"},
+        {9007199254740993.0, "9007199254740992.0"},
+        {1e16, "10000000000000000.0"},
+        {1e17, "1e+17"},
+        {1e22, "1e+22"},
+        {1e23, "1e+23"},
+        {0.0001, "0.0001"},
+        {1.5e-5, "1.5e-5"},
+        {5e-324, "5e-324"},
+        {2.2250738585072014e-308, "2.2250738585072014e-308"},
+        {1.7976931348623157e308, "1.7976931348623157e+308"},
+    };
+    char buf[128];
+    for (size_t i = 0; i < sizeof(ftoa_examples) / sizeof(ftoa_examples[0]);
+         ++i) {
+      size_t len = fio_ftoa(buf, ftoa_examples[i].d, 10);
+      FIO_ASSERT(len == strlen(ftoa_examples[i].s) &&
+                     !memcmp(buf, ftoa_examples[i].s, len + 1),
+                 "fio_ftoa(%.17g) error: %s != %s",
+                 ftoa_examples[i].d,
+                 buf,
+                 ftoa_examples[i].s);
+    }
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    for (size_t i = 0; i < (FIO_ATOL_TEST_MAX >> 2); ++i) {
+      union {
+        uint64_t u;
+        double d;
+      } u1, u2;
+      seed = (seed * 6364136223846793005ULL) + 1442695040888963407ULL;
+      u1.u = seed ^ (seed >> 29);
+      if ((i & 1))
+        u1.d = (double)(u1.u >> 40) / 1000.0; /* short decimals */
+      if ((u1.u & FIO_MATH_DBL_EXPO_MASK) == FIO_MATH_DBL_EXPO_MASK)
+        continue; /* NaN / Infinity */
+      size_t len = fio_ftoa(buf, u1.d, 10);
+      char *end = buf;
+      u2.d = strtod(buf, &end);
+      FIO_ASSERT(u1.u == u2.u && end == buf + len,
+                 "fio_ftoa round-trip error: %.17g => %s",
+                 u1.d,
+                 buf);
+    }
+  }
+
+  fprintf(stderr, "* Testing fio_atof (correctly rounded base 10).\n");
+  {
+    const char *examples[] = {
+        "0.1",
+        "1e23",
+        "9007199254740993",
+        "9007199254740992.5",
+        "18446744073709551616",
+        "123456789012345678901234567890",
+        "0.000000000000000000000000000001",
+        "1.7976931348623157e308",
+        "1.7976931348623159e308",
+        "2.2250738585072011e-308",
+        "2.2250738585072012e-308",
+        "2.4703282292062327e-324",
+        "2.4703282292062328e-324",
+        "1.00000000000000011102230246251565404236316680908203124",
+        "1.00000000000000011102230246251565404236316680908203125",
+        "1.00000000000000011102230246251565404236316680908203126",
+        "5708990770823839207320493820740630171355185152001e-3",
+        "1e-400",
+        "1e400",
+        "3.e2",
+        ".5e1",
+    };
+    union {
+      uint64_t u;
+      double d;
+    } u1, u2;
+    char buf[1200];
+    for (size_t i = 0; i < sizeof(examples) / sizeof(examples[0]); ++i) {
+      char *p1 = (char *)examples[i], *p2 = (char *)examples[i];
+      u1.d = fio_atof(&p1);
+      u2.d = strtod(p2, &p2);
+      FIO_ASSERT(u1.u == u2.u && p1 == p2,
+                 "fio_atof(%s) error: %.17g != %.17g",
+                 examples[i],
+                 u1.d,
+                 u2.d);
+    }
+    /* the exact halfway point between zero and the smallest subnormal */
+    {
+      uint8_t digits[760] = {1};
+      size_t len = 1, pos = 0;
+      for (size_t i = 0; i < 1075; ++i) { /* 5^1075 */
+        unsigned carry = 0;
+        for (size_t j = 0; j < len; ++j) {
+          carry += digits[j] * 5U;
+          digits[j] = (uint8_t)(carry % 10);
+          carry /= 10;
+        }
+        if (carry)
+          digits[len++] = (uint8_t)carry;
+      }
+      buf[pos++] = '0';
+      buf[pos++] = '.';
+      for (size_t i = len; i < 1075; ++i)
+        buf[pos++] = '0';
+      while (len)
+        buf[pos++] = (char)('0' + digits[--len]);
+      buf[pos] = 0;
+      char *p1 = buf;
+      u1.d = fio_atof(&p1);
+      FIO_ASSERT(!u1.u && p1 == buf + pos,
+                 "fio_atof halfway tie should round to even (zero)");
+      FIO_MEMSET(buf + pos, '0', 40); /* beyond the significant digit limit */
+      buf[pos + 40] = '1';
+      buf[pos + 41] = 0;
+      p1 = buf;
+      u1.d = fio_atof(&p1);
+      FIO_ASSERT(u1.u == 1 && p1 == buf + pos + 41,
+                 "fio_atof above halfway should round up (smallest subnormal)");
+    }
+    uint64_t seed = 0x2545F4914F6CDD1DULL;
+    for (size_t i = 0; i < (FIO_ATOL_TEST_MAX >> 2); ++i) {
+      seed = (seed * 6364136223846793005ULL) + 1442695040888963407ULL;
+      u1.u = (seed ^ (seed >> 29)) & (~FIO_MATH_DBL_SIGN_MASK);
+      if ((u1.u & FIO_MATH_DBL_EXPO_MASK) == FIO_MATH_DBL_EXPO_MASK)
+        continue; /* NaN / Infinity */
+      if ((i & 1))
+        snprintf(buf, 64, "%.17g", u1.d);
+      else
+        snprintf(buf, 64, "%.*e", (int)(i & 15), u1.d);
+      char *p1 = buf, *p2 = buf;
+      u1.d = fio_atof(&p1);
+      u2.d = strtod(p2, &p2);
+      FIO_ASSERT(u1.u == u2.u && p1 == p2,
+                 "fio_atof(%s) error: %.17g != %.17g",
+                 buf,
+                 u1.d,
+                 u2.d);
+    }
+  }
+
   FIO_NAME_TEST(stl, atol_speed)("fio_atol/fio_ltoa", fio_atol, fio_ltoa);
   FIO_NAME_TEST(stl, atol_speed)
   ("fio_aton/fio_ltoa", fio_aton_wrapper, fio_ltoa);
@@ -52,6 +52,181 @@ FIO_SFUNC int FIO_NAME_TEST(stl, fiobj_task)(fiobj_each_s *e) {
   return 0;
 }
 
+/* writes random white space and (sometimes) a comment */
+FIO_SFUNC char *FIO_NAME_TEST(stl, fiobj_json_space)(char *d, int comments) {
+  static const char *cmt[] = {"/* comment \"*/", "// comment \"\n", "#\n"};
+  uint64_t r = fio_rand64();
+  for (size_t i = r & 3; i; --i)
+    d = fio_bstr_write(d, " \t\r\n" + ((r >> (i << 1)) & 3), 1);
+  if (comments && !((r >> 8) & 31)) {
+    const char *c = cmt[((r >> 16) & 0xFF) % 3];
+    d = fio_bstr_write(d, c, FIO_STRLEN(c));
+  }
+  return d;
+}
+
+/* writes a random string, with escapes, that might cross block boundaries */
+FIO_SFUNC char *FIO_NAME_TEST(stl, fiobj_json_string)(char *d) {
+  static const char *parts[] = {"a", "\\\"", "\\\\", "\\n", "\\u00e9", "{[,:]}",
+                                "\\\\\\\"", "//", "#", "/*", " ", "0123456789"};
+  uint64_t r = fio_rand64();
+  size_t len = (r & 7) ? (r & 15) : ((r >> 4) & 127);
+  d = fio_bstr_write(d, "\"", 1);
+  for (size_t i = 0; i < len; ++i) {
+    const char *p = parts[(fio_rand64() & 0xFF) % 12];
+    d = fio_bstr_write(d, p, FIO_STRLEN(p));
+  }
+  return fio_bstr_write(d, "\"", 1);
+}
+
+/* writes a random JSON value (collections have a limited nesting depth) */
+FIO_SFUNC char *FIO_NAME_TEST(stl, fiobj_json_value)(char *d, size_t depth) {
+  static const char *words[] = {"true",
+                                "false",
+                                "null",
+                                "Infinity",
+                                "-Infinity",
+                                "0x1F",
+                                "1e400",
+                                "-0.0",
+                                "12345678901234567890"};
+  char buf[32];
+  uint64_t r = fio_rand64();
+  d = FIO_NAME_TEST(stl, fiobj_json_space)(d, 1);
+  switch ((r & 0xFF) % (depth < 5 ? 9 : 5)) {
+  case 0:
+    return fio_bstr_write(d, buf, fio_ltoa(buf, (int64_t)(r >> 8) >> 20, 10));
+  case 1:
+    return fio_bstr_write(d, buf, fio_ftoa(buf, (double)(r >> 11) / 1e9, 10));
+  case 2: return FIO_NAME_TEST(stl, fiobj_json_string)(d);
+  case 3: {
+    const char *w = words[((r >> 8) & 0xFF) % 9];
+    return fio_bstr_write(d, w, FIO_STRLEN(w));
+  }
+  case 4: return FIO_NAME_TEST(stl, fiobj_json_string)(d);
+  case 5: /* fall through */
+  case 6: {
+    size_t count = (r >> 8) & 7;
+    d = fio_bstr_write(d, "[", 1);
+    for (size_t i = 0; i < count; ++i) {
+      if (i)
+        d = fio_bstr_write(FIO_NAME_TEST(stl, fiobj_json_space)(d, 0), ",", 1);
+      d = FIO_NAME_TEST(stl, fiobj_json_value)(d, depth + 1);
+    }
+    if (count && ((r >> 12) & 1))
+      d = fio_bstr_write(d, ",", 1); /* trailing comma */
+    return fio_bstr_write(FIO_NAME_TEST(stl, fiobj_json_space)(d, 0), "]", 1);
+  }
+  default: {
+    size_t count = (r >> 8) & 7;
+    d = fio_bstr_write(d, "{", 1);
+    for (size_t i = 0; i < count; ++i) {
+      if (i)
+        d = fio_bstr_write(FIO_NAME_TEST(stl, fiobj_json_space)(d, 0), ",", 1);
+      d = FIO_NAME_TEST(stl, fiobj_json_space)(d, 1);
+      d = fio_bstr_write(FIO_NAME_TEST(stl, fiobj_json_string)(d), ":", 1);
+      d = FIO_NAME_TEST(stl, fiobj_json_value)(d, depth + 1);
+    }
+    return fio_bstr_write(FIO_NAME_TEST(stl, fiobj_json_space)(d, 0), "}", 1);
+  }
+  }
+}
+
+/* collects the top-level values of a JSON stream in an Array (`udata`) */
+FIO_SFUNC void FIO_NAME_TEST(stl, fiobj_json_stream_on_json)(void *udata,
+                                                             void *value) {
+  FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), push)
+  ((FIOBJ)udata, (FIOBJ)value);
+}
+
+/* writes JSON to a stream in random sized chunks, returns -1 on error */
+FIO_SFUNC int FIO_NAME_TEST(stl, fiobj_json_stream_write)(fio_json_stream_s *s,
+                                                          const char *json,
+                                                          size_t len) {
+  int r = 0;
+  while (len) {
+    uint64_t rnd = fio_rand64();
+    size_t chunk = (rnd & 1) ? 1 : (size_t)((rnd >> 8) % 96) + 1;
+    if (chunk > len)
+      chunk = len;
+    r |= fio_json_stream_write(s, json, chunk);
+    json += chunk;
+    len -= chunk;
+  }
+  return r;
+}
+
+/* collects a single Hash Map element (`udata`) for a JSON path test */
+FIO_SFUNC int FIO_NAME_TEST(stl, fiobj_json_path_pick)(fiobj_each_s *e) {
+  ((FIOBJ *)e->udata)[0] = e->key;
+  ((FIOBJ *)e->udata)[1] = e->value;
+  return -1;
+}
+
+/* writes a random JSON path notation (mostly) addressing data in `o` */
+FIO_SFUNC char *FIO_NAME_TEST(stl, fiobj_json_path_notation)(char *d,
+                                                             FIOBJ o) {
+  for (size_t depth = 0; depth < 8; ++depth) {
+    uint64_t r = fio_rand64();
+    if (!(r & 7))
+      return d;
+    if (FIOBJ_TYPE_CLASS(o) == FIOBJ_T_ARRAY) {
+      char buf[32];
+      /* some of the indexes are out of range */
+      size_t i = (size_t)((r >> 8) %
+                          (FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY),
+                                    count)(o) +
+                           2));
+      d = fio_bstr_write(d, "[", 1);
+      d = fio_bstr_write(d, buf, fio_ltoa(buf, (int64_t)i, 10));
+      d = fio_bstr_write(d, "]", 1);
+      o = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), get)(o, (int64_t)i);
+    } else if (FIOBJ_TYPE_CLASS(o) == FIOBJ_T_HASH &&
+               FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), count)(o)) {
+      FIOBJ kv[2] = {FIOBJ_INVALID, FIOBJ_INVALID};
+      fiobj_each1(o,
+                  FIO_NAME_TEST(stl, fiobj_json_path_pick),
+                  kv,
+                  (int32_t)((r >> 8) %
+                            FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH),
+                                     count)(o)));
+      fio_str_info_s k = FIO_NAME2(fiobj, cstr)(kv[0]);
+      if (!k.len || memchr(k.buf, '.', k.len) || memchr(k.buf, '[', k.len))
+        return d; /* keys that can't be addressed using a compiled path */
+      if (fio_bstr_len(d))
+        d = fio_bstr_write(d, ".", 1);
+      d = fio_bstr_write(d, k.buf, k.len);
+      o = kv[1];
+    } else {
+      if ((r >> 8) & 1) { /* a missing key */
+        if (fio_bstr_len(d))
+          d = fio_bstr_write(d, ".", 1);
+        d = fio_bstr_write(d, "missing", 7);
+      }
+      return d;
+    }
+  }
+  return d;
+}
+
+#if FIO_JSON_USE_INDEX
+/* parses JSON using either the recursive or the structural index parser */
+FIO_SFUNC FIOBJ FIO_NAME_TEST(stl, fiobj_json_parse)(const char *json,
+                                                     size_t len,
+                                                     int indexed,
+                                                     size_t *stop_pos) {
+  fio___json_state_s s = {.cb = FIOBJ_JSON_PARSER_CALLBACKS,
+                          .pos = json,
+                          .end = json + len};
+  FIO_ASSERT(!fio___json_callbacks_validate(&s.cb), "JSON callbacks error");
+  void *r = indexed ? fio___json_consume_indexed(&s) : fio___json_consume(&s);
+  *stop_pos = (size_t)(s.pos - json);
+  if (s.error)
+    return (FIOBJ)s.cb.on_error(r);
+  return (FIOBJ)r;
+}
+#endif /* FIO_JSON_USE_INDEX */
+
 FIO_SFUNC void FIO_NAME_TEST(stl, fiobj)(void) {
   FIOBJ o = FIOBJ_INVALID;
   if (!FIOBJ_MARK_MEMORY_ENABLED) {
@@ -213,6 +388,538 @@ FIO_SFUNC void FIO_NAME_TEST(stl, fiobj)(void) {
     fiobj_free(j);
     o = FIOBJ_INVALID;
   }
+#if FIO_JSON_USE_INDEX
+  {
+    fprintf(stderr, "* Testing FIOBJ JSON structural index (two stages).\n");
+    for (size_t round = 0; round < 2048; ++round) {
+      char *json = FIO_NAME_TEST(stl, fiobj_json_value)(NULL, 0);
+      size_t len = fio_bstr_len(json);
+      size_t stop[2];
+      FIOBJ r[2];
+      json = fio_bstr_write(json, " ", 1);
+      r[0] = FIO_NAME_TEST(stl, fiobj_json_parse)(json, len + 1, 0, stop);
+      r[1] = FIO_NAME_TEST(stl, fiobj_json_parse)(json, len + 1, 1, stop + 1);
+      FIO_ASSERT(r[0] != FIOBJ_INVALID && r[1] != FIOBJ_INVALID,
+                 "JSON parsing failed (%d, %d) for:\n%s",
+                 (int)(r[0] != FIOBJ_INVALID),
+                 (int)(r[1] != FIOBJ_INVALID),
+                 json);
+      FIO_ASSERT(FIO_NAME_BL(fiobj, eq)(r[0], r[1]),
+                 "JSON structural index parsing error for:\n%s",
+                 json);
+      FIO_ASSERT(stop[0] == stop[1] && stop[1] == len,
+                 "JSON structural index stop position error %zu != %zu (%zu)",
+                 stop[1],
+                 stop[0],
+                 len);
+      fiobj_free(r[0]);
+      fiobj_free(r[1]);
+      /* truncated JSON - both parsers should fail (or succeed) */
+      len = (size_t)(fio_rand64() % len);
+      json = fio_bstr_len_set(json, len);
+      r[0] = FIO_NAME_TEST(stl, fiobj_json_parse)(json, len, 0, stop);
+      r[1] = FIO_NAME_TEST(stl, fiobj_json_parse)(json, len, 1, stop + 1);
+      FIO_ASSERT((r[0] == FIOBJ_INVALID) == (r[1] == FIOBJ_INVALID),
+                 "JSON structural index error handling for:\n%s",
+                 json);
+      FIO_ASSERT(FIO_NAME_BL(fiobj, eq)(r[0], r[1]),
+                 "JSON structural index parsing error for:\n%s",
+                 json);
+      fiobj_free(r[0]);
+      fiobj_free(r[1]);
+      fio_bstr_free(json);
+    }
+    /* long strings, escapes across block boundaries, errors */
+    for (size_t i = 0; i < 192; ++i) {
+      char *json = fio_bstr_write(NULL, "[\"", 2);
+      size_t stop;
+      for (size_t j = 0; j < i; ++j)
+        json = fio_bstr_write(json, "\\", 1);
+      json = fio_bstr_write(json, "\", 1, {\"a\":[]}]", 15);
+      o = FIO_NAME_TEST(stl, fiobj_json_parse)(json,
+                                               fio_bstr_len(json),
+                                               1,
+                                               &stop);
+      if ((i & 1)) { /* odd backslashes escape the quote, next string */
+        FIO_ASSERT(o == FIOBJ_INVALID,
+                   "JSON structural index should fail for:\n%s",
+                   json);
+      } else {
+        FIO_ASSERT(FIOBJ_TYPE(o) == FIOBJ_T_ARRAY &&
+                       FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY),
+                                count)(o) == 3 &&
+                       FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), len)(
+                           FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY),
+                                    get)(o, 0)) == (i >> 1) &&
+                       stop == fio_bstr_len(json),
+                   "JSON structural index backslash error (%zu) for:\n%s",
+                   i,
+                   json);
+      }
+      fiobj_free(o);
+      fio_bstr_free(json);
+    }
+    {
+      static const char *bad[] = {
+          "[1 2]",
+          "[1,,2]",
+          "{\"a\" 1}",
+          "{\"a\":1 \"b\":2}",
+          "{\"a\":}",
+          "[\"a]",
+          "[1x]",
+          "{[]:1}",
+          "[/* open",
+          "]",
+          "[tru]",
+          "[1,2",
+          "[\"\\\"]",
+      };
+      for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+        size_t stop;
+        o = FIO_NAME_TEST(stl, fiobj_json_parse)(bad[i],
+                                                 FIO_STRLEN(bad[i]),
+                                                 1,
+                                                 &stop);
+        FIO_ASSERT(o == FIOBJ_INVALID,
+                   "JSON structural index should fail for: %s",
+                   bad[i]);
+        fiobj_free(o);
+      }
+    }
+    o = FIOBJ_INVALID;
+  }
+#endif /* FIO_JSON_USE_INDEX */
+  {
+    fprintf(stderr, "* Testing FIOBJ JSON streaming (push) parser.\n");
+    FIOBJ results = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), new)();
+    fio_json_stream_s *s = fio_json_stream_new(
+        .callbacks = &FIOBJ_JSON_PARSER_CALLBACKS,
+        .on_json = FIO_NAME_TEST(stl, fiobj_json_stream_on_json),
+        .udata = (void *)results);
+    FIO_ASSERT(s, "fio_json_stream_new failed");
+    for (size_t round = 0; round < 1024; ++round) {
+      char *json = FIO_NAME_TEST(stl, fiobj_json_value)(NULL, 0);
+      size_t len = fio_bstr_len(json);
+      size_t stop;
+      int r = FIO_NAME_TEST(stl, fiobj_json_stream_write)(s, json, len);
+      r |= fio_json_stream_finish(s);
+      o = fiobj_json_parse2(json, len, NULL);
+      FIO_ASSERT(!r && o != FIOBJ_INVALID &&
+                     FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY),
+                              count)(results) == 1,
+                 "JSON stream parsing failed for:\n%s",
+                 json);
+      FIO_ASSERT(FIO_NAME_BL(fiobj, eq)(
+                     o,
+                     FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY),
+                              get)(results, 0)),
+                 "JSON stream parsing error for:\n%s",
+                 json);
+      fiobj_free(o);
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), destroy)(results);
+      /* truncated JSON - stream should fail (or succeed) as the parser does */
+      len = (size_t)(fio_rand64() % len);
+      json = fio_bstr_len_set(json, len);
+      r = FIO_NAME_TEST(stl, fiobj_json_stream_write)(s, json, len);
+      r |= fio_json_stream_finish(s);
+      o = fiobj_json_parse2(json, len, &stop);
+      /* the stream rejects trailing data the parser stops before (`-Inf|in`) */
+      FIO_ASSERT(r ? (o == FIOBJ_INVALID || stop < len)
+                   : FIO_NAME_BL(fiobj, eq)(
+                         o,
+                         FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY),
+                                  get)(results, 0)),
+                 "JSON stream error handling (%d) for:\n%.*s",
+                 r,
+                 (int)len,
+                 json);
+      fiobj_free(o);
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), destroy)(results);
+      fio_bstr_free(json);
+    }
+    fio_json_stream_free(s);
+    {
+      static const char *bad[] = {
+          "[1 2]",
+          "[1,,2]",
+          "{\"a\" 1}",
+          "{\"a\":1 \"b\":2}",
+          "{\"a\":}",
+          "[\"a]",
+          "[1x]",
+          "{[]:1}",
+          "[/* open",
+          "]",
+          "[tru]",
+          "[1,2",
+          "[\"\\\"]",
+          "[1]]",
+          "",
+          "[[[[[[[[1]]]]]]]]",
+          "[\"a token longer than 32 bytes, buffered\"]",
+      };
+      s = fio_json_stream_new(.callbacks = &FIOBJ_JSON_PARSER_CALLBACKS,
+                              .max_depth = 7,
+                              .max_token = 32);
+      for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+        int r = 0;
+        for (size_t j = 0; bad[i][j]; ++j) /* one byte at a time */
+          r |= fio_json_stream_write(s, bad[i] + j, 1);
+        r |= fio_json_stream_finish(s);
+        FIO_ASSERT(r == -1, "JSON stream should fail for: %s", bad[i]);
+      }
+      FIO_ASSERT(!fio_json_stream_write(s, "[[[[[[[1]]]]]]] ", 16) &&
+                     !fio_json_stream_finish(s),
+                 "JSON stream nesting limit error");
+      fio_json_stream_free(s);
+    }
+    /* NDJSON - one value per line, invalid lines are skipped */
+    s = fio_json_stream_new(.callbacks = &FIOBJ_JSON_PARSER_CALLBACKS,
+                            .on_json =
+                                FIO_NAME_TEST(stl, fiobj_json_stream_on_json),
+                            .udata = (void *)results,
+                            .ndjson = 1);
+    for (size_t round = 0; round < 64; ++round) {
+      FIOBJ expected = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), new)();
+      char *ndjson = NULL;
+      int r = 0;
+      for (size_t i = 0; i < 32; ++i) {
+        char *json = FIO_NAME_TEST(stl, fiobj_json_value)(NULL, 0);
+        if (FIO_MEMCHR(json, '\n', fio_bstr_len(json))) {
+          fio_bstr_free(json); /* values must fit on a single line */
+          continue;
+        }
+        if (!(fio_rand64() & 7)) { /* an invalid line (unterminated array) */
+          ndjson = fio_bstr_write(ndjson, "[1,", 3);
+          r = -1;
+        } else {
+          FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), push)
+          (expected, fiobj_json_parse2(json, fio_bstr_len(json), NULL));
+        }
+        ndjson = fio_bstr_write(ndjson, json, fio_bstr_len(json));
+        ndjson = fio_bstr_write(ndjson, "\r\n" + (i & 1), 2 - (i & 1));
+        fio_bstr_free(json);
+      }
+      FIO_ASSERT(FIO_NAME_TEST(stl, fiobj_json_stream_write)(
+                     s,
+                     ndjson,
+                     fio_bstr_len(ndjson)) == r &&
+                     !fio_json_stream_finish(s),
+                 "NDJSON stream error reporting for:\n%s",
+                 ndjson);
+      FIO_ASSERT(FIO_NAME_BL(fiobj, eq)(expected, results),
+                 "NDJSON stream parsing error for:\n%s",
+                 ndjson);
+      fiobj_free(expected);
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), destroy)(results);
+      fio_bstr_free(ndjson);
+    }
+    fio_json_stream_free(s);
+    fiobj_free(results);
+    o = FIOBJ_INVALID;
+  }
+  {
+    fprintf(stderr, "* Testing FIOBJ JSON arena documents.\n");
+    for (size_t round = 0; round < 1024; ++round) {
+      char *json = FIO_NAME_TEST(stl, fiobj_json_value)(NULL, 0);
+      size_t len = fio_bstr_len(json);
+      size_t stop[2];
+      FIOBJ r[2], tmp, expected;
+      r[0] = fiobj_json_parse(FIO_STR_INFO2(json, len), stop);
+      r[1] = fiobj_json_parse_arena(FIO_STR_INFO2(json, len), stop + 1);
+      FIO_ASSERT(r[0] != FIOBJ_INVALID && r[1] != FIOBJ_INVALID,
+                 "JSON arena parsing failed (%d, %d) for:\n%s",
+                 (int)(r[0] != FIOBJ_INVALID),
+                 (int)(r[1] != FIOBJ_INVALID),
+                 json);
+      FIO_ASSERT(FIO_NAME_BL(fiobj, eq)(r[0], r[1]) && stop[0] == stop[1],
+                 "JSON arena parsing error for:\n%s",
+                 json);
+      FIO_ASSERT(!FIO_NAME_BL(fiobj, arena)(r[0]),
+                 "fiobj_json_parse result shouldn't be arena backed");
+      /* a nested object escapes the arena when duplicated */
+      tmp = r[1];
+      expected = r[0];
+      while (FIOBJ_TYPE_CLASS(tmp) == FIOBJ_T_ARRAY &&
+             FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), count)(tmp)) {
+        tmp = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), get)(tmp, 0);
+        expected =
+            FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), get)(expected, 0);
+      }
+      if (tmp != r[1] && FIO_NAME_BL(fiobj, arena)(tmp)) {
+        FIOBJ cpy = fiobj_dup(tmp);
+        FIO_ASSERT(cpy != tmp && !FIO_NAME_BL(fiobj, arena)(cpy),
+                   "fiobj_dup should copy nested arena objects");
+        fiobj_free(tmp); /* no-op for nested arena objects */
+        fiobj_free(r[1]);
+        FIO_ASSERT(FIO_NAME_BL(fiobj, eq)(cpy, expected),
+                   "nested arena object copy error for:\n%s",
+                   json);
+        fiobj_free(cpy);
+      } else {
+        /* the root is reference counted */
+        FIO_ASSERT(fiobj_dup(r[1]) == r[1], "fiobj_dup(arena root) error");
+        fiobj_free(r[1]);
+        FIO_ASSERT(FIO_NAME_BL(fiobj, eq)(r[0], r[1]),
+                   "arena root released early");
+        fiobj_free(r[1]);
+      }
+      fiobj_free(r[0]);
+      /* truncated JSON - both parsers should fail (or succeed) */
+      len = (size_t)(fio_rand64() % len);
+      r[0] = fiobj_json_parse(FIO_STR_INFO2(json, len), stop);
+      r[1] = fiobj_json_parse_arena(FIO_STR_INFO2(json, len), stop + 1);
+      FIO_ASSERT((r[0] == FIOBJ_INVALID) == (r[1] == FIOBJ_INVALID) &&
+                     FIO_NAME_BL(fiobj, eq)(r[0], r[1]),
+                 "JSON arena error handling for:\n%.*s",
+                 (int)len,
+                 json);
+      fiobj_free(r[0]);
+      fiobj_free(r[1]);
+      fio_bstr_free(json);
+    }
+#if !defined(DEBUG) /* DEBUG builds assert (abort) on read-only mutations */
+    {
+      /* arena backed containers are read-only, mutators are no-ops */
+      char json[] = "{\"a\":[1,2,3],\"b\":{\"c\":[4],\"d\":5}}";
+      FIOBJ root = fiobj_json_parse_arena(FIO_STR_INFO2(json, sizeof(json) - 1),
+                                          NULL);
+      FIOBJ expected = fiobj_json_parse(FIO_STR_INFO2(json, sizeof(json) - 1),
+                                        NULL);
+      FIOBJ a =
+          FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), get2)(root, "a", 1);
+      FIOBJ b =
+          FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), get2)(root, "b", 1);
+      FIOBJ old = FIOBJ_INVALID;
+      int log_level = FIO_LOG_LEVEL_GET();
+      FIO_ASSERT(FIO_NAME_BL(fiobj, arena)(a) && FIO_NAME_BL(fiobj, arena)(b),
+                 "arena document nodes should be arena backed");
+      FIO_LOG_LEVEL_SET(FIO_LOG_LEVEL_NONE);
+      FIO_ASSERT(!FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), push)(
+                     a,
+                     FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING),
+                              new_cstr)("push", 4)),
+                 "fiobj_array_push should fail for arena nodes");
+      FIO_ASSERT(!FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), unshift)(
+                     a,
+                     FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING),
+                              new_cstr)("unshift", 7)),
+                 "fiobj_array_unshift should fail for arena nodes");
+      FIO_ASSERT(!FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), set)(
+                     a,
+                     0,
+                     FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING),
+                              new_cstr)("set", 3),
+                     &old) &&
+                     old == FIOBJ_INVALID,
+                 "fiobj_array_set should fail for arena nodes");
+      FIO_ASSERT(FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), pop)(a, &old) &&
+                     FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY),
+                              shift)(a, &old) &&
+                     FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY),
+                              remove)(a, 0, &old) &&
+                     !FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), remove2)(
+                         a,
+                         FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_NUMBER),
+                                  new)(1)) &&
+                     old == FIOBJ_INVALID,
+                 "Array removal should fail for arena nodes");
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), compact)(a);
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), reserve)(a, 64);
+      FIO_ASSERT(!FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), concat)(a, a),
+                 "fiobj_array_concat should fail for arena nodes");
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), set2)
+      (b,
+       "e",
+       1,
+       FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), new_cstr)("set2", 4));
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), set2)
+      (root, "a", 1, FIOBJ_INVALID);
+      FIO_ASSERT(FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH),
+                          remove2)(root, "b", 1, &old) &&
+                     old == FIOBJ_INVALID,
+                 "fiobj_hash_remove2 should fail for arena nodes");
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), evict)(b, 1);
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), clear)(b);
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), compact)(b);
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), reserve)(root, 1024);
+      FIO_LOG_LEVEL_SET(log_level);
+      FIO_ASSERT(FIO_NAME_BL(fiobj, eq)(root, expected),
+                 "arena document shouldn't be mutated");
+      FIO_ASSERT(FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_HASH), capa)(root) <
+                     1024,
+                 "arena document shouldn't be reallocated");
+      fiobj_free(expected);
+      fiobj_free(root);
+    }
+#endif
+  }
+  {
+    fprintf(stderr, "* Testing FIOBJ JSON compiled paths.\n");
+    static const char *bad[] = {"a..b", "[x]", "[1", "[1]x", "[]", "a[2]b"};
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i)
+      FIO_ASSERT(!fiobj_json_path_new2(bad[i], FIO_STRLEN(bad[i])),
+                 "fiobj_json_path_new should fail for %s",
+                 bad[i]);
+    for (size_t round = 0; round < 512; ++round) {
+      char *json = FIO_NAME_TEST(stl, fiobj_json_value)(NULL, 0);
+      size_t len = fio_bstr_len(json);
+      size_t stop[2], count = 1 + (fio_rand64() & 3), found = 0;
+      char *notations[4] = {NULL};
+      fio_str_info_s n[4];
+      FIOBJ expected[4], r[4];
+      o = fiobj_json_parse(FIO_STR_INFO2(json, len), stop);
+      FIO_ASSERT(o != FIOBJ_INVALID, "JSON parsing failed for:\n%s", json);
+      for (size_t i = 0; i < count; ++i) {
+        notations[i] = FIO_NAME_TEST(stl, fiobj_json_path_notation)(NULL, o);
+        n[i] = FIO_STR_INFO2(notations[i], fio_bstr_len(notations[i]));
+        expected[i] = fiobj_json_find(o, n[i]);
+        found += (expected[i] != FIOBJ_INVALID);
+      }
+      fiobj_json_path_s *path = fiobj_json_path_new(n, count);
+      FIO_ASSERT(path && fiobj_json_path_count(path) == count,
+                 "fiobj_json_path_new failed for %s",
+                 notations[0]);
+      FIO_ASSERT(fiobj_json_path_find(o, path) == expected[0],
+                 "fiobj_json_path_find error for %s in:\n%s",
+                 notations[0],
+                 json);
+      FIO_ASSERT(fiobj_json_path_find_all(o, path, r) == found,
+                 "fiobj_json_path_find_all count error for:\n%s",
+                 json);
+      for (size_t i = 0; i < count; ++i)
+        FIO_ASSERT(r[i] == expected[i],
+                   "fiobj_json_path_find_all error for %s in:\n%s",
+                   notations[i],
+                   json);
+      /* selective parsing */
+      FIO_ASSERT(fiobj_json_path_parse(path,
+                                       FIO_STR_INFO2(json, len),
+                                       r,
+                                       stop + 1) == found &&
+                     stop[0] == stop[1],
+                 "fiobj_json_path_parse count error for:\n%s",
+                 json);
+      for (size_t i = 0; i < count; ++i) {
+        FIO_ASSERT(FIO_NAME_BL(fiobj, eq)(r[i], expected[i]),
+                   "fiobj_json_path_parse error for %s in:\n%s",
+                   notations[i],
+                   json);
+        fiobj_free(r[i]);
+      }
+      fiobj_free(o);
+      /* truncated JSON - should fail (or succeed) like fiobj_json_parse */
+      len = (size_t)(fio_rand64() % len);
+      o = fiobj_json_parse(FIO_STR_INFO2(json, len), stop);
+      found = fiobj_json_path_parse(path, FIO_STR_INFO2(json, len), r, NULL);
+      FIO_ASSERT(o != FIOBJ_INVALID || !found,
+                 "fiobj_json_path_parse error handling for:\n%.*s",
+                 (int)len,
+                 json);
+      for (size_t i = 0; i < count; ++i) {
+        FIO_ASSERT(FIO_NAME_BL(fiobj, eq)(r[i], fiobj_json_find(o, n[i])),
+                   "fiobj_json_path_parse error for %s in:\n%.*s",
+                   notations[i],
+                   (int)len,
+                   json);
+        fiobj_free(r[i]);
+      }
+      fiobj_free(o);
+      fiobj_json_path_free(path);
+      for (size_t i = 0; i < count; ++i)
+        fio_bstr_free(notations[i]);
+      fio_bstr_free(json);
+    }
+    { /* duplicate keys - the last value wins */
+      char json[] = "{\"a\":{\"b\":1},\"a\":{\"c\":2}}";
+      fio_str_info_s n[2] = {FIO_STR_INFO1((char *)"a.b"),
+                             FIO_STR_INFO1((char *)"a.c")};
+      fiobj_json_path_s *path = fiobj_json_path_new(n, 2);
+      FIOBJ r[2];
+      FIO_ASSERT(fiobj_json_path_parse(path,
+                                       FIO_STR_INFO2(json, sizeof(json) - 1),
+                                       r,
+                                       NULL) == 1 &&
+                     r[0] == FIOBJ_INVALID && fiobj2i(r[1]) == 2,
+                 "fiobj_json_path_parse duplicate key error");
+      fiobj_free(r[1]);
+      fiobj_json_path_free(path);
+    }
+    o = FIOBJ_INVALID;
+  }
+  {
+    fprintf(stderr, "* Testing FIOBJ JSON output (fiobj_json_write).\n");
+    for (size_t round = 0; round < 4096; ++round) {
+      /* escaping must match fio_string_write_escape for any byte */
+      char raw[80];
+      size_t len = (size_t)(fio_rand64() % 80);
+      uint64_t r = fio_rand64();
+      for (size_t i = 0; i < len; ++i) {
+        if (!(i & 7))
+          r = fio_rand64();
+        raw[i] = (char)((r & 1) ? (r >> 8) : ((r >> 8) & 0x7F) | 0x20);
+        r >>= 8;
+      }
+      o = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), new_cstr)(raw, len);
+      FIOBJ json = fiobj2json(FIOBJ_INVALID, o, 0);
+      FIOBJ expected = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), new)();
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)(expected, "\"", 1);
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write_escape)
+      (expected, raw, len);
+      FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), write)(expected, "\"", 1);
+      FIO_ASSERT(FIO_NAME_BL(fiobj, eq)(json, expected),
+                 "JSON String escaping error:\n%s\n%s",
+                 FIO_NAME2(fiobj, cstr)(json).buf,
+                 FIO_NAME2(fiobj, cstr)(expected).buf);
+      FIO_ASSERT(fiobj_json_capa(o, 0) ==
+                     FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), len)(json) +
+                         1,
+                 "fiobj_json_capa String length error");
+      fiobj_free(expected);
+      fiobj_free(json);
+      fiobj_free(o);
+    }
+    for (size_t round = 0; round < 1024; ++round) {
+      char *src = FIO_NAME_TEST(stl, fiobj_json_value)(NULL, 0);
+      o = fiobj_json_parse(FIO_STR_INFO2(src, fio_bstr_len(src)), NULL);
+      for (uint8_t beautify = 0; beautify < 2; ++beautify) {
+        FIOBJ json = fiobj2json(FIOBJ_INVALID, o, beautify);
+        fio_str_info_s j = FIO_NAME2(fiobj, cstr)(json);
+        size_t capa = fiobj_json_capa(o, beautify);
+        char *buf = (char *)FIO_MEM_REALLOC(NULL, 0, capa, 0);
+        FIO_ASSERT_ALLOC(buf);
+        FIO_ASSERT(capa > j.len, "fiobj_json_capa too short");
+        FIO_ASSERT(fiobj_json_write(buf, o, beautify) == j.len &&
+                       !buf[j.len] && !FIO_MEMCMP(buf, j.buf, j.len),
+                   "fiobj_json_write error for:\n%s",
+                   j.buf);
+        FIO_MEM_FREE(buf, capa);
+        /* appending to an existing String */
+        FIOBJ tmp = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING), new_cstr)(
+            "JSON: ",
+            6);
+        FIO_ASSERT(fiobj2json(tmp, o, beautify) == tmp &&
+                       FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_STRING),
+                                len)(tmp) == j.len + 6 &&
+                       !FIO_MEMCMP(FIO_NAME2(fiobj, cstr)(tmp).buf + 6,
+                                   j.buf,
+                                   j.len),
+                   "fiobj2json append error for:\n%s",
+                   j.buf);
+        fiobj_free(tmp);
+        tmp = fiobj_json_parse(j, NULL);
+        FIO_ASSERT(FIO_NAME_BL(fiobj, eq)(o, tmp),
+                   "fiobj2json round-trip error for:\n%s",
+                   j.buf);
+        fiobj_free(tmp);
+        fiobj_free(json);
+      }
+      fiobj_free(o);
+      fio_bstr_free(src);
+    }
+    o = FIOBJ_INVALID;
+  }
   {
     fprintf(stderr, "* Testing FIOBJ array equality test (fiobj_is_eq).\n");
     FIOBJ a1 = FIO_NAME(FIO_NAME(fiobj, FIOBJ___NAME_ARRAY), new)();
@@ -26,6 +26,13 @@ Copyright and License: see header file (000 copyright.h) or top of file
 // #undef FIO___TEST_REINCLUDE
 // #endif
 
+/* collects access log batches into a fio_bstr */
+FIO_SFUNC void fio___test_http_log_on_write(fio_str_info_s lines,
+                                            void *udata) {
+  char **log = (char **)udata;
+  *log = fio_bstr_write(*log, lines.buf, lines.len);
+}
+
 FIO_SFUNC void FIO_NAME_TEST(stl, http_s)(void) {
   fprintf(stderr, "* Testing HTTP handle (fio_http_s).\n");
   fio_http_s *h = fio_http_new();
@@ -175,6 +182,164 @@ FIO_SFUNC void FIO_NAME_TEST(stl, http_s)(void) {
                "fio_http_body_read_until token error");
   }
 
+#if defined(P_tmpdir)
+  { /* test static file responses (and the static file cache) */
+    char name[64];
+    fio_str_info_s folder = FIO_STR_INFO1((char *)P_tmpdir);
+    FIO_STR_INFO_TMP_VAR(path, 1023);
+    uint64_t rnd = fio_rand64();
+    snprintf(name,
+             sizeof(name),
+             "/fio_test_static_%llx",
+             (unsigned long long)rnd);
+    fio_string_write2(&path,
+                      NULL,
+                      FIO_STRING_WRITE_STR2(folder.buf, folder.len),
+                      FIO_STRING_WRITE_STR1(name),
+                      FIO_STRING_WRITE_STR2(".txt", 4));
+    FIO_ASSERT(fio_filename_overwrite(path.buf, "static file body", 16) == 0,
+               "couldn't create test file %s",
+               path.buf);
+    fio_string_write(&path, NULL, ".gz", 3);
+    FIO_ASSERT(fio_filename_overwrite(path.buf, "compressed", 10) == 0,
+               "couldn't create test file %s",
+               path.buf);
+    path.len -= 3;
+    path.buf[path.len] = 0;
+    fio_str_info_s etag[2] = {{0}};
+    char etag_buf[2][32];
+    for (size_t round = 0; round < 4; ++round) {
+      /* round 0/2: identity, round 1/3: gzip (2+ may be served from cache) */
+      fio_http_s *s = fio_http_new();
+      fio_http_status_set(s, 200);
+      fio_http_method_set(s, FIO_STR_INFO1((char *)"GET"));
+      if ((round & 1))
+        fio_http_request_header_set(
+            s,
+            FIO_STR_INFO1((char *)"accept-encoding"),
+            FIO_STR_INFO1((char *)"gzip, deflate"));
+      FIO_ASSERT(!fio_http_static_file_response(
+                     s,
+                     folder,
+                     FIO_STR_INFO2(name, strlen(name)), /* auto-completed */
+                     3600),
+                 "fio_http_static_file_response failed (%zu)",
+                 round);
+      fio_str_info_s tmp =
+          fio_http_response_header(s, FIO_STR_INFO1((char *)"etag"), 0);
+      FIO_ASSERT(fio_http_status(s) == 200 && tmp.len,
+                 "static file response status / etag error (%zu)",
+                 round);
+      if (round < 2) {
+        FIO_ASSERT(tmp.len < 32, "etag too long");
+        FIO_MEMCPY(etag_buf[round], tmp.buf, tmp.len);
+        etag[round] = FIO_STR_INFO2(etag_buf[round], tmp.len);
+      }
+      FIO_ASSERT(FIO_STR_INFO_IS_EQ(tmp, etag[round & 1]),
+                 "static file etag should be stable (%zu)",
+                 round);
+      FIO_ASSERT(!(round & 1) || !FIO_STR_INFO_IS_EQ(etag[0], etag[1]),
+                 "static file variants should have different etags");
+      tmp = fio_http_response_header(s,
+                                     FIO_STR_INFO1((char *)"content-encoding"),
+                                     0);
+      FIO_ASSERT((round & 1) ? FIO_STR_INFO_IS_EQ(tmp,
+                                                  FIO_STR_INFO1((char *)"gzip"))
+                             : !tmp.len,
+                 "static file content-encoding error (%zu)",
+                 round);
+      tmp = fio_http_response_header(s,
+                                     FIO_STR_INFO1((char *)"content-length"),
+                                     0);
+      FIO_ASSERT(FIO_STR_INFO_IS_EQ(
+                     tmp,
+                     FIO_STR_INFO1((char *)((round & 1) ? "10" : "16"))),
+                 "static file content-length error (%zu)",
+                 round);
+      fio_http_free(s);
+    }
+    { /* test if-none-match */
+      fio_http_s *s = fio_http_new();
+      fio_http_status_set(s, 200);
+      fio_http_method_set(s, FIO_STR_INFO1((char *)"GET"));
+      fio_http_request_header_set(s,
+                                  FIO_STR_INFO1((char *)"if-none-match"),
+                                  etag[0]);
+      FIO_ASSERT(!fio_http_static_file_response(
+                     s,
+                     folder,
+                     FIO_STR_INFO2(path.buf + folder.len,
+                                   path.len - folder.len),
+                     0) &&
+                     fio_http_status(s) == 304,
+                 "static file if-none-match should return 304");
+      fio_http_free(s);
+    }
+#if FIO_HTTP_STATIC_FILE_CACHE_LIMIT
+    FIO_ASSERT(fio___http_sfc_map_count(&FIO___HTTP_SFC.map),
+               "static file cache should hold an entry");
+#endif
+    unlink(path.buf);
+    fio_string_write(&path, NULL, ".gz", 3);
+    unlink(path.buf);
+  }
+#endif /* P_tmpdir */
+
+  { /* test the access log sink */
+    char *log = NULL;
+    size_t lines = 0, dropped = fio_http_log_dropped();
+    fio_http_s *s = fio_http_new();
+    fio_http_status_set(s, 200);
+    fio_http_method_set(s, FIO_STR_INFO1((char *)"GET"));
+    fio_http_path_set(s, FIO_STR_INFO1((char *)"/log\"test"));
+    fio_http_version_set(s, FIO_STR_INFO1((char *)"HTTP/1.1"));
+    fio_http_log_sink(.on_write = fio___test_http_log_on_write, .udata = &log);
+    fio_http_write_log(s);
+    fio_http_log_flush();
+    FIO_ASSERT(log && fio_bstr_len(log) &&
+                   log[fio_bstr_len(log) - 1] == '\n' &&
+                   strstr(log, "\"GET /log\"test HTTP/1.1\" 200 "),
+               "access log line error:\n%s",
+               log);
+    fio_bstr_free(log);
+    log = NULL;
+    fio_http_log_sink(.on_write = fio___test_http_log_on_write,
+                      .udata = &log,
+                      .json = 1);
+    fio_http_write_log(s);
+    fio_http_log_flush();
+    FIO_ASSERT(log && !FIO_MEMCMP(log, "{\"pid\":", 7) &&
+                   strstr(log, ",\"path\":\"/log\\\"test\",") &&
+                   strstr(log, ",\"status\":200,") &&
+                   !FIO_MEMCMP(log + fio_bstr_len(log) - 2, "}\n", 2),
+               "JSON access log line error:\n%s",
+               log);
+    fio_bstr_free(log);
+    log = NULL;
+    for (size_t block = 0; block < 2; ++block) {
+      fio_http_log_sink(.on_write = fio___test_http_log_on_write,
+                        .udata = &log,
+                        .block = (uint8_t)block);
+      for (size_t i = 0; i < 4096; ++i)
+        fio_http_write_log(s);
+      fio_http_log_flush();
+      lines = 0;
+      for (char *pos = log; (pos = strchr(pos, '\n')); ++pos)
+        ++lines;
+      FIO_ASSERT(lines + (fio_http_log_dropped() - dropped) == 4096,
+                 "access log lines lost (%zu written, %zu dropped)",
+                 lines,
+                 (fio_http_log_dropped() - dropped));
+      FIO_ASSERT(!block || fio_http_log_dropped() == dropped,
+                 "blocking access log shouldn't drop lines");
+      dropped = fio_http_log_dropped();
+      fio_bstr_free(log);
+      log = NULL;
+    }
+    fio_http_log_sink(.fd = 0); /* restore default (STDOUT) */
+    fio_http_free(s);
+  }
+
   /* almost done, just make sure reference counting doesn't destroy object */
   fio_http_free(fio_http_dup(h));
   FIO_ASSERT(
@@ -185,6 +350,222 @@ FIO_SFUNC void FIO_NAME_TEST(stl, http_s)(void) {
   fio_http_free(h);
 }
 
+
+/* collects multipart parser events into a fio_bstr (`part->udata`) */
+FIO_SFUNC int fio___test_http_multipart_on_part(
+    fio_http_multipart_part_s *part) {
+  char **out = (char **)part->udata;
+  *out = fio_bstr_write(*out, "[", 1);
+  *out = fio_bstr_write(*out, part->name.buf, part->name.len);
+  *out = fio_bstr_write(*out, "|", 1);
+  *out = fio_bstr_write(*out, part->filename.buf, part->filename.len);
+  *out = fio_bstr_write(*out, "|", 1);
+  *out = fio_bstr_write(*out, part->content_type.buf, part->content_type.len);
+  *out = fio_bstr_write(*out, "]", 1);
+  if (part->filename.len && fio_bstr_len(*out) < 4096 &&
+      !FIO_MEMCMP(part->filename.buf, "fd", 2))
+    part->fd = fio_filename_tmp(); /* stream to a file */
+  return 0;
+}
+FIO_SFUNC int fio___test_http_multipart_on_data(fio_http_multipart_part_s *part,
+                                                fio_buf_info_s data) {
+  char **out = (char **)part->udata;
+  *out = fio_bstr_write(*out, data.buf, data.len);
+  return 0 - (data.buf[0] == '!'); /* tests callback errors */
+}
+FIO_SFUNC int fio___test_http_multipart_on_part_end(
+    fio_http_multipart_part_s *part) {
+  char **out = (char **)part->udata;
+  if (part->fd != -1) { /* read back the file's content */
+    char tmp[256];
+    size_t len = fio_fd_read(part->fd, tmp, sizeof(tmp), 0);
+    FIO_ASSERT(len == part->len, "multipart part file length error");
+    *out = fio_bstr_write(*out, "(fd)", 4);
+    *out = fio_bstr_write(*out, tmp, len);
+    close(part->fd);
+  }
+  if (part->error)
+    *out = fio_bstr_write(*out, "<error>", 7);
+  else
+    *out = fio_bstr_write(*out, "<end>", 5);
+  return 0;
+}
+
+FIO_SFUNC void FIO_NAME_TEST(stl, http_body_parsing)(void) {
+  fprintf(stderr, "* Testing HTTP body parsing helpers.\n");
+  { /* urlencoded / query parsing */
+    const char *expected[] = {"a", "1", "b", "", "c", "", "", "d", "e", "%20x"};
+    size_t count = 0;
+    FIO_HTTP_URLENCODED_EACH(FIO_STR_INFO1((char *)"a=1&&b=&c&=d&e=%20x&"),
+                             i) {
+      FIO_ASSERT(count < 10 &&
+                     FIO_STR_INFO_IS_EQ(
+                         i.name,
+                         FIO_STR_INFO1((char *)expected[count])) &&
+                     FIO_STR_INFO_IS_EQ(
+                         i.value,
+                         FIO_STR_INFO1((char *)expected[count + 1])),
+                 "FIO_HTTP_URLENCODED_EACH error at %zu (%.*s=%.*s)",
+                 count >> 1,
+                 (int)i.name.len,
+                 i.name.buf,
+                 (int)i.value.len,
+                 i.value.buf);
+      count += 2;
+    }
+    FIO_ASSERT(count == 10, "FIO_HTTP_URLENCODED_EACH count error");
+    FIO_HTTP_URLENCODED_EACH(FIO_STR_INFO0, i) {
+      FIO_ASSERT(0, "FIO_HTTP_URLENCODED_EACH shouldn't iterate empty data");
+    }
+  }
+  { /* multipart parsing, using every chunk size */
+    fio_str_info_s content_type = FIO_STR_INFO1(
+        (char *)"Multipart/Form-Data; charset=utf-8; boundary=\"xyz123\"");
+    const char *body =
+        "preamble\r\n--xyz123\r\n"
+        "Content-Disposition: form-data; name=\"field\"\r\n"
+        "\r\n"
+        "value\r\n"
+        "--xyz123  \r\n"
+        "content-disposition: form-data; name=\"up\"; filename=\"a.bin\"\r\n"
+        "Content-Type: application/octet-stream\r\n"
+        "\r\n"
+        "l1\r\nl2\r\n--xyz12\r\r\n--xy\r\n\r\n--xyz123\r\n"
+        "Content-Disposition: form-data; name=file; filename=\"fd.txt\"\r\n"
+        "\r\n"
+        "streamed\r\n--xyz123\r\n"
+        "\r\n"
+        "\r\n--xyz123--\r\nepilogue\r\n--xyz123\r\n";
+    const char *expected = "[field||]value<end>"
+                           "[up|a.bin|application/octet-stream]"
+                           "l1\r\nl2\r\n--xyz12\r\r\n--xy\r\n<end>"
+                           "[file|fd.txt|](fd)streamed<end>"
+                           "[||]<end>";
+    const size_t body_len = strlen(body);
+    const size_t body_end = (size_t)(strstr(body, "--xyz123--") + 10 - body);
+    FIO_ASSERT(!fio_http_multipart_new(FIO_STR_INFO1((char *)"text/plain"),
+                                       .udata = NULL),
+               "multipart parser should require multipart/form-data");
+    FIO_ASSERT(!fio_http_multipart_new(
+                   FIO_STR_INFO1((char *)"multipart/form-data; charset=x"),
+                   .udata = NULL),
+               "multipart parser should require a boundary");
+    for (size_t chunk = 1; chunk <= body_len; ++chunk) {
+      char *out = NULL;
+      fio_http_multipart_s *p =
+          fio_http_multipart_new(content_type,
+                                 .on_part = fio___test_http_multipart_on_part,
+                                 .on_data = fio___test_http_multipart_on_data,
+                                 .on_part_end =
+                                     fio___test_http_multipart_on_part_end,
+                                 .udata = &out);
+      FIO_ASSERT(p, "fio_http_multipart_new failed");
+      for (size_t pos = 0; pos < body_len; pos += chunk) {
+        size_t len = (body_len - pos < chunk) ? body_len - pos : chunk;
+        FIO_ASSERT(!fio_http_multipart_is_finished(p) || pos >= body_end,
+                   "multipart parser finished too soon");
+        FIO_ASSERT(!fio_http_multipart_parse(
+                       p,
+                       FIO_BUF_INFO2((char *)body + pos, len)),
+                   "multipart parser error (chunk size %zu)",
+                   chunk);
+      }
+      FIO_ASSERT(fio_http_multipart_is_finished(p) == 1,
+                 "multipart parser should be finished (chunk size %zu)",
+                 chunk);
+      FIO_ASSERT(out && !strcmp(out, expected),
+                 "multipart parser output error (chunk size %zu):\n%s",
+                 chunk,
+                 out);
+      fio_bstr_free(out);
+      fio_http_multipart_free(p);
+    }
+    { /* errors */
+      fio_http_multipart_s *p =
+          fio_http_multipart_new(content_type, .udata = NULL);
+      FIO_ASSERT(fio_http_multipart_parse(
+                     p,
+                     FIO_BUF_INFO1((char *)"--xyz123x\r\n\r\n")) == -1,
+                 "multipart parser should fail on invalid boundary lines");
+      FIO_ASSERT(fio_http_multipart_is_finished(p) == -1 &&
+                     fio_http_multipart_parse(p,
+                                              FIO_BUF_INFO1((char *)"\r\n")) ==
+                         -1,
+                 "multipart parser errors should persist");
+      fio_http_multipart_free(p);
+    }
+    { /* parts cut short still reach `on_part_end` (i.e., to close files) */
+      static const char *tests[][2] = {
+          {"--xyz123\r\nContent-Disposition: form-data; name=f; "
+           "filename=fd.txt\r\n\r\ntrunca",
+           "[f|fd.txt|](fd)trunca<error>"},
+          {"--xyz123\r\nContent-Disposition: form-data; name=f\r\n\r\n"
+           "!fail\r\n--xyz123--",
+           "[f||]!fail<error>"},
+          {"--xyz123\r\nContent-Disposition: form-data; name=f\r\n\r\n"
+           "ok\r\n--xyz123\r\nContent-Disposition: form-data; name=g\r\n"
+           "\r\n!",
+           "[f||]ok<end>[g||]!<error>"},
+          {NULL},
+      };
+      for (size_t i = 0; tests[i][0]; ++i) {
+        char *out = NULL;
+        fio_http_multipart_s *p =
+            fio_http_multipart_new(content_type,
+                                   .on_part = fio___test_http_multipart_on_part,
+                                   .on_data = fio___test_http_multipart_on_data,
+                                   .on_part_end =
+                                       fio___test_http_multipart_on_part_end,
+                                   .udata = &out);
+        fio_http_multipart_parse(p, FIO_BUF_INFO1((char *)tests[i][0]));
+        fio_http_multipart_free(p);
+        FIO_ASSERT(out && !strcmp(out, tests[i][1]),
+                   "multipart parts cut short should end with an error (%zu):"
+                   "\n%s",
+                   i,
+                   out);
+        fio_bstr_free(out);
+      }
+    }
+    { /* streaming the body of an HTTP handle (part of it received earlier) */
+      char *out = NULL;
+      fio_http_s *h = fio_http_new();
+      fio_http_request_header_set(h,
+                                  FIO_STR_INFO1((char *)"content-type"),
+                                  content_type);
+      fio_http_body_write(h, body, 30);
+      FIO_ASSERT(fio_http_body_multipart(
+                     h,
+                     .on_part = fio___test_http_multipart_on_part,
+                     .on_data = fio___test_http_multipart_on_data,
+                     .on_part_end = fio___test_http_multipart_on_part_end,
+                     .udata = &out),
+                 "fio_http_body_multipart failed");
+      FIO_ASSERT(!fio_http_body_multipart(h, .udata = NULL),
+                 "fio_http_body_multipart should only attach a single parser");
+      FIO_ASSERT(!fio_http_body_write(h, body + 30, body_len - 30),
+                 "fio_http_body_write should report a valid multipart body");
+      FIO_ASSERT(fio_http_body_length(h) == body_len &&
+                     !fio_http_body_read(h, 16).len,
+                 "streamed body shouldn't be stored");
+      FIO_ASSERT(out && !strcmp(out, expected),
+                 "fio_http_body_multipart output error:\n%s",
+                 out);
+      fio_bstr_free(out);
+      fio_http_free(h);
+      h = fio_http_new();
+      fio_http_request_header_set(h,
+                                  FIO_STR_INFO1((char *)"content-type"),
+                                  content_type);
+      FIO_ASSERT(fio_http_body_multipart(h, .udata = NULL),
+                 "fio_http_body_multipart failed");
+      FIO_ASSERT(fio_http_body_write(h, "--xyz123x", 9) == -1,
+                 "fio_http_body_write should report multipart errors");
+      fio_http_free(h);
+    }
+  }
+}
+
 /* *****************************************************************************
 Cleanup
 ***************************************************************************** */
@@ -0,0 +1,180 @@
+/* ************************************************************************* */
+#if !defined(FIO_INCLUDE_FILE) /* Dev test - ignore line */
+#define FIO___DEV___           /* Development inclusion - ignore line */
+#define FIO_TEST_ALL           /* Development inclusion - ignore line */
+#include "./include.h"         /* Development inclusion - ignore line */
+#endif                         /* Development inclusion - ignore line */
+/* *****************************************************************************
+
+
+
+
+                        HTTP Router Test Helper
+
+
+
+
+Copyright and License: see header file (000 copyright.h) or top of file
+***************************************************************************** */
+#if defined(FIO_TEST_ALL) && !defined(FIO___TEST_REINCLUDE) &&                 \
+    !defined(H___FIO_HTTP_ROUTER_TEST___H) && defined(H___FIO_HTTP_ROUTER___H)
+#define H___FIO_HTTP_ROUTER_TEST___H
+
+/* route handlers are told apart using their `udata` */
+FIO_SFUNC void fio___test_http_router_task(fio_http_s *h,
+                                           fio_http_route_s *route) {
+  fio_http_udata_set(h, route->udata);
+}
+
+FIO_SFUNC void FIO_NAME_TEST(stl, http_router)(void) {
+  fprintf(stderr, "* Testing HTTP router (fio_http_router_s).\n");
+  struct {
+    const char *method;
+    const char *path;
+    uintptr_t id;
+  } routes[] = {
+      {NULL, "/", 1},
+      {"GET", "/users", 2},
+      {"GET", "/users/:id", 3},
+      {"PUT", "/users/:id", 4},
+      {"GET", "/users/me", 5},
+      {"GET", "/users/:id/posts/:post", 6},
+      {NULL, "/files/*path", 7},
+      {"GET", "/files/index.html", 8},
+      {"GET", "/user", 9},
+      {"POST", "/users", 10},
+      {"GET", "/a:b/:c", 11},
+      {"GET", "/*all", 12},
+      {NULL, NULL, 0},
+  };
+  struct {
+    const char *method;
+    const char *path;
+    int result;
+    uintptr_t id;
+    const char *param[4]; /* name, value pairs */
+  } tests[] = {
+      {"GET", "/", 0, 1, {NULL}},
+      {"DELETE", "/", 0, 1, {NULL}},
+      {"GET", "/users", 0, 2, {NULL}},
+      {"HEAD", "/users", 0, 2, {NULL}},
+      {"POST", "/users", 0, 10, {NULL}},
+      {"DELETE", "/users", 405, 0, {NULL}},
+      {"GET", "/user", 0, 9, {NULL}},
+      {"GET", "/users/me", 0, 5, {NULL}},
+      {"PUT", "/users/me", 0, 4, {"id", "me"}},
+      {"GET", "/users/42", 0, 3, {"id", "42"}},
+      {"PUT", "/users/42", 0, 4, {"id", "42"}},
+      {"DELETE", "/users/42", 405, 0, {NULL}},
+      {"GET", "/users/42/posts/7", 0, 6, {"id", "42", "post", "7"}},
+      {"GET", "/users/me/posts/7", 0, 6, {"id", "me", "post", "7"}},
+      {"GET", "/files/", 0, 7, {"path", ""}},
+      {"GET", "/files/a/b.txt", 0, 7, {"path", "a/b.txt"}},
+      {"GET", "/files/index.html", 0, 8, {NULL}},
+      {"POST", "/files/index.html", 0, 7, {"path", "index.html"}},
+      {"POST", "/nothing", 405, 0, {NULL}},
+      {"GET", "/a:b/c", 0, 11, {"c", "c"}},
+      {"GET", "/users/", 0, 12, {"all", "users/"}},
+      {"GET", "/usersx", 0, 12, {"all", "usersx"}},
+      {"GET", "/nothing/here", 0, 12, {"all", "nothing/here"}},
+      {NULL, NULL, 0, 0, {NULL}},
+  };
+  fio_http_router_s *r = fio_http_router_new(.on_not_found = NULL);
+  fio_http_route_s route;
+  FIO_ASSERT(r, "fio_http_router_new failed");
+  FIO_ASSERT(fio_http_router_find(r,
+                                  &route,
+                                  FIO_STR_INFO1((char *)"GET"),
+                                  FIO_STR_INFO1((char *)"/")) == 404,
+             "empty router should return 404");
+  for (size_t i = 0; routes[i].path; ++i) {
+    FIO_ASSERT(!fio_http_route(r,
+                               .method = routes[i].method,
+                               .path = routes[i].path,
+                               .on_http = fio___test_http_router_task,
+                               .udata = (void *)routes[i].id),
+               "fio_http_route failed for %s",
+               routes[i].path);
+  }
+  /* the router logs errors for invalid routes */
+  int log_level = FIO_LOG_LEVEL_GET();
+  FIO_LOG_LEVEL_SET(FIO_LOG_LEVEL_NONE);
+  FIO_ASSERT(fio_http_route(r,
+                            .path = "/users/:name/x",
+                            .on_http = fio___test_http_router_task) == -1,
+             "parameter name conflicts should fail");
+  FIO_ASSERT(fio_http_route(r,
+                            .path = "/x/*rest/more",
+                            .on_http = fio___test_http_router_task) == -1,
+             "wildcards must be the last segment");
+  FIO_ASSERT(fio_http_route(r,
+                            .path = "/x/:/y",
+                            .on_http = fio___test_http_router_task) == -1,
+             "parameters must be named");
+  FIO_LOG_LEVEL_SET(log_level);
+
+  for (size_t i = 0; tests[i].path; ++i) {
+    int result = fio_http_router_find(r,
+                                      &route,
+                                      FIO_STR_INFO1((char *)tests[i].method),
+                                      FIO_STR_INFO1((char *)tests[i].path));
+    size_t count = 0;
+    FIO_ASSERT(result == tests[i].result,
+               "router result error for %s %s (%d != %d)",
+               tests[i].method,
+               tests[i].path,
+               result,
+               tests[i].result);
+    if (result)
+      continue;
+    FIO_ASSERT(route.udata == (void *)tests[i].id,
+               "router matched the wrong route for %s %s (%zu != %zu)",
+               tests[i].method,
+               tests[i].path,
+               (size_t)(uintptr_t)route.udata,
+               (size_t)tests[i].id);
+    for (; count < 2 && tests[i].param[count << 1]; ++count) {
+      fio_str_info_s v = fio_http_route_param(
+          &route,
+          FIO_STR_INFO1((char *)tests[i].param[count << 1]));
+      fio_str_info_s expected =
+          FIO_STR_INFO1((char *)tests[i].param[(count << 1) + 1]);
+      FIO_ASSERT(v.buf && FIO_STR_INFO_IS_EQ(v, expected),
+                 "router parameter error for %s (%s = %.*s)",
+                 tests[i].path,
+                 tests[i].param[count << 1],
+                 (int)v.len,
+                 v.buf);
+    }
+    FIO_ASSERT(route.count == count,
+               "router parameter count error for %s (%zu != %zu)",
+               tests[i].path,
+               route.count,
+               count);
+  }
+  FIO_ASSERT(!fio_http_route_param(&route, FIO_STR_INFO1((char *)"missing"))
+                  .buf,
+             "missing route parameters should be NULL");
+
+  { /* routes added after compilation, dispatching */
+    fio_http_s *h = fio_http_new();
+    FIO_ASSERT(!fio_http_route(r,
+                               .method = "GET",
+                               .path = "/late/:x",
+                               .on_http = fio___test_http_router_task,
+                               .udata = (void *)(uintptr_t)13),
+               "fio_http_route failed after compilation");
+    fio_http_method_set(h, FIO_STR_INFO1((char *)"GET"));
+    fio_http_path_set(h, FIO_STR_INFO1((char *)"/late/1"));
+    FIO_ASSERT(!fio_http_router_dispatch(r, h) &&
+                   fio_http_udata(h) == (void *)(uintptr_t)13,
+               "fio_http_router_dispatch failed");
+    fio_http_free(h);
+  }
+  fio_http_router_free(r);
+}
+
+/* *****************************************************************************
+Cleanup
+***************************************************************************** */
+#endif /* FIO_TEST_ALL */
@@ -0,0 +1,1008 @@
+/* ************************************************************************* */
+#if !defined(FIO_INCLUDE_FILE) /* Dev test - ignore line */
+#define FIO___DEV___           /* Development inclusion - ignore line */
+#define FIO_TEST_ALL           /* Development inclusion - ignore line */
+#include "./include.h"         /* Development inclusion - ignore line */
+#endif                         /* Development inclusion - ignore line */
+/* *****************************************************************************
+
+
+
+
+      HTTP/2 (HPACK), WebSocket, HTTP Compression and Client Pool Tests
+
+
+
+
+Copyright and License: see header file (000 copyright.h) or top of file
+***************************************************************************** */
+#if defined(FIO_TEST_ALL) && !defined(FIO___TEST_REINCLUDE) &&                 \
+    !defined(H___FIO_HTTP2_TEST___H)
+#define H___FIO_HTTP2_TEST___H
+
+typedef struct {
+  char buf[512];
+  size_t len;
+} fio___test_hpack_s;
+
+/* collects decoded headers as "name: value\n" */
+FIO_SFUNC int fio___test_hpack_on_header(void *udata,
+                                         fio_str_info_s name,
+                                         fio_str_info_s value) {
+  fio___test_hpack_s *t = (fio___test_hpack_s *)udata;
+  FIO_ASSERT(t->len + name.len + value.len + 3 < sizeof(t->buf),
+             "HPACK test buffer overflow");
+  FIO_MEMCPY(t->buf + t->len, name.buf, name.len);
+  t->len += name.len;
+  t->buf[t->len++] = ':';
+  t->buf[t->len++] = ' ';
+  if (value.len)
+    FIO_MEMCPY(t->buf + t->len, value.buf, value.len);
+  t->len += value.len;
+  t->buf[t->len++] = '\n';
+  t->buf[t->len] = 0;
+  return 0;
+}
+
+FIO_SFUNC void FIO_NAME_TEST(stl, hpack)(void) {
+  fprintf(stderr, "* Testing HTTP/2 HPACK header compression (RFC 7541).\n");
+  { /* Huffman round-trip, all byte values */
+    uint8_t src[256], enc[1024];
+    char dec[512];
+    size_t dlen = 0;
+    for (size_t i = 0; i < 256; ++i)
+      src[i] = (uint8_t)i;
+    size_t elen = fio___hpack_huff_encode(enc, src, 256);
+    FIO_ASSERT(elen == fio___hpack_huff_length(src, 256),
+               "HPACK Huffman length error");
+    FIO_ASSERT(!fio___hpack_huff_decode(dec, &dlen, enc, elen) &&
+                   dlen == 256 && !FIO_MEMCMP(dec, src, 256),
+               "HPACK Huffman round-trip error");
+    /* padding longer than 7 bits (a full byte of ones) must fail */
+    enc[elen] = 0xFF;
+    FIO_ASSERT(fio___hpack_huff_decode(dec, &dlen, enc, elen + 1),
+               "HPACK Huffman padding > 7 bits should fail");
+  }
+  { /* integer encoding (RFC 7541, Appendix C.1) */
+    uint8_t buf[8];
+    const uint8_t *pos = buf;
+    uint64_t i = 0;
+    FIO_ASSERT(fio___hpack_int_write(buf, 10, 5, 0) == 1 && buf[0] == 10,
+               "HPACK integer (C.1.1) error");
+    FIO_ASSERT(fio___hpack_int_write(buf, 1337, 5, 0) == 3 && buf[0] == 31 &&
+                   buf[1] == 154 && buf[2] == 10,
+               "HPACK integer (C.1.2) error");
+    FIO_ASSERT(!fio___hpack_int_read(&i, &pos, buf + 3, 5) && i == 1337 &&
+                   pos == buf + 3,
+               "HPACK integer (C.1.2) decoding error");
+    pos = buf;
+    FIO_ASSERT(fio___hpack_int_read(&i, &pos, buf + 2, 5),
+               "HPACK truncated integer should fail");
+  }
+  { /* request examples with Huffman coding (RFC 7541, Appendix C.4) */
+    static const char *blocks[] = {
+        "\x82\x86\x84\x41\x8c\xf1\xe3\xc2\xe5\xf2\x3a\x6b\xa0\xab\x90\xf4\xff",
+        "\x82\x86\x84\xbe\x58\x86\xa8\xeb\x10\x64\x9c\xbf",
+        "\x82\x87\x85\xbf\x40\x88\x25\xa8\x49\xe9\x5b\xa9\x7d\x7f\x89\x25\xa8"
+        "\x49\xe9\x5b\xb8\xe8\xb4\xbf",
+    };
+    static const size_t lengths[] = {17, 12, 24};
+    static const char *expected[] = {
+        ":method: GET\n:scheme: http\n:path: /\n"
+        ":authority: www.example.com\n",
+        ":method: GET\n:scheme: http\n:path: /\n"
+        ":authority: www.example.com\ncache-control: no-cache\n",
+        ":method: GET\n:scheme: https\n:path: /index.html\n"
+        ":authority: www.example.com\ncustom-key: custom-value\n",
+    };
+    fio___hpack_table_s t = {.max = 4096};
+    for (size_t i = 0; i < 3; ++i) {
+      fio___test_hpack_s r = {{0}};
+      FIO_ASSERT(!fio___hpack_decode(&t,
+                                     FIO_BUF_INFO2((char *)blocks[i],
+                                                   lengths[i]),
+                                     fio___test_hpack_on_header,
+                                     &r),
+                 "HPACK decoding failed (C.4.%zu)",
+                 i + 1);
+      FIO_ASSERT(!strcmp(r.buf, expected[i]),
+                 "HPACK decoding error (C.4.%zu):\n%s",
+                 i + 1,
+                 r.buf);
+    }
+    FIO_ASSERT(t.count == 3 && t.size == 164,
+               "HPACK dynamic table state error (C.4.3)");
+    /* an index beyond the dynamic table is a compression error */
+    FIO_ASSERT(fio___hpack_decode(&t,
+                                  FIO_BUF_INFO2((char *)"\xc1", 1),
+                                  fio___test_hpack_on_header,
+                                  NULL) == -1,
+               "HPACK invalid index should fail");
+    /* a size update after the first field is a compression error */
+    FIO_ASSERT(fio___hpack_decode(&t,
+                                  FIO_BUF_INFO2((char *)"\x82\x20", 2),
+                                  fio___test_hpack_on_header,
+                                  &(fio___test_hpack_s){{0}}) == -1,
+               "HPACK late table size update should fail");
+    fio___hpack_table_destroy(&t);
+  }
+  { /* encoder / decoder round-trip with eviction (small table) */
+    fio___hpack_table_s enc = {.max = 128}, dec = {.max = 128};
+    char *block = NULL;
+    for (size_t round = 0; round < 64; ++round) {
+      char value[32];
+      fio___test_hpack_s r = {{0}};
+      char expected[128];
+      size_t vlen = (size_t)snprintf(value, sizeof(value), "value-%zu", round);
+      if (block)
+        block = fio_bstr_len_set(block, 0);
+      block = fio___hpack_encode(&enc,
+                                 block,
+                                 FIO_STR_INFO2((char *)":status", 7),
+                                 FIO_STR_INFO2((char *)"200", 3),
+                                 FIO___HPACK_INDEX);
+      block = fio___hpack_encode(&enc,
+                                 block,
+                                 FIO_STR_INFO2((char *)"x-round", 7),
+                                 FIO_STR_INFO2(value, vlen),
+                                 FIO___HPACK_INDEX);
+      block = fio___hpack_encode(&enc,
+                                 block,
+                                 FIO_STR_INFO2((char *)"x-same", 6),
+                                 FIO_STR_INFO2((char *)"same", 4),
+                                 FIO___HPACK_INDEX);
+      block = fio___hpack_encode(&enc,
+                                 block,
+                                 FIO_STR_INFO2((char *)"set-cookie", 10),
+                                 FIO_STR_INFO2((char *)"id=1", 4),
+                                 FIO___HPACK_NEVER_INDEX);
+      FIO_ASSERT(!fio___hpack_decode(&dec,
+                                     fio_bstr_buf(block),
+                                     fio___test_hpack_on_header,
+                                     &r),
+                 "HPACK round-trip decoding failed (round %zu)",
+                 round);
+      snprintf(expected,
+               sizeof(expected),
+               ":status: 200\nx-round: %s\nx-same: same\nset-cookie: id=1\n",
+               value);
+      FIO_ASSERT(!strcmp(r.buf, expected),
+                 "HPACK round-trip error (round %zu):\n%s",
+                 round,
+                 r.buf);
+      FIO_ASSERT(enc.size == dec.size && enc.count == dec.count &&
+                     enc.size <= 128,
+                 "HPACK encoder / decoder tables out of sync");
+    }
+    fio_bstr_free(block);
+    fio___hpack_table_destroy(&enc);
+    fio___hpack_table_destroy(&dec);
+  }
+  { /* header blocks for closed streams must still update the HPACK table */
+    fio___hpack_table_s enc = {.max = FIO___HTTP2_HPACK_MAX};
+    fio___http2_s *s = fio___http2_new(0);
+    char *block = NULL;
+    FIO_ASSERT_ALLOC(s);
+    *s = (fio___http2_s){.dec = {.max = FIO___HTTP2_HPACK_MAX}, .last_id = 5};
+    s->active = FIO_LIST_INIT(s->active);
+    block = fio___hpack_encode(&enc,
+                               block,
+                               FIO_STR_INFO2((char *)"x-closed", 8),
+                               FIO_STR_INFO2((char *)"stream", 6),
+                               FIO___HPACK_INDEX);
+    fio___http2_on_header_block(s, 3, fio_bstr_buf(block), 1);
+    FIO_ASSERT(!s->error && s->dec.count == enc.count &&
+                   s->dec.size == enc.size,
+               "HTTP/2 HEADERS on a closed stream should update HPACK state");
+    FIO_ASSERT(fio_bstr_len(s->wbuf) == 13 &&
+                   s->wbuf[3] == FIO___HTTP2_FRAME_RST_STREAM &&
+                   fio_buf2u32_be(s->wbuf + 5) == 3 &&
+                   fio_buf2u32_be(s->wbuf + 9) == FIO___HTTP2_STREAM_CLOSED,
+               "HTTP/2 HEADERS on a closed stream should reset the stream");
+    fio_bstr_free(block);
+    fio___hpack_table_destroy(&enc);
+    fio___http2_free(s);
+  }
+}
+
+FIO_SFUNC void FIO_NAME_TEST(stl, websocket_deflate)(void) {
+  fprintf(stderr, "* Testing WebSocket permessage-deflate (RFC 7692).\n");
+#if HAVE_ZLIB
+  { /* extension negotiation */
+    static const struct {
+      const char *offer;
+      const char *response;
+    } examples[] = {
+        {"permessage-deflate", "permessage-deflate"},
+        {"permessage-deflate; client_max_window_bits",
+         "permessage-deflate; client_max_window_bits=12"},
+        {"x-webkit-deflate-frame, permessage-deflate; "
+         "server_max_window_bits=10; client_max_window_bits=\"9\"",
+         "permessage-deflate; server_max_window_bits=10; "
+         "client_max_window_bits=9"},
+        {"permessage-deflate; server_no_context_takeover",
+         "permessage-deflate; server_no_context_takeover"},
+        {"permessage-deflate; server_max_window_bits=8, permessage-deflate",
+         "permessage-deflate"},
+        {"permessage-deflate; server_max_window_bits", NULL},
+        {"permessage-deflate; client_max_window_bits=16", NULL},
+        {"permessage-deflate; unknown_parameter", NULL},
+        {"permessage-deflate; server_no_context_takeover; "
+         "server_no_context_takeover",
+         NULL},
+        {NULL, NULL},
+    };
+    fio_http_settings_s s = {.ws_deflate = 12};
+    for (size_t i = 0; examples[i].offer; ++i) {
+      fio_http_s *h = fio_http_new();
+      fio_http_request_header_add(
+          h,
+          FIO_STR_INFO2((char *)"sec-websocket-extensions", 24),
+          FIO_STR_INFO1((char *)examples[i].offer));
+      fio___http_ws_deflate_negotiate(h, &s);
+      fio_str_info_s r = fio_http_response_header(
+          h,
+          FIO_STR_INFO2((char *)"sec-websocket-extensions", 24),
+          0);
+      FIO_ASSERT((!r.len && !examples[i].response) ||
+                     (examples[i].response &&
+                      FIO_STR_INFO_IS_EQ(
+                          r,
+                          FIO_STR_INFO1((char *)examples[i].response))),
+                 "permessage-deflate negotiation error for:\n\t%s\n\t%s",
+                 examples[i].offer,
+                 (r.len ? r.buf : "(declined)"));
+      fio_http_free(h);
+    }
+  }
+  { /* compression round-trip, with and without context takeover */
+    char msg[1000];
+    for (size_t i = 0; i < sizeof(msg); ++i)
+      msg[i] = "{\"symbol\":\"AAPL\",\"bid\":189.25,\"ask\":189.27}"[i % 43];
+    for (size_t reset = 0; reset < 2; ++reset) {
+      fio___http_zstream_s *tx = fio___http_zstream_new(0, 15);
+      fio___http_zstream_s *rx = fio___http_zstream_new(1, 15);
+      size_t first = 0;
+      FIO_ASSERT(tx && rx, "zlib stream allocation failed");
+      for (size_t round = 0; round < 4; ++round) {
+        char *frame = fio___http_ws_deflate_frame(&tx->z, msg, 1000, 1, 0);
+        FIO_ASSERT(frame && (uint8_t)frame[0] == 0xC1 && frame[1] < 126,
+                   "compressed frame header error (FIN | RSV1 | text)");
+        fio_buf_info_s payload = FIO_BUF_INFO2(frame + 2, (size_t)frame[1]);
+        char *out = fio___http_ws_inflate(&rx->z, payload, 1000);
+        FIO_ASSERT(out && fio_bstr_len(out) == 1000 &&
+                       !FIO_MEMCMP(out, msg, 1000),
+                   "permessage-deflate round-trip error (%zu)",
+                   round);
+        if (!round)
+          first = payload.len;
+        FIO_ASSERT((reset ? payload.len == first : payload.len < first) ||
+                       !round,
+                   "permessage-deflate context takeover error");
+        fio_bstr_free(out);
+        fio_bstr_free(frame);
+        if (reset) {
+          deflateReset(&tx->z);
+          inflateReset(&rx->z);
+        }
+      }
+      fio___http_zstream_free(tx);
+      fio___http_zstream_free(rx);
+    }
+    { /* decompression limits (ws_max_msg_size) */
+      fio___http_zstream_s *tx = fio___http_zstream_new(0, 9);
+      fio___http_zstream_s *rx = fio___http_zstream_new(1, 9);
+      char *frame = fio___http_ws_deflate_frame(&tx->z, msg, 1000, 2, 0);
+      FIO_ASSERT(frame && !fio___http_ws_inflate(
+                              &rx->z,
+                              FIO_BUF_INFO2(frame + 2, (size_t)frame[1]),
+                              999),
+                 "permessage-deflate decompression limit ignored");
+      fio_bstr_free(frame);
+      fio___http_zstream_free(tx);
+      fio___http_zstream_free(rx);
+    }
+  }
+#else
+  fprintf(stderr, "\t- skipped (requires zlib / HAVE_ZLIB).\n");
+#endif /* HAVE_ZLIB */
+}
+
+FIO_SFUNC void FIO_NAME_TEST(stl, http_compress)(void) {
+  fprintf(stderr, "* Testing HTTP response compression (gzip / brotli).\n");
+#if HAVE_ZLIB || HAVE_BROTLI
+  { /* content encoding negotiation */
+    static const struct {
+      const char *accept;
+      uint8_t gzip;
+      uint8_t br;
+    } examples[] = {
+        {"gzip, deflate", FIO___HTTP_ZIP_GZIP, FIO___HTTP_ZIP_GZIP},
+        {"gzip, deflate, br", FIO___HTTP_ZIP_GZIP, FIO___HTTP_ZIP_BR},
+        {"br;q=0, gzip;q=0.5", FIO___HTTP_ZIP_GZIP, FIO___HTTP_ZIP_GZIP},
+        {"gzip;q=0.0, br;q=0.1", 0, FIO___HTTP_ZIP_BR},
+        {"identity", 0, 0},
+        {"br", 0, FIO___HTTP_ZIP_BR},
+        {NULL, 0, 0},
+    };
+    for (size_t i = 0; examples[i].accept; ++i) {
+      fio_http_s *h = fio_http_new();
+#if HAVE_BROTLI
+      uint8_t expected = examples[i].br;
+#else
+      uint8_t expected = examples[i].gzip;
+#endif
+#if !HAVE_ZLIB
+      if (expected == FIO___HTTP_ZIP_GZIP)
+        expected = 0;
+#endif
+      fio_http_request_header_add(h,
+                                  FIO_STR_INFO2((char *)"accept-encoding", 15),
+                                  FIO_STR_INFO1((char *)examples[i].accept));
+      FIO_ASSERT(fio___http_zip_accepted(h) == expected,
+                 "accept-encoding negotiation error for: %s",
+                 examples[i].accept);
+      fio_http_free(h);
+    }
+    FIO_ASSERT(fio___http_zip_is_text(FIO_STR_INFO1((char *)"text/html")) &&
+                   fio___http_zip_is_text(FIO_STR_INFO1(
+                       (char *)"application/json; charset=utf-8")) &&
+                   fio___http_zip_is_text(
+                       FIO_STR_INFO1((char *)"image/svg+xml")) &&
+                   !fio___http_zip_is_text(
+                       FIO_STR_INFO1((char *)"image/png")) &&
+                   !fio___http_zip_is_text(FIO_STR_INFO0),
+               "compressible content type detection error");
+  }
+  { /* `vary` and `etag` headers of compressible responses */
+    fio_http_settings_s settings = {.compress = 6, .compress_min = 100};
+    fio___http_connection_s c = {.settings = &settings};
+    fio_http_s *h = fio_http_new();
+    fio_http_status_set(h, 200);
+    fio_http_response_header_set(h,
+                                 FIO_STR_INFO2((char *)"content-type", 12),
+                                 FIO_STR_INFO2((char *)"text/html", 9));
+    fio_http_response_header_set(h,
+                                 FIO_STR_INFO2((char *)"content-length", 14),
+                                 FIO_STR_INFO2((char *)"1000", 4));
+    fio_http_response_header_set(h,
+                                 FIO_STR_INFO2((char *)"etag", 4),
+                                 FIO_STR_INFO2((char *)"\"abc\"", 5));
+    FIO_ASSERT(!fio___http_zip_start(&c, h) && !c.state.http.zip_type,
+               "response compressed without accept-encoding");
+    FIO_ASSERT(FIO_STR_INFO_IS_EQ(
+                   fio_http_response_header(h,
+                                            FIO_STR_INFO2((char *)"vary", 4),
+                                            0),
+                   FIO_STR_INFO2((char *)"accept-encoding", 15)),
+               "compressible response missing `vary: accept-encoding`");
+    fio___http_zip_etag(h);
+    fio___http_zip_etag(h);
+    FIO_ASSERT(FIO_STR_INFO_IS_EQ(
+                   fio_http_response_header(h,
+                                            FIO_STR_INFO2((char *)"etag", 4),
+                                            0),
+                   FIO_STR_INFO2((char *)"W/\"abc\"", 7)),
+               "compressed response `etag` should be weak");
+    fio_http_method_set(h, FIO_STR_INFO2((char *)"GET", 3));
+    fio_http_request_header_set(h,
+                                FIO_STR_INFO2((char *)"if-none-match", 13),
+                                FIO_STR_INFO2((char *)"W/\"abc\"", 7));
+    FIO_ASSERT(fio_http_etag_is_match(h),
+               "weak `if-none-match` should match a weakened `etag`");
+    fio_http_free(h);
+  }
+  { /* compression - a complete body and a streamed body */
+    char msg[4000];
+    for (size_t i = 0; i < sizeof(msg); ++i)
+      msg[i] = "{\"symbol\":\"AAPL\",\"bid\":189.25,\"ask\":189.27}"[i % 43];
+    for (uint8_t type = 1; type < 3; ++type) {
+      char *out[5] = {NULL};
+      size_t total = 0;
+      void *zip = fio___http_zip_new(type, 6, sizeof(msg));
+      if (!zip)
+        continue; /* not supported by this build */
+      out[0] = fio___http_zip(type, zip, msg, sizeof(msg), 1);
+      fio___http_zip_free(type, zip);
+      FIO_ASSERT(fio_bstr_len(out[0]) && fio_bstr_len(out[0]) < 400,
+                 "HTTP compression error (%s)",
+                 (type == FIO___HTTP_ZIP_GZIP ? "gzip" : "br"));
+      zip = fio___http_zip_new(type, 6, 0);
+      for (size_t i = 1; i < 4; ++i) {
+        out[i] = fio___http_zip(type, zip, msg + ((i - 1) * 1000), 1000, 0);
+        FIO_ASSERT(fio_bstr_len(out[i]), "streaming compression - no flush");
+      }
+      out[4] = fio___http_zip(type, zip, NULL, 0, 1);
+      fio___http_zip_free(type, zip);
+#if HAVE_ZLIB
+      if (type == FIO___HTTP_ZIP_GZIP) { /* decompress both */
+        char dec[8192];
+        for (size_t round = 0; round < 2; ++round) {
+          z_stream z;
+          FIO_MEMSET(&z, 0, sizeof(z));
+          FIO_ASSERT(inflateInit2(&z, 31) == Z_OK, "inflateInit2 failed");
+          z.next_out = (Bytef *)dec;
+          z.avail_out = sizeof(dec);
+          for (size_t i = (round ? 1 : 0); i < (round ? 5U : 1U); ++i) {
+            z.next_in = (Bytef *)out[i];
+            z.avail_in = (uInt)fio_bstr_len(out[i]);
+            inflate(&z, Z_SYNC_FLUSH);
+          }
+          total = sizeof(dec) - z.avail_out;
+          inflateEnd(&z);
+          FIO_ASSERT(total == (round ? 3000U : sizeof(msg)) &&
+                         !FIO_MEMCMP(dec, msg, total),
+                     "gzip round-trip error (%s)",
+                     (round ? "streaming" : "complete"));
+        }
+      }
+#endif
+      for (size_t i = 0; i < 5; ++i)
+        fio_bstr_free(out[i]);
+      (void)total;
+    }
+  }
+#else
+  fprintf(stderr, "\t- skipped (requires zlib or brotli).\n");
+#endif /* HAVE_ZLIB || HAVE_BROTLI */
+}
+
+/* *****************************************************************************
+HTTP Client Connection Pool Tests (a local server and client, in one reactor)
+***************************************************************************** */
+
+#define FIO___TEST_HTTP_POOL_URL "http://127.0.0.1:9761/"
+
+static struct {
+  fio___http_pool_s *pool;
+  fio_io_s *server[8]; /* server side connections (NULL once released) */
+  size_t server_count; /* connections accepted by the server */
+  size_t sent;
+  size_t finished;
+  int64_t deadline;
+  uint8_t stage;
+} FIO___TEST_HTTP_POOL;
+
+/* server side: records the connection and responds. */
+FIO_SFUNC void fio___test_http_pool_on_request(fio_http_s *h) {
+  fio_io_s *io = fio_http_io(h);
+  size_t i = 0;
+  while (i < FIO___TEST_HTTP_POOL.server_count &&
+         FIO___TEST_HTTP_POOL.server[i] != io)
+    ++i;
+  if (i == FIO___TEST_HTTP_POOL.server_count) {
+    FIO_ASSERT(i < 8, "HTTP pool test: too many server connections");
+    FIO___TEST_HTTP_POOL.server[i] = fio_io_dup(io);
+    ++FIO___TEST_HTTP_POOL.server_count;
+  }
+  fio_http_write(h, .buf = (char *)"pool", .len = 4, .finish = 1);
+}
+
+/* client side: validates the response and the pool's connection limit. */
+FIO_SFUNC void fio___test_http_pool_on_response(fio_http_s *h) {
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  FIO___TEST_HTTP_POOL.pool = c->state.http.pool;
+  FIO_ASSERT(fio_http_status(h) == 200 && fio_http_body_length(h) == 4,
+             "HTTP pool test: bad response");
+  FIO_ASSERT(c->state.http.pool && c->state.http.pool->open <= 2,
+             "HTTP pool test: pool_max exceeded (%u connections)",
+             (unsigned)(c->state.http.pool ? c->state.http.pool->open : 0));
+}
+
+FIO_SFUNC void fio___test_http_pool_on_finish(fio_http_s *h) {
+  FIO_ASSERT(fio_http_status(h), "HTTP pool test: request failed");
+  ++FIO___TEST_HTTP_POOL.finished;
+}
+
+FIO_SFUNC void fio___test_http_pool_send(size_t count) {
+  while (count--) {
+    ++FIO___TEST_HTTP_POOL.sent;
+    fio_http_connect(FIO___TEST_HTTP_POOL_URL,
+                     NULL,
+                     .on_http = fio___test_http_pool_on_response,
+                     .on_finish = fio___test_http_pool_on_finish,
+                     .pool_max = 2,
+                     .pool_max_idle = 1);
+  }
+}
+
+/* releases the server side connections (held connections delay shutdown) */
+FIO_SFUNC void fio___test_http_pool_server_release(int close) {
+  for (size_t i = 0; i < FIO___TEST_HTTP_POOL.server_count; ++i) {
+    if (!FIO___TEST_HTTP_POOL.server[i])
+      continue;
+    if (close)
+      fio_io_close(FIO___TEST_HTTP_POOL.server[i]);
+    fio_io_free(FIO___TEST_HTTP_POOL.server[i]);
+    FIO___TEST_HTTP_POOL.server[i] = NULL;
+  }
+}
+
+/* advances the test once the previous stage settled (a timer task). */
+FIO_SFUNC int fio___test_http_pool_step(void *ignr_1, void *ignr_2) {
+  fio___http_pool_s *pool = FIO___TEST_HTTP_POOL.pool;
+  (void)ignr_1, (void)ignr_2;
+  FIO_ASSERT(fio_time_milli() < FIO___TEST_HTTP_POOL.deadline,
+             "HTTP pool test timed out (stage %d)",
+             (int)FIO___TEST_HTTP_POOL.stage);
+  if (FIO___TEST_HTTP_POOL.finished < FIO___TEST_HTTP_POOL.sent)
+    return 0;
+  switch (FIO___TEST_HTTP_POOL.stage) {
+  case 0: /* reuse: sequential requests share a single connection */
+    if (FIO___TEST_HTTP_POOL.sent) {
+      if (pool->idle_count != 1)
+        return 0;
+      FIO_ASSERT(pool->open == 1 && FIO___TEST_HTTP_POOL.server_count == 1,
+                 "HTTP pool test: idle connection not reused");
+    }
+    if (FIO___TEST_HTTP_POOL.sent < 4) {
+      fio___test_http_pool_send(1);
+      return 0;
+    }
+    ++FIO___TEST_HTTP_POOL.stage;
+    /* limits: at most `pool_max` connections, the rest are queued */
+    fio___test_http_pool_send(6);
+    {
+      size_t queued = 0;
+      FIO_LIST_EACH(fio___http_pool_req_s, node, &pool->queue, r) {
+        ++queued;
+        (void)r;
+      }
+      FIO_ASSERT(pool->open == 2 && queued == 4 && !pool->idle_count,
+                 "HTTP pool test: pool_max should queue requests (%u, %zu)",
+                 (unsigned)pool->open,
+                 queued);
+    }
+    return 0;
+  case 1: /* `pool_max_idle` closes the connections it can't keep */
+    if (pool->open != 1)
+      return 0;
+    FIO_ASSERT(pool->idle_count == 1 &&
+                   FIO___TEST_HTTP_POOL.server_count == 2,
+               "HTTP pool test: pool_max_idle error");
+    ++FIO___TEST_HTTP_POOL.stage;
+    /* idle eviction: the server closes the idle connection */
+    fio___test_http_pool_server_release(1);
+    return 0;
+  case 2:
+    if (pool->open || pool->idle_count)
+      return 0;
+    ++FIO___TEST_HTTP_POOL.stage;
+    fio___test_http_pool_send(1); /* a new connection replaces the evicted */
+    return 0;
+  case 3:
+    if (pool->idle_count != 1)
+      return 0;
+    FIO_ASSERT(pool->open == 1 && FIO___TEST_HTTP_POOL.server_count == 3,
+               "HTTP pool test: evicted connection reused");
+    ++FIO___TEST_HTTP_POOL.stage;
+    fio___test_http_pool_server_release(0);
+    fio_io_stop();
+    return -1;
+  }
+  return -1;
+}
+
+FIO_SFUNC void fio___test_http_pool_on_start(void *ignr_) {
+  fio_io_run_every(.fn = fio___test_http_pool_step,
+                   .every = 5,
+                   .repetitions = -1);
+  (void)ignr_;
+}
+
+FIO_SFUNC void FIO_NAME_TEST(stl, http_client_pool)(void) {
+  fprintf(stderr, "* Testing HTTP client connection pool.\n");
+  int log_level = FIO_LOG_LEVEL;
+  void *listener;
+  FIO_LOG_LEVEL = FIO_LOG_LEVEL_WARNING;
+  listener = fio_http_listen(FIO___TEST_HTTP_POOL_URL,
+                             .on_http = fio___test_http_pool_on_request);
+  FIO_ASSERT(listener, "HTTP pool test: couldn't listen for connections");
+  FIO___TEST_HTTP_POOL.deadline = fio_time_milli() + 10000;
+  fio_state_callback_add(FIO_CALL_ON_START,
+                         fio___test_http_pool_on_start,
+                         NULL);
+  fio_io_start(0);
+  fio_state_callback_remove(FIO_CALL_ON_START,
+                            fio___test_http_pool_on_start,
+                            NULL);
+  FIO_ASSERT(FIO___TEST_HTTP_POOL.stage == 4,
+             "HTTP pool test: reactor stopped early (stage %d)",
+             (int)FIO___TEST_HTTP_POOL.stage);
+  fio_io_listen_stop(listener);
+  /* pools (and their pub/sub metadata callbacks) otherwise live until exit */
+  fio___http_pool_cleanup(NULL);
+  FIO_LOG_LEVEL = log_level;
+}
+
+/* *****************************************************************************
+HTTP Response Cache Tests (a local server and client, in one reactor)
+***************************************************************************** */
+
+#define FIO___TEST_HTTP_CACHE_URL "http://127.0.0.1:9762/"
+/* a listener without `cache_vary`, so compressed responses can't be cached */
+#define FIO___TEST_HTTP_CACHE_URL_NO_VARY "http://127.0.0.1:9763/"
+#define FIO___TEST_HTTP_CACHE_LIMIT       4096
+/* paths `/0` - `/15` test LRU eviction (they don't all fit in the cache) */
+#define FIO___TEST_HTTP_CACHE_LRU 16
+#if HAVE_ZLIB || HAVE_BROTLI
+#define FIO___TEST_HTTP_CACHE_COMPRESS 1
+#else
+#define FIO___TEST_HTTP_CACHE_COMPRESS 0
+#endif
+
+/* the request path is `/<slot>`, the server responds according to the slot */
+typedef enum {
+  FIO___TEST_HTTP_CACHE_TTL = FIO___TEST_HTTP_CACHE_LRU,
+  FIO___TEST_HTTP_CACHE_COOKIE,
+  FIO___TEST_HTTP_CACHE_NO_STORE,
+  FIO___TEST_HTTP_CACHE_VARY,
+  FIO___TEST_HTTP_CACHE_SLOW, /* answered once more requests wait for it */
+  FIO___TEST_HTTP_CACHE_ZIP,
+  FIO___TEST_HTTP_CACHE_SLOTS,
+} fio___test_http_cache_slot_e;
+
+static struct {
+  fio___http_cache_s *cache; /* the first listener's response cache */
+  fio_http_s *held;          /* the `SLOW` request, until answered */
+  size_t calls[FIO___TEST_HTTP_CACHE_SLOTS]; /* server side `on_http` calls */
+  size_t gen[FIO___TEST_HTTP_CACHE_SLOTS];   /* last `x-gen` the client got */
+  size_t zipped; /* compressed responses received by the client */
+  size_t sent;
+  size_t finished;
+  size_t lru; /* LRU requests sent */
+  int64_t expires;
+  int64_t deadline;
+  uint8_t stage;
+} FIO___TEST_HTTP_CACHE;
+
+FIO_SFUNC size_t fio___test_http_cache_slot(fio_http_s *h) {
+  fio_str_info_s path = fio_http_path(h);
+  char *pos = path.buf + 1;
+  size_t slot = 0;
+  if (path.len > 1)
+    slot = (size_t)fio_atol10u(&pos);
+  FIO_ASSERT(path.len > 1 && slot < FIO___TEST_HTTP_CACHE_SLOTS,
+             "HTTP cache test: unknown path");
+  return slot;
+}
+
+/* responds, `x-gen` counts the times `on_http` was called for the path. */
+FIO_SFUNC void fio___test_http_cache_respond(fio_http_s *h, size_t slot) {
+  char body[256];
+  size_t len = 128; /* shorter than `compress_min` */
+  FIO_STR_INFO_TMP_VAR(gen, 32);
+  fio_string_write_u(&gen, NULL, FIO___TEST_HTTP_CACHE.calls[slot]);
+  fio_http_response_header_set(h, FIO_STR_INFO2((char *)"x-gen", 5), gen);
+  if (slot == FIO___TEST_HTTP_CACHE_ZIP) {
+    len = 256;
+    fio_http_response_header_set(h,
+                                 FIO_STR_INFO2((char *)"content-type", 12),
+                                 FIO_STR_INFO2((char *)"text/plain", 10));
+  }
+  FIO_MEMSET(body, 'a' + (char)(slot & 15), len);
+  fio_http_write(h, .buf = body, .len = len, .copy = 1, .finish = 1);
+}
+
+/* server side: counts `on_http` calls (cached responses skip it). */
+FIO_SFUNC void fio___test_http_cache_on_request(fio_http_s *h) {
+  size_t slot = fio___test_http_cache_slot(h);
+  ++FIO___TEST_HTTP_CACHE.calls[slot];
+  switch ((fio___test_http_cache_slot_e)slot) {
+  case FIO___TEST_HTTP_CACHE_COOKIE:
+    fio_http_cookie_set(h,
+                        .name = FIO_STR_INFO2((char *)"id", 2),
+                        .value = FIO_STR_INFO2((char *)"1", 1));
+    break;
+  case FIO___TEST_HTTP_CACHE_NO_STORE:
+    fio_http_response_header_set(h,
+                                 FIO_STR_INFO2((char *)"cache-control", 13),
+                                 FIO_STR_INFO2((char *)"no-store", 8));
+    break;
+  case FIO___TEST_HTTP_CACHE_VARY:
+    fio_http_response_header_set(h,
+                                 FIO_STR_INFO2((char *)"vary", 4),
+                                 FIO_STR_INFO2((char *)"user-agent", 10));
+    break;
+  case FIO___TEST_HTTP_CACHE_SLOW:
+    FIO_ASSERT(!FIO___TEST_HTTP_CACHE.held,
+               "HTTP cache test: concurrent requests weren't coalesced");
+    FIO___TEST_HTTP_CACHE.held = fio_http_dup(h);
+    return;
+  default: break;
+  }
+  fio___test_http_cache_respond(h, slot);
+}
+
+FIO_SFUNC void fio___test_http_cache_on_request_main(fio_http_s *h) {
+  FIO___TEST_HTTP_CACHE.cache =
+      fio___http_cache((fio___http_connection_s *)fio_http_cdata(h));
+  fio___test_http_cache_on_request(h);
+}
+
+/* client side: records the response's generation and content encoding. */
+FIO_SFUNC void fio___test_http_cache_on_response(fio_http_s *h) {
+  size_t slot = fio___test_http_cache_slot(h);
+  fio_str_info_s gen =
+      fio_http_response_header(h, FIO_STR_INFO2((char *)"x-gen", 5), 0);
+  FIO_ASSERT(fio_http_status(h) == 200 && gen.len,
+             "HTTP cache test: bad response");
+  FIO___TEST_HTTP_CACHE.gen[slot] = (size_t)fio_atol10u(&gen.buf);
+  FIO___TEST_HTTP_CACHE.zipped +=
+      !!fio_http_response_header(h,
+                                 FIO_STR_INFO2((char *)"content-encoding", 16),
+                                 0)
+            .len;
+}
+
+FIO_SFUNC void fio___test_http_cache_on_finish(fio_http_s *h) {
+  FIO_ASSERT(fio_http_status(h), "HTTP cache test: request failed");
+  ++FIO___TEST_HTTP_CACHE.finished;
+}
+
+FIO_SFUNC void fio___test_http_cache_send(const char *url,
+                                          size_t slot,
+                                          int zip) {
+  fio_http_s *h = fio_http_new();
+  FIO_STR_INFO_TMP_VAR(path, 32);
+  fio_string_write2(&path,
+                    NULL,
+                    FIO_STRING_WRITE_STR2("/", 1),
+                    FIO_STRING_WRITE_UNUM(slot));
+  fio_http_path_set(h, path);
+  if (zip)
+    fio_http_request_header_set(h,
+                                FIO_STR_INFO2((char *)"accept-encoding", 15),
+                                FIO_STR_INFO2((char *)"gzip, br", 8));
+  ++FIO___TEST_HTTP_CACHE.sent;
+  fio_http_connect(url,
+                   h,
+                   .on_http = fio___test_http_cache_on_response,
+                   .on_finish = fio___test_http_cache_on_finish);
+}
+
+/* tests the server's `on_http` calls and the last response's generation. */
+FIO_SFUNC void fio___test_http_cache_expect(size_t slot,
+                                            size_t calls,
+                                            const char *msg) {
+  FIO_ASSERT(FIO___TEST_HTTP_CACHE.calls[slot] == calls &&
+                 FIO___TEST_HTTP_CACHE.gen[slot] == calls,
+             "HTTP cache test: %s (path /%zu: %zu calls, generation %zu)",
+             msg,
+             slot,
+             FIO___TEST_HTTP_CACHE.calls[slot],
+             FIO___TEST_HTTP_CACHE.gen[slot]);
+}
+
+/* answers the held `SLOW` request once two more requests wait for it. */
+FIO_SFUNC int fio___test_http_cache_release_held(void) {
+  fio_http_s *h = FIO___TEST_HTTP_CACHE.held;
+  fio___http_connection_s *c = (fio___http_connection_s *)fio_http_cdata(h);
+  fio___http_cache_entry_s *e = c->state.http.cache;
+  size_t waiting = 0;
+  FIO_ASSERT(e && !c->state.http.cache_hit,
+             "HTTP cache test: the response isn't recorded");
+  FIO_LIST_EACH(fio___http_cache_waiting_s, node, &e->waiting, w) {
+    ++waiting;
+    (void)w;
+  }
+  if (waiting < 2)
+    return -1;
+  FIO___TEST_HTTP_CACHE.held = NULL;
+  fio___test_http_cache_respond(h, FIO___TEST_HTTP_CACHE_SLOW);
+  fio_http_free(h);
+  return 0;
+}
+
+/* advances the test once the previous stage settled (a timer task). */
+FIO_SFUNC int fio___test_http_cache_step(void *ignr_1, void *ignr_2) {
+  fio___http_cache_s *cache = FIO___TEST_HTTP_CACHE.cache;
+  (void)ignr_1, (void)ignr_2;
+  FIO_ASSERT(fio_time_milli() < FIO___TEST_HTTP_CACHE.deadline,
+             "HTTP cache test timed out (stage %d)",
+             (int)FIO___TEST_HTTP_CACHE.stage);
+  if (FIO___TEST_HTTP_CACHE.held && fio___test_http_cache_release_held())
+    return 0;
+  if (FIO___TEST_HTTP_CACHE.finished < FIO___TEST_HTTP_CACHE.sent)
+    return 0;
+  switch (FIO___TEST_HTTP_CACHE.stage++) {
+  case 0: /* TTL: cached until `cache_ttl` expires */
+    fio___test_http_cache_send(FIO___TEST_HTTP_CACHE_URL,
+                               FIO___TEST_HTTP_CACHE_TTL,
+                               0);
+    return 0;
+  case 1:
+    fio___test_http_cache_expect(FIO___TEST_HTTP_CACHE_TTL, 1, "TTL error");
+    FIO___TEST_HTTP_CACHE.expires = fio_time_milli() + 1000;
+    fio___test_http_cache_send(FIO___TEST_HTTP_CACHE_URL,
+                               FIO___TEST_HTTP_CACHE_TTL,
+                               0);
+    return 0;
+  case 2:
+    fio___test_http_cache_expect(FIO___TEST_HTTP_CACHE_TTL,
+                                 1,
+                                 "response not cached");
+    return 0;
+  case 3:
+    if (fio_time_milli() <= FIO___TEST_HTTP_CACHE.expires) {
+      --FIO___TEST_HTTP_CACHE.stage;
+      return 0;
+    }
+    fio___test_http_cache_send(FIO___TEST_HTTP_CACHE_URL,
+                               FIO___TEST_HTTP_CACHE_TTL,
+                               0);
+    return 0;
+  case 4:
+    fio___test_http_cache_expect(FIO___TEST_HTTP_CACHE_TTL,
+                                 2,
+                                 "expired response sent");
+    /* "pass" entries: responses a shared cache can't store */
+    for (size_t i = FIO___TEST_HTTP_CACHE_COOKIE;
+         i <= FIO___TEST_HTTP_CACHE_VARY;
+         ++i)
+      fio___test_http_cache_send(FIO___TEST_HTTP_CACHE_URL, i, 0);
+    return 0;
+  case 5:
+    for (size_t i = FIO___TEST_HTTP_CACHE_COOKIE;
+         i <= FIO___TEST_HTTP_CACHE_VARY;
+         ++i) {
+      fio___test_http_cache_expect(i, 1, "pass entry error");
+      fio___test_http_cache_send(FIO___TEST_HTTP_CACHE_URL, i, 0);
+    }
+    return 0;
+  case 6: {
+    size_t pass = 0;
+    for (size_t i = FIO___TEST_HTTP_CACHE_COOKIE;
+         i <= FIO___TEST_HTTP_CACHE_VARY;
+         ++i)
+      fio___test_http_cache_expect(i, 2, "non-cacheable response cached");
+    FIO_MAP_EACH(fio___http_cache_map, &cache->map, i) {
+      pass += i.value->pass;
+    }
+    FIO_ASSERT(pass == 3,
+               "HTTP cache test: expected 3 pass entries, found %zu",
+               pass);
+  }
+    /* coalescing: concurrent requests wait for the first response */
+    for (size_t i = 0; i < 3; ++i)
+      fio___test_http_cache_send(FIO___TEST_HTTP_CACHE_URL,
+                                 FIO___TEST_HTTP_CACHE_SLOW,
+                                 0);
+    return 0;
+  case 7:
+    fio___test_http_cache_expect(FIO___TEST_HTTP_CACHE_SLOW,
+                                 1,
+                                 "requests weren't coalesced");
+    if (!FIO___TEST_HTTP_CACHE_COMPRESS) {
+      FIO___TEST_HTTP_CACHE.stage = 14;
+      return 0;
+    }
+    /* compression: `accept-encoding` is part of the key (`cache_vary`) */
+    fio___test_http_cache_send(FIO___TEST_HTTP_CACHE_URL,
+                               FIO___TEST_HTTP_CACHE_ZIP,
+                               1);
+    return 0;
+  case 8:
+    fio___test_http_cache_expect(FIO___TEST_HTTP_CACHE_ZIP, 1, "zip error");
+    fio___test_http_cache_send(FIO___TEST_HTTP_CACHE_URL,
+                               FIO___TEST_HTTP_CACHE_ZIP,
+                               1);
+    return 0;
+  case 9:
+    fio___test_http_cache_expect(FIO___TEST_HTTP_CACHE_ZIP,
+                                 1,
+                                 "compressed response not cached");
+    FIO_ASSERT(FIO___TEST_HTTP_CACHE.zipped == 2,
+               "HTTP cache test: cached response should be compressed");
+    fio___test_http_cache_send(FIO___TEST_HTTP_CACHE_URL,
+                               FIO___TEST_HTTP_CACHE_ZIP,
+                               0);
+    return 0;
+  case 10:
+    fio___test_http_cache_expect(FIO___TEST_HTTP_CACHE_ZIP,
+                                 2,
+                                 "compressed response sent as identity");
+    fio___test_http_cache_send(FIO___TEST_HTTP_CACHE_URL,
+                               FIO___TEST_HTTP_CACHE_ZIP,
+                               0);
+    return 0;
+  case 11:
+    fio___test_http_cache_expect(FIO___TEST_HTTP_CACHE_ZIP,
+                                 2,
+                                 "identity response not cached");
+    FIO_ASSERT(FIO___TEST_HTTP_CACHE.zipped == 2,
+               "HTTP cache test: identity response compressed");
+    /* without `cache_vary`, `vary: accept-encoding` leaves a "pass" entry */
+    fio___test_http_cache_send(FIO___TEST_HTTP_CACHE_URL_NO_VARY,
+                               FIO___TEST_HTTP_CACHE_ZIP,
+                               1);
+    return 0;
+  case 12:
+    fio___test_http_cache_expect(FIO___TEST_HTTP_CACHE_ZIP, 3, "zip error");
+    fio___test_http_cache_send(FIO___TEST_HTTP_CACHE_URL_NO_VARY,
+                               FIO___TEST_HTTP_CACHE_ZIP,
+                               1);
+    return 0;
+  case 13:
+    fio___test_http_cache_expect(FIO___TEST_HTTP_CACHE_ZIP,
+                                 4,
+                                 "`vary` ignored for compressed response");
+    FIO_ASSERT(FIO___TEST_HTTP_CACHE.zipped == 4,
+               "HTTP cache test: response should be compressed");
+    return 0;
+  case 14: /* LRU: the cache evicts the least recently used responses */
+    if (FIO___TEST_HTTP_CACHE.lru < FIO___TEST_HTTP_CACHE_LRU) {
+      --FIO___TEST_HTTP_CACHE.stage;
+      fio___test_http_cache_send(FIO___TEST_HTTP_CACHE_URL,
+                                 FIO___TEST_HTTP_CACHE.lru++,
+                                 0);
+      return 0;
+    }
+    FIO_ASSERT(cache->mem <= cache->limit,
+               "HTTP cache test: cache_limit exceeded (%zu bytes)",
+               cache->mem);
+    fio___test_http_cache_send(FIO___TEST_HTTP_CACHE_URL,
+                               FIO___TEST_HTTP_CACHE_LRU - 1,
+                               0);
+    return 0;
+  case 15:
+    fio___test_http_cache_expect(FIO___TEST_HTTP_CACHE_LRU - 1,
+                                 1,
+                                 "recently used response evicted");
+    fio___test_http_cache_send(FIO___TEST_HTTP_CACHE_URL, 0, 0);
+    return 0;
+  case 16:
+    fio___test_http_cache_expect(0, 2, "cache_limit ignored");
+    fio_io_stop();
+    return -1;
+  }
+  return -1;
+}
+
+FIO_SFUNC void fio___test_http_cache_on_start(void *ignr_) {
+  fio_io_run_every(.fn = fio___test_http_cache_step,
+                   .every = 5,
+                   .repetitions = -1);
+  (void)ignr_;
+}
+
+FIO_SFUNC void FIO_NAME_TEST(stl, http_cache)(void) {
+  fprintf(stderr, "* Testing HTTP response cache.\n");
+  int log_level = FIO_LOG_LEVEL;
+  void *listeners[2];
+  FIO_LOG_LEVEL = FIO_LOG_LEVEL_WARNING;
+  listeners[0] =
+      fio_http_listen(FIO___TEST_HTTP_CACHE_URL,
+                      .on_http = fio___test_http_cache_on_request_main,
+                      .cache_vary = FIO_STR_INFO1((char *)"accept-encoding"),
+                      .cache_limit = FIO___TEST_HTTP_CACHE_LIMIT,
+                      .compress_min = 200,
+                      .cache_ttl = 1,
+                      .compress = FIO___TEST_HTTP_CACHE_COMPRESS);
+  listeners[1] = fio_http_listen(FIO___TEST_HTTP_CACHE_URL_NO_VARY,
+                                 .on_http = fio___test_http_cache_on_request,
+                                 .compress_min = 200,
+                                 .cache_ttl = 1,
+                                 .compress = FIO___TEST_HTTP_CACHE_COMPRESS);
+  FIO_ASSERT(listeners[0] && listeners[1],
+             "HTTP cache test: couldn't listen for connections");
+  FIO___TEST_HTTP_CACHE.deadline = fio_time_milli() + 10000;
+  fio_state_callback_add(FIO_CALL_ON_START,
+                         fio___test_http_cache_on_start,
+                         NULL);
+  fio_io_start(0);
+  fio_state_callback_remove(FIO_CALL_ON_START,
+                            fio___test_http_cache_on_start,
+                            NULL);
+  FIO_ASSERT(FIO___TEST_HTTP_CACHE.stage == 17,
+             "HTTP cache test: reactor stopped early (stage %d)",
+             (int)FIO___TEST_HTTP_CACHE.stage);
+  fio_io_listen_stop(listeners[0]);
+  fio_io_listen_stop(listeners[1]);
+  FIO_LOG_LEVEL = log_level;
+}
+
+/* *****************************************************************************
+Cleanup
+***************************************************************************** */
+#endif /* FIO_TEST_ALL */
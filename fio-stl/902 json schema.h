@@ -0,0 +1,289 @@
+/* ************************************************************************* */
+#if !defined(FIO_INCLUDE_FILE) /* Dev test - ignore line */
+#define FIO___DEV___           /* Development inclusion - ignore line */
+#define FIO_TEST_ALL           /* Development inclusion - ignore line */
+#include "./include.h"         /* Development inclusion - ignore line */
+#endif                         /* Development inclusion - ignore line */
+/* *****************************************************************************
+
+
+
+
+                        FIO_JSON_SCHEMA Test Helper
+
+
+
+
+Copyright and License: see header file (000 copyright.h) or top of file
+***************************************************************************** */
+#if defined(FIO_TEST_ALL) && !defined(FIO___TEST_REINCLUDE) &&                 \
+    !defined(H___FIO_JSON_SCHEMA_TEST___H)
+#define H___FIO_JSON_SCHEMA_TEST___H
+
+typedef struct {
+  double x;
+  double y;
+} fio___test_json_point_s;
+
+typedef struct {
+  int64_t id;
+  int32_t small;
+  uint16_t port;
+  uint8_t active;
+  float ratio;
+  double price;
+  char name[16];
+  char *note;
+  fio___test_json_point_s origin;
+  int64_t answer;
+  char *greeting;
+} fio___test_json_msg_s;
+
+#define FIO___TEST_REINCLUDE
+#define FIO_JSON_SCHEMA_NAME   fio___test_json_point
+#define FIO_JSON_SCHEMA_TYPE   fio___test_json_point_s
+#define FIO_JSON_SCHEMA_STRICT 1
+#define FIO_JSON_SCHEMA_FIELDS(FIELD)                                          \
+  FIELD(x, FIO_JSON_FIELD_FLOAT, .required = 1)                                \
+  FIELD(y, FIO_JSON_FIELD_FLOAT, .def.f = -1.5)
+#include FIO_INCLUDE_FILE
+
+#define FIO_JSON_SCHEMA_NAME fio___test_json_msg
+#define FIO_JSON_SCHEMA_TYPE fio___test_json_msg_s
+#define FIO_JSON_SCHEMA_FIELDS(FIELD)                                          \
+  FIELD(id, FIO_JSON_FIELD_INT, .required = 1)                                 \
+  FIELD(small, FIO_JSON_FIELD_INT)                                             \
+  FIELD(port, FIO_JSON_FIELD_UINT)                                             \
+  FIELD(active, FIO_JSON_FIELD_BOOL)                                           \
+  FIELD(ratio, FIO_JSON_FIELD_FLOAT)                                           \
+  FIELD(price, FIO_JSON_FIELD_FLOAT)                                           \
+  FIELD(name, FIO_JSON_FIELD_STR)                                              \
+  FIELD(note, FIO_JSON_FIELD_BSTR)                                             \
+  FIELD(origin, FIO_JSON_FIELD_OBJ(fio___test_json_point))                     \
+  FIELD(answer, FIO_JSON_FIELD_INT, .key = "the-answer", .def.i = 42)          \
+  FIELD(greeting, FIO_JSON_FIELD_BSTR, .def.s = "hello")
+#include FIO_INCLUDE_FILE
+#undef FIO___TEST_REINCLUDE
+
+/* parses a JSON object using a (lazily prepared) runtime schema */
+typedef struct {
+  fio_json_schema_s *schema;
+  fio_str_info_s json;
+  int64_t values[FIO_JSON_SCHEMA_MAX_FIELDS];
+  int result;
+} fio___test_json_schema_task_s;
+
+FIO_SFUNC void *fio___test_json_schema_task(void *task_) {
+  fio___test_json_schema_task_s *task = (fio___test_json_schema_task_s *)task_;
+  task->result =
+      fio_json_schema_parse(task->schema, task->values, task->json, NULL);
+  return NULL;
+}
+
+FIO_SFUNC void FIO_NAME_TEST(stl, json_schema)(void) {
+  fprintf(stderr, "* Testing JSON schemas (JSON to / from C structs).\n");
+  fio___test_json_msg_s m, m2;
+  char buf[1024];
+  fio_str_info_s out = FIO_STR_INFO3(buf, 0, sizeof(buf));
+  size_t consumed = 0;
+  fio___test_json_msg_init(&m);
+  fio___test_json_msg_init(&m2);
+  FIO_ASSERT(!m.id && !m.note && m.answer == 42 && m.origin.y == -1.5 &&
+                 m.greeting && !strcmp(m.greeting, "hello") && !m.name[0],
+             "JSON schema init error");
+  { /* a full message (long enough for the structural index parser) */
+    const char *json = "{\"id\": 9007199254740993, \"small\": -2147483648, "
+                       "\"port\": 65535, \"active\": true, \"ratio\": 0.5, "
+                       "\"unknown\": [1, {\"id\": 2}, [\"x\"]], "
+                       "\"price\": 12, \"na\\u006De\": \"\\u00e9t\\u00e9\", "
+                       "\"note\": \"line\\nbreak\", \"skip\": {\"x\": {}}, "
+                       "\"origin\": {\"x\": 1.25, \"y\": -3}, "
+                       "\"greeting\": null}  ";
+    FIO_ASSERT(FIO_STRLEN(json) >= 128, "test JSON should be indexed");
+    FIO_ASSERT(!fio___test_json_msg_parse(&m, FIO_STR_INFO1((char *)json), 0),
+               "JSON schema parsing failed");
+    FIO_ASSERT(m.id == 9007199254740993LL && m.small == INT32_MIN &&
+                   m.port == 65535 && m.active == 1 && m.ratio == 0.5 &&
+                   m.price == 12.0 && m.origin.x == 1.25 &&
+                   m.origin.y == -3.0 && m.answer == 42 &&
+                   !strcmp(m.greeting, "hello"),
+               "JSON schema parsing value error");
+    FIO_ASSERT(!strcmp(m.name, "\xC3\xA9t\xC3\xA9"),
+               "JSON schema escaped String / key error: %s",
+               m.name);
+    FIO_ASSERT(m.note && !strcmp(m.note, "line\nbreak") &&
+                   fio_bstr_len(m.note) == 10,
+               "JSON schema fio_bstr field error");
+  }
+  { /* writing and round-trip */
+    FIO_ASSERT(!fio___test_json_msg_write(&out, NULL, &m),
+               "JSON schema writing failed (buffer too short?)");
+    FIO_ASSERT(!strcmp(out.buf,
+                       "{\"id\":9007199254740993,\"small\":-2147483648,"
+                       "\"port\":65535,\"active\":true,\"ratio\":0.5,"
+                       "\"price\":12.0,\"name\":\"\xC3\xA9t\xC3\xA9\","
+                       "\"note\":\"line\\nbreak\","
+                       "\"origin\":{\"x\":1.25,\"y\":-3.0},"
+                       "\"the-answer\":42,\"greeting\":\"hello\"}"),
+               "JSON schema output error:\n%s",
+               out.buf);
+    FIO_ASSERT(!fio___test_json_msg_parse(&m2, out, &consumed) &&
+                   consumed == out.len,
+               "JSON schema round-trip parsing failed");
+    FIO_ASSERT(m2.id == m.id && m2.small == m.small && m2.port == m.port &&
+                   m2.active == m.active && m2.ratio == m.ratio &&
+                   m2.price == m.price && !strcmp(m2.name, m.name) &&
+                   !strcmp(m2.note, m.note) &&
+                   m2.origin.x == m.origin.x && m2.origin.y == m.origin.y &&
+                   m2.answer == m.answer && !strcmp(m2.greeting, "hello"),
+               "JSON schema round-trip error");
+    /* writing using a reallocation callback */
+    char *bstr = NULL;
+    fio_str_info_s i = fio_bstr_info(bstr);
+    FIO_ASSERT(!fio___test_json_msg_write(&i, fio_bstr_reallocate, &m),
+               "JSON schema writing (with reallocation) failed");
+    bstr = fio_bstr_len_set(i.buf, i.len);
+    FIO_ASSERT(FIO_BUF_INFO_IS_EQ(fio_bstr_buf(bstr), FIO_STR2BUF_INFO(out)),
+               "JSON schema writing (with reallocation) error");
+    fio_bstr_free(bstr);
+    /* NULL `fio_bstr` fields are written as `null` */
+    fio_bstr_free(m2.greeting);
+    m2.greeting = NULL;
+    out = FIO_STR_INFO3(buf, 0, sizeof(buf));
+    FIO_ASSERT(!fio___test_json_msg_write(&out, NULL, &m2) &&
+                   !FIO_MEMCMP(out.buf + out.len - 16,
+                               "\"greeting\":null}",
+                               16),
+               "JSON schema NULL String output error:\n%s",
+               out.buf);
+    /* a short buffer truncates the output */
+    out = FIO_STR_INFO3(buf, 0, 16);
+    FIO_ASSERT(fio___test_json_msg_write(&out, NULL, &m) && out.len == 15,
+               "JSON schema writing should fail for short buffers");
+  }
+  { /* missing fields, duplicate keys, `null` values and bstr reuse */
+    const char *json = "{\"id\":1,\"the-answer\":7,\"origin\":{\"x\":1},"
+                       "\"origin\":{\"x\":2},\"the-answer\":null,"
+                       "\"note\":\"a\"}";
+    FIO_ASSERT(!fio___test_json_msg_parse(&m, FIO_STR_INFO1((char *)json), 0),
+               "JSON schema parsing failed (defaults)");
+    FIO_ASSERT(m.id == 1 && !m.small && !m.port && !m.active && !m.ratio &&
+                   !m.price && !m.name[0] && m.origin.x == 2.0 &&
+                   m.origin.y == -1.5 && m.answer == 42 &&
+                   !strcmp(m.greeting, "hello") && !strcmp(m.note, "a"),
+               "JSON schema default values error");
+  }
+  { /* errors */
+    const char *errors[] = {
+        "{\"small\":1}",                   /* missing required field */
+        "{\"id\":1,\"origin\":{\"y\":1}}", /* missing required (nested) */
+        "{\"id\":\"1\"}",                  /* type mismatch */
+        "{\"id\":1.5}",                    /* type mismatch */
+        "{\"id\":1,\"active\":1}",         /* type mismatch */
+        "{\"id\":1,\"name\":1}",           /* type mismatch */
+        "{\"id\":1,\"origin\":[1,2]}",     /* type mismatch */
+        "{\"id\":1,\"price\":{}}",         /* type mismatch */
+        "{\"id\":1,\"small\":2147483648}", /* out of range */
+        "{\"id\":1,\"port\":65536}",       /* out of range */
+        "{\"id\":1,\"port\":-1}",          /* out of range */
+        "{\"id\":1,\"name\":\"0123456789abcdef\"}", /* String too long */
+        "{\"id\":1,\"origin\":{\"x\":1,\"z\":1}}",  /* strict schema */
+        "{\"id\":1",                                /* incomplete */
+        "[{\"id\":1}]",                             /* not an object */
+        "1",                                        /* not an object */
+        "",                                         /* no data */
+        NULL,
+    };
+    for (size_t i = 0; errors[i]; ++i) {
+      FIO_ASSERT(fio___test_json_msg_parse(&m,
+                                           FIO_STR_INFO1((char *)errors[i]),
+                                           NULL),
+                 "JSON schema parsing should have failed for: %s",
+                 errors[i]);
+    }
+    FIO_ASSERT(!fio___test_json_msg_parse(
+                   &m,
+                   FIO_STR_INFO1((char *)"{\"id\":1,\"name\":"
+                                         "\"0123456789abcde\"}"),
+                   NULL) &&
+                   !strcmp(m.name, "0123456789abcde"),
+               "JSON schema parsing failed for a String that fits");
+  }
+  { /* perfect hash key dispatch, using a 64 field schema */
+    fio_json_schema_field_s fields[FIO_JSON_SCHEMA_MAX_FIELDS];
+    char names[FIO_JSON_SCHEMA_MAX_FIELDS][8];
+    int64_t values[FIO_JSON_SCHEMA_MAX_FIELDS];
+    char *json = NULL;
+    for (size_t i = 0; i < FIO_JSON_SCHEMA_MAX_FIELDS; ++i) {
+      snprintf(names[i], sizeof(names[i]), "f%zu", i);
+      fields[i] = (fio_json_schema_field_s){
+          .name = names[i],
+          .offset = sizeof(values[0]) * i,
+          .size = sizeof(values[0]),
+          .type = FIO_JSON_SCHEMA_INT,
+          .required = 1,
+      };
+    }
+    fio_json_schema_s schema = {
+        .fields = fields,
+        .count = FIO_JSON_SCHEMA_MAX_FIELDS,
+        .strict = 1,
+    };
+    fio_json_schema_prepare(&schema);
+    FIO_ASSERT(schema.bits, "JSON schema perfect hash not found");
+    json = fio_bstr_write(json, "{", 1);
+    for (size_t i = FIO_JSON_SCHEMA_MAX_FIELDS; i--;)
+      json = fio_bstr_write2(json,
+                             FIO_STRING_WRITE_STR1("\""),
+                             FIO_STRING_WRITE_STR1(names[i]),
+                             FIO_STRING_WRITE_STR1("\":"),
+                             FIO_STRING_WRITE_NUM(i * 3),
+                             FIO_STRING_WRITE_STR1((i ? "," : "}")));
+    FIO_ASSERT(!fio_json_schema_parse(&schema, values, fio_bstr_info(json), 0),
+               "JSON schema (64 fields) parsing failed");
+    for (size_t i = 0; i < FIO_JSON_SCHEMA_MAX_FIELDS; ++i)
+      FIO_ASSERT(values[i] == (int64_t)(i * 3),
+                 "JSON schema (64 fields) value error at %zu",
+                 i);
+    { /* threads racing to prepare a hand declared schema */
+      fio_json_schema_s lazy = {
+          .fields = fields,
+          .count = FIO_JSON_SCHEMA_MAX_FIELDS,
+          .strict = 1,
+      };
+      fio_thread_t threads[4];
+      fio___test_json_schema_task_s tasks[4];
+      for (size_t i = 0; i < 4; ++i) {
+        tasks[i] = (fio___test_json_schema_task_s){
+            .schema = &lazy,
+            .json = fio_bstr_info(json),
+            .result = -1,
+        };
+        FIO_ASSERT(!fio_thread_create(threads + i,
+                                      fio___test_json_schema_task,
+                                      tasks + i),
+                   "couldn't start a JSON schema test thread");
+      }
+      for (size_t i = 0; i < 4; ++i) {
+        fio_thread_join(threads + i);
+        FIO_ASSERT(!tasks[i].result &&
+                       tasks[i].values[FIO_JSON_SCHEMA_MAX_FIELDS - 1] ==
+                           (int64_t)((FIO_JSON_SCHEMA_MAX_FIELDS - 1) * 3),
+                   "JSON schema lazy preparation failed (thread %zu)",
+                   i);
+      }
+      FIO_ASSERT(lazy.ready && lazy.bits == schema.bits &&
+                     lazy.seed == schema.seed,
+                 "JSON schema lazy preparation error");
+    }
+    fio_bstr_free(json);
+  }
+  fio___test_json_msg_destroy(&m);
+  fio___test_json_msg_destroy(&m2);
+  FIO_ASSERT(!m.note && !m.greeting, "JSON schema destroy error");
+}
+
+/* *****************************************************************************
+Cleanup
+***************************************************************************** */
+#endif /* FIO_TEST_ALL */
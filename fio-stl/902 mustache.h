@@ -26,6 +26,49 @@ Copyright and License: see header file (000 copyright.h) or top of file
 // #undef FIO___TEST_REINCLUDE
 // #endif
 
+/* a minimal context: entry 0 is the root context, the rest are values. */
+typedef struct {
+  const char *name;
+  const char *value;
+} fio___test_mustache_var_s;
+static fio___test_mustache_var_s fio___test_mustache_vars[] = {
+    {"", ""},
+    {"tag", "<b>"},
+    {"this_one", "1 & 2"},
+    {"flag", "yes"},
+    {NULL, NULL}};
+static size_t fio___test_mustache_hashed_calls;
+
+FIO_SFUNC uint64_t fio___test_mustache_hash(fio_buf_info_s name) {
+  return fio_risky_hash(name.buf, name.len, 0);
+}
+FIO_SFUNC uint64_t fio___test_mustache_hash2(fio_buf_info_s name) {
+  return fio_risky_hash(name.buf, name.len, 1);
+}
+FIO_SFUNC void *fio___test_mustache_get_var(void *ctx, fio_buf_info_s name) {
+  if (ctx != (void *)fio___test_mustache_vars)
+    return NULL;
+  for (size_t i = 1; fio___test_mustache_vars[i].name; ++i)
+    if (FIO_BUF_INFO_IS_EQ(
+            name,
+            FIO_BUF_INFO1((char *)fio___test_mustache_vars[i].name)))
+      return (void *)(fio___test_mustache_vars + i);
+  return NULL;
+}
+FIO_SFUNC void *fio___test_mustache_get_var_hashed(void *ctx,
+                                                   fio_buf_info_s name,
+                                                   uint64_t hash) {
+  ++fio___test_mustache_hashed_calls;
+  FIO_ASSERT(hash == fio___test_mustache_hash(name),
+             "bound hash value error for %.*s",
+             (int)name.len,
+             name.buf);
+  return fio___test_mustache_get_var(ctx, name);
+}
+FIO_SFUNC fio_buf_info_s fio___test_mustache_var2str(void *var) {
+  return FIO_BUF_INFO1((char *)((fio___test_mustache_var_s *)var)->value);
+}
+
 FIO_SFUNC void FIO_NAME_TEST(stl, mustache)(void) {
   fprintf(stderr, "* Testing mustache template parser.\n");
   char *example1 = (char *)"This is a {{tag}}, and so is {{ this_one }}.";
@@ -45,6 +88,174 @@ FIO_SFUNC void FIO_NAME_TEST(stl, mustache)(void) {
   m = fio_mustache_load(.data = FIO_BUF_INFO1(example2));
   FIO_ASSERT(!m, "invalid example load returned an object.");
   fio_mustache_free(m);
+
+  fprintf(stderr, "* Testing mustache template binding and iov output.\n");
+  {
+    char *example3 =
+        (char *)"{{#flag}}[{{tag}}]{{/flag}}{{^missing}} {{{this_one}}} "
+                "{{this_one}}{{/missing}}{{a.b}}.";
+    fio_buf_info_s expected =
+        FIO_BUF_INFO1((char *)"[&lt;b&gt;] 1 & 2 1 &amp; 2.");
+    fio_mustache_bargs_s args = {
+        .get_var = fio___test_mustache_get_var,
+        .var2str = fio___test_mustache_var2str,
+        .var_hash = fio___test_mustache_hash,
+        .get_var_hashed = fio___test_mustache_get_var_hashed,
+        .ctx = (void *)fio___test_mustache_vars,
+    };
+    m = fio_mustache_load(.data = FIO_BUF_INFO1(example3));
+    FIO_ASSERT(m, "valid example load failed!");
+    fio___test_mustache_hashed_calls = 0;
+    result = (char *)fio_mustache_build FIO_NOOP(m, args);
+    FIO_ASSERT(FIO_BUF_INFO_IS_EQ(fio_bstr_buf(result), expected),
+               "unbound template result error: %s",
+               result);
+    FIO_ASSERT(!fio___test_mustache_hashed_calls,
+               "get_var_hashed called for an unbound template");
+    fio_bstr_free(result);
+
+    fio_mustache_bind(m, fio___test_mustache_hash);
+    result = (char *)fio_mustache_build FIO_NOOP(m, args);
+    FIO_ASSERT(FIO_BUF_INFO_IS_EQ(fio_bstr_buf(result), expected),
+               "bound template result error: %s",
+               result);
+    FIO_ASSERT(fio___test_mustache_hashed_calls,
+               "get_var_hashed wasn't called for a bound template");
+    fio_bstr_free(result);
+
+    fio___test_mustache_hashed_calls = 0;
+    args.var_hash = fio___test_mustache_hash2;
+    result = (char *)fio_mustache_build FIO_NOOP(m, args);
+    FIO_ASSERT(FIO_BUF_INFO_IS_EQ(fio_bstr_buf(result), expected),
+               "template result error (hash function mismatch): %s",
+               result);
+    FIO_ASSERT(!fio___test_mustache_hashed_calls,
+               "get_var_hashed called with a mismatched hash function");
+    fio_bstr_free(result);
+    args.var_hash = fio___test_mustache_hash;
+
+    fio_mustache_iov_s iov = {0};
+    for (size_t round = 0; round < 2; ++round) {
+      size_t count = fio_mustache_build_iov FIO_NOOP(m, &iov, args);
+      FIO_ASSERT(count && count == iov.count && iov.len == expected.len,
+                 "fio_mustache_build_iov count / length error (%zu / %zu)",
+                 count,
+                 iov.len);
+      result = NULL;
+      size_t referenced = 0;
+      for (size_t i = 0; i < iov.count; ++i) {
+        result = fio_bstr_write(result, iov.iov[i].buf, iov.iov[i].len);
+        referenced += (iov.iov[i].buf >= (char *)m &&
+                       iov.iov[i].buf < (char *)m + fio_bstr_len((char *)m));
+      }
+      FIO_ASSERT(FIO_BUF_INFO_IS_EQ(fio_bstr_buf(result), expected),
+                 "fio_mustache_build_iov result error: %s",
+                 result);
+      FIO_ASSERT(referenced, "template text should be referenced, not copied");
+      fio_bstr_free(result);
+    }
+    fio_mustache_free(m); /* the iov holds a reference to the template */
+    FIO_ASSERT(iov.iov[0].buf[0] == '[', "iov template reference error");
+    fio_mustache_iov_destroy(&iov);
+    FIO_ASSERT(!iov.iov && !iov.count && !iov.blocks,
+               "fio_mustache_iov_destroy should zero out the object");
+  }
+
+  fprintf(stderr, "* Testing mustache template cache.\n");
+  {
+    const char *main_fn = "fio___test_mustache_cache_main.mustache";
+    const char *part_fn = "fio___test_mustache_cache_part.mustache";
+    const char *second_fn = "fio___test_mustache_cache_second.mustache";
+    fio_mustache_bargs_s args = {
+        .get_var = fio___test_mustache_get_var,
+        .var2str = fio___test_mustache_var2str,
+        .ctx = (void *)fio___test_mustache_vars,
+    };
+    struct {
+      fio_mustache_s *m;
+      const char *expected;
+    } t[6] = {{0}};
+    fio_mustache_cache_config(0, 0); /* test files for changes every time */
+    FIO_ASSERT(!fio_mustache_cache_get(.filename = FIO_BUF_INFO1(
+                                           (char *)main_fn)),
+               "fio_mustache_cache_get should fail for missing files");
+    FIO_ASSERT(!fio_filename_overwrite(main_fn,
+                                       "[{{> fio___test_mustache_cache_part}}]",
+                                       38) &&
+                   !fio_filename_overwrite(part_fn, "{{tag}}", 7) &&
+                   !fio_filename_overwrite(
+                       second_fn,
+                       "({{> fio___test_mustache_cache_part}})",
+                       38),
+               "couldn't write template cache test files");
+
+    t[0].m = fio_mustache_cache_get(.filename = FIO_BUF_INFO1((char *)main_fn));
+    t[0].expected = "[&lt;b&gt;]";
+    t[1].m = fio_mustache_cache_get(.filename = FIO_BUF_INFO1((char *)main_fn));
+    t[1].expected = t[0].expected;
+    FIO_ASSERT(t[0].m && t[0].m == t[1].m,
+               "fio_mustache_cache_get should return the cached template");
+    t[2].m = fio_mustache_cache_get(.filename =
+                                        FIO_BUF_INFO1((char *)second_fn),
+                                    .var_hash = fio___test_mustache_hash);
+    t[2].expected = "(&lt;b&gt;)";
+    FIO_ASSERT(t[2].m && t[2].m != t[0].m, "cached template error");
+
+    /* a partial change re-compiles both templates, in use templates remain */
+    fio_filename_overwrite(part_fn, "{{{tag}}}!", 10);
+    t[3].m = fio_mustache_cache_get(.filename = FIO_BUF_INFO1((char *)main_fn));
+    t[3].expected = "[<b>!]";
+    FIO_ASSERT(t[3].m && t[3].m != t[0].m,
+               "fio_mustache_cache_get should reload changed partials");
+    t[4].m = fio_mustache_cache_get(.filename =
+                                        FIO_BUF_INFO1((char *)second_fn));
+    t[4].expected = "(<b>!)";
+    FIO_ASSERT(t[4].m && t[4].m != t[2].m,
+               "fio_mustache_cache_get should reload shared partials");
+
+    /* a broken template keeps the last valid version */
+    fprintf(stderr, "\terrors should print on the next lines.\n");
+    fio_filename_overwrite(main_fn, "{{tag}} and {{ incomplete}", 26);
+    t[5].m = fio_mustache_cache_get(.filename = FIO_BUF_INFO1((char *)main_fn));
+    t[5].expected = t[3].expected;
+    FIO_ASSERT(t[5].m == t[3].m,
+               "fio_mustache_cache_get should keep the last valid template");
+
+    for (size_t i = 0; i < 6; ++i) {
+      result = (char *)fio_mustache_build FIO_NOOP(t[i].m, args);
+      FIO_ASSERT(FIO_BUF_INFO_IS_EQ(fio_bstr_buf(result),
+                                    FIO_BUF_INFO1((char *)t[i].expected)),
+                 "cached template (%zu) result error: %s != %s",
+                 i,
+                 result,
+                 t[i].expected);
+      fio_bstr_free(result);
+      fio_mustache_free(t[i].m);
+    }
+
+    /* a tiny memory limit evicts everything but the latest template */
+    fio_mustache_cache_config(1, 0);
+    for (size_t i = 0; i < 2; ++i) {
+      fio_mustache_s *cached =
+          fio_mustache_cache_get(.filename = FIO_BUF_INFO1((char *)second_fn));
+      result = (char *)fio_mustache_build FIO_NOOP(cached, args);
+      FIO_ASSERT(FIO_BUF_INFO_IS_EQ(fio_bstr_buf(result),
+                                    FIO_BUF_INFO1((char *)"(<b>!)")),
+                 "memory limited template cache result error: %s",
+                 result);
+      fio_bstr_free(result);
+      fio_mustache_free(cached);
+    }
+
+    unlink(main_fn);
+    unlink(part_fn);
+    unlink(second_fn);
+    FIO_ASSERT(!fio_mustache_cache_get(.filename = FIO_BUF_INFO1(
+                                           (char *)second_fn)),
+               "fio_mustache_cache_get should drop removed templates");
+    fio_mustache_cache_clear();
+    fio_mustache_cache_config(0, -1);
+  }
 }
 
 /* *****************************************************************************
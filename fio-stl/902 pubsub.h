@@ -69,6 +69,62 @@ FIO_SFUNC void FIO_NAME_TEST(stl, pubsub_encryption)(void) {
   fio___pubsub_message_free(dec);
 }
 
+/* *****************************************************************************
+Cluster Batch Testing
+***************************************************************************** */
+
+FIO_SFUNC void FIO_NAME_TEST(stl, pubsub_batch_on_message)(fio_msg_s *msg) {
+  size_t *state = (size_t *)msg->udata;
+  FIO_ASSERT(msg->message.len == 1 &&
+                 (size_t)msg->message.buf[0] == 'a' + state[0],
+             "(pubsub) batched message out of order (%zu)",
+             state[0]);
+  ++state[0];
+}
+
+FIO_SFUNC void FIO_NAME_TEST(stl, pubsub_batch)(void) {
+  fprintf(stderr, "* Testing pub/sub cluster batches.\n");
+  size_t state = 0;
+  char *batch = NULL;
+  char tmp[2] = {0};
+  fio_buf_info_s test_channel = FIO_BUF_INFO1((char *)"pubsub_batch_channel");
+  fio_subscribe(.channel = test_channel,
+                .on_message = FIO_NAME_TEST(stl, pubsub_batch_on_message),
+                .udata = &state,
+                .filter = -126);
+  for (size_t i = 0; i < 8; ++i) {
+    tmp[0] = (char)('a' + i);
+    fio___pubsub_message_s *m = fio___pubsub_message_author(
+        (fio_publish_args_s){.channel = test_channel,
+                             .message = FIO_BUF_INFO2(tmp, 1),
+                             .filter = -126,
+                             .is_json = FIO___PUBSUB_PROCESS});
+    batch = fio___pubsub_batch_append(batch, m);
+    fio___pubsub_message_free(m);
+  }
+  fio___pubsub_message_s *enc = fio___pubsub_message_author(
+      (fio_publish_args_s){.message = FIO_BUF_INFO2(batch, fio_bstr_len(batch)),
+                           .is_json = FIO___PUBSUB_BATCH});
+  fio_bstr_free(batch);
+  fio___pubsub_message_encrypt(enc);
+  const size_t len = enc->data.channel.len + enc->data.message.len +
+                     FIO___PUBSUB_MESSAGE_OVERHEAD;
+  fio___pubsub_message_s *dec = fio___pubsub_message_alloc(enc->data.udata);
+  FIO_MEMCPY(dec->data.udata, enc->data.udata, len);
+  FIO_ASSERT(!fio___pubsub_message_decrypt(dec), "batch decryption failed");
+  FIO_ASSERT(dec->data.is_json == FIO___PUBSUB_BATCH, "batch flag error");
+  fio___pubsub_on_message_remote(NULL, dec);
+  fio_queue_perform_all(fio_io_queue());
+  FIO_ASSERT(state == 8, "(pubsub) batch unpacking error (%zu/8)", state);
+  fio___pubsub_message_free(enc);
+  fio___pubsub_message_free(dec);
+  fio_unsubscribe(.channel = test_channel,
+                  .on_message = FIO_NAME_TEST(stl, pubsub_batch_on_message),
+                  .udata = &state,
+                  .filter = -126);
+  fio_queue_perform_all(fio_io_queue());
+}
+
 /* *****************************************************************************
 Round Trip Testing
 ***************************************************************************** */
@@ -149,6 +205,7 @@ FIO_SFUNC void FIO_NAME_TEST(stl, pubsub_roundtrip)(void) {
 
 FIO_SFUNC void FIO_NAME_TEST(stl, pubsub)(void) {
   FIO_NAME_TEST(stl, pubsub_encryption)();
+  FIO_NAME_TEST(stl, pubsub_batch)();
   FIO_NAME_TEST(stl, pubsub_roundtrip)();
   fio___io_cleanup_at_exit(NULL);
 }
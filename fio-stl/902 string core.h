@@ -272,6 +272,22 @@ FIO_SFUNC void FIO_NAME_TEST(stl, string_core_helpers)(void) {
     FIO_ASSERT(!memcmp(unescaped.buf, decoded.buf, unescaped.len),
                "C escaping round-trip failed:\n %s",
                decoded.buf);
+    /* escaping into a (non-reallocatable) buffer that's too short */
+    decoded = FIO_STR_INFO3(mem + 512, 0, 512);
+    fio_string_write_escape(&decoded, NULL, "a\"b\nc\001d", 7);
+    for (size_t capa = 1; capa <= decoded.len; ++capa) {
+      memset(mem, 'X', 32);
+      encoded = FIO_STR_INFO3(mem, 0, capa);
+      FIO_ASSERT(fio_string_write_escape(&encoded, NULL, "a\"b\nc\001d", 7),
+                 "C escaping should fail when the buffer is too short");
+      FIO_ASSERT(encoded.len < capa && !mem[encoded.len] && mem[capa] == 'X',
+                 "C escaping overflowed a short buffer (capa %zu, len %zu)",
+                 capa,
+                 encoded.len);
+      FIO_ASSERT(!memcmp(encoded.buf, decoded.buf, encoded.len) &&
+                     (!encoded.len || encoded.buf[encoded.len - 1] != '\\'),
+                 "C escaping truncated in the middle of an escape sequence");
+    }
   }
   { /* testing Base64 Support */
     fprintf(stderr, "* Testing Base64 encoding / decoding.\n");
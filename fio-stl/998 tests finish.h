@@ -323,6 +323,7 @@ FIO_SFUNC void fio_test_dynamic_types(void) {
   fprintf(stderr, "===============\n");
   FIO_NAME_TEST(stl, uset___test_size_t)();
   FIO_NAME_TEST(stl, umap___test_size)();
+  FIO_NAME_TEST(stl, umap___test_size_inc)();
   FIO_NAME_TEST(stl, omap___test_size_t)();
   FIO_NAME_TEST(stl, omap___test_size_lru)();
   fprintf(stderr, "===============\n");
@@ -331,6 +332,8 @@ FIO_SFUNC void fio_test_dynamic_types(void) {
   fprintf(stderr, "===============\n");
   FIO_NAME_TEST(stl, mustache)();
   fprintf(stderr, "===============\n");
+  FIO_NAME_TEST(stl, json_schema)();
+  fprintf(stderr, "===============\n");
   FIO_NAME_TEST(stl, time)();
   fprintf(stderr, "===============\n");
   FIO_NAME_TEST(stl, queue)();
@@ -356,9 +359,19 @@ FIO_SFUNC void fio_test_dynamic_types(void) {
   FIO_NAME_TEST(stl, fiobj)();
   fprintf(stderr, "===============\n");
   FIO_NAME_TEST(stl, io)();
+  /* runs the IO reactor (the pub/sub tests clean up the reactor's state) */
+  FIO_NAME_TEST(stl, http_client_pool)();
+  FIO_NAME_TEST(stl, http_cache)();
   FIO_NAME_TEST(stl, pubsub)();
   fprintf(stderr, "===============\n");
   FIO_NAME_TEST(stl, http_s)();
+  FIO_NAME_TEST(stl, http_body_parsing)();
+  FIO_NAME_TEST(stl, http_router)();
+  fprintf(stderr, "===============\n");
+  FIO_NAME_TEST(stl, hpack)();
+  fprintf(stderr, "===============\n");
+  FIO_NAME_TEST(stl, websocket_deflate)();
+  FIO_NAME_TEST(stl, http_compress)();
   fprintf(stderr, "===============\n");
   FIO_NAME_TEST(stl, risky)();
   fprintf(stderr, "===============\n");
@@ -87,6 +87,9 @@
 #include "102 queue.h"
 #endif
 
+#if defined(FIO_JSON_SCHEMA) || defined(FIO_JSON_SCHEMA_NAME)
+#include "104 json schema.h"
+#endif
 #ifdef FIO_MUSTACHE
 #include "104 mustache.h"
 #endif
@@ -153,6 +156,10 @@
 #include "431 http handle.h"
 #endif
 
+#if defined(FIO_HTTP_ROUTER) && !defined(FIO___RECURSIVE_INCLUDE)
+#include "431 http router.h"
+#endif
+
 #if defined(FIO_HTTP) && !defined(FIO___RECURSIVE_INCLUDE)
 #include "439 http.h"
 #endif
@@ -171,8 +178,11 @@
 #include "902 fiobj.h"
 #include "902 glob matching.h"
 #include "902 http handle.h"
+#include "902 http router.h"
+#include "902 http.h"
 #include "902 imap.h"
 #include "902 io.h"
+#include "902 json schema.h"
 #include "902 math.h"
 #include "902 memalt.h"
 #include "902 mustache.h"
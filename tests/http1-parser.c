@@ -590,11 +590,32 @@ static struct {
     },
 };
 
+/* benchmark state - when active, callbacks only collect statistics. */
+static struct {
+  size_t active;
+  size_t requests;
+  size_t events;
+  size_t bytes;
+} fio_http1_bench;
+
+#define FIO_HTTP1_BENCH_HOOK(len)                                              \
+  do {                                                                         \
+    if (fio_http1_bench.active) {                                              \
+      ++fio_http1_bench.events;                                                \
+      fio_http1_bench.bytes += (len);                                          \
+      return 0;                                                                \
+    }                                                                          \
+  } while (0)
+
 /** called when a request was received. */
-static void fio_http1_on_complete(void *udata) { (void)udata; }
+static void fio_http1_on_complete(void *udata) {
+  (void)udata;
+  fio_http1_bench.requests += fio_http1_bench.active;
+}
 /** called when a request method is parsed. */
 static int fio_http1_on_method(fio_buf_info_s method, void *udata) {
   (void)udata;
+  FIO_HTTP1_BENCH_HOOK(method.len);
   fio_http1_test_data[fio_http1_test_pos].result.method = method.buf;
   FIO_ASSERT(method.len ==
                  strlen(fio_http1_test_data[fio_http1_test_pos].expect.method),
@@ -608,6 +629,7 @@ static int fio_http1_on_status(size_t istatus,
                                fio_buf_info_s status,
                                void *udata) {
   (void)udata;
+  FIO_HTTP1_BENCH_HOOK(status.len);
   fio_http1_test_data[fio_http1_test_pos].result.status = istatus;
   fio_http1_test_data[fio_http1_test_pos].result.method = status.buf;
   FIO_ASSERT(status.len ==
@@ -619,6 +641,7 @@ static int fio_http1_on_status(size_t istatus,
 /** called when a request path (excluding query) is parsed. */
 static int fio_http1_on_url(fio_buf_info_s path, void *udata) {
   (void)udata;
+  FIO_HTTP1_BENCH_HOOK(path.len);
   fio_url_s u = fio_url_parse(path.buf, path.len);
   fio_http1_test_data[fio_http1_test_pos].result.path = u.path.buf;
   FIO_ASSERT(u.path.len ==
@@ -637,6 +660,7 @@ static int fio_http1_on_url(fio_buf_info_s path, void *udata) {
 /** called when a the HTTP/1.x version is parsed. */
 static int fio_http1_on_version(fio_buf_info_s version, void *udata) {
   (void)udata;
+  FIO_HTTP1_BENCH_HOOK(version.len);
   fio_http1_test_data[fio_http1_test_pos].result.version = version.buf;
   FIO_ASSERT(version.len ==
                  strlen(fio_http1_test_data[fio_http1_test_pos].expect.version),
@@ -649,6 +673,7 @@ static int fio_http1_on_header(fio_buf_info_s name,
                                fio_buf_info_s value,
                                void *udata) {
   (void)udata;
+  FIO_HTTP1_BENCH_HOOK(name.len + value.len);
   size_t pos = 0;
   while (pos < 12 &&
          fio_http1_test_data[fio_http1_test_pos].result.headers[pos].name)
@@ -689,6 +714,7 @@ static int fio_http1_on_header_content_length(fio_buf_info_s name,
 /** called when a body chunk is parsed. */
 static int fio_http1_on_body_chunk(fio_buf_info_s chunk, void *udata) {
   (void)udata;
+  FIO_HTTP1_BENCH_HOOK(chunk.len);
   FIO_LOG_DEBUG("body chunk (%zu): %s", chunk.len, chunk.buf);
   fio_http1_test_data[fio_http1_test_pos]
       .result.body[fio_http1_test_data[fio_http1_test_pos].result.body_len] = 0;
@@ -803,13 +829,216 @@ static void fio_http1_parser_test(void) {
   }
 }
 
+/* control characters (other than HT) are rejected, whatever the build. */
+static void fio_http1_parser_ctl_test(void) {
+  static const char *bad[] = {
+      "GET /\x01 HTTP/1.1\r\nHost: localhost\r\n\r\n",
+      "GET / HTTP/1.1\r\nHost: local\x7Fhost\r\n\r\n",
+      "GET / HTTP/1.1\r\nX-Long-Header: 0123456789abcdef\x1B\r\n\r\n",
+      "GET / HTTP/1.1\r\nX-Bare-CR: a\rb\r\n\r\n",
+      "HTTP/1.1 200 OK\r\nX-Test: \x02\r\n\r\n",
+      NULL,
+  };
+  static const char *good[] = {
+      "GET / HTTP/1.1\r\nX-Tab:\tvalue\twith\ttabs and text\r\n\r\n",
+      "GET / HTTP/1.1\r\nX-UTF8: \xD7\xA9\xD7\x9C\xD7\x95\xD7\x9D\r\n\r\n",
+      NULL,
+  };
+  char buf[128];
+  fprintf(stderr, "* http1 parser test: control characters\n");
+  fio_http1_bench.active = 1; /* callbacks skip the test data assertions */
+  for (size_t i = 0; bad[i]; ++i) {
+    fio_http1_parser_s parser = {0};
+    size_t len = strlen(bad[i]);
+    FIO_MEMCPY(buf, bad[i], len + 1); /* the parser edits header names */
+    FIO_ASSERT(fio_http1_parse(&parser, FIO_BUF_INFO2(buf, len), NULL) ==
+                   FIO_HTTP1_PARSER_ERROR,
+               "control characters should be rejected (%zu)",
+               i);
+  }
+  for (size_t i = 0; good[i]; ++i) {
+    fio_http1_parser_s parser = {0};
+    size_t len = strlen(good[i]);
+    FIO_MEMCPY(buf, good[i], len + 1);
+    FIO_ASSERT(fio_http1_parse(&parser, FIO_BUF_INFO2(buf, len), NULL) == len,
+               "HT / UTF-8 bytes should be accepted (%zu)",
+               i);
+  }
+  FIO_MEMSET(&fio_http1_bench, 0, sizeof(fio_http1_bench));
+}
+
+/* *****************************************************************************
+Benchmark
+***************************************************************************** */
+
+/* each benchmark is split into rounds, reporting the best (least noisy) */
+#define FIO_HTTP1_BENCH_ROUNDS 5
+
+/* a typical browser request (18 headers) */
+static const char *fio_http1_bench_browser =
+    "GET /assets/app.js?v=1698765432 HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "Connection: keep-alive\r\n"
+    "sec-ch-ua: \"Chromium\";v=\"118\", \"Google Chrome\";v=\"118\"\r\n"
+    "sec-ch-ua-mobile: ?0\r\n"
+    "User-Agent: Mozilla/5.0 (Macintosh; Intel Mac OS X 10_15_7) "
+    "AppleWebKit/537.36 (KHTML, like Gecko) Chrome/118.0.0.0 Safari/537.36\r\n"
+    "sec-ch-ua-platform: \"macOS\"\r\n"
+    "Accept: */*\r\n"
+    "Sec-Fetch-Site: same-origin\r\n"
+    "Sec-Fetch-Mode: no-cors\r\n"
+    "Sec-Fetch-Dest: script\r\n"
+    "Referer: https://www.example.com/dashboard/overview\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: en-US,en;q=0.9,he;q=0.8\r\n"
+    "Cookie: session=8f14e45fceea167a5a36dedd4bea2543; theme=dark; "
+    "_ga=GA1.1.1234567890.1698765432\r\n"
+    "If-None-Match: \"5f3a-18b4c2e1d20\"\r\n"
+    "If-Modified-Since: Tue, 31 Oct 2023 12:00:00 GMT\r\n"
+    "Cache-Control: max-age=0\r\n"
+    "DNT: 1\r\n"
+    "\r\n";
+
+/* a small API request (4 headers and a body) */
+static const char *fio_http1_bench_api =
+    "POST /api/v1/items HTTP/1.1\r\n"
+    "Host: api.example.com\r\n"
+    "Content-Type: application/json\r\n"
+    "Authorization: Bearer 0123456789abcdef\r\n"
+    "Content-Length: 15\r\n"
+    "\r\n"
+    "{\"name\":\"item\"}";
+
+/* a response, as read by a client */
+static const char *fio_http1_bench_response =
+    "HTTP/1.1 200 OK\r\n"
+    "Date: Tue, 31 Oct 2023 12:00:00 GMT\r\n"
+    "Server: facil.io\r\n"
+    "Content-Type: text/html; charset=utf-8\r\n"
+    "Cache-Control: no-cache\r\n"
+    "Vary: Accept-Encoding\r\n"
+    "Content-Length: 12\r\n"
+    "\r\n"
+    "Hello World!";
+
+/* parses `buf` (one or more messages). */
+FIO_SFUNC int fio_http1_bench_parse(fio_buf_info_s buf) {
+  fio_http1_parser_s parser = {0};
+  while (buf.len) {
+    size_t consumed = fio_http1_parse(&parser, buf, NULL);
+    if (consumed == FIO_HTTP1_PARSER_ERROR || !consumed)
+      return -1;
+    buf.buf += consumed;
+    buf.len -= consumed;
+  }
+  return 0;
+}
+
+/* runs a single benchmark, returning the nanoseconds per message. */
+FIO_SFUNC double fio_http1_bench_run(const char *name,
+                                     char *data,
+                                     size_t len,
+                                     size_t messages,
+                                     size_t repetitions) {
+  int64_t start, end;
+  size_t events;
+  FIO_MEMSET(&fio_http1_bench, 0, sizeof(fio_http1_bench));
+  fio_http1_bench.active = 1;
+  FIO_ASSERT(!fio_http1_bench_parse(FIO_BUF_INFO2(data, len)) &&
+                 fio_http1_bench.requests == messages,
+             "benchmark data parsing failed for %s",
+             name);
+  events = fio_http1_bench.events;
+  start = fio_time_nano();
+  for (size_t i = 0; i < repetitions; ++i) {
+    FIO_COMPILER_GUARD;
+    fio_http1_bench_parse(FIO_BUF_INFO2(data, len));
+  }
+  end = fio_time_nano();
+  FIO_ASSERT(fio_http1_bench.events == events * (repetitions + 1),
+             "benchmark callback count mismatch for %s",
+             name);
+  fio_http1_bench.active = 0;
+  return (double)(end - start) / (double)(repetitions * messages);
+}
+
+/* benchmarks the parser for a single sample. */
+FIO_SFUNC void fio_http1_bench_sample(const char *name,
+                                      const char *sample,
+                                      size_t pipelined,
+                                      size_t repetitions) {
+  size_t len = strlen(sample);
+  double best = 0;
+  char *data = (char *)malloc(len * pipelined);
+  FIO_ASSERT_ALLOC(data);
+  for (size_t i = 0; i < pipelined; ++i)
+    memcpy(data + (i * len), sample, len);
+  repetitions /= pipelined * FIO_HTTP1_BENCH_ROUNDS;
+  if (!repetitions)
+    repetitions = 1;
+  for (size_t round = 0; round < FIO_HTTP1_BENCH_ROUNDS; ++round) {
+    double tmp = fio_http1_bench_run(name,
+                                     data,
+                                     len * pipelined,
+                                     pipelined,
+                                     repetitions);
+    if (!round || tmp < best)
+      best = tmp;
+  }
+  fprintf(stderr,
+          "\t%-20s (%3zu bytes x %2zu): %6.1f ns per message (%5.0f MB/s)\n",
+          name,
+          len,
+          pipelined,
+          best,
+          (double)len * 1000.0 / best);
+  free(data);
+}
+
+static void fio_http1_parser_benchmark(size_t repetitions) {
+  fprintf(stderr,
+          "* HTTP/1.1 parser benchmark (%zu messages per test, %s):\n",
+          repetitions,
+#if FIO___HTTP1_SCANNER && FIO___HAS_X86_INTRIN
+          "AVX2 block scanner"
+#elif FIO___HTTP1_SCANNER
+          "NEON block scanner"
+#else
+          "memchr"
+#endif
+  );
+  fio_http1_bench_sample("browser request",
+                         fio_http1_bench_browser,
+                         1,
+                         repetitions);
+  fio_http1_bench_sample("browser (pipelined)",
+                         fio_http1_bench_browser,
+                         16,
+                         repetitions);
+  fio_http1_bench_sample("API request", fio_http1_bench_api, 1, repetitions);
+  fio_http1_bench_sample("API (pipelined)",
+                         fio_http1_bench_api,
+                         16,
+                         repetitions);
+  fio_http1_bench_sample("response",
+                         fio_http1_bench_response,
+                         1,
+                         repetitions);
+}
+
 /* *****************************************************************************
 Main
 ***************************************************************************** */
 
 int main(int argc, char const *argv[]) {
-  (void)argc;
-  (void)argv;
+  size_t repetitions = 1000000;
+  if (argc > 1) {
+    char *tmp = (char *)argv[1];
+    repetitions = (size_t)fio_atol(&tmp);
+  }
   fio_http1_parser_test();
+  fio_http1_parser_ctl_test();
+  if (repetitions)
+    fio_http1_parser_benchmark(repetitions);
   return 0;
 }
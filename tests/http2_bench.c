@@ -0,0 +1,464 @@
+/* *****************************************************************************
+HTTP/2 server benchmark (an h2load style load generator).
+
+Opens a number of cleartext HTTP/2 connections ("prior knowledge"), keeps a
+number of concurrent streams (requests) open on each connection and reports
+requests per second and request latency percentiles (p50 / p99 / p999).
+
+Unless a URL is provided, a facil.io HTTP server is started in a child process
+(responding with a fixed length body), so the server's HTTP/2 implementation
+can be measured without external tools.
+
+Run using:
+
+    make tests/http2_bench
+
+Or, for specific settings:
+
+    make tests_build.http2_bench && ./tmp/http2_bench -h
+***************************************************************************** */
+#define FIO_LOG
+#define FIO_CLI
+#define FIO_HTTP
+#include "fio-stl.h"
+
+#define FIO_SORT_NAME bench_lat
+#define FIO_SORT_TYPE int64_t
+#include "fio-stl.h"
+
+#if !FIO_OS_WIN
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#endif
+
+/* *****************************************************************************
+Benchmark State
+***************************************************************************** */
+
+#define BENCH_MAX_CLIENTS 1024
+#define BENCH_MAX_STREAMS 128
+#define BENCH_RBUF        (1UL << 17)
+
+typedef struct {
+  int fd;
+  uint32_t next_id;
+  uint32_t in_flight;
+  uint32_t rlen;
+  uint64_t recv; /* DATA bytes since last WINDOW_UPDATE */
+  char *wbuf;    /* fio_bstr */
+  struct {
+    uint32_t id;
+    int64_t start;
+  } slot[BENCH_MAX_STREAMS];
+  char rbuf[BENCH_RBUF];
+} bench_client_s;
+
+static struct {
+  /* settings */
+  size_t clients;
+  size_t streams;
+  size_t requests;
+  size_t length;
+  size_t timeout;
+  fio_url_s url;
+  const char *url_str;
+  /* state */
+  size_t sent;
+  size_t completed;
+  size_t errors;
+  size_t bytes;
+  int64_t *samples;
+  bench_client_s *c;
+} BENCH;
+
+/* *****************************************************************************
+The (Optional) Server - runs in a child process
+***************************************************************************** */
+
+static char *bench_body;
+
+static void bench_on_http(fio_http_s *h) {
+  fio_http_write(h, .buf = bench_body, .len = BENCH.length, .finish = 1);
+}
+
+static int bench_server_start(void) {
+  int pid = fork();
+  if (pid)
+    return pid;
+  bench_body = (char *)malloc(BENCH.length + 1);
+  FIO_ASSERT_ALLOC(bench_body);
+  memset(bench_body, 'x', BENCH.length);
+  FIO_LOG_LEVEL = FIO_LOG_LEVEL_WARNING;
+  fio_http_listen(BENCH.url_str, .on_http = bench_on_http);
+  fio_io_start(0);
+  free(bench_body);
+  exit(0);
+}
+
+/* *****************************************************************************
+HTTP/2 Client
+***************************************************************************** */
+
+static void bench_frame(bench_client_s *c,
+                        uint8_t type,
+                        uint8_t flags,
+                        uint32_t id,
+                        const void *payload,
+                        size_t len) {
+  char hdr[9];
+  fio_u2buf24_be(hdr, (uint32_t)len);
+  hdr[3] = (char)type;
+  hdr[4] = (char)flags;
+  fio_u2buf32_be(hdr + 5, id);
+  c->wbuf = fio_bstr_write(c->wbuf, hdr, 9);
+  if (len)
+    c->wbuf = fio_bstr_write(c->wbuf, payload, len);
+}
+
+static void bench_frame32(bench_client_s *c,
+                          uint8_t type,
+                          uint32_t id,
+                          uint32_t value) {
+  char buf[4];
+  fio_u2buf32_be(buf, value);
+  bench_frame(c, type, 0, id, buf, 4);
+}
+
+/* :method GET, :scheme http, :path and :authority (literal, not indexed) */
+static char bench_request[512];
+static size_t bench_request_len;
+
+static void bench_request_init(void) {
+  fio_buf_info_s path = FIO_BUF_INFO2(BENCH.url.path.buf, BENCH.url.path.len);
+  fio_buf_info_s host = FIO_BUF_INFO2(BENCH.url.host.buf, BENCH.url.host.len);
+  if (!path.len)
+    path = FIO_BUF_INFO2((char *)"/", 1);
+  if (path.len > 126)
+    path.len = 126;
+  if (host.len > 126)
+    host.len = 126;
+  bench_request[0] = (char)0x82; /* :method: GET (static index 2) */
+  bench_request[1] = (char)0x86; /* :scheme: http (static index 6) */
+  bench_request[2] = 0x04;       /* :path (static name index 4) */
+  bench_request[3] = (char)path.len;
+  FIO_MEMCPY(bench_request + 4, path.buf, path.len);
+  bench_request_len = 4 + path.len;
+  bench_request[bench_request_len++] = 0x01; /* :authority (name index 1) */
+  bench_request[bench_request_len++] = (char)host.len;
+  FIO_MEMCPY(bench_request + bench_request_len, host.buf, host.len);
+  bench_request_len += host.len;
+}
+
+static void bench_send_requests(bench_client_s *c) {
+  while (c->in_flight < BENCH.streams && BENCH.sent < BENCH.requests) {
+    for (size_t i = 0; i < BENCH.streams; ++i) {
+      if (c->slot[i].id)
+        continue;
+      c->slot[i].id = c->next_id;
+      c->slot[i].start = fio_time_nano();
+      break;
+    }
+    bench_frame(c,
+                0x1,
+                0x5, /* END_STREAM | END_HEADERS */
+                c->next_id,
+                bench_request,
+                bench_request_len);
+    c->next_id += 2;
+    ++c->in_flight;
+    ++BENCH.sent;
+  }
+}
+
+static void bench_complete(bench_client_s *c, uint32_t id, int is_error) {
+  for (size_t i = 0; i < BENCH.streams; ++i) {
+    if (c->slot[i].id != id)
+      continue;
+    if (BENCH.completed < BENCH.requests)
+      BENCH.samples[BENCH.completed] = fio_time_nano() - c->slot[i].start;
+    ++BENCH.completed;
+    BENCH.errors += (size_t)is_error;
+    c->slot[i].id = 0;
+    --c->in_flight;
+    return;
+  }
+}
+
+/** Consumes complete frames, returns -1 if the connection failed. */
+static int bench_on_data(bench_client_s *c) {
+  size_t pos = 0;
+  while (c->rlen - pos >= 9) {
+    char *f = c->rbuf + pos;
+    const size_t len = fio_buf2u24_be(f);
+    const uint8_t type = (uint8_t)f[3];
+    const uint8_t flags = (uint8_t)f[4];
+    const uint32_t id = fio_buf2u32_be(f + 5) & 0x7FFFFFFFUL;
+    if (len + 9 > BENCH_RBUF)
+      return -1;
+    if (c->rlen - pos < len + 9)
+      break;
+    pos += len + 9;
+    f += 9;
+    switch (type) {
+    case 0x0: /* DATA */
+      BENCH.bytes += len;
+      c->recv += len;
+      if ((flags & 0x1))
+        bench_complete(c, id, 0);
+      break;
+    case 0x1: { /* HEADERS - test for ":status: 200" (static index 8) */
+      size_t skip = ((flags & 0x8) ? 1 : 0) + ((flags & 0x20) ? 5 : 0);
+      if (len <= skip || (uint8_t)f[skip] != 0x88) {
+        if ((flags & 0x1))
+          bench_complete(c, id, 1);
+        else
+          ++BENCH.errors; /* counted once the body is complete */
+        break;
+      }
+      if ((flags & 0x1))
+        bench_complete(c, id, 0);
+      break;
+    }
+    case 0x3: /* RST_STREAM */ bench_complete(c, id, 1); break;
+    case 0x4: /* SETTINGS */
+      if (!(flags & 0x1))
+        bench_frame(c, 0x4, 0x1, 0, NULL, 0);
+      break;
+    case 0x6: /* PING */
+      if (!(flags & 0x1))
+        bench_frame(c, 0x6, 0x1, 0, f, 8);
+      break;
+    case 0x7: /* GOAWAY */
+      FIO_LOG_ERROR("GOAWAY received (error code %u)",
+                    (unsigned)fio_buf2u32_be(f + 4));
+      return -1;
+    }
+  }
+  c->rlen -= (uint32_t)pos;
+  if (c->rlen && pos)
+    FIO_MEMMOVE(c->rbuf, c->rbuf + pos, c->rlen);
+  if (c->recv >= (1UL << 30)) {
+    bench_frame32(c, 0x8, 0, (uint32_t)c->recv);
+    c->recv = 0;
+  }
+  return 0;
+}
+
+static int bench_connect(bench_client_s *c) {
+  static const char preface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+  char settings[12];
+  char port[16];
+  fio_buf_info_s host = FIO_BUF_INFO2(BENCH.url.host.buf, BENCH.url.host.len);
+  char host_str[256];
+  if (host.len > 255)
+    return -1;
+  FIO_MEMCPY(host_str, host.buf, host.len);
+  host_str[host.len] = 0;
+  FIO_MEMCPY(port, BENCH.url.port.buf, BENCH.url.port.len);
+  port[BENCH.url.port.len] = 0;
+  *c = (bench_client_s){.next_id = 1};
+  c->fd = fio_sock_open(host_str, port, FIO_SOCK_CLIENT | FIO_SOCK_TCP);
+  if (c->fd == -1)
+    return -1;
+  fio_sock_set_non_block(c->fd);
+  c->wbuf = fio_bstr_write(c->wbuf, preface, 24);
+  fio_u2buf16_be(settings, 0x2); /* SETTINGS_ENABLE_PUSH */
+  fio_u2buf32_be(settings + 2, 0);
+  fio_u2buf16_be(settings + 6, 0x4); /* SETTINGS_INITIAL_WINDOW_SIZE */
+  fio_u2buf32_be(settings + 8, 0x7FFFFFFFUL);
+  bench_frame(c, 0x4, 0, 0, settings, 12);
+  bench_frame32(c, 0x8, 0, 0x7FFFFFFFUL - 65535);
+  return 0;
+}
+
+/** Writes pending frames, returns -1 on error. */
+static int bench_flush(bench_client_s *c) {
+  size_t len = fio_bstr_len(c->wbuf);
+  size_t written = 0;
+  while (written < len) {
+    ssize_t w = fio_sock_write(c->fd, c->wbuf + written, len - written);
+    if (w > 0) {
+      written += (size_t)w;
+      continue;
+    }
+    if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+      break;
+    return -1;
+  }
+  if (written == len) {
+    c->wbuf = fio_bstr_len_set(c->wbuf, 0);
+  } else if (written) {
+    FIO_MEMMOVE(c->wbuf, c->wbuf + written, len - written);
+    c->wbuf = fio_bstr_len_set(c->wbuf, len - written);
+  }
+  return 0;
+}
+
+static int bench_run(void) {
+  struct pollfd *fds;
+  int64_t start, end, deadline;
+  int r = 0;
+  BENCH.c = (bench_client_s *)calloc(BENCH.clients, sizeof(*BENCH.c));
+  BENCH.samples = (int64_t *)calloc(BENCH.requests, sizeof(int64_t));
+  fds = (struct pollfd *)calloc(BENCH.clients, sizeof(*fds));
+  FIO_ASSERT_ALLOC(BENCH.c && BENCH.samples && fds);
+  bench_request_init();
+  for (size_t i = 0; i < BENCH.clients; ++i) {
+    size_t attempts = 0;
+    while (bench_connect(BENCH.c + i) && ++attempts < 50)
+      poll(NULL, 0, 100); /* the server may still be starting */
+    if (attempts == 50) {
+      FIO_LOG_ERROR("couldn't connect to %s", BENCH.url_str);
+      return -1;
+    }
+  }
+  start = fio_time_nano();
+  deadline = start + ((int64_t)BENCH.timeout * 1000000000LL);
+  while (BENCH.completed < BENCH.requests) {
+    for (size_t i = 0; i < BENCH.clients; ++i) {
+      bench_send_requests(BENCH.c + i);
+      if (BENCH.c[i].fd != -1 && bench_flush(BENCH.c + i))
+        goto connection_error;
+      fds[i] = (struct pollfd){
+          .fd = BENCH.c[i].fd,
+          .events = (short)(POLLIN | (fio_bstr_len(BENCH.c[i].wbuf) ? POLLOUT
+                                                                     : 0)),
+      };
+    }
+    if (poll(fds, (nfds_t)BENCH.clients, 1000) < 0 && errno != EINTR)
+      goto connection_error;
+    for (size_t i = 0; i < BENCH.clients; ++i) {
+      bench_client_s *c = BENCH.c + i;
+      ssize_t rd;
+      if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+        continue;
+      rd = fio_sock_read(c->fd, c->rbuf + c->rlen, BENCH_RBUF - c->rlen);
+      if (rd <= 0) {
+        if (rd < 0 && (errno == EAGAIN || errno == EINTR))
+          continue;
+        goto connection_error;
+      }
+      c->rlen += (uint32_t)rd;
+      if (bench_on_data(c))
+        goto connection_error;
+    }
+    if (fio_time_nano() > deadline) {
+      FIO_LOG_ERROR("timeout, %zu / %zu requests completed",
+                    BENCH.completed,
+                    BENCH.requests);
+      r = -1;
+      break;
+    }
+  }
+  end = fio_time_nano();
+
+  if (BENCH.completed) {
+    const double seconds = (double)(end - start) / 1000000000.0;
+    const size_t count = (BENCH.completed < BENCH.requests) ? BENCH.completed
+                                                            : BENCH.requests;
+    bench_lat_sort(BENCH.samples, count);
+#define BENCH_PERCENTILE(per_mil)                                              \
+  ((double)BENCH.samples[(count * per_mil) / 1000] / 1000.0)
+    fprintf(stderr,
+            "\t%zu requests (%zu errors), %.0f req/s, %.2f MiB/s,"
+            " latency p50 %.1fus p99 %.1fus p999 %.1fus\n",
+            BENCH.completed,
+            BENCH.errors,
+            (seconds > 0 ? (double)BENCH.completed / seconds : 0.0),
+            (seconds > 0 ? (double)BENCH.bytes / (seconds * 1048576.0) : 0.0),
+            BENCH_PERCENTILE(500),
+            BENCH_PERCENTILE(990),
+            BENCH_PERCENTILE(999));
+#undef BENCH_PERCENTILE
+  }
+  if (BENCH.errors)
+    r = -1;
+
+cleanup:
+  for (size_t i = 0; i < BENCH.clients; ++i) {
+    if (BENCH.c[i].fd != -1)
+      fio_sock_close(BENCH.c[i].fd);
+    fio_bstr_free(BENCH.c[i].wbuf);
+  }
+  free(fds);
+  free(BENCH.samples);
+  free(BENCH.c);
+  return r;
+
+connection_error:
+  FIO_LOG_ERROR("HTTP/2 connection failed (%zu / %zu requests completed)",
+                BENCH.completed,
+                BENCH.requests);
+  r = -1;
+  goto cleanup;
+}
+
+/* *****************************************************************************
+Main
+***************************************************************************** */
+
+int main(int argc, char const *argv[]) {
+  int r, server = 0;
+  fio_cli_start(
+      argc,
+      argv,
+      0,
+      0,
+      "HTTP/2 server benchmark (cleartext, prior knowledge). Use:\n\n"
+      "\tNAME [options]\n\n"
+      "Unless a URL is provided, a facil.io server is started and measured.",
+      FIO_CLI_STRING("--url -u the URL to benchmark (http:// only)."),
+      FIO_CLI_INT("--clients -c (10) concurrent connections."),
+      FIO_CLI_INT("--streams -m (10) concurrent streams per connection."),
+      FIO_CLI_INT("--requests -n (100000) total number of requests."),
+      FIO_CLI_INT("--length -l (64) response body length (built-in server)."),
+      FIO_CLI_INT("--timeout -t (30) seconds before the benchmark fails."));
+  BENCH.clients = (size_t)fio_cli_get_i("-c");
+  BENCH.streams = (size_t)fio_cli_get_i("-m");
+  BENCH.requests = (size_t)fio_cli_get_i("-n");
+  BENCH.length = (size_t)fio_cli_get_i("-l");
+  BENCH.timeout = (size_t)fio_cli_get_i("-t");
+  BENCH.url_str = fio_cli_get("-u");
+  if (!BENCH.clients)
+    BENCH.clients = 1;
+  if (BENCH.clients > BENCH_MAX_CLIENTS)
+    BENCH.clients = BENCH_MAX_CLIENTS;
+  if (!BENCH.streams)
+    BENCH.streams = 1;
+  if (BENCH.streams > BENCH_MAX_STREAMS)
+    BENCH.streams = BENCH_MAX_STREAMS;
+  if (!BENCH.requests)
+    BENCH.requests = 1;
+  if (!BENCH.length)
+    BENCH.length = 1;
+  if (!BENCH.timeout)
+    BENCH.timeout = 30;
+  if (!BENCH.url_str) {
+    BENCH.url_str = "http://127.0.0.1:3000/";
+    server = bench_server_start();
+  }
+  BENCH.url = fio_url_parse(BENCH.url_str, strlen(BENCH.url_str));
+  if (!BENCH.url.port.len)
+    BENCH.url.port = FIO_BUF_INFO2((char *)"80", 2);
+
+#if DEBUG
+  fprintf(stderr,
+          "\n=== WARNING: performance tests using the DEBUG mode are "
+          "invalid. \n");
+#endif
+  fprintf(stderr,
+          "* HTTP/2 benchmark: %zu connection(s) x %zu stream(s), %zu "
+          "requests -> %s\n",
+          BENCH.clients,
+          BENCH.streams,
+          BENCH.requests,
+          BENCH.url_str);
+  r = bench_run();
+  if (server) {
+    kill(server, SIGINT);
+    waitpid(server, NULL, 0);
+  }
+  fio_cli_end();
+  return r;
+}
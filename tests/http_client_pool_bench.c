@@ -0,0 +1,226 @@
+/* *****************************************************************************
+HTTP client connection pool benchmark (upstream calls).
+
+Performs a number of HTTP/1.1 requests using `fio_http_connect`, keeping a
+fixed number of requests in flight, and reports requests per second and
+request latency percentiles (p50 / p99 / p999) - first with a new connection
+per request and then using the client connection pool (`pool_max`).
+
+Unless a URL is provided, a facil.io HTTP server is started in a separate
+process (responding with a fixed length body) to act as the local upstream.
+
+Run using:
+
+    make tests/http_client_pool_bench
+
+Or, for specific settings:
+
+    make tests_build.http_client_pool_bench && ./tmp/http_client_pool_bench -h
+***************************************************************************** */
+#define FIO_LOG
+#define FIO_CLI
+#define FIO_HTTP
+#include "fio-stl.h"
+
+#define FIO_SORT_NAME bench_lat
+#define FIO_SORT_TYPE int64_t
+#include "fio-stl.h"
+
+#if !FIO_OS_WIN
+#include <signal.h>
+#include <sys/wait.h>
+#endif
+
+/* *****************************************************************************
+Benchmark State
+***************************************************************************** */
+
+static struct {
+  /* settings */
+  size_t concurrency;
+  size_t requests;
+  size_t length;
+  const char *url;
+  uint16_t pool;
+  /* state */
+  size_t sent;
+  size_t completed;
+  size_t errors;
+  int64_t *samples;
+} BENCH;
+
+/* *****************************************************************************
+The (Optional) Upstream Server - runs in a child process
+***************************************************************************** */
+
+static char *bench_body;
+
+static void bench_on_http(fio_http_s *h) {
+  fio_http_write(h, .buf = bench_body, .len = BENCH.length, .finish = 1);
+}
+
+static void bench_server(void) {
+  bench_body = (char *)malloc(BENCH.length + 1);
+  FIO_ASSERT_ALLOC(bench_body);
+  memset(bench_body, 'x', BENCH.length);
+  FIO_LOG_LEVEL = FIO_LOG_LEVEL_WARNING;
+  fio_http_listen(BENCH.url, .on_http = bench_on_http);
+  fio_io_start(0);
+  free(bench_body);
+}
+
+/* the server is executed anew, as the reactor's state is shared by `fork` */
+static int bench_server_start(const char *program) {
+  char length[24];
+  int pid = fork();
+  if (pid)
+    return pid;
+  length[fio_ltoa(length, (int64_t)BENCH.length, 10)] = 0;
+  execl(program, program, "--server", "-u", BENCH.url, "-l", length, NULL);
+  FIO_LOG_FATAL("couldn't start the upstream server: %s", strerror(errno));
+  exit(1);
+}
+
+/* *****************************************************************************
+HTTP Client
+***************************************************************************** */
+
+static void bench_request(void);
+
+static void bench_on_response(fio_http_s *h) {
+  int64_t start = (int64_t)(intptr_t)fio_http_udata(h);
+  if (fio_http_status(h) != 200 ||
+      fio_http_body_length(h) != BENCH.length) {
+    ++BENCH.errors;
+    return;
+  }
+  BENCH.samples[BENCH.completed++] = fio_time_nano() - start;
+}
+
+static void bench_on_finish(fio_http_s *h) {
+  if (!fio_http_status(h))
+    ++BENCH.errors;
+  if (BENCH.sent < BENCH.requests)
+    bench_request();
+  else if (BENCH.completed + BENCH.errors >= BENCH.requests)
+    fio_io_stop();
+}
+
+static void bench_request(void) {
+  fio_http_s *h = fio_http_new();
+  fio_http_udata_set(h, (void *)(intptr_t)fio_time_nano());
+  ++BENCH.sent;
+  fio_http_connect(BENCH.url,
+                   h,
+                   .on_http = bench_on_response,
+                   .on_finish = bench_on_finish,
+                   .pool_max = BENCH.pool);
+}
+
+static void bench_start(void *ignr_) {
+  for (size_t i = 0; i < BENCH.concurrency && BENCH.sent < BENCH.requests;
+       ++i)
+    bench_request();
+  (void)ignr_;
+}
+
+static void bench_run(uint16_t pool) {
+  int64_t start, end;
+  BENCH.pool = pool;
+  BENCH.sent = BENCH.completed = BENCH.errors = 0;
+  fio_state_callback_add(FIO_CALL_ON_START, bench_start, NULL);
+  start = fio_time_nano();
+  fio_io_start(0);
+  end = fio_time_nano();
+  fio_state_callback_remove(FIO_CALL_ON_START, bench_start, NULL);
+
+  fprintf(stderr,
+          "* %-28s",
+          (pool ? "pooled (keep-alive):" : "new connection per request:"));
+  if (BENCH.completed) {
+    const double seconds = (double)(end - start) / 1000000000.0;
+    const size_t count = BENCH.completed;
+    bench_lat_sort(BENCH.samples, count);
+#define BENCH_PERCENTILE(per_mil)                                              \
+  ((double)BENCH.samples[(count * per_mil) / 1000] / 1000.0)
+    fprintf(stderr,
+            "%zu requests (%zu errors), %.0f req/s,"
+            " latency p50 %.1fus p99 %.1fus p999 %.1fus\n",
+            BENCH.completed,
+            BENCH.errors,
+            (seconds > 0 ? (double)BENCH.completed / seconds : 0.0),
+            BENCH_PERCENTILE(500),
+            BENCH_PERCENTILE(990),
+            BENCH_PERCENTILE(999));
+#undef BENCH_PERCENTILE
+  } else {
+    fprintf(stderr, "no requests completed (%zu errors)\n", BENCH.errors);
+  }
+}
+
+/* *****************************************************************************
+Main
+***************************************************************************** */
+
+int main(int argc, char const *argv[]) {
+  int server = 0;
+  fio_cli_start(
+      argc,
+      argv,
+      0,
+      0,
+      "HTTP client connection pool benchmark. Use:\n\n"
+      "\tNAME [options]\n\n"
+      "Unless a URL is provided, a local upstream server is started.",
+      FIO_CLI_STRING("--url -u the upstream URL (http:// only)."),
+      FIO_CLI_INT("--concurrency -c (16) requests in flight."),
+      FIO_CLI_INT("--requests -n (20000) requests per run."),
+      FIO_CLI_INT("--length -l (64) response body length (built-in server)."),
+      FIO_CLI_BOOL("--server run only the upstream server (internal use)."));
+  BENCH.concurrency = (size_t)fio_cli_get_i("-c");
+  BENCH.requests = (size_t)fio_cli_get_i("-n");
+  BENCH.length = (size_t)fio_cli_get_i("-l");
+  BENCH.url = fio_cli_get("-u");
+  if (!BENCH.concurrency)
+    BENCH.concurrency = 1;
+  if (BENCH.concurrency > 65535)
+    BENCH.concurrency = 65535;
+  if (!BENCH.requests)
+    BENCH.requests = 1;
+  if (!BENCH.length)
+    BENCH.length = 1;
+  if (fio_cli_get_bool("--server")) {
+    bench_server();
+    fio_cli_end();
+    return 0;
+  }
+  if (!BENCH.url) {
+    BENCH.url = "http://127.0.0.1:3000/";
+    server = bench_server_start(argv[0]);
+    poll(NULL, 0, 100); /* allow the server to start listening */
+  }
+  BENCH.samples = (int64_t *)calloc(BENCH.requests, sizeof(int64_t));
+  FIO_ASSERT_ALLOC(BENCH.samples);
+  FIO_LOG_LEVEL = FIO_LOG_LEVEL_WARNING;
+
+#if DEBUG
+  fprintf(stderr,
+          "\n=== WARNING: performance tests using the DEBUG mode are "
+          "invalid. \n");
+#endif
+  fprintf(stderr,
+          "* HTTP client benchmark: %zu requests, %zu in flight -> %s\n",
+          BENCH.requests,
+          BENCH.concurrency,
+          BENCH.url);
+  bench_run(0);
+  bench_run((uint16_t)BENCH.concurrency);
+
+  if (server) {
+    kill(server, SIGINT);
+    waitpid(server, NULL, 0);
+  }
+  free(BENCH.samples);
+  fio_cli_end();
+  return 0;
+}
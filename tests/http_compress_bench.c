@@ -0,0 +1,207 @@
+/* *****************************************************************************
+HTTP response compression benchmark (the `compress` setting).
+
+Compresses a JSON API response body, both as a complete body and as a streamed
+(chunked) response, using gzip and brotli (when available) at a number of
+compression levels, and reports the compression ratio and throughput.
+
+Also compares the cost of using pooled zlib streams (as the HTTP server does)
+with initializing a new zlib stream per response.
+
+Run using:
+
+    make tests/http_compress_bench
+
+Or, for specific settings:
+
+    make tests_build.http_compress_bench && ./tmp/http_compress_bench -h
+***************************************************************************** */
+#define FIO_LOG
+#define FIO_CLI
+#define FIO_HTTP
+#include "fio-stl.h"
+
+/* *****************************************************************************
+Benchmark State
+***************************************************************************** */
+
+static struct {
+  size_t length;
+  size_t rounds;
+  size_t chunk;
+  char *body;
+} BENCH;
+
+/* a JSON API response body (an array of quotes) */
+static void bench_body_init(void) {
+  char *b = NULL;
+  size_t i = 0;
+  b = fio_bstr_write(b, "[", 1);
+  while (fio_bstr_len(b) < BENCH.length) {
+    b = fio_bstr_write2(b,
+                        FIO_STRING_WRITE_STR1((i ? ",{\"id\":" : "{\"id\":")),
+                        FIO_STRING_WRITE_UNUM(i),
+                        FIO_STRING_WRITE_STR1(",\"symbol\":\"SYM"),
+                        FIO_STRING_WRITE_UNUM((i * 7919) % 500),
+                        FIO_STRING_WRITE_STR1("\",\"bid\":"),
+                        FIO_STRING_WRITE_UNUM(10000 + ((i * 31) % 977)),
+                        FIO_STRING_WRITE_STR1(",\"ask\":"),
+                        FIO_STRING_WRITE_UNUM(10001 + ((i * 31) % 977)),
+                        FIO_STRING_WRITE_STR1(",\"active\":true}"));
+    ++i;
+  }
+  b = fio_bstr_write(fio_bstr_len_set(b, BENCH.length - 1), "]", 1);
+  BENCH.body = b;
+}
+
+/* *****************************************************************************
+Benchmarks
+***************************************************************************** */
+
+static const char *bench_type_name(uint8_t type) {
+  return (type == FIO___HTTP_ZIP_GZIP ? "gzip" : "br");
+}
+
+static void bench_complete(uint8_t type, uint8_t level) {
+  size_t out_len = 0;
+  int64_t start = fio_time_nano();
+  for (size_t i = 0; i < BENCH.rounds; ++i) {
+    void *zip = fio___http_zip_new(type, level, BENCH.length);
+    char *out;
+    FIO_ASSERT(zip, "compressor allocation failed");
+    out = fio___http_zip(type, zip, BENCH.body, BENCH.length, 1);
+    fio___http_zip_free(type, zip);
+    out_len = fio_bstr_len(out);
+    fio_bstr_free(out);
+  }
+  int64_t end = fio_time_nano();
+  const double seconds = (double)(end - start) / 1000000000.0;
+  fprintf(stderr,
+          "* %-4s level %u, complete: %zu => %zu bytes (%.1f%%), %.1f MB/s, "
+          "%.1fus per response\n",
+          bench_type_name(type),
+          (unsigned)level,
+          BENCH.length,
+          out_len,
+          (100.0 * (double)out_len) / (double)BENCH.length,
+          ((double)(BENCH.length * BENCH.rounds) / seconds) / 1000000.0,
+          (seconds * 1000000.0) / (double)BENCH.rounds);
+}
+
+static void bench_streaming(uint8_t type, uint8_t level) {
+  size_t out_len = 0;
+  int64_t start = fio_time_nano();
+  for (size_t i = 0; i < BENCH.rounds; ++i) {
+    void *zip = fio___http_zip_new(type, level, 0);
+    char *out;
+    FIO_ASSERT(zip, "compressor allocation failed");
+    out_len = 0;
+    for (size_t pos = 0; pos < BENCH.length; pos += BENCH.chunk) {
+      size_t len = BENCH.length - pos;
+      if (len > BENCH.chunk)
+        len = BENCH.chunk;
+      out = fio___http_zip(type, zip, BENCH.body + pos, len, 0);
+      out_len += fio_bstr_len(out);
+      fio_bstr_free(out);
+    }
+    out = fio___http_zip(type, zip, NULL, 0, 1);
+    out_len += fio_bstr_len(out);
+    fio_bstr_free(out);
+    fio___http_zip_free(type, zip);
+  }
+  int64_t end = fio_time_nano();
+  const double seconds = (double)(end - start) / 1000000000.0;
+  fprintf(stderr,
+          "* %-4s level %u, streaming (%zu byte chunks): %zu => %zu bytes "
+          "(%.1f%%), %.1f MB/s\n",
+          bench_type_name(type),
+          (unsigned)level,
+          BENCH.chunk,
+          BENCH.length,
+          out_len,
+          (100.0 * (double)out_len) / (double)BENCH.length,
+          ((double)(BENCH.length * BENCH.rounds) / seconds) / 1000000.0);
+}
+
+#if HAVE_ZLIB
+/* compares pooled zlib streams to a new stream per response */
+static void bench_pool(uint8_t level) {
+  int64_t start, pooled, fresh;
+  start = fio_time_nano();
+  for (size_t i = 0; i < BENCH.rounds; ++i) {
+    fio___http_zstream_s *s = fio___http_zstream_new(2, level);
+    fio___http_zstream_free(s);
+  }
+  pooled = fio_time_nano() - start;
+  start = fio_time_nano();
+  for (size_t i = 0; i < BENCH.rounds; ++i) {
+    z_stream z;
+    FIO_MEMSET(&z, 0, sizeof(z));
+    deflateInit2(&z,
+                 (int)level,
+                 Z_DEFLATED,
+                 31,
+                 FIO_HTTP_WEBSOCKET_DEFLATE_MEM_LEVEL,
+                 Z_DEFAULT_STRATEGY);
+    deflateEnd(&z);
+  }
+  fresh = fio_time_nano() - start;
+  fprintf(stderr,
+          "* gzip stream setup: pooled %.2fus, new stream %.2fus "
+          "(per response)\n",
+          ((double)pooled / 1000.0) / (double)BENCH.rounds,
+          ((double)fresh / 1000.0) / (double)BENCH.rounds);
+}
+#endif
+
+/* *****************************************************************************
+Main
+***************************************************************************** */
+
+int main(int argc, char const *argv[]) {
+  static const uint8_t levels[] = {1, 4, 6, 9, 0};
+  fio_cli_start(argc,
+                argv,
+                0,
+                0,
+                "HTTP response compression benchmark. Use:\n\n"
+                "\tNAME [options]",
+                FIO_CLI_INT("--length -l (16384) response body length."),
+                FIO_CLI_INT("--rounds -r (2000) responses per test."),
+                FIO_CLI_INT("--chunk -c (1024) streaming chunk length."));
+  BENCH.length = (size_t)fio_cli_get_i("-l");
+  BENCH.rounds = (size_t)fio_cli_get_i("-r");
+  BENCH.chunk = (size_t)fio_cli_get_i("-c");
+  if (BENCH.length < 2)
+    BENCH.length = 2;
+  if (!BENCH.rounds)
+    BENCH.rounds = 1;
+  if (!BENCH.chunk)
+    BENCH.chunk = 1;
+  bench_body_init();
+
+#if DEBUG
+  fprintf(stderr,
+          "\n=== WARNING: performance tests using the DEBUG mode are "
+          "invalid. \n");
+#endif
+#if !HAVE_ZLIB && !HAVE_BROTLI
+  fprintf(stderr, "* HTTP compression requires zlib or brotli.\n");
+#endif
+  for (uint8_t type = FIO___HTTP_ZIP_GZIP; type <= FIO___HTTP_ZIP_BR; ++type) {
+    void *zip = fio___http_zip_new(type, 1, 0);
+    if (!zip)
+      continue; /* not available in this build */
+    fio___http_zip_free(type, zip);
+    for (size_t i = 0; levels[i]; ++i)
+      bench_complete(type, levels[i]);
+    for (size_t i = 0; levels[i]; ++i)
+      bench_streaming(type, levels[i]);
+  }
+#if HAVE_ZLIB
+  bench_pool(6);
+#endif
+  fio_bstr_free(BENCH.body);
+  fio_cli_end();
+  return 0;
+}
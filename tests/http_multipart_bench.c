@@ -0,0 +1,192 @@
+/* *****************************************************************************
+HTTP multipart upload benchmark (1GB, many parts).
+
+Feeds a `multipart/form-data` body to an HTTP handle using network sized
+chunks (as the HTTP/1.1 and HTTP/2 connections do) and compares:
+
+* streaming - a multipart parser is attached (`fio_http_body_multipart`)
+  before the body arrives, so parts are parsed as chunks arrive.
+
+* buffered - the body is stored (spilling to a temporary file, as it does
+  without a parser) and parsed once the upload is complete, by reading it
+  back from the HTTP handle (what applications had to do before).
+
+Reports the throughput, the time per part and the process' peak memory.
+
+Run using:
+
+    make tests/http_multipart_bench
+***************************************************************************** */
+#define FIO_LOG
+#define FIO_CLI
+#define FIO_TIME
+#define FIO_RAND
+#define FIO_HTTP_HANDLE
+#include "fio-stl.h"
+
+#if !FIO_OS_WIN
+#include <sys/resource.h>
+#endif
+
+/* *****************************************************************************
+Benchmark State
+***************************************************************************** */
+
+static struct {
+  char *body;       /* a block of parts, uploaded repeatedly (fio_bstr) */
+  size_t parts;     /* parts per block */
+  size_t blocks;    /* block count */
+  size_t chunk;     /* network chunk size */
+  size_t received;  /* part data received */
+  size_t seen;      /* parts seen */
+  uint64_t hash;    /* a cheap checksum, so the data is actually read */
+} BENCH;
+
+static fio_str_info_s content_type = {
+    .buf = (char *)"multipart/form-data; boundary=----fio-bench-boundary",
+    .len = 52};
+
+static int bench_on_part(fio_http_multipart_part_s *part) {
+  ++BENCH.seen;
+  return 0;
+  (void)part;
+}
+static int bench_on_data(fio_http_multipart_part_s *part, fio_buf_info_s d) {
+  BENCH.received += d.len;
+  BENCH.hash += (uint8_t)d.buf[0] + (uint8_t)d.buf[d.len - 1];
+  return 0;
+  (void)part;
+}
+
+/* creates a block of `count` parts, each with `size` bytes of random data. */
+static void bench_body_init(size_t count, size_t size) {
+  char *data = (char *)malloc(size);
+  FIO_ASSERT_ALLOC(data);
+  fio_rand_bytes(data, size);
+  for (size_t i = 0; i < size; ++i) /* avoid accidental delimiters */
+    data[i] = (data[i] == '-') ? '+' : data[i];
+  for (size_t i = 0; i < count; ++i) {
+    BENCH.body = fio_bstr_write2(
+        BENCH.body,
+        FIO_STRING_WRITE_STR1("------fio-bench-boundary\r\n"
+                              "Content-Disposition: form-data; name=\"file"),
+        FIO_STRING_WRITE_UNUM(i),
+        FIO_STRING_WRITE_STR1("\"; filename=\"upload.bin\"\r\n"
+                              "Content-Type: application/octet-stream\r\n"
+                              "\r\n"),
+        FIO_STRING_WRITE_STR2(data, size),
+        FIO_STRING_WRITE_STR1("\r\n"));
+  }
+  free(data);
+}
+
+/* uploads the body (every block, followed by the closing boundary). */
+static void bench_upload(fio_http_s *h) {
+  const size_t len = fio_bstr_len(BENCH.body);
+  const size_t total = len * BENCH.blocks;
+  /* a chunk reaching the end of a block is cut short */
+  for (size_t pos = 0; pos < total;) {
+    size_t offset = pos % len;
+    size_t l = (total - pos < BENCH.chunk) ? total - pos : BENCH.chunk;
+    if (l > len - offset)
+      l = len - offset;
+    fio_http_body_write(h, BENCH.body + offset, l);
+    pos += l;
+  }
+  fio_http_body_write(h, "------fio-bench-boundary--\r\n", 28);
+}
+
+static void bench_report(const char *name, uint64_t start, size_t total) {
+  uint64_t us = fio_time_micro() - start;
+  size_t rss = 0;
+#if !FIO_OS_WIN
+  struct rusage u;
+  if (!getrusage(RUSAGE_SELF, &u))
+    rss = (size_t)u.ru_maxrss;
+#endif
+  fprintf(stderr,
+          "  %-10s %8.1f MB/s, %8.1f ns / part, peak RSS %zu KB\n",
+          name,
+          (double)total / (us ? us : 1),
+          (double)us * 1000.0 / (BENCH.seen ? BENCH.seen : 1),
+          rss);
+  FIO_ASSERT(BENCH.seen == BENCH.parts * BENCH.blocks,
+             "%s: missing parts (%zu / %zu)",
+             name,
+             BENCH.seen,
+             BENCH.parts * BENCH.blocks);
+}
+
+/* *****************************************************************************
+Benchmark
+***************************************************************************** */
+
+int main(int argc, char const *argv[]) {
+  size_t total, part_size;
+  uint64_t start;
+  fio_cli_start(argc,
+                argv,
+                0,
+                0,
+                "HTTP multipart upload benchmark. Use:\n\n"
+                "\tNAME [options]\n",
+                FIO_CLI_INT("--size -s (1024) upload size in MB."),
+                FIO_CLI_INT("--part -p (16) part size in KB."),
+                FIO_CLI_INT("--chunk -c (16) network chunk size in KB."),
+                FIO_CLI_BOOL("--buffered -b also measure buffered parsing."));
+  part_size = (size_t)fio_cli_get_i("-p") << 10;
+  BENCH.chunk = (size_t)fio_cli_get_i("-c") << 10;
+  BENCH.parts = ((size_t)1 << 22) / (part_size ? part_size : 1);
+  if (!BENCH.parts)
+    BENCH.parts = 1;
+  bench_body_init(BENCH.parts, part_size);
+  BENCH.blocks = ((size_t)fio_cli_get_i("-s") << 20) / fio_bstr_len(BENCH.body);
+  if (!BENCH.blocks)
+    BENCH.blocks = 1;
+  total = BENCH.blocks * fio_bstr_len(BENCH.body);
+  fprintf(stderr,
+          "* Uploading %zu MB in %zu parts (%zu KB chunks):\n",
+          total >> 20,
+          BENCH.parts * BENCH.blocks,
+          BENCH.chunk >> 10);
+
+  { /* streaming */
+    fio_http_s *h = fio_http_new();
+    fio_http_multipart_s *p;
+    fio_http_request_header_set(h,
+                                FIO_STR_INFO1((char *)"content-type"),
+                                content_type);
+    start = fio_time_micro();
+    p = fio_http_body_multipart(h,
+                                .on_part = bench_on_part,
+                                .on_data = bench_on_data);
+    FIO_ASSERT(p, "fio_http_body_multipart failed");
+    bench_upload(h);
+    FIO_ASSERT(fio_http_multipart_is_finished(p) == 1,
+               "streaming: multipart body wasn't completed");
+    bench_report("streaming", start, total);
+    fio_http_free(h);
+  }
+
+  if (fio_cli_get_bool("-b")) { /* buffered, then parsed */
+    fio_http_s *h = fio_http_new();
+    fio_http_multipart_s *p;
+    fio_str_info_s s;
+    BENCH.seen = BENCH.received = 0;
+    start = fio_time_micro();
+    bench_upload(h);
+    p = fio_http_multipart_new(content_type,
+                               .on_part = bench_on_part,
+                               .on_data = bench_on_data);
+    while ((s = fio_http_body_read(h, (size_t)1 << 17)).len)
+      fio_http_multipart_parse(p, FIO_STR2BUF_INFO(s));
+    FIO_ASSERT(fio_http_multipart_is_finished(p) == 1,
+               "buffered: multipart body wasn't completed");
+    bench_report("buffered", start, total);
+    fio_http_multipart_free(p);
+    fio_http_free(h);
+  }
+  fio_bstr_free(BENCH.body);
+  fio_cli_end();
+  return (int)(BENCH.hash & 0);
+}
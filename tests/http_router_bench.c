@@ -0,0 +1,189 @@
+/* *****************************************************************************
+HTTP router benchmark (1,000 routes).
+
+Compares `fio_http_router_find` with a naive dispatcher that tests each route
+pattern in order (segment by segment), which is how many applications route
+requests using a list of `if` statements.
+
+The routes are a mix of static paths, path parameters and wildcards (i.e.
+`/api/v1/resource17/:id/posts/:post`). Lookups are performed in a pseudo-random
+order for paths matching every route.
+
+Run using:
+
+    make tests/http_router_bench
+***************************************************************************** */
+#define FIO_LOG
+#define FIO_TIME
+#define FIO_RAND
+#define FIO_HTTP_ROUTER
+#include "fio-stl.h"
+
+#define BENCH_ROUTES  1000
+#define BENCH_LOOKUPS (1UL << 22)
+#define BENCH_ORDER   (1UL << 16)
+
+/* *****************************************************************************
+Routes and Paths
+***************************************************************************** */
+
+typedef struct {
+  char pattern[96];
+  char path[96];
+  const char *method;
+} bench_route_s;
+
+static bench_route_s routes[BENCH_ROUTES];
+
+/* creates a route pattern and a matching path for route `i`. */
+static void bench_route_init(bench_route_s *r, size_t i) {
+  static const char *methods[] = {"GET", "POST", "PUT", "DELETE"};
+  size_t resource = i >> 2;
+  r->method = methods[i & 3];
+  switch (i % 5) {
+  case 0:
+    snprintf(r->pattern, 96, "/api/v1/resource%zu", resource);
+    snprintf(r->path, 96, "/api/v1/resource%zu", resource);
+    break;
+  case 1:
+    snprintf(r->pattern, 96, "/api/v1/resource%zu/:id", resource);
+    snprintf(r->path, 96, "/api/v1/resource%zu/%zu", resource, i * 7919);
+    break;
+  case 2:
+    snprintf(r->pattern, 96, "/api/v1/resource%zu/:id/posts/:post", resource);
+    snprintf(r->path, 96, "/api/v1/resource%zu/%zu/posts/%zu", resource, i, i);
+    break;
+  case 3:
+    snprintf(r->pattern, 96, "/static/group%zu/*path", resource);
+    snprintf(r->path, 96, "/static/group%zu/css/site.css", resource);
+    break;
+  default:
+    snprintf(r->pattern, 96, "/pages/section%zu/about", i);
+    snprintf(r->path, 96, "/pages/section%zu/about", i);
+    break;
+  }
+}
+
+static void bench_route_task(fio_http_s *h, fio_http_route_s *route) {
+  (void)h, (void)route;
+}
+
+/* *****************************************************************************
+Naive Dispatch - testing every pattern, segment by segment
+***************************************************************************** */
+
+static int naive_match(const char *pattern,
+                       const char *path,
+                       fio_http_route_s *route) {
+  route->count = 0;
+  while (*pattern) {
+    if (*pattern == ':' || *pattern == '*') {
+      const char *name = pattern + 1;
+      const char *value = path;
+      int wildcard = (*pattern == '*');
+      while (*pattern && *pattern != '/')
+        ++pattern;
+      if (wildcard)
+        while (*path)
+          ++path;
+      else
+        while (*path && *path != '/')
+          ++path;
+      if (!wildcard && path == value)
+        return -1;
+      route->param[route->count].name =
+          FIO_STR_INFO2((char *)name, (size_t)(pattern - name));
+      route->param[route->count].value =
+          FIO_STR_INFO2((char *)value, (size_t)(path - value));
+      ++route->count;
+      continue;
+    }
+    if (*pattern != *path)
+      return -1;
+    ++pattern;
+    ++path;
+  }
+  return (*path ? -1 : 0);
+}
+
+static int naive_find(fio_http_route_s *route, const char *method,
+                      const char *path) {
+  for (size_t i = 0; i < BENCH_ROUTES; ++i) {
+    if (strcmp(routes[i].method, method) ||
+        naive_match(routes[i].pattern, path, route))
+      continue;
+    route->udata = (void *)(uintptr_t)i;
+    return 0;
+  }
+  return 404;
+}
+
+/* *****************************************************************************
+Benchmark
+***************************************************************************** */
+
+int main(void) {
+  static uint16_t order[BENCH_ORDER];
+  fio_http_router_s *router = fio_http_router_new(.max_age = 0);
+  fio_http_route_s route;
+  uint64_t start, router_time, naive_time;
+  size_t hits = 0;
+  for (size_t i = 0; i < BENCH_ROUTES; ++i) {
+    bench_route_init(routes + i, i);
+    FIO_ASSERT(!fio_http_route(router,
+                               .method = routes[i].method,
+                               .path = routes[i].pattern,
+                               .on_http = bench_route_task,
+                               .udata = (void *)(uintptr_t)i),
+               "couldn't add route %s",
+               routes[i].pattern);
+  }
+  for (size_t i = 0; i < BENCH_ORDER; ++i)
+    order[i] = (uint16_t)(fio_rand64() % BENCH_ROUTES);
+
+  /* validate (and compile the router before timing it) */
+  for (size_t i = 0; i < BENCH_ROUTES; ++i) {
+    fio_http_route_s naive;
+    FIO_ASSERT(!fio_http_router_find(router,
+                                     &route,
+                                     FIO_STR_INFO1((char *)routes[i].method),
+                                     FIO_STR_INFO1(routes[i].path)),
+               "router failed for %s",
+               routes[i].path);
+    FIO_ASSERT(!naive_find(&naive, routes[i].method, routes[i].path),
+               "naive dispatch failed for %s",
+               routes[i].path);
+    FIO_ASSERT(route.udata == naive.udata && route.count == naive.count,
+               "router / naive mismatch for %s",
+               routes[i].path);
+  }
+
+  start = fio_time_micro();
+  for (size_t i = 0; i < BENCH_LOOKUPS; ++i) {
+    bench_route_s *r = routes + order[i & (BENCH_ORDER - 1)];
+    hits += !fio_http_router_find(router,
+                                  &route,
+                                  FIO_STR_INFO1((char *)r->method),
+                                  FIO_STR_INFO1(r->path));
+  }
+  router_time = fio_time_micro() - start;
+
+  start = fio_time_micro();
+  for (size_t i = 0; i < (BENCH_LOOKUPS >> 6); ++i) {
+    bench_route_s *r = routes + order[i & (BENCH_ORDER - 1)];
+    hits += !naive_find(&route, r->method, r->path);
+  }
+  naive_time = (fio_time_micro() - start) << 6;
+
+  fprintf(stderr,
+          "* %d routes, %zu hits\n"
+          "  router: %.1f ns / lookup\n"
+          "  naive:  %.1f ns / lookup (%.1fx)\n",
+          BENCH_ROUTES,
+          hits,
+          (double)router_time * 1000.0 / BENCH_LOOKUPS,
+          (double)naive_time * 1000.0 / BENCH_LOOKUPS,
+          (double)naive_time / (router_time ? router_time : 1));
+  fio_http_router_free(router);
+  return 0;
+}
@@ -0,0 +1,423 @@
+/* *****************************************************************************
+HTTP static file benchmark (a small-asset-heavy workload).
+
+Creates a public folder with a number of small files (some with a pre-compressed
+`.gz` variant), starts a facil.io HTTP server in a child process serving the
+folder and requests the files using a number of HTTP/1.1 keep-alive (pipelined)
+connections.
+
+Reports requests per second, the server's CPU time per request and (on Linux)
+the server's read / write system calls per request (`/proc/[pid]/io`).
+
+The (opt-in) static file cache is enabled by this file. To compare with the
+static file cache disabled, compile this file with
+`-DFIO_HTTP_STATIC_FILE_CACHE_LIMIT=0`.
+
+Run using:
+
+    make tests/http_static_bench
+***************************************************************************** */
+#ifndef FIO_HTTP_STATIC_FILE_CACHE_LIMIT
+#define FIO_HTTP_STATIC_FILE_CACHE_LIMIT (1UL << 23)
+#endif
+#define FIO_LOG
+#define FIO_CLI
+#define FIO_HTTP
+#include "fio-stl.h"
+
+#if !FIO_OS_WIN
+#include <poll.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#endif
+
+/* *****************************************************************************
+Benchmark State
+***************************************************************************** */
+
+#define BENCH_MAX_CLIENTS 1024
+#define BENCH_RBUF        (1UL << 17)
+
+typedef struct {
+  int fd;
+  uint32_t in_flight;
+  uint32_t rlen;
+  size_t next; /* next file to request */
+  char *wbuf;  /* fio_bstr */
+  char rbuf[BENCH_RBUF];
+} bench_client_s;
+
+static struct {
+  /* settings */
+  size_t clients;
+  size_t pipeline;
+  size_t requests;
+  size_t files;
+  size_t timeout;
+  int gzip;
+  /* state */
+  char folder[512];
+  size_t sent;
+  size_t completed;
+  size_t errors;
+  size_t bytes;
+  bench_client_s *c;
+} BENCH;
+
+static const char *bench_ext[] = {"js", "css", "svg", "json"};
+
+/* *****************************************************************************
+The public folder
+***************************************************************************** */
+
+static void bench_file_name(char *dest, size_t i, const char *suffix) {
+  snprintf(dest,
+           600,
+           "%s/asset%zu.%s%s",
+           BENCH.folder,
+           i,
+           bench_ext[i & 3],
+           suffix);
+}
+
+static void bench_folder_create(void) {
+  char name[600];
+  char *data = (char *)malloc(8192);
+  FIO_ASSERT_ALLOC(data);
+  snprintf(BENCH.folder,
+           sizeof(BENCH.folder),
+           "%s/fio_static_bench_%d",
+           (getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp"),
+           (int)getpid());
+  FIO_ASSERT(!mkdir(BENCH.folder, 0700),
+             "couldn't create folder %s",
+             BENCH.folder);
+  for (size_t i = 0; i < BENCH.files; ++i) {
+    size_t len = 256 + (fio_rand64() & 8191) % 7936; /* 256B - 8KiB */
+    for (size_t j = 0; j < len; ++j)
+      data[j] = "static asset data\n"[(i + j) % 18];
+    bench_file_name(name, i, "");
+    FIO_ASSERT(!fio_filename_overwrite(name, data, len),
+               "couldn't write %s",
+               name);
+    if (!(i & 1))
+      continue;
+    bench_file_name(name, i, ".gz"); /* content isn't validated by the server */
+    FIO_ASSERT(!fio_filename_overwrite(name, data, len >> 2),
+               "couldn't write %s",
+               name);
+  }
+  free(data);
+}
+
+static void bench_folder_remove(void) {
+  char name[600];
+  for (size_t i = 0; i < BENCH.files; ++i) {
+    bench_file_name(name, i, "");
+    unlink(name);
+    bench_file_name(name, i, ".gz");
+    unlink(name);
+  }
+  rmdir(BENCH.folder);
+}
+
+/* *****************************************************************************
+The Server - runs in a child process
+***************************************************************************** */
+
+static void bench_on_http(fio_http_s *h) {
+  fio_http_send_error_response(h, 404);
+}
+
+static int bench_server_start(void) {
+  int pid = fork();
+  if (pid)
+    return pid;
+  FIO_LOG_LEVEL = FIO_LOG_LEVEL_WARNING;
+  fio_http_listen("http://127.0.0.1:3000/",
+                  .on_http = bench_on_http,
+                  .public_folder = FIO_STR_INFO1(BENCH.folder),
+                  .max_age = 3600);
+  fio_io_start(0);
+  exit(0);
+}
+
+/** Reads the server's read / write system call count (Linux only). */
+static size_t bench_server_syscalls(int pid) {
+  char name[64];
+  char buf[1024];
+  size_t r = 0;
+  snprintf(name, sizeof(name), "/proc/%d/io", pid);
+  int fd = open(name, O_RDONLY);
+  if (fd == -1)
+    return 0;
+  ssize_t l = read(fd, buf, sizeof(buf) - 1);
+  close(fd);
+  if (l <= 0)
+    return 0;
+  buf[l] = 0;
+  for (char *pos = strstr(buf, "sysc"); pos; pos = strstr(pos, "sysc")) {
+    pos += 7; /* "syscr: " / "syscw: " */
+    r += (size_t)fio_atol(&pos);
+  }
+  return r;
+}
+
+/* *****************************************************************************
+HTTP/1.1 Client
+***************************************************************************** */
+
+static void bench_send_requests(bench_client_s *c) {
+  char path[128];
+  while (c->fd != -1 && c->in_flight < BENCH.pipeline &&
+         BENCH.sent < BENCH.requests) {
+    int len = snprintf(path,
+                       sizeof(path),
+                       "GET /asset%zu.%s HTTP/1.1\r\nHost: localhost\r\n%s\r\n",
+                       c->next,
+                       bench_ext[c->next & 3],
+                       (BENCH.gzip ? "Accept-Encoding: gzip, br\r\n" : ""));
+    c->wbuf = fio_bstr_write(c->wbuf, path, (size_t)len);
+    c->next = (c->next + 7) % BENCH.files;
+    ++c->in_flight;
+    ++BENCH.sent;
+  }
+}
+
+/** Consumes complete responses, returns -1 on error. */
+static int bench_on_data(bench_client_s *c) {
+  size_t pos = 0;
+  for (;;) {
+    char *start = c->rbuf + pos;
+    char *eoh;
+    size_t clen = 0;
+    c->rbuf[c->rlen] = 0;
+    eoh = strstr(start, "\r\n\r\n");
+    if (!eoh)
+      break;
+    if (start[9] != '2')
+      ++BENCH.errors;
+    for (char *ln = strchr(start, '\n'); ln && ln < eoh;
+         ln = strchr(ln + 1, '\n')) {
+      if ((ln[1] | 32) == 'c' && (ln[9] | 32) == 'l' && ln[15] == ':') {
+        char *num = ln + 16;
+        while (*num == ' ')
+          ++num;
+        clen = (size_t)fio_atol(&num);
+        break;
+      }
+    }
+    eoh += 4;
+    if ((size_t)(eoh - c->rbuf) + clen > c->rlen)
+      break;
+    pos = (size_t)(eoh - c->rbuf) + clen;
+    BENCH.bytes += clen;
+    ++BENCH.completed;
+    --c->in_flight;
+  }
+  c->rlen -= (uint32_t)pos;
+  if (pos && c->rlen)
+    FIO_MEMMOVE(c->rbuf, c->rbuf + pos, c->rlen);
+  if (c->rlen + 1 >= BENCH_RBUF)
+    return -1;
+  return 0;
+}
+
+/** Writes pending requests, returns -1 on error. */
+static int bench_flush(bench_client_s *c) {
+  size_t len = fio_bstr_len(c->wbuf);
+  size_t written = 0;
+  while (written < len) {
+    ssize_t w = fio_sock_write(c->fd, c->wbuf + written, len - written);
+    if (w > 0) {
+      written += (size_t)w;
+      continue;
+    }
+    if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+      break;
+    return -1;
+  }
+  if (written == len) {
+    c->wbuf = fio_bstr_len_set(c->wbuf, 0);
+  } else if (written) {
+    FIO_MEMMOVE(c->wbuf, c->wbuf + written, len - written);
+    c->wbuf = fio_bstr_len_set(c->wbuf, len - written);
+  }
+  return 0;
+}
+
+static int bench_run(int server) {
+  struct pollfd *fds;
+  int64_t start, end, deadline;
+  size_t syscalls = 0;
+  int r = 0;
+  BENCH.c = (bench_client_s *)calloc(BENCH.clients, sizeof(*BENCH.c));
+  fds = (struct pollfd *)calloc(BENCH.clients, sizeof(*fds));
+  FIO_ASSERT_ALLOC(BENCH.c && fds);
+  for (size_t i = 0; i < BENCH.clients; ++i) {
+    size_t attempts = 0;
+    BENCH.c[i].next = i % BENCH.files;
+    while ((BENCH.c[i].fd = fio_sock_open("127.0.0.1",
+                                          "3000",
+                                          FIO_SOCK_CLIENT | FIO_SOCK_TCP)) ==
+               -1 &&
+           ++attempts < 50)
+      poll(NULL, 0, 100); /* the server may still be starting */
+    if (BENCH.c[i].fd == -1) {
+      FIO_LOG_ERROR("couldn't connect to server");
+      r = -1;
+      goto cleanup;
+    }
+    fio_sock_set_non_block(BENCH.c[i].fd);
+  }
+  poll(NULL, 0, 100); /* let the server accept all connections */
+  syscalls = bench_server_syscalls(server);
+  start = fio_time_nano();
+  deadline = start + ((int64_t)BENCH.timeout * 1000000000LL);
+  while (BENCH.completed < BENCH.requests) {
+    for (size_t i = 0; i < BENCH.clients; ++i) {
+      bench_send_requests(BENCH.c + i);
+      if (bench_flush(BENCH.c + i))
+        goto connection_error;
+      fds[i] = (struct pollfd){
+          .fd = BENCH.c[i].fd,
+          .events = (short)(POLLIN | (fio_bstr_len(BENCH.c[i].wbuf) ? POLLOUT
+                                                                     : 0)),
+      };
+    }
+    if (poll(fds, (nfds_t)BENCH.clients, 1000) < 0 && errno != EINTR)
+      goto connection_error;
+    for (size_t i = 0; i < BENCH.clients; ++i) {
+      bench_client_s *c = BENCH.c + i;
+      ssize_t rd;
+      if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+        continue;
+      rd = fio_sock_read(c->fd, c->rbuf + c->rlen, BENCH_RBUF - 1 - c->rlen);
+      if (rd <= 0) {
+        if (rd < 0 && (errno == EAGAIN || errno == EINTR))
+          continue;
+        goto connection_error;
+      }
+      c->rlen += (uint32_t)rd;
+      if (bench_on_data(c))
+        goto connection_error;
+    }
+    if (fio_time_nano() > deadline) {
+      FIO_LOG_ERROR("timeout, %zu / %zu requests completed",
+                    BENCH.completed,
+                    BENCH.requests);
+      r = -1;
+      break;
+    }
+  }
+  end = fio_time_nano();
+  if (syscalls)
+    syscalls = bench_server_syscalls(server) - syscalls;
+
+  if (BENCH.completed) {
+    const double seconds = (double)(end - start) / 1000000000.0;
+    fprintf(stderr,
+            "\t%zu requests (%zu errors), %.0f req/s, %.2f MiB/s",
+            BENCH.completed,
+            BENCH.errors,
+            (seconds > 0 ? (double)BENCH.completed / seconds : 0.0),
+            (seconds > 0 ? (double)BENCH.bytes / (seconds * 1048576.0) : 0.0));
+    if (syscalls)
+      fprintf(stderr,
+              ", %.2f server read/write syscalls per request",
+              (double)syscalls / (double)BENCH.completed);
+    fprintf(stderr, "\n");
+  }
+  if (BENCH.errors)
+    r = -1;
+
+cleanup:
+  for (size_t i = 0; i < BENCH.clients; ++i) {
+    if (BENCH.c[i].fd > 0)
+      fio_sock_close(BENCH.c[i].fd);
+    fio_bstr_free(BENCH.c[i].wbuf);
+  }
+  free(fds);
+  free(BENCH.c);
+  return r;
+
+connection_error:
+  FIO_LOG_ERROR("HTTP connection failed (%zu / %zu requests completed)",
+                BENCH.completed,
+                BENCH.requests);
+  r = -1;
+  goto cleanup;
+}
+
+/* *****************************************************************************
+Main
+***************************************************************************** */
+
+int main(int argc, char const *argv[]) {
+  int r, server;
+  struct rusage usage;
+  fio_cli_start(
+      argc,
+      argv,
+      0,
+      0,
+      "HTTP static file benchmark (small assets). Use:\n\n"
+      "\tNAME [options]\n\n"
+      "A facil.io server (port 3000) is started and measured.",
+      FIO_CLI_INT("--clients -c (16) concurrent connections."),
+      FIO_CLI_INT("--pipeline -m (8) pipelined requests per connection."),
+      FIO_CLI_INT("--requests -n (200000) total number of requests."),
+      FIO_CLI_INT("--files -f (256) number of files in the public folder."),
+      FIO_CLI_BOOL("--gzip -z request pre-compressed (gzip) variants."),
+      FIO_CLI_INT("--timeout -t (30) seconds before the benchmark fails."));
+  BENCH.clients = (size_t)fio_cli_get_i("-c");
+  BENCH.pipeline = (size_t)fio_cli_get_i("-m");
+  BENCH.requests = (size_t)fio_cli_get_i("-n");
+  BENCH.files = (size_t)fio_cli_get_i("-f");
+  BENCH.timeout = (size_t)fio_cli_get_i("-t");
+  BENCH.gzip = fio_cli_get_bool("-z");
+  if (!BENCH.clients)
+    BENCH.clients = 1;
+  if (BENCH.clients > BENCH_MAX_CLIENTS)
+    BENCH.clients = BENCH_MAX_CLIENTS;
+  if (!BENCH.pipeline)
+    BENCH.pipeline = 1;
+  if (!BENCH.requests)
+    BENCH.requests = 1;
+  if (!BENCH.files)
+    BENCH.files = 1;
+  if (!BENCH.timeout)
+    BENCH.timeout = 30;
+
+#if DEBUG
+  fprintf(stderr,
+          "\n=== WARNING: performance tests using the DEBUG mode are "
+          "invalid. \n");
+#endif
+  fprintf(stderr,
+          "* HTTP static file benchmark: %zu files, %zu connection(s) x %zu "
+          "pipelined, %zu requests%s (static file cache %s)\n",
+          BENCH.files,
+          BENCH.clients,
+          BENCH.pipeline,
+          BENCH.requests,
+          (BENCH.gzip ? ", gzip" : ""),
+          (FIO_HTTP_STATIC_FILE_CACHE_LIMIT ? "enabled" : "disabled"));
+  bench_folder_create();
+  server = bench_server_start();
+  r = bench_run(server);
+  kill(server, SIGINT);
+  wait4(server, NULL, 0, &usage);
+  if (BENCH.completed)
+    fprintf(stderr,
+            "\tserver CPU time: %.2fus per request\n",
+            ((double)usage.ru_utime.tv_sec * 1000000.0 +
+             (double)usage.ru_utime.tv_usec +
+             (double)usage.ru_stime.tv_sec * 1000000.0 +
+             (double)usage.ru_stime.tv_usec) /
+                (double)BENCH.completed);
+  bench_folder_remove();
+  fio_cli_end();
+  return r;
+}
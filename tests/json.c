@@ -1,12 +1,484 @@
+#include <sys/resource.h>
+
 #define FIO_CLI
 #define FIO_LOG
+#define FIO_RAND
+#define FIO_TIME
 #include "fio-stl.h"
 #define FIO_FIOBJ
 #include "fio-stl.h"
 
+/* a fixed shape message, parsed directly into a C struct by a JSON schema */
+typedef struct {
+  double x;
+  double y;
+} json_point_s;
+
+typedef struct {
+  int64_t id;
+  uint16_t port;
+  uint8_t active;
+  double price;
+  char name[32];
+  char *note;
+  json_point_s at;
+} json_msg_s;
+
+#define FIO_JSON_SCHEMA_NAME json_point
+#define FIO_JSON_SCHEMA_TYPE json_point_s
+#define FIO_JSON_SCHEMA_FIELDS(FIELD)                                          \
+  FIELD(x, FIO_JSON_FIELD_FLOAT)                                               \
+  FIELD(y, FIO_JSON_FIELD_FLOAT)
+#include "fio-stl.h"
+
+#define FIO_JSON_SCHEMA_NAME json_msg
+#define FIO_JSON_SCHEMA_TYPE json_msg_s
+#define FIO_JSON_SCHEMA_FIELDS(FIELD)                                          \
+  FIELD(id, FIO_JSON_FIELD_INT, .required = 1)                                 \
+  FIELD(port, FIO_JSON_FIELD_UINT)                                             \
+  FIELD(active, FIO_JSON_FIELD_BOOL)                                           \
+  FIELD(price, FIO_JSON_FIELD_FLOAT)                                           \
+  FIELD(name, FIO_JSON_FIELD_STR)                                              \
+  FIELD(note, FIO_JSON_FIELD_BSTR)                                             \
+  FIELD(at, FIO_JSON_FIELD_OBJ(json_point))
+#include "fio-stl.h"
+
 // Prettyfy JSON? this is passed as an argument to `fiobj2json`
 #define PRETTY 0
 
+/* writes a number dense (canada.json like) GeoJSON document */
+static void json_numbers_write(FIOBJ json, size_t count) {
+  static const char *head =
+      "{\"type\":\"FeatureCollection\",\"features\":[{\"type\":"
+      "\"Feature\",\"geometry\":{\"type\":\"Polygon\",\"coordinates\":[[";
+  char buf[64];
+  fiobj_str_write(json, head, strlen(head));
+  for (size_t i = 0; i < count; ++i) {
+    const double lon = (double)(fio_rand64() >> 11) / 9007199254740992.0 * -60;
+    const double lat = (double)(fio_rand64() >> 11) / 9007199254740992.0 * 30;
+    fiobj_str_write(json, (i ? ",[" : "["), (i ? 2 : 1));
+    fiobj_str_write(json, buf, fio_ftoa(buf, lon - 52.0, 10));
+    fiobj_str_write(json, ",", 1);
+    fiobj_str_write(json, buf, fio_ftoa(buf, lat + 45.0, 10));
+    fiobj_str_write(json, "]", 1);
+  }
+  fiobj_str_write(json, "]]}}]}", 6);
+}
+
+static double json_numbers_strtod(char **pstr) { return strtod(*pstr, pstr); }
+
+/* reports JSON parsing and number parsing (fio_atof vs. strtod) throughput */
+static void json_numbers_bench(fio_str_info_s json) {
+  const size_t rounds = 10;
+  struct {
+    const char *name;
+    double (*fn)(char **);
+  } to_test[] = {
+      {"fio_atof", fio_atof},
+      {"strtod", json_numbers_strtod},
+  };
+  const double mb = (double)(json.len * rounds) / (1024.0 * 1024.0);
+  int64_t start = fio_time_nano();
+  for (size_t i = 0; i < rounds; ++i)
+    fiobj_free(fiobj_json_parse(json, NULL));
+  int64_t end = fio_time_nano();
+  fprintf(stderr,
+          "* fiobj_json_parse:  %.1f MB/s\n",
+          mb / ((double)(end - start) / 1000000000.0));
+  for (size_t t = 0; t < sizeof(to_test) / sizeof(to_test[0]); ++t) {
+    volatile double sum = 0;
+    size_t numbers = 0;
+    start = fio_time_nano();
+    for (size_t i = 0; i < rounds; ++i) {
+      char *pos = json.buf;
+      char *const stop = json.buf + json.len;
+      while (pos < stop) {
+        if (pos[0] == '-' || (uint8_t)(pos[0] - '0') < 10) {
+          sum += to_test[t].fn(&pos);
+          ++numbers;
+          continue;
+        }
+        ++pos;
+      }
+    }
+    end = fio_time_nano();
+    fprintf(stderr,
+            "* %-17s %.1f ns per number (%zu numbers)\n",
+            to_test[t].name,
+            (double)(end - start) / (double)numbers,
+            numbers / rounds);
+  }
+}
+
+/* callbacks that build nothing, measuring the parser alone */
+static void *json_nop_value(void) { return (void *)1; }
+static void *json_nop_number(int64_t i) { return (void *)(uintptr_t)(i | 1); }
+static void *json_nop_float(double f) { return (void *)(uintptr_t)(f != 0.1); }
+static void *json_nop_string(const void *s, size_t l) {
+  return (void *)((uintptr_t)s | (l & 1) | 1);
+}
+static void *json_nop_collection(void *ctx, void *at) {
+  return (void *)((uintptr_t)ctx | (uintptr_t)!at);
+}
+static int json_nop_push(void *ctx, void *key, void *value) {
+  return !ctx | !key | !value;
+}
+static int json_nop_push2(void *ctx, void *value) { return !ctx | !value; }
+static void json_nop_free(void *ctx) { (void)ctx; }
+
+/* parses `rounds` times, returns the throughput in GB/s (or 0 on error) */
+static double json_index_bench_run(fio_json_parser_callbacks_s *cb,
+                                   fio_str_info_s json,
+                                   size_t rounds,
+                                   int indexed) {
+  int64_t start = fio_time_nano();
+  for (size_t i = 0; i < rounds; ++i) {
+    fio___json_state_s s = {.cb = *cb,
+                            .pos = json.buf,
+                            .end = json.buf + json.len};
+    void *r = indexed ? fio___json_consume_indexed(&s) : fio___json_consume(&s);
+    if (s.error)
+      return 0;
+    if (cb->on_error != fio___json_callback_noop2)
+      fiobj_free((FIOBJ)r);
+  }
+  int64_t end = fio_time_nano();
+  return (double)(json.len * rounds) / (double)(end - start);
+}
+
+/* reports structural indexing (stage one) and parsing throughput in GB/s */
+static void json_index_bench(fio_str_info_s json) {
+  const size_t rounds = 1 + ((size_t)1 << 28) / (json.len + 1);
+  fio_json_parser_callbacks_s nop = {
+      .on_null = json_nop_value,
+      .on_true = json_nop_value,
+      .on_false = json_nop_value,
+      .on_number = json_nop_number,
+      .on_float = json_nop_float,
+      .on_string = json_nop_string,
+      .on_map = json_nop_collection,
+      .on_array = json_nop_collection,
+      .map_push = json_nop_push,
+      .array_push = json_nop_push2,
+      .free_unused_object = json_nop_free,
+  };
+  fio_json_parser_callbacks_s fiobj_cb = FIOBJ_JSON_PARSER_CALLBACKS;
+  size_t entries = 0;
+  fio___json_callbacks_validate(&nop);
+  fio___json_callbacks_validate(&fiobj_cb);
+  {
+    fio___json_index_s *ix = (fio___json_index_s *)malloc(sizeof(*ix));
+    FIO_ASSERT_ALLOC(ix);
+    int64_t start = fio_time_nano();
+    for (size_t i = 0; i < rounds; ++i) {
+      *ix = (fio___json_index_s){.start = json.buf,
+                                 .pos = json.buf,
+                                 .end = json.buf + json.len};
+      entries = 0;
+      while (fio___json_index_fill(ix))
+        entries += ix->count;
+    }
+    int64_t end = fio_time_nano();
+    free(ix);
+    fprintf(stderr,
+            "* JSON structural index (stage one): %.2f GB/s "
+            "(%zu entries for %zu bytes)\n",
+            (double)(json.len * rounds) / (double)(end - start),
+            entries,
+            json.len);
+  }
+  fprintf(stderr,
+          "* JSON parsing (no-op callbacks):    %.2f GB/s indexed, "
+          "%.2f GB/s recursive\n"
+          "* JSON parsing (FIOBJ callbacks):    %.2f GB/s indexed, "
+          "%.2f GB/s recursive\n",
+          json_index_bench_run(&nop, json, rounds, 1),
+          json_index_bench_run(&nop, json, rounds, 0),
+          json_index_bench_run(&fiobj_cb, json, (rounds >> 2) + 1, 1),
+          json_index_bench_run(&fiobj_cb, json, (rounds >> 2) + 1, 0));
+}
+
+/* collects a streamed value (there should be only one) */
+static void json_stream_on_json(void *udata, void *value) {
+  FIOBJ *dest = (FIOBJ *)udata;
+  fiobj_free(*dest);
+  *dest = (FIOBJ)value;
+}
+
+/* reports streaming throughput (feeding `chunk` bytes at a time) in GB/s */
+static void json_stream_bench(fio_str_info_s json, size_t chunk, FIOBJ expect) {
+  const size_t rounds = 1 + ((size_t)1 << 26) / (json.len + 1);
+  FIOBJ result = FIOBJ_INVALID;
+  fio_json_stream_s *s =
+      fio_json_stream_new(.callbacks = &FIOBJ_JSON_PARSER_CALLBACKS,
+                          .on_json = json_stream_on_json,
+                          .udata = &result);
+  FIO_ASSERT_ALLOC(s);
+  int64_t start = fio_time_nano();
+  for (size_t i = 0; i < rounds; ++i) {
+    for (size_t pos = 0; pos < json.len; pos += chunk)
+      FIO_ASSERT(!fio_json_stream_write(s,
+                                        json.buf + pos,
+                                        (json.len - pos < chunk ? json.len - pos
+                                                                : chunk)),
+                 "JSON stream parsing failed");
+    FIO_ASSERT(!fio_json_stream_finish(s), "JSON stream parsing failed");
+  }
+  int64_t mid = fio_time_nano();
+  for (size_t i = 0; i < rounds; ++i)
+    fiobj_free(fiobj_json_parse(json, NULL));
+  int64_t end = fio_time_nano();
+  FIO_ASSERT(fiobj_is_eq(result, expect), "JSON stream result error");
+  fprintf(stderr,
+          "* JSON streaming (%zu byte chunks): %.2f GB/s streamed, "
+          "%.2f GB/s fio_json_parse\n",
+          chunk,
+          (double)(json.len * rounds) / (double)(mid - start),
+          (double)(json.len * rounds) / (double)(end - mid));
+  fiobj_free(result);
+  fio_json_stream_free(s);
+}
+
+/* reports arena vs. heap documents throughput (parsing and freeing) in GB/s */
+static void json_arena_bench(fio_str_info_s json, FIOBJ expect) {
+  const size_t batch = 64; /* documents kept alive at the same time */
+  const size_t rounds = 1 + ((size_t)1 << 26) / ((json.len + 1) * batch);
+  struct {
+    const char *name;
+    FIOBJ (*fn)(fio_str_info_s, size_t *);
+  } to_test[] = {
+      /* the arena is tested first, so the peak RSS isn't hidden by the heap */
+      {"fiobj_json_parse_arena", fiobj_json_parse_arena},
+      {"fiobj_json_parse", fiobj_json_parse},
+  };
+  FIOBJ docs[64];
+  for (size_t t = 0; t < sizeof(to_test) / sizeof(to_test[0]); ++t) {
+    int64_t parsing = 0, freeing = 0;
+    struct rusage usage;
+    docs[0] = to_test[t].fn(json, NULL);
+    FIO_ASSERT(fiobj_is_eq(docs[0], expect), "%s error", to_test[t].name);
+    fiobj_free(docs[0]);
+    for (size_t i = 0; i < rounds; ++i) {
+      int64_t start = fio_time_nano();
+      for (size_t j = 0; j < batch; ++j)
+        docs[j] = to_test[t].fn(json, NULL);
+      int64_t mid = fio_time_nano();
+      for (size_t j = 0; j < batch; ++j)
+        fiobj_free(docs[j]);
+      int64_t end = fio_time_nano();
+      parsing += mid - start;
+      freeing += end - mid;
+    }
+    getrusage(RUSAGE_SELF, &usage);
+    fprintf(stderr,
+            "* %-23s %.2f GB/s parsing, %.2f GB/s freeing, %.2f GB/s total "
+            "(peak RSS %ld KB)\n",
+            to_test[t].name,
+            (double)(json.len * rounds * batch) / (double)parsing,
+            (double)(json.len * rounds * batch) / (double)freeing,
+            (double)(json.len * rounds * batch) / (double)(parsing + freeing),
+            (long)usage.ru_maxrss);
+  }
+}
+
+/* reports JSON serialization throughput (output bytes) in GB/s */
+static void json_write_bench(FIOBJ obj, uint8_t beautify) {
+  const size_t capa = fiobj_json_capa(obj, beautify);
+  const size_t rounds = 1 + ((size_t)1 << 28) / capa;
+  char *buf = (char *)malloc(capa);
+  FIOBJ str = fiobj_str_new();
+  size_t len = 0;
+  FIO_ASSERT_ALLOC(buf);
+  int64_t start = fio_time_nano();
+  for (size_t i = 0; i < rounds; ++i) {
+    fiobj_str_resize(str, 0);
+    fiobj2json(str, obj, beautify);
+  }
+  int64_t mid = fio_time_nano();
+  for (size_t i = 0; i < rounds; ++i) {
+    len = fiobj_json_write(buf, obj, beautify);
+    FIO_COMPILER_GUARD;
+  }
+  int64_t end = fio_time_nano();
+  for (size_t i = 0; i < rounds; ++i) {
+    len = fiobj_json_capa(obj, beautify);
+    FIO_COMPILER_GUARD;
+  }
+  int64_t sizing = fio_time_nano();
+  FIO_ASSERT(len == capa && fiobj_str_len(str) < capa &&
+                 !memcmp(buf, fiobj_str_ptr(str), fiobj_str_len(str)),
+             "fiobj_json_write / fiobj2json output mismatch");
+  len = fiobj_str_len(str);
+  fprintf(stderr,
+          "* JSON output %zu bytes (fiobj_json_capa %zu):\n"
+          "* fiobj2json (reused String) %.2f GB/s\n"
+          "* fiobj_json_write           %.2f GB/s\n"
+          "* fiobj_json_capa            %.2f GB/s\n",
+          len,
+          capa,
+          (double)(len * rounds) / (double)(mid - start),
+          (double)(len * rounds) / (double)(end - mid),
+          (double)(len * rounds) / (double)(sizing - end));
+  fiobj_free(str);
+  free(buf);
+}
+
+/* copies a FIOBJ message into a C struct (the schema's alternative) */
+static void json_msg_from_fiobj(json_msg_s *m, FIOBJ o) {
+  FIOBJ tmp;
+  fio_str_info_s s;
+  m->id = fiobj2i(fiobj_hash_get2(o, "id", 2));
+  m->port = (uint16_t)fiobj2i(fiobj_hash_get2(o, "port", 4));
+  m->active = fiobj_hash_get2(o, "active", 6) == fiobj_true();
+  m->price = fiobj2f(fiobj_hash_get2(o, "price", 5));
+  s = fiobj2cstr(fiobj_hash_get2(o, "name", 4));
+  if (s.len >= sizeof(m->name))
+    s.len = sizeof(m->name) - 1;
+  FIO_MEMCPY(m->name, s.buf, s.len);
+  m->name[s.len] = 0;
+  s = fiobj2cstr(fiobj_hash_get2(o, "note", 4));
+  m->note = fio_bstr_write(fio_bstr_len_set(m->note, 0), s.buf, s.len);
+  tmp = fiobj_hash_get2(o, "at", 2);
+  m->at.x = fiobj2f(fiobj_hash_get2(tmp, "x", 1));
+  m->at.y = fiobj2f(fiobj_hash_get2(tmp, "y", 1));
+}
+
+/* compares schema (JSON to / from C structs) and FIOBJ throughput in GB/s */
+static void json_schema_bench(void) {
+  fio_str_info_s json = FIO_STR_INFO1(
+      (char *)"{\"id\":1234567,\"port\":8080,\"active\":true,\"price\":19.99,"
+              "\"name\":\"a fixed shape message\",\"ignored\":[1,2,3],"
+              "\"note\":\"with a \\\"quoted\\\" note\",\"at\":{\"x\":1.5,"
+              "\"y\":-2.25}}");
+  const size_t rounds = 1 + ((size_t)1 << 24) / json.len;
+  char buf[512];
+  fio_str_info_s out;
+  json_msg_s m, m2;
+  FIOBJ o = fiobj_json_parse(json, NULL), str = fiobj_str_new();
+  json_msg_init(&m);
+  json_msg_init(&m2);
+  FIO_ASSERT(!json_msg_parse(&m, json, NULL), "json_msg_parse failed");
+  json_msg_from_fiobj(&m2, o);
+  FIO_ASSERT(m.id == m2.id && m.port == m2.port && m.active == m2.active &&
+                 m.price == m2.price && !strcmp(m.name, m2.name) &&
+                 !strcmp(m.note, m2.note) && m.at.x == m2.at.x &&
+                 m.at.y == m2.at.y,
+             "json_msg_parse / FIOBJ value mismatch");
+  int64_t start = fio_time_nano();
+  for (size_t i = 0; i < rounds; ++i) {
+    json_msg_parse(&m, json, NULL);
+    FIO_COMPILER_GUARD;
+  }
+  int64_t mid = fio_time_nano();
+  for (size_t i = 0; i < rounds; ++i) {
+    FIOBJ tmp = fiobj_json_parse(json, NULL);
+    json_msg_from_fiobj(&m2, tmp);
+    fiobj_free(tmp);
+  }
+  int64_t end = fio_time_nano();
+  for (size_t i = 0; i < rounds; ++i) {
+    out = FIO_STR_INFO3(buf, 0, sizeof(buf));
+    json_msg_write(&out, NULL, &m);
+    FIO_COMPILER_GUARD;
+  }
+  int64_t written = fio_time_nano();
+  for (size_t i = 0; i < rounds; ++i) {
+    fiobj_str_resize(str, 0);
+    fiobj2json(str, o, 0);
+  }
+  int64_t written2 = fio_time_nano();
+  fprintf(stderr,
+          "* JSON schema message (%zu bytes, %zu bytes output):\n"
+          "* json_msg_parse             %.2f GB/s\n"
+          "* fiobj_json_parse + copy    %.2f GB/s\n"
+          "* json_msg_write             %.2f GB/s\n"
+          "* fiobj2json (reused String) %.2f GB/s\n",
+          json.len,
+          out.len,
+          (double)(json.len * rounds) / (double)(mid - start),
+          (double)(json.len * rounds) / (double)(end - mid),
+          (double)(out.len * rounds) / (double)(written - end),
+          (double)(fiobj_str_len(str) * rounds) / (double)(written2 - written));
+  json_msg_destroy(&m);
+  json_msg_destroy(&m2);
+  fiobj_free(str);
+  fiobj_free(o);
+}
+
+/* compares JSON path lookups (comma separated `notations`) and extraction */
+static void json_path_bench(fio_str_info_s json,
+                            FIOBJ obj,
+                            const char *notations) {
+  fio_str_info_s n[64];
+  FIOBJ expect[64], results[64];
+  size_t count = 0;
+  for (const char *pos = notations; pos && count < 64; ++count) {
+    const char *end = strchr(pos, ',');
+    size_t len = end ? (size_t)(end - pos) : strlen(pos);
+    n[count] = FIO_STR_INFO2((char *)pos, len);
+    pos = end ? end + 1 : end;
+  }
+  fiobj_json_path_s *path = fiobj_json_path_new(n, count);
+  FIO_ASSERT(path, "couldn't compile the JSON path notations: %s", notations);
+  for (size_t i = 0; i < count; ++i)
+    expect[i] = fiobj_json_find(obj, n[i]);
+
+  const size_t rounds = 1 + ((size_t)1 << 20) / count;
+  size_t found = 0;
+  int64_t start = fio_time_nano();
+  for (size_t r = 0; r < rounds; ++r) {
+    for (size_t i = 0; i < count; ++i)
+      found += (fiobj_json_find(obj, n[i]) != FIOBJ_INVALID);
+    FIO_COMPILER_GUARD;
+  }
+  int64_t mid = fio_time_nano();
+  for (size_t r = 0; r < rounds; ++r) {
+    found += fiobj_json_path_find_all(obj, path, results);
+    FIO_COMPILER_GUARD;
+  }
+  int64_t end = fio_time_nano();
+  for (size_t i = 0; i < count; ++i)
+    FIO_ASSERT(results[i] == expect[i], "fiobj_json_path_find_all error");
+  fprintf(stderr,
+          "* %zu JSON paths: %.1f ns fiobj_json_find, "
+          "%.1f ns fiobj_json_path_find_all (%zu found)\n",
+          count,
+          (double)(mid - start) / (double)rounds,
+          (double)(end - mid) / (double)rounds,
+          found / (rounds * 2));
+
+  /* extracting the data: parsing the whole document vs. selective parsing */
+  const size_t parse_rounds = 1 + ((size_t)1 << 28) / (json.len + 1);
+  start = fio_time_nano();
+  for (size_t r = 0; r < parse_rounds; ++r) {
+    FIOBJ tmp = fiobj_json_parse(json, NULL);
+    for (size_t i = 0; i < count; ++i)
+      results[i] = fiobj_dup(fiobj_json_find(tmp, n[i]));
+    fiobj_free(tmp);
+    for (size_t i = 0; i < count; ++i)
+      fiobj_free(results[i]);
+  }
+  mid = fio_time_nano();
+  for (size_t r = 0; r < parse_rounds; ++r) {
+    fiobj_json_path_parse(path, json, results, NULL);
+    for (size_t i = 0; i < count; ++i)
+      fiobj_free(results[i]);
+  }
+  end = fio_time_nano();
+  fiobj_json_path_parse(path, json, results, NULL);
+  for (size_t i = 0; i < count; ++i) {
+    FIO_ASSERT(fiobj_is_eq(results[i], expect[i]),
+               "fiobj_json_path_parse error");
+    fiobj_free(results[i]);
+  }
+  fprintf(stderr,
+          "* extraction: %.2f GB/s fiobj_json_parse + fiobj_json_find, "
+          "%.2f GB/s fiobj_json_path_parse\n",
+          (double)(json.len * parse_rounds) / (double)(mid - start),
+          (double)(json.len * parse_rounds) / (double)(end - mid));
+  fiobj_json_path_free(path);
+}
+
 int main(int argc, char const *argv[]) {
   // a default string to demo
   const char *json_cstr =
@@ -30,6 +502,20 @@ int main(int argc, char const *argv[]) {
       "<filename>]\n\tNAME [-d] [JSON string]",
       FIO_CLI_STRING("--file -f a file to load for JSON roundtrip testing."),
       FIO_CLI_BOOL("--pretty -p -b test Beautify / Prettify roundtrip."),
+      FIO_CLI_INT("--numbers -n generate (and benchmark) a number dense "
+                  "document with this number of coordinate pairs."),
+      FIO_CLI_BOOL("--index -i benchmark the structural index (two stage) "
+                   "parser (GB/s)."),
+      FIO_CLI_INT("--stream -s benchmark the streaming parser, feeding it "
+                  "chunks of this size."),
+      FIO_CLI_BOOL("--arena -a benchmark arena backed documents "
+                   "(fiobj_json_parse_arena)."),
+      FIO_CLI_STRING("--query -q benchmark compiled JSON paths using these "
+                     "comma separated notations (i.e., \"user.name,id\")."),
+      FIO_CLI_BOOL("--write -w benchmark JSON serialization (fiobj2json and "
+                   "fiobj_json_write)."),
+      FIO_CLI_BOOL("--schema -m benchmark JSON schemas (JSON to / from C "
+                   "structs) using a fixed shape message."),
       FIO_CLI_BOOL("--verbose -v enable debugging mode logging."));
   if (fio_cli_get_bool("-v")) {
     FIO_LOG_LEVEL = FIO_LOG_LEVEL_DEBUG;
@@ -46,6 +532,11 @@ int main(int argc, char const *argv[]) {
     }
   }
 
+  if (fio_cli_get_i("-n") > 0) {
+    fiobj_str_destroy(json);
+    json_numbers_write(json, (size_t)fio_cli_get_i("-n"));
+  }
+
   FIO_LOG_DEBUG2("attempting to parse:\n%s\n", fiobj_str2cstr(json).buf);
 
   // Parsing the JSON
@@ -92,6 +583,25 @@ int main(int argc, char const *argv[]) {
       "-----PASSED-----\nJSON input was %zu bytes\nJSON output is %zu bytes.\n",
       consumed,
       (size_t)fiobj_str_len(json2));
+  if (fio_cli_get_i("-n") > 0)
+    json_numbers_bench(fiobj_str2cstr(json));
+  if (fio_cli_get_bool("-i")) {
+    json_index_bench(fiobj_str2cstr(json));
+    if (fio_cli_get_bool("-b")) {
+      fprintf(stderr, "* (beautified JSON)\n");
+      json_index_bench(fiobj_str2cstr(json2));
+    }
+  }
+  if (fio_cli_get_i("-s") > 0)
+    json_stream_bench(fiobj_str2cstr(json), (size_t)fio_cli_get_i("-s"), obj1);
+  if (fio_cli_get_bool("-a"))
+    json_arena_bench(fiobj_str2cstr(json), obj1);
+  if (fio_cli_get("-q"))
+    json_path_bench(fiobj_str2cstr(json), obj1, fio_cli_get("-q"));
+  if (fio_cli_get_bool("-w"))
+    json_write_bench(obj1, (uint8_t)fio_cli_get_bool("-b"));
+  if (fio_cli_get_bool("-m"))
+    json_schema_bench();
   // cleanup
   FIOBJ_STR_TEMP_DESTROY(json);
   fiobj_free(obj1);
@@ -0,0 +1,192 @@
+/* *****************************************************************************
+JSON floating point benchmark (float-heavy JSON documents).
+
+Formats a corpus of doubles (prices, coordinates and scientific values) using
+`fio_ftoa`, the `printf("%g")` path `fio_ftoa` used to take and the shortest
+round-trip `printf("%.17g")` alternative, reporting the time per number and
+the number of values that don't survive a round-trip through `strtod`.
+
+Then serializes (`fiobj2json`) and parses (`fiobj_json_parse`) a FIOBJ array
+holding the same corpus, reporting throughput and round-trip errors.
+
+Run using:
+
+    make tests/json_float_bench
+
+Or, for specific settings:
+
+    make tests_build.json_float_bench && ./tmp/json_float_bench -h
+***************************************************************************** */
+#define FIO_LOG
+#define FIO_CLI
+#define FIO_RAND
+#define FIO_TIME
+#include "fio-stl.h"
+#define FIO_FIOBJ
+#include "fio-stl.h"
+
+/* *****************************************************************************
+Formatting Functions
+***************************************************************************** */
+
+/* the previous `fio_ftoa` implementation (6 significant digits) */
+static size_t bench_ftoa_g(char *dest, double num) {
+  size_t written = (size_t)snprintf(dest, 30, "%g", num);
+  for (char *start = dest;; ++start) {
+    switch (*start) {
+    case ',': *start = '.'; /* fall through */
+    case 'e':               /* fall through */
+    case 'n':               /* fall through */
+    case '.': return written;
+    case 0:
+      dest[written++] = '.';
+      dest[written++] = '0';
+      dest[written] = 0;
+      return written;
+    }
+  }
+}
+
+/* round-trip safe, but not the shortest representation */
+static size_t bench_ftoa_17g(char *dest, double num) {
+  return (size_t)snprintf(dest, 30, "%.17g", num);
+}
+
+static size_t bench_ftoa_fio(char *dest, double num) {
+  return fio_ftoa(dest, num, 10);
+}
+
+/* *****************************************************************************
+Benchmark State
+***************************************************************************** */
+
+static struct {
+  size_t count;
+  size_t rounds;
+  double *corpus;
+} BENCH;
+
+static void bench_corpus_init(void) {
+  BENCH.corpus = (double *)malloc(sizeof(double) * BENCH.count);
+  FIO_ASSERT_ALLOC(BENCH.corpus);
+  for (size_t i = 0; i < BENCH.count; ++i) {
+    uint64_t r = fio_rand64();
+    switch (i & 3) {
+    case 0: /* a price */
+      BENCH.corpus[i] = (double)(r % 10000000) / 100.0;
+      break;
+    case 1: /* a coordinate */
+      BENCH.corpus[i] = ((double)(r >> 11) / 9007199254740992.0) * 360.0 - 180;
+      break;
+    case 2: /* a measurement */
+      BENCH.corpus[i] = (double)(r % 1000000) / 1000.0;
+      break;
+    default: /* any finite double */
+      r &= ~((uint64_t)1 << 62); /* avoid Infinity / NaN */
+      FIO_MEMCPY(BENCH.corpus + i, &r, sizeof(r));
+    }
+  }
+}
+
+/* *****************************************************************************
+Benchmarks
+***************************************************************************** */
+
+static void bench_format(const char *name, size_t (*fn)(char *, double)) {
+  char buf[128];
+  size_t bytes = 0, errors = 0;
+  int64_t start = fio_time_nano();
+  for (size_t r = 0; r < BENCH.rounds; ++r) {
+    for (size_t i = 0; i < BENCH.count; ++i) {
+      bytes += fn(buf, BENCH.corpus[i]);
+      FIO_COMPILER_GUARD;
+    }
+  }
+  int64_t end = fio_time_nano();
+  for (size_t i = 0; i < BENCH.count; ++i) {
+    fn(buf, BENCH.corpus[i]);
+    errors += (strtod(buf, NULL) != BENCH.corpus[i]);
+  }
+  fprintf(stderr,
+          "* %-10s %6.1f ns per number, %5.1f bytes per number, "
+          "%zu / %zu round-trip errors\n",
+          name,
+          (double)(end - start) / (double)(BENCH.count * BENCH.rounds),
+          (double)bytes / (double)(BENCH.count * BENCH.rounds),
+          errors,
+          BENCH.count);
+}
+
+static void bench_json(void) {
+  FIOBJ ary = fiobj_array_new();
+  FIOBJ json = FIOBJ_INVALID, parsed = FIOBJ_INVALID;
+  size_t errors = 0;
+  for (size_t i = 0; i < BENCH.count; ++i)
+    fiobj_array_push(ary, fiobj_float_new(BENCH.corpus[i]));
+
+  int64_t start = fio_time_nano();
+  for (size_t r = 0; r < BENCH.rounds; ++r) {
+    fiobj_free(json);
+    json = fiobj2json(FIOBJ_INVALID, ary, 0);
+  }
+  int64_t mid = fio_time_nano();
+  for (size_t r = 0; r < BENCH.rounds; ++r) {
+    fiobj_free(parsed);
+    parsed = fiobj_json_parse(fiobj_str2cstr(json), NULL);
+  }
+  int64_t end = fio_time_nano();
+
+  FIO_ASSERT(fiobj_array_count(parsed) == BENCH.count, "JSON parsing failed");
+  for (size_t i = 0; i < BENCH.count; ++i)
+    errors += (fiobj2f(fiobj_array_get(parsed, (int64_t)i)) != BENCH.corpus[i]);
+  const double mb =
+      (double)(fiobj_str_len(json) * BENCH.rounds) / (1024.0 * 1024.0);
+  fprintf(stderr,
+          "* fiobj2json:       %.1f MB/s (%zu bytes)\n"
+          "* fiobj_json_parse: %.1f MB/s\n"
+          "* JSON round-trip:  %zu / %zu errors\n",
+          mb / ((double)(mid - start) / 1000000000.0),
+          fiobj_str_len(json),
+          mb / ((double)(end - mid) / 1000000000.0),
+          errors,
+          BENCH.count);
+  fiobj_free(parsed);
+  fiobj_free(json);
+  fiobj_free(ary);
+}
+
+/* *****************************************************************************
+Main
+***************************************************************************** */
+
+int main(int argc, char const *argv[]) {
+  fio_cli_start(argc,
+                argv,
+                0,
+                0,
+                "JSON floating point benchmark. Use:\n\n"
+                "\tNAME [options]",
+                FIO_CLI_INT("--count -n (100000) numbers in the corpus."),
+                FIO_CLI_INT("--rounds -r (10) rounds per test."));
+  BENCH.count = (size_t)fio_cli_get_i("-n");
+  BENCH.rounds = (size_t)fio_cli_get_i("-r");
+  if (!BENCH.count)
+    BENCH.count = 1;
+  if (!BENCH.rounds)
+    BENCH.rounds = 1;
+  bench_corpus_init();
+
+#if DEBUG
+  fprintf(stderr,
+          "\n=== WARNING: performance tests using the DEBUG mode are "
+          "invalid. \n");
+#endif
+  bench_format("fio_ftoa", bench_ftoa_fio);
+  bench_format("\"%g\"", bench_ftoa_g);
+  bench_format("\"%.17g\"", bench_ftoa_17g);
+  bench_json();
+
+  free(BENCH.corpus);
+  fio_cli_end();
+  return 0;
+}
@@ -0,0 +1,143 @@
+#define FIO_ATOL
+#define FIO_LOG
+#define FIO_TIME
+#include "fio-stl.h"
+
+#define FIO_UMAP_NAME bench_map
+#define FIO_MAP_KEY   uint64_t
+#define FIO_MAP_VALUE uint64_t
+#include "fio-stl.h"
+
+#define FIO_UMAP_NAME       bench_imap
+#define FIO_MAP_KEY         uint64_t
+#define FIO_MAP_VALUE       uint64_t
+#define FIO_MAP_INCREMENTAL 1
+#include "fio-stl.h"
+
+/* keys above this offset are never inserted (used for lookup misses). */
+#define MAP_BENCH_MISS_OFFSET ((uint64_t)1 << 40)
+/* the number of lookups performed for every map size (hits / misses). */
+#define MAP_BENCH_LOOKUPS ((size_t)1 << 23)
+
+/* a fast (well mixed) integer hash, so hashing doesn't mask lookup costs. */
+static uint64_t map_bench_hash(uint64_t key) {
+  key ^= key >> 33;
+  key *= UINT64_C(0xFF51AFD7ED558CCD);
+  key ^= key >> 33;
+  key *= UINT64_C(0xC4CEB9FE1A85EC53);
+  key ^= key >> 33;
+  return key;
+}
+
+/* records the worst single insert while growing a map to `items` keys. */
+#define MAP_BENCH_GROWTH(map_name, items)                                      \
+  do {                                                                         \
+    FIO_NAME(map_name, s) m = FIO_MAP_INIT;                                    \
+    int64_t worst = 0, total = fio_time_nano();                                \
+    for (uint64_t i = 0; i < (items); ++i) {                                   \
+      int64_t t = fio_time_nano();                                             \
+      FIO_NAME(map_name, set)(&m, map_bench_hash(i), i, i, NULL);              \
+      t = fio_time_nano() - t;                                                 \
+      if (t > worst)                                                           \
+        worst = t;                                                             \
+    }                                                                          \
+    total = fio_time_nano() - total;                                           \
+    for (uint64_t i = 0; i < (items); ++i)                                     \
+      FIO_ASSERT(FIO_NAME(map_name, get)(&m, map_bench_hash(i), i) == i,       \
+                 "growth benchmark key missing? %zu",                          \
+                 (size_t)i);                                                   \
+    fprintf(stderr,                                                            \
+            "\t - %-12s %.2f ms total, worst insert %.3f ms\n",               \
+            FIO_MACRO2STR(map_name) ":",                                       \
+            (double)total / 1000000.0,                                         \
+            (double)worst / 1000000.0);                                        \
+    FIO_NAME(map_name, destroy)(&m);                                           \
+  } while (0)
+
+int main(int argc, char const *argv[]) {
+  size_t limit = 10000000;
+  if (argc > 1)
+    limit = (size_t)fio_atol((char **)(argv + 1));
+  fprintf(stderr,
+          "This is a performance test for hash map lookups (hits / misses) "
+          "using %zu lookups per map size.\n",
+          MAP_BENCH_LOOKUPS);
+  for (size_t items = 1000; items <= limit; items *= 10) {
+    bench_map_s m = FIO_MAP_INIT;
+    uint64_t start, end, found = 0;
+    start = fio_time_nano();
+    for (uint64_t i = 0; i < items; ++i)
+      bench_map_set(&m, map_bench_hash(i), i, i, NULL);
+    end = fio_time_nano();
+    fprintf(stderr,
+            "%zu items (capacity %zu):\n"
+            "\t - insert:   %.2f ns per item\n",
+            items,
+            (size_t)bench_map_capa(&m),
+            (double)(end - start) / items);
+
+    start = fio_time_nano();
+    for (size_t i = 0, k = 0; i < MAP_BENCH_LOOKUPS; ++i) {
+      found += bench_map_get(&m, map_bench_hash(k), k) == k;
+      if (++k == items)
+        k = 0;
+    }
+    end = fio_time_nano();
+    FIO_ASSERT(found == MAP_BENCH_LOOKUPS, "lookup (hit) failed?");
+    fprintf(stderr,
+            "\t - hit:      %.2f ns per lookup\n",
+            (double)(end - start) / MAP_BENCH_LOOKUPS);
+
+    found = 0;
+    start = fio_time_nano();
+    for (size_t i = 0, k = 0; i < MAP_BENCH_LOOKUPS; ++i) {
+      found += !!bench_map_get_ptr(&m,
+                                   map_bench_hash(k + MAP_BENCH_MISS_OFFSET),
+                                   k + MAP_BENCH_MISS_OFFSET);
+      if (++k == items)
+        k = 0;
+    }
+    end = fio_time_nano();
+    FIO_ASSERT(!found, "lookup (miss) found a missing key?");
+    fprintf(stderr,
+            "\t - miss:     %.2f ns per lookup\n",
+            (double)(end - start) / MAP_BENCH_LOOKUPS);
+
+    start = fio_time_nano();
+    for (size_t i = 0; i < (items >> 1); ++i) { /* churn, leaves tombstones */
+      bench_map_remove(&m, map_bench_hash(i), i, NULL);
+      bench_map_set(&m,
+                    map_bench_hash(i + items),
+                    i + items,
+                    i + items,
+                    NULL);
+    }
+    end = fio_time_nano();
+    fprintf(stderr,
+            "\t - churn:    %.2f ns per remove + insert\n",
+            (double)(end - start) / (items >> 1));
+
+    found = 0;
+    start = fio_time_nano();
+    for (size_t i = 0, k = 0; i < MAP_BENCH_LOOKUPS; ++i) {
+      found += !!bench_map_get_ptr(&m,
+                                   map_bench_hash(k + MAP_BENCH_MISS_OFFSET),
+                                   k + MAP_BENCH_MISS_OFFSET);
+      if (++k == items)
+        k = 0;
+    }
+    end = fio_time_nano();
+    FIO_ASSERT(!found, "lookup (miss) found a missing key?");
+    fprintf(stderr,
+            "\t - miss:     %.2f ns per lookup (after churn)\n",
+            (double)(end - start) / MAP_BENCH_LOOKUPS);
+    bench_map_destroy(&m);
+  }
+  fprintf(stderr,
+          "Growing a map to %zu keys, blocking (bench_map) vs. incremental "
+          "(bench_imap) rehashing:\n",
+          limit);
+  MAP_BENCH_GROWTH(bench_map, limit);
+  MAP_BENCH_GROWTH(bench_imap, limit);
+  return 0;
+}
@@ -76,6 +76,28 @@ static void mustache_json_run_test(FIOBJ test) {
     fio_bstr_free(unescaped_expect);
     fio_bstr_free(unescaped_result);
   }
+  { /* bound templates and iov output should render the same */
+    fio_mustache_iov_s iov = {0};
+    fiobj_mustache_bind(m);
+    FIOBJ bound = fiobj_mustache_build(m, data);
+    fiobj_mustache_build_iov(m, &iov, data);
+    char *joined = NULL;
+    for (size_t i = 0; i < iov.count; ++i)
+      joined = fio_bstr_write(joined, iov.iov[i].buf, iov.iov[i].len);
+    FIO_ASSERT(FIO_BUF_INFO_IS_EQ(fio_bstr_buf(result),
+                                  (bound ? fiobj_str_buf(bound)
+                                         : FIO_BUF_INFO2(NULL, 0))),
+               "bound template result mismatch!\n\n%s\n\n%s",
+               result,
+               (bound ? fiobj_str_ptr(bound) : ""));
+    FIO_ASSERT(FIO_BUF_INFO_IS_EQ(fio_bstr_buf(result), fio_bstr_buf(joined)),
+               "iov template result mismatch!\n\n%s\n\n%s",
+               result,
+               joined);
+    fio_bstr_free(joined);
+    fio_mustache_iov_destroy(&iov);
+    fiobj_free(bound);
+  }
   printf(
       "* PASSED (%zu/%zu bytes used by mustache object, %zu/%zu by output)\n",
       fio_bstr_len((char *)m),
@@ -108,13 +130,149 @@ static void mustache_json_test(const char *json_file_name) {
   fiobj_free(json);
 }
 
+/* renders a product listing page using a FIOBJ context. */
+static void mustache_page_bench(void) {
+  const char *page_template =
+      "<!DOCTYPE html>\n<html>\n"
+      "<head><title>{{site.title}} - {{title}}</title></head>\n<body>\n"
+      "<header><h1>{{title}}</h1><p>Welcome back, {{user.name}}!</p>\n"
+      "</header>\n<ul class=\"products\">\n"
+      "{{#products}}\n"
+      "  <li id=\"p{{id}}\">\n"
+      "    <h2>{{name}}</h2>\n"
+      "    <p class=\"price\">{{currency}}{{price}}</p>\n"
+      "    <div class=\"description\">{{{description}}}</div>\n"
+      "    {{#on_sale}}<span class=\"sale\">On sale!</span>{{/on_sale}}\n"
+      "    {{^in_stock}}<span class=\"oos\">Sold out</span>{{/in_stock}}\n"
+      "  </li>\n"
+      "{{/products}}\n"
+      "</ul>\n<footer>{{site.footer}}</footer>\n</body>\n</html>\n";
+  char *json = fio_bstr_printf(
+      NULL,
+      "{\"title\":\"Products\",\"currency\":\"$\",\"site\":{\"title\":"
+      "\"Shop & Co.\",\"footer\":\"All rights reserved.\"},\"user\":{"
+      "\"name\":\"Jane <Doe>\"},\"products\":[");
+  for (size_t i = 0; i < 100; ++i)
+    json = fio_bstr_printf(json,
+                           "%s{\"id\":%zu,\"name\":\"Product #%zu\","
+                           "\"price\":\"%zu.99\",\"description\":\"<em>A "
+                           "great</em> product, number %zu.\",\"on_sale\":%s,"
+                           "\"in_stock\":%s}",
+                           (i ? "," : ""),
+                           i,
+                           i,
+                           (i % 90) + 9,
+                           i,
+                           ((i % 3) ? "false" : "true"),
+                           ((i % 5) ? "true" : "false"));
+  json = fio_bstr_write(json, "]}", 2);
+  FIOBJ data = fiobj_json_parse(fio_bstr_info(json), NULL);
+  FIO_ASSERT(data, "page benchmark JSON error:\n%s", json);
+  fio_mustache_s *m = fio_mustache_load(.data = FIO_BUF_INFO1(
+                                            (char *)page_template));
+  fio_mustache_s *mb = fio_mustache_load(.data = FIO_BUF_INFO1(
+                                             (char *)page_template));
+  FIO_ASSERT(m && mb, "page benchmark template error");
+  fiobj_mustache_bind(mb);
+
+  fio_mustache_iov_s iov = {0};
+  FIOBJ page = fiobj_mustache_build(m, data);
+  FIOBJ str = fiobj_str_new();
+  const size_t len = fiobj_str_len(page);
+  const size_t rounds = 1 + ((size_t)1 << 26) / len;
+  int64_t t[5];
+
+  t[0] = fio_time_nano();
+  for (size_t i = 0; i < rounds; ++i)
+    fiobj_free(fiobj_mustache_build(m, data));
+  t[1] = fio_time_nano();
+  for (size_t i = 0; i < rounds; ++i)
+    fiobj_free(fiobj_mustache_build(mb, data));
+  t[2] = fio_time_nano();
+  for (size_t i = 0; i < rounds; ++i) {
+    fiobj_str_resize(str, 0);
+    fiobj_mustache_build2(mb, str, data);
+  }
+  t[3] = fio_time_nano();
+  for (size_t i = 0; i < rounds; ++i)
+    fiobj_mustache_build_iov(mb, &iov, data);
+  t[4] = fio_time_nano();
+
+  FIO_ASSERT(FIO_BUF_INFO_IS_EQ(fiobj_str_buf(page), fiobj_str_buf(str)) &&
+                 iov.len == len,
+             "page benchmark output mismatch");
+  fprintf(stderr,
+          "* Mustache page rendering (%zu bytes, %zu buffers in iov mode):\n",
+          len,
+          iov.count);
+  const char *names[] = {
+      "unbound template (new String)",
+      "bound template (new String)  ",
+      "bound template (reused)      ",
+      "bound template (iov, reused) ",
+  };
+  for (size_t i = 0; i < 4; ++i)
+    fprintf(stderr,
+            "* %s %.0f pages/sec, %.2f GB/s\n",
+            names[i],
+            (double)rounds * 1000000000.0 / (double)(t[i + 1] - t[i]),
+            (double)(len * rounds) / (double)(t[i + 1] - t[i]));
+
+  { /* loading from disk per request vs. the template cache */
+    const char *fn = "./tmp_mustache_bench_page.mustache";
+    const size_t file_rounds = rounds >> 2;
+    fio_filename_overwrite(fn, page_template, strlen(page_template));
+    t[0] = fio_time_nano();
+    for (size_t i = 0; i < file_rounds; ++i) {
+      fio_mustache_s *tmp = fio_mustache_load(.filename = FIO_BUF_INFO1(
+                                                  (char *)fn));
+      fiobj_str_resize(str, 0);
+      fiobj_mustache_build2(tmp, str, data);
+      fio_mustache_free(tmp);
+    }
+    t[1] = fio_time_nano();
+    for (size_t i = 0; i < file_rounds; ++i) {
+      fio_mustache_s *tmp = fio_mustache_cache_get(
+          .filename = FIO_BUF_INFO1((char *)fn),
+          .var_hash = fiobj___mustache_var_hash);
+      fiobj_str_resize(str, 0);
+      fiobj_mustache_build2(tmp, str, data);
+      fio_mustache_free(tmp);
+    }
+    t[2] = fio_time_nano();
+    unlink(fn);
+    fio_mustache_cache_clear();
+    FIO_ASSERT(FIO_BUF_INFO_IS_EQ(fiobj_str_buf(page), fiobj_str_buf(str)),
+               "page benchmark (cached) output mismatch");
+    fprintf(stderr,
+            "* load + render per request      %.0f pages/sec\n"
+            "* template cache + render        %.0f pages/sec\n",
+            (double)file_rounds * 1000000000.0 / (double)(t[1] - t[0]),
+            (double)file_rounds * 1000000000.0 / (double)(t[2] - t[1]));
+  }
+
+  fio_mustache_iov_destroy(&iov);
+  fiobj_free(str);
+  fiobj_free(page);
+  fio_mustache_free(mb);
+  fio_mustache_free(m);
+  fiobj_free(data);
+  fio_bstr_free(json);
+}
+
 int main(int argc, char const *argv[]) {
   fio_cli_start(argc,
                 argv,
                 0,
                 -1,
                 "Mustache template testing using JSON specification file",
-                FIO_CLI_PRINT_LINE("Accepts JSON specification file name(s)."));
+                FIO_CLI_PRINT_LINE("Accepts JSON specification file name(s)."),
+                FIO_CLI_BOOL("--bench -b benchmark page rendering (bound, "
+                             "unbound and iov output)."));
+  if (fio_cli_get_bool("-b")) {
+    mustache_page_bench();
+    return 0;
+  }
   if (!fio_cli_unnamed_count()) {
     char *all_common_specs[] = {
         "./tests/mustache-specs/comments.json",
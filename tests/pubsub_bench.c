@@ -0,0 +1,530 @@
+/* *****************************************************************************
+Pub/Sub throughput and latency benchmarks.
+
+Scenarios:
+
+- local:    N publishers and M subscribers in a single process.
+- workers:  the root process publishes, M subscribers in each worker process
+            (measures the IPC cost).
+- cluster:  two local cluster nodes (processes) connected over loopback TCP,
+            M subscribers on each node (measures the cluster peer cost).
+
+Each receiving process reports delivered messages per second, delivery latency
+percentiles (p50 / p99 / p999) and the (approximate) memory per subscription.
+
+Run using:
+
+    make tests/pubsub_bench
+
+Or, for specific settings:
+
+    make tests_build.pubsub_bench && ./tmp/pubsub_bench -h
+***************************************************************************** */
+#define FIO_LOG
+#define FIO_CLI
+#define FIO_PUBSUB
+#include "fio-stl.h"
+
+#define FIO_SORT_NAME bench_lat
+#define FIO_SORT_TYPE int64_t
+#include "fio-stl.h"
+
+#if !FIO_OS_WIN
+#include <sys/resource.h>
+#include <sys/wait.h>
+#endif
+
+/* *****************************************************************************
+Benchmark State
+***************************************************************************** */
+
+#define BENCH_MAX_SAMPLES (1UL << 20)
+#define BENCH_MAX_PEERS   256
+
+static struct {
+  /* settings */
+  size_t publishers;
+  size_t subscribers;
+  size_t messages;
+  size_t msg_len;
+  size_t burst;
+  size_t timeout;
+  int workers;
+  uint8_t is_pattern;
+  uint8_t is_publisher;
+  uint8_t nodes;
+  const char *name;
+  /* publisher state */
+  size_t receivers; /* number of receiving processes (expected) */
+  size_t ready;
+  size_t done;
+  int ready_pids[BENCH_MAX_PEERS];
+  int64_t publish_start;
+  int64_t publish_end;
+  size_t published;
+  /* receiver state */
+  uintptr_t *handles;
+  size_t expected;
+  size_t received;
+  size_t stride;
+  size_t sample_count;
+  int64_t *samples;
+  int64_t first_published;
+  int64_t last_received;
+  size_t rss_per_sub;
+  uint8_t is_receiving;
+  uint8_t failed;
+  const char *exe;
+} BENCH;
+
+#define BENCH_CHANNEL FIO_BUF_INFO2((char *)"bench", 5)
+#define BENCH_PATTERN FIO_BUF_INFO2((char *)"bench.*", 7)
+#define BENCH_READY FIO_BUF_INFO2((char *)"bench-ready", 11)
+#define BENCH_DONE FIO_BUF_INFO2((char *)"bench-done", 10)
+#define BENCH_STOP FIO_BUF_INFO2((char *)"bench-stop", 10)
+
+/* returns the resident set size, in bytes (peak RSS if unknown, or 0) */
+static size_t bench_rss(void) {
+#if FIO_OS_WIN
+  return 0;
+#else
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (f) {
+    size_t pages = 0, resident = 0;
+    int found = fscanf(f, "%zu %zu", &pages, &resident);
+    fclose(f);
+    if (found == 2)
+      return resident * (size_t)sysconf(_SC_PAGESIZE);
+  }
+  struct rusage u;
+  if (getrusage(RUSAGE_SELF, &u))
+    return 0;
+#if defined(__APPLE__)
+  return (size_t)u.ru_maxrss;
+#else
+  return (size_t)u.ru_maxrss << 10;
+#endif
+#endif
+}
+
+/* *****************************************************************************
+Receiving Messages (subscribers)
+***************************************************************************** */
+
+static void bench_report(void) {
+  const double seconds =
+      (double)(BENCH.last_received - BENCH.first_published) / 1000000000.0;
+  bench_lat_sort(BENCH.samples, BENCH.sample_count);
+#define BENCH_PERCENTILE(per_mil)                                              \
+  ((double)BENCH.samples[(BENCH.sample_count * per_mil) / 1000] / 1000.0)
+  fprintf(stderr,
+          "\t(%d) %-8s %zu deliveries, %.0f msgs/s,"
+          " latency p50 %.1fus p99 %.1fus p999 %.1fus,"
+          " ~%zu bytes per subscription\n",
+          (int)getpid(),
+          BENCH.name,
+          BENCH.received,
+          (seconds > 0 ? (double)BENCH.received / seconds : 0.0),
+          BENCH_PERCENTILE(500),
+          BENCH_PERCENTILE(990),
+          BENCH_PERCENTILE(999),
+          BENCH.rss_per_sub);
+#undef BENCH_PERCENTILE
+}
+
+static void bench_on_message(fio_msg_s *msg) {
+  const int64_t now = fio_time_nano();
+  const int64_t published = (int64_t)fio_buf2u64u(msg->message.buf);
+  if (!BENCH.received || published < BENCH.first_published)
+    BENCH.first_published = published;
+  BENCH.last_received = now;
+  if (!(BENCH.received % BENCH.stride) &&
+      BENCH.sample_count < BENCH_MAX_SAMPLES)
+    BENCH.samples[BENCH.sample_count++] = now - published;
+  if (++BENCH.received != BENCH.expected)
+    return;
+  bench_report();
+  fio_publish(.channel = BENCH_DONE, .engine = FIO_PUBSUB_CLUSTER);
+}
+
+/* announces the process as ready until the first message arrives */
+static int bench_announce_ready(void *ignr1_, void *ignr2_) {
+  char buf[16];
+  if (BENCH.received)
+    return -1;
+  fio_u2buf32u(buf, (uint32_t)(int)getpid());
+  fio_publish(.channel = BENCH_READY,
+              .message = FIO_BUF_INFO2(buf, 4),
+              .engine = FIO_PUBSUB_CLUSTER);
+  return 0;
+  (void)ignr1_, (void)ignr2_;
+}
+
+static void bench_measure_and_announce(void *ignr1_, void *ignr2_) {
+  size_t rss = bench_rss();
+  BENCH.rss_per_sub = (rss > BENCH.rss_per_sub)
+                          ? ((rss - BENCH.rss_per_sub) / BENCH.subscribers)
+                          : 0;
+  bench_announce_ready(NULL, NULL);
+  fio_io_run_every(.fn = bench_announce_ready, .every = 50, .repetitions = -1);
+  (void)ignr1_, (void)ignr2_;
+}
+
+/* called in every process that performs work (workers / single process) */
+static void bench_subscribe(void *ignr_) {
+  (void)ignr_;
+  if (!BENCH.is_receiving)
+    return;
+  BENCH.expected = BENCH.publishers * BENCH.messages * BENCH.subscribers;
+  BENCH.stride = (BENCH.expected / BENCH_MAX_SAMPLES) + 1;
+  BENCH.samples = (int64_t *)malloc(sizeof(*BENCH.samples) *
+                                    ((BENCH.expected / BENCH.stride) + 1));
+  BENCH.handles =
+      (uintptr_t *)calloc(BENCH.subscribers, sizeof(*BENCH.handles));
+  FIO_ASSERT_ALLOC(BENCH.samples && BENCH.handles);
+  BENCH.rss_per_sub = bench_rss();
+  for (size_t i = 0; i < BENCH.subscribers; ++i)
+    fio_subscribe(.channel = (BENCH.is_pattern ? BENCH_PATTERN
+                                               : BENCH_CHANNEL),
+                  .on_message = bench_on_message,
+                  .is_pattern = BENCH.is_pattern,
+                  .subscription_handle_ptr = BENCH.handles + i);
+  /* subscriptions are performed by the IO queue, measure afterwards */
+  fio_io_defer(bench_measure_and_announce, NULL, NULL);
+}
+
+static void bench_unsubscribe(void *ignr_) {
+  (void)ignr_;
+  if (!BENCH.handles)
+    return;
+  for (size_t i = 0; i < BENCH.subscribers; ++i)
+    fio_unsubscribe(.channel = (BENCH.is_pattern
+                                    ? BENCH_PATTERN
+                                    : BENCH_CHANNEL),
+                    .is_pattern = BENCH.is_pattern,
+                    .subscription_handle_ptr = BENCH.handles + i);
+  free(BENCH.handles);
+  free(BENCH.samples);
+  BENCH.handles = NULL;
+  BENCH.samples = NULL;
+}
+
+/* *****************************************************************************
+Publishing Messages
+***************************************************************************** */
+
+static void bench_publish_task(void *pub_, void *count_) {
+  char buf[256];
+  const size_t pub = (size_t)(uintptr_t)pub_;
+  size_t count = (size_t)(uintptr_t)count_;
+  size_t burst = BENCH.burst;
+  FIO_STR_INFO_TMP_VAR(channel, 32);
+  fio_string_write(&channel, NULL, BENCH_CHANNEL.buf, BENCH_CHANNEL.len);
+  if (BENCH.is_pattern)
+    fio_string_write2(&channel,
+                      NULL,
+                      FIO_STRING_WRITE_STR2(".", 1),
+                      FIO_STRING_WRITE_UNUM(pub));
+  FIO_MEMSET(buf, 'x', BENCH.msg_len);
+  for (; count < BENCH.messages && burst; ++count, --burst) {
+    fio_u2buf64u(buf, (uint64_t)fio_time_nano());
+    fio_publish(.channel = FIO_STR2BUF_INFO(channel),
+                .message = FIO_BUF_INFO2(buf, BENCH.msg_len),
+                .engine = FIO_PUBSUB_CLUSTER);
+  }
+  BENCH.published += BENCH.burst - burst;
+  if (count < BENCH.messages) {
+    fio_io_defer(bench_publish_task, pub_, (void *)(uintptr_t)count);
+    return;
+  }
+  if (BENCH.published != BENCH.publishers * BENCH.messages)
+    return;
+  BENCH.publish_end = fio_time_nano();
+  fprintf(stderr,
+          "\t(%d) %-8s published %zu messages (%zu publishers), %.0f msgs/s\n",
+          (int)getpid(),
+          BENCH.name,
+          BENCH.published,
+          BENCH.publishers,
+          (double)BENCH.published * 1000000000.0 /
+              (double)(BENCH.publish_end - BENCH.publish_start + 1));
+}
+
+static void bench_on_ready(fio_msg_s *msg) {
+  if (!BENCH.is_publisher || !fio_io_is_master() || msg->message.len != 4 ||
+      BENCH.ready >= BENCH.receivers)
+    return;
+  const int pid = (int)fio_buf2u32u(msg->message.buf);
+  for (size_t i = 0; i < BENCH.ready; ++i)
+    if (BENCH.ready_pids[i] == pid)
+      return;
+  BENCH.ready_pids[BENCH.ready++] = pid;
+  if (BENCH.ready != BENCH.receivers)
+    return;
+  BENCH.publish_start = fio_time_nano();
+  for (size_t i = 0; i < BENCH.publishers; ++i)
+    fio_io_defer(bench_publish_task, (void *)(uintptr_t)i, NULL);
+}
+
+/* *****************************************************************************
+Stopping
+***************************************************************************** */
+
+static int bench_stop_task(void *ignr1_, void *ignr2_) {
+  fio_io_stop();
+  return -1;
+  (void)ignr1_, (void)ignr2_;
+}
+
+static void bench_on_done(fio_msg_s *msg) {
+  if (!BENCH.is_publisher || !fio_io_is_master())
+    return;
+  if (++BENCH.done != BENCH.receivers)
+    return;
+  fio_publish(.channel = BENCH_STOP, .engine = FIO_PUBSUB_CLUSTER);
+  fio_io_run_every(.fn = bench_stop_task, .every = 100, .repetitions = 1);
+  (void)msg;
+}
+
+static void bench_on_stop(fio_msg_s *msg) {
+  if (fio_io_is_master())
+    fio_io_stop();
+  (void)msg;
+}
+
+static int bench_on_timeout(void *ignr1_, void *ignr2_) {
+  if (!fio_io_is_master())
+    return -1;
+  FIO_LOG_ERROR("(%d) %s benchmark timed out (%zu/%zu ready, %zu/%zu done)",
+                (int)getpid(),
+                BENCH.name,
+                BENCH.ready,
+                BENCH.receivers,
+                BENCH.done,
+                BENCH.receivers);
+  BENCH.failed = 1;
+  fio_io_stop();
+  return -1;
+  (void)ignr1_, (void)ignr2_;
+}
+
+/* *****************************************************************************
+Running a Scenario
+***************************************************************************** */
+
+static int bench_run(void) {
+  fio_subscribe(.channel = BENCH_READY, .on_message = bench_on_ready);
+  fio_subscribe(.channel = BENCH_DONE, .on_message = bench_on_done);
+  fio_subscribe(.channel = BENCH_STOP, .on_message = bench_on_stop);
+  fio_state_callback_add(FIO_CALL_ON_START, bench_subscribe, NULL);
+  fio_state_callback_add(FIO_CALL_ON_STOP, bench_unsubscribe, NULL);
+  fio_io_run_every(.fn = bench_on_timeout,
+                   .every = (uint32_t)(BENCH.timeout * 1000),
+                   .repetitions = 1);
+  fio_io_start(BENCH.workers);
+  return BENCH.failed;
+}
+
+/* attaches an accepted / connected cluster peer socket */
+static void bench_attach_peer(void *fd_) {
+  int fd = (int)(intptr_t)fd_;
+  if (BENCH.is_publisher) { /* node A: accept node B's connection */
+    int listening = fd;
+    fd = accept(listening, NULL, NULL);
+    fio_sock_close(listening);
+    FIO_ASSERT(fd != -1, "couldn't accept cluster peer connection");
+    fio_sock_set_non_block(fd);
+  }
+  /* benchmarks peek into the implementation's cluster peer protocol */
+  fio_io_attach_fd(fd, &FIO___PUBSUB_POSTOFFICE.protocol.remote, NULL, NULL);
+}
+
+/* node B: a fresh process (own reactor, IPC address and IDs), receives only */
+static int bench_run_peer(const char *port) {
+  int fd = fio_sock_open("127.0.0.1",
+                         port,
+                         FIO_SOCK_TCP | FIO_SOCK_CLIENT | FIO_SOCK_NONBLOCK);
+  FIO_ASSERT(fd != -1, "couldn't connect to cluster benchmark node");
+  FIO_LOG_LEVEL = FIO_LOG_LEVEL_WARNING;
+  BENCH.name = "cluster";
+  BENCH.nodes = 2;
+  BENCH.is_receiving = 1;
+  fio_state_callback_add(FIO_CALL_PRE_START,
+                         bench_attach_peer,
+                         (void *)(intptr_t)fd);
+  return bench_run();
+}
+
+/* node A: publishes and receives, starts node B using the same settings */
+static int bench_run_cluster(void) {
+  char port[16], secret[40];
+  char num[6][24];
+  struct sockaddr_in addr;
+  socklen_t addr_len = sizeof(addr);
+  int fd = fio_sock_open("127.0.0.1", "0", FIO_SOCK_TCP | FIO_SOCK_SERVER);
+  FIO_ASSERT(fd != -1, "couldn't open cluster benchmark socket");
+  FIO_ASSERT(!getsockname(fd, (struct sockaddr *)&addr, &addr_len),
+             "couldn't read cluster benchmark socket address");
+  snprintf(port, sizeof(port), "%u", (unsigned)fio_ntol16(addr.sin_port));
+  /* cluster nodes must share a secret, node B reads it from the environment */
+  snprintf(secret,
+           sizeof(secret),
+           "%016llx%016llx",
+           (unsigned long long)fio_rand64(),
+           (unsigned long long)fio_rand64());
+  fio_pubsub_secret_set(secret, strlen(secret));
+  setenv("SECRET", secret, 1);
+  snprintf(num[0], sizeof(num[0]), "%zu", BENCH.publishers);
+  snprintf(num[1], sizeof(num[1]), "%zu", BENCH.subscribers);
+  snprintf(num[2], sizeof(num[2]), "%zu", BENCH.messages);
+  snprintf(num[3], sizeof(num[3]), "%zu", BENCH.msg_len);
+  snprintf(num[4], sizeof(num[4]), "%zu", BENCH.timeout);
+  snprintf(num[5], sizeof(num[5]), "%zu", BENCH.burst);
+  char *args[] = {(char *)BENCH.exe,
+                  (char *)"--peer",
+                  port,
+                  (char *)"-p",
+                  num[0],
+                  (char *)"-s",
+                  num[1],
+                  (char *)"-n",
+                  num[2],
+                  (char *)"-l",
+                  num[3],
+                  (char *)"-t",
+                  num[4],
+                  (char *)"-b",
+                  num[5],
+                  (BENCH.is_pattern ? (char *)"-P" : NULL),
+                  NULL};
+  pid_t node_b = fork();
+  FIO_ASSERT(node_b != -1, "couldn't fork second cluster node");
+  if (!node_b) { /* exec, so node B doesn't share any (polling) state */
+    fio_sock_close(fd);
+    execv(BENCH.exe, args);
+    FIO_LOG_FATAL("couldn't start second cluster node: %s", strerror(errno));
+    _exit(-1);
+  }
+  fio_state_callback_add(FIO_CALL_PRE_START,
+                         bench_attach_peer,
+                         (void *)(intptr_t)fd);
+  int r = bench_run();
+  int status = 0;
+  if (waitpid(node_b, &status, 0) == -1 || !WIFEXITED(status) ||
+      WEXITSTATUS(status))
+    r = -1;
+  return r;
+}
+
+/* runs a scenario in a child process, so each scenario starts fresh */
+static int bench_scenario(const char *name, int workers, uint8_t nodes) {
+  pid_t pid = fork();
+  FIO_ASSERT(pid != -1, "couldn't fork benchmark scenario");
+  if (pid) {
+    int status = 0;
+    if (waitpid(pid, &status, 0) == -1 || !WIFEXITED(status) ||
+        WEXITSTATUS(status)) {
+      FIO_LOG_ERROR("%s benchmark failed.", name);
+      return -1;
+    }
+    return 0;
+  }
+  FIO_LOG_LEVEL = FIO_LOG_LEVEL_WARNING;
+  BENCH.name = name;
+  BENCH.workers = workers;
+  BENCH.nodes = nodes;
+  BENCH.is_publisher = 1;
+  BENCH.is_receiving = 1;
+  BENCH.receivers = (size_t)nodes * (size_t)(workers ? workers : 1);
+  fprintf(stderr,
+          "* Pub/Sub %s benchmark (%d worker(s), %d node(s)):\n",
+          name,
+          workers,
+          (int)nodes);
+  exit((nodes > 1) ? bench_run_cluster() : bench_run());
+}
+
+/* *****************************************************************************
+Main
+***************************************************************************** */
+
+int main(int argc, char const *argv[]) {
+  int r = 0;
+  fio_cli_start(
+      argc,
+      argv,
+      0,
+      0,
+      "Pub/Sub throughput and latency benchmarks. Use:\n\n\tNAME [options]\n\n"
+      "Scenarios: local (in-process), workers (IPC), cluster (two nodes over "
+      "loopback TCP) or all.",
+      FIO_CLI_STRING("--scenario -S (all) the scenario to run."),
+      FIO_CLI_INT("--publishers -p (1) number of publishers."),
+      FIO_CLI_INT("--subscribers -s (500) subscribers per receiving process."),
+      FIO_CLI_INT("--messages -n (2000) messages per publisher."),
+      FIO_CLI_INT("--length -l (32) message payload length (8-256 bytes)."),
+      FIO_CLI_INT("--burst -b (64) messages published per reactor cycle."),
+      FIO_CLI_INT("--workers -w (2) worker processes (workers scenario)."),
+      FIO_CLI_INT("--timeout -t (30) seconds before a scenario fails."),
+      FIO_CLI_BOOL("--pattern -P subscribe using a pattern (\"bench.*\")."),
+      FIO_CLI_STRING("--peer used internally to start the second cluster "
+                     "node, connecting to the first node's port."));
+  BENCH.publishers = (size_t)fio_cli_get_i("-p");
+  BENCH.subscribers = (size_t)fio_cli_get_i("-s");
+  BENCH.messages = (size_t)fio_cli_get_i("-n");
+  BENCH.msg_len = (size_t)fio_cli_get_i("-l");
+  BENCH.burst = (size_t)fio_cli_get_i("-b");
+  BENCH.timeout = (size_t)fio_cli_get_i("-t");
+  BENCH.is_pattern = (uint8_t)fio_cli_get_bool("-P");
+  int workers = (int)fio_cli_get_i("-w");
+  const char *scenario = fio_cli_get("-S");
+  if (!BENCH.publishers)
+    BENCH.publishers = 1;
+  if (!BENCH.subscribers)
+    BENCH.subscribers = 1;
+  if (!BENCH.messages)
+    BENCH.messages = 1;
+  if (BENCH.msg_len < 8)
+    BENCH.msg_len = 8;
+  if (BENCH.msg_len > 256)
+    BENCH.msg_len = 256;
+  if (!BENCH.burst)
+    BENCH.burst = 1;
+  if (!BENCH.timeout)
+    BENCH.timeout = 30;
+  if (workers < 1)
+    workers = 1;
+  if (workers > (BENCH_MAX_PEERS >> 1))
+    workers = (BENCH_MAX_PEERS >> 1);
+
+  BENCH.exe = argv[0];
+
+  if (fio_cli_get("--peer")) {
+    r = bench_run_peer(fio_cli_get("--peer"));
+    fio_cli_end();
+    return r;
+  }
+
+#if DEBUG
+  fprintf(stderr,
+          "\n=== WARNING: performance tests using the DEBUG mode are "
+          "invalid. \n");
+#endif
+  fprintf(stderr,
+          "* %zu publisher(s) x %zu messages (%zu bytes) -> %zu %s "
+          "subscriber(s) per process.\n",
+          BENCH.publishers,
+          BENCH.messages,
+          BENCH.msg_len,
+          BENCH.subscribers,
+          (BENCH.is_pattern ? "pattern" : "channel"));
+
+  if (!scenario || !strcmp(scenario, "all") || !strcmp(scenario, "local"))
+    r |= bench_scenario("local", 0, 1);
+  if (!scenario || !strcmp(scenario, "all") || !strcmp(scenario, "workers"))
+    r |= bench_scenario("workers", workers, 1);
+  if (!scenario || !strcmp(scenario, "all") || !strcmp(scenario, "cluster"))
+    r |= bench_scenario("cluster", 0, 2);
+  fio_cli_end();
+  return r;
+}
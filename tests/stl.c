@@ -4,6 +4,12 @@
 #ifndef FIO_LEAK_COUNTER
 #define FIO_LEAK_COUNTER 1
 #endif
+#ifndef FIO_JSON_USE_INDEX /* test the (opt-in) JSON structural index */
+#define FIO_JSON_USE_INDEX 1
+#endif
+#ifndef FIO_HTTP_STATIC_FILE_CACHE_LIMIT /* test the (opt-in) file cache */
+#define FIO_HTTP_STATIC_FILE_CACHE_LIMIT (1UL << 23)
+#endif
 #ifdef DEBUG
 #define FIO_MEMALT 1
 #endif